@@ -1,15 +1,19 @@
 # Usage:
 #   lcm_wrap_types([C_HEADERS <VARIABLE_NAME> C_SOURCES <VARIABLE_NAME>
 #                   [C_INCLUDE <PATH>] [C_EXPORT <NAME>]
-#                   [C_NOPUBSUB] [C_TYPEINFO]]
+#                   [C_NOPUBSUB] [C_TYPEINFO] [C_VIEWS]
+#                   [C_DECODE_FIELDS] [C_REGISTRY]]
 #                  [CPP_HEADERS <VARIABLE_NAME>
-#                   [CPP_INCLUDE <PATH>] [CPP11]]
+#                   [CPP_INCLUDE <PATH>] [CPP11] [CPP_DECODE_FIELDS]
+#                   [CPP_VIEWS] [CPP_SOA <TYPE.MEMBER>[,...]]]
 #                  [JAVA_SOURCES <VARIABLE_NAME>]
-#                  [PYTHON_SOURCES <VARIABLE_NAME>]
+#                  [PYTHON_SOURCES <VARIABLE_NAME> [PYTHON_NUMPY]]
 #                  [LUA_SOURCES <VARIABLE_NAME>]
-#                  [DESTINATION <PATH>]
+#                  [DESTINATION <PATH>] [CACHE_DIR <PATH>]
 #                  <FILE> [<FILE>...])
-#     generate bindings for specified LCM type definition files
+#     generate bindings for specified LCM type definition files.  With
+#     CACHE_DIR, the bindings of the types that did not change are not
+#     written again
 #
 #   lcm_add_library(<NAME> C [STATIC|SHARED|MODULE] <SOURCES>)
 #   lcm_add_library(<NAME> CPP <SOURCES>)
@@ -157,19 +161,21 @@ endfunction()
 function(lcm_wrap_types)
   # Parse arguments
   set(_flags
-    C_NOPUBSUB C_TYPEINFO
-    CPP11
+    C_NOPUBSUB C_TYPEINFO C_VIEWS C_DECODE_FIELDS C_REGISTRY
+    CPP11 CPP_DECODE_FIELDS CPP_VIEWS
+    PYTHON_NUMPY
     CREATE_C_AGGREGATE_HEADER
     CREATE_CPP_AGGREGATE_HEADER
   )
   set(_sv_opts
     C_HEADERS C_SOURCES C_INCLUDE C_EXPORT
-    CPP_HEADERS CPP_INCLUDE
+    CPP_HEADERS CPP_INCLUDE CPP_SOA
     JAVA_SOURCES
     PYTHON_SOURCES
     LUA_SOURCES
     DESTINATION
     PACKAGE_PREFIX
+    CACHE_DIR
   )
   set(_mv_opts "")
   cmake_parse_arguments("" "${_flags}" "${_sv_opts}" "${_mv_opts}" ${ARGN})
@@ -206,21 +212,34 @@ function(lcm_wrap_types)
   # Set up arguments for invoking lcm-gen
   set(_args "")
   if(DEFINED _C_HEADERS)
-    list(APPEND _args --c --c-cpath ${_DESTINATION} --c-hpath ${_DESTINATION})
+    # the registry is generated from all of the files at once, with the same
+    # paths and export options as the types
+    set(_registry_args --c-cpath ${_DESTINATION} --c-hpath ${_DESTINATION})
     if(DEFINED _C_EXPORT)
       string(TOUPPER "${_C_EXPORT}_EXPORT" _C_EXPORT_SYMBOL)
-      list(APPEND _args --c-export-symbol ${_C_EXPORT_SYMBOL})
-      list(APPEND _args --c-export-include "${_C_EXPORT}_export.h")
+      list(APPEND _registry_args --c-export-symbol ${_C_EXPORT_SYMBOL})
+      list(APPEND _registry_args --c-export-include "${_C_EXPORT}_export.h")
     endif()
     if(DEFINED _C_INCLUDE)
-      list(APPEND _args --cinclude ${_C_INCLUDE})
+      list(APPEND _registry_args --cinclude ${_C_INCLUDE})
     endif()
     if(_C_NOPUBSUB)
-      list(APPEND _args --c-no-pubsub)
+      list(APPEND _registry_args --c-no-pubsub)
+    endif()
+    list(APPEND _args --c ${_registry_args})
+    if(_C_REGISTRY AND NOT _C_TYPEINFO)
+      message(SEND_ERROR "lcm_wrap_types: C_REGISTRY requires C_TYPEINFO")
+      return()
     endif()
     if(_C_TYPEINFO)
       list(APPEND _args --c-typeinfo)
     endif()
+    if(_C_VIEWS)
+      list(APPEND _args --c-views)
+    endif()
+    if(_C_DECODE_FIELDS)
+      list(APPEND _args --c-decode-fields)
+    endif()
   endif()
   if(DEFINED _CPP_HEADERS)
     list(APPEND _args --cpp --cpp-hpath ${_DESTINATION})
@@ -230,12 +249,24 @@ function(lcm_wrap_types)
     if(_CPP11)
       list(APPEND _args --cpp-std=c++11)
     endif()
+    if(_CPP_DECODE_FIELDS)
+      list(APPEND _args --cpp-decode-fields)
+    endif()
+    if(_CPP_VIEWS)
+      list(APPEND _args --cpp-views)
+    endif()
+    if(DEFINED _CPP_SOA)
+      list(APPEND _args --cpp-soa=${_CPP_SOA})
+    endif()
   endif()
   if(DEFINED _JAVA_SOURCES)
     list(APPEND _args --java --jpath ${_DESTINATION})
   endif()
   if(DEFINED _PYTHON_SOURCES)
     list(APPEND _args --python --python-no-init --ppath ${_DESTINATION})
+    if(_PYTHON_NUMPY)
+      list(APPEND _args --python-numpy)
+    endif()
   endif()
   if(DEFINED _LUA_SOURCES)
     list(APPEND _args --lua --lua-no-init --lpath ${_DESTINATION})
@@ -243,9 +274,14 @@ function(lcm_wrap_types)
   if(DEFINED _PACKAGE_PREFIX)
     list(APPEND _args --package-prefix ${_PACKAGE_PREFIX})
   endif()
+  if(DEFINED _CACHE_DIR)
+    list(APPEND _args --cache-dir ${_CACHE_DIR})
+  endif()
 
   # Create build rules
   set(_aggregate_headers "")
+  set(_registry_packages "")
+  set(_registry_files "")
   set(_python_packages "")
   set(_lua_packages "")
   foreach(_lcmtype ${_UNPARSED_ARGUMENTS})
@@ -279,6 +315,9 @@ function(lcm_wrap_types)
       elseif(_line MATCHES "^ *(struct|enum) +")
         # Get type name
         _lcm_extract_token(_type 1 "${_line}")
+        if(_line MATCHES "^ *struct +")
+          list(APPEND _registry_packages "${_package_pre}")
+        endif()
 
         # Determine output file name(s) and add to output variables
         if(DEFINED _C_HEADERS AND DEFINED _C_SOURCES)
@@ -314,6 +353,7 @@ function(lcm_wrap_types)
 
     # Define build command for input file
     get_filename_component(_lcmtype_full "${_lcmtype}" ABSOLUTE)
+    list(APPEND _registry_files ${_lcmtype_full})
     if(WIN32)
       add_custom_command(
         OUTPUT ${_outputs}
@@ -330,6 +370,40 @@ function(lcm_wrap_types)
     endif()
   endforeach()
 
+  # Define build command for the registries of the packages
+  if(DEFINED _C_HEADERS AND _C_REGISTRY AND _registry_packages)
+    set(_outputs "")
+    list(REMOVE_DUPLICATES _registry_packages)
+    foreach(_package_pre ${_registry_packages})
+      if(_package_pre STREQUAL "")
+        set(_registry_name registry)
+      else()
+        set(_registry_name ${_package_pre}_registry)
+      endif()
+      _lcm_add_outputs(_C_HEADERS ${_registry_name}.h)
+      _lcm_add_outputs(_C_SOURCES ${_registry_name}.c)
+    endforeach()
+    list(APPEND _registry_args --c-registry --c-typeinfo)
+    if(DEFINED _PACKAGE_PREFIX)
+      list(APPEND _registry_args --package-prefix ${_PACKAGE_PREFIX})
+    endif()
+    if(WIN32)
+      add_custom_command(
+        OUTPUT ${_outputs}
+        COMMAND ${CMAKE_COMMAND} -E env "PATH=${LCM_LCMGEN_PATH}"
+          $<TARGET_FILE:${LCM_NAMESPACE}lcm-gen> ${_registry_args}
+          ${_registry_files}
+        DEPENDS ${_UNPARSED_ARGUMENTS}
+      )
+    else()
+      add_custom_command(
+        OUTPUT ${_outputs}
+        COMMAND ${LCM_NAMESPACE}lcm-gen ${_registry_args} ${_registry_files}
+        DEPENDS ${_UNPARSED_ARGUMENTS}
+      )
+    endif()
+  endif()
+
   # Finalize aggregate headers and packages
   _lcm_finalize_aggregate_headers()
   _lcm_finalize_lua_packages()
@@ -14,6 +14,7 @@ namespace LCM.LCM
             internal string regex;
             internal Regex pat;
             internal LCMSubscriber lcsub;
+            internal LCMBufferSubscriber bufsub;
         }
 
         private List<SubscriptionRecord> subscriptions = new List<SubscriptionRecord>();
@@ -212,12 +213,38 @@ namespace LCM.LCM
 			srec.regex = regex;
 			srec.pat = new Regex(regex);
 			srec.lcsub = sub;
-			
+			AddSubscription(srec);
+		}
+
+		/// <summary>
+        /// Subscribe to all channels whose name matches the regular
+        /// expression, receiving the contents of each message as a segment
+        /// of the provider's receive buffer, without a copy and without a
+        /// stream.
+        /// </summary>
+        /// <param name="regex">regular expression determining the channels to subscribe</param>
+        /// <param name="sub">subscribing object</param>
+		public void SubscribeBuffer(string regex, LCMBufferSubscriber sub)
+		{
+            if (this.closed)
+            {
+                throw new SystemException();
+            }
+
+			SubscriptionRecord srec = new SubscriptionRecord();
+			srec.regex = regex;
+			srec.pat = new Regex(regex);
+			srec.bufsub = sub;
+			AddSubscription(srec);
+		}
+
+		private void AddSubscription(SubscriptionRecord srec)
+		{
 			lock (this)
 			{
 				foreach (Provider p in providers)
                 {
-				    p.Subscribe(regex);
+				    p.Subscribe(srec.regex);
                 }
 			}
 			
@@ -259,6 +286,22 @@ namespace LCM.LCM
         /// <param name="regex">regular expression determining the channels to unsubscribe</param>
         /// <param name="sub">unsubscribing object</param>
 		public void Unsubscribe(string regex, LCMSubscriber sub)
+		{
+			RemoveSubscriptions(regex, sub);
+		}
+
+		/// <summary>
+        /// Remove a regex/subscriber pair made with SubscribeBuffer(), with
+        /// the same meaning of null arguments as Unsubscribe().
+        /// </summary>
+        /// <param name="regex">regular expression determining the channels to unsubscribe</param>
+        /// <param name="sub">unsubscribing object</param>
+		public void UnsubscribeBuffer(string regex, LCMBufferSubscriber sub)
+		{
+			RemoveSubscriptions(regex, sub);
+		}
+
+		private void RemoveSubscriptions(string regex, object sub)
 		{
             if (this.closed)
             {
@@ -281,7 +324,7 @@ namespace LCM.LCM
 				// Find and remove subscriber from list
                 foreach (SubscriptionRecord sr in subscriptions.ToArray())
                 {
-                    if ((sub == null || sr.lcsub == sub) && (regex == null || sr.regex.Equals(regex)))
+                    if ((sub == null || sr.lcsub == sub || sr.bufsub == sub) && (regex == null || sr.regex.Equals(regex)))
                     {
                         subscriptions.Remove(sr);
                     }
@@ -295,7 +338,7 @@ namespace LCM.LCM
                     {
                         foreach (SubscriptionRecord sr in srecs.ToArray())
                         {
-		                    if ((sub == null || sr.lcsub == sub) && (regex == null || sr.regex.Equals(regex)))
+		                    if ((sub == null || sr.lcsub == sub || sr.bufsub == sub) && (regex == null || sr.regex.Equals(regex)))
                             {
                                 srecs.Remove(sr);
 		                    }
@@ -363,6 +406,11 @@ namespace LCM.LCM
 				
 				foreach (SubscriptionRecord srec in srecs)
 				{
+					if (srec.bufsub != null)
+					{
+						srec.bufsub.MessageReceived(this, channel, new ArraySegment<byte>(data, offset, length));
+						continue;
+					}
 					srec.lcsub.MessageReceived(this, channel, new LCMDataInputStream(data, offset, length));
 				}
 			}
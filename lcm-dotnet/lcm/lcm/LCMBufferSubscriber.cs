@@ -0,0 +1,24 @@
+using System;
+
+namespace LCM.LCM
+{
+	/// <summary>
+    /// A class which listens for messages on a particular channel, and
+    /// receives their contents as a segment of the provider's receive buffer
+    /// instead of a stream.
+    /// </summary>
+	public interface LCMBufferSubscriber
+	{
+		/// <summary>
+        /// Invoked by LCM when a message is received.
+		/// 
+		/// This method is invoked from the LCM thread.  The segment refers to
+		/// the provider's receive buffer, which is reused once this method
+		/// returns, so copy any data that must be kept.
+		/// </summary>
+		/// <param name="lcm">the LCM instance that received the message</param>
+		/// <param name="channel">the channel on which the message was received</param>
+		/// <param name="data">the message contents</param>
+		void MessageReceived(LCM lcm, string channel, ArraySegment<byte> data);
+	}
+}
@@ -1,7 +1,18 @@
 using System;
+using System.Runtime.InteropServices;
 
 namespace LCM.LCM
-{	
+{
+    /// <summary>
+    /// Reinterprets the bits of a float without allocating.
+    /// </summary>
+    [StructLayout(LayoutKind.Explicit)]
+    internal struct FloatBits
+    {
+        [FieldOffset(0)] public float f;
+        [FieldOffset(0)] public int i;
+    }
+
 	/// <summary>
     /// Will not throw EOF.
     /// </summary>
@@ -90,46 +101,137 @@ namespace LCM.LCM
 			return (char) ReadInt16();
 		}
 		
+		// big-endian conversions straight from buf, which don't allocate
+		private short GetInt16(int p)
+		{
+			return (short) ((buf[p] << 8) | buf[p + 1]);
+		}
+		
+		private int GetInt32(int p)
+		{
+			return (buf[p] << 24) | (buf[p + 1] << 16) | (buf[p + 2] << 8) | buf[p + 3];
+		}
+		
+		private long GetInt64(int p)
+		{
+			return ((long) GetInt32(p) << 32) | (uint) GetInt32(p + 4);
+		}
+		
+		private float GetSingle(int p)
+		{
+			FloatBits bits = new FloatBits();
+			bits.i = GetInt32(p);
+			return bits.f;
+		}
+		
 		public override short ReadInt16()
 		{
 			NeedInput(2);
             pos += 2;
-			return Util.BitConverter.ToInt16(buf, pos - 2);
+			return GetInt16(pos - 2);
 		}
 		
 		public override ushort ReadUInt16()
 		{
             NeedInput(2);
             pos += 2;
-            return Util.BitConverter.ToUInt16(buf, pos - 2);
+            return (ushort) GetInt16(pos - 2);
 		}
 		
 		public override int ReadInt32()
 		{
             NeedInput(4);
             pos += 4;
-            return Util.BitConverter.ToInt32(buf, pos - 4);
+            return GetInt32(pos - 4);
 		}
 		
 		public override long ReadInt64()
 		{
             NeedInput(8);
             pos += 8;
-            return Util.BitConverter.ToInt64(buf, pos - 8);
+            return GetInt64(pos - 8);
 		}
 		
 		public override float ReadSingle()
 		{
 			NeedInput(4);
             pos += 4;
-            return Util.BitConverter.ToSingle(buf, pos - 4);
+            return GetSingle(pos - 4);
 		}
 		
 		public override double ReadDouble()
         {
             NeedInput(8);
             pos += 8;
-            return Util.BitConverter.ToDouble(buf, pos - 8);
+            return System.BitConverter.Int64BitsToDouble(GetInt64(pos - 8));
+		}
+		
+		/// <summary>
+        /// Read count values into an array, starting at offset.
+        /// </summary>
+		public void ReadArray(byte[] b, int offset, int count)
+		{
+			ReadFully(b, offset, count);
+		}
+		
+		public void ReadArray(bool[] v, int offset, int count)
+		{
+			NeedInput(count);
+			for (int i = 0; i < count; i++)
+				v[offset + i] = buf[pos++] != 0;
+		}
+		
+		public void ReadArray(short[] v, int offset, int count)
+		{
+			NeedInput(2 * count);
+			for (int i = 0; i < count; i++, pos += 2)
+				v[offset + i] = GetInt16(pos);
+		}
+		
+		public void ReadArray(int[] v, int offset, int count)
+		{
+			NeedInput(4 * count);
+			for (int i = 0; i < count; i++, pos += 4)
+				v[offset + i] = GetInt32(pos);
+		}
+		
+		public void ReadArray(long[] v, int offset, int count)
+		{
+			NeedInput(8 * count);
+			for (int i = 0; i < count; i++, pos += 8)
+				v[offset + i] = GetInt64(pos);
+		}
+		
+		public void ReadArray(float[] v, int offset, int count)
+		{
+			NeedInput(4 * count);
+			for (int i = 0; i < count; i++, pos += 4)
+				v[offset + i] = GetSingle(pos);
+		}
+		
+		public void ReadArray(double[] v, int offset, int count)
+		{
+			NeedInput(8 * count);
+			for (int i = 0; i < count; i++, pos += 8)
+				v[offset + i] = System.BitConverter.Int64BitsToDouble(GetInt64(pos));
+		}
+		
+		/// <summary>
+        /// Read an LCM string: a length including the terminating zero,
+		/// followed by ASCII characters and the zero. The characters are
+		/// decoded in place, without an intermediate byte array.
+        /// </summary>
+		public string ReadLCMString()
+		{
+			int len = ReadInt32();
+			if (len <= 0)
+			{
+				throw new System.IO.IOException("LCM Decode error: invalid string length " + len);
+			}
+			NeedInput(len);
+			string s = System.Text.Encoding.ASCII.GetString(buf, pos, len - 1);
+			pos += len;
+			return s;
 		}
 		
 		public void ReadFully(byte[] b)
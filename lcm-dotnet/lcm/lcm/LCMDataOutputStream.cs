@@ -128,32 +128,138 @@ namespace LCM.LCM
 			buf[pos++] = 0;
 		}
 		
+		/// <summary>
+        /// Write a zero-terminated string, encoded as ASCII directly into
+		/// the buffer.
+        /// </summary>
+        /// <returns>the number of bytes written, without the zero</returns>
+		public int WriteASCIIZ(string s)
+		{
+			int n = System.Text.Encoding.ASCII.GetByteCount(s);
+			EnsureSpace(n + 1);
+			pos += System.Text.Encoding.ASCII.GetBytes(s, 0, s.Length, buf, pos);
+			buf[pos++] = 0;
+			return n;
+		}
+		
+		/// <summary>
+        /// Write an LCM string: a length including the terminating zero,
+		/// followed by ASCII characters and the zero.
+        /// </summary>
+		public void WriteLCMString(string s)
+		{
+			Write(System.Text.Encoding.ASCII.GetByteCount(s) + 1);
+			WriteASCIIZ(s);
+		}
+		
+		// big-endian conversions straight into buf, which don't allocate
+		private void PutInt16(short v)
+		{
+			buf[pos++] = (byte) (v >> 8);
+			buf[pos++] = (byte) v;
+		}
+		
+		private void PutInt32(int v)
+		{
+			buf[pos++] = (byte) (v >> 24);
+			buf[pos++] = (byte) (v >> 16);
+			buf[pos++] = (byte) (v >> 8);
+			buf[pos++] = (byte) v;
+		}
+		
+		private void PutInt64(long v)
+		{
+			PutInt32((int) (v >> 32));
+			PutInt32((int) v);
+		}
+		
+		private void PutSingle(float v)
+		{
+			FloatBits bits = new FloatBits();
+			bits.f = v;
+			PutInt32(bits.i);
+		}
+		
 		public override void Write(double v)
 		{
-			Write(Util.BitConverter.GetBytes(v));
+			EnsureSpace(8);
+			PutInt64(System.BitConverter.DoubleToInt64Bits(v));
 		}
 		
 		public override void Write(float v)
         {
-            Write(Util.BitConverter.GetBytes(v));
+			EnsureSpace(4);
+			PutSingle(v);
 		}
 		
 		public override void Write(int v)
 		{
             EnsureSpace(4);
-            Write(Util.BitConverter.GetBytes(v));
+			PutInt32(v);
 		}
 		
 		public override void Write(long v)
 		{
             EnsureSpace(8);
-            Write(Util.BitConverter.GetBytes(v));
+			PutInt64(v);
 		}
 		
 		public override void Write(short v)
 		{
             EnsureSpace(2);
-            Write(Util.BitConverter.GetBytes(v));
+			PutInt16(v);
+		}
+		
+		/// <summary>
+        /// Write count values of an array, starting at offset.
+        /// </summary>
+		public void WriteArray(byte[] v, int offset, int count)
+		{
+			// like the other overloads, an empty array may be null
+			if (count > 0)
+				Write(v, offset, count);
+		}
+		
+		public void WriteArray(bool[] v, int offset, int count)
+		{
+			EnsureSpace(count);
+			for (int i = 0; i < count; i++)
+				buf[pos++] = v[offset + i] ? (byte) 1 : (byte) 0;
+		}
+		
+		public void WriteArray(short[] v, int offset, int count)
+		{
+			EnsureSpace(2 * count);
+			for (int i = 0; i < count; i++)
+				PutInt16(v[offset + i]);
+		}
+		
+		public void WriteArray(int[] v, int offset, int count)
+		{
+			EnsureSpace(4 * count);
+			for (int i = 0; i < count; i++)
+				PutInt32(v[offset + i]);
+		}
+		
+		public void WriteArray(long[] v, int offset, int count)
+		{
+			EnsureSpace(8 * count);
+			for (int i = 0; i < count; i++)
+				PutInt64(v[offset + i]);
+		}
+		
+		public void WriteArray(float[] v, int offset, int count)
+		{
+			EnsureSpace(4 * count);
+			for (int i = 0; i < count; i++)
+				PutSingle(v[offset + i]);
+		}
+		
+		public void WriteArray(double[] v, int offset, int count)
+		{
+			EnsureSpace(8 * count);
+			for (int i = 0; i < count; i++)
+				PutInt64(System.BitConverter.DoubleToInt64Bits(v[offset + i]));
 		}
 		
 		public void WriteUTF(string s)
@@ -12,6 +12,11 @@ namespace LCM.LCM
 	/// pre-arranged UDP multicast address. Subscription operations are a
 	/// no-op, since all messages are always broadcast.
 	/// 
+	/// Datagrams are received asynchronously into a single reused buffer
+	/// and passed to LCM without copying, and fragmented messages are
+	/// reassembled directly into pooled buffers, so that receiving allocates
+	/// little memory.
+	/// 
 	/// This mechanism is very simple, low-latency, and efficient due to
 	/// not having to transmit messages more than once when there are
 	/// multiple subscribers. Since it uses UDP, it is lossy.
@@ -28,12 +33,36 @@ namespace LCM.LCM
         private const int MAGIC_LONG = 0x4c433033; // ascii of "LC03"
         private const int FRAGMENTATION_THRESHOLD = 64000;
 
-        private Thread reader;
-        private volatile bool readerDone = false;
+        private const int MAX_POOLED_BUFFERS = 4;
+        private const int CHANNEL_CACHE_SIZE = 256;
+
+        // where the sender's address of each datagram is received
+        private static readonly IPEndPoint anyEndPoint = new IPEndPoint(IPAddress.Any, 0);
+
+        // the pending receive, or null before the first subscription.  Only
+        // one receive is outstanding at a time, so the datagrams are
+        // handled one after another, in order.
+        private SocketAsyncEventArgs receiveArgs;
+        private Socket receiveSocket;
+        private volatile bool receiveDone = false;
+        private ManualResetEvent receiveStopped = new ManualResetEvent(true);
+
+        // the receive buffer, which is reused for every datagram
+        private byte[] buf = new byte[65536];
+
+        // reassembly buffers of completed or dropped messages, for reuse
+        private List<byte[]> freeBuffers = new List<byte[]>();
+
+        // the channel names of recent datagrams, so that they are not
+        // decoded into a new string each time
+        private string[] channelCache = new string[CHANNEL_CACHE_SIZE];
 
         private int msgSeqNumber = 0;
 
-        private Dictionary<SocketAddress, FragmentBuffer> fragBufs = new Dictionary<SocketAddress, FragmentBuffer>();
+        // reused for every datagram that is sent, guarded by lock (this)
+        private LCMDataOutputStream sendBuffer = new LCMDataOutputStream(10 + FRAGMENTATION_THRESHOLD);
+
+        private Dictionary<IPEndPoint, FragmentBuffer> fragBufs = new Dictionary<IPEndPoint, FragmentBuffer>();
 
         private LCM lcm;
 
@@ -122,11 +151,18 @@ namespace LCM.LCM
 		{
 			lock (this)
 			{
-				if (reader == null)
+				if (receiveArgs == null)
 				{
-					reader = new Thread(ReaderThreadRun);
-                    reader.IsBackground = true;
-					reader.Start();
+                    SocketAsyncEventArgs args = new SocketAsyncEventArgs();
+                    args.SetBuffer(buf, 0, buf.Length);
+                    args.Completed += ReceiveCompleted;
+                    receiveArgs = args;
+                    receiveSocket = sock.Client;
+                    receiveStopped.Reset();
+
+                    // the first receive may complete at once, and is not
+                    // handled on the subscribing thread
+                    ThreadPool.QueueUserWorkItem(delegate { ReceiveNext(args); });
 				}
 			}
 		}
@@ -146,21 +182,15 @@ namespace LCM.LCM
 		{
 			lock (this)
 			{
-				if (reader != null)
+				if (receiveArgs != null)
 				{
-					reader.Interrupt();
-					readerDone = true;
-					sock.Close(); // close early to interrupt the blocking call: sock.Receive
-					try
-					{
-						reader.Join();
-					}
-					catch (System.Threading.ThreadInterruptedException)
-					{
-					}
+					receiveDone = true;
+					sock.Close(); // close early to abort the pending receive
+					receiveStopped.WaitOne();
+					receiveArgs.Dispose();
 				}
 
-				reader = null;
+				receiveArgs = null;
 				sock.Close();
 				sock = null;
 				fragBufs = null;
@@ -169,19 +199,19 @@ namespace LCM.LCM
 		
 		private void PublishEx(string channel, byte[] data, int offset, int length)
 		{
-			byte[] channelBytes = System.Text.Encoding.GetEncoding("US-ASCII").GetBytes(channel);
+			int channelLength = System.Text.Encoding.ASCII.GetByteCount(channel);
 			
-			int payloadSize = channelBytes.Length + length;
+			int payloadSize = channelLength + length;
+			LCMDataOutputStream outs = sendBuffer;
 			
 			if (payloadSize <= FRAGMENTATION_THRESHOLD)
 			{
-				LCMDataOutputStream outs = new LCMDataOutputStream(length + channel.Length + 32);
+				outs.Reset();
 				
 				outs.Write(MAGIC_SHORT);
 				outs.Write(this.msgSeqNumber);
 
-                outs.Write(channelBytes, 0, channelBytes.Length);
-                outs.Write((byte) 0);
+                outs.WriteASCIIZ(channel);
 				
 				outs.Write(data, offset, length);
 
@@ -200,7 +230,7 @@ namespace LCM.LCM
 				}
 
                 // first fragment is special.  insert channel before data
-                LCMDataOutputStream outs = new LCMDataOutputStream(10 + FRAGMENTATION_THRESHOLD);
+                outs.Reset();
 				
 				int fragmentOffset = 0;
 				int fragNo = 0;
@@ -211,10 +241,9 @@ namespace LCM.LCM
 				outs.Write(fragmentOffset);
 				outs.Write((short) fragNo);
 				outs.Write((short) nfragments);
-				outs.Write(channelBytes, 0, channelBytes.Length);
-				outs.Write((byte) 0);
+				outs.WriteASCIIZ(channel);
 
-				int firstfragDatasize = FRAGMENTATION_THRESHOLD - (channelBytes.Length + 1);
+				int firstfragDatasize = FRAGMENTATION_THRESHOLD - (channelLength + 1);
 				
 				outs.Write(data, offset, firstfragDatasize);
 
@@ -224,7 +253,7 @@ namespace LCM.LCM
 				
 				for (fragNo = 1; fragNo < nfragments; fragNo++)
 				{
-                    outs = new LCMDataOutputStream(10 + FRAGMENTATION_THRESHOLD);
+                    outs.Reset();
 					
 					outs.Write(MAGIC_LONG);
 					outs.Write(this.msgSeqNumber);
@@ -246,108 +275,225 @@ namespace LCM.LCM
 		
 		private class FragmentBuffer
 		{
-			internal SocketAddress from = null;
+			internal IPEndPoint from = null;
 			internal string channel = null;
 			internal int msgSeqNumber = 0;
 			internal int data_size = 0;
 			internal int fragments_remaining = 0;
 			internal byte[] data = null;
 			
-			public FragmentBuffer(SocketAddress from, string channel, int msgSeqNumber, int data_size, int fragments_remaining)
+			public FragmentBuffer(IPEndPoint from, string channel, int msgSeqNumber, int data_size, int fragments_remaining, byte[] data)
 			{
 				this.from = from;
 				this.channel = channel;
 				this.msgSeqNumber = msgSeqNumber;
 				this.data_size = data_size;
 				this.fragments_remaining = fragments_remaining;
-				this.data = new byte[data_size];
-			}
-		}
-		
-		private void ReaderThreadRun()
-		{
-			byte[] packetData;
-            IPEndPoint from = new IPEndPoint(IPAddress.Any, 0);
-			
-			readerDone = false;
-			while (!readerDone)
-			{
-				try
-				{
-					packetData = sock.Receive(ref from);
-					HandlePacket(packetData, from);
-				}
-				catch(SocketException ex)
-				{
-					if (readerDone) break; // finish if readerDone is true
-					Console.Error.WriteLine("Ex: " + ex);
-					continue;
-				}
-				catch (Exception ex)
-				{
-					Console.Error.WriteLine("Ex: " + ex);
-					if (readerDone) break;
-					continue;
-				}
+				this.data = data;
 			}
 		}
 
-        private void HandleShortMessage(byte[] packetData, IPEndPoint from, LCMDataInputStream ins)
+        /// <summary>
+        /// Receives and handles datagrams until a receive is pending or the
+        /// provider is closed.  Receives that complete synchronously are
+        /// handled in this loop rather than by recursing.
+        /// </summary>
+        private void ReceiveNext(SocketAsyncEventArgs e)
+        {
+            try
+            {
+                while (!receiveDone)
+                {
+                    e.RemoteEndPoint = anyEndPoint;
+                    if (receiveSocket.ReceiveFromAsync(e))
+                        return; // ReceiveCompleted is called when it is done
+                    if (!HandleReceive(e))
+                        break;
+                }
+            }
+            catch (ObjectDisposedException)
+            {
+                // the socket was closed
+            }
+            receiveStopped.Set();
+        }
+
+        private void ReceiveCompleted(object sender, SocketAsyncEventArgs e)
+        {
+            if (!HandleReceive(e))
+            {
+                receiveStopped.Set();
+                return;
+            }
+            ReceiveNext(e);
+        }
+
+        /// <summary>
+        /// Handles the datagram of a completed receive.  Returns false once
+        /// the provider is closing.
+        /// </summary>
+        private bool HandleReceive(SocketAsyncEventArgs e)
+        {
+            if (receiveDone)
+                return false;
+            if (e.SocketError != SocketError.Success)
+            {
+                Console.Error.WriteLine("LC: receive failed: " + e.SocketError);
+                return true;
+            }
+            try
+            {
+                HandlePacket(e.BytesTransferred, (IPEndPoint) e.RemoteEndPoint);
+            }
+            catch (Exception ex)
+            {
+                Console.Error.WriteLine("Ex: " + ex);
+            }
+            return true;
+        }
+
+        private byte[] AllocBuffer(int size)
+        {
+            for (int i = 0; i < freeBuffers.Count; i++)
+            {
+                byte[] b = freeBuffers[i];
+                if (b.Length >= size)
+                {
+                    freeBuffers.RemoveAt(i);
+                    return b;
+                }
+            }
+            return new byte[size];
+        }
+
+        private void ReleaseBuffer(FragmentBuffer fbuf)
+        {
+            fragBufs.Remove(fbuf.from);
+            if (freeBuffers.Count >= MAX_POOLED_BUFFERS)
+            {
+                // keep the largest buffers
+                int smallest = 0;
+                for (int i = 1; i < freeBuffers.Count; i++)
+                {
+                    if (freeBuffers[i].Length < freeBuffers[smallest].Length)
+                        smallest = i;
+                }
+                if (freeBuffers[smallest].Length >= fbuf.data.Length)
+                    return;
+                freeBuffers.RemoveAt(smallest);
+            }
+            freeBuffers.Add(fbuf.data);
+        }
+
+        private static int ReadInt32(byte[] b, int offset)
+        {
+            return (b[offset] << 24) | (b[offset + 1] << 16) | (b[offset + 2] << 8) | b[offset + 3];
+        }
+
+        private static int ReadUInt16(byte[] b, int offset)
+        {
+            return (b[offset] << 8) | b[offset + 1];
+        }
+
+        /// <summary>
+        /// Returns the channel name of len bytes at offset in buf.
+        /// </summary>
+        private string ChannelName(int offset, int len)
+        {
+            int hash = len;
+            for (int i = 0; i < len; i++)
+                hash = 31 * hash + buf[offset + i];
+            int slot = hash & (CHANNEL_CACHE_SIZE - 1);
+
+            string cached = channelCache[slot];
+            if (cached != null && cached.Length == len)
+            {
+                int i = 0;
+                while (i < len && cached[i] == (char) buf[offset + i])
+                    i++;
+                if (i == len)
+                    return cached;
+            }
+            string channel = System.Text.Encoding.ASCII.GetString(buf, offset, len);
+            channelCache[slot] = channel;
+            return channel;
+        }
+
+        /// <summary>
+        /// Returns the length of the zero terminated string at offset, or -1
+        /// if it isn't terminated before end.
+        /// </summary>
+        private int StringLength(int offset, int end)
+        {
+            for (int i = offset; i < end; i++)
+            {
+                if (buf[i] == 0)
+                    return i - offset;
+            }
+            return -1;
+        }
+
+        private void HandleShortMessage(int end)
 		{
-			int msgSeqNumber = ins.ReadInt32();
-			string channel = ins.ReadStringZ();
-			
-			lcm.ReceiveMessage(channel, ins.Buffer, ins.BufferOffset, ins.Available);
+            int channelLen = StringLength(8, end);
+            if (channelLen < 0)
+            {
+                Console.Error.WriteLine("LC: dropping message without a channel");
+                return;
+            }
+            string channel = ChannelName(8, channelLen);
+            int dataStart = 8 + channelLen + 1;
+
+			lcm.ReceiveMessage(channel, buf, dataStart, end - dataStart);
 		}
 
-        private void HandleFragment(byte[] packetData, IPEndPoint from, LCMDataInputStream ins)
+        private void HandleFragment(int end, IPEndPoint from)
 		{
-			int msgSeqNumber = ins.ReadInt32();
-			int msgSize = ins.ReadInt32() & unchecked((int) 0xffffffff);
-			int fragmentOffset = ins.ReadInt32() & unchecked((int) 0xffffffff);
-			int fragmentId = ins.ReadInt16() & 0xffff;
-			int fragmentsInMsg = ins.ReadInt16() & 0xffff;
-			
-			// read entire packet payload
-			byte[] payload = new byte[ins.Available];
-			ins.ReadFully(payload);
-			
-			if (ins.Available > 0)
-			{
-				System.Console.Error.WriteLine("Unread data! " + ins.Available);
-			}
-			
-			int dataStart = 0;
-			int fragSize = payload.Length;
+            if (end < 20)
+            {
+                Console.Error.WriteLine("LC: dropping truncated fragment");
+                return;
+            }
+			int msgSeqNumber = ReadInt32(buf, 4);
+			int msgSize = ReadInt32(buf, 8);
+			int fragmentOffset = ReadInt32(buf, 12);
+			int fragmentId = ReadUInt16(buf, 16);
+			int fragmentsInMsg = ReadUInt16(buf, 18);
+
+            // the payload is copied from the receive buffer straight into
+            // the reassembly buffer
+			int dataStart = 20;
+			int fragSize = end - dataStart;
 			
 			FragmentBuffer fbuf;
-            fragBufs.TryGetValue(from.Serialize(), out fbuf);
+            fragBufs.TryGetValue(from, out fbuf);
 			
 			if (fbuf != null && ((fbuf.msgSeqNumber != msgSeqNumber) || (fbuf.data_size != msgSize)))
 			{
-                fragBufs.Remove(fbuf.from);
+                ReleaseBuffer(fbuf);
 				fbuf = null;
 			}
 			
 			if (fbuf == null && fragmentId == 0)
 			{	
-				// extract channel name
-				int channelLen = 0;
-				for (; channelLen < payload.Length; channelLen++)
-				{
-					if (payload[channelLen] == 0)
-					{
-						break;
-					}
-				}
+                if (msgSize < 0 || fragmentsInMsg == 0)
+                {
+                    Console.Error.WriteLine("LC: dropping invalid fragment");
+                    return;
+                }
 
-				dataStart = channelLen + 1;
-				fragSize -= (channelLen + 1);
-				string tempStr;
-				tempStr = System.Text.Encoding.GetEncoding("US-ASCII").GetString(payload);
-				string channel = new string(tempStr.ToCharArray(), 0, channelLen);
+				// extract channel name
+                int channelLen = StringLength(dataStart, end);
+                if (channelLen < 0)
+                {
+                    Console.Error.WriteLine("LC: dropping invalid fragment");
+                    return;
+                }
+                string channel = ChannelName(dataStart, channelLen);
+				dataStart += channelLen + 1;
+				fragSize -= channelLen + 1;
 
-                fbuf = new FragmentBuffer(from.Serialize(), channel, msgSeqNumber, msgSize, fragmentsInMsg);
+                fbuf = new FragmentBuffer(from, channel, msgSeqNumber, msgSize, fragmentsInMsg, AllocBuffer(msgSize));
 
                 fragBufs.Add(fbuf.from, fbuf);
 			}
@@ -358,35 +504,39 @@ namespace LCM.LCM
 				return ;
 			}
 			
-			if (fragmentOffset + fragSize > fbuf.data_size)
+			if (fragmentOffset < 0 || fragmentOffset + fragSize > fbuf.data_size)
 			{
 				System.Console.Error.WriteLine("LC: dropping invalid fragment");
-                fragBufs.Remove(fbuf.from);
+                ReleaseBuffer(fbuf);
 				return ;
 			}
 			
-			Array.Copy(payload, dataStart, fbuf.data, fragmentOffset, fragSize);
+			Array.Copy(buf, dataStart, fbuf.data, fragmentOffset, fragSize);
 			fbuf.fragments_remaining--;
 			
 			if (0 == fbuf.fragments_remaining)
 			{
 				lcm.ReceiveMessage(fbuf.channel, fbuf.data, 0, fbuf.data_size);
-                fragBufs.Remove(fbuf.from);
+                ReleaseBuffer(fbuf);
 			}
 		}
 
-        private void HandlePacket(byte[] packetData, IPEndPoint from)
+        private void HandlePacket(int length, IPEndPoint from)
 		{
-			LCMDataInputStream ins = new LCMDataInputStream(packetData, 0, packetData.Length);
-			
-			int magic = ins.ReadInt32();
+            if (length < 8)
+            {
+                Console.Error.WriteLine("LC: dropping truncated datagram");
+                return;
+            }
+
+			int magic = ReadInt32(buf, 0);
             if (magic == UDPMulticastProvider.MAGIC_SHORT)
 			{
-				HandleShortMessage(packetData, from, ins);
+				HandleShortMessage(length);
 			}
             else if (magic == UDPMulticastProvider.MAGIC_LONG)
 			{
-				HandleFragment(packetData, from, ins);
+				HandleFragment(length, from);
 			}
 			else
 			{
@@ -0,0 +1,261 @@
+package lcm.lcm;
+
+import java.io.*;
+import java.util.*;
+import java.util.concurrent.atomic.*;
+
+/**
+ * Accumulates received LCM messages in a bounded, lock-free queue.
+ * <p>
+ * This works like {@link MessageAggregator}, but the queue is a fixed-size
+ * array that the LCM thread and the threads retrieving messages update
+ * without taking a lock, so they don't contend on a monitor for every
+ * message.  A lock is only taken to wake up threads that wait for a message
+ * while the queue is empty.
+ * <p>
+ * The queue is limited by a number of messages, and what happens to a
+ * message that arrives while the queue is full is set by an
+ * {@link OverflowPolicy}.
+ */
+public class ConcurrentMessageAggregator
+    implements LCMSubscriber
+{
+    /**
+     * What to do with a message that arrives while the queue is full.
+     */
+    public enum OverflowPolicy {
+        /** Discard the oldest queued message to make room. */
+        DROP_OLDEST,
+        /** Discard the message that arrived. */
+        DROP_NEWEST
+    }
+
+    final OverflowPolicy policy;
+    final int mask;
+
+    // Each slot has a sequence number that tells whether it is ready to be
+    // written or read at a given position of the queue.
+    final AtomicReferenceArray<MessageAggregator.Message> slots;
+    final AtomicLongArray sequences;
+    final AtomicLong enqueuePos = new AtomicLong();
+    final AtomicLong dequeuePos = new AtomicLong();
+
+    final AtomicLong numDropped = new AtomicLong();
+    final AtomicInteger numWaiters = new AtomicInteger();
+    final Object waitLock = new Object();
+
+    /**
+     * Creates an aggregator that queues up to 1024 messages, and discards
+     * the oldest ones when it is full, like {@link MessageAggregator}.
+     */
+    public ConcurrentMessageAggregator()
+    {
+        this(1024, OverflowPolicy.DROP_OLDEST);
+    }
+
+    /**
+     * @param capacity the largest number of messages queued, which is
+     * rounded up to a power of two.
+     * @param policy what to do with messages that arrive while the queue is
+     * full.
+     */
+    public ConcurrentMessageAggregator(int capacity, OverflowPolicy policy)
+    {
+        if (capacity <= 0 || capacity > (1 << 30))
+            throw new IllegalArgumentException("Invalid capacity "+capacity);
+
+        int size = 1;
+        while (size < capacity)
+            size <<= 1;
+
+        this.policy = policy;
+        mask = size - 1;
+        slots = new AtomicReferenceArray<MessageAggregator.Message>(size);
+        sequences = new AtomicLongArray(size);
+        for (int i = 0; i < size; i++)
+            sequences.set(i, i);
+    }
+
+    boolean offer(MessageAggregator.Message m)
+    {
+        long pos = enqueuePos.get();
+        while (true) {
+            int idx = (int) (pos & mask);
+            long dif = sequences.get(idx) - pos;
+            if (dif == 0) {
+                if (enqueuePos.compareAndSet(pos, pos + 1)) {
+                    slots.set(idx, m);
+                    sequences.set(idx, pos + 1);
+                    return true;
+                }
+                pos = enqueuePos.get();
+            } else if (dif < 0) {
+                // the slot still holds the message of the previous lap
+                return false;
+            } else {
+                pos = enqueuePos.get();
+            }
+        }
+    }
+
+    MessageAggregator.Message poll()
+    {
+        long pos = dequeuePos.get();
+        while (true) {
+            int idx = (int) (pos & mask);
+            long dif = sequences.get(idx) - (pos + 1);
+            if (dif == 0) {
+                if (dequeuePos.compareAndSet(pos, pos + 1)) {
+                    MessageAggregator.Message m = slots.get(idx);
+                    slots.set(idx, null);
+                    sequences.set(idx, pos + mask + 1);
+                    return m;
+                }
+                pos = dequeuePos.get();
+            } else if (dif < 0) {
+                // nothing was written to the slot yet
+                return null;
+            } else {
+                pos = dequeuePos.get();
+            }
+        }
+    }
+
+    /**
+     * Internal method, called by LCM when a message is received.
+     */
+    public void messageReceived(LCM lcm, String channel, LCMDataInputStream dins)
+    {
+        MessageAggregator.Message m;
+        try {
+            byte data[] = new byte[dins.available()];
+            dins.readFully(data);
+            m = new MessageAggregator.Message(channel, data);
+        } catch (IOException xcp) {
+            return;
+        }
+
+        while (!offer(m)) {
+            if (policy == OverflowPolicy.DROP_NEWEST) {
+                numDropped.incrementAndGet();
+                return;
+            }
+            if (poll() != null)
+                numDropped.incrementAndGet();
+        }
+
+        // Waiters register before they look at the queue, so either they
+        // see this message or this sees them.
+        if (numWaiters.get() > 0) {
+            synchronized(waitLock) {
+                waitLock.notifyAll();
+            }
+        }
+    }
+
+    /**
+     * Attempt to retrieve the next received LCM message.
+     * @param timeout_ms Max # of milliseconds to wait for a message.  If 0,
+     * then don't wait.  If less than 0, then wait indefinitely.
+     * @return a Message, or null if no message was received.
+     */
+    public MessageAggregator.Message getNextMessage(long timeout_ms)
+    {
+        MessageAggregator.Message m = poll();
+        if (m != null || timeout_ms == 0)
+            return m;
+
+        long deadline = System.currentTimeMillis() + timeout_ms;
+        synchronized(waitLock) {
+            numWaiters.incrementAndGet();
+            try {
+                while ((m = poll()) == null) {
+                    if (timeout_ms < 0) {
+                        waitLock.wait();
+                    } else {
+                        long remaining = deadline - System.currentTimeMillis();
+                        if (remaining <= 0)
+                            break;
+                        waitLock.wait(remaining);
+                    }
+                }
+            } catch (InterruptedException xcp) {
+            } finally {
+                numWaiters.decrementAndGet();
+            }
+        }
+        return m;
+    }
+
+    /**
+     * Retrieves the next message, waiting if necessary.
+     */
+    public MessageAggregator.Message getNextMessage()
+    {
+        return getNextMessage(-1);
+    }
+
+    /**
+     * Retrieves the queued messages at once.
+     *
+     * @param out the collection that the messages are added to, oldest
+     * first.
+     * @param maxMessages the largest number of messages to retrieve.
+     * @param timeout_ms Max # of milliseconds to wait for the first
+     * message.  If 0, then don't wait.  If less than 0, then wait
+     * indefinitely.
+     * @return the number of messages added to out.
+     */
+    public int drainMessages(Collection<? super MessageAggregator.Message> out,
+                             int maxMessages, long timeout_ms)
+    {
+        if (maxMessages <= 0)
+            return 0;
+
+        MessageAggregator.Message m = getNextMessage(timeout_ms);
+        int n = 0;
+        while (m != null) {
+            out.add(m);
+            if (++n == maxMessages)
+                break;
+            m = poll();
+        }
+        return n;
+    }
+
+    /**
+     * Retrieves the queued messages at once, without waiting.
+     *
+     * @return the number of messages added to out.
+     */
+    public int drainMessages(Collection<? super MessageAggregator.Message> out,
+                             int maxMessages)
+    {
+        return drainMessages(out, maxMessages, 0);
+    }
+
+    /**
+     * Returns the number of received messages waiting to be retrieved.
+     */
+    public int numMessagesAvailable()
+    {
+        long n = enqueuePos.get() - dequeuePos.get();
+        return (int) Math.max(0, Math.min(n, mask + 1));
+    }
+
+    /**
+     * Returns the largest number of messages queued.
+     */
+    public int getCapacity()
+    {
+        return mask + 1;
+    }
+
+    /**
+     * Returns the number of messages discarded because the queue was full.
+     */
+    public long getNumDropped()
+    {
+        return numDropped.get();
+    }
+}
@@ -16,6 +16,7 @@ public class LCM
         String  regex;
         Pattern pat;
         LCMSubscriber lcsub;
+        LCMBufferSubscriber bufsub;
     }
 
     ArrayList<SubscriptionRecord> subscriptions = new ArrayList<SubscriptionRecord>();
@@ -149,10 +150,28 @@ public class LCM
         srec.regex = regex;
         srec.pat = Pattern.compile(regex);
         srec.lcsub = sub;
+        addSubscription(srec);
+    }
 
+    /** Subscribe to all channels whose name matches the regular
+     * expression, receiving the contents of each message as a ByteBuffer
+     * that is not copied out of the provider's receive buffer.
+     **/
+    public void subscribeBuffer(String regex, LCMBufferSubscriber sub)
+    {
+        if (this.closed) throw new IllegalStateException();
+        SubscriptionRecord srec = new SubscriptionRecord();
+        srec.regex = regex;
+        srec.pat = Pattern.compile(regex);
+        srec.bufsub = sub;
+        addSubscription(srec);
+    }
+
+    void addSubscription(SubscriptionRecord srec)
+    {
         synchronized(this) {
             for (Provider p : providers)
-                p.subscribe (regex);
+                p.subscribe (srec.regex);
         }
 
         synchronized(subscriptions) {
@@ -175,6 +194,17 @@ public class LCM
      * cancelled.
      **/
     public void unsubscribe(String regex, LCMSubscriber sub) {
+        removeSubscriptions(regex, sub);
+    }
+
+    /** Remove a regex/subscriber pair made with subscribeBuffer(), with
+     * the same meaning of null arguments as unsubscribe().
+     **/
+    public void unsubscribeBuffer(String regex, LCMBufferSubscriber sub) {
+        removeSubscriptions(regex, sub);
+    }
+
+    void removeSubscriptions(String regex, Object sub) {
         if (this.closed) throw new IllegalStateException();
 
         synchronized(this) {
@@ -190,7 +220,7 @@ public class LCM
             for (Iterator<SubscriptionRecord> it = subscriptions.iterator(); it.hasNext(); ) {
                 SubscriptionRecord sr = it.next();
 
-                if ((sub == null || sr.lcsub == sub) &&
+                if ((sub == null || sr.lcsub == sub || sr.bufsub == sub) &&
                     (regex == null || sr.regex.equals(regex))) {
                     it.remove();
                 }
@@ -201,7 +231,7 @@ public class LCM
                 for (Iterator<SubscriptionRecord> it = subscriptionsMap.get(channel).iterator(); it.hasNext(); ) {
                     SubscriptionRecord sr = it.next();
 
-                    if ((sub == null || sr.lcsub == sub) &&
+                    if ((sub == null || sr.lcsub == sub || sr.bufsub == sub) &&
                         (regex == null || sr.regex.equals(regex))) {
                         it.remove();
                     }
@@ -232,6 +262,11 @@ public class LCM
             }
 
             for (SubscriptionRecord srec : srecs) {
+                if (srec.bufsub != null) {
+                    srec.bufsub.messageReceived(this, channel,
+                                                ByteBuffer.wrap(data, offset, length).slice());
+                    continue;
+                }
                 srec.lcsub.messageReceived(this,
                                            channel,
                                            new LCMDataInputStream(data, offset, length));
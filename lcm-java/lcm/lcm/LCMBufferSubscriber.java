@@ -0,0 +1,22 @@
+package lcm.lcm;
+
+import java.nio.*;
+
+/** A class which listens for messages on a particular channel, and receives
+ * their contents as a ByteBuffer instead of a stream.
+ **/
+public interface LCMBufferSubscriber
+{
+    /**
+     * Invoked by LCM when a message is received.
+     *
+     * This method is invoked from the LCM thread.  The buffer is a slice of
+     * the provider's receive buffer, which is reused once this method
+     * returns, so copy any data that must be kept.
+     *
+     * @param lcm the LCM instance that received the message.
+     * @param channel the channel on which the message was received.
+     * @param data the message contents, from position 0 to the limit.
+     */
+    public void messageReceived(LCM lcm, String channel, ByteBuffer data);
+}
@@ -1,6 +1,8 @@
 package lcm.lcm;
 
 import java.io.*;
+import java.nio.ByteBuffer;
+import java.nio.charset.Charset;
 
 /** Will not throw EOF. **/
 public final class LCMDataInputStream implements DataInput
@@ -11,6 +13,8 @@ public final class LCMDataInputStream implements DataInput
     int startpos;  // index of first valid byte
     int endpos;    // index of byte after last valid byte
 
+    static final Charset UTF8 = Charset.forName("UTF-8");
+
     public LCMDataInputStream(byte buf[])
     {
         this.buf = buf;
@@ -31,6 +35,12 @@ public final class LCMDataInputStream implements DataInput
             throw new EOFException("LCMDataInputStream needed "+need+" bytes, only "+available()+" available.");
     }
 
+    void needElements(int n, int size) throws EOFException
+    {
+        if (n < 0 || n > available() / size)
+            throw new EOFException("LCMDataInputStream needed "+n+" elements of "+size+" bytes, only "+available()+" bytes available.");
+    }
+
     public int available()
     {
         return endpos - pos - 1;
@@ -140,6 +150,125 @@ public final class LCMDataInputStream implements DataInput
         return Double.longBitsToDouble(readLong());
     }
 
+    /** Reads n big-endian shorts into v[off] to v[off+n-1]. **/
+    public void readShorts(short v[], int off, int n) throws IOException
+    {
+        needElements(n, 2);
+        ByteBuffer.wrap(buf, pos, 2*n).asShortBuffer().get(v, off, n);
+        pos += 2*n;
+    }
+
+    /** Reads n shorts from ins, all at once if it is an LCMDataInputStream. **/
+    public static void readShorts(DataInput ins, short v[], int off, int n) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readShorts(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            v[off+i] = ins.readShort();
+    }
+
+    /** Reads n big-endian ints into v[off] to v[off+n-1]. **/
+    public void readInts(int v[], int off, int n) throws IOException
+    {
+        needElements(n, 4);
+        ByteBuffer.wrap(buf, pos, 4*n).asIntBuffer().get(v, off, n);
+        pos += 4*n;
+    }
+
+    /** Reads n ints from ins, all at once if it is an LCMDataInputStream. **/
+    public static void readInts(DataInput ins, int v[], int off, int n) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readInts(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            v[off+i] = ins.readInt();
+    }
+
+    /** Reads n big-endian longs into v[off] to v[off+n-1]. **/
+    public void readLongs(long v[], int off, int n) throws IOException
+    {
+        needElements(n, 8);
+        ByteBuffer.wrap(buf, pos, 8*n).asLongBuffer().get(v, off, n);
+        pos += 8*n;
+    }
+
+    /** Reads n longs from ins, all at once if it is an LCMDataInputStream. **/
+    public static void readLongs(DataInput ins, long v[], int off, int n) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readLongs(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            v[off+i] = ins.readLong();
+    }
+
+    /** Reads n big-endian floats into v[off] to v[off+n-1]. **/
+    public void readFloats(float v[], int off, int n) throws IOException
+    {
+        needElements(n, 4);
+        ByteBuffer.wrap(buf, pos, 4*n).asFloatBuffer().get(v, off, n);
+        pos += 4*n;
+    }
+
+    /** Reads n floats from ins, all at once if it is an LCMDataInputStream. **/
+    public static void readFloats(DataInput ins, float v[], int off, int n) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readFloats(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            v[off+i] = ins.readFloat();
+    }
+
+    /** Reads n big-endian doubles into v[off] to v[off+n-1]. **/
+    public void readDoubles(double v[], int off, int n) throws IOException
+    {
+        needElements(n, 8);
+        ByteBuffer.wrap(buf, pos, 8*n).asDoubleBuffer().get(v, off, n);
+        pos += 8*n;
+    }
+
+    /** Reads n doubles from ins, all at once if it is an LCMDataInputStream. **/
+    public static void readDoubles(DataInput ins, double v[], int off, int n) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream) {
+            ((LCMDataInputStream) ins).readDoubles(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            v[off+i] = ins.readDouble();
+    }
+
+    /** Reads a string as LCM encodes it: its length in bytes including a
+     * terminating zero, then its UTF-8 bytes and the zero. **/
+    public String readLCMString() throws IOException
+    {
+        int len = readInt() - 1;
+        if (len < 0)
+            throw new IOException("LCM Decode error: bad string length");
+        needElements(len + 1, 1);
+        String s = new String(buf, pos, len, UTF8);
+        pos += len + 1;
+        return s;
+    }
+
+    /** Reads an LCM string from ins. **/
+    public static String readLCMString(DataInput ins) throws IOException
+    {
+        if (ins instanceof LCMDataInputStream)
+            return ((LCMDataInputStream) ins).readLCMString();
+        byte b[] = new byte[ins.readInt() - 1];
+        ins.readFully(b);
+        ins.readByte();
+        return new String(b, UTF8);
+    }
+
     public String readLine() throws IOException
     {
         StringBuffer sb = new StringBuffer();
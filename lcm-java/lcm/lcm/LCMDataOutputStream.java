@@ -1,12 +1,16 @@
 package lcm.lcm;
 
 import java.io.*;
+import java.nio.ByteBuffer;
+import java.nio.charset.Charset;
 
 public final class LCMDataOutputStream implements DataOutput
 {
     byte buf[];
     int pos;
 
+    static final Charset UTF8 = Charset.forName("UTF-8");
+
     public LCMDataOutputStream()
     {
         this(512);
@@ -114,6 +118,125 @@ public final class LCMDataOutputStream implements DataOutput
         buf[pos++] = 0;
     }
 
+    /** Writes v[off] to v[off+n-1] as big-endian shorts. **/
+    public void writeShorts(short v[], int off, int n)
+    {
+        ensureSpace(2*n);
+        ByteBuffer.wrap(buf, pos, 2*n).asShortBuffer().put(v, off, n);
+        pos += 2*n;
+    }
+
+    /** Writes n shorts to outs, all at once if it is an LCMDataOutputStream. **/
+    public static void writeShorts(DataOutput outs, short v[], int off, int n) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeShorts(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            outs.writeShort(v[off+i]);
+    }
+
+    /** Writes v[off] to v[off+n-1] as big-endian ints. **/
+    public void writeInts(int v[], int off, int n)
+    {
+        ensureSpace(4*n);
+        ByteBuffer.wrap(buf, pos, 4*n).asIntBuffer().put(v, off, n);
+        pos += 4*n;
+    }
+
+    /** Writes n ints to outs, all at once if it is an LCMDataOutputStream. **/
+    public static void writeInts(DataOutput outs, int v[], int off, int n) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeInts(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            outs.writeInt(v[off+i]);
+    }
+
+    /** Writes v[off] to v[off+n-1] as big-endian longs. **/
+    public void writeLongs(long v[], int off, int n)
+    {
+        ensureSpace(8*n);
+        ByteBuffer.wrap(buf, pos, 8*n).asLongBuffer().put(v, off, n);
+        pos += 8*n;
+    }
+
+    /** Writes n longs to outs, all at once if it is an LCMDataOutputStream. **/
+    public static void writeLongs(DataOutput outs, long v[], int off, int n) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeLongs(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            outs.writeLong(v[off+i]);
+    }
+
+    /** Writes v[off] to v[off+n-1] as big-endian floats. **/
+    public void writeFloats(float v[], int off, int n)
+    {
+        ensureSpace(4*n);
+        ByteBuffer.wrap(buf, pos, 4*n).asFloatBuffer().put(v, off, n);
+        pos += 4*n;
+    }
+
+    /** Writes n floats to outs, all at once if it is an LCMDataOutputStream. **/
+    public static void writeFloats(DataOutput outs, float v[], int off, int n) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeFloats(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            outs.writeFloat(v[off+i]);
+    }
+
+    /** Writes v[off] to v[off+n-1] as big-endian doubles. **/
+    public void writeDoubles(double v[], int off, int n)
+    {
+        ensureSpace(8*n);
+        ByteBuffer.wrap(buf, pos, 8*n).asDoubleBuffer().put(v, off, n);
+        pos += 8*n;
+    }
+
+    /** Writes n doubles to outs, all at once if it is an LCMDataOutputStream. **/
+    public static void writeDoubles(DataOutput outs, double v[], int off, int n) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeDoubles(v, off, n);
+            return;
+        }
+        for (int i = 0; i < n; i++)
+            outs.writeDouble(v[off+i]);
+    }
+
+    /** Writes a string as LCM encodes it: its length in bytes including a
+     * terminating zero, then its UTF-8 bytes and the zero. **/
+    public void writeLCMString(String s)
+    {
+        byte b[] = s.getBytes(UTF8);
+        ensureSpace(b.length + 5);
+        writeInt(b.length + 1);
+        write(b, 0, b.length);
+        buf[pos++] = 0;
+    }
+
+    /** Writes an LCM string to outs. **/
+    public static void writeLCMString(DataOutput outs, String s) throws IOException
+    {
+        if (outs instanceof LCMDataOutputStream) {
+            ((LCMDataOutputStream) outs).writeLCMString(s);
+            return;
+        }
+        byte b[] = s.getBytes(UTF8);
+        outs.writeInt(b.length + 1);
+        outs.write(b, 0, b.length);
+        outs.writeByte(0);
+    }
+
     public void writeDouble(double v)
     {
         writeLong(Double.doubleToLongBits(v));
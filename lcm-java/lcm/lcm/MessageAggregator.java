@@ -14,6 +14,9 @@ import java.util.*;
  * <p>
  * The aggregator has configurable limits.  If too many messages are aggregated
  * without having been retrieved, then older messages are discarded.
+ * <p>
+ * Every message received and retrieved takes the lock of the aggregator.
+ * {@link ConcurrentMessageAggregator} avoids that for high message rates.
  */
 public class MessageAggregator
     implements LCMSubscriber
@@ -21,7 +24,7 @@ public class MessageAggregator
     /**
      * A received message.
      */
-    public class Message {
+    public static class Message {
         /**
          * The raw data bytes of the message body.
          */
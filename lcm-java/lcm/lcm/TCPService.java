@@ -3,215 +3,379 @@ package lcm.lcm;
 import java.net.*;
 import java.io.*;
 import java.util.*;
-import java.util.concurrent.locks.*;
 import java.util.regex.*;
 import java.nio.*;
+import java.nio.channels.*;
 
+/** Relay for the tcpq: provider.  Every client is served from a single
+ * thread with a Selector, and each client has a bounded queue of messages
+ * waiting to be written, so that a slow client can't stall the others.
+ * Messages that don't fit in the queue of a client are dropped for that
+ * client.
+ **/
 public class TCPService
 {
-    ServerSocket serverSocket;
+    public static final int DEFAULT_MAX_QUEUE_BYTES = 4*1024*1024;
 
-    AcceptThread acceptThread;
-    ArrayList<ClientThread> clients = new ArrayList<ClientThread>();
-    ReadWriteLock clients_lock = new ReentrantReadWriteLock();
+    static final int RECV_BUF_SIZE = 64*1024;
+    static final int MAX_WRITE_BUFFERS = 64;
+
+    ServerSocketChannel serverChannel;
+    Selector selector;
+    int maxQueueBytes;
+
+    ArrayList<Client> clients = new ArrayList<Client>();
+
+    // subscriptions of all clients, by regex, and the clients that each
+    // channel goes to, so that every regex is matched once per channel
+    // rather than once per client.
+    HashMap<String, Subscription> subscriptions = new HashMap<String, Subscription>();
+    HashMap<String, Client[]> channelClients = new HashMap<String, Client[]>();
 
     int bytesCount = 0;
+    long droppedCount = 0;
 
     public TCPService(int port) throws IOException
     {
-        serverSocket = new ServerSocket(port);
-        //	sock.setReuseAddress(true);
-        //	sock.setLoopbackMode(false); // true *disables* loopback
+        this(port, DEFAULT_MAX_QUEUE_BYTES);
+    }
 
-        acceptThread = new AcceptThread();
-        acceptThread.start();
+    /**
+     * Serves clients until the thread is interrupted.
+     *
+     * @param port the TCP port to listen on.
+     * @param maxQueueBytes the largest number of bytes queued for a client.
+     **/
+    public TCPService(int port, int maxQueueBytes) throws IOException
+    {
+        this.maxQueueBytes = maxQueueBytes;
+
+        selector = Selector.open();
+        serverChannel = ServerSocketChannel.open();
+        serverChannel.socket().bind(new InetSocketAddress(port));
+        serverChannel.configureBlocking(false);
+        serverChannel.register(selector, SelectionKey.OP_ACCEPT);
 
         long inittime = System.currentTimeMillis();
-        long starttime = System.currentTimeMillis();
+        long starttime = inittime;
         while (!Thread.interrupted()) {
-            try {
-                Thread.sleep(1000);
-            } catch (InterruptedException ex) {
-                break;
+            selector.select(1000);
+
+            Iterator<SelectionKey> it = selector.selectedKeys().iterator();
+            while (it.hasNext()) {
+                SelectionKey key = it.next();
+                it.remove();
+
+                if (!key.isValid())
+                    continue;
+                if (key.isAcceptable()) {
+                    accept();
+                    continue;
+                }
+
+                Client client = (Client) key.attachment();
+                if (key.isReadable())
+                    client.read();
+                if (client.key.isValid() && key.isWritable())
+                    client.flush();
             }
+
             long endtime = System.currentTimeMillis();
-            double dt = (endtime - starttime) / 1000.0;
-            starttime = endtime;
-            System.out.printf("%10.3f : %10.1f kB/s, %d clients\n",(endtime - inittime)/1000.0, bytesCount/1024.0/dt, clients.size());
-            bytesCount = 0;
+            if (endtime - starttime >= 1000) {
+                double dt = (endtime - starttime) / 1000.0;
+                starttime = endtime;
+                System.out.printf("%10.3f : %10.1f kB/s, %d clients, %d dropped\n",(endtime - inittime)/1000.0, bytesCount/1024.0/dt, clients.size(), droppedCount);
+                bytesCount = 0;
+                droppedCount = 0;
+            }
         }
         // interrupt signal received
         closeResources();
     }
 
     private void closeResources() throws IOException {
-        acceptThread.interrupt();
-        serverSocket.close();
-        synchronized(clients) {
-            for (ClientThread clientThread : clients) {
-                clientThread.closeResources();
-            }
-        }
+        for (Client client : new ArrayList<Client>(clients))
+            client.close();
+        serverChannel.close();
+        selector.close();
     }
 
+    void accept() throws IOException
+    {
+        SocketChannel chan = serverChannel.accept();
+        if (chan == null)
+            return;
+
+        chan.configureBlocking(false);
+        chan.socket().setTcpNoDelay(true);
+        Client client = new Client(chan);
+        clients.add(client);
+
+        ByteBuffer hello = ByteBuffer.allocate(8);
+        hello.putInt(TCPProvider.MAGIC_SERVER);
+        hello.putInt(TCPProvider.VERSION);
+        hello.flip();
+        client.send(hello);
+    }
 
+    /** Sends a message to every client subscribed to its channel.  Must be
+     * called from the thread that runs the service. **/
     public void relay(byte channel[], byte data[])
     {
-        // synchronously send to all clients.
         String chanstr = new String(channel);
-        try {
-            clients_lock.readLock().lock();
-            for (ClientThread client : clients) {
-                client.send(chanstr, channel, data);
+        Client targets[] = channelClients.get(chanstr);
+        if (targets == null) {
+            LinkedHashSet<Client> matches = new LinkedHashSet<Client>();
+            for (Subscription sub : subscriptions.values()) {
+                if (sub.pat.matcher(chanstr).matches())
+                    matches.addAll(sub.clients);
             }
-        } finally {
-            clients_lock.readLock().unlock();
+            targets = matches.toArray(new Client[matches.size()]);
+            channelClients.put(chanstr, targets);
         }
+        if (targets.length == 0)
+            return;
+
+        // one copy of the message is shared by all clients
+        ByteBuffer msg = ByteBuffer.allocate(12 + channel.length + data.length);
+        msg.putInt(TCPProvider.MESSAGE_TYPE_PUBLISH);
+        msg.putInt(channel.length);
+        msg.put(channel);
+        msg.putInt(data.length);
+        msg.put(data);
+        msg.flip();
+
+        for (Client client : targets)
+            client.send(msg.duplicate());
     }
 
-    class AcceptThread extends Thread
+    void subscribe(Client client, String regex)
     {
-        public void run()
-        {
-            while (!Thread.interrupted()) {
-                try {
-                    Socket clientSock = serverSocket.accept();
-
-                    ClientThread client = new ClientThread(clientSock);
-                    client.start();
-
-                    try {
-                        clients_lock.writeLock().lock();
-                        clients.add(client);
-                    } finally {
-                        clients_lock.writeLock().unlock();
-                    }
-                } catch (IOException ex) {
-                }
+        Subscription sub = subscriptions.get(regex);
+        if (sub == null) {
+            try {
+                sub = new Subscription(regex);
+            } catch (PatternSyntaxException ex) {
+                System.err.println("TCPService: invalid subscription "+regex);
+                return;
             }
+            subscriptions.put(regex, sub);
         }
+        sub.clients.add(client);
+        client.subscriptions.add(regex);
+        channelClients.clear();
+    }
+
+    void unsubscribe(Client client, String regex)
+    {
+        if (!client.subscriptions.remove(regex))
+            return;
+
+        Subscription sub = subscriptions.get(regex);
+        sub.clients.remove(client);
+        if (sub.clients.isEmpty())
+            subscriptions.remove(regex);
+        channelClients.clear();
     }
 
-    class ClientThread extends Thread
+    class Subscription
     {
-        Socket sock;
-        DataInputStream ins;
-        DataOutputStream outs;
+        Pattern pat;
+        // a client appears once for each time it subscribed with the regex
+        ArrayList<Client> clients = new ArrayList<Client>();
 
-        class SubscriptionRecord
+        Subscription(String regex)
         {
-            String  regex;
-            Pattern pat;
-            SubscriptionRecord(String regex) {
-                this.regex = regex;
-                this.pat = Pattern.compile(regex);
-            }
+            this.pat = Pattern.compile(regex);
         }
+    }
 
-        ArrayList<SubscriptionRecord> subscriptions = new ArrayList<SubscriptionRecord>();
-        ReadWriteLock subscriptions_lock = new ReentrantReadWriteLock();
+    class Client
+    {
+        SocketChannel chan;
+        SelectionKey key;
 
-        public ClientThread(Socket sock) throws IOException
-        {
-            this.sock = sock;
+        ByteBuffer readBuf = ByteBuffer.allocate(RECV_BUF_SIZE);
+        boolean helloReceived = false;
 
-            ins = new DataInputStream(sock.getInputStream());
-            outs = new DataOutputStream(sock.getOutputStream());
+        ArrayDeque<ByteBuffer> writeQueue = new ArrayDeque<ByteBuffer>();
+        ByteBuffer writeBufs[] = new ByteBuffer[MAX_WRITE_BUFFERS];
+        int queuedBytes = 0;
+        long dropped = 0;
 
-            outs.writeInt(TCPProvider.MAGIC_SERVER);
-            outs.writeInt(TCPProvider.VERSION);
+        ArrayList<String> subscriptions = new ArrayList<String>();
+
+        Client(SocketChannel chan) throws IOException
+        {
+            this.chan = chan;
+            key = chan.register(selector, SelectionKey.OP_READ, this);
         }
 
-        public void run()
+        void close()
         {
-            ///////////////////////
-            // read messages until something bad happens.
+            if (!key.isValid())
+                return;
+
+            key.cancel();
             try {
-                while (true) {
-                    int type = ins.readInt();
-                    if (type == TCPProvider.MESSAGE_TYPE_PUBLISH) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-
-                        int datalen = ins.readInt();
-                        byte data[] = new byte[datalen];
-                        ins.readFully(data);
-
-                        TCPService.this.relay(channel, data);
-
-                        bytesCount += channellen + datalen + 8;
-                    } else if(type == TCPProvider.MESSAGE_TYPE_SUBSCRIBE) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-                        try {
-                            subscriptions_lock.writeLock().lock();
-                            subscriptions.add(new SubscriptionRecord(new String(channel)));
-                        } finally {
-                            subscriptions_lock.writeLock().unlock();
-                        }
-                    } else if(type == TCPProvider.MESSAGE_TYPE_UNSUBSCRIBE) {
-                        int channellen = ins.readInt();
-                        byte channel[] = new byte[channellen];
-                        ins.readFully(channel);
-                        String re = new String(channel);
-                        try {
-                            subscriptions_lock.writeLock().lock();
-                            for(int i=0, n=subscriptions.size(); i<n; i++) {
-                                if(subscriptions.get(i).regex.equals(re)) {
-                                    subscriptions.remove(i);
-                                    break;
-                                }
-                            }
-                        } finally {
-                            subscriptions_lock.writeLock().unlock();
-                        }
-                    }
-                }
+                chan.close();
             } catch (IOException ex) {
             }
 
-            ///////////////////////
-            // Something bad happened, close this connection.
+            for (String regex : new ArrayList<String>(subscriptions))
+                unsubscribe(this, regex);
+            clients.remove(this);
+            if (dropped > 0)
+                System.out.println("client disconnected, "+dropped+" messages dropped");
+        }
+
+        /** Queues a message, or drops it if the client is too far behind.
+         * A message is never dropped from an empty queue, so that a client
+         * always receives messages larger than the bound. **/
+        void send(ByteBuffer msg)
+        {
+            if (!key.isValid())
+                return;
+
+            if (!writeQueue.isEmpty() &&
+                queuedBytes + msg.remaining() > maxQueueBytes) {
+                dropped++;
+                droppedCount++;
+                return;
+            }
+            writeQueue.addLast(msg);
+            queuedBytes += msg.remaining();
+
+            // the queue was empty, so the socket is probably writable
+            if (writeQueue.size() == 1)
+                flush();
+        }
+
+        void flush()
+        {
             try {
-                closeResources();
+                while (!writeQueue.isEmpty()) {
+                    int n = 0;
+                    for (ByteBuffer b : writeQueue) {
+                        if (n == writeBufs.length)
+                            break;
+                        writeBufs[n++] = b;
+                    }
+                    long written = chan.write(writeBufs, 0, n);
+                    queuedBytes -= written;
+                    while (!writeQueue.isEmpty() && !writeQueue.peekFirst().hasRemaining())
+                        writeQueue.removeFirst();
+                    Arrays.fill(writeBufs, 0, n, null);
+                    if (written == 0)
+                        break;
+                }
             } catch (IOException ex) {
+                close();
+                return;
             }
 
+            if (writeQueue.isEmpty())
+                key.interestOps(SelectionKey.OP_READ);
+            else
+                key.interestOps(SelectionKey.OP_READ | SelectionKey.OP_WRITE);
+        }
+
+        void read()
+        {
             try {
-                clients_lock.writeLock().lock();
-                clients.remove(this);
-            } finally {
-                clients_lock.writeLock().unlock();
+                if (chan.read(readBuf) < 0) {
+                    close();
+                    return;
+                }
+            } catch (IOException ex) {
+                close();
+                return;
             }
-        }
 
-        public void closeResources() throws IOException {
-            sock.close();
+            readBuf.flip();
+            boolean ok = parse();
+            readBuf.compact();
+            if (!ok)
+                close();
         }
 
-        public void send(String chanstr, byte channel[], byte data[])
+        // Handles the messages received in full.  Returns false if the
+        // client sent something invalid.
+        boolean parse()
         {
-            try {
-                subscriptions_lock.readLock().lock();
-                for(SubscriptionRecord sr : subscriptions) {
-                    if(sr.pat.matcher(chanstr).matches()) {
-                        synchronized(outs) {
-                            outs.writeInt(TCPProvider.MESSAGE_TYPE_PUBLISH);
-                            outs.writeInt(channel.length);
-                            outs.write(channel);
-                            outs.writeInt(data.length);
-                            outs.write(data);
-                            outs.flush();
-                            return;
+            while (key.isValid()) {
+                int avail = readBuf.remaining();
+                int p = readBuf.position();
+
+                if (!helloReceived) {
+                    if (avail < 8)
+                        break;
+                    if (readBuf.getInt(p) != TCPProvider.MAGIC_CLIENT) {
+                        System.err.println("TCPService: invalid magic from client");
+                        return false;
+                    }
+                    helloReceived = true;
+                    readBuf.position(p + 8);
+                    continue;
+                }
+
+                // message type, channel length, channel, and for publish
+                // the payload size and payload
+                long need = 8;
+                int type = 0;
+                int channellen = 0;
+                int datalen = 0;
+                if (avail >= need) {
+                    type = readBuf.getInt(p);
+                    channellen = readBuf.getInt(p + 4);
+                    if (channellen < 0)
+                        return false;
+                    need += channellen;
+                    if (type == TCPProvider.MESSAGE_TYPE_PUBLISH) {
+                        need += 4;
+                        if (avail >= need) {
+                            datalen = readBuf.getInt(p + (int) need - 4);
+                            if (datalen < 0)
+                                return false;
+                            need += datalen;
                         }
                     }
                 }
-            } catch (IOException ex) {
-            } finally {
-                subscriptions_lock.readLock().unlock();
+                if (need > Integer.MAX_VALUE - 8) {
+                    System.err.println("TCPService: message too large");
+                    return false;
+                }
+                if (avail < need) {
+                    if (need > readBuf.capacity()) {
+                        // make room for the rest of the message
+                        ByteBuffer bigger = ByteBuffer.allocate((int) need);
+                        bigger.put(readBuf);
+                        bigger.flip();
+                        readBuf = bigger;
+                    }
+                    break;
+                }
+
+                byte channel[] = new byte[channellen];
+                readBuf.position(p + 8);
+                readBuf.get(channel);
+
+                if (type == TCPProvider.MESSAGE_TYPE_PUBLISH) {
+                    byte data[] = new byte[datalen];
+                    readBuf.getInt();
+                    readBuf.get(data);
+                    bytesCount += channellen + datalen + 8;
+                    relay(channel, data);
+                } else if (type == TCPProvider.MESSAGE_TYPE_SUBSCRIBE) {
+                    subscribe(this, new String(channel));
+                } else if (type == TCPProvider.MESSAGE_TYPE_UNSUBSCRIBE) {
+                    unsubscribe(this, new String(channel));
+                } else {
+                    System.err.println("TCPService: unknown message type "+type);
+                    return false;
+                }
             }
+            return true;
         }
     }
 
@@ -219,9 +383,12 @@ public class TCPService
     {
         try {
             int port = 7700;
+            int maxQueueBytes = DEFAULT_MAX_QUEUE_BYTES;
             if (args.length > 0)
                 port = Integer.parseInt(args[0]);
-            new TCPService(port);
+            if (args.length > 1)
+                maxQueueBytes = Integer.parseInt(args[1]) * 1024;
+            new TCPService(port, maxQueueBytes);
         } catch (IOException ex) {
             System.out.println("Ex: "+ex);
         }
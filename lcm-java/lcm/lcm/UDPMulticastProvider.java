@@ -10,6 +10,10 @@ import java.nio.*;
  * pre-arranged UDP multicast address. Subscription operations are a
  * no-op, since all messages are always broadcast.
  *
+ * Datagrams are received into a single reused buffer and passed to LCM
+ * without copying, and fragmented messages are reassembled directly into
+ * pooled buffers, so that receiving allocates little memory.
+ *
  * This mechanism is very simple, low-latency, and efficient due to
  * not having to transmit messages more than once when there are
  * multiple subscribers. Since it uses UDP, it is lossy.
@@ -190,20 +194,34 @@ public class UDPMulticastProvider implements Provider
         boolean frag_received[];
 
         FragmentBuffer(SocketAddress from, String channel, int msgSeqNumber, int data_size,
-                       int fragments_remaining)
+                       int fragments_remaining, byte[] data)
         {
             this.from = from;
             this.channel = channel;
             this.msgSeqNumber = msgSeqNumber;
             this.data_size = data_size;
             this.fragments_remaining = fragments_remaining;
-            this.data = new byte[data_size];
+            this.data = data;
             this.frag_received = new boolean[fragments_remaining];
         }
     }
 
     class ReaderThread extends Thread
     {
+        static final int MAX_POOLED_BUFFERS = 4;
+        static final int CHANNEL_CACHE_SIZE = 256;
+
+        // the receive buffer, which is reused for every datagram
+        byte[] buf = new byte[65536];
+        ByteBuffer header = ByteBuffer.wrap(buf);
+
+        // reassembly buffers of completed or dropped messages, for reuse
+        ArrayList<byte[]> freeBuffers = new ArrayList<byte[]>();
+
+        // the channel names of recent datagrams, so that they are not
+        // decoded into a new String each time
+        String[] channelCache = new String[CHANNEL_CACHE_SIZE];
+
         ReaderThread()
         {
             setDaemon(true);
@@ -211,10 +229,11 @@ public class UDPMulticastProvider implements Provider
 
         public void run()
         {
-            DatagramPacket packet = new DatagramPacket(new byte[65536], 65536);
+            DatagramPacket packet = new DatagramPacket(buf, buf.length);
 
             while (!isInterrupted()) {
                 try {
+                    packet.setLength(buf.length);
                     sock.receive(packet);
                     handlePacket(packet);
                 } catch (IOException ex) {
@@ -230,56 +249,126 @@ public class UDPMulticastProvider implements Provider
             sock.close();
         }
 
-        void handleShortMessage(DatagramPacket packet, LCMDataInputStream ins) throws IOException
+        byte[] allocBuffer(int size)
         {
-            int msgSeqNumber = ins.readInt();
-            String channel = ins.readStringZ();
+            for (int i = 0; i < freeBuffers.size(); i++) {
+                byte[] b = freeBuffers.get(i);
+                if (b.length >= size) {
+                    freeBuffers.remove(i);
+                    return b;
+                }
+            }
+            return new byte[size];
+        }
 
-            lcm.receiveMessage(channel, ins.getBuffer(), ins.getBufferOffset(), ins.available());
+        void releaseBuffer(FragmentBuffer fbuf)
+        {
+            fragBufs.remove(fbuf.from);
+            if (freeBuffers.size() >= MAX_POOLED_BUFFERS) {
+                // keep the largest buffers
+                int smallest = 0;
+                for (int i = 1; i < freeBuffers.size(); i++) {
+                    if (freeBuffers.get(i).length < freeBuffers.get(smallest).length)
+                        smallest = i;
+                }
+                if (freeBuffers.get(smallest).length >= fbuf.data.length)
+                    return;
+                freeBuffers.remove(smallest);
+            }
+            freeBuffers.add(fbuf.data);
         }
 
-        void handleFragment (DatagramPacket packet, LCMDataInputStream ins) throws IOException
+        // Returns the channel name of len bytes at offset in buf.
+        String channelName(int offset, int len) throws IOException
         {
-            int msgSeqNumber = ins.readInt();
-            int msg_size = ins.readInt() & 0xffffffff;
-            int fragment_offset = ins.readInt() & 0xffffffff;
-            int fragment_id = ins.readShort() & 0xffff;
-            int fragments_in_msg = ins.readShort() & 0xffff;
-
-            // read entire packet payload
-            byte payload[] = new byte[ins.available()];
-            ins.readFully(payload);
-
-            if (ins.available() > 0) {
-                System.err.println("Unread data! "+ins.available());
+            int hash = len;
+            for (int i = 0; i < len; i++)
+                hash = 31 * hash + buf[offset + i];
+            int slot = hash & (CHANNEL_CACHE_SIZE - 1);
+
+            String cached = channelCache[slot];
+            if (cached != null && cached.length() == len) {
+                int i = 0;
+                while (i < len && cached.charAt(i) == (char) (buf[offset + i] & 0xff))
+                    i++;
+                if (i == len)
+                    return cached;
             }
+            String channel = new String(buf, offset, len, "US-ASCII");
+            channelCache[slot] = channel;
+            return channel;
+        }
 
-            int data_start = 0;
-            int frag_size = payload.length;
+        // Returns the length of the zero terminated string at offset, or -1
+        // if it isn't terminated before end.
+        int stringLength(int offset, int end)
+        {
+            for (int i = offset; i < end; i++) {
+                if (buf[i] == 0)
+                    return i - offset;
+            }
+            return -1;
+        }
+
+        void handleShortMessage(DatagramPacket packet) throws IOException
+        {
+            int end = packet.getLength();
+            int channel_len = stringLength(8, end);
+            if (channel_len < 0) {
+                System.err.println("LC: dropping message without a channel");
+                return;
+            }
+            String channel = channelName(8, channel_len);
+            int data_start = 8 + channel_len + 1;
+
+            lcm.receiveMessage(channel, buf, data_start, end - data_start);
+        }
+
+        void handleFragment (DatagramPacket packet) throws IOException
+        {
+            int end = packet.getLength();
+            if (end < 20) {
+                System.err.println ("LC: dropping truncated fragment");
+                return;
+            }
+            int msgSeqNumber = header.getInt(4);
+            int msg_size = header.getInt(8);
+            int fragment_offset = header.getInt(12);
+            int fragment_id = header.getShort(16) & 0xffff;
+            int fragments_in_msg = header.getShort(18) & 0xffff;
+
+            // the payload is copied from the receive buffer straight into
+            // the reassembly buffer
+            int data_start = 20;
+            int frag_size = end - data_start;
 
             SocketAddress from = packet.getSocketAddress();
             FragmentBuffer fbuf = fragBufs.get(from);
 
             if (fbuf != null && ((fbuf.msgSeqNumber != msgSeqNumber) ||
                                  (fbuf.data_size != msg_size))) {
-                fragBufs.remove(fbuf.from);
+                releaseBuffer(fbuf);
                 fbuf = null;
             }
 
             if (null == fbuf && 0 == fragment_id) {
+                if (msg_size < 0 || fragments_in_msg == 0) {
+                    System.err.println ("LC: dropping invalid fragment");
+                    return;
+                }
 
                 // extract channel name
-                int channel_len = 0;
-                for (; channel_len < payload.length; channel_len++) {
-                    if (0 == payload[channel_len]) {
-                        break;
-                    }
+                int channel_len = stringLength(data_start, end);
+                if (channel_len < 0) {
+                    System.err.println ("LC: dropping invalid fragment");
+                    return;
                 }
-                data_start = channel_len + 1;
+                String channel = channelName(data_start, channel_len);
+                data_start += channel_len + 1;
                 frag_size -= channel_len + 1;
-                String channel = new String(payload, 0, channel_len, "US-ASCII");
 
-                fbuf = new FragmentBuffer (from, channel, msgSeqNumber, msg_size, fragments_in_msg);
+                fbuf = new FragmentBuffer (from, channel, msgSeqNumber, msg_size,
+                                           fragments_in_msg, allocBuffer(msg_size));
 
                 fragBufs.put (fbuf.from, fbuf);
             }
@@ -289,37 +378,39 @@ public class UDPMulticastProvider implements Provider
                 return;
             }
 
-            if (fragment_offset + frag_size > fbuf.data_size) {
+            if (fragment_offset < 0 || fragment_id >= fbuf.frag_received.length ||
+                fragment_offset + frag_size > fbuf.data_size) {
                 System.err.println ("LC: dropping invalid fragment");
-                fragBufs.remove (fbuf.from);
+                releaseBuffer(fbuf);
                 return;
             }
 
             if (!fbuf.frag_received[fragment_id]) {
                 fbuf.frag_received[fragment_id] = true;
 
-                System.arraycopy(payload, data_start, fbuf.data, fragment_offset, frag_size);
+                System.arraycopy(buf, data_start, fbuf.data, fragment_offset, frag_size);
 
                 fbuf.fragments_remaining --;
             }
 
             if (0 == fbuf.fragments_remaining) {
                 lcm.receiveMessage(fbuf.channel, fbuf.data, 0, fbuf.data_size);
-                fragBufs.remove (fbuf.from);
+                releaseBuffer(fbuf);
             }
         }
 
         void handlePacket(DatagramPacket packet) throws IOException
         {
-            LCMDataInputStream ins = new LCMDataInputStream(packet.getData(),
-                                                            packet.getOffset(),
-                                                            packet.getLength());
+            if (packet.getLength() < 8) {
+                System.err.println("LC: dropping truncated datagram");
+                return;
+            }
 
-            int magic = ins.readInt();
+            int magic = header.getInt(0);
             if (magic == MAGIC_SHORT) {
-                handleShortMessage(packet, ins);
+                handleShortMessage(packet);
             } else if (magic == MAGIC_LONG) {
-                handleFragment(packet, ins);
+                handleFragment(packet);
             } else {
                 System.err.println("bad magic: " + Integer.toHexString(magic));
                 return;
@@ -1,6 +1,7 @@
 package lcm.logging;
 
 import java.io.*;
+import java.util.*;
 
 import lcm.util.*;
 import lcm.lcm.*;
@@ -15,6 +16,35 @@ public class Log
     static final int LOG_MAGIC = 0xEDA1DA01;
     String path;
 
+    /**
+     * Appended to the path of a log file to name its index, as written by
+     * lcm-logger and lcm-logindex.
+     */
+    public static final String INDEX_SUFFIX = ".lcmidx";
+
+    // The sidecar index has the format of the C library's: a magic number
+    // and a version, then records that each start with a type.  See
+    // lcm/eventlog.c.  Version 3 adds the INDEX_BLOCK_STATS records, which
+    // are skipped here and not written.
+    static final int INDEX_MAGIC = 0xEDA1DA1D;
+    static final int INDEX_VERSION = 2;
+    static final int INDEX_MAX_VERSION = 3;
+    static final int INDEX_EVENT = 1;
+    static final int INDEX_CHANNEL = 2;
+    static final int INDEX_BLOCK_CHANNELS = 3;
+    static final int INDEX_BLOCK_STATS = 4;
+    static final int INDEX_STATS_ENTRY_SIZE = 40;
+    static final int INDEX_INTERVAL_EVENTS = 1000;
+    static final int INDEX_INTERVAL_BYTES = 1 << 20;
+    static final int HEADER_SIZE = 28;
+    static final int MAX_CHANNEL_LEN = 1000;
+
+    /** The index of the log, or null until one is loaded or built. **/
+    Index index;
+    /** The block of the index that the last filtered read checked. **/
+    int filterBlock = -1;
+    volatile boolean closed = false;
+
     /** Used to count the number of messages written so far. **/
     long numMessagesWritten = 0;
 
@@ -44,6 +74,286 @@ public class Log
         public String channel;
     }
 
+    /**
+     * Selects the channels that {@link #readNext(ChannelFilter)} returns.
+     */
+    public interface ChannelFilter
+    {
+        /** @return true if the events on the channel should be read. **/
+        boolean accept(String channel);
+    }
+
+    /** Blocks of events, each of which starts with the event at an offset,
+     * and the channels in each block. **/
+    static class Index
+    {
+        int length;
+        long eventNumbers[] = new long[1024];
+        long utimes[] = new long[1024];
+        long offsets[] = new long[1024];
+        // bitmaps of the channel numbers in each block, or null if unknown
+        int channels[][] = new int[1024][];
+        ArrayList<String> channelNames = new ArrayList<String>();
+
+        void addBlock(long eventNumber, long utime, long offset)
+        {
+            if (length == offsets.length) {
+                int capacity = 2 * length;
+                eventNumbers = Arrays.copyOf(eventNumbers, capacity);
+                utimes = Arrays.copyOf(utimes, capacity);
+                offsets = Arrays.copyOf(offsets, capacity);
+                channels = Arrays.copyOf(channels, capacity);
+            }
+            eventNumbers[length] = eventNumber;
+            utimes[length] = utime;
+            offsets[length] = offset;
+            channels[length] = null;
+            length++;
+        }
+
+        /** @return the last block that starts at or before offset, or -1. **/
+        int findOffset(long offset)
+        {
+            if (length == 0 || offset < offsets[0])
+                return -1;
+            int lo = 0, hi = length;
+            while (hi - lo > 1) {
+                int mid = lo + (hi - lo) / 2;
+                if (offsets[mid] <= offset)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        /** @return the last block that starts before utime, or the first. **/
+        int findUtime(long utime)
+        {
+            int lo = 0, hi = length;
+            while (hi - lo > 1) {
+                int mid = lo + (hi - lo) / 2;
+                if (utimes[mid] < utime)
+                    lo = mid;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        /** @return true if the block may have events that pass the filter. **/
+        boolean blockMatches(int block, ChannelFilter filter)
+        {
+            int bits[] = channels[block];
+            if (bits == null)
+                return true;
+            for (int w = 0; w < bits.length; w++) {
+                for (int b = 0; b < 32; b++) {
+                    if ((bits[w] & (1 << b)) == 0)
+                        continue;
+                    int id = w * 32 + b;
+                    if (id >= channelNames.size() || filter.accept(channelNames.get(id)))
+                        return true;
+                }
+            }
+            return false;
+        }
+
+        /** Parses an index file.  A partly written last record is left
+         * out.
+         *
+         * @return the index, or null if the file is not an index.
+         **/
+        static Index read(File file) throws IOException
+        {
+            DataInputStream ins = new DataInputStream(new BufferedInputStream(new FileInputStream(file)));
+            try {
+                if (ins.readInt() != INDEX_MAGIC)
+                    return null;
+                int version = ins.readInt();
+                if (version < INDEX_VERSION || version > INDEX_MAX_VERSION)
+                    return null;
+
+                Index index = new Index();
+                try {
+                    while (true) {
+                        int type = ins.readInt();
+                        if (type == INDEX_EVENT) {
+                            long eventNumber = ins.readLong();
+                            long utime = ins.readLong();
+                            long offset = ins.readLong();
+                            index.addBlock(eventNumber, utime, offset);
+                        } else if (type == INDEX_CHANNEL) {
+                            int len = ins.readInt();
+                            if (len <= 0 || len >= MAX_CHANNEL_LEN)
+                                break;
+                            byte name[] = new byte[len];
+                            ins.readFully(name);
+                            index.channelNames.add(new String(name));
+                        } else if (type == INDEX_BLOCK_CHANNELS) {
+                            int words = ins.readInt();
+                            if (words < 0 || words > file.length() / 4)
+                                break;
+                            int bits[] = new int[words];
+                            for (int w = 0; w < words; w++)
+                                bits[w] = ins.readInt();
+                            if (index.length > 0)
+                                index.channels[index.length - 1] = bits;
+                        } else if (type == INDEX_BLOCK_STATS) {
+                            ins.readLong();
+                            int num = ins.readInt();
+                            if (num < 0 || num > file.length() / INDEX_STATS_ENTRY_SIZE)
+                                break;
+                            ins.readFully(new byte[num * INDEX_STATS_ENTRY_SIZE]);
+                        } else {
+                            break;
+                        }
+                    }
+                } catch (EOFException ex) {
+                }
+                return index;
+            } catch (EOFException ex) {
+                return null;
+            } finally {
+                ins.close();
+            }
+        }
+    }
+
+    /** Builds the index of a log that has none, and writes it next to the
+     * log for the next time the log is opened. **/
+    class IndexBuilder extends Thread
+    {
+        Index built = new Index();
+        ByteArrayOutputStream bouts = new ByteArrayOutputStream();
+        DataOutputStream outs = new DataOutputStream(bouts);
+        HashMap<String, Integer> channelIds = new HashMap<String, Integer>();
+        int blockChannels[];
+        int eventsSinceBlock = INDEX_INTERVAL_EVENTS;
+        long bytesSinceBlock = 0;
+
+        IndexBuilder()
+        {
+            setDaemon(true);
+        }
+
+        void endBlock() throws IOException
+        {
+            if (blockChannels == null)
+                return;
+            outs.writeInt(INDEX_BLOCK_CHANNELS);
+            outs.writeInt(blockChannels.length);
+            for (int w = 0; w < blockChannels.length; w++)
+                outs.writeInt(blockChannels[w]);
+            built.channels[built.length - 1] = blockChannels;
+            blockChannels = null;
+        }
+
+        void addEvent(long eventNumber, long utime, long offset, String channel, int eventSize) throws IOException
+        {
+            if (eventsSinceBlock >= INDEX_INTERVAL_EVENTS ||
+                bytesSinceBlock >= INDEX_INTERVAL_BYTES) {
+                endBlock();
+                outs.writeInt(INDEX_EVENT);
+                outs.writeLong(eventNumber);
+                outs.writeLong(utime);
+                outs.writeLong(offset);
+                built.addBlock(eventNumber, utime, offset);
+                blockChannels = new int[1];
+                eventsSinceBlock = 0;
+                bytesSinceBlock = 0;
+            }
+            eventsSinceBlock++;
+            bytesSinceBlock += eventSize;
+
+            Integer id = channelIds.get(channel);
+            if (id == null) {
+                id = channelIds.size();
+                channelIds.put(channel, id);
+                built.channelNames.add(channel);
+                byte name[] = channel.getBytes();
+                outs.writeInt(INDEX_CHANNEL);
+                outs.writeInt(name.length);
+                outs.write(name);
+            }
+            int word = id / 32;
+            if (word >= blockChannels.length)
+                blockChannels = Arrays.copyOf(blockChannels, word + 1);
+            blockChannels[word] |= 1 << (id % 32);
+        }
+
+        public void run()
+        {
+            try {
+                outs.writeInt(INDEX_MAGIC);
+                outs.writeInt(INDEX_VERSION);
+
+                BufferedRandomAccessFile f = new BufferedRandomAccessFile(path, "r");
+                try {
+                    scan(f);
+                } finally {
+                    f.close();
+                }
+                if (closed)
+                    return;
+                endBlock();
+            } catch (IOException ex) {
+                return;
+            }
+
+            synchronized(Log.this) {
+                if (index == null)
+                    index = built;
+            }
+
+            // An index that can't be written is still used by this reader
+            File ipath = new File(path + INDEX_SUFFIX);
+            File tmp = new File(path + INDEX_SUFFIX + ".tmp");
+            try {
+                FileOutputStream fouts = new FileOutputStream(tmp);
+                try {
+                    bouts.writeTo(fouts);
+                } finally {
+                    fouts.close();
+                }
+                ipath.delete();
+                if (!tmp.renameTo(ipath))
+                    tmp.delete();
+            } catch (IOException ex) {
+                tmp.delete();
+            }
+        }
+
+        void scan(BufferedRandomAccessFile f) throws IOException
+        {
+            byte channel[] = new byte[MAX_CHANNEL_LEN];
+            while (!closed) {
+                int magic = 0;
+                try {
+                    while (magic != LOG_MAGIC)
+                        magic = (magic << 8) | (f.readByte() & 0xff);
+
+                    long offset = f.getFilePointer() - 4;
+                    long eventNumber = f.readLong();
+                    long utime = f.readLong();
+                    int channellen = f.readInt();
+                    int datalen = f.readInt();
+                    if (channellen <= 0 || channellen >= MAX_CHANNEL_LEN || datalen < 0) {
+                        // resynchronize just past this magic number
+                        f.seek(offset + 4);
+                        continue;
+                    }
+                    f.readFully(channel, 0, channellen);
+                    addEvent(eventNumber, utime, offset, new String(channel, 0, channellen),
+                             HEADER_SIZE + channellen + datalen);
+                    f.seek(f.getFilePointer() + datalen);
+                } catch (EOFException ex) {
+                    return;
+                }
+            }
+        }
+    }
+
     /**
      * Opens a log file for reading or writing.
      *
@@ -56,6 +366,49 @@ public class Log
         this.path = path;
         raf = new BufferedRandomAccessFile(path, mode);
         //raf = new RandomAccessFile(path, mode);
+
+        if (mode.equals("r") && raf.length() > 0) {
+            loadIndex();
+            if (index == null)
+                new IndexBuilder().start();
+        }
+    }
+
+    /** Loads the sidecar index, if there is one and it matches the log. **/
+    void loadIndex() throws IOException
+    {
+        File ipath = new File(path + INDEX_SUFFIX);
+        if (!ipath.exists())
+            return;
+
+        Index idx = Index.read(ipath);
+        if (idx == null || idx.length == 0 || idx.offsets[0] != 0 ||
+            !checkBlock(idx, 0) || !checkBlock(idx, idx.length - 1))
+            return;
+        index = idx;
+    }
+
+    /** @return true if the event at the start of a block is as indexed. **/
+    boolean checkBlock(Index idx, int block) throws IOException
+    {
+        if (idx.offsets[block] + HEADER_SIZE > raf.length())
+            return false;
+        raf.seek(idx.offsets[block]);
+        boolean ok = raf.readInt() == LOG_MAGIC &&
+            raf.readLong() == idx.eventNumbers[block] &&
+            raf.readLong() == idx.utimes[block];
+        raf.seek(0);
+        return ok;
+    }
+
+    /**
+     * Returns true if seeking uses an index of the log.  Logs opened for
+     * reading without an index are indexed in the background, which this
+     * reports when done.
+     */
+    public synchronized boolean hasIndex()
+    {
+        return index != null;
     }
 
     /**
@@ -81,13 +434,32 @@ public class Log
      * @throws java.io.EOFException if the end of the file has been reached.
      */
     public synchronized Event readNext() throws IOException
+    {
+        return readNext(null);
+    }
+
+    /**
+     * Reads the next event on a channel that the filter accepts.  The data
+     * of other events is skipped, and if the log has an index, so are the
+     * blocks of events without any accepted channel.
+     *
+     * @param filter the channels to read, or null for all of them.
+     * @throws java.io.EOFException if the end of the file has been reached.
+     */
+    public synchronized Event readNext(ChannelFilter filter) throws IOException
     {
         int magic = 0;
         Event e = new Event();
         int channellen = 0, datalen = 0;
+        byte bchannel[];
+        boolean atEvent = true;
 
         while (true)
         {
+            if (filter != null && index != null && atEvent)
+                skipUnmatchedBlocks(filter);
+            atEvent = false;
+
             int v = raf.readByte()&0xff;
 
             magic = (magic<<8) | v;
@@ -106,19 +478,114 @@ public class Log
                                   e.eventNumber, e.utime, channellen, datalen);
                 continue;
             }
+
+            bchannel = new byte[channellen];
+            raf.readFully(bchannel);
+            e.channel = new String(bchannel);
+            if (filter != null && !filter.accept(e.channel)) {
+                raf.seek(raf.getFilePointer() + datalen);
+                magic = 0;
+                atEvent = true;
+                continue;
+            }
             break;
         }
 
-        byte bchannel[] = new byte[channellen];
         e.data = new byte[datalen];
-
-        raf.readFully(bchannel);
-        e.channel = new String(bchannel);
         raf.readFully(e.data);
 
         return e;
     }
 
+    /** Moves a filtered read past the blocks without accepted channels. **/
+    void skipUnmatchedBlocks(ChannelFilter filter) throws IOException
+    {
+        int block = index.findOffset(raf.getFilePointer());
+        if (block < 0 || block == filterBlock)
+            return;
+        while (block < index.length && !index.blockMatches(block, filter))
+            block++;
+        filterBlock = block;
+        if (block < index.length && index.offsets[block] > raf.getFilePointer())
+            raf.seek(index.offsets[block]);
+        else if (block == index.length)
+            raf.seek(raf.length());
+    }
+
+    /**
+     * Moves to the event that starts at offset or the first one after it,
+     * scanning forward from the start of the block of the index that holds
+     * offset.
+     *
+     * @return false if the events of the block are not as indexed.
+     */
+    boolean seekIndexed(long offset, long utime) throws IOException
+    {
+        int block = offset >= 0 ? index.findOffset(offset) : index.findUtime(utime);
+        if (block < 0)
+            return false;
+
+        long pos = index.offsets[block];
+        while (pos < raf.length()) {
+            raf.seek(pos);
+            if (pos + HEADER_SIZE > raf.length() || raf.readInt() != LOG_MAGIC)
+                return false;
+            raf.readLong();
+            long eventUtime = raf.readLong();
+            if (offset >= 0 ? pos >= offset : eventUtime >= utime)
+                break;
+            int channellen = raf.readInt();
+            int datalen = raf.readInt();
+            if (channellen <= 0 || datalen < 0)
+                return false;
+            pos += HEADER_SIZE + channellen + datalen;
+        }
+        raf.seek(pos);
+        return true;
+    }
+
+    /**
+     * Seeks to the first event at or after a timestamp.  With an index of
+     * the log this reads at most one block of events, and otherwise it
+     * bisects the log by position.
+     *
+     * @param utime time in microseconds since 00:00:00 UTC January 1, 1970.
+     */
+    public synchronized void seekToTimestamp(long utime) throws IOException
+    {
+        filterBlock = -1;
+        if (index != null && seekIndexed(-1, utime))
+            return;
+
+        double lo = 0, hi = 1;
+        for (int i = 0; i < 40 && raf.length() * (hi - lo) > 1; i++) {
+            double mid = (lo + hi) / 2;
+            raf.seek((long) (raf.length() * mid));
+            try {
+                if (readNext().utime < utime)
+                    lo = mid;
+                else
+                    hi = mid;
+            } catch (EOFException ex) {
+                hi = mid;
+            }
+        }
+
+        long pos = (long) (raf.length() * lo);
+        raf.seek(pos);
+        try {
+            while (true) {
+                Event e = readNext();
+                if (e.utime >= utime)
+                    break;
+                pos = raf.getFilePointer();
+            }
+        } catch (EOFException ex) {
+            pos = raf.length();
+        }
+        raf.seek(pos);
+    }
+
     public synchronized double getPositionFraction() throws IOException
     {
         return raf.getFilePointer()/((double) raf.length());
@@ -131,7 +598,15 @@ public class Log
      */
     public synchronized void seekPositionFraction(double frac) throws IOException
     {
-        raf.seek((long) (raf.length()*frac));
+        long offset = (long) (raf.length()*frac);
+        filterBlock = -1;
+
+        // with an index, this lands on the start of an event rather than
+        // wherever the next magic number is, which may be inside the data
+        // of an event
+        if (index != null && seekIndexed(offset, 0))
+            return;
+        raf.seek(offset);
     }
 
     /**
@@ -175,6 +650,7 @@ public class Log
      */
     public synchronized void close() throws IOException
     {
+        closed = true;
         raf.close();
     }
 }
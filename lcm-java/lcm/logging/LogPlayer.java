@@ -58,6 +58,8 @@ public class LogPlayer extends JComponent
 
     double total_seconds; // an estimate of how many seconds there are in the file
 
+    long currentUtime; // time of the last event played or seeked to
+
     BlockingQueue<QueuedEvent> events = new LinkedBlockingQueue<QueuedEvent>();
 
     Object sync = new Object();
@@ -145,6 +147,30 @@ public class LogPlayer extends JComponent
         }
     }
 
+    // seek to a timestamp, preserving the current play/pause state
+    class SeekTimeEvent implements QueuedEvent
+    {
+        long utime;
+
+        public SeekTimeEvent(long utime)
+        {
+            this.utime = utime;
+        }
+
+        public void execute(LogPlayer lp)
+        {
+            boolean player_was_running = (player != null);
+
+            if (player_was_running)
+                doStop();
+
+            doSeekTime(utime);
+
+            if (player_was_running)
+                doPlay();
+        }
+    }
+
     class StepEvent implements QueuedEvent
     {
         public void execute(LogPlayer lp)
@@ -445,12 +471,20 @@ public class LogPlayer extends JComponent
                         setSpeed(slowerSpeed(speed));
                     } else if (cmd.startsWith("BACK")) {
                         double seconds = Double.parseDouble(cmd.substring(4));
-                        double pos = log.getPositionFraction() - seconds/total_seconds;
-                        events.offer(new SeekEvent(pos));
+                        if (log.hasIndex()) {
+                            events.offer(new SeekTimeEvent(currentUtime - (long) (seconds*1000000)));
+                        } else {
+                            double pos = log.getPositionFraction() - seconds/total_seconds;
+                            events.offer(new SeekEvent(pos));
+                        }
                     } else if (cmd.startsWith("FORWARD")) {
                         double seconds = Double.parseDouble(cmd.substring(7));
-                        double pos = log.getPositionFraction() + seconds/total_seconds;
-                        events.offer(new SeekEvent(pos));
+                        if (log.hasIndex()) {
+                            events.offer(new SeekTimeEvent(currentUtime + (long) (seconds*1000000)));
+                        } else {
+                            double pos = log.getPositionFraction() + seconds/total_seconds;
+                            events.offer(new SeekEvent(pos));
+                        }
                     } else {
                         System.out.println("Unknown remote command: "+cmd);
                     }
@@ -717,11 +751,29 @@ public class LogPlayer extends JComponent
         }
     }
 
+    void doSeekTime(long utime)
+    {
+        assert (player == null);
+
+        try {
+            log.seekToTimestamp(utime);
+            Log.Event e = log.readNext();
+            log.seekToTimestamp(utime);
+            js.set(log.getPositionFraction());
+
+            lastSystemTime = 0; // reset log-play statistics.
+            updateDisplay(e);
+        } catch (IOException ex) {
+            System.out.println("exception: "+ex);
+        }
+    }
+
     long lastEventTime;
     long lastSystemTime;
 
     void updateDisplay(Log.Event e)
     {
+        currentUtime = e.utime;
         if (show_absolute_time) {
             java.text.SimpleDateFormat df =
                 new java.text.SimpleDateFormat("yyyy.MM.dd HH:mm:ss.S z");
@@ -762,6 +814,20 @@ public class LogPlayer extends JComponent
             stopflag = true;
         }
 
+        // Events that wouldn't be published are skipped without reading
+        // their data, along with whole blocks of them when the log has an
+        // index.  Channels without a filter yet are read so that they get
+        // one.
+        Log.ChannelFilter channelFilter = new Log.ChannelFilter()
+        {
+            public boolean accept(String channel)
+            {
+                Filter f = filterMap.get(channel);
+                return f == null || (f.enabled && f.outchannel.length() > 0) ||
+                    (stopOnChannel != null && channel.startsWith(stopOnChannel));
+            }
+        };
+
         public void run()
         {
             long lastTime = 0;
@@ -779,7 +845,8 @@ public class LogPlayer extends JComponent
             try {
                 while (!stopflag)
                 {
-                    Log.Event e = log.readNext();
+                    Log.Event e = log.readNext(channelFilter);
+                    currentUtime = e.utime;
 
                     if (speed != lastspeed) {
                         //System.out.printf("Speed changed. Old %12.6f new %12.6f\n",
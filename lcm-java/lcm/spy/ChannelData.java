@@ -10,24 +10,28 @@ public class ChannelData
     public long        fingerprint;   // lcm type fingerprint
     public int         row;
 
-    public long        nreceived;
-    public int         nerrors;
-    public long        last_utime;    // when was last message received?
+    // written by the LCM thread, and read by the table refresh
+    public volatile long nreceived;
+    public volatile int  nerrors;
+    public volatile long nbytes;
+    public volatile long last_utime;    // when was last message received?
+    public volatile long hz_min_interval;
+    public volatile long hz_max_interval;
 
-    public long        min_interval;  // written periodically by HzThread
+    public long        min_interval;  // written periodically by the table refresh
     public long        max_interval;
     public double      bandwidth;     // bytes per second
 
     public JFrame      viewerFrame;
     public ObjectPanel viewer;
 
-    // below: used by HzThread
+    // below: used by the table refresh
     public double      hz;
     public long        hz_last_utime;
     public long        hz_last_nreceived;
-    public long        hz_min_interval;
-    public long        hz_max_interval;
-    public long        hz_bytes;
+    public long        hz_last_nbytes;
+    public int         hz_last_nerrors;
 
-    public Object      last;         // last received object on this channel.
+    public Object      last;         // last decoded object on this channel.
+    public long        last_decode_utime; // when was last message decoded?
 }
@@ -7,6 +7,7 @@ import java.awt.event.*;
 
 import java.io.*;
 import java.util.*;
+import java.util.concurrent.*;
 import lcm.util.*;
 import java.lang.reflect.*;
 
@@ -19,7 +20,9 @@ public class Spy
     LCMTypeDatabase handlers;
     long startuTime; // time that lcm-spy started
 
-    HashMap<String,  ChannelData> channelMap = new HashMap<String, ChannelData>();
+    // channelMap is shared with the LCM thread, while channelList and the
+    // table are only used from the Swing event dispatch thread.
+    ConcurrentHashMap<String, ChannelData> channelMap = new ConcurrentHashMap<String, ChannelData>();
     ArrayList<ChannelData>        channelList = new ArrayList<ChannelData>();
 
     ChannelTableModel _channelTableModel = new ChannelTableModel();
@@ -31,6 +34,14 @@ public class Spy
 
     JButton clearButton = new JButton("Clear");
 
+    /** Period at which the messages of channels without an open viewer are
+     * decoded, in microseconds. **/
+    static final long SAMPLE_INTERVAL_US = 500000;
+
+    /** Period at which the statistics in the table are updated, in
+     * milliseconds. **/
+    static final int REFRESH_INTERVAL_MS = 1000;
+
     public Spy(String lcmurl) throws IOException
     {
         //    sortedChannelTableModel.addMouseListenerToHeaderInTable(channelTable);
@@ -67,7 +78,14 @@ public class Spy
             lcm = new LCM(lcmurl);
         lcm.subscribeAll(new MySubscriber());
 
-        new HzThread().start();
+        javax.swing.Timer refreshTimer = new javax.swing.Timer(REFRESH_INTERVAL_MS, new ActionListener()
+        {
+            public void actionPerformed(ActionEvent e)
+            {
+                refreshStatistics();
+            }
+        });
+        refreshTimer.start();
 
         clearButton.addActionListener(new ActionListener()
         {
@@ -331,13 +349,17 @@ public class Spy
                     cd.name = channel;
                     cd.cls = cls;
                     cd.fingerprint = fingerprint;
-                    cd.row = channelList.size();
+                    cd.hz_last_utime = utime_now();
 
-                    synchronized(channelList) {
-                        channelMap.put(channel, cd);
-                        channelList.add(cd);
-                        _channelTableModel.fireTableDataChanged();
-                    }
+                    channelMap.put(channel, cd);
+                    final ChannelData newcd = cd;
+                    SwingUtilities.invokeLater(new Runnable()
+                    {
+                        public void run()
+                        {
+                            addChannel(newcd);
+                        }
+                    });
 
                 } else {
                     if (cls != null && cd.cls != null && !cd.cls.equals(cls)) {
@@ -350,15 +372,30 @@ public class Spy
                 long interval = utime - cd.last_utime;
                 cd.hz_min_interval = Math.min(cd.hz_min_interval, interval);
                 cd.hz_max_interval = Math.max(cd.hz_max_interval, interval);
-                cd.hz_bytes += msg_size;
+                cd.nbytes += msg_size;
                 cd.last_utime = utime;
 
                 cd.nreceived++;
 
+                if (cd.cls == null) {
+                    cd.nerrors++;
+                    return;
+                }
+
+                // Decoding through reflection is far more expensive than
+                // the statistics above, so only channels with a visible
+                // viewer decode every message.  The others are sampled, to
+                // keep cd.last recent for when a viewer is opened.
+                boolean viewing = cd.viewer != null && cd.viewerFrame.isVisible();
+                if (!viewing && cd.last != null &&
+                    utime - cd.last_decode_utime < SAMPLE_INTERVAL_US)
+                    return;
+                cd.last_decode_utime = utime;
+
                 o = cd.cls.getConstructor(DataInput.class).newInstance(dins);
                 cd.last = o;
 
-                if (cd.viewer != null)
+                if (viewing)
                     cd.viewer.setObject(o, cd.last_utime);
 
             } catch (NullPointerException ex) {
@@ -383,51 +420,65 @@ public class Spy
         }
     }
 
-    class HzThread extends Thread
+    /** Adds a channel first seen by the LCM thread to the table. **/
+    void addChannel(ChannelData cd)
     {
-        public HzThread()
-        {
-            setDaemon(true);
-        }
+        // the channels may have been cleared in the meantime
+        if (channelMap.get(cd.name) != cd)
+            return;
 
-        public void run()
-        {
-            while (true)
-            {
-                long utime = utime_now();
-
-                synchronized(channelList)
-                {
-                    for (ChannelData cd : channelList)
-                    {
-                        long diff_recv = cd.nreceived - cd.hz_last_nreceived;
-                        cd.hz_last_nreceived = cd.nreceived;
-                        long dutime = utime - cd.hz_last_utime;
-                        cd.hz_last_utime = utime;
-
-                        cd.hz = diff_recv / (dutime/1000000.0);
-
-                        cd.min_interval = cd.hz_min_interval;
-                        cd.max_interval = cd.hz_max_interval;
-                        cd.hz_min_interval = 9999;
-                        cd.hz_max_interval = 0;
-                        cd.bandwidth = cd.hz_bytes / (dutime/1000000.0);
-                        cd.hz_bytes = 0;
-                    }
-                }
+        cd.row = channelList.size();
+        channelList.add(cd);
+        _channelTableModel.fireTableRowsInserted(cd.row, cd.row);
+    }
 
-                int selrow = channelTable.getSelectedRow();
-                channelTableModel.fireTableDataChanged();
-                if (selrow >= 0)
-                    channelTable.setRowSelectionInterval(selrow, selrow);
+    /** Updates the statistics of each channel from the counters written by
+     * the LCM thread, and repaints the rows that changed with a single
+     * table event. **/
+    void refreshStatistics()
+    {
+        long utime = utime_now();
+        int first_row = -1;
+        int last_row = -1;
 
-                try {
-                    Thread.sleep(1000);
-                } catch (InterruptedException ex) {
-                }
-            }
+        for (ChannelData cd : channelList)
+        {
+            long nreceived = cd.nreceived;
+            long nbytes = cd.nbytes;
+            int nerrors = cd.nerrors;
+            long diff_recv = nreceived - cd.hz_last_nreceived;
+            long dutime = utime - cd.hz_last_utime;
+            cd.hz_last_utime = utime;
+
+            // channels that stay silent keep showing the same row
+            if (diff_recv == 0 && cd.hz == 0 && nerrors == cd.hz_last_nerrors)
+                continue;
+
+            cd.hz = diff_recv / (dutime/1000000.0);
+            cd.bandwidth = (nbytes - cd.hz_last_nbytes) / (dutime/1000000.0);
+            cd.hz_last_nreceived = nreceived;
+            cd.hz_last_nbytes = nbytes;
+            cd.hz_last_nerrors = nerrors;
+
+            // a message arriving in between may be missed by the reset,
+            // which only affects the jitter of this period
+            cd.min_interval = cd.hz_min_interval;
+            cd.max_interval = cd.hz_max_interval;
+            cd.hz_min_interval = 9999;
+            cd.hz_max_interval = 0;
+
+            if (first_row < 0)
+                first_row = cd.row;
+            last_row = cd.row;
         }
 
+        if (first_row < 0)
+            return;
+
+        int selrow = channelTable.getSelectedRow();
+        _channelTableModel.fireTableRowsUpdated(first_row, last_row);
+        if (selrow >= 0 && channelTable.getSelectedRow() < 0)
+            channelTable.setRowSelectionInterval(selrow, selrow);
     }
 
     class DefaultViewer extends AbstractAction
@@ -250,6 +250,23 @@ public class TableSorter extends AbstractTableModel {
         return modelToView;
     }
 
+    // Returns true if the rows firstRow..lastRow of the model are still in
+    // order with the rows next to them in the view.
+    private boolean isStillSorted(int firstRow, int lastRow) {
+        Row[] rows = getViewToModel();
+        int[] views = getModelToView();
+        for (int row = firstRow; row <= lastRow; row++) {
+            int view = views[row];
+            if (view > 0 && rows[view - 1].compareTo(rows[view]) > 0) {
+                return false;
+            }
+            if (view < rows.length - 1 && rows[view].compareTo(rows[view + 1]) > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     // TableModel interface methods
 
     public synchronized int getRowCount() {
@@ -368,6 +385,29 @@ public class TableSorter extends AbstractTableModel {
                     return;
                 }
 
+                // An update of several rows can also be mapped through if
+                // every updated row still sorts between its neighbours, so
+                // that periodic updates of many rows don't resort the table
+                // and lose its selection each time.
+                if (e.getType() == TableModelEvent.UPDATE
+                    && e.getFirstRow() >= 0
+                    && e.getLastRow() < getRowCount()
+                    && viewToModel != null
+                    && viewToModel.length == getRowCount()
+                    && isStillSorted(e.getFirstRow(), e.getLastRow())) {
+                    int[] views = getModelToView();
+                    int firstView = Integer.MAX_VALUE;
+                    int lastView = -1;
+                    for (int row = e.getFirstRow(); row <= e.getLastRow(); row++) {
+                        firstView = Math.min(firstView, views[row]);
+                        lastView = Math.max(lastView, views[row]);
+                    }
+                    fireTableChanged(new TableModelEvent(TableSorter.this,
+                                                         firstView, lastView,
+                                                         column, e.getType()));
+                    return;
+                }
+
                 // Something has happened to the data that may have invalidated the row order.
                 clearSortingState();
                 fireTableDataChanged();
@@ -94,6 +94,117 @@ static void deliver_packet(lcmlite_t *lcm, const char *channel, const void *buf,
     }
 }
 
+static const uint32_t size_class_size[LCM3_NUM_SIZE_CLASSES] = {
+    LCM3_SMALL_PACKET_SIZE, LCM3_MEDIUM_PACKET_SIZE, LCM3_MAX_PACKET_SIZE
+};
+
+static const int size_class_count[LCM3_NUM_SIZE_CLASSES] = {
+    LCM3_NUM_SMALL_BUFFERS, LCM3_NUM_MEDIUM_BUFFERS, LCM3_NUM_BUFFERS
+};
+
+static inline int lookup_slot(uint64_t from_addr, uint32_t msg_seq)
+{
+    uint32_t h = (uint32_t) from_addr ^ (uint32_t) (from_addr >> 32);
+    h = (h * 2654435761u) ^ msg_seq;
+    h ^= h >> 16;
+    return h & (LCM3_LOOKUP_SIZE - 1);
+}
+
+// Finds the buffer in progress for a message, or returns -1.
+static int lookup_find(lcmlite_t *lcm, uint64_t from_addr, uint32_t msg_seq)
+{
+    int idx = lcm->lookup[lookup_slot(from_addr, msg_seq)];
+    while (idx >= 0) {
+        struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+        if (fbuf->from_addr == from_addr && fbuf->msg_seq == msg_seq)
+            return idx;
+        idx = fbuf->lookup_next;
+    }
+    return -1;
+}
+
+static void lookup_remove(lcmlite_t *lcm, int idx)
+{
+    struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+    int16_t *link = &lcm->lookup[lookup_slot(fbuf->from_addr, fbuf->msg_seq)];
+    while (*link != idx)
+        link = &lcm->fragment_buffers[*link].lookup_next;
+    *link = fbuf->lookup_next;
+}
+
+static void lru_remove(lcmlite_t *lcm, int idx)
+{
+    struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+    int c = fbuf->size_class;
+
+    if (fbuf->list_prev >= 0)
+        lcm->fragment_buffers[fbuf->list_prev].list_next = fbuf->list_next;
+    else
+        lcm->lru_head[c] = fbuf->list_next;
+
+    if (fbuf->list_next >= 0)
+        lcm->fragment_buffers[fbuf->list_next].list_prev = fbuf->list_prev;
+    else
+        lcm->lru_tail[c] = fbuf->list_prev;
+}
+
+// Makes a buffer the most recently used of its size class.
+static void lru_append(lcmlite_t *lcm, int idx)
+{
+    struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+    int c = fbuf->size_class;
+
+    fbuf->list_prev = lcm->lru_tail[c];
+    fbuf->list_next = -1;
+    if (lcm->lru_tail[c] >= 0)
+        lcm->fragment_buffers[lcm->lru_tail[c]].list_next = idx;
+    else
+        lcm->lru_head[c] = idx;
+    lcm->lru_tail[c] = idx;
+}
+
+static void free_push(lcmlite_t *lcm, int idx)
+{
+    struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+    fbuf->fragments_remaining = 0;
+    fbuf->list_prev = -1;
+    fbuf->list_next = lcm->free_head[fbuf->size_class];
+    lcm->free_head[fbuf->size_class] = idx;
+}
+
+// Picks a buffer for a new message: an idle buffer of the smallest size
+// class that can hold it, or else the least recently used buffer in
+// progress of any class that can hold it. Returns -1 if there is none.
+static int fragment_buffer_acquire(lcmlite_t *lcm, uint32_t msg_size)
+{
+    for (int c = 0; c < LCM3_NUM_SIZE_CLASSES; c++) {
+        if (size_class_size[c] < msg_size || lcm->free_head[c] < 0)
+            continue;
+        int idx = lcm->free_head[c];
+        lcm->free_head[c] = lcm->fragment_buffers[idx].list_next;
+        return idx;
+    }
+
+    int victim = -1;
+    int32_t max_age = -1;
+    for (int c = 0; c < LCM3_NUM_SIZE_CLASSES; c++) {
+        if (size_class_size[c] < msg_size || lcm->lru_head[c] < 0)
+            continue;
+        int idx = lcm->lru_head[c];
+        int32_t age = lcm->last_fragment_count - lcm->fragment_buffers[idx].last_fragment_count;
+        if (age > max_age) {
+            victim = idx;
+            max_age = age;
+        }
+    }
+
+    if (victim >= 0) {
+        lookup_remove(lcm, victim);
+        lru_remove(lcm, victim);
+    }
+    return victim;
+}
+
 // The caller allocates permanent storage for LCMLite. This initializes
 int lcmlite_init(lcmlite_t *lcm, void (*transmit_packet)(const void *_buf, int buf_len, void *user), void *transmit_user)
 {
@@ -101,6 +212,38 @@ int lcmlite_init(lcmlite_t *lcm, void (*transmit_packet)(const void *_buf, int b
     lcm->transmit_packet = transmit_packet;
     lcm->transmit_user = transmit_user;
 
+    for (int i = 0; i < LCM3_LOOKUP_SIZE; i++)
+        lcm->lookup[i] = -1;
+
+    // carve the storage into buffers, ordered by size class
+    int idx = 0;
+    uint32_t storage_pos = 0;
+    for (int c = 0; c < LCM3_NUM_SIZE_CLASSES; c++) {
+        lcm->free_head[c] = -1;
+        lcm->lru_head[c] = -1;
+        lcm->lru_tail[c] = -1;
+
+        for (int i = 0; i < size_class_count[c]; i++, idx++) {
+            struct fragment_buffer *fbuf = &lcm->fragment_buffers[idx];
+            fbuf->buf = &lcm->fragment_storage[storage_pos];
+            fbuf->size_class = c;
+            fbuf->lookup_next = -1;
+            storage_pos += size_class_size[c];
+            free_push(lcm, idx);
+        }
+    }
+
+    return 0;
+}
+
+int lcmlite_init_sg(lcmlite_t *lcm,
+                    void (*transmit_packet_sg)(const void *hdr, int hdr_len,
+                                               const void *payload, int payload_len, void *user),
+                    void *transmit_user)
+{
+    lcmlite_init(lcm, NULL, transmit_user);
+    lcm->transmit_packet_sg = transmit_packet_sg;
+
     return 0;
 }
 
@@ -147,7 +290,7 @@ int lcmlite_receive_packet(lcmlite_t *lcm, const void *_buf, int buf_len, uint64
 
     } else if (magic == MAGIC_LCM3) {
 
-        if (LCM3_NUM_BUFFERS == 0)
+        if (LCM3_TOTAL_BUFFERS == 0)
             return -3;
 
         uint32_t msg_seq = decode_u32(&buf[buf_pos]);           buf_pos += 4;
@@ -158,10 +301,23 @@ int lcmlite_receive_packet(lcmlite_t *lcm, const void *_buf, int buf_len, uint64
 
         int payload_len = buf_len - buf_pos;
 
+        // the first fragment starts with the channel name
+        if (fragment_id == 0) {
+            const uint8_t *channel_end = memchr(&buf[buf_pos], 0, payload_len);
+            if (channel_end == NULL)
+                return -8;
+            payload_len -= channel_end - &buf[buf_pos] + 1;
+        }
+
         // printf("%08x:%08x %d / %d\n", from_addr, msg_seq, fragment_id, fragments_in_msg);
 
         // validate packet metadata
-        if (msg_size > LCM3_MAX_PACKET_SIZE)
+        int fits = 0;
+        for (int c = 0; c < LCM3_NUM_SIZE_CLASSES; c++) {
+            if (size_class_count[c] > 0 && size_class_size[c] >= msg_size)
+                fits = 1;
+        }
+        if (!fits)
             return -4;
 
         if (fragments_in_msg > LCM3_MAX_FRAGMENTS)
@@ -170,57 +326,44 @@ int lcmlite_receive_packet(lcmlite_t *lcm, const void *_buf, int buf_len, uint64
         if (fragment_id >= fragments_in_msg || fragment_offset + payload_len > msg_size)
             return -6;
 
-        // find the fragment. Use a simple linear search; this is
-        // cheap in comparison to how much work we're spending to
-        // decode the large packet...
-        struct fragment_buffer *fbuf = NULL;
-
         // try to find a reassembly buffer for this from_addr that's already in progress
-        for (int idx = 0; idx < LCM3_NUM_BUFFERS; idx++) {
-
-            if (lcm->fragment_buffers[idx].from_addr == from_addr &&
-                lcm->fragment_buffers[idx].msg_seq == msg_seq) {
-                fbuf = &lcm->fragment_buffers[idx];
-                break;
-            }
-        }
+        int idx = lookup_find(lcm, from_addr, msg_seq);
+        struct fragment_buffer *fbuf;
 
-        if (fbuf == NULL) {
-            // didn't find one. Pick a new buffer to use.
+        if (idx >= 0) {
+            fbuf = &lcm->fragment_buffers[idx];
 
-            // Priorities:
-            //   1) an idle (complete) buffer
-            //   2) the incomplete buffer that received a valid fragment the longest time ago.
-            int32_t max_age = -1; // low scores are good.
-            for (int idx = 0; idx < LCM3_NUM_BUFFERS; idx++) {
-                if (lcm->fragment_buffers[idx].fragments_remaining == 0) {
-                    fbuf = &lcm->fragment_buffers[idx];
-                    break;
-                } else {
-                    int32_t age = lcm->last_fragment_count - lcm->fragment_buffers[idx].last_fragment_count;
-                    if (age > max_age) {
-                        fbuf = &lcm->fragment_buffers[idx];
-                        max_age = age;
-                    }
-                }
-            }
+            // the sender's fragments disagree with each other
+            if (fbuf->msg_size != msg_size)
+                return -6;
 
-            if (fbuf == NULL)
+            lru_remove(lcm, idx);
+        } else {
+            // didn't find one. Pick a new buffer to use.
+            idx = fragment_buffer_acquire(lcm, msg_size);
+            if (idx < 0)
                 return -7; // this should never happen
 
+            fbuf = &lcm->fragment_buffers[idx];
+
             // initialize the fragment buffer
-            for (int i = 0; i < fragments_in_msg; i++) {
-                fbuf->frag_received[i] = 0;
-            }
+            memset(fbuf->frag_received, 0, sizeof(fbuf->frag_received));
 
             fbuf->from_addr = from_addr;
             fbuf->msg_seq = msg_seq;
+            fbuf->msg_size = msg_size;
             fbuf->fragments_remaining = fragments_in_msg;
+            fbuf->channel[0] = 0;
+
+            int slot = lookup_slot(from_addr, msg_seq);
+            fbuf->lookup_next = lcm->lookup[slot];
+            lcm->lookup[slot] = idx;
         }
 
         // now, handle this fragment
         fbuf->last_fragment_count = lcm->last_fragment_count;
         lcm->last_fragment_count++;
+        lru_append(lcm, idx);
 
         if (fragment_id == 0) {
             // this fragment contains the channel name plus data
@@ -238,12 +381,18 @@ int lcmlite_receive_packet(lcmlite_t *lcm, const void *_buf, int buf_len, uint64
             memcpy(&fbuf->buf[fragment_offset], &buf[buf_pos], buf_len - buf_pos);
 
         // record reception of this packet
-        if (fbuf->frag_received[fragment_id] == 0) {
-            fbuf->frag_received[fragment_id] = 1;
+        uint8_t frag_bit = 1 << (fragment_id & 7);
+        if ((fbuf->frag_received[fragment_id >> 3] & frag_bit) == 0) {
+            fbuf->frag_received[fragment_id >> 3] |= frag_bit;
             fbuf->fragments_remaining--;
 
             if (fbuf->fragments_remaining == 0) {
                 deliver_packet(lcm, fbuf->channel, fbuf->buf, msg_size);
+
+                // the buffer is idle again
+                lookup_remove(lcm, idx);
+                lru_remove(lcm, idx);
+                free_push(lcm, idx);
             }
         }
     }
@@ -257,9 +406,27 @@ void lcmlite_subscribe(lcmlite_t *lcm, lcmlite_subscription_t *sub)
     lcm->first_subscription = sub;
 }
 
+// Sends the header that is in the publish buffer followed by a slice of
+// the payload, as one packet.
+static void transmit(lcmlite_t *lcm, uint32_t hdr_len, const void *payload, uint32_t payload_len)
+{
+    if (lcm->transmit_packet_sg) {
+        lcm->transmit_packet_sg(lcm->publish_buffer, hdr_len, payload, payload_len, lcm->transmit_user);
+        return;
+    }
+
+    memcpy(&lcm->publish_buffer[hdr_len], payload, payload_len);
+    lcm->transmit_packet(lcm->publish_buffer, hdr_len + payload_len, lcm->transmit_user);
+}
+
 int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int buf_len)
 {
-    if (buf_len < LCM_PUBLISH_BUFFER_SIZE - MAXIMUM_HEADER_LENGTH) {
+    // without scatter-gather, header and payload must fit in the publish buffer
+    uint32_t max_payload_size = lcm->transmit_packet_sg ?
+        LCM_SG_MAX_PACKET_SIZE - MAXIMUM_HEADER_LENGTH :
+        LCM_PUBLISH_BUFFER_SIZE - MAXIMUM_HEADER_LENGTH;
+
+    if (buf_len < max_payload_size) {
         // publish non-fragmented message
         uint32_t buf_pos = 0;
 
@@ -274,9 +441,7 @@ int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int b
         }
         lcm->publish_buffer[buf_pos++] =0 ;
 
-        memcpy(&lcm->publish_buffer[buf_pos], _buf, buf_len);       buf_pos += buf_len;
-
-        lcm->transmit_packet(lcm->publish_buffer, buf_pos, lcm->transmit_user);
+        transmit(lcm, buf_pos, _buf, buf_len);
 
         return 0;
     } else {
@@ -285,10 +450,13 @@ int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int b
         lcm->msg_seq++;
 
         uint32_t fragment_offset = 0;
-        uint32_t max_fragment_size = LCM_PUBLISH_BUFFER_SIZE - MAXIMUM_HEADER_LENGTH;
+        uint32_t max_fragment_size = max_payload_size;
         uint32_t fragment_id = 0;
         uint32_t fragments_in_msg = (buf_len + max_fragment_size - 1) / max_fragment_size;
 
+        if (fragments_in_msg > 65535)
+            return -1;
+
         while (fragment_offset < buf_len) {
             uint32_t buf_pos = 0;
 
@@ -312,10 +480,7 @@ int lcmlite_publish(lcmlite_t *lcm, const char *channel, const void *_buf, int b
             if (this_fragment_size > max_fragment_size)
                 this_fragment_size = max_fragment_size;
 
-            memcpy(&lcm->publish_buffer[buf_pos], &((char*) _buf)[fragment_offset], this_fragment_size);
-            buf_pos += this_fragment_size;
-
-            lcm->transmit_packet(lcm->publish_buffer, buf_pos, lcm->transmit_user);
+            transmit(lcm, buf_pos, &((const char*) _buf)[fragment_offset], this_fragment_size);
 
             fragment_offset += this_fragment_size;
             fragment_id++;
@@ -29,23 +29,79 @@
  * the defines below.
  **/
 
-// Disable long packet reception by setting NUM BUFFERS to zero.
+// Fragmented (LCM3) messages are reassembled in buffers of three size
+// classes, whose number and size are set independently, so that memory
+// isn't spent on buffers of the maximum size for messages that are only
+// somewhat too large for a single packet. A message uses a buffer of the
+// smallest class that can hold it, or of a larger class if those are all
+// in use. When every usable buffer is in use, the one that least recently
+// received a fragment is reused.
+//
+// Disable long packet reception by setting all of the NUM BUFFERS to zero.
 // Total memory allocated is roughly:
 //
-// NUM_BUFFERS*(MAX_PACKET_SIZE + MAX_FRAGMENTS + CHANNEL_LENGTH) + PUBLISH_BUFFER_SIZE
+// NUM_SMALL_BUFFERS*SMALL_PACKET_SIZE + NUM_MEDIUM_BUFFERS*MEDIUM_PACKET_SIZE +
+// NUM_BUFFERS*MAX_PACKET_SIZE +
+// TOTAL_BUFFERS*(MAX_FRAGMENTS/8 + CHANNEL_LENGTH) + PUBLISH_BUFFER_SIZE
 //
 // Note that for full LCM compatibility, CHANNEL_LENGTH must be 256.
 //
+// Each of these can be overridden on the compiler command line.
+//
+#ifndef LCM3_NUM_SMALL_BUFFERS
+#define LCM3_NUM_SMALL_BUFFERS 0
+#endif
+#ifndef LCM3_SMALL_PACKET_SIZE
+#define LCM3_SMALL_PACKET_SIZE (16384)
+#endif
+
+#ifndef LCM3_NUM_MEDIUM_BUFFERS
+#define LCM3_NUM_MEDIUM_BUFFERS 0
+#endif
+#ifndef LCM3_MEDIUM_PACKET_SIZE
+#define LCM3_MEDIUM_PACKET_SIZE (65536)
+#endif
+
+#ifndef LCM3_NUM_BUFFERS
 #define LCM3_NUM_BUFFERS 4
+#endif
+#ifndef LCM3_MAX_PACKET_SIZE
 #define LCM3_MAX_PACKET_SIZE (300000)
+#endif
+
 #define LCM3_MAX_FRAGMENTS 256
 
+#define LCM3_NUM_SIZE_CLASSES 3
+#define LCM3_TOTAL_BUFFERS \
+    (LCM3_NUM_SMALL_BUFFERS + LCM3_NUM_MEDIUM_BUFFERS + LCM3_NUM_BUFFERS)
+#define LCM3_STORAGE_SIZE                                  \
+    (LCM3_NUM_SMALL_BUFFERS * LCM3_SMALL_PACKET_SIZE +     \
+     LCM3_NUM_MEDIUM_BUFFERS * LCM3_MEDIUM_PACKET_SIZE +   \
+     LCM3_NUM_BUFFERS * LCM3_MAX_PACKET_SIZE)
+
+// Buffers in progress are found by sender and sequence number in a hash
+// table of this many entries, which must be a power of two.
+#ifndef LCM3_LOOKUP_SIZE
+#define LCM3_LOOKUP_SIZE 16
+#endif
+
 #define LCM_MAX_CHANNEL_LENGTH 256
 
 // LCMLite will allocate a single buffer of the size below for
 // publishing messages. The LCM3 fragmentation option will be used to
 // send messages larger than this.
+//
+// With a scatter-gather transmit function (see lcmlite_init_sg), the
+// buffer only holds packet headers, so it can be as small as
+// MAXIMUM_HEADER_LENGTH (300), and packets are instead limited to
+// LCM_SG_MAX_PACKET_SIZE.
+#ifndef LCM_PUBLISH_BUFFER_SIZE
 #define LCM_PUBLISH_BUFFER_SIZE 8192
+#endif
+
+#ifndef LCM_SG_MAX_PACKET_SIZE
+#define LCM_SG_MAX_PACKET_SIZE 65000
+#endif
 
 typedef struct lcmlite_subscription lcmlite_subscription_t;
 typedef struct lcmlite lcmlite_t;
@@ -56,11 +112,21 @@ struct fragment_buffer
 
     uint64_t from_addr;
     uint32_t msg_seq;
+    uint32_t msg_size;
 
     char channel[LCM_MAX_CHANNEL_LENGTH];
     int fragments_remaining;
-    char buf[LCM3_MAX_PACKET_SIZE];
-    uint8_t frag_received[LCM3_MAX_FRAGMENTS];
+    uint8_t frag_received[LCM3_MAX_FRAGMENTS / 8]; // bit per fragment
+
+    char *buf; // points into lcmlite_t.fragment_storage
+    uint8_t size_class;
+
+    // indices into lcmlite_t.fragment_buffers, or -1: the next buffer in
+    // the same lookup slot, and the neighbours in the free list or LRU
+    // list of the size class.
+    int16_t lookup_next;
+    int16_t list_prev;
+    int16_t list_next;
 };
 
 struct lcmlite_subscription
@@ -76,8 +142,20 @@ struct lcmlite_subscription
 
 struct lcmlite
 {
-    /** Buffers for reassembling multi-fragment messages. **/
-    struct fragment_buffer fragment_buffers[LCM3_NUM_BUFFERS];
+    /** Buffers for reassembling multi-fragment messages, and their
+        storage, ordered by size class. **/
+    struct fragment_buffer fragment_buffers[LCM3_TOTAL_BUFFERS];
+    char fragment_storage[LCM3_STORAGE_SIZE];
+
+    /** For each size class, a list of idle buffers, and a list of the
+        buffers in progress from the least to the most recently
+        used. **/
+    int16_t free_head[LCM3_NUM_SIZE_CLASSES];
+    int16_t lru_head[LCM3_NUM_SIZE_CLASSES];
+    int16_t lru_tail[LCM3_NUM_SIZE_CLASSES];
+
+    /** Buffers in progress, by hash of sender and sequence number. **/
+    int16_t lookup[LCM3_LOOKUP_SIZE];
 
     /** every time we receive a fragment, we increment this counter
         and write the value to the corresponding fragment buffer. This
@@ -87,6 +165,8 @@ struct lcmlite
     int32_t last_fragment_count;
 
     void (*transmit_packet)(const void *_buf, int buf_len, void *user);
+    void (*transmit_packet_sg)(const void *hdr, int hdr_len,
+                               const void *payload, int payload_len, void *user);
     void *transmit_user;
 
     uint8_t publish_buffer[LCM_PUBLISH_BUFFER_SIZE];
@@ -98,6 +178,16 @@ struct lcmlite
 // Caller allocates the lcmlite_t object, which we initialize.
 int lcmlite_init(lcmlite_t *lcm, void (*transmit_packet)(const void *_buf, int buf_len, void *user), void *transmit_user);
 
+// Like lcmlite_init, but packets are handed to transmit_packet_sg as two
+// pieces that must be sent as one UDP packet (e.g., with sendmsg() and two
+// iovecs, or by chaining two buffers of a network stack): the header,
+// which is in lcmlite's publish buffer, and a slice of the buffer that was
+// given to lcmlite_publish. The payload is never copied by lcmlite.
+int lcmlite_init_sg(lcmlite_t *lcm,
+                    void (*transmit_packet_sg)(const void *hdr, int hdr_len,
+                                               const void *payload, int payload_len, void *user),
+                    void *transmit_user);
+
 // The user is responsible for creating and listening on a UDP
 // multicast socket. When a packet is received, call this function. Do
 // not call this function from more than one thread at a time. Returns
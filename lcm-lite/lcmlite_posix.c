@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -32,6 +33,29 @@ void transmit_packet(const void *_buf, int buf_len, void *user)
         perror("transmit_packet: sendto");
 }
 
+// Sends the header and payload as one packet without copying them.
+void transmit_packet_sg(const void *hdr, int hdr_len, const void *payload, int payload_len, void *user)
+{
+    struct transmit_info *tinfo = (struct transmit_info*) user;
+
+    struct iovec iov[2];
+    iov[0].iov_base = (void*) hdr;
+    iov[0].iov_len = hdr_len;
+    iov[1].iov_base = (void*) payload;
+    iov[1].iov_len = payload_len;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &tinfo->send_addr;
+    msg.msg_namelen = sizeof(tinfo->send_addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    ssize_t res = sendmsg(tinfo->send_fd, &msg, 0);
+    if (res < 0)
+        perror("transmit_packet_sg: sendmsg");
+}
+
 static void abc_callback(lcmlite_t *lcm, const char *channel, const void *buf, int buf_len, void *user)
 {
     int8_t v = 17;
@@ -122,7 +146,9 @@ int main(int argc, char *argv[])
     struct transmit_info tinfo;
     tinfo.send_addr = send_addr;
     tinfo.send_fd = send_fd;
-    lcmlite_init(&lcm, transmit_packet, &tinfo);
+    // lcmlite_init(&lcm, transmit_packet, &tinfo) works as well, but
+    // copies every packet into the publish buffer.
+    lcmlite_init_sg(&lcm, transmit_packet_sg, &tinfo);
 
     // subscribe to LCM messages
     if (1) {
@@ -34,6 +34,16 @@ typedef struct _signal_pipe {
 static signal_pipe_t g_sp;
 static int g_sp_initialized = 0;
 
+// handlers of signals that have one of their own
+#define MAX_SIGNAL_HANDLERS 8
+typedef struct {
+    int sig;
+    signal_pipe_glib_handler_t func;
+    void *userdata;
+} signal_handler_t;
+static signal_handler_t g_sp_handlers[MAX_SIGNAL_HANDLERS];
+static int g_sp_num_handlers = 0;
+
 extern GMainLoop *_mainloop;
 
 int 
@@ -88,6 +98,13 @@ signal_handler_glib (GIOChannel *source, GIOCondition condition, void *ud)
         return TRUE;
     }
 
+    for (int i = 0; i < g_sp_num_handlers; i++) {
+        if (g_sp_handlers[i].sig == signum) {
+            g_sp_handlers[i].func (signum, g_sp_handlers[i].userdata);
+            return TRUE;
+        }
+    }
+
     if (g_sp.userfunc) {
         g_sp.userfunc (signum, g_sp.userdata);
     }
@@ -118,6 +135,23 @@ signal_pipe_add_signal (int sig)
     return;
 }
 
+int
+signal_pipe_add_glib_handler (int sig, signal_pipe_glib_handler_t func,
+        gpointer user_data)
+{
+    if (! g_sp_initialized) return -1;
+
+    if (g_sp_num_handlers == MAX_SIGNAL_HANDLERS) return -1;
+
+    g_sp_handlers[g_sp_num_handlers].sig = sig;
+    g_sp_handlers[g_sp_num_handlers].func = func;
+    g_sp_handlers[g_sp_num_handlers].userdata = user_data;
+    g_sp_num_handlers++;
+    signal_pipe_add_signal (sig);
+
+    return 0;
+}
+
 int 
 signal_pipe_attach_glib (signal_pipe_glib_handler_t func, gpointer user_data)
 {
@@ -25,6 +25,12 @@ void signal_pipe_add_signal (int sig);
 int signal_pipe_attach_glib (signal_pipe_glib_handler_t user_func, 
         gpointer user_data);
 
+// catches signal with signal_pipe, like signal_pipe_add_signal, but calls
+// user_func for it instead of the handler set by signal_pipe_attach_glib.
+// Call after signal_pipe_init.
+int signal_pipe_add_glib_handler (int sig, signal_pipe_glib_handler_t user_func,
+        gpointer user_data);
+
 // convenience function to setup a signal handler that calls
 // signal_pipe_init, and adds a signal handler that automatically call
 // g_main_loop_quit (mainloop) on receiving SIGTERM, SIGINT, or SIGHUP.
@@ -0,0 +1,696 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#include <lcm/lcm.h>
+#include <lcm/lcm_clock.h>
+#include <lcm/lcmtypes/lcm_stats_report_t.h>
+
+// Serves the health of an LCM network over HTTP, in the OpenMetrics text
+// format that Prometheus scrapes.  Three kinds of metrics are exported:
+//  - per channel counts, rates and arrival jitter, measured by subscribing.
+//    Payloads are never decoded.
+//  - the receive statistics of the exporter's own LCM instance, which include
+//    the messages lost, reordered and duplicated on the network.
+//  - the reports that LCM instances created with the stats_interval option
+//    publish on LCM_STATS, one set of metrics per sending process.
+
+#define DEFAULT_PORT 9112
+#define DEFAULT_MAX_CHANNELS 1000
+#define MAX_REQUEST_SIZE 8192
+// how long a scraper may take to send its request or read the response
+#define CLIENT_TIMEOUT_MS 1000
+// rates are measured over windows of this length
+#define RATE_INTERVAL_US 1000000
+// processes whose reports stopped are forgotten after this long
+#define NODE_EXPIRE_US (300 * (int64_t) 1000000)
+
+typedef struct _channel_stats channel_stats_t;
+struct _channel_stats {
+    int64_t num_msgs;
+    int64_t num_bytes;
+    int64_t last_utime;
+    // interval between the last two messages, or -1 before the second one
+    int64_t last_interval_us;
+    // smoothed variation of the interval between messages, as RFC 3550
+    // computes it for RTP packets
+    double jitter_us;
+
+    // counts at the start of the current rate window
+    int64_t window_msgs;
+    int64_t window_bytes;
+    double msg_rate;
+    double byte_rate;
+};
+
+typedef struct _node_stats node_stats_t;
+struct _node_stats {
+    lcm_stats_report_t report;
+    int64_t recv_utime;
+};
+
+typedef struct _exporter exporter_t;
+struct _exporter {
+    lcm_t *lcm;
+    int stats_only;
+    unsigned int max_channels;
+
+    GHashTable *channels;     // char * -> channel_stats_t *
+    GHashTable *nodes;        // "host:pid" -> node_stats_t *
+    int64_t num_untracked_msgs;
+    int64_t num_bad_reports;
+    int64_t num_scrapes;
+
+    int64_t window_start_us;
+};
+
+static volatile sig_atomic_t _quit = 0;
+
+static void
+quit_handler (int signum)
+{
+    _quit = 1;
+}
+
+static void
+node_stats_destroy (void *p)
+{
+    node_stats_t *node = (node_stats_t *) p;
+    lcm_stats_report_t_decode_cleanup (&node->report);
+    free (node);
+}
+
+static void
+handle_stats_report (exporter_t *exp, const lcm_recv_buf_t *rbuf)
+{
+    lcm_stats_report_t report;
+    if (lcm_stats_report_t_decode (rbuf->data, 0, rbuf->data_size,
+                &report) < 0) {
+        exp->num_bad_reports++;
+        return;
+    }
+
+    char *key = g_strdup_printf ("%s:%d", report.host, report.pid);
+    node_stats_t *node = (node_stats_t *) g_hash_table_lookup (exp->nodes,
+            key);
+    if (node) {
+        lcm_stats_report_t_decode_cleanup (&node->report);
+        g_free (key);
+    } else {
+        node = (node_stats_t *) calloc (1, sizeof (node_stats_t));
+        g_hash_table_insert (exp->nodes, key, node);
+    }
+    node->report = report;
+    node->recv_utime = rbuf->recv_utime;
+}
+
+static void
+on_message (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    exporter_t *exp = (exporter_t *) user;
+
+    if (!strcmp (channel, LCM_STATS_CHANNEL))
+        handle_stats_report (exp, rbuf);
+    if (exp->stats_only)
+        return;
+
+    channel_stats_t *cs = (channel_stats_t *) g_hash_table_lookup (
+            exp->channels, channel);
+    if (!cs) {
+        if (g_hash_table_size (exp->channels) >= exp->max_channels) {
+            exp->num_untracked_msgs++;
+            return;
+        }
+        cs = (channel_stats_t *) calloc (1, sizeof (channel_stats_t));
+        cs->last_interval_us = -1;
+        g_hash_table_insert (exp->channels, g_strdup (channel), cs);
+    } else {
+        int64_t interval = rbuf->recv_utime - cs->last_utime;
+        if (cs->last_interval_us >= 0) {
+            double d = fabs ((double) (interval - cs->last_interval_us));
+            cs->jitter_us += (d - cs->jitter_us) / 16;
+        }
+        cs->last_interval_us = interval;
+    }
+    cs->num_msgs++;
+    cs->num_bytes += rbuf->data_size;
+    cs->last_utime = rbuf->recv_utime;
+}
+
+// Closes a rate window and drops the processes that stopped reporting.
+static void
+update_rates (exporter_t *exp)
+{
+    int64_t now = lcm_clock_monotonic_us ();
+    double dt = (now - exp->window_start_us) / 1e6;
+    if (dt * 1e6 < RATE_INTERVAL_US)
+        return;
+    exp->window_start_us = now;
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, exp->channels);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        channel_stats_t *cs = (channel_stats_t *) value;
+        cs->msg_rate = (cs->num_msgs - cs->window_msgs) / dt;
+        cs->byte_rate = (cs->num_bytes - cs->window_bytes) / dt;
+        cs->window_msgs = cs->num_msgs;
+        cs->window_bytes = cs->num_bytes;
+    }
+
+    int64_t expire_utime = lcm_clock_realtime_us () - NODE_EXPIRE_US;
+    g_hash_table_iter_init (&iter, exp->nodes);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        if (((node_stats_t *) value)->recv_utime < expire_utime)
+            g_hash_table_iter_remove (&iter);
+    }
+}
+
+// Appends a label value, escaped as the exposition format requires.
+static void
+append_label_value (GString *out, const char *value)
+{
+    for (const char *p = value; *p; p++) {
+        switch (*p) {
+            case '\\': g_string_append (out, "\\\\"); break;
+            case '"':  g_string_append (out, "\\\""); break;
+            case '\n': g_string_append (out, "\\n"); break;
+            default:   g_string_append_c (out, *p); break;
+        }
+    }
+}
+
+static void
+append_family (GString *out, const char *name, const char *type,
+        const char *help)
+{
+    g_string_append_printf (out, "# TYPE %s %s\n# HELP %s %s\n", name, type,
+            name, help);
+}
+
+static void
+append_channel_family (GString *out, exporter_t *exp, const char *name,
+        const char *type, const char *help, size_t offset, int is_double,
+        double scale)
+{
+    append_family (out, name, type, help);
+    const char *suffix = strcmp (type, "counter") ? "" : "_total";
+
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, exp->channels);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        const char *field = (const char *) value + offset;
+        g_string_append_printf (out, "%s%s{channel=\"", name, suffix);
+        append_label_value (out, (const char *) key);
+        if (is_double)
+            g_string_append_printf (out, "\"} %.9g\n",
+                    *(const double *) field * scale);
+        else if (scale != 1)
+            g_string_append_printf (out, "\"} %.6f\n",
+                    *(const int64_t *) field * scale);
+        else
+            g_string_append_printf (out, "\"} %" PRId64 "\n",
+                    *(const int64_t *) field);
+    }
+}
+
+static void
+append_value (GString *out, const char *name, const char *type,
+        const char *help, double value)
+{
+    append_family (out, name, type, help);
+    g_string_append_printf (out, "%s%s %.9g\n", name,
+            strcmp (type, "counter") ? "" : "_total", value);
+}
+
+#define NODE_FIELD_INT64(field) \
+    offsetof (lcm_stats_report_t, field), sizeof (int64_t)
+#define NODE_FIELD_INT32(field) \
+    offsetof (lcm_stats_report_t, field), sizeof (int32_t)
+#define NODE_FIELD_DOUBLE(field) \
+    offsetof (lcm_stats_report_t, field), 0
+
+typedef struct {
+    const char *name;
+    const char *type;
+    const char *help;
+    size_t offset;
+    // sizeof the integer field, or 0 for a double
+    size_t size;
+} node_metric_t;
+
+static const node_metric_t node_metrics[] = {
+    { "lcm_node_published_messages", "counter", "Messages published.",
+        NODE_FIELD_INT64 (num_published) },
+    { "lcm_node_published_bytes", "counter", "Bytes of messages published.",
+        NODE_FIELD_INT64 (bytes_published) },
+    { "lcm_node_publish_failures", "counter", "Publish calls that failed.",
+        NODE_FIELD_INT64 (num_publish_failed) },
+    { "lcm_node_received_messages", "counter",
+        "Messages delivered to subscriptions.",
+        NODE_FIELD_INT64 (num_received) },
+    { "lcm_node_received_bytes", "counter",
+        "Bytes of messages delivered to subscriptions.",
+        NODE_FIELD_INT64 (bytes_received) },
+    { "lcm_node_dropped_queue_full", "counter",
+        "Messages dropped because a subscription queue was full.",
+        NODE_FIELD_INT64 (num_dropped_queue_full) },
+    { "lcm_node_queued_messages", "gauge",
+        "Messages waiting for a handler.",
+        NODE_FIELD_INT32 (num_queued) },
+    { "lcm_node_wakeups", "counter",
+        "Times lcm_handle() went to the provider for messages.",
+        NODE_FIELD_INT64 (num_wakeups) },
+    { "lcm_node_packets", "counter", "Datagrams received.",
+        NODE_FIELD_INT64 (num_packets) },
+    { "lcm_node_packet_bytes", "counter", "Bytes of datagrams received.",
+        NODE_FIELD_INT64 (num_bytes) },
+    { "lcm_node_bad_packets", "counter", "Malformed datagrams discarded.",
+        NODE_FIELD_INT64 (num_bad_packets) },
+    { "lcm_node_lost_messages", "counter",
+        "Messages missing from the senders' sequence numbers.",
+        NODE_FIELD_INT64 (num_lost) },
+    { "lcm_node_reordered_messages", "counter",
+        "Messages that arrived after a later one from the same sender.",
+        NODE_FIELD_INT64 (num_reordered) },
+    { "lcm_node_duplicated_messages", "counter",
+        "Messages that arrived more than once.",
+        NODE_FIELD_INT64 (num_duplicated) },
+    { "lcm_node_incomplete_messages", "counter",
+        "Fragmented messages discarded with fragments missing.",
+        NODE_FIELD_INT64 (num_incomplete) },
+    { "lcm_node_dropped_no_buffer", "counter",
+        "Datagrams dropped because the receive buffer pool was full.",
+        NODE_FIELD_INT64 (num_dropped_no_buffer) },
+    { "lcm_node_senders", "gauge", "Senders tracked by the receiver.",
+        NODE_FIELD_INT32 (num_senders) },
+    { "lcm_node_ring_low_watermark_ratio", "gauge",
+        "Smallest free fraction of the receive buffer pool.",
+        NODE_FIELD_DOUBLE (ring_low_watermark) },
+    { "lcm_node_publish_queue_messages", "gauge",
+        "Messages in the asynchronous publish queue.",
+        NODE_FIELD_INT32 (tx_num_queued) },
+    { "lcm_node_publish_queue_dropped", "counter",
+        "Messages dropped by the asynchronous publish queue.",
+        NODE_FIELD_INT64 (tx_num_dropped) },
+};
+
+static void
+append_node_metrics (GString *out, exporter_t *exp)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+
+    append_family (out, "lcm_node_last_report_timestamp_seconds", "gauge",
+            "When the last report of the process was received.");
+    g_hash_table_iter_init (&iter, exp->nodes);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+        const node_stats_t *node = (const node_stats_t *) value;
+        g_string_append (out,
+                "lcm_node_last_report_timestamp_seconds{host=\"");
+        append_label_value (out, node->report.host);
+        g_string_append_printf (out, "\",pid=\"%d\"} %.6f\n",
+                node->report.pid, node->recv_utime / 1e6);
+    }
+
+    for (size_t i = 0; i < G_N_ELEMENTS (node_metrics); i++) {
+        const node_metric_t *m = &node_metrics[i];
+        append_family (out, m->name, m->type, m->help);
+        const char *suffix = strcmp (m->type, "counter") ? "" : "_total";
+
+        g_hash_table_iter_init (&iter, exp->nodes);
+        while (g_hash_table_iter_next (&iter, &key, &value)) {
+            const node_stats_t *node = (const node_stats_t *) value;
+            const char *field = (const char *) &node->report + m->offset;
+            g_string_append_printf (out, "%s%s{host=\"", m->name, suffix);
+            append_label_value (out, node->report.host);
+            g_string_append_printf (out, "\",pid=\"%d\"} ", node->report.pid);
+            if (m->size == sizeof (int64_t))
+                g_string_append_printf (out, "%" PRId64 "\n",
+                        *(const int64_t *) field);
+            else if (m->size == sizeof (int32_t))
+                g_string_append_printf (out, "%d\n", *(const int32_t *) field);
+            else
+                g_string_append_printf (out, "%.9g\n",
+                        *(const double *) field);
+        }
+    }
+}
+
+static GString *
+render_metrics (exporter_t *exp)
+{
+    GString *out = g_string_sized_new (16384);
+
+    if (!exp->stats_only) {
+        append_channel_family (out, exp, "lcm_channel_messages", "counter",
+                "Messages received on the channel.",
+                offsetof (channel_stats_t, num_msgs), 0, 1);
+        append_channel_family (out, exp, "lcm_channel_bytes", "counter",
+                "Payload bytes received on the channel.",
+                offsetof (channel_stats_t, num_bytes), 0, 1);
+        append_channel_family (out, exp, "lcm_channel_message_rate", "gauge",
+                "Messages per second over the last second.",
+                offsetof (channel_stats_t, msg_rate), 1, 1);
+        append_channel_family (out, exp, "lcm_channel_byte_rate", "gauge",
+                "Payload bytes per second over the last second.",
+                offsetof (channel_stats_t, byte_rate), 1, 1);
+        append_channel_family (out, exp,
+                "lcm_channel_interarrival_jitter_seconds", "gauge",
+                "Smoothed variation of the time between messages "
+                "(RFC 3550).",
+                offsetof (channel_stats_t, jitter_us), 1, 1e-6);
+        append_channel_family (out, exp,
+                "lcm_channel_last_message_timestamp_seconds", "gauge",
+                "When the last message on the channel was received.",
+                offsetof (channel_stats_t, last_utime), 0, 1e-6);
+        append_value (out, "lcm_exporter_channels", "gauge",
+                "Channels tracked.", g_hash_table_size (exp->channels));
+        append_value (out, "lcm_exporter_untracked_messages", "counter",
+                "Messages on channels beyond --max-channels.",
+                (double) exp->num_untracked_msgs);
+    }
+
+    lcm_stats_t stats;
+    if (lcm_get_stats (exp->lcm, &stats) == 0) {
+        append_value (out, "lcm_exporter_dropped_queue_full", "counter",
+                "Messages the exporter dropped because it fell behind.",
+                (double) stats.num_dropped_queue_full);
+        if (stats.has_transport_stats) {
+            const lcm_transport_stats_t *t = &stats.transport;
+            append_value (out, "lcm_transport_packets", "counter",
+                    "Datagrams received.", (double) t->num_packets);
+            append_value (out, "lcm_transport_bytes", "counter",
+                    "Bytes of datagrams received.", (double) t->num_bytes);
+            append_value (out, "lcm_transport_bad_packets", "counter",
+                    "Malformed datagrams discarded.",
+                    (double) t->num_bad_packets);
+            append_value (out, "lcm_transport_lost_messages", "counter",
+                    "Messages missing from the senders' sequence numbers.",
+                    (double) t->num_lost);
+            append_value (out, "lcm_transport_reordered_messages", "counter",
+                    "Messages that arrived after a later one from the same "
+                    "sender.", (double) t->num_reordered);
+            append_value (out, "lcm_transport_duplicated_messages", "counter",
+                    "Messages that arrived more than once.",
+                    (double) t->num_duplicated);
+            append_value (out, "lcm_transport_incomplete_messages", "counter",
+                    "Fragmented messages discarded with fragments missing.",
+                    (double) t->num_incomplete);
+            append_value (out, "lcm_transport_dropped_no_buffer", "counter",
+                    "Datagrams dropped because the receive buffer pool was "
+                    "full.", (double) t->num_dropped_no_buffer);
+            append_value (out, "lcm_transport_senders", "gauge",
+                    "Senders tracked by the receiver.", t->num_senders);
+            append_value (out, "lcm_transport_ring_low_watermark_ratio",
+                    "gauge", "Smallest free fraction of the receive buffer "
+                    "pool.", t->ring_low_watermark);
+        }
+    }
+
+    append_node_metrics (out, exp);
+    append_value (out, "lcm_exporter_bad_reports", "counter",
+            "Messages on " LCM_STATS_CHANNEL " that could not be decoded.",
+            (double) exp->num_bad_reports);
+    append_value (out, "lcm_exporter_scrapes", "counter",
+            "Metric requests served.", (double) exp->num_scrapes);
+
+    g_string_append (out, "# EOF\n");
+    return out;
+}
+
+static int
+send_all (int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send (fd, data, len, 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void
+send_response (int fd, const char *status, const char *content_type,
+        const char *body, size_t body_len)
+{
+    char *header = g_strdup_printf ("HTTP/1.1 %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %zu\r\n"
+            "Connection: close\r\n\r\n", status, content_type, body_len);
+    if (send_all (fd, header, strlen (header)) == 0)
+        send_all (fd, body, body_len);
+    g_free (header);
+}
+
+// Serves one scrape.  Requests are answered one at a time between calls to
+// lcm_handle(); meanwhile, received messages wait in the provider's buffers.
+static void
+serve_client (exporter_t *exp, int fd)
+{
+    struct timeval tv = { CLIENT_TIMEOUT_MS / 1000,
+        (CLIENT_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof (tv));
+
+    char request[MAX_REQUEST_SIZE + 1];
+    size_t len = 0;
+    while (len < MAX_REQUEST_SIZE) {
+        ssize_t n = recv (fd, request + len, MAX_REQUEST_SIZE - len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        len += n;
+        request[len] = 0;
+        if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+            break;
+    }
+    request[len] = 0;
+
+    // only the request line matters
+    char *eol = strpbrk (request, "\r\n");
+    if (eol)
+        *eol = 0;
+    char *method = request;
+    char *path = strchr (method, ' ');
+    if (!path) {
+        const char *msg = "Bad request\n";
+        send_response (fd, "400 Bad Request", "text/plain", msg, strlen (msg));
+        return;
+    }
+    *path++ = 0;
+    char *end = strpbrk (path, " ?");
+    if (end)
+        *end = 0;
+
+    if (strcmp (method, "GET")) {
+        const char *msg = "Only GET is supported\n";
+        send_response (fd, "405 Method Not Allowed", "text/plain", msg,
+                strlen (msg));
+    } else if (!strcmp (path, "/metrics")) {
+        exp->num_scrapes++;
+        GString *body = render_metrics (exp);
+        send_response (fd, "200 OK",
+                "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                body->str, body->len);
+        g_string_free (body, TRUE);
+    } else {
+        const char *msg = "The metrics are at /metrics\n";
+        send_response (fd, "404 Not Found", "text/plain", msg, strlen (msg));
+    }
+}
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...]\n\
+  Serves LCM traffic and health statistics to Prometheus.\n\
+\n\
+Options:\n\
+  -l, --lcm-url=URL      LCM URL to monitor.  Default is the LCM_DEFAULT_URL\n\
+                         environment variable, or udpm.\n\
+  -p, --port=PORT        HTTP port to listen on.  Default is %d.\n\
+  -b, --bind=ADDR        Address to listen on.  Default is all interfaces.\n\
+  -c, --channel=REGEX    Channels to measure.  Default is \".*\".\n\
+  -s, --stats-only       Only export the reports published on %s,\n\
+                         without subscribing to other channels.\n\
+  -m, --max-channels=N   Measure at most N channels.  Default is %d.\n\
+  -h, --help             Shows this help text and exits.\n\
+  \n", cmd, DEFAULT_PORT, LCM_STATS_CHANNEL, DEFAULT_MAX_CHANNELS);
+}
+
+int
+main (int argc, char ** argv)
+{
+    exporter_t exp;
+    memset (&exp, 0, sizeof (exp));
+    exp.max_channels = DEFAULT_MAX_CHANNELS;
+
+    char *lcmurl = NULL;
+    const char *channel_regex = ".*";
+    int port = DEFAULT_PORT;
+    struct in_addr bind_addr;
+    bind_addr.s_addr = htonl (INADDR_ANY);
+
+    struct option long_opts[] = {
+        { "help", no_argument, 0, 'h' },
+        { "lcm-url", required_argument, 0, 'l' },
+        { "port", required_argument, 0, 'p' },
+        { "bind", required_argument, 0, 'b' },
+        { "channel", required_argument, 0, 'c' },
+        { "stats-only", no_argument, 0, 's' },
+        { "max-channels", required_argument, 0, 'm' },
+        { 0, 0, 0, 0 }
+    };
+
+    int c;
+    char *endptr = NULL;
+    long n;
+    while ((c = getopt_long (argc, argv, "hl:p:b:c:sm:", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'l':
+                lcmurl = optarg;
+                break;
+            case 'p':
+                port = strtol (optarg, &endptr, 0);
+                if (*endptr || port <= 0 || port > 65535) {
+                    usage (argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if (!inet_aton (optarg, &bind_addr)) {
+                    fprintf (stderr, "Invalid address \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                channel_regex = optarg;
+                break;
+            case 's':
+                exp.stats_only = 1;
+                break;
+            case 'm':
+                n = strtol (optarg, &endptr, 0);
+                if (*endptr || n <= 0) {
+                    usage (argv[0]);
+                    return 1;
+                }
+                exp.max_channels = n;
+                break;
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    exp.lcm = lcm_create (lcmurl);
+    if (!exp.lcm) {
+        fprintf (stderr, "Couldn't initialize LCM!");
+        return 1;
+    }
+
+    signal (SIGPIPE, SIG_IGN);
+    signal (SIGINT, quit_handler);
+    signal (SIGTERM, quit_handler);
+
+    int listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror ("socket");
+        lcm_destroy (exp.lcm);
+        return 1;
+    }
+    int one = 1;
+    setsockopt (listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = bind_addr;
+    addr.sin_port = htons (port);
+    if (bind (listen_fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+            listen (listen_fd, 16) < 0) {
+        perror ("bind");
+        close (listen_fd);
+        lcm_destroy (exp.lcm);
+        return 1;
+    }
+
+    exp.channels = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+            free);
+    exp.nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+            node_stats_destroy);
+    exp.window_start_us = lcm_clock_monotonic_us ();
+
+    // the reports are always decoded, whether or not the regex matches them
+    char *pattern = exp.stats_only ? g_strdup (LCM_STATS_CHANNEL) :
+        g_strdup_printf ("(%s|%s)", channel_regex, LCM_STATS_CHANNEL);
+    lcm_subscription_t *sub = lcm_subscribe (exp.lcm, pattern, on_message,
+            &exp);
+    g_free (pattern);
+    if (!sub) {
+        fprintf (stderr, "Invalid channel regex \"%s\"\n", channel_regex);
+        close (listen_fd);
+        lcm_destroy (exp.lcm);
+        return 1;
+    }
+
+    printf ("LCM exporter serving http://%s:%d/metrics\n",
+            inet_ntoa (bind_addr), port);
+    fflush (stdout);
+
+    struct pollfd fds[2];
+    fds[0].fd = lcm_get_fileno (exp.lcm);
+    fds[0].events = POLLIN;
+    fds[1].fd = listen_fd;
+    fds[1].events = POLLIN;
+    while (!_quit) {
+        int status = poll (fds, 2, RATE_INTERVAL_US / 1000);
+        if (status < 0 && errno != EINTR) {
+            perror ("poll");
+            break;
+        }
+        if (status > 0 && (fds[0].revents & POLLIN))
+            lcm_handle (exp.lcm);
+        if (status > 0 && (fds[1].revents & POLLIN)) {
+            int fd = accept (listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                serve_client (&exp, fd);
+                close (fd);
+            }
+        }
+        update_rates (&exp);
+    }
+
+    lcm_unsubscribe (exp.lcm, sub);
+    close (listen_fd);
+    g_hash_table_destroy (exp.channels);
+    g_hash_table_destroy (exp.nodes);
+    lcm_destroy (exp.lcm);
+    return 0;
+}
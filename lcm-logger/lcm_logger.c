@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // for fallocate()
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
@@ -10,6 +11,7 @@
 #include <glib/gstdio.h>
 
 #include <lcm/lcm.h>
+#include <lcm/lcm_clock.h>
 
 // GRegex was new in GLib 2.14.0
 #if GLIB_CHECK_VERSION(2,14,0)
@@ -22,6 +24,8 @@
 #include <lcm/windows/WinPorting.h>
 #else
 #include <unistd.h> /* fdatasync */
+#include <fcntl.h>
+#include <sys/stat.h>
 #endif
 
 #include <inttypes.h>
@@ -36,6 +40,15 @@
 
 #define SECONDS_PER_HOUR 3600
 
+// How much is queued to one stripe before moving on to the next, see
+// --stripe
+#define STRIPE_BLOCK_SIZE (1 << 20)
+
+// What happens to the log file every flush interval, see --sync
+#define SYNC_FULL 0   // fdatasync() on the write thread
+#define SYNC_ASYNC 1  // fdatasync() on the sync thread, while writing goes on
+#define SYNC_NONE 2   // flush to the OS only
+
 GMainLoop *_mainloop;
 
 static int _reset_logfile = 0;
@@ -45,13 +58,62 @@ static inline int64_t timestamp_seconds(int64_t v)
     return v/1000000;
 }
 
-static inline int64_t timestamp_now(void)
+// Priority classes of channels, see --priority.  A message is only queued
+// while the queue is less full than the share of its class.
+#define PRIORITY_LOW 0
+#define PRIORITY_NORMAL 1
+#define PRIORITY_HIGH 2
+static const char *priority_names[] = { "low", "normal", "high" };
+static const double priority_queue_share[] = { 0.5, 0.9, 1.0 };
+
+// A --priority rule
+typedef struct {
+    GRegex *regex;
+    int priority;
+} priority_rule_t;
+
+// A --max-rate rule
+typedef struct {
+    GRegex *regex;
+    int64_t min_interval;  // usec between the messages kept
+} rate_rule_t;
+
+// What the message handler knows of a channel
+typedef struct {
+    int priority;
+    int trigger;  // whether it triggers a --flight-recorder dump
+    int64_t dropped;
+    // With --max-rate, messages received before next_utime are skipped, to
+    // keep one every min_interval usec
+    int64_t min_interval;
+    int64_t next_utime;
+    int64_t skipped;
+} channel_info_t;
+
+// A message in the write queue, followed by its NUL-terminated channel and
+// its data, and padded to a multiple of 8 bytes.
+typedef struct {
+    int64_t timestamp;
+    int32_t channellen;  // -1 marks the end of the ring
+    int32_t datalen;
+} queued_msg_t;
+
+static inline int64_t queued_msg_size(int channellen, int datalen)
 {
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    return (sizeof(queued_msg_t) + channellen + 1 + datalen + 7) & ~7;
 }
 
+// A log file opened ahead of time by the segment thread, see --preopen
+typedef struct segment segment_t;
+struct segment
+{
+    lcm_eventlog_t *log;
+    char fname[PATH_MAX];       // its name once it is written to
+    char temp_fname[PATH_MAX];  // with --rotate, its name until the log file
+                                // before it is rotated away, otherwise empty
+    segment_t *replaced_by;     // of a log file to close, the one after it
+};
+
 typedef struct logger logger_t;
 struct logger
 {
@@ -60,7 +122,13 @@ struct logger
     char    input_fname[PATH_MAX];
     char    fname[PATH_MAX];
     char    fname_prefix[PATH_MAX];
-    lcm_t    *lcm;
+    // the LCM instances of the --lcm-url options, all handled by the main
+    // loop
+    lcm_t    **lcms;
+    int num_lcms;
+    // with --tag-source, the channel of each message gets @N appended, N
+    // being the index of its LCM instance
+    int tag_source;
 
     int64_t max_write_queue_size;
     int auto_increment;
@@ -72,17 +140,34 @@ struct logger
     int rotate;
     int quiet;
     int append;
+    int index;
+    char *compress;
+    int direct_io;
+    int preallocate;
 
     GThread *write_thread;
-    GAsyncQueue *write_queue;
     GMutex * mutex;
+    GCond * write_cond;  // signaled when messages are queued, or on exit
+
+    // Received messages waiting to be written, in a ring of
+    // max_write_queue_size bytes.  Positions only grow, and are taken
+    // modulo the size.  Each message is contiguous: one that does not fit
+    // before the end of the ring starts over at the beginning.
+    uint8_t *ring;
 
     // variables for inverted matching (e.g., logging all but some channels)
     int invert_channels;
     GRegex * regex;
 
+    // these members controlled by the message handler
+    int64_t last_timestamp;     // of the last message queued
+    GPtrArray *priority_rules;  // priority_rule_t, first match wins
+    GPtrArray *rate_rules;      // rate_rule_t, first match wins
+    GHashTable *channels;       // channel name -> channel_info_t
+
     // these members controlled by mutex
-    int64_t write_queue_size;
+    int64_t ring_head;  // where the next message goes
+    int64_t ring_tail;  // the oldest message that is not written yet
     int write_thread_exit_flag;
 
     // these members controlled by write thread
@@ -97,8 +182,66 @@ struct logger
     int64_t dropped_packets_count;
     int64_t last_drop_report_utime;
     int64_t last_drop_report_count;
+
+    int64_t last_report_utime;  // monotonic time of the last summary
+
+    // CPUs and scheduling policy of the write thread, or NULL
+    char *write_cpu;
+    char *write_sched;
+
+    // syncing the log file to disk
+    int sync_mode;
+    GThread *sync_thread;
+    GMutex *sync_mutex;
+    GCond *sync_cond;  // signaled when a sync is requested, done, or on exit
+    // these members controlled by sync_mutex
+    int sync_fd;         // the file to sync, or -1 when there is nothing to do
+    int sync_busy;
+    int sync_exit;
+    GArray *sync_latencies;  // ms of each sync since the last summary
+
+    // opening and closing the log files of --split-mb, see --preopen
+    int preopen;
+    GThread *segment_thread;
+    GMutex *segment_mutex;
+    GCond *segment_cond;  // signaled when the queues change, or on exit
+    int next_temp_num;    // controlled by the segment thread
+    // these members controlled by segment_mutex
+    GQueue *ready_segments;   // segment_t, in the order they are used
+    GQueue *closed_segments;  // segment_t, whose log files are to be closed
+    int segment_failed;
+    int segment_exit;
+
+    // With --stripe, the loggers that each write a stripe, which the message
+    // handler queues messages to a block at a time
+    logger_t *stripes;
+    int num_stripes;
+    int next_stripe;
+    int64_t stripe_bytes;  // queued to the current stripe
+
+    // With --flight-recorder, the ring keeps the messages of the last
+    // flight_recorder_usec, and nothing is written until a dump is asked
+    // for.  The write thread then writes the messages from dump_pos up to
+    // dump_end to a new log file.  Messages older than dump_pos are evicted
+    // to make room, and the others are kept until they are written.
+    int64_t flight_recorder_usec;
+    GRegex *trigger_regex;
+    // these members controlled by mutex
+    int64_t dump_pos;
+    int64_t dump_end;
 };
 
+// Renames tomove to newname, if it exists
+static void
+rotate_logfile(const char* tomove, const char* newname)
+{
+    if(g_file_test(tomove, G_FILE_TEST_EXISTS)) {
+        if(0 != g_rename(tomove, newname)) {
+            fprintf(stderr, "ERROR!  Unable to rotate [%s]\n", tomove);
+        }
+    }
+}
+
 static void
 rotate_logfiles(logger_t* logger)
 {
@@ -106,31 +249,65 @@ rotate_logfiles(logger_t* logger)
         printf("Rotating log files\n");
     }
     // delete log files that have fallen off the end of the rotation
-    gchar* tomove = g_strdup_printf("%s.%d", logger->fname_prefix,
-            logger->rotate-1);
-    if(g_file_test(tomove, G_FILE_TEST_EXISTS)) {
-        if(0 != g_unlink(tomove)) {
-            fprintf(stderr, "ERROR! Unable to delete [%s]\n", tomove);
+    for(int i = 0; i < 2; i++) {
+        gchar* tomove = g_strdup_printf("%s.%d%s", logger->fname_prefix,
+                logger->rotate-1, i ? LCM_EVENTLOG_INDEX_SUFFIX : "");
+        if(g_file_test(tomove, G_FILE_TEST_EXISTS)) {
+            if(0 != g_unlink(tomove)) {
+                fprintf(stderr, "ERROR! Unable to delete [%s]\n", tomove);
+            }
         }
+        g_free(tomove);
     }
-    g_free(tomove);
 
     // Rotate away any existing log files
     for(int file_num = logger->rotate-1; file_num>=0; file_num--) {
         gchar* newname = g_strdup_printf("%s.%d", logger->fname_prefix, file_num);
-        tomove = g_strdup_printf("%s.%d", logger->fname_prefix, file_num-1);
-        if(g_file_test(tomove, G_FILE_TEST_EXISTS)) {
-            if(0 != g_rename(tomove, newname)) {
-                fprintf(stderr, "ERROR!  Unable to rotate [%s]\n", tomove);
-            }
-        }
+        gchar* tomove = g_strdup_printf("%s.%d", logger->fname_prefix, file_num-1);
+        rotate_logfile(tomove, newname);
+        g_free(newname);
+        g_free(tomove);
+        newname = g_strdup_printf("%s.%d%s", logger->fname_prefix, file_num,
+                LCM_EVENTLOG_INDEX_SUFFIX);
+        tomove = g_strdup_printf("%s.%d%s", logger->fname_prefix, file_num-1,
+                LCM_EVENTLOG_INDEX_SUFFIX);
+        rotate_logfile(tomove, newname);
         g_free(newname);
         g_free(tomove);
     }
 }
 
+// Renames a log file and its index, if they exist
+static void
+rename_logfile(const char* tomove, const char* newname)
+{
+    rotate_logfile(tomove, newname);
+    gchar* index_tomove = g_strdup_printf("%s%s", tomove,
+            LCM_EVENTLOG_INDEX_SUFFIX);
+    gchar* index_newname = g_strdup_printf("%s%s", newname,
+            LCM_EVENTLOG_INDEX_SUFFIX);
+    rotate_logfile(index_tomove, index_newname);
+    g_free(index_tomove);
+    g_free(index_newname);
+}
+
+// Deletes a log file and its index, if they exist
+static void
+remove_logfile(const char* fname)
+{
+    gchar* index_fname = g_strdup_printf("%s%s", fname,
+            LCM_EVENTLOG_INDEX_SUFFIX);
+    if(g_file_test(fname, G_FILE_TEST_EXISTS) && 0 != g_unlink(fname))
+        fprintf(stderr, "ERROR! Unable to delete [%s]\n", fname);
+    if(g_file_test(index_fname, G_FILE_TEST_EXISTS) &&
+            0 != g_unlink(index_fname))
+        fprintf(stderr, "ERROR! Unable to delete [%s]\n", index_fname);
+    g_free(index_fname);
+}
+
+// Picks the name of the next log file.  Returns 0 on success.
 static int
-open_logfile(logger_t* logger)
+next_logfile_name(logger_t* logger, char* fname)
 {
     // maybe run the filename through strftime
     if (logger->use_strftime) {
@@ -152,144 +329,566 @@ open_logfile(logger_t* logger)
         /* Loop through possible file names until we find one that doesn't
          * already exist.  This way, we never overwrite an existing file. */
         do {
-            snprintf(logger->fname, sizeof(logger->fname), "%s.%02d",
+            snprintf(fname, PATH_MAX, "%s.%02d",
                     logger->fname_prefix, logger->next_increment_num);
             logger->next_increment_num++;
-        } while(g_file_test(logger->fname, G_FILE_TEST_EXISTS));
+        } while(g_file_test(fname, G_FILE_TEST_EXISTS));
     } else if(logger->rotate > 0) {
-        snprintf(logger->fname, sizeof(logger->fname), "%s.0", logger->fname_prefix);
+        snprintf(fname, PATH_MAX, "%s.0", logger->fname_prefix);
     } else {
-        strcpy(logger->fname, logger->fname_prefix);
+        strcpy(fname, logger->fname_prefix);
         if (! (logger->force_overwrite || logger->append)) {
-            if (g_file_test(logger->fname, G_FILE_TEST_EXISTS))
+            if (g_file_test(fname, G_FILE_TEST_EXISTS))
             {
                 fprintf (stderr, "Refusing to overwrite existing file \"%s\"\n",
-                        logger->fname);
+                        fname);
                 return 1;
             }
         }
     }
 
+    return 0;
+}
+
+// Opens the log file fname the way the options ask for.  Returns NULL on
+// failure.
+static lcm_eventlog_t*
+open_log(logger_t* logger, const char* fname)
+{
     // create directories if needed
-    char *dirpart = g_path_get_dirname (logger->fname);
+    char *dirpart = g_path_get_dirname (fname);
     if (! g_file_test (dirpart, G_FILE_TEST_IS_DIR)) {
         mkdir_with_parents (dirpart, 0755);
     }
     g_free (dirpart);
 
-    if(!logger->quiet) {
-        printf("Opening log file \"%s\"\n", logger->fname);
-    }
-
     // open output file in append mode if we're rotating log files or appending
     // use write mode if not.
     const char* logmode = (logger->rotate > 0 || logger->append) ? "a" : "w";
-    logger->log = lcm_eventlog_create(logger->fname, logmode);
-    if (logger->log == NULL) {
+    lcm_eventlog_t* log = lcm_eventlog_create(fname, logmode);
+    if (log == NULL) {
         perror ("Error: fopen failed");
+        return NULL;
+    }
+    if (logger->compress &&
+            0 != lcm_eventlog_set_compression(log, logger->compress)) {
+        fprintf (stderr, "Unable to compress \"%s\"\n", fname);
+        lcm_eventlog_destroy(log);
+        return NULL;
+    }
+#ifndef WIN32
+    // events are batched into fewer system calls, and still written out
+    // every flush interval
+    int write_flags = LCM_EVENTLOG_WRITEV;
+    if (logger->direct_io)
+        write_flags |= LCM_EVENTLOG_DIRECT;
+    if (0 != lcm_eventlog_set_write_flags(log, write_flags) &&
+            logger->direct_io) {
+        fprintf (stderr, "Unable to write \"%s\" with direct I/O\n",
+                fname);
+        lcm_eventlog_destroy(log);
+        return NULL;
+    }
+#endif
+    if (logger->index && 0 != lcm_eventlog_enable_index(log)) {
+        // the log is still useful without an index
+        fprintf (stderr, "Unable to create the index of \"%s\"\n",
+                fname);
+    }
+#ifdef __linux__
+    // The blocks of the whole segment are reserved up front, without
+    // changing the size of the file.  Those left over are given back when it
+    // is closed.
+    off_t segment_size = (off_t) (logger->auto_split_mb * (1 << 20));
+    if (logger->preallocate && 0 != fallocate(fileno(log->f),
+                FALLOC_FL_KEEP_SIZE, 0, segment_size)) {
+        // the file then grows as it is written, like without --preallocate
+        fprintf (stderr, "Unable to preallocate \"%s\": %s\n", fname,
+                strerror(errno));
+    }
+#endif
+    return log;
+}
+
+// Closes a log file, and gives back the space preallocated past its end
+static void
+close_log(logger_t* logger, lcm_eventlog_t* log, const char* fname)
+{
+    lcm_eventlog_destroy(log);
+#ifdef __linux__
+    struct stat st;
+    if (logger->preallocate && 0 == stat(fname, &st) &&
+            0 != truncate(fname, st.st_size)) {
+        fprintf (stderr, "Unable to truncate \"%s\": %s\n", fname,
+                strerror(errno));
+    }
+#endif
+}
+
+static int
+open_logfile(logger_t* logger)
+{
+    if (0 != next_logfile_name(logger, logger->fname))
         return 1;
+    if(!logger->quiet) {
+        printf("Opening log file \"%s\"\n", logger->fname);
     }
-    return 0;
+    logger->log = open_log(logger, logger->fname);
+    return logger->log ? 0 : 1;
 }
 
+// Opens the next log file of the pool.  Returns NULL on failure.
+static segment_t*
+open_segment(logger_t* logger)
+{
+    segment_t* seg = g_new0(segment_t, 1);
+    if (0 != next_logfile_name(logger, seg->fname)) {
+        g_free(seg);
+        return NULL;
+    }
+    const char* path = seg->fname;
+    if (logger->rotate > 0) {
+        // FILE.0 is still being written to
+        snprintf(seg->temp_fname, sizeof(seg->temp_fname), "%s.next%d",
+                logger->fname_prefix, logger->next_temp_num++);
+        remove_logfile(seg->temp_fname);
+        path = seg->temp_fname;
+    }
+    seg->log = open_log(logger, path);
+    if (!seg->log) {
+        g_free(seg);
+        return NULL;
+    }
+    return seg;
+}
+
+// Closes a log file given up by the write thread, and puts the one that
+// replaced it in place
+static void
+close_segment(logger_t* logger, segment_t* seg)
+{
+    close_log(logger, seg->log, seg->fname);
+    segment_t* next = seg->replaced_by;
+    if (next->temp_fname[0]) {
+        rotate_logfiles(logger);
+        rename_logfile(next->temp_fname, next->fname);
+    }
+    g_free(next);
+    g_free(seg);
+}
+
+// Keeps --preopen log files ready for the write thread, and closes the ones
+// it is done with, so that neither happens on the write path
 static void*
-write_thread(void *user_data)
+segment_thread(void *user_data)
 {
     logger_t *logger = (logger_t*) user_data;
+    g_mutex_lock(logger->segment_mutex);
+    while(1) {
+        while(g_queue_is_empty(logger->closed_segments) &&
+                !logger->segment_exit && (logger->segment_failed ||
+                    g_queue_get_length(logger->ready_segments) >=
+                    (guint) logger->preopen))
+            g_cond_wait(logger->segment_cond, logger->segment_mutex);
+
+        // log files are closed before exiting
+        segment_t *seg = (segment_t*) g_queue_pop_head(logger->closed_segments);
+        if(seg) {
+            g_mutex_unlock(logger->segment_mutex);
+            close_segment(logger, seg);
+            g_mutex_lock(logger->segment_mutex);
+            continue;
+        }
+        if(logger->segment_exit)
+            break;
+
+        g_mutex_unlock(logger->segment_mutex);
+        seg = open_segment(logger);
+        g_mutex_lock(logger->segment_mutex);
+        if(seg)
+            g_queue_push_tail(logger->ready_segments, seg);
+        else
+            logger->segment_failed = 1;
+        g_cond_broadcast(logger->segment_cond);
+    }
+    g_mutex_unlock(logger->segment_mutex);
+    return NULL;
+}
+
+// Moves the write thread on to the next log file of the pool, and leaves the
+// current one to the segment thread
+static void
+switch_segment(logger_t *logger)
+{
+    g_mutex_lock(logger->segment_mutex);
+    // only waits if log files are needed faster than they are opened
+    while(g_queue_is_empty(logger->ready_segments) && !logger->segment_failed)
+        g_cond_wait(logger->segment_cond, logger->segment_mutex);
+    segment_t *next = (segment_t*) g_queue_pop_head(logger->ready_segments);
+    g_mutex_unlock(logger->segment_mutex);
+    if(!next)
+        exit(1);
+
+    segment_t *seg = g_new0(segment_t, 1);
+    seg->log = logger->log;
+    strcpy(seg->fname, logger->fname);
+    seg->replaced_by = next;
+    logger->log = next->log;
+    strcpy(logger->fname, next->fname);
+    if(!logger->quiet) {
+        printf("Opening log file \"%s\"\n", logger->fname);
+    }
+
+    g_mutex_lock(logger->segment_mutex);
+    g_queue_push_tail(logger->closed_segments, seg);
+    g_cond_broadcast(logger->segment_cond);
+    g_mutex_unlock(logger->segment_mutex);
+}
 
-    GTimeVal start_time;
-    g_get_current_time(&start_time);
-    int num_splits = 0;
 
+#ifndef WIN32
+// Runs the syncs requested by the write thread, one at a time
+static void*
+sync_thread(void *user_data)
+{
+    logger_t *logger = (logger_t*) user_data;
+    g_mutex_lock(logger->sync_mutex);
     while(1) {
-        void *msg = g_async_queue_pop(logger->write_queue);
+        while(logger->sync_fd < 0 && !logger->sync_exit)
+            g_cond_wait(logger->sync_cond, logger->sync_mutex);
+        if(logger->sync_fd < 0)
+            break;
+        int fd = logger->sync_fd;
+        logger->sync_fd = -1;
+        logger->sync_busy = 1;
+        g_mutex_unlock(logger->sync_mutex);
+
+        int64_t start = lcm_clock_monotonic_ns();
+        fdatasync(fd);
+        double ms = (lcm_clock_monotonic_ns() - start) / 1e6;
+
+        g_mutex_lock(logger->sync_mutex);
+        logger->sync_busy = 0;
+        g_array_append_val(logger->sync_latencies, ms);
+        g_cond_broadcast(logger->sync_cond);
+    }
+    g_mutex_unlock(logger->sync_mutex);
+    return NULL;
+}
+#endif
 
-        // Is it time to start a new logfile?
-        int split_log = 0;
-        if(logger->auto_split_mb) {
-          double logsize_mb = (double)logger->logsize / (1 << 20);
-          split_log = (logsize_mb > logger->auto_split_mb);
-        }
-        if(_reset_logfile) {
-            split_log = 1;
-            _reset_logfile = 0;
-        }
+// Makes the log file durable up to what has been flushed, or starts doing so
+static void
+sync_logfile(logger_t *logger)
+{
+#ifndef WIN32
+    int fd = fileno(logger->log->f);
+    if(logger->sync_mode == SYNC_FULL) {
+        int64_t start = lcm_clock_monotonic_ns();
+        fdatasync(fd);
+        double ms = (lcm_clock_monotonic_ns() - start) / 1e6;
+        g_mutex_lock(logger->sync_mutex);
+        g_array_append_val(logger->sync_latencies, ms);
+        g_mutex_unlock(logger->sync_mutex);
+    } else if(logger->sync_mode == SYNC_ASYNC) {
+        // A sync still running covers the flushes before it started.  A
+        // request made meanwhile is run once it is done.
+        g_mutex_lock(logger->sync_mutex);
+        logger->sync_fd = fd;
+        g_cond_broadcast(logger->sync_cond);
+        g_mutex_unlock(logger->sync_mutex);
+    }
+#endif
+}
+
+// Waits for the sync thread to be done with the log file, before it is
+// closed
+static void
+sync_wait_idle(logger_t *logger)
+{
+    if(!logger->sync_thread)
+        return;
+    g_mutex_lock(logger->sync_mutex);
+    while(logger->sync_fd >= 0 || logger->sync_busy)
+        g_cond_wait(logger->sync_cond, logger->sync_mutex);
+    g_mutex_unlock(logger->sync_mutex);
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return x < y ? -1 : x > y;
+}
+
+// Formats the percentiles of the sync latencies since the last summary into
+// buf, and starts over
+static void
+format_sync_latencies(logger_t *logger, char *buf, size_t size)
+{
+    g_mutex_lock(logger->sync_mutex);
+    GArray *latencies = logger->sync_latencies;
+    if(!latencies->len) {
+        g_mutex_unlock(logger->sync_mutex);
+        buf[0] = 0;
+        return;
+    }
+    double *ms = &g_array_index(latencies, double, 0);
+    qsort(ms, latencies->len, sizeof(double), compare_doubles);
+    snprintf(buf, size, "  Sync ms p50: %.1f p99: %.1f max: %.1f",
+            ms[latencies->len / 2], ms[latencies->len * 99 / 100],
+            ms[latencies->len - 1]);
+    g_array_set_size(latencies, 0);
+    g_mutex_unlock(logger->sync_mutex);
+}
+
+// Points le at a message in the queue, which it is written from
+static void
+queued_event(queued_msg_t *msg, lcm_eventlog_event_t *le)
+{
+    le->timestamp = msg->timestamp;
+    le->channellen = msg->channellen;
+    le->datalen = msg->datalen;
+    le->channel = (char*) (msg + 1);
+    le->data = le->channel + msg->channellen + 1;
+    // log_write_event will handle le.eventnum.
+}
 
-        if(split_log) {
-            // Yes.  open up a new log file
-            lcm_eventlog_destroy(logger->log);
+// Writes one queued message, after starting a new log file if it is time to
+static void
+write_message(logger_t *logger, queued_msg_t *msg)
+{
+    // Is it time to start a new logfile?
+    int split_log = 0;
+    if(logger->auto_split_mb) {
+      double logsize_mb = (double)logger->logsize / (1 << 20);
+      split_log = (logsize_mb > logger->auto_split_mb);
+    }
+    if(_reset_logfile) {
+        split_log = 1;
+        _reset_logfile = 0;
+    }
+
+    if(split_log) {
+        // Yes.  open up a new log file
+        sync_wait_idle(logger);
+        if(logger->segment_thread) {
+            switch_segment(logger);
+        } else {
+            close_log(logger, logger->log, logger->fname);
             if(logger->rotate > 0)
                 rotate_logfiles(logger);
             if(0 != open_logfile(logger))
               exit(1);
-            num_splits++;
-            logger->logsize = 0;
-            logger->last_report_logsize = 0;
         }
+        logger->logsize = 0;
+        logger->last_report_logsize = 0;
+    }
 
-        // Should the write thread exit?
-        g_mutex_lock(logger->mutex);
-        if(msg == &logger->write_thread_exit_flag) {
-            g_mutex_unlock(logger->mutex);
-            return NULL;
+    lcm_eventlog_event_t le;
+    queued_event(msg, &le);
+
+    if(0 != lcm_eventlog_write_event(logger->log, &le)) {
+        static int64_t last_spew_utime = 0;
+        char *reason = strdup(strerror(errno));
+        int64_t now = lcm_clock_monotonic_us();
+        if(now - last_spew_utime > 500000) {
+            fprintf(stderr, "lcm_eventlog_write_event: %s\n", reason);
+            last_spew_utime = now;
         }
-        // nope.  write the event to disk
-        lcm_eventlog_event_t *le = (lcm_eventlog_event_t*) msg;
-        int64_t sz = sizeof(lcm_eventlog_event_t) + le->channellen + 1 + le->datalen;
-        logger->write_queue_size -= sz;
+        free(reason);
+        if(errno == ENOSPC)
+            exit(1);
+        return;
+    }
+    if (logger->fflush_interval_ms >= 0 &&
+        (le.timestamp - logger->last_fflush_time) > logger->fflush_interval_ms*1000) {
+        lcm_eventlog_flush(logger->log);
+        sync_logfile(logger);
+        logger->last_fflush_time = le.timestamp;
+    }
+
+    // bookkeeping
+    int64_t offset_utime = le.timestamp - logger->time0;
+    logger->nevents++;
+    logger->events_since_last_report ++;
+    logger->logsize += 4 + 8 + 8 + 4 + le.channellen + 4 + le.datalen;
+
+    if (!logger->quiet && (offset_utime - logger->last_report_time > 1000000)) {
+        double dt = (offset_utime - logger->last_report_time)/1000000.0;
+
+        double tps =  logger->events_since_last_report / dt;
+        double kbps = (logger->logsize - logger->last_report_logsize) / dt / 1024.0;
+        // what the disk kept up with, by the clock
+        int64_t now = lcm_clock_monotonic_us();
+        double write_mbps = (logger->logsize - logger->last_report_logsize) /
+            ((now - logger->last_report_utime) / 1000000.0) / 1048576.0;
+        char sync_latencies[80];
+        format_sync_latencies(logger, sync_latencies, sizeof(sync_latencies));
+        printf("Summary: %s ti:%4"PRIi64"sec Events: %-9"PRIi64" ( %4"PRIi64" MB )      TPS: %8.2f       KB/s: %8.2f  Write MB/s: %7.2f%s\n",
+                logger->fname,
+                timestamp_seconds(offset_utime),
+                logger->nevents, logger->logsize/1048576,
+                tps, kbps, write_mbps, sync_latencies);
+        logger->last_report_time = offset_utime;
+        logger->last_report_utime = now;
+        logger->events_since_last_report = 0;
+        logger->last_report_logsize = logger->logsize;
+    }
+}
+
+static void*
+write_thread(void *user_data)
+{
+    logger_t *logger = (logger_t*) user_data;
+    if (logger->write_cpu || logger->write_sched)
+        lcm_set_thread_scheduling(logger->write_cpu, logger->write_sched);
+
+    int64_t tail = 0;
+    while(1) {
+        g_mutex_lock(logger->mutex);
+        // the rest of the queue is written before exiting
+        while(logger->ring_head == tail && !logger->write_thread_exit_flag)
+            g_cond_wait(logger->write_cond, logger->mutex);
+        int64_t head = logger->ring_head;
         g_mutex_unlock(logger->mutex);
+        if(head == tail)
+            return NULL;
 
-        if(0 != lcm_eventlog_write_event(logger->log, le)) {
-            static int64_t last_spew_utime = 0;
-            char *reason = strdup(strerror(errno));
-            int64_t now = timestamp_now();
-            if(now - last_spew_utime > 500000) {
-                fprintf(stderr, "lcm_eventlog_write_event: %s\n", reason);
-                last_spew_utime = now;
-            }
-            free(reason);
-            free(le);
-            if(errno == ENOSPC) {
-                exit(1);
+        // everything queued so far is written without taking the lock
+        while(tail < head) {
+            int64_t pos = tail % logger->max_write_queue_size;
+            int64_t left = logger->max_write_queue_size - pos;
+            queued_msg_t *msg = (queued_msg_t*) (logger->ring + pos);
+            if(left < (int64_t) sizeof(queued_msg_t) || msg->channellen < 0) {
+                tail += left;
             } else {
-                continue;
+                write_message(logger, msg);
+                tail += queued_msg_size(msg->channellen, msg->datalen);
+            }
+
+            // room is made as messages are written, a megabyte at a time
+            if(tail - logger->ring_tail >= (1 << 20) || tail == head) {
+                g_mutex_lock(logger->mutex);
+                logger->ring_tail = tail;
+                g_mutex_unlock(logger->mutex);
             }
         }
-        if (logger->fflush_interval_ms >= 0 &&
-            (le->timestamp - logger->last_fflush_time) > logger->fflush_interval_ms*1000) {
-            fflush(logger->log->f);
-            // Perform a full fsync operation after flush
-#ifndef WIN32
-            fdatasync(fileno(logger->log->f));
-#endif
-            logger->last_fflush_time = le->timestamp;
+    }
+}
+
+// Writes the messages asked for by a flight recorder dump to a new log file
+static void
+dump_ring(logger_t *logger)
+{
+    g_mutex_lock(logger->mutex);
+    int64_t pos = logger->dump_pos;
+    int64_t end = logger->dump_end;
+    g_mutex_unlock(logger->mutex);
+
+    int status = open_logfile(logger);
+    int64_t published = pos;
+    int64_t nevents = 0;
+    int64_t first_utime = 0;
+    int64_t last_utime = 0;
+    while(status == 0 && pos < end) {
+        int64_t ring_pos = pos % logger->max_write_queue_size;
+        int64_t left = logger->max_write_queue_size - ring_pos;
+        queued_msg_t *msg = (queued_msg_t*) (logger->ring + ring_pos);
+        if(left < (int64_t) sizeof(queued_msg_t) || msg->channellen < 0) {
+            pos += left;
+        } else {
+            lcm_eventlog_event_t le;
+            queued_event(msg, &le);
+            if(0 != lcm_eventlog_write_event(logger->log, &le)) {
+                fprintf(stderr, "lcm_eventlog_write_event: %s\n",
+                        strerror(errno));
+                status = -1;
+            }
+            if(!nevents)
+                first_utime = le.timestamp;
+            last_utime = le.timestamp;
+            nevents++;
+            pos += queued_msg_size(msg->channellen, msg->datalen);
         }
 
-        // bookkeeping, cleanup
-        int64_t offset_utime = le->timestamp - logger->time0;
-        logger->nevents++;
-        logger->events_since_last_report ++;
-        logger->logsize += 4 + 8 + 8 + 4 + le->channellen + 4 + le->datalen;
-
-        free(le);
-
-        if (!logger->quiet && (offset_utime - logger->last_report_time > 1000000)) {
-            double dt = (offset_utime - logger->last_report_time)/1000000.0;
-
-            double tps =  logger->events_since_last_report / dt;
-            double kbps = (logger->logsize - logger->last_report_logsize) / dt / 1024.0;
-            printf("Summary: %s ti:%4"PRIi64"sec Events: %-9"PRIi64" ( %4"PRIi64" MB )      TPS: %8.2f       KB/s: %8.2f\n",
-                    logger->fname,
-                    timestamp_seconds(offset_utime),
-                    logger->nevents, logger->logsize/1048576,
-                    tps, kbps);
-            logger->last_report_time = offset_utime;
-            logger->events_since_last_report = 0;
-            logger->last_report_logsize = logger->logsize;
+        // Written messages may be evicted, a megabyte at a time.  The dump
+        // goes on to the last trigger, if there was another one meanwhile.
+        if(pos - published >= (1 << 20) || pos == end) {
+            published = pos;
+            g_mutex_lock(logger->mutex);
+            logger->dump_pos = pos;
+            end = logger->dump_end;
+            g_mutex_unlock(logger->mutex);
         }
     }
+
+    // what can't be written is given up
+    g_mutex_lock(logger->mutex);
+    logger->dump_pos = logger->dump_end;
+    g_mutex_unlock(logger->mutex);
+    if(!logger->log)
+        return;
+    lcm_eventlog_flush(logger->log);
+#ifndef WIN32
+    if(logger->sync_mode != SYNC_NONE)
+        fdatasync(fileno(logger->log->f));
+#endif
+    close_log(logger, logger->log, logger->fname);
+    logger->log = NULL;
+    if(!logger->quiet) {
+        printf("Flight recorder: wrote %"PRIi64" events, %.1f seconds, to \"%s\"\n",
+                nevents, (last_utime - first_utime) / 1000000.0, logger->fname);
+    }
+}
+
+// The write thread, with --flight-recorder
+static void*
+dump_thread(void *user_data)
+{
+    logger_t *logger = (logger_t*) user_data;
+    if (logger->write_cpu || logger->write_sched)
+        lcm_set_thread_scheduling(logger->write_cpu, logger->write_sched);
+
+    while(1) {
+        g_mutex_lock(logger->mutex);
+        while(logger->dump_pos == logger->dump_end &&
+                !logger->write_thread_exit_flag)
+            g_cond_wait(logger->write_cond, logger->mutex);
+        int pending = logger->dump_pos < logger->dump_end;
+        g_mutex_unlock(logger->mutex);
+        // a dump that was asked for is finished before exiting
+        if(!pending)
+            return NULL;
+        dump_ring(logger);
+    }
 }
 
+// Asks the write thread to dump what the flight recorder holds, or, if it is
+// already dumping, to go on up to the latest message
+static void
+request_dump(logger_t *logger)
+{
+    g_mutex_lock(logger->mutex);
+    if(logger->dump_pos == logger->dump_end)
+        logger->dump_pos = logger->ring_tail;
+    logger->dump_end = logger->ring_head;
+    g_cond_signal(logger->write_cond);
+    g_mutex_unlock(logger->mutex);
+}
+
+#ifdef SIGUSR1
+static void
+sigusr1_handler(int signum, void *user)
+{
+    logger_t *logger = (logger_t*) user;
+    if(!logger->quiet)
+        printf("Flight recorder: dumping on SIGUSR1\n");
+    request_dump(logger);
+}
+#endif
+
 static void
 message_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
 {
@@ -300,20 +899,117 @@ message_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
             return;
     }
 
+    channel_info_t *info = (channel_info_t*) g_hash_table_lookup(
+            logger->channels, channel);
+    if(!info) {
+        info = g_new0(channel_info_t, 1);
+        info->priority = PRIORITY_NORMAL;
+        for(guint i = 0; i < logger->priority_rules->len; i++) {
+            priority_rule_t *rule = (priority_rule_t*)
+                g_ptr_array_index(logger->priority_rules, i);
+            if(g_regex_match(rule->regex, channel, (GRegexMatchFlags) 0,
+                        NULL)) {
+                info->priority = rule->priority;
+                break;
+            }
+        }
+        for(guint i = 0; i < logger->rate_rules->len; i++) {
+            rate_rule_t *rule = (rate_rule_t*)
+                g_ptr_array_index(logger->rate_rules, i);
+            if(g_regex_match(rule->regex, channel, (GRegexMatchFlags) 0,
+                        NULL)) {
+                info->min_interval = rule->min_interval;
+                break;
+            }
+        }
+        info->trigger = logger->trigger_regex && g_regex_match(
+                logger->trigger_regex, channel, (GRegexMatchFlags) 0, NULL);
+        g_hash_table_insert(logger->channels, g_strdup(channel), info);
+    }
+
+    // downsample before anything is copied.  Keeping to a schedule of one
+    // message per interval holds the rate despite jitter in the arrivals,
+    // and it starts over after a gap.
+    if(info->min_interval) {
+        if(rbuf->recv_utime < info->next_utime) {
+            info->skipped++;
+            return;
+        }
+        info->next_utime += info->min_interval;
+        if(info->next_utime <= rbuf->recv_utime)
+            info->next_utime = rbuf->recv_utime + info->min_interval;
+    }
+
+    // the stripe that is queued to, if any
+    logger_t *w = logger;
+    if(logger->num_stripes) {
+        if(logger->stripe_bytes >= STRIPE_BLOCK_SIZE) {
+            logger->next_stripe = (logger->next_stripe + 1) % logger->num_stripes;
+            logger->stripe_bytes = 0;
+        }
+        w = &logger->stripes[logger->next_stripe];
+    }
+
+    char tagged[LCM_MAX_CHANNEL_NAME_LENGTH + 16];
+    if(logger->tag_source) {
+        int source = 0;
+        while(source < logger->num_lcms - 1 &&
+                logger->lcms[source] != rbuf->lcm)
+            source++;
+        snprintf(tagged, sizeof(tagged), "%.*s@%d",
+                LCM_MAX_CHANNEL_NAME_LENGTH, channel, source);
+        channel = tagged;
+    }
+
+    // The receive threads of several LCM instances stamp their messages
+    // independently, so the messages handled here are a few microseconds
+    // out of order at times.  They are stamped no earlier than the last one
+    // to keep the log in time order.
+    int64_t timestamp = rbuf->recv_utime;
+    if(logger->num_lcms > 1 && timestamp < logger->last_timestamp)
+        timestamp = logger->last_timestamp;
+
     int channellen = strlen(channel);
+    int64_t size = queued_msg_size(channellen, rbuf->data_size);
+    int64_t capacity = w->max_write_queue_size;
+    // lower priorities leave the rest of the queue to higher ones
+    int64_t share = (int64_t) (capacity * priority_queue_share[info->priority]);
 
     // check if the backlog of unwritten messages is too big.  If so, then
-    // ignore this event
-    int64_t mem_sz = sizeof(lcm_eventlog_event_t) + channellen + 1 + rbuf->data_size;
-    g_mutex_lock(logger->mutex);
-    int64_t mem_required = mem_sz + logger->write_queue_size;
+    // ignore this event.  Only this thread adds to the queue, so the room
+    // found here stays available.
+    g_mutex_lock(w->mutex);
+    int64_t head = w->ring_head;
+    int64_t pos = head % capacity;
+    int64_t skip = pos + size > capacity ? capacity - pos : 0;
+    int64_t mem_required = head + skip + size - w->ring_tail;
+    if(logger->flight_recorder_usec) {
+        // Old messages make room, as long as they are not still to be
+        // dumped
+        int64_t limit = w->dump_pos < w->dump_end ? w->dump_pos : head;
+        int64_t oldest = timestamp - logger->flight_recorder_usec;
+        while(w->ring_tail < limit) {
+            int64_t tail_pos = w->ring_tail % capacity;
+            int64_t left = capacity - tail_pos;
+            queued_msg_t *old = (queued_msg_t*) (w->ring + tail_pos);
+            if(left < (int64_t) sizeof(queued_msg_t) || old->channellen < 0) {
+                w->ring_tail += left;
+            } else if(mem_required > share || old->timestamp < oldest) {
+                w->ring_tail += queued_msg_size(old->channellen, old->datalen);
+            } else {
+                break;
+            }
+            mem_required = head + skip + size - w->ring_tail;
+        }
+    }
+    g_mutex_unlock(w->mutex);
 
-    if(mem_required > logger->max_write_queue_size) {
+    if(mem_required > share) {
         // can't write to logfile fast enough.  drop packet.
-        g_mutex_unlock(logger->mutex);
+        info->dropped++;
 
         // maybe print an informational message to stdout
-        int64_t now = timestamp_now();
+        int64_t now = lcm_clock_monotonic_us();
         logger->dropped_packets_count ++;
         int rc = logger->dropped_packets_count - logger->last_drop_report_count;
 
@@ -325,27 +1021,287 @@ message_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
             logger->last_drop_report_count = logger->dropped_packets_count;
         }
         return;
-    } else {
-        logger->write_queue_size = mem_required;
-        g_mutex_unlock(logger->mutex);
     }
 
-    // queue up the message for writing to disk by the write thread
-    lcm_eventlog_event_t *le = (lcm_eventlog_event_t*) malloc(mem_sz);
-    memset(le, 0, mem_sz);
+    // copy the message into the queue, once, for the write thread
+    if(skip) {
+        if(skip >= (int64_t) sizeof(queued_msg_t))
+            ((queued_msg_t*) (w->ring + pos))->channellen = -1;
+        pos = 0;
+    }
+    queued_msg_t *msg = (queued_msg_t*) (w->ring + pos);
+    msg->timestamp = timestamp;
+    logger->last_timestamp = timestamp;
+    msg->channellen = channellen;
+    msg->datalen = rbuf->data_size;
+    char *msg_channel = (char*) (msg + 1);
+    memcpy(msg_channel, channel, channellen + 1);
+    memcpy(msg_channel + channellen + 1, rbuf->data, rbuf->data_size);
+
+    g_mutex_lock(w->mutex);
+    w->ring_head = head + skip + size;
+    g_cond_signal(w->write_cond);
+    g_mutex_unlock(w->mutex);
+    logger->stripe_bytes += size;
+
+    if(info->trigger) {
+        if(!logger->quiet)
+            printf("Flight recorder: dumping on [%s]\n", channel);
+        request_dump(logger);
+    }
+}
 
-    le->timestamp = rbuf->recv_utime;
-    le->channellen = channellen;
-    le->datalen = rbuf->data_size;
-    // log_write_event will handle le.eventnum.
+typedef struct {
+    const char *name;
+    const channel_info_t *info;
+    int64_t count;
+} channel_drops_t;
 
-    le->channel = ((char*)le) + sizeof(lcm_eventlog_event_t);
-    strcpy(le->channel, channel);
-    le->data = le->channel + channellen + 1;
-    assert((char*)le->data + rbuf->data_size == (char*)le + mem_sz);
-    memcpy(le->data, rbuf->data, rbuf->data_size);
+static int
+compare_channel_drops(const void *a, const void *b)
+{
+    const channel_drops_t *x = (const channel_drops_t*) a;
+    const channel_drops_t *y = (const channel_drops_t*) b;
+    if(x->count != y->count)
+        return x->count > y->count ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
 
-    g_async_queue_push(logger->write_queue, le);
+// Prints how many messages of each channel were dropped, or skipped by
+// --max-rate, most first
+static void
+print_channel_counts(logger_t *logger, int skipped)
+{
+    GArray *drops = g_array_new(FALSE, FALSE, sizeof(channel_drops_t));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, logger->channels);
+    while(g_hash_table_iter_next(&iter, &key, &value)) {
+        const channel_info_t *info = (channel_info_t*) value;
+        channel_drops_t d = { (const char*) key, info,
+            skipped ? info->skipped : info->dropped };
+        if(d.count)
+            g_array_append_val(drops, d);
+    }
+    if(drops->len) {
+        qsort(drops->data, drops->len, sizeof(channel_drops_t),
+                compare_channel_drops);
+        printf("%s messages by channel:\n",
+                skipped ? "Downsampled" : "Dropped");
+    }
+    for(guint i = 0; i < drops->len; i++) {
+        channel_drops_t *d = &g_array_index(drops, channel_drops_t, i);
+        if(skipped)
+            printf("  %-30s %10"PRIi64"  (max %.3g Hz)\n", d->name, d->count,
+                    1e6 / d->info->min_interval);
+        else
+            printf("  %-30s %10"PRIi64"  (%s priority)\n", d->name,
+                    d->count, priority_names[d->info->priority]);
+    }
+    g_array_free(drops, TRUE);
+}
+
+// Adds the rule of a --priority REGEX=CLASS option.  Returns 0 on success.
+static int
+add_priority_rule(logger_t *logger, const char *arg)
+{
+    const char *eq = strrchr(arg, '=');
+    if(!eq)
+        return -1;
+    int priority = -1;
+    for(int i = 0; i < 3; i++) {
+        if(!strcmp(eq + 1, priority_names[i]))
+            priority = i;
+    }
+    if(priority < 0)
+        return -1;
+    char *regexbuf = g_strdup_printf("^%.*s$", (int) (eq - arg), arg);
+    GError *rerr = NULL;
+    GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0,
+            (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if(rerr) {
+        fprintf(stderr, "%s\n", rerr->message);
+        g_error_free(rerr);
+        return -1;
+    }
+    priority_rule_t *rule = g_new(priority_rule_t, 1);
+    rule->regex = regex;
+    rule->priority = priority;
+    g_ptr_array_add(logger->priority_rules, rule);
+    return 0;
+}
+
+// Adds the rule of a --max-rate REGEX=HZ option.  Returns 0 on success.
+static int
+add_rate_rule(logger_t *logger, const char *arg)
+{
+    const char *eq = strrchr(arg, '=');
+    if(!eq)
+        return -1;
+    char *eptr = NULL;
+    double hz = strtod(eq + 1, &eptr);
+    if(eptr == eq + 1 || *eptr || !(hz > 0) || hz > 1e6)
+        return -1;
+    char *regexbuf = g_strdup_printf("^%.*s$", (int) (eq - arg), arg);
+    GError *rerr = NULL;
+    GRegex *regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0,
+            (GRegexMatchFlags) 0, &rerr);
+    g_free(regexbuf);
+    if(rerr) {
+        fprintf(stderr, "%s\n", rerr->message);
+        g_error_free(rerr);
+        return -1;
+    }
+    rate_rule_t *rule = g_new(rate_rule_t, 1);
+    rule->regex = regex;
+    rule->min_interval = (int64_t) (1e6 / hz);
+    g_ptr_array_add(logger->rate_rules, rule);
+    return 0;
+}
+
+// Allocates the write queue, opens the first log file and starts the threads
+// that write it.  Returns 0 on success.
+static int
+start_writing(logger_t *logger)
+{
+    logger->ring = (uint8_t*) malloc(logger->max_write_queue_size);
+    if (!logger->ring) {
+        fprintf(stderr, "Unable to allocate a write queue of %"PRIi64" bytes\n",
+                logger->max_write_queue_size);
+        return 1;
+    }
+
+    // a flight recorder opens a log file for each dump
+    if(!logger->flight_recorder_usec && 0 != open_logfile(logger))
+        return 1;
+
+    // create write thread
+    logger->write_thread_exit_flag = 0;
+    logger->mutex = g_mutex_new();
+    logger->write_cond = g_cond_new();
+    logger->sync_mutex = g_mutex_new();
+    logger->sync_cond = g_cond_new();
+    logger->sync_fd = -1;
+    logger->sync_latencies = g_array_new(FALSE, FALSE, sizeof(double));
+#ifndef WIN32
+    if (logger->sync_mode == SYNC_ASYNC)
+        logger->sync_thread = g_thread_create(sync_thread, logger, TRUE, NULL);
+#endif
+    logger->segment_mutex = g_mutex_new();
+    logger->segment_cond = g_cond_new();
+    logger->ready_segments = g_queue_new();
+    logger->closed_segments = g_queue_new();
+    if (logger->preopen > 0)
+        logger->segment_thread = g_thread_create(segment_thread, logger, TRUE,
+                NULL);
+    logger->write_thread = g_thread_create(logger->flight_recorder_usec ?
+            dump_thread : write_thread, logger, TRUE, NULL);
+    return 0;
+}
+
+// Writes what is left in the queue, stops the threads and closes the log
+// file
+static void
+stop_writing(logger_t *logger)
+{
+    // stop the write thread
+    g_mutex_lock(logger->mutex);
+    logger->write_thread_exit_flag = 1;
+    g_cond_signal(logger->write_cond);
+    g_mutex_unlock(logger->mutex);
+    g_thread_join(logger->write_thread);
+    g_cond_free(logger->write_cond);
+    g_mutex_free(logger->mutex);
+
+    // and the sync thread, which may still be syncing
+    if (logger->sync_thread) {
+        g_mutex_lock(logger->sync_mutex);
+        logger->sync_exit = 1;
+        g_cond_broadcast(logger->sync_cond);
+        g_mutex_unlock(logger->sync_mutex);
+        g_thread_join(logger->sync_thread);
+    }
+    g_cond_free(logger->sync_cond);
+    g_mutex_free(logger->sync_mutex);
+    g_array_free(logger->sync_latencies, TRUE);
+
+    // and the segment thread, once it has closed the log files left to it.
+    // The log files it opened ahead of time are not needed anymore.
+    if (logger->segment_thread) {
+        g_mutex_lock(logger->segment_mutex);
+        logger->segment_exit = 1;
+        g_cond_broadcast(logger->segment_cond);
+        g_mutex_unlock(logger->segment_mutex);
+        g_thread_join(logger->segment_thread);
+    }
+    segment_t *seg;
+    while ((seg = (segment_t*) g_queue_pop_head(logger->ready_segments))) {
+        lcm_eventlog_destroy(seg->log);
+        remove_logfile(seg->temp_fname[0] ? seg->temp_fname : seg->fname);
+        g_free(seg);
+    }
+    g_queue_free(logger->ready_segments);
+    g_queue_free(logger->closed_segments);
+    g_cond_free(logger->segment_cond);
+    g_mutex_free(logger->segment_mutex);
+
+    if (logger->log)
+        close_log(logger, logger->log, logger->fname);
+    free(logger->ring);
+}
+
+// Sets up a logger for each --stripe directory, which writes a log file named
+// like FILE in it, and writes the manifest of the stripes to FILE.  Returns 0
+// on success.
+static int
+start_stripes(logger_t *logger, GPtrArray *stripe_dirs)
+{
+    if (0 != next_logfile_name(logger, logger->fname))
+        return 1;
+    char *dirpart = g_path_get_dirname (logger->fname);
+    if (! g_file_test (dirpart, G_FILE_TEST_IS_DIR)) {
+        mkdir_with_parents (dirpart, 0755);
+    }
+    g_free (dirpart);
+
+    logger->num_stripes = stripe_dirs->len;
+    logger->stripes = g_new0(logger_t, logger->num_stripes);
+    const char **paths = g_new0(const char*, logger->num_stripes);
+    gchar *basename = g_path_get_basename(logger->fname);
+    gchar *cwd = g_get_current_dir();
+    int status = 0;
+    for (int i = 0; i < logger->num_stripes; i++) {
+        logger_t *stripe = &logger->stripes[i];
+        *stripe = *logger;
+        stripe->stripes = NULL;
+        stripe->num_stripes = 0;
+        stripe->auto_increment = 0;
+        stripe->use_strftime = 0;
+        // the manifest names the stripes wherever it is moved to
+        const char *dir = (const char*) g_ptr_array_index(stripe_dirs, i);
+        gchar *path = dir[0] == G_DIR_SEPARATOR ?
+            g_build_filename(dir, basename, NULL) :
+            g_build_filename(cwd, dir, basename, NULL);
+        snprintf(stripe->input_fname, sizeof(stripe->input_fname), "%s", path);
+        g_free(path);
+        paths[i] = stripe->input_fname;
+    }
+    g_free(cwd);
+    g_free(basename);
+
+    if(!logger->quiet) {
+        printf("Writing stripe manifest \"%s\"\n", logger->fname);
+    }
+    if (0 != lcm_eventlog_write_manifest(logger->fname, logger->num_stripes,
+                paths)) {
+        perror ("Error: Unable to write the stripe manifest");
+        status = 1;
+    }
+    g_free(paths);
+    for (int i = 0; i < logger->num_stripes && status == 0; i++)
+        status = start_writing(&logger->stripes[i]);
+    return status;
 }
 
 #ifdef USE_SIGHUP
@@ -355,6 +1311,21 @@ static void sighup_handler (int signum)
 }
 #endif
 
+// Appends key=value to the options of *lcmurl, which starts out as the
+// default URL if it is NULL.
+static void
+add_url_option(char **lcmurl, const char *key, const char *value)
+{
+    const char *url = *lcmurl ? *lcmurl : getenv("LCM_DEFAULT_URL");
+    if (!url)
+        url = "udpm://";
+    char *newurl = g_strdup_printf("%s%c%s=%s", url,
+            strchr(url, '?') ? '&' : '?', key, value);
+    free(*lcmurl);
+    *lcmurl = strdup(newurl);
+    g_free(newurl);
+}
+
 static void usage ()
 {
     fprintf (stderr, "usage: lcm-logger [options] [FILE]\n"
@@ -370,26 +1341,103 @@ static void usage ()
             "                             (default: \".*\")\n"
             "      --flush-interval=MS    Flush the log file to disk every MS milliseconds.\n"
             "                             (default: 100)\n"
+            "      --compress=CODEC       Write compressed log files, with CODEC lz4 or\n"
+            "                             zlib.  Compressed files can be read and seeked\n"
+            "                             in like others, but can not be appended to.\n"
+            "                             --split-mb counts the size before compression.\n"
+            "      --direct-io            Write log files with O_DIRECT, bypassing the\n"
+            "                             page cache.\n"
             "  -f, --force                Overwrite existing files\n"
             "  -h, --help                 Shows this help text and exits\n"
+            "      --index                Write an index of each log file, named\n"
+            "                             FILE.lcmidx, which lets players seek quickly,\n"
+            "                             even while the log is still being written.\n"
+            "                             Existing logs can be indexed with lcm-logindex.\n"
+            "                             (default)\n"
+            "      --no-index             Do not write an index.\n"
             "  -i, --increment            Automatically append a suffix to FILE\n"
             "                             such that the resulting filename does not\n"
             "                             already exist.  This option precludes -f and\n"
             "                             --rotate\n"
-            "  -l, --lcm-url=URL          Log messages on the specified LCM URL\n"
+            "  -l, --lcm-url=URL          Log messages on the specified LCM URL.  Can be\n"
+            "                             repeated to log the messages of several\n"
+            "                             networks into one log file, in time order.\n"
+            "      --tag-source           With several -l, log each message on its\n"
+            "                             channel with @N appended, where N is the\n"
+            "                             index of its -l option, starting at 0.\n"
             "  -m, --max-unwritten-mb=SZ  Maximum size of received but unwritten\n"
             "                             messages to store in memory before dropping\n"
-            "                             messages.  (default: 100 MB)\n"
+            "                             messages.  The queue is allocated upfront.\n"
+            "                             (default: 100 MB)\n"
             "      --rotate=NUM           When creating a new log file, rename existing files\n"
             "                             out of the way and always write to FILE.0.  If\n"
             "                             FILE.0 already exists, it is renamed to FILE.1.  If\n"
             "                             FILE.1 exists, it is renamed to FILE.2, etc.  If\n"
             "                             FILE.NUM exists, then it is deleted.  This option\n"
             "                             precludes -i.\n"
+            "      --rx-timestamp=MODE    Timestamp events with the udpm receive\n"
+            "                             timestamps selected by MODE, one of ns, sw\n"
+            "                             or hw.  Adds rx_timestamp=MODE to the LCM\n"
+            "                             URL.  Log files store microseconds.\n"
+            "      --rx-cpu=CPUS          Pin the LCM receive thread to CPUS, e.g. 3 or\n"
+            "                             0,2-3.  Adds rx_cpu=CPUS to the LCM URL.\n"
+            "      --rx-sched=POLICY      Scheduling policy of the LCM receive thread,\n"
+            "                             e.g. fifo:50.  Adds rx_sched=POLICY to the LCM\n"
+            "                             URL.\n"
+            "      --write-cpu=CPUS       Pin the thread that writes the log file to CPUS.\n"
+            "      --write-sched=POLICY   Scheduling policy of the thread that writes the\n"
+            "                             log file, one of fifo:PRIO, rr:PRIO or other.\n"
+            "      --sync=MODE            How the log file is made durable every flush\n"
+            "                             interval: full waits for fdatasync, async\n"
+            "                             runs it on another thread while writing goes\n"
+            "                             on, and none leaves it to the OS.\n"
+            "                             (default: full)\n"
             "      --split-mb=N           Automatically start writing to a new log\n"
             "                             file once the log file exceeds N MB in size\n"
             "                             (can be fractional).  This option requires -i\n"
             "                             or --rotate.\n"
+            "      --priority=CHAN=CLASS  Give the channels that match the regular\n"
+            "                             expression CHAN the priority CLASS, one of\n"
+            "                             low, normal or high.  When the log can't be\n"
+            "                             written fast enough, low priority messages are\n"
+            "                             dropped once the queue is half full, normal\n"
+            "                             ones when it is 90%% full, and high ones only\n"
+            "                             when it is full.  Can be repeated; the first\n"
+            "                             match wins.  (default: normal)\n"
+            "      --max-rate=CHAN=HZ     Log at most HZ messages per second of the\n"
+            "                             channels that match the regular expression\n"
+            "                             CHAN, each channel on its own, skipping the\n"
+            "                             others as they arrive.  Can be repeated; the\n"
+            "                             first match wins.\n"
+            "      --preallocate          Reserve the disk space of each log file of\n"
+            "                             --split-mb when it is opened, so that it is\n"
+            "                             not extended write by write.  What is left\n"
+            "                             over is given back when it is closed.  Only\n"
+            "                             supported on Linux.\n"
+            "      --preopen=N            Keep the next N log files of --split-mb open\n"
+            "                             ahead of time, and close the previous ones on\n"
+            "                             another thread, so that moving to a new log\n"
+            "                             file does not hold up writing.  With --rotate,\n"
+            "                             they are named FILE.nextK until they are\n"
+            "                             rotated into place.  This option requires -i\n"
+            "                             or --rotate.\n"
+            "      --stripe=DIR           Spread the log over DIR and the directories of\n"
+            "                             other --stripe options, e.g. on separate\n"
+            "                             disks, to write it faster than one disk can.\n"
+            "                             Each directory gets a log file named like FILE,\n"
+            "                             written by a thread and queue of its own, which\n"
+            "                             messages go to a megabyte at a time.  FILE is\n"
+            "                             then a manifest of the stripes, which LCM log\n"
+            "                             readers and lcm-logmerge read as one log.  This\n"
+            "                             option precludes --split-mb, --rotate and -a.\n"
+            "      --flight-recorder=SEC  Keep the messages of the last SEC seconds in\n"
+            "                             memory, in the queue of -m, instead of writing\n"
+            "                             them.  They are written to a new log file, as\n"
+            "                             with -i, on SIGUSR1 or --trigger.  This option\n"
+            "                             precludes --split-mb, --rotate, -a and --stripe.\n"
+            "      --trigger=CHAN         With --flight-recorder, write what is kept in\n"
+            "                             memory when a message arrives on a channel that\n"
+            "                             matches the regular expression CHAN.\n"
             "  -q, --quiet                Suppress normal output and only report errors.\n"
             "  -a, --append               Append events to the given log file.\n"
             "  -s, --strftime             Format FILE with strftime.\n"
@@ -433,9 +1481,19 @@ int main(int argc, char *argv[])
     logger.rotate = -1;
     logger.quiet = 0;
     logger.append = 0;
-
-    char *lcmurl = NULL;
-    char *optstring = "fic:shm:vu:qa";
+    logger.index = 1;
+
+    GPtrArray *lcmurls = g_ptr_array_new();
+    char *rx_timestamp = NULL;
+    char *rx_cpu = NULL;
+    char *rx_sched = NULL;
+    char *optstring = "fic:shl:m:vu:qa";
+    logger.priority_rules = g_ptr_array_new();
+    logger.rate_rules = g_ptr_array_new();
+    logger.channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            g_free);
+    GPtrArray *stripe_dirs = g_ptr_array_new();
+    char *trigger = NULL;
     int c;
     struct option long_opts[] = {
         { "split-mb", required_argument, 0, 'b' },
@@ -443,6 +1501,7 @@ int main(int argc, char *argv[])
         { "force", no_argument, 0, 'f' },
         { "increment", required_argument, 0, 'i' },
         { "lcm-url", required_argument, 0, 'l' },
+        { "tag-source", no_argument, 0, 'G' },
         { "max-unwritten-mb", required_argument, 0, 'm' },
         { "rotate", required_argument, 0, 'r' },
         { "strftime", required_argument, 0, 's' },
@@ -450,6 +1509,23 @@ int main(int argc, char *argv[])
         { "append", no_argument, 0, 'a' },
         { "invert-channels", no_argument, 0, 'v' },
         { "flush-interval", required_argument, 0,'u'},
+        { "rx-timestamp", required_argument, 0, 't' },
+        { "rx-cpu", required_argument, 0, 'p' },
+        { "rx-sched", required_argument, 0, 'x' },
+        { "write-cpu", required_argument, 0, 'w' },
+        { "write-sched", required_argument, 0, 'y' },
+        { "index", no_argument, 0, 'n' },
+        { "no-index", no_argument, 0, 'N' },
+        { "compress", required_argument, 0, 'z' },
+        { "direct-io", no_argument, 0, 'D' },
+        { "sync", required_argument, 0, 'S' },
+        { "priority", required_argument, 0, 'P' },
+        { "max-rate", required_argument, 0, 'M' },
+        { "preallocate", no_argument, 0, 'L' },
+        { "preopen", required_argument, 0, 'O' },
+        { "stripe", required_argument, 0, 'R' },
+        { "flight-recorder", required_argument, 0, 'E' },
+        { "trigger", required_argument, 0, 'T' },
         { 0, 0, 0, 0 }
     };
 
@@ -477,8 +1553,10 @@ int main(int argc, char *argv[])
                 logger.use_strftime = 1;
                 break;
             case 'l':
-                free(lcmurl);
-                lcmurl = strdup(optarg);
+                g_ptr_array_add(lcmurls, strdup(optarg));
+                break;
+            case 'G':
+                logger.tag_source = 1;
                 break;
             case 'q':
                 logger.quiet = 1;
@@ -513,6 +1591,99 @@ int main(int argc, char *argv[])
             case 'a':
               logger.append = 1;
               break;
+            case 't':
+                if (strcmp(optarg, "ns") && strcmp(optarg, "sw") &&
+                        strcmp(optarg, "hw")) {
+                    usage();
+                    return 1;
+                }
+                free(rx_timestamp);
+                rx_timestamp = strdup(optarg);
+                break;
+            case 'p':
+                free(rx_cpu);
+                rx_cpu = strdup(optarg);
+                break;
+            case 'x':
+                free(rx_sched);
+                rx_sched = strdup(optarg);
+                break;
+            case 'w':
+                free(logger.write_cpu);
+                logger.write_cpu = strdup(optarg);
+                break;
+            case 'y':
+                free(logger.write_sched);
+                logger.write_sched = strdup(optarg);
+                break;
+            case 'n':
+                logger.index = 1;
+                break;
+            case 'N':
+                logger.index = 0;
+                break;
+            case 'z':
+                free(logger.compress);
+                logger.compress = strdup(optarg);
+                break;
+            case 'D':
+                logger.direct_io = 1;
+                break;
+            case 'P':
+                if (0 != add_priority_rule(&logger, optarg)) {
+                    fprintf(stderr, "Invalid --priority \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'M':
+                if (0 != add_rate_rule(&logger, optarg)) {
+                    fprintf(stderr, "Invalid --max-rate \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                logger.preallocate = 1;
+                break;
+            case 'O':
+                {
+                  char* eptr = NULL;
+                  logger.preopen = strtol(optarg, &eptr, 10);
+                  if(*eptr || logger.preopen < 0) {
+                      usage();
+                      return 1;
+                  }
+                }
+                break;
+            case 'R':
+                g_ptr_array_add(stripe_dirs, optarg);
+                break;
+            case 'E':
+                {
+                  char* eptr = NULL;
+                  double seconds = strtod(optarg, &eptr);
+                  if(*eptr || seconds <= 0) {
+                      usage();
+                      return 1;
+                  }
+                  logger.flight_recorder_usec = (int64_t) (seconds * 1000000);
+                }
+                break;
+            case 'T':
+                free(trigger);
+                trigger = strdup(optarg);
+                break;
+            case 'S':
+                if (!strcmp(optarg, "full"))
+                    logger.sync_mode = SYNC_FULL;
+                else if (!strcmp(optarg, "async"))
+                    logger.sync_mode = SYNC_ASYNC;
+                else if (!strcmp(optarg, "none"))
+                    logger.sync_mode = SYNC_NONE;
+                else {
+                    usage();
+                    return 1;
+                }
+                break;
             case 'h':
             default:
                 usage();
@@ -543,32 +1714,103 @@ int main(int argc, char *argv[])
     if (logger.force_overwrite && logger.append) {
         fprintf(stderr, "ERROR.  --force_overwrite and --append can't both be used\n");
     }
+    if (logger.compress && logger.append) {
+        fprintf(stderr, "ERROR.  --compress and --append can't both be used\n");
+        return 1;
+    }
+    if (logger.preallocate && !logger.auto_split_mb) {
+        fprintf(stderr, "ERROR.  --preallocate requires --split-mb\n");
+        return 1;
+    }
+    if (logger.preopen > 0 && !(logger.auto_increment || (logger.rotate > 0))) {
+        fprintf(stderr, "ERROR.  --preopen requires either --increment or --rotate\n");
+        return 1;
+    }
+    if (stripe_dirs->len && (logger.auto_split_mb || logger.rotate > 0 ||
+                logger.append)) {
+        fprintf(stderr, "ERROR.  --stripe can't be used with --split-mb, --rotate or --append\n");
+        return 1;
+    }
+    if (logger.flight_recorder_usec) {
+        if (logger.auto_split_mb || logger.rotate > 0 || logger.append ||
+                stripe_dirs->len) {
+            fprintf(stderr, "ERROR.  --flight-recorder can't be used with --split-mb, --rotate, --append or --stripe\n");
+            return 1;
+        }
+        // each dump gets a log file of its own
+        logger.auto_increment = 1;
+    } else if (trigger) {
+        fprintf(stderr, "ERROR.  --trigger requires --flight-recorder\n");
+        return 1;
+    }
+    if (trigger) {
+        char *regexbuf = g_strdup_printf("^%s$", trigger);
+        GError *rerr = NULL;
+        logger.trigger_regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0,
+                (GRegexMatchFlags) 0, &rerr);
+        g_free(regexbuf);
+        free(trigger);
+        if(rerr) {
+            fprintf(stderr, "%s\n", rerr->message);
+            g_error_free(rerr);
+            return 1;
+        }
+    }
 
-    logger.time0 = timestamp_now();
-    logger.max_write_queue_size = (int64_t)(max_write_queue_size_mb * (1 << 20));
-
-    if(0 != open_logfile(&logger))
+    logger.time0 = lcm_clock_realtime_us();
+    logger.last_report_utime = lcm_clock_monotonic_us();
+    // the ring holds whole queued_msg_t
+    logger.max_write_queue_size =
+        (int64_t)(max_write_queue_size_mb * (1 << 20)) & ~7;
+    if (logger.max_write_queue_size < (int64_t) sizeof(queued_msg_t)) {
+        usage();
         return 1;
+    }
 
-    // create write thread
-    logger.write_thread_exit_flag = 0;
-    logger.mutex = g_mutex_new();
-    logger.write_queue_size = 0;
-    logger.write_queue = g_async_queue_new();
-    logger.write_thread = g_thread_create(write_thread, &logger, TRUE, NULL);
-
-    // begin logging
-    logger.lcm = lcm_create (lcmurl);
-    free(lcmurl);
-    if (!logger.lcm) {
-        fprintf (stderr, "Couldn't initialize LCM!");
+    if (stripe_dirs->len) {
+        if (0 != start_stripes(&logger, stripe_dirs))
+            return 1;
+    } else if (0 != start_writing(&logger)) {
         return 1;
     }
+    g_ptr_array_free(stripe_dirs, TRUE);
+
+    // ask the providers for the requested receive timestamps and receive
+    // thread setup
+    if (!lcmurls->len)
+        g_ptr_array_add(lcmurls, NULL);
+    logger.num_lcms = lcmurls->len;
+    logger.lcms = g_new0(lcm_t*, logger.num_lcms);
+    for (int i = 0; i < logger.num_lcms; i++) {
+        char **lcmurl = (char**) &g_ptr_array_index(lcmurls, i);
+        if (rx_timestamp)
+            add_url_option(lcmurl, "rx_timestamp", rx_timestamp);
+        if (rx_cpu)
+            add_url_option(lcmurl, "rx_cpu", rx_cpu);
+        if (rx_sched)
+            add_url_option(lcmurl, "rx_sched", rx_sched);
+
+        // begin logging
+        logger.lcms[i] = lcm_create (*lcmurl);
+        if (!logger.lcms[i]) {
+            fprintf (stderr, "Couldn't initialize LCM!");
+            return 1;
+        }
+        if (logger.tag_source && !logger.quiet)
+            printf("Logging %s as @%d\n", *lcmurl ? *lcmurl : "the default "
+                    "LCM URL", i);
+        free(*lcmurl);
+    }
+    g_ptr_array_free(lcmurls, TRUE);
+    free(rx_timestamp);
+    free(rx_cpu);
+    free(rx_sched);
 
     if(logger.invert_channels) {
         // if inverting the channels, subscribe to everything and invert on the
         // callback
-        lcm_subscribe(logger.lcm, ".*", message_handler, &logger);
+        for (int i = 0; i < logger.num_lcms; i++)
+            lcm_subscribe(logger.lcms[i], ".*", message_handler, &logger);
         char *regexbuf = g_strdup_printf("^%s$", chan_regex);
         GError *rerr = NULL;
         logger.regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
@@ -580,17 +1822,26 @@ int main(int argc, char *argv[])
         g_free(regexbuf);
     } else {
         // otherwise, let LCM handle the regex
-        lcm_subscribe(logger.lcm, chan_regex, message_handler, &logger);
+        for (int i = 0; i < logger.num_lcms; i++)
+            lcm_subscribe(logger.lcms[i], chan_regex, message_handler,
+                    &logger);
     }
 
     free(chan_regex);
 
     _mainloop = g_main_loop_new (NULL, FALSE);
     signal_pipe_glib_quit_on_kill ();
-    glib_mainloop_attach_lcm (logger.lcm);
+    for (int i = 0; i < logger.num_lcms; i++)
+        glib_mainloop_attach_lcm (logger.lcms[i]);
 
 #ifdef USE_SIGHUP
-    signal(SIGHUP, sighup_handler);
+    // stripes are not split
+    if (!logger.num_stripes)
+        signal(SIGHUP, sighup_handler);
+#endif
+#ifdef SIGUSR1
+    if (logger.flight_recorder_usec)
+        signal_pipe_add_glib_handler(SIGUSR1, sigusr1_handler, &logger);
 #endif
 
     // main loop
@@ -598,31 +1849,50 @@ int main(int argc, char *argv[])
 
     fprintf(stderr, "Logger exiting\n");
 
-    // stop the write thread
-    g_mutex_lock(logger.mutex);
-    logger.write_thread_exit_flag = 1;
-    g_mutex_unlock(logger.mutex);
-    g_async_queue_push(logger.write_queue, &logger.write_thread_exit_flag);
-    g_thread_join(logger.write_thread);
-    g_mutex_free(logger.mutex);
+    if (logger.num_stripes) {
+        for (int i = 0; i < logger.num_stripes; i++)
+            stop_writing(&logger.stripes[i]);
+        g_free(logger.stripes);
+    } else {
+        stop_writing(&logger);
+    }
 
     // cleanup.  This isn't strictly necessary, do it to be pedantic and so that
     // leak checkers don't complain
-    glib_mainloop_detach_lcm (logger.lcm);
-    lcm_destroy (logger.lcm);
-    lcm_eventlog_destroy (logger.log);
+    for (int i = 0; i < logger.num_lcms; i++) {
+        glib_mainloop_detach_lcm (logger.lcms[i]);
+        lcm_destroy (logger.lcms[i]);
+    }
+    g_free(logger.lcms);
 
-    for(void *msg = g_async_queue_try_pop(logger.write_queue); msg;
-            msg=g_async_queue_try_pop(logger.write_queue)) {
-        if(msg == &logger.write_thread_exit_flag)
-            continue;
-        free(msg);
+    if(!logger.quiet) {
+        print_channel_counts(&logger, 0);
+        print_channel_counts(&logger, 1);
+    }
+    g_hash_table_destroy(logger.channels);
+    for(guint i = 0; i < logger.priority_rules->len; i++) {
+        priority_rule_t *rule = (priority_rule_t*)
+            g_ptr_array_index(logger.priority_rules, i);
+        g_regex_unref(rule->regex);
+        g_free(rule);
+    }
+    g_ptr_array_free(logger.priority_rules, TRUE);
+    for(guint i = 0; i < logger.rate_rules->len; i++) {
+        rate_rule_t *rule = (rate_rule_t*)
+            g_ptr_array_index(logger.rate_rules, i);
+        g_regex_unref(rule->regex);
+        g_free(rule);
     }
-    g_async_queue_unref(logger.write_queue);
+    g_ptr_array_free(logger.rate_rules, TRUE);
 
     if(logger.invert_channels) {
         g_regex_unref(logger.regex);
     }
+    if(logger.trigger_regex)
+        g_regex_unref(logger.trigger_regex);
+    free(logger.write_cpu);
+    free(logger.write_sched);
+    free(logger.compress);
 
     return 0;
 }
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include <lcm/lcm.h>
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...] FILE...\n\
+  Writes an index of each LCM log file to FILE.lcmidx, which lets log\n\
+  players seek quickly.  Any existing index is replaced.\n\
+\n\
+Options:\n\
+  -h, --help          Shows some help text and exits.\n\
+  \n", cmd);
+}
+
+int
+main(int argc, char ** argv)
+{
+    int c;
+    struct option long_opts[] = {
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while ((c = getopt_long (argc, argv, "h", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    if (optind == argc) {
+        usage (argv[0]);
+        return 1;
+    }
+
+    int status = 0;
+    for (int i = optind; i < argc; i++) {
+        if (0 != lcm_eventlog_build_index (argv[i])) {
+            fprintf (stderr, "Error: Failed to index %s\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
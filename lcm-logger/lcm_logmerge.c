@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <lcm/lcm.h>
+
+// One input log, and the next event to merge from it
+typedef struct {
+    const char *path;
+    lcm_eventlog_t *log;
+    lcm_eventlog_event_t event;
+    int32_t channel_capacity;
+    int32_t data_capacity;
+} input_t;
+
+// An event merged within the duplicate window.  Events are told apart by
+// the hash of their channel and data.
+typedef struct {
+    int64_t timestamp;
+    uint64_t hash;
+} recent_t;
+
+// Whether input a's event goes before input b's.  Events with the same
+// timestamp keep the order of the inputs on the command line.
+static int
+before (const input_t *a, const input_t *b)
+{
+    if (a->event.timestamp != b->event.timestamp)
+        return a->event.timestamp < b->event.timestamp;
+    return a < b;
+}
+
+static void
+sift_down (input_t **heap, int n, int i)
+{
+    while (1) {
+        int first = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < n && before (heap[left], heap[first]))
+            first = left;
+        if (right < n && before (heap[right], heap[first]))
+            first = right;
+        if (first == i)
+            return;
+        input_t *tmp = heap[i];
+        heap[i] = heap[first];
+        heap[first] = tmp;
+        i = first;
+    }
+}
+
+static int
+read_next (input_t *in)
+{
+    return lcm_eventlog_read_next_event_into (in->log, &in->event,
+            &in->channel_capacity, &in->data_capacity);
+}
+
+// FNV-1a of the channel and data of an event
+static uint64_t
+event_hash (const lcm_eventlog_event_t *event)
+{
+    uint64_t h = 14695981039346656037ULL;
+    const uint8_t *p = (const uint8_t *) event->channel;
+    for (int32_t i = 0; i <= event->channellen; i++)
+        h = (h ^ p[i]) * 1099511628211ULL;
+    p = (const uint8_t *) event->data;
+    for (int32_t i = 0; i < event->datalen; i++)
+        h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+static guint
+hash_hash (gconstpointer key)
+{
+    uint64_t h = *(const uint64_t *) key;
+    return (guint) (h ^ (h >> 32));
+}
+
+static gboolean
+hash_equal (gconstpointer a, gconstpointer b)
+{
+    return *(const uint64_t *) a == *(const uint64_t *) b;
+}
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...] -o OUTPUT FILE...\n\
+  Merges LCM log files into a single log, in timestamp order.\n\
+\n\
+Options:\n\
+  -o, --output=OUTPUT  Write the merged log to OUTPUT.\n\
+  -c, --channel=CHAN   Only merge the events on channels that match the\n\
+                       regular expression CHAN.\n\
+  -d, --dedup=USEC     Drop events with the same channel and data as one\n\
+                       merged at most USEC microseconds earlier, e.g.\n\
+                       messages recorded by several loggers.\n\
+  -f, --force          Overwrite OUTPUT if it exists.\n\
+  -q, --quiet          Do not print a summary.\n\
+  -h, --help           Shows some help text and exits.\n\
+  \n", cmd);
+}
+
+int
+main(int argc, char ** argv)
+{
+    char *output = NULL;
+    char *channel = NULL;
+    int64_t dedup = -1;
+    int force = 0;
+    int quiet = 0;
+
+    int c;
+    struct option long_opts[] = {
+        { "output", required_argument, 0, 'o' },
+        { "channel", required_argument, 0, 'c' },
+        { "dedup", required_argument, 0, 'd' },
+        { "force", no_argument, 0, 'f' },
+        { "quiet", no_argument, 0, 'q' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while ((c = getopt_long (argc, argv, "o:c:d:fqh", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'c':
+                channel = optarg;
+                break;
+            case 'd':
+                {
+                    char *endptr = NULL;
+                    dedup = strtoll (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || dedup < 0) {
+                        fprintf (stderr, "Invalid --dedup \"%s\"\n", optarg);
+                        return 1;
+                    }
+                }
+                break;
+            case 'f':
+                force = 1;
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    if (!output || optind == argc) {
+        usage (argv[0]);
+        return 1;
+    }
+    struct stat st;
+    if (!force && 0 == stat (output, &st)) {
+        fprintf (stderr, "Refusing to overwrite existing file \"%s\"\n",
+                output);
+        return 1;
+    }
+
+    int num_inputs = argc - optind;
+    input_t *inputs = (input_t *) calloc (num_inputs, sizeof (input_t));
+    input_t **heap = (input_t **) calloc (num_inputs, sizeof (input_t *));
+    int heap_len = 0;
+    int status = 0;
+    for (int i = 0; i < num_inputs; i++) {
+        input_t *in = &inputs[i];
+        in->path = argv[optind + i];
+        in->log = channel ? lcm_eventlog_create_filtered (in->path, channel) :
+            lcm_eventlog_create (in->path, "r");
+        if (!in->log) {
+            fprintf (stderr, "Unable to open \"%s\"\n", in->path);
+            status = 1;
+            break;
+        }
+        if (0 == read_next (in))
+            heap[heap_len++] = in;
+    }
+
+    lcm_eventlog_t *out = NULL;
+    if (status == 0) {
+        out = lcm_eventlog_create (output, "w");
+        if (!out) {
+            perror ("Error: fopen failed");
+            status = 1;
+        }
+    }
+#ifndef WIN32
+    // the merged events are written in large batches
+    if (out)
+        lcm_eventlog_set_write_flags (out, LCM_EVENTLOG_WRITEV);
+#endif
+
+    // the events merged within the last dedup microseconds, oldest first,
+    // and by hash
+    GQueue *recent = g_queue_new ();
+    GHashTable *recent_hashes = g_hash_table_new (hash_hash, hash_equal);
+    int64_t num_merged = 0;
+    int64_t num_duplicates = 0;
+
+    for (int i = heap_len / 2 - 1; i >= 0; i--)
+        sift_down (heap, heap_len, i);
+    while (out && heap_len > 0) {
+        input_t *in = heap[0];
+        lcm_eventlog_event_t *event = &in->event;
+        int duplicate = 0;
+        if (dedup >= 0) {
+            recent_t *r;
+            while ((r = (recent_t *) g_queue_peek_head (recent)) &&
+                    r->timestamp < event->timestamp - dedup) {
+                g_queue_pop_head (recent);
+                g_hash_table_remove (recent_hashes, &r->hash);
+                free (r);
+            }
+            uint64_t hash = event_hash (event);
+            if (g_hash_table_lookup (recent_hashes, &hash)) {
+                duplicate = 1;
+            } else {
+                r = (recent_t *) malloc (sizeof (recent_t));
+                r->timestamp = event->timestamp;
+                r->hash = hash;
+                g_queue_push_tail (recent, r);
+                g_hash_table_insert (recent_hashes, &r->hash, r);
+            }
+        }
+
+        if (duplicate) {
+            num_duplicates++;
+        } else if (0 != lcm_eventlog_write_event (out, event)) {
+            fprintf (stderr, "Error: Failed to write \"%s\"\n", output);
+            status = 1;
+            break;
+        } else {
+            num_merged++;
+        }
+
+        if (0 != read_next (in))
+            heap[0] = heap[--heap_len];
+        sift_down (heap, heap_len, 0);
+    }
+
+    if (out && 0 != lcm_eventlog_flush (out)) {
+        fprintf (stderr, "Error: Failed to write \"%s\"\n", output);
+        status = 1;
+    }
+    if (out)
+        lcm_eventlog_destroy (out);
+    if (status == 0 && !quiet) {
+        printf ("Merged %" PRId64 " events from %d files into %s",
+                num_merged, num_inputs, output);
+        if (dedup >= 0)
+            printf (", dropping %" PRId64 " duplicates",
+                    num_duplicates);
+        printf ("\n");
+    }
+
+    recent_t *r;
+    while ((r = (recent_t *) g_queue_pop_head (recent)))
+        free (r);
+    g_queue_free (recent);
+    g_hash_table_destroy (recent_hashes);
+    for (int i = 0; i < num_inputs; i++) {
+        if (inputs[i].log)
+            lcm_eventlog_destroy (inputs[i].log);
+        free (inputs[i].event.channel);
+        free (inputs[i].event.data);
+    }
+    free (heap);
+    free (inputs);
+    return status;
+}
@@ -1,11 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/time.h>
 
 #include <string.h>
 
 #include <lcm/lcm.h>
+#include "lcm/lcmtypes/lcm_replay_clock_t.h"
 
+#define DEFAULT_CLOCK_CHANNEL "LCM_REPLAY_CLOCK"
+
+// while waiting for the consumers, say so this often
+#define LOCKSTEP_WARN_USEC 5000000
 
 typedef struct logplayer logplayer_t;
 struct logplayer
@@ -13,8 +21,26 @@ struct logplayer
     lcm_t * lcm_in;
     lcm_t * lcm_out;
     int verbose;
+
+    // Lockstep replay.  Steps numbered below complete_seq have been
+    // acknowledged by num_acks consumers, and acks[seq % window] counts those
+    // of the steps up to next_seq that are still outstanding.
+    const char * clock_channel;
+    int num_acks;
+    int window;
+    int64_t next_seq;
+    int64_t complete_seq;
+    int * acks;
 };
 
+static int64_t
+now_usec (void)
+{
+    struct timeval tv;
+    gettimeofday (&tv, NULL);
+    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 void
 handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
 {
@@ -27,6 +53,133 @@ handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
     lcm_publish (l->lcm_out, channel, rbuf->data, rbuf->data_size);
 }
 
+static void
+ack_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+{
+    logplayer_t * l = (logplayer_t *) u;
+    lcm_replay_clock_t clock;
+    if (lcm_replay_clock_t_decode (rbuf->data, 0, rbuf->data_size,
+                &clock) < 0)
+        return;
+    // acks of steps that are done already, or not played yet, are ignored
+    if (clock.seq < l->complete_seq || clock.seq >= l->next_seq)
+        return;
+    l->acks[clock.seq % l->window]++;
+    while (l->complete_seq < l->next_seq &&
+            l->acks[l->complete_seq % l->window] >= l->num_acks) {
+        l->acks[l->complete_seq % l->window] = 0;
+        l->complete_seq++;
+    }
+}
+
+// handles acks until at most max_outstanding steps are not acknowledged.
+// Returns 0 on success.
+static int
+wait_for_acks (logplayer_t * l, int64_t max_outstanding)
+{
+    int64_t since = now_usec ();
+    while (l->next_seq - l->complete_seq > max_outstanding) {
+        if (lcm_handle_timeout (l->lcm_out, 100) < 0)
+            return -1;
+        if (now_usec () - since >= LOCKSTEP_WARN_USEC) {
+            fprintf (stderr, "Waiting for %d consumers to complete step %"
+                    PRId64 "\n", l->num_acks, l->complete_seq);
+            since = now_usec ();
+        }
+    }
+    return 0;
+}
+
+// publishes the clock for the step that ends at utime, once the window has
+// room for it
+static int
+publish_step (logplayer_t * l, int64_t utime)
+{
+    if (0 != wait_for_acks (l, l->window - 1))
+        return -1;
+    lcm_replay_clock_t clock;
+    clock.utime = utime;
+    clock.seq = l->next_seq++;
+    uint8_t buf[LCM_REPLAY_CLOCK_T_ENCODED_SIZE];
+    lcm_replay_clock_t_encode (buf, 0, sizeof (buf), &clock);
+    return lcm_publish (l->lcm_out, l->clock_channel, buf, sizeof (buf));
+}
+
+// Plays the log as fast as the consumers acknowledge the steps of
+// step_usec of log time, or of one event each if it is 0.
+static int
+play_lockstep (logplayer_t * l, const char * file, const char * expression,
+        const char * ack_channel, int64_t step_usec)
+{
+    lcm_eventlog_t * log = expression ?
+        lcm_eventlog_create_filtered (file, expression) :
+        lcm_eventlog_create (file, "r");
+    if (!log) {
+        fprintf (stderr, "Error: Failed to open %s\n", file);
+        return 1;
+    }
+    l->acks = (int *) calloc (l->window, sizeof (int));
+    lcm_subscription_t * sub = lcm_subscribe (l->lcm_out, ack_channel,
+            ack_handler, l);
+
+    lcm_eventlog_event_t event;
+    memset (&event, 0, sizeof (event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    int64_t step_start = 0;
+    int in_step = 0;
+    int64_t last_utime = 0;
+    int status = 0;
+    while (status == 0 && 0 == lcm_eventlog_read_next_event_into (log,
+                &event, &channel_capacity, &data_capacity)) {
+        if (in_step && event.timestamp - step_start >= step_usec) {
+            status = publish_step (l, last_utime);
+            in_step = 0;
+        }
+        if (!in_step) {
+            step_start = event.timestamp;
+            in_step = 1;
+        }
+        if (l->verbose)
+            printf ("%.3f Channel %-20s size %d\n", event.timestamp / 1e6,
+                    event.channel, event.datalen);
+        if (status == 0)
+            status = lcm_publish (l->lcm_out, event.channel, event.data,
+                    event.datalen);
+        last_utime = event.timestamp;
+        if (step_usec == 0 && status == 0) {
+            status = publish_step (l, last_utime);
+            in_step = 0;
+        }
+    }
+    if (status == 0 && in_step)
+        status = publish_step (l, last_utime);
+    // the replay is done once everything has been handled
+    if (status == 0)
+        status = wait_for_acks (l, 0);
+
+    lcm_unsubscribe (l->lcm_out, sub);
+    free (event.channel);
+    free (event.data);
+    free (l->acks);
+    lcm_eventlog_destroy (log);
+    return status == 0 ? 0 : 1;
+}
+
+// appends s to url, with the characters that would end a URL option escaped
+static void
+append_escaped (char * url, const char * s)
+{
+    url += strlen (url);
+    for (; *s; s++) {
+        if (strchr ("%&?#", *s))
+            url += sprintf (url, "%%%02X", (unsigned char) *s);
+        else
+            *url++ = *s;
+    }
+    *url = 0;
+}
+
 static void
 usage (char * cmd)
 {
@@ -39,6 +192,28 @@ Options:\n\
   -s, --speed=NUM     Playback speed multiplier.  Default is 1.0.\n\
   -e, --regexp=EXPR   GLib regular expression of channels to play.\n\
   -l, --lcm-url=URL   Play logged messages on the specified LCM URL.\n\
+  -r, --read-ahead=N  Read up to N events ahead of playback, from a thread of\n\
+                      its own.\n\
+  -P, --precise       Time playback against the monotonic clock, and sleep\n\
+                      to absolute deadlines.\n\
+  -t, --timing-log=FILE\n\
+                      With --precise, write the scheduling error of each\n\
+                      event to FILE.\n\
+  -m, --preload       Read the events to play into memory before playing\n\
+                      them.\n\
+  -n, --loop[=COUNT]  Play the log from memory over and over, COUNT times if\n\
+                      given.\n\
+  -L, --lockstep=CHAN Play in lockstep with the consumers, as fast as they\n\
+                      acknowledge each step on channel CHAN.\n\
+  -C, --clock-channel=CHAN\n\
+                      With --lockstep, publish the simulated clock that ends\n\
+                      each step on CHAN.  Default is LCM_REPLAY_CLOCK.\n\
+  -a, --acks=N        With --lockstep, wait for N consumers to acknowledge\n\
+                      each step.  Default is 1.\n\
+  -w, --window=N      With --lockstep, let N steps be unacknowledged at\n\
+                      once.  Default is 1.\n\
+  -S, --step=USEC     With --lockstep, make each step USEC microseconds of\n\
+                      the log long, instead of one event.\n\
   -h, --help          Shows some help text and exits.\n\
   \n", cmd);
 }
@@ -50,18 +225,40 @@ main(int argc, char ** argv)
     double speed = 1.0;
     int c;
     char * expression = NULL;
+    int read_ahead = 0;
+    int precise = 0;
+    char * timing_log = NULL;
+    char * lockstep = NULL;
+    int64_t step_usec = 0;
+    int preload = 0;
+    int loop = 0;
+    int loop_count = 0;
     struct option long_opts[] = {
         { "help", no_argument, 0, 'h' },
         { "speed", required_argument, 0, 's' },
         { "lcm-url", required_argument, 0, 'l' },
         { "verbose", no_argument, 0, 'v' },
         { "regexp", required_argument, 0, 'e' },
+        { "read-ahead", required_argument, 0, 'r' },
+        { "precise", no_argument, 0, 'P' },
+        { "timing-log", required_argument, 0, 't' },
+        { "preload", no_argument, 0, 'm' },
+        { "loop", optional_argument, 0, 'n' },
+        { "lockstep", required_argument, 0, 'L' },
+        { "clock-channel", required_argument, 0, 'C' },
+        { "acks", required_argument, 0, 'a' },
+        { "window", required_argument, 0, 'w' },
+        { "step", required_argument, 0, 'S' },
         { 0, 0, 0, 0 }
     };
 
     char *lcmurl = NULL;
     memset (&l, 0, sizeof (logplayer_t));
-    while ((c = getopt_long (argc, argv, "hp:s:ve:l:", long_opts, 0)) >= 0)
+    l.clock_channel = DEFAULT_CLOCK_CHANNEL;
+    l.num_acks = 1;
+    l.window = 1;
+    while ((c = getopt_long (argc, argv, "hp:s:ve:l:r:Pt:mn::L:C:a:w:S:",
+                    long_opts, 0)) >= 0)
     {
         switch (c) {
             case 's':
@@ -77,6 +274,69 @@ main(int argc, char ** argv)
             case 'e':
                 expression = strdup (optarg);
                 break;
+            case 'r':
+                {
+                    char *endptr = NULL;
+                    read_ahead = strtol (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || read_ahead < 0) {
+                        fprintf (stderr, "Invalid --read-ahead \"%s\"\n",
+                                optarg);
+                        return 1;
+                    }
+                }
+                break;
+            case 'P':
+                precise = 1;
+                break;
+            case 't':
+                timing_log = optarg;
+                break;
+            case 'm':
+                preload = 1;
+                break;
+            case 'n':
+                loop = 1;
+                if (optarg) {
+                    char *endptr = NULL;
+                    loop_count = strtol (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || loop_count < 1) {
+                        fprintf (stderr, "Invalid --loop \"%s\"\n", optarg);
+                        return 1;
+                    }
+                }
+                break;
+            case 'L':
+                lockstep = optarg;
+                break;
+            case 'C':
+                l.clock_channel = optarg;
+                break;
+            case 'a':
+            case 'w':
+                {
+                    char *endptr = NULL;
+                    int n = strtol (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || n < 1) {
+                        fprintf (stderr, "Invalid --%s \"%s\"\n",
+                                c == 'a' ? "acks" : "window", optarg);
+                        return 1;
+                    }
+                    if (c == 'a')
+                        l.num_acks = n;
+                    else
+                        l.window = n;
+                }
+                break;
+            case 'S':
+                {
+                    char *endptr = NULL;
+                    step_usec = strtoll (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || step_usec < 0) {
+                        fprintf (stderr, "Invalid --step \"%s\"\n", optarg);
+                        return 1;
+                    }
+                }
+                break;
             case 'h':
             default:
                 usage (argv[0]);
@@ -84,21 +344,65 @@ main(int argc, char ** argv)
         };
     }
 
+    if (timing_log && !precise) {
+        fprintf (stderr, "--timing-log requires --precise\n");
+        return 1;
+    }
     if (optind != argc - 1) {
         usage (argv[0]);
         return 1;
     }
 
     char * file = argv[optind];
+    if (lockstep) {
+        if (precise || read_ahead > 0 || preload || loop)
+            fprintf (stderr, "Warning: --lockstep plays without timing, "
+                    "ignoring --precise, --read-ahead, --preload and "
+                    "--loop\n");
+        l.lcm_out = lcm_create (lcmurl);
+        free (lcmurl);
+        if (!l.lcm_out) {
+            fprintf (stderr, "Error: Failed to create LCM\n");
+            free (expression);
+            return 1;
+        }
+        int status = play_lockstep (&l, file, expression, lockstep,
+                step_usec);
+        lcm_destroy (l.lcm_out);
+        free (expression);
+        return status;
+    }
+
     printf ("Using playback speed %f\n", speed);
+    // the file provider only reads the events on the channels to play, and
+    // uses the log's index to skip over the others
+    int filtered = expression != NULL;
     if (!expression)
         expression = strdup (".*");
 #ifndef WIN32
-    char url_in[strlen(file) + 64];
+    char url_in[strlen(file) + (timing_log ? strlen(timing_log) : 0) +
+        3 * strlen(expression) + 192];
 #else
     char url_in[2048];
 #endif
     sprintf (url_in, "file://%s?speed=%f", argv[optind], speed);
+    if (read_ahead > 0)
+        sprintf (url_in + strlen (url_in), "&read_ahead=%d", read_ahead);
+    if (precise)
+        strcat (url_in, "&precise=1");
+    if (preload)
+        strcat (url_in, "&preload=1");
+    if (loop)
+        sprintf (url_in + strlen (url_in), "&loop=1&loop_count=%d",
+                loop_count);
+    if (timing_log) {
+        strcat (url_in, "&timing_log=");
+        strcat (url_in, timing_log);
+    }
+    if (filtered) {
+        strcat (url_in, "&channel=");
+        append_escaped (url_in, expression);
+    }
     l.lcm_in = lcm_create (url_in);
     if (!l.lcm_in) {
         fprintf (stderr, "Error: Failed to open %s\n", file);
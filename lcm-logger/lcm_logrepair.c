@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <sys/stat.h>
+
+#include <lcm/lcm.h>
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...] -o OUTPUT FILE\n\
+  Copies the whole events of a damaged LCM log file, e.g. one cut short by\n\
+  a power failure, into a clean log with an index, skipping the rest.\n\
+\n\
+Options:\n\
+  -o, --output=OUTPUT  Write the repaired log to OUTPUT.\n\
+  -f, --force          Overwrite OUTPUT if it exists.\n\
+  -q, --quiet          Do not print a summary.\n\
+  -h, --help           Shows some help text and exits.\n\
+  \n", cmd);
+}
+
+int
+main(int argc, char ** argv)
+{
+    char *output = NULL;
+    int force = 0;
+    int quiet = 0;
+
+    int c;
+    struct option long_opts[] = {
+        { "output", required_argument, 0, 'o' },
+        { "force", no_argument, 0, 'f' },
+        { "quiet", no_argument, 0, 'q' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while ((c = getopt_long (argc, argv, "o:fqh", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'o':
+                output = optarg;
+                break;
+            case 'f':
+                force = 1;
+                break;
+            case 'q':
+                quiet = 1;
+                break;
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    if (!output || optind != argc - 1) {
+        usage (argv[0]);
+        return 1;
+    }
+    const char *input = argv[optind];
+    struct stat st, in_st;
+    if (0 == stat (output, &st)) {
+        if (0 == stat (input, &in_st) && st.st_dev == in_st.st_dev &&
+                st.st_ino == in_st.st_ino) {
+            fprintf (stderr, "The output can not be the input\n");
+            return 1;
+        }
+        if (!force) {
+            fprintf (stderr, "Refusing to overwrite existing file \"%s\"\n",
+                    output);
+            return 1;
+        }
+    }
+
+    lcm_eventlog_repair_stats_t stats;
+    if (0 != lcm_eventlog_repair (input, output, &stats)) {
+        fprintf (stderr, "Error: Failed to repair %s\n", input);
+        return 1;
+    }
+    if (!quiet)
+        printf ("%" PRId64 " events kept, %" PRId64 " bytes in %" PRId64
+                " damaged stretches skipped\n", stats.num_events,
+                stats.bytes_skipped, stats.num_damaged);
+    return 0;
+}
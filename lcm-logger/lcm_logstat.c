@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <inttypes.h>
+
+#include <glib.h>
+#include <lcm/lcm.h>
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...] FILE...\n\
+  Prints how many events and bytes each channel of LCM log files has, at\n\
+  what rate, and the longest gap between its events.  Logs with an index\n\
+  are summarized from it, and others from their event headers alone.\n\
+\n\
+Options:\n\
+  -j, --threads=N     Read a log that has to be read with N threads.\n\
+  -c, --csv           Print comma-separated values, with absolute\n\
+                      timestamps in microseconds.\n\
+  -h, --help          Shows some help text and exits.\n\
+  \n", cmd);
+}
+
+static void
+print_stats (const char *path, const lcm_eventlog_channel_stats_t *stats,
+        int num, int csv)
+{
+    if (csv) {
+        for (int i = 0; i < num; i++) {
+            const lcm_eventlog_channel_stats_t *cs = &stats[i];
+            printf ("%s,%s,%" PRId64 ",%" PRId64 ",%" PRId64 ",%" PRId64
+                    ",%" PRId64 "\n", path, cs->channel, cs->num_events,
+                    cs->num_bytes, cs->first_timestamp, cs->last_timestamp,
+                    cs->max_gap);
+        }
+        return;
+    }
+
+    int64_t start = INT64_MAX, end = INT64_MIN;
+    int64_t num_events = 0, num_bytes = 0;
+    int width = 7;
+    for (int i = 0; i < num; i++) {
+        start = MIN (start, stats[i].first_timestamp);
+        end = MAX (end, stats[i].last_timestamp);
+        num_events += stats[i].num_events;
+        num_bytes += stats[i].num_bytes;
+        width = MAX (width, (int) strlen (stats[i].channel));
+    }
+    printf ("%s: %d channels, %" PRId64 " events, %" PRId64 " bytes",
+            path, num, num_events, num_bytes);
+    if (num)
+        printf (", %.3f s from %" PRId64, (end - start) * 1e-6, start);
+    printf ("\n");
+    if (!num)
+        return;
+
+    printf ("%-*s %12s %14s %10s %10s %10s %12s %10s\n", width, "CHANNEL",
+            "EVENTS", "BYTES", "FIRST(s)", "LAST(s)", "RATE(Hz)",
+            "BW(kB/s)", "MAXGAP(ms)");
+    for (int i = 0; i < num; i++) {
+        const lcm_eventlog_channel_stats_t *cs = &stats[i];
+        double span = (cs->last_timestamp - cs->first_timestamp) * 1e-6;
+        // a rate is the number of intervals between events over their span
+        double rate = span > 0 ? (cs->num_events - 1) / span : 0;
+        double bw = span > 0 ? cs->num_bytes / span / 1e3 : 0;
+        printf ("%-*s %12" PRId64 " %14" PRId64 " %10.3f %10.3f %10.2f "
+                "%12.2f %10.3f\n", width, cs->channel, cs->num_events,
+                cs->num_bytes, (cs->first_timestamp - start) * 1e-6,
+                (cs->last_timestamp - start) * 1e-6, rate, bw,
+                cs->max_gap * 1e-3);
+    }
+}
+
+int
+main(int argc, char ** argv)
+{
+    int num_threads = 1;
+    int csv = 0;
+
+    int c;
+    struct option long_opts[] = {
+        { "threads", required_argument, 0, 'j' },
+        { "csv", no_argument, 0, 'c' },
+        { "help", no_argument, 0, 'h' },
+        { 0, 0, 0, 0 }
+    };
+
+    while ((c = getopt_long (argc, argv, "j:ch", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'j':
+                {
+                    char *endptr = NULL;
+                    num_threads = strtol (optarg, &endptr, 10);
+                    if (endptr == optarg || *endptr || num_threads < 1) {
+                        fprintf (stderr, "Invalid --threads \"%s\"\n",
+                                optarg);
+                        return 1;
+                    }
+                }
+                break;
+            case 'c':
+                csv = 1;
+                break;
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    if (optind == argc) {
+        usage (argv[0]);
+        return 1;
+    }
+
+    if (csv)
+        printf ("file,channel,events,bytes,first_utime,last_utime,"
+                "max_gap_usec\n");
+    int status = 0;
+    for (int i = optind; i < argc; i++) {
+        lcm_eventlog_channel_stats_t *stats = NULL;
+        int num = lcm_eventlog_get_channel_stats (argv[i], num_threads,
+                &stats);
+        if (num < 0) {
+            fprintf (stderr, "Error: Failed to read %s\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        if (i > optind && !csv)
+            printf ("\n");
+        print_stats (argv[i], stats, num, csv);
+        lcm_eventlog_free_channel_stats (stats, num);
+    }
+    return status;
+}
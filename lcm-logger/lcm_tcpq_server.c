@@ -0,0 +1,663 @@
+// for accept4
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <glib.h>
+
+#include <lcm/channel_matcher.h>
+#include <lcm/lcm_clock.h>
+
+// Relays messages between tcpq:// clients.  Speaks the same protocol as the
+// Java lcm.lcm.TCPService, but serves every client from one epoll loop.
+
+#define MAGIC_SERVER 0x287617fa      // first word sent by server
+#define MAGIC_CLIENT 0x287617fb      // first word sent by client
+#define PROTOCOL_VERSION 0x0100
+#define MESSAGE_TYPE_PUBLISH     1
+#define MESSAGE_TYPE_SUBSCRIBE   2
+#define MESSAGE_TYPE_UNSUBSCRIBE 3
+
+#define DEFAULT_PORT 7700
+#define DEFAULT_MAX_QUEUE_KB 4096
+#define RECV_BUF_SIZE (64 * 1024)
+#define MAX_EVENTS 64
+#define MAX_SEND_IOVS 64
+
+// A message as it goes out on the wire.  Published messages are forwarded
+// exactly as the publisher framed them, so one copy is shared by the output
+// queues of all the subscribers.
+typedef struct _relay_msg relay_msg_t;
+struct _relay_msg {
+    int ref;
+    uint32_t size;
+    char data[];
+};
+
+typedef struct _client client_t;
+
+typedef struct _subscription subscription_t;
+struct _subscription {
+    char *text;                     // the pattern as sent by the client
+    lcm_channel_pattern_t *pattern;
+    client_t *client;
+};
+
+struct _client {
+    int fd;
+    int id;
+    int hello_received;
+    int dead;
+    int want_write;
+
+    // received bytes not yet parsed are in_buf[in_start, in_end)
+    char *in_buf;
+    uint32_t in_buf_len;
+    uint32_t in_start;
+    uint32_t in_end;
+
+    // ring of queued messages.  The first out_offset bytes of the oldest one
+    // have been sent already.
+    relay_msg_t **out_msgs;
+    unsigned int out_cap;
+    unsigned int out_head;
+    unsigned int out_count;
+    uint32_t out_offset;
+    int64_t out_bytes;
+
+    GPtrArray *subs;                // subscription_t*, in subscription order
+    uint64_t last_relay;            // relay stamp, to send each message once
+    int64_t dropped;
+};
+
+typedef struct _server server_t;
+struct _server {
+    int listen_fd;
+    int epoll_fd;
+    int64_t max_queue_bytes;
+    int verbose;
+
+    GHashTable *clients;            // fd -> client_t*
+    GPtrArray *dead_clients;
+    lcm_channel_matcher_t *matcher; // subscription_t*
+    GPtrArray *matches;
+    uint64_t relay_count;
+    int next_client_id;
+
+    relay_msg_t *hello;
+
+    int64_t bytes_in;
+    int64_t msgs_in;
+    int64_t dropped;
+};
+
+static volatile sig_atomic_t _quit = 0;
+
+static void
+quit_handler (int signum)
+{
+    _quit = 1;
+}
+
+static relay_msg_t *
+relay_msg_new (const void *data, uint32_t size)
+{
+    relay_msg_t *msg = (relay_msg_t *) malloc (sizeof (relay_msg_t) + size);
+    if (!msg)
+        return NULL;
+    msg->ref = 1;
+    msg->size = size;
+    memcpy (msg->data, data, size);
+    return msg;
+}
+
+static void
+relay_msg_unref (relay_msg_t *msg)
+{
+    if (!--msg->ref)
+        free (msg);
+}
+
+static uint32_t
+get_uint32 (const char *p)
+{
+    uint32_t v;
+    memcpy (&v, p, 4);
+    return ntohl (v);
+}
+
+static void
+client_watch (server_t *server, client_t *client, int want_write)
+{
+    if (client->want_write == want_write)
+        return;
+    struct epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN | (want_write ? EPOLLOUT : 0);
+    ev.data.ptr = client;
+    if (epoll_ctl (server->epoll_fd, EPOLL_CTL_MOD, client->fd, &ev) < 0)
+        perror ("epoll_ctl");
+    client->want_write = want_write;
+}
+
+static void
+client_kill (server_t *server, client_t *client)
+{
+    if (client->dead)
+        return;
+    client->dead = 1;
+    epoll_ctl (server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    for (unsigned int i = 0; i < client->subs->len; i++) {
+        subscription_t *sub = (subscription_t *) g_ptr_array_index (
+                client->subs, i);
+        lcm_channel_matcher_remove (server->matcher, sub->pattern, sub);
+    }
+    g_ptr_array_add (server->dead_clients, client);
+}
+
+static void
+subscription_destroy (subscription_t *sub)
+{
+    lcm_channel_pattern_free (sub->pattern);
+    free (sub->text);
+    free (sub);
+}
+
+static void
+client_destroy (server_t *server, client_t *client)
+{
+    if (server->verbose)
+        printf ("client %d disconnected, %" PRId64 " messages dropped\n",
+                client->id, client->dropped);
+    g_hash_table_remove (server->clients, GINT_TO_POINTER (client->fd));
+    close (client->fd);
+    for (unsigned int i = 0; i < client->subs->len; i++)
+        subscription_destroy ((subscription_t *) g_ptr_array_index (
+                    client->subs, i));
+    g_ptr_array_free (client->subs, TRUE);
+    for (unsigned int i = 0; i < client->out_count; i++)
+        relay_msg_unref (client->out_msgs[(client->out_head + i) %
+                client->out_cap]);
+    free (client->out_msgs);
+    free (client->in_buf);
+    free (client);
+}
+
+// Writes as much of the output queue as the socket takes without blocking.
+static void
+client_flush (server_t *server, client_t *client)
+{
+    while (client->out_count && !client->dead) {
+        struct iovec iov[MAX_SEND_IOVS];
+        unsigned int iovcnt = 0;
+        for (; iovcnt < MAX_SEND_IOVS && iovcnt < client->out_count;
+                iovcnt++) {
+            relay_msg_t *msg = client->out_msgs[(client->out_head + iovcnt) %
+                client->out_cap];
+            uint32_t offset = iovcnt ? 0 : client->out_offset;
+            iov[iovcnt].iov_base = msg->data + offset;
+            iov[iovcnt].iov_len = msg->size - offset;
+        }
+        struct msghdr mh;
+        memset (&mh, 0, sizeof (mh));
+        mh.msg_iov = iov;
+        mh.msg_iovlen = iovcnt;
+        ssize_t sent = sendmsg (client->fd, &mh, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            client_kill (server, client);
+            return;
+        }
+        client->out_bytes -= sent;
+        while (sent > 0) {
+            relay_msg_t *msg = client->out_msgs[client->out_head];
+            uint32_t remaining = msg->size - client->out_offset;
+            if (sent < remaining) {
+                client->out_offset += sent;
+                break;
+            }
+            sent -= remaining;
+            client->out_offset = 0;
+            relay_msg_unref (msg);
+            client->out_head = (client->out_head + 1) % client->out_cap;
+            client->out_count--;
+        }
+    }
+    if (!client->dead)
+        client_watch (server, client, client->out_count > 0);
+}
+
+// Queues a message for a client, or drops it if the client is too far
+// behind.  A message is never dropped from an empty queue, so that a client
+// always receives messages larger than the bound.
+static void
+client_send (server_t *server, client_t *client, relay_msg_t *msg)
+{
+    if (client->out_count &&
+            client->out_bytes + msg->size > server->max_queue_bytes) {
+        client->dropped++;
+        server->dropped++;
+        return;
+    }
+    if (client->out_count == client->out_cap) {
+        unsigned int cap = client->out_cap ? 2 * client->out_cap : 16;
+        relay_msg_t **msgs = (relay_msg_t **) malloc (cap * sizeof (*msgs));
+        for (unsigned int i = 0; i < client->out_count; i++)
+            msgs[i] = client->out_msgs[(client->out_head + i) %
+                client->out_cap];
+        free (client->out_msgs);
+        client->out_msgs = msgs;
+        client->out_cap = cap;
+        client->out_head = 0;
+    }
+    msg->ref++;
+    client->out_msgs[(client->out_head + client->out_count) %
+        client->out_cap] = msg;
+    client->out_count++;
+    client->out_bytes += msg->size;
+
+    // the queue was empty, so the socket is probably writable
+    if (client->out_count == 1)
+        client_flush (server, client);
+}
+
+static void
+relay (server_t *server, const char *channel, const char *frame,
+        uint32_t frame_size)
+{
+    server->msgs_in++;
+    server->bytes_in += frame_size;
+
+    g_ptr_array_set_size (server->matches, 0);
+    lcm_channel_matcher_lookup (server->matcher, channel, server->matches);
+    if (!server->matches->len)
+        return;
+
+    relay_msg_t *msg = relay_msg_new (frame, frame_size);
+    if (!msg) {
+        fprintf (stderr, "Memory allocation error\n");
+        return;
+    }
+    uint64_t stamp = ++server->relay_count;
+    for (unsigned int i = 0; i < server->matches->len; i++) {
+        subscription_t *sub = (subscription_t *) g_ptr_array_index (
+                server->matches, i);
+        client_t *client = sub->client;
+        if (client->dead || client->last_relay == stamp)
+            continue;
+        client->last_relay = stamp;
+        client_send (server, client, msg);
+    }
+    relay_msg_unref (msg);
+}
+
+static void
+client_subscribe (server_t *server, client_t *client, const char *text)
+{
+    GError *err = NULL;
+    lcm_channel_pattern_t *pattern = lcm_channel_pattern_new (text, &err);
+    if (!pattern) {
+        fprintf (stderr, "client %d: invalid subscription \"%s\": %s\n",
+                client->id, text, err->message);
+        g_error_free (err);
+        return;
+    }
+    subscription_t *sub = (subscription_t *) calloc (1, sizeof (*sub));
+    sub->text = strdup (text);
+    sub->pattern = pattern;
+    sub->client = client;
+    g_ptr_array_add (client->subs, sub);
+    lcm_channel_matcher_add (server->matcher, pattern, sub);
+    if (server->verbose)
+        printf ("client %d subscribed to \"%s\"\n", client->id, text);
+}
+
+static void
+client_unsubscribe (server_t *server, client_t *client, const char *text)
+{
+    for (unsigned int i = 0; i < client->subs->len; i++) {
+        subscription_t *sub = (subscription_t *) g_ptr_array_index (
+                client->subs, i);
+        if (strcmp (sub->text, text))
+            continue;
+        lcm_channel_matcher_remove (server->matcher, sub->pattern, sub);
+        g_ptr_array_remove_index (client->subs, i);
+        subscription_destroy (sub);
+        if (server->verbose)
+            printf ("client %d unsubscribed from \"%s\"\n", client->id, text);
+        return;
+    }
+}
+
+// Handles the messages received in full.  Returns -1 if the client sent
+// something invalid.
+static int
+client_parse (server_t *server, client_t *client)
+{
+    while (!client->dead) {
+        char *p = client->in_buf + client->in_start;
+        uint32_t avail = client->in_end - client->in_start;
+
+        if (!client->hello_received) {
+            if (avail < 8)
+                break;
+            if (get_uint32 (p) != MAGIC_CLIENT) {
+                fprintf (stderr, "client %d: invalid magic\n", client->id);
+                return -1;
+            }
+            client->hello_received = 1;
+            client->in_start += 8;
+            continue;
+        }
+
+        // message type, channel length, channel, and for publish the
+        // payload size and payload
+        int64_t need = 8;
+        if (avail >= need) {
+            uint32_t type = get_uint32 (p);
+            need += get_uint32 (p + 4);
+            if (type == MESSAGE_TYPE_PUBLISH) {
+                need += 4;
+                if (avail >= need)
+                    need += get_uint32 (p + need - 4);
+            }
+        }
+        if (need > INT32_MAX) {
+            fprintf (stderr, "client %d: message too large\n", client->id);
+            return -1;
+        }
+        if (avail < need) {
+            if (need > client->in_buf_len - client->in_start) {
+                // make room for the rest of the message
+                memmove (client->in_buf, p, avail);
+                client->in_start = 0;
+                client->in_end = avail;
+                if (need > client->in_buf_len) {
+                    char *buf = (char *) realloc (client->in_buf, need);
+                    if (!buf) {
+                        fprintf (stderr, "Memory allocation error\n");
+                        return -1;
+                    }
+                    client->in_buf = buf;
+                    client->in_buf_len = need;
+                }
+            }
+            break;
+        }
+
+        uint32_t type = get_uint32 (p);
+        uint32_t channel_len = get_uint32 (p + 4);
+        char *channel = g_strndup (p + 8, channel_len);
+        client->in_start += need;
+        switch (type) {
+            case MESSAGE_TYPE_PUBLISH:
+                relay (server, channel, p, need);
+                break;
+            case MESSAGE_TYPE_SUBSCRIBE:
+                client_subscribe (server, client, channel);
+                break;
+            case MESSAGE_TYPE_UNSUBSCRIBE:
+                client_unsubscribe (server, client, channel);
+                break;
+            default:
+                break;
+        }
+        g_free (channel);
+    }
+    if (client->in_start == client->in_end)
+        client->in_start = client->in_end = 0;
+    return 0;
+}
+
+static void
+client_read (server_t *server, client_t *client)
+{
+    ssize_t n = recv (client->fd, client->in_buf + client->in_end,
+            client->in_buf_len - client->in_end, 0);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+        return;
+    if (n <= 0 || (client->in_end += n, client_parse (server, client) < 0))
+        client_kill (server, client);
+}
+
+static void
+accept_clients (server_t *server)
+{
+    while (1) {
+        struct sockaddr_in addr;
+        socklen_t addrlen = sizeof (addr);
+        int fd = accept4 (server->listen_fd, (struct sockaddr *) &addr,
+                &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror ("accept");
+            return;
+        }
+        int one = 1;
+        setsockopt (fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof (one));
+
+        client_t *client = (client_t *) calloc (1, sizeof (client_t));
+        client->fd = fd;
+        client->id = server->next_client_id++;
+        client->in_buf_len = RECV_BUF_SIZE;
+        client->in_buf = (char *) malloc (client->in_buf_len);
+        client->subs = g_ptr_array_new ();
+
+        struct epoll_event ev;
+        memset (&ev, 0, sizeof (ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        if (epoll_ctl (server->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror ("epoll_ctl");
+            close (fd);
+            g_ptr_array_free (client->subs, TRUE);
+            free (client->in_buf);
+            free (client);
+            continue;
+        }
+        g_hash_table_insert (server->clients, GINT_TO_POINTER (fd), client);
+        if (server->verbose)
+            printf ("client %d connected from %s:%d\n", client->id,
+                    inet_ntoa (addr.sin_addr), ntohs (addr.sin_port));
+
+        client_send (server, client, server->hello);
+    }
+}
+
+static void
+usage (char * cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...]\n\
+  Relays LCM messages between tcpq:// clients.\n\
+\n\
+Options:\n\
+  -p, --port=PORT        TCP port to listen on.  Default is %d.\n\
+  -b, --bind=ADDR        Address to listen on.  Default is all interfaces.\n\
+  -q, --max-queue-kb=N   Messages queued for a client are capped at N\n\
+                         kilobytes.  Messages that do not fit are dropped\n\
+                         for that client.  Default is %d.\n\
+  -v, --verbose          Print connections and throughput once a second.\n\
+  -h, --help             Shows this help text and exits.\n\
+  \n", cmd, DEFAULT_PORT, DEFAULT_MAX_QUEUE_KB);
+}
+
+int
+main (int argc, char ** argv)
+{
+    server_t server;
+    memset (&server, 0, sizeof (server));
+    server.max_queue_bytes = (int64_t) DEFAULT_MAX_QUEUE_KB * 1024;
+
+    int port = DEFAULT_PORT;
+    struct in_addr bind_addr;
+    bind_addr.s_addr = htonl (INADDR_ANY);
+
+    struct option long_opts[] = {
+        { "help", no_argument, 0, 'h' },
+        { "port", required_argument, 0, 'p' },
+        { "bind", required_argument, 0, 'b' },
+        { "max-queue-kb", required_argument, 0, 'q' },
+        { "verbose", no_argument, 0, 'v' },
+        { 0, 0, 0, 0 }
+    };
+
+    int c;
+    char *endptr = NULL;
+    while ((c = getopt_long (argc, argv, "hp:b:q:v", long_opts, 0)) >= 0)
+    {
+        switch (c) {
+            case 'p':
+                port = strtol (optarg, &endptr, 0);
+                if (*endptr || port <= 0 || port > 65535) {
+                    usage (argv[0]);
+                    return 1;
+                }
+                break;
+            case 'b':
+                if (!inet_aton (optarg, &bind_addr)) {
+                    fprintf (stderr, "Invalid address \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'q':
+                server.max_queue_bytes = strtoll (optarg, &endptr, 0) * 1024;
+                if (*endptr || server.max_queue_bytes <= 0) {
+                    usage (argv[0]);
+                    return 1;
+                }
+                break;
+            case 'v':
+                server.verbose = 1;
+                break;
+            case 'h':
+            default:
+                usage (argv[0]);
+                return 1;
+        };
+    }
+
+    signal (SIGPIPE, SIG_IGN);
+    signal (SIGINT, quit_handler);
+    signal (SIGTERM, quit_handler);
+
+    server.listen_fd = socket (AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (server.listen_fd < 0) {
+        perror ("socket");
+        return 1;
+    }
+    int one = 1;
+    setsockopt (server.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one,
+            sizeof (one));
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = bind_addr;
+    addr.sin_port = htons (port);
+    if (bind (server.listen_fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+            listen (server.listen_fd, SOMAXCONN) < 0) {
+        perror ("bind");
+        close (server.listen_fd);
+        return 1;
+    }
+
+    server.epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+    if (server.epoll_fd < 0) {
+        perror ("epoll_create1");
+        close (server.listen_fd);
+        return 1;
+    }
+    struct epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl (server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &ev);
+
+    server.clients = g_hash_table_new (g_direct_hash, g_direct_equal);
+    server.dead_clients = g_ptr_array_new ();
+    server.matcher = lcm_channel_matcher_new ();
+    server.matches = g_ptr_array_new ();
+    uint32_t hello[2] = { htonl (MAGIC_SERVER), htonl (PROTOCOL_VERSION) };
+    server.hello = relay_msg_new (hello, sizeof (hello));
+
+    printf ("LCM tcpq server listening on %s:%d\n", inet_ntoa (bind_addr),
+            port);
+
+    int64_t report_utime = lcm_clock_monotonic_us ();
+    while (!_quit) {
+        struct epoll_event events[MAX_EVENTS];
+        int nevents = epoll_wait (server.epoll_fd, events, MAX_EVENTS, 1000);
+        if (nevents < 0 && errno != EINTR) {
+            perror ("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < nevents; i++) {
+            client_t *client = (client_t *) events[i].data.ptr;
+            if (!client) {
+                accept_clients (&server);
+                continue;
+            }
+            if (client->dead)
+                continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+                client_kill (&server, client);
+            else if (events[i].events & EPOLLIN)
+                client_read (&server, client);
+            if (!client->dead && (events[i].events & EPOLLOUT))
+                client_flush (&server, client);
+        }
+
+        // clients are only freed here, since a fan-out may visit a client
+        // after an earlier write to it failed
+        for (unsigned int i = 0; i < server.dead_clients->len; i++)
+            client_destroy (&server, (client_t *) g_ptr_array_index (
+                        server.dead_clients, i));
+        g_ptr_array_set_size (server.dead_clients, 0);
+
+        int64_t now = lcm_clock_monotonic_us ();
+        if (server.verbose && now - report_utime >= 1000000) {
+            double dt = (now - report_utime) / 1000000.0;
+            printf ("%10.1f kB/s, %10.1f msg/s, %d clients, %" PRId64
+                    " dropped\n", server.bytes_in / 1024.0 / dt,
+                    server.msgs_in / dt, g_hash_table_size (server.clients),
+                    server.dropped);
+            server.bytes_in = server.msgs_in = server.dropped = 0;
+            report_utime = now;
+        }
+    }
+
+    GList *clients = g_hash_table_get_values (server.clients);
+    for (GList *elem = clients; elem; elem = elem->next)
+        client_kill (&server, (client_t *) elem->data);
+    g_list_free (clients);
+    for (unsigned int i = 0; i < server.dead_clients->len; i++)
+        client_destroy (&server, (client_t *) g_ptr_array_index (
+                    server.dead_clients, i));
+    g_ptr_array_free (server.dead_clients, TRUE);
+    g_hash_table_destroy (server.clients);
+    g_ptr_array_free (server.matches, TRUE);
+    lcm_channel_matcher_free (server.matcher);
+    relay_msg_unref (server.hello);
+    close (server.epoll_fd);
+    close (server.listen_fd);
+    return 0;
+}
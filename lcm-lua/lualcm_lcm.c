@@ -36,6 +36,11 @@
  * table.
  *
  * The LCM userdata __gc does the same thing, but for all remaining entries.
+ *
+ * The environment/uservalue table also holds a single buffer userdata, which
+ * is handed to the handlers of subscriptions made with the buffer option
+ * instead of a string. The buffer points to the received message, so no copy
+ * of the payload is made, and it is only valid while the handler runs.
  */
 
 /* lcm userdata */
@@ -51,12 +56,19 @@ static int impl_lcm_unsubscribe(lua_State *);
 static int impl_lcm_publish(lua_State *);
 static int impl_lcm_handle(lua_State *);
 static int impl_lcm_handle_timeout(lua_State *);
+static int impl_lcm_handle_batch(lua_State *);
 static int impl_lcm_timedhandle(lua_State *); /* depricated! */
 
 /* metamethods */
 static int impl_lcm_tostring(lua_State *);
 static int impl_lcm_gc(lua_State *);
 
+/* buffer methods and metamethods */
+static int impl_buffer_size(lua_State *);
+static int impl_buffer_sub(lua_State *);
+static int impl_buffer_byte(lua_State *);
+static int impl_buffer_tostring(lua_State *);
+
 /* supporting functions */
 static void impl_lcm_c_handler(const lcm_recv_buf_t *, const char *, void *);
 static impl_lcm_userdata_t *impl_lcm_newuserdata(lua_State *);
@@ -75,8 +87,15 @@ typedef struct impl_sub_userdata {
   lcm_subscription_t *subscription;
   impl_lcm_userdata_t *owning_lcm_userdata;
   int ref_num;
+  int deliver_buffer;
 } impl_sub_userdata_t;
 
+/* buffer userdata, data is NULL outside of a handler */
+typedef struct impl_buffer_userdata {
+  const char *data;
+  size_t data_size;
+} impl_buffer_userdata_t;
+
 static int impl_abs_index(lua_State *L, int i) {
   return i > 0 ? i : i <= LUA_REGISTRYINDEX ? i : lua_gettop(L) + 1 + i;
 }
@@ -109,6 +128,7 @@ void ll_lcm_makemetatable(lua_State *L) {
       {"publish", impl_lcm_publish},
       {"handle", impl_lcm_handle},
       {"handle_timeout", impl_lcm_handle_timeout},
+      {"handle_batch", impl_lcm_handle_batch},
       {"timedhandle", impl_lcm_timedhandle},
       {NULL, NULL},
   };
@@ -126,6 +146,34 @@ void ll_lcm_makemetatable(lua_State *L) {
 
   /* pop the metatable */
   lua_pop(L, 1);
+
+  /* the buffer userdata's metatable is named "lcm.buffer" */
+  if (!luaL_newmetatable(L, "lcm.buffer")) {
+    lua_pushstring(L, "cannot create metatable");
+    lua_error(L);
+  }
+
+  const struct luaL_Reg buffer_metas[] = {
+      {"__len", impl_buffer_size},
+      {"__tostring", impl_buffer_tostring},
+      {NULL, NULL},
+  };
+
+  luaX_registertable(L, buffer_metas);
+
+  const struct luaL_Reg buffer_methods[] = {
+      {"size", impl_buffer_size},
+      {"sub", impl_buffer_sub},
+      {"byte", impl_buffer_byte},
+      {NULL, NULL},
+  };
+
+  lua_pushstring(L, "__index");
+  lua_newtable(L);
+  luaX_registertable(L, buffer_methods);
+  lua_rawset(L, -3);
+
+  lua_pop(L, 1);
 }
 
 /**
@@ -252,9 +300,16 @@ static int impl_lcm_publish(lua_State *L) {
  *
  * @see lcm_subscribe
  *
+ * The handler is called with the channel and the message data, which is a
+ * string. If the options table has a true "buffer" field, the message data
+ * is given as a buffer userdata instead. The buffer is not a copy of the
+ * message and is reused for every message, so it can only be read while the
+ * handler runs: its length is #buffer, and buffer:sub(i, j) and
+ * buffer:byte(i, j) work like their string counterparts.
+ *
  * @pre The Lua arguments on the stack:
- *     A LCM userdata (self), a string containing the channel, and a function
- *     for the handler.
+ *     A LCM userdata (self), a string containing the channel, a function
+ *     for the handler, and an optional table of options.
  *
  * @post The Lua return values on the stack:
  *     A subscription reference number.
@@ -263,8 +318,8 @@ static int impl_lcm_publish(lua_State *L) {
  * @return The number of return values on the Lua stack.
  */
 static int impl_lcm_subscribe(lua_State *L) {
-  /* we expect 3 arguments */
-  lua_settop(L, 3);
+  /* we expect 4 arguments */
+  lua_settop(L, 4);
 
   /* get the lcm userdata */
   impl_lcm_userdata_t *lcmu = impl_lcm_checkuserdata(L, 1);
@@ -275,11 +330,25 @@ static int impl_lcm_subscribe(lua_State *L) {
   /* check the handler */
   luaL_checktype(L, 3, LUA_TFUNCTION);
 
+  /* check the options */
+  int deliver_buffer = 0;
+  if (!lua_isnil(L, 4)) {
+    luaL_checktype(L, 4, LUA_TTABLE);
+    lua_pushstring(L, "buffer");
+    lua_rawget(L, 4);
+    deliver_buffer = lua_toboolean(L, -1);
+    lua_pop(L, 1);
+  }
+
+  /* leave the handler on top of the stack */
+  lua_settop(L, 3);
+
   /* add a subscription table entry */
   int *ref_num_ptr;
   lcm_subscription_t **subscription;
-  void *userdata =
+  impl_sub_userdata_t *userdata = (impl_sub_userdata_t *)
       impl_lcm_addtosubscriptiontable(L, 1, &ref_num_ptr, &subscription);
+  userdata->deliver_buffer = deliver_buffer;
 
   /* pop subscription table */
   lua_pop(L, 1);
@@ -397,6 +466,66 @@ static int impl_lcm_handle_timeout(lua_State *L) {
   return 1;
 }
 
+/**
+ * Handles up to a given number of incoming messages. Calls lcm_handle_batch.
+ * Blocks for the given amount of time for the first message, and then
+ * handles the messages that have already been received without waiting for
+ * more, so that a high message rate costs fewer calls from Lua.
+ *
+ * Notice that the handle method prepares the Lua stack for the handler
+ * functions. When the handler functions execute, the Lua stack contains only
+ * the LCM userdata.
+ *
+ * Recursive calls to handle are not allowed, therefore handlers must not
+ * call handle.
+ *
+ * @see lcm_handle_batch
+ *
+ * @pre The Lua arguments on the stack:
+ *     A LCM userdata (self), the maximum number of messages to handle, and a
+ *     number of milliseconds to block for the first message.
+ *
+ * @post The Lua return values on the stack:
+ *     The number of messages handled, which is 0 on timeout.
+ *
+ * @param L The Lua state.
+ * @return The number of return values on the Lua stack.
+ *
+ * @throws Lua error if the messages cannot be handled.
+ */
+static int impl_lcm_handle_batch(lua_State *L) {
+  /* we expect 3 arguments */
+  lua_settop(L, 3);
+
+  /* get the lcm userdata */
+  impl_lcm_userdata_t *lcmu = impl_lcm_checkuserdata(L, 1);
+
+  /* check the number of messages and the timeout in milliseconds */
+  lua_Integer max_msgs = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, max_msgs > 0, 2, "must be positive");
+  lua_Integer timeout_millisec = luaL_checkinteger(L, 3);
+  luaL_argcheck(L, timeout_millisec >= 0, 3, "must not be negative");
+
+  /* the handlers expect only the lcm userdata on the stack */
+  lua_settop(L, 1);
+
+  /* update the lua state */
+  lcmu->handler_lua_State = L;
+
+  /* call lcm handle_batch */
+  int status = lcm_handle_batch(lcmu->lcm, max_msgs, timeout_millisec);
+
+  if (status < 0) {
+    /* an error occurred */
+    lua_pushstring(L, "error lcm handle");
+    lua_error(L);
+  }
+
+  lua_pushinteger(L, status);
+
+  return 1;
+}
+
 /**
  * This function is deprecated! It was written before lcm_handle_timeout
  * existed, so now you should use that instead!
@@ -527,11 +656,176 @@ static void impl_lcm_c_handler(const lcm_recv_buf_t *recv_buf,
   /* push channel */
   lua_pushstring(L, channel);
 
-  /* push buffer as a binary string */
-  lua_pushlstring(L, (const char *)recv_buf->data, recv_buf->data_size);
+  if (!subu->deliver_buffer) {
+    /* push buffer as a binary string */
+    lua_pushlstring(L, (const char *)recv_buf->data, recv_buf->data_size);
+
+    /* call the handler */
+    lua_call(L, 2, 0);
+    return;
+  }
+
+  /* point the reusable buffer userdata at the message */
+  luaX_getfenv(L, 1);
+  lua_pushstring(L, "buffer");
+  lua_rawget(L, -2);
+  lua_remove(L, -2);
+
+  impl_buffer_userdata_t *bufu =
+      (impl_buffer_userdata_t *)lua_touserdata(L, -1);
+  bufu->data = (const char *)recv_buf->data;
+  bufu->data_size = recv_buf->data_size;
+
+  /* call the handler, and invalidate the buffer even if it fails */
+  int status = lua_pcall(L, 2, 0, 0);
+  bufu->data = NULL;
+  bufu->data_size = 0;
+  if (status != 0) {
+    lua_error(L);
+  }
+}
+
+/**
+ * Checks for a buffer userdata that is valid, i.e. whose handler is running.
+ */
+static impl_buffer_userdata_t *impl_buffer_checkvalid(lua_State *L,
+                                                      int index) {
+  impl_buffer_userdata_t *bufu =
+      (impl_buffer_userdata_t *)luaL_checkudata(L, index, "lcm.buffer");
+  if (!bufu->data) {
+    luaL_error(L, "lcm buffer can only be used in its handler");
+  }
+  return bufu;
+}
+
+/**
+ * Converts string.sub style indices to a zero-based range, returns the
+ * number of bytes in the range.
+ */
+static size_t impl_buffer_range(lua_State *L, size_t size, size_t *start) {
+  lua_Integer i = luaL_optinteger(L, 2, 1);
+  lua_Integer j = luaL_optinteger(L, 3, -1);
+
+  /* negative indices count from the end */
+  if (i < 0) i += (lua_Integer)size + 1;
+  if (j < 0) j += (lua_Integer)size + 1;
+  if (i < 1) i = 1;
+  if (j > (lua_Integer)size) j = (lua_Integer)size;
+
+  if (i > j) {
+    *start = 0;
+    return 0;
+  }
+  *start = (size_t)(i - 1);
+  return (size_t)(j - i + 1);
+}
 
-  /* call the handler */
-  lua_call(L, 2, 0);
+/**
+ * Gets the size of the message of a buffer userdata. This is also its __len
+ * metamethod.
+ *
+ * @pre The Lua arguments on the stack:
+ *     A buffer userdata (self).
+ *
+ * @post The Lua return values on the stack:
+ *     The number of bytes in the message.
+ *
+ * @param L The Lua state.
+ * @return The number of return values on the Lua stack.
+ */
+static int impl_buffer_size(lua_State *L) {
+  impl_buffer_userdata_t *bufu = impl_buffer_checkvalid(L, 1);
+
+  lua_pushinteger(L, (lua_Integer)bufu->data_size);
+
+  return 1;
+}
+
+/**
+ * Copies part of the message of a buffer userdata to a string, like
+ * string.sub.
+ *
+ * @pre The Lua arguments on the stack:
+ *     A buffer userdata (self), and optionally the first and last index.
+ *
+ * @post The Lua return values on the stack:
+ *     A string.
+ *
+ * @param L The Lua state.
+ * @return The number of return values on the Lua stack.
+ */
+static int impl_buffer_sub(lua_State *L) {
+  impl_buffer_userdata_t *bufu = impl_buffer_checkvalid(L, 1);
+
+  size_t start;
+  size_t length = impl_buffer_range(L, bufu->data_size, &start);
+
+  lua_pushlstring(L, bufu->data + start, length);
+
+  return 1;
+}
+
+/**
+ * Gets bytes of the message of a buffer userdata as numbers, like
+ * string.byte.
+ *
+ * @pre The Lua arguments on the stack:
+ *     A buffer userdata (self), and optionally the first and last index.
+ *     The last index defaults to the first.
+ *
+ * @post The Lua return values on the stack:
+ *     One number per byte.
+ *
+ * @param L The Lua state.
+ * @return The number of return values on the Lua stack.
+ */
+static int impl_buffer_byte(lua_State *L) {
+  impl_buffer_userdata_t *bufu = impl_buffer_checkvalid(L, 1);
+
+  /* like string.byte, the last index defaults to the first */
+  lua_settop(L, 3);
+  if (lua_isnil(L, 3)) {
+    lua_pushinteger(L, luaL_optinteger(L, 2, 1));
+    lua_replace(L, 3);
+  }
+
+  size_t start;
+  size_t length = impl_buffer_range(L, bufu->data_size, &start);
+
+  luaL_checkstack(L, (int)length, "too many bytes");
+
+  size_t i;
+  for (i = 0; i < length; i++) {
+    lua_pushinteger(L, (unsigned char)bufu->data[start + i]);
+  }
+
+  return (int)length;
+}
+
+/**
+ * Creates a string from a buffer userdata. This is the __tostring metamethod
+ * of the buffer userdata.
+ *
+ * @pre The Lua arguments on the stack:
+ *     A buffer userdata (self).
+ *
+ * @post The Lua return values on the stack:
+ *     A string representing the buffer userdata.
+ *
+ * @param L The Lua state.
+ * @return The number of return values on the Lua stack.
+ */
+static int impl_buffer_tostring(lua_State *L) {
+  impl_buffer_userdata_t *bufu =
+      (impl_buffer_userdata_t *)luaL_checkudata(L, 1, "lcm.buffer");
+
+  if (bufu->data) {
+    lua_pushfstring(L, "lcm.buffer (%d bytes)", (int)bufu->data_size);
+  } else {
+    lua_pushstring(L, "lcm.buffer (invalid)");
+  }
+
+  return 1;
 }
 
 /**
@@ -753,6 +1047,16 @@ static void impl_lcm_createsubscriptiontable(lua_State *L, int index) {
   lua_newtable(L);
   lua_rawset(L, -3);
 
+  /* add the buffer for subscriptions with the buffer option */
+  lua_pushstring(L, "buffer");
+  impl_buffer_userdata_t *bufu = (impl_buffer_userdata_t *)lua_newuserdata(
+      L, sizeof(impl_buffer_userdata_t));
+  bufu->data = NULL;
+  bufu->data_size = 0;
+  luaL_getmetatable(L, "lcm.buffer");
+  lua_setmetatable(L, -2);
+  lua_rawset(L, -3);
+
   /* set as environment */
   luaX_setfenv(L, index);
 }
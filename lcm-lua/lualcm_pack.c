@@ -27,6 +27,8 @@
 /* functions */
 static int impl_unpack(lua_State *);
 static int impl_pack(lua_State *);
+static int impl_unpack_array(lua_State *);
+static int impl_pack_array(lua_State *);
 static int impl_prepare_string(lua_State *);
 static int impl_trim_to_null(lua_State *);
 static int impl_utf8_check(lua_State *);
@@ -70,6 +72,12 @@ static bool impl_pack_buffer(lua_State *, impl_pack_op_t *, size_t, bool,
                              uint8_t *, size_t, size_t *, const char **);
 static bool impl_is_machine_little_endian(void);
 static void impl_swap_bytes(uint8_t *, size_t);
+static size_t impl_get_array_op(lua_State *, const char *, impl_pack_op_t *,
+                                bool *);
+static void impl_array_element_to_buffer(lua_State *, impl_datatype_t,
+                                         uint8_t *);
+static void impl_array_element_from_buffer(lua_State *, impl_datatype_t,
+                                           uint8_t *);
 
 /* unpack helper functions */
 static void impl_unpack_int8_t(lua_State *, const uint8_t *, size_t *, size_t,
@@ -126,6 +134,8 @@ void ll_pack_register(lua_State *L) {
   const struct luaL_Reg functions[] = {
       {"pack", impl_pack},
       {"unpack", impl_unpack},
+      {"pack_array", impl_pack_array},
+      {"unpack_array", impl_unpack_array},
       {"prepare_string", impl_prepare_string},
       {"_trim_to_null", impl_trim_to_null},
       {"_utf8_check", impl_utf8_check},
@@ -235,6 +245,92 @@ int impl_pack(lua_State *L) {
   return 1;
 }
 
+/*
+ * Array functions. These pack or unpack a homogeneous array of n numbers (or
+ * booleans) in one pass, reading or filling a Lua table directly instead of
+ * going through the stack, so the size of an array isn't limited by the stack
+ * size. The format holds a single type, e.g. '>d', and no repeat count.
+ *
+ *   local str = lcm._pack.pack_array(format, n, table)
+ *   local table = lcm._pack.unpack_array(format, n, str)
+ */
+
+int impl_unpack_array(lua_State *L) {
+  const char *format = luaL_checkstring(L, 1);
+
+  impl_pack_op_t op;
+  bool is_little_endian;
+  const size_t elem_size =
+      impl_get_array_op(L, format, &op, &is_little_endian);
+
+  const lua_Integer n = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, n >= 0, 2, "array size must not be negative");
+
+  size_t buf_size;
+  const uint8_t *buf = (const uint8_t *)luaL_checklstring(L, 3, &buf_size);
+
+  if ((size_t)n > buf_size / elem_size) {
+    luaL_error(L, "error unpacking buffer: buffer is too small");
+  }
+
+  const bool swap = is_little_endian != impl_is_machine_little_endian();
+
+  lua_createtable(L, (int)n, 0);
+
+  lua_Integer i;
+  for (i = 0; i < n; i++) {
+    uint8_t elem[sizeof(uint64_t)];
+    memcpy(elem, buf + i * elem_size, elem_size);
+    if (swap) impl_swap_bytes(elem, elem_size);
+    impl_array_element_from_buffer(L, op.datatype, elem);
+    lua_rawseti(L, -2, (int)(i + 1));
+  }
+
+  return 1;
+}
+
+int impl_pack_array(lua_State *L) {
+  const char *format = luaL_checkstring(L, 1);
+
+  impl_pack_op_t op;
+  bool is_little_endian;
+  const size_t elem_size =
+      impl_get_array_op(L, format, &op, &is_little_endian);
+
+  const lua_Integer n = luaL_checkinteger(L, 2);
+  luaL_argcheck(L, n >= 0, 2, "array size must not be negative");
+  luaL_checktype(L, 3, LUA_TTABLE);
+
+  const bool swap = is_little_endian != impl_is_machine_little_endian();
+  const lua_Integer per_chunk = LUAL_BUFFERSIZE / elem_size;
+
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+
+  /* fill the buffer a whole chunk at a time; the stack is balanced around
+   * each element, as luaL_Buffer requires */
+  lua_Integer i = 0;
+  while (i < n) {
+    uint8_t *chunk = (uint8_t *)luaL_prepbuffer(&b);
+    lua_Integer count = n - i < per_chunk ? n - i : per_chunk;
+
+    lua_Integer j;
+    for (j = 0; j < count; j++, i++) {
+      uint8_t *elem = chunk + j * elem_size;
+      lua_rawgeti(L, 3, (int)(i + 1));
+      impl_array_element_to_buffer(L, op.datatype, elem);
+      lua_pop(L, 1);
+      if (swap) impl_swap_bytes(elem, elem_size);
+    }
+
+    luaL_addsize(&b, count * elem_size);
+  }
+
+  luaL_pushresult(&b);
+
+  return 1;
+}
+
 int impl_prepare_string(lua_State *L) {
   /* get the string */
   const char *string = luaL_checkstring(L, 1);
@@ -622,6 +718,133 @@ static bool impl_pack_buffer(lua_State *L, impl_pack_op_t *ops, size_t num_ops,
   return true;
 }
 
+/* parses the format of an array function and returns the element size */
+static size_t impl_get_array_op(lua_State *L, const char *format,
+                                impl_pack_op_t *op, bool *is_little_endian) {
+  size_t num_ops;
+  const char *error_message = "expected a single type";
+
+  if (!impl_format_to_ops(op, 1, &num_ops, is_little_endian, format,
+                          &error_message) ||
+      num_ops != 1 || op->repeat != 1) {
+    luaL_error(L, "error reading format: %s", error_message);
+  }
+
+  switch (op->datatype) {
+    case DATATYPE_INT8:
+    case DATATYPE_BOOLEAN:
+      return sizeof(int8_t);
+    case DATATYPE_INT16:
+      return sizeof(int16_t);
+    case DATATYPE_INT32:
+    case DATATYPE_UINT32:
+    case DATATYPE_FLOAT:
+      return sizeof(int32_t);
+    case DATATYPE_INT64:
+    case DATATYPE_DOUBLE:
+      return sizeof(int64_t);
+    default:
+      luaL_error(L, "error reading format: type can't be packed as an array");
+  }
+
+  return 0;
+}
+
+/* converts the value on top of the stack, in native byte order */
+static void impl_array_element_to_buffer(lua_State *L, impl_datatype_t type,
+                                         uint8_t *elem) {
+  if (type == DATATYPE_BOOLEAN) {
+    *elem = (uint8_t)lua_toboolean(L, -1);
+    return;
+  }
+
+  if (!lua_isnumber(L, -1)) {
+    luaL_error(L, "error packing buffer: array element is not a number");
+  }
+  const lua_Number x = lua_tonumber(L, -1);
+
+  switch (type) {
+    case DATATYPE_INT8: {
+      int8_t n = (int8_t)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_INT16: {
+      int16_t n = (int16_t)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_INT32: {
+      int32_t n = (int32_t)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_UINT32: {
+      uint32_t n = (uint32_t)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_INT64: {
+      int64_t n = (int64_t)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_FLOAT: {
+      float n = (float)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    case DATATYPE_DOUBLE: {
+      double n = (double)x;
+      memcpy(elem, &n, sizeof(n));
+    } break;
+    default:
+      break;
+  }
+}
+
+/* pushes an element that is in native byte order */
+static void impl_array_element_from_buffer(lua_State *L, impl_datatype_t type,
+                                           uint8_t *elem) {
+  switch (type) {
+    case DATATYPE_BOOLEAN:
+      lua_pushboolean(L, *elem != 0);
+      break;
+    case DATATYPE_INT8: {
+      int8_t n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_INT16: {
+      int16_t n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_INT32: {
+      int32_t n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_UINT32: {
+      uint32_t n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_INT64: {
+      int64_t n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_FLOAT: {
+      float n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    case DATATYPE_DOUBLE: {
+      double n;
+      memcpy(&n, elem, sizeof(n));
+      lua_pushnumber(L, n);
+    } break;
+    default:
+      lua_pushnil(L);
+      break;
+  }
+}
+
 static bool impl_is_machine_little_endian(void) {
   static union {
     uint32_t test_int;
@@ -22,7 +22,8 @@ class Event(object):
         """Channel on which message was received"""
 
         self.data = data
-        """Binary string containing raw message data"""
+        """Binary string containing raw message data.  For events returned
+        by L{EventLog.read_events}, a read-only memoryview of the data"""
 
 class EventLog(object):
     """EventLog is a class for reading and writing LCM log files in Python.
@@ -32,7 +33,8 @@ to next() returning the next L{Event<lcm.Event>} in the log.
 
 @undocumented: __iter__
     """
-    def __init__ (self, path, mode = "r", overwrite = False):
+    def __init__ (self, path, mode = "r", overwrite = False,
+            channel_regex = None):
         """
         Initializer
 
@@ -42,6 +44,9 @@ to next() returning the next L{Event<lcm.Event>} in the log.
         exists, then EventLog will truncate and overwrite the file if this
         parameter is set to True.  Otherwise, EventLog refuses to overwrite
         existing files and raises a ValueError.
+        @param channel_regex:  If mode is 'r', only the events on channels
+        matching this regular expression are read.  The filtering is done
+        while reading the log, and the data of other events is skipped.
         """
         if mode not in [ "r", "w" ]:
             raise ValueError ("invalid event log mode")
@@ -52,7 +57,7 @@ to next() returning the next L{Event<lcm.Event>} in the log.
 
         self.mode = mode
 
-        self.c_eventlog = _lcm.EventLog (path, mode)
+        self.c_eventlog = _lcm.EventLog (path, mode, channel_regex)
         self.f = None
 
     def seek (self, filepos):
@@ -114,6 +119,32 @@ to next() returning the next L{Event<lcm.Event>} in the log.
         if not tup: return None
         return Event (*tup)
 
+    def read_events (self, max_events = 100):
+        """
+        Reads up to max_events events at once.  The data of each event is a
+        read-only memoryview, which is not copied after it is read from the
+        file.  Use its tobytes() to copy it.
+
+        @param max_events: the largest number of events to read
+        @return: a list of L{Event<lcm.Event>}, which is empty at the end of
+        the log file.
+        """
+        return [ Event (*tup) for tup in
+                self.c_eventlog.read_events (max_events) ]
+
+    def batches (self, max_events = 100):
+        """
+        Iterates over the rest of the log in batches, as returned by
+        L{read_events}.
+
+        @param max_events: the largest number of events in a batch
+        """
+        while True:
+            events = self.read_events (max_events)
+            if not events:
+                return
+            yield events
+
     def __iter__ (self):
         self.c_eventlog.seek (0)
         return self
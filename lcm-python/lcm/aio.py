@@ -0,0 +1,194 @@
+"""asyncio integration for LCM.
+
+AsyncLCM registers the file descriptor of an L{LCM<lcm.LCM>} instance with an
+asyncio event loop, and handles its messages in batches whenever it becomes
+readable, so that asyncio applications receive messages on the loop's own
+thread:
+
+    async def main():
+        alc = lcm.aio.AsyncLCM()
+        async for channel, data in alc.subscribe("EXAMPLE"):
+            print(channel, len(data))
+
+Requires Python 3.5 or newer.
+"""
+
+import asyncio
+import collections
+
+from . import LCM
+
+class AsyncSubscription(object):
+    """An asynchronous iterator over the messages received on a channel,
+    returned by L{AsyncLCM.subscribe}.  Each message is a (channel, data)
+    tuple.
+    """
+
+    def __init__ (self, alcm, channel, maxlen):
+        self._alcm = alcm
+        self._queue = collections.deque()
+        self._maxlen = maxlen
+        self._waiter = None
+        self._error = None
+        self._closed = False
+
+        self.num_dropped = 0
+        """Number of messages discarded because the queue was full"""
+
+        self.subscription = alcm.lc.subscribe(channel, self._on_message)
+        """The underlying L{LCMSubscription<lcm.LCMSubscription>}"""
+
+    def _on_message (self, channel, data):
+        if self._maxlen and len(self._queue) >= self._maxlen:
+            self._queue.popleft()
+            self.num_dropped += 1
+        self._queue.append((channel, data))
+        self._wake()
+
+    def _wake (self):
+        if self._waiter is not None and not self._waiter.done():
+            self._waiter.set_result(None)
+
+    def _fail (self, error):
+        self._error = error
+        self._wake()
+
+    async def _wait (self):
+        while not self._queue:
+            if self._error is not None:
+                raise self._error
+            if self._closed:
+                raise StopAsyncIteration
+            self._waiter = self._alcm.loop.create_future()
+            try:
+                await self._waiter
+            finally:
+                self._waiter = None
+
+    def __aiter__ (self):
+        return self
+
+    async def __anext__ (self):
+        await self._wait()
+        return self._queue.popleft()
+
+    async def get (self):
+        """Waits for the next message.
+
+        @return: a (channel, data) tuple
+        @raise StopAsyncIteration: if the subscription was closed
+        """
+        return await self.__anext__()
+
+    async def get_batch (self, max_msgs = None):
+        """Waits until at least one message is queued, and then returns all
+        of the queued messages at once.
+
+        @param max_msgs: the largest number of messages to return, or None
+        for no limit
+        @return: a list of (channel, data) tuples, which is empty if the
+        subscription was closed
+        """
+        try:
+            await self._wait()
+        except StopAsyncIteration:
+            return []
+        n = len(self._queue)
+        if max_msgs is not None:
+            n = min(n, max_msgs)
+        return [ self._queue.popleft() for i in range(n) ]
+
+    def qsize (self):
+        """
+        @return: the number of messages queued
+        """
+        return len(self._queue)
+
+    def close (self):
+        """Unsubscribes.  Iterating over the subscription ends once the
+        messages already queued have been consumed.
+        """
+        if self._closed:
+            return
+        self._closed = True
+        self._alcm._remove(self)
+        self._wake()
+
+class AsyncLCM(object):
+    """Dispatches the messages of an L{LCM<lcm.LCM>} instance from an asyncio
+    event loop, without a thread of its own.
+
+    Subscriptions made directly on L{lc} with a callback work as well, and
+    their callbacks run on the event loop.
+    """
+
+    def __init__ (self, lc = None, max_batch = 100, loop = None):
+        """
+        Initializer
+
+        @param lc: the L{LCM<lcm.LCM>} instance to use.  A new one with the
+        default URL is created if this is None.
+        @param max_batch: the largest number of messages handled each time
+        the LCM file descriptor becomes readable, so that a busy channel does
+        not starve the other tasks of the loop.
+        @param loop: the event loop, which defaults to the current one
+        """
+        if max_batch <= 0:
+            raise ValueError("max_batch must be positive")
+        self.lc = lc if lc is not None else LCM()
+        """The underlying L{LCM<lcm.LCM>} instance"""
+        self.loop = loop if loop is not None else asyncio.get_event_loop()
+        """The event loop that messages are handled on"""
+        self.max_batch = max_batch
+        self._subscriptions = []
+        self._fileno = self.lc.fileno()
+        self.loop.add_reader(self._fileno, self._on_readable)
+
+    def _on_readable (self):
+        try:
+            self.lc.handle_batch(self.max_batch, 0)
+        except IOError as error:
+            # the LCM instance can't receive anymore
+            self.loop.remove_reader(self._fileno)
+            for sub in self._subscriptions:
+                sub._fail(error)
+        except Exception as error:
+            # raised by a callback subscribed on lc directly
+            self.loop.call_exception_handler({
+                "message": "Exception in an LCM message handler",
+                "exception": error,
+            })
+
+    def _remove (self, sub):
+        self._subscriptions.remove(sub)
+        self.lc.unsubscribe(sub.subscription)
+
+    def subscribe (self, channel, maxlen = 0):
+        """Subscribes to a channel.
+
+        @param channel: the channel name, or a regular expression
+        @param maxlen: the largest number of messages queued, or 0 for no
+        limit.  When the queue is full the oldest message is discarded.
+        @return: an L{AsyncSubscription}
+        """
+        sub = AsyncSubscription(self, channel, maxlen)
+        self._subscriptions.append(sub)
+        return sub
+
+    def publish (self, channel, data):
+        """Publishes a message, like L{LCM.publish<lcm.LCM.publish>}"""
+        self.lc.publish(channel, data)
+
+    def close (self):
+        """Stops handling messages and closes all subscriptions"""
+        for sub in list(self._subscriptions):
+            sub.close()
+        if self._fileno is not None:
+            self.loop.remove_reader(self._fileno)
+            self._fileno = None
+
+    async def __aenter__ (self):
+        return self
+
+    async def __aexit__ (self, exc_type, exc, tb):
+        self.close()
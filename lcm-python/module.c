@@ -10,6 +10,7 @@
 #endif
 
 extern PyTypeObject pylcmeventlog_type;
+extern PyTypeObject pylcmeventdata_type;
 extern PyTypeObject pylcm_type;
 extern PyTypeObject pylcm_subscription_type;
 
@@ -44,6 +45,14 @@ init_lcm (void)
     PyObject *m;
 
     Py_TYPE(&pylcmeventlog_type) = &PyType_Type;
+    Py_TYPE(&pylcmeventdata_type) = &PyType_Type;
+    if (PyType_Ready (&pylcmeventdata_type) < 0) {
+        #if PY_MAJOR_VERSION >= 3
+        return NULL; // in python 3 return NULL on error
+        #else
+        return;
+        #endif
+    }
     Py_TYPE(&pylcm_type) = &PyType_Type;
     Py_TYPE(&pylcm_subscription_type) = &PyType_Type;
 
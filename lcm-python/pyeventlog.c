@@ -26,6 +26,131 @@ PyDoc_STRVAR(pylog_doc,
 "Event Log parser\n\
 ");
 
+// The data of an event, read from the log and exposed through the buffer
+// protocol, so that it reaches Python without being copied again.
+typedef struct {
+    PyObject_HEAD
+
+    void *data;
+    Py_ssize_t datalen;
+} PyLogEventDataObject;
+
+static int
+pylog_event_data_getbuffer (PyLogEventDataObject *self, Py_buffer *view,
+        int flags)
+{
+    return PyBuffer_FillInfo (view, (PyObject *) self, self->data,
+            self->datalen, 1, flags);
+}
+
+#if PY_MAJOR_VERSION < 3
+static Py_ssize_t
+pylog_event_data_getreadbuffer (PyLogEventDataObject *self, Py_ssize_t segment,
+        void **ptr)
+{
+    if (segment != 0) {
+        PyErr_SetString (PyExc_SystemError, "invalid buffer segment");
+        return -1;
+    }
+    *ptr = self->data;
+    return self->datalen;
+}
+
+static Py_ssize_t
+pylog_event_data_getsegcount (PyLogEventDataObject *self, Py_ssize_t *lenp)
+{
+    if (lenp) *lenp = self->datalen;
+    return 1;
+}
+#endif
+
+static PyBufferProcs pylog_event_data_as_buffer = {
+#if PY_MAJOR_VERSION < 3
+    (readbufferproc) pylog_event_data_getreadbuffer,
+    0,
+    (segcountproc) pylog_event_data_getsegcount,
+    0,
+#endif
+    (getbufferproc) pylog_event_data_getbuffer,
+    0,
+};
+
+static void
+pylog_event_data_dealloc (PyLogEventDataObject *self)
+{
+    free (self->data);
+    Py_TYPE(self)->tp_free ((PyObject *) self);
+}
+
+PyTypeObject pylcmeventdata_type = {
+#if PY_MAJOR_VERSION >= 3
+    PyVarObject_HEAD_INIT(0, 0) /* size is now part of macro */
+#else
+    PyObject_HEAD_INIT(0)   /* Must fill in type value later */
+    0,                  /* ob_size */
+#endif
+    "EventData",            /* tp_name */
+    sizeof(PyLogEventDataObject),     /* tp_basicsize */
+    0,                  /* tp_itemsize */
+    (destructor)pylog_event_data_dealloc,     /* tp_dealloc */
+    0,                  /* tp_print */
+    0,                  /* tp_getattr */
+    0,                  /* tp_setattr */
+    0,                  /* tp_compare */
+    0,                  /* tp_repr */
+    0,                  /* tp_as_number */
+    0,                  /* tp_as_sequence */
+    0,                  /* tp_as_mapping */
+    0,                  /* tp_hash */
+    0,                  /* tp_call */
+    0,                  /* tp_str */
+    0,                  /* tp_getattro */
+    0,                  /* tp_setattro */
+    &pylog_event_data_as_buffer,        /* tp_as_buffer */
+#if PY_MAJOR_VERSION >= 3
+    Py_TPFLAGS_DEFAULT, /* tp_flags */
+#else
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /* tp_flags */
+#endif
+    0,                  /* tp_doc */
+    0,                  /* tp_traverse */
+    0,                  /* tp_clear */
+    0,                  /* tp_richcompare */
+    0,                  /* tp_weaklistoffset */
+    0,                  /* tp_iter */
+    0,                  /* tp_iternext */
+    0,                  /* tp_methods */
+    0,                  /* tp_members */
+    0,                  /* tp_getset */
+    0,                  /* tp_base */
+    0,                  /* tp_dict */
+    0,                  /* tp_descr_get */
+    0,                  /* tp_descr_set */
+    0,                  /* tp_dictoffset */
+    0,                  /* tp_init */
+    PyType_GenericAlloc,            /* tp_alloc */
+    0,                  /* tp_new */
+    PyObject_Del,               /* tp_free */
+};
+
+// Returns a memoryview of the data of an event, and takes ownership of it.
+static PyObject *
+pylog_event_data_view (lcm_eventlog_event_t *event)
+{
+    PyLogEventDataObject *owner = (PyLogEventDataObject *)
+        PyType_GenericAlloc (&pylcmeventdata_type, 0);
+    if (!owner) {
+        return NULL;
+    }
+    owner->data = event->data;
+    owner->datalen = event->datalen;
+    event->data = NULL;
+
+    PyObject *view = PyMemoryView_FromObject ((PyObject *) owner);
+    Py_DECREF (owner);
+    return view;
+}
+
 //gives redefinition error in MSVC
 //PyTypeObject pylcmeventlog_type; 
 
@@ -79,6 +204,71 @@ PyObject *result = Py_BuildValue ("LLs#y#", // build from bytes
     return result;
 }
 
+static PyObject *
+pylog_read_events (PyLogObject *self, PyObject *args)
+{
+    int max_events = 0;
+    if (!PyArg_ParseTuple (args, "i", &max_events)) {
+        return NULL;
+    }
+    if (max_events <= 0) {
+        PyErr_SetString (PyExc_ValueError, "max_events must be positive");
+        return NULL;
+    }
+
+    if (!self->eventlog) {
+        PyErr_SetString (PyExc_ValueError, "event log already closed");
+        return NULL;
+    }
+
+    if (self->mode != 'r') {
+        PyErr_SetString (PyExc_RuntimeError, 
+                "reading not allowed in write mode");
+        return NULL;
+    }
+
+    lcm_eventlog_event_t **events = (lcm_eventlog_event_t **)
+        malloc (max_events * sizeof (lcm_eventlog_event_t *));
+    if (!events) {
+        return PyErr_NoMemory ();
+    }
+
+    // read the whole batch without the GIL
+    int num_events = 0;
+    Py_BEGIN_ALLOW_THREADS
+    while (num_events < max_events) {
+        lcm_eventlog_event_t *event =
+            lcm_eventlog_read_next_event (self->eventlog);
+        if (!event) {
+            break;
+        }
+        events[num_events++] = event;
+    }
+    Py_END_ALLOW_THREADS
+
+    PyObject *result = PyList_New (num_events);
+    for (int i = 0; i < num_events; i++) {
+        lcm_eventlog_event_t *event = events[i];
+        PyObject *item = NULL;
+        if (result) {
+            PyObject *data = pylog_event_data_view (event);
+            if (data) {
+                item = Py_BuildValue ("LLs#N", event->eventnum,
+                        event->timestamp, event->channel,
+                        (int) event->channellen, data);
+            }
+            if (item) {
+                PyList_SET_ITEM (result, i, item);
+            } else {
+                Py_CLEAR (result);
+            }
+        }
+        lcm_eventlog_free_event (event);
+    }
+    free (events);
+    return result;
+}
+
 static PyObject *
 pylog_seek (PyLogObject *self, PyObject *arg)
 {
@@ -195,6 +385,7 @@ static PyMethodDef pylog_methods[] = {
     { "seek", (PyCFunction)pylog_seek, METH_O, "" },
     { "seek_to_timestamp", (PyCFunction)pylog_seek_to_timestamp, METH_O, "" },
     { "read_next_event", (PyCFunction)pylog_read_next_event, METH_NOARGS, "" },
+    { "read_events", (PyCFunction)pylog_read_events, METH_VARARGS, "" },
     { "write_event", (PyCFunction)pylog_write_next_event, METH_VARARGS, "" },
     { "size", (PyCFunction)pylog_size, METH_NOARGS, "" },
     { "ftell", (PyCFunction)pylog_ftell, METH_NOARGS, "" },
@@ -239,12 +430,13 @@ static int
 pylog_initobj(PyObject *s, PyObject *args, PyObject *kwds)
 {
     PyLogObject *self = (PyLogObject *)s;
-    static char *keywords[] = { "filename", "mode", 0 };
+    static char *keywords[] = { "filename", "mode", "channel_regex", 0 };
     char *filename = NULL;
     char *mode = "r";
+    char *channel_regex = NULL;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|s", keywords, &filename,
-                &mode))
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|sz", keywords, &filename,
+                &mode, &channel_regex))
         return -1;
 
     if (!strcmp (mode, "r")) {
@@ -258,7 +450,16 @@ pylog_initobj(PyObject *s, PyObject *args, PyObject *kwds)
 
     if (self->eventlog) { lcm_eventlog_destroy (self->eventlog); }
 
-    self->eventlog = lcm_eventlog_create (filename, mode);
+    if (channel_regex) {
+        if (self->mode != 'r') {
+            PyErr_SetString (PyExc_ValueError,
+                    "channel_regex requires mode 'r'");
+            return -1;
+        }
+        self->eventlog = lcm_eventlog_create_filtered (filename, channel_regex);
+    } else {
+        self->eventlog = lcm_eventlog_create (filename, mode);
+    }
     if (!self->eventlog) {
         PyErr_SetFromErrno (PyExc_IOError);
         return -1;
@@ -314,3 +515,4 @@ PyTypeObject pylcmeventlog_type = {
     pylog_new,             /* tp_new */
     PyObject_Del,               /* tp_free */
 };
+
@@ -216,22 +216,26 @@ call to subscribe()\n\
 static PyObject *
 pylcm_publish (PyLCMObject *lcm_obj, PyObject *args)
 {
-    char *data = NULL;
-    int datalen = 0;
+    Py_buffer data;
     char *channel = NULL;
 
-    if (!PyArg_ParseTuple (args, "ss#", &channel, &data, &datalen)) {
+    // any object with the buffer interface is published in place, without
+    // being converted to a string first
+    if (!PyArg_ParseTuple (args, "ss*", &channel, &data)) {
         return NULL;
     }
     if (!channel || !strlen (channel)) {
+        PyBuffer_Release (&data);
         PyErr_SetString (PyExc_ValueError, "invalid channel");
         return NULL;
     }
 
     int status;
     Py_BEGIN_ALLOW_THREADS
-    status = lcm_publish (lcm_obj->lcm, channel, (uint8_t*)data, datalen);
+    status = lcm_publish (lcm_obj->lcm, channel, (uint8_t*)data.buf,
+            (unsigned int) data.len);
     Py_END_ALLOW_THREADS
+    PyBuffer_Release (&data);
 
     if (0 != status) {
         PyErr_SetFromErrno (PyExc_IOError);
@@ -245,7 +249,8 @@ PyDoc_STRVAR (pylcm_publish_doc,
 Publishes a message to an LCM network\n\
 \n\
 @param channel: specifies the channel to which the message should be published.\n\
-@param data: binary string containing the message to publish\n\
+@param data: the message to publish, as a binary string or any other object\n\
+with the buffer interface, such as a bytearray or a memoryview\n\
 ");
 
 static PyObject *
@@ -349,10 +354,72 @@ error occurs.\n\
 @return 0 if the function timed out, >1 if a message was handled.\n\
 ");
 
+static PyObject *
+pylcm_handle_batch (PyLCMObject *lcm_obj, PyObject *args)
+{
+    int max_msgs, timeout_millis;
+    if (!PyArg_ParseTuple (args, "ii", &max_msgs, &timeout_millis))
+        return NULL;
+    if (max_msgs <= 0) {
+        PyErr_SetString (PyExc_ValueError, "invalid max_msgs");
+        return NULL;
+    }
+    if (timeout_millis < 0) {
+        PyErr_SetString (PyExc_ValueError, "invalid timeout");
+        return NULL;
+    }
+
+    dbg(DBG_PYTHON, "pylcm_handle_batch(%p, %d, %d)\n", lcm_obj, max_msgs,
+        timeout_millis);
+
+    if (lcm_obj->saved_thread_state) {
+        PyErr_SetString (PyExc_RuntimeError,
+            "Simultaneous calls to handle() / handle_timeout() detected");
+        return NULL;
+    }
+    lcm_obj->saved_thread_state = PyEval_SaveThread();
+    lcm_obj->exception_raised = 0;
+
+    // The first message restores the thread state in pylcm_msg_handler(),
+    // and the rest of the batch is dispatched without releasing it again.
+    int status = lcm_handle_batch(lcm_obj->lcm, max_msgs, timeout_millis);
+
+    if (lcm_obj->saved_thread_state) {
+      PyEval_RestoreThread(lcm_obj->saved_thread_state);
+      lcm_obj->saved_thread_state = NULL;
+    }
+
+    if (lcm_obj->exception_raised) { return NULL; }
+    if (status < 0) {
+        PyErr_SetString (PyExc_IOError, "lcm_handle_batch() returned -1");
+        return NULL;
+    }
+    return PyInt_FromLong(status);
+}
+PyDoc_STRVAR (pylcm_handle_batch_doc,
+"handle_batch(max_msgs, timeout_millis) -> int\n\
+\n\
+waits for the next incoming message, with a timeout, and then dispatches up\n\
+to max_msgs messages that have already been received.  The lock of the\n\
+Python interpreter is released while waiting, and taken once for the whole\n\
+batch, which makes this cheaper than calling handle() for each message at\n\
+high message rates.\n\
+\n\
+If a handler raises an exception, the remaining messages of the batch are\n\
+dropped and the exception is raised.  Raises ValueError if max_msgs or\n\
+timeout_millis is invalid, or IOError if another error occurs.\n\
+\n\
+@param max_msgs: the maximum number of messages to dispatch.\n\
+@param timeout_millis: the amount of time to wait, in milliseconds.\n\
+@return the number of messages handled, or 0 if the function timed out.\n\
+");
+
 static PyMethodDef pylcm_methods[] = {
     { "handle", (PyCFunction)pylcm_handle, METH_NOARGS, pylcm_handle_doc },
     { "handle_timeout", (PyCFunction)pylcm_handle_timeout, METH_O,
       pylcm_handle_timeout_doc },
+    { "handle_batch", (PyCFunction)pylcm_handle_batch, METH_VARARGS,
+      pylcm_handle_batch_doc },
     { "subscribe", (PyCFunction)pylcm_subscribe, METH_VARARGS, 
         pylcm_subscribe_doc },
     { "unsubscribe", (PyCFunction)pylcm_unsubscribe, METH_VARARGS,
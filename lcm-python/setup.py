@@ -9,16 +9,28 @@ sources = [ \
     "pyeventlog.c",
     "pylcm.c",
     "pylcm_subscription.c",
+    os.path.join("..", "lcm", "bufpool.c"),
+    os.path.join("..", "lcm", "channel_matcher.c"),
     os.path.join("..", "lcm", "eventlog.c"),
     os.path.join("..", "lcm", "lcm.c"),
     os.path.join("..", "lcm", "lcm_file.c"),
+    os.path.join("..", "lcm", "lcm_hybrid.c"),
+    os.path.join("..", "lcm", "lcm_inproc.c"),
+    os.path.join("..", "lcm", "lcm_interest.c"),
     os.path.join("..", "lcm", "lcm_memq.c"),
     os.path.join("..", "lcm", "lcm_mpudpm.c"),
+    os.path.join("..", "lcm", "lcm_poll_set.c"),
+    os.path.join("..", "lcm", "lcm_shared.c"),
+    os.path.join("..", "lcm", "lcm_shm.c"),
     os.path.join("..", "lcm", "lcm_tcpq.c"),
+    os.path.join("..", "lcm", "lcm_thread.c"),
     os.path.join("..", "lcm", "lcmtypes", "channel_port_map_update_t.c"),
     os.path.join("..", "lcm", "lcmtypes", "channel_to_port_t.c"),
+    os.path.join("..", "lcm", "lcmtypes", "channel_port_assign_t.c"),
+    os.path.join("..", "lcm", "lcmtypes", "channel_port_map_delta_t.c"),
+    os.path.join("..", "lcm", "lcmtypes", "channel_port_assignment_t.c"),
+    os.path.join("..", "lcm", "lcmtypes", "lcm_interest_t.c"),
     os.path.join("..", "lcm", "lcm_udpm.c"),
-    os.path.join("..", "lcm", "ringbuffer.c"),
     os.path.join("..", "lcm", "udpm_util.c")
     ]
 
@@ -81,6 +93,13 @@ else:
     # libraries
     pkgconfig_lflags = subprocess.check_output( ["pkg-config", "--libs-only-l", pkg_deps] ).decode(sys.stdout.encoding)
     libraries = [ t[2:] for t in pkgconfig_lflags.split() ]
+    if sys.platform.startswith("linux"):
+        # shm_open, for the shm provider
+        libraries.append("rt")
+    # compressed log files and udpm messages, if zlib is there
+    if subprocess.call(["pkg-config", "--exists", "zlib"]) == 0:
+        define_macros.append(('LCM_HAVE_ZLIB', ''))
+        libraries.append("z")
 
     # link directories
     pkgconfig_biglflags = subprocess.check_output( ["pkg-config", "--libs-only-L", pkg_deps ] ).decode(sys.stdout.encoding)
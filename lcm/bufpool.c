@@ -0,0 +1,185 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+
+#include "bufpool.h"
+
+#define MAGIC 0x067f8688
+
+#define NUM_SIZE_CLASSES 3
+static const unsigned int size_classes[NUM_SIZE_CLASSES] = {
+    512, 8192, LCM_BUFPOOL_MAX_ALLOC
+};
+
+// how lcm_bufpool_prealloc divides the memory cap between the size classes,
+// in quarters.  The smallest class gets whatever is left.
+static const unsigned int prealloc_quarters[NUM_SIZE_CLASSES] = {
+    1, 1, 2
+};
+
+typedef struct _lcm_bufpool_chunk lcm_bufpool_chunk_t;
+
+struct _lcm_bufpool_chunk
+{
+    int32_t              magic;
+    int32_t              size_class;
+    lcm_bufpool_chunk_t *next;      // next chunk on the free list
+    // keeps buf aligned the same way as the ring buffer used to
+    char                 pad[32 - 2 * sizeof (int32_t) - sizeof (void*)];
+    char                 buf[];
+};
+
+struct _lcm_bufpool {
+    size_t max_bytes;
+    size_t held;                      // bytes malloc()ed, in use or free
+    size_t used;                      // bytes in use
+    int fixed;                        // preallocated, never malloc()s
+
+    lcm_bufpool_chunk_t *free_lists[NUM_SIZE_CLASSES];
+};
+
+static size_t
+chunk_bytes (int size_class)
+{
+    return sizeof (lcm_bufpool_chunk_t) + size_classes[size_class];
+}
+
+static lcm_bufpool_chunk_t *
+chunk_of (const char *buf)
+{
+    lcm_bufpool_chunk_t *chunk =
+        (lcm_bufpool_chunk_t*) (buf - offsetof (lcm_bufpool_chunk_t, buf));
+    assert (chunk->magic == MAGIC);
+    return chunk;
+}
+
+lcm_bufpool_t *
+lcm_bufpool_new (size_t max_bytes)
+{
+    lcm_bufpool_t *pool = (lcm_bufpool_t *) calloc (1, sizeof (lcm_bufpool_t));
+    pool->max_bytes = max_bytes;
+    return pool;
+}
+
+static void
+free_list_release (lcm_bufpool_t *pool, int size_class)
+{
+    while (pool->free_lists[size_class]) {
+        lcm_bufpool_chunk_t *chunk = pool->free_lists[size_class];
+        pool->free_lists[size_class] = chunk->next;
+        pool->held -= chunk_bytes (size_class);
+        free (chunk);
+    }
+}
+
+void
+lcm_bufpool_free (lcm_bufpool_t *pool)
+{
+    if (!pool)
+        return;
+    assert (pool->used == 0);
+    for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+        free_list_release (pool, i);
+    free (pool);
+}
+
+int
+lcm_bufpool_prealloc (lcm_bufpool_t *pool)
+{
+    for (int i = NUM_SIZE_CLASSES - 1; i >= 0; i--) {
+        size_t nbytes = chunk_bytes (i);
+        size_t share = pool->max_bytes / 4 * prealloc_quarters[i];
+        size_t n = i ? share / nbytes : pool->max_bytes / nbytes;
+        if (!n)
+            n = 1;
+        for (; n && pool->held + nbytes <= pool->max_bytes; n--) {
+            lcm_bufpool_chunk_t *chunk = (lcm_bufpool_chunk_t *) malloc (nbytes);
+            if (!chunk) {
+                pool->fixed = 1;
+                return -1;
+            }
+            memset (chunk, 0, nbytes);
+            chunk->magic = MAGIC;
+            chunk->size_class = i;
+            chunk->next = pool->free_lists[i];
+            pool->free_lists[i] = chunk;
+            pool->held += nbytes;
+        }
+    }
+    pool->fixed = 1;
+    return 0;
+}
+
+char *
+lcm_bufpool_alloc (lcm_bufpool_t *pool, unsigned int len)
+{
+    int size_class = 0;
+    while (size_class < NUM_SIZE_CLASSES && len > size_classes[size_class])
+        size_class++;
+    if (size_class == NUM_SIZE_CLASSES)
+        return NULL;
+
+    lcm_bufpool_chunk_t *chunk = pool->free_lists[size_class];
+    if (pool->fixed) {
+        // fall back to a larger buffer rather than allocate
+        while (!chunk && ++size_class < NUM_SIZE_CLASSES)
+            chunk = pool->free_lists[size_class];
+        if (!chunk)
+            return NULL;
+        pool->free_lists[size_class] = chunk->next;
+    } else if (chunk) {
+        pool->free_lists[size_class] = chunk->next;
+    } else {
+        size_t nbytes = chunk_bytes (size_class);
+
+        // memory cached for the other size classes is given back before the
+        // pool refuses to allocate.  The largest buffers go first.
+        for (int i = NUM_SIZE_CLASSES - 1;
+                i >= 0 && pool->held + nbytes > pool->max_bytes; i--) {
+            if (i != size_class)
+                free_list_release (pool, i);
+        }
+        if (pool->held + nbytes > pool->max_bytes)
+            return NULL;
+
+        chunk = (lcm_bufpool_chunk_t *) malloc (nbytes);
+        if (!chunk)
+            return NULL;
+        chunk->magic = MAGIC;
+        chunk->size_class = size_class;
+        pool->held += nbytes;
+    }
+    chunk->next = NULL;
+    pool->used += chunk_bytes (size_class);
+    return chunk->buf;
+}
+
+void
+lcm_bufpool_release (lcm_bufpool_t *pool, char *buf)
+{
+    lcm_bufpool_chunk_t *chunk = chunk_of (buf);
+    pool->used -= chunk_bytes (chunk->size_class);
+    chunk->next = pool->free_lists[chunk->size_class];
+    pool->free_lists[chunk->size_class] = chunk;
+}
+
+unsigned int
+lcm_bufpool_buf_size (const char *buf)
+{
+    return size_classes[chunk_of (buf)->size_class];
+}
+
+size_t
+lcm_bufpool_capacity (lcm_bufpool_t *pool)
+{
+    return pool->max_bytes;
+}
+
+size_t
+lcm_bufpool_used (lcm_bufpool_t *pool)
+{
+    return pool->used;
+}
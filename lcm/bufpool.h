@@ -0,0 +1,74 @@
+#ifndef __lcm_bufpool_h__
+#define __lcm_bufpool_h__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/*
+ * A pool of packet buffers in a few fixed size classes (512 bytes, 8 KB and
+ * 64 KB).  Buffers can be released in any order, and are kept on a free list
+ * per size class for reuse.
+ *
+ * The pool never holds more than its memory cap, counting both the buffers in
+ * use and the ones on the free lists.  Once the cap is reached,
+ * lcm_bufpool_alloc returns NULL instead of growing the pool.
+ *
+ * A pool can also be filled up front with lcm_bufpool_prealloc, after which
+ * it never calls malloc() or free() again until lcm_bufpool_free.
+ *
+ * A pool is not thread-safe.
+ */
+typedef struct _lcm_bufpool lcm_bufpool_t;
+
+#define LCM_BUFPOOL_MAX_ALLOC 65536
+
+lcm_bufpool_t * lcm_bufpool_new (size_t max_bytes);
+
+/*
+ * Frees the pool.  All buffers must have been released first.
+ */
+void lcm_bufpool_free (lcm_bufpool_t * pool);
+
+/*
+ * Allocates buffers of every size class up to the memory cap, touches them
+ * so that their pages are mapped in, and puts them on the free lists.  From
+ * then on the pool only hands out those buffers, and a request for a size
+ * class that has run out is served from a larger one.
+ *
+ * Returns 0 on success, or -1 if malloc() failed, in which case the pool
+ * keeps the buffers allocated so far and still works.
+ */
+int lcm_bufpool_prealloc (lcm_bufpool_t * pool);
+
+/*
+ * Returns a buffer of at least len bytes, or NULL if len is larger than
+ * LCM_BUFPOOL_MAX_ALLOC or the pool is at its memory cap.
+ */
+char * lcm_bufpool_alloc (lcm_bufpool_t * pool, unsigned int len);
+
+/*
+ * Returns a buffer to the pool.
+ */
+void lcm_bufpool_release (lcm_bufpool_t * pool, char * buf);
+
+/*
+ * The number of bytes that can be handed out from a buffer returned by
+ * lcm_bufpool_alloc, i.e., the size of its size class.
+ */
+unsigned int lcm_bufpool_buf_size (const char * buf);
+
+size_t lcm_bufpool_capacity (lcm_bufpool_t * pool);
+
+/*
+ * Bytes taken by the buffers currently in use, including their bookkeeping.
+ */
+size_t lcm_bufpool_used (lcm_bufpool_t * pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+
+#include <glib.h>
+
+#include "channel_matcher.h"
+
+struct _lcm_channel_pattern {
+    lcm_channel_pattern_kind_t kind;
+    char   *text;     // literal channel name or prefix, unescaped
+    size_t  text_len;
+    GRegex *regex;    // only for LCM_CHANNEL_PATTERN_REGEX
+};
+
+typedef struct _matcher_entry matcher_entry_t;
+struct _matcher_entry {
+    const lcm_channel_pattern_t *pat;
+    void     *value;
+    uint64_t  seqno;  // insertion order, used to sort lookup results
+};
+
+typedef struct _trie_node trie_node_t;
+struct _trie_node {
+    char         c;
+    trie_node_t *child;
+    trie_node_t *sibling;
+    GPtrArray   *entries;  // matcher_entry_t* whose prefix ends here
+};
+
+struct _lcm_channel_matcher {
+    GHashTable  *literals;  // channel name -> GPtrArray of matcher_entry_t*
+    trie_node_t  prefixes;  // root of the prefix trie
+    GPtrArray   *regexes;   // matcher_entry_t*
+    uint64_t     next_seqno;
+};
+
+static int
+is_regex_metachar (char c)
+{
+    return strchr (".[](){}*+?|^$\\", c) != NULL;
+}
+
+/*
+ * Scans a subscription pattern.  If it can be matched without a regex engine,
+ * stores the unescaped literal text in *text and returns the pattern kind.
+ * Otherwise, returns LCM_CHANNEL_PATTERN_REGEX.
+ */
+static lcm_channel_pattern_kind_t
+classify_pattern (const char *pattern, char **text)
+{
+    size_t len = strlen (pattern);
+    char *buf = (char *) malloc (len + 1);
+    size_t n = 0;
+    lcm_channel_pattern_kind_t kind = LCM_CHANNEL_PATTERN_LITERAL;
+
+    for (size_t i = 0; i < len; i++) {
+        char c = pattern[i];
+        if (c == '\\') {
+            // an escaped punctuation character stands for itself.  Escapes
+            // like \d or \w are character classes.
+            char e = pattern[i+1];
+            if (e && !isalnum ((unsigned char) e)) {
+                buf[n++] = e;
+                i++;
+                continue;
+            }
+            kind = LCM_CHANNEL_PATTERN_REGEX;
+            break;
+        }
+        if (c == '.' && pattern[i+1] == '*' && i + 2 == len) {
+            kind = LCM_CHANNEL_PATTERN_PREFIX;
+            break;
+        }
+        if (is_regex_metachar (c)) {
+            kind = LCM_CHANNEL_PATTERN_REGEX;
+            break;
+        }
+        buf[n++] = c;
+    }
+
+    if (kind == LCM_CHANNEL_PATTERN_REGEX) {
+        free (buf);
+        *text = NULL;
+    } else {
+        buf[n] = 0;
+        *text = buf;
+    }
+    return kind;
+}
+
+lcm_channel_pattern_t *
+lcm_channel_pattern_new (const char *pattern, GError **err)
+{
+    lcm_channel_pattern_t *pat =
+        (lcm_channel_pattern_t *) calloc (1, sizeof (lcm_channel_pattern_t));
+    pat->kind = classify_pattern (pattern, &pat->text);
+
+    if (pat->kind != LCM_CHANNEL_PATTERN_REGEX) {
+        pat->text_len = strlen (pat->text);
+        return pat;
+    }
+
+    char *regexbuf = g_strdup_printf ("^%s$", pattern);
+    pat->regex = g_regex_new (regexbuf, (GRegexCompileFlags) 0,
+            (GRegexMatchFlags) 0, err);
+    g_free (regexbuf);
+    if (!pat->regex) {
+        free (pat);
+        return NULL;
+    }
+    return pat;
+}
+
+void
+lcm_channel_pattern_free (lcm_channel_pattern_t *pat)
+{
+    if (!pat)
+        return;
+    if (pat->regex)
+        g_regex_unref (pat->regex);
+    free (pat->text);
+    free (pat);
+}
+
+lcm_channel_pattern_kind_t
+lcm_channel_pattern_kind (const lcm_channel_pattern_t *pat)
+{
+    return pat->kind;
+}
+
+const char *
+lcm_channel_pattern_text (const lcm_channel_pattern_t *pat)
+{
+    return pat->text;
+}
+
+int
+lcm_channel_pattern_match (const lcm_channel_pattern_t *pat,
+        const char *channel)
+{
+    switch (pat->kind) {
+        case LCM_CHANNEL_PATTERN_LITERAL:
+            return !strcmp (pat->text, channel);
+        case LCM_CHANNEL_PATTERN_PREFIX:
+            // '.' does not match a newline
+            return !strncmp (pat->text, channel, pat->text_len) &&
+                !strchr (channel + pat->text_len, '\n');
+        default:
+            return g_regex_match (pat->regex, channel, (GRegexMatchFlags) 0,
+                    NULL);
+    }
+}
+
+/* ==== matcher ==== */
+
+static void
+free_entries (GPtrArray *entries)
+{
+    for (unsigned int i = 0; i < entries->len; i++)
+        free (g_ptr_array_index (entries, i));
+    g_ptr_array_free (entries, TRUE);
+}
+
+static void
+literals_free_callback (gpointer key, gpointer value, gpointer user_data)
+{
+    free_entries ((GPtrArray *) value);
+    free (key);
+}
+
+static int
+remove_entry (GPtrArray *entries, const lcm_channel_pattern_t *pat,
+        void *value)
+{
+    for (unsigned int i = 0; i < entries->len; i++) {
+        matcher_entry_t *e = (matcher_entry_t *) g_ptr_array_index (entries, i);
+        if (e->pat == pat && e->value == value) {
+            g_ptr_array_remove_index (entries, i);
+            free (e);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static void
+trie_free_children (trie_node_t *node)
+{
+    trie_node_t *child = node->child;
+    while (child) {
+        trie_node_t *next = child->sibling;
+        trie_free_children (child);
+        if (child->entries)
+            free_entries (child->entries);
+        free (child);
+        child = next;
+    }
+}
+
+static trie_node_t *
+trie_find_child (trie_node_t *node, char c)
+{
+    for (trie_node_t *child = node->child; child; child = child->sibling) {
+        if (child->c == c)
+            return child;
+    }
+    return NULL;
+}
+
+lcm_channel_matcher_t *
+lcm_channel_matcher_new (void)
+{
+    lcm_channel_matcher_t *matcher =
+        (lcm_channel_matcher_t *) calloc (1, sizeof (lcm_channel_matcher_t));
+    matcher->literals = g_hash_table_new (g_str_hash, g_str_equal);
+    matcher->regexes = g_ptr_array_new ();
+    return matcher;
+}
+
+void
+lcm_channel_matcher_free (lcm_channel_matcher_t *matcher)
+{
+    g_hash_table_foreach (matcher->literals, literals_free_callback, NULL);
+    g_hash_table_destroy (matcher->literals);
+    trie_free_children (&matcher->prefixes);
+    if (matcher->prefixes.entries)
+        free_entries (matcher->prefixes.entries);
+    free_entries (matcher->regexes);
+    free (matcher);
+}
+
+void
+lcm_channel_matcher_add (lcm_channel_matcher_t *matcher,
+        const lcm_channel_pattern_t *pat, void *value)
+{
+    matcher_entry_t *e = (matcher_entry_t *) calloc (1, sizeof (matcher_entry_t));
+    e->pat = pat;
+    e->value = value;
+    e->seqno = matcher->next_seqno++;
+
+    GPtrArray *entries = NULL;
+    switch (pat->kind) {
+        case LCM_CHANNEL_PATTERN_LITERAL:
+            entries = (GPtrArray *) g_hash_table_lookup (matcher->literals,
+                    pat->text);
+            if (!entries) {
+                entries = g_ptr_array_new ();
+                g_hash_table_insert (matcher->literals, strdup (pat->text),
+                        entries);
+            }
+            break;
+        case LCM_CHANNEL_PATTERN_PREFIX:
+            {
+                trie_node_t *node = &matcher->prefixes;
+                for (const char *p = pat->text; *p; p++) {
+                    trie_node_t *child = trie_find_child (node, *p);
+                    if (!child) {
+                        child = (trie_node_t *) calloc (1, sizeof (trie_node_t));
+                        child->c = *p;
+                        child->sibling = node->child;
+                        node->child = child;
+                    }
+                    node = child;
+                }
+                if (!node->entries)
+                    node->entries = g_ptr_array_new ();
+                entries = node->entries;
+            }
+            break;
+        default:
+            entries = matcher->regexes;
+            break;
+    }
+    g_ptr_array_add (entries, e);
+}
+
+int
+lcm_channel_matcher_remove (lcm_channel_matcher_t *matcher,
+        const lcm_channel_pattern_t *pat, void *value)
+{
+    switch (pat->kind) {
+        case LCM_CHANNEL_PATTERN_LITERAL:
+            {
+                gpointer key = NULL;
+                gpointer entries = NULL;
+                if (!g_hash_table_lookup_extended (matcher->literals,
+                            pat->text, &key, &entries))
+                    return -1;
+                if (0 != remove_entry ((GPtrArray *) entries, pat, value))
+                    return -1;
+                if (!((GPtrArray *) entries)->len) {
+                    g_hash_table_remove (matcher->literals, pat->text);
+                    g_ptr_array_free ((GPtrArray *) entries, TRUE);
+                    free (key);
+                }
+                return 0;
+            }
+        case LCM_CHANNEL_PATTERN_PREFIX:
+            {
+                // trie nodes are left in place.  The set of distinct prefixes
+                // is small and bounded by the subscriptions ever made.
+                trie_node_t *node = &matcher->prefixes;
+                for (const char *p = pat->text; *p && node; p++)
+                    node = trie_find_child (node, *p);
+                if (!node || !node->entries)
+                    return -1;
+                return remove_entry (node->entries, pat, value);
+            }
+        default:
+            return remove_entry (matcher->regexes, pat, value);
+    }
+}
+
+static gint
+entry_seqno_compare (gconstpointer a, gconstpointer b)
+{
+    const matcher_entry_t *ea = *(const matcher_entry_t * const *) a;
+    const matcher_entry_t *eb = *(const matcher_entry_t * const *) b;
+    if (ea->seqno < eb->seqno)
+        return -1;
+    return ea->seqno > eb->seqno;
+}
+
+static void
+append_entries (GPtrArray *dst, GPtrArray *entries)
+{
+    if (!entries)
+        return;
+    for (unsigned int i = 0; i < entries->len; i++)
+        g_ptr_array_add (dst, g_ptr_array_index (entries, i));
+}
+
+void
+lcm_channel_matcher_lookup (lcm_channel_matcher_t *matcher,
+        const char *channel, GPtrArray *result)
+{
+    GPtrArray *found = g_ptr_array_new ();
+
+    append_entries (found, (GPtrArray *) g_hash_table_lookup (
+                matcher->literals, channel));
+
+    // every trie node on the path spelled by the channel name is a matching
+    // prefix, as long as the rest of the name has no newline for ".*" to
+    // stop at.
+    const char *last_newline = strrchr (channel, '\n');
+    trie_node_t *node = &matcher->prefixes;
+    if (!last_newline)
+        append_entries (found, node->entries);
+    for (const char *p = channel; *p && node; p++) {
+        node = trie_find_child (node, *p);
+        if (node && (!last_newline || last_newline <= p))
+            append_entries (found, node->entries);
+    }
+
+    for (unsigned int i = 0; i < matcher->regexes->len; i++) {
+        matcher_entry_t *e =
+            (matcher_entry_t *) g_ptr_array_index (matcher->regexes, i);
+        if (lcm_channel_pattern_match (e->pat, channel))
+            g_ptr_array_add (found, e);
+    }
+
+    if (found->len > 1)
+        g_ptr_array_sort (found, entry_seqno_compare);
+
+    for (unsigned int i = 0; i < found->len; i++) {
+        matcher_entry_t *e = (matcher_entry_t *) g_ptr_array_index (found, i);
+        g_ptr_array_add (result, e->value);
+    }
+    g_ptr_array_free (found, TRUE);
+}
@@ -0,0 +1,79 @@
+#ifndef __lcm_channel_matcher_h__
+#define __lcm_channel_matcher_h__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A compiled subscription pattern.  Channel subscriptions are regular
+ * expressions implicitly surrounded by '^' and '$', but in practice almost
+ * all of them are either plain channel names or a literal prefix followed by
+ * ".*".  Those two cases are recognized when the pattern is compiled and
+ * matched without going through GRegex.
+ */
+typedef struct _lcm_channel_pattern lcm_channel_pattern_t;
+
+typedef enum {
+    LCM_CHANNEL_PATTERN_LITERAL,
+    LCM_CHANNEL_PATTERN_PREFIX,
+    LCM_CHANNEL_PATTERN_REGEX
+} lcm_channel_pattern_kind_t;
+
+/*
+ * Compiles a subscription pattern.  Returns NULL and sets @err if the pattern
+ * is not a valid regular expression.
+ */
+lcm_channel_pattern_t * lcm_channel_pattern_new (const char *pattern,
+        GError **err);
+void lcm_channel_pattern_free (lcm_channel_pattern_t *pat);
+
+lcm_channel_pattern_kind_t lcm_channel_pattern_kind (
+        const lcm_channel_pattern_t *pat);
+
+/*
+ * For literal patterns, the channel name that matches.  For prefix patterns,
+ * the prefix.  NULL for regular expressions.
+ */
+const char * lcm_channel_pattern_text (const lcm_channel_pattern_t *pat);
+
+int lcm_channel_pattern_match (const lcm_channel_pattern_t *pat,
+        const char *channel);
+
+/*
+ * An index over a set of (pattern, value) pairs that answers "which values
+ * have a pattern matching this channel name".  Literal patterns are looked up
+ * in a hash table, prefix patterns in a character trie, and only true regular
+ * expressions are tested one by one.
+ *
+ * The matcher does not own the patterns or the values.
+ */
+typedef struct _lcm_channel_matcher lcm_channel_matcher_t;
+
+lcm_channel_matcher_t * lcm_channel_matcher_new (void);
+void lcm_channel_matcher_free (lcm_channel_matcher_t *matcher);
+
+void lcm_channel_matcher_add (lcm_channel_matcher_t *matcher,
+        const lcm_channel_pattern_t *pat, void *value);
+
+/*
+ * Removes a (pattern, value) pair previously added.  Returns 0 on success, -1
+ * if the pair was not found.
+ */
+int lcm_channel_matcher_remove (lcm_channel_matcher_t *matcher,
+        const lcm_channel_pattern_t *pat, void *value);
+
+/*
+ * Appends to @result every value whose pattern matches @channel, in the order
+ * in which the values were added.
+ */
+void lcm_channel_matcher_lookup (lcm_channel_matcher_t *matcher,
+        const char *channel, GPtrArray *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
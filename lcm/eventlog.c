@@ -1,3 +1,4 @@
+#define _GNU_SOURCE  // for O_DIRECT
 #include <stdio.h>
 #include <sys/types.h>
 #include <string.h>
@@ -7,9 +8,35 @@
 #define __STDC_FORMAT_MACROS			// Enable integer types
 #endif
 #include <stdint.h>
+#include <errno.h>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+#include <glib.h>
+#ifdef LCM_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef LCM_HAVE_ZLIB
+#include <zlib.h>
+#endif
+// Looking for the magic number of an event after corrupt data compares 32
+// or 16 bytes at a time when the compiler targets AVX2 or SSE2, and uses
+// memchr() otherwise.
+#if defined(__AVX2__)
+#define EVENTLOG_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define EVENTLOG_SIMD_SSE2
+#include <emmintrin.h>
+#endif
 
 #include "ioutils.h"
 #include "eventlog.h"
+#include "channel_matcher.h"
+#include "lcm_internal.h"
 
 #ifdef WIN32
 #include "./windows/WinPorting.h"
@@ -17,9 +44,438 @@
 
 #define MAGIC ((int32_t) 0xEDA1DA01L)
 
+// The first line of a stripe manifest, see lcm_eventlog_write_manifest().
+// Each following line is the path of a stripe.
+#define MANIFEST_HEADER "LCM stripe manifest 1\n"
+
+// Size of the stdio buffer in read mode.  Events are parsed from large
+// reads, and a log is only scanned a byte at a time to resynchronize after
+// corrupt data.
+#define READ_BUF_SIZE (1 << 20)
+
+// magic, event number, timestamp, channel length, data length
+#define HEADER_SIZE 28
+
+// The sidecar index starts with a magic number and a version, followed by
+// records that each start with a type, all big-endian like the log itself:
+//
+//   INDEX_EVENT           event number, timestamp and file offset of an event
+//                         that starts a block.  The block runs up to the
+//                         next INDEX_EVENT.
+//   INDEX_CHANNEL         length and name of a channel.  Channels are
+//                         numbered in the order they first appear.
+//   INDEX_BLOCK_CHANNELS  number of words, then a bitmap of the channels in
+//                         the block that the last INDEX_EVENT started.
+//                         Written when the block ends, so the last block of
+//                         a log that is still being written has none.
+//   INDEX_BLOCK_STATS     offset just past the last event of the block, and
+//                         the number of its channels, then for each of them
+//                         the channel number, the number of events, their
+//                         data bytes, the first and last timestamps and the
+//                         longest time between two events.  Written after
+//                         INDEX_BLOCK_CHANNELS, by version 3 and later.
+//
+// A block starts with the first event, and then with the first event after
+// every INDEX_INTERVAL_EVENTS events or INDEX_INTERVAL_BYTES bytes,
+// whichever comes first, so that seeking reads at most about that much of
+// the log.
+#define INDEX_MAGIC ((int32_t) 0xEDA1DA1DL)
+#define INDEX_VERSION 3
+#define INDEX_EVENT 1
+#define INDEX_CHANNEL 2
+#define INDEX_BLOCK_CHANNELS 3
+#define INDEX_BLOCK_STATS 4
+#define INDEX_STATS_HEADER_SIZE 16
+#define INDEX_STATS_ENTRY_SIZE 40
+#define INDEX_INTERVAL_EVENTS 1000
+#define INDEX_INTERVAL_BYTES (1 << 20)
+
+// Channel names in a log are shorter than this
+#define MAX_CHANNEL_LEN 1000
+
+// How much of a log is searched at a time for the next event after corrupt
+// data
+#define RESYNC_CHUNK_SIZE (1 << 16)
+
+// A compressed log is made of blocks, each of which starts with a header:
+//
+//   magic, codec, stored size, raw size      int32 each
+//   event number, timestamp                  int64 each, of the first event
+//
+// followed by the stored size bytes of the events of the block, in the
+// ordinary format, compressed with the codec unless it is BLOCK_CODEC_NONE.
+// A log that was closed properly ends with an index of its blocks:
+//
+//   FOOTER_MAGIC, number of blocks           int32 each
+//   offset, event number, timestamp          int64 each, for every block
+//   offset of the footer                     int64
+//   FOOTER_MAGIC                             int32
+//
+// Without the footer, the block headers are scanned instead.
+#define BLOCK_MAGIC ((int32_t) 0xEDA1DA02L)
+#define FOOTER_MAGIC ((int32_t) 0xEDA1DA03L)
+#define BLOCK_HEADER_SIZE 32
+#define FOOTER_ENTRY_SIZE 24
+#define FOOTER_TRAILER_SIZE 12
+#define BLOCK_CODEC_NONE 0
+#define BLOCK_CODEC_LZ4 1
+#define BLOCK_CODEC_ZLIB 2
+
+// Buffer of the writer that bypasses stdio.  Writes with O_DIRECT are made
+// of whole WRITE_ALIGN blocks from a buffer aligned the same way.
+#define WRITE_BUF_SIZE (1 << 20)
+#define WRITE_ALIGN 4096
+// Events at least this large are written out of the caller's buffers, along
+// with what is buffered, instead of being copied
+#define WRITEV_MIN_SIZE (1 << 14)
+
+// Events are compressed in blocks of about this many bytes.  Seeking
+// decompresses at most one block.
+#define BLOCK_SIZE (1 << 18)
+
+static inline int32_t decode32(const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+            ((uint32_t) p[2] << 8) | (uint32_t) p[3]);
+}
+
+static inline int64_t decode64(const uint8_t *p)
+{
+    return (int64_t) (((uint64_t) (uint32_t) decode32(p) << 32) |
+            (uint32_t) decode32(p + 4));
+}
+
+// A block of the sidecar index: the event it starts with and where that is,
+// and the channels in it.
+typedef struct {
+    int64_t eventnum;
+    int64_t timestamp;
+    int64_t offset;
+    const uint8_t *channels;  // the bitmap in the raw index, or NULL
+    int32_t channel_words;
+    int8_t matches;           // for filtered reads, -1 until known
+    const uint8_t *stats;     // the channel stats in the raw index, or NULL
+    int32_t num_stats;
+    int64_t end_offset;       // just past the block, if stats is set
+} index_entry_t;
+
+// What the index counts of one channel in the current block.
+typedef struct {
+    int32_t count;
+    int64_t bytes;
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    int64_t max_gap;
+} block_stats_t;
+
+// A block of a compressed log.
+typedef struct {
+    int64_t offset;
+    int64_t eventnum;
+    int64_t timestamp;
+} block_entry_t;
+
+// What the library keeps along with the lcm_eventlog_t handed out.
+// An event queued by lcm_eventlog_write_event() on an asynchronous log.  The
+// channel and data follow the struct.
+typedef struct _async_event async_event_t;
+struct _async_event {
+    async_event_t *next;
+    int64_t size;
+    lcm_eventlog_event_t event;
+};
+
+typedef struct _eventlog_impl eventlog_impl_t;
+struct _eventlog_impl {
+    lcm_eventlog_t log;  // must be first
+    char *path;
+    int reading;
+
+    // Writing without stdio, see lcm_eventlog_set_write_flags().  The
+    // buffered data goes to the file at wbuf_offset.
+    int fd;                // -1 when writing through stdio
+    int own_fd;            // fd was opened for O_DIRECT
+    int direct;
+    uint8_t *wbuf;
+    size_t wbuf_len;
+    int64_t wbuf_offset;
+
+    // Writing from a thread of our own, see lcm_eventlog_create_async().
+    // The queue and the stats are guarded by async_mutex.
+    GThread *async_thread;
+    GMutex *async_mutex;
+    GCond *async_cond;        // signaled when events are queued, or on exit
+    GCond *async_space_cond;  // signaled when queued events are written
+    async_event_t *async_head;
+    async_event_t *async_tail;
+    int64_t async_queue_cap;
+    int async_block;
+    int async_exit;
+    int async_flush_status;   // of the last flush
+    int64_t async_eventcount; // the eventnum of the next queued event
+    lcm_eventlog_async_stats_t async_stats;
+
+    // The file offset just past the magic number that was read to validate
+    // the end of the previous event, or -1.  The next read skips re-reading
+    // that magic number if the file has not moved since.
+    int64_t next_header_offset;
+
+    // writing the index
+    FILE *index_f;
+    int64_t bytes_since_index;  // logged since the current block started
+    int64_t events_since_index;
+    GHashTable *index_channel_ids;  // channel name -> number + 1
+    uint32_t *block_channels;       // bitmap of the current block, or NULL
+    int32_t block_channel_words;
+    int index_stats;                // whether to write INDEX_BLOCK_STATS
+    block_stats_t *block_stats;     // by channel number
+    guint block_stats_len;
+    int64_t block_end;              // just past the last event indexed
+
+    // reading the index, loaded by the first seek
+    uint8_t *index_raw;
+    index_entry_t *index;
+    int64_t index_len;
+    int64_t index_file_size;    // of the index file that was loaded
+    int32_t index_version;
+    GPtrArray *index_channels;  // names by number
+
+    // Compressed logs.  A block of raw events is assembled in write mode, and
+    // decompressed in read mode.
+    int compressed;
+    int codec;                  // of the blocks to write
+    uint8_t *block;
+    int32_t block_capacity;
+    int32_t block_len;
+    int32_t block_pos;          // of the next event to read
+    uint8_t *stored;            // compressed data
+    int32_t stored_capacity;
+    int64_t next_block_offset;  // where reading left the file, or -1
+    GArray *blocks;             // block_entry_t, written or found so far
+    int blocks_complete;        // read from the footer
+    int64_t blocks_scanned_to;  // offset of the next block header to scan
+
+    // filtered reads
+    lcm_channel_pattern_t *filter;
+    GHashTable *filter_matches;  // channel name -> 1 + whether it matches
+    int64_t filter_block;        // where the last lookup found the file
+
+    // Reads stop at the first event, or block of a compressed log, that
+    // starts at or after range_end, unless it is -1.
+    int64_t range_end;
+
+    // A striped log, read from the logs named by a manifest.  stripe_ready
+    // is 1 when stripe_events holds the next event of a stripe, 0 once the
+    // stripe is done, and -1 until it is read.  stripe_next_num is the event
+    // number of the stripe's next event.
+    lcm_eventlog_t **stripes;
+    int num_stripes;
+    lcm_eventlog_event_t *stripe_events;
+    int32_t *stripe_capacities;  // of the channel and data of each event
+    int8_t *stripe_ready;
+    int64_t *stripe_next_num;
+
+    char read_buf[];  // the stdio buffer in read mode
+};
+
+static inline eventlog_impl_t *impl(lcm_eventlog_t *l)
+{
+    return (eventlog_impl_t *) l;
+}
+
+static int load_stripes(eventlog_impl_t *li);
+
+static int write_be32(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t) ((uint32_t) v >> 24);
+    p[1] = (uint8_t) ((uint32_t) v >> 16);
+    p[2] = (uint8_t) ((uint32_t) v >> 8);
+    p[3] = (uint8_t) v;
+    return 4;
+}
+
+static int write_be64(uint8_t *p, int64_t v)
+{
+    write_be32(p, (int32_t) ((uint64_t) v >> 32));
+    return 4 + write_be32(p + 4, (int32_t) v);
+}
+
+static char *index_path(const char *path)
+{
+    char *ipath = (char *) malloc(strlen(path) +
+            strlen(LCM_EVENTLOG_INDEX_SUFFIX) + 1);
+    strcpy(ipath, path);
+    strcat(ipath, LCM_EVENTLOG_INDEX_SUFFIX);
+    return ipath;
+}
+
+static void free_index(eventlog_impl_t *li)
+{
+    free(li->index_raw);
+    free(li->index);
+    li->index_raw = NULL;
+    li->index = NULL;
+    li->index_len = 0;
+    if (li->index_channels)
+        g_ptr_array_free(li->index_channels, TRUE);
+    li->index_channels = NULL;
+}
+
+// A piece of what is written with log_output()
+typedef struct {
+    const void *data;
+    size_t len;
+} out_part_t;
+
+#ifndef WIN32
+static int writev_all(int fd, struct iovec *iov, int n)
+{
+    while (n > 0) {
+        ssize_t written = writev(fd, iov, n);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        while (n > 0 && (size_t) written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            n--;
+        }
+        if (n > 0) {
+            iov->iov_base = (char *) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+static int pwrite_all(int fd, const uint8_t *buf, size_t len, int64_t offset)
+{
+    while (len > 0) {
+        ssize_t written = pwrite(fd, buf, len, offset);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += written;
+        len -= written;
+        offset += written;
+    }
+    return 0;
+}
+#endif
+
+// Writes out what the writer has buffered.  With O_DIRECT, only whole
+// blocks are written, unless final is set.  Then the last partial block is
+// written padded, and the file truncated to its actual size.  The partial
+// block stays buffered, to be written again with what follows.
+static int writer_drain(eventlog_impl_t *li, int final)
+{
+#ifndef WIN32
+    if (!li->direct) {
+        struct iovec iov = { li->wbuf, li->wbuf_len };
+        if (li->wbuf_len && 0 != writev_all(li->fd, &iov, 1))
+            return -1;
+        li->wbuf_offset += li->wbuf_len;
+        li->wbuf_len = 0;
+        return 0;
+    }
+    size_t aligned = li->wbuf_len & ~(size_t) (WRITE_ALIGN - 1);
+    if (aligned) {
+        if (0 != pwrite_all(li->fd, li->wbuf, aligned, li->wbuf_offset))
+            return -1;
+        memmove(li->wbuf, li->wbuf + aligned, li->wbuf_len - aligned);
+        li->wbuf_offset += aligned;
+        li->wbuf_len -= aligned;
+    }
+    if (final && li->wbuf_len) {
+        memset(li->wbuf + li->wbuf_len, 0, WRITE_ALIGN - li->wbuf_len);
+        if (0 != pwrite_all(li->fd, li->wbuf, WRITE_ALIGN, li->wbuf_offset) ||
+                0 != ftruncate(li->fd, li->wbuf_offset + li->wbuf_len))
+            return -1;
+    }
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+// Writes the parts one after the other, through stdio or the writer.
+// Returns 0 on success, or -1 with errno set.
+static int log_output(lcm_eventlog_t *l, const out_part_t *parts, int n)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->fd < 0) {
+        for (int i = 0; i < n; i++)
+            if (parts[i].len &&
+                    fwrite(parts[i].data, 1, parts[i].len, l->f) != parts[i].len)
+                return -1;
+        return 0;
+    }
+#ifndef WIN32
+    size_t total = 0;
+    for (int i = 0; i < n; i++)
+        total += parts[i].len;
+    if (!li->direct && total >= WRITEV_MIN_SIZE) {
+        // one system call for the buffered events and this one
+        struct iovec iov[8];
+        int niov = 0;
+        if (li->wbuf_len) {
+            iov[niov].iov_base = li->wbuf;
+            iov[niov++].iov_len = li->wbuf_len;
+        }
+        for (int i = 0; i < n && niov < 8; i++) {
+            iov[niov].iov_base = (void *) parts[i].data;
+            iov[niov++].iov_len = parts[i].len;
+        }
+        if (0 != writev_all(li->fd, iov, niov))
+            return -1;
+        li->wbuf_offset += li->wbuf_len + total;
+        li->wbuf_len = 0;
+        return 0;
+    }
+#endif
+    for (int i = 0; i < n; i++) {
+        const uint8_t *p = (const uint8_t *) parts[i].data;
+        size_t left = parts[i].len;
+        while (left > 0) {
+            if (li->wbuf_len == WRITE_BUF_SIZE && 0 != writer_drain(li, 0))
+                return -1;
+            size_t chunk = WRITE_BUF_SIZE - li->wbuf_len;
+            if (chunk > left)
+                chunk = left;
+            memcpy(li->wbuf + li->wbuf_len, p, chunk);
+            li->wbuf_len += chunk;
+            p += chunk;
+            left -= chunk;
+        }
+    }
+    return 0;
+}
+
+// Where the next byte written goes
+static int64_t log_offset(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->fd >= 0)
+        return li->wbuf_offset + li->wbuf_len;
+    return ftello(l->f);
+}
+
+// The size of a log that is being written
+static int64_t log_size(lcm_eventlog_t *l)
+{
+    if (impl(l)->fd < 0)
+        fseeko(l->f, 0, SEEK_END);
+    return log_offset(l);
+}
+
 lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode)
 {
     assert(!strcmp(mode, "r") || !strcmp(mode, "w") || !strcmp(mode, "a"));
+    int reading = *mode == 'r';
     if(*mode == 'w')
         mode = "wb";
     else if(*mode == 'r')
@@ -29,189 +485,2309 @@ lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode)
     else
         return NULL;
 
-    lcm_eventlog_t *l = (lcm_eventlog_t*) calloc(1, sizeof(lcm_eventlog_t));
+    eventlog_impl_t *li = (eventlog_impl_t*) calloc(1,
+            sizeof(eventlog_impl_t) + (reading ? READ_BUF_SIZE : 0));
+    lcm_eventlog_t *l = &li->log;
 
     l->f = fopen(path, mode);
     if (l->f == NULL) {
-        free (l);
+        free (li);
         return NULL;
     }
+    if (reading) {
+        setvbuf(l->f, li->read_buf, _IOFBF, READ_BUF_SIZE);
+        // Once the C library has seeked, it knows the file offset, and
+        // ftello() no longer needs a system call.
+        fseeko(l->f, 0, SEEK_SET);
+        int32_t magic;
+        li->compressed = 0 == fread32(l->f, &magic) && magic == BLOCK_MAGIC;
+        fseeko(l->f, 0, SEEK_SET);
+        li->next_block_offset = 0;
+    }
 
     l->eventcount = 0;
+    li->path = strdup(path);
+    li->reading = reading;
+    li->fd = -1;
+    li->range_end = -1;
+    li->next_header_offset = -1;
 
+    if (reading && 0 != load_stripes(li)) {
+        lcm_eventlog_destroy(l);
+        return NULL;
+    }
     return l;
 }
 
+static int index_write(eventlog_impl_t *li, const uint8_t *buf, size_t len);
+static void index_end_block(eventlog_impl_t *li);
+
+static int flush_block(lcm_eventlog_t *l);
+static void write_footer(lcm_eventlog_t *l);
+
+static void async_stop(eventlog_impl_t *li);
+
 void lcm_eventlog_destroy(lcm_eventlog_t *l)
 {
+    eventlog_impl_t *li = impl(l);
+    // the queued events are written first
+    if (li->async_thread)
+        async_stop(li);
+    if (li->compressed && li->codec) {
+        flush_block(l);
+        write_footer(l);
+    }
+    if (li->fd >= 0) {
+        writer_drain(li, 1);
+        if (li->own_fd)
+            close(li->fd);
+        free(li->wbuf);
+    }
     fflush(l->f);
     fclose(l->f);
-    free(l);
+    if (li->index_f) {
+        index_end_block(li);
+        if (li->index_f)
+            fclose(li->index_f);
+    }
+    if (li->index_channel_ids)
+        g_hash_table_destroy(li->index_channel_ids);
+    free(li->block_channels);
+    free(li->block_stats);
+    free_index(li);
+    free(li->block);
+    free(li->stored);
+    if (li->blocks)
+        g_array_free(li->blocks, TRUE);
+    if (li->filter)
+        lcm_channel_pattern_free(li->filter);
+    if (li->filter_matches)
+        g_hash_table_destroy(li->filter_matches);
+    for (int i = 0; i < li->num_stripes; i++) {
+        if (li->stripes[i])
+            lcm_eventlog_destroy(li->stripes[i]);
+        free(li->stripe_events[i].channel);
+        free(li->stripe_events[i].data);
+    }
+    free(li->stripes);
+    free(li->stripe_events);
+    free(li->stripe_capacities);
+    free(li->stripe_ready);
+    free(li->stripe_next_num);
+    free(li->path);
+    free(li);
 }
 
-lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *l)
+// Opens the stripes of a log, if it is a stripe manifest.  Returns 0 on
+// success, including for other logs.
+static int load_stripes(eventlog_impl_t *li)
 {
-    lcm_eventlog_event_t *le =
-        (lcm_eventlog_event_t*) calloc(1, sizeof(lcm_eventlog_event_t));
+    char header[sizeof(MANIFEST_HEADER) - 1];
+    size_t n = fread(header, 1, sizeof(header), li->log.f);
+    fseeko(li->log.f, 0, SEEK_SET);
+    if (n != sizeof(header) || memcmp(header, MANIFEST_HEADER, n))
+        return 0;
 
-    uint32_t magic = 0;
-    int r;
+    gchar *contents = NULL;
+    if (!g_file_get_contents(li->path, &contents, NULL, NULL))
+        return -1;
+    gchar **lines = g_strsplit(contents + sizeof(header), "\n", -1);
+    g_free(contents);
+    int num_lines = 0;
+    while (lines[num_lines])
+        num_lines++;
+    li->stripes = (lcm_eventlog_t **) calloc(num_lines + 1,
+            sizeof(lcm_eventlog_t *));
+    li->stripe_events = (lcm_eventlog_event_t *) calloc(num_lines,
+            sizeof(lcm_eventlog_event_t));
+    li->stripe_capacities = (int32_t *) calloc(2 * num_lines, sizeof(int32_t));
+    li->stripe_ready = (int8_t *) calloc(num_lines, sizeof(int8_t));
+    li->stripe_next_num = (int64_t *) calloc(num_lines, sizeof(int64_t));
 
-    do {
-        r = fgetc(l->f);
-        if (r < 0) {
-            free(le);
-            return NULL;
+    // relative paths are relative to the manifest
+    gchar *dir = g_path_get_dirname(li->path);
+    int status = 0;
+    for (int i = 0; i < num_lines && status == 0; i++) {
+        const char *stripe = g_strstrip(lines[i]);
+        if (!*stripe)
+            continue;
+        gchar *stripe_path = stripe[0] == G_DIR_SEPARATOR ? g_strdup(stripe) :
+            g_build_filename(dir, stripe, NULL);
+        lcm_eventlog_t *sl = lcm_eventlog_create(stripe_path, "r");
+        if (!sl) {
+            fprintf(stderr, "Unable to open stripe \"%s\" of \"%s\"\n",
+                    stripe_path, li->path);
+            status = -1;
+        } else {
+            li->stripe_ready[li->num_stripes] = -1;
+            li->stripes[li->num_stripes++] = sl;
         }
-        magic = (magic << 8) | (uint32_t) r;
-    } while( magic != MAGIC );
-
-    if (0 != fread64(l->f, &le->eventnum) ||
-        0 != fread64(l->f, &le->timestamp) ||
-        0 != fread32(l->f, &le->channellen) ||
-        0 != fread32(l->f, &le->datalen)) {
-        free(le);
-        return NULL;
+        g_free(stripe_path);
     }
+    g_free(dir);
+    g_strfreev(lines);
+    return status;
+}
 
-    // Sanity check the channel length and data length
-    if (le->channellen <= 0 || le->channellen >= 1000) {
-        fprintf(stderr, "Log event has invalid channel length: %d\n", le->channellen);
-        free(le);
-        return NULL;
-    }
-    if (le->datalen < 0) {
-        fprintf(stderr, "Log event has invalid data length: %d\n", le->datalen);
-        free(le);
-        return NULL;
+// Returns the earliest of the next events of the stripes.  The buffers of
+// the event are swapped with those of le, rather than copied.
+static int read_striped_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le,
+        int32_t *channel_capacity, int32_t *data_capacity)
+{
+    eventlog_impl_t *li = impl(l);
+    int next = -1;
+    for (int i = 0; i < li->num_stripes; i++) {
+        lcm_eventlog_event_t *e = &li->stripe_events[i];
+        if (li->stripe_ready[i] < 0) {
+            li->stripe_ready[i] = 0 == lcm_eventlog_read_next_event_into(
+                    li->stripes[i], e, &li->stripe_capacities[2 * i],
+                    &li->stripe_capacities[2 * i + 1]);
+            if (li->stripe_ready[i])
+                li->stripe_next_num[i] = e->eventnum;
+        }
+        // events with the same timestamp are taken in stripe order
+        if (li->stripe_ready[i] && (next < 0 ||
+                    e->timestamp < li->stripe_events[next].timestamp))
+            next = i;
     }
+    if (next < 0)
+        return -1;
 
-    le->channel = (char *) calloc(1, le->channellen+1);
-    if (fread(le->channel, 1, le->channellen, l->f) != (size_t) le->channellen) {
-        free(le->channel);
-        free(le->data);
-        free(le);
-        return NULL;
-    }
+    // Each stripe numbers its own events, so the events before this one
+    // are those before the next event of every stripe.
+    lcm_eventlog_event_t *e = &li->stripe_events[next];
+    le->eventnum = 0;
+    for (int i = 0; i < li->num_stripes; i++)
+        le->eventnum += li->stripe_next_num[i];
+    le->timestamp = e->timestamp;
+    le->channellen = e->channellen;
+    le->datalen = e->datalen;
 
-    le->data = calloc(1, le->datalen+1);
-    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen) {
-        free(le->channel);
-        free(le->data);
-        free(le);
-        return NULL;
-        }
+    char *channel = le->channel;
+    void *data = le->data;
+    int32_t capacity = *channel_capacity;
+    le->channel = e->channel;
+    le->data = e->data;
+    *channel_capacity = li->stripe_capacities[2 * next];
+    e->channel = channel;
+    li->stripe_capacities[2 * next] = capacity;
+    capacity = *data_capacity;
+    *data_capacity = li->stripe_capacities[2 * next + 1];
+    e->data = data;
+    li->stripe_capacities[2 * next + 1] = capacity;
 
-    // Check that there's a valid event or the EOF after this event.
-    int32_t next_magic;
-    if (0 == fread32(l->f, &next_magic)) {
-        if (next_magic != MAGIC) {
-            fprintf(stderr, "Invalid header after log data\n");
-            free(le->channel);
-            free(le->data);
-            free(le);
+    li->stripe_ready[next] = -1;
+    li->stripe_next_num[next] = e->eventnum + 1;
+    return 0;
+}
+
+// The first magic number of an event in [p, end), or NULL.
+static const uint8_t *find_magic(const uint8_t *p, const uint8_t *end)
+{
+#if defined(EVENTLOG_SIMD_AVX2)
+    const __m256i m0 = _mm256_set1_epi8((char) 0xED);
+    const __m256i m1 = _mm256_set1_epi8((char) 0xA1);
+    const __m256i m2 = _mm256_set1_epi8((char) 0xDA);
+    const __m256i m3 = _mm256_set1_epi8((char) 0x01);
+    for (; end - p >= 32 + 3; p += 32) {
+        __m256i eq = _mm256_and_si256(_mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *) p), m0),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *) (p + 1)), m1)),
+                _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *) (p + 2)), m2),
+                    _mm256_cmpeq_epi8(_mm256_loadu_si256(
+                            (const __m256i *) (p + 3)), m3)));
+        uint32_t mask = (uint32_t) _mm256_movemask_epi8(eq);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(EVENTLOG_SIMD_SSE2)
+    const __m128i m0 = _mm_set1_epi8((char) 0xED);
+    const __m128i m1 = _mm_set1_epi8((char) 0xA1);
+    const __m128i m2 = _mm_set1_epi8((char) 0xDA);
+    const __m128i m3 = _mm_set1_epi8((char) 0x01);
+    for (; end - p >= 16 + 3; p += 16) {
+        __m128i eq = _mm_and_si128(_mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p), m0),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *) (p + 1)), m1)),
+                _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *) (p + 2)), m2),
+                    _mm_cmpeq_epi8(_mm_loadu_si128(
+                            (const __m128i *) (p + 3)), m3)));
+        int mask = _mm_movemask_epi8(eq);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    while (end - p >= 4) {
+        p = (const uint8_t *) memchr(p, 0xED, end - p - 3);
+        if (!p)
             return NULL;
-        }
-        fseeko (l->f, -4, SEEK_CUR);
+        if (p[1] == 0xA1 && p[2] == 0xDA && p[3] == 0x01)
+            return p;
+        p++;
     }
-    return le;
+    return NULL;
 }
 
-int lcm_eventlog_write_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+// Whether hdr, which starts with the magic number, has lengths that an
+// event can have.
+static int header_plausible(const uint8_t *hdr)
 {
-    if (0 != fwrite32(l->f, MAGIC)) return -1;
+    int32_t channellen = decode32(hdr + 20);
+    int32_t datalen = decode32(hdr + 24);
+    return channellen > 0 && channellen < MAX_CHANNEL_LEN && datalen >= 0 &&
+        datalen != INT32_MAX;
+}
 
-    le->eventnum = l->eventcount;
+// The offset of the first plausible event header at or after offset, or -1
+// if there is none.
+static int64_t find_header(FILE *f, int64_t offset)
+{
+    uint8_t *buf = (uint8_t *) malloc(RESYNC_CHUNK_SIZE);
+    int64_t found = -1;
+    while (found < 0 && 0 == fseeko(f, offset, SEEK_SET)) {
+        size_t n = fread(buf, 1, RESYNC_CHUNK_SIZE, f);
+        if (n < HEADER_SIZE)
+            break;
+        // only whole headers are looked at, the rest is searched again
+        const uint8_t *end = buf + n - HEADER_SIZE + 4;
+        for (const uint8_t *p = find_magic(buf, end); p;
+                p = find_magic(p + 1, end)) {
+            if (header_plausible(p)) {
+                found = offset + (p - buf);
+                break;
+            }
+        }
+        if (n < RESYNC_CHUNK_SIZE)
+            break;
+        offset += n - HEADER_SIZE + 1;
+    }
+    free(buf);
+    return found;
+}
 
-    if (0 != fwrite64(l->f, le->eventnum)) return -1;
-    if (0 != fwrite64(l->f, le->timestamp)) return -1;
-    if (0 != fwrite32(l->f, le->channellen)) return -1;
-    if (0 != fwrite32(l->f, le->datalen)) return -1;
+// Reads an event header into hdr, starting at the next magic number.
+// Returns 0 on success, or -1 at the end of the file.
+static int read_header(lcm_eventlog_t *l, uint8_t *hdr)
+{
+    eventlog_impl_t *li = impl(l);
+    int have = 0;
+    if (li->next_header_offset >= 0 && ftello(l->f) == li->next_header_offset) {
+        // the previous read already checked the magic number
+        int32_t magic = htonl(MAGIC);
+        memcpy(hdr, &magic, 4);
+        have = 4;
+    }
+    li->next_header_offset = -1;
 
-    if (le->channellen != fwrite(le->channel, 1, le->channellen, l->f)) 
+    if (fread(hdr + have, 1, HEADER_SIZE - have, l->f) !=
+            (size_t) (HEADER_SIZE - have))
         return -1;
-    if (le->datalen != fwrite(le->data, 1, le->datalen, l->f))
-        return -1;
-
-    l->eventcount++;
+    if (decode32(hdr) == MAGIC)
+        return 0;
 
+    // Corrupt data.  Look for the next header that is plausible, from the
+    // byte after the one that was expected.
+    int64_t offset = find_header(l->f, ftello(l->f) - HEADER_SIZE + 1);
+    if (offset < 0 || 0 != fseeko(l->f, offset, SEEK_SET) ||
+            fread(hdr, 1, HEADER_SIZE, l->f) != HEADER_SIZE)
+        return -1;
     return 0;
 }
 
-void lcm_eventlog_free_event(lcm_eventlog_event_t *le)
+// Makes *buf at least size bytes, keeping *capacity up to date.  Returns 0
+// on success.
+static int grow_buffer(void **buf, int32_t *capacity, int32_t size)
 {
-    if (le->data) free(le->data);
-    if (le->channel) free(le->channel);
-    memset(le,0,sizeof(lcm_eventlog_event_t));
-    free(le);
+    if (*buf && *capacity >= size)
+        return 0;
+    void *grown = realloc(*buf, size);
+    if (!grown) {
+        fprintf(stderr, "Unable to allocate %d bytes for a log event\n", size);
+        return -1;
+    }
+    *buf = grown;
+    *capacity = size;
+    return 0;
 }
 
+static int channel_matches(eventlog_impl_t *li, const char *channel)
+{
+    gpointer cached = g_hash_table_lookup(li->filter_matches, channel);
+    if (cached)
+        return GPOINTER_TO_INT(cached) - 1;
+    int matches = lcm_channel_pattern_match(li->filter, channel) ? 1 : 0;
+    g_hash_table_insert(li->filter_matches, g_strdup(channel),
+            GINT_TO_POINTER(matches + 1));
+    return matches;
+}
 
+// Whether the block of index entry i may have events that pass the filter.
+static int block_matches(eventlog_impl_t *li, int64_t i)
+{
+    index_entry_t *entry = &li->index[i];
+    if (entry->matches >= 0)
+        return entry->matches;
+    entry->matches = !entry->channels;
+    for (int32_t w = 0; w < entry->channel_words && !entry->matches; w++) {
+        uint32_t word = (uint32_t) decode32(entry->channels + 4 * w);
+        for (int b = 0; word; b++, word >>= 1) {
+            if (!(word & 1))
+                continue;
+            guint id = w * 32 + b;
+            if (id >= li->index_channels->len || channel_matches(li,
+                        (const char *) g_ptr_array_index(li->index_channels,
+                            id))) {
+                entry->matches = 1;
+                break;
+            }
+        }
+    }
+    return entry->matches;
+}
 
-static int64_t get_event_time(lcm_eventlog_t *l)
+// The last index entry at or before offset, or -1.
+static int64_t find_block(eventlog_impl_t *li, int64_t offset)
 {
-    uint32_t magic = 0;
-    int r;
+    int64_t hint = li->filter_block;
+    if (hint < li->index_len && li->index[hint].offset <= offset &&
+            (hint + 1 == li->index_len || offset < li->index[hint + 1].offset))
+        return hint;
+    if (offset < li->index[0].offset)
+        return -1;
+    int64_t lo = 0, hi = li->index_len;
+    while (hi - lo > 1) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (li->index[mid].offset <= offset)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    li->filter_block = lo;
+    return lo;
+}
 
-    do {
-        r = fgetc(l->f);
-        if (r < 0) goto eof;
-        magic = (magic << 8) | (uint32_t) r;
-    } while( magic != MAGIC );
+// Moves a filtered reader past any blocks without matching channels.
+static void skip_unmatched_blocks(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    int64_t i = find_block(li, ftello(l->f));
+    if (i < 0 || block_matches(li, i))
+        return;
+    while (++i < li->index_len && !block_matches(li, i)) {
+    }
+    if (i < li->index_len)
+        fseeko(l->f, li->index[i].offset, SEEK_SET);
+    else
+        fseeko(l->f, 0, SEEK_END);
+    li->next_header_offset = -1;
+}
 
-    int64_t event_num;
-    int64_t timestamp;
-    if (0 != fread64(l->f, &event_num)) return -1;
-    if (0 != fread64(l->f, &timestamp)) return -1;
-    fseeko (l->f, -20, SEEK_CUR);
+// Decompresses stored_size bytes of li->stored into li->block.  Returns 0
+// on success.
+static int decompress_block(eventlog_impl_t *li, int32_t codec,
+        int32_t stored_size, int32_t raw_size)
+{
+    if (0 != grow_buffer((void **) &li->block, &li->block_capacity,
+                raw_size + 1))
+        return -1;
+    switch (codec) {
+    case BLOCK_CODEC_NONE:
+        if (stored_size != raw_size)
+            return -1;
+        memcpy(li->block, li->stored, raw_size);
+        return 0;
+#ifdef LCM_HAVE_LZ4
+    case BLOCK_CODEC_LZ4:
+        return LZ4_decompress_safe((const char *) li->stored,
+                (char *) li->block, stored_size, raw_size) == raw_size ?
+            0 : -1;
+#endif
+#ifdef LCM_HAVE_ZLIB
+    case BLOCK_CODEC_ZLIB: {
+        uLongf size = raw_size;
+        return uncompress((Bytef *) li->block, &size,
+                (const Bytef *) li->stored, stored_size) == Z_OK &&
+            size == (uLongf) raw_size ? 0 : -1;
+    }
+#endif
+    default:
+        fprintf(stderr, "Log block uses unsupported codec %d\n", codec);
+        return -1;
+    }
+}
 
-    l->eventcount = event_num;
+// Reads the block that starts at the file position.  Returns 0 on success,
+// or -1 at the end of the blocks.
+static int load_block(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    uint8_t hdr[BLOCK_HEADER_SIZE];
+    li->block_len = li->block_pos = 0;
+    if (fread(hdr, 1, BLOCK_HEADER_SIZE, l->f) != BLOCK_HEADER_SIZE ||
+            decode32(hdr) != BLOCK_MAGIC) {
+        li->next_block_offset = ftello(l->f);
+        return -1;
+    }
+    int32_t codec = decode32(hdr + 4);
+    int32_t stored_size = decode32(hdr + 8);
+    int32_t raw_size = decode32(hdr + 12);
+    int ok = stored_size >= 0 && raw_size >= 0 && raw_size < INT32_MAX &&
+        0 == grow_buffer((void **) &li->stored, &li->stored_capacity,
+                stored_size + 1) &&
+        fread(li->stored, 1, stored_size, l->f) == (size_t) stored_size &&
+        0 == decompress_block(li, codec, stored_size, raw_size);
+    li->next_block_offset = ftello(l->f);
+    if (!ok) {
+        fprintf(stderr, "Invalid block in compressed log\n");
+        return -1;
+    }
+    li->block_len = raw_size;
+    return 0;
+}
 
-    return timestamp;
+// Finds the blocks of a compressed log, from its footer or by scanning the
+// block headers that were not scanned yet.
+static GArray *load_blocks(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->blocks && li->blocks_complete)
+        return li->blocks;
+    if (!li->blocks) {
+        li->blocks = g_array_new(FALSE, FALSE, sizeof(block_entry_t));
+        uint8_t trailer[FOOTER_TRAILER_SIZE];
+        fseeko(l->f, 0, SEEK_END);
+        int64_t file_len = ftello(l->f);
+        if (file_len >= FOOTER_TRAILER_SIZE + 8 &&
+                0 == fseeko(l->f, -FOOTER_TRAILER_SIZE, SEEK_END) &&
+                fread(trailer, 1, FOOTER_TRAILER_SIZE, l->f) ==
+                FOOTER_TRAILER_SIZE && decode32(trailer + 8) == FOOTER_MAGIC) {
+            int64_t footer_offset = decode64(trailer);
+            uint8_t hdr[8];
+            if (footer_offset >= 0 && 0 == fseeko(l->f, footer_offset,
+                        SEEK_SET) && fread(hdr, 1, 8, l->f) == 8 &&
+                    decode32(hdr) == FOOTER_MAGIC && footer_offset + 8 +
+                    (int64_t) decode32(hdr + 4) * FOOTER_ENTRY_SIZE +
+                    FOOTER_TRAILER_SIZE == file_len) {
+                int32_t n = decode32(hdr + 4);
+                uint8_t entry[FOOTER_ENTRY_SIZE];
+                for (int32_t i = 0; i < n && fread(entry, 1,
+                            FOOTER_ENTRY_SIZE, l->f) == FOOTER_ENTRY_SIZE;
+                        i++) {
+                    block_entry_t b = { decode64(entry), decode64(entry + 8),
+                        decode64(entry + 16) };
+                    g_array_append_val(li->blocks, b);
+                }
+                if (li->blocks->len == (guint) n) {
+                    li->blocks_complete = 1;
+                    return li->blocks;
+                }
+                g_array_set_size(li->blocks, 0);
+            }
+        }
+    }
 
-eof:
-    return -1;
+    // no footer, e.g. because the log is still being written
+    uint8_t hdr[BLOCK_HEADER_SIZE];
+    int64_t offset = li->blocks_scanned_to;
+    while (0 == fseeko(l->f, offset, SEEK_SET) &&
+            fread(hdr, 1, BLOCK_HEADER_SIZE, l->f) == BLOCK_HEADER_SIZE &&
+            decode32(hdr) == BLOCK_MAGIC && decode32(hdr + 8) >= 0) {
+        int64_t next = offset + BLOCK_HEADER_SIZE + decode32(hdr + 8);
+        fseeko(l->f, 0, SEEK_END);
+        if (ftello(l->f) < next)
+            break;  // partly written
+        block_entry_t b = { offset, decode64(hdr + 16), decode64(hdr + 24) };
+        g_array_append_val(li->blocks, b);
+        offset = next;
+    }
+    li->blocks_scanned_to = offset;
+    return li->blocks;
 }
 
+// Positions a compressed log at block i, or at the end of the log.
+static int seek_block(lcm_eventlog_t *l, guint i)
+{
+    eventlog_impl_t *li = impl(l);
+    li->block_len = li->block_pos = 0;
+    if (i < li->blocks->len)
+        fseeko(l->f, g_array_index(li->blocks, block_entry_t, i).offset,
+                SEEK_SET);
+    else
+        fseeko(l->f, li->blocks_scanned_to, SEEK_SET);
+    li->next_block_offset = ftello(l->f);
+    return i < li->blocks->len ? load_block(l) : -1;
+}
 
-int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *l, int64_t timestamp)
+// The event at the read position of the current block, not yet consumed.
+// Returns a pointer to its header, or NULL if the block has no more events.
+static const uint8_t *block_event(eventlog_impl_t *li, int32_t *size)
 {
-    fseeko (l->f, 0, SEEK_END);
-    off_t file_len = ftello(l->f);
+    int32_t left = li->block_len - li->block_pos;
+    if (left <= 0)
+        return NULL;
+    const uint8_t *p = li->block + li->block_pos;
+    int32_t channellen = left >= HEADER_SIZE ? decode32(p + 20) : 0;
+    int32_t datalen = left >= HEADER_SIZE ? decode32(p + 24) : -1;
+    if (decode32(p) != MAGIC || channellen <= 0 ||
+            channellen >= MAX_CHANNEL_LEN || datalen < 0 ||
+            datalen > left - HEADER_SIZE - channellen) {
+        fprintf(stderr, "Invalid event in compressed log block\n");
+        li->block_pos = li->block_len;
+        return NULL;
+    }
+    *size = HEADER_SIZE + channellen + datalen;
+    return p;
+}
 
-    int64_t cur_time;
-    double frac1 = 0;               // left bracket
-    double frac2 = 1;               // right bracket
-    double prev_frac = -1;
-    double frac;                    // current position
+static int read_compressed_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le,
+        int32_t *channel_capacity, int32_t *data_capacity)
+{
+    eventlog_impl_t *li = impl(l);
+    if (ftello(l->f) != li->next_block_offset) {
+        // Moved by the caller, e.g. with fseeko() to an approximate
+        // position.  Continue with the first block that starts there or
+        // after.
+        int64_t offset = ftello(l->f);
+        GArray *blocks = load_blocks(l);
+        guint i = 0;
+        while (i < blocks->len &&
+                g_array_index(blocks, block_entry_t, i).offset < offset)
+            i++;
+        seek_block(l, i);
+    }
 
     while (1) {
-        frac = 0.5*(frac1+frac2);
-        off_t offset = (off_t)(frac*file_len);
-        fseeko (l->f, offset, SEEK_SET);
-        cur_time = get_event_time (l);
-        if (cur_time < 0)
+        int32_t size;
+        const uint8_t *p = block_event(li, &size);
+        if (!p) {
+            if (li->range_end >= 0 && ftello(l->f) >= li->range_end)
+                return -1;
+            if (0 != load_block(l))
+                return -1;
+            continue;
+        }
+        li->block_pos += size;
+
+        le->eventnum = decode64(p + 4);
+        le->timestamp = decode64(p + 12);
+        le->channellen = decode32(p + 20);
+        le->datalen = decode32(p + 24);
+        if (0 != grow_buffer((void **) &le->channel, channel_capacity,
+                    le->channellen + 1))
+            return -1;
+        memcpy(le->channel, p + HEADER_SIZE, le->channellen);
+        le->channel[le->channellen] = 0;
+        if (li->filter && !channel_matches(li, le->channel))
+            continue;
+        if (0 != grow_buffer(&le->data, data_capacity, le->datalen + 1))
             return -1;
+        memcpy(le->data, p + HEADER_SIZE + le->channellen, le->datalen);
+        ((char *) le->data)[le->datalen] = 0;
+        return 0;
+    }
+}
 
-        if ((frac > frac2) || (frac < frac1) || (frac1>=frac2))
-            break;
-    
-        double df = frac-prev_frac;
-        if (df < 0)
-            df = -df;
-        if (df < 1e-12)
-            break;
+int lcm_eventlog_read_next_event_into(lcm_eventlog_t *l,
+        lcm_eventlog_event_t *le, int32_t *channel_capacity,
+        int32_t *data_capacity)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->stripes)
+        return read_striped_event(l, le, channel_capacity, data_capacity);
+    if (li->compressed)
+        return read_compressed_event(l, le, channel_capacity, data_capacity);
 
-        if (cur_time == timestamp)
-            break;
+    uint8_t hdr[HEADER_SIZE];
+    while (1) {
+        if (li->filter && li->index_len)
+            skip_unmatched_blocks(l);
+        if (0 != read_header(l, hdr))
+            return -1;
+        if (li->range_end >= 0 &&
+                ftello(l->f) - HEADER_SIZE >= li->range_end) {
+            // the event belongs to the next range
+            fseeko(l->f, -HEADER_SIZE, SEEK_CUR);
+            li->next_header_offset = -1;
+            return -1;
+        }
 
-        if (cur_time < timestamp)
-            frac1 = frac;
-        else
-            frac2 = frac;
+        le->eventnum = decode64(hdr + 4);
+        le->timestamp = decode64(hdr + 12);
+        le->channellen = decode32(hdr + 20);
+        le->datalen = decode32(hdr + 24);
+
+        // Sanity check the channel length and data length
+        if (le->channellen <= 0 || le->channellen >= MAX_CHANNEL_LEN) {
+            fprintf(stderr, "Log event has invalid channel length: %d\n", le->channellen);
+            return -1;
+        }
+        if (le->datalen < 0 || le->datalen == INT32_MAX) {
+            fprintf(stderr, "Log event has invalid data length: %d\n", le->datalen);
+            return -1;
+        }
+
+        // both are NUL-terminated, as a convenience
+        if (0 != grow_buffer((void **) &le->channel, channel_capacity,
+                    le->channellen + 1))
+            return -1;
+        if (fread(le->channel, 1, le->channellen, l->f) != (size_t) le->channellen)
+            return -1;
+        le->channel[le->channellen] = 0;
+        if (!li->filter || channel_matches(li, le->channel))
+            break;
+        // the data of other channels is never read
+        if (0 != fseeko(l->f, le->datalen, SEEK_CUR))
+            return -1;
+    }
+
+    if (0 != grow_buffer(&le->data, data_capacity, le->datalen + 1))
+        return -1;
+    if (fread(le->data, 1, le->datalen, l->f) != (size_t) le->datalen)
+        return -1;
+    ((char *) le->data)[le->datalen] = 0;
+
+    // Check that there's a valid event or the EOF after this event.  The
+    // magic number is not read again for the next event.
+    int32_t next_magic;
+    if (0 == fread32(l->f, &next_magic)) {
+        if (next_magic != MAGIC) {
+            fprintf(stderr, "Invalid header after log data\n");
+            return -1;
+        }
+        li->next_header_offset = ftello(l->f);
+    }
+    return 0;
+}
+
+lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *l)
+{
+    lcm_eventlog_event_t *le =
+        (lcm_eventlog_event_t*) calloc(1, sizeof(lcm_eventlog_event_t));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    if (0 != lcm_eventlog_read_next_event_into(l, le, &channel_capacity,
+                &data_capacity)) {
+        free(le->channel);
+        free(le->data);
+        free(le);
+        return NULL;
+    }
+    return le;
+}
+
+// Appends to the index that is being written.  If that fails, the log goes
+// on without an index.  Returns 0 on success.
+static int index_write(eventlog_impl_t *li, const uint8_t *buf, size_t len)
+{
+    if (!li->index_f)
+        return -1;
+    if (fwrite(buf, 1, len, li->index_f) == len)
+        return 0;
+    fclose(li->index_f);
+    li->index_f = NULL;
+    return -1;
+}
+
+// Writes the channels of the current block, if there is one.
+static void index_end_block(eventlog_impl_t *li)
+{
+    if (!li->block_channels)
+        return;
+    int32_t words = li->block_channel_words;
+    uint8_t *rec = (uint8_t *) malloc(8 + 4 * words);
+    int n = write_be32(rec, INDEX_BLOCK_CHANNELS);
+    n += write_be32(rec + n, words);
+    for (int32_t w = 0; w < words; w++)
+        n += write_be32(rec + n, (int32_t) li->block_channels[w]);
+    index_write(li, rec, n);
+    free(rec);
+    free(li->block_channels);
+    li->block_channels = NULL;
+    li->block_channel_words = 0;
+    if (!li->index_stats)
+        return;
+
+    int32_t num = 0;
+    for (guint id = 0; id < li->block_stats_len; id++)
+        num += li->block_stats[id].count > 0;
+    rec = (uint8_t *) malloc(INDEX_STATS_HEADER_SIZE +
+            INDEX_STATS_ENTRY_SIZE * (size_t) num);
+    n = write_be32(rec, INDEX_BLOCK_STATS);
+    n += write_be64(rec + n, li->block_end);
+    n += write_be32(rec + n, num);
+    for (guint id = 0; id < li->block_stats_len; id++) {
+        const block_stats_t *bs = &li->block_stats[id];
+        if (!bs->count)
+            continue;
+        n += write_be32(rec + n, (int32_t) id);
+        n += write_be32(rec + n, bs->count);
+        n += write_be64(rec + n, bs->bytes);
+        n += write_be64(rec + n, bs->first_timestamp);
+        n += write_be64(rec + n, bs->last_timestamp);
+        n += write_be64(rec + n, bs->max_gap);
+    }
+    index_write(li, rec, n);
+    free(rec);
+    memset(li->block_stats, 0, li->block_stats_len * sizeof(block_stats_t));
+}
+
+// Records an event that is about to be logged at offset.
+static void index_add_event(eventlog_impl_t *li, int64_t eventnum,
+        int64_t timestamp, int64_t offset, const char *channel,
+        int32_t channellen, int32_t datalen)
+{
+    if (li->events_since_index >= INDEX_INTERVAL_EVENTS ||
+            li->bytes_since_index >= INDEX_INTERVAL_BYTES) {
+        index_end_block(li);
+        uint8_t rec[28];
+        int n = write_be32(rec, INDEX_EVENT);
+        n += write_be64(rec + n, eventnum);
+        n += write_be64(rec + n, timestamp);
+        n += write_be64(rec + n, offset);
+        if (0 != index_write(li, rec, n))
+            return;
+        li->block_channels = (uint32_t *) calloc(1, sizeof(uint32_t));
+        li->block_channel_words = 1;
+        li->bytes_since_index = 0;
+        li->events_since_index = 0;
+    }
+    li->events_since_index++;
+    li->bytes_since_index += HEADER_SIZE + channellen + datalen;
+    li->block_end = offset + HEADER_SIZE + channellen + datalen;
+
+    // Events that readers reject are not worth a channel
+    if (channellen <= 0 || channellen >= MAX_CHANNEL_LEN)
+        return;
+    char name[MAX_CHANNEL_LEN];
+    memcpy(name, channel, channellen);
+    name[channellen] = 0;
+    guint id = GPOINTER_TO_UINT(g_hash_table_lookup(li->index_channel_ids,
+                name));
+    if (id) {
+        id--;
+    } else {
+        id = g_hash_table_size(li->index_channel_ids);
+        g_hash_table_insert(li->index_channel_ids, g_strdup(name),
+                GUINT_TO_POINTER(id + 1));
+        uint8_t rec[8 + MAX_CHANNEL_LEN];
+        int n = write_be32(rec, INDEX_CHANNEL);
+        n += write_be32(rec + n, channellen);
+        memcpy(rec + n, channel, channellen);
+        if (0 != index_write(li, rec, n + channellen))
+            return;
+    }
+    int32_t word = id / 32;
+    if (word >= li->block_channel_words) {
+        li->block_channels = (uint32_t *) realloc(li->block_channels,
+                (word + 1) * sizeof(uint32_t));
+        memset(li->block_channels + li->block_channel_words, 0,
+                (word + 1 - li->block_channel_words) * sizeof(uint32_t));
+        li->block_channel_words = word + 1;
+    }
+    li->block_channels[word] |= 1u << (id % 32);
+
+    if (!li->index_stats)
+        return;
+    if (id >= li->block_stats_len) {
+        guint len = MAX(id + 1, 2 * li->block_stats_len);
+        li->block_stats = (block_stats_t *) realloc(li->block_stats,
+                len * sizeof(block_stats_t));
+        memset(li->block_stats + li->block_stats_len, 0,
+                (len - li->block_stats_len) * sizeof(block_stats_t));
+        li->block_stats_len = len;
+    }
+    block_stats_t *bs = &li->block_stats[id];
+    if (bs->count == 0)
+        bs->first_timestamp = timestamp;
+    else if (timestamp - bs->last_timestamp > bs->max_gap)
+        bs->max_gap = timestamp - bs->last_timestamp;
+    bs->last_timestamp = timestamp;
+    bs->count++;
+    bs->bytes += datalen;
+}
+
+// Compresses li->block into li->stored.  Returns the codec used, which is
+// BLOCK_CODEC_NONE if the data did not compress, and sets *stored_size.
+static int compress_block(eventlog_impl_t *li, int32_t *stored_size)
+{
+    int32_t len = li->block_len;
+    // anything that does not shrink is stored as it is
+    int32_t capacity = len;
+    int size = -1;
+    if (0 != grow_buffer((void **) &li->stored, &li->stored_capacity,
+                capacity + 1))
+        return -1;
+    switch (li->codec) {
+#ifdef LCM_HAVE_LZ4
+    case BLOCK_CODEC_LZ4:
+        size = LZ4_compress_default((const char *) li->block,
+                (char *) li->stored, len, capacity);
+        if (size <= 0)
+            size = -1;
+        break;
+#endif
+#ifdef LCM_HAVE_ZLIB
+    case BLOCK_CODEC_ZLIB: {
+        // level 1 keeps up with a logger, and most of the gain is there
+        uLongf zsize = capacity;
+        if (compress2((Bytef *) li->stored, &zsize,
+                    (const Bytef *) li->block, len, 1) == Z_OK)
+            size = zsize;
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    if (size < 0 || size >= len) {
+        memcpy(li->stored, li->block, len);
+        *stored_size = len;
+        return BLOCK_CODEC_NONE;
+    }
+    *stored_size = size;
+    return li->codec;
+}
+
+// Writes out the events of the current block, if any.  Returns 0 on
+// success.
+static int flush_block(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    if (!li->block_len)
+        return 0;
+    int32_t stored_size = 0;
+    int codec = compress_block(li, &stored_size);
+    if (codec < 0)
+        return -1;
+
+    block_entry_t b;
+    b.offset = log_offset(l);
+    b.eventnum = decode64(li->block + 4);
+    b.timestamp = decode64(li->block + 12);
+    uint8_t hdr[BLOCK_HEADER_SIZE];
+    int n = write_be32(hdr, BLOCK_MAGIC);
+    n += write_be32(hdr + n, codec);
+    n += write_be32(hdr + n, stored_size);
+    n += write_be32(hdr + n, li->block_len);
+    n += write_be64(hdr + n, b.eventnum);
+    write_be64(hdr + n, b.timestamp);
+    li->block_len = 0;
+    out_part_t parts[2] = { { hdr, BLOCK_HEADER_SIZE },
+        { li->stored, (size_t) stored_size } };
+    if (0 != log_output(l, parts, 2))
+        return -1;
+    g_array_append_val(li->blocks, b);
+    return 0;
+}
+
+static void write_footer(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    guint n = li->blocks->len;
+    size_t size = 8 + (size_t) n * FOOTER_ENTRY_SIZE + FOOTER_TRAILER_SIZE;
+    uint8_t *footer = (uint8_t *) malloc(size);
+    int64_t footer_offset = log_offset(l);
+    uint8_t *p = footer;
+    p += write_be32(p, FOOTER_MAGIC);
+    p += write_be32(p, n);
+    for (guint i = 0; i < n; i++) {
+        block_entry_t *b = &g_array_index(li->blocks, block_entry_t, i);
+        p += write_be64(p, b->offset);
+        p += write_be64(p, b->eventnum);
+        p += write_be64(p, b->timestamp);
+    }
+    p += write_be64(p, footer_offset);
+    write_be32(p, FOOTER_MAGIC);
+    out_part_t part = { footer, size };
+    log_output(l, &part, 1);
+    free(footer);
+}
+
+static int write_compressed_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
+    eventlog_impl_t *li = impl(l);
+    int64_t size = (int64_t) HEADER_SIZE + le->channellen + le->datalen;
+    if (le->channellen < 0 || le->datalen < 0 ||
+            li->block_len + size >= INT32_MAX)
+        return -1;
+    if (0 != grow_buffer((void **) &li->block, &li->block_capacity,
+                li->block_len + size))
+        return -1;
+
+    le->eventnum = l->eventcount;
+    uint8_t *p = li->block + li->block_len;
+    int n = write_be32(p, MAGIC);
+    n += write_be64(p + n, le->eventnum);
+    n += write_be64(p + n, le->timestamp);
+    n += write_be32(p + n, le->channellen);
+    n += write_be32(p + n, le->datalen);
+    memcpy(p + n, le->channel, le->channellen);
+    memcpy(p + n + le->channellen, le->data, le->datalen);
+    li->block_len += size;
+    l->eventcount++;
+
+    if (li->block_len >= BLOCK_SIZE)
+        return flush_block(l);
+    return 0;
+}
+
+static int async_enqueue(lcm_eventlog_t *l, lcm_eventlog_event_t *le);
+
+static int write_event_now(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->compressed)
+        return write_compressed_event(l, le);
+
+    // a failure to index is not a failure to log
+    if (li->index_f)
+        index_add_event(li, l->eventcount, le->timestamp, log_offset(l),
+                le->channel, le->channellen, le->datalen);
+
+    le->eventnum = l->eventcount;
+
+    // the header is assembled here, and written along with the event
+    uint8_t hdr[HEADER_SIZE];
+    int n = write_be32(hdr, MAGIC);
+    n += write_be64(hdr + n, le->eventnum);
+    n += write_be64(hdr + n, le->timestamp);
+    n += write_be32(hdr + n, le->channellen);
+    write_be32(hdr + n, le->datalen);
+    out_part_t parts[3] = { { hdr, HEADER_SIZE },
+        { le->channel, (size_t) le->channellen },
+        { le->data, (size_t) le->datalen } };
+    if (0 != log_output(l, parts, 3))
+        return -1;
+
+    l->eventcount++;
+
+    return 0;
+}
+
+int lcm_eventlog_write_event(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
+    if (impl(l)->async_thread)
+        return async_enqueue(l, le);
+    return write_event_now(l, le);
+}
+
+int lcm_eventlog_set_compression(lcm_eventlog_t *l, const char *codec)
+{
+    eventlog_impl_t *li = impl(l);
+    int id;
+    if (!strcmp(codec, "lz4")) {
+        id = BLOCK_CODEC_LZ4;
+    } else if (!strcmp(codec, "zlib")) {
+        id = BLOCK_CODEC_ZLIB;
+    } else {
+        fprintf(stderr, "Unknown log compression \"%s\"\n", codec);
+        return -1;
+    }
+#ifndef LCM_HAVE_LZ4
+    if (id == BLOCK_CODEC_LZ4) {
+        fprintf(stderr, "LCM was built without lz4 support\n");
+        return -1;
+    }
+#endif
+#ifndef LCM_HAVE_ZLIB
+    if (id == BLOCK_CODEC_ZLIB) {
+        fprintf(stderr, "LCM was built without zlib support\n");
+        return -1;
+    }
+#endif
+    // only a new, empty log can be compressed
+    if (li->compressed || log_size(l) != 0 || li->index_f) {
+        fprintf(stderr, "Only new logs can be compressed\n");
+        return -1;
+    }
+    li->compressed = 1;
+    li->codec = id;
+    li->blocks = g_array_new(FALSE, FALSE, sizeof(block_entry_t));
+    return 0;
+}
+
+static int flush_now(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    int status = 0;
+    if (li->compressed && li->codec)
+        status = flush_block(l);
+    if (li->fd >= 0 && 0 != writer_drain(li, 1))
+        status = -1;
+    if (0 != fflush(l->f))
+        status = -1;
+    // After the log, so that the index never points past what is on disk.
+    // The log goes on without it if it can not be written.
+    if (li->index_f && 0 != fflush(li->index_f)) {
+        fclose(li->index_f);
+        li->index_f = NULL;
+    }
+    return status;
+}
+
+static int async_wait_written(eventlog_impl_t *li);
+
+int lcm_eventlog_flush(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->async_thread)
+        return async_wait_written(li);
+    return flush_now(l);
+}
+
+int lcm_eventlog_set_write_flags(lcm_eventlog_t *l, int flags)
+{
+    eventlog_impl_t *li = impl(l);
+#ifndef WIN32
+    if (li->reading || li->fd >= 0 ||
+            (flags & ~(LCM_EVENTLOG_WRITEV | LCM_EVENTLOG_DIRECT)))
+        return -1;
+    if (!flags)
+        return 0;
+    // buffered events are written first
+    if (li->compressed && 0 != flush_block(l))
+        return -1;
+    if (0 != fflush(l->f))
+        return -1;
+    int fd = fileno(l->f);
+    int64_t size = lseek(fd, 0, SEEK_END);
+    void *wbuf = NULL;
+    if (size < 0 || 0 != posix_memalign(&wbuf, WRITE_ALIGN, WRITE_BUF_SIZE))
+        return -1;
+    li->wbuf_offset = size;
+    li->wbuf_len = 0;
+
+    if (flags & LCM_EVENTLOG_DIRECT) {
+#ifndef O_DIRECT
+        fprintf(stderr, "Direct I/O is not supported on this platform\n");
+        free(wbuf);
+        return -1;
+#else
+        // A descriptor of our own, without O_APPEND, on which the partial
+        // block at the end is read back and then rewritten.
+        fd = open(li->path, O_RDWR);
+        li->wbuf_offset = size & ~(int64_t) (WRITE_ALIGN - 1);
+        li->wbuf_len = size - li->wbuf_offset;
+        if (fd < 0 || (li->wbuf_len && pread(fd, wbuf, li->wbuf_len,
+                        li->wbuf_offset) != (ssize_t) li->wbuf_len) ||
+                0 != fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT)) {
+            fprintf(stderr, "Unable to open %s for direct I/O: %s\n",
+                    li->path, strerror(errno));
+            if (fd >= 0)
+                close(fd);
+            free(wbuf);
+            li->wbuf_len = 0;
+            return -1;
+        }
+        li->own_fd = 1;
+        li->direct = 1;
+#endif
+    }
+    li->fd = fd;
+    li->wbuf = (uint8_t *) wbuf;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+// Starts writing an index to ipath, or continues one in append mode.
+static int open_index(eventlog_impl_t *li, const char *ipath,
+        const char *mode)
+{
+    li->index_f = fopen(ipath, mode);
+    if (!li->index_f)
+        return -1;
+    li->index_channel_ids = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+    // the next event starts a block
+    li->events_since_index = INDEX_INTERVAL_EVENTS;
+    li->index_stats = 1;
+    fseeko(li->index_f, 0, SEEK_END);
+    if (ftello(li->index_f) > 0) {
+        // an older index is continued as it is
+        li->index_stats = li->index_version >= 3;
+        // channels keep their numbers
+        for (guint i = 0; li->index_channels && i < li->index_channels->len;
+                i++)
+            g_hash_table_insert(li->index_channel_ids,
+                    g_strdup((const char *) g_ptr_array_index(
+                            li->index_channels, i)),
+                    GUINT_TO_POINTER(i + 1));
+        return 0;
+    }
+    uint8_t hdr[8];
+    int n = write_be32(hdr, INDEX_MAGIC);
+    n += write_be32(hdr + n, INDEX_VERSION);
+    return index_write(li, hdr, n);
+}
+
+static int64_t load_index(eventlog_impl_t *li);
+
+int lcm_eventlog_enable_index(lcm_eventlog_t *l)
+{
+    eventlog_impl_t *li = impl(l);
+    // compressed logs index their blocks themselves
+    if (li->index_f || li->compressed)
+        return 0;
+    char *ipath = index_path(li->path);
+    // When appending, an index that does not cover the start of the log is
+    // ignored by readers, until lcm_eventlog_build_index() replaces it.
+    // One that cannot be read is started over.
+    int appending = log_size(l) > 0 && load_index(li) > 0;
+    int status = open_index(li, ipath, appending ? "ab" : "wb");
+    free_index(li);
+    free(ipath);
+    return status;
+}
+
+int lcm_eventlog_build_index(const char *path)
+{
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l)
+        return -1;
+    eventlog_impl_t *li = impl(l);
+    if (li->compressed) {
+        lcm_eventlog_destroy(l);
+        return 0;
+    }
+
+    char *ipath = index_path(path);
+    char *tmp_path = (char *) malloc(strlen(ipath) + 5);
+    strcpy(tmp_path, ipath);
+    strcat(tmp_path, ".tmp");
+    int status = open_index(li, tmp_path, "wb");
+
+    uint8_t hdr[HEADER_SIZE];
+    char channel[MAX_CHANNEL_LEN];
+    while (status == 0 && 0 == read_header(l, hdr)) {
+        int64_t offset = ftello(l->f) - HEADER_SIZE;
+        int32_t channellen = decode32(hdr + 20);
+        int32_t datalen = decode32(hdr + 24);
+        if (channellen <= 0 || channellen >= MAX_CHANNEL_LEN || datalen < 0 ||
+                fread(channel, 1, channellen, l->f) != (size_t) channellen) {
+            // resynchronize just past this magic number
+            fseeko(l->f, offset + 4, SEEK_SET);
+            continue;
+        }
+        index_add_event(li, decode64(hdr + 4), decode64(hdr + 12), offset,
+                channel, channellen, datalen);
+        if (!li->index_f)
+            status = -1;
+        fseeko(l->f, datalen, SEEK_CUR);
+    }
+
+    if (li->index_f) {
+        index_end_block(li);
+        if (!li->index_f || 0 != fclose(li->index_f))
+            status = -1;
+        li->index_f = NULL;
+    }
+    if (status == 0) {
+        remove(ipath);
+        if (0 != rename(tmp_path, ipath))
+            status = -1;
+    }
+    if (status != 0)
+        remove(tmp_path);
+    free(tmp_path);
+    free(ipath);
+    lcm_eventlog_destroy(l);
+    return status;
+}
+
+void lcm_eventlog_free_event(lcm_eventlog_event_t *le)
+{
+    if (le->data) free(le->data);
+    if (le->channel) free(le->channel);
+    memset(le,0,sizeof(lcm_eventlog_event_t));
+    free(le);
+}
+
+
+
+static int64_t get_event_time(lcm_eventlog_t *l)
+{
+    // the header is read whole, since the caller just moved the file
+    uint8_t hdr[HEADER_SIZE];
+    impl(l)->next_header_offset = -1;
+    if (0 != read_header(l, hdr))
+        return -1;
+    fseeko (l->f, -HEADER_SIZE, SEEK_CUR);
+
+    l->eventcount = decode64(hdr + 4);
+
+    return decode64(hdr + 12);
+}
+
+// Parses an index.  A partly written last record is left out.
+static void parse_index(eventlog_impl_t *li, const uint8_t *p,
+        const uint8_t *end)
+{
+    int64_t capacity = 0;
+    while (end - p >= 8) {
+        int32_t type = decode32(p);
+        if (type == INDEX_EVENT) {
+            if (end - p < 28)
+                break;
+            if (li->index_len == capacity) {
+                capacity = capacity ? 2 * capacity : 1024;
+                li->index = (index_entry_t *) realloc(li->index,
+                        capacity * sizeof(index_entry_t));
+            }
+            index_entry_t *entry = &li->index[li->index_len++];
+            entry->eventnum = decode64(p + 4);
+            entry->timestamp = decode64(p + 12);
+            entry->offset = decode64(p + 20);
+            entry->channels = NULL;
+            entry->channel_words = 0;
+            entry->matches = -1;
+            entry->stats = NULL;
+            entry->num_stats = 0;
+            entry->end_offset = -1;
+            p += 28;
+        } else if (type == INDEX_CHANNEL) {
+            int32_t len = decode32(p + 4);
+            if (len <= 0 || len >= MAX_CHANNEL_LEN || end - p - 8 < len)
+                break;
+            g_ptr_array_add(li->index_channels,
+                    g_strndup((const char *) p + 8, len));
+            p += 8 + len;
+        } else if (type == INDEX_BLOCK_CHANNELS) {
+            int32_t words = decode32(p + 4);
+            if (words < 0 || (end - p - 8) / 4 < words)
+                break;
+            if (li->index_len) {
+                li->index[li->index_len - 1].channels = p + 8;
+                li->index[li->index_len - 1].channel_words = words;
+            }
+            p += 8 + 4 * (int64_t) words;
+        } else if (type == INDEX_BLOCK_STATS) {
+            if (end - p < INDEX_STATS_HEADER_SIZE)
+                break;
+            int32_t num = decode32(p + 12);
+            if (num < 0 || (end - p - INDEX_STATS_HEADER_SIZE) /
+                    INDEX_STATS_ENTRY_SIZE < num)
+                break;
+            if (li->index_len) {
+                index_entry_t *entry = &li->index[li->index_len - 1];
+                entry->end_offset = decode64(p + 4);
+                entry->stats = p + INDEX_STATS_HEADER_SIZE;
+                entry->num_stats = num;
+            }
+            p += INDEX_STATS_HEADER_SIZE +
+                INDEX_STATS_ENTRY_SIZE * (int64_t) num;
+        } else {
+            break;
+        }
+    }
+}
+
+// Loads the sidecar index if there is one, or reloads it if it has grown.
+// Returns the number of blocks.
+static int64_t load_index(eventlog_impl_t *li)
+{
+    char *ipath = index_path(li->path);
+    FILE *f = fopen(ipath, "rb");
+    free(ipath);
+    if (!f)
+        return 0;
+    fseeko(f, 0, SEEK_END);
+    int64_t size = ftello(f);
+    if (size == li->index_file_size) {
+        fclose(f);
+        return li->index_len;
+    }
+
+    free_index(li);
+    li->index_file_size = size;
+    li->index_channels = g_ptr_array_new_with_free_func(g_free);
+    li->filter_block = 0;
+
+    li->index_raw = (uint8_t *) malloc(size + 1);
+    li->index_version = 0;
+    fseeko(f, 0, SEEK_SET);
+    // version 2 is the same without INDEX_BLOCK_STATS
+    if (li->index_raw && size >= 8 &&
+            fread(li->index_raw, 1, size, f) == (size_t) size &&
+            decode32(li->index_raw) == INDEX_MAGIC &&
+            decode32(li->index_raw + 4) >= 2 &&
+            decode32(li->index_raw + 4) <= INDEX_VERSION) {
+        li->index_version = decode32(li->index_raw + 4);
+        parse_index(li, li->index_raw + 8, li->index_raw + size);
+    }
+    fclose(f);
+    return li->index_len;
+}
+
+// Checks that index entry i still describes the event at its offset, and
+// leaves the file just past that event's header in hdr.
+static int check_index_entry(lcm_eventlog_t *l, int64_t i, uint8_t *hdr)
+{
+    const index_entry_t *entry = &impl(l)->index[i];
+    impl(l)->next_header_offset = -1;
+    return 0 == fseeko(l->f, entry->offset, SEEK_SET) &&
+        0 == read_header(l, hdr) &&
+        ftello(l->f) == entry->offset + HEADER_SIZE &&
+        decode64(hdr + 4) == entry->eventnum &&
+        decode64(hdr + 12) == entry->timestamp;
+}
+
+// Seeks to the first event at or after timestamp using the index.  Returns
+// 0 on success, or -1 if the index does not help, in which case the caller
+// falls back to bisecting the log.
+static int seek_with_index(lcm_eventlog_t *l, int64_t timestamp,
+        int64_t file_len)
+{
+    eventlog_impl_t *li = impl(l);
+    int64_t len = load_index(li);
+    if (len == 0 || li->index[0].offset != 0)
+        return -1;
+
+    // the last entry before timestamp, or the first one
+    int64_t lo = 0, hi = len;
+    while (hi - lo > 1) {
+        int64_t mid = lo + (hi - lo) / 2;
+        if (li->index[mid].timestamp < timestamp)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    // The entry must still describe the log.  From there, at most one
+    // block of events is scanned.
+    uint8_t hdr[HEADER_SIZE];
+    if (li->index[lo].offset + HEADER_SIZE > file_len ||
+            !check_index_entry(l, lo, hdr))
+        return -1;
+    int64_t offset = li->index[lo].offset;
+    while (decode64(hdr + 12) < timestamp) {
+        int64_t next = offset + HEADER_SIZE + decode32(hdr + 20) +
+            decode32(hdr + 24);
+        uint8_t next_hdr[HEADER_SIZE];
+        // past the end of the log, stay on the last event
+        if (next + HEADER_SIZE > file_len ||
+                0 != fseeko(l->f, next, SEEK_SET) ||
+                0 != read_header(l, next_hdr) ||
+                ftello(l->f) != next + HEADER_SIZE)
+            break;
+        memcpy(hdr, next_hdr, HEADER_SIZE);
+        offset = next;
+    }
+    fseeko(l->f, offset, SEEK_SET);
+    li->next_header_offset = -1;
+    l->eventcount = decode64(hdr + 4);
+    return 0;
+}
+
+// Seeks to the first event at or after timestamp in a compressed log, or to
+// the last event if there is none.
+static int seek_compressed(lcm_eventlog_t *l, int64_t timestamp)
+{
+    eventlog_impl_t *li = impl(l);
+    GArray *blocks = load_blocks(l);
+    if (!blocks->len)
+        return -1;
+    // the last block that starts before timestamp, or the first one
+    guint lo = 0, hi = blocks->len;
+    while (hi - lo > 1) {
+        guint mid = lo + (hi - lo) / 2;
+        if (g_array_index(blocks, block_entry_t, mid).timestamp < timestamp)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if (0 != seek_block(l, lo))
+        return -1;
+    int32_t last_pos = -1;
+    while (1) {
+        int32_t size;
+        const uint8_t *p = block_event(li, &size);
+        if (!p) {
+            if (++lo < blocks->len && 0 == seek_block(l, lo))
+                continue;
+            if (last_pos < 0)
+                return -1;
+            // stay on the last event of the last block
+            seek_block(l, lo - 1);
+            li->block_pos = last_pos;
+            p = li->block + last_pos;
+            break;
+        }
+        if (decode64(p + 12) >= timestamp)
+            break;
+        last_pos = li->block_pos;
+        li->block_pos += size;
+    }
+    l->eventcount = decode64(li->block + li->block_pos + 4);
+    return 0;
+}
+
+int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *l, int64_t timestamp)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->stripes) {
+        // a stripe that can't seek there has nothing left to read
+        int status = -1;
+        for (int i = 0; i < li->num_stripes; i++) {
+            if (0 == lcm_eventlog_seek_to_timestamp(li->stripes[i], timestamp)) {
+                li->stripe_ready[i] = -1;
+                status = 0;
+            } else {
+                li->stripe_ready[i] = 0;
+            }
+        }
+        return status;
+    }
+    if (li->compressed)
+        return seek_compressed(l, timestamp);
+
+    fseeko (l->f, 0, SEEK_END);
+    off_t file_len = ftello(l->f);
+
+    if (0 == seek_with_index(l, timestamp, file_len))
+        return 0;
+
+    int64_t cur_time;
+    double frac1 = 0;               // left bracket
+    double frac2 = 1;               // right bracket
+    double prev_frac = -1;
+    double frac;                    // current position
+
+    while (1) {
+        frac = 0.5*(frac1+frac2);
+        off_t offset = (off_t)(frac*file_len);
+        fseeko (l->f, offset, SEEK_SET);
+        cur_time = get_event_time (l);
+        if (cur_time < 0)
+            return -1;
+
+        if ((frac > frac2) || (frac < frac1) || (frac1>=frac2))
+            break;
+
+        double df = frac-prev_frac;
+        if (df < 0)
+            df = -df;
+        if (df < 1e-12)
+            break;
+
+        if (cur_time == timestamp)
+            break;
+
+        if (cur_time < timestamp)
+            frac1 = frac;
+        else
+            frac2 = frac;
 
         prev_frac = frac;
     }
 
     return 0;
 }
+
+lcm_eventlog_t *lcm_eventlog_create_filtered(const char *path,
+        const char *channel_regex)
+{
+    GError *err = NULL;
+    lcm_channel_pattern_t *filter = lcm_channel_pattern_new(channel_regex,
+            &err);
+    if (!filter) {
+        fprintf(stderr, "Invalid channel regex \"%s\": %s\n", channel_regex,
+                err->message);
+        g_error_free(err);
+        return NULL;
+    }
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l) {
+        lcm_channel_pattern_free(filter);
+        return NULL;
+    }
+    eventlog_impl_t *li = impl(l);
+    li->filter = filter;
+    li->filter_matches = g_hash_table_new_full(g_str_hash, g_str_equal,
+            g_free, NULL);
+
+    // each stripe is filtered on its own
+    for (int i = 0; i < li->num_stripes; i++) {
+        lcm_eventlog_t *sl = lcm_eventlog_create_filtered(
+                impl(li->stripes[i])->path, channel_regex);
+        if (!sl) {
+            lcm_eventlog_destroy(l);
+            return NULL;
+        }
+        lcm_eventlog_destroy(li->stripes[i]);
+        li->stripes[i] = sl;
+    }
+    if (li->stripes)
+        return l;
+
+    // Blocks are only skipped with an index of this very log
+    uint8_t hdr[HEADER_SIZE];
+    if (load_index(li) > 0 && (li->index[0].offset != 0 ||
+                !check_index_entry(l, 0, hdr) ||
+                !check_index_entry(l, li->index_len - 1, hdr)))
+        free_index(li);
+    fseeko(l->f, 0, SEEK_SET);
+    li->next_header_offset = -1;
+    return l;
+}
+
+// Copies the event into the queue, waiting for room or dropping it if the
+// queue is full.
+static int async_enqueue(lcm_eventlog_t *l, lcm_eventlog_event_t *le)
+{
+    eventlog_impl_t *li = impl(l);
+    if (le->channellen < 0 || le->datalen < 0)
+        return -1;
+    int64_t size = (int64_t) le->channellen + le->datalen;
+    async_event_t *ev = (async_event_t *) malloc(sizeof(async_event_t) +
+            size + 1);
+    if (!ev)
+        return -1;
+    ev->next = NULL;
+    ev->size = size;
+    ev->event = *le;
+    ev->event.channel = (char *) (ev + 1);
+    memcpy(ev->event.channel, le->channel, le->channellen);
+    ev->event.channel[le->channellen] = 0;
+    ev->event.data = ev->event.channel + le->channellen + 1;
+    memcpy(ev->event.data, le->data, le->datalen);
+
+    g_mutex_lock(li->async_mutex);
+    // an event larger than the whole queue still goes once the queue is
+    // empty
+    int waited = 0;
+    while (li->async_stats.num_queued &&
+            li->async_stats.queued_bytes + size > li->async_queue_cap) {
+        if (!li->async_block) {
+            li->async_stats.num_dropped++;
+            g_mutex_unlock(li->async_mutex);
+            free(ev);
+            return -1;
+        }
+        if (!waited)
+            li->async_stats.num_blocked++;
+        waited = 1;
+        g_cond_wait(li->async_space_cond, li->async_mutex);
+    }
+    le->eventnum = ev->event.eventnum = li->async_eventcount++;
+    if (li->async_tail)
+        li->async_tail->next = ev;
+    else
+        li->async_head = ev;
+    li->async_tail = ev;
+    li->async_stats.num_queued++;
+    li->async_stats.queued_bytes += size;
+    li->async_stats.max_queued_bytes = MAX(li->async_stats.max_queued_bytes,
+            li->async_stats.queued_bytes);
+    g_cond_signal(li->async_cond);
+    g_mutex_unlock(li->async_mutex);
+    return 0;
+}
+
+static gpointer async_write_thread(gpointer user)
+{
+    lcm_eventlog_t *l = (lcm_eventlog_t *) user;
+    eventlog_impl_t *li = impl(l);
+    lcm_internal_thread_init("lcm-eventlog", NULL, NULL);
+
+    g_mutex_lock(li->async_mutex);
+    while (1) {
+        while (!li->async_exit && !li->async_head)
+            g_cond_wait(li->async_cond, li->async_mutex);
+        // the events still queued are written before exiting
+        if (!li->async_head)
+            break;
+
+        // everything queued so far is written, and then flushed once
+        async_event_t *batch = li->async_head;
+        li->async_head = NULL;
+        li->async_tail = NULL;
+        g_mutex_unlock(li->async_mutex);
+
+        int num_events = 0;
+        int num_failed = 0;
+        int64_t bytes = 0;
+        while (batch) {
+            async_event_t *ev = batch;
+            batch = ev->next;
+            if (0 != write_event_now(l, &ev->event))
+                num_failed++;
+            num_events++;
+            bytes += ev->size;
+            free(ev);
+        }
+        int flush_status = flush_now(l);
+
+        // events count as queued until they have been flushed
+        g_mutex_lock(li->async_mutex);
+        li->async_stats.num_queued -= num_events;
+        li->async_stats.queued_bytes -= bytes;
+        li->async_stats.num_written += num_events - num_failed;
+        li->async_stats.num_failed += num_failed;
+        li->async_stats.num_flushes++;
+        li->async_flush_status = flush_status;
+        g_cond_broadcast(li->async_space_cond);
+    }
+    g_mutex_unlock(li->async_mutex);
+    return NULL;
+}
+
+static int async_wait_written(eventlog_impl_t *li)
+{
+    g_mutex_lock(li->async_mutex);
+    while (li->async_stats.num_queued)
+        g_cond_wait(li->async_space_cond, li->async_mutex);
+    int status = li->async_flush_status;
+    g_mutex_unlock(li->async_mutex);
+    return status;
+}
+
+static void async_free(eventlog_impl_t *li)
+{
+    li->async_thread = NULL;
+    g_cond_free(li->async_space_cond);
+    g_cond_free(li->async_cond);
+    g_mutex_free(li->async_mutex);
+}
+
+// joins the writer thread once it has written the queued events
+static void async_stop(eventlog_impl_t *li)
+{
+    g_mutex_lock(li->async_mutex);
+    li->async_exit = 1;
+    g_cond_signal(li->async_cond);
+    g_mutex_unlock(li->async_mutex);
+
+    g_thread_join(li->async_thread);
+    async_free(li);
+}
+
+lcm_eventlog_t *lcm_eventlog_create_async(const char *path, const char *mode,
+        int64_t queue_bytes, int block)
+{
+    if (strcmp(mode, "w") && strcmp(mode, "a"))
+        return NULL;
+    lcm_eventlog_t *l = lcm_eventlog_create(path, mode);
+    if (!l)
+        return NULL;
+    eventlog_impl_t *li = impl(l);
+    li->async_mutex = g_mutex_new();
+    li->async_cond = g_cond_new();
+    li->async_space_cond = g_cond_new();
+    li->async_queue_cap = queue_bytes;
+    li->async_block = block;
+    li->async_thread = g_thread_create(async_write_thread, l, TRUE, NULL);
+    if (!li->async_thread) {
+        fprintf(stderr, "Unable to start the writer thread of %s\n", path);
+        async_free(li);
+        lcm_eventlog_destroy(l);
+        return NULL;
+    }
+    return l;
+}
+
+int lcm_eventlog_get_async_stats(lcm_eventlog_t *l,
+        lcm_eventlog_async_stats_t *stats)
+{
+    eventlog_impl_t *li = impl(l);
+    if (!li->async_thread)
+        return -1;
+    g_mutex_lock(li->async_mutex);
+    *stats = li->async_stats;
+    g_mutex_unlock(li->async_mutex);
+    return 0;
+}
+
+// Whether a plausible event starts at offset: its header is sane, and it is
+// followed by another magic number or by the end of the file.
+static int valid_event_at(FILE *f, int64_t offset, int64_t file_size)
+{
+    uint8_t hdr[HEADER_SIZE];
+    if (0 != fseeko(f, offset, SEEK_SET) ||
+            fread(hdr, 1, HEADER_SIZE, f) != HEADER_SIZE)
+        return 0;
+    int32_t channellen = decode32(hdr + 20);
+    int32_t datalen = decode32(hdr + 24);
+    if (decode32(hdr) != MAGIC || channellen <= 0 ||
+            channellen >= MAX_CHANNEL_LEN || datalen < 0)
+        return 0;
+    int64_t next = offset + HEADER_SIZE + channellen + datalen;
+    if (next >= file_size)
+        return next == file_size;
+    int32_t magic;
+    return 0 == fseeko(f, next, SEEK_SET) && 0 == fread32(f, &magic) &&
+        magic == MAGIC;
+}
+
+// The start of the first event, or block of a compressed log, at or after
+// offset, or file_size if there is none.
+static int64_t range_boundary(lcm_eventlog_t *l, int64_t offset,
+        int64_t file_size)
+{
+    eventlog_impl_t *li = impl(l);
+    if (li->compressed) {
+        GArray *blocks = load_blocks(l);
+        for (guint i = 0; i < blocks->len; i++) {
+            int64_t block_offset =
+                g_array_index(blocks, block_entry_t, i).offset;
+            if (block_offset >= offset)
+                return block_offset;
+        }
+        return file_size;
+    }
+    if (li->index_len) {
+        // from the last indexed event before offset, hop from header to
+        // header
+        int64_t i = find_block(li, offset);
+        int64_t pos = li->index[i].offset;
+        uint8_t hdr[HEADER_SIZE];
+        while (pos < offset && 0 == fseeko(l->f, pos, SEEK_SET) &&
+                fread(hdr, 1, HEADER_SIZE, l->f) == HEADER_SIZE &&
+                decode32(hdr) == MAGIC && decode32(hdr + 20) > 0 &&
+                decode32(hdr + 24) >= 0)
+            pos += HEADER_SIZE + decode32(hdr + 20) + decode32(hdr + 24);
+        if (pos >= offset)
+            return pos < file_size ? pos : file_size;
+    }
+
+    // Look for the magic number, and check that what follows looks like an
+    // event, since event data can contain the magic number too.
+    const size_t chunk = 1 << 16;
+    uint8_t *buf = (uint8_t *) malloc(chunk);
+    while (offset < file_size) {
+        size_t n;
+        if (0 != fseeko(l->f, offset, SEEK_SET) ||
+                (n = fread(buf, 1, chunk, l->f)) < 4)
+            break;
+        for (const uint8_t *p = find_magic(buf, buf + n); p;
+                p = find_magic(p + 1, buf + n)) {
+            int64_t event_offset = offset + (p - buf);
+            if (valid_event_at(l->f, event_offset, file_size)) {
+                free(buf);
+                return event_offset;
+            }
+        }
+        offset += n - 3;
+    }
+    free(buf);
+    return file_size;
+}
+
+int lcm_eventlog_split(const char *path, int num_ranges, int64_t *offsets)
+{
+    if (num_ranges < 1)
+        return -1;
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l)
+        return -1;
+    eventlog_impl_t *li = impl(l);
+    if (li->stripes) {
+        lcm_eventlog_destroy(l);
+        return -1;
+    }
+    fseeko(l->f, 0, SEEK_END);
+    int64_t file_size = ftello(l->f);
+
+    // only an index of this very log is used
+    uint8_t hdr[HEADER_SIZE];
+    if (!li->compressed && load_index(li) > 0 &&
+            (li->index[0].offset != 0 || !check_index_entry(l, 0, hdr) ||
+             !check_index_entry(l, li->index_len - 1, hdr)))
+        free_index(li);
+
+    int n = 0;
+    offsets[n++] = 0;
+    for (int i = 1; i < num_ranges; i++) {
+        int64_t offset = range_boundary(l, file_size / num_ranges * i,
+                file_size);
+        if (offset > offsets[n - 1] && offset < file_size)
+            offsets[n++] = offset;
+    }
+    offsets[n] = file_size;
+    lcm_eventlog_destroy(l);
+    return n;
+}
+
+lcm_eventlog_t *lcm_eventlog_create_range(const char *path, int64_t start,
+        int64_t end)
+{
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l)
+        return NULL;
+    if (0 != fseeko(l->f, start, SEEK_SET)) {
+        lcm_eventlog_destroy(l);
+        return NULL;
+    }
+    impl(l)->range_end = end;
+    return l;
+}
+
+typedef struct {
+    const char *path;
+    int range;
+    int64_t start;
+    int64_t end;
+    lcm_eventlog_scan_handler_t handler;
+    void *user;
+    int status;
+} scan_range_t;
+
+static gpointer scan_thread(gpointer user)
+{
+    scan_range_t *r = (scan_range_t *) user;
+    lcm_internal_thread_init("lcm-logscan", NULL, NULL);
+    lcm_eventlog_t *l = lcm_eventlog_create_range(r->path, r->start, r->end);
+    if (!l) {
+        r->status = -1;
+        return NULL;
+    }
+    lcm_eventlog_event_t event;
+    memset(&event, 0, sizeof(event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    while (0 == lcm_eventlog_read_next_event_into(l, &event,
+                &channel_capacity, &data_capacity))
+        r->handler(&event, r->range, r->user);
+    free(event.channel);
+    free(event.data);
+    lcm_eventlog_destroy(l);
+    return NULL;
+}
+
+int lcm_eventlog_scan_parallel(const char *path, int num_threads,
+        lcm_eventlog_scan_handler_t handler, void *user)
+{
+    if (num_threads < 1)
+        return -1;
+    int64_t *offsets = (int64_t *) malloc((num_threads + 1) * sizeof(int64_t));
+    int n = lcm_eventlog_split(path, num_threads, offsets);
+    if (n < 0) {
+        free(offsets);
+        return -1;
+    }
+    scan_range_t *ranges = (scan_range_t *) calloc(n, sizeof(scan_range_t));
+    GThread **threads = (GThread **) calloc(n, sizeof(GThread *));
+    int status = n;
+    for (int i = 0; i < n; i++) {
+        scan_range_t *r = &ranges[i];
+        r->path = path;
+        r->range = i;
+        r->start = offsets[i];
+        r->end = offsets[i + 1];
+        r->handler = handler;
+        r->user = user;
+        threads[i] = g_thread_create(scan_thread, r, TRUE, NULL);
+        if (!threads[i]) {
+            // the range is scanned on this thread instead
+            scan_thread(r);
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        if (threads[i])
+            g_thread_join(threads[i]);
+        if (ranges[i].status != 0)
+            status = -1;
+    }
+    free(threads);
+    free(ranges);
+    free(offsets);
+    return status;
+}
+
+// Channel name -> lcm_eventlog_channel_stats_t, which owns the name.
+static GHashTable *stats_table_new(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free);
+}
+
+static lcm_eventlog_channel_stats_t *stats_lookup(GHashTable *table,
+        const char *channel)
+{
+    lcm_eventlog_channel_stats_t *cs = (lcm_eventlog_channel_stats_t *)
+        g_hash_table_lookup(table, channel);
+    if (!cs) {
+        size_t len = strlen(channel);
+        cs = (lcm_eventlog_channel_stats_t *) calloc(1,
+                sizeof(lcm_eventlog_channel_stats_t) + len + 1);
+        cs->channel = (char *) (cs + 1);
+        memcpy(cs->channel, channel, len + 1);
+        g_hash_table_insert(table, cs->channel, cs);
+    }
+    return cs;
+}
+
+// Adds what part counts of events that follow those counted in cs.
+static void stats_merge(lcm_eventlog_channel_stats_t *cs,
+        const lcm_eventlog_channel_stats_t *part)
+{
+    if (part->num_events == 0)
+        return;
+    if (cs->num_events == 0) {
+        cs->first_timestamp = part->first_timestamp;
+        cs->max_gap = part->max_gap;
+    } else {
+        cs->max_gap = MAX(cs->max_gap, part->max_gap);
+        cs->max_gap = MAX(cs->max_gap,
+                part->first_timestamp - cs->last_timestamp);
+    }
+    cs->last_timestamp = part->last_timestamp;
+    cs->num_events += part->num_events;
+    cs->num_bytes += part->num_bytes;
+}
+
+static void stats_add_event(GHashTable *table, const char *channel,
+        int64_t timestamp, int32_t datalen)
+{
+    lcm_eventlog_channel_stats_t part = { NULL, 1, datalen, timestamp,
+        timestamp, 0 };
+    stats_merge(stats_lookup(table, channel), &part);
+}
+
+// Merges the later counts of from into table.
+static void stats_merge_table(GHashTable *table, GHashTable *from)
+{
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, from);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        const lcm_eventlog_channel_stats_t *part =
+            (const lcm_eventlog_channel_stats_t *) value;
+        stats_merge(stats_lookup(table, part->channel), part);
+    }
+}
+
+// Counts the events of a range of an uncompressed log from their headers
+// alone, without reading their data.  Returns 0 on success.
+static int stats_scan_headers(const char *path, int64_t start, int64_t end,
+        int64_t file_size, GHashTable *table)
+{
+    lcm_eventlog_t *l = lcm_eventlog_create_range(path, start, end);
+    if (!l)
+        return -1;
+    uint8_t hdr[HEADER_SIZE];
+    char channel[MAX_CHANNEL_LEN];
+    while (0 == read_header(l, hdr)) {
+        int64_t offset = ftello(l->f) - HEADER_SIZE;
+        if (offset >= end)
+            break;
+        int32_t channellen = decode32(hdr + 20);
+        int32_t datalen = decode32(hdr + 24);
+        if (channellen <= 0 || channellen >= MAX_CHANNEL_LEN || datalen < 0 ||
+                fread(channel, 1, channellen, l->f) != (size_t) channellen) {
+            // resynchronize just past this magic number
+            fseeko(l->f, offset + 4, SEEK_SET);
+            continue;
+        }
+        // a truncated last event is left out, as readers do
+        int64_t next = offset + HEADER_SIZE + channellen + datalen;
+        if (next > file_size)
+            break;
+        channel[channellen] = 0;
+        stats_add_event(table, channel, decode64(hdr + 12), datalen);
+        fseeko(l->f, next, SEEK_SET);
+    }
+    lcm_eventlog_destroy(l);
+    return 0;
+}
+
+typedef struct {
+    const char *path;
+    int64_t start;
+    int64_t end;
+    int64_t file_size;
+    GHashTable *table;
+    int status;
+} stats_range_t;
+
+static gpointer stats_thread(gpointer user)
+{
+    stats_range_t *r = (stats_range_t *) user;
+    lcm_internal_thread_init("lcm-logstat", NULL, NULL);
+    r->status = stats_scan_headers(r->path, r->start, r->end, r->file_size,
+            r->table);
+    return NULL;
+}
+
+static void stats_scan_handler(const lcm_eventlog_event_t *event, int range,
+        void *user)
+{
+    GHashTable **tables = (GHashTable **) user;
+    stats_add_event(tables[range], event->channel, event->timestamp,
+            event->datalen);
+}
+
+// Counts the blocks of an index of the log that l reads, which must have
+// been checked against it, into table.  Returns the offset from which the
+// log still has to be scanned, or -1 if the index does not have the stats
+// of every block.
+static int64_t stats_from_index(eventlog_impl_t *li, GHashTable *table)
+{
+    for (int64_t i = 0; i < li->index_len; i++) {
+        const index_entry_t *entry = &li->index[i];
+        if (!entry->stats || (i + 1 < li->index_len &&
+                    entry->end_offset != li->index[i + 1].offset)) {
+            // a log that is still being written has a last block without
+            // them
+            return i + 1 == li->index_len ? entry->offset : -1;
+        }
+    }
+    for (int64_t i = 0; i < li->index_len; i++) {
+        const index_entry_t *entry = &li->index[i];
+        for (int32_t k = 0; k < entry->num_stats; k++) {
+            const uint8_t *p = entry->stats + INDEX_STATS_ENTRY_SIZE * k;
+            guint id = (guint) decode32(p);
+            if (id >= li->index_channels->len)
+                continue;
+            lcm_eventlog_channel_stats_t part = { NULL, decode32(p + 4),
+                decode64(p + 8), decode64(p + 16), decode64(p + 24),
+                decode64(p + 32) };
+            stats_merge(stats_lookup(table, (const char *)
+                        g_ptr_array_index(li->index_channels, id)), &part);
+        }
+    }
+    return li->index[li->index_len - 1].end_offset;
+}
+
+static int compare_channel_stats(const void *a, const void *b)
+{
+    return strcmp(((const lcm_eventlog_channel_stats_t *) a)->channel,
+            ((const lcm_eventlog_channel_stats_t *) b)->channel);
+}
+
+int lcm_eventlog_get_channel_stats(const char *path, int num_threads,
+        lcm_eventlog_channel_stats_t **stats)
+{
+    if (num_threads < 1)
+        return -1;
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l)
+        return -1;
+    eventlog_impl_t *li = impl(l);
+    GHashTable *table = stats_table_new();
+    int status = 0;
+
+    if (li->stripes) {
+        // the stripes are read together, in timestamp order
+        lcm_eventlog_event_t event;
+        memset(&event, 0, sizeof(event));
+        int32_t channel_capacity = 0;
+        int32_t data_capacity = 0;
+        while (0 == lcm_eventlog_read_next_event_into(l, &event,
+                    &channel_capacity, &data_capacity))
+            stats_add_event(table, event.channel, event.timestamp,
+                    event.datalen);
+        free(event.channel);
+        free(event.data);
+        lcm_eventlog_destroy(l);
+        l = NULL;
+    } else if (li->compressed) {
+        // events are only found by decompressing their blocks
+        lcm_eventlog_destroy(l);
+        l = NULL;
+        GHashTable **tables = (GHashTable **) calloc(num_threads,
+                sizeof(GHashTable *));
+        for (int i = 0; i < num_threads; i++)
+            tables[i] = stats_table_new();
+        if (lcm_eventlog_scan_parallel(path, num_threads, stats_scan_handler,
+                    tables) < 0)
+            status = -1;
+        for (int i = 0; i < num_threads; i++) {
+            stats_merge_table(table, tables[i]);
+            g_hash_table_destroy(tables[i]);
+        }
+        free(tables);
+    } else {
+        fseeko(l->f, 0, SEEK_END);
+        int64_t file_size = ftello(l->f);
+        uint8_t hdr[HEADER_SIZE];
+        int64_t scan_from = -1;
+        // only an index of this very log is used
+        if (load_index(li) > 0 && li->index[0].offset == 0 &&
+                check_index_entry(l, 0, hdr) &&
+                check_index_entry(l, li->index_len - 1, hdr))
+            scan_from = stats_from_index(li, table);
+        lcm_eventlog_destroy(l);
+        l = NULL;
+
+        int n = 1;
+        int64_t *offsets = (int64_t *) malloc((num_threads + 1) *
+                sizeof(int64_t));
+        if (scan_from >= 0) {
+            // what the index does not cover yet is usually small
+            offsets[0] = scan_from;
+            offsets[1] = MAX(scan_from, file_size);
+        } else {
+            n = lcm_eventlog_split(path, num_threads, offsets);
+        }
+        if (n < 0) {
+            status = -1;
+            n = 0;
+        }
+        stats_range_t *ranges = (stats_range_t *) calloc(n + 1,
+                sizeof(stats_range_t));
+        GThread **threads = (GThread **) calloc(n + 1, sizeof(GThread *));
+        for (int i = 0; i < n; i++) {
+            stats_range_t *r = &ranges[i];
+            r->path = path;
+            r->start = offsets[i];
+            r->end = offsets[i + 1];
+            r->file_size = file_size;
+            r->table = stats_table_new();
+            if (n > 1)
+                threads[i] = g_thread_create(stats_thread, r, TRUE, NULL);
+            if (!threads[i])
+                stats_thread(r);
+        }
+        for (int i = 0; i < n; i++) {
+            if (threads[i])
+                g_thread_join(threads[i]);
+            if (ranges[i].status != 0)
+                status = -1;
+            stats_merge_table(table, ranges[i].table);
+            g_hash_table_destroy(ranges[i].table);
+        }
+        free(threads);
+        free(ranges);
+        free(offsets);
+    }
+
+    int num = 0;
+    if (status == 0) {
+        *stats = (lcm_eventlog_channel_stats_t *) calloc(
+                g_hash_table_size(table) + 1,
+                sizeof(lcm_eventlog_channel_stats_t));
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, table);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            (*stats)[num] = *(const lcm_eventlog_channel_stats_t *) value;
+            (*stats)[num].channel = strdup((*stats)[num].channel);
+            num++;
+        }
+        qsort(*stats, num, sizeof(lcm_eventlog_channel_stats_t),
+                compare_channel_stats);
+    }
+    g_hash_table_destroy(table);
+    return status == 0 ? num : -1;
+}
+
+void lcm_eventlog_free_channel_stats(lcm_eventlog_channel_stats_t *stats,
+        int num_channels)
+{
+    if (!stats)
+        return;
+    for (int i = 0; i < num_channels; i++)
+        free(stats[i].channel);
+    free(stats);
+}
+
+int lcm_eventlog_repair(const char *path, const char *out_path,
+        lcm_eventlog_repair_stats_t *stats)
+{
+    lcm_eventlog_repair_stats_t unused;
+    if (!stats)
+        stats = &unused;
+    memset(stats, 0, sizeof(*stats));
+    if (!strcmp(path, out_path))
+        return -1;
+    lcm_eventlog_t *l = lcm_eventlog_create(path, "r");
+    if (!l)
+        return -1;
+    eventlog_impl_t *li = impl(l);
+    if (li->compressed || li->stripes) {
+        fprintf(stderr, "Only uncompressed log files can be repaired\n");
+        lcm_eventlog_destroy(l);
+        return -1;
+    }
+    lcm_eventlog_t *out = lcm_eventlog_create(out_path, "w");
+    if (!out) {
+        lcm_eventlog_destroy(l);
+        return -1;
+    }
+    int status = lcm_eventlog_enable_index(out);
+
+    fseeko(l->f, 0, SEEK_END);
+    int64_t file_size = ftello(l->f);
+    fseeko(l->f, 0, SEEK_SET);
+    lcm_eventlog_event_t le;
+    memset(&le, 0, sizeof(le));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    int64_t expected = 0;  // just past the last event kept
+    uint8_t hdr[HEADER_SIZE];
+    while (status == 0 && 0 == read_header(l, hdr)) {
+        int64_t offset = ftello(l->f) - HEADER_SIZE;
+        le.eventnum = decode64(hdr + 4);
+        le.timestamp = decode64(hdr + 12);
+        le.channellen = decode32(hdr + 20);
+        le.datalen = decode32(hdr + 24);
+        int64_t next = offset + HEADER_SIZE + (int64_t) le.channellen +
+            le.datalen;
+
+        // An event is kept if it is whole and followed by another one or by
+        // the end of the file.  Otherwise the search goes on from just past
+        // its magic number.
+        int32_t next_magic;
+        if (!header_plausible(hdr) || next > file_size ||
+                0 != grow_buffer((void **) &le.channel, &channel_capacity,
+                    le.channellen + 1) ||
+                0 != grow_buffer(&le.data, &data_capacity, le.datalen + 1) ||
+                fread(le.channel, 1, le.channellen, l->f) !=
+                    (size_t) le.channellen ||
+                fread(le.data, 1, le.datalen, l->f) != (size_t) le.datalen ||
+                (next < file_size && (0 != fread32(l->f, &next_magic) ||
+                                      next_magic != MAGIC))) {
+            fseeko(l->f, offset + 4, SEEK_SET);
+            continue;
+        }
+        if (next < file_size)
+            li->next_header_offset = ftello(l->f);
+        le.channel[le.channellen] = 0;
+
+        if (offset > expected) {
+            stats->num_damaged++;
+            stats->bytes_skipped += offset - expected;
+        }
+        expected = next;
+        if (0 != lcm_eventlog_write_event(out, &le))
+            status = -1;
+        else
+            stats->num_events++;
+    }
+    if (status == 0 && expected < file_size) {
+        // a truncated last event, or garbage
+        stats->num_damaged++;
+        stats->bytes_skipped += file_size - expected;
+    }
+    if (0 != lcm_eventlog_flush(out))
+        status = -1;
+
+    free(le.channel);
+    free(le.data);
+    lcm_eventlog_destroy(out);
+    lcm_eventlog_destroy(l);
+    return status;
+}
+
+int lcm_eventlog_write_manifest(const char *path, int num_stripes,
+        const char **stripe_paths)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+    int status = fputs(MANIFEST_HEADER, f) < 0 ? -1 : 0;
+    for (int i = 0; i < num_stripes && status == 0; i++) {
+        if (fprintf(f, "%s\n", stripe_paths[i]) < 0)
+            status = -1;
+    }
+    if (fclose(f) != 0)
+        status = -1;
+    return status;
+}
@@ -28,6 +28,11 @@ extern "C" {
  * @{
  */
 
+/**
+ * Appended to the path of a log file to name its index.
+ */
+#define LCM_EVENTLOG_INDEX_SUFFIX ".lcmidx"
+
 typedef struct _lcm_eventlog_t lcm_eventlog_t;
 struct _lcm_eventlog_t
 {
@@ -79,6 +84,9 @@ struct _lcm_eventlog_event_t {
 /**
  * Open a log file for reading or writing.
  *
+ * In read mode, @p path may also be a stripe manifest (see
+ * lcm_eventlog_write_manifest()), whose stripes are then read as one log.
+ *
  * @param path Log file to open
  * @param mode "r" (read mode), "w" (write mode), or "a" (append mode)
  *
@@ -87,6 +95,223 @@ struct _lcm_eventlog_event_t {
 LCM_EXPORT
 lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode);
 
+/**
+ * Open a log file for reading only the events on some channels.
+ *
+ * lcm_eventlog_read_next_event() and lcm_eventlog_read_next_event_into()
+ * then return only the events on channels that match @p channel_regex.  The
+ * data of other events is never read, and if the log has an index (see
+ * lcm_eventlog_build_index()), whole blocks of events without a matching
+ * channel are skipped, so that reading a channel costs about as much as the
+ * channel's share of the log.
+ *
+ * @param path Log file to open
+ * @param channel_regex Which channels to read.  This is a regular expression
+ *        implicitly surrounded by '^' and '$', like a subscription.
+ *
+ * @return a newly allocated lcm_eventlog_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_eventlog_t *lcm_eventlog_create_filtered(const char *path,
+        const char *channel_regex);
+
+/**
+ * Split a log file into ranges that can be read in parallel.
+ *
+ * The file is cut into @p num_ranges byte ranges of about the same size,
+ * each moved to the start of the next event, or of the next block of a
+ * compressed log, so that every event belongs to exactly one range.  Events
+ * are found with the index of the log when it has one (see
+ * lcm_eventlog_build_index()), and otherwise by looking for the next magic
+ * number that is followed by a plausible event.  Each range is then read
+ * with its own reader from lcm_eventlog_create_range().
+ *
+ * @param path Log file to split
+ * @param num_ranges How many ranges to make, at least 1
+ * @param offsets Filled in with the start of each range, followed by the
+ *        size of the file.  Must have room for @p num_ranges + 1 values.
+ *
+ * @return the number of ranges, which is smaller than @p num_ranges when the
+ * log has too few events, or -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_split(const char *path, int num_ranges, int64_t *offsets);
+
+/**
+ * Open a log file for reading the events of one range from
+ * lcm_eventlog_split().
+ *
+ * Reading starts at @p start, and ends before the first event, or the
+ * first block of a compressed log, that starts at or after @p end.  The
+ * readers of different ranges are independent, and can be used from
+ * different threads.
+ *
+ * @param path Log file to open
+ * @param start Where the range starts
+ * @param end Where the next range starts, or -1 to read to the end of the
+ *        file
+ *
+ * @return a newly allocated lcm_eventlog_t, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_eventlog_t *lcm_eventlog_create_range(const char *path, int64_t start,
+        int64_t end);
+
+/**
+ * Callback for lcm_eventlog_scan_parallel().  @p event and its buffers are
+ * only valid during the call.
+ */
+typedef void (*lcm_eventlog_scan_handler_t)(const lcm_eventlog_event_t *event,
+        int range, void *user);
+
+/**
+ * Read a whole log file with several threads.
+ *
+ * The log is split with lcm_eventlog_split(), and each range is read on a
+ * thread of its own, which calls @p handler for each event of the range in
+ * order.  Handlers for different ranges run concurrently, so a handler
+ * usually accumulates into per-range state, indexed by @p range, that the
+ * caller combines once this returns.
+ *
+ * @param path Log file to read
+ * @param num_threads How many ranges, and threads, to split the log into
+ * @param handler Called with each event, its range, and @p user
+ * @param user Passed to @p handler
+ *
+ * @return the number of ranges that were read, at most @p num_threads, or
+ * -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_scan_parallel(const char *path, int num_threads,
+        lcm_eventlog_scan_handler_t handler, void *user);
+
+/**
+ * Statistics of the events of one channel of a log, from
+ * lcm_eventlog_get_channel_stats().
+ */
+typedef struct _lcm_eventlog_channel_stats_t lcm_eventlog_channel_stats_t;
+struct _lcm_eventlog_channel_stats_t {
+    char *channel;
+    int64_t num_events;
+    int64_t num_bytes;        /**< of the data of the events */
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    /** The longest time between two consecutive events, in microseconds */
+    int64_t max_gap;
+};
+
+/**
+ * Count the events of each channel of a log file.
+ *
+ * If the log has an index that was written by this version of LCM (see
+ * lcm_eventlog_build_index()), the counts of the blocks it covers are taken
+ * from it, and only the events logged after the index are read.  Otherwise
+ * the log is split with lcm_eventlog_split() and each range is read on a
+ * thread of its own, from the event headers alone, so that the data of the
+ * events is never read or copied.  Compressed logs are decompressed, and
+ * striped logs read on one thread.
+ *
+ * @param path Log file to read
+ * @param num_threads How many ranges, and threads, to split the log into if
+ *        it has to be read
+ * @param stats Set to a newly allocated array of the channels, sorted by
+ *        name, to be freed with lcm_eventlog_free_channel_stats()
+ *
+ * @return the number of channels, or -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_get_channel_stats(const char *path, int num_threads,
+        lcm_eventlog_channel_stats_t **stats);
+
+/**
+ * Free the channel statistics returned by lcm_eventlog_get_channel_stats().
+ */
+LCM_EXPORT
+void lcm_eventlog_free_channel_stats(lcm_eventlog_channel_stats_t *stats,
+        int num_channels);
+
+/**
+ * Open a log file that is written by a thread of its own.
+ *
+ * lcm_eventlog_write_event() then copies the event into a queue of at most
+ * @p queue_bytes of channels and data, and returns without waiting for the
+ * disk.  The writer thread writes everything queued at once and flushes the
+ * file after each such batch.  lcm_eventlog_flush() waits for the queued
+ * events to be written and flushed, and lcm_eventlog_destroy() writes them
+ * before closing the log.
+ *
+ * lcm_eventlog_set_compression(), lcm_eventlog_set_write_flags() and
+ * lcm_eventlog_enable_index() may still be called before the first event is
+ * written.  The eventcount field of the log is updated by the writer thread.
+ *
+ * @param path Log file to open
+ * @param mode "w" (write mode) or "a" (append mode)
+ * @param queue_bytes How many bytes of events may wait to be written.  An
+ *        event larger than that is queued once the queue is empty.
+ * @param block What lcm_eventlog_write_event() does when the queue is full:
+ *        wait for room if nonzero, or drop the event and return -1.
+ *
+ * @return a newly allocated lcm_eventlog_t, or NULL on failure.
+ * @sa lcm_eventlog_get_async_stats()
+ */
+LCM_EXPORT
+lcm_eventlog_t *lcm_eventlog_create_async(const char *path, const char *mode,
+        int64_t queue_bytes, int block);
+
+/**
+ * Counters of a log opened with lcm_eventlog_create_async(), retrieved with
+ * lcm_eventlog_get_async_stats().
+ */
+typedef struct _lcm_eventlog_async_stats_t lcm_eventlog_async_stats_t;
+struct _lcm_eventlog_async_stats_t
+{
+    /**
+     * the number of events queued and not written and flushed yet
+     */
+    int num_queued;
+    /**
+     * the bytes of channels and data of those events
+     */
+    int64_t queued_bytes;
+    /**
+     * the most bytes that have been queued at once
+     */
+    int64_t max_queued_bytes;
+    /**
+     * the number of events written to the file
+     */
+    int64_t num_written;
+    /**
+     * the number of events that could not be written
+     */
+    int64_t num_failed;
+    /**
+     * the number of events discarded because the queue was full
+     */
+    int64_t num_dropped;
+    /**
+     * the number of events whose writer had to wait for room in the queue
+     */
+    int64_t num_blocked;
+    /**
+     * the number of batches written, each followed by a flush
+     */
+    int64_t num_flushes;
+};
+
+/**
+ * Retrieves the counters of an asynchronous log.
+ *
+ * @param eventlog The log file object
+ * @param stats filled in with a snapshot of the counters
+ *
+ * @return 0 on success, -1 if @p eventlog was not opened with
+ * lcm_eventlog_create_async()
+ */
+LCM_EXPORT
+int lcm_eventlog_get_async_stats(lcm_eventlog_t *eventlog,
+        lcm_eventlog_async_stats_t *stats);
+
 /**
  * Read the next event in the log file.  Valid in read mode only.  Free the
  * returned structure with lcm_eventlog_free_event() after use.
@@ -99,6 +324,43 @@ lcm_eventlog_t *lcm_eventlog_create(const char *path, const char *mode);
 LCM_EXPORT
 lcm_eventlog_event_t *lcm_eventlog_read_next_event(lcm_eventlog_t *eventlog);
 
+/**
+ * Read the next event in the log file into a structure owned by the caller,
+ * reusing its channel and data buffers.  Valid in read mode only.
+ *
+ * Unlike lcm_eventlog_read_next_event(), this does not allocate memory for
+ * each event: @c event->channel and @c event->data are grown with realloc()
+ * only when an event does not fit.  Start with both set to NULL and both
+ * capacities set to 0, and free() the buffers when done.  The channel and
+ * data are each followed by a NUL byte, which the capacities account for.
+ *
+ * @code
+ * lcm_eventlog_event_t event = { 0 };
+ * int32_t channel_capacity = 0, data_capacity = 0;
+ * while (0 == lcm_eventlog_read_next_event_into(log, &event,
+ *             &channel_capacity, &data_capacity)) {
+ *     ...
+ * }
+ * free(event.channel);
+ * free(event.data);
+ * @endcode
+ *
+ * @param eventlog The log file object
+ * @param event Filled in with the next event
+ * @param channel_capacity The number of bytes allocated for
+ *        @c event->channel, updated when the buffer grows
+ * @param data_capacity The number of bytes allocated for @c event->data,
+ *        updated when the buffer grows
+ *
+ * @return 0 on success, or -1 when the end of the file has been reached or
+ * when invalid data is read.  The buffers stay valid either way, but the
+ * other fields of @p event are then undefined.
+ */
+LCM_EXPORT
+int lcm_eventlog_read_next_event_into(lcm_eventlog_t *eventlog,
+        lcm_eventlog_event_t *event, int32_t *channel_capacity,
+        int32_t *data_capacity);
+
 /**
  * Free a structure returned by lcm_eventlog_read_next_event().
  *
@@ -110,6 +372,12 @@ void lcm_eventlog_free_event(lcm_eventlog_event_t *event);
 /**
  * Seek (approximately) to a particular timestamp.
  *
+ * If the log has an index (see lcm_eventlog_build_index()), this seeks to the
+ * first event with a timestamp of at least @p ts, or to the last event if
+ * there is none, reading only a small part of the log.  Otherwise, or if the
+ * index does not match the log, it bisects the log by file offset, which is
+ * only exact if the timestamps in the log increase monotonically.
+ *
  * @param eventlog The log file object
  * @param ts Timestamp of the target event in the log file.
  *
@@ -125,12 +393,173 @@ int lcm_eventlog_seek_to_timestamp(lcm_eventlog_t *eventlog, int64_t ts);
  * @param event The event to write to the file.  On return, the eventnum field
  * will be filled in for you.
  *
- * @return 0 on success, -1 on failure.
+ * @return 0 on success, -1 on failure.  For a log opened with
+ * lcm_eventlog_create_async(), 0 means that the event was queued, and -1
+ * that it was dropped.
  */
 LCM_EXPORT
 int lcm_eventlog_write_event(lcm_eventlog_t *eventlog,
         lcm_eventlog_event_t *event);
 
+/**
+ * Compress a log file as it is written.  Valid in write mode, and in append
+ * mode for an empty file, before the first call to
+ * lcm_eventlog_write_event().
+ *
+ * Events are then written in compressed blocks of about 256 kB, followed by
+ * an index of the blocks when the log is closed.  Compressed logs are read
+ * with the same functions as other logs, including
+ * lcm_eventlog_seek_to_timestamp(), which decompresses at most one block.
+ * Reading them needs an LCM that supports the codec.  Events are only
+ * written to the file once a block is full, or on lcm_eventlog_flush().
+ *
+ * @param eventlog The log file object
+ * @param codec "lz4" or "zlib"
+ *
+ * @return 0 on success, -1 if the codec is not available or the log is not
+ * empty.
+ */
+LCM_EXPORT
+int lcm_eventlog_set_compression(lcm_eventlog_t *eventlog, const char *codec);
+
+/**
+ * Write any buffered events to the file, and flush the file.
+ *
+ * For compressed logs, this ends the current block, so flushing often
+ * costs some compression.
+ *
+ * @param eventlog The log file object
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_flush(lcm_eventlog_t *eventlog);
+
+/**
+ * Flag for lcm_eventlog_set_write_flags(): write events with writev() in
+ * batches, instead of through stdio.
+ */
+#define LCM_EVENTLOG_WRITEV 1
+/**
+ * Flag for lcm_eventlog_set_write_flags(): write the file with O_DIRECT,
+ * bypassing the page cache.
+ */
+#define LCM_EVENTLOG_DIRECT 2
+
+/**
+ * Choose how a log file is written.  Valid in write and append mode.
+ *
+ * With LCM_EVENTLOG_WRITEV, small events are gathered in a 1 MB buffer, and
+ * large ones are written with what is buffered in a single system call,
+ * without being copied.  LCM_EVENTLOG_DIRECT also writes whole blocks with
+ * O_DIRECT, so that a logger does not fill the page cache.  The log is only
+ * complete on disk after lcm_eventlog_flush() or lcm_eventlog_destroy().
+ *
+ * @param eventlog The log file object
+ * @param flags LCM_EVENTLOG_WRITEV, optionally combined with
+ * LCM_EVENTLOG_DIRECT, or 0 to keep writing through stdio
+ *
+ * @return 0 on success, -1 if the flags are not supported on this platform
+ * or file system, or were already set.
+ */
+LCM_EXPORT
+int lcm_eventlog_set_write_flags(lcm_eventlog_t *eventlog, int flags);
+
+/**
+ * Write an index of the log alongside it, as events are written.  Valid in
+ * write and append mode only, and before the first call to
+ * lcm_eventlog_write_event() if the index is to cover the whole log.
+ *
+ * The index is named by appending #LCM_EVENTLOG_INDEX_SUFFIX to the path
+ * of the log.  It splits the log into blocks of about a thousand events, or
+ * a megabyte, and holds the timestamp and file offset of the first event of
+ * each block, which channels the block has, and how many events and bytes
+ * each of them has (see lcm_eventlog_get_channel_stats()).
+ *
+ * The index is flushed along with the log by lcm_eventlog_flush(), so that
+ * readers can seek with it while the log is still being written, and is
+ * completed by lcm_eventlog_destroy().
+ *
+ * Compressed logs hold an index of their own, so this does nothing for
+ * them.
+ *
+ * @param eventlog The log file object
+ *
+ * @return 0 on success, -1 if the index could not be created.
+ */
+LCM_EXPORT
+int lcm_eventlog_enable_index(lcm_eventlog_t *eventlog);
+
+/**
+ * Build the index of an existing log file, replacing any previous index.
+ * Compressed logs are left alone, since they hold an index of their own.
+ *
+ * @param path Log file to index
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_build_index(const char *path);
+
+/**
+ * What lcm_eventlog_repair() found.
+ */
+typedef struct _lcm_eventlog_repair_stats_t lcm_eventlog_repair_stats_t;
+struct _lcm_eventlog_repair_stats_t {
+    int64_t num_events;     /**< written to the repaired log */
+    /** Stretches of the log that were not whole events, and were dropped */
+    int64_t num_damaged;
+    int64_t bytes_skipped;  /**< in those stretches */
+};
+
+/**
+ * Copy the events of a damaged log file, e.g. one cut short by a power
+ * failure, into a new log file with an index.
+ *
+ * An event is copied if it is whole and followed by another event or by the
+ * end of the file.  Whatever else the log holds, such as a partly written
+ * last event or garbage, is skipped by searching for the next plausible event
+ * header, many bytes at a time.  Events are renumbered in the new log.
+ * Readers search past corrupt data the same way, but each damaged stretch
+ * still ends a read with lcm_eventlog_read_next_event() once, and makes
+ * seeking and splitting the log search again.
+ *
+ * Compressed and striped logs can not be repaired.
+ *
+ * @param path Log file to read
+ * @param out_path Log file to write, which is replaced if it exists, along
+ *        with its index.  Must not be @p path.
+ * @param stats Filled in with what was found, unless it is NULL
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_repair(const char *path, const char *out_path,
+        lcm_eventlog_repair_stats_t *stats);
+
+/**
+ * Write a stripe manifest, which lets a log written as several stripes be
+ * read as one.
+ *
+ * A log can be striped to write it faster than one disk can, with the events
+ * spread over log files on different disks.  lcm_eventlog_create() and
+ * lcm_eventlog_create_filtered() open the manifest of such a log like a log
+ * file, and read the events of all its stripes in timestamp order.  Seeking
+ * seeks in each stripe.  Each event is numbered by how many events of all
+ * stripes come before it, assuming each stripe numbers its own events from
+ * 0.  Striped logs can not be split with lcm_eventlog_split().
+ *
+ * @param path Manifest to write
+ * @param num_stripes Number of stripes
+ * @param stripe_paths Log file of each stripe.  Relative paths are relative
+ *        to the directory of the manifest.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_eventlog_write_manifest(const char *path, int num_stripes,
+        const char **stripe_paths);
+
 /**
  * Close a log file and release allocated resources.
  *
@@ -12,6 +12,153 @@ Subscription::setQueueCapacity(int num_messages)
     return lcm_subscription_set_queue_capacity(c_subs, num_messages);
 }
 
+int
+Subscription::setConflate(bool conflate)
+{
+    return lcm_subscription_set_conflate(c_subs, conflate);
+}
+
+int
+Subscription::setPriority(int priority)
+{
+    return lcm_subscription_set_priority(c_subs, priority);
+}
+
+int
+Subscription::setMaxRate(double max_rate_hz)
+{
+    return lcm_subscription_set_max_rate(c_subs, max_rate_hz);
+}
+
+SubscriptionStats
+Subscription::getStats() const
+{
+    lcm_subscription_stats_t c_stats;
+    lcm_subscription_get_stats(c_subs, &c_stats);
+    SubscriptionStats stats;
+    stats.num_enqueued = c_stats.num_enqueued;
+    stats.num_dispatched = c_stats.num_dispatched;
+    stats.num_dropped = c_stats.num_dropped;
+    stats.peak_queue_depth = c_stats.peak_queue_depth;
+    stats.handler_time_usec = c_stats.handler_time_usec;
+    stats.max_handler_time_usec = c_stats.max_handler_time_usec;
+    for (int i = 0; i < LCM_HANDLER_HISTOGRAM_BUCKETS; i++)
+        stats.handler_time_histogram[i] = c_stats.handler_time_histogram[i];
+    stats.num_slow = c_stats.num_slow;
+    stats.num_decimated = c_stats.num_decimated;
+    return stats;
+}
+
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType>
+MessageQueue<MessageType>::MessageQueue(int capacity) :
+    slots(capacity), head(0), tail(0), num_dropped(0), waiting(false)
+{
+}
+
+template <class MessageType>
+void
+MessageQueue<MessageType>::cb_func(const lcm_recv_buf_t *rbuf,
+        const char *channel, void *user_data)
+{
+    MessageQueue<MessageType> *queue =
+        static_cast<MessageQueue<MessageType> *>(user_data);
+    uint64_t t = queue->tail.load(std::memory_order_relaxed);
+    if (t - queue->head.load(std::memory_order_acquire) == queue->slots.size()) {
+        queue->num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    MessageType& msg = queue->slots[t % queue->slots.size()];
+    int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+    if (status < 0) {
+        fprintf (stderr, "error %d decoding %s!!!\n", status,
+                MessageType::getTypeName());
+        return;
+    }
+    queue->tail.store(t + 1, std::memory_order_release);
+
+    // either the consumer sees the new tail before it waits, or this sees
+    // that it waits
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queue->waiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->cond.notify_one();
+    }
+}
+
+template <class MessageType>
+bool
+MessageQueue<MessageType>::tryPop(MessageType& msg)
+{
+    uint64_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire))
+        return false;
+    using std::swap;
+    swap(msg, slots[h % slots.size()]);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+template <class MessageType>
+bool
+MessageQueue<MessageType>::popWait(MessageType& msg, int timeout_millis)
+{
+    if (tryPop(msg))
+        return true;
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(timeout_millis);
+    std::unique_lock<std::mutex> lock(mutex);
+    waiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool popped;
+    while (!(popped = tryPop(msg))) {
+        if (timeout_millis < 0) {
+            cond.wait(lock);
+        } else if (cond.wait_until(lock, deadline) == std::cv_status::timeout) {
+            popped = tryPop(msg);
+            break;
+        }
+    }
+    waiting.store(false, std::memory_order_relaxed);
+    return popped;
+}
+
+template <class MessageType>
+int64_t
+MessageQueue<MessageType>::getNumDropped() const
+{
+    return num_dropped.load(std::memory_order_relaxed);
+}
+#endif
+
+// Decodes the messages of the subscriptions that hand their handler a const
+// pointer.  When a message is dispatched to several subscriptions, the first
+// one of its type decodes it into its own instance and the others get that.
+template <class MessageType>
+struct LCMSharedDecode {
+    // decodes into msg, and complains if that fails
+    static int decodeInto(const lcm_recv_buf_t *rbuf, MessageType& msg)
+    {
+        int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+        if (status < 0)
+            fprintf (stderr, "error %d decoding %s!!!\n", status,
+                    MessageType::getTypeName());
+        return status;
+    }
+    static int decode(const lcm_recv_buf_t *rbuf, void *msg)
+    {
+        return decodeInto(rbuf, *static_cast<MessageType *>(msg));
+    }
+    // Returns msg decoded, or the message another subscription decoded for
+    // all of them.  NULL if it cannot be decoded.
+    static const MessageType *get(const lcm_recv_buf_t *rbuf, MessageType& msg)
+    {
+        return static_cast<const MessageType *>(lcm_recv_buf_decode(rbuf,
+                    MessageType::getHash(), decode, &msg));
+    }
+};
+
 template <class MessageType, class ContextClass>
 class LCMTypedSubscription : public Subscription {
     friend class LCM;
@@ -19,13 +166,45 @@ class LCMTypedSubscription : public Subscription {
         ContextClass context;
         void (*handler)(const ReceiveBuffer *rbuf, const std::string& channel,
                 const MessageType*msg, ContextClass context);
+        // decoded into for every message that no earlier subscription of
+        // the type decoded, so that its strings and vectors keep their
+        // capacity
+        MessageType msg;
         static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
                 void *user_data)
         {
             typedef LCMTypedSubscription<MessageType,ContextClass> SubsClass;
             SubsClass *subs = static_cast<SubsClass *> (user_data);
-            MessageType msg;
-            int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+            const MessageType *msg =
+                LCMSharedDecode<MessageType>::get(rbuf, subs->msg);
+            if (!msg)
+                return;
+            const ReceiveBuffer rb = {
+                rbuf->data,
+                rbuf->data_size,
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
+            };
+            subs->handler(&rb, channel, msg, subs->context);
+        }
+};
+
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class ContextClass>
+class LCMTypedMoveSubscription : public Subscription {
+    friend class LCM;
+    private:
+        ContextClass context;
+        void (*handler)(const ReceiveBuffer *rbuf, const std::string& channel,
+                MessageType&& msg, ContextClass context);
+        // decoded into for every message, unless the handler moved it away
+        MessageType msg;
+        static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
+                void *user_data)
+        {
+            typedef LCMTypedMoveSubscription<MessageType,ContextClass> SubsClass;
+            SubsClass *subs = static_cast<SubsClass *> (user_data);
+            int status = subs->msg.decode(rbuf->data, 0, rbuf->data_size);
             if (status < 0) {
                 fprintf (stderr, "error %d decoding %s!!!\n", status,
                         MessageType::getTypeName());
@@ -34,11 +213,13 @@ class LCMTypedSubscription : public Subscription {
             const ReceiveBuffer rb = {
                 rbuf->data,
                 rbuf->data_size,
-                rbuf->recv_utime
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
             };
-            subs->handler(&rb, channel, &msg, subs->context);
+            subs->handler(&rb, channel, std::move(subs->msg), subs->context);
         }
 };
+#endif
 
 template <class ContextClass>
 class LCMUntypedSubscription : public Subscription {
@@ -55,7 +236,8 @@ class LCMUntypedSubscription : public Subscription {
             const ReceiveBuffer rb = {
                 rbuf->data,
                 rbuf->data_size,
-                rbuf->recv_utime
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
             };
             subs->handler(&rb, channel, subs->context);
         }
@@ -67,13 +249,45 @@ class LCMMHSubscription : public Subscription {
     private:
         MessageHandlerClass* handler;
         void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel, const MessageType* msg);
+        // decoded into for every message that no earlier subscription of
+        // the type decoded, so that its strings and vectors keep their
+        // capacity
+        MessageType msg;
         static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
                 void *user_data)
         {
             LCMMHSubscription<MessageType,MessageHandlerClass> *subs =
                 static_cast<LCMMHSubscription<MessageType,MessageHandlerClass> *>(user_data);
-            MessageType msg;
-            int status = msg.decode(rbuf->data, 0, rbuf->data_size);
+            const MessageType *msg =
+                LCMSharedDecode<MessageType>::get(rbuf, subs->msg);
+            if (!msg)
+                return;
+            const ReceiveBuffer rb = {
+                rbuf->data,
+                rbuf->data_size,
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
+            };
+            std::string chan_str(channel);
+            (subs->handler->*subs->handlerMethod)(&rb, chan_str, msg);
+        }
+};
+
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class MessageHandlerClass>
+class LCMMHMoveSubscription : public Subscription {
+    friend class LCM;
+    private:
+        MessageHandlerClass* handler;
+        void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel, MessageType&& msg);
+        // decoded into for every message, unless the handler moved it away
+        MessageType msg;
+        static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
+                void *user_data)
+        {
+            LCMMHMoveSubscription<MessageType,MessageHandlerClass> *subs =
+                static_cast<LCMMHMoveSubscription<MessageType,MessageHandlerClass> *>(user_data);
+            int status = subs->msg.decode(rbuf->data, 0, rbuf->data_size);
             if (status < 0) {
                 fprintf (stderr, "error %d decoding %s!!!\n", status,
                         MessageType::getTypeName());
@@ -82,12 +296,14 @@ class LCMMHSubscription : public Subscription {
             const ReceiveBuffer rb = {
                 rbuf->data,
                 rbuf->data_size,
-                rbuf->recv_utime
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
             };
             std::string chan_str(channel);
-            (subs->handler->*subs->handlerMethod)(&rb, chan_str, &msg);
+            (subs->handler->*subs->handlerMethod)(&rb, chan_str, std::move(subs->msg));
         }
 };
+#endif
 
 template<class MessageHandlerClass>
 class LCMMHUntypedSubscription : public Subscription {
@@ -102,13 +318,96 @@ class LCMMHUntypedSubscription : public Subscription {
             const ReceiveBuffer rb = {
                 rbuf->data,
                 rbuf->data_size,
-                rbuf->recv_utime
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
             };
             std::string chan_str(channel);
             (subs->handler->*subs->handlerMethod)(&rb, chan_str);
         }
 };
 
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class Callable>
+class LCMCallableSubscription : public Subscription {
+    friend class LCM;
+    private:
+        template <class F>
+        explicit LCMCallableSubscription(F&& f) : callable(std::forward<F>(f)) {}
+
+        Callable callable;
+        // decoded into for every message that no earlier subscription of
+        // the type decoded, unless the callable moved it away
+        MessageType msg;
+        // the channel of the last message, assigned to only when it changes
+        std::string chan_str;
+
+        // callables that take a pointer get the message shared with the
+        // other subscriptions, and the others an rvalue reference to msg
+        template <class F>
+        static auto invoke(F& f, const lcm_recv_buf_t *rbuf,
+                const ReceiveBuffer *rb, const std::string& channel,
+                MessageType& msg, int)
+            -> decltype(f(rb, channel, static_cast<const MessageType*>(&msg)), void())
+        {
+            const MessageType *shared = LCMSharedDecode<MessageType>::get(rbuf,
+                    msg);
+            if (shared)
+                f(rb, channel, shared);
+        }
+        template <class F>
+        static void invoke(F& f, const lcm_recv_buf_t *rbuf,
+                const ReceiveBuffer *rb, const std::string& channel,
+                MessageType& msg, long)
+        {
+            if (LCMSharedDecode<MessageType>::decodeInto(rbuf, msg) >= 0)
+                f(rb, channel, std::move(msg));
+        }
+
+        static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
+                void *user_data)
+        {
+            typedef LCMCallableSubscription<MessageType, Callable> SubsClass;
+            SubsClass *subs = static_cast<SubsClass *>(user_data);
+            const ReceiveBuffer rb = {
+                rbuf->data,
+                rbuf->data_size,
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
+            };
+            if (subs->chan_str != channel)
+                subs->chan_str = channel;
+            invoke(subs->callable, rbuf, &rb, subs->chan_str, subs->msg, 0);
+        }
+};
+
+template <class Callable>
+class LCMCallableSubscription<void, Callable> : public Subscription {
+    friend class LCM;
+    private:
+        template <class F>
+        explicit LCMCallableSubscription(F&& f) : callable(std::forward<F>(f)) {}
+
+        Callable callable;
+        std::string chan_str;
+
+        static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
+                void *user_data)
+        {
+            typedef LCMCallableSubscription<void, Callable> SubsClass;
+            SubsClass *subs = static_cast<SubsClass *>(user_data);
+            const ReceiveBuffer rb = {
+                rbuf->data,
+                rbuf->data_size,
+                rbuf->recv_utime,
+                rbuf->recv_time_ns
+            };
+            if (subs->chan_str != channel)
+                subs->chan_str = channel;
+            subs->callable(&rb, subs->chan_str);
+        }
+};
+#endif
+
 inline
 LCM::LCM(std::string lcm_url):
 owns_lcm(true)
@@ -152,12 +451,75 @@ LCM::publish(const std::string& channel, const void *data, unsigned int datalen)
 template<class MessageType>
 inline int
 LCM::publish(const std::string& channel, const MessageType *msg) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to publish()\n");
+        return -1;
+    }
+    if(!lcm_publish_wanted(this->lcm, channel.c_str()))
+        return 0;
     unsigned int datalen = msg->getEncodedSize();
-    uint8_t *buf = new uint8_t[datalen];
-    msg->encode(buf, 0, datalen);
-    int status = this->publish(channel, buf, datalen);
-    delete[] buf;
-    return status;
+    uint8_t *buf = (uint8_t*) lcm_publish_reserve(this->lcm, channel.c_str(),
+            datalen);
+    if(!buf)
+        return -1;
+    int data_size = msg->encode(buf, 0, datalen);
+    if(data_size < 0) {
+        lcm_publish_cancel(this->lcm, buf);
+        return data_size;
+    }
+    return lcm_publish_commit(this->lcm, buf, data_size);
+}
+
+template<class MessageType>
+inline int
+LCM::publish(const std::string& channel, const MessageType *msg,
+        std::vector<uint8_t>& buf) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to publish()\n");
+        return -1;
+    }
+    unsigned int datalen = msg->getEncodedSize();
+    buf.resize(datalen);
+    int data_size = msg->encode(datalen ? &buf[0] : NULL, 0, datalen);
+    if(data_size < 0)
+        return data_size;
+    buf.resize(data_size);
+    return lcm_publish(this->lcm, channel.c_str(),
+            data_size ? &buf[0] : NULL, data_size);
+}
+
+inline int
+LCM::streamFlush(void *user, const void *data, int len) {
+    return lcm_publish_stream_write(static_cast<lcm_publish_stream_t*>(user),
+            data, len);
+}
+
+template<class MessageType>
+inline int
+LCM::publishStream(const std::string& channel, const MessageType *msg) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to publishStream()\n");
+        return -1;
+    }
+    lcm_publish_stream_t *stream = lcm_publish_stream_begin(this->lcm,
+            channel.c_str(), msg->getEncodedSize());
+    if(!stream)
+        return -1;
+    uint8_t buf[16384];
+    lcm_encode_stream_t es;
+    es.flush = streamFlush;
+    es.user = stream;
+    es.buf = buf;
+    es.capacity = sizeof(buf);
+    es.used = 0;
+    if(msg->encode(&es) < 0 || __lcm_stream_flush(&es) < 0) {
+        lcm_publish_stream_cancel(stream);
+        return -1;
+    }
+    return lcm_publish_stream_end(stream);
 }
 
 inline int
@@ -210,6 +572,26 @@ LCM::handleTimeout(int timeout_millis) {
     return lcm_handle_timeout(this->lcm, timeout_millis);
 }
 
+inline int
+LCM::handleBatch(int max_msgs, int timeout_millis) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to handleBatch()\n");
+        return -1;
+    }
+    return lcm_handle_batch(this->lcm, max_msgs, timeout_millis);
+}
+
+inline int
+LCM::handleReady(int max_msgs) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to handleReady()\n");
+        return -1;
+    }
+    return lcm_handle_batch(this->lcm, max_msgs, 0);
+}
+
 template <class MessageType, class MessageHandlerClass>
 Subscription*
 LCM::subscribe(const std::string& channel,
@@ -231,6 +613,29 @@ LCM::subscribe(const std::string& channel,
     return subs;
 }
 
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class MessageHandlerClass>
+Subscription*
+LCM::subscribe(const std::string& channel,
+    void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel, MessageType&& msg),
+    MessageHandlerClass* handler)
+{
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to subscribe()\n");
+        return NULL;
+    }
+    LCMMHMoveSubscription<MessageType, MessageHandlerClass> *subs =
+        new LCMMHMoveSubscription<MessageType, MessageHandlerClass>();
+    subs->handler = handler;
+    subs->handlerMethod = handlerMethod;
+    subs->c_subs = lcm_subscribe(this->lcm, channel.c_str(),
+            LCMMHMoveSubscription<MessageType, MessageHandlerClass>::cb_func, subs);
+    subscriptions.push_back(subs);
+    return subs;
+}
+#endif
+
 template <class MessageHandlerClass>
 Subscription*
 LCM::subscribe(const std::string& channel,
@@ -272,6 +677,62 @@ LCM::subscribeFunction(const std::string& channel,
     return sub;
 }
 
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class ContextClass>
+Subscription*
+LCM::subscribeFunction(const std::string& channel,
+        void (*handler)(const ReceiveBuffer *rbuf,
+            const std::string& channel,
+            MessageType&& msg, ContextClass context),
+        ContextClass context) {
+    if(!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribeFunction()\n");
+        return NULL;
+    }
+    typedef LCMTypedMoveSubscription<MessageType, ContextClass> SubsClass;
+    SubsClass *sub = new SubsClass();
+    sub->c_subs = lcm_subscribe(lcm, channel.c_str(), SubsClass::cb_func, sub);
+    sub->handler = handler;
+    sub->context = context;
+    subscriptions.push_back(sub);
+    return sub;
+}
+#endif
+
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType, class Callable>
+Subscription*
+LCM::subscribe(const std::string& channel, Callable&& callable) {
+    if(!this->lcm) {
+        fprintf(stderr,
+            "LCM instance not initialized.  Ignoring call to subscribe()\n");
+        return NULL;
+    }
+    typedef LCMCallableSubscription<MessageType,
+            typename std::decay<Callable>::type> SubsClass;
+    SubsClass *sub = new SubsClass(std::forward<Callable>(callable));
+    sub->c_subs = lcm_subscribe(lcm, channel.c_str(), SubsClass::cb_func, sub);
+    subscriptions.push_back(sub);
+    return sub;
+}
+
+template <class MessageType>
+MessageQueue<MessageType>*
+LCM::subscribeQueue(const std::string& channel, int capacity) {
+    if(!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to subscribeQueue()\n");
+        return NULL;
+    }
+    if(capacity <= 0)
+        return NULL;
+    MessageQueue<MessageType> *queue = new MessageQueue<MessageType>(capacity);
+    queue->c_subs = lcm_subscribe(lcm, channel.c_str(),
+            MessageQueue<MessageType>::cb_func, queue);
+    subscriptions.push_back(queue);
+    return queue;
+}
+#endif
+
 template <class ContextClass>
 Subscription*
 LCM::subscribeFunction(const std::string& channel,
@@ -293,6 +754,19 @@ LCM::subscribeFunction(const std::string& channel,
 }
 
 
+int
+LCM::setSlowHandlerThreshold(int64_t threshold_usec,
+        lcm_slow_handler_t callback, void *user_data)
+{
+    if(!this->lcm) {
+        fprintf(stderr, "LCM instance not initialized.  Ignoring call to "
+                "setSlowHandlerThreshold()\n");
+        return -1;
+    }
+    return lcm_set_slow_handler_threshold(this->lcm, threshold_usec, callback,
+            user_data);
+}
+
 lcm_t*
 LCM::getUnderlyingLCM()
 {
@@ -301,8 +775,35 @@ LCM::getUnderlyingLCM()
 
 LogFile::LogFile(const std::string & path, const std::string & mode) :
   eventlog(lcm_eventlog_create(path.c_str(), mode.c_str())),
-  last_event(NULL)
+  channel_capacity(0),
+  data_capacity(0)
 {
+    std::memset(&last_event, 0, sizeof(last_event));
+}
+
+LogFile::LogFile(const std::string & path, const std::string & mode,
+        int64_t queue_bytes, bool block) :
+  eventlog(lcm_eventlog_create_async(path.c_str(), mode.c_str(), queue_bytes,
+              block)),
+  channel_capacity(0),
+  data_capacity(0)
+{
+    std::memset(&last_event, 0, sizeof(last_event));
+}
+
+LogFile::LogFile(const std::string & path, const std::string & mode,
+        const std::string & channel_regex) :
+  eventlog(NULL),
+  channel_capacity(0),
+  data_capacity(0)
+{
+    std::memset(&last_event, 0, sizeof(last_event));
+    if(mode != "r") {
+        fprintf(stderr, "LogFile: channel filters need read mode\n");
+        return;
+    }
+    eventlog = lcm_eventlog_create_filtered(path.c_str(),
+            channel_regex.c_str());
 }
 
 LogFile::~LogFile()
@@ -310,9 +811,8 @@ LogFile::~LogFile()
     if(eventlog)
         lcm_eventlog_destroy(eventlog);
     eventlog = NULL;
-    if(last_event)
-        lcm_eventlog_free_event(last_event);
-    last_event = NULL;
+    std::free(last_event.channel);
+    std::free(last_event.data);
 }
 
 bool
@@ -324,18 +824,21 @@ LogFile::good() const
 const LogEvent*
 LogFile::readNextEvent()
 {
-    lcm_eventlog_event_t* evt = lcm_eventlog_read_next_event(eventlog);
-    if(last_event)
-        lcm_eventlog_free_event(last_event);
-    last_event = evt;
-    if(!evt)
-        return NULL;
-    curEvent.eventnum = evt->eventnum;
-    curEvent.timestamp = evt->timestamp;
-    curEvent.channel.assign(evt->channel, evt->channellen);
-    curEvent.datalen = evt->datalen;
-    curEvent.data = evt->data;
-    return &curEvent;
+    return readNextEvent(curEvent) ? &curEvent : NULL;
+}
+
+bool
+LogFile::readNextEvent(LogEvent& event)
+{
+    if(0 != lcm_eventlog_read_next_event_into(eventlog, &last_event,
+                &channel_capacity, &data_capacity))
+        return false;
+    event.eventnum = last_event.eventnum;
+    event.timestamp = last_event.timestamp;
+    event.channel.assign(last_event.channel, last_event.channellen);
+    event.datalen = last_event.datalen;
+    event.data = last_event.data;
+    return true;
 }
 
 int
@@ -344,6 +847,53 @@ LogFile::seekToTimestamp(int64_t timestamp)
     return lcm_eventlog_seek_to_timestamp(eventlog, timestamp);
 }
 
+LogFile::EventIterator&
+LogFile::EventIterator::operator++()
+{
+    if(0 != lcm_eventlog_read_next_event_into(log->eventlog, &log->last_event,
+                &log->channel_capacity, &log->data_capacity) ||
+            log->last_event.timestamp >= end_time) {
+        log = NULL;
+        return *this;
+    }
+    view.eventnum = log->last_event.eventnum;
+    view.timestamp = log->last_event.timestamp;
+    view.channel = log->last_event.channel;
+    view.channellen = log->last_event.channellen;
+    view.datalen = log->last_event.datalen;
+    view.data = log->last_event.data;
+    return *this;
+}
+
+LogFile::EventRange
+LogFile::openRange(int64_t start_time, int64_t end_time, bool seek)
+{
+    EventRange range;
+    if(!eventlog)
+        return range;
+    if(seek)
+        seekToTimestamp(start_time);
+    range.first.log = this;
+    range.first.end_time = end_time;
+    do {
+        ++range.first;
+    } while(seek && range.first.log && range.first.view.timestamp < start_time);
+    return range;
+}
+
+LogFile::EventRange
+LogFile::events()
+{
+    // timestamps are never this large
+    return openRange(0, (int64_t) (~0ULL >> 1), false);
+}
+
+LogFile::EventRange
+LogFile::events(int64_t start_time, int64_t end_time)
+{
+    return openRange(start_time, end_time, true);
+}
+
 int
 LogFile::writeEvent(LogEvent* event)
 {
@@ -357,6 +907,18 @@ LogFile::writeEvent(LogEvent* event)
     return lcm_eventlog_write_event(eventlog, &evt);
 }
 
+int
+LogFile::flush()
+{
+    return lcm_eventlog_flush(eventlog);
+}
+
+int
+LogFile::getAsyncStats(lcm_eventlog_async_stats_t* stats)
+{
+    return lcm_eventlog_get_async_stats(eventlog, stats);
+}
+
 FILE*
 LogFile::getFilePtr()
 {
@@ -3,8 +3,22 @@
 
 #include <string>
 #include <vector>
+#include <iterator>
 #include <cstdio>  /* needed for FILE* */
+#include <cstdlib>
+#include <cstring>
 #include "lcm.h"
+#include "lcm_coretypes.h"
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+#define LCM_CXX_11_ENABLED
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#endif
 
 namespace lcm {
 
@@ -21,6 +35,11 @@ namespace lcm {
 
 class Subscription;
 
+#ifdef LCM_CXX_11_ENABLED
+template <class MessageType>
+class MessageQueue;
+#endif
+
 struct ReceiveBuffer;
 
 /**
@@ -83,7 +102,8 @@ class LCM {
          * @brief Publishes a message with automatic message encoding.
          *
          * This template method is designed for use with C++ classes generated
-         * by lcm-gen.
+         * by lcm-gen.  The message is encoded into a buffer obtained from
+         * lcm_publish_reserve(), so in steady state it does not allocate.
          *
          * @param channel the channel to publish the message on.
          * @param msg the message to publish.
@@ -93,6 +113,43 @@ class LCM {
         template<class MessageType>
         inline int publish(const std::string& channel, const MessageType* msg);
 
+        /**
+         * @brief Publishes a message, encoding it into a caller-supplied
+         * buffer.
+         *
+         * Like publish(const std::string&, const MessageType*), but @p buf
+         * is grown as needed and holds the encoded message afterwards, for
+         * callers that also need the encoded bytes, e.g. to log them.
+         * Reusing the same buffer keeps its capacity between calls.
+         *
+         * @param channel the channel to publish the message on.
+         * @param msg the message to publish.
+         * @param buf the buffer to encode the message into.
+         *
+         * @return 0 on success, -1 on failure.
+         */
+        template<class MessageType>
+        inline int publish(const std::string& channel, const MessageType* msg,
+                std::vector<uint8_t>& buf);
+
+        /**
+         * @brief Publishes a message without encoding it into one buffer.
+         *
+         * Like publish(const std::string&, const MessageType*), but the
+         * message is encoded in pieces with lcm_publish_stream_begin(), so
+         * that a very large message is never held whole in encoded form.
+         * With the udpm provider, each fragment is transmitted as soon as it
+         * is encoded.
+         *
+         * @param channel the channel to publish the message on.
+         * @param msg the message to publish.
+         *
+         * @return 0 on success, -1 on failure.
+         */
+        template<class MessageType>
+        inline int publishStream(const std::string& channel,
+                const MessageType* msg);
+
         /**
          * @brief Returns a file descriptor or socket that can be used with
          * @c select(), @c poll(), or other event loops for asynchronous
@@ -130,6 +187,51 @@ class LCM {
          */
         inline int handleTimeout(int timeout_millis);
 
+        /**
+         * @brief Waits for a message, then dispatches up to @p max_msgs
+         * messages that have already been received.
+         *
+         * @return the number of messages handled, 0 if the function timed out,
+         * and <0 if an error occured.
+         * @sa lcm_handle_batch()
+         */
+        inline int handleBatch(int max_msgs, int timeout_millis);
+
+        /**
+         * @brief Dispatches up to @p max_msgs messages that have already
+         * been received, and never waits.
+         *
+         * This is meant for event loops that watch the file descriptor of
+         * getFileno() along with others, so that one thread can drive many
+         * %LCM instances.  The limit keeps a busy instance from starving the
+         * rest of the loop; messages beyond it stay queued, and the file
+         * descriptor stays readable.  With asio, for example:
+         *
+         * @code
+         * asio::posix::stream_descriptor fd(io, lcm.getFileno());
+         * std::function<void()> wait = [&]() {
+         *     fd.async_wait(asio::posix::stream_descriptor::wait_read,
+         *         [&](const std::error_code& ec) {
+         *             if (!ec) {
+         *                 lcm.handleReady();
+         *                 wait();
+         *             }
+         *         });
+         * };
+         * wait();
+         * io.run();
+         * @endcode
+         *
+         * The descriptor belongs to the %LCM instance, and must be released
+         * from the event loop without closing it, e.g. with asio's
+         * @c release().
+         *
+         * @return the number of messages handled, which is 0 if none were
+         * available, or <0 if an error occured.
+         * @sa lcm_handle_batch()
+         */
+        inline int handleReady(int max_msgs = 100);
+
         /**
          * @brief Subscribes a callback method of an object to a channel, with
          * automatic message decoding.
@@ -143,7 +245,12 @@ class LCM {
          * message type @c MessageType @c , which should be a class generated
          * by @c lcm-gen @c .  If message
          * decoding fails, the callback method is not invoked and an error
-         * message is printed to stderr.
+         * message is printed to stderr.  The subscription decodes every
+         * message into the same object, so the message passed to the
+         * callback method is only valid until the method returns.  When
+         * several subscriptions of the same @c MessageType receive a
+         * message in the same call to handle(), it is decoded only once,
+         * into the object of the first, and they are all passed that.
          *
          * The callback method is invoked during calls to LCM::handle().
          * Callback methods are invoked by the same thread that invokes
@@ -241,6 +348,26 @@ class LCM {
             void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel),
             MessageHandlerClass* handler);
 
+#ifdef LCM_CXX_11_ENABLED
+        /**
+         * @brief Subscribe a callback method of an object to a channel, with
+         * automatic message decoding, passing the decoded message by rvalue
+         * reference.
+         *
+         * Like subscribe(const std::string&, void (MessageHandlerClass::*)(const ReceiveBuffer*, const std::string&, const MessageType*), MessageHandlerClass*),
+         * but the callback may move the message, e.g. into a queue for
+         * another thread, without copying its strings and vectors.  A
+         * message that the callback leaves in place is decoded into for the
+         * next message, as before.
+         *
+         * Requires C++11.
+         */
+        template <class MessageType, class MessageHandlerClass>
+        Subscription* subscribe(const std::string& channel,
+            void (MessageHandlerClass::*handlerMethod)(const ReceiveBuffer* rbuf, const std::string& channel, MessageType&& msg),
+            MessageHandlerClass* handler);
+#endif
+
         /**
          * @brief Subscribe a function callback to a channel, with automatic
          * message decoding.
@@ -253,7 +380,12 @@ class LCM {
          * will attempt to automatically decode the message to the specified
          * message type @c MessageType @c , which should be a class generated
          * by @c lcm-gen @c .  If message decoding fails, the callback function
-         * is not invoked and an error message is printed to stderr.
+         * is not invoked and an error message is printed to stderr.  The
+         * subscription decodes every message into the same object, so the
+         * message passed to the callback is only valid until it returns.
+         * When several subscriptions of the same @c MessageType receive a
+         * message in the same call to handle(), it is decoded only once,
+         * into the object of the first, and they are all passed that.
          *
          * The callback function is invoked during calls to LCM::handle().
          * Callbacks are invoked by the same thread that invokes
@@ -346,6 +478,26 @@ class LCM {
          * the LCM class, and is automatically destroyed when its LCM instance
          * is destroyed.
          */
+#ifdef LCM_CXX_11_ENABLED
+        /**
+         * @brief Subscribe a function callback to a channel, with automatic
+         * message decoding, passing the decoded message by rvalue reference.
+         *
+         * Like subscribeFunction(const std::string&, void (*)(const ReceiveBuffer*, const std::string&, const MessageType*, ContextClass), ContextClass),
+         * but the callback may move the message without copying its strings
+         * and vectors.
+         *
+         * Requires C++11.
+         */
+        template <class MessageType, class ContextClass>
+        Subscription* subscribeFunction(const std::string& channel,
+                void (*handler)(const ReceiveBuffer* rbuf,
+                                const std::string& channel,
+                                MessageType&& msg,
+                                ContextClass context),
+                ContextClass context);
+#endif
+
         template <class ContextClass>
         Subscription* subscribeFunction(const std::string& channel,
                 void (*handler)(const ReceiveBuffer* rbuf,
@@ -353,6 +505,86 @@ class LCM {
                                 ContextClass context),
                 ContextClass context);
 
+#ifdef LCM_CXX_11_ENABLED
+        /**
+         * @brief Subscribe a callable object, such as a capturing lambda, to
+         * a channel, with automatic message decoding.
+         *
+         * The callable is stored by value in the subscription, so calling
+         * it takes no std::function and no allocation.  Each message is
+         * decoded into the same @c MessageType instance, as with
+         * subscribeFunction(), and the callable is invoked as
+         * @c callable(rbuf, channel, msg).  @c msg is a
+         * <tt>const MessageType*</tt> if the callable takes one, which is
+         * shared with the other subscriptions of that type, or else a
+         * <tt>MessageType&&</tt> that it may move away.  With no
+         * @c MessageType, the message is not decoded and the callable is
+         * invoked as @c callable(rbuf, channel).
+         *
+         * For example:
+         *
+         * \code
+         * int count = 0;
+         * lcm.subscribe<exlcm::example_t>("EXAMPLE",
+         *     [&count](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+         *              const exlcm::example_t* msg) { count++; });
+         * \endcode
+         *
+         * Requires C++11.
+         *
+         * @param channel The channel to subscribe to.  This is treated as a
+         * regular expression implicitly surrounded by '^' and '$'.
+         * @param callable The callback, which is moved or copied into the
+         * subscription.
+         *
+         * @return a Subscription object that can be used to adjust the
+         * subscription and unsubscribe.  The Subscription object is managed by
+         * the LCM class, and is automatically destroyed when its LCM instance
+         * is destroyed, along with the callable.
+         */
+        template <class MessageType = void, class Callable>
+        Subscription* subscribe(const std::string& channel, Callable&& callable);
+#endif
+
+#ifdef LCM_CXX_11_ENABLED
+        /**
+         * @brief Subscribe a queue of decoded messages to a channel, for a
+         * thread of its own to take them from.
+         *
+         * Messages are decoded by the thread that calls handle(), and passed
+         * to the consumer thread through a lock-free ring of @p capacity
+         * messages, which is allocated up front.  The messages are swapped
+         * in and out of the ring, so their strings and vectors are not
+         * copied.  When the ring is full, new messages are dropped and
+         * counted.
+         *
+         * Example usage:
+         * @code
+         * lcm::MessageQueue<exlcm::example_t>* queue =
+         *     lcm.subscribeQueue<exlcm::example_t>("EXAMPLE", 100);
+         *
+         * // on the consumer thread
+         * exlcm::example_t msg;
+         * while (queue->popWait(msg, -1)) {
+         *     ...
+         * }
+         * @endcode
+         *
+         * Requires C++11.
+         *
+         * @param channel The channel to subscribe to.  This is treated as a
+         * regular expression implicitly surrounded by '^' and '$'.
+         * @param capacity The number of messages that the ring holds.
+         *
+         * @return the queue, or NULL if @p capacity is not positive.  It is
+         * unsubscribed with unsubscribe(), once the consumer thread no longer
+         * uses it.
+         */
+        template <class MessageType>
+        MessageQueue<MessageType>* subscribeQueue(const std::string& channel,
+                int capacity);
+#endif
+
         /**
          * @brief Unsubscribes a message handler.
          *
@@ -369,6 +601,23 @@ class LCM {
          */
         inline int unsubscribe(Subscription* subscription);
 
+        /**
+         * @brief Reports message handlers that run for too long.
+         *
+         * @param threshold_usec handler calls that take at least this many
+         * microseconds are reported.  0 stops reporting them.
+         * @param callback called after each slow handler call, from the
+         * thread that ran it.  If NULL, a warning is printed on stderr
+         * instead, at most once a second for each subscription.
+         * @param user_data passed to @p callback
+         *
+         * @return 0 on success, -1 if @p threshold_usec is out of range
+         *
+         * @sa lcm_set_slow_handler_threshold()
+         */
+        inline int setSlowHandlerThreshold(int64_t threshold_usec,
+                lcm_slow_handler_t callback = NULL, void *user_data = NULL);
+
         /**
          * @brief retrives the lcm_t C data structure wrapped by this class.
          *
@@ -386,6 +635,8 @@ class LCM {
         lcm_t *lcm;
         bool owns_lcm;
 
+        inline static int streamFlush(void *user, const void *data, int len);
+
         std::vector<Subscription*> subscriptions;
 };
 
@@ -408,6 +659,62 @@ struct ReceiveBuffer {
      * microseconds since the UNIX epoch.
      */
     int64_t recv_utime;
+    /**
+     * Same as recv_utime, in nanoseconds.  Only has more than microsecond
+     * resolution if the provider was configured for finer timestamps.
+     */
+    int64_t recv_time_ns;
+};
+
+/**
+ * @brief Queueing and dispatch statistics for a subscription.
+ *
+ * @sa Subscription::getStats(), lcm_subscription_get_stats()
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+struct SubscriptionStats {
+    /**
+     * Number of messages accepted into the subscription's queue.
+     */
+    int64_t num_enqueued;
+    /**
+     * Number of messages passed to the subscription's handler.
+     */
+    int64_t num_dispatched;
+    /**
+     * Number of messages discarded because the queue was full.
+     */
+    int64_t num_dropped;
+    /**
+     * Largest number of messages that have been queued at once.
+     */
+    int peak_queue_depth;
+    /**
+     * Total time spent in the handler, in microseconds.
+     */
+    int64_t handler_time_usec;
+    /**
+     * Longest time that one call of the handler took, in microseconds.
+     */
+    int64_t max_handler_time_usec;
+    /**
+     * Number of handler calls by how long they took, in buckets of powers
+     * of two microseconds.
+     *
+     * @sa lcm_subscription_stats_t::handler_time_histogram
+     */
+    int64_t handler_time_histogram[LCM_HANDLER_HISTOGRAM_BUCKETS];
+    /**
+     * Number of handler calls that took at least the threshold set with
+     * LCM::setSlowHandlerThreshold().
+     */
+    int64_t num_slow;
+    /**
+     * Number of messages skipped to keep to the rate set with
+     * Subscription::setMaxRate().
+     */
+    int64_t num_decimated;
 };
 
 /**
@@ -443,6 +750,43 @@ class Subscription {
          */
         inline int setQueueCapacity(int num_messages);
 
+        /**
+         * @brief Delivers only the newest queued message to this
+         * subscription, dropping older ones that were not dispatched yet.
+         *
+         * @sa lcm_subscription_set_conflate()
+         */
+        inline int setConflate(bool conflate);
+
+        /**
+         * @brief Sets the priority with which messages are dispatched to
+         * this subscription.  Higher values are dispatched first.
+         *
+         * @sa lcm_subscription_set_priority()
+         */
+        inline int setPriority(int priority);
+
+        /**
+         * @brief Limits this subscription to at most @p max_rate_hz messages
+         * per second, skipping the others as they are received.  0 takes
+         * every message.
+         *
+         * @sa lcm_subscription_set_max_rate()
+         */
+        inline int setMaxRate(double max_rate_hz);
+
+        /**
+         * @brief Retrieves queueing and dispatch statistics for this
+         * subscription.
+         *
+         * Use this to size the queue with setQueueCapacity(): a non-zero
+         * @c num_dropped means the handler is not keeping up at the current
+         * capacity.
+         *
+         * @sa lcm_subscription_get_stats()
+         */
+        inline SubscriptionStats getStats() const;
+
     friend class LCM;
     protected:
         Subscription() {};
@@ -453,6 +797,70 @@ class Subscription {
         lcm_subscription_t *c_subs;
 };
 
+#ifdef LCM_CXX_11_ENABLED
+/**
+ * @brief A subscription that queues decoded messages for another thread.
+ *
+ * Constructed and returned by LCM::subscribeQueue().  The thread that calls
+ * LCM::handle() puts messages into the queue, and one other thread at a
+ * time takes them out with tryPop() or popWait().  Neither of them takes a
+ * lock, unless the consumer waits for a message.
+ *
+ * Requires C++11.
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+template <class MessageType>
+class MessageQueue : public Subscription {
+    public:
+        /**
+         * @brief Takes the oldest queued message, without waiting.
+         *
+         * @param msg receives the message.  Its previous contents are
+         * swapped into the queue, to be decoded into later.
+         *
+         * @return true if there was a message.
+         */
+        inline bool tryPop(MessageType& msg);
+
+        /**
+         * @brief Takes the oldest queued message, waiting for one if the
+         * queue is empty.
+         *
+         * @param msg receives the message, as with tryPop().
+         * @param timeout_millis the longest time to wait, in milliseconds,
+         * or -1 to wait until a message arrives.
+         *
+         * @return true if there was a message, false on timeout.
+         */
+        inline bool popWait(MessageType& msg, int timeout_millis);
+
+        /**
+         * @brief The number of messages that were dropped because the queue
+         * was full.
+         */
+        inline int64_t getNumDropped() const;
+
+    friend class LCM;
+    private:
+        explicit MessageQueue(int capacity);
+
+        static void cb_func(const lcm_recv_buf_t *rbuf, const char *channel,
+                void *user_data);
+
+        // slot i % capacity holds message i, for head <= i < tail
+        std::vector<MessageType> slots;
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        std::atomic<int64_t> num_dropped;
+
+        // only used while the consumer waits in popWait()
+        std::atomic<bool> waiting;
+        std::mutex mutex;
+        std::condition_variable cond;
+};
+#endif
+
 /**
  * @brief Represents a single event (message) in a log file.
  *
@@ -489,6 +897,43 @@ struct LogEvent {
     void* data;
 };
 
+/**
+ * @brief An event of a log file, as read by LogFile::events().
+ *
+ * The channel and data point into buffers that the LogFile reuses for the
+ * next event.
+ *
+ * @headerfile lcm/lcm-cpp.hpp
+ */
+struct LogEventView {
+    /**
+     * Monotically increasing counter identifying the event number.
+     */
+    int64_t eventnum;
+    /**
+     * Timestamp identifying when the event was received.  Represented in
+     * microseconds since the UNIX epoch.
+     */
+    int64_t timestamp;
+    /**
+     * The channel on which the message was received, followed by a NUL
+     * byte.
+     */
+    const char* channel;
+    /**
+     * The length of the channel, in bytes.
+     */
+    int32_t channellen;
+    /**
+     * The length of the message payload, in bytes.
+     */
+    int32_t datalen;
+    /**
+     * The message payload.
+     */
+    const void* data;
+};
+
 /**
  * @brief Read and write %LCM log files.
  *
@@ -509,6 +954,36 @@ class LogFile {
          */
         inline LogFile(const std::string & path, const std::string & mode);
 
+        /**
+         * Constructor.  Opens the specified log file for writing from a
+         * thread of its own, so that writeEvent() does not wait for the
+         * disk.
+         * @param path the file to open
+         * @param mode "w" (write mode) or "a" (append mode)
+         * @param queue_bytes how many bytes of events may wait to be written
+         * @param block whether writeEvent() waits for room in a full queue,
+         * instead of dropping the event
+         *
+         * @sa lcm_eventlog_create_async()
+         */
+        inline LogFile(const std::string & path, const std::string & mode,
+                int64_t queue_bytes, bool block);
+
+        /**
+         * Constructor.  Opens the specified log file for reading only the
+         * events on channels that match @p channel_regex.  If the log has an
+         * index, blocks of events on other channels are skipped without
+         * reading them.
+         * @param path the file to open
+         * @param mode "r" (read mode)
+         * @param channel_regex which channels to read, as a regular
+         * expression implicitly surrounded by '^' and '$'
+         *
+         * @sa lcm_eventlog_create_filtered()
+         */
+        inline LogFile(const std::string & path, const std::string & mode,
+                const std::string & channel_regex);
+
         /**
          * Destructor.  Closes the log file.
          */
@@ -530,6 +1005,22 @@ class LogFile {
          */
         inline const LogEvent* readNextEvent();
 
+        /**
+         * Reads the next event in the log file into @p event.  Valid in read
+         * mode only.
+         *
+         * The channel is assigned to @p event.channel, which reuses the
+         * string's storage, and @p event.data points to a buffer that the
+         * LogFile reuses for every event, so that reading a log this way
+         * does not allocate memory for each event.  The data are valid until
+         * the next call to either readNextEvent() method.
+         *
+         * @return true on success, or false if the end of the log file has
+         * been reached.
+         * @sa lcm_eventlog_read_next_event_into()
+         */
+        inline bool readNextEvent(LogEvent& event);
+
         /**
          * Seek close to the specified timestamp in the log file.  Valid
          * in read mode only.
@@ -541,6 +1032,84 @@ class LogFile {
          */
         inline int seekToTimestamp(int64_t timestamp);
 
+        /**
+         * @brief An input iterator over the events of a log file, see
+         * events().
+         *
+         * All iterators of a LogFile share its read position, so the events
+         * can be read only once.  Incrementing an iterator invalidates the
+         * view of the previous event.
+         */
+        class EventIterator {
+            public:
+                typedef std::input_iterator_tag iterator_category;
+                typedef LogEventView value_type;
+                typedef std::ptrdiff_t difference_type;
+                typedef const LogEventView* pointer;
+                typedef const LogEventView& reference;
+
+                EventIterator() : log(NULL), end_time(0) {}
+
+                const LogEventView& operator*() const { return view; }
+                const LogEventView* operator->() const { return &view; }
+                inline EventIterator& operator++();
+
+                /**
+                 * Iterators are equal when both are past the end of their
+                 * range, or both read from the same LogFile.
+                 */
+                bool operator==(const EventIterator& o) const { return log == o.log; }
+                bool operator!=(const EventIterator& o) const { return log != o.log; }
+
+            private:
+                friend class LogFile;
+                LogFile* log;
+                int64_t end_time;
+                LogEventView view;
+        };
+
+        /**
+         * @brief The events of a log file that are read by a range-based
+         * for loop, see events().
+         */
+        class EventRange {
+            public:
+                EventIterator begin() const { return first; }
+                EventIterator end() const { return EventIterator(); }
+
+            private:
+                friend class LogFile;
+                EventIterator first;
+        };
+
+        /**
+         * Reads the remaining events of the log file, without allocating
+         * memory for each event.  Valid in read mode only.
+         *
+         * @code
+         * lcm::LogFile log("example.log", "r", "POSE.*");
+         * for (const lcm::LogEventView& event : log.events()) {
+         *     ...
+         * }
+         * @endcode
+         */
+        inline EventRange events();
+
+        /**
+         * Reads the events of the log file from @p start_time until
+         * @p end_time.  Valid in read mode only.
+         *
+         * Seeks to @p start_time first, which reads only a small part of the
+         * log if it has an index, and then skips any events before it.  The
+         * range ends at the first event at or after @p end_time.
+         *
+         * @param start_time the timestamp of the first event
+         * @param end_time the timestamp that ends the range
+         *
+         * @sa seekToTimestamp()
+         */
+        inline EventRange events(int64_t start_time, int64_t end_time);
+
         /**
          * Writes an event to the log file.  Valid in write mode only.
          *
@@ -553,6 +1122,25 @@ class LogFile {
          */
         inline int writeEvent(LogEvent* event);
 
+        /**
+         * Writes any buffered events to the file, and flushes the file.  For
+         * an asynchronous log, waits for the queued events to be written.
+         *
+         * @return 0 on success, -1 on error.
+         * @sa lcm_eventlog_flush()
+         */
+        inline int flush();
+
+        /**
+         * Retrieves the counters of an asynchronous log.
+         *
+         * @param stats filled in with a snapshot of the counters
+         *
+         * @return 0 on success, -1 if the log is not asynchronous.
+         * @sa lcm_eventlog_get_async_stats()
+         */
+        inline int getAsyncStats(lcm_eventlog_async_stats_t* stats);
+
         /**
          * @brief retrives the underlying FILE* wrapped by this class.
          *
@@ -568,7 +1156,12 @@ class LogFile {
     private:
         LogEvent curEvent;
         lcm_eventlog_t* eventlog;
-        lcm_eventlog_event_t* last_event;
+        lcm_eventlog_event_t last_event;  // buffers reused for every event
+        int32_t channel_capacity;
+        int32_t data_capacity;
+
+        inline EventRange openRange(int64_t start_time, int64_t end_time,
+                bool seek);
 };
 
 /**
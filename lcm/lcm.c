@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <assert.h>
 
@@ -9,31 +10,202 @@
 
 #include "lcm.h"
 #include "lcm_internal.h"
+#include "lcm_clock.h"
+#include "lcm_trace.h"
+#include "channel_matcher.h"
 #include "dbg.h"
+#include "lcmtypes/lcm_stats_report_t.h"
 
 #ifdef WIN32
 #include "windows/WinPorting.h"
 #include <winsock2.h>
+#include <process.h>
+#define poll WSAPoll
+#define getpid _getpid
+typedef WSAPOLLFD lcm_pollfd_t;
 #else
-#include <sys/select.h>
+#include <poll.h>
+#include <unistd.h>
 typedef int SOCKET;
+typedef struct pollfd lcm_pollfd_t;
 #endif
 
 #define LCM_DEFAULT_URL "udpm://239.255.76.67:7667?ttl=0"
 
+// number of released publish buffers kept around for reuse
+#define LCM_MAX_CACHED_PUBLISH_BUFS 4
+
+// default cap on the asynchronous publish queue, in megabytes
+#define LCM_DEFAULT_TX_QUEUE_MB 64
+
+// the most channels given an ID by lcm_internal_channel_id().  Channel names
+// come from the network, so the table must not grow without bound.
+#define LCM_MAX_CHANNEL_IDS 65536
+
+// An immutable list of the handlers subscribed to one channel.  Lists are
+// never modified once published in a handler table; subscribe and unsubscribe
+// build new lists instead.  Each list holds a reference on its handlers.
+typedef struct _lcm_handler_list lcm_handler_list_t;
+struct _lcm_handler_list {
+    int ref;
+    char *channel;
+    unsigned int num_handlers;
+    lcm_subscription_t *handlers[];
+};
+
+// A snapshot of the channel name -> lcm_handler_list_t* map.  The current
+// snapshot is read without holding any lock; writers copy it, modify the
+// copy, and swap it in.  Replaced snapshots are retired and freed once no
+// reader can still be looking at them.
+typedef struct _lcm_handler_table lcm_handler_table_t;
+struct _lcm_handler_table {
+    GHashTable *map;  // keys are owned by the lists
+    // the lists of map by channel ID (see lcm_internal_channel_id()), for
+    // the channels looked up by ID so far.  The lists are those of map, and
+    // hold no reference of their own.
+    lcm_handler_list_t **by_id;
+    int num_ids;
+    lcm_handler_table_t *next_retired;
+};
+
+// A buffer handed out by lcm_publish_reserve().  The caller's payload
+// immediately follows the struct.
+typedef struct _lcm_publish_buf lcm_publish_buf_t;
+struct _lcm_publish_buf {
+    lcm_publish_buf_t *next;  // in lcm_t::publish_bufs or the publish queue
+    unsigned int capacity;    // payload bytes allocated
+    unsigned int datalen;     // payload bytes to publish, while queued
+    char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+};
+
 struct _lcm_t {
     GStaticRecMutex mutex;  // guards data structures
     GStaticRecMutex handle_mutex;  // only one thread allowed in lcm_handle at a time
 
     GPtrArray   *handlers_all;  // list containing *all* handlers
-    GHashTable  *handlers_map;  // map of channel name (string) to GPtrArray 
-                                // of matching handlers (lcm_subscription_t*)
+    lcm_channel_matcher_t *matcher;  // index of handlers_all by channel pattern
+
+    lcm_handler_table_t *handlers_table;  // current snapshot, atomic access
+    int table_readers;  // number of threads looking up handlers_table
+    lcm_handler_table_t *retired_tables;  // guarded by mutex
+    // the subscriptions whose priority is not 0.  Changed under mutex, read
+    // atomically.
+    int num_prioritized;
+    // the conflating subscriptions, likewise
+    int num_conflating;
 
     lcm_provider_vtable_t * vtable;
     lcm_provider_t * provider;
 
     int default_max_num_queued_messages;
     int in_handle;
+
+    // see lcm_internal_set_dispatch_tap()
+    lcm_msg_handler_t dispatch_tap;
+    void *dispatch_tap_user;
+
+    // dispatch thread pool, only used when the dispatch_threads URL option is
+    // given.  Subscriptions with undelivered messages wait in
+    // dispatch_runnable until a worker picks them up.  A subscription is in
+    // dispatch_runnable or being run by a worker, never both, so its messages
+    // are delivered in order.
+    int num_dispatch_threads;
+    GThread **dispatch_threads;
+    GMutex *dispatch_mutex;  // guards all dispatch_* and pool_* state
+    GCond *dispatch_cond;
+    GQueue *dispatch_runnable;
+    int dispatch_exit;
+
+    GStaticMutex publish_bufs_lock;  // guards publish_bufs
+    lcm_publish_buf_t *publish_bufs;  // buffers ready for lcm_publish_reserve
+
+    GStaticMutex self_test_lock;  // guards the self_test_* fields
+    int self_test_status;
+    lcm_self_test_handler_t self_test_handler;
+    void *self_test_user;
+
+    int slow_handler_usec;  // 0 if disabled, atomic access
+    GStaticMutex slow_handler_lock;  // guards the slow_handler_* fields
+    lcm_slow_handler_t slow_handler_cb;
+    void *slow_handler_user;
+    int num_publish_bufs;
+
+    // asynchronous publish queue, only used when the async_tx URL option is
+    // given.  lcm_publish() and lcm_publish_commit() append publish buffers
+    // to tx_head..tx_tail, and tx_thread hands them to the provider.
+    GThread *tx_thread;
+    GMutex *tx_mutex;  // guards all tx_* state
+    GCond *tx_cond;  // signalled when a message is queued or tx_exit is set
+    GCond *tx_space_cond;  // signalled when a message leaves the queue
+    lcm_publish_buf_t *tx_head;
+    lcm_publish_buf_t *tx_tail;
+    int64_t tx_queue_cap;  // bytes
+    int tx_block;  // wait for room instead of dropping when the queue is full
+    int tx_exit;
+    lcm_publish_queue_stats_t tx_stats;
+
+    // the counters of lcm_stats_t kept here rather than by the provider or
+    // the publish queue
+    GStaticMutex stats_lock;  // guards stats
+    lcm_stats_t stats;
+
+    // publishes the stats every stats_interval_ms, only used when the
+    // stats_interval URL option is given
+    GThread *stats_thread;
+    GMutex *stats_mutex;  // guards stats_exit
+    GCond *stats_cond;  // signalled when stats_exit is set
+    int stats_interval_ms;
+    int stats_exit;
+
+    // the skip_unsubscribed URL option: messages that nobody subscribes to
+    // are not transmitted
+    int skip_unsubscribed;
+};
+
+// the number of message types that a dispatch shares between its handlers.
+// Past that, the handlers decode the other types on their own.
+#define LCM_MAX_SHARED_DECODES 8
+
+// A message decoded by one of the handlers of a dispatch into its own object,
+// for the handlers of the other subscriptions of the same type (see
+// lcm_recv_buf_decode()).
+typedef struct _lcm_decoded lcm_decoded_t;
+struct _lcm_decoded {
+    lcm_subscription_t *owner;  // msg lives in its handler's user data
+    int64_t type_hash;
+    int (*decode) (const lcm_recv_buf_t *rbuf, void *msg);
+    const void *msg;        // NULL if it could not be decoded
+};
+
+// The messages decoded while dispatching one received message to several
+// subscriptions.  rbuf->decoded points at it while the handlers run.
+typedef struct _lcm_decode_cache lcm_decode_cache_t;
+struct _lcm_decode_cache {
+    lcm_subscription_t *handler;  // the one being invoked
+    unsigned int num_decoded;
+    lcm_decoded_t decoded[LCM_MAX_SHARED_DECODES];
+};
+
+// A copy of a received message, shared by the subscriptions it is queued on
+// when dispatching in the thread pool.
+typedef struct _lcm_pooled_msg lcm_pooled_msg_t;
+struct _lcm_pooled_msg {
+    lcm_recv_buf_owner_t owner;  // the loan holds the references to the msg
+    lcm_recv_buf_t rbuf;
+    char *channel;
+};
+
+// Storage taken over by lcm_recv_buf_retain(), freed with the last reference.
+struct _lcm_recv_buf_loan {
+    int ref;
+    void *block;
+};
+
+// A buffer handed out by lcm_recv_buf_retain()
+typedef struct _lcm_retained_buf lcm_retained_buf_t;
+struct _lcm_retained_buf {
+    lcm_recv_buf_t rbuf;
+    lcm_recv_buf_owner_t owner;
 };
 
 struct _lcm_subscription_t {
@@ -41,12 +213,33 @@ struct _lcm_subscription_t {
     lcm_msg_handler_t  handler;
     void             *userdata;
     lcm_t* lcm;
-    GRegex * regex;
-    int callback_scheduled;
+    lcm_channel_pattern_t * pattern;
+    int ref;  // held by handlers_all and by each lcm_handler_list_t
     int marked_for_deletion;
 
     int max_num_queued_messages;
     int num_queued_messages;
+    int conflate;  // only deliver the newest queued message, atomic access
+    // while conflating, the messages that a provider queued with
+    // lcm_defer_enqueue_message() and has not yet passed to
+    // lcm_try_enqueue_message(), atomic access
+    int num_deferred;
+    int priority;  // see lcm_subscription_set_priority(), atomic access
+    // see lcm_subscription_set_max_rate().  rate_limited is read atomically,
+    // the rest is guarded by stats_lock.
+    int rate_limited;
+    int64_t rate_interval_ns;
+    int64_t rate_next_ns;  // on lcm_clock_fast_ns(), when the next is due
+
+    GQueue *pool_msgs;  // lcm_pooled_msg_t* waiting for a dispatch thread
+    int num_pool_msgs;  // length of pool_msgs, atomic access
+    int pool_scheduled; // in dispatch_runnable or being run
+
+    GStaticMutex stats_lock;  // guards stats, handler_time_ns, slow_warn_utime
+                              // and the rate_* fields
+    lcm_subscription_stats_t stats;
+    int64_t handler_time_ns;  // stats.handler_time_usec, unrounded
+    int64_t slow_warn_utime;  // when the last slow handler warning was printed
 };
 
 extern void lcm_udpm_provider_init (GPtrArray * providers);
@@ -54,6 +247,46 @@ extern void lcm_logprov_provider_init (GPtrArray * providers);
 extern void lcm_tcpq_provider_init (GPtrArray * providers);
 extern void lcm_mpudpm_provider_init(GPtrArray * providers);
 extern void lcm_memq_provider_init(GPtrArray * providers);
+extern void lcm_inproc_provider_init(GPtrArray * providers);
+extern void lcm_shm_provider_init(GPtrArray * providers);
+extern void lcm_shared_provider_init(GPtrArray * providers);
+extern void lcm_hybrid_provider_init(GPtrArray * providers);
+
+static void dispatch_pool_start (lcm_t *lcm, int num_threads);
+static void dispatch_pool_stop (lcm_t *lcm);
+static void tx_queue_start (lcm_t *lcm, int queue_mb, int block);
+static void tx_queue_stop (lcm_t *lcm);
+static void stats_publisher_start (lcm_t *lcm, int interval_ms);
+static void stats_publisher_stop (lcm_t *lcm);
+static void publish_buf_put (lcm_t *lcm, lcm_publish_buf_t *pb);
+
+// the providers never change, so their list is built once per process
+static GStaticMutex providers_lock = G_STATIC_MUTEX_INIT;
+static GPtrArray *providers_list = NULL;
+
+// channel name -> GINT_TO_POINTER (1 + ID), shared by all the instances
+static GStaticMutex channel_ids_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *channel_ids = NULL;
+
+static GPtrArray *
+get_providers (void)
+{
+    g_static_mutex_lock (&providers_lock);
+    if (!providers_list) {
+        providers_list = g_ptr_array_new ();
+        lcm_udpm_provider_init (providers_list);
+        lcm_logprov_provider_init (providers_list);
+        lcm_tcpq_provider_init (providers_list);
+        lcm_mpudpm_provider_init (providers_list);
+        lcm_memq_provider_init (providers_list);
+        lcm_inproc_provider_init (providers_list);
+        lcm_shm_provider_init (providers_list);
+        lcm_shared_provider_init (providers_list);
+        lcm_hybrid_provider_init (providers_list);
+    }
+    g_static_mutex_unlock (&providers_lock);
+    return providers_list;
+}
 
 lcm_t * 
 lcm_create (const char *url)
@@ -71,15 +304,9 @@ lcm_create (const char *url)
     char * network = NULL;
     GHashTable * args = g_hash_table_new_full (g_str_hash, g_str_equal,
             free, free);
-    GPtrArray * providers = g_ptr_array_new ();
+    GPtrArray * providers = get_providers ();
     lcm_t *lcm = NULL;
 
-    // initialize the list of providers
-    lcm_udpm_provider_init (providers);
-    lcm_logprov_provider_init (providers);
-    lcm_tcpq_provider_init (providers);
-    lcm_mpudpm_provider_init (providers);
-    lcm_memq_provider_init (providers);
     if (providers->len == 0) {
         fprintf (stderr, "Error: no LCM providers found\n");
         goto fail;
@@ -96,6 +323,82 @@ lcm_create (const char *url)
         goto fail;
     }
 
+    // options handled here rather than by the provider
+    int num_dispatch_threads = 0;
+    const char *dispatch_threads_str =
+        (const char *) g_hash_table_lookup (args, "dispatch_threads");
+    if (dispatch_threads_str) {
+        char *endptr = NULL;
+        num_dispatch_threads = strtol (dispatch_threads_str, &endptr, 0);
+        if (endptr == dispatch_threads_str || *endptr ||
+                num_dispatch_threads < 0) {
+            fprintf (stderr, "Warning: Invalid value for dispatch_threads\n");
+            num_dispatch_threads = 0;
+        }
+        g_hash_table_remove (args, "dispatch_threads");
+    }
+
+    int async_tx = 0;
+    int tx_queue_mb = LCM_DEFAULT_TX_QUEUE_MB;
+    int tx_block = 0;
+    const char *async_tx_str =
+        (const char *) g_hash_table_lookup (args, "async_tx");
+    if (async_tx_str) {
+        char *endptr = NULL;
+        async_tx = strtol (async_tx_str, &endptr, 0);
+        if (endptr == async_tx_str || *endptr) {
+            fprintf (stderr, "Warning: Invalid value for async_tx\n");
+            async_tx = 0;
+        }
+        g_hash_table_remove (args, "async_tx");
+    }
+    const char *tx_queue_mb_str =
+        (const char *) g_hash_table_lookup (args, "tx_queue_mb");
+    if (tx_queue_mb_str) {
+        char *endptr = NULL;
+        tx_queue_mb = strtol (tx_queue_mb_str, &endptr, 0);
+        if (endptr == tx_queue_mb_str || *endptr || tx_queue_mb <= 0) {
+            fprintf (stderr, "Warning: Invalid value for tx_queue_mb\n");
+            tx_queue_mb = LCM_DEFAULT_TX_QUEUE_MB;
+        }
+        g_hash_table_remove (args, "tx_queue_mb");
+    }
+    const char *tx_queue_policy_str =
+        (const char *) g_hash_table_lookup (args, "tx_queue_policy");
+    if (tx_queue_policy_str) {
+        if (!strcmp (tx_queue_policy_str, "block"))
+            tx_block = 1;
+        else if (strcmp (tx_queue_policy_str, "drop"))
+            fprintf (stderr, "Warning: Invalid value for tx_queue_policy\n");
+        g_hash_table_remove (args, "tx_queue_policy");
+    }
+
+    int stats_interval_ms = 0;
+    const char *stats_interval_str =
+        (const char *) g_hash_table_lookup (args, "stats_interval");
+    if (stats_interval_str) {
+        char *endptr = NULL;
+        stats_interval_ms = strtol (stats_interval_str, &endptr, 0);
+        if (endptr == stats_interval_str || *endptr || stats_interval_ms < 0) {
+            fprintf (stderr, "Warning: Invalid value for stats_interval\n");
+            stats_interval_ms = 0;
+        }
+        g_hash_table_remove (args, "stats_interval");
+    }
+
+    int skip_unsubscribed = 0;
+    const char *skip_unsubscribed_str =
+        (const char *) g_hash_table_lookup (args, "skip_unsubscribed");
+    if (skip_unsubscribed_str) {
+        char *endptr = NULL;
+        skip_unsubscribed = strtol (skip_unsubscribed_str, &endptr, 0);
+        if (endptr == skip_unsubscribed_str || *endptr) {
+            fprintf (stderr, "Warning: Invalid value for skip_unsubscribed\n");
+            skip_unsubscribed = 0;
+        }
+        g_hash_table_remove (args, "skip_unsubscribed");
+    }
+
     lcm_provider_info_t * info = NULL;
     /* Find a matching provider */
     for (unsigned int i = 0; i < providers->len; i++) {
@@ -108,7 +411,6 @@ lcm_create (const char *url)
     if (!info) {
         fprintf (stderr, "Error: LCM provider \"%s\" not found\n",
                 provider_str);
-        g_ptr_array_free (providers, TRUE);
         free (provider_str);
         free (network);
         g_hash_table_destroy (args);
@@ -119,17 +421,25 @@ lcm_create (const char *url)
 
     lcm->vtable = info->vtable;
     lcm->handlers_all = g_ptr_array_new();
-    lcm->handlers_map = g_hash_table_new (g_str_hash, g_str_equal);
+    lcm->matcher = lcm_channel_matcher_new();
+    lcm->handlers_table = (lcm_handler_table_t *) calloc (1, sizeof (lcm_handler_table_t));
+    lcm->handlers_table->map = g_hash_table_new (g_str_hash, g_str_equal);
 
     g_static_rec_mutex_init (&lcm->mutex);
     g_static_rec_mutex_init (&lcm->handle_mutex);
+    g_static_mutex_init (&lcm->publish_bufs_lock);
+    g_static_mutex_init (&lcm->self_test_lock);
+    g_static_mutex_init (&lcm->slow_handler_lock);
+    g_static_mutex_init (&lcm->stats_lock);
+
+    if (num_dispatch_threads > 0)
+        dispatch_pool_start (lcm, num_dispatch_threads);
 
     lcm->provider = info->vtable->create (lcm, network, args);
     lcm->in_handle = 0;
 
     free (provider_str);
     free (network);
-    g_ptr_array_free (providers, TRUE);
     g_hash_table_destroy (args);
 
     if (!lcm->provider) {
@@ -138,6 +448,12 @@ lcm_create (const char *url)
     }
 
     lcm->default_max_num_queued_messages = 30;
+    lcm->skip_unsubscribed = skip_unsubscribed;
+
+    if (async_tx)
+        tx_queue_start (lcm, tx_queue_mb, tx_block);
+    if (stats_interval_ms > 0)
+        stats_publisher_start (lcm, stats_interval_ms);
 
     return lcm;
 
@@ -146,36 +462,125 @@ fail:
     free (network);
     if (args)
         g_hash_table_destroy (args);
-    if (providers)
-        g_ptr_array_free (providers, TRUE);
 //    if (lcm)
 //        lcm_destroy (lcm);
     return NULL;
 }
 
-// free the array that we associate for each channel, and the key. Don't free
-// the lcm_subscription_t*s.
-static void 
-map_free_handlers_callback(gpointer _key, gpointer _value, gpointer _data)
-{
-    GPtrArray *handlers = (GPtrArray*) _value;
-    g_ptr_array_free(handlers, TRUE);
-    free(_key);
-}
-
 static void
 lcm_handler_free (lcm_subscription_t *h) 
 {
-    assert (!h->callback_scheduled);
-    g_regex_unref(h->regex);
+    assert (!h->pool_scheduled);
+    if (h->pool_msgs)
+        g_queue_free (h->pool_msgs);
+    lcm_channel_pattern_free(h->pattern);
+    g_static_mutex_free (&h->stats_lock);
     free (h->channel);
     memset (h, 0, sizeof (lcm_subscription_t));
     free (h);
 }
 
+static void
+lcm_handler_unref (lcm_subscription_t *h)
+{
+    if (g_atomic_int_dec_and_test (&h->ref))
+        lcm_handler_free (h);
+}
+
+static lcm_handler_list_t *
+handler_list_new (const char *channel, unsigned int num_handlers)
+{
+    lcm_handler_list_t *list = (lcm_handler_list_t *) calloc (1,
+            sizeof (lcm_handler_list_t) +
+            num_handlers * sizeof (lcm_subscription_t *));
+    list->ref = 1;
+    list->channel = strdup (channel);
+    list->num_handlers = num_handlers;
+    return list;
+}
+
+static void
+handler_list_unref (lcm_handler_list_t *list)
+{
+    if (!g_atomic_int_dec_and_test (&list->ref))
+        return;
+    for (unsigned int i = 0; i < list->num_handlers; i++)
+        lcm_handler_unref (list->handlers[i]);
+    free (list->channel);
+    free (list);
+}
+
+static void
+table_free_list_callback (gpointer _key, gpointer _value, gpointer _data)
+{
+    handler_list_unref ((lcm_handler_list_t *) _value);
+}
+
+static void
+handler_table_free (lcm_handler_table_t *table)
+{
+    g_hash_table_foreach (table->map, table_free_list_callback, NULL);
+    g_hash_table_destroy (table->map);
+    free (table->by_id);
+    free (table);
+}
+
+// Fills in the by_id index of table, a copy of old with other lists, from
+// that of old.  num_ids is at least min_ids.
+static void
+handler_table_index (lcm_handler_table_t *table,
+        const lcm_handler_table_t *old, int min_ids)
+{
+    table->num_ids = MAX (old->num_ids, min_ids);
+    if (!table->num_ids)
+        return;
+    table->by_id = (lcm_handler_list_t **) calloc (table->num_ids,
+            sizeof (lcm_handler_list_t *));
+    for (int i = 0; i < old->num_ids; i++)
+        if (old->by_id[i])
+            table->by_id[i] = (lcm_handler_list_t *) g_hash_table_lookup (
+                    table->map, old->by_id[i]->channel);
+}
+
+static void
+free_retired_tables (lcm_t *lcm)
+{
+    while (lcm->retired_tables) {
+        lcm_handler_table_t *table = lcm->retired_tables;
+        lcm->retired_tables = table->next_retired;
+        handler_table_free (table);
+    }
+}
+
+// Make table the current snapshot.  Must be called with lcm->mutex held.
+static void
+handler_table_publish (lcm_t *lcm, lcm_handler_table_t *table)
+{
+    lcm_handler_table_t *old = lcm->handlers_table;
+    g_atomic_pointer_set (&lcm->handlers_table, table);
+
+    old->next_retired = lcm->retired_tables;
+    lcm->retired_tables = old;
+
+    // Readers increment table_readers before loading handlers_table.  If
+    // there are none right now, any reader that comes later sees the new
+    // table, so nothing can still be using the retired ones.
+    if (g_atomic_int_get (&lcm->table_readers) == 0)
+        free_retired_tables (lcm);
+}
+
 void
 lcm_destroy (lcm_t * lcm)
 {
+    // handlers running in the dispatch threads may still publish, so stop
+    // those first.
+    if (lcm->stats_thread)
+        stats_publisher_stop (lcm);
+    if (lcm->num_dispatch_threads)
+        dispatch_pool_stop (lcm);
+    if (lcm->tx_thread)
+        tx_queue_stop (lcm);
+
     if (lcm->provider){
         for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
             // unsubscribe from all handlers
@@ -185,16 +590,26 @@ lcm_destroy (lcm_t * lcm)
         }
         lcm->vtable->destroy (lcm->provider);
     }
-    g_hash_table_foreach (lcm->handlers_map, map_free_handlers_callback, NULL);
-    g_hash_table_destroy (lcm->handlers_map);
+    free_retired_tables (lcm);
+    handler_table_free (lcm->handlers_table);
 
     for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
         lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(
                 lcm->handlers_all, i);
-        h->callback_scheduled = 0; // XXX hack...
-        lcm_handler_free(h);
+        lcm_handler_unref(h);
     }
     g_ptr_array_free(lcm->handlers_all, TRUE);
+    lcm_channel_matcher_free(lcm->matcher);
+
+    while (lcm->publish_bufs) {
+        lcm_publish_buf_t *pb = lcm->publish_bufs;
+        lcm->publish_bufs = pb->next;
+        free (pb);
+    }
+    g_static_mutex_free (&lcm->publish_bufs_lock);
+    g_static_mutex_free (&lcm->self_test_lock);
+    g_static_mutex_free (&lcm->slow_handler_lock);
+    g_static_mutex_free (&lcm->stats_lock);
 
     g_static_rec_mutex_free (&lcm->handle_mutex);
     g_static_rec_mutex_free (&lcm->mutex);
@@ -204,6 +619,14 @@ lcm_destroy (lcm_t * lcm)
 #endif
 }
 
+static void
+count_wakeup (lcm_t *lcm)
+{
+    g_static_mutex_lock (&lcm->stats_lock);
+    lcm->stats.num_wakeups++;
+    g_static_mutex_unlock (&lcm->stats_lock);
+}
+
 int
 lcm_handle (lcm_t * lcm)
 {
@@ -212,6 +635,7 @@ lcm_handle (lcm_t * lcm)
         g_static_rec_mutex_lock (&lcm->handle_mutex);
         assert(!lcm->in_handle); // recursive calls to lcm_handle are not allowed
         lcm->in_handle = 1;
+        count_wakeup (lcm);
         ret = lcm->vtable->handle (lcm->provider);
         lcm->in_handle = 0;
         g_static_rec_mutex_unlock (&lcm->handle_mutex);
@@ -220,33 +644,81 @@ lcm_handle (lcm_t * lcm)
         return -1;
 }
 
-int
-lcm_handle_timeout (lcm_t *lcm, int timeout_milis)
+// waits until the LCM file descriptor is readable.  Returns >0 if it is, 0 on
+// timeout, and <0 on error.  poll() is used rather than select() so that
+// descriptors beyond FD_SETSIZE work.
+static int
+lcm_wait_readable (lcm_t *lcm, int timeout_millis)
 {
-  fd_set fds;
-  FD_ZERO(&fds);
-  SOCKET lcm_fd = lcm_get_fileno(lcm);
-  FD_SET(lcm_fd, &fds);
+  lcm_pollfd_t pfd;
+  pfd.fd = (SOCKET) lcm_get_fileno(lcm);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
 
-  struct timeval timeout;
-  timeout.tv_sec = timeout_milis / 1000;
-  timeout.tv_usec = (timeout_milis % 1000) * 1000;
+  // a provider may spin a while before we sleep
+  if (timeout_millis > 0 && lcm->provider && lcm->vtable->busy_wait &&
+          lcm->vtable->busy_wait (lcm->provider, timeout_millis))
+      return 1;
 
+  return poll(&pfd, 1, timeout_millis);
+}
+
+int
+lcm_handle_timeout (lcm_t *lcm, int timeout_milis)
+{
   if (timeout_milis < 0) {
       return -1;
   }
 
-  int select_result = select(lcm_fd + 1, &fds, NULL, NULL, &timeout);
-  if (select_result > 0) {
+  int poll_result = lcm_wait_readable(lcm, timeout_milis);
+  if (poll_result > 0) {
       int lcm_handle_result = lcm_handle(lcm);
       return lcm_handle_result == 0 ? 1 : lcm_handle_result;
-  } else if (select_result == 0) {
+  } else if (poll_result == 0) {
       return 0;
   } else {
-      return select_result;
+      return poll_result;
   }
 }
 
+int
+lcm_handle_batch (lcm_t *lcm, int max_msgs, int timeout_millis)
+{
+    if (max_msgs <= 0 || timeout_millis < 0)
+        return -1;
+    if (!lcm->provider || !lcm->vtable->handle)
+        return -1;
+
+    int wait_result = lcm_wait_readable (lcm, timeout_millis);
+    if (wait_result <= 0)
+        return wait_result;
+
+    int num_handled = 0;
+    g_static_rec_mutex_lock (&lcm->handle_mutex);
+    assert(!lcm->in_handle); // recursive calls to lcm_handle are not allowed
+    lcm->in_handle = 1;
+    count_wakeup (lcm);
+    if (lcm->vtable->handle_batch) {
+        num_handled = lcm->vtable->handle_batch (lcm->provider, max_msgs);
+    } else {
+        // the provider can only hand out one message at a time.  Keep going
+        // for as long as more are immediately available.
+        while (num_handled < max_msgs) {
+            if (0 != lcm->vtable->handle (lcm->provider)) {
+                if (!num_handled)
+                    num_handled = -1;
+                break;
+            }
+            num_handled++;
+            if (num_handled < max_msgs && lcm_wait_readable (lcm, 0) <= 0)
+                break;
+        }
+    }
+    lcm->in_handle = 0;
+    g_static_rec_mutex_unlock (&lcm->handle_mutex);
+    return num_handled;
+}
+
 int
 lcm_get_fileno (lcm_t * lcm)
 {
@@ -256,44 +728,464 @@ lcm_get_fileno (lcm_t * lcm)
         return -1;
 }
 
+int
+lcm_get_transport_stats (lcm_t *lcm, lcm_transport_stats_t *stats)
+{
+    if (lcm->provider && lcm->vtable->get_stats)
+        return lcm->vtable->get_stats (lcm->provider, stats);
+    else
+        return -1;
+}
+
+int
+lcm_get_publish_queue_stats (lcm_t *lcm, lcm_publish_queue_stats_t *stats)
+{
+    if (!lcm->tx_thread)
+        return -1;
+    g_mutex_lock (lcm->tx_mutex);
+    *stats = lcm->tx_stats;
+    g_mutex_unlock (lcm->tx_mutex);
+    return 0;
+}
+
+int
+lcm_get_stats (lcm_t *lcm, lcm_stats_t *stats)
+{
+    g_static_mutex_lock (&lcm->stats_lock);
+    *stats = lcm->stats;
+    g_static_mutex_unlock (&lcm->stats_lock);
+
+    g_static_rec_mutex_lock (&lcm->mutex);
+    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
+        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index (
+                lcm->handlers_all, i);
+        stats->num_queued += g_atomic_int_get (&h->num_queued_messages) +
+            g_atomic_int_get (&h->num_pool_msgs);
+        g_static_mutex_lock (&h->stats_lock);
+        stats->num_dropped_queue_full += h->stats.num_dropped;
+        g_static_mutex_unlock (&h->stats_lock);
+    }
+    g_static_rec_mutex_unlock (&lcm->mutex);
+
+    stats->has_transport_stats =
+        lcm_get_transport_stats (lcm, &stats->transport) == 0;
+    if (!stats->has_transport_stats)
+        memset (&stats->transport, 0, sizeof (stats->transport));
+    stats->has_publish_queue_stats =
+        lcm_get_publish_queue_stats (lcm, &stats->publish_queue) == 0;
+    if (!stats->has_publish_queue_stats)
+        memset (&stats->publish_queue, 0, sizeof (stats->publish_queue));
+    return 0;
+}
+
+int
+lcm_set_slow_handler_threshold (lcm_t *lcm, int64_t threshold_usec,
+        lcm_slow_handler_t callback, void *user_data)
+{
+    if (threshold_usec < 0 || threshold_usec > G_MAXINT)
+        return -1;
+    g_static_mutex_lock (&lcm->slow_handler_lock);
+    lcm->slow_handler_cb = callback;
+    lcm->slow_handler_user = user_data;
+    g_static_mutex_unlock (&lcm->slow_handler_lock);
+    g_atomic_int_set (&lcm->slow_handler_usec, (int) threshold_usec);
+    return 0;
+}
+
+int
+lcm_get_self_test_status (lcm_t *lcm)
+{
+    g_static_mutex_lock (&lcm->self_test_lock);
+    int status = lcm->self_test_status;
+    g_static_mutex_unlock (&lcm->self_test_lock);
+    return status;
+}
+
+void
+lcm_set_self_test_handler (lcm_t *lcm, lcm_self_test_handler_t handler,
+        void *user_data)
+{
+    g_static_mutex_lock (&lcm->self_test_lock);
+    lcm->self_test_handler = handler;
+    lcm->self_test_user = user_data;
+    int status = lcm->self_test_status;
+    g_static_mutex_unlock (&lcm->self_test_lock);
+
+    // a self test that already finished is reported right away
+    if (handler && (status == LCM_SELF_TEST_PASSED ||
+                status == LCM_SELF_TEST_FAILED))
+        handler (lcm, status, user_data);
+}
+
+void
+lcm_internal_set_self_test_status (lcm_t *lcm, int status)
+{
+    g_static_mutex_lock (&lcm->self_test_lock);
+    lcm->self_test_status = status;
+    lcm_self_test_handler_t handler = lcm->self_test_handler;
+    void *user = lcm->self_test_user;
+    g_static_mutex_unlock (&lcm->self_test_lock);
+
+    if (handler && (status == LCM_SELF_TEST_PASSED ||
+                status == LCM_SELF_TEST_FAILED))
+        handler (lcm, status, user);
+}
+
+// Appends pb to the publish queue, waiting for room or dropping it if the
+// queue is full.  Takes over pb either way.
+static int
+tx_enqueue (lcm_t *lcm, lcm_publish_buf_t *pb, unsigned int datalen)
+{
+    pb->next = NULL;
+    pb->datalen = datalen;
+
+    g_mutex_lock (lcm->tx_mutex);
+    // a message larger than the whole queue still goes once the queue is
+    // empty
+    while (lcm->tx_stats.num_queued &&
+            lcm->tx_stats.queued_bytes + datalen > lcm->tx_queue_cap) {
+        if (!lcm->tx_block) {
+            lcm->tx_stats.num_dropped++;
+            g_mutex_unlock (lcm->tx_mutex);
+            publish_buf_put (lcm, pb);
+            return -1;
+        }
+        g_cond_wait (lcm->tx_space_cond, lcm->tx_mutex);
+    }
+    if (lcm->tx_tail)
+        lcm->tx_tail->next = pb;
+    else
+        lcm->tx_head = pb;
+    lcm->tx_tail = pb;
+    lcm->tx_stats.num_queued++;
+    lcm->tx_stats.queued_bytes += datalen;
+    lcm->tx_stats.max_queued_bytes = MAX (lcm->tx_stats.max_queued_bytes,
+            lcm->tx_stats.queued_bytes);
+    g_cond_signal (lcm->tx_cond);
+    g_mutex_unlock (lcm->tx_mutex);
+    return 0;
+}
+
+// counts a message that was published, or queued, if status is 0 or more
+static int
+count_published (lcm_t *lcm, unsigned int datalen, int status)
+{
+    g_static_mutex_lock (&lcm->stats_lock);
+    if (status < 0) {
+        lcm->stats.num_publish_failed++;
+    } else {
+        lcm->stats.num_published++;
+        lcm->stats.bytes_published += datalen;
+    }
+    g_static_mutex_unlock (&lcm->stats_lock);
+    return status;
+}
+
+int
+lcm_has_remote_subscribers (lcm_t *lcm, const char *channel)
+{
+    if (!lcm->provider || !lcm->vtable->has_subscribers)
+        return -1;
+    return lcm->vtable->has_subscribers (lcm->provider, channel);
+}
+
+static int
+publish_wanted (lcm_t *lcm, const char *channel)
+{
+    // the instance's own handlers hear what it publishes through the
+    // provider, so those channels always go out
+    return !lcm->skip_unsubscribed || lcm_has_handlers (lcm, channel) ||
+        lcm_has_remote_subscribers (lcm, channel) != 0;
+}
+
+// counts a message that was skipped because nobody subscribes to it
+static int
+count_suppressed (lcm_t *lcm)
+{
+    g_static_mutex_lock (&lcm->stats_lock);
+    lcm->stats.num_suppressed++;
+    g_static_mutex_unlock (&lcm->stats_lock);
+    return 0;
+}
+
+int
+lcm_publish_wanted (lcm_t *lcm, const char *channel)
+{
+    if (!lcm->provider || publish_wanted (lcm, channel))
+        return 1;
+    count_suppressed (lcm);
+    return 0;
+}
+
 int
 lcm_publish (lcm_t *lcm, const char *channel, const void *data,
         unsigned int datalen)
 {
-    if (lcm->provider && lcm->vtable->publish)
-        return lcm->vtable->publish (lcm->provider, channel, data, datalen);
-    else
+    if (!lcm->provider || !lcm->vtable->publish)
+        return -1;
+    if (!publish_wanted (lcm, channel))
+        return count_suppressed (lcm);
+    if (lcm->tx_thread) {
+        void *buf = lcm_publish_reserve (lcm, channel, datalen);
+        if (!buf)
+            return count_published (lcm, datalen, -1);
+        memcpy (buf, data, datalen);
+        return count_published (lcm, datalen,
+                tx_enqueue (lcm, (lcm_publish_buf_t *) buf - 1, datalen));
+    }
+    return count_published (lcm, datalen,
+            lcm->vtable->publish (lcm->provider, channel, data, datalen));
+}
+
+void *
+lcm_publish_reserve (lcm_t *lcm, const char *channel, unsigned int size)
+{
+    if (strlen (channel) > LCM_MAX_CHANNEL_NAME_LENGTH) {
+        fprintf (stderr, "LCM Error: channel name too long [%s]\n", channel);
+        return NULL;
+    }
+
+    g_static_mutex_lock (&lcm->publish_bufs_lock);
+    lcm_publish_buf_t *pb = lcm->publish_bufs;
+    if (pb) {
+        lcm->publish_bufs = pb->next;
+        lcm->num_publish_bufs--;
+    }
+    g_static_mutex_unlock (&lcm->publish_bufs_lock);
+
+    if (!pb || pb->capacity < size) {
+        lcm_publish_buf_t *grown = (lcm_publish_buf_t *) realloc (pb,
+                sizeof (lcm_publish_buf_t) + size);
+        if (!grown) {
+            free (pb);
+            return NULL;
+        }
+        pb = grown;
+        pb->capacity = size;
+    }
+    pb->next = NULL;
+    strcpy (pb->channel, channel);
+    return pb + 1;
+}
+
+static void
+publish_buf_put (lcm_t *lcm, lcm_publish_buf_t *pb)
+{
+    g_static_mutex_lock (&lcm->publish_bufs_lock);
+    if (lcm->num_publish_bufs < LCM_MAX_CACHED_PUBLISH_BUFS) {
+        pb->next = lcm->publish_bufs;
+        lcm->publish_bufs = pb;
+        lcm->num_publish_bufs++;
+        pb = NULL;
+    }
+    g_static_mutex_unlock (&lcm->publish_bufs_lock);
+    free (pb);
+}
+
+int
+lcm_publish_commit (lcm_t *lcm, void *buf, unsigned int datalen)
+{
+    lcm_publish_buf_t *pb = (lcm_publish_buf_t *) buf - 1;
+    int status = -1;
+    if (datalen > pb->capacity)
+        fprintf (stderr, "LCM Error: lcm_publish_commit of %u bytes exceeds "
+                "the %u reserved\n", datalen, pb->capacity);
+    else if (lcm->provider && !publish_wanted (lcm, pb->channel))
+        status = count_suppressed (lcm);
+    else if (lcm->tx_thread && lcm->provider && lcm->vtable->publish)
+        // the reserved buffer itself is queued, without copying it
+        return count_published (lcm, datalen, tx_enqueue (lcm, pb, datalen));
+    else if (lcm->provider && lcm->vtable->publish_owned) {
+        status = count_published (lcm, datalen, lcm->vtable->publish_owned (
+                    lcm->provider, pb->channel, pb, buf, datalen));
+        if (status > 0)
+            return 0;
+    } else
+        status = lcm_publish (lcm, pb->channel, buf, datalen);
+    publish_buf_put (lcm, pb);
+    return status;
+}
+
+void
+lcm_publish_cancel (lcm_t *lcm, void *buf)
+{
+    publish_buf_put (lcm, (lcm_publish_buf_t *) buf - 1);
+}
+
+// A message published with lcm_publish_stream_begin().  It is either
+// streamed by the provider, or collected in a publish buffer.
+struct _lcm_publish_stream_t {
+    lcm_t *lcm;
+    void *provider_stream;  // from publish_stream_begin, or NULL
+    uint8_t *buf;           // from lcm_publish_reserve, if not streamed
+    unsigned int datalen;
+    unsigned int written;
+    int failed;
+};
+
+lcm_publish_stream_t *
+lcm_publish_stream_begin (lcm_t *lcm, const char *channel,
+        unsigned int datalen)
+{
+    if (!lcm->provider || !lcm->vtable->publish)
+        return NULL;
+    lcm_publish_stream_t *stream =
+        (lcm_publish_stream_t *) calloc (1, sizeof (lcm_publish_stream_t));
+    stream->lcm = lcm;
+    stream->datalen = datalen;
+    // the publish queue needs the whole message
+    if (!lcm->tx_thread && lcm->vtable->publish_stream_begin)
+        stream->provider_stream = lcm->vtable->publish_stream_begin (
+                lcm->provider, channel, datalen);
+    if (!stream->provider_stream) {
+        stream->buf = (uint8_t *) lcm_publish_reserve (lcm, channel, datalen);
+        if (!stream->buf) {
+            free (stream);
+            return NULL;
+        }
+    }
+    return stream;
+}
+
+int
+lcm_publish_stream_write (lcm_publish_stream_t *stream, const void *data,
+        unsigned int len)
+{
+    if (stream->failed || len > stream->datalen - stream->written) {
+        stream->failed = 1;
+        return -1;
+    }
+    if (stream->provider_stream) {
+        lcm_t *lcm = stream->lcm;
+        if (lcm->vtable->publish_stream_write (lcm->provider,
+                    stream->provider_stream, data, len) < 0) {
+            stream->failed = 1;
+            return -1;
+        }
+    } else {
+        memcpy (stream->buf + stream->written, data, len);
+    }
+    stream->written += len;
+    return 0;
+}
+
+int
+lcm_publish_stream_end (lcm_publish_stream_t *stream)
+{
+    if (stream->failed || stream->written != stream->datalen) {
+        lcm_publish_stream_cancel (stream);
         return -1;
+    }
+    lcm_t *lcm = stream->lcm;
+    int status;
+    if (stream->provider_stream)
+        status = count_published (lcm, stream->datalen,
+                lcm->vtable->publish_stream_end (lcm->provider,
+                    stream->provider_stream, 0));
+    else
+        status = lcm_publish_commit (lcm, stream->buf, stream->datalen);
+    free (stream);
+    return status;
 }
 
-static int 
-is_handler_subscriber(lcm_subscription_t *h, const char *channel_name)
+void
+lcm_publish_stream_cancel (lcm_publish_stream_t *stream)
 {
-    return g_regex_match(h->regex, channel_name, (GRegexMatchFlags) 0, NULL);
+    lcm_t *lcm = stream->lcm;
+    if (stream->provider_stream)
+        lcm->vtable->publish_stream_end (lcm->provider,
+                stream->provider_stream, 1);
+    else
+        lcm_publish_cancel (lcm, stream->buf);
+    free (stream);
 }
 
-// add the handler to any channel's handler list if its subscription matches
-static void 
-map_add_handler_callback(gpointer _key, gpointer _value, gpointer _data)
+typedef struct {
+    lcm_handler_table_t *table;
+    lcm_subscription_t *h;
+} table_rebuild_t;
+
+static void
+table_copy_list (lcm_handler_table_t *table, lcm_handler_list_t *list)
+{
+    g_atomic_int_inc (&list->ref);
+    g_hash_table_insert (table->map, list->channel, list);
+}
+
+static void
+table_copy_list_callback(gpointer _key, gpointer _value, gpointer _data)
+{
+    table_copy_list((lcm_handler_table_t*) _data, (lcm_handler_list_t*) _value);
+}
+
+// copy a channel's handler list into the new table, appending the handler if
+// its subscription matches
+static void
+table_add_handler_callback(gpointer _key, gpointer _value, gpointer _data)
 {
-    lcm_subscription_t *h = (lcm_subscription_t*) _data;
-    char *channel_name = (char*) _key;
-    GPtrArray *handlers = (GPtrArray*) _value;
+    table_rebuild_t *rebuild = (table_rebuild_t*) _data;
+    lcm_handler_list_t *list = (lcm_handler_list_t*) _value;
+    lcm_subscription_t *h = rebuild->h;
 
-    if (!is_handler_subscriber(h, channel_name))
+    if (!lcm_channel_pattern_match(h->pattern, list->channel)) {
+        table_copy_list(rebuild->table, list);
         return;
-    
-    g_ptr_array_add(handlers, h);
+    }
+
+    lcm_handler_list_t *newlist = handler_list_new(list->channel,
+            list->num_handlers + 1);
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        newlist->handlers[i] = list->handlers[i];
+        g_atomic_int_inc(&newlist->handlers[i]->ref);
+    }
+    newlist->handlers[list->num_handlers] = h;
+    g_atomic_int_inc(&h->ref);
+    g_hash_table_insert(rebuild->table->map, newlist->channel, newlist);
+}
+
+// copy a channel's handler list into the new table, without the handler
+static void
+table_remove_handler_callback(gpointer _key, gpointer _value, gpointer _data)
+{
+    table_rebuild_t *rebuild = (table_rebuild_t*) _data;
+    lcm_handler_list_t *list = (lcm_handler_list_t*) _value;
+    lcm_subscription_t *h = rebuild->h;
+
+    unsigned int found = 0;
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        if (list->handlers[i] == h)
+            found++;
+    }
+    if (!found) {
+        table_copy_list(rebuild->table, list);
+        return;
+    }
+
+    lcm_handler_list_t *newlist = handler_list_new(list->channel,
+            list->num_handlers - found);
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        if (list->handlers[i] == h)
+            continue;
+        newlist->handlers[n] = list->handlers[i];
+        g_atomic_int_inc(&newlist->handlers[n]->ref);
+        n++;
+    }
+    g_hash_table_insert(rebuild->table->map, newlist->channel, newlist);
 }
 
-// remove from a channel's handler list
-static void 
-map_remove_handler_callback(gpointer _key, gpointer _value, 
-        gpointer _data)
+// Publish a copy of the handler table with h added to or removed from the
+// lists of every channel seen so far.  Must be called with lcm->mutex held.
+static void
+handler_table_rebuild(lcm_t *lcm, lcm_subscription_t *h, GHFunc func)
 {
-    lcm_subscription_t *h = (lcm_subscription_t*) _data;
-    GPtrArray *handlers = (GPtrArray*) _value;
-    g_ptr_array_remove_fast(handlers, h);
+    table_rebuild_t rebuild;
+    rebuild.table = (lcm_handler_table_t *) calloc (1, sizeof (lcm_handler_table_t));
+    rebuild.table->map = g_hash_table_new (g_str_hash, g_str_equal);
+    rebuild.h = h;
+    g_hash_table_foreach(lcm->handlers_table->map, func, &rebuild);
+    handler_table_index(rebuild.table, lcm->handlers_table, 0);
+    handler_table_publish(lcm, rebuild.table);
 }
 
 lcm_subscription_t
@@ -313,26 +1205,28 @@ lcm_subscription_t
     h->channel = strdup(channel);
     h->handler = handler;
     h->userdata = userdata;
-    h->callback_scheduled = 0;
+    h->ref = 1;
     h->marked_for_deletion = 0;
     h->max_num_queued_messages = lcm->default_max_num_queued_messages;
     h->num_queued_messages = 0;
     h->lcm = lcm;
+    g_static_mutex_init (&h->stats_lock);
 
-    char *regexbuf = g_strdup_printf("^%s$", channel);
     GError *rerr = NULL;
-    h->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
-    g_free(regexbuf);
+    h->pattern = lcm_channel_pattern_new(channel, &rerr);
     if(rerr) {
         fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
         dbg(DBG_LCM, "%s: %s\n", __FUNCTION__, rerr->message);
         g_error_free(rerr);
+        g_static_mutex_free(&h->stats_lock);
+        free(h->channel);
         free(h);
         return NULL;
     }
     g_static_rec_mutex_lock (&lcm->mutex);
     g_ptr_array_add(lcm->handlers_all, h);
-    g_hash_table_foreach(lcm->handlers_map, map_add_handler_callback, h);
+    lcm_channel_matcher_add(lcm->matcher, h->pattern, h);
+    handler_table_rebuild(lcm, h, table_add_handler_callback);
     g_static_rec_mutex_unlock (&lcm->mutex);
 
     return h;
@@ -346,17 +1240,24 @@ lcm_unsubscribe (lcm_t *lcm, lcm_subscription_t *h)
     // remove the handler from the master list
     int foundit = g_ptr_array_remove(lcm->handlers_all, h);
 
-    if (lcm->provider && lcm->vtable->unsubscribe) {
+    // h may already be freed if it wasn't found
+    if (foundit && lcm->provider && lcm->vtable->unsubscribe) {
         lcm->vtable->unsubscribe(lcm->provider, h->channel);
     }
 
     if (foundit) {
         // remove the handler from all the lists in the hash table
-        g_hash_table_foreach(lcm->handlers_map, map_remove_handler_callback, h);
-        if (!h->callback_scheduled)
-            lcm_handler_free (h);
-        else
-            h->marked_for_deletion = 1;
+        // a dispatch in progress may still hold a list containing the
+        // handler.  Make sure it isn't invoked anymore; it is freed when the
+        // last list referencing it goes away.
+        g_atomic_int_set (&h->marked_for_deletion, 1);
+        if (g_atomic_int_get (&h->priority))
+            g_atomic_int_add (&lcm->num_prioritized, -1);
+        if (g_atomic_int_get (&h->conflate))
+            g_atomic_int_add (&lcm->num_conflating, -1);
+        lcm_channel_matcher_remove(lcm->matcher, h->pattern, h);
+        handler_table_rebuild(lcm, h, table_remove_handler_callback);
+        lcm_handler_unref (h);
     }
 
     g_static_rec_mutex_unlock (&lcm->mutex);
@@ -366,112 +1267,903 @@ lcm_unsubscribe (lcm_t *lcm, lcm_subscription_t *h)
 
 /* ==== Internal API for Providers ==== */
 
-GPtrArray *
-lcm_get_handlers (lcm_t * lcm, const char * channel)
+int
+lcm_internal_channel_id (const char *channel)
 {
-    g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = (GPtrArray *) g_hash_table_lookup (lcm->handlers_map, channel);
-    if (handlers)
-        goto finished;
+    g_static_mutex_lock (&channel_ids_lock);
+    if (!channel_ids)
+        channel_ids = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+                NULL);
+    int id = GPOINTER_TO_INT (g_hash_table_lookup (channel_ids, channel)) - 1;
+    if (id < 0 && g_hash_table_size (channel_ids) < LCM_MAX_CHANNEL_IDS) {
+        id = g_hash_table_size (channel_ids);
+        g_hash_table_insert (channel_ids, strdup (channel),
+                GINT_TO_POINTER (id + 1));
+    }
+    g_static_mutex_unlock (&channel_ids_lock);
+    return id;
+}
 
-    // if we haven't seen this channel name before, create a new list
-    // of subscribed handlers.
-    handlers = g_ptr_array_new ();
-    // alloc channel name
-    g_hash_table_insert (lcm->handlers_map, strdup(channel), handlers);
+// The list of table for the channel named channel, whose ID is channel_id,
+// or -1 if unknown, or NULL if table does not have it.
+static lcm_handler_list_t *
+handler_table_lookup (const lcm_handler_table_t *table, const char *channel,
+        int channel_id)
+{
+    if (channel_id < 0)
+        return (lcm_handler_list_t *) g_hash_table_lookup (table->map,
+                channel);
+    return channel_id < table->num_ids ? table->by_id[channel_id] : NULL;
+}
 
-    // find all the matching handlers
-    for (unsigned int i = 0; i < lcm->handlers_all->len; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index (lcm->handlers_all, i);
-        if (is_handler_subscriber (h, channel))
-            g_ptr_array_add(handlers, h);
-    }
+// Returns a reference to the list of handlers for a channel, whose ID is
+// channel_id, or -1 to look it up by name.  Release it with
+// handler_list_unref().
+static lcm_handler_list_t *
+lcm_acquire_handlers (lcm_t * lcm, const char * channel, int channel_id)
+{
+    // fast path: the channel has been seen before.  No locks are taken.
+    g_atomic_int_inc (&lcm->table_readers);
+    lcm_handler_table_t *table =
+        (lcm_handler_table_t *) g_atomic_pointer_get (&lcm->handlers_table);
+    lcm_handler_list_t *list = handler_table_lookup (table, channel,
+            channel_id);
+    if (list)
+        g_atomic_int_inc (&list->ref);
+    g_atomic_int_add (&lcm->table_readers, -1);
+    if (list)
+        return list;
+
+    // if we haven't seen this channel name or ID before, create a new list
+    // of subscribed handlers, or index the one there is by the ID.
+    g_static_rec_mutex_lock (&lcm->mutex);
+    list = handler_table_lookup (lcm->handlers_table, channel, channel_id);
+    if (!list) {
+        list = (lcm_handler_list_t *) g_hash_table_lookup (
+                lcm->handlers_table->map, channel);
+        int is_new = !list;
+        if (is_new) {
+            // find all the matching handlers
+            GPtrArray *handlers = g_ptr_array_new ();
+            lcm_channel_matcher_lookup (lcm->matcher, channel, handlers);
+            list = handler_list_new (channel, handlers->len);
+            for (unsigned int i = 0; i < handlers->len; i++) {
+                list->handlers[i] = (lcm_subscription_t *) g_ptr_array_index (handlers, i);
+                g_atomic_int_inc (&list->handlers[i]->ref);
+            }
+            g_ptr_array_free (handlers, TRUE);
+        }
 
-finished:
+        lcm_handler_table_t *newtable =
+            (lcm_handler_table_t *) calloc (1, sizeof (lcm_handler_table_t));
+        newtable->map = g_hash_table_new (g_str_hash, g_str_equal);
+        g_hash_table_foreach (lcm->handlers_table->map,
+                table_copy_list_callback, newtable);
+        if (is_new)
+            g_hash_table_insert (newtable->map, list->channel, list);
+        handler_table_index (newtable, lcm->handlers_table, channel_id + 1);
+        if (channel_id >= 0)
+            newtable->by_id[channel_id] = list;
+        handler_table_publish (lcm, newtable);
+    }
+    g_atomic_int_inc (&list->ref);
     g_static_rec_mutex_unlock (&lcm->mutex);
-    return handlers;
+    return list;
 }
 
 int
 lcm_try_enqueue_message(lcm_t* lcm, const char* channel)
 {
-    g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
+    return lcm_try_enqueue_message_by_id (lcm, channel, -1);
+}
+
+// claim one of the messages that a provider deferred for a conflating
+// handler.  Returns the number that were deferred, including the one claimed.
+static int
+handler_take_deferred(lcm_subscription_t *h)
+{
+    while (1) {
+        int num_deferred = g_atomic_int_get(&h->num_deferred);
+        if (num_deferred <= 0)
+            return 0;
+        if (g_atomic_int_compare_and_exchange(&h->num_deferred,
+                    num_deferred, num_deferred - 1))
+            return num_deferred;
+    }
+}
+
+int
+lcm_try_enqueue_message_by_id(lcm_t* lcm, const char* channel, int channel_id)
+{
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel,
+            channel_id);
     int num_keepers = 0;
-    for(unsigned int i=0; i<handlers->len; i++) {
-        lcm_subscription_t* h = (lcm_subscription_t*) g_ptr_array_index(handlers, i);
-        if(h->num_queued_messages <= h->max_num_queued_messages ||
-                h->max_num_queued_messages <= 0) {
-            h->num_queued_messages++;
+    int64_t now_ns = 0;
+    for(unsigned int i=0; i<list->num_handlers; i++) {
+        lcm_subscription_t* h = list->handlers[i];
+        int decimated = 0;
+        if(g_atomic_int_get(&h->rate_limited)) {
+            if(!now_ns)
+                now_ns = lcm_clock_fast_ns();
+            g_static_mutex_lock(&h->stats_lock);
+            if(now_ns < h->rate_next_ns) {
+                decimated = 1;
+            } else {
+                // keep to the rate on average, but do not make up for a
+                // stretch without messages with a burst
+                h->rate_next_ns += h->rate_interval_ns;
+                if(h->rate_next_ns <= now_ns)
+                    h->rate_next_ns = now_ns + h->rate_interval_ns;
+            }
+            g_static_mutex_unlock(&h->stats_lock);
+        }
+
+        int max_num_queued_messages = g_atomic_int_get(&h->max_num_queued_messages);
+        int num_queued = g_atomic_int_get(&h->num_queued_messages) +
+            g_atomic_int_get(&h->num_pool_msgs);
+        int conflate = g_atomic_int_get(&h->conflate);
+        // a provider that defers this call may already have queued a newer
+        // message behind this one
+        int superseded = conflate && handler_take_deferred(h) > 1;
+        // a conflating subscription always takes the newest message.  The
+        // older ones are skipped when they come up for dispatch.
+        int keep = !decimated && !superseded &&
+            (num_queued <= max_num_queued_messages ||
+             max_num_queued_messages <= 0 || conflate);
+        if(keep) {
+            g_atomic_int_inc(&h->num_queued_messages);
             num_keepers++;
         }
+
+        g_static_mutex_lock(&h->stats_lock);
+        if(decimated) {
+            h->stats.num_decimated++;
+        } else if(keep) {
+            h->stats.num_enqueued++;
+            if(num_queued + 1 > h->stats.peak_queue_depth)
+                h->stats.peak_queue_depth = num_queued + 1;
+        } else {
+            h->stats.num_dropped++;
+        }
+        g_static_mutex_unlock(&h->stats_lock);
+        if(decimated)
+            LCM_TRACE4(drop, channel, -1, -1, LCM_TRACE_DROP_RATE_LIMITED);
+        else if(superseded)
+            LCM_TRACE4(drop, channel, -1, -1, LCM_TRACE_DROP_CONFLATED);
+        else if(!keep)
+            LCM_TRACE4(drop, channel, -1, -1, LCM_TRACE_DROP_QUEUE_FULL);
     }
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    handler_list_unref (list);
     return num_keepers > 0;
 }
 
+int
+lcm_decimate_message_by_id (lcm_t * lcm, const char * channel,
+        int channel_id)
+{
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel,
+            channel_id);
+    int64_t now_ns = 0;
+    int decimated = list->num_handlers > 0;
+    for (unsigned int i = 0; i < list->num_handlers && decimated; i++) {
+        lcm_subscription_t* h = list->handlers[i];
+        if (!g_atomic_int_get (&h->rate_limited)) {
+            decimated = 0;
+            break;
+        }
+        if (!now_ns)
+            now_ns = lcm_clock_fast_ns ();
+        g_static_mutex_lock (&h->stats_lock);
+        decimated = now_ns < h->rate_next_ns;
+        g_static_mutex_unlock (&h->stats_lock);
+    }
+    if (decimated) {
+        for (unsigned int i = 0; i < list->num_handlers; i++) {
+            lcm_subscription_t* h = list->handlers[i];
+            g_static_mutex_lock (&h->stats_lock);
+            h->stats.num_decimated++;
+            g_static_mutex_unlock (&h->stats_lock);
+            LCM_TRACE4 (drop, channel, -1, -1, LCM_TRACE_DROP_RATE_LIMITED);
+        }
+    }
+    handler_list_unref (list);
+    return decimated;
+}
+
 int
 lcm_has_handlers (lcm_t * lcm, const char * channel)
 {
-    int has_handlers = 1;
-    g_static_rec_mutex_lock (&lcm->mutex);
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
-    if (!handlers || !handlers->len)
-        has_handlers = 0;
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    return lcm_has_handlers_by_id (lcm, channel, -1);
+}
+
+int
+lcm_has_handlers_by_id (lcm_t * lcm, const char * channel, int channel_id)
+{
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel,
+            channel_id);
+    int has_handlers = list->num_handlers > 0;
+    handler_list_unref (list);
     return has_handlers;
 }
 
+void
+lcm_defer_enqueue_message (lcm_t * lcm, const char * channel)
+{
+    // nearly every instance has no conflating subscriptions
+    if (!g_atomic_int_get (&lcm->num_conflating))
+        return;
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel, -1);
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        lcm_subscription_t* h = list->handlers[i];
+        if (g_atomic_int_get (&h->conflate))
+            g_atomic_int_inc (&h->num_deferred);
+    }
+    handler_list_unref (list);
+}
+
 int
-lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel)
+lcm_channel_priority_by_id (lcm_t * lcm, const char * channel, int channel_id)
 {
-    g_static_rec_mutex_lock (&lcm->mutex);
+    // nearly every instance leaves all its subscriptions at 0
+    if (!g_atomic_int_get (&lcm->num_prioritized))
+        return 0;
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel,
+            channel_id);
+    int priority = 0;
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        int p = g_atomic_int_get (&list->handlers[i]->priority);
+        if (i == 0 || p > priority)
+            priority = p;
+    }
+    handler_list_unref (list);
+    return priority;
+}
+
+int
+lcm_handlers_backlogged (lcm_t * lcm, const char * channel)
+{
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel, -1);
+    int backlogged = 0;
+    for (unsigned int i = 0; i < list->num_handlers && !backlogged; i++) {
+        lcm_subscription_t* h = list->handlers[i];
+        int max_num_queued_messages =
+            g_atomic_int_get (&h->max_num_queued_messages);
+        int num_queued = g_atomic_int_get (&h->num_queued_messages) +
+            g_atomic_int_get (&h->num_pool_msgs);
+        backlogged = max_num_queued_messages > 0 &&
+            !g_atomic_int_get (&h->conflate) &&
+            num_queued >= max_num_queued_messages;
+    }
+    handler_list_unref (list);
+    return backlogged;
+}
+
+// claim one of the messages queued for a handler.  Returns the number of
+// messages that were queued, including the one claimed.
+static int
+handler_dequeue_message (lcm_subscription_t *h)
+{
+    while (1) {
+        int num_queued = g_atomic_int_get (&h->num_queued_messages);
+        if (num_queued <= 0)
+            return 0;
+        if (g_atomic_int_compare_and_exchange (&h->num_queued_messages,
+                    num_queued, num_queued - 1))
+            return num_queued;
+    }
+}
+
+static void
+handler_count_dropped (lcm_subscription_t *h, int num_dropped)
+{
+    g_static_mutex_lock (&h->stats_lock);
+    h->stats.num_dropped += num_dropped;
+    g_static_mutex_unlock (&h->stats_lock);
+}
+
+// passes a slow handler call to the callback, or warns about it
+static void
+handler_report_slow (lcm_subscription_t *h, const char *channel, int64_t usec)
+{
+    lcm_t *lcm = h->lcm;
+    g_static_mutex_lock (&lcm->slow_handler_lock);
+    lcm_slow_handler_t cb = lcm->slow_handler_cb;
+    void *user = lcm->slow_handler_user;
+    g_static_mutex_unlock (&lcm->slow_handler_lock);
+
+    if (cb) {
+        cb (h, channel, usec, user);
+        return;
+    }
+
+    int64_t now = lcm_clock_monotonic_us ();
+    g_static_mutex_lock (&h->stats_lock);
+    int warn = now - h->slow_warn_utime >= 1000000;
+    if (warn)
+        h->slow_warn_utime = now;
+    int64_t num_slow = h->stats.num_slow;
+    g_static_mutex_unlock (&h->stats_lock);
+    if (warn)
+        fprintf (stderr, "LCM: handler for %s took %" PRId64 " us on %s "
+                "(%" PRId64 " slow calls so far)\n", h->channel, usec,
+                channel, num_slow);
+}
+
+// invoke a handler, keeping track of how long it takes
+static void
+handler_invoke (lcm_subscription_t *h, const lcm_recv_buf_t *buf,
+        const char *channel)
+{
+    LCM_TRACE3 (handler_start, channel, buf->data_size, h);
+    int64_t start = lcm_clock_fast_ns ();
+    h->handler (buf, channel, h->userdata);
+    int64_t end = lcm_clock_fast_ns ();
+    LCM_TRACE3 (handler_end, channel, buf->data_size, h);
+
+    int64_t usec = (end - start) / 1000;
+    // the bucket of usec is the number of bits it takes
+    int bucket = 0;
+    for (int64_t t = usec; t > 0 && bucket < LCM_HANDLER_HISTOGRAM_BUCKETS - 1;
+            t >>= 1)
+        bucket++;
+    int slow_usec = g_atomic_int_get (&h->lcm->slow_handler_usec);
+    int slow = slow_usec > 0 && usec >= slow_usec;
+
+    g_static_mutex_lock (&h->stats_lock);
+    h->stats.num_dispatched++;
+    h->handler_time_ns += end - start;
+    h->stats.handler_time_usec = h->handler_time_ns / 1000;
+    if (usec > h->stats.max_handler_time_usec)
+        h->stats.max_handler_time_usec = usec;
+    h->stats.handler_time_histogram[bucket]++;
+    if (slow)
+        h->stats.num_slow++;
+    g_static_mutex_unlock (&h->stats_lock);
+
+    if (slow)
+        handler_report_slow (h, channel, usec);
+}
+
+/* ==== Retained receive buffers ==== */
+
+static lcm_recv_buf_loan_t *
+loan_new (void *block, int ref)
+{
+    lcm_recv_buf_loan_t *loan =
+        (lcm_recv_buf_loan_t *) malloc (sizeof (lcm_recv_buf_loan_t));
+    loan->ref = ref;
+    loan->block = block;
+    return loan;
+}
+
+static void
+loan_unref (lcm_recv_buf_loan_t *loan)
+{
+    if (g_atomic_int_dec_and_test (&loan->ref)) {
+        free (loan->block);
+        free (loan);
+    }
+}
+
+int
+lcm_recv_buf_owner_finish (lcm_recv_buf_owner_t *owner)
+{
+    if (!owner->loan)
+        return 0;
+    loan_unref (owner->loan);
+    owner->loan = NULL;
+    return 1;
+}
+
+lcm_recv_buf_t *
+lcm_recv_buf_retain (const lcm_recv_buf_t *rbuf)
+{
+    lcm_recv_buf_owner_t *owner = rbuf->owner;
+    lcm_retained_buf_t *retained =
+        (lcm_retained_buf_t *) malloc (sizeof (lcm_retained_buf_t));
+    retained->rbuf = *rbuf;
+    retained->rbuf.owner = &retained->owner;
+    // the decoded messages go away with the dispatch
+    retained->rbuf.decoded = NULL;
+    retained->owner.block = NULL;
+
+    if (owner && !owner->loan && owner->block) {
+        // take over the provider's storage.  The owner keeps a reference
+        // until the provider is done dispatching.
+        owner->loan = loan_new (owner->block, 1);
+        owner->block = NULL;
+    }
+    if (owner && owner->loan) {
+        g_atomic_int_inc (&owner->loan->ref);
+        retained->owner.loan = owner->loan;
+    } else {
+        void *copy = malloc (rbuf->data_size);
+        memcpy (copy, rbuf->data, rbuf->data_size);
+        retained->rbuf.data = copy;
+        retained->owner.loan = loan_new (copy, 1);
+    }
+    return &retained->rbuf;
+}
 
-    GPtrArray * handlers = lcm_get_handlers (lcm, channel);
-
-    // ref the handlers to prevent them from being destroyed by an
-    // lcm_unsubscribe.  This guarantees that handlers 0-(nhandlers-1) will not
-    // be destroyed during the callbacks.  Store nhandlers in a local variable
-    // so that we don't iterate over handlers that are added during the
-    // callbacks.
-    int nhandlers = handlers->len;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        h->callback_scheduled = 1;
-    }
-
-    // now, call the handlers.
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        if (!h->marked_for_deletion && h->num_queued_messages > 0) {
-            h->num_queued_messages--;
-            int depth = g_static_rec_mutex_unlock_full (&lcm->mutex);
-            h->handler (buf, channel, h->userdata);
-            g_static_rec_mutex_lock_full (&lcm->mutex, depth);
+void
+lcm_recv_buf_release (lcm_recv_buf_t *rbuf)
+{
+    lcm_retained_buf_t *retained = (lcm_retained_buf_t *) rbuf;
+    loan_unref (retained->owner.loan);
+    free (retained);
+}
+
+/* ==== Decoded messages shared by the handlers ==== */
+
+const void *
+lcm_recv_buf_decode (const lcm_recv_buf_t *rbuf, int64_t type_hash,
+        int (*decode) (const lcm_recv_buf_t *rbuf, void *msg), void *msg)
+{
+    lcm_decode_cache_t *cache = rbuf->decoded;
+    if (cache) {
+        for (unsigned int i = 0; i < cache->num_decoded; i++) {
+            lcm_decoded_t *d = &cache->decoded[i];
+            // an unsubscribed owner may already have freed its object
+            if (d->type_hash == type_hash && d->decode == decode &&
+                    !g_atomic_int_get (&d->owner->marked_for_deletion))
+                return d->msg;
         }
     }
 
-    // unref the handlers and check if any should be deleted
-    GList *to_remove = NULL;
-    for (int i = 0; i < nhandlers; i++) {
-        lcm_subscription_t *h = (lcm_subscription_t *) g_ptr_array_index(handlers, i);
-        h->callback_scheduled = 0;
-        if (h->marked_for_deletion)
-            to_remove = g_list_prepend (to_remove, h);
-    }
-    // actually delete handlers marked for deletion
-    for (;to_remove; to_remove = g_list_delete_link (to_remove, to_remove)) {
-        lcm_subscription_t *h = (lcm_subscription_t *) to_remove->data;
-        g_ptr_array_remove (lcm->handlers_all, h);
-        g_hash_table_foreach (lcm->handlers_map, 
-                map_remove_handler_callback, h);
-        lcm_handler_free (h);
+    // the first handler of a type decodes into its own object, which the
+    // later ones of the same dispatch then get
+    const void *decoded = decode (rbuf, msg) < 0 ? NULL : msg;
+    if (cache && cache->num_decoded < LCM_MAX_SHARED_DECODES) {
+        lcm_decoded_t *d = &cache->decoded[cache->num_decoded++];
+        d->owner = cache->handler;
+        d->type_hash = type_hash;
+        d->decode = decode;
+        d->msg = decoded;
     }
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    return decoded;
+}
+
+/* ==== Dispatch thread pool ==== */
 
+static lcm_pooled_msg_t *
+pooled_msg_new (const lcm_recv_buf_t *buf, const char *channel)
+{
+    size_t channel_size = strlen (channel) + 1;
+    lcm_pooled_msg_t *msg = (lcm_pooled_msg_t *) malloc (
+            sizeof (lcm_pooled_msg_t) + buf->data_size + channel_size);
+    char *data = (char *) (msg + 1);
+    msg->owner.block = NULL;
+    msg->owner.loan = loan_new (msg, 1);
+    msg->rbuf = *buf;
+    msg->rbuf.data = data;
+    msg->rbuf.owner = &msg->owner;
+    memcpy (data, buf->data, buf->data_size);
+    msg->channel = data + buf->data_size;
+    memcpy (msg->channel, channel, channel_size);
+    // a subscription may decode its next message while the others still
+    // read this one, so on dispatch threads each decodes its own
+    msg->rbuf.decoded = NULL;
+    return msg;
+}
+
+static void
+pooled_msg_unref (lcm_pooled_msg_t *msg)
+{
+    loan_unref (msg->owner.loan);
+}
+
+// orders dispatch_runnable by decreasing priority, and otherwise keeps the
+// order the subscriptions were scheduled in
+static gint
+runnable_compare (gconstpointer a, gconstpointer b, gpointer user)
+{
+    int pa = g_atomic_int_get (&((const lcm_subscription_t *) a)->priority);
+    int pb = g_atomic_int_get (&((const lcm_subscription_t *) b)->priority);
+    return pa >= pb ? -1 : 1;
+}
+
+// Has a dispatch thread run h, after the runnable subscriptions of the same
+// or a higher priority.  Must be called with dispatch_mutex held.
+static void
+dispatch_schedule (lcm_t *lcm, lcm_subscription_t *h)
+{
+    if (g_atomic_int_get (&lcm->num_prioritized))
+        g_queue_insert_sorted (lcm->dispatch_runnable, h, runnable_compare,
+                NULL);
+    else
+        g_queue_push_tail (lcm->dispatch_runnable, h);
+}
+
+// queue a message for delivery to h by the dispatch threads
+static void
+dispatch_pool_push (lcm_t *lcm, lcm_subscription_t *h, lcm_pooled_msg_t *msg)
+{
+    g_mutex_lock (lcm->dispatch_mutex);
+    g_atomic_int_inc (&msg->owner.loan->ref);
+    if (!h->pool_msgs)
+        h->pool_msgs = g_queue_new ();
+    if (g_atomic_int_get (&h->conflate)) {
+        // drop whatever is still waiting for a dispatch thread
+        int num_dropped = 0;
+        while (!g_queue_is_empty (h->pool_msgs)) {
+            pooled_msg_unref ((lcm_pooled_msg_t *) g_queue_pop_head (h->pool_msgs));
+            g_atomic_int_add (&h->num_pool_msgs, -1);
+            num_dropped++;
+        }
+        if (num_dropped)
+            handler_count_dropped (h, num_dropped);
+    }
+    g_queue_push_tail (h->pool_msgs, msg);
+    g_atomic_int_inc (&h->num_pool_msgs);
+    if (!h->pool_scheduled) {
+        // the subscription is kept alive while it has queued messages
+        h->pool_scheduled = 1;
+        g_atomic_int_inc (&h->ref);
+        dispatch_schedule (lcm, h);
+        g_cond_signal (lcm->dispatch_cond);
+    }
+    g_mutex_unlock (lcm->dispatch_mutex);
+}
+
+static void *
+dispatch_thread (void *user)
+{
+    lcm_t *lcm = (lcm_t *) user;
+
+    g_mutex_lock (lcm->dispatch_mutex);
+    while (1) {
+        while (!lcm->dispatch_exit && g_queue_is_empty (lcm->dispatch_runnable))
+            g_cond_wait (lcm->dispatch_cond, lcm->dispatch_mutex);
+        if (lcm->dispatch_exit)
+            break;
+
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_queue_pop_head (lcm->dispatch_runnable);
+        lcm_pooled_msg_t *msg = (lcm_pooled_msg_t *) g_queue_pop_head (h->pool_msgs);
+        g_mutex_unlock (lcm->dispatch_mutex);
+
+        if (!g_atomic_int_get (&h->marked_for_deletion))
+            handler_invoke (h, &msg->rbuf, msg->channel);
+        g_atomic_int_add (&h->num_pool_msgs, -1);
+        pooled_msg_unref (msg);
+
+        g_mutex_lock (lcm->dispatch_mutex);
+        if (!g_queue_is_empty (h->pool_msgs)) {
+            // go to the back of the line of its priority so that other
+            // subscriptions get a turn
+            dispatch_schedule (lcm, h);
+        } else {
+            h->pool_scheduled = 0;
+            lcm_handler_unref (h);
+        }
+    }
+    g_mutex_unlock (lcm->dispatch_mutex);
+    return NULL;
+}
+
+static void
+dispatch_pool_start (lcm_t *lcm, int num_threads)
+{
+    lcm->dispatch_mutex = g_mutex_new ();
+    lcm->dispatch_cond = g_cond_new ();
+    lcm->dispatch_runnable = g_queue_new ();
+    lcm->dispatch_exit = 0;
+    lcm->dispatch_threads = (GThread **) calloc (num_threads, sizeof (GThread *));
+    for (int i = 0; i < num_threads; i++) {
+        lcm->dispatch_threads[i] = g_thread_create (dispatch_thread, lcm,
+                TRUE, NULL);
+        if (!lcm->dispatch_threads[i])
+            break;
+        lcm->num_dispatch_threads++;
+    }
+    if (lcm->num_dispatch_threads < num_threads)
+        fprintf (stderr, "Warning: started only %d of %d dispatch threads\n",
+                lcm->num_dispatch_threads, num_threads);
+}
+
+// joins the dispatch threads and drops any messages not yet delivered
+static void
+dispatch_pool_stop (lcm_t *lcm)
+{
+    g_mutex_lock (lcm->dispatch_mutex);
+    lcm->dispatch_exit = 1;
+    g_cond_broadcast (lcm->dispatch_cond);
+    g_mutex_unlock (lcm->dispatch_mutex);
+
+    for (int i = 0; i < lcm->num_dispatch_threads; i++)
+        g_thread_join (lcm->dispatch_threads[i]);
+    free (lcm->dispatch_threads);
+    lcm->dispatch_threads = NULL;
+    lcm->num_dispatch_threads = 0;
+
+    while (!g_queue_is_empty (lcm->dispatch_runnable)) {
+        lcm_subscription_t *h =
+            (lcm_subscription_t *) g_queue_pop_head (lcm->dispatch_runnable);
+        while (!g_queue_is_empty (h->pool_msgs)) {
+            pooled_msg_unref ((lcm_pooled_msg_t *) g_queue_pop_head (h->pool_msgs));
+            g_atomic_int_add (&h->num_pool_msgs, -1);
+        }
+        h->pool_scheduled = 0;
+        lcm_handler_unref (h);
+    }
+    g_queue_free (lcm->dispatch_runnable);
+    g_cond_free (lcm->dispatch_cond);
+    g_mutex_free (lcm->dispatch_mutex);
+}
+
+static gpointer
+tx_thread (gpointer user)
+{
+    lcm_t *lcm = (lcm_t *) user;
+    lcm_internal_thread_init ("lcm-tx", NULL, NULL);
+
+    g_mutex_lock (lcm->tx_mutex);
+    while (1) {
+        while (!lcm->tx_exit && !lcm->tx_head)
+            g_cond_wait (lcm->tx_cond, lcm->tx_mutex);
+        // the messages still queued are transmitted before exiting
+        if (!lcm->tx_head)
+            break;
+
+        lcm_publish_buf_t *pb = lcm->tx_head;
+        lcm->tx_head = pb->next;
+        if (!lcm->tx_head)
+            lcm->tx_tail = NULL;
+        g_mutex_unlock (lcm->tx_mutex);
+
+        unsigned int datalen = pb->datalen;
+        int status = lcm->vtable->publish (lcm->provider, pb->channel, pb + 1,
+                datalen);
+        publish_buf_put (lcm, pb);
+
+        // a message counts as queued until it has been transmitted
+        g_mutex_lock (lcm->tx_mutex);
+        lcm->tx_stats.num_queued--;
+        lcm->tx_stats.queued_bytes -= datalen;
+        if (status < 0)
+            lcm->tx_stats.num_failed++;
+        else
+            lcm->tx_stats.num_transmitted++;
+        g_cond_broadcast (lcm->tx_space_cond);
+    }
+    g_mutex_unlock (lcm->tx_mutex);
+    return NULL;
+}
+
+static void
+tx_queue_start (lcm_t *lcm, int queue_mb, int block)
+{
+    lcm->tx_mutex = g_mutex_new ();
+    lcm->tx_cond = g_cond_new ();
+    lcm->tx_space_cond = g_cond_new ();
+    lcm->tx_queue_cap = (int64_t) queue_mb * 1024 * 1024;
+    lcm->tx_block = block;
+    lcm->tx_thread = g_thread_create (tx_thread, lcm, TRUE, NULL);
+    if (!lcm->tx_thread) {
+        fprintf (stderr, "Warning: LCM failed to start the transmit thread, "
+                "publishing synchronously\n");
+        g_cond_free (lcm->tx_space_cond);
+        g_cond_free (lcm->tx_cond);
+        g_mutex_free (lcm->tx_mutex);
+    }
+}
+
+// joins the transmit thread once it has transmitted the queued messages
+static void
+tx_queue_stop (lcm_t *lcm)
+{
+    g_mutex_lock (lcm->tx_mutex);
+    lcm->tx_exit = 1;
+    g_cond_signal (lcm->tx_cond);
+    g_mutex_unlock (lcm->tx_mutex);
+
+    g_thread_join (lcm->tx_thread);
+    lcm->tx_thread = NULL;
+    g_cond_free (lcm->tx_space_cond);
+    g_cond_free (lcm->tx_cond);
+    g_mutex_free (lcm->tx_mutex);
+}
+
+// Encodes the stats as an lcm_stats_report_t and publishes them on
+// LCM_STATS_CHANNEL.
+static void
+publish_stats (lcm_t *lcm, char *host)
+{
+    lcm_stats_t stats;
+    lcm_get_stats (lcm, &stats);
+
+    lcm_stats_report_t report;
+    memset (&report, 0, sizeof (report));
+    report.utime = lcm_clock_realtime_us ();
+    report.host = host;
+    report.pid = getpid ();
+    report.num_published = stats.num_published;
+    report.bytes_published = stats.bytes_published;
+    report.num_publish_failed = stats.num_publish_failed;
+    report.num_received = stats.num_received;
+    report.bytes_received = stats.bytes_received;
+    report.num_dropped_queue_full = stats.num_dropped_queue_full;
+    report.num_queued = stats.num_queued;
+    report.num_wakeups = stats.num_wakeups;
+
+    const lcm_transport_stats_t *t = &stats.transport;
+    report.has_transport_stats = stats.has_transport_stats;
+    report.num_packets = t->num_packets;
+    report.num_bytes = t->num_bytes;
+    report.num_bad_packets = t->num_bad_packets;
+    report.num_lost = t->num_lost;
+    report.num_reordered = t->num_reordered;
+    report.num_duplicated = t->num_duplicated;
+    report.num_incomplete = t->num_incomplete;
+    report.num_dropped_no_buffer = t->num_dropped_no_buffer;
+    report.num_fec_recovered = t->num_fec_recovered;
+    report.num_nacked = t->num_nacked;
+    report.num_retransmitted = t->num_retransmitted;
+    report.num_senders = t->num_senders;
+    report.ring_low_watermark = t->ring_low_watermark;
+    report.frag_bytes_high_watermark = t->frag_bytes_high_watermark;
+
+    const lcm_publish_queue_stats_t *q = &stats.publish_queue;
+    report.has_publish_queue_stats = stats.has_publish_queue_stats;
+    report.tx_num_queued = q->num_queued;
+    report.tx_queued_bytes = q->queued_bytes;
+    report.tx_max_queued_bytes = q->max_queued_bytes;
+    report.tx_num_transmitted = q->num_transmitted;
+    report.tx_num_failed = q->num_failed;
+    report.tx_num_dropped = q->num_dropped;
+
+    int size = lcm_stats_report_t_encoded_size (&report);
+    void *buf = lcm_publish_reserve (lcm, LCM_STATS_CHANNEL, size);
+    if (!buf)
+        return;
+    if (lcm_stats_report_t_encode (buf, 0, size, &report) < 0) {
+        lcm_publish_cancel (lcm, buf);
+        return;
+    }
+    lcm_publish_commit (lcm, buf, size);
+}
+
+static gpointer
+stats_thread (gpointer user)
+{
+    lcm_t *lcm = (lcm_t *) user;
+    lcm_internal_thread_init ("lcm-stats", NULL, NULL);
+
+    char host[256];
+    if (gethostname (host, sizeof (host)) != 0)
+        strcpy (host, "unknown");
+    host[sizeof (host) - 1] = 0;
+
+    int64_t next_utime = lcm_clock_realtime_us ();
+    g_mutex_lock (lcm->stats_mutex);
+    while (!lcm->stats_exit) {
+        next_utime += (int64_t) lcm->stats_interval_ms * 1000;
+        // g_cond_timed_wait() takes a wall clock deadline
+        GTimeVal deadline;
+        deadline.tv_sec = next_utime / 1000000;
+        deadline.tv_usec = next_utime % 1000000;
+        while (!lcm->stats_exit &&
+                g_cond_timed_wait (lcm->stats_cond, lcm->stats_mutex,
+                    &deadline))
+            ;
+        if (lcm->stats_exit)
+            break;
+        g_mutex_unlock (lcm->stats_mutex);
+
+        publish_stats (lcm, host);
+
+        // keep to the schedule, unless the wall clock was set
+        int64_t now = lcm_clock_realtime_us ();
+        int64_t interval_usec = (int64_t) lcm->stats_interval_ms * 1000;
+        if (next_utime < now - interval_usec || next_utime > now + interval_usec)
+            next_utime = now;
+        g_mutex_lock (lcm->stats_mutex);
+    }
+    g_mutex_unlock (lcm->stats_mutex);
+    return NULL;
+}
+
+static void
+stats_publisher_start (lcm_t *lcm, int interval_ms)
+{
+    lcm->stats_mutex = g_mutex_new ();
+    lcm->stats_cond = g_cond_new ();
+    lcm->stats_interval_ms = interval_ms;
+    lcm->stats_thread = g_thread_create (stats_thread, lcm, TRUE, NULL);
+    if (!lcm->stats_thread) {
+        fprintf (stderr, "Warning: LCM failed to start the stats thread\n");
+        g_cond_free (lcm->stats_cond);
+        g_mutex_free (lcm->stats_mutex);
+    }
+}
+
+static void
+stats_publisher_stop (lcm_t *lcm)
+{
+    g_mutex_lock (lcm->stats_mutex);
+    lcm->stats_exit = 1;
+    g_cond_signal (lcm->stats_cond);
+    g_mutex_unlock (lcm->stats_mutex);
+
+    g_thread_join (lcm->stats_thread);
+    lcm->stats_thread = NULL;
+    g_cond_free (lcm->stats_cond);
+    g_mutex_free (lcm->stats_mutex);
+}
+
+int
+lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel)
+{
+    return lcm_dispatch_handlers_by_id (lcm, buf, channel, -1);
+}
+
+int
+lcm_dispatch_handlers_by_id (lcm_t * lcm, lcm_recv_buf_t * buf,
+        const char *channel, int channel_id)
+{
+    // holding a reference to the list guarantees that its handlers will not
+    // be destroyed by an lcm_unsubscribe during the callbacks.  Handlers added
+    // during the callbacks go into a new list and are not invoked.
+    lcm_handler_list_t * list = lcm_acquire_handlers (lcm, channel,
+            channel_id);
+    lcm_pooled_msg_t *msg = NULL;
+
+    g_static_mutex_lock (&lcm->stats_lock);
+    lcm->stats.num_received++;
+    lcm->stats.bytes_received += buf->data_size;
+    g_static_mutex_unlock (&lcm->stats_lock);
+
+    // with several subscriptions, each message type is decoded only once
+    lcm_decode_cache_t decoded;
+    decoded.num_decoded = 0;
+    buf->decoded = NULL;
+
+    if (lcm->dispatch_tap)
+        lcm->dispatch_tap (buf, channel, lcm->dispatch_tap_user);
+
+    if (list->num_handlers > 1)
+        buf->decoded = &decoded;
+    for (unsigned int i = 0; i < list->num_handlers; i++) {
+        lcm_subscription_t *h = list->handlers[i];
+        if (g_atomic_int_get (&h->marked_for_deletion))
+            continue;
+        int num_queued = handler_dequeue_message (h);
+        if (!num_queued)
+            continue;
+        if (num_queued > 1 && g_atomic_int_get (&h->conflate)) {
+            // a newer message for this subscription is already queued
+            handler_count_dropped (h, 1);
+            LCM_TRACE4 (drop, channel, buf->data_size, -1,
+                    LCM_TRACE_DROP_CONFLATED);
+            continue;
+        }
+        if (lcm->num_dispatch_threads) {
+            // the provider reclaims buf once we return, so the dispatch
+            // threads get a copy
+            if (!msg)
+                msg = pooled_msg_new (buf, channel);
+            dispatch_pool_push (lcm, h, msg);
+        } else {
+            decoded.handler = h;
+            handler_invoke (h, buf, channel);
+        }
+    }
+
+    if (msg)
+        pooled_msg_unref (msg);
+    buf->decoded = NULL;
+    handler_list_unref (list);
     return 0;
 }
 
+void
+lcm_internal_set_dispatch_tap (lcm_t * lcm, lcm_msg_handler_t tap,
+        void *user)
+{
+    lcm->dispatch_tap = tap;
+    lcm->dispatch_tap_user = user;
+}
+
 int
 lcm_parse_url (const char * url, char ** provider, char ** network,
         GHashTable * args)
@@ -522,8 +2214,57 @@ lcm_parse_url (const char * url, char ** provider, char ** network,
 int 
 lcm_subscription_set_queue_capacity(lcm_subscription_t* subs, int num_messages)
 {
-    g_static_rec_mutex_lock(&subs->lcm->mutex);
-    subs->max_num_queued_messages = num_messages;
-    g_static_rec_mutex_unlock(&subs->lcm->mutex);
+    g_atomic_int_set(&subs->max_num_queued_messages, num_messages);
+    return 0;
+}
+
+int
+lcm_subscription_set_conflate(lcm_subscription_t* subs, int conflate)
+{
+    lcm_t *lcm = subs->lcm;
+    g_static_rec_mutex_lock(&lcm->mutex);
+    int old = g_atomic_int_get(&subs->conflate);
+    g_atomic_int_set(&subs->conflate, conflate != 0);
+    if (!g_atomic_int_get(&subs->marked_for_deletion) && !old != !conflate)
+        g_atomic_int_add(&lcm->num_conflating, conflate ? 1 : -1);
+    // the messages queued so far were not counted, or not all of them
+    g_atomic_int_set(&subs->num_deferred, 0);
+    g_static_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+int
+lcm_subscription_set_priority(lcm_subscription_t* subs, int priority)
+{
+    lcm_t *lcm = subs->lcm;
+    g_static_rec_mutex_lock(&lcm->mutex);
+    int old = g_atomic_int_get(&subs->priority);
+    g_atomic_int_set(&subs->priority, priority);
+    if (!g_atomic_int_get(&subs->marked_for_deletion) && !old != !priority)
+        g_atomic_int_add(&lcm->num_prioritized, priority ? 1 : -1);
+    g_static_rec_mutex_unlock(&lcm->mutex);
+    return 0;
+}
+
+int
+lcm_subscription_set_max_rate(lcm_subscription_t* subs, double max_rate_hz)
+{
+    g_static_mutex_lock(&subs->stats_lock);
+    if(max_rate_hz > 0) {
+        subs->rate_interval_ns = (int64_t) (1e9 / max_rate_hz);
+        subs->rate_next_ns = 0;
+    }
+    g_static_mutex_unlock(&subs->stats_lock);
+    g_atomic_int_set(&subs->rate_limited, max_rate_hz > 0);
+    return 0;
+}
+
+int
+lcm_subscription_get_stats(lcm_subscription_t* subs,
+        lcm_subscription_stats_t* stats)
+{
+    g_static_mutex_lock(&subs->stats_lock);
+    *stats = subs->stats;
+    g_static_mutex_unlock(&subs->stats_lock);
     return 0;
 }
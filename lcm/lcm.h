@@ -54,6 +54,12 @@ typedef struct _lcm_t lcm_t;
  */
 typedef struct _lcm_subscription_t lcm_subscription_t;
 
+/**
+ * An opaque data structure for a message being published in pieces, see
+ * lcm_publish_stream_begin().
+ */
+typedef struct _lcm_publish_stream_t lcm_publish_stream_t;
+
 /**
  * Received messages are passed to user programs using this data structure.
  * Each instance represents one message.
@@ -78,6 +84,24 @@ struct _lcm_recv_buf_t
      * pointer to the lcm_t struct that owns this buffer
      */
     lcm_t *lcm;
+    /**
+     * for internal use.  Identifies the storage behind @c data so that
+     * lcm_recv_buf_retain() can keep it alive without copying it.  May be
+     * NULL.
+     */
+    struct _lcm_recv_buf_owner *owner;
+    /**
+     * timestamp (nanoseconds since the epoch) at which the message was
+     * received.  Only has more than microsecond resolution if the provider
+     * was asked for finer timestamps, e.g. with the @c rx_timestamp option
+     * of udpm.
+     */
+    int64_t recv_time_ns;
+    /**
+     * for internal use.  The messages decoded by the handlers of the other
+     * subscriptions, see lcm_recv_buf_decode().  May be NULL.
+     */
+    struct _lcm_decode_cache *decoded;
 };
 
 /**
@@ -118,9 +142,286 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
              size of the kernel UDP receive buffer to request.  Defaults to
              operating system defaults
 
+         recv_pool_size = N
+             maximum number of bytes used to hold received messages until
+             they are handled, not counting messages reassembled from
+             fragments.  Datagrams that arrive when it is reached are
+             dropped.  Defaults to 32 MB
+
+         prealloc = [0|1]
+             if 1, the memory for recv_pool_size is allocated and touched
+             when the LCM instance is created, so that receiving never calls
+             malloc() or takes page faults for it.  Default 0
+
+         frag_store_mb = N
+             if set, hard cap in megabytes on the memory holding messages
+             being reassembled from fragments.  The oldest incomplete
+             messages are dropped to make room, and messages larger than the
+             cap are dropped outright and counted in num_dropped_too_large.
+             Without it, up to 16 MB is held, and a single larger message is
+             let through
+
+         max_frag_msgs = N
+             number of fragmented messages that may be reassembled at once.
+             Default 1000
+
+         frag_timeout_ms = N
+             how long a message being reassembled is kept when none of its
+             fragments arrive, after which it is dropped and counted in
+             num_incomplete.  -1 keeps it until it is evicted to make room
+             for others.  Default 2000
+
          ttl = N
              time to live of transmitted packets.  Default 0
 
+         max_rate_mbps = N
+             if set, large messages are fragmented and their fragments are
+             transmitted no faster than N megabits per second, so that slower
+             receivers do not drop them.  Messages that fit in a single packet
+             are never delayed.  Defaults to 0 (unlimited)
+
+         burst_kb = N
+             number of kilobytes of fragments that may be transmitted back to
+             back before max_rate_mbps applies.  Defaults to 256
+
+         mtu = N
+             if set, published datagrams are no larger than N bytes with
+             their IP and UDP headers, so that IP does not fragment them on
+             a network with that MTU, e.g. 9000 with jumbo frames.  Larger
+             messages are split into fragments of that size.  N must be at
+             least 576.  Receivers accept any fragment size.  mpudpm takes
+             this option too.  Defaults to the largest UDP datagram (1500 on
+             OS X)
+
+         recv_threads = N
+             number of receive sockets and threads (Linux only).  Each one
+             receives and reassembles the messages of a subset of the
+             publishers, chosen by a hash of their address and port, so that
+             receiving from many publishers can use more than one core.
+             mpudpm takes this option too, on every platform, and divides
+             its ports between the threads instead, so that traffic spread
+             over many ports can use more than one core.  Defaults to 1
+
+         rx_timestamp = ns | sw | hw
+             source of the receive timestamps (Linux only).  "ns" and "sw" use
+             the kernel's nanosecond software timestamps.  "hw" uses the
+             network interface's hardware timestamps, and falls back to
+             software timestamps for packets that have none.  Hardware
+             timestamping must already be enabled on the interface, and the
+             interface clock should be synchronized to the system clock.
+             By default, the kernel's microsecond timestamps are used.
+
+         fec = K[:M]
+             if set, every group of K fragments of a large message is
+             followed by M parity packets (M defaults to 1), and receivers
+             rebuild a lost fragment from them without retransmission.  Up to
+             M consecutive fragments lost in a group can be rebuilt.  K can
+             be at most 255 and M at most K.  Receivers without this option
+             ignore the parity packets, which they count as bad packets.
+             Defaults to no parity packets
+
+         channel_filter = 0 | 1
+             if 1, a socket filter drops the messages on channels that
+             nothing subscribes to in the kernel, before they are copied to
+             the process (Linux only).  Subscriptions to regular expressions
+             turn the filter off.  Defaults to 1
+
+         reliable = REGEX
+             the publisher keeps the messages it publishes on the channels
+             that match REGEX, and retransmits them when a receiver reports
+             them lost.  Only the receivers that asked for a message accept
+             its retransmission.  By default, no messages are kept
+
+         retransmit_window = N
+             the number of most recently published messages from which
+             retransmissions can be made.  Defaults to 64
+
+         nack = 0 | 1
+             if 1, a receiver that sees a gap in a sender's sequence numbers
+             asks for the missing messages once.  Turns channel_filter off,
+             since messages dropped there would look lost.  Defaults to 0
+
+         ignore_local = 0 | 1
+             if 1, datagrams sent from any address of this host are dropped
+             on receipt, so that only other hosts are heard.  Turns the self
+             test off, since it relies on the instance hearing itself.  Not
+             supported on Windows.  Defaults to 0
+
+         interfaces = IFACE[,IFACE...]
+             udpm only: network interfaces, by name or IPv4 address, that
+             datagrams are transmitted on and the group is joined on (Linux
+             only), e.g. "eth0,eth1" on a host with two links.  Every
+             datagram leaves from the address of the first one, so the
+             receivers see one sender whichever link it came over, and
+             strict reverse path filtering on them must be off.  Receivers
+             that list several interfaces drop copies of the messages they
+             already received.  By default, the group is joined and
+             transmitted to through the interface of the default route
+
+         interface_mode = stripe | redundant
+             with interfaces, "stripe" sends each datagram on the next
+             interface in turn, so that large messages use the bandwidth of
+             all of the links.  "redundant" sends every datagram on each
+             of them, so that messages get through while any link is up.
+             Defaults to stripe
+
+         interest = 0 | 1
+             if 1, the instance announces the channel patterns it subscribes
+             to on the group, and keeps track of what the other instances
+             with interest=1 announce, so that lcm_has_remote_subscribers()
+             can tell whether anybody would receive a channel.  Starts the
+             receive threads right away.  Defaults to 0
+
+         announce_ms = MS
+             with interest=1, how often the subscriptions are announced, in
+             milliseconds.  An instance is forgotten after three intervals
+             without an announcement.  Defaults to 1000
+
+         io = select | uring | iocp
+             how the read threads receive datagrams.  "uring" uses io_uring
+             (Linux 6.0 or later, and LCM built with LCM_ENABLE_IO_URING),
+             where the kernel keeps receiving into a ring of buffers with no
+             system call per datagram.  Falls back to the default if io_uring
+             is not available.  "iocp" (Windows only) keeps overlapped
+             receives posted on an I/O completion port, so that a read
+             thread wakes up once per datagram without calling select().
+             Defaults to iocp on Windows and select elsewhere
+
+         xdp = IFNAME
+             if set, an XDP program on the network interface IFNAME hands
+             the group's datagrams to AF_XDP sockets, one for each read
+             thread, which read them from memory shared with the driver
+             instead of taking them from the kernel's network stack (Linux
+             5.9 or later, and LCM built with LCM_ENABLE_XDP).  Needs
+             CAP_NET_ADMIN and CAP_BPF, or root.  Read thread @c i gets
+             receive queue @c xdp_queue + @c i of the interface, so the
+             interface should spread the group over that many queues, e.g.
+             with ethtool -L or -N.  Datagrams on other queues, IP
+             fragments, and those longer than about 3800 bytes still take
+             the usual path, as does everything if the program can not be
+             attached, e.g. because the interface already has one.  The
+             datagrams taken this way no longer reach the other sockets of
+             the host, so other processes on it can not receive the group
+             on that interface.  io=uring is not used with it
+
+         xdp_queue = N
+             with xdp, the receive queue of the first read thread.  Defaults
+             to 0
+
+         busy_poll = N
+             if set, the read threads and lcm_handle() spin for up to N
+             microseconds waiting for packets before they sleep, which
+             lowers the wakeup latency at the cost of CPU time.  The receive
+             sockets also get SO_BUSY_POLL (Linux only), which may need
+             CAP_NET_ADMIN.  The read threads do not spin with io=uring.
+             Defaults to 0
+
+         rx_cpu = CPUS
+             pins the read threads to CPUS, a list such as "3" or "0,2-3"
+             (Linux only).  mpudpm takes this option too.  See also
+             lcm_set_thread_hook()
+
+         rx_sched = POLICY[:PRIORITY]
+             scheduling policy of the read threads: fifo, rr or other, e.g.,
+             "fifo:50".  Realtime policies usually need CAP_SYS_NICE or an
+             rtprio limit.  mpudpm takes this option too
+
+         numa = auto | NODES | off
+             places the read threads, and the memory they receive into, on a
+             NUMA node (Linux only).  With auto, that is the node of the
+             network interface: the xdp interface if set, or else the one
+             the group is routed through.  NODES is a list such as "0" or
+             "0,1", read thread i taking the (i mod n)th node, so that with
+             recv_threads each node has read threads and buffer pools of its
+             own.  The threads run on the CPUs of their node unless rx_cpu
+             is set.  Handler threads can be placed with
+             lcm_set_thread_scheduling().  Default off
+
+         self_test = async | sync | off
+             when the first subscription starts receiving, udpm publishes
+             messages to itself to check that multicast works.  "async"
+             starts receiving right away and runs the test on a background
+             thread, "sync" makes the first subscription wait for it, and
+             "off" skips it.  A failed test is reported on stderr, and by
+             lcm_get_self_test_status() and lcm_set_self_test_handler().
+             With "sync", it also stops the provider from receiving.
+             Defaults to async.  mpudpm takes "sync", its default, and "off"
+
+         compress = lz4 | zlib | none
+             compresses the messages published on the channels that match
+             compress_channels, if they are at least compress_min bytes and
+             get smaller.  A compressed message is marked with its own magic
+             numbers, so receivers that have no support for it drop it,
+             while every receiver with support decompresses it whatever its
+             own options.  Each codec is only available if LCM was built
+             with it.  Defaults to none
+
+         compress_min = N
+             the smallest message, in bytes, that is compressed.  Defaults to
+             4096
+
+         compress_channels = REGEX
+             the channels whose messages are compressed.  Defaults to all
+             channels
+
+         tx_sockets = N
+             the number of transmit sockets, up to 64.  Each thread that
+             publishes always uses the same socket, so that its messages
+             stay in order, and threads on different sockets publish at
+             the same time instead of taking turns.  Receivers see each
+             socket as a separate sender.  Defaults to 1
+
+         batch_us = N
+             udpm only: small messages wait up to N microseconds for later
+             ones, and are transmitted several to a datagram of at most one
+             MTU (1500 bytes if mtu is not set), which saves system calls
+             and packets when many small messages are published.  Larger
+             messages, and the messages of lcm_publish_stream_begin(), are
+             transmitted after the waiting ones so that they stay in order.
+             Receivers that have no support for batches drop these
+             datagrams.  Defaults to 0, no batching
+
+         qos_channels = REGEX
+             udpm only: latency-critical channels, such as e-stop and
+             control, which are transmitted on a socket of their own whose
+             datagrams are marked with qos_dscp and qos_priority, so that
+             switches and the interface queue let them ahead of bulk
+             traffic.  They are never batched, and may overtake messages
+             published earlier on other channels.  Defaults to none
+
+         qos_dscp = N
+             the DSCP, 0 to 63, of the datagrams of qos_channels.  Defaults
+             to 46, Expedited Forwarding
+
+         qos_priority = N
+             the Linux SO_PRIORITY of the datagrams of qos_channels, which
+             picks the queue of the interface.  Above 6 it needs
+             CAP_NET_ADMIN.  Defaults to 6
+
+         port_policy = hash | load
+             mpudpm only: how channels are spread over its nports ports.
+             "hash" puts each channel on a port chosen by hashing its name.
+             "load" also measures how much each process publishes on its
+             channels, and every few seconds moves one heavy channel to the
+             least loaded port when that relieves the port it shares, so
+             that subscribers receive less traffic for channels they did
+             not ask for.  Every process follows a move whatever its own
+             policy, but subscribers may miss a few messages while the
+             channel moves.  Defaults to hash
+
+         drop_rate = P, dup_rate = P, reorder_rate = P
+             for testing only: each transmitted datagram is dropped with
+             probability P, transmitted twice with probability P, or held
+             back and transmitted after the next datagram with probability
+             P, so that receivers can be tested against a bad network.  The
+             messages of mpudpm's own channels are left alone.  Defaults
+             to 0
+
+         fault_seed = N
+             seeds the random choices of drop_rate, dup_rate and
+             reorder_rate, so that runs can be repeated.  Defaults to a
+             different seed every time
+
      examples:
          "udpm://239.255.76.67:7667"
              Default initialization string
@@ -138,7 +439,8 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
      Events are read from or written to the log file.  In read mode, events
      are generated from the log file in real-time, or at the rate specified
      by the speed option.  In write mode, events published to the LCM instance
-     will be written to the log file in real-time.
+     will be written to the log file in real-time.  Compressed log files, as
+     written by lcm-logger --compress, are read like any other.
 
      options:
          speed = N
@@ -148,8 +450,17 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
              never skipped in read mode, so actual playback speed may be slower
              than requested, depending on the handlers.
 
-         mode = r | w
-             Specifies the log file mode.  Defaults to 'r'
+         mode = r | w | a | afap
+             Specifies the log file mode.  Defaults to 'r'.  'afap' reads the
+             log as fast as possible, like speed=0.  Each call to lcm_handle
+             then dispatches the next event right away, without going through
+             the timer thread.
+
+         flow_control = 0 | 1
+             When playing back as fast as possible, wait until no subscriber
+             to the next event's channel has a full queue before dispatching
+             it, so that subscribers with a queue capacity, such as those
+             dispatched by thread pools, see every event.  Defaults to 0.
 
          start_timestamp = USEC
              Seeks to USEC microseconds in the logfile, where USEC is given in
@@ -158,6 +469,67 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
              log file.  If it is after the last event, calls to lcm_handle will
              return -1.
 
+         channel = REGEX
+             In read mode, only play back the events on channels that match
+             the regular expression REGEX, which is implicitly surrounded by
+             '^' and '$' like a subscription.  Other events are never read,
+             and if the log has an index, the blocks of events without a
+             matching channel are skipped.  The remaining events keep their
+             original timing.  Characters special to URLs, like '?' and '&',
+             can be written as %XX escapes.
+
+         mmap = 0 | 1
+             In read mode, map the log into memory and play it back in place,
+             so that the data of each received message points into the
+             mapping instead of a copy.  Compressed logs, stripe manifests,
+             playback by channel, and logs larger than mmap_limit_mb are read
+             as usual.  Not available on Windows.  Defaults to 0.
+
+         mmap_limit_mb = N
+             Largest log, in megabytes, that mmap=1 maps.  Defaults to 1024.
+
+         read_ahead = N
+             Read up to N events ahead of playback from a thread of its own,
+             with the file advised as read sequentially, so that the latency
+             of the disk or of a network file system is hidden behind the
+             playback timing.  Defaults to 0, reading each event when the
+             previous one is dispatched.
+
+         preload = 0 | 1
+             In read mode, read all the events to play, from start_timestamp
+             on and on the channels selected by channel, into one block of
+             memory before playback starts, locked into RAM if the process
+             may, and play them from there.  Defaults to 0.
+
+         loop = 0 | 1
+             Play the preloaded events over and over, implying preload=1.
+             Each pass starts the mean interval between events after the
+             last event of the previous one, and the timestamps keep
+             increasing from pass to pass.  Defaults to 0.
+
+         loop_count = N
+             With loop=1, stop after N passes.  Defaults to 0, looping until
+             the LCM instance is destroyed.
+
+         precise = 0 | 1
+             Time playback against the monotonic clock, which NTP cannot
+             slew, sleeping with clock_nanosleep() to the absolute deadline
+             of each event and spinning for the last spin_usec microseconds.
+             Linux only.  Defaults to 0.
+
+         spin_usec = N
+             Length of the spin at the end of each precise wait.  Defaults to
+             50.
+
+         timing_log = PATH
+             With precise=1, writes a line per event to PATH holding the
+             event's log timestamp and the difference between the time
+             lcm_handle dispatched it and its deadline, in nanoseconds.
+
+         rx_cpu = CPUS, rx_sched = POLICY[:PRIORITY]
+             CPUs and scheduling policy of the thread that times playback in
+             read mode, as for udpm
+
      examples:
          "file:///home/albert/path/to/logfile"
              Loads the file "/home/albert/path/to/logfile" as an LCM event
@@ -180,12 +552,227 @@ typedef void (*lcm_msg_handler_t) (const lcm_recv_buf_t *rbuf,
     that require deterministic and predictable behavior that is independent of
     a system's network configuration.
 
-    example:
+    Publishing reuses the storage of messages already handled, so that in
+    steady state it does not allocate memory, and any thread may publish
+    without waiting for lcm_handle().
+
+    options:
+
+        zero_copy = 1
+            lcm_publish_commit() queues the buffer obtained from
+            lcm_publish_reserve() instead of copying it, so that handlers
+            see the buffer the publisher encoded into.  This saves a copy
+            of large messages, but the buffer is not recycled for the next
+            lcm_publish_reserve().  Defaults to 0
+
+    examples:
         "memq://"
-            This is the only valid way to instantiate this provider.
+
+        "memq://?zero_copy=1"
+
+ @endverbatim
+ *
+ * @verbatim
+ inproc://
+    Direct in-process provider
+
+    Like memq, this provider is private to the LCM instance, but nothing is
+    queued: lcm_publish() invokes the matching handlers before it returns,
+    on the publishing thread, with the publisher's buffer.  There is no
+    need to call lcm_handle(), which would block, and lcm_handle_timeout()
+    always times out.  Handlers run on whichever threads publish, so with
+    several publishing threads they must be thread-safe.
+    Subscription queue capacities and conflation still apply.
+
+    options:
+
+        defer = 1
+            A handler that publishes on the same instance does not invoke
+            the handlers of that message right away, nested inside its own
+            call.  Instead, the message is copied and dispatched after the
+            handlers of the outermost lcm_publish() have returned, in the
+            order such messages were published.  Defaults to 0
+
+        max_depth = N
+            without defer, the deepest that publishing from handlers may
+            nest.  lcm_publish() returns -1 beyond that.  Defaults to 16
+
+    examples:
+        "inproc://"
+
+        "inproc://?defer=1"
+
+ @endverbatim
+ *
+ * @verbatim
+ shared://URL
+    Process-wide sharing of one LCM instance
+
+    All instances in the process created with the same shared:// URL share
+    one instance of URL, which has the only sockets, receive threads and
+    reassembly buffers.  A fan-out thread handles its messages and queues
+    each one once on every shared instance subscribed to its channel, so
+    that memory and receive work stay flat however many instances a process
+    creates.  Each shared instance still has its own handlers, lcm_handle()
+    and subscription queue capacities, and what one publishes reaches the
+    others like it would with separate instances.  The underlying instance
+    is destroyed with the last shared instance.
+
+    The options after URL are those of URL, and instances only share if
+    they have the same ones, in any order.  The options of LCM itself, such
+    as dispatch_threads and async_tx, apply to each shared instance.
+    lcm_get_transport_stats() reports those of the underlying instance.
+
+    examples:
+        "shared://udpm://239.255.76.67:7667?ttl=1"
 
  @endverbatim
  *
+ * @verbatim
+ tcpq://
+    TCP queue provider
+    network is the "address:port" of an LCM TCP server, such as the one
+    started by lcm.lcm.TCPService in Java.  Defaults to "127.0.0.1:7700"
+
+    options:
+        nodelay = 0 | 1
+            Whether to disable Nagle's algorithm on the connection.  Each
+            message is written with a single system call, so there is no
+            benefit in delaying it.  Defaults to 1
+
+        cork = 0 | 1
+            Linux only: hold small messages in the kernel until they fill
+            a TCP segment, which suits publishing many small messages in a
+            burst.  The held messages are sent when lcm_handle() is next
+            called, or after at most 200 ms.  Defaults to 0
+
+    example:
+        "tcpq://127.0.0.1:7700?cork=1"
+
+ @endverbatim
+ *
+ * @verbatim
+ shm://
+    Shared memory provider, Linux only
+    network is a name, "default" if omitted.  All the LCM instances on the
+    host created with the same name exchange messages through a ring in the
+    shared memory segment /dev/shm/lcm-NAME, which the first one creates.
+
+    Publishing copies the message into the ring without taking a lock or
+    making a system call, unless a receiver is asleep waiting for messages.
+    Each receiving instance copies the messages it has handlers for out of
+    the ring from a read thread.  The ring does not wait for slow receivers:
+    once it is full, new messages overwrite the oldest ones, and a receiver
+    that fell behind by more than the ring size loses messages, which
+    lcm_get_transport_stats() counts.  A message may take at most a quarter
+    of the ring.  The segment outlives the processes and can be removed
+    once none of them is running.
+
+    options:
+        size_mb = N
+            Size of the ring in megabytes, rounded up to a power of two.  Only
+            used by the instance that creates the segment.  Defaults to 32
+
+        rx_cpu = CPUS, rx_sched = POLICY[:PRIORITY]
+            CPUs and scheduling policy of the read thread, as for udpm
+
+    example:
+        "shm://perception?size_mb=256"
+
+ @endverbatim
+ *
+ * @verbatim
+ hybrid://
+    Shared memory on the host, multicast between hosts, Linux only
+    network is "multicast-address:port", as for udpm.  The hybrid instances
+    of a group on the same host exchange messages through shm://, and only
+    send a message over udpm if an instance on another host subscribes to
+    its channel.  The instances learn about each other's subscriptions from
+    announcements on the multicast group.  The multicast datagrams that come
+    from the host itself are ignored, so a hybrid instance does not hear the
+    udpm instances of its own host, and they only hear it while it sends to
+    some other host.  Udpm instances with interest=1 on other hosts take part
+    in the announcements, and lcm_has_remote_subscribers() covers the hybrid
+    instances of both the host and the other hosts.
+
+    options:
+        shm = NAME
+            the shm segment, by default derived from network, so that all
+            the hybrid instances of a group on the host share one
+
+        shm_size_mb = N
+            the size_mb option of the shm segment
+
+        udp = auto | always
+            with "always", every message is sent over udpm too, for
+            applications on other hosts that are not hybrid instances and so
+            do not announce their subscriptions.  Defaults to auto
+
+        announce_ms = N
+            milliseconds between two announcements of the subscriptions,
+            which are also announced as soon as they change.  An instance not
+            heard from for three of its intervals is forgotten.  Defaults to
+            1000
+
+    All the other options are those of udpm.
+
+    example:
+        "hybrid://239.255.76.67:7667?ttl=1"
+
+ @endverbatim
+ *
+ * In addition to the provider-specific options, the following options are
+ * accepted by every provider:
+ *
+ * @verbatim
+    dispatch_threads = N
+        Number of threads used to invoke message handlers.  Defaults to 0,
+        in which case handlers are invoked from the thread that calls
+        lcm_handle().  Otherwise, lcm_handle() hands each message to a pool
+        of N threads and returns without waiting for the handlers.  Messages
+        are delivered to each subscription in the order they were received,
+        one at a time, but different subscriptions may run concurrently on
+        different threads.  Handlers must be thread-safe with respect to
+        each other.
+
+    async_tx = 1
+        Publish from a background thread.  lcm_publish() copies the message
+        into a queue and returns without waiting for the provider, so that
+        a full socket send buffer does not stall the caller, and
+        lcm_publish_commit() queues the reserved buffer itself.  Messages
+        are transmitted in the order they were queued, and lcm_destroy()
+        transmits the ones still queued.  See also
+        lcm_get_publish_queue_stats().  Defaults to 0
+
+    tx_queue_mb = N
+        cap on the bytes of the messages queued with async_tx, in megabytes.
+        Defaults to 64
+
+    tx_queue_policy = drop | block
+        what publishing does when the async_tx queue is full.  "drop"
+        discards the message and returns -1, and "block" waits for room.
+        Defaults to drop
+
+    stats_interval = MS
+        Publish the instance's lcm_stats_t every MS milliseconds on
+        LCM_STATS_CHANNEL, from a background thread.  Defaults to 0, which
+        publishes nothing
+
+    skip_unsubscribed = 0 | 1
+        if 1, messages on channels that neither this instance nor any other
+        subscribes to, as far as lcm_has_remote_subscribers() knows, are not
+        transmitted: lcm_publish() returns 0 without handing them to the
+        provider, and counts them in the lcm_stats_t num_suppressed.  See
+        lcm_publish_wanted() for skipping the encoding as well.  Only safe
+        if every subscriber announces its subscriptions, such as udpm
+        instances with interest=1 or hybrid instances.  Defaults to 0
+
+    examples:
+        "udpm://239.255.76.67:7667?dispatch_threads=4"
+
+        "udpm://239.255.76.67:7667?async_tx=1&tx_queue_mb=64"
+ @endverbatim
+ *
  * @return a newly allocated lcm_t instance, or NULL on failure.  Free with
  * lcm_destroy() when no longer needed.
  */
@@ -280,11 +867,151 @@ LCM_EXPORT
 int lcm_publish (lcm_t *lcm, const char *channel, const void *data,
         unsigned int datalen);
 
+/**
+ * @brief Tells whether another %LCM instance subscribes to a channel.
+ *
+ * The instances learn about each other's subscriptions from the
+ * announcements they make, as udpm instances created with the @c interest=1
+ * option and hybrid instances do.  An instance only knows about the others
+ * once it has been running for one announcement interval.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel
+ *
+ * @return 1 if another instance is known to subscribe to @p channel, 0 if
+ * none does, or -1 if the provider can not tell.
+ */
+LCM_EXPORT
+int lcm_has_remote_subscribers (lcm_t *lcm, const char *channel);
+
+/**
+ * @brief Tells whether a message published on a channel would be
+ * transmitted.
+ *
+ * With the @c skip_unsubscribed option of lcm_create(), this is 0 for the
+ * channels that neither @p lcm nor, according to
+ * lcm_has_remote_subscribers(), any other instance subscribes to.  The
+ * message-specific publish functions generated by @c lcm-gen call it, so
+ * that those messages are not even encoded.  Otherwise, it is always 1.
+ * A 0 counts the message as suppressed, so call it only for a message that
+ * is about to be published, and skip the publishing.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ *
+ * @return 1 if a message on @p channel would be transmitted, 0 if it would
+ * be skipped.
+ */
+LCM_EXPORT
+int lcm_publish_wanted (lcm_t *lcm, const char *channel);
+
+/**
+ * @brief Obtain a buffer to encode a message into before publishing it.
+ *
+ * Together with lcm_publish_commit(), this replaces the allocate, encode,
+ * publish, free sequence of lcm_publish().  Buffers are recycled by the %LCM
+ * instance, so in steady state publishing this way does not allocate memory.
+ * The message-specific publish functions generated by @c lcm-gen use it.
+ *
+ * Every buffer obtained must be passed to either lcm_publish_commit() or
+ * lcm_publish_cancel().  This function is thread-safe, and each buffer is
+ * owned by the caller until then.
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ * @param size     The maximum number of bytes that will be written
+ *
+ * @return a buffer of at least @p size bytes, or NULL on failure.
+ */
+LCM_EXPORT
+void * lcm_publish_reserve (lcm_t *lcm, const char *channel, unsigned int size);
+
+/**
+ * @brief Publish the contents of a buffer obtained from lcm_publish_reserve().
+ *
+ * The buffer is released, whether or not publishing succeeds.
+ *
+ * @param lcm      The %LCM object
+ * @param buf      The buffer returned by lcm_publish_reserve()
+ * @param datalen  The number of bytes to publish.  Must not be larger than
+ *                 the size reserved.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+LCM_EXPORT
+int lcm_publish_commit (lcm_t *lcm, void *buf, unsigned int datalen);
+
+/**
+ * @brief Release a buffer obtained from lcm_publish_reserve() without
+ * publishing it.
+ */
+LCM_EXPORT
+void lcm_publish_cancel (lcm_t *lcm, void *buf);
+
+/**
+ * @brief Start publishing a message that is written in pieces.
+ *
+ * For very large messages, this avoids holding the whole encoded message in
+ * memory: the message is written with lcm_publish_stream_write() in pieces
+ * of any size, and the udpm provider transmits each fragment as soon as it
+ * is full.  Other providers, and udpm messages that are short, compressed,
+ * protected by forward error correction or published on reliable channels,
+ * are collected in a buffer from lcm_publish_reserve() and published by
+ * lcm_publish_stream_end().
+ *
+ * While a message is streamed by udpm, other threads that publish on the same
+ * transmit socket wait for it to be finished.
+ *
+ * Every stream must be passed to either lcm_publish_stream_end() or
+ * lcm_publish_stream_cancel().
+ *
+ * @param lcm      The %LCM object
+ * @param channel  The channel to publish on
+ * @param datalen  The exact size of the message, in bytes
+ *
+ * @return the stream, or NULL on failure.
+ */
+LCM_EXPORT
+lcm_publish_stream_t * lcm_publish_stream_begin (lcm_t *lcm,
+        const char *channel, unsigned int datalen);
+
+/**
+ * @brief Append @p len bytes to a message started by
+ * lcm_publish_stream_begin().
+ *
+ * @return 0 on success, or -1 on failure, including writing more than the
+ * size given to lcm_publish_stream_begin().  After a failure, the stream can
+ * only be cancelled.
+ */
+LCM_EXPORT
+int lcm_publish_stream_write (lcm_publish_stream_t *stream, const void *data,
+        unsigned int len);
+
+/**
+ * @brief Finish publishing a message started by lcm_publish_stream_begin().
+ *
+ * The stream is released, whether or not publishing succeeds.
+ *
+ * @return 0 on success, or -1 on failure, including if fewer bytes were
+ * written than the size given to lcm_publish_stream_begin().
+ */
+LCM_EXPORT
+int lcm_publish_stream_end (lcm_publish_stream_t *stream);
+
+/**
+ * @brief Release a stream started by lcm_publish_stream_begin() without
+ * finishing the message.  Receivers drop the fragments already transmitted.
+ */
+LCM_EXPORT
+void lcm_publish_stream_cancel (lcm_publish_stream_t *stream);
+
 /**
  * @brief Wait for and dispatch the next incoming message.
  *
  * Message handlers are invoked one at a time from the thread that calls this
- * function, and in the order that they were subscribed.
+ * function, and in the order that they were subscribed.  If the instance was
+ * created with the @c dispatch_threads option, handlers are instead invoked
+ * from the dispatch thread pool, see lcm_create().
  *
  * This function waits indefinitely.  If you want timeout behavior, (e.g., wait
  * 100ms for a message) then consider using lcm_get_fileno() together with
@@ -310,7 +1037,9 @@ int lcm_handle (lcm_t *lcm);
  *
  * This function largely exists for convenience, and its behavior can be
  * replicated by using lcm_fileno() and lcm_handle() in conjunction with
- * select() or poll().
+ * select() or poll().  It uses poll() internally, so it also works with file
+ * descriptors that are too large for select().  To wait on several instances
+ * at once, see lcm_poll_set_create().
  *
  * New in LCM 1.1.0.
  *
@@ -325,6 +1054,32 @@ int lcm_handle (lcm_t *lcm);
 LCM_EXPORT
 int lcm_handle_timeout (lcm_t *lcm, int timeout_millis);
 
+/**
+ * @brief Wait for and dispatch a batch of incoming messages, up to a time
+ * limit.
+ *
+ * This function waits up to @p timeout_millis milliseconds for a message to
+ * arrive, and then dispatches up to @p max_msgs messages that have already
+ * been received, without waiting for more.  Draining several messages per
+ * call amortizes the locking and notification overhead of lcm_handle(), which
+ * helps at high message rates.
+ *
+ * The same restrictions as for lcm_handle() apply.
+ *
+ * @param lcm the %LCM object
+ * @param max_msgs the maximum number of messages to dispatch.  Must be
+ *        positive.
+ * @param timeout_millis the maximum amount of time to wait for the first
+ *        message, in milliseconds.  If 0, then dispatches any available
+ *        messages and then returns immediately.  Values less than 0 are not
+ *        allowed.
+ *
+ * @return the number of messages handled, 0 if the function timed out, and <0
+ * if an error occured.
+ */
+LCM_EXPORT
+int lcm_handle_batch (lcm_t *lcm, int max_msgs, int timeout_millis);
+
 /**
  * @brief Adjusts the maximum number of received messages that can be queued up
  * for a subscription.
@@ -346,6 +1101,632 @@ int lcm_handle_timeout (lcm_t *lcm, int timeout_millis);
 LCM_EXPORT
 int lcm_subscription_set_queue_capacity(lcm_subscription_t* handler, int num_messages);
 
+/**
+ * @brief Delivers only the newest message queued for a subscription.
+ *
+ * Meant for channels that carry state, such as a pose estimate, where only the
+ * most recent message matters.  When enabled, messages that are superseded by
+ * a newer one before their handler runs are dropped instead of dispatched, so
+ * a slow handler always sees fresh data.  Dropped messages are counted in the
+ * @c num_dropped statistic.  The queue capacity is ignored while conflating.
+ *
+ * @param handler the subscription object
+ * @param conflate 1 to enable conflation, 0 to restore the default FIFO
+ *        delivery.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_conflate(lcm_subscription_t* handler, int conflate);
+
+/**
+ * @brief Sets the priority with which messages are dispatched to a
+ * subscription.
+ *
+ * Messages of a channel take the highest priority of the subscriptions to
+ * it.  Where messages wait for lcm_handle(), those of a higher priority are
+ * handled first, so that a latency-critical channel does not wait behind a
+ * burst of bulk traffic received before it.  The udpm provider keeps the
+ * messages of a priority above 0 in ready queues of their own, and the
+ * dispatch threads of the @c dispatch_threads option run the subscriptions
+ * with messages in order of decreasing priority.  Messages of the same
+ * priority keep the order they arrived in.  The other providers deliver in
+ * arrival order.
+ *
+ * @param handler the subscription object
+ * @param priority higher values are dispatched first.  The default is 0.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_priority(lcm_subscription_t* handler, int priority);
+
+/**
+ * @brief Limits the rate at which a subscription receives messages.
+ *
+ * Meant for displays and monitors that subscribe to a fast channel but only
+ * need to see it every so often.  Messages that arrive sooner than
+ * 1 / @p max_rate_hz seconds after the last one the subscription took are
+ * skipped when they are received, before they are queued, copied or
+ * decoded, and counted in the @c num_decimated statistic.  A provider drops
+ * a message that no subscription takes as early as it can, so udpm does
+ * not reassemble the fragments of one that only rate-limited subscriptions
+ * would get.
+ *
+ * @param handler the subscription object
+ * @param max_rate_hz the most messages per second to take, on average, or
+ *        0 to take every message, which is the default.
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_set_max_rate(lcm_subscription_t* handler,
+        double max_rate_hz);
+
+/**
+ * The number of buckets in lcm_subscription_stats_t::handler_time_histogram.
+ */
+#define LCM_HANDLER_HISTOGRAM_BUCKETS 24
+
+/**
+ * Counters collected for each subscription, retrieved with
+ * lcm_subscription_get_stats().  All counts start at zero when the
+ * subscription is created.
+ */
+typedef struct _lcm_subscription_stats_t lcm_subscription_stats_t;
+struct _lcm_subscription_stats_t
+{
+    /**
+     * the number of messages accepted into the subscription's queue
+     */
+    int64_t num_enqueued;
+    /**
+     * the number of messages passed to the subscription's handler
+     */
+    int64_t num_dispatched;
+    /**
+     * the number of messages discarded because the queue was full.  See
+     * lcm_subscription_set_queue_capacity().
+     */
+    int64_t num_dropped;
+    /**
+     * the largest number of messages that have been queued at once
+     */
+    int peak_queue_depth;
+    /**
+     * the total time spent in the handler, in microseconds
+     */
+    int64_t handler_time_usec;
+    /**
+     * the longest that one call of the handler took, in microseconds
+     */
+    int64_t max_handler_time_usec;
+    /**
+     * the number of handler calls by how long they took.  Bucket 0 counts
+     * the calls that took less than 1 microsecond, and bucket @c i > 0 those
+     * that took from 2^(i-1) up to 2^i microseconds.  The last bucket also
+     * counts everything longer.
+     */
+    int64_t handler_time_histogram[LCM_HANDLER_HISTOGRAM_BUCKETS];
+    /**
+     * the number of handler calls that took at least the threshold set with
+     * lcm_set_slow_handler_threshold()
+     */
+    int64_t num_slow;
+    /**
+     * the number of messages skipped to keep to the rate set with
+     * lcm_subscription_set_max_rate()
+     */
+    int64_t num_decimated;
+};
+
+/**
+ * @brief Keeps a received message alive past the end of its handler.
+ *
+ * Normally, the buffer passed to a message handler is reclaimed as soon as the
+ * handler returns.  Calling this function from within the handler returns a
+ * buffer that stays valid until it is passed to lcm_recv_buf_release(), from
+ * any thread, e.g., to hand a large message off to a worker thread.
+ *
+ * When the provider received the message into storage of its own (the memq
+ * provider, and messages that udpm or mpudpm reassembled from fragments),
+ * the returned buffer shares that storage and no data is copied.  Otherwise,
+ * the payload is copied into the returned buffer.  The @c lcm field of the
+ * returned buffer is only valid as long as the %LCM instance is.
+ *
+ * @param rbuf the buffer passed to the handler, or a buffer previously
+ *        returned by this function
+ *
+ * @return a buffer that must be released with lcm_recv_buf_release()
+ */
+LCM_EXPORT
+lcm_recv_buf_t * lcm_recv_buf_retain (const lcm_recv_buf_t *rbuf);
+
+/**
+ * @brief Releases a buffer obtained from lcm_recv_buf_retain().
+ */
+LCM_EXPORT
+void lcm_recv_buf_release (lcm_recv_buf_t *rbuf);
+
+/**
+ * @brief Decodes a received message once for all of its handlers.
+ *
+ * For language bindings.  Decodes @p rbuf into @p msg with @p decode, unless
+ * the message is being dispatched to several subscriptions and the handler
+ * of another one already called this for the same @p type_hash and
+ * @p decode.  That handler's object is then returned instead, and the
+ * caller must not modify it.  A message is only shared between handlers
+ * invoked by the same call to lcm_handle(), not on dispatch threads.
+ *
+ * @param rbuf the buffer passed to the handler
+ * @param type_hash the fingerprint of the message type
+ * @param decode decodes @p rbuf into the object it is passed, and returns a
+ *        negative value if it cannot
+ * @param msg the handler's own object.  It is handed to the later handlers
+ *        of the message, so it must stay valid and unchanged until they
+ *        have run, or until its subscription is removed.
+ *
+ * @return the decoded message, which is either @p msg or the object of
+ *         another handler, or NULL if it cannot be decoded
+ */
+LCM_EXPORT
+const void * lcm_recv_buf_decode (const lcm_recv_buf_t *rbuf,
+        int64_t type_hash, int (*decode) (const lcm_recv_buf_t *rbuf,
+            void *msg), void *msg);
+
+/**
+ * @brief Retrieves queueing and dispatch statistics for a subscription.
+ *
+ * Useful for choosing a queue capacity: a non-zero @c num_dropped means the
+ * handler did not keep up with the incoming messages at the current
+ * capacity, and @c peak_queue_depth shows how deep the queue actually got.
+ *
+ * @param handler the subscription object
+ * @param stats filled in with a snapshot of the subscription's counters
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_subscription_get_stats(lcm_subscription_t* handler,
+        lcm_subscription_stats_t* stats);
+
+/**
+ * Called after a message handler that took at least the threshold set with
+ * lcm_set_slow_handler_threshold().
+ *
+ * @param subscription the subscription whose handler was slow
+ * @param channel the channel of the message that it handled
+ * @param handler_time_usec how long the handler took, in microseconds
+ * @param user_data the pointer passed to lcm_set_slow_handler_threshold()
+ */
+typedef void (*lcm_slow_handler_t) (lcm_subscription_t *subscription,
+        const char *channel, int64_t handler_time_usec, void *user_data);
+
+/**
+ * @brief Reports message handlers that run for too long.
+ *
+ * A handler that blocks delays every other subscription that is dispatched
+ * from the same thread, which then drop messages from their full queues.
+ * Once a threshold is set, each handler call that takes at least that long
+ * is counted in the @c num_slow field of lcm_subscription_stats_t and is
+ * passed to @p callback, from the thread that ran the handler.  Without a
+ * callback, a warning is printed on stderr, at most once a second for each
+ * subscription.
+ *
+ * @param lcm the %LCM object
+ * @param threshold_usec the threshold in microseconds, or 0 to stop
+ *        reporting slow handlers
+ * @param callback called for each slow handler call, or NULL to print
+ *        warnings
+ * @param user_data passed to @p callback
+ *
+ * @return 0 on success, -1 if @p threshold_usec is negative or larger than
+ * INT_MAX
+ */
+LCM_EXPORT
+int lcm_set_slow_handler_threshold(lcm_t *lcm, int64_t threshold_usec,
+        lcm_slow_handler_t callback, void *user_data);
+
+/**
+ * Receive counters kept by the udpm, mpudpm and shm providers, retrieved with
+ * lcm_get_transport_stats().  Counting starts when the provider starts
+ * receiving, i.e., with the first subscription.
+ *
+ * Messages lost, reordered or duplicated are detected from the sequence
+ * number that each sender stamps on its messages, so they count what happened
+ * in the network, as opposed to the messages dropped from full subscription
+ * queues counted by lcm_subscription_get_stats().
+ */
+typedef struct _lcm_transport_stats_t lcm_transport_stats_t;
+struct _lcm_transport_stats_t
+{
+    /**
+     * the number of datagrams received
+     */
+    int64_t num_packets;
+    /**
+     * the bytes of those datagrams, including LCM headers
+     */
+    int64_t num_bytes;
+    /**
+     * the number of datagrams discarded because they were malformed
+     */
+    int64_t num_bad_packets;
+    /**
+     * the number of messages that never arrived, from gaps in the senders'
+     * sequence numbers.  Always 0 for mpudpm, where each port only carries
+     * part of a sender's messages, and for udpm while the channel_filter
+     * option drops the channels nothing subscribes to.
+     */
+    int64_t num_lost;
+    /**
+     * the number of messages that arrived after a later message from the same
+     * sender
+     */
+    int64_t num_reordered;
+    /**
+     * the number of messages that arrived more than once
+     */
+    int64_t num_duplicated;
+    /**
+     * the number of fragmented messages discarded because some of their
+     * fragments never arrived
+     */
+    int64_t num_incomplete;
+    /**
+     * the number of datagrams discarded because the receive buffer pool was
+     * at its memory cap (see the recv_pool_size option)
+     */
+    int64_t num_dropped_no_buffer;
+    /**
+     * the number of fragments that were lost and rebuilt from parity packets
+     * (see the udpm fec option)
+     */
+    int64_t num_fec_recovered;
+    /**
+     * the number of lost messages asked for again (see the udpm nack option)
+     */
+    int64_t num_nacked;
+    /**
+     * the number of those that were retransmitted in time.  They also count
+     * as reordered, and no longer as lost.
+     */
+    int64_t num_retransmitted;
+    /**
+     * the number of senders currently tracked.  For mpudpm, each port a
+     * sender publishes on counts separately.
+     */
+    int num_senders;
+    /**
+     * the smallest fraction of the receive buffer pool that has been free,
+     * from 0 to 1.  Close to 0 means that lcm_handle() did not keep up, and
+     * datagrams may have been dropped.
+     */
+    double ring_low_watermark;
+    /**
+     * the most memory, in bytes, that messages being reassembled from
+     * fragments have held at once.  With several receive threads it is the
+     * sum of each thread's most.
+     */
+    int64_t frag_bytes_high_watermark;
+    /**
+     * the number of fragmented messages discarded because they were larger
+     * than the udpm frag_store_mb cap
+     */
+    int64_t num_dropped_too_large;
+};
+
+/**
+ * @brief Retrieves the provider's receive statistics.
+ *
+ * @param lcm the %LCM object
+ * @param stats filled in with a snapshot of the counters
+ *
+ * @return 0 on success, -1 if the provider does not keep these statistics
+ */
+LCM_EXPORT
+int lcm_get_transport_stats(lcm_t *lcm, lcm_transport_stats_t *stats);
+
+/**
+ * Counters of the asynchronous publish queue (see the @c async_tx option of
+ * lcm_create()), retrieved with lcm_get_publish_queue_stats().
+ */
+typedef struct _lcm_publish_queue_stats_t lcm_publish_queue_stats_t;
+struct _lcm_publish_queue_stats_t
+{
+    /**
+     * the number of messages queued and not transmitted yet
+     */
+    int num_queued;
+    /**
+     * the bytes of those messages
+     */
+    int64_t queued_bytes;
+    /**
+     * the most bytes that have been queued at once
+     */
+    int64_t max_queued_bytes;
+    /**
+     * the number of messages handed to the provider
+     */
+    int64_t num_transmitted;
+    /**
+     * the number of messages that the provider failed to transmit
+     */
+    int64_t num_failed;
+    /**
+     * the number of messages discarded because the queue was full
+     */
+    int64_t num_dropped;
+};
+
+/**
+ * @brief Retrieves the counters of the asynchronous publish queue.
+ *
+ * @param lcm the %LCM object
+ * @param stats filled in with a snapshot of the counters
+ *
+ * @return 0 on success, -1 if @p lcm was not created with the @c async_tx
+ * option
+ */
+LCM_EXPORT
+int lcm_get_publish_queue_stats(lcm_t *lcm, lcm_publish_queue_stats_t *stats);
+
+/**
+ * The channel that an %LCM instance created with the @c stats_interval
+ * option publishes its lcm_stats_t on, encoded as the lcm_stats_report_t
+ * type of lcm/lcmtypes/lcm_stats_report.lcm.
+ */
+#define LCM_STATS_CHANNEL "LCM_STATS"
+
+/**
+ * Everything that an %LCM instance counts, retrieved with lcm_get_stats().
+ * Counting starts when the instance is created.
+ */
+typedef struct _lcm_stats_t lcm_stats_t;
+struct _lcm_stats_t
+{
+    /**
+     * the number of messages published, including those that went to the
+     * asynchronous publish queue
+     */
+    int64_t num_published;
+    /**
+     * the bytes of those messages, not including LCM headers
+     */
+    int64_t bytes_published;
+    /**
+     * the number of messages that could not be published or queued
+     */
+    int64_t num_publish_failed;
+    /**
+     * the number of messages that the provider passed on for dispatch
+     */
+    int64_t num_received;
+    /**
+     * the bytes of those messages, not including LCM headers
+     */
+    int64_t bytes_received;
+    /**
+     * the number of messages that current subscriptions discarded because
+     * their queue was full, the sum of their lcm_subscription_stats_t
+     * num_dropped
+     */
+    int64_t num_dropped_queue_full;
+    /**
+     * the number of messages waiting for a handler, over all subscriptions
+     */
+    int num_queued;
+    /**
+     * the number of times that lcm_handle(), lcm_handle_timeout() or
+     * lcm_handle_batch() went to the provider for messages.  Compared with
+     * @c num_received, this shows how many messages each wakeup handles.
+     */
+    int64_t num_wakeups;
+    /**
+     * nonzero if @c transport holds the provider's receive statistics
+     */
+    int has_transport_stats;
+    /**
+     * see lcm_get_transport_stats()
+     */
+    lcm_transport_stats_t transport;
+    /**
+     * nonzero if @c publish_queue holds the counters of the asynchronous
+     * publish queue
+     */
+    int has_publish_queue_stats;
+    /**
+     * see lcm_get_publish_queue_stats()
+     */
+    lcm_publish_queue_stats_t publish_queue;
+    /**
+     * the number of messages not transmitted because nobody subscribes to
+     * their channel (see the @c skip_unsubscribed option of lcm_create())
+     */
+    int64_t num_suppressed;
+};
+
+/**
+ * @brief Retrieves all of the counters of an %LCM instance at once.
+ *
+ * This includes the provider's receive statistics and the counters of the
+ * publish queue, where there are some.  Creating the instance with the
+ * @c stats_interval=<ms> URL option also publishes them periodically on
+ * #LCM_STATS_CHANNEL, so that other processes can monitor it.
+ *
+ * @param lcm the %LCM object
+ * @param stats filled in with a snapshot of the counters
+ *
+ * @return 0 on success
+ */
+LCM_EXPORT
+int lcm_get_stats(lcm_t *lcm, lcm_stats_t *stats);
+
+/**
+ * The self test has not run: the provider has none, it was turned off with
+ * the @c self_test option, or the provider has not started receiving yet.
+ */
+#define LCM_SELF_TEST_NONE 0
+/**
+ * The self test is running.
+ */
+#define LCM_SELF_TEST_PENDING 1
+/**
+ * The provider received the messages that it published to itself.
+ */
+#define LCM_SELF_TEST_PASSED 2
+/**
+ * The provider did not receive its own messages in time, which usually
+ * means that multicast is not routed to the loopback interface or is
+ * blocked by a firewall.
+ */
+#define LCM_SELF_TEST_FAILED 3
+
+/**
+ * Called when the provider's self test finishes.
+ *
+ * @param lcm the %LCM object
+ * @param status LCM_SELF_TEST_PASSED or LCM_SELF_TEST_FAILED
+ * @param user_data the pointer passed to lcm_set_self_test_handler()
+ */
+typedef void (*lcm_self_test_handler_t) (lcm_t *lcm, int status,
+        void *user_data);
+
+/**
+ * @brief Retrieves the state of the provider's self test.
+ *
+ * The udpm and mpudpm providers check that they receive the messages they
+ * publish when they start receiving, i.e., with the first subscription.  By
+ * default, udpm runs the test in the background while it receives (see its
+ * @c self_test option).
+ *
+ * @param lcm the %LCM object
+ *
+ * @return one of LCM_SELF_TEST_NONE, LCM_SELF_TEST_PENDING,
+ * LCM_SELF_TEST_PASSED or LCM_SELF_TEST_FAILED
+ */
+LCM_EXPORT
+int lcm_get_self_test_status(lcm_t *lcm);
+
+/**
+ * @brief Sets a function to call when the self test finishes.
+ *
+ * The handler is called from an internal %LCM thread with the background
+ * self test, so it must not call lcm_destroy().  If the self test has
+ * already finished, the handler is called right away.
+ *
+ * @param lcm the %LCM object
+ * @param handler the handler, or NULL to remove it
+ * @param user_data passed to @p handler
+ */
+LCM_EXPORT
+void lcm_set_self_test_handler(lcm_t *lcm, lcm_self_test_handler_t handler,
+        void *user_data);
+
+/**
+ * Called by each thread that %LCM starts, from that thread, before it does
+ * anything else.
+ *
+ * @param thread_name what the thread does: "udpm-rx", "udpm-nack",
+ *        "udpm-selftest", "udpm-batch", "mpudpm-rx", "file-timer", "lcm-tx",
+ *        "lcm-stats" or "shared-fanout"
+ * @param user_data the pointer passed to lcm_set_thread_hook()
+ */
+typedef void (*lcm_thread_hook_t) (const char *thread_name, void *user_data);
+
+/**
+ * @brief Sets a hook that applications can use to set up the threads that
+ * %LCM starts, e.g., to pin them to CPUs or to set their scheduling policy.
+ *
+ * The hook applies to all lcm_t instances, and to the threads started after
+ * it is set.  It runs after the @c rx_cpu and @c rx_sched options are applied.
+ *
+ * @param hook the hook, or NULL to remove it
+ * @param user_data passed to @p hook
+ */
+LCM_EXPORT
+void lcm_set_thread_hook (lcm_thread_hook_t hook, void *user_data);
+
+/**
+ * @brief Pins the calling thread to CPUs and sets its scheduling policy.
+ *
+ * This is what the @c rx_cpu and @c rx_sched provider options do to the
+ * receive threads.
+ *
+ * @param cpus a list of CPUs such as "3" or "0,2-3", or NULL to leave the
+ *        affinity alone.  Only supported on Linux.
+ * @param sched a policy and priority such as "fifo:50", "rr:10" or "other",
+ *        or NULL to leave the scheduling alone.  Realtime policies usually
+ *        need CAP_SYS_NICE or an rtprio limit.
+ *
+ * @return 0 on success, -1 if either argument is invalid or could not be
+ * applied
+ */
+LCM_EXPORT
+int lcm_set_thread_scheduling (const char *cpus, const char *sched);
+
+/**
+ * An opaque set of %LCM instances that can be waited on together.
+ */
+typedef struct _lcm_poll_set_t lcm_poll_set_t;
+
+/**
+ * @brief Creates an empty poll set.
+ *
+ * A poll set lets a single thread service many lcm_t instances, e.g., one per
+ * %LCM URL, without building a @c select() or @c poll() loop by hand.  On
+ * Linux the set is backed by epoll, so the cost of waiting does not depend on
+ * the number of instances.  Elsewhere, @c poll() is used.
+ *
+ * @return a newly allocated poll set, or NULL on failure.  Free with
+ * lcm_poll_set_destroy().
+ */
+LCM_EXPORT
+lcm_poll_set_t * lcm_poll_set_create (void);
+
+/**
+ * @brief Destroys a poll set.  The lcm_t instances in the set are not
+ * affected.
+ */
+LCM_EXPORT
+void lcm_poll_set_destroy (lcm_poll_set_t *set);
+
+/**
+ * @brief Adds an %LCM instance to a poll set.
+ *
+ * @return 0 on success, or -1 if @p lcm is already in the set or its file
+ * descriptor could not be added.
+ */
+LCM_EXPORT
+int lcm_poll_set_add (lcm_poll_set_t *set, lcm_t *lcm);
+
+/**
+ * @brief Removes an %LCM instance from a poll set.  This must be done before
+ * the instance is destroyed.
+ *
+ * @return 0 on success, or -1 if @p lcm is not in the set.
+ */
+LCM_EXPORT
+int lcm_poll_set_remove (lcm_poll_set_t *set, lcm_t *lcm);
+
+/**
+ * @brief Waits for incoming messages on any instance in a poll set, up to a
+ * time limit.
+ *
+ * Calls lcm_handle() once on each instance that has a message available.
+ *
+ * @param set the poll set
+ * @param timeout_millis the maximum amount of time to wait, in milliseconds.
+ *        If 0, then dispatches any available messages and then returns
+ *        immediately.  Values less than 0 are not allowed.
+ *
+ * @return the number of messages handled, 0 if the function timed out, and <0
+ * if an error occured.
+ */
+LCM_EXPORT
+int lcm_poll_set_handle_timeout (lcm_poll_set_t *set, int timeout_millis);
+
 /**
  * @}
  */
@@ -0,0 +1,134 @@
+#ifndef __lcm_array_view_hpp__
+#define __lcm_array_view_hpp__
+
+#include <cstddef>
+#include <iterator>
+
+#include "lcm_coretypes.h"
+
+namespace lcm {
+
+/**
+ * @brief A read-only range over an encoded array of a primitive type.
+ *
+ * The views generated by @c lcm-gen @c --cpp-views return these for their
+ * array members.  The range points into the encoded message, which must
+ * outlive it, and its elements are decoded from big-endian as they are read.
+ * Multidimensional arrays are flattened in row-major order.
+ *
+ * @ingroup LcmCpp
+ */
+template <typename T>
+class ArrayView {
+  public:
+    typedef T value_type;
+
+    /**
+     * @brief A random access iterator that decodes the element it points to.
+     */
+    class const_iterator {
+      public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T* pointer;
+        typedef T reference;
+
+        const_iterator() : p(NULL) {}
+        explicit const_iterator(const uint8_t* ptr) : p(ptr) {}
+
+        T operator*() const { return ArrayView<T>::load(p); }
+        T operator[](difference_type i) const
+        {
+            return ArrayView<T>::load(p + i * (difference_type)sizeof(T));
+        }
+        const_iterator& operator++() { p += sizeof(T); return *this; }
+        const_iterator operator++(int) { const_iterator it = *this; ++*this; return it; }
+        const_iterator& operator--() { p -= sizeof(T); return *this; }
+        const_iterator operator--(int) { const_iterator it = *this; --*this; return it; }
+        const_iterator& operator+=(difference_type n)
+        {
+            p += n * (difference_type)sizeof(T);
+            return *this;
+        }
+        const_iterator& operator-=(difference_type n)
+        {
+            p -= n * (difference_type)sizeof(T);
+            return *this;
+        }
+        const_iterator operator+(difference_type n) const { const_iterator it = *this; return it += n; }
+        const_iterator operator-(difference_type n) const { const_iterator it = *this; return it -= n; }
+        difference_type operator-(const const_iterator& o) const
+        {
+            return (p - o.p) / (difference_type)sizeof(T);
+        }
+        bool operator==(const const_iterator& o) const { return p == o.p; }
+        bool operator!=(const const_iterator& o) const { return p != o.p; }
+        bool operator<(const const_iterator& o) const { return p < o.p; }
+        bool operator>(const const_iterator& o) const { return p > o.p; }
+        bool operator<=(const const_iterator& o) const { return p <= o.p; }
+        bool operator>=(const const_iterator& o) const { return p >= o.p; }
+
+      private:
+        const uint8_t* p;
+    };
+
+    ArrayView() : buf(NULL), length(0) {}
+
+    /**
+     * @param data the first encoded element.
+     * @param n the number of elements.
+     */
+    ArrayView(const void* data, int n)
+        : buf(static_cast<const uint8_t*>(data)), length(n)
+    {
+    }
+
+    /**
+     * @brief The number of elements.
+     */
+    int size() const { return length; }
+
+    bool empty() const { return length == 0; }
+
+    /**
+     * @brief Element @p i, which is not checked.
+     */
+    T operator[](int i) const { return load(buf + i * sizeof(T)); }
+
+    const_iterator begin() const { return const_iterator(buf); }
+    const_iterator end() const { return const_iterator(buf + length * sizeof(T)); }
+
+    /**
+     * @brief Decodes @p count elements starting at @p first into @p dst.
+     *
+     * @return @p count, or -1 if the elements are out of range.
+     */
+    int copy(T* dst, int first, int count) const
+    {
+        if (first < 0 || count < 0 || count > length - first)
+            return -1;
+        __lcm_copy_swapped(dst, buf + first * sizeof(T), count, sizeof(T));
+        return count;
+    }
+
+    /**
+     * @brief The encoded elements, in big-endian byte order.
+     */
+    const void* bytes() const { return buf; }
+
+  private:
+    static T load(const uint8_t* p)
+    {
+        T v;
+        __lcm_copy_swapped(&v, p, 1, sizeof(T));
+        return v;
+    }
+
+    const uint8_t* buf;
+    int length;
+};
+
+}  // namespace lcm
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lcm_clock.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(WIN32)
+#define LCM_CLOCK_USE_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+// how long the TSC is compared with CLOCK_MONOTONIC, in nanoseconds
+#define TSC_CALIBRATION_NSEC 10000000
+
+#ifdef LCM_CLOCK_USE_TSC
+typedef struct {
+    int enabled;
+    uint64_t tsc0;
+    int64_t ns0;
+    // nanoseconds per tick, in 32.32 fixed point
+    uint64_t mult;
+} tsc_clock_t;
+
+static tsc_clock_t tsc_clock;
+static GStaticMutex tsc_clock_mutex = G_STATIC_MUTEX_INIT;
+static volatile gint tsc_clock_initialized = 0;
+
+// Returns nonzero if the TSC runs at a constant rate in every power state.
+static int
+tsc_is_invariant (void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid (0x80000000, &eax, &ebx, &ecx, &edx) == 0 ||
+            eax < 0x80000007)
+        return 0;
+    __get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx >> 8) & 1;
+}
+
+static void
+tsc_clock_init (void)
+{
+    const char *mode = getenv ("LCM_CLOCK");
+    if (!mode || strcmp (mode, "tsc") || !tsc_is_invariant ())
+        return;
+
+    int64_t ns0 = lcm_clock_monotonic_ns ();
+    uint64_t tsc0 = __rdtsc ();
+    int64_t ns1;
+    uint64_t tsc1;
+    do {
+        ns1 = lcm_clock_monotonic_ns ();
+        tsc1 = __rdtsc ();
+    } while (ns1 - ns0 < TSC_CALIBRATION_NSEC);
+
+    if (tsc1 <= tsc0)
+        return;
+    tsc_clock.mult = (uint64_t) ((((unsigned __int128) (ns1 - ns0)) << 32) /
+            (tsc1 - tsc0));
+    tsc_clock.tsc0 = tsc1;
+    tsc_clock.ns0 = ns1;
+    tsc_clock.enabled = 1;
+}
+#endif
+
+int64_t
+lcm_clock_fast_ns (void)
+{
+#ifdef LCM_CLOCK_USE_TSC
+    if (!g_atomic_int_get (&tsc_clock_initialized)) {
+        g_static_mutex_lock (&tsc_clock_mutex);
+        if (!tsc_clock_initialized) {
+            tsc_clock_init ();
+            g_atomic_int_set (&tsc_clock_initialized, 1);
+        }
+        g_static_mutex_unlock (&tsc_clock_mutex);
+    }
+    if (tsc_clock.enabled) {
+        uint64_t ticks = __rdtsc () - tsc_clock.tsc0;
+        return tsc_clock.ns0 +
+            (int64_t) (((unsigned __int128) ticks * tsc_clock.mult) >> 32);
+    }
+#endif
+    return lcm_clock_monotonic_ns ();
+}
@@ -0,0 +1,101 @@
+#ifndef __lcm_clock_h__
+#define __lcm_clock_h__
+
+#include <stdint.h>
+#include <time.h>
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The clocks used inside LCM.
+ *
+ * The realtime clock is the wall clock.  It timestamps received messages
+ * and log events, which are compared across processes and hosts.
+ *
+ * The monotonic clock never jumps and is not slewed by NTP.  It is used for
+ * everything that measures an interval: timeouts, pacing, log playback
+ * scheduling and statistics.
+ *
+ * On POSIX systems both are clock_gettime(), which the C library answers
+ * from the vDSO without a system call.  These functions are inline so that
+ * the programs built with the library can use them as well.
+ */
+
+#ifndef WIN32
+
+static inline int64_t
+lcm_clock_realtime_ns (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline int64_t
+lcm_clock_monotonic_ns (void)
+{
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#else
+
+static inline int64_t
+lcm_clock_realtime_ns (void)
+{
+    GTimeVal tv;
+    g_get_current_time (&tv);
+    return ((int64_t) tv.tv_sec * 1000000 + tv.tv_usec) * 1000;
+}
+
+static inline int64_t
+lcm_clock_monotonic_ns (void)
+{
+#if GLIB_CHECK_VERSION(2,28,0)
+    return g_get_monotonic_time () * 1000;
+#else
+    return lcm_clock_realtime_ns ();
+#endif
+}
+
+#endif
+
+/* The wall clock time, in microseconds since the epoch, which is the unit
+ * of LCM timestamps. */
+static inline int64_t
+lcm_clock_realtime_us (void)
+{
+    return lcm_clock_realtime_ns () / 1000;
+}
+
+/* The monotonic time, in microseconds from an unspecified start. */
+static inline int64_t
+lcm_clock_monotonic_us (void)
+{
+    return lcm_clock_monotonic_ns () / 1000;
+}
+
+/*
+ * A monotonic time, in nanoseconds, for code that reads the clock in a tight
+ * loop or once per message.  Only the difference between two of its values
+ * is meaningful.
+ *
+ * If the LCM_CLOCK environment variable is "tsc" and the CPU has an
+ * invariant time stamp counter, this reads the counter and scales it with a
+ * calibration against CLOCK_MONOTONIC that the first call makes (which takes
+ * about 10 ms).  Otherwise it is lcm_clock_monotonic_ns().
+ *
+ * Only available inside the library.
+ */
+int64_t lcm_clock_fast_ns (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
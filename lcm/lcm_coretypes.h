@@ -6,6 +6,30 @@
 #include <string.h>
 #include <stdlib.h>
 
+/*
+ * LCM encodes integers and floating point numbers big-endian.  On
+ * little-endian hosts, arrays of them are byte-swapped in blocks with SSSE3,
+ * AVX2 or NEON shuffles when the compiler targets them (e.g., with
+ * -mssse3, -mavx2 or -march=native), and one element at a time otherwise.
+ * Define LCM_CORETYPES_NO_SIMD to always use the latter.
+ */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__) && \
+    __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define __LCM_BIG_ENDIAN
+#elif !defined(LCM_CORETYPES_NO_SIMD)
+#if defined(__AVX2__)
+#define __LCM_SIMD_AVX2
+#define __LCM_SIMD_SSSE3
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#define __LCM_SIMD_SSSE3
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define __LCM_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -29,6 +53,168 @@ struct ___lcm_hash_ptr
     int64_t (*v)(void);
 };
 
+/**
+ * BYTE ORDER
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define __lcm_bswap16(v) __builtin_bswap16(v)
+#define __lcm_bswap32(v) __builtin_bswap32(v)
+#define __lcm_bswap64(v) __builtin_bswap64(v)
+#elif defined(_MSC_VER)
+#define __lcm_bswap16(v) _byteswap_ushort(v)
+#define __lcm_bswap32(v) _byteswap_ulong(v)
+#define __lcm_bswap64(v) _byteswap_uint64(v)
+#else
+static inline uint16_t __lcm_bswap16(uint16_t v)
+{
+    return (uint16_t) ((v >> 8) | (v << 8));
+}
+
+static inline uint32_t __lcm_bswap32(uint32_t v)
+{
+    return (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+}
+
+static inline uint64_t __lcm_bswap64(uint64_t v)
+{
+    return ((uint64_t) __lcm_bswap32((uint32_t) v) << 32) |
+        __lcm_bswap32((uint32_t) (v >> 32));
+}
+#endif
+
+#ifdef __LCM_SIMD_SSSE3
+// the shuffle that reverses the bytes of each element of a given size
+static inline __m128i __lcm_bswap_mask(int size)
+{
+    if (size == 2)
+        return _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                9, 8, 11, 10, 13, 12, 15, 14);
+    if (size == 4)
+        return _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                11, 10, 9, 8, 15, 14, 13, 12);
+    return _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0,
+            15, 14, 13, 12, 11, 10, 9, 8);
+}
+#endif
+
+/*
+ * Copies an array of elements of size 1, 2, 4 or 8 between host and network
+ * byte order, which is the same operation in both directions.  Neither
+ * pointer needs to be aligned.  Both are inlined with a constant size, so
+ * only one of the branches on size remains.
+ */
+static inline void __lcm_copy_swapped(void *_dst, const void *_src,
+        int elements, int size)
+{
+    uint8_t *dst = (uint8_t*) _dst;
+    const uint8_t *src = (const uint8_t*) _src;
+    int total_size = elements * size;
+
+#ifdef __LCM_BIG_ENDIAN
+    (void) size;
+    memcpy(dst, src, total_size);
+#else
+    int pos = 0;
+
+    if (size == 1) {
+        memcpy(dst, src, total_size);
+        return;
+    }
+
+#ifdef __LCM_SIMD_SSSE3
+    const __m128i mask = __lcm_bswap_mask(size);
+#ifdef __LCM_SIMD_AVX2
+    const __m256i mask256 = _mm256_broadcastsi128_si256(mask);
+    for (; pos + 32 <= total_size; pos += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (src + pos));
+        _mm256_storeu_si256((__m256i*) (dst + pos),
+                _mm256_shuffle_epi8(v, mask256));
+    }
+#endif
+    for (; pos + 16 <= total_size; pos += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (src + pos));
+        _mm_storeu_si128((__m128i*) (dst + pos), _mm_shuffle_epi8(v, mask));
+    }
+#elif defined(__LCM_SIMD_NEON)
+    for (; pos + 16 <= total_size; pos += 16) {
+        uint8x16_t v = vld1q_u8(src + pos);
+        if (size == 2)
+            v = vrev16q_u8(v);
+        else if (size == 4)
+            v = vrev32q_u8(v);
+        else
+            v = vrev64q_u8(v);
+        vst1q_u8(dst + pos, v);
+    }
+#endif
+
+    // the rest, one element at a time
+    if (size == 2) {
+        for (; pos < total_size; pos += 2) {
+            uint16_t v;
+            memcpy(&v, src + pos, 2);
+            v = __lcm_bswap16(v);
+            memcpy(dst + pos, &v, 2);
+        }
+    } else if (size == 4) {
+        for (; pos < total_size; pos += 4) {
+            uint32_t v;
+            memcpy(&v, src + pos, 4);
+            v = __lcm_bswap32(v);
+            memcpy(dst + pos, &v, 4);
+        }
+    } else {
+        for (; pos < total_size; pos += 8) {
+            uint64_t v;
+            memcpy(&v, src + pos, 8);
+            v = __lcm_bswap64(v);
+            memcpy(dst + pos, &v, 8);
+        }
+    }
+#endif
+}
+
+/*
+ * Like __lcm_copy_swapped(), for elements that lie dst_stride and src_stride
+ * bytes apart, such as one member of each of an array of encoded structs.
+ * Inlined with constant strides and size, the loop is simple enough for the
+ * compiler to vectorize.
+ */
+static inline void __lcm_copy_swapped_strided(void *_dst, int dst_stride,
+        const void *_src, int src_stride, int elements, int size)
+{
+    uint8_t *dst = (uint8_t*) _dst;
+    const uint8_t *src = (const uint8_t*) _src;
+    int i;
+
+    for (i = 0; i < elements; i++) {
+        const uint8_t *s = src + (size_t) i * src_stride;
+        uint8_t *d = dst + (size_t) i * dst_stride;
+#ifdef __LCM_BIG_ENDIAN
+        memcpy(d, s, size);
+#else
+        if (size == 1) {
+            *d = *s;
+        } else if (size == 2) {
+            uint16_t v;
+            memcpy(&v, s, 2);
+            v = __lcm_bswap16(v);
+            memcpy(d, &v, 2);
+        } else if (size == 4) {
+            uint32_t v;
+            memcpy(&v, s, 4);
+            v = __lcm_bswap32(v);
+            memcpy(d, &v, 4);
+        } else {
+            uint64_t v;
+            memcpy(&v, s, 8);
+            v = __lcm_bswap64(v);
+            memcpy(d, &v, 8);
+        }
+#endif
+    }
+}
+
 /**
  * BOOLEAN
  */
@@ -37,14 +223,110 @@ struct ___lcm_hash_ptr
 #define __boolean_encoded_array_size __int8_t_encoded_array_size
 #define __boolean_encode_array __int8_t_encode_array
 #define __boolean_decode_array __int8_t_decode_array
+#define __boolean_decode_array_arena __int8_t_decode_array_arena
 #define __boolean_clone_array __int8_t_clone_array
 #define boolean_encoded_size int8_t_encoded_size
 
+/**
+ * ARENA
+ *
+ * A bump allocator for the *_decode_arena() functions of the generated
+ * types.  Everything a decoded message points to is allocated from the
+ * arena, and released all at once with lcm_arena_reset() or
+ * lcm_arena_free() instead of with *_decode_cleanup().  After a reset the
+ * arena keeps its largest block, so that decoding messages of a similar size
+ * over and over soon stops allocating at all.
+ */
+typedef struct _lcm_arena_block_t lcm_arena_block_t;
+struct _lcm_arena_block_t
+{
+    lcm_arena_block_t *next;
+    size_t size;
+    size_t used;
+};
+
+typedef struct _lcm_arena_t lcm_arena_t;
+struct _lcm_arena_t
+{
+    // the block being allocated from, followed by the smaller, full ones
+    lcm_arena_block_t *blocks;
+};
+
+#define LCM_ARENA_INITIALIZER { NULL }
+
+// allocations are aligned for any primitive type
+#define __LCM_ARENA_ALIGN(sz) (((sz) + 15) & ~(size_t) 15)
+#define __LCM_ARENA_MIN_BLOCK 4096
+
+static inline void lcm_arena_init(lcm_arena_t *arena)
+{
+    arena->blocks = NULL;
+}
+
+/**
+ * Allocates sz bytes from the arena.  Returns NULL if sz is 0, or if no
+ * memory is left.
+ */
+static inline void *lcm_arena_alloc(lcm_arena_t *arena, size_t sz)
+{
+    lcm_arena_block_t *block = arena->blocks;
+    const size_t header = __LCM_ARENA_ALIGN(sizeof(lcm_arena_block_t));
+
+    if (!sz)
+        return NULL;
+    sz = __LCM_ARENA_ALIGN(sz);
+    if (!block || block->size - block->used < sz) {
+        size_t size = block ? block->size * 2 : __LCM_ARENA_MIN_BLOCK;
+        while (size < sz)
+            size *= 2;
+        block = (lcm_arena_block_t*) malloc(header + size);
+        if (!block)
+            return NULL;
+        block->next = arena->blocks;
+        block->size = size;
+        block->used = 0;
+        arena->blocks = block;
+    }
+    block->used += sz;
+    return (uint8_t*) block + header + block->used - sz;
+}
+
+/**
+ * Releases everything allocated from the arena, and keeps its largest
+ * block for the allocations to come.
+ */
+static inline void lcm_arena_reset(lcm_arena_t *arena)
+{
+    lcm_arena_block_t *block = arena->blocks;
+    if (!block)
+        return;
+    while (block->next) {
+        lcm_arena_block_t *next = block->next->next;
+        free(block->next);
+        block->next = next;
+    }
+    block->used = 0;
+}
+
+/**
+ * Releases everything allocated from the arena, and its memory.
+ */
+static inline void lcm_arena_free(lcm_arena_t *arena)
+{
+    while (arena->blocks) {
+        lcm_arena_block_t *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+}
+
 /**
  * BYTE
  */
 #define __byte_hash_recursive(p) 0
 #define __byte_decode_array_cleanup(p, sz) {}
+#define __byte_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __byte_decode_array(buf, offset, maxlen, p, elements)
 #define byte_encoded_size(p) ( sizeof(int64_t) + sizeof(uint8_t) )
 
 static inline int __byte_encoded_array_size(const uint8_t *p, int elements)
@@ -85,6 +367,8 @@ static inline int __byte_clone_array(const uint8_t *p, uint8_t *q, int elements)
  */
 #define __int8_t_hash_recursive(p) 0
 #define __int8_t_decode_array_cleanup(p, sz) {}
+#define __int8_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int8_t_decode_array(buf, offset, maxlen, p, elements)
 #define int8_t_encoded_size(p) ( sizeof(int64_t) + sizeof(int8_t) )
 
 static inline int __int8_t_encoded_array_size(const int8_t *p, int elements)
@@ -126,6 +410,8 @@ static inline int __int8_t_clone_array(const int8_t *p, int8_t *q, int elements)
  */
 #define __int16_t_hash_recursive(p) 0
 #define __int16_t_decode_array_cleanup(p, sz) {}
+#define __int16_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int16_t_decode_array(buf, offset, maxlen, p, elements)
 #define int16_t_encoded_size(p) ( sizeof(int64_t) + sizeof(int16_t) )
 
 static inline int __int16_t_encoded_array_size(const int16_t *p, int elements)
@@ -138,22 +424,11 @@ static inline int __int16_t_encode_array(void *_buf, int offset, int maxlen, con
 {
     int total_size = sizeof(int16_t) * elements;
     uint8_t *buf = (uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    //  See Section 5.8 paragraph 3 of the standard
-    //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
-    //  use uint for shifting instead if int
-    const uint16_t *unsigned_p = (const uint16_t*)p;
-    for (element = 0; element < elements; element++) {
-        uint16_t v = unsigned_p[element];
-        buf[pos++] = (v>>8) & 0xff;
-        buf[pos++] = (v & 0xff);
-    }
-
+    __lcm_copy_swapped(&buf[offset], p, elements, sizeof(int16_t));
     return total_size;
 }
 
@@ -161,17 +436,11 @@ static inline int __int16_t_decode_array(const void *_buf, int offset, int maxle
 {
     int total_size = sizeof(int16_t) * elements;
     const uint8_t *buf = (const uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    for (element = 0; element < elements; element++) {
-        p[element] = (buf[pos]<<8) + buf[pos+1];
-        pos+=2;
-    }
-
+    __lcm_copy_swapped(p, &buf[offset], elements, sizeof(int16_t));
     return total_size;
 }
 
@@ -186,6 +455,8 @@ static inline int __int16_t_clone_array(const int16_t *p, int16_t *q, int elemen
  */
 #define __int32_t_hash_recursive(p) 0
 #define __int32_t_decode_array_cleanup(p, sz) {}
+#define __int32_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int32_t_decode_array(buf, offset, maxlen, p, elements)
 #define int32_t_encoded_size(p) ( sizeof(int64_t) + sizeof(int32_t) )
 
 static inline int __int32_t_encoded_array_size(const int32_t *p, int elements)
@@ -198,24 +469,11 @@ static inline int __int32_t_encode_array(void *_buf, int offset, int maxlen, con
 {
     int total_size = sizeof(int32_t) * elements;
     uint8_t *buf = (uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    //  See Section 5.8 paragraph 3 of the standard
-    //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
-    //  use uint for shifting instead if int
-    const uint32_t* unsigned_p = (const uint32_t*)p;
-    for (element = 0; element < elements; element++) {
-        const uint32_t v = unsigned_p[element];
-        buf[pos++] = (v>>24)&0xff;
-        buf[pos++] = (v>>16)&0xff;
-        buf[pos++] = (v>>8)&0xff;
-        buf[pos++] = (v & 0xff);
-    }
-
+    __lcm_copy_swapped(&buf[offset], p, elements, sizeof(int32_t));
     return total_size;
 }
 
@@ -223,20 +481,11 @@ static inline int __int32_t_decode_array(const void *_buf, int offset, int maxle
 {
     int total_size = sizeof(int32_t) * elements;
     const uint8_t *buf = (const uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    //  See Section 5.8 paragraph 3 of the standard
-    //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
-    //  use uint for shifting instead if int
-    for (element = 0; element < elements; element++) {
-        p[element] = (((uint32_t)buf[pos+0])<<24) + (((uint32_t)buf[pos+1])<<16) + (((uint32_t)buf[pos+2])<<8) + ((uint32_t)buf[pos+3]);
-        pos+=4;
-    }
-
+    __lcm_copy_swapped(p, &buf[offset], elements, sizeof(int32_t));
     return total_size;
 }
 
@@ -251,6 +500,8 @@ static inline int __int32_t_clone_array(const int32_t *p, int32_t *q, int elemen
  */
 #define __int64_t_hash_recursive(p) 0
 #define __int64_t_decode_array_cleanup(p, sz) {}
+#define __int64_t_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __int64_t_decode_array(buf, offset, maxlen, p, elements)
 #define int64_t_encoded_size(p) ( sizeof(int64_t) + sizeof(int64_t) )
 
 static inline int __int64_t_encoded_array_size(const int64_t *p, int elements)
@@ -263,28 +514,11 @@ static inline int __int64_t_encode_array(void *_buf, int offset, int maxlen, con
 {
     int total_size = sizeof(int64_t) * elements;
     uint8_t *buf = (uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    //  See Section 5.8 paragraph 3 of the standard
-    //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
-    //  use uint for shifting instead if int
-    const uint64_t * unsigned_p = (const uint64_t*)p;
-    for (element = 0; element < elements; element++) {
-        const uint64_t v = unsigned_p[element];
-        buf[pos++] = (v>>56)&0xff;
-        buf[pos++] = (v>>48)&0xff;
-        buf[pos++] = (v>>40)&0xff;
-        buf[pos++] = (v>>32)&0xff;
-        buf[pos++] = (v>>24)&0xff;
-        buf[pos++] = (v>>16)&0xff;
-        buf[pos++] = (v>>8)&0xff;
-        buf[pos++] = (v & 0xff);
-    }
-
+    __lcm_copy_swapped(&buf[offset], p, elements, sizeof(int64_t));
     return total_size;
 }
 
@@ -292,23 +526,11 @@ static inline int __int64_t_decode_array(const void *_buf, int offset, int maxle
 {
     int total_size = sizeof(int64_t) * elements;
     const uint8_t *buf = (const uint8_t*) _buf;
-    int pos = offset;
-    int element;
 
     if (maxlen < total_size)
         return -1;
 
-    //  See Section 5.8 paragraph 3 of the standard
-    //  http://open-std.org/JTC1/SC22/WG21/docs/papers/2015/n4527.pdf
-    //  use uint for shifting instead if int
-    for (element = 0; element < elements; element++) {
-        uint64_t a = (((uint32_t)buf[pos+0])<<24) + (((uint32_t)buf[pos+1])<<16) + (((uint32_t)buf[pos+2])<<8) + (uint32_t)buf[pos+3];
-        pos+=4;
-        uint64_t b = (((uint32_t)buf[pos+0])<<24) + (((uint32_t)buf[pos+1])<<16) + (((uint32_t)buf[pos+2])<<8) + (uint32_t)buf[pos+3];
-        pos+=4;
-        p[element] = (a<<32) + (b&0xffffffff);
-    }
-
+    __lcm_copy_swapped(p, &buf[offset], elements, sizeof(int64_t));
     return total_size;
 }
 
@@ -323,6 +545,8 @@ static inline int __int64_t_clone_array(const int64_t *p, int64_t *q, int elemen
  */
 #define __float_hash_recursive(p) 0
 #define __float_decode_array_cleanup(p, sz) {}
+#define __float_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __float_decode_array(buf, offset, maxlen, p, elements)
 #define float_encoded_size(p) ( sizeof(int64_t) + sizeof(float) )
 
 static inline int __float_encoded_array_size(const float *p, int elements)
@@ -352,6 +576,8 @@ static inline int __float_clone_array(const float *p, float *q, int elements)
  */
 #define __double_hash_recursive(p) 0
 #define __double_decode_array_cleanup(p, sz) {}
+#define __double_decode_array_arena(buf, offset, maxlen, p, elements, arena) \
+    __double_decode_array(buf, offset, maxlen, p, elements)
 #define double_encoded_size(p) ( sizeof(int64_t) + sizeof(double) )
 
 static inline int __double_encoded_array_size(const double *p, int elements)
@@ -422,6 +648,24 @@ static inline int __string_encode_array(void *_buf, int offset, int maxlen, char
     return pos;
 }
 
+// Encodes a string of length bytes, not counting the terminating \0, with a
+// single bounds check.  Used by the C++ bindings, whose strings know their
+// length.
+static inline int __string_encode_sized(void *_buf, int offset, int maxlen, const char *s, uint32_t length)
+{
+    uint8_t *buf = ((uint8_t *) _buf) + offset;
+    if (maxlen < 0 || (uint64_t) maxlen < 4 + (uint64_t) length + 1)
+        return -1;
+    uint32_t v = length + 1;  // includes \0
+    buf[0] = (v >> 24) & 0xff;
+    buf[1] = (v >> 16) & 0xff;
+    buf[2] = (v >> 8) & 0xff;
+    buf[3] = v & 0xff;
+    memcpy(buf + 4, s, length);
+    buf[4 + length] = 0;
+    return 4 + length + 1;
+}
+
 static inline int __string_decode_array(const void *_buf, int offset, int maxlen, char **p, int elements)
 {
     int pos = 0, thislen;
@@ -442,6 +686,57 @@ static inline int __string_decode_array(const void *_buf, int offset, int maxlen
     return pos;
 }
 
+static inline int __string_decode_array_arena(const void *_buf, int offset, int maxlen, char **p, int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int element;
+
+    for (element = 0; element < elements; element++) {
+        int32_t length;
+
+        // read length including \0
+        thislen = __int32_t_decode_array(_buf, offset + pos, maxlen - pos, &length, 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+        if (length <= 0) return -1;
+
+        p[element] = (char*) lcm_arena_alloc(arena, length);
+        if (!p[element]) return -1;
+        thislen = __int8_t_decode_array(_buf, offset + pos, maxlen - pos, (int8_t*) p[element], length);
+        if (thislen < 0) return thislen; else pos += thislen;
+    }
+
+    return pos;
+}
+
+/**
+ * VIEWS
+ */
+
+// n * d for counting the elements of an array in a view, or limit + 1 if
+// that is more than limit.  Returns -1 if d is negative.
+static inline int64_t __lcm_view_count(int64_t n, int64_t d, int limit)
+{
+    if (n < 0 || d < 0)
+        return -1;
+    if (d && n > ((int64_t) limit + 1) / d)
+        return (int64_t) limit + 1;
+    return n * d;
+}
+
+// Checks the encoded string at offset, and returns its encoded size, or -1
+// if it is not valid
+static inline int __string_view_skip(const void *_buf, int offset, int maxlen)
+{
+    const uint8_t *buf = (const uint8_t*) _buf;
+    int32_t length;
+
+    if (__int32_t_decode_array(_buf, offset, maxlen, &length, 1) < 0)
+        return -1;
+    if (length <= 0 || length > maxlen - 4 || buf[offset + 4 + length - 1])
+        return -1;
+    return 4 + length;
+}
+
 static inline int __string_clone_array(char * const *p, char **q, int elements)
 {
     int element;
@@ -454,6 +749,60 @@ static inline int __string_clone_array(char * const *p, char **q, int elements)
     return 0;
 }
 
+/**
+ * ENCODE STREAMS
+ *
+ * Generated C++ types can encode into a stream instead of a buffer that
+ * holds the whole message: the encoded bytes are collected in buf, which
+ * holds at least 8 bytes, and passed to flush whenever it is full.  flush
+ * returns <0 on failure.
+ */
+typedef struct _lcm_encode_stream lcm_encode_stream_t;
+struct _lcm_encode_stream {
+    int (*flush)(void *user, const void *data, int len);
+    void *user;
+    uint8_t *buf;
+    int capacity;
+    int used;
+};
+
+static inline int __lcm_stream_flush(lcm_encode_stream_t *s)
+{
+    int status = s->used ? s->flush(s->user, s->buf, s->used) : 0;
+    s->used = 0;
+    return status < 0 ? status : 0;
+}
+
+// Appends elements values of size bytes each, in big-endian byte order
+static inline int __lcm_stream_put(lcm_encode_stream_t *s, const void *p, int elements, int size)
+{
+    const uint8_t *src = (const uint8_t *) p;
+    while (elements > 0) {
+        int n = (s->capacity - s->used) / size;
+        if (n == 0) {
+            if (__lcm_stream_flush(s) < 0)
+                return -1;
+            continue;
+        }
+        if (n > elements)
+            n = elements;
+        __lcm_copy_swapped(s->buf + s->used, src, n, size);
+        s->used += n * size;
+        src += n * size;
+        elements -= n;
+    }
+    return 0;
+}
+
+// Appends a string of length bytes, not counting the terminating \0
+static inline int __lcm_stream_put_string(lcm_encode_stream_t *s, const char *str, uint32_t length)
+{
+    int32_t v = length + 1;
+    if (__lcm_stream_put(s, &v, 1, 4) < 0)
+        return -1;
+    return __lcm_stream_put(s, str, length + 1, 1);
+}
+
 static inline void *lcm_malloc(size_t sz)
 {
     if (sz)
@@ -551,6 +900,47 @@ struct _lcm_type_info_t
 
 };
 
+typedef const lcm_type_info_t *(*lcm_get_type_info_t)(void);
+
+/**
+ * An entry of the type registry that lcm-gen --c-registry generates for each
+ * package, which lists the types of the package by fingerprint.
+ */
+typedef struct _lcm_type_registry_entry_t lcm_type_registry_entry_t;
+struct _lcm_type_registry_entry_t
+{
+    /**
+     * The fingerprint that messages of the type start with.
+     */
+    int64_t fingerprint;
+    /**
+     * The fully-qualified name of the type, e.g. "exlcm.example_t".
+     */
+    const char *name;
+    lcm_get_type_info_t get_type_info;
+};
+
+/**
+ * Finds the entry of a registry, which is sorted by fingerprint, in
+ * O(log n) time.  Returns NULL if no type has the fingerprint.
+ */
+static inline const lcm_type_registry_entry_t *
+lcm_type_registry_find(const lcm_type_registry_entry_t *entries,
+        int num_entries, int64_t fingerprint)
+{
+    int lo = 0, hi = num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (entries[mid].fingerprint < fingerprint)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < num_entries && entries[lo].fingerprint == fingerprint)
+        return &entries[lo];
+    return NULL;
+}
+
 
 #ifdef __cplusplus
 }
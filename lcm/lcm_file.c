@@ -5,15 +5,41 @@
 #ifndef WIN32
 #include <sys/time.h>
 #include <sys/select.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <time.h>
 #else
 #include "windows/WinPorting.h"
 #include <Winsock2.h>
 #endif
 
 #include "lcm_internal.h"
+#include "lcm_clock.h"
 #include "dbg.h"
 #include "eventlog.h"
 
+// precise=1 schedules events against CLOCK_MONOTONIC with clock_nanosleep()
+#ifdef __linux__
+#define LCM_FILE_PRECISE_TIMING
+#endif
+
+// default length of the spin at the end of a precise wait
+#define PRECISE_DEFAULT_SPIN_USEC 50
+
+// a precise wait checks for the abort command at least this often
+#define PRECISE_MAX_SLEEP_NSEC 50000000
+
+// logs up to this size are mapped with mmap=1, unless set by mmap_limit_mb
+#define MMAP_DEFAULT_LIMIT_MB 1024
+
+// the layout of an event in a plain log file, see eventlog.c
+#define LOG_MAGIC ((int32_t) 0xEDA1DA01L)
+#define LOG_HEADER_SIZE 28
+#define LOG_MAX_CHANNEL_LEN 1000
+
 typedef enum {
   LCM_LOGPROV_READ_MODE=0,
   LCM_LOGPROV_WRITE_MODE=1,
@@ -26,6 +52,10 @@ struct _lcm_provider_t {
 
     char * filename;
 
+    // if set, only the events on channels matching this regular expression
+    // are read from the log
+    char * channel;
+
     // The log file mode (reading, writing, append)
     lcm_log_provider_mode_t log_mode;
 
@@ -33,15 +63,102 @@ struct _lcm_provider_t {
     lcm_eventlog_event_t * event;
 
     double speed;
+    // play back as fast as possible, dispatching events back-to-back from
+    // handle() without the timer thread
+    int afap;
+    // in afap mode, wait for backlogged subscribers instead of letting them
+    // drop events
+    int flow_control;
+    // monotonic time at which the current event is due, in microseconds,
+    // and what to add to it for the wall clock time that it is stamped with
     int64_t next_clock_time;
+    int64_t clock_offset;
     int64_t start_timestamp;
 
+    // schedule against the monotonic clock and sleep to absolute deadlines,
+    // spinning for the last spin_usec microseconds
+    int precise;
+    int spin_usec;
+    // CLOCK_MONOTONIC time at which the current event is due, in nanoseconds
+    int64_t next_deadline_ns;
+    // if set, the scheduling error of each event is written here
+    char * timing_log_name;
+    FILE * timing_log;
+
+    // CPUs and scheduling policy of the timer thread, or NULL
+    char * rx_cpu;
+    char * rx_sched;
+
     int thread_created;
     GThread *timer_thread;
     int notify_pipe[2];
     int timer_pipe[2];
+
+    // Reading ahead from a thread of our own, up to read_ahead events.  The
+    // queue and the flags are guarded by read_ahead_mutex.
+    unsigned int read_ahead;
+    GThread *read_ahead_thread;
+    GMutex *read_ahead_mutex;
+    GCond *read_ahead_cond;        // signaled when an event is queued, or at EOF
+    GCond *read_ahead_space_cond;  // signaled when an event is taken, or on exit
+    GQueue *read_ahead_queue;
+    int read_ahead_eof;
+    int read_ahead_exit;
+
+    // Playing back in place from a mapping of the whole log.  map_event
+    // points into the mapping, except for its channel, which is copied to
+    // map_channel to be NUL-terminated.
+    int use_mmap;
+    int64_t mmap_limit;
+    const uint8_t *map;
+    int64_t map_size;
+    int64_t map_offset;  // of the next event
+    lcm_eventlog_event_t map_event;
+    char map_channel[LOG_MAX_CHANNEL_LEN + 1];
+
+    // Playing back from memory, with preload=1.  The channels and data of
+    // the events are copied one after the other into preload_arena, and
+    // preload_events points into it.  preload_event is the one being played,
+    // with its timestamp moved by loop_shift for the passes after the first.
+    int preload;
+    int loop;
+    int loop_count;  // passes to play with loop=1, or 0 to loop forever
+    uint8_t *preload_arena;
+    int64_t preload_size;
+    lcm_eventlog_event_t *preload_events;
+    int64_t num_preload;
+    int64_t preload_next;
+    int loop_pass;
+    int64_t loop_shift;
+    lcm_eventlog_event_t preload_event;
 };
 
+static void
+read_ahead_stop (lcm_logprov_t *lr)
+{
+    if (lr->read_ahead_thread) {
+        g_mutex_lock (lr->read_ahead_mutex);
+        lr->read_ahead_exit = 1;
+        g_cond_signal (lr->read_ahead_space_cond);
+        g_mutex_unlock (lr->read_ahead_mutex);
+        g_thread_join (lr->read_ahead_thread);
+        lr->read_ahead_thread = NULL;
+    }
+    if (lr->read_ahead_queue) {
+        lcm_eventlog_event_t *event;
+        while ((event = g_queue_pop_head (lr->read_ahead_queue)))
+            lcm_eventlog_free_event (event);
+        g_queue_free (lr->read_ahead_queue);
+        lr->read_ahead_queue = NULL;
+    }
+    if (lr->read_ahead_mutex) {
+        g_mutex_free (lr->read_ahead_mutex);
+        g_cond_free (lr->read_ahead_cond);
+        g_cond_free (lr->read_ahead_space_cond);
+        lr->read_ahead_mutex = NULL;
+    }
+}
+
 static void
 lcm_logprov_destroy (lcm_logprov_t *lr)
 {
@@ -56,27 +173,65 @@ lcm_logprov_destroy (lcm_logprov_t *lr)
         g_thread_join (lr->timer_thread);
     }
 
-    if(lr->notify_pipe[0] >= 0) lcm_internal_pipe_close(lr->notify_pipe[0]);
-    if(lr->notify_pipe[1] >= 0) lcm_internal_pipe_close(lr->notify_pipe[1]);
+    lcm_internal_notify_close(lr->notify_pipe);
     if(lr->timer_pipe[0] >= 0)  lcm_internal_pipe_close(lr->timer_pipe[0]);
     if(lr->timer_pipe[1] >= 0)  lcm_internal_pipe_close(lr->timer_pipe[1]);
 
-    if (lr->event)
+    read_ahead_stop (lr);
+
+    if (lr->event && lr->event != &lr->map_event &&
+            lr->event != &lr->preload_event)
         lcm_eventlog_free_event (lr->event);
+#ifndef WIN32
+    if (lr->map)
+        munmap ((void *) lr->map, lr->map_size);
+    if (lr->preload_arena)
+        munlock (lr->preload_arena, lr->preload_size);
+#endif
+    free (lr->preload_arena);
+    free (lr->preload_events);
     if (lr->log)
         lcm_eventlog_destroy (lr->log);
 
+    if (lr->timing_log)
+        fclose (lr->timing_log);
+
     free (lr->filename);
+    free (lr->channel);
+    free (lr->timing_log_name);
+    free (lr->rx_cpu);
+    free (lr->rx_sched);
     free (lr);
 }
 
-static int64_t
-timestamp_now (void)
+#ifdef LCM_FILE_PRECISE_TIMING
+// sleeps until deadline_ns on the monotonic clock, spinning for the last
+// spin_usec.  Returns -1 without waiting any longer if a command arrives on
+// the timer pipe, and 0 otherwise.
+static int
+precise_wait (lcm_logprov_t * lr, int64_t deadline_ns)
 {
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
+    int64_t wake_ns = deadline_ns - (int64_t) lr->spin_usec * 1000;
+    int64_t now = lcm_clock_monotonic_ns ();
+    while (now < wake_ns) {
+        int64_t sleep_ns = wake_ns;
+        if (sleep_ns - now > PRECISE_MAX_SLEEP_NSEC)
+            sleep_ns = now + PRECISE_MAX_SLEEP_NSEC;
+        struct timespec ts;
+        ts.tv_sec = sleep_ns / 1000000000;
+        ts.tv_nsec = sleep_ns % 1000000000;
+        clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+
+        struct pollfd pfd = { lr->timer_pipe[0], POLLIN, 0 };
+        if (poll (&pfd, 1, 0) > 0)
+            return -1;
+        now = lcm_clock_monotonic_ns ();
+    }
+    while (lcm_clock_monotonic_ns () < deadline_ns)
+        ;
+    return 0;
 }
+#endif
 
 static void *
 timer_thread (void * user)
@@ -84,11 +239,23 @@ timer_thread (void * user)
     lcm_logprov_t * lr = (lcm_logprov_t *) user;
     int64_t abstime;
     struct timeval sleep_tv;
+    lcm_internal_thread_init ("file-timer", lr->rx_cpu, lr->rx_sched);
 
     while (lcm_internal_pipe_read(lr->timer_pipe[0], &abstime, 8) == 8) {
         if (abstime < 0) return NULL;
 
-        int64_t now = timestamp_now();
+#ifdef LCM_FILE_PRECISE_TIMING
+        // in precise mode, abstime is a deadline on the monotonic clock
+        if (lr->precise) {
+            if (precise_wait (lr, abstime) == 0 &&
+                    lcm_internal_notify_signal(lr->notify_pipe) < 0) {
+                perror(__FILE__ " - write (timer precise)");
+            }
+            continue;
+        }
+#endif
+
+        int64_t now = lcm_clock_monotonic_us();
 
         if (abstime > now) {
             int64_t sleep_utime = abstime - now;
@@ -105,12 +272,12 @@ timer_thread (void * user)
 
             if (0 == status) {
                 // select timed out
-                if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+                if(lcm_internal_notify_signal(lr->notify_pipe) < 0) {
                     perror(__FILE__ " - write (timer select)");
                 }
             }
         } else {
-            if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+            if(lcm_internal_notify_signal(lr->notify_pipe) < 0) {
                 perror(__FILE__ " - write (timer)");
             }
        }
@@ -119,6 +286,34 @@ timer_thread (void * user)
     return NULL;
 }
 
+static int
+hex_value (char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// decodes the %XX escapes of a URL option in place
+static void
+percent_decode (char *s)
+{
+    char *out = s;
+    for (; *s; s++) {
+        if (s[0] == '%' && hex_value (s[1]) >= 0 && hex_value (s[2]) >= 0) {
+            *out++ = (char) (hex_value (s[1]) * 16 + hex_value (s[2]));
+            s += 2;
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = 0;
+}
+
 static void
 new_argument (gpointer key, gpointer value, gpointer user)
 {
@@ -137,6 +332,9 @@ new_argument (gpointer key, gpointer value, gpointer user)
         const char *mode = (char *) value;
         if (!strcmp(mode, "r")) {
             lr->log_mode = LCM_LOGPROV_READ_MODE;
+        } else if (!strcmp(mode, "afap")) {
+            lr->log_mode = LCM_LOGPROV_READ_MODE;
+            lr->afap = 1;
         } else if(!strcmp(mode, "w")) {
           lr->log_mode = LCM_LOGPROV_WRITE_MODE;
         } else if(!strcmp(mode, "a")) {
@@ -144,19 +342,364 @@ new_argument (gpointer key, gpointer value, gpointer user)
         } else {
           fprintf(stderr, "Warning: Invalid value for mode: %s\n", mode);
         }
+    } else if (!strcmp ((char *) key, "flow_control")) {
+        char *endptr = NULL;
+        lr->flow_control = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for flow_control\n");
+    } else if (!strcmp ((char *) key, "precise")) {
+        char *endptr = NULL;
+        lr->precise = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for precise\n");
+#ifndef LCM_FILE_PRECISE_TIMING
+        if (lr->precise)
+            fprintf (stderr, "Warning: precise timing is not supported on "
+                    "this platform\n");
+        lr->precise = 0;
+#endif
+    } else if (!strcmp ((char *) key, "spin_usec")) {
+        char *endptr = NULL;
+        lr->spin_usec = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr || lr->spin_usec < 0) {
+            fprintf (stderr, "Warning: Invalid value for spin_usec\n");
+            lr->spin_usec = PRECISE_DEFAULT_SPIN_USEC;
+        }
+    } else if (!strcmp ((char *) key, "channel")) {
+        free (lr->channel);
+        lr->channel = strdup ((char *) value);
+        percent_decode (lr->channel);
+    } else if (!strcmp ((char *) key, "mmap")) {
+        char *endptr = NULL;
+        lr->use_mmap = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for mmap\n");
+    } else if (!strcmp ((char *) key, "mmap_limit_mb")) {
+        char *endptr = NULL;
+        double mb = strtod ((char *) value, &endptr);
+        if (endptr == value || *endptr || mb < 0)
+            fprintf (stderr, "Warning: Invalid value for mmap_limit_mb\n");
+        else
+            lr->mmap_limit = (int64_t) (mb * (1 << 20));
+    } else if (!strcmp ((char *) key, "preload")) {
+        char *endptr = NULL;
+        lr->preload = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for preload\n");
+    } else if (!strcmp ((char *) key, "loop")) {
+        char *endptr = NULL;
+        lr->loop = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for loop\n");
+    } else if (!strcmp ((char *) key, "loop_count")) {
+        char *endptr = NULL;
+        lr->loop_count = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr || lr->loop_count < 0) {
+            fprintf (stderr, "Warning: Invalid value for loop_count\n");
+            lr->loop_count = 0;
+        }
+    } else if (!strcmp ((char *) key, "read_ahead")) {
+        char *endptr = NULL;
+        long read_ahead = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr || read_ahead < 0 ||
+                read_ahead > G_MAXUINT) {
+            fprintf (stderr, "Warning: Invalid value for read_ahead\n");
+            read_ahead = 0;
+        }
+        lr->read_ahead = read_ahead;
+    } else if (!strcmp ((char *) key, "timing_log")) {
+        free (lr->timing_log_name);
+        lr->timing_log_name = strdup ((char *) value);
+    } else if (!strcmp ((char *) key, "rx_cpu") ||
+            !strcmp ((char *) key, "rx_sched")) {
+        int is_cpu = !strcmp ((char *) key, "rx_cpu");
+        if (lcm_internal_check_thread_scheduling (
+                    is_cpu ? (char *) value : NULL,
+                    is_cpu ? NULL : (char *) value) < 0) {
+            fprintf (stderr, "Warning: Invalid value for %s\n", (char *) key);
+        } else {
+            char **dest = is_cpu ? &lr->rx_cpu : &lr->rx_sched;
+            free (*dest);
+            *dest = strdup ((char *) value);
+        }
     } else {
         fprintf(stderr, "Warning: unrecognized option: [%s]\n",
                 (const char*)key);
     }
 }
 
+// reads events ahead of playback, so that the dispatching thread does not
+// wait on the disk
+static void *
+read_ahead_thread (void * user)
+{
+    lcm_logprov_t * lr = (lcm_logprov_t *) user;
+    lcm_internal_thread_init ("file-read-ahead", NULL, NULL);
+
+    while (1) {
+        lcm_eventlog_event_t *event = lcm_eventlog_read_next_event (lr->log);
+
+        g_mutex_lock (lr->read_ahead_mutex);
+        while (!lr->read_ahead_exit &&
+                g_queue_get_length (lr->read_ahead_queue) >= lr->read_ahead)
+            g_cond_wait (lr->read_ahead_space_cond, lr->read_ahead_mutex);
+        if (lr->read_ahead_exit || !event) {
+            lr->read_ahead_eof = 1;
+            g_cond_signal (lr->read_ahead_cond);
+            g_mutex_unlock (lr->read_ahead_mutex);
+            if (event)
+                lcm_eventlog_free_event (event);
+            return NULL;
+        }
+        g_queue_push_tail (lr->read_ahead_queue, event);
+        g_cond_signal (lr->read_ahead_cond);
+        g_mutex_unlock (lr->read_ahead_mutex);
+    }
+}
+
+static int
+read_ahead_start (lcm_logprov_t * lr)
+{
+#if defined(POSIX_FADV_SEQUENTIAL) && !defined(WIN32)
+    if (lr->log->f)
+        posix_fadvise (fileno (lr->log->f), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    lr->read_ahead_queue = g_queue_new ();
+    lr->read_ahead_mutex = g_mutex_new ();
+    lr->read_ahead_cond = g_cond_new ();
+    lr->read_ahead_space_cond = g_cond_new ();
+    lr->read_ahead_thread = g_thread_create (read_ahead_thread, lr, TRUE,
+            NULL);
+    return lr->read_ahead_thread ? 0 : -1;
+}
+
+static int32_t
+map_decode32 (const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+            ((uint32_t) p[2] << 8) | (uint32_t) p[3]);
+}
+
+static int64_t
+map_decode64 (const uint8_t *p)
+{
+    return (int64_t) (((uint64_t) map_decode32 (p) << 32) |
+            (uint32_t) map_decode32 (p + 4));
+}
+
+// maps the log for mmap=1.  Compressed logs, stripe manifests, logs larger
+// than mmap_limit and logs played back by channel are read as usual.
+static void
+map_log (lcm_logprov_t * lr)
+{
+#ifndef WIN32
+    if (lr->channel) {
+        dbg (DBG_LCM, "Not mapping %s, reading by channel\n", lr->filename);
+        return;
+    }
+    int fd = open (lr->filename, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (0 == fstat (fd, &st) && st.st_size >= LOG_HEADER_SIZE &&
+            st.st_size <= lr->mmap_limit) {
+        void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED &&
+                map_decode32 ((const uint8_t *) map) != LOG_MAGIC) {
+            munmap (map, st.st_size);
+            map = MAP_FAILED;
+        }
+        if (map != MAP_FAILED) {
+            madvise (map, st.st_size, MADV_SEQUENTIAL);
+            lr->map = (const uint8_t *) map;
+            lr->map_size = st.st_size;
+        }
+    }
+    close (fd);
+    dbg (DBG_LCM, "%s %s\n", lr->map ? "Mapped" : "Not mapping",
+            lr->filename);
+#endif
+}
+
+// finds the event at lr->map_offset, skipping over corrupt data like the
+// eventlog reader.  Returns the size of the event, or -1 at the end.
+static int64_t
+map_find_event (lcm_logprov_t * lr)
+{
+    while (lr->map_offset + LOG_HEADER_SIZE <= lr->map_size) {
+        const uint8_t *p = lr->map + lr->map_offset;
+        if (map_decode32 (p) != LOG_MAGIC) {
+            lr->map_offset++;
+            continue;
+        }
+        int32_t channellen = map_decode32 (p + 20);
+        int32_t datalen = map_decode32 (p + 24);
+        if (channellen <= 0 || channellen >= LOG_MAX_CHANNEL_LEN ||
+                datalen < 0) {
+            fprintf (stderr, "Log event has invalid lengths: %d, %d\n",
+                    channellen, datalen);
+            return -1;
+        }
+        int64_t size = (int64_t) LOG_HEADER_SIZE + channellen + datalen;
+        if (lr->map_offset + size > lr->map_size)
+            return -1;
+        return size;
+    }
+    return -1;
+}
+
+static int
+map_next_event (lcm_logprov_t * lr)
+{
+    int64_t size = map_find_event (lr);
+    if (size < 0)
+        return -1;
+    const uint8_t *p = lr->map + lr->map_offset;
+    lcm_eventlog_event_t *le = &lr->map_event;
+    le->eventnum = map_decode64 (p + 4);
+    le->timestamp = map_decode64 (p + 12);
+    le->channellen = map_decode32 (p + 20);
+    le->datalen = map_decode32 (p + 24);
+    memcpy (lr->map_channel, p + LOG_HEADER_SIZE, le->channellen);
+    lr->map_channel[le->channellen] = 0;
+    le->channel = lr->map_channel;
+    le->data = (void *) (p + LOG_HEADER_SIZE + le->channellen);
+    lr->map_offset += size;
+    return 0;
+}
+
+// moves to the first event at or after timestamp, walking the headers
+static void
+map_seek_to_timestamp (lcm_logprov_t * lr, int64_t timestamp)
+{
+    lr->map_offset = 0;
+    int64_t size;
+    while ((size = map_find_event (lr)) >= 0 &&
+            map_decode64 (lr->map + lr->map_offset + 12) < timestamp)
+        lr->map_offset += size;
+}
+
+// reads the rest of the log into memory for preload=1.  Returns the number of
+// events read, or -1 on error.
+static int64_t
+preload_log (lcm_logprov_t * lr)
+{
+    int64_t capacity = 1 << 20;
+    int64_t max_events = 1024;
+    uint8_t *arena = (uint8_t *) malloc (capacity);
+    lcm_eventlog_event_t *events = (lcm_eventlog_event_t *)
+        malloc (max_events * sizeof (lcm_eventlog_event_t));
+    // where the channel of each event starts, until the arena stops moving
+    int64_t *offsets = (int64_t *) malloc (max_events * sizeof (int64_t));
+    int64_t size = 0;
+    int64_t num = 0;
+
+    lcm_eventlog_event_t event;
+    memset (&event, 0, sizeof (event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    while (0 == lcm_eventlog_read_next_event_into (lr->log, &event,
+                &channel_capacity, &data_capacity)) {
+        // keep the data of each event 8-byte aligned
+        int64_t data_offset = (event.channellen + 1 + 7) / 8 * 8;
+        int64_t len = (data_offset + event.datalen + 7) / 8 * 8;
+        if (size + len > capacity) {
+            while (size + len > capacity)
+                capacity *= 2;
+            arena = (uint8_t *) realloc (arena, capacity);
+        }
+        if (num == max_events) {
+            max_events *= 2;
+            events = (lcm_eventlog_event_t *) realloc (events,
+                    max_events * sizeof (lcm_eventlog_event_t));
+            offsets = (int64_t *) realloc (offsets,
+                    max_events * sizeof (int64_t));
+        }
+        memcpy (arena + size, event.channel, event.channellen + 1);
+        memcpy (arena + size + data_offset, event.data, event.datalen);
+        events[num] = event;
+        offsets[num] = size;
+        size += len;
+        num++;
+    }
+    free (event.channel);
+    free (event.data);
+
+    if (size > 0)
+        arena = (uint8_t *) realloc (arena, size);
+    for (int64_t i = 0; i < num; i++) {
+        events[i].channel = (char *) arena + offsets[i];
+        events[i].data = arena + offsets[i] +
+            (events[i].channellen + 1 + 7) / 8 * 8;
+    }
+    free (offsets);
+
+#ifndef WIN32
+    // keep the arena from being paged out, if the process may
+    if (size > 0 && mlock (arena, size) != 0) {
+        dbg (DBG_LCM, "Could not lock the preloaded log in memory: %s\n",
+                strerror (errno));
+    }
+#endif
+    lr->preload_arena = arena;
+    lr->preload_size = size;
+    lr->preload_events = events;
+    lr->num_preload = num;
+    dbg (DBG_LCM, "Preloaded %lld events, %lld bytes\n", (long long) num,
+            (long long) size);
+    return num;
+}
+
+// plays the next preloaded event, starting the next pass over them at the
+// end if looping.  A pass starts the mean interval between its events after
+// the previous one ended.
+static int
+preload_next_event (lcm_logprov_t * lr)
+{
+    if (lr->preload_next == lr->num_preload) {
+        if (!lr->loop || lr->num_preload == 0 ||
+                (lr->loop_count > 0 && lr->loop_pass + 1 >= lr->loop_count)) {
+            lr->event = NULL;
+            return -1;
+        }
+        int64_t span = lr->preload_events[lr->num_preload - 1].timestamp -
+            lr->preload_events[0].timestamp;
+        lr->loop_shift += span;
+        if (lr->num_preload > 1)
+            lr->loop_shift += span / (lr->num_preload - 1);
+        lr->loop_pass++;
+        lr->preload_next = 0;
+    }
+    lr->preload_event = lr->preload_events[lr->preload_next++];
+    lr->preload_event.timestamp += lr->loop_shift;
+    lr->event = &lr->preload_event;
+    return 0;
+}
+
 static int
 load_next_event (lcm_logprov_t * lr)
 {
+    if (lr->preload_events)
+        return preload_next_event (lr);
+
+    if (lr->map) {
+        lr->event = map_next_event (lr) < 0 ? NULL : &lr->map_event;
+        return lr->event ? 0 : -1;
+    }
+
     if (lr->event)
         lcm_eventlog_free_event (lr->event);
 
-    lr->event = lcm_eventlog_read_next_event (lr->log);
+    if (lr->read_ahead_thread) {
+        g_mutex_lock (lr->read_ahead_mutex);
+        while (g_queue_is_empty (lr->read_ahead_queue) && !lr->read_ahead_eof)
+            g_cond_wait (lr->read_ahead_cond, lr->read_ahead_mutex);
+        lr->event = g_queue_pop_head (lr->read_ahead_queue);
+        g_cond_signal (lr->read_ahead_space_cond);
+        g_mutex_unlock (lr->read_ahead_mutex);
+    } else {
+        lr->event = lcm_eventlog_read_next_event (lr->log);
+    }
     if (!lr->event)
         return -1;
 
@@ -177,13 +720,20 @@ lcm_logprov_create (lcm_t * parent, const char *target, const GHashTable *args)
     lr->speed = 1;
     lr->next_clock_time = -1;
     lr->start_timestamp = -1;
+    lr->spin_usec = PRECISE_DEFAULT_SPIN_USEC;
+    lr->mmap_limit = (int64_t) MMAP_DEFAULT_LIMIT_MB << 20;
 
     g_hash_table_foreach ((GHashTable*) args, new_argument, lr);
+    if (lr->speed <= 0)
+        lr->afap = 1;
+    // looping replays the log from memory
+    if (lr->loop)
+        lr->preload = 1;
 
     dbg (DBG_LCM, "Initializing LCM log provider context...\n");
     dbg (DBG_LCM, "Filename %s\n", lr->filename);
 
-    if(lcm_internal_pipe_create(lr->notify_pipe) != 0) {
+    if(lcm_internal_notify_create(lr->notify_pipe) != 0) {
         perror(__FILE__ " - pipe (notify)");
         lcm_logprov_destroy (lr);
         return NULL;
@@ -193,11 +743,14 @@ lcm_logprov_create (lcm_t * parent, const char *target, const GHashTable *args)
         lcm_logprov_destroy (lr);
         return NULL;
     }
-    //fcntl (lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
 
     switch (lr->log_mode) {
         case LCM_LOGPROV_READ_MODE:
-            lr->log = lcm_eventlog_create(lr->filename, "r");
+            if (lr->channel)
+                lr->log = lcm_eventlog_create_filtered(lr->filename,
+                        lr->channel);
+            else
+                lr->log = lcm_eventlog_create(lr->filename, "r");
             break;
         case LCM_LOGPROV_WRITE_MODE:
             lr->log = lcm_eventlog_create(lr->filename, "w");
@@ -218,30 +771,70 @@ lcm_logprov_create (lcm_t * parent, const char *target, const GHashTable *args)
         return NULL;
     }
 
+    if (lr->timing_log_name && lr->log_mode == LCM_LOGPROV_READ_MODE &&
+            !lr->afap) {
+        if (!lr->precise)
+            fprintf (stderr, "Warning: timing_log requires precise=1\n");
+        else if (!(lr->timing_log = fopen (lr->timing_log_name, "w"))) {
+            fprintf (stderr, "Error: Failed to open %s: %s\n",
+                    lr->timing_log_name, strerror (errno));
+            lcm_logprov_destroy (lr);
+            return NULL;
+        } else
+            fprintf (lr->timing_log, "# log_timestamp_usec error_nsec\n");
+    }
+
     // only start the reader thread if we're in read mode
     if (lr->log_mode == LCM_LOGPROV_READ_MODE){
+        if (lr->preload) {
+            // only the events from start_timestamp on are loaded and played
+            if (lr->start_timestamp > 0)
+                lcm_eventlog_seek_to_timestamp (lr->log, lr->start_timestamp);
+            if (preload_log (lr) < 0) {
+                fprintf (stderr, "Error: Failed to preload %s\n",
+                        lr->filename);
+                lcm_logprov_destroy (lr);
+                return NULL;
+            }
+        } else if (lr->use_mmap) {
+            map_log (lr);
+        }
         if (load_next_event (lr) < 0) {
             fprintf (stderr, "Error: Failed to read first event from log\n");
             lcm_logprov_destroy (lr);
             return NULL;
         }
 
-        /* Start the reader thread */
-        lr->timer_thread = g_thread_create (timer_thread, lr, TRUE, NULL);
-        if (!lr->timer_thread) {
-            fprintf (stderr, "Error: LCM failed to start timer thread\n");
-            lcm_logprov_destroy (lr);
-            return NULL;
+        /* Start the reader thread.  In afap mode there is nothing to time,
+         * and the notify pipe is signaled once and left readable. */
+        if (!lr->afap) {
+            lr->timer_thread = g_thread_create (timer_thread, lr, TRUE, NULL);
+            if (!lr->timer_thread) {
+                fprintf (stderr, "Error: LCM failed to start timer thread\n");
+                lcm_logprov_destroy (lr);
+                return NULL;
+            }
+            lr->thread_created = 1;
         }
-        lr->thread_created = 1;
 
-        if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+        if(lcm_internal_notify_signal(lr->notify_pipe) < 0) {
             perror(__FILE__ " - write (reader create)");
         }
 
-        if(lr->start_timestamp > 0){
+        if(lr->start_timestamp > 0 && !lr->preload_events){
             dbg (DBG_LCM, "Seeking to timestamp: %lld\n", (long long)lr->start_timestamp);
-            lcm_eventlog_seek_to_timestamp(lr->log, lr->start_timestamp);
+            if (lr->map)
+                map_seek_to_timestamp (lr, lr->start_timestamp);
+            else
+                lcm_eventlog_seek_to_timestamp(lr->log, lr->start_timestamp);
+        }
+
+        // a mapped or preloaded log has nothing to read ahead
+        if (lr->read_ahead > 0 && !lr->map && !lr->preload_events &&
+                read_ahead_start (lr) < 0) {
+            fprintf (stderr, "Error: LCM failed to start read-ahead thread\n");
+            lcm_logprov_destroy (lr);
+            return NULL;
         }
     }
 
@@ -254,6 +847,35 @@ lcm_logprov_get_fileno (lcm_logprov_t *lr)
     return lr->notify_pipe[0];
 }
 
+// dispatches the current event right away and loads the next one.  The
+// notify pipe keeps its one token, so it stays readable until the end of the
+// log, when handle() starts returning -1.
+static int
+handle_afap (lcm_logprov_t * lr)
+{
+    lcm_recv_buf_t rbuf;
+    const char *channel = lr->event->channel;
+
+    if (lr->flow_control) {
+        while (lcm_handlers_backlogged (lr->lcm, channel))
+            g_usleep (100);
+    }
+
+    rbuf.data = (uint8_t*) lr->event->data;
+    rbuf.data_size = lr->event->datalen;
+    rbuf.recv_time_ns = lcm_clock_realtime_ns ();
+    rbuf.recv_utime = rbuf.recv_time_ns / 1000;
+    rbuf.lcm = lr->lcm;
+    rbuf.owner = NULL;
+
+    if (lcm_try_enqueue_message (lr->lcm, channel))
+        lcm_dispatch_handlers (lr->lcm, &rbuf, channel);
+
+    if (load_next_event (lr) < 0)
+        lr->event = NULL;
+    return 0;
+}
+
 static int
 lcm_logprov_handle (lcm_logprov_t * lr)
 {
@@ -262,8 +884,10 @@ lcm_logprov_handle (lcm_logprov_t * lr)
     if (!lr->event)
         return -1;
 
-    char ch;
-    int status = lcm_internal_pipe_read(lr->notify_pipe[0], &ch, 1);
+    if (lr->afap)
+        return handle_afap (lr);
+
+    int status = lcm_internal_notify_wait(lr->notify_pipe);
     if (status == 0) {
         fprintf (stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
         return -1;
@@ -273,16 +897,31 @@ lcm_logprov_handle (lcm_logprov_t * lr)
         return -1;
     }
 
-    int64_t now = timestamp_now ();
-    /* Initialize the wall clock if this is the first time through */
-    if (lr->next_clock_time < 0)
+    int64_t now = lcm_clock_monotonic_us ();
+#ifdef LCM_FILE_PRECISE_TIMING
+    int64_t now_ns = 0;
+    if (lr->precise) {
+        now_ns = lcm_clock_monotonic_ns ();
+        if (lr->next_clock_time < 0)
+            lr->next_deadline_ns = now_ns;
+        else if (lr->timing_log)
+            fprintf (lr->timing_log, "%" PRId64 " %" PRId64 "\n",
+                    lr->event->timestamp, now_ns - lr->next_deadline_ns);
+    }
+#endif
+    /* Initialize the clock if this is the first time through */
+    if (lr->next_clock_time < 0) {
         lr->next_clock_time = now;
+        lr->clock_offset = lcm_clock_realtime_us () - now;
+    }
 
 //    rbuf.channel = lr->event->channel,
     rbuf.data = (uint8_t*) lr->event->data;
     rbuf.data_size = lr->event->datalen;
-    rbuf.recv_utime = lr->next_clock_time;
+    rbuf.recv_utime = lr->next_clock_time + lr->clock_offset;
+    rbuf.recv_time_ns = rbuf.recv_utime * 1000;
     rbuf.lcm = lr->lcm;
+    rbuf.owner = NULL;
 
     if(lcm_try_enqueue_message(lr->lcm, lr->event->channel))
         lcm_dispatch_handlers (lr->lcm, &rbuf, lr->event->channel);
@@ -292,26 +931,44 @@ lcm_logprov_handle (lcm_logprov_t * lr)
         /* end-of-file reached.  This call succeeds, but next call to
          * _handle will fail */
         lr->event = NULL;
-        if(lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1) < 0) {
+        if(lcm_internal_notify_signal(lr->notify_pipe) < 0) {
             perror(__FILE__ " - write(notify)");
         }
         return 0;
     }
 
-    /* Compute the wall time for the next event */
+    /* Compute the time for the next event */
     if (lr->speed > 0)
         lr->next_clock_time +=
             (lr->event->timestamp - prev_log_time) / lr->speed;
     else
         lr->next_clock_time = now;
 
+#ifdef LCM_FILE_PRECISE_TIMING
+    if (lr->precise) {
+        // the deadline keeps nanoseconds that next_clock_time rounds off, so
+        // that rounding does not accumulate over the log
+        lr->next_deadline_ns +=
+            (int64_t) ((lr->event->timestamp - prev_log_time) * 1000 /
+                    lr->speed);
+        int64_t *deadline = &lr->next_deadline_ns;
+        int wstatus = (*deadline > now_ns) ?
+            lcm_internal_pipe_write(lr->timer_pipe[1], deadline, 8) :
+            lcm_internal_notify_signal(lr->notify_pipe);
+        if(wstatus < 0) {
+            perror(__FILE__ " - write(timer_pipe)");
+        }
+        return 0;
+    }
+#endif
+
     if (lr->next_clock_time > now) {
         int wstatus = lcm_internal_pipe_write(lr->timer_pipe[1], &lr->next_clock_time, 8);
         if(wstatus < 0) {
             perror(__FILE__ " - write(timer_pipe)");
         }
     } else {
-        int wstatus = lcm_internal_pipe_write(lr->notify_pipe[1], "+", 1);
+        int wstatus = lcm_internal_notify_signal(lr->notify_pipe);
         if(wstatus < 0) {
             perror(__FILE__ " - write(notify_pipe)");
         }
@@ -336,9 +993,7 @@ lcm_logprov_publish (lcm_logprov_t *lcm, const char *channel, const void *data,
     lcm_eventlog_event_t *le = (lcm_eventlog_event_t*) malloc(mem_sz);
     memset(le, 0, mem_sz);
 
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    le->timestamp = (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;;
+    le->timestamp = lcm_clock_realtime_us ();
     le->channellen = channellen;
     le->datalen = datalen;
     // log_write_event will handle le.eventnum.
@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lcm_internal.h"
+#include "lcm_clock.h"
+#include "lcm_interest.h"
+#include "dbg.h"
+
+#ifdef __linux__
+#include <signal.h>
+#include <pthread.h>
+#include <sys/select.h>
+
+/*
+ * Hybrid provider.  hybrid://ADDR:PORT delivers the messages published on
+ * the host through the shm provider, and only uses the udpm multicast group
+ * ADDR:PORT to reach the other hosts.
+ *
+ * Each hybrid instance holds two underlying instances: one of shm://NAME,
+ * shared by all the hybrid instances of the group on the host, and one of
+ * udpm with ignore_local, which drops the multicast datagrams that come from
+ * the host, since their messages already arrived through shared memory.  A
+ * relay thread handles the messages of both and queues them for
+ * lcm_handle(), like the shared provider does with its underlying instance.
+ *
+ * Messages are always published to shared memory, and to the multicast group
+ * only if an instance on another host subscribes to their channel.  The
+ * instances learn about each other's subscriptions from the lcm_interest_t
+ * announcements that the relay threads publish on the multicast group (see
+ * lcm_interest.h), in the way mpudpm instances share their channel-to-port
+ * map.  The announcements also go to shared memory, so that
+ * lcm_has_remote_subscribers() knows about the instances of the host too.
+ */
+
+// the most messages the relay thread takes from an underlying instance at a
+// time
+#define HYBRID_RELAY_BATCH 64
+
+// A received message.  The channel and the payload follow the struct.
+typedef struct _hybrid_msg hybrid_msg_t;
+struct _hybrid_msg {
+    char *channel;
+    lcm_recv_buf_t rbuf;
+};
+
+// a channel pattern subscribed to on the underlying instances
+typedef struct _hybrid_pattern hybrid_pattern_t;
+struct _hybrid_pattern {
+    lcm_subscription_t *shm_subs;
+    lcm_subscription_t *udpm_subs;
+    int count;  // subscriptions to it on the hybrid instance
+};
+
+typedef struct _lcm_provider_t lcm_hybrid_t;
+struct _lcm_provider_t {
+    lcm_t *lcm;
+    lcm_t *shm;
+    lcm_t *udpm;
+
+    int udp_always;     // publish to the group whether or not anyone listens
+    int interval_ms;    // between announcements
+    int64_t node_id;
+    lcm_interest_table_t *interest;         // of the other hosts
+    lcm_interest_table_t *local_interest;   // of this host
+
+    GThread *relay_thread;
+    // tells relay_thread to quit ('x') or to announce the subscriptions
+    // ('a').  announce_pending is set while an 'a' is in the pipe.
+    int wake_pipe[2];
+    volatile gint announce_pending;
+
+    // channel pattern -> hybrid_pattern_t.  Held while subscribing, which
+    // may wait for the relay thread, so never taken by it.
+    GStaticMutex patterns_lock;
+    GHashTable *patterns;
+
+    // the keys of patterns, as announced by the relay thread
+    GStaticMutex announced_lock;
+    GPtrArray *announced;
+
+    GStaticMutex queue_lock;  // guards queue
+    GQueue *queue;
+    int notify_pipe[2];  // holds a token while the queue is not empty
+};
+
+static void
+hybrid_ignore (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+}
+
+// Dispatch tap of the underlying instances: queues the message on the hybrid
+// instance if it has room for it.
+static void
+hybrid_relay (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    lcm_hybrid_t *self = (lcm_hybrid_t *) user;
+    if (!strcmp (channel, LCM_INTEREST_CHANNEL) ||
+            !lcm_try_enqueue_message (self->lcm, channel))
+        return;
+
+    int channel_size = strlen (channel) + 1;
+    hybrid_msg_t *msg = (hybrid_msg_t *) malloc (sizeof (hybrid_msg_t) +
+            channel_size + rbuf->data_size);
+    msg->channel = (char *) (msg + 1);
+    memcpy (msg->channel, channel, channel_size);
+    msg->rbuf = *rbuf;
+    msg->rbuf.data = msg->channel + channel_size;
+    memcpy (msg->rbuf.data, rbuf->data, rbuf->data_size);
+    msg->rbuf.owner = NULL;
+
+    g_static_mutex_lock (&self->queue_lock);
+    g_queue_push_tail (self->queue, msg);
+    int was_empty = g_queue_get_length (self->queue) == 1;
+    g_static_mutex_unlock (&self->queue_lock);
+    if (was_empty && lcm_internal_notify_signal (self->notify_pipe) < 0)
+        perror (__FILE__ " - write to notify pipe (hybrid_relay)");
+}
+
+// Has the relay thread announce the subscriptions soon.
+static void
+hybrid_request_announce (lcm_hybrid_t *self)
+{
+    if (g_atomic_int_compare_and_exchange (&self->announce_pending, 0, 1) &&
+            lcm_internal_pipe_write (self->wake_pipe[1], "a", 1) < 0)
+        perror (__FILE__ " write(announce)");
+}
+
+// Adds channel to the announced patterns, or removes it, and has them
+// announced.
+static void
+hybrid_set_announced (lcm_hybrid_t *self, const char *channel, int add)
+{
+    g_static_mutex_lock (&self->announced_lock);
+    if (add) {
+        g_ptr_array_add (self->announced, strdup (channel));
+    } else {
+        for (unsigned int i = 0; i < self->announced->len; i++) {
+            char *pattern = (char *) g_ptr_array_index (self->announced, i);
+            if (!strcmp (pattern, channel)) {
+                g_ptr_array_remove_index (self->announced, i);
+                free (pattern);
+                break;
+            }
+        }
+    }
+    g_static_mutex_unlock (&self->announced_lock);
+    hybrid_request_announce (self);
+}
+
+static void
+hybrid_announce (lcm_hybrid_t *self)
+{
+    g_static_mutex_lock (&self->announced_lock);
+    int size;
+    void *buf = lcm_interest_encode (self->node_id, self->interval_ms,
+            self->announced, &size);
+    g_static_mutex_unlock (&self->announced_lock);
+
+    if (lcm_publish (self->shm, LCM_INTEREST_CHANNEL, buf, size) < 0 ||
+            lcm_publish (self->udpm, LCM_INTEREST_CHANNEL, buf, size) < 0)
+        dbg (DBG_LCM, "could not announce the subscriptions\n");
+    free (buf);
+}
+
+static void
+hybrid_update_interest (lcm_hybrid_t *self, lcm_interest_table_t *table,
+        const lcm_recv_buf_t *rbuf)
+{
+    // answer a newcomer right away, so that it does not wait a whole
+    // interval to learn about this instance
+    if (lcm_interest_table_update (table, rbuf->data, rbuf->data_size,
+                lcm_clock_monotonic_us ()) > 0)
+        hybrid_request_announce (self);
+}
+
+static void
+hybrid_on_interest (const lcm_recv_buf_t *rbuf, const char *channel,
+        void *user)
+{
+    lcm_hybrid_t *self = (lcm_hybrid_t *) user;
+    hybrid_update_interest (self, self->interest, rbuf);
+}
+
+static void
+hybrid_on_local_interest (const lcm_recv_buf_t *rbuf, const char *channel,
+        void *user)
+{
+    lcm_hybrid_t *self = (lcm_hybrid_t *) user;
+    hybrid_update_interest (self, self->local_interest, rbuf);
+}
+
+static void *
+hybrid_relay_thread (void *user)
+{
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset (&mask);
+    pthread_sigmask (SIG_SETMASK, &mask, NULL);
+
+    lcm_hybrid_t *self = (lcm_hybrid_t *) user;
+    lcm_internal_thread_init ("hybrid-relay", NULL, NULL);
+    int shm_fd = lcm_get_fileno (self->shm);
+    int udpm_fd = lcm_get_fileno (self->udpm);
+    int64_t next_announce = 0;
+    while (1) {
+        int64_t now = lcm_clock_monotonic_us ();
+        if (now >= next_announce) {
+            hybrid_announce (self);
+            lcm_interest_table_expire (self->interest, now);
+            lcm_interest_table_expire (self->local_interest, now);
+            next_announce = now + (int64_t) self->interval_ms * 1000;
+        }
+
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (self->wake_pipe[0], &fds);
+        FD_SET (shm_fd, &fds);
+        FD_SET (udpm_fd, &fds);
+        int maxfd = MAX (self->wake_pipe[0], MAX (shm_fd, udpm_fd));
+        int64_t timeout = next_announce - now;
+        struct timeval tv = { timeout / 1000000, timeout % 1000000 };
+        int status = select (maxfd + 1, &fds, NULL, NULL, &tv);
+        if (status < 0) {
+            if (errno != EINTR)
+                perror ("hybrid relay thread -- select");
+            continue;
+        }
+        if (FD_ISSET (self->wake_pipe[0], &fds)) {
+            char cmd;
+            if (lcm_internal_pipe_read (self->wake_pipe[0], &cmd, 1) != 1 ||
+                    cmd == 'x')
+                break;
+            g_atomic_int_set (&self->announce_pending, 0);
+            next_announce = 0;
+        }
+        if (FD_ISSET (shm_fd, &fds) &&
+                lcm_handle_batch (self->shm, HYBRID_RELAY_BATCH, 0) < 0)
+            break;
+        if (FD_ISSET (udpm_fd, &fds) &&
+                lcm_handle_batch (self->udpm, HYBRID_RELAY_BATCH, 0) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void
+hybrid_pattern_free (gpointer data)
+{
+    free (data);
+}
+
+static void
+lcm_hybrid_destroy (lcm_hybrid_t *self)
+{
+    dbg (DBG_LCM, "destroying LCM hybrid provider context\n");
+    if (self->relay_thread) {
+        if (lcm_internal_pipe_write (self->wake_pipe[1], "x", 1) < 0)
+            perror (__FILE__ " write(exit)");
+        else
+            g_thread_join (self->relay_thread);
+    }
+    if (self->wake_pipe[0] >= 0) {
+        lcm_internal_pipe_close (self->wake_pipe[0]);
+        lcm_internal_pipe_close (self->wake_pipe[1]);
+    }
+    if (self->udpm)
+        lcm_destroy (self->udpm);
+    if (self->shm)
+        lcm_destroy (self->shm);
+    if (self->interest)
+        lcm_interest_table_free (self->interest);
+    if (self->local_interest)
+        lcm_interest_table_free (self->local_interest);
+    g_hash_table_destroy (self->patterns);
+    g_static_mutex_free (&self->patterns_lock);
+    for (unsigned int i = 0; i < self->announced->len; i++)
+        free (g_ptr_array_index (self->announced, i));
+    g_ptr_array_free (self->announced, TRUE);
+    g_static_mutex_free (&self->announced_lock);
+
+    hybrid_msg_t *msg;
+    while ((msg = (hybrid_msg_t *) g_queue_pop_head (self->queue)))
+        free (msg);
+    g_queue_free (self->queue);
+    g_static_mutex_free (&self->queue_lock);
+    lcm_internal_notify_close (self->notify_pipe);
+    free (self);
+}
+
+typedef struct {
+    lcm_hybrid_t *self;
+    GString *udpm_url;
+    char *shm_name;
+    char *shm_size_mb;
+} hybrid_args_t;
+
+static void
+new_argument (gpointer key, gpointer value, gpointer user)
+{
+    hybrid_args_t *args = (hybrid_args_t *) user;
+    lcm_hybrid_t *self = args->self;
+    if (!strcmp ((char *) key, "shm")) {
+        free (args->shm_name);
+        args->shm_name = strdup ((char *) value);
+    } else if (!strcmp ((char *) key, "shm_size_mb")) {
+        free (args->shm_size_mb);
+        args->shm_size_mb = strdup ((char *) value);
+    } else if (!strcmp ((char *) key, "udp")) {
+        if (!strcmp ((char *) value, "always"))
+            self->udp_always = 1;
+        else if (!strcmp ((char *) value, "auto"))
+            self->udp_always = 0;
+        else
+            fprintf (stderr, "Warning: Invalid value for udp\n");
+    } else if (!strcmp ((char *) key, "announce_ms")) {
+        char *endptr = NULL;
+        self->interval_ms = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || self->interval_ms <= 0) {
+            fprintf (stderr, "Warning: Invalid value for announce_ms\n");
+            self->interval_ms = LCM_INTEREST_DEFAULT_INTERVAL_MS;
+        }
+    } else if (!strcmp ((char *) key, "ignore_local")) {
+        fprintf (stderr, "Warning: ignore_local is always on with hybrid\n");
+    } else if (!strcmp ((char *) key, "interest")) {
+        fprintf (stderr, "Warning: interest is always on with hybrid\n");
+    } else {
+        // everything else is for udpm
+        g_string_append_printf (args->udpm_url, "&%s=%s", (char *) key,
+                (char *) value);
+    }
+}
+
+static lcm_provider_t *
+lcm_hybrid_create (lcm_t *parent, const char *network, const GHashTable *args)
+{
+    lcm_hybrid_t *self = (lcm_hybrid_t *) calloc (1, sizeof (lcm_hybrid_t));
+    self->lcm = parent;
+    self->interval_ms = LCM_INTEREST_DEFAULT_INTERVAL_MS;
+    self->node_id = lcm_interest_new_node_id ();
+    self->wake_pipe[0] = self->wake_pipe[1] = -1;
+    g_static_mutex_init (&self->patterns_lock);
+    self->patterns = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+            hybrid_pattern_free);
+    g_static_mutex_init (&self->announced_lock);
+    self->announced = g_ptr_array_new ();
+    g_static_mutex_init (&self->queue_lock);
+    self->queue = g_queue_new ();
+    if (lcm_internal_notify_create (self->notify_pipe) != 0) {
+        perror (__FILE__ " - pipe (notify)");
+        self->notify_pipe[0] = self->notify_pipe[1] = -1;
+        lcm_hybrid_destroy (self);
+        return NULL;
+    }
+
+    hybrid_args_t hargs = { self, NULL, NULL, NULL };
+    hargs.udpm_url = g_string_new ("udpm://");
+    g_string_append_printf (hargs.udpm_url, "%s?ignore_local=1",
+            network ? network : "");
+    g_hash_table_foreach ((GHashTable *) args, new_argument, &hargs);
+
+    // by default, the hybrid instances of the same group share a segment
+    GString *shm_url = g_string_new ("shm://");
+    if (hargs.shm_name) {
+        g_string_append (shm_url, hargs.shm_name);
+    } else {
+        g_string_append (shm_url, "hybrid-");
+        for (const char *c = network && *network ? network : "default"; *c;
+                c++)
+            g_string_append_c (shm_url, *c == ':' ? '-' : *c);
+    }
+    if (hargs.shm_size_mb)
+        g_string_append_printf (shm_url, "?size_mb=%s", hargs.shm_size_mb);
+
+    dbg (DBG_LCM, "hybrid of %s and %s\n", shm_url->str, hargs.udpm_url->str);
+    self->shm = lcm_create (shm_url->str);
+    if (self->shm)
+        self->udpm = lcm_create (hargs.udpm_url->str);
+    g_string_free (shm_url, TRUE);
+    g_string_free (hargs.udpm_url, TRUE);
+    free (hargs.shm_name);
+    free (hargs.shm_size_mb);
+    if (!self->udpm) {
+        lcm_hybrid_destroy (self);
+        return NULL;
+    }
+    lcm_internal_set_dispatch_tap (self->shm, hybrid_relay, self);
+    lcm_internal_set_dispatch_tap (self->udpm, hybrid_relay, self);
+
+    self->interest = lcm_interest_table_new (self->node_id);
+    self->local_interest = lcm_interest_table_new (self->node_id);
+    lcm_subscription_t *subs = lcm_subscribe (self->udpm,
+            LCM_INTEREST_CHANNEL, hybrid_on_interest, self);
+    lcm_subscription_t *local_subs = lcm_subscribe (self->shm,
+            LCM_INTEREST_CHANNEL, hybrid_on_local_interest, self);
+    if (!subs || !local_subs) {
+        lcm_hybrid_destroy (self);
+        return NULL;
+    }
+    lcm_subscription_set_queue_capacity (subs, 0);
+    lcm_subscription_set_queue_capacity (local_subs, 0);
+
+    if (0 != lcm_internal_pipe_create (self->wake_pipe)) {
+        perror (__FILE__ " pipe(wake)");
+        self->wake_pipe[0] = self->wake_pipe[1] = -1;
+        lcm_hybrid_destroy (self);
+        return NULL;
+    }
+    self->relay_thread = g_thread_create (hybrid_relay_thread, self, TRUE,
+            NULL);
+    if (!self->relay_thread) {
+        fprintf (stderr, "Error: LCM failed to start the relay thread\n");
+        lcm_hybrid_destroy (self);
+        return NULL;
+    }
+    return self;
+}
+
+static int
+lcm_hybrid_subscribe (lcm_hybrid_t *self, const char *channel)
+{
+    int status = 0;
+    g_static_mutex_lock (&self->patterns_lock);
+    hybrid_pattern_t *pat = (hybrid_pattern_t *) g_hash_table_lookup (
+            self->patterns, channel);
+    if (!pat) {
+        lcm_subscription_t *shm_subs = lcm_subscribe (self->shm, channel,
+                hybrid_ignore, NULL);
+        lcm_subscription_t *udpm_subs = shm_subs ? lcm_subscribe (self->udpm,
+                channel, hybrid_ignore, NULL) : NULL;
+        if (udpm_subs) {
+            // the queues that count are those of the hybrid instance
+            lcm_subscription_set_queue_capacity (shm_subs, 0);
+            lcm_subscription_set_queue_capacity (udpm_subs, 0);
+            pat = (hybrid_pattern_t *) calloc (1, sizeof (hybrid_pattern_t));
+            pat->shm_subs = shm_subs;
+            pat->udpm_subs = udpm_subs;
+            g_hash_table_insert (self->patterns, strdup (channel), pat);
+        } else {
+            if (shm_subs)
+                lcm_unsubscribe (self->shm, shm_subs);
+            status = -1;
+        }
+    }
+    if (pat)
+        pat->count++;
+    int is_new = pat && pat->count == 1;
+    g_static_mutex_unlock (&self->patterns_lock);
+
+    if (is_new)
+        hybrid_set_announced (self, channel, 1);
+    return status;
+}
+
+static int
+lcm_hybrid_unsubscribe (lcm_hybrid_t *self, const char *channel)
+{
+    g_static_mutex_lock (&self->patterns_lock);
+    hybrid_pattern_t *pat = (hybrid_pattern_t *) g_hash_table_lookup (
+            self->patterns, channel);
+    int removed = pat && --pat->count == 0;
+    if (removed) {
+        lcm_unsubscribe (self->shm, pat->shm_subs);
+        lcm_unsubscribe (self->udpm, pat->udpm_subs);
+        g_hash_table_remove (self->patterns, channel);
+    }
+    g_static_mutex_unlock (&self->patterns_lock);
+
+    if (removed)
+        hybrid_set_announced (self, channel, 0);
+    return 0;
+}
+
+static int
+lcm_hybrid_publish (lcm_hybrid_t *self, const char *channel, const void *data,
+        unsigned int datalen)
+{
+    int status = lcm_publish (self->shm, channel, data, datalen);
+    if ((self->udp_always ||
+                lcm_interest_table_match (self->interest, channel)) &&
+            lcm_publish (self->udpm, channel, data, datalen) < 0)
+        status = -1;
+    return status;
+}
+
+static int
+lcm_hybrid_has_subscribers (lcm_hybrid_t *self, const char *channel)
+{
+    int local = lcm_interest_table_has_subscribers (self->local_interest,
+            channel, self->interval_ms);
+    int remote = lcm_interest_table_has_subscribers (self->interest, channel,
+            self->interval_ms);
+    return local > 0 || remote > 0 ? 1 : MIN (local, remote);
+}
+
+static int
+lcm_hybrid_get_fileno (lcm_hybrid_t *self)
+{
+    return self->notify_pipe[0];
+}
+
+static int
+lcm_hybrid_handle_batch (lcm_hybrid_t *self, int max_msgs)
+{
+    int status = lcm_internal_notify_wait (self->notify_pipe);
+    if (status == 0) {
+        fprintf (stderr,
+                "Error: lcm_hybrid_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    } else if (status < 0) {
+        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
+        return -1;
+    }
+
+    int num_msgs = 0;
+    int num_left = 0;
+    while (num_msgs < max_msgs) {
+        g_static_mutex_lock (&self->queue_lock);
+        hybrid_msg_t *msg = (hybrid_msg_t *) g_queue_pop_head (self->queue);
+        num_left = g_queue_get_length (self->queue);
+        g_static_mutex_unlock (&self->queue_lock);
+        if (!msg)
+            break;
+
+        dbg (DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
+                msg->channel, msg->rbuf.data_size);
+        msg->rbuf.lcm = self->lcm;
+        lcm_dispatch_handlers (self->lcm, &msg->rbuf, msg->channel);
+        free (msg);
+        num_msgs++;
+        if (!num_left)
+            break;
+    }
+
+    // the token was taken, so one is due for the messages still queued
+    if (num_left && lcm_internal_notify_signal (self->notify_pipe) < 0)
+        perror (__FILE__ " - write to notify pipe (lcm_hybrid_handle)");
+    return num_msgs;
+}
+
+static int
+lcm_hybrid_handle (lcm_hybrid_t *self)
+{
+    int status = lcm_hybrid_handle_batch (self, 1);
+    return status < 0 ? status : 0;
+}
+
+// The counters of udpm, with the messages received through shared memory
+// added to its packets.
+static int
+lcm_hybrid_get_stats (lcm_hybrid_t *self, lcm_transport_stats_t *stats)
+{
+    lcm_transport_stats_t shm_stats;
+    if (lcm_get_transport_stats (self->udpm, stats) < 0 ||
+            lcm_get_transport_stats (self->shm, &shm_stats) < 0)
+        return -1;
+    stats->num_packets += shm_stats.num_packets;
+    stats->num_bytes += shm_stats.num_bytes;
+    stats->num_bad_packets += shm_stats.num_bad_packets;
+    stats->num_lost += shm_stats.num_lost;
+    return 0;
+}
+
+static lcm_provider_vtable_t hybrid_vtable = {
+    .create      = lcm_hybrid_create,
+    .destroy     = lcm_hybrid_destroy,
+    .subscribe   = lcm_hybrid_subscribe,
+    .unsubscribe = lcm_hybrid_unsubscribe,
+    .publish     = lcm_hybrid_publish,
+    .handle      = lcm_hybrid_handle,
+    .get_fileno  = lcm_hybrid_get_fileno,
+    .handle_batch = lcm_hybrid_handle_batch,
+    .get_stats   = lcm_hybrid_get_stats,
+    .has_subscribers = lcm_hybrid_has_subscribers
+};
+static lcm_provider_info_t hybrid_info;
+#endif
+
+void
+lcm_hybrid_provider_init (GPtrArray * providers)
+{
+#ifdef __linux__
+    hybrid_info.name = "hybrid";
+    hybrid_info.vtable = &hybrid_vtable;
+
+    g_ptr_array_add (providers, &hybrid_info);
+#endif
+}
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <sys/time.h>
+#else
+#include "windows/WinPorting.h"
+#include <Winsock2.h>
+#endif
+
+#include "lcm_internal.h"
+#include "lcm_clock.h"
+#include "dbg.h"
+
+/*
+ * lcm_publish() invokes the matching handlers itself, on the publishing
+ * thread, with the caller's buffer.  Nothing is queued, so lcm_handle() never
+ * has anything to do.
+ *
+ * A handler that publishes on the same instance dispatches its message right
+ * away too, nested inside the first dispatch, up to max_depth levels.  With
+ * defer=1 such messages are instead copied and dispatched in order once the
+ * handlers of the outermost lcm_publish() have returned.
+ */
+
+#define INPROC_DEFAULT_MAX_DEPTH 16
+
+typedef struct _lcm_provider_t lcm_inproc_t;
+struct _lcm_provider_t {
+    lcm_t* lcm;
+    int defer;
+    int max_depth;
+    int notify_pipe[2];  // never written to
+};
+
+// A message published from within a handler, in defer mode.  The channel
+// and payload follow the struct.
+typedef struct _inproc_msg inproc_msg_t;
+struct _inproc_msg {
+    unsigned int datalen;
+};
+
+// One lcm_publish() in progress on the current thread.  Frames live on the
+// stack of the publishing thread, innermost first.
+typedef struct _inproc_frame inproc_frame_t;
+struct _inproc_frame {
+    lcm_inproc_t* self;
+    inproc_frame_t* parent;
+    inproc_frame_t* root;  // the outermost frame of the same instance
+    int depth;
+    GQueue* deferred;      // only used in the root frame
+};
+
+static GStaticPrivate DISPATCH_FRAME_PKEY = G_STATIC_PRIVATE_INIT;
+
+static void
+inproc_dispatch(lcm_inproc_t* self, const char* channel, const void* data,
+        unsigned int datalen)
+{
+    if (!lcm_try_enqueue_message(self->lcm, channel))
+        return;
+
+    int64_t utime = lcm_clock_realtime_us();
+    lcm_recv_buf_t rbuf;
+    rbuf.data = (void*) data;
+    rbuf.data_size = datalen;
+    rbuf.recv_utime = utime;
+    rbuf.recv_time_ns = utime * 1000;
+    rbuf.lcm = self->lcm;
+    // the buffer belongs to the publisher, so lcm_recv_buf_retain() copies
+    rbuf.owner = NULL;
+    lcm_dispatch_handlers(self->lcm, &rbuf, channel);
+}
+
+static void
+lcm_inproc_destroy (lcm_inproc_t *self)
+{
+    dbg(DBG_LCM, "destroying LCM inproc provider context\n");
+    lcm_internal_notify_close(self->notify_pipe);
+    memset(self, 0, sizeof(lcm_inproc_t));
+    free(self);
+}
+
+static lcm_provider_t*
+lcm_inproc_create (lcm_t* parent, const char* target, const GHashTable* args)
+{
+    lcm_inproc_t * self = (lcm_inproc_t*) calloc(1, sizeof(lcm_inproc_t));
+    self->lcm = parent;
+    self->max_depth = INPROC_DEFAULT_MAX_DEPTH;
+
+    dbg(DBG_LCM, "Initializing LCM inproc provider context...\n");
+
+    const char* defer = (const char*) g_hash_table_lookup(
+            (GHashTable*) args, "defer");
+    if (defer) {
+        char* endptr = NULL;
+        self->defer = strtol(defer, &endptr, 0);
+        if (endptr == defer || *endptr)
+            fprintf(stderr, "Warning: Invalid value for defer\n");
+    }
+    const char* max_depth = (const char*) g_hash_table_lookup(
+            (GHashTable*) args, "max_depth");
+    if (max_depth) {
+        char* endptr = NULL;
+        self->max_depth = strtol(max_depth, &endptr, 0);
+        if (endptr == max_depth || *endptr || self->max_depth < 1) {
+            fprintf(stderr, "Warning: Invalid value for max_depth\n");
+            self->max_depth = INPROC_DEFAULT_MAX_DEPTH;
+        }
+    }
+
+    // lcm_get_fileno() has to return something that event loops can wait on
+    if(lcm_internal_notify_create(self->notify_pipe) != 0) {
+        perror(__FILE__ " - pipe (notify)");
+        lcm_inproc_destroy (self);
+        return NULL;
+    }
+    return self;
+}
+
+static int
+lcm_inproc_get_fileno(lcm_inproc_t* self)
+{
+    return self->notify_pipe[0];
+}
+
+static int
+lcm_inproc_handle(lcm_inproc_t* self)
+{
+    // messages are dispatched as they are published, so this only returns
+    // if the pipe is closed
+    int status = lcm_internal_notify_wait(self->notify_pipe);
+    return status <= 0 ? -1 : 0;
+}
+
+static int
+lcm_inproc_publish (lcm_inproc_t *self, const char *channel, const void *data,
+        unsigned int datalen)
+{
+    inproc_frame_t* top =
+        (inproc_frame_t*) g_static_private_get(&DISPATCH_FRAME_PKEY);
+    inproc_frame_t* outer = top;
+    while (outer && outer->self != self)
+        outer = outer->parent;
+
+    if (outer && self->defer) {
+        size_t channel_size = strlen(channel) + 1;
+        inproc_msg_t* msg = (inproc_msg_t*) malloc(sizeof(inproc_msg_t) +
+                channel_size + datalen);
+        if (!msg)
+            return -1;
+        msg->datalen = datalen;
+        memcpy(msg + 1, channel, channel_size);
+        memcpy((char*) (msg + 1) + channel_size, data, datalen);
+        if (!outer->root->deferred)
+            outer->root->deferred = g_queue_new();
+        g_queue_push_tail(outer->root->deferred, msg);
+        dbg(DBG_LCM, "Deferring [%s] size [%d]\n", channel, datalen);
+        return 0;
+    }
+    if (outer && outer->depth >= self->max_depth) {
+        fprintf(stderr, "LCM inproc: publishing [%s] from a handler nested "
+                "%d deep, dropping\n", channel, outer->depth);
+        return -1;
+    }
+    dbg(DBG_LCM, "Publishing to [%s] message size [%d]\n", channel, datalen);
+
+    inproc_frame_t frame;
+    frame.self = self;
+    frame.parent = top;
+    frame.root = outer ? outer->root : &frame;
+    frame.depth = outer ? outer->depth + 1 : 1;
+    frame.deferred = NULL;
+    g_static_private_set(&DISPATCH_FRAME_PKEY, &frame, NULL);
+
+    inproc_dispatch(self, channel, data, datalen);
+
+    if (frame.deferred) {
+        // handlers of deferred messages may defer more of them
+        inproc_msg_t* msg;
+        while ((msg = (inproc_msg_t*) g_queue_pop_head(frame.deferred))) {
+            const char* msg_channel = (const char*) (msg + 1);
+            inproc_dispatch(self, msg_channel,
+                    msg_channel + strlen(msg_channel) + 1, msg->datalen);
+            free(msg);
+        }
+        g_queue_free(frame.deferred);
+    }
+
+    g_static_private_set(&DISPATCH_FRAME_PKEY, top, NULL);
+    return 0;
+}
+
+#ifdef WIN32
+static lcm_provider_vtable_t inproc_vtable;
+#else
+static lcm_provider_vtable_t inproc_vtable = {
+    .create      = lcm_inproc_create,
+    .destroy     = lcm_inproc_destroy,
+    .subscribe   = NULL,
+    .unsubscribe = NULL,
+    .publish     = lcm_inproc_publish,
+    .handle      = lcm_inproc_handle,
+    .get_fileno  = lcm_inproc_get_fileno,
+};
+#endif
+static lcm_provider_info_t inproc_info;
+
+void
+lcm_inproc_provider_init (GPtrArray * providers)
+{
+#ifdef WIN32
+    inproc_vtable.create      = lcm_inproc_create;
+    inproc_vtable.destroy     = lcm_inproc_destroy;
+    inproc_vtable.subscribe   = NULL;
+    inproc_vtable.unsubscribe = NULL;
+    inproc_vtable.publish     = lcm_inproc_publish;
+    inproc_vtable.handle      = lcm_inproc_handle;
+    inproc_vtable.get_fileno  = lcm_inproc_get_fileno;
+#endif
+    inproc_info.name = "inproc";
+    inproc_info.vtable = &inproc_vtable;
+
+    g_ptr_array_add (providers, &inproc_info);
+}
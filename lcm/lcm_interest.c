@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "lcm_interest.h"
+#include "lcm_clock.h"
+#include "channel_matcher.h"
+#include "dbg.h"
+#include "lcmtypes/lcm_interest_t.h"
+
+// the most channels whose answer is cached.  Past that, the cache starts over.
+#define INTEREST_CACHE_MAX 4096
+
+typedef struct _interest_node interest_node_t;
+struct _interest_node {
+    int64_t node_id;
+    int64_t expires_us;     // on the monotonic clock
+    GPtrArray *texts;       // char*, the patterns as announced
+    GPtrArray *patterns;    // lcm_channel_pattern_t*, compiled from texts
+};
+
+struct _lcm_interest_table {
+    int64_t self_id;
+    int64_t created_us;     // on the monotonic clock
+
+    // guards everything below, since publishers look up channels from their
+    // own threads
+    GStaticMutex lock;
+    GHashTable *nodes;      // &node_id -> interest_node_t
+    lcm_channel_matcher_t *matcher;     // patterns of all the nodes
+    GHashTable *cache;      // channel -> GINT_TO_POINTER (1 + matched)
+};
+
+static void
+interest_node_free (lcm_interest_table_t *table, interest_node_t *node)
+{
+    for (unsigned int i = 0; i < node->patterns->len; i++) {
+        lcm_channel_pattern_t *pat = (lcm_channel_pattern_t *)
+            g_ptr_array_index (node->patterns, i);
+        lcm_channel_matcher_remove (table->matcher, pat, node);
+        lcm_channel_pattern_free (pat);
+    }
+    g_ptr_array_free (node->patterns, TRUE);
+    for (unsigned int i = 0; i < node->texts->len; i++)
+        free (g_ptr_array_index (node->texts, i));
+    g_ptr_array_free (node->texts, TRUE);
+    free (node);
+}
+
+lcm_interest_table_t *
+lcm_interest_table_new (int64_t self_id)
+{
+    lcm_interest_table_t *table = (lcm_interest_table_t *) calloc (1,
+            sizeof (lcm_interest_table_t));
+    table->self_id = self_id;
+    table->created_us = lcm_clock_monotonic_us ();
+    g_static_mutex_init (&table->lock);
+    table->nodes = g_hash_table_new (g_int64_hash, g_int64_equal);
+    table->matcher = lcm_channel_matcher_new ();
+    table->cache = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+            NULL);
+    return table;
+}
+
+void
+lcm_interest_table_free (lcm_interest_table_t *table)
+{
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init (&iter, table->nodes);
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+        interest_node_free (table, (interest_node_t *) value);
+    g_hash_table_destroy (table->nodes);
+    lcm_channel_matcher_free (table->matcher);
+    g_hash_table_destroy (table->cache);
+    g_static_mutex_free (&table->lock);
+    free (table);
+}
+
+// Returns nonzero if node already announced exactly the patterns of msg.
+static int
+interest_node_same (const interest_node_t *node, const lcm_interest_t *msg)
+{
+    if ((int) node->texts->len != msg->num_patterns)
+        return 0;
+    for (int i = 0; i < msg->num_patterns; i++)
+        if (strcmp ((const char *) g_ptr_array_index (node->texts, i),
+                    msg->patterns[i]))
+            return 0;
+    return 1;
+}
+
+int
+lcm_interest_table_update (lcm_interest_table_t *table, const void *data,
+        int size, int64_t now_us)
+{
+    lcm_interest_t msg;
+    if (lcm_interest_t_decode (data, 0, size, &msg) < 0) {
+        dbg (DBG_LCM, "could not decode an lcm_interest_t\n");
+        return -1;
+    }
+    if (msg.node_id == table->self_id) {
+        lcm_interest_t_decode_cleanup (&msg);
+        return -1;
+    }
+    int interval_ms = CLAMP (msg.interval_ms, 1, 3600 * 1000);
+    int64_t expires_us = now_us +
+        (int64_t) interval_ms * 1000 * LCM_INTEREST_EXPIRY_INTERVALS;
+
+    g_static_mutex_lock (&table->lock);
+    interest_node_t *node = (interest_node_t *) g_hash_table_lookup (
+            table->nodes, &msg.node_id);
+    int is_new = node == NULL;
+    if (node && interest_node_same (node, &msg)) {
+        node->expires_us = expires_us;
+        g_static_mutex_unlock (&table->lock);
+        lcm_interest_t_decode_cleanup (&msg);
+        return 0;
+    }
+
+    if (node) {
+        g_hash_table_remove (table->nodes, &node->node_id);
+        interest_node_free (table, node);
+    }
+    node = (interest_node_t *) calloc (1, sizeof (interest_node_t));
+    node->node_id = msg.node_id;
+    node->expires_us = expires_us;
+    node->texts = g_ptr_array_new ();
+    node->patterns = g_ptr_array_new ();
+    for (int i = 0; i < msg.num_patterns; i++) {
+        g_ptr_array_add (node->texts, strdup (msg.patterns[i]));
+        GError *err = NULL;
+        lcm_channel_pattern_t *pat = lcm_channel_pattern_new (msg.patterns[i],
+                &err);
+        if (!pat) {
+            dbg (DBG_LCM, "ignoring the bad pattern [%s]: %s\n",
+                    msg.patterns[i], err->message);
+            g_error_free (err);
+            continue;
+        }
+        g_ptr_array_add (node->patterns, pat);
+        lcm_channel_matcher_add (table->matcher, pat, node);
+    }
+    g_hash_table_insert (table->nodes, &node->node_id, node);
+    g_hash_table_remove_all (table->cache);
+    dbg (DBG_LCM, "instance %" PRIx64 " subscribes to %d "
+            "patterns\n", msg.node_id, msg.num_patterns);
+    g_static_mutex_unlock (&table->lock);
+
+    lcm_interest_t_decode_cleanup (&msg);
+    return is_new;
+}
+
+void
+lcm_interest_table_expire (lcm_interest_table_t *table, int64_t now_us)
+{
+    g_static_mutex_lock (&table->lock);
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init (&iter, table->nodes);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+        interest_node_t *node = (interest_node_t *) value;
+        if (node->expires_us > now_us)
+            continue;
+        dbg (DBG_LCM, "forgetting instance %" PRIx64 "\n",
+                node->node_id);
+        g_hash_table_iter_remove (&iter);
+        interest_node_free (table, node);
+        g_hash_table_remove_all (table->cache);
+    }
+    g_static_mutex_unlock (&table->lock);
+}
+
+int
+lcm_interest_table_match (lcm_interest_table_t *table, const char *channel)
+{
+    g_static_mutex_lock (&table->lock);
+    int matched = GPOINTER_TO_INT (g_hash_table_lookup (table->cache,
+                channel)) - 1;
+    if (matched < 0) {
+        GPtrArray *result = g_ptr_array_new ();
+        lcm_channel_matcher_lookup (table->matcher, channel, result);
+        matched = result->len > 0;
+        g_ptr_array_free (result, TRUE);
+        if (g_hash_table_size (table->cache) >= INTEREST_CACHE_MAX)
+            g_hash_table_remove_all (table->cache);
+        g_hash_table_insert (table->cache, strdup (channel),
+                GINT_TO_POINTER (1 + matched));
+    }
+    g_static_mutex_unlock (&table->lock);
+    return matched;
+}
+
+int
+lcm_interest_table_has_subscribers (lcm_interest_table_t *table,
+        const char *channel, int interval_ms)
+{
+    if (lcm_clock_monotonic_us () <
+            table->created_us + (int64_t) interval_ms * 1000)
+        return -1;
+    return lcm_interest_table_match (table, channel) ? 1 : 0;
+}
+
+int
+lcm_interest_table_num_nodes (lcm_interest_table_t *table)
+{
+    g_static_mutex_lock (&table->lock);
+    int n = g_hash_table_size (table->nodes);
+    g_static_mutex_unlock (&table->lock);
+    return n;
+}
+
+void *
+lcm_interest_encode (int64_t node_id, int interval_ms, GPtrArray *patterns,
+        int *size)
+{
+    lcm_interest_t msg;
+    msg.utime = lcm_clock_realtime_us ();
+    msg.node_id = node_id;
+    msg.interval_ms = interval_ms;
+    msg.num_patterns = patterns->len;
+    msg.patterns = (char **) patterns->pdata;
+
+    *size = lcm_interest_t_encoded_size (&msg);
+    void *buf = malloc (*size);
+    lcm_interest_t_encode (buf, 0, *size, &msg);
+    return buf;
+}
+
+int64_t
+lcm_interest_new_node_id (void)
+{
+    return (int64_t) (((uint64_t) g_random_int () << 32) | g_random_int ());
+}
@@ -0,0 +1,85 @@
+#ifndef __lcm_interest_h__
+#define __lcm_interest_h__
+
+#include <stdint.h>
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Subscriber interest.  LCM instances that take part announce the channel
+ * patterns they subscribe to with lcm_interest_t messages on
+ * LCM_INTEREST_CHANNEL: every interval_ms milliseconds, and whenever their
+ * subscriptions change.  An interest table collects the announcements that
+ * the others make, so that a publisher can tell whether anybody would
+ * receive a channel before sending it.
+ */
+
+#define LCM_INTEREST_CHANNEL "#!lcm_interest"
+#define LCM_INTEREST_DEFAULT_INTERVAL_MS 1000
+
+// an instance is forgotten after this many of its intervals without an
+// announcement
+#define LCM_INTEREST_EXPIRY_INTERVALS 3
+
+typedef struct _lcm_interest_table lcm_interest_table_t;
+
+/*
+ * Creates an empty table.  The announcements of @self_id, the node ID of the
+ * instance that owns the table, are ignored.
+ */
+lcm_interest_table_t * lcm_interest_table_new (int64_t self_id);
+void lcm_interest_table_free (lcm_interest_table_t *table);
+
+/*
+ * Records the encoded lcm_interest_t in @data, received at @now_us on the
+ * monotonic clock, in place of what its instance announced before.  Returns
+ * 1 if the instance was not known, 0 if it was, and -1 if the message could
+ * not be decoded or is the table's own.
+ */
+int lcm_interest_table_update (lcm_interest_table_t *table, const void *data,
+        int size, int64_t now_us);
+
+/*
+ * Forgets the instances that have not been heard from for
+ * LCM_INTEREST_EXPIRY_INTERVALS of their intervals.
+ */
+void lcm_interest_table_expire (lcm_interest_table_t *table, int64_t now_us);
+
+/*
+ * Returns nonzero if a known instance subscribes to @channel.  The answers
+ * are cached until the announcements change, so that this is one hash
+ * lookup per call.  Can be called from any thread.
+ */
+int lcm_interest_table_match (lcm_interest_table_t *table,
+        const char *channel);
+
+/*
+ * Like lcm_interest_table_match(), for the has_subscribers entry of a
+ * provider: returns -1 while the table has existed for less than
+ * @interval_ms, the announcement interval, because it may not have heard
+ * from everyone yet.
+ */
+int lcm_interest_table_has_subscribers (lcm_interest_table_t *table,
+        const char *channel, int interval_ms);
+
+/* The number of instances known. */
+int lcm_interest_table_num_nodes (lcm_interest_table_t *table);
+
+/*
+ * Encodes the announcement of instance @node_id, which subscribes to the
+ * @patterns (char*), into a buffer to free() of *size bytes.
+ */
+void * lcm_interest_encode (int64_t node_id, int interval_ms,
+        GPtrArray *patterns, int *size);
+
+/* A random node ID for lcm_interest_encode(). */
+int64_t lcm_interest_new_node_id (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,8 +21,87 @@
 #define lcm_internal_pipe_read read
 #define lcm_internal_pipe_close close
 #define lcm_internal_pipe_create pipe
+#include <fcntl.h>
+#include <stdint.h>
 #endif
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#define LCM_USE_EVENTFD
+#endif
+
+/*
+ * Message-ready notification used by the providers.  A provider signals on the
+ * empty -> non-empty transition of its queue, so that at most one token is
+ * pending, and the descriptor is readable exactly while messages are queued.
+ * handle() need not consume the token while messages remain: the busy
+ * providers only wait when their queue is empty, and take the token back when
+ * they dequeue the last message, so that handling a burst costs no system
+ * calls in between.  notify[0] is the descriptor to poll on and is what a
+ * provider's get_fileno() returns.
+ *
+ * On Linux this is a single counting eventfd, which costs one descriptor
+ * instead of two and keeps no data in a kernel pipe buffer.  Elsewhere it is
+ * a pipe with a non-blocking write end.
+ */
+static inline int
+lcm_internal_notify_create (int notify[2])
+{
+#ifdef LCM_USE_EVENTFD
+    int fd = eventfd (0, 0);
+    if (fd < 0)
+        return -1;
+    notify[0] = notify[1] = fd;
+    return 0;
+#else
+    if (0 != lcm_internal_pipe_create (notify))
+        return -1;
+#ifndef WIN32
+    fcntl (notify[1], F_SETFL, O_NONBLOCK);
+#endif
+    return 0;
+#endif
+}
+
+static inline int
+lcm_internal_notify_signal (int notify[2])
+{
+#ifdef LCM_USE_EVENTFD
+    uint64_t one = 1;
+    return write (notify[1], &one, sizeof (one)) == sizeof (one) ? 0 : -1;
+#else
+    return lcm_internal_pipe_write (notify[1], "+", 1) == 1 ? 0 : -1;
+#endif
+}
+
+/*
+ * Blocks until a notification is available and consumes it.  The eventfd is
+ * reset to zero, whatever its count.  Returns 1 on success, 0 if the
+ * notification channel was closed, and -1 on error.
+ */
+static inline int
+lcm_internal_notify_wait (int notify[2])
+{
+#ifdef LCM_USE_EVENTFD
+    uint64_t count;
+    int status = read (notify[0], &count, sizeof (count));
+    return status == sizeof (count) ? 1 : status;
+#else
+    char ch;
+    return lcm_internal_pipe_read (notify[0], &ch, 1);
+#endif
+}
+
+static inline void
+lcm_internal_notify_close (int notify[2])
+{
+    if (notify[0] >= 0)
+        lcm_internal_pipe_close (notify[0]);
+    if (notify[1] >= 0 && notify[1] != notify[0])
+        lcm_internal_pipe_close (notify[1]);
+    notify[0] = notify[1] = -1;
+}
+
 typedef struct _lcm_provider_t lcm_provider_t;
 typedef struct _lcm_provider_info_t lcm_provider_info_t;
 typedef struct _lcm_provider_vtable_t lcm_provider_vtable_t;
@@ -42,12 +121,64 @@ struct _lcm_provider_vtable_t {
             unsigned int);
     int (*handle)(lcm_provider_t *);
     int (*get_fileno)(lcm_provider_t *);
+    // optional.  Dispatches up to max_msgs messages that are already queued,
+    // blocking only until the first one is available.  Returns the number of
+    // messages handled, or -1 on error.
+    int (*handle_batch)(lcm_provider_t *, int max_msgs);
+    // optional.  Fills in the receive statistics, and returns 0 on success.
+    int (*get_stats)(lcm_provider_t *, lcm_transport_stats_t *stats);
+    // optional.  Spins for a bounded time, at most timeout_millis, until a
+    // message can be handled without blocking.  Returns nonzero if one can.
+    int (*busy_wait)(lcm_provider_t *, int timeout_millis);
+    // optional.  Like publish, for data that lies in block, a malloc()ed
+    // buffer that the provider may take over instead of copying data.
+    // Returns 1 if it did, in which case it frees block, 0 if it copied
+    // data, or -1 on error.
+    int (*publish_owned)(lcm_provider_t *, const char *channel, void *block,
+            const void *data, unsigned int datalen);
+    // optional.  Publishes a message of datalen bytes that is written in
+    // pieces by publish_stream_write, and finished or abandoned by
+    // publish_stream_end.  publish_stream_begin returns NULL if the message
+    // can not be streamed, in which case it is buffered and published as
+    // usual.  The pieces written add up to datalen bytes exactly.
+    void * (*publish_stream_begin)(lcm_provider_t *, const char *channel,
+            unsigned int datalen);
+    int (*publish_stream_write)(lcm_provider_t *, void *stream,
+            const void *data, unsigned int len);
+    int (*publish_stream_end)(lcm_provider_t *, void *stream, int cancel);
+    // optional.  Returns 1 if another instance is known to subscribe to
+    // channel, 0 if none does, or -1 if the provider can not tell.
+    int (*has_subscribers)(lcm_provider_t *, const char *channel);
 };
 
 int
 lcm_parse_url (const char * url, char ** provider, char ** target,
         GHashTable * args);
 
+typedef struct _lcm_recv_buf_owner lcm_recv_buf_owner_t;
+typedef struct _lcm_recv_buf_loan lcm_recv_buf_loan_t;
+
+/**
+ * Lets a provider lend the storage of a received message to
+ * lcm_recv_buf_retain().  The provider points lcm_recv_buf_t::owner at one
+ * of these while dispatching.  If @c block is set, it must be a malloc()ed
+ * block holding the payload, which a handler may take over instead of having
+ * the payload copied.  Once dispatch is done, the provider calls
+ * lcm_recv_buf_owner_finish() and frees @c block itself only if it was not
+ * taken.
+ */
+struct _lcm_recv_buf_owner {
+    void *block;
+    lcm_recv_buf_loan_t *loan;  // set once block has been taken over
+};
+
+/**
+ * Returns 1 if a handler took over @p owner's block, in which case the
+ * provider must not free it, or 0 otherwise.
+ */
+int
+lcm_recv_buf_owner_finish (lcm_recv_buf_owner_t *owner);
+
 /**
  * Try to enqueue a message.  This may fail if there are no subscribers, or if
  * all the subscribers' queues are full.  The actual message contents are not
@@ -59,7 +190,108 @@ lcm_try_enqueue_message (lcm_t * lcm, const char * channel);
 int
 lcm_has_handlers (lcm_t * lcm, const char * channel);
 
+/**
+ * For providers that queue a message when it is published, but only call
+ * lcm_try_enqueue_message() for it when it comes up for dispatch, such as
+ * memq.  Counts the message as queued for the conflating subscriptions to
+ * @p channel, so that they drop it when a newer one is already queued behind
+ * it.  Every message that this is called for must then be passed to
+ * lcm_try_enqueue_message().
+ */
+void
+lcm_defer_enqueue_message (lcm_t * lcm, const char * channel);
+
+/**
+ * Returns the ID of @p channel, a small integer that is the same for every
+ * %LCM instance of the process and for as long as it runs, or -1 if too many
+ * channels have been seen already.  A provider that looks it up once per
+ * message, and passes it to the _by_id variants of lcm_try_enqueue_message(),
+ * lcm_has_handlers() and lcm_dispatch_handlers(), has them find the
+ * subscriptions of the channel in an array instead of hashing its name each
+ * time.  Those take @p channel too, and a @p channel_id of -1 for one that
+ * has no ID.
+ */
+int
+lcm_internal_channel_id (const char *channel);
+
+int
+lcm_try_enqueue_message_by_id (lcm_t * lcm, const char * channel,
+        int channel_id);
+
+int
+lcm_has_handlers_by_id (lcm_t * lcm, const char * channel, int channel_id);
+
+/**
+ * For providers that receive a message in pieces.  Returns 1 if every
+ * subscription to @p channel would skip a message arriving now because of its
+ * max rate, and counts it as decimated for each of them, so that the provider
+ * can drop it before it reassembles it.  Otherwise changes nothing and returns
+ * 0, and the provider passes the message to lcm_try_enqueue_message() once
+ * it has all of it.
+ */
+int
+lcm_decimate_message_by_id (lcm_t * lcm, const char * channel,
+        int channel_id);
+
+/**
+ * Returns the highest lcm_subscription_set_priority() of the subscriptions
+ * to @p channel, or 0 if it has none, for providers that keep the messages
+ * of different priorities apart.
+ */
+int
+lcm_channel_priority_by_id (lcm_t * lcm, const char * channel,
+        int channel_id);
+
+/**
+ * Returns 1 if any subscriber to @p channel has as many messages queued as
+ * its queue capacity, so that a provider which can hold messages back, like
+ * the file provider, can wait before enqueueing another one instead of having
+ * it dropped.  Conflating subscriptions and those without a capacity are
+ * never backlogged.
+ */
+int
+lcm_handlers_backlogged (lcm_t * lcm, const char * channel);
+
 int
 lcm_dispatch_handlers (lcm_t * lcm, lcm_recv_buf_t * buf, const char *channel);
 
+int
+lcm_dispatch_handlers_by_id (lcm_t * lcm, lcm_recv_buf_t * buf,
+        const char *channel, int channel_id);
+
+/**
+ * Has @p tap called once for every message that lcm_dispatch_handlers()
+ * passes to the subscriptions of @p lcm, before any of them, however many
+ * match.  The shared provider uses this to pass each message on to its
+ * instances once.  Must be set before messages arrive.
+ */
+void
+lcm_internal_set_dispatch_tap (lcm_t * lcm, lcm_msg_handler_t tap,
+        void *user);
+
+/**
+ * Returns 0 if @p cpus and @p sched, either of which may be NULL, are valid
+ * arguments to lcm_set_thread_scheduling() on this platform, and -1
+ * otherwise.
+ */
+int
+lcm_internal_check_thread_scheduling (const char *cpus, const char *sched);
+
+/**
+ * Called first by each thread that a provider starts.  Applies @p cpus and
+ * @p sched, either of which may be NULL, and then calls the application's
+ * thread hook with @p name.
+ */
+void
+lcm_internal_thread_init (const char *name, const char *cpus,
+        const char *sched);
+
+/**
+ * Records the state of the provider's self test, one of the
+ * LCM_SELF_TEST_* values, and calls the application's self-test handler if
+ * the test finished.  Can be called from any thread.
+ */
+void
+lcm_internal_set_self_test_status (lcm_t *lcm, int status);
+
 #endif
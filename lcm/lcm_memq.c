@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <assert.h>
 #ifndef WIN32
@@ -10,78 +11,225 @@
 #endif
 
 #include "lcm_internal.h"
+#include "lcm_clock.h"
 #include "dbg.h"
 
+/*
+ * Messages are kept in nodes that are recycled through a free list, so that
+ * in steady state publishing allocates nothing: a node keeps its payload
+ * buffer when it is reused, and the channel names are interned once.
+ *
+ * Publishers append nodes to an intrusive multi-producer, single-consumer
+ * queue (D. Vyukov's) without taking a lock, and lcm_handle() pops them.
+ * The number of queued messages is counted separately, so that the notify
+ * pipe only carries a byte while the queue is not empty.
+ *
+ * With zero_copy=1, lcm_publish_commit() hands the reserved buffer to the
+ * queue instead of having it copied into a node.
+ */
+
+// nodes and buffers beyond these are freed instead of recycled
+#define MEMQ_MAX_POOLED_MSGS 256
+#define MEMQ_MAX_POOLED_BUF_SIZE (256 * 1024)
+
+typedef struct _memq_msg memq_msg_t;
+struct _memq_msg {
+    memq_msg_t* next;       // in the queue or the free list
+    const char* channel;    // interned, owned by lcm_memq_t::channels
+    lcm_recv_buf_t rbuf;
+    void* buf;              // recycled payload storage
+    unsigned int capacity;  // bytes allocated for buf
+    void* block;            // storage taken over with zero_copy, if set
+};
+
 typedef struct _lcm_provider_t lcm_memq_t;
 struct _lcm_provider_t {
     lcm_t* lcm;
-    GQueue* queue;
-    GMutex* mutex;
+    int zero_copy;
+
+    // the queue.  head and stub belong to the thread in lcm_handle()
+    memq_msg_t* tail;
+    memq_msg_t* head;
+    memq_msg_t stub;
+    int num_queued;  // atomic access
     int notify_pipe[2];
-};
 
-typedef struct _memq_msg memq_msg_t;
-struct _memq_msg {
-    char* channel;
-    lcm_recv_buf_t rbuf;
+    // recycled nodes.  Any thread may push onto free_msgs without a lock,
+    // but popping takes pool_lock, which also guards channels.
+    GStaticMutex pool_lock;
+    memq_msg_t* free_msgs;
+    int num_free_msgs;  // atomic access
+    GHashTable* channels;
 };
 
+static void
+memq_queue_push(lcm_memq_t* self, memq_msg_t* msg)
+{
+    msg->next = NULL;
+    memq_msg_t* prev;
+    do {
+        prev = (memq_msg_t*) g_atomic_pointer_get(&self->tail);
+    } while (!g_atomic_pointer_compare_and_exchange(&self->tail, prev, msg));
+    // Until this store, the consumer cannot reach msg or any message pushed
+    // after it
+    g_atomic_pointer_set(&prev->next, msg);
+}
+
+// Returns NULL when the queue is empty, and also while the oldest message is
+// still being pushed.
 static memq_msg_t*
-memq_msg_new(lcm_t* lcm, const char* channel, const void* data, int data_size, int64_t utime) {
-    memq_msg_t* msg = (memq_msg_t*)malloc(sizeof(memq_msg_t));
-    msg->rbuf.data = malloc(data_size);
-    msg->rbuf.data_size = data_size;
-    memcpy(msg->rbuf.data, data, data_size);
-    msg->rbuf.recv_utime = utime;
-    msg->rbuf.lcm = lcm;
-    msg->channel = g_strdup(channel);
+memq_queue_pop(lcm_memq_t* self)
+{
+    memq_msg_t* head = self->head;
+    memq_msg_t* next = (memq_msg_t*) g_atomic_pointer_get(&head->next);
+    if (head == &self->stub) {
+        if (!next)
+            return NULL;
+        self->head = next;
+        head = next;
+        next = (memq_msg_t*) g_atomic_pointer_get(&head->next);
+    }
+    if (next) {
+        self->head = next;
+        return head;
+    }
+    if (head != g_atomic_pointer_get(&self->tail))
+        return NULL;
+    // head is the last message, so the stub takes its place at the end
+    memq_queue_push(self, &self->stub);
+    next = (memq_msg_t*) g_atomic_pointer_get(&head->next);
+    if (next) {
+        self->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+static void
+memq_msg_release(lcm_memq_t* self, memq_msg_t* msg)
+{
+    free(msg->block);
+    msg->block = NULL;
+    if (msg->capacity > MEMQ_MAX_POOLED_BUF_SIZE) {
+        free(msg->buf);
+        msg->buf = NULL;
+        msg->capacity = 0;
+    }
+    if (g_atomic_int_get(&self->num_free_msgs) >= MEMQ_MAX_POOLED_MSGS) {
+        free(msg->buf);
+        free(msg);
+        return;
+    }
+    g_atomic_int_inc(&self->num_free_msgs);
+    memq_msg_t* top;
+    do {
+        top = (memq_msg_t*) g_atomic_pointer_get(&self->free_msgs);
+        msg->next = top;
+    } while (!g_atomic_pointer_compare_and_exchange(&self->free_msgs, top,
+                msg));
+}
+
+// Takes a node from the free list, or allocates one, and points it at the
+// interned copy of channel.  Returns NULL on failure.
+static memq_msg_t*
+memq_msg_get(lcm_memq_t* self, const char* channel)
+{
+    g_static_mutex_lock(&self->pool_lock);
+    // Only one thread pops at a time, so a node cannot leave and come back
+    // to the top of the list between the reads and the exchange below.
+    memq_msg_t* msg;
+    do {
+        msg = (memq_msg_t*) g_atomic_pointer_get(&self->free_msgs);
+    } while (msg && !g_atomic_pointer_compare_and_exchange(&self->free_msgs,
+                msg, msg->next));
+    if (msg)
+        g_atomic_int_add(&self->num_free_msgs, -1);
+
+    char* interned = (char*) g_hash_table_lookup(self->channels, channel);
+    if (!interned) {
+        interned = g_strdup(channel);
+        g_hash_table_insert(self->channels, interned, interned);
+    }
+    g_static_mutex_unlock(&self->pool_lock);
+
+    if (!msg) {
+        msg = (memq_msg_t*) calloc(1, sizeof(memq_msg_t));
+        if (!msg)
+            return NULL;
+    }
+    msg->channel = interned;
     return msg;
 }
 
 static void
-memq_msg_destroy(memq_msg_t* msg) {
-    free(msg->rbuf.data);
-    g_free(msg->channel);
-    memset(msg, 0, sizeof(memq_msg_t));
-    free(msg);
+memq_enqueue(lcm_memq_t* self, memq_msg_t* msg, void* data,
+        unsigned int datalen)
+{
+    int64_t utime = lcm_clock_realtime_us();
+    msg->rbuf.data = data;
+    msg->rbuf.data_size = datalen;
+    msg->rbuf.recv_utime = utime;
+    msg->rbuf.recv_time_ns = utime * 1000;
+    msg->rbuf.lcm = self->lcm;
+    msg->rbuf.owner = NULL;
+
+    // lcm_memq_handle_batch() calls lcm_try_enqueue_message() for it
+    lcm_defer_enqueue_message(self->lcm, msg->channel);
+    memq_queue_push(self, msg);
+    if (g_atomic_int_exchange_and_add(&self->num_queued, 1) == 0) {
+        if(lcm_internal_notify_signal(self->notify_pipe) < 0) {
+            perror(__FILE__ " - write to notify pipe (lcm_memq_publish)");
+        }
+    }
 }
 
 static void
 lcm_memq_destroy (lcm_memq_t *self)
 {
     dbg(DBG_LCM, "destroying LCM memq provider context\n");
-    if(self->notify_pipe[0] >= 0) lcm_internal_pipe_close(self->notify_pipe[0]);
-    if(self->notify_pipe[1] >= 0) lcm_internal_pipe_close(self->notify_pipe[1]);
+    lcm_internal_notify_close(self->notify_pipe);
 
-    while (!g_queue_is_empty(self->queue)) {
-        memq_msg_t* msg = (memq_msg_t*) g_queue_pop_head(self->queue);
-        memq_msg_destroy(msg);
+    memq_msg_t* msg;
+    while ((msg = memq_queue_pop(self))) {
+        free(msg->block);
+        free(msg->buf);
+        free(msg);
+    }
+    for (msg = self->free_msgs; msg; ) {
+        memq_msg_t* next = msg->next;
+        free(msg->buf);
+        free(msg);
+        msg = next;
     }
-    g_queue_free(self->queue);
-    g_mutex_free(self->mutex);
+    g_hash_table_destroy(self->channels);
+    g_static_mutex_free(&self->pool_lock);
     memset(self, 0, sizeof(lcm_memq_t));
     free(self);
 }
 
-static int64_t
-timestamp_now (void)
-{
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
-}
-
 static lcm_provider_t*
 lcm_memq_create (lcm_t* parent, const char* target, const GHashTable* args)
 {
     lcm_memq_t * self = (lcm_memq_t*) calloc(1, sizeof(lcm_memq_t));
     self->lcm = parent;
-    self->queue = g_queue_new();
-    self->mutex = g_mutex_new();
+    self->tail = &self->stub;
+    self->head = &self->stub;
+    g_static_mutex_init(&self->pool_lock);
+    self->channels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+            NULL);
 
     dbg(DBG_LCM, "Initializing LCM memq provider context...\n");
 
-    if(lcm_internal_pipe_create(self->notify_pipe) != 0) {
+    const char* zero_copy = (const char*) g_hash_table_lookup(
+            (GHashTable*) args, "zero_copy");
+    if (zero_copy) {
+        char* endptr = NULL;
+        self->zero_copy = strtol(zero_copy, &endptr, 0);
+        if (endptr == zero_copy || *endptr)
+            fprintf(stderr, "Warning: Invalid value for zero_copy\n");
+    }
+
+    if(lcm_internal_notify_create(self->notify_pipe) != 0) {
         perror(__FILE__ " - pipe (notify)");
         lcm_memq_destroy (self);
         return NULL;
@@ -96,36 +244,70 @@ lcm_memq_get_fileno(lcm_memq_t* self)
 }
 
 static int
-lcm_memq_handle(lcm_memq_t* self)
+lcm_memq_handle_batch(lcm_memq_t* self, int max_msgs)
 {
-    char ch;
-    int status = lcm_internal_pipe_read(self->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf(stderr,
-            "Error: lcm_memq_handle read 0 bytes from notify_pipe\n");
-        return -1;
+    // the notification stays in place while messages are queued, and is
+    // only consumed to wait for the first one or with the last one
+    int consumed = !g_atomic_int_get(&self->num_queued);
+    if (consumed) {
+        int status = lcm_internal_notify_wait(self->notify_pipe);
+        if (status == 0) {
+            fprintf(stderr,
+                "Error: lcm_memq_handle read 0 bytes from notify_pipe\n");
+            return -1;
+        }
     }
 
-    g_mutex_lock(self->mutex);
-    memq_msg_t* msg = (memq_msg_t*)g_queue_pop_head(self->queue);
-    if (!g_queue_is_empty(self->queue)) {
-        if(lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write to notify pipe (lcm_memq_handle)");
-        }
+    int num_queued = g_atomic_int_get(&self->num_queued);
+    int num_msgs = MIN(max_msgs, num_queued);
+    if (!consumed && num_msgs == num_queued) {
+        // taking the last one.  A publisher that queues another meanwhile
+        // sees a nonzero count and does not signal, so we do below.
+        lcm_internal_notify_wait(self->notify_pipe);
+        consumed = 1;
     }
-    g_mutex_unlock(self->mutex);
+    for (int i = 0; i < num_msgs; i++) {
+        memq_msg_t* msg;
+        // a message that is counted is at most a few instructions away
+        // from being reachable
+        while (!(msg = memq_queue_pop(self)))
+            g_thread_yield();
 
-    dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
-        msg->channel, msg->rbuf.data_size);
+        dbg(DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
+            msg->channel, msg->rbuf.data_size);
 
-    if (lcm_try_enqueue_message(self->lcm, msg->channel)) {
-      lcm_dispatch_handlers(self->lcm, &msg->rbuf, msg->channel);
+        void* storage = msg->block ? msg->block : msg->buf;
+        lcm_recv_buf_owner_t owner = { storage, NULL };
+        msg->rbuf.owner = &owner;
+        if (lcm_try_enqueue_message(self->lcm, msg->channel)) {
+          lcm_dispatch_handlers(self->lcm, &msg->rbuf, msg->channel);
+        }
+        if (lcm_recv_buf_owner_finish(&owner)) {
+            if (msg->block) {
+                msg->block = NULL;
+            } else {
+                msg->buf = NULL;
+                msg->capacity = 0;
+            }
+        }
+        memq_msg_release(self, msg);
     }
 
-    memq_msg_destroy(msg);
-    return 0;
+    if (g_atomic_int_exchange_and_add(&self->num_queued, -num_msgs) >
+            num_msgs && consumed) {
+        if(lcm_internal_notify_signal(self->notify_pipe) < 0) {
+            perror(__FILE__ " - write to notify pipe (lcm_memq_handle)");
+        }
+    }
+    return num_msgs;
 }
 
+static int
+lcm_memq_handle(lcm_memq_t* self)
+{
+    int status = lcm_memq_handle_batch(self, 1);
+    return status < 0 ? status : 0;
+}
 
 static int
 lcm_memq_publish (lcm_memq_t *self, const char *channel, const void *data,
@@ -138,21 +320,41 @@ lcm_memq_publish (lcm_memq_t *self, const char *channel, const void *data,
       return 0;
     }
     dbg(DBG_LCM, "Publishing to [%s] message size [%d]\n", channel, datalen);
-    memq_msg_t* msg =
-      memq_msg_new(self->lcm, channel, data, datalen, timestamp_now());
-
-    g_mutex_lock(self->mutex);
-    int was_empty = g_queue_is_empty(self->queue);
-    g_queue_push_tail(self->queue, msg);
-    if (was_empty) {
-        if(lcm_internal_pipe_write(self->notify_pipe[1], "+", 1) < 0) {
-            perror(__FILE__ " - write to notify pipe (lcm_memq_publish)");
+
+    memq_msg_t* msg = memq_msg_get(self, channel);
+    if (!msg)
+        return -1;
+    if (msg->capacity < datalen || !msg->buf) {
+        void* buf = realloc(msg->buf, MAX(datalen, 1));
+        if (!buf) {
+            memq_msg_release(self, msg);
+            return -1;
         }
+        msg->buf = buf;
+        msg->capacity = MAX(datalen, 1);
     }
-    g_mutex_unlock(self->mutex);
+    memcpy(msg->buf, data, datalen);
+    memq_enqueue(self, msg, msg->buf, datalen);
     return 0;
 }
 
+static int
+lcm_memq_publish_owned (lcm_memq_t *self, const char *channel, void *block,
+        const void *data, unsigned int datalen)
+{
+    if (!self->zero_copy || !lcm_has_handlers(self->lcm, channel))
+        return lcm_memq_publish(self, channel, data, datalen);
+    dbg(DBG_LCM, "Publishing to [%s] message size [%d] without copying\n",
+        channel, datalen);
+
+    memq_msg_t* msg = memq_msg_get(self, channel);
+    if (!msg)
+        return -1;
+    msg->block = block;
+    memq_enqueue(self, msg, (void*) data, datalen);
+    return 1;
+}
+
 #ifdef WIN32
 static lcm_provider_vtable_t memq_vtable;
 #else
@@ -163,7 +365,9 @@ static lcm_provider_vtable_t memq_vtable = {
     .unsubscribe = NULL,
     .publish     = lcm_memq_publish,
     .handle      = lcm_memq_handle,
-    .get_fileno  = lcm_memq_get_fileno
+    .get_fileno  = lcm_memq_get_fileno,
+    .handle_batch = lcm_memq_handle_batch,
+    .publish_owned = lcm_memq_publish_owned
 };
 #endif
 static lcm_provider_info_t memq_info;
@@ -179,6 +383,8 @@ lcm_memq_provider_init (GPtrArray * providers)
     memq_vtable.publish     = lcm_memq_publish;
     memq_vtable.handle      = lcm_memq_handle;
     memq_vtable.get_fileno  = lcm_memq_get_fileno;
+    memq_vtable.handle_batch = lcm_memq_handle_batch;
+    memq_vtable.publish_owned = lcm_memq_publish_owned;
 #endif
     memq_info.name = "memq";
     memq_info.vtable = &memq_vtable;
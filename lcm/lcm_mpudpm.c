@@ -17,34 +17,56 @@
 #include <sys/select.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+// wait on the receive sockets with a persistent epoll set, rather than
+// building an fd_set for select() every time
+#define USE_EPOLL
+// the most socket events handled per epoll_wait() call
+#define MAX_EPOLL_EVENTS 64
+#endif
+
 #include <glib.h>
 
 #include "lcm.h"
 #include "lcm_internal.h"
 #include "dbg.h"
-#include "ringbuffer.h"
 #include "udpm_util.h"
+#include "channel_matcher.h"
 
 #include "lcmtypes/channel_port_map_update_t.h"
+#include "lcmtypes/channel_port_assign_t.h"
+#include "lcmtypes/channel_port_map_delta_t.h"
 
 // Lets reserve channels starting with #! for internal use
 #define RESERVED_CHANNEL_PREFIX "#!"
 // The number of LCM channels that we use internally for stuff.
 // Updating the channel to port map efficiently depends on this number
 // being correct
-#define NUM_INTERNAL_CHANNELS 3
+#define NUM_INTERNAL_CHANNELS 5
 #define SELF_TEST_CHANNEL RESERVED_CHANNEL_PREFIX "mpudpm_SELF_TEST"
 #define CHANNEL_TO_PORT_MAP_UPDATE_CHANNEL \
     RESERVED_CHANNEL_PREFIX "mpudpm_CH2PRT_UPD"
 #define CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL \
     RESERVED_CHANNEL_PREFIX "mpudpm_CH2PRT_REQ"
-
-// regex to check with the channel is a string literal
-#define REGEX_FINDER_RE "[^\\\\][\\.\\[\\{\\(\\)\\\\\\*\\+\\?\\|\\^\\$]"
+#define CHANNEL_TO_PORT_ASSIGN_CHANNEL \
+    RESERVED_CHANNEL_PREFIX "mpudpm_CH2PRT_ASG"
+#define CHANNEL_TO_PORT_MAP_DELTA_CHANNEL \
+    RESERVED_CHANNEL_PREFIX "mpudpm_CH2PRT_DLT"
 
 // broadcast channel to port mapping this frequently
 #define CHANNEL_TO_PORT_MAP_UPDATE_NOMINAL_PERIOD 5e6
 
+// ask for the full channel to port mapping at most this frequently when our
+// map does not match someone else's
+#define MIN_RESYNC_PERIOD 1e6
+
+// with port_policy=load, channels published slower than this many bytes per
+// second are never moved to another port
+#define MIN_MOVE_BYTES_PER_SEC 100000
+
+
+typedef struct _mpudpm_rx_worker_t mpudpm_rx_worker_t;
 
 /**
  * mpudpm_socket_t:
@@ -52,28 +74,50 @@
  * @port                multicast port
  * @num_subscribers     the number of subscribers to enable closing this socket
  *                             when it's no longer in use
+ * @worker              the read thread that receives on this socket
  */
 typedef struct _mpudpm_socket_t {
     SOCKET fd;
     uint16_t port;
     int num_subscribers;
+    mpudpm_rx_worker_t *worker;
 } mpudpm_socket_t;
 
 
 /**
  * mpudpm_subscriber_t:
  * @channel_string  The channel string this subscriber is subscribed to
- * @regex           Compiled regex to match explicit channels to this subscriber
+ * @pattern         Compiled channel_string, to match channels to this
+ *                  subscriber
  * @sockets         The list of sockets that are used for this subscription
  * @channel_set     Set of active channels that the channel_regex matches
  */
 typedef struct _mpudpm_subscriber_t {
     char * channel_string;
-    GRegex * regex;   // compiled regex for the channel_string (if it's a regex)
+    lcm_channel_pattern_t * pattern;
     GSList* sockets;  //type: mpudpm_socket_t
-    GHashTable* channel_set; //GHashTable used as a set (value points to key)
+    // channels that this subscriber listens to, mapped to the port that it
+    // listens on for each: char* -> uint16_t (via GUINT_TO_POINTER macro)
+    GHashTable* channel_set;
 } mpudpm_subscriber_t;
 
+/**
+ * mpudpm_channel_load_t:
+ * @version         incremented every time the channel is moved to another port
+ * @tx_bytes        bytes this process published on the channel since the
+ *                  rates were last computed
+ * @tx_rate         bytes per second this process publishes on the channel
+ * @remote_rate     bytes per second another process last reported for it
+ * @remote_utime    when remote_rate was reported
+ */
+typedef struct _mpudpm_channel_load_t {
+    int32_t version;
+    int64_t tx_bytes;
+    int64_t tx_rate;
+    int64_t remote_rate;
+    int64_t remote_utime;
+} mpudpm_channel_load_t;
+
 /**
  * mpudpm_params_t:
  * @mc_addr:              multicast address
@@ -85,6 +129,23 @@ typedef struct _mpudpm_subscriber_t {
  *                        don't use > 1.  that's just rude.
  * @recv_buf_size:        requested size of the kernel receive buffer, set with
  *                        SO_RCVBUF.  0 indicates to use the default settings.
+ * @recv_pool_size:       cap on the memory holding received packets.
+ * @max_rate_mbps:        if nonzero, fragments of large messages are
+ *                        transmitted no faster than this many megabits per
+ *                        second.
+ * @burst_kb:             kilobytes of fragments that may be sent back to
+ *                        back when max_rate_mbps is set.
+ * @mtu:                  if nonzero, published datagrams are no larger than
+ *                        this many bytes with their IP and UDP headers.
+ * @rx_cpu, rx_sched:     CPUs and scheduling policy of the read thread, or
+ *                        NULL to leave them alone.
+ * @no_self_test:         if nonzero, receiving starts without a self test.
+ * @port_policy_load:     if nonzero, heavily used channels are moved to
+ *                        lightly loaded ports.
+ * @recv_threads:         number of read threads that the ports are divided
+ *                        between.
+ * @faults:               datagrams to drop, duplicate and reorder when
+ *                        transmitting, for testing.
  *
  */
 typedef struct _mpudpm_params_t mpudpm_params_t;
@@ -94,9 +155,61 @@ struct _mpudpm_params_t {
     uint16_t num_mc_ports;
     uint8_t mc_ttl; 
     int recv_buf_size;
+    int recv_pool_size;
+    double max_rate_mbps;
+    int burst_kb;
+    int mtu;
+    char *rx_cpu;
+    char *rx_sched;
+    int no_self_test;
+    int port_policy_load;
+    int recv_threads;
+    lcm_fault_params_t faults;
 };
 
 typedef struct _lcm_provider_t lcm_mpudpm_t;
+
+/**
+ * mpudpm_rx_worker_t:
+ *
+ * A read thread, and the state it needs to receive on its share of the
+ * receive sockets.  Each port belongs to one worker, and all the fragments
+ * of a message are sent to the same port, so every worker reassembles its
+ * messages on its own.
+ */
+struct _mpudpm_rx_worker_t {
+    lcm_mpudpm_t *lcm;
+    int index;
+
+    GThread *read_thread;
+    int thread_msg_pipe[2];     // pipe to notify read thread when to cancel a
+    // select or terminate
+#ifdef USE_EPOLL
+    int epoll_fd;               // thread_msg_pipe[0] and the worker's sockets
+#endif
+
+    /* flag for whether the worker's sockets have changed since the read
+     * thread last started waiting for packets, or with epoll, since it last
+     * looked at the sockets it waited for.
+     * must be protected by the receive_lock.*/
+    int8_t recv_sockets_changed;
+    /* sockets removed while the read thread may still be receiving on them
+     * without the receive_lock.  The read thread closes them once it is
+     * done with them.  must be protected by the receive_lock. */
+    GSList* removed_sockets;
+
+    /* only used by the read thread */
+    lcm_frag_buf_store  *frag_bufs;
+
+    /* receive counters, updated by the read thread.  They are copied to
+     * stats_snapshot under stats_lock whenever the thread waits for more
+     * packets. */
+    lcm_transport_stats_t stats;
+    lcm_seq_tracker_t *seq_tracker;
+    GStaticMutex stats_lock;
+    lcm_transport_stats_t stats_snapshot;
+};
+
 struct _lcm_provider_t {
     lcm_t * lcm;
     mpudpm_params_t params;
@@ -114,12 +227,11 @@ struct _lcm_provider_t {
 
     /* list of mpudpm_socket_t structs */
     GSList* recv_sockets;
-    /* flag for whether the subscriptions have changed since they were last
-     * accessed. must be protected by the receive_lock.*/
-    int8_t recv_sockets_changed;
 
     /* list of mpudpm_subscriber_t structs */
     GSList* subscribers;
+    /* index of the subscribers by their pattern */
+    lcm_channel_matcher_t* sub_matcher;
 
     /* Packet structures available for sending or receiving use are
      * stored in the *_empty queues. */
@@ -127,9 +239,9 @@ struct _lcm_provider_t {
     /* Received packets that are filled with data are queued here. */
     lcm_buf_queue_t * inbufs_filled;
 
-    /* Memory for received small packets is taken from a fixed-size ring buffer
-     * so we don't have to do any mallocs */
-    lcm_ringbuf_t * ringbuf;
+    /* Memory for received small packets is taken from a pool with a fixed
+     * cap so we don't have to do any mallocs */
+    lcm_bufpool_t * pool;
 
     /* Indicates whether the receive thread was successfully created */
     int8_t recv_thread_created;
@@ -146,6 +258,8 @@ struct _lcm_provider_t {
 
     /* All traffic gets sent from a single socket */
     SOCKET send_fd;
+    /* the faults injected into the messages published on send_fd, or NULL */
+    lcm_fault_injector_t *faults;
     /* Destination address used for broadcasting coordination messages */
     struct sockaddr_in dest_addr;
 
@@ -153,21 +267,55 @@ struct _lcm_provider_t {
      * type: char* -> uint16_t (via GUINT_TO_POINTER macro)*/
     GHashTable* channel_to_port_map;
 
-    /* Last time the channel_to_port mapping was broadcast by someone */
+    /* Last time the channel_to_port mapping, or a delta showing that it
+     * matches ours, was broadcast by someone */
     int64_t last_mapping_update_utime;
+    /* Last time we broadcast the whole channel_to_port mapping */
+    int64_t last_snapshot_utime;
+    /* Last time we asked everyone to broadcast their whole mapping */
+    int64_t last_resync_utime;
+
+    /* number of channel_port_map_delta_t messages with new channels that we
+     * have broadcast */
+    int32_t map_delta_version;
+    /* number and sum of the hashes of the non-reserved channels in the
+     * channel_to_port_map, to check whether ours matches someone else's */
+    int32_t map_size;
+    uint64_t map_checksum;
+    /* the last delta version that each other process broadcast
+     * type: int64_t* -> int32_t (via GINT_TO_POINTER macro) */
+    GHashTable* peer_delta_versions;
+
+    /* Versions and publish rates of the channels that have been moved or
+     * that are published with port_policy=load
+     * type: char* -> mpudpm_channel_load_t */
+    GHashTable* channel_loads;
+    /* Last time the publish rates of channel_loads were computed */
+    int64_t last_load_utime;
+
+    /* number of subscribers.  Only while there are any, the channels that
+     * are added to, or move in, the channel_to_port_map are kept in
+     * changed_channels (char*) until update_subscription_ports looks at
+     * them */
+    int num_subscribers;
+    GPtrArray* changed_channels;
 
     /* rolling counter of how many messages transmitted */
     uint32_t     msg_seqno;
 
+    /* limits the rate at which fragments are transmitted */
+    lcm_pacer_t  pacer;
+
     /* Use a separate variable for publishers to ease contention */
     int8_t recv_thread_created_tx;
     /* END VARIABLES GUARDED BY transmit_lock
      **************************************************************/
 
-    GThread *read_thread;
-    int notify_pipe[2];         // pipe to notify application when messages arrive
-    int thread_msg_pipe[2];     // pipe to notify read thread when to cancel a
-    // select or terminate
+    int notify_pipe[2];         // notifies application when messages arrive
+
+    /* the read threads, recv_threads of them */
+    mpudpm_rx_worker_t *workers;
+    int num_workers;
 
     /* synchronization variables used only while allocating receive resources
      */
@@ -177,16 +325,9 @@ struct _lcm_provider_t {
 
 
     /* other variables */
-    lcm_frag_buf_store  *frag_bufs;
-
-    uint32_t     udp_rx;            // packets received and processed
-    uint32_t     udp_discarded_bad; // packets discarded because they were bad 
-    // somehow
-    double       udp_low_watermark; // least buffer available
-    int32_t      udp_last_report_secs;
 
-    // regex to check whether a passed in channel is a regex :-)
-    GRegex* regex_finder_re;
+    // random number that identifies our channel_port_assign_t messages
+    int64_t node_id;
 };
 
 // Forward declare some of the functions that are used out of order
@@ -199,6 +340,15 @@ static int publish_message_internal(lcm_mpudpm_t *lcm, const char *channel,
 static void publish_channel_mapping_update(lcm_mpudpm_t *lcm);
 static void channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
         const channel_port_map_update_t *msg, int64_t recv_time);
+static void insert_channel_mapping(lcm_mpudpm_t *lcm, const char *channel,
+        uint16_t port);
+static void publish_channel_map_delta(lcm_mpudpm_t *lcm,
+        const char *channel, uint16_t port);
+static void channel_port_map_delta_handler(lcm_mpudpm_t *lcm,
+        const channel_port_map_delta_t *msg, int64_t recv_time);
+static void publish_channel_assignments(lcm_mpudpm_t *lcm);
+static void channel_port_assign_handler(lcm_mpudpm_t *lcm,
+        const channel_port_assign_t *msg, int64_t recv_time);
 static void update_subscription_ports(lcm_mpudpm_t* lcm);
 static void add_channel_to_subscriber(lcm_mpudpm_t* lcm,
         mpudpm_subscriber_t * sub, const char * channel, uint16_t port);
@@ -211,8 +361,7 @@ mpudpm_subscriber_t_destroy (mpudpm_subscriber_t *sub)
 {
     if (sub->channel_string!=NULL)
         free(sub->channel_string);
-    if (sub->regex!=NULL)
-        g_regex_unref(sub->regex);
+    lcm_channel_pattern_free(sub->pattern);
 
     if (sub->sockets != NULL ) {
         // Only free the list structs.
@@ -231,50 +380,78 @@ mpudpm_socket_t_destroy (mpudpm_socket_t *sock)
     free(sock);
 }
 
+/* Closes the sockets removed from the worker, which the read thread no
+ * longer uses.  Must be called with receive_lock held. */
+static void
+close_removed_sockets(mpudpm_rx_worker_t *worker) {
+    for (GSList* it = worker->removed_sockets; it != NULL ; it = it->next)
+        mpudpm_socket_t_destroy((mpudpm_socket_t *) it->data);
+    g_slist_free(worker->removed_sockets);
+    worker->removed_sockets = NULL;
+}
+
 static void
 destroy_recv_parts (lcm_mpudpm_t *lcm)
 {
-    if (lcm->recv_thread_created) {
-        // send the read thread an exit command
-        int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "\0", 1);
-        if(wstatus < 0) {
-            perror(__FILE__ " thread_msg_pipe write: terminate");
-        } else {
-            g_thread_join (lcm->read_thread);
+    for (int i = 0; i < lcm->num_workers; i++) {
+        mpudpm_rx_worker_t *worker = &lcm->workers[i];
+        if (worker->read_thread) {
+            // send the read thread an exit command
+            int wstatus = lcm_internal_pipe_write(worker->thread_msg_pipe[1],
+                    "\0", 1);
+            if(wstatus < 0) {
+                perror(__FILE__ " thread_msg_pipe write: terminate");
+            } else {
+                g_thread_join (worker->read_thread);
+            }
+            worker->read_thread = NULL;
         }
-        lcm->read_thread = NULL;
-        lcm->recv_thread_created = 0;
-    }
-
-    if (lcm->thread_msg_pipe[0] >= 0) {
-        lcm_internal_pipe_close(lcm->thread_msg_pipe[0]);
-        lcm_internal_pipe_close(lcm->thread_msg_pipe[1]);
-        lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    }
 
-    if (lcm->subscribers) {
-        for (GSList* it = lcm->subscribers; it != NULL ; it = it->next) {
-            mpudpm_subscriber_t * sub = (mpudpm_subscriber_t *) it->data;
-            lcm_mpudpm_unsubscribe(lcm, sub->channel_string);
+        close_removed_sockets(worker);
+        if (worker->thread_msg_pipe[0] >= 0) {
+            lcm_internal_pipe_close(worker->thread_msg_pipe[0]);
+            lcm_internal_pipe_close(worker->thread_msg_pipe[1]);
+            worker->thread_msg_pipe[0] = worker->thread_msg_pipe[1] = -1;
         }
-        g_slist_free(lcm->subscribers);
     }
+    lcm->recv_thread_created = 0;
 
-    if (lcm->frag_bufs) {
-        lcm_frag_buf_store_destroy(lcm->frag_bufs);
+    // lcm_mpudpm_unsubscribe removes the subscriber from the list
+    while (lcm->subscribers) {
+        mpudpm_subscriber_t * sub =
+            (mpudpm_subscriber_t *) lcm->subscribers->data;
+        lcm_mpudpm_unsubscribe(lcm, sub->channel_string);
+    }
+    // the socket for the channel to port map updates has no subscriber
+    for (GSList* it = lcm->recv_sockets; it != NULL ; it = it->next)
+        mpudpm_socket_t_destroy((mpudpm_socket_t *) it->data);
+    g_slist_free(lcm->recv_sockets);
+    lcm->recv_sockets = NULL;
+    for (int i = 0; i < lcm->num_workers; i++) {
+        mpudpm_rx_worker_t *worker = &lcm->workers[i];
+#ifdef USE_EPOLL
+        if (worker->epoll_fd >= 0) {
+            close(worker->epoll_fd);
+            worker->epoll_fd = -1;
+        }
+#endif
+        if (worker->frag_bufs) {
+            lcm_frag_buf_store_destroy(worker->frag_bufs);
+            worker->frag_bufs = NULL;
+        }
     }
 
     if (lcm->inbufs_empty) {
-        lcm_buf_queue_free (lcm->inbufs_empty, lcm->ringbuf);
+        lcm_buf_queue_free (lcm->inbufs_empty);
         lcm->inbufs_empty = NULL;
     }
     if (lcm->inbufs_filled) {
-        lcm_buf_queue_free (lcm->inbufs_filled, lcm->ringbuf);
+        lcm_buf_queue_free (lcm->inbufs_filled);
         lcm->inbufs_filled = NULL;
     }
-    if (lcm->ringbuf) {
-        lcm_ringbuf_free (lcm->ringbuf);
-        lcm->ringbuf = NULL;
+    if (lcm->pool) {
+        lcm_bufpool_free (lcm->pool);
+        lcm->pool = NULL;
     }
 }
 
@@ -286,25 +463,43 @@ lcm_mpudpm_destroy (lcm_mpudpm_t *lcm)
 
     if (lcm->send_fd >= 0)
         lcm_close_socket(lcm->send_fd);
+    lcm_fault_injector_destroy(lcm->faults);
 
     if (lcm->channel_to_port_map != NULL) {
         g_hash_table_destroy(lcm->channel_to_port_map);
     }
+    if (lcm->channel_loads != NULL) {
+        g_hash_table_destroy(lcm->channel_loads);
+    }
+    if (lcm->peer_delta_versions != NULL) {
+        g_hash_table_destroy(lcm->peer_delta_versions);
+    }
 
-    lcm_internal_pipe_close(lcm->notify_pipe[0]);
-    lcm_internal_pipe_close(lcm->notify_pipe[1]);
+    lcm_internal_notify_close(lcm->notify_pipe);
 
     g_static_mutex_free (&lcm->receive_lock);
     g_static_mutex_free (&lcm->transmit_lock);
+    for (int i = 0; i < lcm->num_workers; i++) {
+        g_static_mutex_free (&lcm->workers[i].stats_lock);
+        lcm_seq_tracker_destroy (lcm->workers[i].seq_tracker);
+    }
+    free (lcm->workers);
     if(lcm->create_read_thread_mutex) {
         g_mutex_free(lcm->create_read_thread_mutex);
         g_cond_free(lcm->create_read_thread_cond);
     }
 
-    if (lcm->regex_finder_re != NULL ) {
-        g_regex_unref(lcm->regex_finder_re);
+    if (lcm->sub_matcher != NULL) {
+        lcm_channel_matcher_free(lcm->sub_matcher);
+    }
+    if (lcm->changed_channels != NULL) {
+        for (unsigned int i = 0; i < lcm->changed_channels->len; i++)
+            free(g_ptr_array_index(lcm->changed_channels, i));
+        g_ptr_array_free(lcm->changed_channels, TRUE);
     }
 
+    free (lcm->params.rx_cpu);
+    free (lcm->params.rx_sched);
     free (lcm);
 }
 
@@ -368,12 +563,83 @@ new_argument (gpointer key, gpointer value, gpointer user)
         if (endptr == value)
             fprintf (stderr, "Warning: Invalid value for recv_buf_size\n");
     }
+    else if (!strcmp ((char *) key, "recv_pool_size")) {
+        char *endptr = NULL;
+        params->recv_pool_size = strtol ((char *) value, &endptr, 0);
+        if (endptr == value ||
+                params->recv_pool_size < 2 * LCM_MAX_UNFRAGMENTED_PACKET_SIZE) {
+            fprintf (stderr, "Warning: Invalid value for recv_pool_size\n");
+            params->recv_pool_size = LCM_DEFAULT_RECV_POOL_SIZE;
+        }
+    }
     else if (!strcmp ((char *) key, "ttl")) {
         char *endptr = NULL;
         params->mc_ttl = strtol ((char *) value, &endptr, 0);
         if (endptr == value)
             fprintf (stderr, "Warning: Invalid value for ttl\n");
     }
+    else if (!strcmp ((char *) key, "max_rate_mbps")) {
+        char *endptr = NULL;
+        params->max_rate_mbps = strtod ((char *) value, &endptr);
+        if (endptr == value || params->max_rate_mbps < 0)
+            fprintf (stderr, "Warning: Invalid value for max_rate_mbps\n");
+    }
+    else if (!strcmp ((char *) key, "rx_cpu") ||
+            !strcmp ((char *) key, "rx_sched")) {
+        int is_cpu = !strcmp ((char *) key, "rx_cpu");
+        if (lcm_internal_check_thread_scheduling (
+                    is_cpu ? (char *) value : NULL,
+                    is_cpu ? NULL : (char *) value) < 0) {
+            fprintf (stderr, "Warning: Invalid value for %s\n", (char *) key);
+        } else {
+            char **dest = is_cpu ? &params->rx_cpu : &params->rx_sched;
+            free (*dest);
+            *dest = strdup ((char *) value);
+        }
+    }
+    else if (!strcmp ((char *) key, "self_test")) {
+        if (!strcmp ((char *) value, "sync"))
+            params->no_self_test = 0;
+        else if (!strcmp ((char *) value, "off"))
+            params->no_self_test = 1;
+        else
+            fprintf (stderr, "Warning: Invalid value for self_test\n");
+    }
+    else if (!strcmp ((char *) key, "mtu")) {
+        char *endptr = NULL;
+        params->mtu = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || (params->mtu && params->mtu < LCM_MIN_MTU)) {
+            fprintf (stderr, "Warning: Invalid value for mtu\n");
+            params->mtu = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "burst_kb")) {
+        char *endptr = NULL;
+        params->burst_kb = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->burst_kb < 0)
+            fprintf (stderr, "Warning: Invalid value for burst_kb\n");
+    }
+    else if (!strcmp ((char *) key, "port_policy")) {
+        if (!strcmp ((char *) value, "hash"))
+            params->port_policy_load = 0;
+        else if (!strcmp ((char *) value, "load"))
+            params->port_policy_load = 1;
+        else
+            fprintf (stderr, "Warning: Invalid value for port_policy\n");
+    }
+    else if (!strcmp ((char *) key, "recv_threads")) {
+        char *endptr = NULL;
+        params->recv_threads = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_threads < 1 ||
+                params->recv_threads > LCM_MAX_RECV_THREADS) {
+            fprintf (stderr, "Warning: Invalid value for recv_threads\n");
+            params->recv_threads = 1;
+        }
+    }
+    else if (lcm_fault_params_parse (&params->faults, (char *) key,
+                (char *) value)) {
+        // drop_rate, dup_rate, reorder_rate or fault_seed
+    }
     else if (!strcmp ((char *) key, "nports")) {
         char *endptr = NULL;
         params->num_mc_ports = strtol ((char *) value, &endptr, 0);
@@ -399,65 +665,108 @@ is_reserved_channel(const char * channel){
 }
 
 static int 
-recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
+recv_message_fragment (mpudpm_rx_worker_t *worker, lcm_buf_t *lcmb,
+        uint32_t sz)
 {
+    lcm_mpudpm_t *lcm = worker->lcm;
     lcm2_header_long_t *hdr = (lcm2_header_long_t*) lcmb->buf;
 
-    // any existing fragment buffer for this message source?
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
-            &lcmb->from);
-
     uint32_t msg_seqno = ntohl (hdr->msg_seqno);
     uint32_t data_size = ntohl (hdr->msg_size);
     uint32_t fragment_offset = ntohl (hdr->fragment_offset);
-    //    uint16_t fragment_no = ntohs (hdr->fragment_no);
+    uint16_t fragment_no = ntohs (hdr->fragment_no);
     uint16_t fragments_in_msg = ntohs (hdr->fragments_in_msg);
     uint32_t frag_size = sz - sizeof (lcm2_header_long_t);
     char *data_start = (char*) (hdr + 1);
 
-    // discard any stale fragments from previous messages
-    if (fbuf && ((fbuf->msg_seqno != msg_seqno) ||
-            (fbuf->data_size != data_size))) {
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+    if (data_size > LCM_MAX_MESSAGE_SIZE) {
+        dbg (DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
+        return 0;
+    }
+    if (fragment_no >= fragments_in_msg) {
+        dbg (DBG_LCM, "bad fragment number\n");
+        worker->stats.num_bad_packets++;
+        return 0;
+    }
+
+    // messages that stopped arriving halfway are given up on
+    worker->stats.num_incomplete += lcm_frag_buf_store_expire (
+            worker->frag_bufs, lcmb->recv_utime);
+
+    // any existing fragment buffer for this message?
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(worker->frag_bufs,
+            &lcmb->from, msg_seqno);
+
+    // a sender that restarted may reuse the sequence number
+    if (fbuf && ((fbuf->data_size != data_size) ||
+                 (fbuf->fragments_in_msg != fragments_in_msg))) {
+        if (!fbuf->ignored)
+            worker->stats.num_incomplete++;
         dbg(DBG_LCM, "Dropping message (missing %d fragments)\n",
             fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove (worker->frag_bufs, fbuf);
         fbuf = NULL;
     }
 
-    if (data_size > LCM_MAX_MESSAGE_SIZE) {
-        dbg (DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
+    // the rest of a message nobody wanted
+    if (fbuf && fbuf->ignored) {
+        if (!lcm_frag_buf_mark_received (fbuf, fragment_no))
+            return 0;
+        if (!fbuf->fragments_remaining)
+            lcm_frag_buf_store_remove (worker->frag_bufs, fbuf);
+        else
+            lcm_frag_buf_store_touch (worker->frag_bufs, fbuf,
+                    lcmb->recv_utime, lcmb->recv_utime * 1000);
         return 0;
     }
 
-    // create a new fragment buffer if necessary
-    //TODO(abachrac): this discards a msg if the first fragment is out of order
-    if (!fbuf && hdr->fragment_no == 0) {
+    if (fragment_no == 0) {
         char *channel = (char*) (hdr + 1);
         int channel_sz = strlen (channel);
         if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH) {
             dbg (DBG_LCM, "bad channel name length\n");
-            lcm->udp_discarded_bad++;
+            worker->stats.num_bad_packets++;
             return 0;
         }
 
-        // if the packet has no subscribers, drop the message now.
+        // if the packet has no subscribers, drop the message now, and the
+        // rest of its fragments as they arrive.
         if (!lcm_has_handlers(lcm->lcm, channel)
-                && !is_reserved_channel(channel))
+                && !is_reserved_channel(channel)) {
+            if (fbuf) {
+                lcm_frag_buf_store_ignore (worker->frag_bufs, fbuf);
+            } else {
+                fbuf = lcm_frag_buf_new_ignored (
+                        *((struct sockaddr_in*) &lcmb->from), msg_seqno,
+                        data_size, fragments_in_msg, lcmb->recv_utime);
+                worker->stats.num_incomplete += lcm_frag_buf_store_add (
+                        worker->frag_bufs, fbuf);
+            }
+            lcm_frag_buf_mark_received (fbuf, 0);
+            if (!fbuf->fragments_remaining)
+                lcm_frag_buf_store_remove (worker->frag_bufs, fbuf);
             return 0;
+        }
 
-        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
-                channel, msg_seqno, data_size, fragments_in_msg,
-                lcmb->recv_utime);
-        lcm_frag_buf_store_add (lcm->frag_bufs, fbuf);
+        if (!fbuf) {
+            fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+                    channel, msg_seqno, data_size, fragments_in_msg,
+                    lcmb->recv_utime);
+            worker->stats.num_incomplete += lcm_frag_buf_store_add (
+                    worker->frag_bufs, fbuf);
+        } else if (!lcm_frag_buf_has_fragment (fbuf, 0)) {
+            strcpy (fbuf->channel, channel);
+        }
         data_start += channel_sz + 1;
         frag_size -= (channel_sz + 1);
-    }
-
-    if (!fbuf){
-        // received fragment for message we dropped (hopefully intentionally)
-        //TODO(abachrac): is there a way to distinguish between intentionally
-        // dropped, and packets being dropped due to out of order packet 0?
-        return 0;
+    } else if (!fbuf) {
+        // the first fragment is late.  The channel is filled in when it
+        // arrives.
+        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+                NULL, msg_seqno, data_size, fragments_in_msg,
+                lcmb->recv_utime);
+        worker->stats.num_incomplete += lcm_frag_buf_store_add (worker->frag_bufs,
+                fbuf);
     }
 
 #ifdef __linux__
@@ -479,15 +788,20 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
     if (fragment_offset + frag_size > fbuf->data_size) {
         dbg (DBG_LCM, "dropping invalid fragment (off: %d, %d / %d)\n",
                 fragment_offset, frag_size, fbuf->data_size);
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove (worker->frag_bufs, fbuf);
+        return 0;
+    }
+
+    // fragments can arrive more than once, e.g., when they are retransmitted
+    if (!lcm_frag_buf_mark_received (fbuf, fragment_no)) {
+        dbg (DBG_LCM, "duplicate fragment %d\n", fragment_no);
         return 0;
     }
 
     // copy data
     memcpy (fbuf->data + fragment_offset, data_start, frag_size);
-    fbuf->last_packet_utime = lcmb->recv_utime;
-
-    fbuf->fragments_remaining --;
+    lcm_frag_buf_store_touch (worker->frag_bufs, fbuf, lcmb->recv_utime,
+            lcmb->recv_utime * 1000);
 
     if (0 == fbuf->fragments_remaining) {
         // complete message received.  Is there a subscriber that still
@@ -497,15 +811,15 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
         if (!is_reserved_channel(fbuf->channel)
                 && !lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
             // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove(lcm->frag_bufs, fbuf);
+            lcm_frag_buf_store_remove(worker->frag_bufs, fbuf);
             return 0;
         }
 
         // yes, transfer the message into the lcm_buf_t
 
-        // deallocate the ringbuffer-allocated buffer
+        // deallocate the pool-allocated buffer
         g_static_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
+        lcm_buf_free_data(lcmb);
         g_static_mutex_unlock(&lcm->receive_lock);
 
         // transfer ownership of the message's payload buffer
@@ -519,7 +833,7 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
         lcmb->recv_utime = fbuf->last_packet_utime;
 
         // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove (worker->frag_bufs, fbuf);
 
         return 1;
     }
@@ -528,8 +842,9 @@ recv_message_fragment (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 }
 
 static int
-recv_short_message (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int sz)
+recv_short_message (mpudpm_rx_worker_t *worker, lcm_buf_t *lcmb, int sz)
 {
+    lcm_mpudpm_t *lcm = worker->lcm;
     lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
 
     // shouldn't have to worry about buffer overflow here because we
@@ -540,11 +855,10 @@ recv_short_message (lcm_mpudpm_t *lcm, lcm_buf_t *lcmb, int sz)
 
     if (lcmb->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
         dbg (DBG_LCM, "bad channel name length\n");
-        lcm->udp_discarded_bad++;
+        worker->stats.num_bad_packets++;
         return 0;
     }
 
-    lcm->udp_rx++;
 
     // if the packet has no subscribers, drop the message now.
     // WARNING: lcm_try_enqueue_message increments the number of queued
@@ -590,31 +904,58 @@ static void dispatch_complete_message(lcm_mpudpm_t * lcm, lcm_buf_t * lcmb,
         }
         // discard the received message
         handled_internal_message = 1;
+    } else if (strcmp(lcmb->channel_name, CHANNEL_TO_PORT_MAP_DELTA_CHANNEL)
+            == 0) {
+        channel_port_map_delta_t dlt_msg;
+        int status = channel_port_map_delta_t_decode(lcmb->buf,
+                lcmb->data_offset, lcmb->data_size, &dlt_msg);
+        if (status < 0) {
+            fprintf(stderr, "error %d decoding channel_port_map_delta_t!!!\n",
+                    status);
+        } else {
+            channel_port_map_delta_handler(lcm, &dlt_msg, lcmb->recv_utime);
+            channel_port_map_delta_t_decode_cleanup(&dlt_msg);
+        }
+        // discard the received message
+        handled_internal_message = 1;
+    } else if (strcmp(lcmb->channel_name, CHANNEL_TO_PORT_ASSIGN_CHANNEL)
+            == 0) {
+        channel_port_assign_t asg_msg;
+        int status = channel_port_assign_t_decode(lcmb->buf,
+                lcmb->data_offset, lcmb->data_size, &asg_msg);
+        if (status < 0) {
+            fprintf(stderr, "error %d decoding channel_port_assign_t!!!\n",
+                    status);
+        } else {
+            channel_port_assign_handler(lcm, &asg_msg, lcmb->recv_utime);
+            channel_port_assign_t_decode_cleanup(&asg_msg);
+        }
+        // discard the received message
+        handled_internal_message = 1;
     }
 
     if (handled_internal_message) {
         // one of the handlers above took it, so discard lcmb
         g_static_mutex_lock(&lcm->receive_lock);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
+        lcm_buf_free_data(lcmb);
         lcm_buf_enqueue(lcm->inbufs_empty, lcmb);
         g_static_mutex_unlock(&lcm->receive_lock);
     } else {
         // enqueue the lcmb for handling by the user
         g_static_mutex_lock(&lcm->receive_lock);
 
-        // if the newly received packet is a short packet, then resize the space
-        // allocated in the ringbuffer to exactly match the amount of space
-        // required.  That way, we do not use 64k of the ringbuffer for every
-        // incoming message.
-        if (lcmb->ringbuf) {
-            lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf, actual_size);
+        // if the newly received packet is a short packet, then move it to a
+        // smaller buffer from the pool.  That way, we do not hold 64k of the
+        // pool for every incoming message.
+        if (lcmb->pool) {
+            lcm_buf_shrink_data(lcmb, actual_size);
         }
         // If necessary, notify the reading thread by writing to a pipe.  We
         // only want one character in the pipe at a time to avoid blocking
         // writes, so we only do this when the queue transitions from empty to
         // non-empty.
         if (lcm_buf_queue_is_empty(lcm->inbufs_filled)) {
-            if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0) {
+            if (lcm_internal_notify_signal(lcm->notify_pipe) < 0) {
                 perror("write to notify");
             }
         }
@@ -624,6 +965,171 @@ static void dispatch_complete_message(lcm_mpudpm_t * lcm, lcm_buf_t * lcmb,
     }
 }
 
+/* Receives the datagrams waiting on the socket recv_fd, bound to recv_port,
+ * until recvmsg would block or fails.  *lcmbp is the buffer to receive into
+ * next, or NULL.  Must be called with receive_lock held, which is released
+ * while receiving, and returns with it held. */
+static void
+recv_socket_datagrams(mpudpm_rx_worker_t *worker, SOCKET recv_fd,
+        uint16_t recv_port, lcm_buf_t **lcmbp) {
+    lcm_mpudpm_t *lcm = worker->lcm;
+    lcm_buf_t *lcmb = *lcmbp;
+    while (1) {
+        // We should be holding receive_lock at the start of this loop
+        if (lcmb == NULL )
+            lcmb = lcm_buf_allocate(lcm->inbufs_empty);
+        if (lcm_buf_allocate_data(lcmb, lcm->pool,
+                    LCM_MAX_UNFRAGMENTED_PACKET_SIZE) < 0) {
+            // the pool is at its cap.  Discard the datagram.
+            g_static_mutex_unlock(&lcm->receive_lock);
+            worker->stats.num_dropped_no_buffer++;
+            char ch;
+            int status = recv(recv_fd, &ch, 1, 0);
+            g_static_mutex_lock(&lcm->receive_lock);
+            if (status < 0)
+                break;
+            continue;
+        }
+        size_t capacity = lcm_bufpool_capacity(lcm->pool);
+        size_t used = lcm_bufpool_used(lcm->pool);
+        double buf_avail = ((double) (capacity - MIN(used, capacity)))
+            / capacity;
+        if (buf_avail < worker->stats.ring_low_watermark)
+            worker->stats.ring_low_watermark = buf_avail;
+
+        // unlock while we actually receive the incoming message
+        g_static_mutex_unlock(&lcm->receive_lock);
+        struct iovec vec;
+        vec.iov_base = lcmb->buf;
+        vec.iov_len = 65535;
+
+        struct msghdr msg;
+        msg.msg_name = &lcmb->from;
+        msg.msg_namelen = sizeof(struct sockaddr);
+        msg.msg_iov = &vec;
+        msg.msg_iovlen = 1;
+#ifdef MSG_EXT_HDR
+        // operating systems that provide SO_TIMESTAMP allow us to
+        // obtain more accurate timestamps by having the kernel produce
+        // timestamps as soon as packets are received.
+        char controlbuf[64];
+        msg.msg_control = controlbuf;
+        msg.msg_controllen = sizeof(controlbuf);
+        msg.msg_flags = 0;
+#endif
+        int sz = recvmsg(recv_fd, &msg, 0);
+
+        if (sz < 0) {
+#ifndef WIN32
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+#else
+            if (WSAGetLastError() != WSAEWOULDBLOCK) {
+#endif
+                perror("udp_read_packet -- recvmsg");
+                worker->stats.num_bad_packets++;
+            }
+            g_static_mutex_lock(&lcm->receive_lock);
+            break;
+        }
+        worker->stats.num_packets++;
+        worker->stats.num_bytes += sz;
+
+        if (sz < sizeof(lcm2_header_short_t)) {
+            // packet too short to be LCM
+            worker->stats.num_bad_packets++;
+            g_static_mutex_lock(&lcm->receive_lock);
+            continue;
+        }
+
+        lcmb->fromlen = msg.msg_namelen;
+        // overwrite upper 16 bits of the address in lcmb->from with the
+        // recv_port since all channels are sent from the same port, and
+        // the from address is used to retrieve fragment buffers. If
+        // there is an existing fragment buffer with a different seqno
+        // the message would get dropped. This ensures that messages on
+        // different channels will appear as though they are coming from
+        // different senders
+        struct sockaddr_in *from_addr =
+                (struct sockaddr_in*) &lcmb->from;
+        // s_addr is network order, so we actually modify lower 16
+        from_addr->sin_addr.s_addr &= 0xFFFF0000;
+        from_addr->sin_addr.s_addr |= htons(recv_port);
+
+        int got_utime = 0;
+#ifdef SO_TIMESTAMP
+        struct cmsghdr * cmsg = CMSG_FIRSTHDR (&msg);
+        // Get the receive timestamp out of the packet headers
+        // (if possible)
+        while (!lcmb->recv_utime && cmsg) {
+            if (cmsg->cmsg_level == SOL_SOCKET
+                    && cmsg->cmsg_type == SCM_TIMESTAMP) {
+                struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
+                lcmb->recv_utime = (int64_t) t->tv_sec * 1000000
+                        + t->tv_usec;
+                got_utime = 1;
+                break;
+            }
+            cmsg = CMSG_NXTHDR (&msg, cmsg);
+        }
+#endif
+        if (!got_utime)
+            lcmb->recv_utime = lcm_clock_realtime_us();
+
+        lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
+        uint32_t rcvd_magic = ntohl(hdr2->magic);
+        if (rcvd_magic == LCM2_MAGIC_SHORT ||
+                rcvd_magic == LCM2_MAGIC_LONG) {
+            // each port only sees part of a sender's sequence
+            // numbers, so gaps do not mean that anything was lost
+            lcm_seq_tracker_update(worker->seq_tracker, from_addr,
+                    ntohl(hdr2->msg_seqno),
+                    rcvd_magic == LCM2_MAGIC_LONG, lcmb->recv_utime,
+                    &worker->stats);
+        }
+        int got_complete_message = 0;
+        if (rcvd_magic == LCM2_MAGIC_SHORT)
+            got_complete_message = recv_short_message(worker, lcmb, sz);
+        else if (rcvd_magic == LCM2_MAGIC_LONG)
+            got_complete_message = recv_message_fragment(worker, lcmb, sz);
+        else {
+            dbg(DBG_LCM, "LCM: bad magic\n");
+            worker->stats.num_bad_packets++;
+            g_static_mutex_lock(&lcm->receive_lock);
+            continue;
+        }
+
+        // dispatch internal messages
+        if (got_complete_message) {
+            dispatch_complete_message(lcm, lcmb, sz);
+            lcmb = NULL;
+        }
+        // lock to go back around the while loop
+        g_static_mutex_lock(&lcm->receive_lock);
+    }
+
+
+    *lcmbp = lcmb;
+}
+
+/* Reads a command from thread_msg_pipe.  Returns 1 if the read thread should
+ * exit. */
+static int
+read_thread_msg(mpudpm_rx_worker_t *worker) {
+    char ch;
+    int status = lcm_internal_pipe_read(worker->thread_msg_pipe[0], &ch, 1);
+    if (status <= 0) {
+        fprintf(stderr, "Error: Problem reading from thread_msg_pipe\n");
+        return 1;
+    }
+    if (ch == 'c') {
+        dbg(DBG_LCM, "Aborted select due to changed receive sockets\n");
+        return 0;
+    }
+    // received an exit message.
+    dbg(DBG_LCM, "read thread received exit command\n");
+    return 1;
+}
+
 /* This is the receiver thread that runs continuously to retrieve any incoming
  * LCM packets from the network and queues them locally. */
 static void *
@@ -635,12 +1141,69 @@ recv_thread(void * user) {
     pthread_sigmask(SIG_SETMASK, &mask, NULL);
 #endif
 
-    lcm_mpudpm_t * lcm = (lcm_mpudpm_t *) user;
+    mpudpm_rx_worker_t * worker = (mpudpm_rx_worker_t *) user;
+    lcm_mpudpm_t * lcm = worker->lcm;
+    lcm_internal_thread_init ("mpudpm-rx", lcm->params.rx_cpu,
+            lcm->params.rx_sched);
 
     lcm_buf_t *lcmb = NULL;
     // loop until we get an exit message on the thread_msg_pipe
     while (1) {
+        if (worker->frag_bufs)
+            worker->stats.frag_bytes_high_watermark =
+                worker->frag_bufs->peak_total_size;
+        g_static_mutex_lock(&worker->stats_lock);
+        worker->stats_snapshot = worker->stats;
+        g_static_mutex_unlock(&worker->stats_lock);
+
+#ifdef USE_EPOLL
+        // the epoll set is kept up to date by add_recv_socket and
+        // remove_recv_socket, so waiting costs the same however many ports
+        // are subscribed
+        struct epoll_event events[MAX_EPOLL_EVENTS];
+        int num_events = epoll_wait(worker->epoll_fd, events, MAX_EPOLL_EVENTS,
+                -1);
+        if (num_events < 0) {
+            if (errno != EINTR)
+                perror("udp_read_packet -- epoll_wait() failed:");
+            continue;
+        }
+
+        // check for a signaling message
+        int exit_thread = 0;
+        for (int i = 0; i < num_events; i++) {
+            if (!events[i].data.ptr && read_thread_msg(worker))
+                exit_thread = 1;
+        }
+        if (exit_thread)
+            break;
+
+        g_static_mutex_lock(&lcm->receive_lock);
+        if (worker->recv_sockets_changed) {
+            // the events may be for sockets that have been removed since.
+            // The sockets still ready are reported again.
+            worker->recv_sockets_changed = 0;
+            close_removed_sockets(worker);
+            g_static_mutex_unlock(&lcm->receive_lock);
+            continue;
+        }
 
+        // receive data on all the sockets that have data
+        for (int i = 0; i < num_events; i++) {
+            mpudpm_socket_t * sub_socket =
+                (mpudpm_socket_t *) events[i].data.ptr;
+            if (!sub_socket)
+                continue;
+            recv_socket_datagrams(worker, sub_socket->fd, sub_socket->port,
+                    &lcmb);
+            if (worker->recv_sockets_changed) {
+                // the remaining events may be for sockets that have been
+                // removed
+                break;
+            }
+        }
+        g_static_mutex_unlock(&lcm->receive_lock);
+#else
         // lock subscription lists so things don't change on us
         g_static_mutex_lock(&lcm->receive_lock);
 
@@ -649,17 +1212,20 @@ recv_thread(void * user) {
         FD_ZERO(&fds);
 
         // thread_msg_pipe fd
-        FD_SET(lcm->thread_msg_pipe[0], &fds);
-        SOCKET maxfd = lcm->thread_msg_pipe[0];
+        FD_SET(worker->thread_msg_pipe[0], &fds);
+        SOCKET maxfd = worker->thread_msg_pipe[0];
 
         for (GSList* it = lcm->recv_sockets; it != NULL ; it = it->next) {
           mpudpm_socket_t * sub_socket = (mpudpm_socket_t *) it->data;
+          if (sub_socket->worker != worker)
+            continue;
           FD_SET(sub_socket->fd, &fds);
           if (sub_socket->fd > maxfd) {
             maxfd = sub_socket->fd;
           }
         }
-        lcm->recv_sockets_changed = 0;
+        worker->recv_sockets_changed = 0;
+        close_removed_sockets(worker);
 
         // unlock receive_lock while we wait for a message
         g_static_mutex_unlock(&lcm->receive_lock);
@@ -670,36 +1236,13 @@ recv_thread(void * user) {
         }
 
         // check for a signaling message
-        if (FD_ISSET(lcm->thread_msg_pipe[0], &fds)) {
-            char ch;
-            int status = lcm_internal_pipe_read(lcm->thread_msg_pipe[0], &ch,
-                    1);
-            if (status <= 0) {
-                fprintf(stderr,
-                        "Error: Problem reading from thread_msg_pipe\n");
-                break;
-            }
-            if (ch == 'c') {
-                dbg(DBG_LCM, "Aborted select due to changed receive sockets\n");
-                continue;
-            } else {
-                // received an exit message.
-                dbg(DBG_LCM, "read thread received exit command\n");
-                if (lcmb) {
-                    // lcmb is not on one of the memory managed buffer queues.
-                    // We could either put it back on one of the queues, or
-                    // just free it here.  Do the latter.
-                    //
-                    // Can also just free its lcm_buf_t here.  Its data buffer
-                    // is managed either by the ring buffer or the fragment
-                    // buffer, so we can ignore it.
-                    free(lcmb);
-                }
+        if (FD_ISSET(worker->thread_msg_pipe[0], &fds)) {
+            if (read_thread_msg(worker))
                 break;
-            }
+            continue;
         }
         g_static_mutex_lock(&lcm->receive_lock);
-        if (lcm->recv_sockets_changed) {
+        if (worker->recv_sockets_changed) {
             // the set of receive sockets has changed, so we need to start
             // over
             g_static_mutex_unlock(&lcm->receive_lock);
@@ -708,136 +1251,38 @@ recv_thread(void * user) {
 
         // there is incoming UDP data ready on at least one of our sockets.
         // loop over sockets and receive data on all the ones that have data
-        SOCKET recv_fd = -1;
-        uint16_t recv_port = -1;
-        int poll_i = 1;
-        for (GSList* it = lcm->recv_sockets; it != NULL ;
-                it = it->next, ++poll_i) {
+        for (GSList* it = lcm->recv_sockets; it != NULL ; it = it->next) {
             // We should be holding receive_lock at the start of this loop
             mpudpm_socket_t * sub_socket = (mpudpm_socket_t *) it->data;
-            if (!FD_ISSET(sub_socket->fd, &fds)) {
+            if (sub_socket->worker != worker ||
+                    !FD_ISSET(sub_socket->fd, &fds))
                 continue;
-            } else {
-                recv_fd = sub_socket->fd;
-                recv_port = sub_socket->port;
-            }
-
-            // loop until recvmsg would block (we've read all available data)
-            // or a read fails
-            while (1) {
-                // We should be holding receive_lock at the start of this loop
-                if (lcmb == NULL ) {
-                    lcmb = lcm_buf_allocate_data(lcm->inbufs_empty,
-                            &lcm->ringbuf);
-                }
+            recv_socket_datagrams(worker, sub_socket->fd, sub_socket->port,
+                    &lcmb);
 
-                // unlock while we actually receive the incoming message
-                g_static_mutex_unlock(&lcm->receive_lock);
-                struct iovec vec;
-                vec.iov_base = lcmb->buf;
-                vec.iov_len = 65535;
-
-                struct msghdr msg;
-                msg.msg_name = &lcmb->from;
-                msg.msg_namelen = sizeof(struct sockaddr);
-                msg.msg_iov = &vec;
-                msg.msg_iovlen = 1;
-#ifdef MSG_EXT_HDR
-                // operating systems that provide SO_TIMESTAMP allow us to
-                // obtain more accurate timestamps by having the kernel produce
-                // timestamps as soon as packets are received.
-                char controlbuf[64];
-                msg.msg_control = controlbuf;
-                msg.msg_controllen = sizeof(controlbuf);
-                msg.msg_flags = 0;
-#endif
-                int sz = recvmsg(recv_fd, &msg, 0);
-
-                if (sz < 0) {
-#ifndef WIN32
-                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-#else
-                    if (WSAGetLastError() != WSAEWOULDBLOCK) {
-#endif
-                        perror("udp_read_packet -- recvmsg");
-                        lcm->udp_discarded_bad++;
-                    }
-                    break;
-                }
-
-                if (sz < sizeof(lcm2_header_short_t)) {
-                    // packet too short to be LCM
-                    lcm->udp_discarded_bad++;
-                    continue;
-                }
-
-                lcmb->fromlen = msg.msg_namelen;
-                // overwrite upper 16 bits of the address in lcmb->from with the
-                // recv_port since all channels are sent from the same port, and
-                // the from address is used to retrieve fragment buffers. If
-                // there is an existing fragment buffer with a different seqno
-                // the message would get dropped. This ensures that messages on
-                // different channels will appear as though they are coming from
-                // different senders
-                struct sockaddr_in *from_addr =
-                        (struct sockaddr_in*) &lcmb->from;
-                // s_addr is network order, so we actually modify lower 16
-                from_addr->sin_addr.s_addr &= 0xFFFF0000;
-                from_addr->sin_addr.s_addr |= htons(recv_port);
-
-                int got_utime = 0;
-#ifdef SO_TIMESTAMP
-                struct cmsghdr * cmsg = CMSG_FIRSTHDR (&msg);
-                // Get the receive timestamp out of the packet headers
-                // (if possible)
-                while (!lcmb->recv_utime && cmsg) {
-                    if (cmsg->cmsg_level == SOL_SOCKET
-                            && cmsg->cmsg_type == SCM_TIMESTAMP) {
-                        struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
-                        lcmb->recv_utime = (int64_t) t->tv_sec * 1000000
-                                + t->tv_usec;
-                        got_utime = 1;
-                        break;
-                    }
-                    cmsg = CMSG_NXTHDR (&msg, cmsg);
-                }
-#endif
-                if (!got_utime)
-                    lcmb->recv_utime = lcm_timestamp_now();
-
-                lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
-                uint32_t rcvd_magic = ntohl(hdr2->magic);
-                int got_complete_message = 0;
-                if (rcvd_magic == LCM2_MAGIC_SHORT)
-                    got_complete_message = recv_short_message(lcm, lcmb, sz);
-                else if (rcvd_magic == LCM2_MAGIC_LONG)
-                    got_complete_message = recv_message_fragment(lcm, lcmb, sz);
-                else {
-                    dbg(DBG_LCM, "LCM: bad magic\n");
-                    lcm->udp_discarded_bad++;
-                    continue;
-                }
-
-                // dispatch internal messages
-                if (got_complete_message) {
-                    dispatch_complete_message(lcm, lcmb, sz);
-                    lcmb = NULL;
-                }
-                // lock to go back around the while loop
-                g_static_mutex_lock(&lcm->receive_lock);
-            }
-
-            // we're done with this file descriptor
-            // lock the receive lock to check whether the receive sockets have
-            // changed and go back around the loop
-            g_static_mutex_lock(&lcm->receive_lock);
-            if (lcm->recv_sockets_changed) {
+            // we're done with this file descriptor.  check whether the
+            // receive sockets have changed and go back around the loop
+            if (worker->recv_sockets_changed) {
                 // the set of receive sockets may have changed, so we need to
                 // break and wait again on the appropriate set of sockets
                 break;
             }
         }
         g_static_mutex_unlock(&lcm->receive_lock);
+#endif
+    }
+
+    if (lcmb) {
+        // lcmb is not on one of the memory managed buffer queues.  We could
+        // either put it back on one of the queues, or just free it here.  Do
+        // the latter.
+        //
+        // Its data buffer, if any, is from the pool.  It would stay in use
+        // forever.
+        g_static_mutex_lock(&lcm->receive_lock);
+        lcm_buf_free_data(lcmb);
+        g_static_mutex_unlock(&lcm->receive_lock);
+        free(lcmb);
     }
 
     dbg(DBG_LCM, "read thread exiting\n");
@@ -869,20 +1314,20 @@ lcm_mpudpm_subscribe (lcm_mpudpm_t *lcm, const char *channel)
     sub->channel_set = g_hash_table_new_full(g_str_hash, g_str_equal, free,
             NULL );
 
-    if (g_regex_match(lcm->regex_finder_re, channel, (GRegexMatchFlags) 0,
-            NULL )) {
+    // the same kind of pattern that lcm.c matches the subscriptions with
+    GError *rerr = NULL;
+    sub->pattern = lcm_channel_pattern_new(channel, &rerr);
+    if (!sub->pattern) {
+        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
+        g_error_free(rerr);
+        mpudpm_subscriber_t_destroy(sub);
+        return -1;
+    }
+    int is_literal = lcm_channel_pattern_kind(sub->pattern) ==
+        LCM_CHANNEL_PATTERN_LITERAL;
+
+    if (!is_literal) {
         dbg(DBG_LCM, "Subscribing to channels that match: %s\n", channel);
-        char *regexbuf = g_strdup_printf("^%s$", channel);
-        GError *rerr = NULL;
-        sub->regex = g_regex_new(regexbuf, (GRegexCompileFlags) 0,
-                (GRegexMatchFlags) 0, &rerr);
-        g_free(regexbuf);
-        if (rerr) {
-            fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
-            g_error_free(rerr);
-            mpudpm_subscriber_t_destroy(sub);
-            return -1;
-        }
         // Request an update to the channel to port map
         dbg(DBG_LCM, "Requesting a channel to port map update\n");
         char *msg = "r";
@@ -891,6 +1336,8 @@ lcm_mpudpm_subscribe (lcm_mpudpm_t *lcm, const char *channel)
                 (uint8_t*) msg, strlen(msg));
         g_static_mutex_unlock(&lcm->transmit_lock);
     } else {
+        // without the escapes, if it had any
+        channel = lcm_channel_pattern_text(sub->pattern);
         dbg(DBG_LCM, "Subscribing to single channel: %s\n", channel);
         // add it to our channel map
         g_static_mutex_lock(&lcm->transmit_lock);
@@ -901,11 +1348,9 @@ lcm_mpudpm_subscribe (lcm_mpudpm_t *lcm, const char *channel)
         if (lookup_value == NULL ) {
             // insert the new destination into the hash table
             port = map_channel_to_port(lcm, channel);
-            g_hash_table_insert(lcm->channel_to_port_map, strdup(channel),
-                    GUINT_TO_POINTER(port));
-            // broadcast the updated channel map...
-            lcm->last_mapping_update_utime = 0;
-            publish_channel_mapping_update(lcm);
+            insert_channel_mapping(lcm, channel, port);
+            // and tell everyone about it
+            publish_channel_map_delta(lcm, channel, port);
         }
         else{
             port = GPOINTER_TO_UINT(lookup_value);
@@ -913,18 +1358,33 @@ lcm_mpudpm_subscribe (lcm_mpudpm_t *lcm, const char *channel)
         g_static_mutex_unlock(&lcm->transmit_lock);
 
         g_static_mutex_lock(&lcm->receive_lock);
-        add_channel_to_subscriber(lcm, sub, sub->channel_string, port);
+        add_channel_to_subscriber(lcm, sub, channel, port);
         g_static_mutex_unlock(&lcm->receive_lock);
     }
 
     // add sub to the list of active subscribers
     g_static_mutex_lock(&lcm->receive_lock);
+    g_static_mutex_lock(&lcm->transmit_lock);
     lcm->subscribers = g_slist_prepend(lcm->subscribers, sub);
+    lcm_channel_matcher_add(lcm->sub_matcher, sub->pattern, sub);
+    lcm->num_subscribers++;
+    if (!is_literal) {
+        // listen for the channels that we already know of.  The ones that
+        // come later are matched by update_subscription_ports
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, lcm->channel_to_port_map);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            const char * mapped_channel = (const char *) key;
+            if (!is_reserved_channel(mapped_channel) &&
+                    lcm_channel_pattern_match(sub->pattern, mapped_channel)) {
+                add_channel_to_subscriber(lcm, sub, mapped_channel,
+                        GPOINTER_TO_UINT(value));
+            }
+        }
+    }
+    g_static_mutex_unlock(&lcm->transmit_lock);
     g_static_mutex_unlock(&lcm->receive_lock);
-
-    // Do an update to set the ports used by this subscription
-    // this is what will actually open the sockets if needed...
-    update_subscription_ports(lcm);
     return 0;
 }
 
@@ -964,23 +1424,145 @@ lcm_mpudpm_unsubscribe (lcm_mpudpm_t *lcm, const char *channel)
         }
     }
     lcm->subscribers = g_slist_delete_link (lcm->subscribers, chan_it);
+    lcm_channel_matcher_remove(lcm->sub_matcher, chan_sub->pattern, chan_sub);
+    g_static_mutex_lock(&lcm->transmit_lock);
+    lcm->num_subscribers--;
+    g_static_mutex_unlock(&lcm->transmit_lock);
     mpudpm_subscriber_t_destroy(chan_sub);
     g_static_mutex_unlock(&lcm->receive_lock);
     return 0;
 }
 
+// Remembers that channel was added to, or moved in, the channel_to_port_map
+// for update_subscription_ports.
+// This function assumes that the caller is holding the transmit_lock
+static void
+record_changed_channel(lcm_mpudpm_t *lcm, const char *channel) {
+    if (lcm->num_subscribers > 0)
+        g_ptr_array_add(lcm->changed_channels, strdup(channel));
+}
+
+// Adds a channel that is not in the channel_to_port_map yet.
+// This function assumes that the caller is holding the transmit_lock
+static void
+insert_channel_mapping(lcm_mpudpm_t *lcm, const char *channel, uint16_t port) {
+    g_hash_table_insert(lcm->channel_to_port_map, strdup(channel),
+            GUINT_TO_POINTER(port));
+    if (!is_reserved_channel(channel)) {
+        lcm->map_size++;
+        lcm->map_checksum += mpudpm_str_hash(channel);
+        record_changed_channel(lcm, channel);
+    }
+}
+
+// Broadcasts the mapping of a channel that we just added, or with a NULL
+// channel, only the size and checksum of our map.  Others ask for the whole
+// map when they find that they missed a delta or that their map is
+// different.
+// This function assumes that the caller is holding the transmit_lock
+static void
+publish_channel_map_delta(lcm_mpudpm_t *lcm, const char *channel,
+        uint16_t port) {
+    channel_to_port_t mapping;
+    channel_port_map_delta_t msg;
+    msg.node_id = lcm->node_id;
+    msg.num_ports = lcm->params.num_mc_ports;
+    msg.num_channels = 0;
+    msg.mapping = NULL;
+    if (channel != NULL) {
+        mapping.channel = (char *) channel;
+        mapping.port = (int16_t) port; // cast to int16_t for LCM
+        msg.num_channels = 1;
+        msg.mapping = &mapping;
+        lcm->map_delta_version++;
+    }
+    msg.version = lcm->map_delta_version;
+    msg.map_size = lcm->map_size;
+    msg.map_checksum = (int64_t) lcm->map_checksum;
+    lcm->last_mapping_update_utime = lcm_clock_realtime_us();
+
+    int msg_sz = channel_port_map_delta_t_encoded_size(&msg);
+    void* buf = malloc(msg_sz);
+    channel_port_map_delta_t_encode(buf, 0, msg_sz, &msg);
+    publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_DELTA_CHANNEL, buf,
+            msg_sz);
+    free(buf);
+}
+
+static void
+channel_port_map_delta_handler(lcm_mpudpm_t *lcm,
+        const channel_port_map_delta_t *msg, int64_t recv_utime) {
+    if (msg->num_ports != lcm->params.num_mc_ports) {
+        fprintf(stderr, "WARNING: received a channel to port mapping "
+                "update from a process with \n"
+                "nports=%d instead of %d\n", msg->num_ports,
+                lcm->params.num_mc_ports);
+        return;
+    }
+    if (msg->node_id == lcm->node_id) {
+        return;
+    }
+    g_static_mutex_lock(&lcm->transmit_lock);
+    int8_t updated_channel_to_port_map = FALSE;
+    for (int i = 0; i < msg->num_channels; i++) {
+        if (g_hash_table_lookup(lcm->channel_to_port_map,
+                    msg->mapping[i].channel) == NULL) {
+            // cast back to uint16_t for LCM
+            uint16_t port = (uint16_t)msg->mapping[i].port;
+            dbg(DBG_LCM, "Received mapping for new channel %s on port %d\n",
+                    msg->mapping[i].channel, port);
+            insert_channel_mapping(lcm, msg->mapping[i].channel, port);
+            updated_channel_to_port_map = TRUE;
+        }
+    }
+
+    // a delta with new channels comes right after the previous one, and one
+    // without any repeats the version of the last one
+    gpointer last_version;
+    int8_t missed_delta = FALSE;
+    if (g_hash_table_lookup_extended(lcm->peer_delta_versions,
+                &msg->node_id, NULL, &last_version)) {
+        missed_delta = msg->version != GPOINTER_TO_INT(last_version)
+            + (msg->num_channels > 0);
+    }
+    int64_t *node_id = (int64_t *) malloc(sizeof(int64_t));
+    *node_id = msg->node_id;
+    g_hash_table_replace(lcm->peer_delta_versions, node_id,
+            GINT_TO_POINTER(msg->version));
+
+    if (msg->map_size == lcm->map_size &&
+            (uint64_t) msg->map_checksum == lcm->map_checksum) {
+        // the sender's map is identical to mine...
+        // treat it as if I just published an update :-)
+        lcm->last_mapping_update_utime = recv_utime;
+    } else if ((missed_delta || msg->num_channels == 0) &&
+            recv_utime - lcm->last_resync_utime > MIN_RESYNC_PERIOD) {
+        // a delta with new channels may just be crossing one of ours, but
+        // otherwise our maps really are out of sync
+        dbg(DBG_LCM, "Channel to port map is out of sync, requesting it\n");
+        lcm->last_resync_utime = recv_utime;
+        char *req = "r";
+        publish_message_internal(lcm, CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL,
+                (uint8_t*) req, strlen(req));
+    }
+    g_static_mutex_unlock(&lcm->transmit_lock);
+
+    if (updated_channel_to_port_map){
+        update_subscription_ports(lcm);
+    }
+}
+
 // This function assumes that the caller is holding the transmit_lock
 static void
 publish_channel_mapping_update(lcm_mpudpm_t *lcm){
-    int64_t now = lcm_timestamp_now();
-    if (now - lcm->last_mapping_update_utime < 1e4) {
+    int64_t now = lcm_clock_realtime_us();
+    if (now - lcm->last_snapshot_utime < 1e4) {
         // lets not publish updates too often.
-        // if we actually have new information (ie a new channel),
-        // last_mapping_update_utime will have been set to 0, so this check
-        // is bypassed
+        // new channels are broadcast by publish_channel_map_delta instead
         return;
     }
-    lcm->last_mapping_update_utime = lcm_timestamp_now();
+    lcm->last_snapshot_utime = now;
+    lcm->last_mapping_update_utime = now;
 
     channel_port_map_update_t* msg = (channel_port_map_update_t*) calloc(1,
             sizeof(channel_port_map_update_t));
@@ -1019,6 +1601,196 @@ publish_channel_mapping_update(lcm_mpudpm_t *lcm){
         free(buf);
     }
     channel_port_map_update_t_destroy(msg);
+
+    // the mapping only tells where new channels are, so tell everyone which
+    // channels have moved as well
+    publish_channel_assignments(lcm);
+}
+
+// This function assumes that the caller is holding the transmit_lock
+static mpudpm_channel_load_t *
+get_channel_load(lcm_mpudpm_t *lcm, const char *channel) {
+    mpudpm_channel_load_t *load = (mpudpm_channel_load_t *)
+        g_hash_table_lookup(lcm->channel_loads, channel);
+    if (load == NULL) {
+        load = (mpudpm_channel_load_t *) calloc(1,
+                sizeof(mpudpm_channel_load_t));
+        g_hash_table_insert(lcm->channel_loads, strdup(channel), load);
+    }
+    return load;
+}
+
+// Computes how many bytes per second we published on each channel since the
+// last call, and moves at most one of our channels to the least loaded port
+// if that leaves its current port less loaded than before.  The rates that
+// other processes reported recently are counted as well.
+// This function assumes that the caller is holding the transmit_lock
+static void
+rebalance_channel_ports(lcm_mpudpm_t *lcm, int64_t now) {
+    double elapsed = (now - lcm->last_load_utime) / 1e6;
+    lcm->last_load_utime = now;
+    if (elapsed <= 0)
+        return;
+
+    uint16_t first_port = lcm->params.mc_port_range_start;
+    int64_t *port_loads = (int64_t *) calloc(lcm->params.num_mc_ports,
+            sizeof(int64_t));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->channel_loads);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        mpudpm_channel_load_t *load = (mpudpm_channel_load_t *) value;
+        load->tx_rate = (int64_t) (load->tx_bytes / elapsed);
+        load->tx_bytes = 0;
+        if (now - load->remote_utime >
+                3 * lcm->channel_to_port_map_update_period) {
+            load->remote_rate = 0;
+        }
+        void *port_value = g_hash_table_lookup(lcm->channel_to_port_map, key);
+        if (port_value != NULL) {
+            port_loads[GPOINTER_TO_UINT(port_value) - first_port] +=
+                load->tx_rate + load->remote_rate;
+        }
+    }
+
+    // every process listens on the first port for the internal channels, so
+    // never move anything there unless it is the only port
+    int lightest = lcm->params.num_mc_ports > 1 ? 1 : 0;
+    for (int i = lightest + 1; i < lcm->params.num_mc_ports; i++) {
+        if (port_loads[i] < port_loads[lightest])
+            lightest = i;
+    }
+
+    // only move channels that we publish, so that the processes publishing
+    // on one port do not all move the same channel
+    const char *move_channel = NULL;
+    mpudpm_channel_load_t *move_load = NULL;
+    int64_t move_rate = 0;
+    g_hash_table_iter_init(&iter, lcm->channel_loads);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        mpudpm_channel_load_t *load = (mpudpm_channel_load_t *) value;
+        if (load->tx_rate < MIN_MOVE_BYTES_PER_SEC)
+            continue;
+        void *port_value = g_hash_table_lookup(lcm->channel_to_port_map, key);
+        if (port_value == NULL)
+            continue;
+        int64_t rate = load->tx_rate + load->remote_rate;
+        int ind = GPOINTER_TO_UINT(port_value) - first_port;
+        if (port_loads[lightest] + rate < port_loads[ind] &&
+                rate > move_rate) {
+            move_channel = (const char *) key;
+            move_load = load;
+            move_rate = rate;
+        }
+    }
+    free(port_loads);
+
+    if (move_channel != NULL) {
+        uint16_t port = first_port + lightest;
+        dbg(DBG_LCM, "Moving channel %s (%lld B/s) to port %d\n",
+                move_channel, (long long) move_rate, port);
+        move_load->version++;
+        g_hash_table_insert(lcm->channel_to_port_map, strdup(move_channel),
+                GUINT_TO_POINTER(port));
+        record_changed_channel(lcm, move_channel);
+    }
+}
+
+// Broadcasts the ports of the channels that have been moved, and how much
+// we publish on each channel.
+// This function assumes that the caller is holding the transmit_lock
+static void
+publish_channel_assignments(lcm_mpudpm_t *lcm) {
+    channel_port_assign_t msg;
+    msg.node_id = lcm->node_id;
+    msg.num_ports = lcm->params.num_mc_ports;
+    msg.assignment = (channel_port_assignment_t *) calloc(
+            g_hash_table_size(lcm->channel_loads) + 1,
+            sizeof(channel_port_assignment_t));
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, lcm->channel_loads);
+    int ind = 0;
+    while (g_hash_table_iter_next(&iter, &key, &value) && ind < INT16_MAX) {
+        mpudpm_channel_load_t *load = (mpudpm_channel_load_t *) value;
+        void *port_value = g_hash_table_lookup(lcm->channel_to_port_map, key);
+        if (port_value == NULL || (load->version == 0 && load->tx_rate == 0))
+            continue;
+        msg.assignment[ind].channel = (char *) key;
+        msg.assignment[ind].port = (int16_t) GPOINTER_TO_UINT(port_value);
+        msg.assignment[ind].version = load->version;
+        msg.assignment[ind].bytes_per_sec = load->tx_rate;
+        ind++;
+    }
+    msg.num_channels = ind;
+
+    if (msg.num_channels > 0) {
+        int msg_sz = channel_port_assign_t_encoded_size(&msg);
+        void* buf = malloc(msg_sz);
+        channel_port_assign_t_encode(buf, 0, msg_sz, &msg);
+        dbg(DBG_LCM, "Publishing a %dB channel_port_assign with %d channels\n",
+                msg_sz, msg.num_channels);
+        publish_message_internal(lcm, CHANNEL_TO_PORT_ASSIGN_CHANNEL, buf,
+                msg_sz);
+        free(buf);
+    }
+    free(msg.assignment);
+}
+
+static void
+channel_port_assign_handler(lcm_mpudpm_t *lcm,
+        const channel_port_assign_t *msg, int64_t recv_utime) {
+    if (msg->num_ports != lcm->params.num_mc_ports) {
+        // channel_port_mapping_update_handler warns about this
+        return;
+    }
+    if (msg->node_id == lcm->node_id) {
+        // our own.  Our subscribers followed our moves when we made them
+        return;
+    }
+    int first_port = lcm->params.mc_port_range_start;
+    int8_t moved = FALSE;
+    g_static_mutex_lock(&lcm->transmit_lock);
+    for (int i = 0; i < msg->num_channels; i++) {
+        const channel_port_assignment_t *asg = &msg->assignment[i];
+        uint16_t port = (uint16_t) asg->port;
+        if (is_reserved_channel(asg->channel) || port < first_port ||
+                port >= first_port + lcm->params.num_mc_ports) {
+            continue;
+        }
+        mpudpm_channel_load_t *load = get_channel_load(lcm, asg->channel);
+        if (asg->bytes_per_sec > 0) {
+            load->remote_rate = asg->bytes_per_sec;
+            load->remote_utime = recv_utime;
+        }
+        void* lookup_value = g_hash_table_lookup(lcm->channel_to_port_map,
+                asg->channel);
+        uint16_t cur_port = GPOINTER_TO_UINT(lookup_value);
+        // take the newest assignment.  If two processes moved a channel
+        // at the same time, they all settle on the lower port.
+        if (asg->version > load->version ||
+                (asg->version == load->version && asg->version > 0 &&
+                 port < cur_port)) {
+            load->version = asg->version;
+            if (lookup_value == NULL || port != cur_port) {
+                dbg(DBG_LCM, "Channel %s moved to port %d\n",
+                        asg->channel, port);
+                if (lookup_value == NULL) {
+                    insert_channel_mapping(lcm, asg->channel, port);
+                } else {
+                    g_hash_table_insert(lcm->channel_to_port_map,
+                            strdup(asg->channel), GUINT_TO_POINTER(port));
+                    record_changed_channel(lcm, asg->channel);
+                }
+                moved = TRUE;
+            }
+        }
+    }
+    g_static_mutex_unlock(&lcm->transmit_lock);
+
+    if (moved) {
+        update_subscription_ports(lcm);
+    }
 }
 
 static void
@@ -1044,9 +1816,7 @@ channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
                     port);
 
             // insert the new destination into the hash table
-            g_hash_table_insert(lcm->channel_to_port_map,
-                    strdup(msg->mapping[i].channel),
-                    GUINT_TO_POINTER(port));
+            insert_channel_mapping(lcm, msg->mapping[i].channel, port);
             updated_channel_to_port_map = TRUE;
         }
     }
@@ -1066,9 +1836,10 @@ channel_port_mapping_update_handler(lcm_mpudpm_t *lcm,
     }
 }
 
+// Makes sub use the socket on port for channel, opening it if needed.
 // This function assumes that the caller is holding the receive_lock
 static void
-add_channel_to_subscriber(lcm_mpudpm_t* lcm, mpudpm_subscriber_t * sub,
+add_socket_to_subscriber(lcm_mpudpm_t* lcm, mpudpm_subscriber_t * sub,
         const char * channel, uint16_t port) {
     mpudpm_socket_t* subscription_socket = NULL;
     for (GSList* sock_it = lcm->recv_sockets; sock_it != NULL ;
@@ -1093,51 +1864,101 @@ add_channel_to_subscriber(lcm_mpudpm_t* lcm, mpudpm_subscriber_t * sub,
     subscription_socket->num_subscribers++;
     sub->sockets = g_slist_prepend(sub->sockets,
             subscription_socket);
-    char* key = strdup(channel);
-    g_hash_table_replace(sub->channel_set, key, key);
 }
 
+// Releases the socket on port that sub used for one of its channels, and
+// closes it if no one else uses it.
+// This function assumes that the caller is holding the receive_lock
+static void
+remove_socket_from_subscriber(lcm_mpudpm_t* lcm, mpudpm_subscriber_t * sub,
+        uint16_t port) {
+    for (GSList* sock_it = sub->sockets; sock_it != NULL ;
+            sock_it = sock_it->next) {
+        mpudpm_socket_t* sock = (mpudpm_socket_t*) sock_it->data;
+        if (sock->port == port) {
+            sub->sockets = g_slist_delete_link(sub->sockets, sock_it);
+            sock->num_subscribers--;
+            if (sock->num_subscribers == 0) {
+                dbg(DBG_LCM, "No more subscribers using port %d, closing it\n",
+                        port);
+                remove_recv_socket(lcm, sock);
+            }
+            return;
+        }
+    }
+}
+
+// This function assumes that the caller is holding the receive_lock
+static void
+add_channel_to_subscriber(lcm_mpudpm_t* lcm, mpudpm_subscriber_t * sub,
+        const char * channel, uint16_t port) {
+    add_socket_to_subscriber(lcm, sub, channel, port);
+    g_hash_table_replace(sub->channel_set, strdup(channel),
+            GUINT_TO_POINTER(port));
+}
+
+// Makes the subscribers follow the channels in changed_channels, i.e.,
+// listen for the new channels that they match, and move to the new port of
+// the channels that moved.  Only the subscribers whose pattern matches a
+// channel are looked at for it.
 static void
 update_subscription_ports(lcm_mpudpm_t* lcm){
     // grab both locks in the proper order
     g_static_mutex_lock(&lcm->receive_lock);
     g_static_mutex_lock (&lcm->transmit_lock);
 
-    for (GSList* it = lcm->subscribers; it != NULL ; it = it->next) {
-        mpudpm_subscriber_t * sub = (mpudpm_subscriber_t *) it->data;
-        if (sub->regex==NULL){
-            // Subscriber is looking for a single channel
-            // We should have already subscribed
-            continue;
-        }
-        else {
-            // Subscriber uses a regex to match a set of channels
-            GHashTableIter iter;
-            gpointer key, value;
-            g_hash_table_iter_init(&iter, lcm->channel_to_port_map);
-            while (g_hash_table_iter_next(&iter, &key, &value)) {
-                char * channel = (char *) key;
-                uint16_t port = GPOINTER_TO_UINT(value);
-                if (g_regex_match(sub->regex, channel, (GRegexMatchFlags) 0,
-                        NULL ) && !is_reserved_channel(channel)) {
-                    if (g_hash_table_lookup_extended(sub->channel_set, channel,
-                            NULL, NULL )) {
-                        dbg(DBG_LCM,
-                                "Subscriber (%s) already listening for [%s] "
-                                "on port %d\n", sub->channel_string, channel, port);
-                    } else {
-                        add_channel_to_subscriber(lcm, sub, channel, port);
-                    }
-                }
+    GPtrArray* subs = g_ptr_array_new();
+    for (unsigned int i = 0; i < lcm->changed_channels->len; i++) {
+        char* channel = (char *) g_ptr_array_index(lcm->changed_channels, i);
+        void* lookup_value = g_hash_table_lookup(lcm->channel_to_port_map,
+                channel);
+        uint16_t port = GPOINTER_TO_UINT(lookup_value);
+        g_ptr_array_set_size(subs, 0);
+        if (lookup_value != NULL)
+            lcm_channel_matcher_lookup(lcm->sub_matcher, channel, subs);
+        for (unsigned int j = 0; j < subs->len; j++) {
+            mpudpm_subscriber_t * sub =
+                (mpudpm_subscriber_t *) g_ptr_array_index(subs, j);
+            gpointer set_value;
+            if (!g_hash_table_lookup_extended(sub->channel_set, channel,
+                        NULL, &set_value)) {
+                add_channel_to_subscriber(lcm, sub, channel, port);
+            } else if (GPOINTER_TO_UINT(set_value) != port) {
+                // follow the channel to its new port
+                uint16_t old_port = GPOINTER_TO_UINT(set_value);
+                dbg(DBG_LCM,
+                        "Subscriber (%s) following [%s] from port %d to %d\n",
+                        sub->channel_string, channel, old_port, port);
+                add_socket_to_subscriber(lcm, sub, channel, port);
+                remove_socket_from_subscriber(lcm, sub, old_port);
+                g_hash_table_insert(sub->channel_set, strdup(channel),
+                        GUINT_TO_POINTER(port));
             }
         }
+        free(channel);
     }
+    g_ptr_array_set_size(lcm->changed_channels, 0);
+    g_ptr_array_free(subs, TRUE);
+
     // Release both locks in the proper order
     g_static_mutex_unlock (&lcm->transmit_lock);
     g_static_mutex_unlock(&lcm->receive_lock);
 }
 
 
+// Transmits a datagram of a message on channel, through the fault injector
+// if there is one.  The messages of the reserved channels, which keep the
+// channel to port mapping, are left alone.  Must be called with the
+// transmit_lock held.
+static int
+send_datagram (lcm_mpudpm_t *lcm, const char *channel,
+        const struct msghdr *msg)
+{
+    if (lcm->faults && !is_reserved_channel(channel))
+        return lcm_fault_sendmsg(lcm->faults, lcm->send_fd, msg);
+    return sendmsg(lcm->send_fd, msg, 0);
+}
+
 // This function assumes that the caller is holding the transmit_lock
 // The transmit lock is held so that all fragments are transmitted
 // together, and so that no other message uses the same sequence number
@@ -1176,21 +1997,33 @@ publish_message_internal (lcm_mpudpm_t *lcm, const char *channel, const void *da
                 channel, chan_port);
 
         // insert the new destination into the hash table
-        g_hash_table_insert(lcm->channel_to_port_map, strdup(channel),
-                GUINT_TO_POINTER(chan_port));
-        // force an update to get sent
-        lcm->last_mapping_update_utime =0; 
+        insert_channel_mapping(lcm, channel, chan_port);
+        // and tell everyone about it
+        publish_channel_map_delta(lcm, channel, chan_port);
+    }
+    if (lcm->params.port_policy_load && !is_reserved_channel(channel)) {
+        get_channel_load(lcm, channel)->tx_bytes += datalen;
     }
-    if (lcm_timestamp_now() - lcm->last_mapping_update_utime>
+    int64_t now = lcm_clock_realtime_us();
+    if (now - lcm->last_mapping_update_utime>
         lcm->channel_to_port_map_update_period) {
-        // publish the mapping if no one has broadcast in a while
-        publish_channel_mapping_update(lcm);
+        // tell everyone what our mapping looks like if no one has broadcast
+        // one like it in a while
+        publish_channel_map_delta(lcm, NULL, 0);
+    }
+    if (lcm->params.port_policy_load && now - lcm->last_load_utime >
+            lcm->channel_to_port_map_update_period) {
+        // tell everyone how much we publish, and where our channels move
+        rebalance_channel_ports(lcm, now);
+        publish_channel_assignments(lcm);
+        chan_port = GPOINTER_TO_UINT(g_hash_table_lookup(
+                lcm->channel_to_port_map, channel));
     }
     // set the destination port
     lcm->dest_addr.sin_port = htons(chan_port);
 
     int payload_size = channel_size + 1 + datalen;
-    if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
+    if (payload_size <= lcm_short_message_max_size (lcm->params.mtu)) {
         // message is short.  send in a single packet
         lcm2_header_short_t hdr;
         hdr.magic = htonl(LCM2_MAGIC_SHORT);
@@ -1214,7 +2047,7 @@ publish_message_internal (lcm_mpudpm_t *lcm, const char *channel, const void *da
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
-        int status = sendmsg(lcm->send_fd, &msg, 0);
+        int status = send_datagram(lcm, channel, &msg);
 
         ++lcm->msg_seqno;
 
@@ -1222,7 +2055,7 @@ publish_message_internal (lcm_mpudpm_t *lcm, const char *channel, const void *da
         else return status;
     } else {
         // message is large.  fragment into multiple packets
-        int fragment_size = LCM_FRAGMENT_MAX_PAYLOAD;
+        int fragment_size = lcm_fragment_max_payload (lcm->params.mtu);
         int nfragments = payload_size / fragment_size +
                 !!(payload_size % fragment_size);
 
@@ -1263,7 +2096,8 @@ publish_message_internal (lcm_mpudpm_t *lcm, const char *channel, const void *da
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
-        int status = sendmsg(lcm->send_fd, &msg, 0);
+        lcm_pacer_wait (&lcm->pacer, packet_size);
+        int status = send_datagram(lcm, channel, &msg);
 
         // transmit the rest of the fragments
         for (uint16_t frag_no=1; 
@@ -1283,10 +2117,11 @@ publish_message_internal (lcm_mpudpm_t *lcm, const char *channel, const void *da
 
             msg.msg_iov = sendbufs;
             msg.msg_iovlen = 2;
-            status = sendmsg(lcm->send_fd, &msg, 0);
+            packet_size = sizeof (hdr) + fraglen;
+            lcm_pacer_wait (&lcm->pacer, packet_size);
+            status = send_datagram(lcm, channel, &msg);
 
             fragment_offset += fraglen;
-            packet_size = sizeof (hdr) + fraglen;
         }
 
         // sanity check
@@ -1312,70 +2147,148 @@ lcm_mpudpm_publish(lcm_mpudpm_t *lcm, const char *channel,
     // acquire lock so that we can call the internal publish function
     g_static_mutex_lock(&lcm->transmit_lock);
     int status = publish_message_internal(lcm, channel, data, datalen);
+    int channels_changed = lcm->changed_channels->len > 0;
     g_static_mutex_unlock(&lcm->transmit_lock);
+
+    // our own subscribers may want a channel that we just added or moved
+    if (channels_changed)
+        update_subscription_ports(lcm);
     return status;
 }
 
-int
-lcm_mpudpm_handle (lcm_mpudpm_t *lcm)
+static int
+lcm_mpudpm_get_stats (lcm_mpudpm_t *lcm, lcm_transport_stats_t *stats)
+{
+    memset (stats, 0, sizeof (lcm_transport_stats_t));
+    stats->ring_low_watermark = 1.0;
+
+    for (int i = 0; i < lcm->num_workers; i++) {
+        mpudpm_rx_worker_t *worker = &lcm->workers[i];
+        g_static_mutex_lock (&worker->stats_lock);
+        lcm_transport_stats_t *s = &worker->stats_snapshot;
+        stats->num_packets += s->num_packets;
+        stats->num_bytes += s->num_bytes;
+        stats->num_bad_packets += s->num_bad_packets;
+        stats->num_lost += s->num_lost;
+        stats->num_reordered += s->num_reordered;
+        stats->num_duplicated += s->num_duplicated;
+        stats->num_incomplete += s->num_incomplete;
+        stats->num_dropped_no_buffer += s->num_dropped_no_buffer;
+        stats->num_fec_recovered += s->num_fec_recovered;
+        stats->num_nacked += s->num_nacked;
+        stats->num_retransmitted += s->num_retransmitted;
+        stats->num_senders += s->num_senders;
+        stats->ring_low_watermark = MIN (stats->ring_low_watermark,
+                s->ring_low_watermark);
+        stats->frag_bytes_high_watermark += s->frag_bytes_high_watermark;
+        g_static_mutex_unlock (&worker->stats_lock);
+    }
+    return 0;
+}
+
+static int
+lcm_mpudpm_handle_batch (lcm_mpudpm_t *lcm, int max_msgs)
 {
     int status;
-    char ch;
     if(0 != setup_recv_parts (lcm)){
         return -1;
     }
 
-    /* Read one byte from the notify pipe.  This will block if no packets are
-     * available yet and wake up when they are. */
-    status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf (stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
-        return -1;
-    }
-    else if (status < 0) {
-        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
-        return -1;
+    /* Consume the notification if no packets are queued yet.  This blocks
+     * until they are.  While packets remain from an earlier call, the
+     * notification is left alone, so that draining a burst costs no system
+     * calls. */
+    g_static_mutex_lock (&lcm->receive_lock);
+    int consumed = lcm_buf_queue_is_empty (lcm->inbufs_filled);
+    g_static_mutex_unlock (&lcm->receive_lock);
+    if (consumed) {
+        status = lcm_internal_notify_wait(lcm->notify_pipe);
+        if (status == 0) {
+            fprintf (stderr,
+                    "Error: lcm_handle read 0 bytes from notify_pipe\n");
+            return -1;
+        }
+        else if (status < 0) {
+            fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
+            return -1;
+        }
     }
 
-    /* Dequeue the next received packet */
+    /* Dequeue up to max_msgs received packets */
     g_static_mutex_lock (&lcm->receive_lock);
-    lcm_buf_t * lcmb = lcm_buf_dequeue (lcm->inbufs_filled);
+    lcm_buf_t * batch = NULL;
+    lcm_buf_t ** batch_tail = &batch;
+    int num_msgs = 0;
+    while (num_msgs < max_msgs) {
+        lcm_buf_t * lcmb = lcm_buf_dequeue (lcm->inbufs_filled);
+        if (!lcmb)
+            break;
+        *batch_tail = lcmb;
+        batch_tail = &lcmb->next;
+        num_msgs++;
+    }
 
-    if (!lcmb) {
+    if (!num_msgs) {
         fprintf (stderr, 
                 "Error: no packet available despite getting notification.\n");
         g_static_mutex_unlock (&lcm->receive_lock);
         return -1;
     }
 
-    /* If there are still packets in the queue, put something back in the pipe
-     * so that future invocations will get called. */
-    if (!lcm_buf_queue_is_empty (lcm->inbufs_filled))
-        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
+    /* The notification has to be there exactly while packets remain.  The
+     * read threads signal under receive_lock, so one we did not consume is
+     * already in place. */
+    if (lcm_buf_queue_is_empty (lcm->inbufs_filled)) {
+        if (!consumed && lcm_internal_notify_wait(lcm->notify_pipe) <= 0)
+            perror ("read from notify");
+    } else if (consumed) {
+        if (lcm_internal_notify_signal(lcm->notify_pipe) < 0)
             perror ("write to notify");
+    }
     g_static_mutex_unlock (&lcm->receive_lock);
 
-    lcm_recv_buf_t rbuf;
-    rbuf.data = (uint8_t*) lcmb->buf + lcmb->data_offset;
-    rbuf.data_size = lcmb->data_size;
-    rbuf.recv_utime = lcmb->recv_utime;
-    rbuf.lcm = lcm->lcm;
-
-    if(lcm->creating_read_thread) {
-        // special case:  If we're creating the read thread and are in
-        // self-test mode, then only dispatch the self-test message.
-        if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
+    for (lcm_buf_t * lcmb = batch; lcmb; lcmb = lcmb->next) {
+        // reassembled messages are in their own malloc()ed buffer, which
+        // handlers may keep.  Pool buffers go back to the pool.
+        lcm_recv_buf_owner_t owner = { lcmb->pool ? NULL : lcmb->buf, NULL };
+        lcm_recv_buf_t rbuf;
+        rbuf.data = (uint8_t*) lcmb->buf + lcmb->data_offset;
+        rbuf.data_size = lcmb->data_size;
+        rbuf.recv_utime = lcmb->recv_utime;
+        rbuf.recv_time_ns = lcmb->recv_utime * 1000;
+        rbuf.lcm = lcm->lcm;
+        rbuf.owner = &owner;
+
+        if(lcm->creating_read_thread) {
+            // special case:  If we're creating the read thread and are in
+            // self-test mode, then only dispatch the self-test message.
+            if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
+                lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+        } else {
             lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
-    } else {
-        lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+        }
+
+        if (lcm_recv_buf_owner_finish (&owner))
+            lcmb->buf = NULL;
     }
 
     g_static_mutex_lock (&lcm->receive_lock);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
-    lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
+    while (batch) {
+        lcm_buf_t * lcmb = batch;
+        batch = lcmb->next;
+        lcm_buf_free_data(lcmb);
+        lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
+    }
     g_static_mutex_unlock (&lcm->receive_lock);
 
-    return 0;
+    return num_msgs;
+}
+
+int
+lcm_mpudpm_handle (lcm_mpudpm_t *lcm)
+{
+    int status = lcm_mpudpm_handle_batch (lcm, 1);
+    return status < 0 ? status : 0;
 }
 
 static void
@@ -1548,19 +2461,37 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
         goto add_recv_socket_fail;
     }
 
+    // the ports are dealt out to the read threads in turn
+    mpudpm_rx_worker_t *worker = &lcm->workers[
+        (port - lcm->params.mc_port_range_start) % lcm->num_workers];
     mpudpm_socket_t* subscriber_socket =
             (mpudpm_socket_t*) calloc(1, sizeof(mpudpm_socket_t));
     subscriber_socket->fd = recv_fd;
     subscriber_socket->port = port;
     subscriber_socket->num_subscribers =0;
+    subscriber_socket->worker = worker;
+#ifdef USE_EPOLL
+    // the read thread picks up the new socket without being woken up
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = subscriber_socket;
+    if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, recv_fd, &ev) < 0) {
+        perror ("epoll_ctl (EPOLL_CTL_ADD)");
+        free(subscriber_socket);
+        goto add_recv_socket_fail;
+    }
     lcm->recv_sockets = g_slist_prepend(lcm->recv_sockets, subscriber_socket);
-    lcm->recv_sockets_changed = 1;
+#else
+    lcm->recv_sockets = g_slist_prepend(lcm->recv_sockets, subscriber_socket);
+    worker->recv_sockets_changed = 1;
 
     // Tell read thread that a select should be canceled
-    int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "c", 1);
+    int wstatus = lcm_internal_pipe_write(worker->thread_msg_pipe[1], "c", 1);
     if (wstatus < 0) {
         perror(__FILE__ " thread_msg_pipe write: cancel_select");
     }
+#endif
     return subscriber_socket;
 
     add_recv_socket_fail:
@@ -1571,15 +2502,32 @@ add_recv_socket(lcm_mpudpm_t *lcm, uint16_t port){
 // This function assumes that the caller is holding the lcm->receive_lock
 static void
 remove_recv_socket(lcm_mpudpm_t *lcm, mpudpm_socket_t* sock){
+#ifdef USE_EPOLL
+    // the read thread may have events for sock that it has not looked at
+    // yet.  It discards them when it sees recv_sockets_changed.
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    if (epoll_ctl(sock->worker->epoll_fd, EPOLL_CTL_DEL, sock->fd, &ev) < 0)
+        perror ("epoll_ctl (EPOLL_CTL_DEL)");
+#else
     // Tell read thread that a select should be canceled
-    int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "c", 1);
+    int wstatus = lcm_internal_pipe_write(sock->worker->thread_msg_pipe[1],
+            "c", 1);
     if (wstatus < 0) {
         perror(__FILE__ " thread_msg_pipe write: cancel_select");
     }
-    lcm->recv_sockets_changed = 1;
+#endif
+    sock->worker->recv_sockets_changed = 1;
 
     lcm->recv_sockets = g_slist_remove(lcm->recv_sockets, sock);
-    mpudpm_socket_t_destroy(sock);
+    if (sock->worker->read_thread) {
+        // closing the socket now could make the read thread receive on a
+        // closed, or even reused, descriptor
+        sock->worker->removed_sockets =
+            g_slist_prepend(sock->worker->removed_sockets, sock);
+    } else {
+        mpudpm_socket_t_destroy(sock);
+    }
 }
 
 static int
@@ -1630,33 +2578,55 @@ setup_recv_parts (lcm_mpudpm_t *lcm)
 
     dbg (DBG_LCM, "allocating resources for receiving messages\n");
 
-    // allocate the fragment buffer hashtable
-    lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE,
-            MAX_NUM_FRAG_BUFS);
-
     lcm->inbufs_empty = lcm_buf_queue_new ();
     lcm->inbufs_filled = lcm_buf_queue_new ();
-    lcm->ringbuf = lcm_ringbuf_new (LCM_RINGBUF_SIZE);
+    lcm->pool = lcm_bufpool_new (lcm->params.recv_pool_size);
 
     for (int i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
         /* We don't set the receive buffer's data pointer yet because it
-         * will be taken from the ringbuffer at receive time. */
+         * will be taken from the pool at receive time. */
         lcm_buf_t * lcmb = (lcm_buf_t *) calloc (1, sizeof (lcm_buf_t));
         lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
     }
 
-    // setup a pipe for notifying the reader thread when to quit
-    if(0 != lcm_internal_pipe_create(lcm->thread_msg_pipe)) {
-        perror(__FILE__ " pipe(setup)");
-        goto setup_recv_thread_fail;
-    }
-    fcntl (lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
+    for (int i = 0; i < lcm->num_workers; i++) {
+        mpudpm_rx_worker_t *worker = &lcm->workers[i];
+
+        // allocate the fragment buffer hashtable
+        worker->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE,
+                MAX_NUM_FRAG_BUFS);
 
-    /* Start the reader thread */
-    lcm->read_thread = g_thread_create (recv_thread, lcm, TRUE, NULL);
-    if (!lcm->read_thread) {
-        fprintf (stderr, "Error: LCM failed to start reader thread\n");
-        goto setup_recv_thread_fail;
+        // setup a pipe for notifying the reader thread when to quit
+        if(0 != lcm_internal_pipe_create(worker->thread_msg_pipe)) {
+            perror(__FILE__ " pipe(setup)");
+            goto setup_recv_thread_fail;
+        }
+        fcntl (worker->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
+
+#ifdef USE_EPOLL
+        worker->epoll_fd = epoll_create(MAX_EPOLL_EVENTS);
+        if (worker->epoll_fd < 0) {
+            perror(__FILE__ " epoll_create");
+            goto setup_recv_thread_fail;
+        }
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD,
+                    worker->thread_msg_pipe[0], &ev) < 0) {
+            perror(__FILE__ " epoll_ctl(thread_msg_pipe)");
+            goto setup_recv_thread_fail;
+        }
+#endif
+
+        /* Start the reader thread */
+        worker->read_thread = g_thread_create (recv_thread, worker, TRUE,
+                NULL);
+        if (!worker->read_thread) {
+            fprintf (stderr, "Error: LCM failed to start reader thread\n");
+            goto setup_recv_thread_fail;
+        }
     }
     lcm->recv_thread_created = 1;
 
@@ -1677,17 +2647,25 @@ setup_recv_parts (lcm_mpudpm_t *lcm)
 
     g_static_mutex_unlock(&lcm->receive_lock);
 
-    // conduct a self-test just to make sure everything is working.
-    dbg (DBG_LCM, "LCM: conducting self test\n");
-    int self_test_results = mpudpm_self_test(lcm);
+    int self_test_results = 0;
+    if (!lcm->params.no_self_test) {
+        // conduct a self-test just to make sure everything is working.
+        dbg (DBG_LCM, "LCM: conducting self test\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_PENDING);
+        self_test_results = mpudpm_self_test(lcm);
+    }
     g_static_mutex_lock(&lcm->receive_lock);
 
-    if (0 == self_test_results) {
+    if (lcm->params.no_self_test) {
+        dbg (DBG_LCM, "LCM: self test disabled\n");
+    } else if (0 == self_test_results) {
         dbg (DBG_LCM, "LCM: self test successful\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_PASSED);
     } else {
         // self test failed.  destroy the read thread
         fprintf (stderr, "LCM self test failed!!\n"
                 "Check your routing tables and firewall settings\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_FAILED);
         destroy_recv_parts (lcm);
     }
 
@@ -1717,11 +2695,15 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 {
     mpudpm_params_t params;
     memset (&params, 0, sizeof (mpudpm_params_t));
+    params.recv_pool_size = LCM_DEFAULT_RECV_POOL_SIZE;
     params.num_mc_ports = 500;
+    params.recv_threads = 1;
 
     g_hash_table_foreach ((GHashTable*) args, new_argument, &params);
 
     if (parse_mc_addr_and_port (network, &params) < 0) {
+        free (params.rx_cpu);
+        free (params.rx_sched);
         return NULL;
     }
 
@@ -1729,28 +2711,40 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 
     lcm->lcm = parent;
     lcm->params = params;
+    lcm_pacer_init (&lcm->pacer, params.max_rate_mbps, params.burst_kb);
     lcm->recv_sockets = NULL;
     lcm->send_fd = -1;
-    lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
+    lcm->num_workers = params.recv_threads;
+    lcm->workers = (mpudpm_rx_worker_t *) calloc (lcm->num_workers,
+            sizeof (mpudpm_rx_worker_t));
+    for (int i = 0; i < lcm->num_workers; i++) {
+        mpudpm_rx_worker_t *worker = &lcm->workers[i];
+        worker->lcm = lcm;
+        worker->index = i;
+        worker->thread_msg_pipe[0] = worker->thread_msg_pipe[1] = -1;
+#ifdef USE_EPOLL
+        worker->epoll_fd = -1;
+#endif
+        worker->stats.ring_low_watermark = 1.0;
+        worker->stats_snapshot = worker->stats;
+        worker->seq_tracker = lcm_seq_tracker_new(0);
+        g_static_mutex_init(&worker->stats_lock);
+    }
 
     lcm->kernel_rbuf_sz = 0;
     lcm->warned_about_small_kernel_buf = 0;
 
-    lcm->frag_bufs = NULL;
-
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
     lcm->create_read_thread_mutex = NULL;
     lcm->create_read_thread_cond = NULL;
 
     // internal notification pipe
-    if(0 != lcm_internal_pipe_create(lcm->notify_pipe)) {
+    if(0 != lcm_internal_notify_create(lcm->notify_pipe)) {
         perror(__FILE__ " pipe(create)");
         lcm_mpudpm_destroy (lcm);
         return NULL;
     }
-    fcntl (lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
 
     g_static_mutex_init (&lcm->receive_lock);
     g_static_mutex_init (&lcm->transmit_lock);
@@ -1765,18 +2759,14 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     // but store shorts as pointers so no destroy function for values
     lcm->channel_to_port_map = g_hash_table_new_full(g_str_hash, g_str_equal,
             free, NULL );
-
-    // Create a regex to find whether subscribers use a regex to get a set of
-    // channels instead of just listening to a single channel.
-    GError *rerr = NULL;
-    lcm->regex_finder_re = g_regex_new(REGEX_FINDER_RE, (GRegexCompileFlags) 0,
-            (GRegexMatchFlags) 0, &rerr);
-    if (rerr) {
-        fprintf(stderr, "%s: %s\n", __FUNCTION__, rerr->message);
-        g_error_free(rerr);
-        lcm_mpudpm_destroy(lcm);
-        return NULL;
-    }
+    lcm->channel_loads = g_hash_table_new_full(g_str_hash, g_str_equal,
+            free, free);
+    lcm->last_load_utime = lcm_clock_realtime_us();
+    lcm->peer_delta_versions = g_hash_table_new_full(g_int64_hash,
+            g_int64_equal, free, NULL);
+    lcm->node_id = ((int64_t) g_random_int() << 32) | g_random_int();
+    lcm->sub_matcher = lcm_channel_matcher_new();
+    lcm->changed_channels = g_ptr_array_new();
 
 
     // put all the internal channels into the channel_to_port_map
@@ -1786,6 +2776,12 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     g_hash_table_insert(lcm->channel_to_port_map,
             strdup(CHANNEL_TO_PORT_MAP_REQUEST_CHANNEL),
             GUINT_TO_POINTER(lcm->params.mc_port_range_start));
+    g_hash_table_insert(lcm->channel_to_port_map,
+            strdup(CHANNEL_TO_PORT_ASSIGN_CHANNEL),
+            GUINT_TO_POINTER(lcm->params.mc_port_range_start));
+    g_hash_table_insert(lcm->channel_to_port_map,
+            strdup(CHANNEL_TO_PORT_MAP_DELTA_CHANNEL),
+            GUINT_TO_POINTER(lcm->params.mc_port_range_start));
     g_hash_table_insert(lcm->channel_to_port_map, strdup(SELF_TEST_CHANNEL),
             GUINT_TO_POINTER(map_channel_to_port(lcm, SELF_TEST_CHANNEL)));
 
@@ -1815,6 +2811,7 @@ lcm_mpudpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     // don't use connect() on the actual transmit socket, because linux then
     // has problems multicasting to localhost
     lcm->send_fd = socket (AF_INET, SOCK_DGRAM, 0);
+    lcm->faults = lcm_fault_injector_new (&params.faults, 0);
 
     // set multicast TTL
     if (params.mc_ttl == 0) {
@@ -1889,7 +2886,9 @@ static lcm_provider_vtable_t mpudpm_vtable = {
     .unsubscribe = lcm_mpudpm_unsubscribe,
     .publish     = lcm_mpudpm_publish,
     .handle      = lcm_mpudpm_handle,
-    .get_fileno  = lcm_mpudpm_get_fileno
+    .get_fileno  = lcm_mpudpm_get_fileno,
+    .handle_batch = lcm_mpudpm_handle_batch,
+    .get_stats   = lcm_mpudpm_get_stats
 };
 #endif
 static lcm_provider_info_t mpudpm_info;
@@ -1907,6 +2906,8 @@ lcm_mpudpm_provider_init (GPtrArray * providers)
     mpudpm_vtable.publish     = lcm_mpudpm_publish;
     mpudpm_vtable.handle      = lcm_mpudpm_handle;
     mpudpm_vtable.get_fileno  = lcm_mpudpm_get_fileno;
+    mpudpm_vtable.handle_batch = lcm_mpudpm_handle_batch;
+    mpudpm_vtable.get_stats   = lcm_mpudpm_get_stats;
 #endif
     mpudpm_info.name = "mpudpm";
     mpudpm_info.vtable = &mpudpm_vtable;
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include "lcm.h"
+
+#ifdef WIN32
+#include "windows/WinPorting.h"
+#include <winsock2.h>
+#define poll WSAPoll
+typedef WSAPOLLFD lcm_pollfd_t;
+#else
+#include <poll.h>
+typedef int SOCKET;
+typedef struct pollfd lcm_pollfd_t;
+#endif
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#define USE_EPOLL
+#endif
+
+struct _lcm_poll_set_t {
+    GPtrArray *lcms;  // lcm_t*, in the order they were added
+#ifdef USE_EPOLL
+    int epoll_fd;
+    struct epoll_event *events;
+    int events_size;
+#else
+    lcm_pollfd_t *pfds;
+    int pfds_size;
+#endif
+};
+
+lcm_poll_set_t *
+lcm_poll_set_create (void)
+{
+    lcm_poll_set_t *set = (lcm_poll_set_t *) calloc (1, sizeof (lcm_poll_set_t));
+#ifdef USE_EPOLL
+    set->epoll_fd = epoll_create (16);
+    if (set->epoll_fd < 0) {
+        perror ("lcm_poll_set_create - epoll_create");
+        free (set);
+        return NULL;
+    }
+#endif
+    set->lcms = g_ptr_array_new ();
+    return set;
+}
+
+void
+lcm_poll_set_destroy (lcm_poll_set_t *set)
+{
+#ifdef USE_EPOLL
+    close (set->epoll_fd);
+    free (set->events);
+#else
+    free (set->pfds);
+#endif
+    g_ptr_array_free (set->lcms, TRUE);
+    free (set);
+}
+
+static int
+poll_set_index (lcm_poll_set_t *set, lcm_t *lcm)
+{
+    for (unsigned int i = 0; i < set->lcms->len; i++) {
+        if (g_ptr_array_index (set->lcms, i) == lcm)
+            return i;
+    }
+    return -1;
+}
+
+int
+lcm_poll_set_add (lcm_poll_set_t *set, lcm_t *lcm)
+{
+    if (poll_set_index (set, lcm) >= 0)
+        return -1;
+    int fd = lcm_get_fileno (lcm);
+    if (fd < 0)
+        return -1;
+
+#ifdef USE_EPOLL
+    struct epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = lcm;
+    if (epoll_ctl (set->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        perror ("lcm_poll_set_add - epoll_ctl");
+        return -1;
+    }
+#endif
+    g_ptr_array_add (set->lcms, lcm);
+    return 0;
+}
+
+int
+lcm_poll_set_remove (lcm_poll_set_t *set, lcm_t *lcm)
+{
+    int index = poll_set_index (set, lcm);
+    if (index < 0)
+        return -1;
+
+#ifdef USE_EPOLL
+    struct epoll_event ev;
+    memset (&ev, 0, sizeof (ev));
+    if (epoll_ctl (set->epoll_fd, EPOLL_CTL_DEL, lcm_get_fileno (lcm), &ev) < 0)
+        perror ("lcm_poll_set_remove - epoll_ctl");
+#endif
+    g_ptr_array_remove_index (set->lcms, index);
+    return 0;
+}
+
+int
+lcm_poll_set_handle_timeout (lcm_poll_set_t *set, int timeout_millis)
+{
+    if (timeout_millis < 0)
+        return -1;
+    int num_lcms = set->lcms->len;
+    if (!num_lcms)
+        return -1;
+
+    int num_handled = 0;
+#ifdef USE_EPOLL
+    if (set->events_size < num_lcms) {
+        set->events = (struct epoll_event *) realloc (set->events,
+                num_lcms * sizeof (struct epoll_event));
+        set->events_size = num_lcms;
+    }
+    int nready = epoll_wait (set->epoll_fd, set->events, num_lcms,
+            timeout_millis);
+    if (nready < 0)
+        return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < nready; i++) {
+        lcm_t *lcm = (lcm_t *) set->events[i].data.ptr;
+        if (0 != lcm_handle (lcm))
+            return -1;
+        num_handled++;
+    }
+#else
+    if (set->pfds_size < num_lcms) {
+        set->pfds = (lcm_pollfd_t *) realloc (set->pfds,
+                num_lcms * sizeof (lcm_pollfd_t));
+        set->pfds_size = num_lcms;
+    }
+    for (int i = 0; i < num_lcms; i++) {
+        set->pfds[i].fd = (SOCKET) lcm_get_fileno (
+                (lcm_t *) g_ptr_array_index (set->lcms, i));
+        set->pfds[i].events = POLLIN;
+        set->pfds[i].revents = 0;
+    }
+    int nready = poll (set->pfds, num_lcms, timeout_millis);
+    if (nready < 0)
+        return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < num_lcms && nready > 0; i++) {
+        if (!(set->pfds[i].revents & POLLIN))
+            continue;
+        nready--;
+        if (0 != lcm_handle ((lcm_t *) g_ptr_array_index (set->lcms, i)))
+            return -1;
+        num_handled++;
+    }
+#endif
+    return num_handled;
+}
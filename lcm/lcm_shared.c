@@ -0,0 +1,495 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <signal.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#else
+#include "windows/WinPorting.h"
+#include <Winsock2.h>
+#endif
+
+#include "lcm_internal.h"
+#include "dbg.h"
+
+/*
+ * The instances created with shared://URL share, within the process, one
+ * instance of URL: a single lcm_t with its sockets, receive threads and
+ * reassembly buffers, however many of them there are.  A fan-out thread
+ * handles the messages of that instance and passes each one, once, to every
+ * shared instance subscribed to its channel.  The instances queue the
+ * message, which they share, until their own lcm_handle(), so that each one
+ * keeps its own handlers, threads and subscription queue capacities.
+ *
+ * Publishing goes to the underlying instance, and so do the channel patterns
+ * subscribed to, each one once however many shared instances subscribe to
+ * it.  The underlying instance is destroyed with the last shared instance.
+ */
+
+// the most messages the fan-out thread takes from the underlying instance at
+// a time
+#define SHARED_FAN_OUT_BATCH 64
+
+// A received message, queued on all the shared instances it is for.  The
+// channel and the payload follow the struct.
+typedef struct _shared_msg shared_msg_t;
+struct _shared_msg {
+    int ref;  // atomic access
+    char *channel;
+    lcm_recv_buf_t rbuf;
+};
+
+// a channel pattern subscribed to on the underlying instance
+typedef struct _shared_pattern shared_pattern_t;
+struct _shared_pattern {
+    lcm_subscription_t *subs;
+    int count;  // shared instances subscribed to it
+};
+
+typedef struct _lcm_provider_t lcm_shared_t;
+
+// The underlying instance of one URL, in shared_cores
+typedef struct _shared_core shared_core_t;
+struct _shared_core {
+    char *url;
+    lcm_t *lcm;
+    int ref;  // guarded by shared_cores_lock
+
+    GThread *fan_out_thread;
+    int exit_pipe[2];  // tells fan_out_thread to quit
+
+    // the shared instances.  Held by the fan-out thread while it queues
+    // a message, so that they can not go away in the meantime.
+    GStaticMutex clients_lock;
+    GPtrArray *clients;
+
+    // channel pattern -> shared_pattern_t.  Held while subscribing, which
+    // may wait for the fan-out thread, so never taken by it.
+    GStaticMutex patterns_lock;
+    GHashTable *patterns;
+};
+
+struct _lcm_provider_t {
+    lcm_t *lcm;
+    shared_core_t *core;
+
+    GStaticMutex queue_lock;  // guards queue
+    GQueue *queue;
+    int notify_pipe[2];  // holds a token while the queue is not empty
+};
+
+// URL -> shared_core_t
+static GStaticMutex shared_cores_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *shared_cores = NULL;
+
+static void
+shared_msg_unref (shared_msg_t *msg)
+{
+    if (g_atomic_int_dec_and_test (&msg->ref))
+        free (msg);
+}
+
+static shared_msg_t *
+shared_msg_new (const lcm_recv_buf_t *rbuf, const char *channel)
+{
+    int channel_size = strlen (channel) + 1;
+    shared_msg_t *msg = (shared_msg_t *) malloc (sizeof (shared_msg_t) +
+            channel_size + rbuf->data_size);
+    msg->ref = 1;
+    msg->channel = (char *) (msg + 1);
+    memcpy (msg->channel, channel, channel_size);
+    msg->rbuf = *rbuf;
+    msg->rbuf.data = msg->channel + channel_size;
+    memcpy (msg->rbuf.data, rbuf->data, rbuf->data_size);
+    msg->rbuf.owner = NULL;
+    return msg;
+}
+
+// Dispatch tap of the underlying instance: queues the message on every
+// shared instance that has room for it.
+static void
+shared_fan_out (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    shared_core_t *core = (shared_core_t *) user;
+    shared_msg_t *msg = NULL;
+
+    g_static_mutex_lock (&core->clients_lock);
+    for (unsigned int i = 0; i < core->clients->len; i++) {
+        lcm_shared_t *self = (lcm_shared_t *) g_ptr_array_index (
+                core->clients, i);
+        if (!lcm_try_enqueue_message (self->lcm, channel))
+            continue;
+        if (!msg)
+            msg = shared_msg_new (rbuf, channel);
+        g_atomic_int_inc (&msg->ref);
+
+        g_static_mutex_lock (&self->queue_lock);
+        g_queue_push_tail (self->queue, msg);
+        int was_empty = g_queue_get_length (self->queue) == 1;
+        g_static_mutex_unlock (&self->queue_lock);
+        if (was_empty && lcm_internal_notify_signal (self->notify_pipe) < 0)
+            perror (__FILE__ " - write to notify pipe (shared_fan_out)");
+    }
+    g_static_mutex_unlock (&core->clients_lock);
+
+    if (msg)
+        shared_msg_unref (msg);
+}
+
+// the subscriptions on the underlying instance only make it receive the
+// channels.  shared_fan_out() passes the messages on.
+static void
+shared_ignore (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+}
+
+static void *
+shared_fan_out_thread (void *user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    shared_core_t *core = (shared_core_t *) user;
+    lcm_internal_thread_init ("shared-fanout", NULL, NULL);
+    int lcm_fd = lcm_get_fileno (core->lcm);
+    while (1) {
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (core->exit_pipe[0], &fds);
+        FD_SET (lcm_fd, &fds);
+        int maxfd = MAX (core->exit_pipe[0], lcm_fd);
+        if (select (maxfd + 1, &fds, NULL, NULL, NULL) <= 0) {
+            if (errno != EINTR)
+                perror ("shared fan-out thread -- select");
+            continue;
+        }
+        if (FD_ISSET (core->exit_pipe[0], &fds))
+            break;
+        if (FD_ISSET (lcm_fd, &fds) &&
+                lcm_handle_batch (core->lcm, SHARED_FAN_OUT_BATCH, 0) < 0)
+            break;
+    }
+    return NULL;
+}
+
+static void
+shared_pattern_free (gpointer data)
+{
+    free (data);
+}
+
+// Must be called with shared_cores_lock held.
+static void
+shared_core_destroy (shared_core_t *core)
+{
+    if (core->fan_out_thread) {
+        if (lcm_internal_pipe_write (core->exit_pipe[1], "\0", 1) < 0)
+            perror (__FILE__ " write(exit)");
+        else
+            g_thread_join (core->fan_out_thread);
+    }
+    if (core->exit_pipe[0] >= 0) {
+        lcm_internal_pipe_close (core->exit_pipe[0]);
+        lcm_internal_pipe_close (core->exit_pipe[1]);
+    }
+    if (core->lcm)
+        lcm_destroy (core->lcm);
+    g_hash_table_destroy (core->patterns);
+    g_ptr_array_free (core->clients, TRUE);
+    g_static_mutex_free (&core->patterns_lock);
+    g_static_mutex_free (&core->clients_lock);
+    free (core->url);
+    free (core);
+}
+
+// Must be called with shared_cores_lock held.
+static shared_core_t *
+shared_core_new (const char *url)
+{
+    shared_core_t *core = (shared_core_t *) calloc (1, sizeof (shared_core_t));
+    core->url = strdup (url);
+    core->exit_pipe[0] = core->exit_pipe[1] = -1;
+    g_static_mutex_init (&core->clients_lock);
+    core->clients = g_ptr_array_new ();
+    g_static_mutex_init (&core->patterns_lock);
+    core->patterns = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+            shared_pattern_free);
+
+    dbg (DBG_LCM, "creating the shared instance of %s\n", url);
+    core->lcm = lcm_create (url);
+    if (!core->lcm) {
+        shared_core_destroy (core);
+        return NULL;
+    }
+    lcm_internal_set_dispatch_tap (core->lcm, shared_fan_out, core);
+
+    if (0 != lcm_internal_pipe_create (core->exit_pipe)) {
+        perror (__FILE__ " pipe(exit)");
+        shared_core_destroy (core);
+        return NULL;
+    }
+    core->fan_out_thread = g_thread_create (shared_fan_out_thread, core, TRUE,
+            NULL);
+    if (!core->fan_out_thread) {
+        fprintf (stderr, "Error: LCM failed to start the fan-out thread\n");
+        shared_core_destroy (core);
+        return NULL;
+    }
+    return core;
+}
+
+static int
+shared_compare_keys (gconstpointer a, gconstpointer b)
+{
+    return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static void
+shared_collect_key (gpointer key, gpointer value, gpointer user)
+{
+    g_ptr_array_add ((GPtrArray *) user, key);
+}
+
+// Rebuilds the URL to share from the network and options of the shared://
+// URL, with the options sorted so that their order does not matter.
+static char *
+shared_url (const char *network, const GHashTable *args)
+{
+    GString *url = g_string_new (network);
+    GPtrArray *keys = g_ptr_array_new ();
+    g_hash_table_foreach ((GHashTable *) args, shared_collect_key, keys);
+    g_ptr_array_sort (keys, shared_compare_keys);
+    for (unsigned int i = 0; i < keys->len; i++) {
+        const char *key = (const char *) g_ptr_array_index (keys, i);
+        g_string_append_printf (url, "%c%s=%s", i ? '&' : '?', key,
+                (const char *) g_hash_table_lookup ((GHashTable *) args, key));
+    }
+    g_ptr_array_free (keys, TRUE);
+    return g_string_free (url, FALSE);
+}
+
+static void
+lcm_shared_destroy (lcm_shared_t *self)
+{
+    dbg (DBG_LCM, "destroying LCM shared provider context\n");
+    if (self->core) {
+        shared_core_t *core = self->core;
+        g_static_mutex_lock (&core->clients_lock);
+        g_ptr_array_remove (core->clients, self);
+        g_static_mutex_unlock (&core->clients_lock);
+
+        g_static_mutex_lock (&shared_cores_lock);
+        if (--core->ref == 0) {
+            g_hash_table_remove (shared_cores, core->url);
+            shared_core_destroy (core);
+        }
+        g_static_mutex_unlock (&shared_cores_lock);
+    }
+
+    shared_msg_t *msg;
+    while ((msg = (shared_msg_t *) g_queue_pop_head (self->queue)))
+        shared_msg_unref (msg);
+    g_queue_free (self->queue);
+    g_static_mutex_free (&self->queue_lock);
+    lcm_internal_notify_close (self->notify_pipe);
+    free (self);
+}
+
+static lcm_provider_t *
+lcm_shared_create (lcm_t *parent, const char *network, const GHashTable *args)
+{
+    if (!network || !*network) {
+        fprintf (stderr, "Error: shared:// needs the URL of the LCM instance "
+                "to share\n");
+        return NULL;
+    }
+
+    lcm_shared_t *self = (lcm_shared_t *) calloc (1, sizeof (lcm_shared_t));
+    self->lcm = parent;
+    g_static_mutex_init (&self->queue_lock);
+    self->queue = g_queue_new ();
+    if (lcm_internal_notify_create (self->notify_pipe) != 0) {
+        perror (__FILE__ " - pipe (notify)");
+        self->notify_pipe[0] = self->notify_pipe[1] = -1;
+        lcm_shared_destroy (self);
+        return NULL;
+    }
+
+    char *url = shared_url (network, args);
+    g_static_mutex_lock (&shared_cores_lock);
+    if (!shared_cores)
+        shared_cores = g_hash_table_new (g_str_hash, g_str_equal);
+    shared_core_t *core = (shared_core_t *) g_hash_table_lookup (shared_cores,
+            url);
+    if (!core) {
+        core = shared_core_new (url);
+        if (core)
+            g_hash_table_insert (shared_cores, core->url, core);
+    }
+    if (core)
+        core->ref++;
+    g_static_mutex_unlock (&shared_cores_lock);
+    g_free (url);
+    if (!core) {
+        lcm_shared_destroy (self);
+        return NULL;
+    }
+
+    self->core = core;
+    g_static_mutex_lock (&core->clients_lock);
+    g_ptr_array_add (core->clients, self);
+    g_static_mutex_unlock (&core->clients_lock);
+    return self;
+}
+
+static int
+lcm_shared_subscribe (lcm_shared_t *self, const char *channel)
+{
+    shared_core_t *core = self->core;
+    int status = 0;
+    g_static_mutex_lock (&core->patterns_lock);
+    shared_pattern_t *pat = (shared_pattern_t *) g_hash_table_lookup (
+            core->patterns, channel);
+    if (!pat) {
+        lcm_subscription_t *subs = lcm_subscribe (core->lcm, channel,
+                shared_ignore, NULL);
+        if (subs) {
+            // the queues that count are those of the shared instances
+            lcm_subscription_set_queue_capacity (subs, 0);
+            pat = (shared_pattern_t *) calloc (1, sizeof (shared_pattern_t));
+            pat->subs = subs;
+            g_hash_table_insert (core->patterns, strdup (channel), pat);
+        } else {
+            status = -1;
+        }
+    }
+    if (pat)
+        pat->count++;
+    g_static_mutex_unlock (&core->patterns_lock);
+    return status;
+}
+
+static int
+lcm_shared_unsubscribe (lcm_shared_t *self, const char *channel)
+{
+    shared_core_t *core = self->core;
+    g_static_mutex_lock (&core->patterns_lock);
+    shared_pattern_t *pat = (shared_pattern_t *) g_hash_table_lookup (
+            core->patterns, channel);
+    if (pat && --pat->count == 0) {
+        lcm_unsubscribe (core->lcm, pat->subs);
+        g_hash_table_remove (core->patterns, channel);
+    }
+    g_static_mutex_unlock (&core->patterns_lock);
+    return 0;
+}
+
+static int
+lcm_shared_publish (lcm_shared_t *self, const char *channel, const void *data,
+        unsigned int datalen)
+{
+    return lcm_publish (self->core->lcm, channel, data, datalen);
+}
+
+static int
+lcm_shared_get_fileno (lcm_shared_t *self)
+{
+    return self->notify_pipe[0];
+}
+
+static int
+lcm_shared_handle_batch (lcm_shared_t *self, int max_msgs)
+{
+    int status = lcm_internal_notify_wait (self->notify_pipe);
+    if (status == 0) {
+        fprintf (stderr,
+                "Error: lcm_shared_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    } else if (status < 0) {
+        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
+        return -1;
+    }
+
+    int num_msgs = 0;
+    int num_left = 0;
+    while (num_msgs < max_msgs) {
+        g_static_mutex_lock (&self->queue_lock);
+        shared_msg_t *msg = (shared_msg_t *) g_queue_pop_head (self->queue);
+        num_left = g_queue_get_length (self->queue);
+        g_static_mutex_unlock (&self->queue_lock);
+        if (!msg)
+            break;
+
+        dbg (DBG_LCM, "Dispatching message on channel [%s], size [%d]\n",
+                msg->channel, msg->rbuf.data_size);
+        lcm_recv_buf_t rbuf = msg->rbuf;
+        rbuf.lcm = self->lcm;
+        lcm_dispatch_handlers (self->lcm, &rbuf, msg->channel);
+        shared_msg_unref (msg);
+        num_msgs++;
+        if (!num_left)
+            break;
+    }
+
+    // the token was taken, so one is due for the messages still queued
+    if (num_left && lcm_internal_notify_signal (self->notify_pipe) < 0)
+        perror (__FILE__ " - write to notify pipe (lcm_shared_handle)");
+    return num_msgs;
+}
+
+static int
+lcm_shared_handle (lcm_shared_t *self)
+{
+    int status = lcm_shared_handle_batch (self, 1);
+    return status < 0 ? status : 0;
+}
+
+static int
+lcm_shared_get_stats (lcm_shared_t *self, lcm_transport_stats_t *stats)
+{
+    return lcm_get_transport_stats (self->core->lcm, stats);
+}
+
+#ifdef WIN32
+static lcm_provider_vtable_t shared_vtable;
+#else
+static lcm_provider_vtable_t shared_vtable = {
+    .create      = lcm_shared_create,
+    .destroy     = lcm_shared_destroy,
+    .subscribe   = lcm_shared_subscribe,
+    .unsubscribe = lcm_shared_unsubscribe,
+    .publish     = lcm_shared_publish,
+    .handle      = lcm_shared_handle,
+    .get_fileno  = lcm_shared_get_fileno,
+    .handle_batch = lcm_shared_handle_batch,
+    .get_stats   = lcm_shared_get_stats
+};
+#endif
+static lcm_provider_info_t shared_info;
+
+void
+lcm_shared_provider_init (GPtrArray * providers)
+{
+#ifdef WIN32
+    shared_vtable.create      = lcm_shared_create;
+    shared_vtable.destroy     = lcm_shared_destroy;
+    shared_vtable.subscribe   = lcm_shared_subscribe;
+    shared_vtable.unsubscribe = lcm_shared_unsubscribe;
+    shared_vtable.publish     = lcm_shared_publish;
+    shared_vtable.handle      = lcm_shared_handle;
+    shared_vtable.get_fileno  = lcm_shared_get_fileno;
+    shared_vtable.handle_batch = lcm_shared_handle_batch;
+    shared_vtable.get_stats   = lcm_shared_get_stats;
+#endif
+    shared_info.name = "shared";
+    shared_info.vtable = &shared_vtable;
+
+    g_ptr_array_add (providers, &shared_info);
+}
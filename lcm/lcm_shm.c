@@ -0,0 +1,715 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ctype.h>
+#include <inttypes.h>
+
+#include "lcm_internal.h"
+#include "lcm_clock.h"
+#include "dbg.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+/*
+ * Same-host provider.  All the instances created with the same shm://NAME map
+ * one ring of messages in the shared memory segment /lcm-NAME.
+ *
+ * Publishers reserve space for a message by advancing the ring's head with an
+ * atomic add, copy the message in, and then commit it by storing its
+ * position in its header.  There is no lock, so publishers in different
+ * processes never wait for each other.  Each receiving instance follows the
+ * ring at its own pace from a read thread, copies out the messages that it
+ * has handlers for, and queues them for lcm_handle().  Like a datagram
+ * socket, the ring never waits for slow readers: publishers overwrite the
+ * oldest messages, and a reader that was lapped counts the messages it
+ * missed and carries on from the head.
+ *
+ * A reader cannot tell from the bytes it copied whether a publisher was
+ * overwriting them at the same time, so it checks the head afterwards, as
+ * with a seqlock: the copy is good if no publisher has reserved space one
+ * ring length past the message.  That does not cover a publisher that was
+ * descheduled between reserving its space and copying its message in, while
+ * the others went once around the ring, and which then writes over newer
+ * messages.  Each message therefore carries a checksum, and a reader drops
+ * the messages that do not match it.  Readers with nothing to read sleep on
+ * a futex in the segment, which publishers only wake when someone is
+ * waiting.
+ */
+
+#define SHM_MAGIC 0x4c434d53            // "LCMS"
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 4096            // ring header, one page
+#define SHM_RECORD_ALIGN 64             // records start on cache lines
+#define SHM_PAD_RECORD 0xffff           // channel_len of a padding record
+#define SHM_DEFAULT_SIZE_MB 32
+#define SHM_STUCK_USEC 1000000          // see read_thread
+
+typedef struct _shm_ring_header shm_ring_header_t;
+struct _shm_ring_header {
+    uint32_t magic;             // stored last by the creator
+    uint32_t version;
+    uint64_t capacity;          // bytes in the ring, a power of two
+    char pad0[48];
+
+    uint64_t head;              // position of the next byte to reserve
+    uint64_t next_seq;          // number of the next message published
+    char pad1[48];
+
+    uint32_t commit_count;      // futex word, changes with each commit
+    uint32_t num_waiters;       // readers sleeping on commit_count
+};
+
+// Positions are byte counts since the ring was created, so that a header
+// left over from an earlier lap never holds the position being read.  A
+// record never wraps around the end of the ring: a publisher whose space
+// would, fills it with a padding record and reserves again.
+typedef struct _shm_record shm_record_t;
+struct _shm_record {
+    uint64_t pos;               // position of the record once committed
+    uint64_t seq;               // from next_seq, to count the lost messages
+    int64_t  utime;             // when it was published
+    uint32_t size;              // bytes reserved, header included
+    uint32_t data_size;
+    uint16_t channel_len;       // or SHM_PAD_RECORD
+    char     pad[6];
+    uint64_t checksum;          // see shm_record_checksum
+    // channel_len bytes of channel name, then data_size bytes of data
+};
+
+typedef struct _shm_msg shm_msg_t;
+struct _shm_msg {
+    char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    lcm_recv_buf_t rbuf;
+};
+
+typedef struct _lcm_provider_t lcm_shm_t;
+struct _lcm_provider_t {
+    lcm_t *lcm;
+
+    char *shm_name;
+    int64_t size_mb;
+    char *rx_cpu;
+    char *rx_sched;
+
+    shm_ring_header_t *header;
+    char *ring;
+    uint64_t mask;              // capacity - 1
+    size_t map_size;
+
+    GThread *read_thread;
+    uint64_t start_pos;         // where the read thread starts reading
+    uint64_t start_seq;         // and the message number there
+    int stopping;               // atomic access
+
+    // messages copied out by the read thread, guarded by mutex
+    GQueue *queue;
+    GMutex *mutex;
+    int notify_pipe[2];
+
+    GStaticMutex stats_lock;
+    lcm_transport_stats_t stats;
+};
+
+static int
+futex_wait (uint32_t *addr, uint32_t val, int timeout_millis)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout_millis / 1000;
+    ts.tv_nsec = (timeout_millis % 1000) * 1000000;
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, &ts, NULL, 0);
+}
+
+static void
+futex_wake_all (uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT32_MAX, NULL, NULL, 0);
+}
+
+static void
+shm_notify_readers (shm_ring_header_t *header)
+{
+    __atomic_add_fetch(&header->commit_count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->num_waiters, __ATOMIC_SEQ_CST))
+        futex_wake_all(&header->commit_count);
+}
+
+static uint64_t
+shm_hash (uint64_t h, const void *buf, size_t len)
+{
+    // four independent lanes, so that the multiplications overlap
+    const char *p = (const char*) buf;
+    uint64_t lanes[4] = { h, h ^ 1, h ^ 2, h ^ 3 };
+    for (; len >= 32; len -= 32, p += 32) {
+        for (int i = 0; i < 4; i++) {
+            uint64_t w;
+            memcpy(&w, p + 8 * i, 8);
+            lanes[i] = (lanes[i] ^ w) * 0x9e3779b97f4a7c15ULL;
+            lanes[i] ^= lanes[i] >> 29;
+        }
+    }
+    h = lanes[0] ^ (lanes[1] * 3) ^ (lanes[2] * 5) ^ (lanes[3] * 7);
+    for (; len > 0; len -= MIN(len, 8), p += 8) {
+        uint64_t w = 0;
+        memcpy(&w, p, MIN(len, 8));
+        h = (h ^ w ^ len) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+// Covers the fields of the record and its contents, so that a reader can
+// tell a message that a late publisher wrote over.
+static uint64_t
+shm_record_checksum (const shm_record_t *rec, const char *channel,
+        const void *data)
+{
+    uint64_t h = rec->pos ^ (rec->seq << 1) ^ ((uint64_t) rec->utime << 2) ^
+        ((uint64_t) rec->size << 32) ^ ((uint64_t) rec->data_size << 16) ^
+        rec->channel_len;
+    h = shm_hash(h, channel, rec->channel_len);
+    return shm_hash(h, data, rec->data_size);
+}
+
+static void
+shm_msg_destroy (shm_msg_t *msg)
+{
+    free(msg->rbuf.data);
+    free(msg);
+}
+
+static void
+lcm_shm_destroy (lcm_shm_t *self)
+{
+    dbg(DBG_LCM, "destroying LCM shm provider context\n");
+    if (self->read_thread) {
+        g_atomic_int_set(&self->stopping, 1);
+        shm_notify_readers(self->header);
+        g_thread_join(self->read_thread);
+    }
+    if (self->header)
+        munmap(self->header, self->map_size);
+    lcm_internal_notify_close(self->notify_pipe);
+    if (self->queue) {
+        while (!g_queue_is_empty(self->queue))
+            shm_msg_destroy((shm_msg_t*) g_queue_pop_head(self->queue));
+        g_queue_free(self->queue);
+    }
+    if (self->mutex)
+        g_mutex_free(self->mutex);
+    g_static_mutex_free(&self->stats_lock);
+    free(self->shm_name);
+    free(self->rx_cpu);
+    free(self->rx_sched);
+    free(self);
+}
+
+// Opens the segment, creating it if no other instance has.  Returns 0 on
+// success.
+static int
+shm_map_ring (lcm_shm_t *self)
+{
+    uint64_t capacity = 1;
+    while (capacity < (uint64_t) self->size_mb * 1024 * 1024)
+        capacity <<= 1;
+
+    int created = 1;
+    int fd = shm_open(self->shm_name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd >= 0) {
+        if (ftruncate(fd, SHM_HEADER_SIZE + capacity) < 0) {
+            perror("LCM shm: ftruncate");
+            close(fd);
+            shm_unlink(self->shm_name);
+            return -1;
+        }
+    } else if (errno == EEXIST) {
+        created = 0;
+        fd = shm_open(self->shm_name, O_RDWR, 0);
+    }
+    if (fd < 0) {
+        fprintf(stderr, "LCM shm: could not open %s: %s\n", self->shm_name,
+                strerror(errno));
+        return -1;
+    }
+
+    // wait for the creator to size the segment
+    struct stat st;
+    for (int i = 0; ; i++) {
+        if (fstat(fd, &st) < 0) {
+            perror("LCM shm: fstat");
+            close(fd);
+            return -1;
+        }
+        if (st.st_size > SHM_HEADER_SIZE)
+            break;
+        if (i == 1000) {
+            fprintf(stderr, "LCM shm: %s was never initialized\n",
+                    self->shm_name);
+            close(fd);
+            return -1;
+        }
+        g_usleep(1000);
+    }
+
+    self->map_size = st.st_size;
+    void *addr = mmap(NULL, self->map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        perror("LCM shm: mmap");
+        return -1;
+    }
+    self->header = (shm_ring_header_t*) addr;
+    self->ring = (char*) addr + SHM_HEADER_SIZE;
+
+    if (created) {
+        self->header->version = SHM_VERSION;
+        self->header->capacity = capacity;
+        self->header->head = capacity;
+        self->header->next_seq = 0;
+        __atomic_store_n(&self->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; __atomic_load_n(&self->header->magic, __ATOMIC_ACQUIRE) !=
+            SHM_MAGIC; i++) {
+        if (i == 1000) {
+            fprintf(stderr, "LCM shm: %s was never initialized\n",
+                    self->shm_name);
+            return -1;
+        }
+        g_usleep(1000);
+    }
+    uint64_t ring_capacity = self->header->capacity;
+    if (self->header->version != SHM_VERSION ||
+            ring_capacity & (ring_capacity - 1) ||
+            SHM_HEADER_SIZE + ring_capacity > self->map_size) {
+        fprintf(stderr, "LCM shm: %s has an incompatible layout\n",
+                self->shm_name);
+        return -1;
+    }
+    if (ring_capacity != capacity)
+        dbg(DBG_LCM, "%s already exists with %" PRIu64
+                " bytes, ignoring size_mb\n", self->shm_name, ring_capacity);
+    self->mask = ring_capacity - 1;
+    return 0;
+}
+
+static void
+new_argument (gpointer key, gpointer value, gpointer user)
+{
+    lcm_shm_t *self = (lcm_shm_t*) user;
+    if (!strcmp((char*) key, "size_mb")) {
+        char *endptr = NULL;
+        self->size_mb = strtol((char*) value, &endptr, 0);
+        if (endptr == value || self->size_mb <= 0 ||
+                self->size_mb > 64 * 1024) {
+            fprintf(stderr, "Warning: Invalid value for size_mb\n");
+            self->size_mb = SHM_DEFAULT_SIZE_MB;
+        }
+    } else if (!strcmp((char*) key, "rx_cpu") ||
+            !strcmp((char*) key, "rx_sched")) {
+        int is_cpu = !strcmp((char*) key, "rx_cpu");
+        if (lcm_internal_check_thread_scheduling(
+                    is_cpu ? (char*) value : NULL,
+                    is_cpu ? NULL : (char*) value) < 0) {
+            fprintf(stderr, "Warning: Invalid value for %s\n", (char*) key);
+        } else {
+            char **dest = is_cpu ? &self->rx_cpu : &self->rx_sched;
+            free(*dest);
+            *dest = strdup((char*) value);
+        }
+    } else {
+        fprintf(stderr, "Warning: unrecognized option: [%s]\n",
+                (const char*) key);
+    }
+}
+
+static lcm_provider_t *
+lcm_shm_create (lcm_t *parent, const char *target, const GHashTable *args)
+{
+    if (!target || !strlen(target))
+        target = "default";
+    for (const char *c = target; *c; c++) {
+        if (!isalnum((unsigned char) *c) && *c != '_' && *c != '-' && *c != '.') {
+            fprintf(stderr, "Error: invalid shm name \"%s\"\n", target);
+            return NULL;
+        }
+    }
+
+    lcm_shm_t *self = (lcm_shm_t*) calloc(1, sizeof(lcm_shm_t));
+    self->lcm = parent;
+    self->shm_name = g_strdup_printf("/lcm-%s", target);
+    self->size_mb = SHM_DEFAULT_SIZE_MB;
+    self->notify_pipe[0] = self->notify_pipe[1] = -1;
+    self->queue = g_queue_new();
+    self->mutex = g_mutex_new();
+    g_static_mutex_init(&self->stats_lock);
+
+    g_hash_table_foreach((GHashTable*) args, new_argument, self);
+
+    dbg(DBG_LCM, "Initializing LCM shm provider context...\n");
+
+    if (lcm_internal_notify_create(self->notify_pipe) != 0) {
+        perror(__FILE__ " - pipe (notify)");
+        lcm_shm_destroy(self);
+        return NULL;
+    }
+    if (shm_map_ring(self) < 0) {
+        lcm_shm_destroy(self);
+        return NULL;
+    }
+    dbg(DBG_LCM, "Ring %s, %" PRIu64 " bytes\n", self->shm_name,
+            self->mask + 1);
+    return self;
+}
+
+static void
+shm_queue_msg (lcm_shm_t *self, shm_msg_t *msg)
+{
+    g_mutex_lock(self->mutex);
+    int was_empty = g_queue_is_empty(self->queue);
+    g_queue_push_tail(self->queue, msg);
+    if (was_empty) {
+        if (lcm_internal_notify_signal(self->notify_pipe) < 0)
+            perror(__FILE__ " - write to notify pipe (shm read thread)");
+    }
+    g_mutex_unlock(self->mutex);
+}
+
+// Returns nonzero if no publisher has reserved the space that follows
+// [pos, pos + capacity), so that what was read at pos is intact.
+static int
+shm_still_valid (lcm_shm_t *self, uint64_t pos)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&self->header->head, __ATOMIC_RELAXED);
+    return head - pos <= self->mask + 1;
+}
+
+// Gives up on the messages between pos and the head, which were overwritten
+// or never committed, and counts them as lost.
+static void
+shm_skip_to_head (lcm_shm_t *self, uint64_t *pos, uint64_t *expected_seq)
+{
+    uint64_t seq = __atomic_load_n(&self->header->next_seq, __ATOMIC_ACQUIRE);
+    *pos = __atomic_load_n(&self->header->head, __ATOMIC_ACQUIRE);
+    if (seq > *expected_seq) {
+        g_static_mutex_lock(&self->stats_lock);
+        self->stats.num_lost += seq - *expected_seq;
+        g_static_mutex_unlock(&self->stats_lock);
+        *expected_seq = seq;
+    }
+}
+
+static void *
+read_thread (void *user)
+{
+    lcm_shm_t *self = (lcm_shm_t*) user;
+    shm_ring_header_t *header = self->header;
+    uint64_t capacity = self->mask + 1;
+    lcm_internal_thread_init("shm-rx", self->rx_cpu, self->rx_sched);
+
+    uint64_t pos = self->start_pos;
+    uint64_t expected_seq = self->start_seq;
+    int64_t stuck_since = 0;
+
+    while (!g_atomic_int_get(&self->stopping)) {
+        shm_record_t *rec = (shm_record_t*) (self->ring + (pos & self->mask));
+        if (__atomic_load_n(&rec->pos, __ATOMIC_ACQUIRE) != pos) {
+            uint32_t commits = __atomic_load_n(&header->commit_count,
+                    __ATOMIC_SEQ_CST);
+            uint64_t head = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+            if (head - pos > capacity) {
+                // lapped by the publishers
+                shm_skip_to_head(self, &pos, &expected_seq);
+                continue;
+            }
+            if (head != pos) {
+                // A publisher reserved the space but has not committed it
+                // yet.  If it never does, e.g. because it crashed, skip to
+                // the head rather than waiting forever.
+                int64_t now = lcm_clock_monotonic_us();
+                if (!stuck_since) {
+                    stuck_since = now;
+                } else if (now - stuck_since > SHM_STUCK_USEC) {
+                    dbg(DBG_LCM, "skipping an uncommitted message\n");
+                    shm_skip_to_head(self, &pos, &expected_seq);
+                    stuck_since = 0;
+                    continue;
+                }
+                sched_yield();
+                continue;
+            }
+            stuck_since = 0;
+            __atomic_add_fetch(&header->num_waiters, 1, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&rec->pos, __ATOMIC_ACQUIRE) != pos)
+                futex_wait(&header->commit_count, commits, 100);
+            __atomic_sub_fetch(&header->num_waiters, 1, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        stuck_since = 0;
+
+        uint32_t size = rec->size;
+        uint32_t data_size = rec->data_size;
+        uint16_t channel_len = rec->channel_len;
+        uint64_t seq = rec->seq;
+        int64_t utime = rec->utime;
+        uint64_t checksum = rec->checksum;
+        char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+        if (channel_len <= LCM_MAX_CHANNEL_NAME_LENGTH)
+            memcpy(channel, (char*) (rec + 1), channel_len);
+        if (!shm_still_valid(self, pos)) {
+            // overwritten while we read it
+            shm_skip_to_head(self, &pos, &expected_seq);
+            continue;
+        }
+        int bad = size < sizeof(shm_record_t) || size % SHM_RECORD_ALIGN ||
+            size > capacity / 2;
+        if (!bad && channel_len != SHM_PAD_RECORD)
+            bad = channel_len > LCM_MAX_CHANNEL_NAME_LENGTH ||
+                sizeof(shm_record_t) + channel_len + data_size > size;
+        if (bad) {
+            g_static_mutex_lock(&self->stats_lock);
+            self->stats.num_bad_packets++;
+            g_static_mutex_unlock(&self->stats_lock);
+            shm_skip_to_head(self, &pos, &expected_seq);
+            continue;
+        }
+        if (channel_len == SHM_PAD_RECORD) {
+            pos += size;
+            continue;
+        }
+        channel[channel_len] = 0;
+
+        shm_msg_t *msg = NULL;
+        if (lcm_has_handlers(self->lcm, channel)) {
+            msg = (shm_msg_t*) malloc(sizeof(shm_msg_t));
+            memcpy(msg->channel, channel, channel_len + 1);
+            msg->rbuf.data = malloc(data_size ? data_size : 1);
+            memcpy(msg->rbuf.data, (char*) (rec + 1) + channel_len, data_size);
+            msg->rbuf.data_size = data_size;
+            msg->rbuf.recv_utime = utime;
+            msg->rbuf.recv_time_ns = utime * 1000;
+            msg->rbuf.lcm = self->lcm;
+            msg->rbuf.owner = NULL;
+            if (!shm_still_valid(self, pos)) {
+                shm_msg_destroy(msg);
+                shm_skip_to_head(self, &pos, &expected_seq);
+                continue;
+            }
+            shm_record_t fields;
+            fields.pos = pos;
+            fields.seq = seq;
+            fields.utime = utime;
+            fields.size = size;
+            fields.data_size = data_size;
+            fields.channel_len = channel_len;
+            if (checksum != shm_record_checksum(&fields, channel,
+                        msg->rbuf.data)) {
+                // written over by a late publisher
+                g_static_mutex_lock(&self->stats_lock);
+                self->stats.num_bad_packets++;
+                g_static_mutex_unlock(&self->stats_lock);
+                shm_msg_destroy(msg);
+                pos += size;
+                continue;
+            }
+        }
+
+        // Concurrent publishers may commit their messages in a different
+        // order than they were numbered, so a message from the past was
+        // counted as lost when a later one was read.
+        int64_t lost = 0;
+        if (seq >= expected_seq) {
+            lost = seq - expected_seq;
+            expected_seq = seq + 1;
+        } else {
+            lost = -1;
+        }
+
+        g_static_mutex_lock(&self->stats_lock);
+        self->stats.num_packets++;
+        self->stats.num_bytes += size;
+        self->stats.num_lost += lost;
+        g_static_mutex_unlock(&self->stats_lock);
+
+        pos += size;
+        if (msg && lcm_try_enqueue_message(self->lcm, msg->channel))
+            shm_queue_msg(self, msg);
+        else if (msg)
+            shm_msg_destroy(msg);
+    }
+    return NULL;
+}
+
+static int
+lcm_shm_subscribe (lcm_shm_t *self, const char *channel)
+{
+    // start following the ring with the first subscription
+    if (!self->read_thread) {
+        // messages published from now on are received, even those that
+        // come before the thread is running
+        self->start_seq = __atomic_load_n(&self->header->next_seq,
+                __ATOMIC_ACQUIRE);
+        self->start_pos = __atomic_load_n(&self->header->head,
+                __ATOMIC_ACQUIRE);
+        self->read_thread = g_thread_create(read_thread, self, TRUE, NULL);
+        if (!self->read_thread) {
+            fprintf(stderr, "Error: LCM shm failed to start read thread\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void
+shm_commit (shm_ring_header_t *header, shm_record_t *rec, uint64_t pos)
+{
+    // If the other publishers went around the ring while this one was
+    // writing, the space is no longer ours and nobody is waiting for it.
+    uint64_t capacity = header->capacity;
+    if (__atomic_load_n(&header->head, __ATOMIC_ACQUIRE) - pos > capacity)
+        return;
+    __atomic_store_n(&rec->pos, pos, __ATOMIC_RELEASE);
+}
+
+static int
+lcm_shm_publish (lcm_shm_t *self, const char *channel, const void *data,
+        unsigned int datalen)
+{
+    shm_ring_header_t *header = self->header;
+    uint64_t capacity = self->mask + 1;
+    size_t channel_len = strlen(channel);
+    uint64_t size = sizeof(shm_record_t) + channel_len + datalen;
+    size = (size + SHM_RECORD_ALIGN - 1) & ~(uint64_t) (SHM_RECORD_ALIGN - 1);
+    if (channel_len > LCM_MAX_CHANNEL_NAME_LENGTH || size > capacity / 4) {
+        fprintf(stderr, "LCM shm: message of %u bytes is too large for %s, "
+                "see the size_mb option\n", datalen, self->shm_name);
+        return -1;
+    }
+
+    while (1) {
+        uint64_t pos = __atomic_fetch_add(&header->head, size,
+                __ATOMIC_RELAXED);
+        // pairs with the fence in shm_still_valid: a reader that sees any
+        // of the bytes written below also sees the head moved past them
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        uint64_t offset = pos & self->mask;
+        shm_record_t *rec = (shm_record_t*) (self->ring + offset);
+        rec->size = size;
+        if (offset + size > capacity) {
+            // the space wraps around the end of the ring
+            rec->channel_len = SHM_PAD_RECORD;
+            shm_commit(header, rec, pos);
+            continue;
+        }
+        shm_record_t fields;
+        fields.pos = pos;
+        fields.seq = __atomic_fetch_add(&header->next_seq, 1,
+                __ATOMIC_RELAXED);
+        fields.utime = lcm_clock_realtime_us();
+        fields.size = size;
+        fields.data_size = datalen;
+        fields.channel_len = channel_len;
+        rec->seq = fields.seq;
+        rec->utime = fields.utime;
+        rec->data_size = datalen;
+        rec->channel_len = channel_len;
+        rec->checksum = shm_record_checksum(&fields, channel, data);
+        memcpy(rec + 1, channel, channel_len);
+        memcpy((char*) (rec + 1) + channel_len, data, datalen);
+        shm_commit(header, rec, pos);
+        break;
+    }
+    shm_notify_readers(header);
+    return 0;
+}
+
+static int
+lcm_shm_get_fileno (lcm_shm_t *self)
+{
+    return self->notify_pipe[0];
+}
+
+static int
+lcm_shm_handle_batch (lcm_shm_t *self, int max_msgs)
+{
+    int status = lcm_internal_notify_wait(self->notify_pipe);
+    if (status == 0) {
+        fprintf(stderr,
+            "Error: lcm_shm_handle read 0 bytes from notify_pipe\n");
+        return -1;
+    }
+
+    g_mutex_lock(self->mutex);
+    int num_msgs = MIN(max_msgs, (int) g_queue_get_length(self->queue));
+    GPtrArray *batch = g_ptr_array_sized_new(num_msgs);
+    for (int i = 0; i < num_msgs; i++)
+        g_ptr_array_add(batch, g_queue_pop_head(self->queue));
+    if (!g_queue_is_empty(self->queue)) {
+        if (lcm_internal_notify_signal(self->notify_pipe) < 0)
+            perror(__FILE__ " - write to notify pipe (lcm_shm_handle)");
+    }
+    g_mutex_unlock(self->mutex);
+
+    for (int i = 0; i < num_msgs; i++) {
+        shm_msg_t *msg = (shm_msg_t*) g_ptr_array_index(batch, i);
+        lcm_recv_buf_owner_t owner = { msg->rbuf.data, NULL };
+        msg->rbuf.owner = &owner;
+        lcm_dispatch_handlers(self->lcm, &msg->rbuf, msg->channel);
+        if (lcm_recv_buf_owner_finish(&owner))
+            msg->rbuf.data = NULL;
+        shm_msg_destroy(msg);
+    }
+    g_ptr_array_free(batch, TRUE);
+    return num_msgs;
+}
+
+static int
+lcm_shm_handle (lcm_shm_t *self)
+{
+    int status = lcm_shm_handle_batch(self, 1);
+    return status < 0 ? status : 0;
+}
+
+static int
+lcm_shm_get_stats (lcm_shm_t *self, lcm_transport_stats_t *stats)
+{
+    g_static_mutex_lock(&self->stats_lock);
+    *stats = self->stats;
+    g_static_mutex_unlock(&self->stats_lock);
+    return 0;
+}
+
+static lcm_provider_vtable_t shm_vtable = {
+    .create      = lcm_shm_create,
+    .destroy     = lcm_shm_destroy,
+    .subscribe   = lcm_shm_subscribe,
+    .unsubscribe = NULL,
+    .publish     = lcm_shm_publish,
+    .handle      = lcm_shm_handle,
+    .get_fileno  = lcm_shm_get_fileno,
+    .handle_batch = lcm_shm_handle_batch,
+    .get_stats   = lcm_shm_get_stats
+};
+static lcm_provider_info_t shm_info;
+#endif
+
+void
+lcm_shm_provider_init (GPtrArray * providers)
+{
+#ifdef __linux__
+    shm_info.name = "shm";
+    shm_info.vtable = &shm_vtable;
+
+    g_ptr_array_add (providers, &shm_info);
+#endif
+}
@@ -6,6 +6,7 @@
 #ifndef WIN32
 #include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -18,6 +19,7 @@
 #endif
 
 #include "lcm_internal.h"
+#include "lcm_clock.h"
 #include "dbg.h"
 #include "eventlog.h"
 
@@ -28,6 +30,13 @@
 #define MESSAGE_TYPE_SUBSCRIBE   2
 #define MESSAGE_TYPE_UNSUBSCRIBE 3
 
+// initial size of the receive buffer.  It grows to hold the largest message
+#define RECV_BUF_SIZE (64 * 1024)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
 typedef struct _lcm_provider_t lcm_tcpq_t;
 struct _lcm_provider_t {
     lcm_t * lcm;
@@ -35,8 +44,16 @@ struct _lcm_provider_t {
 
     char *recv_channel_buf;
     uint32_t recv_channel_buf_len;
-    void *data_buf;
-    uint32_t data_buf_len;
+
+    // bytes received from the server and not yet dispatched are
+    // recv_buf[recv_start, recv_end)
+    void *recv_buf;
+    uint32_t recv_buf_len;
+    uint32_t recv_start;
+    uint32_t recv_end;
+
+    int nodelay;
+    int cork;
 
     char *server_addr_str;
     struct in_addr server_addr;
@@ -56,14 +73,6 @@ _close_socket(int fd)
 #endif
 }
 
-static int64_t
-timestamp_now (void)
-{
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
-}
-
 static int
 _recv_fully(int fd, void *b, int len)
 {
@@ -85,25 +94,38 @@ _recv_fully(int fd, void *b, int len)
     return cnt;
 }
 
+// Sends the iovcnt buffers in iov in order, with as few system calls as the
+// socket allows.  Modifies iov.  Returns 0 on success.
 static int
-_send_fully(int fd, const void *b, int len)
+_send_iov_fully(int fd, struct iovec *iov, int iovcnt)
 {
-    int cnt=0;
-    int thiscnt;
-    char *bb=(char*) b;
-
-    while(cnt<len) {
-        thiscnt=send(fd, &bb[cnt], len-cnt, 0);
-        if(thiscnt<0) {
-            perror("_send_fully");
+    while(iovcnt > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+        int thiscnt = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if(thiscnt < 0) {
+            if(errno == EINTR)
+                continue;
+            perror("_send_iov_fully");
             return -1;
         }
         if(thiscnt == 0) {
             return -1;
         }
-        cnt+=thiscnt;
+        // skip past the buffers that went out
+        while(iovcnt > 0 && (size_t) thiscnt >= iov->iov_len) {
+            thiscnt -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0) {
+            iov->iov_base = (char*) iov->iov_base + thiscnt;
+            iov->iov_len -= thiscnt;
+        }
     }
-    return cnt;
+    return 0;
 }
 
 static int
@@ -116,11 +138,25 @@ _recv_uint32(int fd, uint32_t *result)
     return 0;
 }
 
-static int
-_send_uint32(int fd, uint32_t v)
+static void
+_set_sockopt_int(int fd, int level, int name, int value, const char *what)
 {
-    uint32_t n = htonl(v);
-    return (_send_fully(fd, &n, 4) == 4) ? 0 : -1;
+    if(setsockopt(fd, level, name, (const char*) &value, sizeof(value)) < 0)
+        fprintf(stderr, "LCM tcpq: could not set %s: %s\n", what,
+                strerror(errno));
+}
+
+// With the cork option, small publishes are held in the kernel until they
+// fill a segment.  Toggling the option pushes out the ones that did not.
+static void
+_flush_corked(lcm_tcpq_t *self)
+{
+#ifdef TCP_CORK
+    if(self->cork && self->socket >= 0) {
+        _set_sockopt_int(self->socket, IPPROTO_TCP, TCP_CORK, 0, "TCP_CORK");
+        _set_sockopt_int(self->socket, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+    }
+#endif
 }
 
 static void
@@ -132,7 +168,7 @@ lcm_tcpq_destroy (lcm_tcpq_t *self)
     if(self->server_addr_str)
         g_free(self->server_addr_str);
     free(self->recv_channel_buf);
-    free(self->data_buf);
+    free(self->recv_buf);
     free(self);
 }
 
@@ -141,8 +177,9 @@ _connect_to_server(lcm_tcpq_t *self)
 {
     fprintf(stderr, "LCM tcpq: connecting...\n");
 
-    if(self->socket)
+    if(self->socket >= 0)
         _close_socket(self->socket);
+    self->recv_start = self->recv_end = 0;
 
     self->socket=socket(AF_INET,SOCK_STREAM,0);
     if(self->socket < 0) {
@@ -150,6 +187,16 @@ _connect_to_server(lcm_tcpq_t *self)
         return -1;
     }
 
+    // every message goes out in a single write, so Nagle's algorithm would
+    // only hold it back waiting for the server's delayed ACK
+    if(self->nodelay)
+        _set_sockopt_int(self->socket, IPPROTO_TCP, TCP_NODELAY, 1,
+                "TCP_NODELAY");
+#ifdef TCP_CORK
+    if(self->cork)
+        _set_sockopt_int(self->socket, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK");
+#endif
+
     struct sockaddr_in sa;
     sa.sin_family = AF_INET;
     sa.sin_port=self->server_port;
@@ -160,8 +207,9 @@ _connect_to_server(lcm_tcpq_t *self)
         goto fail;
     }
 
-    if(_send_uint32(self->socket, MAGIC_CLIENT) ||
-       _send_uint32(self->socket, PROTOCOL_VERSION)) {
+    uint32_t hello[2] = { htonl(MAGIC_CLIENT), htonl(PROTOCOL_VERSION) };
+    struct iovec hello_iov = { .iov_base = hello, .iov_len = sizeof(hello) };
+    if(_send_iov_fully(self->socket, &hello_iov, 1)) {
         goto fail;
     }
 
@@ -185,6 +233,7 @@ _connect_to_server(lcm_tcpq_t *self)
             goto fail;
         }
     }
+    _flush_corked(self);
 
     dbg(DBG_LCM, "LCM tcpq: connected (%d)\n", self->socket);
     return 0;
@@ -196,6 +245,33 @@ fail:
         return -1;
 }
 
+static void
+new_argument(gpointer key, gpointer value, gpointer user)
+{
+    lcm_tcpq_t *self = (lcm_tcpq_t *) user;
+    if(!strcmp((char *) key, "nodelay")) {
+        char *endptr = NULL;
+        self->nodelay = strtol((char *) value, &endptr, 0);
+        if(endptr == value)
+            fprintf(stderr, "Warning: Invalid value for nodelay\n");
+    }
+    else if(!strcmp((char *) key, "cork")) {
+        char *endptr = NULL;
+        self->cork = strtol((char *) value, &endptr, 0);
+        if(endptr == value)
+            fprintf(stderr, "Warning: Invalid value for cork\n");
+#ifndef TCP_CORK
+        if(self->cork)
+            fprintf(stderr, "LCM tcpq: cork is not supported on this "
+                    "platform\n");
+#endif
+    }
+    else {
+        fprintf(stderr, "%s:%d -- unknown provider argument %s\n",
+                __FILE__, __LINE__, (char *) key);
+    }
+}
+
 static lcm_provider_t *
 lcm_tcpq_create(lcm_t * parent, const char *network, const GHashTable *args)
 {
@@ -211,9 +287,12 @@ lcm_tcpq_create(lcm_t * parent, const char *network, const GHashTable *args)
     self->recv_channel_buf_len = 64;
     self->recv_channel_buf = (char*) calloc(1, self->recv_channel_buf_len);
 
-    self->data_buf_len = 1024;
-    self->data_buf = calloc(1, self->data_buf_len);
+    self->recv_buf_len = RECV_BUF_SIZE;
+    self->recv_buf = malloc(self->recv_buf_len);
     self->subs = NULL;
+    self->nodelay = 1;
+
+    g_hash_table_foreach((GHashTable*) args, new_argument, self);
 
     // parse server address and port
     if (!network || !strlen(network)) {
@@ -271,9 +350,12 @@ _sub_unsub_helper(lcm_tcpq_t *self, const char *channel, uint32_t msg_type)
     }
 
     uint32_t channel_len = strlen(channel);
-    if(_send_uint32(self->socket, msg_type) ||
-       _send_uint32(self->socket, channel_len) ||
-       (channel_len != _send_fully(self->socket, channel, channel_len)))
+    uint32_t header[2] = { htonl(msg_type), htonl(channel_len) };
+    struct iovec iov[2] = {
+        { .iov_base = header, .iov_len = sizeof(header) },
+        { .iov_base = (char*) channel, .iov_len = channel_len },
+    };
+    if(_send_iov_fully(self->socket, iov, 2))
     {
         perror("LCM tcpq");
         dbg(DBG_LCM, "Disconnected!\n");
@@ -338,56 +420,117 @@ _ensure_buf_capacity(void **buf, uint32_t *cur_size, int req_size)
     return 0;
 }
 
+static uint32_t
+_get_uint32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return ntohl(v);
+}
+
+// Returns the size of the message frame at the start of the receive buffer,
+// or 0 if it has not been received in full yet.  Grows the buffer as needed
+// to hold the frame.  Returns -1 on allocation failure.
+static int64_t
+_buffered_frame_size(lcm_tcpq_t *self)
+{
+    const char *p = (const char*) self->recv_buf + self->recv_start;
+    uint32_t avail = self->recv_end - self->recv_start;
+
+    // message type, channel length, channel, payload size, payload
+    int64_t need = 8;
+    if(avail >= need) {
+        need += (int64_t) _get_uint32(p + 4) + 4;
+        if(avail >= need) {
+            need += _get_uint32(p + need - 4);
+            if(avail >= need)
+                return need;
+        }
+    }
+
+    if(need > self->recv_buf_len - self->recv_start) {
+        // make room for the rest of the frame
+        memmove(self->recv_buf, p, avail);
+        self->recv_start = 0;
+        self->recv_end = avail;
+        if(need > INT32_MAX || _ensure_buf_capacity(&self->recv_buf,
+                    &self->recv_buf_len, need))
+            return -1;
+    }
+    return 0;
+}
+
 static int
 lcm_tcpq_handle(lcm_tcpq_t * self)
 {
     if(self->socket < 0 && 0 != _connect_to_server(self)) {
         return -1;
     }
-
-    // read, ignore message type
-    uint32_t msg_type;
-    if(_recv_uint32(self->socket, &msg_type))
-        goto disconnected;
-
-    // read channel length, channel
-    uint32_t channel_len;
-    if(_recv_uint32(self->socket, &channel_len))
-        goto disconnected;
-    if(_ensure_buf_capacity((void**)&self->recv_channel_buf,
-                &self->recv_channel_buf_len, channel_len+1)) {
-        fprintf(stderr, "Memory allocation error\n");
-        return -1;
+    _flush_corked(self);
+
+    // receive until there is at least one whole message buffered
+    int64_t frame_size;
+    while(0 == (frame_size = _buffered_frame_size(self))) {
+        if(self->recv_start == self->recv_end)
+            self->recv_start = self->recv_end = 0;
+        int thiscnt = recv(self->socket,
+                (char*) self->recv_buf + self->recv_end,
+                self->recv_buf_len - self->recv_end, 0);
+        if(thiscnt < 0 && errno == EINTR)
+            continue;
+        if(thiscnt < 0)
+            perror("LCM tcpq recv");
+        if(thiscnt <= 0)
+            goto disconnected;
+        self->recv_end += thiscnt;
     }
-    if(channel_len != _recv_fully(self->socket, self->recv_channel_buf,
-                channel_len))
-        goto disconnected;
-    self->recv_channel_buf[channel_len] = 0;
-
-    // read payload size, payload
-    uint32_t data_len;
-    if(_recv_uint32(self->socket, &data_len))
-        goto disconnected;
-    if(_ensure_buf_capacity(&self->data_buf, &self->data_buf_len, data_len)) {
+    if(frame_size < 0) {
         fprintf(stderr, "Memory allocation error\n");
-        return -1;
-    }
-    if(data_len != _recv_fully(self->socket, self->data_buf, data_len))
         goto disconnected;
+    }
 
-    lcm_recv_buf_t rbuf;
-    rbuf.data = self->data_buf;
-    rbuf.data_size = data_len;
-    rbuf.recv_utime = timestamp_now();
-    rbuf.lcm = self->lcm;
-
-    if(lcm_try_enqueue_message(self->lcm, self->recv_channel_buf))
-        lcm_dispatch_handlers(self->lcm, &rbuf, self->recv_channel_buf);
+    // Dispatch every message that is buffered in full, so that the socket
+    // becomes readable again when lcm_handle() has more to do.  A handler
+    // that reconnects resets the buffer, which ends the loop.
+    int64_t recv_utime = lcm_clock_realtime_us();
+    while(frame_size > 0) {
+        const char *p = (const char*) self->recv_buf + self->recv_start;
+        uint32_t channel_len = _get_uint32(p + 4);
+        if(_ensure_buf_capacity((void**)&self->recv_channel_buf,
+                    &self->recv_channel_buf_len, channel_len+1)) {
+            fprintf(stderr, "Memory allocation error\n");
+            goto disconnected;
+        }
+        memcpy(self->recv_channel_buf, p + 8, channel_len);
+        self->recv_channel_buf[channel_len] = 0;
+        self->recv_start += frame_size;
+
+        lcm_recv_buf_t rbuf;
+        rbuf.data = (char*) p + 12 + channel_len;
+        rbuf.data_size = frame_size - 12 - channel_len;
+        rbuf.recv_utime = recv_utime;
+        rbuf.recv_time_ns = rbuf.recv_utime * 1000;
+        rbuf.lcm = self->lcm;
+        rbuf.owner = NULL;
+
+        if(lcm_try_enqueue_message(self->lcm, self->recv_channel_buf))
+            lcm_dispatch_handlers(self->lcm, &rbuf, self->recv_channel_buf);
+
+        if(self->socket < 0)
+            break;
+        frame_size = _buffered_frame_size(self);
+        if(frame_size < 0) {
+            fprintf(stderr, "Memory allocation error\n");
+            goto disconnected;
+        }
+    }
     return 0;
 
 disconnected:
-    _close_socket(self->socket);
+    if(self->socket >= 0)
+        _close_socket(self->socket);
     self->socket = -1;
+    self->recv_start = self->recv_end = 0;
     return -1;
 }
 
@@ -400,12 +543,16 @@ lcm_tcpq_publish(lcm_tcpq_t *self, const char *channel, const void *data,
     }
 
     uint32_t channel_len = strlen(channel);
-
-    if(_send_uint32(self->socket, MESSAGE_TYPE_PUBLISH) ||
-       _send_uint32(self->socket, channel_len) ||
-       (channel_len != _send_fully(self->socket, channel, channel_len)) ||
-       _send_uint32(self->socket, datalen) ||
-       (datalen != _send_fully(self->socket, data, datalen)))
+    uint32_t header[2] = { htonl(MESSAGE_TYPE_PUBLISH), htonl(channel_len) };
+    uint32_t data_len = htonl(datalen);
+    struct iovec iov[4] = {
+        { .iov_base = header, .iov_len = sizeof(header) },
+        { .iov_base = (char*) channel, .iov_len = channel_len },
+        { .iov_base = &data_len, .iov_len = sizeof(data_len) },
+        { .iov_base = (char*) data, .iov_len = datalen },
+    };
+
+    if(_send_iov_fully(self->socket, iov, 4))
     {
         perror("LCM tcpq send");
         dbg(DBG_LCM, "Disconnected!\n");
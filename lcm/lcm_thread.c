@@ -0,0 +1,170 @@
+#ifdef __linux__
+// for cpu_set_t and pthread_setaffinity_np
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include "lcm.h"
+#include "lcm_internal.h"
+
+#ifndef WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static GStaticMutex hook_lock = G_STATIC_MUTEX_INIT;
+static lcm_thread_hook_t thread_hook = NULL;
+static void *thread_hook_user = NULL;
+
+void
+lcm_set_thread_hook (lcm_thread_hook_t hook, void *user_data)
+{
+    g_static_mutex_lock (&hook_lock);
+    thread_hook = hook;
+    thread_hook_user = user_data;
+    g_static_mutex_unlock (&hook_lock);
+}
+
+#ifdef __linux__
+// Parses a list of CPUs such as "3" or "0,2-3".  Returns 0 on success.
+static int
+_parse_cpus (const char *cpus, cpu_set_t *set)
+{
+    CPU_ZERO (set);
+    const char *p = cpus;
+    while (1) {
+        char *endptr = NULL;
+        long first = strtol (p, &endptr, 10);
+        if (endptr == p || first < 0 || first >= CPU_SETSIZE)
+            return -1;
+        long last = first;
+        p = endptr;
+        if (*p == '-') {
+            last = strtol (p + 1, &endptr, 10);
+            if (endptr == p + 1 || last < first || last >= CPU_SETSIZE)
+                return -1;
+            p = endptr;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET (cpu, set);
+        if (!*p)
+            return 0;
+        if (*p != ',')
+            return -1;
+        p++;
+    }
+}
+#endif
+
+#ifndef WIN32
+// Parses a scheduling policy such as "fifo:50", "rr:10" or "other".  Returns
+// 0 on success.
+static int
+_parse_sched (const char *sched, int *policy, int *priority)
+{
+    const char *colon = strchr (sched, ':');
+    size_t len = colon ? (size_t) (colon - sched) : strlen (sched);
+    if (len == 4 && !strncmp (sched, "fifo", len))
+        *policy = SCHED_FIFO;
+    else if (len == 2 && !strncmp (sched, "rr", len))
+        *policy = SCHED_RR;
+    else if (len == 5 && !strncmp (sched, "other", len))
+        *policy = SCHED_OTHER;
+    else
+        return -1;
+
+    *priority = 0;
+    if (colon) {
+        char *endptr = NULL;
+        *priority = strtol (colon + 1, &endptr, 10);
+        if (endptr == colon + 1 || *endptr)
+            return -1;
+    }
+    if (*priority < sched_get_priority_min (*policy) ||
+            *priority > sched_get_priority_max (*policy))
+        return -1;
+    return 0;
+}
+#endif
+
+int
+lcm_internal_check_thread_scheduling (const char *cpus, const char *sched)
+{
+#ifdef WIN32
+    return (cpus || sched) ? -1 : 0;
+#else
+#ifdef __linux__
+    cpu_set_t set;
+    if (cpus && _parse_cpus (cpus, &set) < 0)
+        return -1;
+#else
+    if (cpus)
+        return -1;
+#endif
+    int policy, priority;
+    if (sched && _parse_sched (sched, &policy, &priority) < 0)
+        return -1;
+    return 0;
+#endif
+}
+
+int
+lcm_set_thread_scheduling (const char *cpus, const char *sched)
+{
+    if (lcm_internal_check_thread_scheduling (cpus, sched) < 0) {
+        fprintf (stderr, "LCM: invalid or unsupported thread scheduling "
+                "[%s] [%s]\n", cpus ? cpus : "", sched ? sched : "");
+        return -1;
+    }
+    int status = 0;
+#ifdef __linux__
+    if (cpus) {
+        cpu_set_t set;
+        _parse_cpus (cpus, &set);
+        int err = pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+        if (err) {
+            fprintf (stderr, "LCM: could not pin thread to CPUs %s: %s\n",
+                    cpus, strerror (err));
+            status = -1;
+        }
+    }
+#endif
+#ifndef WIN32
+    if (sched) {
+        int policy, priority;
+        _parse_sched (sched, &policy, &priority);
+        struct sched_param param;
+        memset (&param, 0, sizeof (param));
+        param.sched_priority = priority;
+        int err = pthread_setschedparam (pthread_self (), policy, &param);
+        if (err) {
+            // realtime policies usually need CAP_SYS_NICE or an rtprio limit
+            fprintf (stderr, "LCM: could not set thread scheduling %s: %s\n",
+                    sched, strerror (err));
+            status = -1;
+        }
+    }
+#endif
+    return status;
+}
+
+void
+lcm_internal_thread_init (const char *name, const char *cpus,
+        const char *sched)
+{
+    if (cpus || sched)
+        lcm_set_thread_scheduling (cpus, sched);
+
+    g_static_mutex_lock (&hook_lock);
+    lcm_thread_hook_t hook = thread_hook;
+    void *user = thread_hook_user;
+    g_static_mutex_unlock (&hook_lock);
+    if (hook)
+        hook (name, user);
+}
@@ -0,0 +1,58 @@
+#ifndef __lcm_trace_h__
+#define __lcm_trace_h__
+
+/*
+ * Static tracepoints on the paths that a message takes through LCM, for
+ * bpftrace, perf or SystemTap.  They are USDT probes of the "lcm" provider,
+ * built in when <sys/sdt.h> is found (see the LCM_ENABLE_USDT CMake option).
+ * A probe is a single nop until a tracer attaches to it, and expands to
+ * nothing at all otherwise.  For example:
+ *
+ *   bpftrace -e 'usdt:/usr/lib/liblcm.so:lcm:handler_start
+ *                { printf("%s\n", str(arg0)); }'
+ *
+ * Arguments that are not known at a probe are NULL or -1.
+ *
+ *   udpm_publish_entry (channel, size)
+ *   udpm_publish_return (channel, size, seqno, status)
+ *       around lcm_publish() on udpm.  At return, size is after
+ *       compression.
+ *   udpm_datagram (size, seqno, magic)
+ *       the receive thread got a datagram with an LCM header.
+ *   udpm_message (channel, size, seqno)
+ *       the datagram completed a message that has a subscriber.
+ *   udpm_enqueue (channel, size, seqno, num_queued)
+ *       the receive thread queued the message for lcm_handle().  num_queued
+ *       counts the messages of that thread not yet handled.
+ *   udpm_dispatch_start (channel, size, seqno)
+ *   udpm_dispatch_end (channel, size, seqno)
+ *       lcm_handle() passes the message to the subscriptions.
+ *   handler_start (channel, size, subscription)
+ *   handler_end (channel, size, subscription)
+ *       around a message handler, on whatever thread runs it.
+ *   drop (channel, size, seqno, reason)
+ *       a message or datagram was discarded for one of the LCM_TRACE_DROP_
+ *       reasons.
+ */
+
+#define LCM_TRACE_DROP_NO_BUFFER  1     // the receive buffer pool was full
+#define LCM_TRACE_DROP_QUEUE_FULL 2     // a subscription queue was full
+#define LCM_TRACE_DROP_CONFLATED  3     // a newer message replaced it
+#define LCM_TRACE_DROP_RATE_LIMITED 4   // over a subscription's max rate
+
+#ifdef LCM_ENABLE_USDT
+#include <sys/sdt.h>
+
+#define LCM_TRACE2(name, a, b) DTRACE_PROBE2 (lcm, name, a, b)
+#define LCM_TRACE3(name, a, b, c) DTRACE_PROBE3 (lcm, name, a, b, c)
+#define LCM_TRACE4(name, a, b, c, d) DTRACE_PROBE4 (lcm, name, a, b, c, d)
+
+#else
+
+#define LCM_TRACE2(name, a, b) do { } while (0)
+#define LCM_TRACE3(name, a, b, c) do { } while (0)
+#define LCM_TRACE4(name, a, b, c, d) do { } while (0)
+
+#endif
+
+#endif
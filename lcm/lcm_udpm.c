@@ -1,3 +1,7 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // for recvmmsg()
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +17,8 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <ifaddrs.h>
+#include <net/if.h>
 #include <sys/time.h>
 #include <sys/poll.h>
 #include <sys/select.h>
@@ -28,19 +34,125 @@
 #include <Ws2tcpip.h>
 
 #define MSG_EXT_HDR
+
+// the read threads wait on an I/O completion port with overlapped receives
+// posted to it, instead of calling select() and recvmsg() per datagram
+#define USE_IOCP
+#define LCM_IOCP_RECVS 32
+#define LCM_IOCP_RECV 1     // completion key of the posted receives
+#define LCM_IOCP_EXIT 2     // completion key of the exit command
+
+// WinPorting.cpp emulates sendmmsg() with WSASendMsg()
+#define USE_SENDMMSG
+#define LCM_SEND_BATCH 32
+
+typedef struct _udpm_iocp_recv {
+    // first, so that the OVERLAPPED of a completion is also the receive
+    WSAOVERLAPPED ov;
+    WSABUF wsabuf;
+    DWORD flags;
+    struct sockaddr from;
+    int fromlen;
+    char data[65536];
+} udpm_iocp_recv_t;
+#endif
+
+#ifdef __linux__
+// socket filters split the incoming traffic between several receive sockets,
+// and drop the channels that nobody subscribes to
+#include <linux/filter.h>
+#define USE_RECV_SHARDS
+#define USE_SOCKET_FILTER
+#endif
+
+#if defined(__linux__) && defined(IP_PKTINFO)
+// the interfaces option picks the outgoing interface of each datagram with an
+// IP_PKTINFO control message
+#define USE_MULTI_IFACE
+#endif
+
+#if defined(__linux__) && defined(SO_TIMESTAMPNS) && defined(SO_TIMESTAMPING)
+#include <linux/net_tstamp.h>
+#define USE_NS_TIMESTAMPS
 #endif
 
+// sources of receive timestamps, selected with the rx_timestamp option
+typedef enum {
+    UDPM_RX_TIMESTAMP_DEFAULT,  // SO_TIMESTAMP, microseconds
+    UDPM_RX_TIMESTAMP_NS,       // SO_TIMESTAMPNS
+    UDPM_RX_TIMESTAMP_SW,       // SO_TIMESTAMPING, software
+    UDPM_RX_TIMESTAMP_HW,       // SO_TIMESTAMPING, hardware
+} udpm_rx_timestamp_t;
+
+typedef enum {
+    UDPM_SELF_TEST_ASYNC,       // started with the read threads
+    UDPM_SELF_TEST_SYNC,        // the first subscription waits for it
+    UDPM_SELF_TEST_OFF,
+} udpm_self_test_t;
+
 #include <glib.h>
 
 #include "lcm.h"
 #include "lcm_internal.h"
 #include "dbg.h"
-#include "ringbuffer.h"
+#include "channel_matcher.h"
 #include "udpm_util.h"
+#include "lcm_trace.h"
+#include "lcm_interest.h"
 
 
 #define SELF_TEST_CHANNEL "LCM_SELF_TEST"
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+// read up to this many datagrams with each recvmmsg() call
+#define USE_RECVMMSG
+#define LCM_RECV_BATCH 16
+
+// send up to this many fragments with each sendmmsg() call
+#define USE_SENDMMSG
+#define LCM_SEND_BATCH 32
+
+typedef struct _udpm_rx_slot {
+    char data[65536];
+    struct sockaddr from;
+    struct iovec vec;
+    char control[64];
+} udpm_rx_slot_t;
+#endif
+
+#ifdef USE_IO_URING
+#ifdef USE_RECVMMSG
+// receive buffers handed to the kernel by each read thread.  Each one holds a
+// recvmsg header, the sender's address, the control messages and a datagram.
+#define LCM_URING_BUFS 32
+#define LCM_URING_CONTROL_SIZE 64
+#define LCM_URING_BUF_SIZE (sizeof (struct io_uring_recvmsg_out) + \
+        sizeof (struct sockaddr) + LCM_URING_CONTROL_SIZE + 65536)
+
+// user_data of the completions
+#define URING_RECV 1
+#define URING_EXIT 2
+#else
+// the io_uring read loop hands datagrams over like recvmmsg does
+#undef USE_IO_URING
+#endif
+#endif
+
+#ifdef USE_XDP
+#ifdef USE_RECVMMSG
+// UMEM frames of the AF_XDP socket of each read thread
+#define LCM_XDP_FRAMES 2048
+// the most batches read from it in a row before recvfd is looked at
+#define LCM_XDP_STREAK 64
+
+// the most NUMA nodes that the numa option can list
+#define UDPM_MAX_NUMA_NODES 16
+#else
+// so does the AF_XDP one
+#undef USE_XDP
+#endif
+#endif
+
 /**
  * udpm_params_t:
  * @mc_addr:        multicast address
@@ -51,6 +163,84 @@
  *                  don't use > 1.  that's just rude. 
  * @recv_buf_size:  requested size of the kernel receive buffer, set with
  *                  SO_RCVBUF.  0 indicates to use the default settings.
+ * @max_rate_mbps:  if nonzero, fragments of large messages are transmitted
+ *                  no faster than this many megabits per second.
+ * @burst_kb:       kilobytes of fragments that may be sent back to back when
+ *                  max_rate_mbps is set.
+ * @mtu:            if nonzero, published datagrams are no larger than this
+ *                  many bytes with their IP and UDP headers.
+ * @recv_pool_size: cap on the memory holding received packets, split
+ *                  between the receive threads.
+ * @prealloc:       if nonzero, the receive buffer pools are allocated and
+ *                  touched in lcm_udpm_create.
+ * @frag_store_size: if nonzero, hard cap in bytes on the memory holding
+ *                  messages being reassembled, split between the receive
+ *                  threads.
+ * @max_frag_msgs:  number of messages that may be reassembled at once,
+ *                  split between the receive threads.
+ * @frag_timeout_ms: how long a message being reassembled is kept without
+ *                  any of its fragments arriving, or -1 for no limit.
+ * @recv_threads:   number of receive sockets and read threads.  0 is the same
+ *                  as 1.
+ * @rx_timestamp:   where receive timestamps come from.
+ * @channel_filter: if nonzero, the receive sockets drop the messages on
+ *                  channels that nobody subscribes to, where supported.
+ * @fec_k, fec_m:   if fec_k is nonzero, fec_m parity packets are transmitted
+ *                  for every fec_k fragments of a large message.
+ * @reliable:       pattern of the channels whose messages are kept for
+ *                  retransmission, or NULL.  Only valid during
+ *                  lcm_udpm_create.
+ * @retransmit_window: number of sequence numbers for which messages on
+ *                  reliable channels are kept.
+ * @nack:           if nonzero, gaps in the senders' sequence numbers are
+ *                  reported back to them.
+ * @io_uring:       if nonzero, the read threads receive with io_uring where
+ *                  supported.
+ * @iocp:           if nonzero, the read threads receive with an I/O
+ *                  completion port on Windows.
+ * @xdp_ifname:     if set, the network interface on which the read threads
+ *                  receive the group's datagrams with AF_XDP sockets.
+ * @xdp_queue:      the receive queue of the interface that the first read
+ *                  thread takes, the next thread taking the next queue.
+ * @rx_cpu, rx_sched: CPUs and scheduling policy of the read threads, or NULL
+ *                  to leave them alone.
+ * @numa_auto:      if nonzero, the read threads and their memory are placed
+ *                  on the NUMA node of the receiving network interface.
+ * @numa_nodes:     otherwise, the NUMA nodes that read thread i and its
+ *                  memory are placed on, numa_nodes[i % num_numa_nodes].
+ * @busy_poll:      if nonzero, the number of microseconds that the read
+ *                  threads and lcm_udpm_handle spin before they sleep
+ *                  waiting for packets.
+ * @self_test:      how the self test runs when receiving starts.
+ * @compress:       LCM_CODEC_* used to compress published messages, or 0.
+ * @compress_min:   the smallest message data, in bytes, that is compressed.
+ * @compress_channels: pattern of the channels whose messages are
+ *                  compressed, or NULL for all of them.  Only valid during
+ *                  lcm_udpm_create.
+ * @tx_sockets:     number of transmit sockets.  Each publishing thread
+ *                  always uses the same one, and threads on different
+ *                  sockets transmit concurrently.  0 is the same as 1.
+ * @faults:         datagrams to drop, duplicate and reorder when
+ *                  transmitting, for testing.
+ * @batch_us:       if nonzero, small messages are held for up to this many
+ *                  microseconds and transmitted several to a datagram.
+ * @qos_channels:   pattern of the latency-critical channels, which are
+ *                  transmitted on a socket of their own marked with qos_dscp
+ *                  and qos_priority, or NULL.  Only valid during
+ *                  lcm_udpm_create.
+ * @qos_dscp:       the DSCP of the datagrams of qos_channels.
+ * @qos_priority:   the SO_PRIORITY of the datagrams of qos_channels, where
+ *                  supported.
+ * @ignore_local:   if nonzero, datagrams sent from this host are dropped.
+ * @interest:       if nonzero, the subscriptions are announced, and those of
+ *                  the other instances are kept track of (see
+ *                  lcm_interest.h).
+ * @announce_ms:    the interval between those announcements.
+ * @ifaces:         if set, the comma-separated network interfaces, by name
+ *                  or IPv4 address, that datagrams are transmitted on and
+ *                  the group is joined on.
+ * @iface_redundant: if nonzero, every datagram is transmitted on each of
+ *                  ifaces.  Otherwise they take turns.
  *
  */
 typedef struct _udpm_params_t udpm_params_t;
@@ -59,41 +249,270 @@ struct _udpm_params_t {
     uint16_t mc_port;
     uint8_t mc_ttl; 
     int recv_buf_size;
+    int recv_pool_size;
+    int prealloc;
+    int64_t frag_store_size;
+    int max_frag_msgs;
+    int frag_timeout_ms;
+    double max_rate_mbps;
+    int burst_kb;
+    int mtu;
+    int recv_threads;
+    udpm_rx_timestamp_t rx_timestamp;
+    int channel_filter;
+    int fec_k;
+    int fec_m;
+    const char *reliable;
+    int retransmit_window;
+    int io_uring;
+    int iocp;
+    char *xdp_ifname;
+    int xdp_queue;
+    int busy_poll;
+    char *rx_cpu;
+    char *rx_sched;
+    int numa_auto;
+    int num_numa_nodes;
+    int numa_nodes[UDPM_MAX_NUMA_NODES];
+    int nack;
+    udpm_self_test_t self_test;
+    int compress;
+    int compress_min;
+    const char *compress_channels;
+    int tx_sockets;
+    lcm_fault_params_t faults;
+    int batch_us;
+    const char *qos_channels;
+    int qos_dscp;
+    int qos_priority;
+    int ignore_local;
+    int interest;
+    int announce_ms;
+    char *ifaces;
+    int iface_redundant;
 };
 
 typedef struct _lcm_provider_t lcm_udpm_t;
-struct _lcm_provider_t {
-    SOCKET recvfd;
+
+// number of sequence numbers for which reliable messages are kept by default
+#define LCM_DEFAULT_RETRANSMIT_WINDOW 64
+
+// messages smaller than this are not compressed by default
+#define LCM_DEFAULT_COMPRESS_MIN 4096
+
+// the most transmit sockets that tx_sockets can ask for
+#define LCM_MAX_TX_SOCKETS 64
+
+// qos_channels are marked Expedited Forwarding, and queued by Linux in the
+// highest band that needs no privileges, by default
+#define LCM_DEFAULT_QOS_DSCP 46
+#define LCM_DEFAULT_QOS_PRIORITY 6
+
+// how long a receiver accepts the retransmissions it asked for
+#define NACK_TIMEOUT_USEC 2000000
+
+// the most messages a receive thread waits to be retransmitted
+#define MAX_NACKED_MSGS 1024
+
+// how long the self test waits for its messages, and how often it sends one
+static const GTimeVal SELF_TEST_TIMEOUT = { 10, 0 };
+static const GTimeVal SELF_TEST_RETRANSMIT_INTERVAL = { 0, 100000 };
+
+/* A message on a reliable channel, kept in case it has to be transmitted
+ * again.  data is NULL if the slot is empty. */
+typedef struct _udpm_retained_msg {
+    uint32_t seqno;
+    char channel[LCM_MAX_CHANNEL_NAME_LENGTH + 1];
+    char *data;
+    unsigned int datalen;
+    int compressed;             // data is an lcm_compress_payload
+} udpm_retained_msg_t;
+
+/* A transmit socket.  Receivers tell senders apart by their source address,
+ * so each socket has its own sequence numbers, and the fragments of a
+ * message all go out on one socket while its lock is held.  Publishing
+ * threads on different sockets don't wait for each other. */
+typedef struct _udpm_tx_lane {
     SOCKET sendfd;
-    struct sockaddr_in dest_addr;
+    GStaticMutex lock;
+
+    uint32_t msg_seqno;         // rolling counter of how many messages
+                                // transmitted.  protected by lock
+
+    /* If some channels are reliable, the messages published on them are kept
+     * in retained[seqno % retransmit_window], protected by lock, and
+     * nack_thread retransmits them when receivers ask for them. */
+    udpm_retained_msg_t *retained;
+
+    /* the faults injected into the datagrams transmitted on sendfd, or NULL.
+     * Protected by lock. */
+    lcm_fault_injector_t *faults;
+
+    /* With batch_us, the first batch_len bytes of a batch datagram that
+     * collects small messages until batch_deadline (monotonic microseconds),
+     * or NULL.  Protected by lock. */
+    char *batch;
+    int batch_len;
+    int64_t batch_deadline;
+
+    int qos;                    // nonzero for the socket of qos_channels
+
+    // with interfaces striped, the one that the next datagram goes out on.
+    // Protected by lock
+    int next_iface;
+} udpm_tx_lane_t;
+
+/* A network interface given with the interfaces option. */
+typedef struct _udpm_iface {
+    struct in_addr addr;
+    int index;
+} udpm_iface_t;
+
+/* A receive socket and the read thread that services it.  There is normally
+ * only one.  With recv_threads=N there are N, and a socket filter on each one
+ * only accepts the datagrams of the senders that hash to it, so that all the
+ * fragments of a message are reassembled by the same thread. */
+typedef struct _udpm_rx_shard udpm_rx_shard_t;
+struct _udpm_rx_shard {
+    lcm_udpm_t *lcm;
+    int index;
 
-    lcm_t * lcm;
+    SOCKET recvfd;
+    GThread *read_thread;
 
-    udpm_params_t params;
+    /* the NUMA node that the read thread and the memory it receives into are
+     * placed on, or -1, and the CPUs of that node */
+    int numa_node;
+    char *numa_cpus;
 
     /* size of the kernel UDP receive buffer */
     int kernel_rbuf_sz;
     int warned_about_small_kernel_buf;
 
-    /* Packet structures available for sending or receiving use are
-     * stored in the *_empty queues. */
-    lcm_buf_queue_t * inbufs_empty;
-    /* Received packets that are filled with data are queued here. */
-    lcm_buf_queue_t * inbufs_filled;
+    /* Memory for received small packets is taken from a pool with a fixed
+     * cap so we don't have to do any mallocs.  Only used by the read thread,
+     * which also frees the buffers that lcm_udpm_handle is done with. */
+    lcm_bufpool_t * pool;
+    lcm_buf_queue_t * free_bufs;
+
+    /* Filled buffers go to lcm_udpm_handle on the filled ring, or on
+     * filled_urgent if their channel has a priority above 0, and come back
+     * on the returned ring once they have been dispatched.  None takes a
+     * lock.  bufs_outstanding counts the buffers pushed on the filled rings
+     * and not yet taken back from returned, so that no ring can overflow. */
+    lcm_buf_ring_t * filled;
+    lcm_buf_ring_t * filled_urgent;
+    lcm_buf_ring_t * returned;
+    int bufs_outstanding;
 
-    /* Memory for received small packets is taken from a fixed-size ring buffer
-     * so we don't have to do any mallocs */
-    lcm_ringbuf_t * ringbuf;
+    lcm_frag_buf_store * frag_bufs;
+    /* nonzero once a parity packet was received, after which fragments that
+     * arrive before the first one of their message are kept, so that a lost
+     * first fragment can be rebuilt */
+    int parity_seen;
+
+    /* messages asked for again with a NACK, and not received yet
+     * (lcm_frag_key_t -> expiry time).  Only used by the read thread. */
+    GHashTable *nacked;
+
+    /* receive counters, updated by the read thread.  They are copied to
+     * stats_snapshot under stats_lock whenever the thread waits for more
+     * packets, or is about to wake up lcm_udpm_handle. */
+    lcm_transport_stats_t stats;
+    lcm_seq_tracker_t *seq_tracker;
+    GStaticMutex stats_lock;
+    lcm_transport_stats_t stats_snapshot;
+
+    /* the records of the last batch datagram received that were not handed
+     * out yet, batch[batch_off, batch_len), and where and when the datagram
+     * was received.  Only used by the read thread. */
+    char *batch;
+    int batch_off;
+    int batch_len;
+    struct sockaddr batch_from;
+    socklen_t batch_fromlen;
+    int64_t batch_recv_time_ns;
+
+#ifdef USE_RECVMMSG
+    /* datagrams read by the last recvmmsg() call.  rx_msgs[rx_next] through
+     * rx_msgs[rx_count-1] are not processed yet.  Only used by the read
+     * thread. */
+    udpm_rx_slot_t *rx_slots;
+    struct mmsghdr *rx_msgs;
+    int rx_count;
+    int rx_next;
+#endif
 
-    GStaticRecMutex mutex; /* Must be locked when reading/writing to the
-                              above three queues */
+#ifdef USE_IO_URING
+    /* with io_uring, a multishot recvmsg request fills the ring's receive
+     * buffers, and rx_msgs points into them.  rx_bids are the buffers
+     * to give back once the datagrams are processed.  Only used by the read
+     * thread. */
+    lcm_uring_t *uring;
+    int uring_armed;
+    struct msghdr uring_msg;
+    struct iovec *rx_vecs;
+    int *rx_bids;
+#endif
 
-    int thread_created;
-    GThread *read_thread;
-    int notify_pipe[2];         // pipe to notify application when messages arrive
-    int thread_msg_pipe[2];     // pipe to notify read thread when to quit
+#ifdef USE_XDP
+    /* with AF_XDP, the datagrams that the XDP program redirects to xsk are
+     * taken from its frames, and the others still arrive on recvfd.  While
+     * rx_xdp is set, rx_msgs points at xdp_dgrams, whose frames are given
+     * back once the datagrams are processed.  Only used by the read thread.
+     */
+    lcm_xsk_t *xsk;
+    int rx_xdp;
+    int xdp_streak;     // batches taken from xsk since recvfd was read
+    lcm_xsk_datagram_t *xdp_dgrams;
+    struct iovec *xdp_vecs;
+#endif
+
+#ifdef USE_IOCP
+    /* with an I/O completion port, LCM_IOCP_RECVS overlapped receives are
+     * kept posted on recvfd, and iocp_pending counts those not completed
+     * yet.  Only used by the read thread, and by _destroy_recv_parts once it
+     * has exited. */
+    HANDLE iocp;
+    udpm_iocp_recv_t *iocp_recvs;
+    int iocp_pending;
+#endif
+};
+
+struct _lcm_provider_t {
+    /* the transmit sockets.  The publishing threads are spread over the
+     * first num_thread_lanes, and with qos_channels the last one is for
+     * those channels. */
+    udpm_tx_lane_t *tx_lanes;
+    int num_tx_lanes;
+    int num_thread_lanes;
+    struct sockaddr_in dest_addr;
+
+    lcm_t * lcm;
+
+    udpm_params_t params;
+
+    GStaticRecMutex mutex; /* Must be locked when setting up or tearing
+                              down the receive shards */
 
-    GStaticMutex transmit_lock; // so that only thread at a time can transmit
+    /* channel pattern -> number of subscriptions to it, from which the socket
+     * filters are built.  Protected by mutex */
+    GHashTable *subscriptions;
+    /* nonzero while the socket filters drop unsubscribed channels.  The
+     * senders' sequence numbers then have gaps that are not losses. */
+    volatile gint filtering_channels;
+
+    int thread_created;
+    udpm_rx_shard_t *shards;
+    int num_shards;
+#ifdef USE_XDP
+    lcm_xdp_t *xdp;             // steers the group to the shards' xsk
+#endif
+    int notify_pipe[2];         // notifies application when messages arrive
+    volatile gint notify_pending; // 1 while notify_pipe holds a byte, or
+                                  // lcm_udpm_handle is draining the rings
+    int next_shard;             // shard lcm_udpm_handle looks at first
+    int thread_msg_pipe[2];     // pipe to notify read threads when to quit
 
     /* synchronization variables used only while allocating receive resources
      */
@@ -101,35 +520,192 @@ struct _lcm_provider_t {
     GCond* create_read_thread_cond;
     GMutex* create_read_thread_mutex;
 
-
-    /* other variables */
-    lcm_frag_buf_store * frag_bufs;
-
-    uint32_t     udp_rx;            // packets received and processed
-    uint32_t     udp_discarded_bad; // packets discarded because they were bad 
-                                    // somehow
-    double       udp_low_watermark; // least buffer available
-    int32_t      udp_last_report_secs;
-
-    uint32_t     msg_seqno; // rolling counter of how many messages transmitted
+    lcm_pacer_t  pacer;     // limits the fragment rate of all the transmit
+                            // sockets together.  protected by pacer_lock
+    GStaticMutex pacer_lock;
+
+    // channels whose messages are kept for retransmission, or NULL
+    lcm_channel_pattern_t *reliable;
+    GThread *nack_thread;
+    int nack_pipe[2];           // tells nack_thread to quit
+
+    // channels whose messages are compressed, or NULL for all of them
+    lcm_channel_pattern_t *compress_channels;
+
+    // channels transmitted on the QoS socket, or NULL
+    lcm_channel_pattern_t *qos_channels;
+
+    /* with batch_us, batch_thread transmits the batches whose deadline
+     * passed.  batch_pending is set, under batch_mutex, when a batch may be
+     * waiting.  batch_size is the size of batch datagrams, and messages whose
+     * record would take more than batch_max_record bytes are not batched. */
+    GThread *batch_thread;
+    GMutex *batch_mutex;
+    GCond *batch_cond;
+    int batch_pending;
+    int batch_exit;
+    int batch_size;
+    int batch_max_record;
+
+    /* the background self test.  self_test_mutex guards self_test_passed
+     * and self_test_stop.  The read threads only look for the self-test
+     * message while self_test_waiting is set. */
+    GThread *self_test_thread;
+    GMutex *self_test_mutex;
+    GCond *self_test_cond;
+    int self_test_passed;
+    int self_test_stop;
+    volatile gint self_test_waiting;
+
+    // with ignore_local, the IPv4 addresses of this host's interfaces
+    struct in_addr *local_addrs;
+    int num_local_addrs;
+
+    /* with interest, what the other instances subscribe to, as heard by the
+     * read threads.  interest_thread announces the subscriptions every
+     * announce_ms, and when told to through interest_pipe ('a', or 'x' to
+     * quit).  announce_pending is set while an 'a' is in the pipe. */
+    lcm_interest_table_t *interest;
+    int64_t node_id;
+    GThread *interest_thread;
+    int interest_pipe[2];
+    volatile gint announce_pending;
+
+    /* with interfaces, where datagrams are transmitted and the group is
+     * joined.  They all leave from the address of the first one, so that the
+     * receivers see one sender whichever link a datagram came over, and
+     * those that joined on several drop the copies of what they already
+     * have. */
+    udpm_iface_t *ifaces;
+    int num_ifaces;
 };
 
+/* Returns nonzero if channel is that of the interest announcements, which the
+ * read threads take whether or not anyone subscribes to it. */
+static inline int
+_is_interest (lcm_udpm_t *lcm, const char *channel)
+{
+    return lcm->interest && !strcmp (channel, LCM_INTEREST_CHANNEL);
+}
+
 static int _setup_recv_parts (lcm_udpm_t *lcm);
+static int _flush_batch (lcm_udpm_t *lcm, udpm_tx_lane_t *lane);
+#ifdef USE_SOCKET_FILTER
+static void _update_socket_filters (lcm_udpm_t *lcm);
+#endif
 
 static GStaticPrivate CREATE_READ_THREAD_PKEY = G_STATIC_PRIVATE_INIT;
 
+// one more than the number that picks the transmit socket of a thread
+static GStaticPrivate TX_LANE_PKEY = G_STATIC_PRIVATE_INIT;
+static volatile gint next_tx_thread = 0;
+
+static void
+_init_recv_shard (lcm_udpm_t *lcm, udpm_rx_shard_t *shard, int index)
+{
+    shard->lcm = lcm;
+    shard->index = index;
+    shard->recvfd = -1;
+    shard->numa_node = -1;
+    shard->stats.ring_low_watermark = 1.0;
+    shard->stats_snapshot = shard->stats;
+    shard->seq_tracker = lcm_seq_tracker_new (1);
+    shard->nacked = g_hash_table_new_full (lcm_frag_key_hash,
+            lcm_frag_key_equal, free, free);
+    g_static_mutex_init (&shard->stats_lock);
+}
+
+static void
+_publish_shard_stats (udpm_rx_shard_t *shard)
+{
+    if (shard->frag_bufs)
+        shard->stats.frag_bytes_high_watermark =
+            shard->frag_bufs->peak_total_size;
+    g_static_mutex_lock (&shard->stats_lock);
+    shard->stats_snapshot = shard->stats;
+    g_static_mutex_unlock (&shard->stats_lock);
+}
+
+/* Frees the data of the buffers that lcm_udpm_handle has given back, and
+ * keeps the lcm_buf_t structs for reuse.  Only called by the read thread. */
+static void
+_reclaim_bufs (udpm_rx_shard_t *shard)
+{
+    lcm_buf_t *lcmb;
+    while ((lcmb = lcm_buf_ring_pop (shard->returned))) {
+        lcm_buf_free_data (lcmb);
+        lcm_buf_enqueue (shard->free_bufs, lcmb);
+        shard->bufs_outstanding--;
+    }
+}
+
+/* Takes a buffer for the next datagram.  Its data is allocated separately,
+ * with _allocate_data. */
+static lcm_buf_t *
+_allocate_buf (udpm_rx_shard_t *shard)
+{
+    _reclaim_bufs (shard);
+    lcm_buf_t *lcmb = lcm_buf_allocate(shard->free_bufs);
+    lcmb->rx_shard = shard->index;
+    return lcmb;
+}
+
+/* Makes room for len bytes in lcmb, and keeps track of how full the pool
+ * gets.  Returns -1 if the pool is at its cap, in which case the datagram
+ * has to be dropped. */
+static int
+_allocate_data (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, unsigned int len)
+{
+    // buffers given back since lcmb was taken may make room
+    if (lcm_buf_allocate_data(lcmb, shard->pool, len) < 0)
+        _reclaim_bufs (shard);
+    if (lcm_buf_allocate_data(lcmb, shard->pool, len) < 0) {
+        dbg (DBG_LCM, "receive buffer pool full, dropping datagram\n");
+        shard->stats.num_dropped_no_buffer++;
+        return -1;
+    }
+    size_t capacity = lcm_bufpool_capacity(shard->pool);
+    size_t used = lcm_bufpool_used(shard->pool);
+    double buf_avail = ((double)(capacity - MIN (used, capacity))) / capacity;
+    if (buf_avail < shard->stats.ring_low_watermark)
+        shard->stats.ring_low_watermark = buf_avail;
+    return 0;
+}
+
 static void
 _destroy_recv_parts (lcm_udpm_t *lcm)
 {
+    if (lcm->self_test_thread) {
+        g_mutex_lock (lcm->self_test_mutex);
+        lcm->self_test_stop = 1;
+        g_cond_signal (lcm->self_test_cond);
+        g_mutex_unlock (lcm->self_test_mutex);
+        g_thread_join (lcm->self_test_thread);
+        lcm->self_test_thread = NULL;
+    }
+
     if (lcm->thread_created) {
-        // send the read thread an exit command
+        // send the read threads an exit command.  They only poll the pipe, so
+        // one byte is seen by all of them.
         int wstatus = lcm_internal_pipe_write(lcm->thread_msg_pipe[1], "\0", 1);
-        if(wstatus < 0) {
-            perror(__FILE__ " write(destroy)");
-        } else {
-            g_thread_join (lcm->read_thread);
+#ifdef USE_IOCP
+        // the threads waiting on a completion port get the exit command
+        // there instead
+        for (int i = 0; i < lcm->num_shards; i++)
+            if (lcm->shards[i].iocp)
+                PostQueuedCompletionStatus (lcm->shards[i].iocp, 0,
+                        LCM_IOCP_EXIT, NULL);
+#endif
+        for (int i = 0; i < lcm->num_shards; i++) {
+            if (!lcm->shards[i].read_thread)
+                continue;
+            if(wstatus < 0) {
+                perror(__FILE__ " write(destroy)");
+            } else {
+                g_thread_join (lcm->shards[i].read_thread);
+            }
+            lcm->shards[i].read_thread = NULL;
         }
-        lcm->read_thread = NULL;
         lcm->thread_created = 0;
     }
 
@@ -139,48 +715,166 @@ _destroy_recv_parts (lcm_udpm_t *lcm)
         lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
     }
 
-    if (lcm->recvfd >= 0) {
-        lcm_close_socket(lcm->recvfd);
-        lcm->recvfd = -1;
-    }
+    for (int i = 0; i < lcm->num_shards; i++) {
+        udpm_rx_shard_t *shard = &lcm->shards[i];
+        if (shard->recvfd >= 0)
+            lcm_close_socket(shard->recvfd);
+#ifdef USE_IOCP
+        if (shard->iocp) {
+            // closing the socket cancels the receives still posted.  Their
+            // buffers can only be freed once the cancellations are in.
+            DWORD nbytes;
+            ULONG_PTR key;
+            LPOVERLAPPED ov;
+            while (shard->iocp_pending > 0 &&
+                    (GetQueuedCompletionStatus (shard->iocp, &nbytes, &key,
+                        &ov, 1000) || ov)) {
+                if (ov)
+                    shard->iocp_pending--;
+            }
+            CloseHandle (shard->iocp);
+            if (!shard->iocp_pending)
+                free (shard->iocp_recvs);
+        }
+#endif
 
-    if (lcm->frag_bufs) {
-        lcm_frag_buf_store_destroy(lcm->frag_bufs);
-        lcm->frag_bufs = NULL;
-    }
+        if (shard->returned) {
+            _reclaim_bufs (shard);
+            lcm_buf_ring_free (shard->returned);
+        }
+        lcm_buf_ring_t *rings[] = { shard->filled, shard->filled_urgent };
+        for (int j = 0; j < 2; j++) {
+            if (!rings[j])
+                continue;
+            lcm_buf_t *lcmb;
+            while ((lcmb = lcm_buf_ring_pop (rings[j]))) {
+                lcm_buf_free_data (lcmb);
+                free (lcmb);
+            }
+            lcm_buf_ring_free (rings[j]);
+        }
+        if (shard->free_bufs)
+            lcm_buf_queue_free (shard->free_bufs);
 
-    if (lcm->inbufs_empty) {
-        lcm_buf_queue_free (lcm->inbufs_empty, lcm->ringbuf);
-        lcm->inbufs_empty = NULL;
-    }
-    if (lcm->inbufs_filled) {
-        lcm_buf_queue_free (lcm->inbufs_filled, lcm->ringbuf);
-        lcm->inbufs_filled = NULL;
-    }
-    if (lcm->ringbuf) {
-        lcm_ringbuf_free (lcm->ringbuf);
-        lcm->ringbuf = NULL;
+#ifdef USE_RECVMMSG
+        free (shard->rx_slots);
+        free (shard->rx_msgs);
+#endif
+#ifdef USE_IO_URING
+        if (shard->uring)
+            lcm_uring_destroy (shard->uring);
+        free (shard->rx_vecs);
+        free (shard->rx_bids);
+#endif
+#ifdef USE_XDP
+        if (shard->xsk)
+            lcm_xsk_destroy (shard->xsk);
+        free (shard->xdp_dgrams);
+        free (shard->xdp_vecs);
+#endif
+
+        free (shard->batch);
+        if (shard->frag_bufs)
+            lcm_frag_buf_store_destroy(shard->frag_bufs);
+        lcm_seq_tracker_destroy (shard->seq_tracker);
+        g_hash_table_destroy (shard->nacked);
+        g_static_mutex_free (&shard->stats_lock);
+        lcm_bufpool_free (shard->pool);
+        free (shard->numa_cpus);
     }
+    free (lcm->shards);
+    lcm->shards = NULL;
+    lcm->num_shards = 0;
+#ifdef USE_XDP
+    if (lcm->xdp)
+        lcm_xdp_detach (lcm->xdp);
+    lcm->xdp = NULL;
+#endif
 }
 
 void
 lcm_udpm_destroy (lcm_udpm_t *lcm) 
 {
     dbg (DBG_LCM, "closing lcm context\n");
+    if (lcm->interest_thread) {
+        if (lcm_internal_pipe_write (lcm->interest_pipe[1], "x", 1) < 0)
+            perror (__FILE__ " write(interest)");
+        else
+            g_thread_join (lcm->interest_thread);
+    }
     _destroy_recv_parts (lcm);
+    // the read threads are done with the interest table and pipe
+    if (lcm->interest_pipe[0] >= 0) {
+        lcm_internal_pipe_close (lcm->interest_pipe[0]);
+        lcm_internal_pipe_close (lcm->interest_pipe[1]);
+    }
+    if (lcm->interest)
+        lcm_interest_table_free (lcm->interest);
+
+    if (lcm->nack_thread) {
+        if (lcm_internal_pipe_write (lcm->nack_pipe[1], "\0", 1) < 0)
+            perror (__FILE__ " write(nack)");
+        else
+            g_thread_join (lcm->nack_thread);
+    }
+    if (lcm->nack_pipe[0] >= 0) {
+        lcm_internal_pipe_close (lcm->nack_pipe[0]);
+        lcm_internal_pipe_close (lcm->nack_pipe[1]);
+    }
+    if (lcm->batch_thread) {
+        g_mutex_lock (lcm->batch_mutex);
+        lcm->batch_exit = 1;
+        g_cond_signal (lcm->batch_cond);
+        g_mutex_unlock (lcm->batch_mutex);
+        g_thread_join (lcm->batch_thread);
+    }
+    if (lcm->batch_mutex) {
+        g_mutex_free (lcm->batch_mutex);
+        g_cond_free (lcm->batch_cond);
+    }
+    for (int i = 0; i < lcm->num_tx_lanes; i++) {
+        udpm_tx_lane_t *lane = &lcm->tx_lanes[i];
+        // the messages still waiting in the batch were published
+        if (lane->sendfd >= 0)
+            _flush_batch (lcm, lane);
+        free (lane->batch);
+        if (lane->retained) {
+            for (int j = 0; j < lcm->params.retransmit_window; j++)
+                free (lane->retained[j].data);
+            free (lane->retained);
+        }
+        if (lane->sendfd >= 0)
+            lcm_close_socket (lane->sendfd);
+        lcm_fault_injector_destroy (lane->faults);
+        g_static_mutex_free (&lane->lock);
+    }
+    free (lcm->tx_lanes);
+    if (lcm->reliable)
+        lcm_channel_pattern_free (lcm->reliable);
+    if (lcm->compress_channels)
+        lcm_channel_pattern_free (lcm->compress_channels);
+    if (lcm->qos_channels)
+        lcm_channel_pattern_free (lcm->qos_channels);
+    if (lcm->self_test_mutex) {
+        g_mutex_free (lcm->self_test_mutex);
+        g_cond_free (lcm->self_test_cond);
+    }
 
-    if (lcm->sendfd >= 0)
-        lcm_close_socket(lcm->sendfd);
-
-    lcm_internal_pipe_close(lcm->notify_pipe[0]);
-    lcm_internal_pipe_close(lcm->notify_pipe[1]);
+    lcm_internal_notify_close(lcm->notify_pipe);
 
+    g_hash_table_destroy (lcm->subscriptions);
     g_static_rec_mutex_free (&lcm->mutex);
-    g_static_mutex_free (&lcm->transmit_lock);
+    g_static_mutex_free (&lcm->pacer_lock);
     if(lcm->create_read_thread_mutex) {
         g_mutex_free(lcm->create_read_thread_mutex);
         g_cond_free(lcm->create_read_thread_cond);
     }
+    free (lcm->local_addrs);
+    free (lcm->ifaces);
+    free (lcm->params.ifaces);
+    free (lcm->params.rx_cpu);
+    free (lcm->params.rx_sched);
+    free (lcm->params.xdp_ifname);
     free (lcm);
 }
 
@@ -222,12 +916,326 @@ new_argument (gpointer key, gpointer value, gpointer user)
         if (endptr == value)
             fprintf (stderr, "Warning: Invalid value for recv_buf_size\n");
     }
+    else if (!strcmp ((char *) key, "recv_pool_size")) {
+        char *endptr = NULL;
+        params->recv_pool_size = strtol ((char *) value, &endptr, 0);
+        if (endptr == value ||
+                params->recv_pool_size < 2 * LCM_MAX_UNFRAGMENTED_PACKET_SIZE) {
+            fprintf (stderr, "Warning: Invalid value for recv_pool_size\n");
+            params->recv_pool_size = LCM_DEFAULT_RECV_POOL_SIZE;
+        }
+    }
+    else if (!strcmp ((char *) key, "prealloc")) {
+        char *endptr = NULL;
+        params->prealloc = strtol ((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf (stderr, "Warning: Invalid value for prealloc\n");
+            params->prealloc = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "frag_store_mb")) {
+        char *endptr = NULL;
+        double mb = strtod ((char *) value, &endptr);
+        if (endptr == value || mb < 0 || mb >= 4096) {
+            fprintf (stderr, "Warning: Invalid value for frag_store_mb\n");
+            mb = 0;
+        }
+        params->frag_store_size = (int64_t) (mb * 1024 * 1024);
+    }
+    else if (!strcmp ((char *) key, "max_frag_msgs")) {
+        char *endptr = NULL;
+        params->max_frag_msgs = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->max_frag_msgs < 1) {
+            fprintf (stderr, "Warning: Invalid value for max_frag_msgs\n");
+            params->max_frag_msgs = MAX_NUM_FRAG_BUFS;
+        }
+    }
+    else if (!strcmp ((char *) key, "frag_timeout_ms")) {
+        char *endptr = NULL;
+        params->frag_timeout_ms = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->frag_timeout_ms < -1) {
+            fprintf (stderr, "Warning: Invalid value for frag_timeout_ms\n");
+            params->frag_timeout_ms = FRAG_BUF_MAX_AGE_USEC / 1000;
+        }
+    }
     else if (!strcmp ((char *) key, "ttl")) {
         char *endptr = NULL;
         params->mc_ttl = strtol ((char *) value, &endptr, 0);
         if (endptr == value)
             fprintf (stderr, "Warning: Invalid value for ttl\n");
     }
+    else if (!strcmp ((char *) key, "max_rate_mbps")) {
+        char *endptr = NULL;
+        params->max_rate_mbps = strtod ((char *) value, &endptr);
+        if (endptr == value || params->max_rate_mbps < 0)
+            fprintf (stderr, "Warning: Invalid value for max_rate_mbps\n");
+    }
+    else if (!strcmp ((char *) key, "mtu")) {
+        char *endptr = NULL;
+        params->mtu = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || (params->mtu && params->mtu < LCM_MIN_MTU)) {
+            fprintf (stderr, "Warning: Invalid value for mtu\n");
+            params->mtu = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "burst_kb")) {
+        char *endptr = NULL;
+        params->burst_kb = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->burst_kb < 0)
+            fprintf (stderr, "Warning: Invalid value for burst_kb\n");
+    }
+    else if (!strcmp ((char *) key, "recv_threads")) {
+        char *endptr = NULL;
+        params->recv_threads = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->recv_threads < 0 ||
+                params->recv_threads > LCM_MAX_RECV_THREADS) {
+            fprintf (stderr, "Warning: Invalid value for recv_threads\n");
+            params->recv_threads = 1;
+        }
+#ifndef USE_RECV_SHARDS
+        if (params->recv_threads > 1) {
+            fprintf (stderr, "Warning: recv_threads is not supported on this "
+                    "platform.  Using 1\n");
+            params->recv_threads = 1;
+        }
+#endif
+    }
+    else if (!strcmp ((char *) key, "channel_filter")) {
+        char *endptr = NULL;
+        params->channel_filter = strtol ((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf (stderr, "Warning: Invalid value for channel_filter\n");
+            params->channel_filter = 1;
+        }
+    }
+    else if (!strcmp ((char *) key, "fec")) {
+        char *endptr = NULL;
+        params->fec_k = strtol ((char *) value, &endptr, 0);
+        params->fec_m = 1;
+        if (endptr != value && *endptr == ':') {
+            const char *m = endptr + 1;
+            params->fec_m = strtol (m, &endptr, 0);
+            if (endptr == m)
+                params->fec_m = 0;
+        }
+        if (endptr == value || *endptr || params->fec_k < 1 ||
+                params->fec_k > LCM_MAX_FEC_GROUP || params->fec_m < 1 ||
+                params->fec_m > params->fec_k) {
+            fprintf (stderr, "Warning: Invalid value for fec\n");
+            params->fec_k = params->fec_m = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "io")) {
+        if (!strcmp ((char *) value, "uring")) {
+            params->io_uring = 1;
+            params->iocp = 0;
+        } else if (!strcmp ((char *) value, "iocp")) {
+            params->iocp = 1;
+            params->io_uring = 0;
+        } else if (!strcmp ((char *) value, "select")) {
+            params->io_uring = 0;
+            params->iocp = 0;
+        } else {
+            fprintf (stderr, "Warning: Invalid value for io\n");
+        }
+    }
+    else if (!strcmp ((char *) key, "xdp")) {
+        free (params->xdp_ifname);
+        params->xdp_ifname = strdup ((char *) value);
+    }
+    else if (!strcmp ((char *) key, "xdp_queue")) {
+        char *endptr = NULL;
+        params->xdp_queue = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || *endptr || params->xdp_queue < 0) {
+            fprintf (stderr, "Warning: Invalid value for xdp_queue\n");
+            params->xdp_queue = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "rx_cpu") ||
+            !strcmp ((char *) key, "rx_sched")) {
+        int is_cpu = !strcmp ((char *) key, "rx_cpu");
+        if (lcm_internal_check_thread_scheduling (
+                    is_cpu ? (char *) value : NULL,
+                    is_cpu ? NULL : (char *) value) < 0) {
+            fprintf (stderr, "Warning: Invalid value for %s\n", (char *) key);
+        } else {
+            char **dest = is_cpu ? &params->rx_cpu : &params->rx_sched;
+            free (*dest);
+            *dest = strdup ((char *) value);
+        }
+    }
+    else if (!strcmp ((char *) key, "numa")) {
+        params->numa_auto = 0;
+        params->num_numa_nodes = 0;
+        if (!strcmp ((char *) value, "auto")) {
+            params->numa_auto = 1;
+        } else if (strcmp ((char *) value, "off")) {
+            gchar **nodes = g_strsplit ((char *) value, ",", 0);
+            int valid = g_strv_length (nodes) <= UDPM_MAX_NUMA_NODES;
+            for (int i = 0; valid && nodes[i]; i++) {
+                char *endptr = NULL;
+                long node = strtol (nodes[i], &endptr, 10);
+                valid = endptr != nodes[i] && !*endptr && node >= 0;
+                params->numa_nodes[params->num_numa_nodes++] = node;
+            }
+            g_strfreev (nodes);
+            if (!valid) {
+                fprintf (stderr, "Warning: Invalid value for numa\n");
+                params->num_numa_nodes = 0;
+            }
+        }
+    }
+    else if (!strcmp ((char *) key, "self_test")) {
+        if (!strcmp ((char *) value, "async"))
+            params->self_test = UDPM_SELF_TEST_ASYNC;
+        else if (!strcmp ((char *) value, "sync"))
+            params->self_test = UDPM_SELF_TEST_SYNC;
+        else if (!strcmp ((char *) value, "off"))
+            params->self_test = UDPM_SELF_TEST_OFF;
+        else
+            fprintf (stderr, "Warning: Invalid value for self_test\n");
+    }
+    else if (!strcmp ((char *) key, "compress")) {
+        int codec = lcm_codec_from_name ((char *) value);
+        if (codec > 0)
+            params->compress = codec;
+        else if (codec < 0)
+            fprintf (stderr, "Warning: LCM was built without %s compression\n",
+                    (char *) value);
+        else if (strcmp ((char *) value, "none"))
+            fprintf (stderr, "Warning: Invalid value for compress\n");
+    }
+    else if (!strcmp ((char *) key, "compress_min")) {
+        char *endptr = NULL;
+        params->compress_min = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->compress_min < 0) {
+            fprintf (stderr, "Warning: Invalid value for compress_min\n");
+            params->compress_min = LCM_DEFAULT_COMPRESS_MIN;
+        }
+    }
+    else if (!strcmp ((char *) key, "compress_channels")) {
+        params->compress_channels = (const char *) value;
+    }
+    else if (!strcmp ((char *) key, "tx_sockets")) {
+        char *endptr = NULL;
+        params->tx_sockets = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->tx_sockets < 0 ||
+                params->tx_sockets > LCM_MAX_TX_SOCKETS) {
+            fprintf (stderr, "Warning: Invalid value for tx_sockets\n");
+            params->tx_sockets = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "qos_channels")) {
+        params->qos_channels = (const char *) value;
+    }
+    else if (!strcmp ((char *) key, "qos_dscp")) {
+        char *endptr = NULL;
+        params->qos_dscp = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->qos_dscp < 0 || params->qos_dscp > 63) {
+            fprintf (stderr, "Warning: Invalid value for qos_dscp\n");
+            params->qos_dscp = LCM_DEFAULT_QOS_DSCP;
+        }
+    }
+    else if (!strcmp ((char *) key, "qos_priority")) {
+        char *endptr = NULL;
+        params->qos_priority = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->qos_priority < 0) {
+            fprintf (stderr, "Warning: Invalid value for qos_priority\n");
+            params->qos_priority = LCM_DEFAULT_QOS_PRIORITY;
+        }
+    }
+    else if (!strcmp ((char *) key, "batch_us")) {
+        char *endptr = NULL;
+        params->batch_us = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->batch_us < 0) {
+            fprintf (stderr, "Warning: Invalid value for batch_us\n");
+            params->batch_us = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "busy_poll")) {
+        char *endptr = NULL;
+        params->busy_poll = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->busy_poll < 0) {
+            fprintf (stderr, "Warning: Invalid value for busy_poll\n");
+            params->busy_poll = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "reliable")) {
+        params->reliable = (const char *) value;
+    }
+    else if (!strcmp ((char *) key, "retransmit_window")) {
+        char *endptr = NULL;
+        params->retransmit_window = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->retransmit_window <= 0) {
+            fprintf (stderr, "Warning: Invalid value for retransmit_window\n");
+            params->retransmit_window = LCM_DEFAULT_RETRANSMIT_WINDOW;
+        }
+    }
+    else if (!strcmp ((char *) key, "nack")) {
+        char *endptr = NULL;
+        params->nack = strtol ((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf (stderr, "Warning: Invalid value for nack\n");
+            params->nack = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "ignore_local")) {
+        char *endptr = NULL;
+        params->ignore_local = strtol ((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf (stderr, "Warning: Invalid value for ignore_local\n");
+            params->ignore_local = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "interest")) {
+        char *endptr = NULL;
+        params->interest = strtol ((char *) value, &endptr, 0);
+        if (endptr == value) {
+            fprintf (stderr, "Warning: Invalid value for interest\n");
+            params->interest = 0;
+        }
+    }
+    else if (!strcmp ((char *) key, "announce_ms")) {
+        char *endptr = NULL;
+        params->announce_ms = strtol ((char *) value, &endptr, 0);
+        if (endptr == value || params->announce_ms <= 0) {
+            fprintf (stderr, "Warning: Invalid value for announce_ms\n");
+            params->announce_ms = LCM_INTEREST_DEFAULT_INTERVAL_MS;
+        }
+    }
+    else if (!strcmp ((char *) key, "interfaces")) {
+        free (params->ifaces);
+        params->ifaces = strdup ((char *) value);
+    }
+    else if (!strcmp ((char *) key, "interface_mode")) {
+        if (!strcmp ((char *) value, "stripe"))
+            params->iface_redundant = 0;
+        else if (!strcmp ((char *) value, "redundant"))
+            params->iface_redundant = 1;
+        else
+            fprintf (stderr, "Warning: Invalid value for interface_mode\n");
+    }
+    else if (!strcmp ((char *) key, "rx_timestamp")) {
+        if (!strcmp ((char *) value, "ns"))
+            params->rx_timestamp = UDPM_RX_TIMESTAMP_NS;
+        else if (!strcmp ((char *) value, "sw"))
+            params->rx_timestamp = UDPM_RX_TIMESTAMP_SW;
+        else if (!strcmp ((char *) value, "hw"))
+            params->rx_timestamp = UDPM_RX_TIMESTAMP_HW;
+        else
+            fprintf (stderr, "Warning: Invalid value for rx_timestamp\n");
+#ifndef USE_NS_TIMESTAMPS
+        if (params->rx_timestamp != UDPM_RX_TIMESTAMP_DEFAULT) {
+            fprintf (stderr, "Warning: rx_timestamp is not supported on this "
+                    "platform\n");
+            params->rx_timestamp = UDPM_RX_TIMESTAMP_DEFAULT;
+        }
+#endif
+    }
+    else if (lcm_fault_params_parse (&params->faults, (char *) key,
+                (char *) value)) {
+        // drop_rate, dup_rate, reorder_rate or fault_seed
+    }
     else if (!strcmp ((char *) key, "transmit_only")) {
         fprintf (stderr, "%s:%d -- transmit_only option is now obsolete\n",
                 __FILE__, __LINE__);
@@ -238,69 +1246,195 @@ new_argument (gpointer key, gpointer value, gpointer user)
     }
 }
 
-static int 
-_recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
+/* Decompresses the *size bytes of a compressed message at payload.  Returns
+ * the malloc()ed message data, whose size is stored in *size, or NULL if it
+ * cannot be decompressed. */
+static char *
+_decompress (udpm_rx_shard_t *shard, const char *payload, uint32_t *size)
+{
+    char *data = NULL;
+    int data_size = lcm_decompress_payload (payload, *size, &data);
+    if (data_size < 0) {
+        dbg (DBG_LCM, "dropping message that could not be decompressed\n");
+        shard->stats.num_bad_packets++;
+        return NULL;
+    }
+    *size = data_size;
+    return data;
+}
+
+/* Returns 1, and counts the message as dropped, if a message of data_size
+ * bytes does not fit in the fragment store at all and the store has a hard
+ * cap. */
+static int
+_frag_too_large (udpm_rx_shard_t *shard, uint32_t data_size)
+{
+    if (!shard->lcm->params.frag_store_size ||
+            data_size <= shard->frag_bufs->max_total_size)
+        return 0;
+    dbg (DBG_LCM, "dropping message larger than the fragment store "
+            "(%d bytes)\n", data_size);
+    shard->stats.num_dropped_too_large++;
+    return 1;
+}
+
+/* Forgets fbuf, all of whose fragments have arrived.  Joined on several
+ * interfaces, the message is remembered, so that the copies of its fragments
+ * that come over the other links are dropped. */
+static void
+_frag_buf_complete (udpm_rx_shard_t *shard, lcm_frag_buf_t *fbuf)
+{
+    if (shard->lcm->num_ifaces > 1)
+        lcm_seq_tracker_set_complete (shard->seq_tracker, &fbuf->key.from,
+                fbuf->key.msg_seqno);
+    lcm_frag_buf_store_remove (shard->frag_bufs, fbuf);
+}
+
+/* Starts ignoring the message of which hdr is a fragment, so that the rest
+ * of its fragments are dropped as they arrive. */
+static void
+_ignore_message (udpm_rx_shard_t *shard, lcm_buf_t *lcmb,
+        const lcm2_header_long_t *hdr)
 {
-    lcm2_header_long_t *hdr = (lcm2_header_long_t*) lcmb->buf;
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_new_ignored (
+            *((struct sockaddr_in*) &lcmb->from), ntohl (hdr->msg_seqno),
+            ntohl (hdr->msg_size), ntohs (hdr->fragments_in_msg),
+            lcmb->recv_utime);
+    shard->stats.num_incomplete += lcm_frag_buf_store_add (shard->frag_bufs,
+            fbuf);
+    lcm_frag_buf_mark_received (fbuf, ntohs (hdr->fragment_no));
+    if (!fbuf->fragments_remaining)
+        _frag_buf_complete (shard, fbuf);
+}
 
-    // any existing fragment buffer for this message source?
-    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(lcm->frag_bufs,
-            &lcmb->from);
+/* pkt is the received datagram.  It need not be stored in lcmb, which only
+ * receives the message once all of its fragments have arrived.  compressed
+ * is nonzero if the datagram says that the message is compressed. */
+static int 
+_recv_message_fragment (udpm_rx_shard_t *shard, lcm_buf_t *lcmb,
+        const char *pkt, uint32_t sz, int compressed)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    lcm2_header_long_t *hdr = (lcm2_header_long_t*) pkt;
 
     uint32_t msg_seqno = ntohl (hdr->msg_seqno);
     uint32_t data_size = ntohl (hdr->msg_size);
     uint32_t fragment_offset = ntohl (hdr->fragment_offset);
-//    uint16_t fragment_no = ntohs (hdr->fragment_no);
+    uint16_t fragment_no = ntohs (hdr->fragment_no);
     uint16_t fragments_in_msg = ntohs (hdr->fragments_in_msg);
     uint32_t frag_size = sz - sizeof (lcm2_header_long_t);
     char *data_start = (char*) (hdr + 1);
 
-    // discard any stale fragments from previous messages
-    if (fbuf && ((fbuf->msg_seqno != msg_seqno) ||
-                 (fbuf->data_size != data_size))) {
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+    if (data_size > LCM_MAX_MESSAGE_SIZE) {
+        dbg (DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
+        return 0;
+    }
+    if (fragment_no >= fragments_in_msg) {
+        dbg (DBG_LCM, "bad fragment number\n");
+        shard->stats.num_bad_packets++;
+        return 0;
+    }
+
+    // messages that stopped arriving halfway are given up on
+    shard->stats.num_incomplete += lcm_frag_buf_store_expire (
+            shard->frag_bufs, lcmb->recv_utime);
+
+    // any existing fragment buffer for this message?
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup(shard->frag_bufs,
+            &lcmb->from, msg_seqno);
+
+    // a sender that restarted may reuse the sequence number
+    if (fbuf && ((fbuf->data_size != data_size) ||
+                 (fbuf->fragments_in_msg != fragments_in_msg))) {
+        if (!fbuf->ignored)
+            shard->stats.num_incomplete++;
         dbg(DBG_LCM, "Dropping message (missing %d fragments)\n",
             fbuf->fragments_remaining);
+        lcm_frag_buf_store_remove (shard->frag_bufs, fbuf);
         fbuf = NULL;
     }
 
-//    printf ("fragment %d/%d (offset %d/%d) seq %d packet sz: %d %p\n",
-//        ntohs(hdr->fragment_no) + 1, fragments_in_msg,
-//        fragment_offset, data_size, msg_seqno, sz, fbuf);
-
-    if (data_size > LCM_MAX_MESSAGE_SIZE) {
-        dbg (DBG_LCM, "rejecting huge message (%d bytes)\n", data_size);
+    // the rest of a message nobody wanted
+    if (fbuf && fbuf->ignored) {
+        if (!lcm_frag_buf_mark_received (fbuf, fragment_no))
+            return 0;
+        if (!fbuf->fragments_remaining)
+            _frag_buf_complete (shard, fbuf);
+        else
+            lcm_frag_buf_store_touch (shard->frag_bufs, fbuf,
+                    lcmb->recv_utime, lcmb->recv_time_ns);
         return 0;
     }
 
-    // create a new fragment buffer if necessary
-    if (!fbuf && hdr->fragment_no == 0) {
+    if (fragment_no == 0) {
         char *channel = (char*) (hdr + 1);
         int channel_sz = strlen (channel);
         if (channel_sz > LCM_MAX_CHANNEL_NAME_LENGTH) {
             dbg (DBG_LCM, "bad channel name length\n");
-            lcm->udp_discarded_bad++;
+            shard->stats.num_bad_packets++;
             return 0;
         }
 
-        // if the packet has no subscribers, drop the message now.
-        if(!lcm_has_handlers(lcm->lcm, channel))
+        // if the packet has no subscribers, or only rate-limited ones that
+        // are not due for another message, drop the message now, and the
+        // rest of its fragments as they arrive.
+        int channel_id = lcm_internal_channel_id (channel);
+        if (!_is_interest (lcm, channel) &&
+                (!lcm_has_handlers_by_id(lcm->lcm, channel, channel_id) ||
+                 lcm_decimate_message_by_id(lcm->lcm, channel, channel_id))) {
+            if (fbuf) {
+                lcm_frag_buf_store_ignore (shard->frag_bufs, fbuf);
+            } else {
+                fbuf = lcm_frag_buf_new_ignored (
+                        *((struct sockaddr_in*) &lcmb->from), msg_seqno,
+                        data_size, fragments_in_msg, lcmb->recv_utime);
+                shard->stats.num_incomplete += lcm_frag_buf_store_add (
+                        shard->frag_bufs, fbuf);
+            }
+            lcm_frag_buf_mark_received (fbuf, 0);
+            if (!fbuf->fragments_remaining)
+                _frag_buf_complete (shard, fbuf);
             return 0;
+        }
 
-        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
-                channel, msg_seqno, data_size, fragments_in_msg,
-                lcmb->recv_utime);
-        lcm_frag_buf_store_add (lcm->frag_bufs, fbuf);
+        if (!fbuf && _frag_too_large (shard, data_size)) {
+            _ignore_message (shard, lcmb, hdr);
+            return 0;
+        } else if (!fbuf) {
+            fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+                    channel, msg_seqno, data_size, fragments_in_msg,
+                    lcmb->recv_utime);
+            shard->stats.num_incomplete += lcm_frag_buf_store_add (
+                    shard->frag_bufs, fbuf);
+        } else if (!lcm_frag_buf_has_fragment (fbuf, 0)) {
+            strcpy (fbuf->channel, channel);
+        }
+        fbuf->channel_id = channel_id;
         data_start += channel_sz + 1;
         frag_size -= (channel_sz + 1);
+    } else if (!fbuf && _frag_too_large (shard, data_size)) {
+        _ignore_message (shard, lcmb, hdr);
+        return 0;
+    } else if (!fbuf && (shard->parity_seen || lcm->num_ifaces > 1 ||
+                !g_atomic_int_get (&lcm->filtering_channels))) {
+        // the first fragment is late, e.g. because it came over another
+        // interface, or lost and about to be rebuilt.  The channel is filled
+        // in when it arrives.
+        fbuf = lcm_frag_buf_new (*((struct sockaddr_in*) &lcmb->from),
+                NULL, msg_seqno, data_size, fragments_in_msg,
+                lcmb->recv_utime);
+        shard->stats.num_incomplete += lcm_frag_buf_store_add (shard->frag_bufs,
+                fbuf);
     }
 
     if (!fbuf) return 0;
+    if (compressed)
+        fbuf->compressed = 1;
 
 #ifdef __linux__
-    if(lcm->kernel_rbuf_sz < 262145 && 
-       data_size > lcm->kernel_rbuf_sz &&
-       ! lcm->warned_about_small_kernel_buf) {
+    if(shard->kernel_rbuf_sz < 262145 && 
+       data_size > shard->kernel_rbuf_sz &&
+       ! shard->warned_about_small_kernel_buf) {
         fprintf(stderr, 
 "==== LCM Warning ===\n"
 "LCM detected that large packets are being received, but the kernel UDP\n"
@@ -309,38 +1443,55 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 "\n"
 "For more information, visit:\n"
 "   http://lcm-proj.github.io/multicast_setup.html\n\n");
-        lcm->warned_about_small_kernel_buf = 1;
+        shard->warned_about_small_kernel_buf = 1;
     }
 #endif
 
     if (fragment_offset + frag_size > fbuf->data_size) {
         dbg (DBG_LCM, "dropping invalid fragment (off: %d, %d / %d)\n",
                 fragment_offset, frag_size, fbuf->data_size);
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+        lcm_frag_buf_store_remove (shard->frag_bufs, fbuf);
+        return 0;
+    }
+
+    // fragments can arrive more than once, e.g., when they are retransmitted
+    if (!lcm_frag_buf_mark_received (fbuf, fragment_no)) {
+        dbg (DBG_LCM, "duplicate fragment %d\n", fragment_no);
         return 0;
     }
 
     // copy data
     memcpy (fbuf->data + fragment_offset, data_start, frag_size);
-    fbuf->last_packet_utime = lcmb->recv_utime;
-
-    fbuf->fragments_remaining --;
+    lcm_frag_buf_store_touch (shard->frag_bufs, fbuf, lcmb->recv_utime,
+            lcmb->recv_time_ns);
 
     if (0 == fbuf->fragments_remaining) {
+        if (fbuf->compressed) {
+            uint32_t size = fbuf->data_size;
+            char *data = _decompress (shard, fbuf->data, &size);
+            if (!data) {
+                _frag_buf_complete (shard, fbuf);
+                return 0;
+            }
+            free (fbuf->data);
+            fbuf->data = data;
+            fbuf->data_size = size;
+        }
+
         // complete message received.  Is there a subscriber that still
         // wants it?  (i.e., does any subscriber have space in its queue?)
-        if(!lcm_try_enqueue_message(lcm->lcm, fbuf->channel)) {
+        if(!_is_interest (lcm, fbuf->channel) &&
+                !lcm_try_enqueue_message_by_id(lcm->lcm, fbuf->channel,
+                    fbuf->channel_id)) {
             // no... sad... free the fragment buffer and return
-            lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+            _frag_buf_complete (shard, fbuf);
             return 0;
         }
 
         // yes, transfer the message into the lcm_buf_t
 
-        // deallocate the ringbuffer-allocated buffer
-        g_static_rec_mutex_lock (&lcm->mutex);
-        lcm_buf_free_data(lcmb, lcm->ringbuf);
-        g_static_rec_mutex_unlock (&lcm->mutex);
+        // deallocate the pool-allocated buffer
+        lcm_buf_free_data(lcmb);
 
         // transfer ownership of the message's payload buffer
         lcmb->buf = fbuf->data;
@@ -348,12 +1499,14 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
 
         strcpy (lcmb->channel_name, fbuf->channel);
         lcmb->channel_size = strlen (lcmb->channel_name);
+        lcmb->channel_id = fbuf->channel_id;
         lcmb->data_offset = 0;
         lcmb->data_size = fbuf->data_size;
         lcmb->recv_utime = fbuf->last_packet_utime;
+        lcmb->recv_time_ns = fbuf->last_packet_time_ns;
 
         // don't need the fragment buffer anymore
-        lcm_frag_buf_store_remove (lcm->frag_bufs, fbuf);
+        _frag_buf_complete (shard, fbuf);
 
         return 1;
     }
@@ -361,9 +1514,22 @@ _recv_message_fragment (lcm_udpm_t *lcm, lcm_buf_t *lcmb, uint32_t sz)
     return 0;
 }
 
+// Called by the read threads when the background self test gets through.
+static void
+_self_test_received (lcm_udpm_t *lcm)
+{
+    g_atomic_int_set (&lcm->self_test_waiting, 0);
+    g_mutex_lock (lcm->self_test_mutex);
+    lcm->self_test_passed = 1;
+    g_cond_signal (lcm->self_test_cond);
+    g_mutex_unlock (lcm->self_test_mutex);
+}
+
 static int
-_recv_short_message (lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
+_recv_short_message (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, int sz,
+        int compressed)
 {
+    lcm_udpm_t *lcm = shard->lcm;
     lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
 
     // shouldn't have to worry about buffer overflow here because we
@@ -374,14 +1540,51 @@ _recv_short_message (lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
 
     if (lcmb->channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
         dbg (DBG_LCM, "bad channel name length\n");
-        lcm->udp_discarded_bad++;
+        shard->stats.num_bad_packets++;
+        return 0;
+    }
+
+    // the self test's own message isn't for the subscribers
+    if (g_atomic_int_get (&lcm->self_test_waiting) &&
+            !strcmp (pkt_channel_str, SELF_TEST_CHANNEL)) {
+        _self_test_received (lcm);
         return 0;
     }
 
-    lcm->udp_rx++;
+    // the only time the channel name is hashed for this message
+    lcmb->channel_id = lcm_internal_channel_id (pkt_channel_str);
+
+    if (compressed) {
+        // decompress first, so that a message that turns out to be corrupt
+        // is never enqueued
+        if (!_is_interest (lcm, pkt_channel_str) &&
+                !lcm_has_handlers_by_id (lcm->lcm, pkt_channel_str,
+                    lcmb->channel_id))
+            return 0;
+        int data_offset = sizeof (lcm2_header_short_t) +
+            lcmb->channel_size + 1;
+        if (sz < data_offset) {
+            shard->stats.num_bad_packets++;
+            return 0;
+        }
+        uint32_t size = sz - data_offset;
+        char *data = _decompress (shard, lcmb->buf + data_offset, &size);
+        if (!data)
+            return 0;
+        strcpy (lcmb->channel_name, pkt_channel_str);
+        lcm_buf_free_data (lcmb);
+        lcmb->buf = data;
+        lcmb->data_offset = 0;
+        lcmb->data_size = size;
+        return _is_interest (lcm, lcmb->channel_name) ||
+            lcm_try_enqueue_message_by_id (lcm->lcm, lcmb->channel_name,
+                    lcmb->channel_id);
+    }
 
     // if the packet has no subscribers, drop the message now.
-    if(!lcm_try_enqueue_message(lcm->lcm, pkt_channel_str))
+    if(!_is_interest (lcm, pkt_channel_str) &&
+            !lcm_try_enqueue_message_by_id(lcm->lcm, pkt_channel_str,
+                lcmb->channel_id))
         return 0;
 
     strcpy (lcmb->channel_name, pkt_channel_str);
@@ -393,251 +1596,1540 @@ _recv_short_message (lcm_udpm_t *lcm, lcm_buf_t *lcmb, int sz)
     return 1;
 }
 
-// read continuously until a complete message arrives
-static lcm_buf_t *
-udp_read_packet (lcm_udpm_t *lcm)
+/* XORs the payload of fragment frag_no into parity, which has room for
+ * fragment_size bytes.  The payload of a fragmented message is its channel
+ * name with its terminating zero, then its data, cut into fragments of
+ * fragment_size bytes.  Returns the size of the fragment. */
+static int
+_fec_xor_fragment (uint8_t *parity, const char *channel, int channel_size,
+        const uint8_t *data, int payload_size, int fragment_size, int frag_no)
 {
-    lcm_buf_t *lcmb = NULL;
+    int start = frag_no * fragment_size;
+    int end = MIN (start + fragment_size, payload_size);
+    int i = start;
+    for (; i < end && i <= channel_size; i++)
+        parity[i - start] ^= (uint8_t) channel[i];
+    const uint8_t *src = data + i - (channel_size + 1);
+    uint8_t *dst = parity + i - start;
+    for (int n = end - i; n > 0; n--)
+        *dst++ ^= *src++;
+    return end - start;
+}
 
-    int sz = 0;
+/* Rebuilds the fragment covered by a parity packet if it is the only one
+ * missing, and processes it as if it had been received.  Returns 1 if this
+ * completed a message. */
+static int
+_recv_parity (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, const char *pkt,
+        uint32_t sz)
+{
+    lcm2_header_parity_t *hdr = (lcm2_header_parity_t*) pkt;
+    if (sz < sizeof (lcm2_header_parity_t)) {
+        shard->stats.num_bad_packets++;
+        return 0;
+    }
+    shard->parity_seen = 1;
 
-    // TODO warn about message loss somewhere else.
-
-//    g_static_rec_mutex_lock (&lcm->mutex);
-//    unsigned int ring_capacity = lcm_ringbuf_capacity(lcm->ringbuf);
-//    unsigned int ring_used = lcm_ringbuf_used(lcm->ringbuf);
-//    double buf_avail = ((double)(ring_capacity - ring_used)) / ring_capacity;
-//    g_static_rec_mutex_unlock (&lcm->mutex);
-//    if (buf_avail < lcm->udp_low_watermark)
-//        lcm->udp_low_watermark = buf_avail;
-//
-//    GTimeVal tv;
-//    g_get_current_time(&tv);
-//    int elapsedsecs = tv.tv_sec - lcm->udp_last_report_secs;
-//    if (elapsedsecs > 2) {
-//        uint32_t total_bad = lcm->udp_discarded_bad;
-//        if (total_bad > 0 || lcm->udp_low_watermark < 0.5) {
-//            fprintf(stderr, 
-//                    "%d.%03d LCM loss %4.1f%% : %5d err, "
-//                    "buf avail %4.1f%%\n", 
-//                   (int) tv.tv_sec, (int) tv.tv_usec/1000,
-//                   total_bad * 100.0 / (lcm->udp_rx + total_bad),
-//                   lcm->udp_discarded_bad,
-//                   100.0 * lcm->udp_low_watermark);
-//            
-//            lcm->udp_rx = 0;
-//            lcm->udp_discarded_bad = 0;
-//            lcm->udp_last_report_secs = tv.tv_sec;
-//            lcm->udp_low_watermark = HUGE;
-//        }
-//    }
-    
-    int got_complete_message = 0;
+    uint32_t msg_seqno = ntohl (hdr->msg_seqno);
+    int fragments_in_msg = ntohs (hdr->fragments_in_msg);
+    int first = ntohs (hdr->first_fragment);
+    int stride = ntohs (hdr->stride);
+    int num_covered = ntohs (hdr->num_covered);
+    int fragment_size = ntohs (hdr->fragment_size);
+    int last_size = ntohs (hdr->last_fragment_size);
+    int parity_size = sz - sizeof (lcm2_header_parity_t);
+    if (!stride || !num_covered || !fragment_size ||
+            last_size > fragment_size || parity_size > fragment_size ||
+            first + (num_covered - 1) * stride >= fragments_in_msg) {
+        dbg (DBG_LCM, "bad parity packet\n");
+        shard->stats.num_bad_packets++;
+        return 0;
+    }
 
-    while (!got_complete_message) {
-        // wait for either incoming UDP data, or for an abort message
-        fd_set fds;
-        FD_ZERO (&fds);
-        FD_SET (lcm->recvfd, &fds);
-        FD_SET (lcm->thread_msg_pipe[0], &fds);
-        SOCKET maxfd = MAX(lcm->recvfd, lcm->thread_msg_pipe[0]);
+    lcm_frag_buf_t *fbuf = lcm_frag_buf_store_lookup (shard->frag_bufs,
+            &lcmb->from, msg_seqno);
+    if (!fbuf || fbuf->ignored || fbuf->fragments_in_msg != fragments_in_msg)
+        return 0;
 
-        if (select (maxfd + 1, &fds, NULL, NULL, NULL) <= 0) { 
-            perror ("udp_read_packet -- select:");
+    // only one missing fragment can be rebuilt
+    int missing = -1;
+    for (int i = 0; i < num_covered; i++) {
+        int frag_no = first + i * stride;
+        if (lcm_frag_buf_has_fragment (fbuf, frag_no))
             continue;
-        }
+        if (missing >= 0)
+            return 0;
+        missing = frag_no;
+    }
+    if (missing < 0)
+        return 0;
 
-        if (FD_ISSET (lcm->thread_msg_pipe[0], &fds)) {
-            // received an exit command.
-            dbg (DBG_LCM, "read thread received exit command\n");
-            if (lcmb) {
-                // lcmb is not on one of the memory managed buffer queues.  We could
-                // either put it back on one of the queues, or just free it here.  Do the
-                // latter.
-                //
-                // Can also just free its lcm_buf_t here.  Its data buffer is
-                // managed either by the ring buffer or the fragment buffer, so
-                // we can ignore it.
-                free (lcmb);
-            }
-            return NULL;
-        }
+    // the channel name and its zero come before the data
+    int payload_size = (fragments_in_msg - 1) * fragment_size + last_size;
+    int header_size = payload_size - (int) fbuf->data_size;
+    int frag_size = (missing == fragments_in_msg - 1) ? last_size :
+        fragment_size;
+    if (header_size < 1 || header_size > LCM_MAX_CHANNEL_NAME_LENGTH + 1 ||
+            frag_size > parity_size) {
+        dbg (DBG_LCM, "bad parity packet\n");
+        shard->stats.num_bad_packets++;
+        return 0;
+    }
 
-        // there is incoming UDP data ready.
-        assert (FD_ISSET (lcm->recvfd, &fds));
+    char *frag = (char*) malloc (sizeof (lcm2_header_long_t) + parity_size);
+    uint8_t *payload = (uint8_t*) (frag + sizeof (lcm2_header_long_t));
+    memcpy (payload, pkt + sizeof (lcm2_header_parity_t), parity_size);
+    for (int i = 0; i < num_covered; i++) {
+        int frag_no = first + i * stride;
+        if (frag_no != missing)
+            _fec_xor_fragment (payload, fbuf->channel, header_size - 1,
+                    (uint8_t*) fbuf->data, payload_size, fragment_size,
+                    frag_no);
+    }
 
-        if (!lcmb) {
-            g_static_rec_mutex_lock (&lcm->mutex);
-            lcmb = lcm_buf_allocate_data(lcm->inbufs_empty, &lcm->ringbuf);
-            g_static_rec_mutex_unlock (&lcm->mutex);
-        }
-        struct iovec        vec;
-        vec.iov_base = lcmb->buf;
-        vec.iov_len = 65535;
+    int status = 0;
+    if (missing == 0 && payload[header_size - 1] != 0) {
+        dbg (DBG_LCM, "rebuilt a bad first fragment\n");
+    } else {
+        lcm2_header_long_t *frag_hdr = (lcm2_header_long_t*) frag;
+        frag_hdr->magic = htonl (LCM2_MAGIC_LONG);
+        frag_hdr->msg_seqno = htonl (msg_seqno);
+        frag_hdr->msg_size = htonl (fbuf->data_size);
+        frag_hdr->fragment_offset = htonl (missing ?
+                missing * fragment_size - header_size : 0);
+        frag_hdr->fragment_no = htons (missing);
+        frag_hdr->fragments_in_msg = htons (fragments_in_msg);
+        shard->stats.num_fec_recovered++;
+        status = _recv_message_fragment (shard, lcmb, frag,
+                sizeof (lcm2_header_long_t) + frag_size, 0);
+    }
+    free (frag);
+    return status;
+}
 
-        struct msghdr msg;
-        memset(&msg, 0, sizeof(struct msghdr));
-        msg.msg_name = &lcmb->from;
-        msg.msg_namelen = sizeof (struct sockaddr);
-        msg.msg_iov = &vec;
-        msg.msg_iovlen = 1;
-#ifdef MSG_EXT_HDR
-        // operating systems that provide SO_TIMESTAMP allow us to obtain more
-        // accurate timestamps by having the kernel produce timestamps as soon
-        // as packets are received.
-        char controlbuf[64];
-        msg.msg_control = controlbuf;
-        msg.msg_controllen = sizeof (controlbuf);
-        msg.msg_flags = 0;
-#endif
-        sz = recvmsg (lcm->recvfd, &msg, 0);
+static gboolean
+_nack_is_expired (gpointer key, gpointer value, gpointer user)
+{
+    return *(int64_t*) value <= *(int64_t*) user;
+}
 
-        if (sz < 0) {
-            perror ("udp_read_packet -- recvmsg");
-            lcm->udp_discarded_bad++;
-            continue;
-        }
+/* Asks the sender of lcmb to retransmit the count messages before msg_seqno,
+ * which never arrived. */
+static void
+_send_nack (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, uint32_t msg_seqno,
+        int count)
+{
+    count = MIN (count, LCM_MAX_NACK_COUNT);
+    int64_t now = lcmb->recv_utime;
+    g_hash_table_foreach_remove (shard->nacked, _nack_is_expired, &now);
+    if (g_hash_table_size (shard->nacked) + count > MAX_NACKED_MSGS) {
+        dbg (DBG_LCM, "too many messages NACKed already\n");
+        return;
+    }
 
-        if (sz < sizeof(lcm2_header_short_t)) { 
-            // packet too short to be LCM
-            lcm->udp_discarded_bad++;
-            continue;
-        }
+    lcm2_nack_t nack;
+    nack.magic = htonl (LCM2_MAGIC_NACK);
+    nack.first_seqno = htonl (msg_seqno - count);
+    nack.count = htonl (count);
+    if (sendto (shard->recvfd, (char *) &nack, sizeof (nack), 0,
+                (struct sockaddr*) &lcmb->from, lcmb->fromlen) < 0) {
+        perror ("sendto (nack)");
+        return;
+    }
+    shard->stats.num_nacked += count;
+
+    for (int i = count; i > 0; i--) {
+        lcm_frag_key_t *key = (lcm_frag_key_t *) calloc (1,
+                sizeof (lcm_frag_key_t));
+        key->from = *(struct sockaddr_in *) &lcmb->from;
+        key->msg_seqno = msg_seqno - i;
+        int64_t *expiry = (int64_t *) malloc (sizeof (int64_t));
+        *expiry = now + NACK_TIMEOUT_USEC;
+        g_hash_table_replace (shard->nacked, key, expiry);
+    }
+}
 
-        lcmb->fromlen = msg.msg_namelen;
+/* Returns 1 if a NACK asked for message msg_seqno of the sender of lcmb, and
+ * the retransmission is not too late. */
+static int
+_was_nacked (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, uint32_t msg_seqno)
+{
+    if (!g_hash_table_size (shard->nacked))
+        return 0;
+    lcm_frag_key_t key;
+    memset (&key, 0, sizeof (key));
+    key.from = *(struct sockaddr_in *) &lcmb->from;
+    key.msg_seqno = msg_seqno;
+    int64_t *expiry = (int64_t *) g_hash_table_lookup (shard->nacked, &key);
+    return expiry && *expiry > lcmb->recv_utime;
+}
 
-        int got_utime = 0;
-#ifdef SO_TIMESTAMP
-        struct cmsghdr * cmsg = CMSG_FIRSTHDR (&msg);
-        /* Get the receive timestamp out of the packet headers if possible */
-        while (!lcmb->recv_utime && cmsg) {
-            if (cmsg->cmsg_level == SOL_SOCKET &&
-                    cmsg->cmsg_type == SCM_TIMESTAMP) {
-                struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
-                lcmb->recv_utime = (int64_t) t->tv_sec * 1000000 + t->tv_usec;
-                got_utime = 1;
-                break;
-            }
-            cmsg = CMSG_NXTHDR (&msg, cmsg);
+static void
+_forget_nacked (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, uint32_t msg_seqno)
+{
+    if (!g_hash_table_size (shard->nacked))
+        return;
+    lcm_frag_key_t key;
+    memset (&key, 0, sizeof (key));
+    key.from = *(struct sockaddr_in *) &lcmb->from;
+    key.msg_seqno = msg_seqno;
+    g_hash_table_remove (shard->nacked, &key);
+}
+
+/* Returns nonzero if lcmb was sent from one of the addresses of this host. */
+static int
+_is_local_sender (lcm_udpm_t *lcm, const lcm_buf_t *lcmb)
+{
+    const struct sockaddr_in *from = (const struct sockaddr_in *) &lcmb->from;
+    for (int i = 0; i < lcm->num_local_addrs; i++)
+        if (from->sin_addr.s_addr == lcm->local_addrs[i].s_addr)
+            return 1;
+    return 0;
+}
+
+/* Processes one received datagram of sz bytes, which starts at pkt.  Returns 1
+ * if it completed a message, which is then stored in lcmb. */
+static int
+_recv_datagram (udpm_rx_shard_t *shard, lcm_buf_t *lcmb, const char *pkt,
+        int sz)
+{
+    lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) pkt;
+    uint32_t rcvd_magic = ntohl(hdr2->magic);
+
+    if (shard->lcm->num_local_addrs && _is_local_sender (shard->lcm, lcmb)) {
+        dbg (DBG_LCM, "ignoring a datagram from this host\n");
+        return 0;
+    }
+
+    // the messages of a batch are handed out one at a time by
+    // _next_batch_record()
+    if (rcvd_magic == LCM2_MAGIC_BATCH) {
+        LCM_TRACE3 (udpm_datagram, sz, -1, rcvd_magic);
+        if (!shard->batch)
+            shard->batch = (char *) malloc (65536);
+        memcpy (shard->batch, pkt, sz);
+        shard->batch_off = sizeof (uint32_t);
+        shard->batch_len = sz;
+        shard->batch_from = lcmb->from;
+        shard->batch_fromlen = lcmb->fromlen;
+        shard->batch_recv_time_ns = lcmb->recv_time_ns;
+        return 0;
+    }
+
+    uint32_t msg_seqno = ntohl (hdr2->msg_seqno);
+    lcmb->msg_seqno = msg_seqno;
+    LCM_TRACE3 (udpm_datagram, sz, msg_seqno, rcvd_magic);
+
+    // compressed messages are otherwise handled like the others, and only
+    // decompressed once they are complete
+    int compressed = 0;
+    uint32_t plain_magic = rcvd_magic & ~LCM2_MAGIC_COMPRESSED;
+    if (plain_magic != rcvd_magic && (plain_magic == LCM2_MAGIC_SHORT ||
+                plain_magic == LCM2_MAGIC_LONG ||
+                plain_magic == LCM2_MAGIC_SHORT_RETRANSMIT ||
+                plain_magic == LCM2_MAGIC_LONG_RETRANSMIT)) {
+        compressed = 1;
+        rcvd_magic = plain_magic;
+    }
+
+    // retransmissions are multicast, and only accepted by the receivers that
+    // asked for them.  A fragmented message stays wanted until all of its
+    // fragments are in.
+    if (rcvd_magic == LCM2_MAGIC_SHORT_RETRANSMIT ||
+            rcvd_magic == LCM2_MAGIC_LONG_RETRANSMIT) {
+        int is_fragment = rcvd_magic == LCM2_MAGIC_LONG_RETRANSMIT;
+        if (_was_nacked (shard, lcmb, msg_seqno)) {
+            _forget_nacked (shard, lcmb, msg_seqno);
+            shard->stats.num_retransmitted++;
+        } else if (!is_fragment || !lcm_frag_buf_store_lookup (
+                    shard->frag_bufs, &lcmb->from, msg_seqno)) {
+            return 0;
         }
-#endif
-        if (!got_utime)
-            lcmb->recv_utime = lcm_timestamp_now ();
+        rcvd_magic = is_fragment ? LCM2_MAGIC_LONG : LCM2_MAGIC_SHORT;
+    } else if (rcvd_magic == LCM2_MAGIC_SHORT ||
+            rcvd_magic == LCM2_MAGIC_LONG) {
+        // an original that was only late
+        _forget_nacked (shard, lcmb, msg_seqno);
+    }
 
-        lcm2_header_short_t *hdr2 = (lcm2_header_short_t*) lcmb->buf;
-        uint32_t rcvd_magic = ntohl(hdr2->magic);
-        if (rcvd_magic == LCM2_MAGIC_SHORT)
-            got_complete_message = _recv_short_message (lcm, lcmb, sz);
-        else if (rcvd_magic == LCM2_MAGIC_LONG)
-            got_complete_message = _recv_message_fragment (lcm, lcmb, sz);
-        else {
-            dbg (DBG_LCM, "LCM: bad magic\n");
-            lcm->udp_discarded_bad++;
-            continue;
+    if (rcvd_magic == LCM2_MAGIC_SHORT || rcvd_magic == LCM2_MAGIC_LONG) {
+        int skipped = lcm_seq_tracker_update (shard->seq_tracker,
+                (struct sockaddr_in *) &lcmb->from, msg_seqno,
+                rcvd_magic == LCM2_MAGIC_LONG, lcmb->recv_utime,
+                &shard->stats);
+        if (skipped > 0 && shard->lcm->params.nack)
+            _send_nack (shard, lcmb, msg_seqno, skipped);
+
+        // joined on several interfaces, the same datagram may come over
+        // each link.  A short message is a copy if its sequence number was
+        // seen.  The fragments of a message share theirs, and may arrive in
+        // any order, so only those of a completed message are dropped here.
+        // Copies of the fragments of a message in progress are told apart
+        // by its fragment buffer.
+        if (shard->lcm->num_ifaces > 1 &&
+                (rcvd_magic == LCM2_MAGIC_SHORT ? skipped < 0 :
+                 lcm_seq_tracker_is_complete (shard->seq_tracker,
+                     (struct sockaddr_in *) &lcmb->from, msg_seqno))) {
+            dbg (DBG_LCM, "dropping a copy of message %u\n", msg_seqno);
+            return 0;
+        }
+    }
+    if (rcvd_magic == LCM2_MAGIC_SHORT) {
+        // one more byte for a terminating zero, so that strlen never
+        // segfaults
+        if (pkt != lcmb->buf) {
+            if (_allocate_data (shard, lcmb, sz + 1) < 0) {
+                LCM_TRACE4 (drop, NULL, sz, msg_seqno,
+                        LCM_TRACE_DROP_NO_BUFFER);
+                return 0;
+            }
+            memcpy (lcmb->buf, pkt, sz);
+        } else {
+            lcmb->buf[sz] = 0;
         }
+        return _recv_short_message (shard, lcmb, sz, compressed);
     }
+    if (rcvd_magic == LCM2_MAGIC_LONG)
+        return _recv_message_fragment (shard, lcmb, pkt, sz, compressed);
+    if (rcvd_magic == LCM2_MAGIC_PARITY)
+        return _recv_parity (shard, lcmb, pkt, sz);
 
-    // if the newly received packet is a short packet, then resize the space
-    // allocated to it on the ringbuffer to exactly match the amount of space
-    // required.  That way, we do not use 64k of the ringbuffer for every
-    // incoming message.
-    if (lcmb->ringbuf) {
-        g_static_rec_mutex_lock (&lcm->mutex);
-        lcm_ringbuf_shrink_last(lcmb->ringbuf, lcmb->buf, sz);
-        g_static_rec_mutex_unlock (&lcm->mutex);
+    dbg (DBG_LCM, "LCM: bad magic\n");
+    shard->stats.num_bad_packets++;
+    return 0;
+}
+
+/* Copies the next record of the batch datagram being handed out into lcmb,
+ * as if it had been received on its own.  Returns its size, or 0 if it was
+ * dropped. */
+static int
+_next_batch_record (udpm_rx_shard_t *shard, lcm_buf_t *lcmb)
+{
+    uint16_t size;
+    if (shard->batch_len - shard->batch_off < (int) sizeof (size)) {
+        shard->stats.num_bad_packets++;
+        shard->batch_off = shard->batch_len;
+        return 0;
+    }
+    memcpy (&size, shard->batch + shard->batch_off, sizeof (size));
+    size = ntohs (size);
+    const char *pkt = shard->batch + shard->batch_off + sizeof (size);
+    if (size < sizeof (lcm2_header_short_t) ||
+            size > shard->batch_len - shard->batch_off - sizeof (size)) {
+        shard->stats.num_bad_packets++;
+        shard->batch_off = shard->batch_len;
+        return 0;
+    }
+    shard->batch_off += sizeof (size) + size;
+
+    // only short messages are batched
+    uint32_t magic;
+    memcpy (&magic, pkt, sizeof (magic));
+    magic = ntohl (magic) & ~LCM2_MAGIC_COMPRESSED;
+    if (magic != LCM2_MAGIC_SHORT) {
+        shard->stats.num_bad_packets++;
+        return 0;
     }
 
-    return lcmb;
+    // one more byte for a terminating zero, as for datagrams
+    if (_allocate_data (shard, lcmb, size + 1) < 0) {
+        LCM_TRACE4 (drop, NULL, size, -1, LCM_TRACE_DROP_NO_BUFFER);
+        return 0;
+    }
+    memcpy (lcmb->buf, pkt, size);
+    lcmb->from = shard->batch_from;
+    lcmb->fromlen = shard->batch_fromlen;
+    lcmb->recv_time_ns = shard->batch_recv_time_ns;
+    lcmb->recv_utime = lcmb->recv_time_ns / 1000;
+    return size;
 }
 
-/* This is the receiver thread that runs continuously to retrieve any incoming
- * LCM packets from the network and queues them locally. */
-static void *
-recv_thread (void * user)
+/* Returns the receive timestamp of a datagram, in nanoseconds, from its
+ * timestamp control message if there is one. */
+static int64_t
+_recv_time_ns (struct msghdr *msg)
 {
-#ifdef G_OS_UNIX
-    // Mask out all signals on this thread.
-    sigset_t mask;
-    sigfillset(&mask);
-    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#ifdef SO_TIMESTAMP
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR (msg);
+    while (cmsg) {
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMP) {
+            struct timeval * t = (struct timeval*) CMSG_DATA (cmsg);
+            return ((int64_t) t->tv_sec * 1000000 + t->tv_usec) * 1000;
+        }
+#ifdef USE_NS_TIMESTAMPS
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec * t = (struct timespec*) CMSG_DATA (cmsg);
+            return (int64_t) t->tv_sec * 1000000000 + t->tv_nsec;
+        }
+        if (cmsg->cmsg_level == SOL_SOCKET &&
+                cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            // ts[0] is the software timestamp, ts[2] the raw hardware one.
+            // Either may be zero.
+            struct timespec * ts = (struct timespec*) CMSG_DATA (cmsg);
+            struct timespec * t = (ts[2].tv_sec || ts[2].tv_nsec) ? &ts[2] :
+                &ts[0];
+            if (t->tv_sec || t->tv_nsec)
+                return (int64_t) t->tv_sec * 1000000000 + t->tv_nsec;
+        }
 #endif
+        cmsg = CMSG_NXTHDR (msg, cmsg);
+    }
+#endif
+    return lcm_clock_realtime_ns ();
+}
 
-    lcm_udpm_t * lcm = (lcm_udpm_t *) user;
-
+/* Blocks until either UDP data is available or the read thread is told to
+ * exit.  Returns 1 in the first case and 0 in the second. */
+static int
+_wait_for_packets (udpm_rx_shard_t *shard)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    _publish_shard_stats (shard);
+    lcm_seq_tracker_set_count_gaps (shard->seq_tracker,
+            !g_atomic_int_get (&lcm->filtering_channels));
+    int64_t spin_until = lcm->params.busy_poll ?
+        lcm_clock_fast_ns () + (int64_t) lcm->params.busy_poll * 1000 : 0;
     while (1) {
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (shard->recvfd, &fds);
+        FD_SET (lcm->thread_msg_pipe[0], &fds);
+        SOCKET maxfd = MAX(shard->recvfd, lcm->thread_msg_pipe[0]);
+#ifdef USE_XDP
+        if (shard->xsk) {
+            FD_SET (lcm_xsk_fileno (shard->xsk), &fds);
+            maxfd = MAX (maxfd, lcm_xsk_fileno (shard->xsk));
+        }
+#endif
 
-        lcm_buf_t *lcmb = udp_read_packet(lcm);
-        if (!lcmb) break;
+        // when busy polling, only sleep once the time to spin is up
+        struct timeval zero = { 0, 0 };
+        int spin = spin_until && lcm_clock_fast_ns () < spin_until;
+        int status = select (maxfd + 1, &fds, NULL, NULL, spin ? &zero : NULL);
+        if (status == 0 && spin)
+            continue;
+        if (status <= 0) { 
+            perror ("udp_read_packet -- select:");
+            continue;
+        }
 
-        /* If necessary, notify the reading thread by writing to a pipe.  We
-         * only want one character in the pipe at a time to avoid blocking
-         * writes, so we only do this when the queue transitions from empty to
-         * non-empty. */
-        g_static_rec_mutex_lock (&lcm->mutex);
+        if (FD_ISSET (lcm->thread_msg_pipe[0], &fds)) {
+            // received an exit command.
+            dbg (DBG_LCM, "read thread received exit command\n");
+            return 0;
+        }
 
-        if (lcm_buf_queue_is_empty (lcm->inbufs_filled))
-            if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-                perror ("write to notify");
+        // there is incoming UDP data ready.
+#ifdef USE_XDP
+        assert (FD_ISSET (shard->recvfd, &fds) || shard->xsk);
+#else
+        assert (FD_ISSET (shard->recvfd, &fds));
+#endif
+        return 1;
+    }
+}
 
-        /* Queue the packet for future retrieval by lcm_handle (). */
-        lcm_buf_enqueue (lcm->inbufs_filled, lcmb);
-        
-        g_static_rec_mutex_unlock (&lcm->mutex);
+#ifdef USE_RECVMMSG
+static void
+_init_rx_slots (udpm_rx_shard_t *shard)
+{
+    shard->rx_slots = (udpm_rx_slot_t *) calloc (LCM_RECV_BATCH,
+            sizeof (udpm_rx_slot_t));
+    shard->rx_msgs = (struct mmsghdr *) calloc (LCM_RECV_BATCH,
+            sizeof (struct mmsghdr));
+    for (int i = 0; i < LCM_RECV_BATCH; i++) {
+        udpm_rx_slot_t *slot = &shard->rx_slots[i];
+        // the last byte stays zero so that strlen never segfaults
+        slot->vec.iov_base = slot->data;
+        slot->vec.iov_len = sizeof (slot->data) - 1;
+        shard->rx_msgs[i].msg_hdr.msg_name = &slot->from;
+        shard->rx_msgs[i].msg_hdr.msg_iov = &slot->vec;
+        shard->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+        shard->rx_msgs[i].msg_hdr.msg_control = slot->control;
     }
-    dbg (DBG_LCM, "read thread exiting\n");
-    return NULL;
 }
 
-static int 
-lcm_udpm_get_fileno (lcm_udpm_t *lcm)
+/* Called once the datagram in rx_msgs[i] is processed. */
+static void
+_release_rx_slot (udpm_rx_shard_t *shard, int i)
 {
-    if (_setup_recv_parts (lcm) < 0) {
-        return -1;
+#ifdef USE_IO_URING
+    if (shard->uring)
+        lcm_uring_recycle_buf (shard->uring, shard->rx_bids[i]);
+#endif
+#ifdef USE_XDP
+    if (shard->rx_xdp)
+        lcm_xsk_recycle (shard->xsk, shard->xdp_dgrams[i].frame);
+#endif
+}
+#endif
+
+#ifdef USE_XDP
+/* Steers the group's datagrams to an AF_XDP socket for each read thread.
+ * Those that can not have one keep receiving from recvfd only.  Called
+ * before the read threads start. */
+static void
+_xdp_init (lcm_udpm_t *lcm)
+{
+    const char *ifname = lcm->params.xdp_ifname;
+    uint16_t port = ntohs (lcm->params.mc_port);
+    lcm->xdp = lcm_xdp_attach (ifname, lcm->params.mc_addr, port, port,
+            lcm->params.xdp_queue + lcm->num_shards);
+    if (!lcm->xdp) {
+        fprintf (stderr, "LCM: could not attach an XDP program to %s (%s), "
+                "using the default receive path\n", ifname, strerror (errno));
+        return;
+    }
+    for (int i = 0; i < lcm->num_shards; i++) {
+        udpm_rx_shard_t *shard = &lcm->shards[i];
+        int queue = lcm->params.xdp_queue + i;
+        shard->xsk = lcm_xsk_new (lcm->xdp, queue, LCM_XDP_FRAMES,
+                shard->numa_node);
+        if (!shard->xsk) {
+            fprintf (stderr, "LCM: could not open an AF_XDP socket on queue "
+                    "%d of %s (%s)\n", queue, ifname, strerror (errno));
+            continue;
+        }
+        shard->xdp_dgrams = (lcm_xsk_datagram_t *) calloc (LCM_RECV_BATCH,
+                sizeof (lcm_xsk_datagram_t));
+        shard->xdp_vecs = (struct iovec *) calloc (LCM_RECV_BATCH,
+                sizeof (struct iovec));
+        dbg (DBG_LCM, "read thread %d receives queue %d of %s with AF_XDP\n",
+                i, queue, ifname);
     }
-    return lcm->notify_pipe[0];
 }
 
+/* Points rx_msgs at the datagrams received on the AF_XDP socket so far, like
+ * recvmmsg does, without blocking.  Returns how many there are. */
 static int
-lcm_udpm_subscribe (lcm_udpm_t *lcm, const char *channel)
+_xdp_take_packets (udpm_rx_shard_t *shard)
 {
-    return _setup_recv_parts (lcm);
+    int num_bad = 0;
+    int n = lcm_xsk_receive (shard->xsk, shard->xdp_dgrams, LCM_RECV_BATCH,
+            &num_bad);
+    shard->stats.num_packets += num_bad;
+    shard->stats.num_bad_packets += num_bad;
+    for (int i = 0; i < n; i++) {
+        lcm_xsk_datagram_t *dgram = &shard->xdp_dgrams[i];
+        struct mmsghdr *mmsg = &shard->rx_msgs[i];
+        mmsg->msg_hdr.msg_name = &dgram->from;
+        mmsg->msg_hdr.msg_namelen = sizeof (dgram->from);
+        mmsg->msg_hdr.msg_control = NULL;
+        mmsg->msg_hdr.msg_controllen = 0;
+        shard->xdp_vecs[i].iov_base = dgram->data;
+        shard->xdp_vecs[i].iov_len = dgram->len;
+        mmsg->msg_hdr.msg_iov = &shard->xdp_vecs[i];
+        mmsg->msg_len = dgram->len;
+    }
+    if (n) {
+        shard->rx_xdp = 1;
+        shard->rx_count = n;
+        shard->rx_next = 0;
+    }
+    return n;
 }
+#endif
 
-static int 
-lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
-        unsigned int datalen)
+#ifdef USE_IO_URING
+/* Sets up an io_uring for a read thread, which then waits for the exit
+ * command with a poll request.  Returns -1 if the kernel does not support
+ * what is needed, and the thread should use recvmmsg instead. */
+static int
+_uring_init (udpm_rx_shard_t *shard)
 {
-    int channel_size = strlen (channel);
-    if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH) {
-        fprintf (stderr, "LCM Error: channel name too long [%s]\n",
-                channel);
+    lcm_udpm_t *lcm = shard->lcm;
+    shard->uring = lcm_uring_new (8, 0, LCM_URING_BUFS, LCM_URING_BUF_SIZE);
+    if (!shard->uring)
         return -1;
-    }
 
-    int payload_size = channel_size + 1 + datalen;
-    if (payload_size <= LCM_SHORT_MESSAGE_MAX_SIZE) {
-        // message is short.  send in a single packet
+    shard->uring_msg.msg_namelen = sizeof (struct sockaddr);
+    shard->uring_msg.msg_controllen = LCM_URING_CONTROL_SIZE;
+    shard->rx_msgs = (struct mmsghdr *) calloc (LCM_RECV_BATCH,
+            sizeof (struct mmsghdr));
+    shard->rx_vecs = (struct iovec *) calloc (LCM_RECV_BATCH,
+            sizeof (struct iovec));
+    shard->rx_bids = (int *) calloc (LCM_RECV_BATCH, sizeof (int));
+    for (int i = 0; i < LCM_RECV_BATCH; i++) {
+        shard->rx_msgs[i].msg_hdr.msg_iov = &shard->rx_vecs[i];
+        shard->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
-        g_static_mutex_lock (&lcm->transmit_lock);
+    struct io_uring_sqe *sqe = lcm_uring_get_sqe (shard->uring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = lcm->thread_msg_pipe[0];
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_EXIT;
+    if (lcm_uring_submit_and_wait (shard->uring, 0) < 0) {
+        lcm_uring_destroy (shard->uring);
+        shard->uring = NULL;
+        return -1;
+    }
+    dbg (DBG_LCM, "read thread %d receives with io_uring\n", shard->index);
+    return 0;
+}
 
-        lcm2_header_short_t hdr;
-        hdr.magic = htonl (LCM2_MAGIC_SHORT);
-        hdr.msg_seqno = htonl(lcm->msg_seqno);
+#ifdef USE_IOCP
+/* Posts the overlapped receive r on the read thread's socket.  Returns -1 if
+ * it could not be posted. */
+static int
+_iocp_post_recv (udpm_rx_shard_t *shard, udpm_iocp_recv_t *r)
+{
+    memset (&r->ov, 0, sizeof (r->ov));
+    // the last byte stays free for a terminating zero
+    r->wsabuf.buf = r->data;
+    r->wsabuf.len = sizeof (r->data) - 1;
+    r->flags = 0;
+    r->fromlen = sizeof (r->from);
+    DWORD nbytes;
+    if (WSARecvFrom (shard->recvfd, &r->wsabuf, 1, &nbytes, &r->flags,
+                &r->from, &r->fromlen, &r->ov, NULL) == SOCKET_ERROR &&
+            WSAGetLastError () != WSA_IO_PENDING)
+        return -1;
+    shard->iocp_pending++;
+    return 0;
+}
 
-        struct iovec sendbufs[3];
-        sendbufs[0].iov_base = (char *) &hdr;
-        sendbufs[0].iov_len = sizeof (hdr);
-        sendbufs[1].iov_base = (char *) channel;
-        sendbufs[1].iov_len = channel_size + 1;
-        sendbufs[2].iov_base = (char *) data;
-        sendbufs[2].iov_len = datalen;
+/* Sets up an I/O completion port for a read thread and posts its receives.
+ * Returns -1 if that fails, and the thread should use select() instead. */
+static int
+_iocp_init (udpm_rx_shard_t *shard)
+{
+    shard->iocp = CreateIoCompletionPort (INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (!shard->iocp)
+        return -1;
+    if (!CreateIoCompletionPort ((HANDLE) shard->recvfd, shard->iocp,
+                LCM_IOCP_RECV, 1)) {
+        CloseHandle (shard->iocp);
+        shard->iocp = NULL;
+        return -1;
+    }
+    shard->iocp_recvs = (udpm_iocp_recv_t *) calloc (LCM_IOCP_RECVS,
+            sizeof (udpm_iocp_recv_t));
+    for (int i = 0; i < LCM_IOCP_RECVS; i++) {
+        if (_iocp_post_recv (shard, &shard->iocp_recvs[i]) < 0 && !i) {
+            // the socket stays associated with the port, so it cannot be
+            // waited on in any other way that needs overlapped I/O, but
+            // select() and recvmsg() still work
+            CloseHandle (shard->iocp);
+            shard->iocp = NULL;
+            free (shard->iocp_recvs);
+            shard->iocp_recvs = NULL;
+            return -1;
+        }
+    }
+    dbg (DBG_LCM, "read thread %d receives with an I/O completion port\n",
+            shard->index);
+    return 0;
+}
 
-        // transmit
-        int packet_size = datalen + sizeof (hdr) + channel_size + 1;
-        dbg (DBG_LCM_MSG, "transmitting %d byte [%s] payload (%d byte pkt)\n", 
-                datalen, channel, packet_size);
+/* The completion port counterpart of _wait_for_packets followed by recvmsg:
+ * waits for a posted receive to complete, and returns it with its datagram
+ * zero terminated and its size in *sz.  Returns NULL once the thread is told
+ * to exit. */
+static udpm_iocp_recv_t *
+_iocp_wait_for_packet (udpm_rx_shard_t *shard, int *sz)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    _publish_shard_stats (shard);
+    lcm_seq_tracker_set_count_gaps (shard->seq_tracker,
+            !g_atomic_int_get (&lcm->filtering_channels));
+    int64_t spin_until = lcm->params.busy_poll ?
+        lcm_clock_fast_ns () + (int64_t) lcm->params.busy_poll * 1000 : 0;
+    while (1) {
+        DWORD nbytes;
+        ULONG_PTR key;
+        LPOVERLAPPED ov;
+
+        // when busy polling, only sleep once the time to spin is up
+        int spin = spin_until && lcm_clock_fast_ns () < spin_until;
+        BOOL ok = GetQueuedCompletionStatus (shard->iocp, &nbytes, &key, &ov,
+                spin ? 0 : INFINITE);
+        if (!ov) {
+            if (ok && key == LCM_IOCP_EXIT) {
+                dbg (DBG_LCM, "read thread received exit command\n");
+                return NULL;
+            }
+            if (!spin)
+                fprintf (stderr, "udp_read_packet -- "
+                        "GetQueuedCompletionStatus: %d\n",
+                        (int) GetLastError ());
+            continue;
+        }
+
+        udpm_iocp_recv_t *r = (udpm_iocp_recv_t *) ov;
+        shard->iocp_pending--;
+        if (!ok) {
+            // e.g. WSAEMSGSIZE, or an ICMP error reported on the socket
+            shard->stats.num_bad_packets++;
+            _iocp_post_recv (shard, r);
+            continue;
+        }
+        r->data[nbytes] = 0;
+        *sz = nbytes;
+        return r;
+    }
+}
+#endif
+
+/* The io_uring counterpart of _wait_for_packets followed by recvmmsg: waits
+ * for datagrams and points rx_msgs at them.  A single multishot recvmsg
+ * request keeps receiving into the ring's buffers until they run out.
+ * Returns 0 if the thread was told to exit. */
+static int
+_uring_wait_for_packets (udpm_rx_shard_t *shard)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    _publish_shard_stats (shard);
+    lcm_seq_tracker_set_count_gaps (shard->seq_tracker,
+            !g_atomic_int_get (&lcm->filtering_channels));
+    while (1) {
+        int n = 0;
+        struct io_uring_cqe *cqe;
+        while (n < LCM_RECV_BATCH &&
+                (cqe = lcm_uring_peek_cqe (shard->uring))) {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res;
+            unsigned flags = cqe->flags;
+            lcm_uring_cqe_seen (shard->uring);
+
+            if (user_data == URING_EXIT) {
+                dbg (DBG_LCM, "read thread received exit command\n");
+                return 0;
+            }
+            if (!(flags & IORING_CQE_F_MORE))
+                shard->uring_armed = 0;
+            if (res < 0) {
+                // out of buffers until lcm_udpm_handle gives some back
+                if (res != -ENOBUFS) {
+                    errno = -res;
+                    perror ("udp_read_packet -- io_uring recvmsg");
+                    shard->stats.num_bad_packets++;
+                }
+                continue;
+            }
+
+            int bid = flags >> IORING_CQE_BUFFER_SHIFT;
+            char *buf = lcm_uring_buf (shard->uring, bid);
+            struct io_uring_recvmsg_out *out =
+                (struct io_uring_recvmsg_out *) buf;
+            char *name = (char *) (out + 1);
+            char *control = name + shard->uring_msg.msg_namelen;
+            char *payload = control + shard->uring_msg.msg_controllen;
+            if (out->flags & MSG_TRUNC) {
+                shard->stats.num_packets++;
+                shard->stats.num_bad_packets++;
+                lcm_uring_recycle_buf (shard->uring, bid);
+                continue;
+            }
+            // so that strlen never segfaults
+            payload[out->payloadlen] = 0;
+
+            struct mmsghdr *mmsg = &shard->rx_msgs[n];
+            mmsg->msg_hdr.msg_name = name;
+            mmsg->msg_hdr.msg_namelen = MIN (out->namelen,
+                    shard->uring_msg.msg_namelen);
+            mmsg->msg_hdr.msg_control = out->controllen ? control : NULL;
+            mmsg->msg_hdr.msg_controllen = MIN (out->controllen,
+                    shard->uring_msg.msg_controllen);
+            shard->rx_vecs[n].iov_base = payload;
+            shard->rx_vecs[n].iov_len = out->payloadlen;
+            mmsg->msg_len = out->payloadlen;
+            shard->rx_bids[n] = bid;
+            n++;
+        }
+        if (n) {
+            shard->rx_count = n;
+            shard->rx_next = 0;
+            return 1;
+        }
+
+        if (!shard->uring_armed) {
+            struct io_uring_sqe *sqe = lcm_uring_get_sqe (shard->uring);
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->fd = shard->recvfd;
+            sqe->addr = (uintptr_t) &shard->uring_msg;
+            sqe->len = 1;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = 0;
+            sqe->user_data = URING_RECV;
+            shard->uring_armed = 1;
+        }
+        if (lcm_uring_submit_and_wait (shard->uring, 1) < 0 &&
+                errno != EINTR)
+            perror ("udp_read_packet -- io_uring_enter");
+    }
+}
+#endif
+
+// read continuously until a complete message arrives
+static lcm_buf_t *
+udp_read_packet (udpm_rx_shard_t *shard)
+{
+    lcm_buf_t *lcmb = NULL;
+
+    int sz = 0;
+
+    int got_complete_message = 0;
+
+    while (!got_complete_message) {
+        if (shard->batch_off < shard->batch_len) {
+            if (!lcmb)
+                lcmb = _allocate_buf (shard);
+            sz = _next_batch_record (shard, lcmb);
+            if (sz)
+                got_complete_message = _recv_datagram (shard, lcmb,
+                        lcmb->buf, sz);
+            continue;
+        }
+#ifdef USE_RECVMMSG
+        if (shard->rx_next == shard->rx_count) {
+#ifdef USE_IO_URING
+            if (shard->uring) {
+                if (!_uring_wait_for_packets (shard))
+                    goto exit_command;
+                continue;
+            }
+#endif
+#ifdef USE_XDP
+            // the AF_XDP socket is read without a system call, and recvfd
+            // gets its turn every LCM_XDP_STREAK batches, or once the
+            // socket runs dry
+            if (shard->xsk && shard->xdp_streak < LCM_XDP_STREAK &&
+                    _xdp_take_packets (shard)) {
+                shard->xdp_streak++;
+                continue;
+            }
+            shard->xdp_streak = 0;
+#endif
+            // wait for either incoming UDP data, or for an abort message
+            if (!_wait_for_packets (shard))
+                goto exit_command;
+
+#ifdef USE_XDP
+            if (shard->rx_xdp) {
+                for (int i = 0; i < LCM_RECV_BATCH; i++) {
+                    udpm_rx_slot_t *slot = &shard->rx_slots[i];
+                    shard->rx_msgs[i].msg_hdr.msg_name = &slot->from;
+                    shard->rx_msgs[i].msg_hdr.msg_iov = &slot->vec;
+                    shard->rx_msgs[i].msg_hdr.msg_control = slot->control;
+                }
+                shard->rx_xdp = 0;
+            }
+#endif
+            // read as many datagrams as are already queued in the kernel
+            for (int i = 0; i < LCM_RECV_BATCH; i++) {
+                struct msghdr *msg = &shard->rx_msgs[i].msg_hdr;
+                msg->msg_namelen = sizeof (struct sockaddr);
+                msg->msg_controllen = sizeof (shard->rx_slots[i].control);
+                msg->msg_flags = 0;
+            }
+            int n = recvmmsg (shard->recvfd, shard->rx_msgs, LCM_RECV_BATCH,
+                    MSG_DONTWAIT, NULL);
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EINTR) {
+                    perror ("udp_read_packet -- recvmmsg");
+                    shard->stats.num_bad_packets++;
+                }
+                continue;
+            }
+            shard->rx_count = n;
+            shard->rx_next = 0;
+            continue;
+        }
+
+        struct mmsghdr *mmsg = &shard->rx_msgs[shard->rx_next];
+        char *pkt = (char *) mmsg->msg_hdr.msg_iov->iov_base;
+        int rx_index = shard->rx_next++;
+        sz = mmsg->msg_len;
+        shard->stats.num_packets++;
+        shard->stats.num_bytes += sz;
+
+        if (sz < sizeof(lcm2_header_short_t)) { 
+            // packet too short to be LCM
+            shard->stats.num_bad_packets++;
+            _release_rx_slot (shard, rx_index);
+            continue;
+        }
+
+        if (!lcmb)
+            lcmb = _allocate_buf (shard);
+        memcpy (&lcmb->from, mmsg->msg_hdr.msg_name, mmsg->msg_hdr.msg_namelen);
+        lcmb->fromlen = mmsg->msg_hdr.msg_namelen;
+        lcmb->recv_time_ns = _recv_time_ns (&mmsg->msg_hdr);
+        lcmb->recv_utime = lcmb->recv_time_ns / 1000;
+
+        got_complete_message = _recv_datagram (shard, lcmb, pkt, sz);
+        _release_rx_slot (shard, rx_index);
+#else
+#ifdef USE_IOCP
+        if (shard->iocp) {
+            udpm_iocp_recv_t *r = _iocp_wait_for_packet (shard, &sz);
+            if (!r)
+                goto exit_command;
+            shard->stats.num_packets++;
+            shard->stats.num_bytes += sz;
+
+            if (sz < sizeof(lcm2_header_short_t)) {
+                // packet too short to be LCM
+                shard->stats.num_bad_packets++;
+                _iocp_post_recv (shard, r);
+                continue;
+            }
+
+            if (!lcmb)
+                lcmb = _allocate_buf (shard);
+            memcpy (&lcmb->from, &r->from, r->fromlen);
+            lcmb->fromlen = r->fromlen;
+            lcmb->recv_time_ns = lcm_clock_realtime_ns ();
+            lcmb->recv_utime = lcmb->recv_time_ns / 1000;
+
+            // the datagram is copied out of r, which can take the next one
+            got_complete_message = _recv_datagram (shard, lcmb, r->data, sz);
+            if (_iocp_post_recv (shard, r) < 0) {
+                fprintf (stderr, "udp_read_packet -- WSARecvFrom: %d\n",
+                        WSAGetLastError ());
+                shard->stats.num_bad_packets++;
+            }
+            continue;
+        }
+#endif
+        // wait for either incoming UDP data, or for an abort message
+        if (!_wait_for_packets (shard))
+            goto exit_command;
+
+        if (!lcmb)
+            lcmb = _allocate_buf (shard);
+        if (_allocate_data (shard, lcmb, LCM_MAX_UNFRAGMENTED_PACKET_SIZE) < 0) {
+            // discard the datagram
+            char ch;
+            recv (shard->recvfd, &ch, 1, 0);
+            LCM_TRACE4 (drop, NULL, -1, -1, LCM_TRACE_DROP_NO_BUFFER);
+            continue;
+        }
+        struct iovec        vec;
+        vec.iov_base = lcmb->buf;
+        vec.iov_len = 65535;
 
-//        int status = writev (lcm->sendfd, sendbufs, 3);
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(struct msghdr));
+        msg.msg_name = &lcmb->from;
+        msg.msg_namelen = sizeof (struct sockaddr);
+        msg.msg_iov = &vec;
+        msg.msg_iovlen = 1;
+#ifdef MSG_EXT_HDR
+        // operating systems that provide SO_TIMESTAMP allow us to obtain more
+        // accurate timestamps by having the kernel produce timestamps as soon
+        // as packets are received.
+        char controlbuf[64];
+        msg.msg_control = controlbuf;
+        msg.msg_controllen = sizeof (controlbuf);
+        msg.msg_flags = 0;
+#endif
+        sz = recvmsg (shard->recvfd, &msg, 0);
+
+        if (sz < 0) {
+            perror ("udp_read_packet -- recvmsg");
+            shard->stats.num_bad_packets++;
+            continue;
+        }
+        shard->stats.num_packets++;
+        shard->stats.num_bytes += sz;
+
+        if (sz < sizeof(lcm2_header_short_t)) { 
+            // packet too short to be LCM
+            shard->stats.num_bad_packets++;
+            continue;
+        }
+
+        lcmb->fromlen = msg.msg_namelen;
+        lcmb->recv_time_ns = _recv_time_ns (&msg);
+        lcmb->recv_utime = lcmb->recv_time_ns / 1000;
+
+        got_complete_message = _recv_datagram (shard, lcmb, lcmb->buf, sz);
+#endif
+    }
+
+#ifndef USE_RECVMMSG
+    // if the newly received packet is a short packet, then move it to a
+    // smaller buffer from the pool.  That way, we do not hold 64k of the pool
+    // for every incoming message.
+#ifdef USE_IOCP
+    // datagrams received on the completion port already are
+    if (lcmb->pool && !shard->iocp)
+#else
+    if (lcmb->pool)
+#endif
+        lcm_buf_shrink_data(lcmb, sz);
+#endif
+
+    return lcmb;
+
+exit_command:
+    if (lcmb) {
+        // lcmb is not on one of the memory managed buffer queues.  We could
+        // either put it back on one of the queues, or just free it here.  Do the
+        // latter.
+        //
+        // Its data buffer, if any, is from the pool.  It would stay in use
+        // forever.
+        lcm_buf_free_data (lcmb);
+        free (lcmb);
+    }
+    return NULL;
+}
+
+/* Waits until lcm_udpm_handle has given back enough buffers for another one
+ * to be queued.  Returns 0 if the thread was told to exit in the meantime. */
+static int
+_wait_for_free_slot (udpm_rx_shard_t *shard)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    while (1) {
+        if (shard->bufs_outstanding >= LCM_BUF_RING_SIZE)
+            _reclaim_bufs (shard);
+        if (shard->bufs_outstanding < LCM_BUF_RING_SIZE)
+            return 1;
+
+        // the application is not keeping up.  Leave new datagrams in the
+        // kernel buffer until it does.
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (lcm->thread_msg_pipe[0], &fds);
+        struct timeval tv = { 0, 1000 };
+        if (select (lcm->thread_msg_pipe[0] + 1, &fds, 0, 0, &tv) > 0)
+            return 0;
+    }
+}
+
+/* Has interest_thread announce the subscriptions soon. */
+static void
+_request_announce (lcm_udpm_t *lcm)
+{
+    if (g_atomic_int_compare_and_exchange (&lcm->announce_pending, 0, 1) &&
+            lcm_internal_pipe_write (lcm->interest_pipe[1], "a", 1) < 0)
+        perror (__FILE__ " write(announce)");
+}
+
+/* Records an interest announcement received by a read thread. */
+static void
+_interest_received (lcm_udpm_t *lcm, const lcm_buf_t *lcmb)
+{
+    // answer a newcomer right away, so that it does not wait a whole
+    // interval to learn about this instance
+    if (lcm_interest_table_update (lcm->interest,
+                lcmb->buf + lcmb->data_offset, lcmb->data_size,
+                lcm_clock_monotonic_us ()) > 0)
+        _request_announce (lcm);
+}
+
+/* This is the receiver thread that runs continuously to retrieve any incoming
+ * LCM packets from the network and queues them locally. */
+static void *
+recv_thread (void * user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    udpm_rx_shard_t * shard = (udpm_rx_shard_t *) user;
+    lcm_udpm_t * lcm = shard->lcm;
+    lcm_internal_thread_init ("udpm-rx", lcm->params.rx_cpu ?
+            lcm->params.rx_cpu : shard->numa_cpus, lcm->params.rx_sched);
+    if (shard->numa_node >= 0) {
+        // everything the thread allocates from here on, like its buffer pool
+        // being filled, comes from the node
+        if (lcm_numa_prefer_node (shard->numa_node) < 0)
+            dbg (DBG_LCM, "could not prefer NUMA node %d: %s\n",
+                    shard->numa_node, strerror (errno));
+        if (lcm->params.prealloc && lcm_bufpool_prealloc (shard->pool) < 0)
+            fprintf (stderr, "Warning: could not preallocate the receive "
+                    "buffer pool\n");
+    }
+
+#ifdef USE_RECVMMSG
+#ifdef USE_IO_URING
+    if (lcm->params.io_uring && _uring_init (shard) < 0 && !shard->index)
+        fprintf (stderr, "LCM: io_uring is not available (%s), "
+                "falling back to recvmmsg\n", strerror (errno));
+    if (!shard->uring)
+        _init_rx_slots (shard);
+#else
+    _init_rx_slots (shard);
+#endif
+#endif
+#ifdef USE_IOCP
+    if (lcm->params.iocp && _iocp_init (shard) < 0 && !shard->index)
+        fprintf (stderr, "LCM: I/O completion port setup failed (%d), "
+                "falling back to select\n", (int) GetLastError ());
+#endif
+
+    while (1) {
+
+        lcm_buf_t *lcmb = udp_read_packet(shard);
+        if (!lcmb) break;
+        LCM_TRACE3 (udpm_message, lcmb->channel_name, lcmb->data_size,
+                lcmb->msg_seqno);
+
+        if (_is_interest (lcm, lcmb->channel_name)) {
+            _interest_received (lcm, lcmb);
+            lcm_buf_free_data (lcmb);
+            lcm_buf_enqueue (shard->free_bufs, lcmb);
+            continue;
+        }
+
+        if (!_wait_for_free_slot (shard)) {
+            lcm_buf_free_data (lcmb);
+            free (lcmb);
+            break;
+        }
+
+        /* If lcm_handle () is idle, it is about to be woken up.  Let the
+         * counters it sees then include this packet. */
+        if (!g_atomic_int_get (&lcm->notify_pending))
+            _publish_shard_stats (shard);
+
+        /* Queue the packet for future retrieval by lcm_handle (). */
+        int urgent = lcm_channel_priority_by_id (lcm->lcm, lcmb->channel_name,
+                lcmb->channel_id) > 0;
+        lcm_buf_ring_push (urgent ? shard->filled_urgent : shard->filled,
+                lcmb);
+        shard->bufs_outstanding++;
+        LCM_TRACE4 (udpm_enqueue, lcmb->channel_name, lcmb->data_size,
+                lcmb->msg_seqno, shard->bufs_outstanding);
+
+        /* If necessary, notify the reading thread by writing to a pipe.  We
+         * only want one character in the pipe at a time to avoid blocking
+         * writes, so only the thread that sets notify_pending does it. */
+        if (g_atomic_int_compare_and_exchange (&lcm->notify_pending, 0, 1))
+            if (lcm_internal_notify_signal(lcm->notify_pipe) < 0)
+                perror ("write to notify");
+    }
+    dbg (DBG_LCM, "read thread %d exiting\n", shard->index);
+    return NULL;
+}
+
+static int 
+lcm_udpm_get_fileno (lcm_udpm_t *lcm)
+{
+    if (_setup_recv_parts (lcm) < 0) {
+        return -1;
+    }
+    return lcm->notify_pipe[0];
+}
+
+static int
+lcm_udpm_subscribe (lcm_udpm_t *lcm, const char *channel)
+{
+    g_static_rec_mutex_lock (&lcm->mutex);
+    int count = GPOINTER_TO_INT (g_hash_table_lookup (lcm->subscriptions,
+                channel));
+    g_hash_table_insert (lcm->subscriptions, strdup (channel),
+            GINT_TO_POINTER (count + 1));
+#ifdef USE_SOCKET_FILTER
+    if (!count)
+        _update_socket_filters (lcm);
+#endif
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    if (!count && lcm->interest)
+        _request_announce (lcm);
+
+    return _setup_recv_parts (lcm);
+}
+
+static int
+lcm_udpm_unsubscribe (lcm_udpm_t *lcm, const char *channel)
+{
+    g_static_rec_mutex_lock (&lcm->mutex);
+    int count = GPOINTER_TO_INT (g_hash_table_lookup (lcm->subscriptions,
+                channel));
+    if (count > 1) {
+        g_hash_table_insert (lcm->subscriptions, strdup (channel),
+                GINT_TO_POINTER (count - 1));
+    } else if (count == 1) {
+        g_hash_table_remove (lcm->subscriptions, channel);
+#ifdef USE_SOCKET_FILTER
+        _update_socket_filters (lcm);
+#endif
+    }
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    if (count == 1 && lcm->interest)
+        _request_announce (lcm);
+    return 0;
+}
+
+/* Transmits a datagram on the socket of lane, through its fault injector if
+ * it has one. */
+static int
+_send_on_lane (udpm_tx_lane_t *lane, const struct msghdr *msg)
+{
+    if (lane->faults)
+        return lcm_fault_sendmsg (lane->faults, lane->sendfd, msg);
+    return sendmsg (lane->sendfd, msg, 0);
+}
+
+#ifdef USE_MULTI_IFACE
+#define UDPM_IFACE_CONTROL_SIZE CMSG_SPACE (sizeof (struct in_pktinfo))
+
+/* Makes msg go out on interface i of the interfaces option, from the address
+ * of the first one.  control holds the IP_PKTINFO control message, of
+ * UDPM_IFACE_CONTROL_SIZE bytes. */
+static void
+_set_iface (lcm_udpm_t *lcm, struct msghdr *msg, char *control, int i)
+{
+    memset (control, 0, UDPM_IFACE_CONTROL_SIZE);
+    msg->msg_control = control;
+    msg->msg_controllen = UDPM_IFACE_CONTROL_SIZE;
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR (msg);
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (struct in_pktinfo));
+    struct in_pktinfo *info = (struct in_pktinfo *) CMSG_DATA (cmsg);
+    info->ipi_ifindex = lcm->ifaces[i].index;
+    info->ipi_spec_dst = lcm->ifaces[0].addr;
+}
+
+/* Returns the interface that the next datagram of lane is striped to. */
+static inline int
+_next_iface (lcm_udpm_t *lcm, udpm_tx_lane_t *lane)
+{
+    int i = lane->next_iface;
+    lane->next_iface = (i + 1) % lcm->num_ifaces;
+    return i;
+}
+#endif
+
+/* Transmits a datagram on the socket of lane.  With interfaces, it goes out
+ * on the next one of them, or on each of them if they are redundant, in
+ * which case it is sent if any of the copies was.  Must be called with the
+ * lock of lane held. */
+static int
+_send_datagram (lcm_udpm_t *lcm, udpm_tx_lane_t *lane, struct msghdr *msg)
+{
+#ifdef USE_MULTI_IFACE
+    if (lcm->num_ifaces) {
+        char control[UDPM_IFACE_CONTROL_SIZE];
+        int status = -1;
+        if (!lcm->params.iface_redundant) {
+            _set_iface (lcm, msg, control, _next_iface (lcm, lane));
+            status = _send_on_lane (lane, msg);
+        } else {
+            for (int i = 0; i < lcm->num_ifaces; i++) {
+                _set_iface (lcm, msg, control, i);
+                int sent = _send_on_lane (lane, msg);
+                if (sent >= 0)
+                    status = sent;
+            }
+        }
+        msg->msg_control = NULL;
+        msg->msg_controllen = 0;
+        return status;
+    }
+#endif
+    return _send_on_lane (lane, msg);
+}
+
+#ifdef USE_SENDMMSG
+/* Transmits the n fragments in msgs with as few system calls as the fault
+ * injector and the interfaces allow.  Returns 0 on success.  Must be called
+ * with the lock of lane held. */
+static int
+_send_fragments (lcm_udpm_t *lcm, udpm_tx_lane_t *lane, struct mmsghdr *msgs,
+        int n)
+{
+    if (lane->faults) {
+        for (int i = 0; i < n; i++)
+            if (_send_datagram (lcm, lane, &msgs[i].msg_hdr) < 0)
+                return -1;
+        return 0;
+    }
+
+    int passes = 1;
+#ifdef USE_MULTI_IFACE
+    char control[LCM_SEND_BATCH][UDPM_IFACE_CONTROL_SIZE];
+    if (lcm->num_ifaces && lcm->params.iface_redundant)
+        passes = lcm->num_ifaces;
+#endif
+    int status = -1;
+    for (int pass = 0; pass < passes; pass++) {
+#ifdef USE_MULTI_IFACE
+        // the whole batch goes out on one interface per pass, or each
+        // fragment on the next one
+        for (int i = 0; lcm->num_ifaces && i < n; i++)
+            _set_iface (lcm, &msgs[i].msg_hdr, control[i],
+                    lcm->params.iface_redundant ? pass :
+                    _next_iface (lcm, lane));
+#endif
+        // sendmmsg() may return before it has sent the whole batch
+        int sent = 0;
+        while (sent < n) {
+            int count = sendmmsg (lane->sendfd, msgs + sent, n - sent, 0);
+            if (count <= 0)
+                break;
+            sent += count;
+        }
+        if (sent == n)
+            status = 0;
+    }
+#ifdef USE_MULTI_IFACE
+    for (int i = 0; lcm->num_ifaces && i < n; i++) {
+        msgs[i].msg_hdr.msg_control = NULL;
+        msgs[i].msg_hdr.msg_controllen = 0;
+    }
+#endif
+    return status;
+}
+#endif
+
+/* Waits until nbytes may be transmitted without going over max_rate_mbps. */
+static void
+_pace (lcm_udpm_t *lcm, int nbytes)
+{
+    if (lcm->pacer.rate <= 0)
+        return;
+    g_static_mutex_lock (&lcm->pacer_lock);
+    lcm_pacer_wait (&lcm->pacer, nbytes);
+    g_static_mutex_unlock (&lcm->pacer_lock);
+}
+
+/* Transmits the parity packets of a fragmented message, after all of its
+ * fragments.  For every group of fec_k fragments there are fec_m parity
+ * packets, and parity packet p covers fragments p, p + fec_m, p + 2 fec_m...
+ * of the group, so that a receiver can rebuild up to fec_m consecutive lost
+ * fragments.  Must be called with the lock of lane held. */
+static int
+_send_parity (lcm_udpm_t *lcm, udpm_tx_lane_t *lane, uint32_t seqno,
+        const char *channel, int channel_size, const void *data,
+        unsigned int datalen, int fragment_size, int nfragments)
+{
+    int payload_size = channel_size + 1 + datalen;
+    int k = lcm->params.fec_k;
+    int m = lcm->params.fec_m;
+    uint8_t *parity = (uint8_t*) malloc (fragment_size);
+
+    lcm2_header_parity_t hdr;
+    hdr.magic = htonl (LCM2_MAGIC_PARITY);
+    hdr.msg_seqno = htonl (seqno);
+    hdr.fragments_in_msg = htons (nfragments);
+    hdr.stride = htons (m);
+    hdr.fragment_size = htons (fragment_size);
+    hdr.last_fragment_size = htons (payload_size -
+            (nfragments - 1) * fragment_size);
+
+    struct iovec sendbufs[2];
+    sendbufs[0].iov_base = (char *) &hdr;
+    sendbufs[0].iov_len = sizeof (hdr);
+    sendbufs[1].iov_base = (char *) parity;
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
+    msg.msg_namelen = sizeof (lcm->dest_addr);
+    msg.msg_iov = sendbufs;
+    msg.msg_iovlen = 2;
+
+    int status = 0;
+    for (int first = 0; status >= 0 && first < nfragments; first += k) {
+        int group_size = MIN (k, nfragments - first);
+        for (int p = 0; status >= 0 && p < m && p < group_size; p++) {
+            memset (parity, 0, fragment_size);
+            int parity_size = 0;
+            int num_covered = 0;
+            for (int frag_no = first + p; frag_no < first + group_size;
+                    frag_no += m) {
+                int size = _fec_xor_fragment (parity, channel, channel_size,
+                        (const uint8_t*) data, payload_size, fragment_size,
+                        frag_no);
+                parity_size = MAX (parity_size, size);
+                num_covered++;
+            }
+            hdr.first_fragment = htons (first + p);
+            hdr.num_covered = htons (num_covered);
+            sendbufs[1].iov_len = parity_size;
+
+            _pace (lcm, sizeof (hdr) + parity_size);
+            status = _send_datagram (lcm, lane, &msg);
+        }
+    }
+    free (parity);
+    return status < 0 ? -1 : 0;
+}
+
+/* Transmits the messages collected in the batch of lane, if there are any.
+ * Must be called with the lock of lane held. */
+static int
+_flush_batch (lcm_udpm_t *lcm, udpm_tx_lane_t *lane)
+{
+    if (!lane->batch || lane->batch_len <= (int) sizeof (uint32_t))
+        return 0;
+
+    struct iovec vec;
+    vec.iov_base = lane->batch;
+    vec.iov_len = lane->batch_len;
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
+    msg.msg_namelen = sizeof (lcm->dest_addr);
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    dbg (DBG_LCM_MSG, "transmitting %d byte batch\n", lane->batch_len);
+    int status = _send_datagram (lcm, lane, &msg);
+    int sent = status == lane->batch_len;
+    lane->batch_len = sizeof (uint32_t);
+    return sent ? 0 : -1;
+}
+
+/* Appends a short message to the batch of lane, after transmitting the
+ * batch if the message does not fit.  Returns 1 if the message started a new
+ * batch, which batch_thread then has to transmit in time, and 0 otherwise.
+ * Must be called with the lock of lane held. */
+static int
+_batch_message (lcm_udpm_t *lcm, udpm_tx_lane_t *lane,
+        const lcm2_header_short_t *hdr, const char *channel, int channel_size,
+        const void *data, unsigned int datalen)
+{
+    int record_size = sizeof (*hdr) + channel_size + 1 + datalen;
+    if (lane->batch_len + 2 + record_size > lcm->batch_size)
+        _flush_batch (lcm, lane);
+
+    int started = lane->batch_len == sizeof (uint32_t);
+    if (started)
+        lane->batch_deadline = lcm_clock_monotonic_us () +
+            lcm->params.batch_us;
+
+    char *p = lane->batch + lane->batch_len;
+    uint16_t size = htons (record_size);
+    memcpy (p, &size, sizeof (size));
+    p += sizeof (size);
+    memcpy (p, hdr, sizeof (*hdr));
+    p += sizeof (*hdr);
+    memcpy (p, channel, channel_size + 1);
+    p += channel_size + 1;
+    memcpy (p, data, datalen);
+    lane->batch_len += sizeof (size) + record_size;
+    return started;
+}
+
+/* Transmits the batches when their time is up, so that a message never
+ * waits more than batch_us for others to share its datagram. */
+static void *
+_batch_thread (void *user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    lcm_internal_thread_init ("udpm-batch", NULL, NULL);
+
+    g_mutex_lock (lcm->batch_mutex);
+    while (!lcm->batch_exit) {
+        if (!lcm->batch_pending) {
+            g_cond_wait (lcm->batch_cond, lcm->batch_mutex);
+            continue;
+        }
+        lcm->batch_pending = 0;
+        g_mutex_unlock (lcm->batch_mutex);
+
+        int64_t now = lcm_clock_monotonic_us ();
+        int64_t next_deadline = 0;
+        for (int i = 0; i < lcm->num_tx_lanes; i++) {
+            udpm_tx_lane_t *lane = &lcm->tx_lanes[i];
+            g_static_mutex_lock (&lane->lock);
+            if (lane->batch_len > (int) sizeof (uint32_t)) {
+                if (lane->batch_deadline <= now)
+                    _flush_batch (lcm, lane);
+                else if (!next_deadline ||
+                        lane->batch_deadline < next_deadline)
+                    next_deadline = lane->batch_deadline;
+            }
+            g_static_mutex_unlock (&lane->lock);
+        }
+
+        g_mutex_lock (lcm->batch_mutex);
+        if (next_deadline && !lcm->batch_exit) {
+            lcm->batch_pending = 1;
+            // g_cond_timed_wait() takes a wall clock deadline
+            int64_t until_utime = lcm_clock_realtime_us () +
+                (next_deadline - lcm_clock_monotonic_us ());
+            GTimeVal until;
+            until.tv_sec = until_utime / 1000000;
+            until.tv_usec = until_utime % 1000000;
+            g_cond_timed_wait (lcm->batch_cond, lcm->batch_mutex, &until);
+        }
+    }
+    g_mutex_unlock (lcm->batch_mutex);
+    return NULL;
+}
+
+/* Tells batch_thread that a new batch is waiting.  Must be called without
+ * the lock of a lane held. */
+static void
+_batch_started (lcm_udpm_t *lcm)
+{
+    g_mutex_lock (lcm->batch_mutex);
+    lcm->batch_pending = 1;
+    g_cond_signal (lcm->batch_cond);
+    g_mutex_unlock (lcm->batch_mutex);
+}
+
+/* Transmits a message with sequence number seqno on the socket of lane.
+ * Retransmissions are marked so that only the receivers that asked for them
+ * accept them, and compressed messages so that they are decompressed.  With
+ * batch_us, a small message is only added to the batch of lane, and *batched
+ * is set if it started a new batch.  Other messages are transmitted after
+ * the batch, so that they stay in order.  Must be called with the lock of
+ * lane held, so that all fragments are transmitted together, and so that no
+ * other message uses the same sequence number (at least until the sequence
+ * # rolls over). */
+static int
+_transmit (lcm_udpm_t *lcm, udpm_tx_lane_t *lane, const char *channel,
+        const void *data, unsigned int datalen, uint32_t seqno,
+        int retransmit, int compressed, int *batched)
+{
+    int channel_size = strlen (channel);
+    uint32_t magic_flags = compressed ? LCM2_MAGIC_COMPRESSED : 0;
+
+    int payload_size = channel_size + 1 + datalen;
+    if (payload_size <= lcm_short_message_max_size (lcm->params.mtu)) {
+        // message is short.  send in a single packet
+        lcm2_header_short_t hdr;
+        hdr.magic = htonl ((retransmit ? LCM2_MAGIC_SHORT_RETRANSMIT :
+                    LCM2_MAGIC_SHORT) | magic_flags);
+        hdr.msg_seqno = htonl (seqno);
+
+        if (lane->batch && !retransmit &&
+                (int) (2 + sizeof (hdr)) + payload_size <=
+                lcm->batch_max_record) {
+            int started = _batch_message (lcm, lane, &hdr, channel,
+                    channel_size, data, datalen);
+            if (batched)
+                *batched = started;
+            return 0;
+        }
+        _flush_batch (lcm, lane);
+
+        struct iovec sendbufs[3];
+        sendbufs[0].iov_base = (char *) &hdr;
+        sendbufs[0].iov_len = sizeof (hdr);
+        sendbufs[1].iov_base = (char *) channel;
+        sendbufs[1].iov_len = channel_size + 1;
+        sendbufs[2].iov_base = (char *) data;
+        sendbufs[2].iov_len = datalen;
+
+        // transmit
+        int packet_size = datalen + sizeof (hdr) + channel_size + 1;
+        dbg (DBG_LCM_MSG, "transmitting %d byte [%s] payload (%d byte pkt)\n", 
+                datalen, channel, packet_size);
+
+//        int status = writev (lane->sendfd, sendbufs, 3);
         struct msghdr msg;
         msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
         msg.msg_namelen = sizeof(lcm->dest_addr);
@@ -646,17 +3138,15 @@ lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
         msg.msg_control = NULL;
         msg.msg_controllen = 0;
         msg.msg_flags = 0;
-        int status = sendmsg(lcm->sendfd, &msg, 0);
-
-        lcm->msg_seqno ++;
-        g_static_mutex_unlock (&lcm->transmit_lock);
+        int status = _send_datagram (lcm, lane, &msg);
 
         if (status == packet_size) return 0;
         else return status;
     } else {
         // message is large.  fragment into multiple packets
+        _flush_batch (lcm, lane);
 
-        int fragment_size = LCM_FRAGMENT_MAX_PAYLOAD;
+        int fragment_size = lcm_fragment_max_payload (lcm->params.mtu);
         int nfragments = payload_size / fragment_size +
             !!(payload_size % fragment_size);
 
@@ -665,146 +3155,617 @@ lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
             return -1;
         }
 
-        // acquire transmit lock so that all fragments are transmitted
-        // together, and so that no other message uses the same sequence number
-        // (at least until the sequence # rolls over)
-        g_static_mutex_lock (&lcm->transmit_lock);
         dbg (DBG_LCM_MSG, "transmitting %d byte [%s] payload in %d fragments\n",
                 payload_size, channel, nfragments);
 
         uint32_t fragment_offset = 0;
 
         lcm2_header_long_t hdr;
-        hdr.magic = htonl (LCM2_MAGIC_LONG);
-        hdr.msg_seqno = htonl (lcm->msg_seqno);
+        hdr.magic = htonl ((retransmit ? LCM2_MAGIC_LONG_RETRANSMIT :
+                    LCM2_MAGIC_LONG) | magic_flags);
+        hdr.msg_seqno = htonl (seqno);
         hdr.msg_size = htonl (datalen);
         hdr.fragment_offset = 0;
         hdr.fragment_no = 0;
         hdr.fragments_in_msg = htons (nfragments);
 
-        // first fragment is special.  insert channel before data
-        int firstfrag_datasize = fragment_size - (channel_size + 1);
-        assert (firstfrag_datasize <= datalen);
+        // first fragment is special.  insert channel before data
+        int firstfrag_datasize = fragment_size - (channel_size + 1);
+        assert (firstfrag_datasize <= datalen);
+
+#ifdef USE_SENDMMSG
+        // each fragment needs its own header, so build them a batch at a time
+        lcm2_header_long_t hdrs[LCM_SEND_BATCH];
+        struct iovec sendbufs[LCM_SEND_BATCH][3];
+        struct mmsghdr msgs[LCM_SEND_BATCH];
+        memset (msgs, 0, sizeof (msgs));
+
+        // when pacing, keep each batch within the burst size
+        int batch_size = LCM_SEND_BATCH;
+        if (lcm->pacer.rate > 0)
+            batch_size = MAX (1, MIN (LCM_SEND_BATCH, (int) (lcm->pacer.burst /
+                            (sizeof (hdr) + fragment_size))));
+
+        int status = 0;
+        int frag_no = 0;
+        while (status >= 0 && frag_no < nfragments) {
+            int n;
+            int batch_bytes = 0;
+            for (n = 0; n < batch_size && frag_no < nfragments;
+                    n++, frag_no++) {
+                hdrs[n] = hdr;
+                hdrs[n].fragment_offset = htonl (fragment_offset);
+                hdrs[n].fragment_no = htons (frag_no);
+
+                struct iovec *iov = sendbufs[n];
+                int iovlen = 0;
+                iov[iovlen].iov_base = (char *) &hdrs[n];
+                iov[iovlen++].iov_len = sizeof (hdr);
+                int fraglen;
+                if (frag_no == 0) {
+                    // first fragment is special.  insert channel before data
+                    iov[iovlen].iov_base = (char *) channel;
+                    iov[iovlen++].iov_len = channel_size + 1;
+                    fraglen = firstfrag_datasize;
+                } else {
+                    fraglen = MIN (fragment_size, datalen - fragment_offset);
+                }
+                iov[iovlen].iov_base = (char *) data + fragment_offset;
+                iov[iovlen++].iov_len = fraglen;
+
+                msgs[n].msg_hdr.msg_name = (struct sockaddr*) &lcm->dest_addr;
+                msgs[n].msg_hdr.msg_namelen = sizeof (lcm->dest_addr);
+                msgs[n].msg_hdr.msg_iov = iov;
+                msgs[n].msg_hdr.msg_iovlen = iovlen;
+                fragment_offset += fraglen;
+                for (int i = 0; i < iovlen; i++)
+                    batch_bytes += iov[i].iov_len;
+            }
+
+            _pace (lcm, batch_bytes);
+            status = _send_fragments (lcm, lane, msgs, n);
+        }
+#else
+        struct iovec    first_sendbufs[3];
+        first_sendbufs[0].iov_base = (char *) &hdr;
+        first_sendbufs[0].iov_len = sizeof (hdr);
+        first_sendbufs[1].iov_base = (char *) channel;
+        first_sendbufs[1].iov_len = channel_size + 1;
+        first_sendbufs[2].iov_base = (char *) data;
+        first_sendbufs[2].iov_len = firstfrag_datasize;
+
+        int packet_size = sizeof (hdr) + channel_size + 1 + firstfrag_datasize;
+        fragment_offset += firstfrag_datasize;
+//        int status = writev (lane->sendfd, first_sendbufs, 3);
+        struct msghdr msg;
+        msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
+        msg.msg_namelen = sizeof(lcm->dest_addr);
+        msg.msg_iov = first_sendbufs;
+        msg.msg_iovlen = 3;
+        msg.msg_control = NULL;
+        msg.msg_controllen = 0;
+        msg.msg_flags = 0;
+        int status = _send_datagram (lcm, lane, &msg);
+
+        // transmit the rest of the fragments
+        for (uint16_t frag_no=1; 
+                packet_size == status && frag_no<nfragments; 
+                frag_no++) {
+            hdr.fragment_offset = htonl (fragment_offset);
+            hdr.fragment_no = htons (frag_no);
+
+            int fraglen = MIN (fragment_size,
+                    datalen - fragment_offset);
+
+            struct iovec sendbufs[2];
+            sendbufs[0].iov_base = (char *) &hdr;
+            sendbufs[0].iov_len = sizeof (hdr);
+            sendbufs[1].iov_base = (char *) ((char *)data + fragment_offset);
+            sendbufs[1].iov_len = fraglen;
+
+//            status = writev (lane->sendfd, sendbufs, 2);
+            msg.msg_iov = sendbufs;
+            msg.msg_iovlen = 2;
+            packet_size = sizeof (hdr) + fraglen;
+            _pace (lcm, packet_size);
+            status = _send_datagram (lcm, lane, &msg);
+
+            fragment_offset += fraglen;
+        }
+
+        // sanity check
+        if (0 == status) {
+            assert (fragment_offset == datalen);
+        }
+#endif
+
+        if (lcm->params.fec_k && !retransmit)
+            _send_parity (lcm, lane, seqno, channel, channel_size, data,
+                    datalen, fragment_size, nfragments);
+    }
+
+    return 0;
+}
+
+/* Keeps a copy of a reliable message so that it can be retransmitted.  Must
+ * be called with the lock of lane held. */
+static void
+_retain_message (lcm_udpm_t *lcm, udpm_tx_lane_t *lane, const char *channel,
+        const void *data, unsigned int datalen, int compressed)
+{
+    udpm_retained_msg_t *rm =
+        &lane->retained[lane->msg_seqno % lcm->params.retransmit_window];
+    free (rm->data);
+    rm->data = (char *) malloc (datalen ? datalen : 1);
+    memcpy (rm->data, data, datalen);
+    rm->datalen = datalen;
+    rm->compressed = compressed;
+    rm->seqno = lane->msg_seqno;
+    strcpy (rm->channel, channel);
+}
+
+/* Answers the NACKs that receivers send to the transmit sockets by
+ * retransmitting the retained messages they ask for. */
+static void *
+_nack_thread (void *user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    lcm_internal_thread_init ("udpm-nack", NULL, NULL);
+    while (1) {
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (lcm->nack_pipe[0], &fds);
+        SOCKET maxfd = lcm->nack_pipe[0];
+        for (int i = 0; i < lcm->num_tx_lanes; i++) {
+            FD_SET (lcm->tx_lanes[i].sendfd, &fds);
+            maxfd = MAX(maxfd, lcm->tx_lanes[i].sendfd);
+        }
+
+        if (select (maxfd + 1, &fds, NULL, NULL, NULL) <= 0) {
+            perror ("nack thread -- select:");
+            continue;
+        }
+        if (FD_ISSET (lcm->nack_pipe[0], &fds))
+            break;
+
+        for (int i = 0; i < lcm->num_tx_lanes; i++) {
+            udpm_tx_lane_t *lane = &lcm->tx_lanes[i];
+            if (!FD_ISSET (lane->sendfd, &fds))
+                continue;
+
+            lcm2_nack_t nack;
+            ssize_t sz = recv (lane->sendfd, (char *) &nack, sizeof (nack), 0);
+            if (sz != sizeof (nack) || ntohl (nack.magic) != LCM2_MAGIC_NACK)
+                continue;
+
+            uint32_t first = ntohl (nack.first_seqno);
+            uint32_t count = ntohl (nack.count);
+            count = MIN(count, LCM_MAX_NACK_COUNT);
+            count = MIN(count, (uint32_t) lcm->params.retransmit_window);
+
+            g_static_mutex_lock (&lane->lock);
+            for (uint32_t j = 0; j < count; j++) {
+                uint32_t seqno = first + j;
+                udpm_retained_msg_t *rm =
+                    &lane->retained[seqno % lcm->params.retransmit_window];
+                if (!rm->data || rm->seqno != seqno)
+                    continue;
+                dbg (DBG_LCM, "retransmitting message %u\n", seqno);
+                _transmit (lcm, lane, rm->channel, rm->data, rm->datalen,
+                        seqno, 1, rm->compressed, NULL);
+            }
+            g_static_mutex_unlock (&lane->lock);
+        }
+    }
+    return NULL;
+}
+
+/* Returns the transmit socket for a message of the calling thread on
+ * channel.  Threads are numbered the first time they publish, so that they
+ * spread over the sockets, and the messages of one thread are always in
+ * order, except that qos_channels have a socket of their own. */
+static udpm_tx_lane_t *
+_tx_lane (lcm_udpm_t *lcm, const char *channel)
+{
+    if (lcm->qos_channels &&
+            lcm_channel_pattern_match (lcm->qos_channels, channel))
+        return &lcm->tx_lanes[lcm->num_thread_lanes];
+    if (lcm->num_thread_lanes == 1)
+        return &lcm->tx_lanes[0];
+    int id = GPOINTER_TO_INT (g_static_private_get (&TX_LANE_PKEY));
+    if (!id) {
+        id = g_atomic_int_exchange_and_add (&next_tx_thread, 1) + 1;
+        g_static_private_set (&TX_LANE_PKEY, GINT_TO_POINTER (id), NULL);
+    }
+    return &lcm->tx_lanes[(id - 1) % lcm->num_thread_lanes];
+}
+
+static int 
+lcm_udpm_publish (lcm_udpm_t *lcm, const char *channel, const void *data,
+        unsigned int datalen)
+{
+    if (strlen (channel) > LCM_MAX_CHANNEL_NAME_LENGTH) {
+        fprintf (stderr, "LCM Error: channel name too long [%s]\n",
+                channel);
+        return -1;
+    }
+    LCM_TRACE2 (udpm_publish_entry, channel, datalen);
+
+    // compress before taking the lock, so that other threads can transmit
+    // in the meantime
+    char *compressed = NULL;
+    if (lcm->params.compress && datalen >= (unsigned int) lcm->params.compress_min &&
+            (!lcm->compress_channels ||
+             lcm_channel_pattern_match (lcm->compress_channels, channel))) {
+        int size = lcm_compress_payload (lcm->params.compress, data, datalen,
+                &compressed);
+        if (size >= 0) {
+            data = compressed;
+            datalen = size;
+        }
+    }
+
+    udpm_tx_lane_t *lane = _tx_lane (lcm, channel);
+    g_static_mutex_lock (&lane->lock);
+    uint32_t seqno = lane->msg_seqno;
+    int batched = 0;
+    int status = _transmit (lcm, lane, channel, data, datalen,
+            seqno, 0, compressed != NULL, &batched);
+    if (lane->retained &&
+            lcm_channel_pattern_match (lcm->reliable, channel))
+        _retain_message (lcm, lane, channel, data, datalen, compressed != NULL);
+    lane->msg_seqno ++;
+    g_static_mutex_unlock (&lane->lock);
+    if (batched)
+        _batch_started (lcm);
+    free (compressed);
+    LCM_TRACE4 (udpm_publish_return, channel, datalen, seqno, status);
+    return status;
+}
 
-        struct iovec    first_sendbufs[3];
-        first_sendbufs[0].iov_base = (char *) &hdr;
-        first_sendbufs[0].iov_len = sizeof (hdr);
-        first_sendbufs[1].iov_base = (char *) channel;
-        first_sendbufs[1].iov_len = channel_size + 1;
-        first_sendbufs[2].iov_base = (char *) data;
-        first_sendbufs[2].iov_len = firstfrag_datasize;
+/* A fragmented message that is transmitted as it is written, so that it is
+ * never held whole.  The lock of lane is held from
+ * lcm_udpm_publish_stream_begin() to lcm_udpm_publish_stream_end(), so that
+ * the fragments go out together, and frag collects the payload of the
+ * fragment being written.  The first one begins with the channel. */
+typedef struct {
+    udpm_tx_lane_t *lane;
+    lcm2_header_long_t hdr;
+    int fragment_size;
+    int nfragments;
+    int frag_no;
+    uint32_t fragment_offset;   // of the data in frag, not counting the channel
+    int channel_part;           // bytes of the channel at the start of frag
+    int used;                   // bytes in frag
+    int status;
+    uint8_t frag[];
+} udpm_tx_stream_t;
 
-        int packet_size = sizeof (hdr) + channel_size + 1 + firstfrag_datasize;
-        fragment_offset += firstfrag_datasize;
-//        int status = writev (lcm->sendfd, first_sendbufs, 3);
-        struct msghdr msg;
-        msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
-        msg.msg_namelen = sizeof(lcm->dest_addr);
-        msg.msg_iov = first_sendbufs;
-        msg.msg_iovlen = 3;
-        msg.msg_control = NULL;
-        msg.msg_controllen = 0;
-        msg.msg_flags = 0;
-        int status = sendmsg(lcm->sendfd, &msg, 0);
+static void *
+lcm_udpm_publish_stream_begin (lcm_udpm_t *lcm, const char *channel,
+        unsigned int datalen)
+{
+    int channel_size = strlen (channel);
+    if (channel_size > LCM_MAX_CHANNEL_NAME_LENGTH)
+        return NULL;
+    // short messages are sent in one piece anyway, and compressed messages,
+    // parity packets and retained messages need all of the data
+    int64_t payload_size = (int64_t) channel_size + 1 + datalen;
+    if (payload_size <= lcm_short_message_max_size (lcm->params.mtu) ||
+            lcm->params.fec_k ||
+            (lcm->params.compress &&
+             datalen >= (unsigned int) lcm->params.compress_min &&
+             (!lcm->compress_channels ||
+              lcm_channel_pattern_match (lcm->compress_channels, channel))) ||
+            (lcm->reliable && lcm_channel_pattern_match (lcm->reliable, channel)))
+        return NULL;
 
-        // transmit the rest of the fragments
-        for (uint16_t frag_no=1; 
-                packet_size == status && frag_no<nfragments; 
-                frag_no++) {
-            hdr.fragment_offset = htonl (fragment_offset);
-            hdr.fragment_no = htons (frag_no);
+    int fragment_size = lcm_fragment_max_payload (lcm->params.mtu);
+    int64_t nfragments = (payload_size + fragment_size - 1) / fragment_size;
+    if (nfragments > 65535) {
+        fprintf (stderr, "LCM error: too much data for a single message\n");
+        return NULL;
+    }
 
-            int fraglen = MIN (fragment_size,
-                    datalen - fragment_offset);
+    udpm_tx_stream_t *stream = (udpm_tx_stream_t *) malloc (
+            sizeof (udpm_tx_stream_t) + fragment_size);
+    stream->fragment_size = fragment_size;
+    stream->nfragments = nfragments;
+    stream->frag_no = 0;
+    stream->fragment_offset = 0;
+    stream->channel_part = channel_size + 1;
+    stream->used = channel_size + 1;
+    stream->status = 0;
+    memcpy (stream->frag, channel, channel_size + 1);
+
+    stream->lane = _tx_lane (lcm, channel);
+    g_static_mutex_lock (&stream->lane->lock);
+    _flush_batch (lcm, stream->lane);
+    stream->hdr.magic = htonl (LCM2_MAGIC_LONG);
+    stream->hdr.msg_seqno = htonl (stream->lane->msg_seqno);
+    stream->hdr.msg_size = htonl (datalen);
+    stream->hdr.fragments_in_msg = htons (nfragments);
+    dbg (DBG_LCM_MSG, "streaming %d byte [%s] payload in %d fragments\n",
+            (int) payload_size, channel, (int) nfragments);
+    return stream;
+}
 
-            struct iovec sendbufs[2];
-            sendbufs[0].iov_base = (char *) &hdr;
-            sendbufs[0].iov_len = sizeof (hdr);
-            sendbufs[1].iov_base = (char *) ((char *)data + fragment_offset);
-            sendbufs[1].iov_len = fraglen;
+/* Transmits the fragment collected in stream. */
+static int
+_send_stream_fragment (lcm_udpm_t *lcm, udpm_tx_stream_t *stream)
+{
+    stream->hdr.fragment_offset = htonl (stream->fragment_offset);
+    stream->hdr.fragment_no = htons (stream->frag_no);
+
+    struct iovec sendbufs[2];
+    sendbufs[0].iov_base = (char *) &stream->hdr;
+    sendbufs[0].iov_len = sizeof (stream->hdr);
+    sendbufs[1].iov_base = (char *) stream->frag;
+    sendbufs[1].iov_len = stream->used;
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = (struct sockaddr*) &lcm->dest_addr;
+    msg.msg_namelen = sizeof (lcm->dest_addr);
+    msg.msg_iov = sendbufs;
+    msg.msg_iovlen = 2;
+
+    int packet_size = sizeof (stream->hdr) + stream->used;
+    _pace (lcm, packet_size);
+    if (_send_datagram (lcm, stream->lane, &msg) != packet_size)
+        return -1;
 
-//            status = writev (lcm->sendfd, sendbufs, 2);
-            msg.msg_iov = sendbufs;
-            msg.msg_iovlen = 2;
-            status = sendmsg(lcm->sendfd, &msg, 0);
+    stream->fragment_offset += stream->used - stream->channel_part;
+    stream->channel_part = 0;
+    stream->used = 0;
+    stream->frag_no++;
+    return 0;
+}
 
-            fragment_offset += fraglen;
-            packet_size = sizeof (hdr) + fraglen;
-        }
+static int
+lcm_udpm_publish_stream_write (lcm_udpm_t *lcm, void *_stream,
+        const void *data, unsigned int len)
+{
+    udpm_tx_stream_t *stream = (udpm_tx_stream_t *) _stream;
+    const uint8_t *p = (const uint8_t *) data;
+    while (len > 0 && stream->status == 0) {
+        unsigned int n = MIN (len,
+                (unsigned int) (stream->fragment_size - stream->used));
+        memcpy (stream->frag + stream->used, p, n);
+        stream->used += n;
+        p += n;
+        len -= n;
+        if (stream->used == stream->fragment_size)
+            stream->status = _send_stream_fragment (lcm, stream);
+    }
+    return stream->status;
+}
 
-        // sanity check
-        if (0 == status) {
-            assert (fragment_offset == datalen);
-        }
+static int
+lcm_udpm_publish_stream_end (lcm_udpm_t *lcm, void *_stream, int cancel)
+{
+    udpm_tx_stream_t *stream = (udpm_tx_stream_t *) _stream;
+    udpm_tx_lane_t *lane = stream->lane;
+    if (!cancel && stream->status == 0 && stream->used > 0)
+        stream->status = _send_stream_fragment (lcm, stream);
+    if (!cancel && stream->status == 0)
+        assert (stream->frag_no == stream->nfragments);
+    int status = cancel ? -1 : stream->status;
+    // receivers drop a message whose fragments stopped, so the number is
+    // used up either way
+    lane->msg_seqno++;
+    g_static_mutex_unlock (&lane->lock);
+    free (stream);
+    return status;
+}
+
+static int
+_rx_rings_empty (lcm_udpm_t *lcm)
+{
+    for (int i = 0; i < lcm->num_shards; i++) {
+        if (!lcm_buf_ring_is_empty (lcm->shards[i].filled) ||
+                !lcm_buf_ring_is_empty (lcm->shards[i].filled_urgent))
+            return 0;
+    }
+    return 1;
+}
 
-        lcm->msg_seqno ++;
-        g_static_mutex_unlock (&lcm->transmit_lock);
+/* Called by lcm_udpm_handle after it has taken packets from the rings.
+ * Leaves the notification in place if packets remain, putting it back if
+ * consumed is set, and otherwise takes it and lets the read threads signal
+ * the next one. */
+static void
+_rearm_notify (lcm_udpm_t *lcm, int consumed)
+{
+    if (_rx_rings_empty (lcm)) {
+        // notify_pending still guards against a second byte, so the one we
+        // leave unread is already there, or about to be
+        if (!consumed && lcm_internal_notify_wait (lcm->notify_pipe) <= 0)
+            perror ("read from notify");
+        g_atomic_int_set (&lcm->notify_pending, 0);
+        // a read thread may have queued a packet before seeing the flag
+        // cleared
+        if (_rx_rings_empty (lcm) ||
+                !g_atomic_int_compare_and_exchange (&lcm->notify_pending, 0, 1))
+            return;
+    } else if (!consumed) {
+        return;
     }
+    if (lcm_internal_notify_signal(lcm->notify_pipe) < 0)
+        perror ("write to notify");
+}
 
+/* Busy polling: spins until the read threads have queued a packet, for at
+ * most max_usec.  Returns nonzero if one is queued. */
+static int
+_spin_for_packets (lcm_udpm_t *lcm, int64_t max_usec)
+{
+    int64_t spin_until = lcm_clock_fast_ns () + max_usec * 1000;
+    do {
+        if (!_rx_rings_empty (lcm))
+            return 1;
+    } while (lcm_clock_fast_ns () < spin_until);
     return 0;
 }
 
+static int
+lcm_udpm_busy_wait (lcm_udpm_t *lcm, int timeout_millis)
+{
+    if (!lcm->params.busy_poll || _setup_recv_parts (lcm) < 0)
+        return 0;
+    return _spin_for_packets (lcm,
+            MIN ((int64_t) timeout_millis * 1000, lcm->params.busy_poll));
+}
+
 static int 
-lcm_udpm_handle (lcm_udpm_t *lcm)
+lcm_udpm_handle_batch (lcm_udpm_t *lcm, int max_msgs)
 {
     int status;
-    char ch;
-    if(0 != _setup_recv_parts (lcm))
+    if(0 != _setup_recv_parts (lcm)){
         return -1;
+    }
 
-    /* Read one byte from the notify pipe.  This will block if no packets are
-     * available yet and wake up when they are. */
-    status = lcm_internal_pipe_read(lcm->notify_pipe[0], &ch, 1);
-    if (status == 0) {
-        fprintf (stderr, "Error: lcm_handle read 0 bytes from notify_pipe\n");
-        return -1;
+    if (lcm->params.busy_poll)
+        _spin_for_packets (lcm, lcm->params.busy_poll);
+
+    /* Consume the notification if no packets are queued yet.  This blocks
+     * until they are.  While packets remain from an earlier call, the
+     * notification is left alone, so that draining a burst costs no system
+     * calls. */
+    int consumed = _rx_rings_empty (lcm);
+    if (consumed) {
+        status = lcm_internal_notify_wait(lcm->notify_pipe);
+        if (status == 0) {
+            fprintf (stderr,
+                    "Error: lcm_handle read 0 bytes from notify_pipe\n");
+            return -1;
+        }
+        else if (status < 0) {
+            fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
+            return -1;
+        }
     }
-    else if (status < 0) {
-        fprintf (stderr, "Error: lcm_handle read: %s\n", strerror (errno));
-        return -1;
+
+    /* Dequeue up to max_msgs received packets, taking one from each receive
+     * thread in turn so that a busy sender does not starve the others.  The
+     * urgent ones come first, so that they are dispatched first. */
+    lcm_buf_t * batch = NULL;
+    lcm_buf_t ** batch_tail = &batch;
+    int num_msgs = 0;
+    for (int urgent = 1; urgent >= 0; urgent--) {
+        int num_idle = 0;
+        while (num_msgs < max_msgs && num_idle < lcm->num_shards) {
+            udpm_rx_shard_t *shard = &lcm->shards[lcm->next_shard];
+            lcm->next_shard = (lcm->next_shard + 1) % lcm->num_shards;
+            lcm_buf_t * lcmb = lcm_buf_ring_pop (urgent ?
+                    shard->filled_urgent : shard->filled);
+            if (!lcmb) {
+                num_idle++;
+                continue;
+            }
+            num_idle = 0;
+            *batch_tail = lcmb;
+            batch_tail = &lcmb->next;
+            num_msgs++;
+        }
     }
 
-    /* Dequeue the next received packet */
-    g_static_rec_mutex_lock (&lcm->mutex);
-    lcm_buf_t * lcmb = lcm_buf_dequeue (lcm->inbufs_filled);
+    _rearm_notify (lcm, consumed);
 
-    if (!lcmb) {
+    if (!num_msgs) {
         fprintf (stderr, 
                 "Error: no packet available despite getting notification.\n");
-        g_static_rec_mutex_unlock (&lcm->mutex);
         return -1;
     }
 
-    /* If there are still packets in the queue, put something back in the pipe
-     * so that future invocations will get called. */
-    if (!lcm_buf_queue_is_empty (lcm->inbufs_filled))
-        if (lcm_internal_pipe_write(lcm->notify_pipe[1], "+", 1) < 0)
-            perror ("write to notify");
-    g_static_rec_mutex_unlock (&lcm->mutex);
+    for (lcm_buf_t * lcmb = batch; lcmb; lcmb = lcmb->next) {
+        // reassembled messages are in their own malloc()ed buffer, which
+        // handlers may keep.  Pool buffers go back to the pool.
+        lcm_recv_buf_owner_t owner = { lcmb->pool ? NULL : lcmb->buf, NULL };
+        lcm_recv_buf_t rbuf;
+        rbuf.data = (uint8_t*) lcmb->buf + lcmb->data_offset;
+        rbuf.data_size = lcmb->data_size;
+        rbuf.recv_utime = lcmb->recv_utime;
+        rbuf.recv_time_ns = lcmb->recv_time_ns;
+        rbuf.lcm = lcm->lcm;
+        rbuf.owner = &owner;
+
+        LCM_TRACE3 (udpm_dispatch_start, lcmb->channel_name, lcmb->data_size,
+                lcmb->msg_seqno);
+        if(lcm->creating_read_thread) {
+            // special case:  If we're creating the read thread and are in
+            // self-test mode, then only dispatch the self-test message.
+            if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
+                lcm_dispatch_handlers_by_id (lcm->lcm, &rbuf,
+                        lcmb->channel_name, lcmb->channel_id);
+        } else {
+            lcm_dispatch_handlers_by_id (lcm->lcm, &rbuf, lcmb->channel_name,
+                    lcmb->channel_id);
+        }
+        LCM_TRACE3 (udpm_dispatch_end, lcmb->channel_name, lcmb->data_size,
+                lcmb->msg_seqno);
 
-    lcm_recv_buf_t rbuf;
-    rbuf.data = (uint8_t*) lcmb->buf + lcmb->data_offset;
-    rbuf.data_size = lcmb->data_size;
-    rbuf.recv_utime = lcmb->recv_utime;
-    rbuf.lcm = lcm->lcm;
+        if (lcm_recv_buf_owner_finish (&owner))
+            lcmb->buf = NULL;
+    }
 
-    if(lcm->creating_read_thread) {
-        // special case:  If we're creating the read thread and are in
-        // self-test mode, then only dispatch the self-test message.
-        if(!strcmp(lcmb->channel_name, SELF_TEST_CHANNEL))
-            lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
-    } else {
-        lcm_dispatch_handlers (lcm->lcm, &rbuf, lcmb->channel_name);
+    /* Give the buffers back to the read threads, which free their data.  This
+     * never overflows the returned rings, see bufs_outstanding. */
+    while (batch) {
+        lcm_buf_t * lcmb = batch;
+        batch = lcmb->next;
+        lcm_buf_ring_push (lcm->shards[lcmb->rx_shard].returned, lcmb);
     }
 
+    return num_msgs;
+}
+
+static int
+lcm_udpm_get_stats (lcm_udpm_t *lcm, lcm_transport_stats_t *stats)
+{
+    memset (stats, 0, sizeof (lcm_transport_stats_t));
+    stats->ring_low_watermark = 1.0;
+
     g_static_rec_mutex_lock (&lcm->mutex);
-    lcm_buf_free_data(lcmb, lcm->ringbuf);
-    lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
+    for (int i = 0; i < lcm->num_shards; i++) {
+        udpm_rx_shard_t *shard = &lcm->shards[i];
+        g_static_mutex_lock (&shard->stats_lock);
+        lcm_transport_stats_t *s = &shard->stats_snapshot;
+        stats->num_packets += s->num_packets;
+        stats->num_bytes += s->num_bytes;
+        stats->num_bad_packets += s->num_bad_packets;
+        stats->num_lost += s->num_lost;
+        stats->num_reordered += s->num_reordered;
+        stats->num_duplicated += s->num_duplicated;
+        stats->num_incomplete += s->num_incomplete;
+        stats->num_dropped_no_buffer += s->num_dropped_no_buffer;
+        stats->num_fec_recovered += s->num_fec_recovered;
+        stats->num_nacked += s->num_nacked;
+        stats->num_retransmitted += s->num_retransmitted;
+        stats->num_senders += s->num_senders;
+        stats->ring_low_watermark = MIN (stats->ring_low_watermark,
+                s->ring_low_watermark);
+        stats->frag_bytes_high_watermark += s->frag_bytes_high_watermark;
+        stats->num_dropped_too_large += s->num_dropped_too_large;
+        g_static_mutex_unlock (&shard->stats_lock);
+    }
     g_static_rec_mutex_unlock (&lcm->mutex);
-
     return 0;
 }
 
+static int 
+lcm_udpm_handle (lcm_udpm_t *lcm)
+{
+    int status = lcm_udpm_handle_batch (lcm, 1);
+    return status < 0 ? status : 0;
+}
+
 static void
 self_test_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *user)
 {
@@ -825,16 +3786,14 @@ udpm_self_test (lcm_udpm_t *lcm)
     char *msg = "lcm self test";
     lcm_udpm_publish (lcm, SELF_TEST_CHANNEL, (uint8_t*)msg, strlen (msg));
 
-    // wait one second for message to be received
+    // wait ten seconds for message to be received
     GTimeVal now, endtime;
     g_get_current_time(&now);
-    endtime.tv_sec = now.tv_sec + 10;
-    endtime.tv_usec = now.tv_usec;
+    lcm_timeval_add (&now, &SELF_TEST_TIMEOUT, &endtime);
 
     // periodically retransmit, just in case
-    GTimeVal retransmit_interval = { 0, 100000 };
     GTimeVal next_retransmit;
-    lcm_timeval_add (&now, &retransmit_interval, &next_retransmit);
+    lcm_timeval_add (&now, &SELF_TEST_RETRANSMIT_INTERVAL, &next_retransmit);
 
     int recvfd = lcm->notify_pipe[0];
 
@@ -850,7 +3809,8 @@ udpm_self_test (lcm_udpm_t *lcm)
         if (lcm_timeval_compare (&now, &next_retransmit) > 0) {
             status = lcm_udpm_publish (lcm, SELF_TEST_CHANNEL, (uint8_t*)msg, 
                     strlen (msg));
-            lcm_timeval_add (&now, &retransmit_interval, &next_retransmit);
+            lcm_timeval_add (&now, &SELF_TEST_RETRANSMIT_INTERVAL,
+                    &next_retransmit);
         }
 
         status=select (recvfd + 1,&readfds,0,0, (struct timeval*) &selectto);
@@ -870,61 +3830,326 @@ udpm_self_test (lcm_udpm_t *lcm)
     return (success == 1)?0:-1;
 }
 
+/* Runs the self test while the read threads receive.  The message is
+ * published until a read thread sees it come back, and the result goes to
+ * lcm_internal_set_self_test_status. */
+static void *
+_self_test_thread (void *user)
+{
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    lcm_internal_thread_init ("udpm-selftest", NULL, NULL);
+
+    char *msg = "lcm self test";
+    GTimeVal now, endtime;
+    g_get_current_time (&now);
+    lcm_timeval_add (&now, &SELF_TEST_TIMEOUT, &endtime);
+
+    g_mutex_lock (lcm->self_test_mutex);
+    while (!lcm->self_test_passed && !lcm->self_test_stop) {
+        g_get_current_time (&now);
+        if (lcm_timeval_compare (&now, &endtime) >= 0)
+            break;
+
+        g_mutex_unlock (lcm->self_test_mutex);
+        lcm_udpm_publish (lcm, SELF_TEST_CHANNEL, (uint8_t*) msg,
+                strlen (msg));
+        g_mutex_lock (lcm->self_test_mutex);
+
+        // periodically retransmit, just in case
+        GTimeVal next_retransmit;
+        lcm_timeval_add (&now, &SELF_TEST_RETRANSMIT_INTERVAL,
+                &next_retransmit);
+        if (!lcm->self_test_passed && !lcm->self_test_stop)
+            g_cond_timed_wait (lcm->self_test_cond, lcm->self_test_mutex,
+                    &next_retransmit);
+    }
+    int passed = lcm->self_test_passed;
+    int stopped = lcm->self_test_stop;
+    g_mutex_unlock (lcm->self_test_mutex);
+    g_atomic_int_set (&lcm->self_test_waiting, 0);
+
+    if (passed) {
+        dbg (DBG_LCM, "LCM: self test successful\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_PASSED);
+    } else if (!stopped) {
+        // unlike the synchronous test, keep receiving.  Unicast senders on
+        // the same host may still get through.
+        fprintf (stderr, "LCM self test failed!!\n"
+                "Check your routing tables and firewall settings\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_FAILED);
+    }
+    return NULL;
+}
+
+// Starts the background self test.  Called with the mutex locked.
+static void
+_start_self_test (lcm_udpm_t *lcm)
+{
+    if (!lcm->self_test_mutex) {
+        lcm->self_test_mutex = g_mutex_new ();
+        lcm->self_test_cond = g_cond_new ();
+    }
+    lcm->self_test_passed = 0;
+    lcm->self_test_stop = 0;
+    g_atomic_int_set (&lcm->self_test_waiting, 1);
+    lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_PENDING);
+
+    dbg (DBG_LCM, "LCM: conducting self test in the background\n");
+    lcm->self_test_thread = g_thread_create (_self_test_thread, lcm, TRUE,
+            NULL);
+    if (!lcm->self_test_thread) {
+        fprintf (stderr, "Error: LCM failed to start self test thread\n");
+        g_atomic_int_set (&lcm->self_test_waiting, 0);
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_NONE);
+    }
+}
+
+#ifdef USE_SOCKET_FILTER
+#define FILTER_ACCEPT 0xffffffff
+
+// the filter sees the packet starting at the UDP header
+#define FILTER_LCM_OFF 8
+
+static void
+_filter_emit (GArray *code, uint16_t op, uint8_t jt, uint8_t jf, uint32_t k)
+{
+    struct sock_filter insn = BPF_JUMP (op, k, jt, jf);
+    g_array_append_val (code, insn);
+}
+
+/* Appends instructions that accept the datagram if the len bytes starting at
+ * offset X are those of str, and otherwise go on to whatever follows them. */
+static void
+_filter_emit_match (GArray *code, const char *str, int len)
+{
+    int num_compares = len / 4 + (len % 4 >= 2) + (len % 2);
+    int block_len = 2 * num_compares + 1;
+    int pos = 0;
+    for (int off = 0; off < len; ) {
+        int n = (len - off >= 4) ? 4 : (len - off >= 2) ? 2 : 1;
+        uint32_t word = 0;
+        for (int i = 0; i < n; i++)
+            word = (word << 8) | (uint8_t) str[off + i];
+        uint16_t size = (n == 4) ? BPF_W : (n == 2) ? BPF_H : BPF_B;
+        _filter_emit (code, BPF_LD | size | BPF_IND, 0, 0, off);
+        pos += 2;
+        _filter_emit (code, BPF_JMP | BPF_JEQ | BPF_K, 0, block_len - pos,
+                word);
+        off += n;
+    }
+    _filter_emit (code, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+}
+
+/* Appends instructions that accept the messages on subscribed channels, and
+ * drop everything else.  Fragments other than the first of a message do not
+ * carry the channel name, and are always accepted.  Returns 0 without
+ * appending anything if a subscription cannot be checked this way, i.e., it
+ * is a regular expression.  Must be called with lcm->mutex held. */
 static int
-_setup_recv_parts (lcm_udpm_t *lcm)
+_filter_emit_channels (lcm_udpm_t *lcm, GArray *code)
 {
-    g_static_rec_mutex_lock(&lcm->mutex);
+    GPtrArray *patterns = g_ptr_array_new ();
+    GHashTableIter iter;
+    gpointer key;
+    int ok = 1;
+
+    g_hash_table_iter_init (&iter, lcm->subscriptions);
+    while (ok && g_hash_table_iter_next (&iter, &key, NULL)) {
+        lcm_channel_pattern_t *pat = lcm_channel_pattern_new (
+                (const char *) key, NULL);
+        if (!pat)
+            continue;
+        g_ptr_array_add (patterns, pat);
+        lcm_channel_pattern_kind_t kind = lcm_channel_pattern_kind (pat);
+        if (kind == LCM_CHANNEL_PATTERN_REGEX ||
+                (kind == LCM_CHANNEL_PATTERN_PREFIX &&
+                 !*lcm_channel_pattern_text (pat)))
+            ok = 0;
+    }
 
-    // some thread synchronization code to ensure that only one thread sets up the
-    // receive thread, and that all threads entering this function after the thread
-    // setup begins wait for it to finish.
-    if(lcm->creating_read_thread) {
-        // check if this thread is the one creating the receive thread.
-        // If so, just return.
-        if(g_static_private_get(&CREATE_READ_THREAD_PKEY)) {
-            g_static_rec_mutex_unlock(&lcm->mutex);
-            return 0;
+    if (ok) {
+        const int short_off = FILTER_LCM_OFF + sizeof (lcm2_header_short_t);
+        const int long_off = FILTER_LCM_OFF + sizeof (lcm2_header_long_t);
+        const int frag_no_off = FILTER_LCM_OFF +
+            offsetof (lcm2_header_long_t, fragment_no);
+
+        // X = offset of the channel name
+        _filter_emit (code, BPF_LD | BPF_W | BPF_ABS, 0, 0, FILTER_LCM_OFF);
+        _filter_emit (code, BPF_JMP | BPF_JEQ | BPF_K, 4, 0, LCM2_MAGIC_SHORT);
+        _filter_emit (code, BPF_JMP | BPF_JEQ | BPF_K, 0, 2, LCM2_MAGIC_LONG);
+        _filter_emit (code, BPF_LD | BPF_H | BPF_ABS, 0, 0, frag_no_off);
+        _filter_emit (code, BPF_JMP | BPF_JEQ | BPF_K, 3, 0, 0);
+        // not an LCM packet, or a later fragment
+        _filter_emit (code, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+        _filter_emit (code, BPF_LDX | BPF_W | BPF_IMM, 0, 0, short_off);
+        _filter_emit (code, BPF_JMP | BPF_JA, 0, 0, 1);
+        _filter_emit (code, BPF_LDX | BPF_W | BPF_IMM, 0, 0, long_off);
+
+        // the self test has to get through before anyone subscribes
+        _filter_emit_match (code, SELF_TEST_CHANNEL,
+                strlen (SELF_TEST_CHANNEL) + 1);
+        if (lcm->params.interest)
+            _filter_emit_match (code, LCM_INTEREST_CHANNEL,
+                    strlen (LCM_INTEREST_CHANNEL) + 1);
+        for (unsigned int i = 0; i < patterns->len; i++) {
+            lcm_channel_pattern_t *pat =
+                (lcm_channel_pattern_t *) g_ptr_array_index (patterns, i);
+            const char *text = lcm_channel_pattern_text (pat);
+            // a channel name has to match up to its terminating zero
+            if (lcm_channel_pattern_kind (pat) == LCM_CHANNEL_PATTERN_LITERAL)
+                _filter_emit_match (code, text, strlen (text) + 1);
+            else
+                _filter_emit_match (code, text, strlen (text));
         }
+        _filter_emit (code, BPF_RET | BPF_K, 0, 0, 0);
+    }
 
-        // ugly bit with two mutexes because we can't use a GStaticRecMutex with a GCond
-        g_mutex_lock(lcm->create_read_thread_mutex);
-        g_static_rec_mutex_unlock(&lcm->mutex);
+    for (unsigned int i = 0; i < patterns->len; i++)
+        lcm_channel_pattern_free (
+                (lcm_channel_pattern_t *) g_ptr_array_index (patterns, i));
+    g_ptr_array_free (patterns, TRUE);
+    return ok;
+}
 
-        // wait for the thread creating the read thread to finish
-        while(lcm->creating_read_thread) {
-            g_cond_wait(lcm->create_read_thread_cond, lcm->create_read_thread_mutex);
+/* Attaches the socket filter of a shard.  With several shards, the filter
+ * only accepts datagrams whose sender address and port hash to this shard.
+ * Every datagram sent to the multicast group is delivered to every socket
+ * bound to the port, so each one is accepted by exactly one shard.  Then, if
+ * possible, it drops the channels nobody subscribes to before they cost a
+ * system call.
+ *
+ * Returns 1 if the filter drops channels, 0 if not, and -1 on error.  Must
+ * be called with lcm->mutex held. */
+static int
+_attach_socket_filter (udpm_rx_shard_t *shard)
+{
+    lcm_udpm_t *lcm = shard->lcm;
+    GArray *code = g_array_new (FALSE, FALSE, sizeof (struct sock_filter));
+
+    if (lcm->num_shards > 1) {
+        // A = source address ^ source port
+        _filter_emit (code, BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_NET_OFF + 12);
+        _filter_emit (code, BPF_MISC | BPF_TAX, 0, 0, 0);
+        _filter_emit (code, BPF_LD | BPF_H | BPF_ABS, 0, 0, 0);
+        _filter_emit (code, BPF_ALU | BPF_XOR | BPF_X, 0, 0, 0);
+        _filter_emit (code, BPF_ALU | BPF_MOD | BPF_K, 0, 0, lcm->num_shards);
+        _filter_emit (code, BPF_JMP | BPF_JEQ | BPF_K, 1, 0, shard->index);
+        _filter_emit (code, BPF_RET | BPF_K, 0, 0, 0);
+    }
+
+    guint shard_len = code->len;
+    int filtering = lcm->params.channel_filter &&
+        _filter_emit_channels (lcm, code);
+    if (filtering && code->len > BPF_MAXINSNS) {
+        dbg (DBG_LCM, "too many subscriptions for a socket filter\n");
+        g_array_set_size (code, shard_len);
+        filtering = 0;
+    }
+
+    int status = 0;
+    if (!code->len) {
+        // nothing to filter.  Fails harmlessly if there was no filter.  The
+        // kernel ignores the value, but rejects an option shorter than an int.
+        int unused = 0;
+        setsockopt (shard->recvfd, SOL_SOCKET, SO_DETACH_FILTER, &unused,
+                sizeof (unused));
+    } else {
+        if (!filtering)
+            _filter_emit (code, BPF_RET | BPF_K, 0, 0, FILTER_ACCEPT);
+        struct sock_fprog prog;
+        prog.len = code->len;
+        prog.filter = (struct sock_filter *) code->data;
+        if (setsockopt (shard->recvfd, SOL_SOCKET, SO_ATTACH_FILTER,
+                    &prog, sizeof (prog)) < 0) {
+            perror ("setsockopt (SOL_SOCKET, SO_ATTACH_FILTER)");
+            status = -1;
         }
-        g_mutex_unlock(lcm->create_read_thread_mutex);
-        g_static_rec_mutex_lock(&lcm->mutex);
+    }
+    g_array_free (code, TRUE);
+    return status < 0 ? status : filtering;
+}
 
-        // if we've gotten here, then either the read thread is created, or it
-        // was not possible to do so.  Figure out which happened, and return.
-        int result = lcm->thread_created ? 0 : -1;
-        g_static_rec_mutex_unlock(&lcm->mutex);
-        return result;
-    } else if(lcm->thread_created) {
-        g_static_rec_mutex_unlock(&lcm->mutex);
-        return 0;
+/* Rebuilds the socket filters after the subscriptions changed.  Must be
+ * called with lcm->mutex held. */
+static void
+_update_socket_filters (lcm_udpm_t *lcm)
+{
+    int filtering = 0;
+    for (int i = 0; i < lcm->num_shards; i++) {
+        if (lcm->shards[i].recvfd >= 0)
+            filtering = _attach_socket_filter (&lcm->shards[i]) > 0;
     }
+    g_atomic_int_set (&lcm->filtering_channels, filtering);
+}
+#endif
 
-    // no other thread is trying to create the read thread right now.  claim that task.
-    lcm->creating_read_thread = 1;
-    lcm->create_read_thread_mutex = g_mutex_new();
-    lcm->create_read_thread_cond = g_cond_new();
-    // mark this thread as the one creating the read thread
-    g_static_private_set(&CREATE_READ_THREAD_PKEY, GINT_TO_POINTER(1), NULL);
+/* Returns the NUMA node that the read thread of shard @index is placed on,
+ * or -1 to leave it alone. */
+static int
+_numa_node_of_shard (lcm_udpm_t *lcm, int index)
+{
+    if (lcm->params.num_numa_nodes)
+        return lcm->params.numa_nodes[index % lcm->params.num_numa_nodes];
+    if (!lcm->params.numa_auto)
+        return -1;
+    int node = lcm->params.xdp_ifname ?
+        lcm_numa_node_of_ifname (lcm->params.xdp_ifname) :
+        lcm_numa_node_of_route (lcm->params.mc_addr);
+    if (node < 0 && !index)
+        dbg (DBG_LCM, "the NUMA node of the network interface is not "
+                "known, leaving the read threads alone\n");
+    return node;
+}
 
-    dbg (DBG_LCM, "allocating resources for receiving messages\n");
+/* Opens and binds the receive socket of one shard */
+static int
+_setup_recv_shard (lcm_udpm_t *lcm, udpm_rx_shard_t *shard)
+{
+    shard->numa_node = _numa_node_of_shard (lcm, shard->index);
+    if (shard->numa_node >= 0) {
+        shard->numa_cpus = lcm_numa_node_cpus (shard->numa_node);
+        if (!shard->numa_cpus) {
+            fprintf (stderr, "LCM: NUMA node %d has no CPUs, leaving read "
+                    "thread %d alone\n", shard->numa_node, shard->index);
+            shard->numa_node = -1;
+        } else {
+            dbg (DBG_LCM, "read thread %d is placed on NUMA node %d (CPUs "
+                    "%s)\n", shard->index, shard->numa_node,
+                    shard->numa_cpus);
+        }
+    }
 
     // allocate the fragment buffer hashtable
-    lcm->frag_bufs = lcm_frag_buf_store_new(MAX_FRAG_BUF_TOTAL_SIZE,
-            MAX_NUM_FRAG_BUFS);
+    int64_t frag_store_size = lcm->params.frag_store_size ?
+        lcm->params.frag_store_size / lcm->num_shards : MAX_FRAG_BUF_TOTAL_SIZE;
+    shard->frag_bufs = lcm_frag_buf_store_new(frag_store_size,
+            MAX (lcm->params.max_frag_msgs / lcm->num_shards, 1));
+    shard->frag_bufs->max_age_usec = lcm->params.frag_timeout_ms < 0 ? 0 :
+        (int64_t) lcm->params.frag_timeout_ms * 1000;
+    shard->pool = lcm_bufpool_new (MAX (lcm->params.recv_pool_size /
+                lcm->num_shards, LCM_MAX_UNFRAGMENTED_PACKET_SIZE * 2));
+    // on a NUMA node, the read thread fills its pool itself
+    if (lcm->params.prealloc && shard->numa_node < 0 &&
+            lcm_bufpool_prealloc (shard->pool) < 0)
+        fprintf (stderr, "Warning: could not preallocate the receive "
+                "buffer pool\n");
+    shard->filled = lcm_buf_ring_new (LCM_BUF_RING_SIZE);
+    shard->filled_urgent = lcm_buf_ring_new (LCM_BUF_RING_SIZE);
+    shard->returned = lcm_buf_ring_new (LCM_BUF_RING_SIZE);
+
+    shard->free_bufs = lcm_buf_queue_new ();
+    for (int i = 0; i < LCM_DEFAULT_RECV_BUFS / lcm->num_shards; i++) {
+        /* We don't set the receive buffer's data pointer yet because it
+         * will be taken from the pool at receive time. */
+        lcm_buf_t * lcmb = (lcm_buf_t *) calloc (1, sizeof (lcm_buf_t));
+        lcm_buf_enqueue (shard->free_bufs, lcmb);
+    }
 
     // allocate multicast socket
-    lcm->recvfd = socket (AF_INET, SOCK_DGRAM, 0);
-    if (lcm->recvfd < 0) {
+    shard->recvfd = socket (AF_INET, SOCK_DGRAM, 0);
+    if (shard->recvfd < 0) {
         perror ("allocating LCM recv socket");
-        goto setup_recv_thread_fail;
+        return -1;
     }
 
     struct sockaddr_in addr;
@@ -937,10 +4162,10 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     // multicast address and port
     int opt=1;
     dbg (DBG_LCM, "LCM: setting SO_REUSEADDR\n");
-    if (setsockopt (lcm->recvfd, SOL_SOCKET, SO_REUSEADDR, 
+    if (setsockopt (shard->recvfd, SOL_SOCKET, SO_REUSEADDR, 
             (char*)&opt, sizeof (opt)) < 0) {
         perror ("setsockopt (SOL_SOCKET, SO_REUSEADDR)");
-        goto setup_recv_thread_fail;
+        return -1;
     }
 
 #ifdef USE_REUSEPORT
@@ -948,10 +4173,10 @@ _setup_recv_parts (lcm_udpm_t *lcm)
      * to REUSEADDR or it won't let multiple processes bind to the
      * same port, even if they are using multicast. */
     dbg (DBG_LCM, "LCM: setting SO_REUSEPORT\n");
-    if (setsockopt (lcm->recvfd, SOL_SOCKET, SO_REUSEPORT, 
+    if (setsockopt (shard->recvfd, SOL_SOCKET, SO_REUSEPORT, 
             (char*)&opt, sizeof (opt)) < 0) {
         perror ("setsockopt (SOL_SOCKET, SO_REUSEPORT)");
-        goto setup_recv_thread_fail;
+        return -1;
     }
 #endif
 
@@ -960,7 +4185,7 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     // are also delivered to it
     unsigned char lo_opt = 1;
     dbg (DBG_LCM, "LCM: setting multicast loopback option\n");
-    status = setsockopt (lcm->recvfd, IPPROTO_IP, IP_MULTICAST_LOOP, 
+    status = setsockopt (shard->recvfd, IPPROTO_IP, IP_MULTICAST_LOOP, 
             &lo_opt, sizeof (lo_opt));
     if (status < 0) {
         perror ("setting multicast loopback");
@@ -972,69 +4197,164 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     // Windows has small (8k) buffer by default
     // Increase it to a default reasonable amount
     int recv_buf_size = 2048 * 1024;
-    setsockopt(lcm->recvfd, SOL_SOCKET, SO_RCVBUF, 
+    setsockopt(shard->recvfd, SOL_SOCKET, SO_RCVBUF, 
             (char*)&recv_buf_size, sizeof(recv_buf_size));
 #endif
 
     // debugging... how big is the receive buffer?
     unsigned int retsize = sizeof (int);
-    getsockopt (lcm->recvfd, SOL_SOCKET, SO_RCVBUF, 
-            (char*)&lcm->kernel_rbuf_sz, (socklen_t *) &retsize);
-    dbg (DBG_LCM, "LCM: receive buffer is %d bytes\n", lcm->kernel_rbuf_sz);
+    getsockopt (shard->recvfd, SOL_SOCKET, SO_RCVBUF, 
+            (char*)&shard->kernel_rbuf_sz, (socklen_t *) &retsize);
+    dbg (DBG_LCM, "LCM: receive buffer is %d bytes\n", shard->kernel_rbuf_sz);
     if (lcm->params.recv_buf_size) {
-        if (setsockopt (lcm->recvfd, SOL_SOCKET, SO_RCVBUF,
+        if (setsockopt (shard->recvfd, SOL_SOCKET, SO_RCVBUF,
                 (char *) &lcm->params.recv_buf_size, 
                 sizeof (lcm->params.recv_buf_size)) < 0) {
             perror ("setsockopt(SOL_SOCKET, SO_RCVBUF)");
             fprintf (stderr, "Warning: Unable to set recv buffer size\n");
         }
-        getsockopt (lcm->recvfd, SOL_SOCKET, SO_RCVBUF, 
-                (char*)&lcm->kernel_rbuf_sz, (socklen_t *) &retsize);
-        dbg (DBG_LCM, "LCM: receive buffer is %d bytes\n", lcm->kernel_rbuf_sz);
+        getsockopt (shard->recvfd, SOL_SOCKET, SO_RCVBUF, 
+                (char*)&shard->kernel_rbuf_sz, (socklen_t *) &retsize);
+        dbg (DBG_LCM, "LCM: receive buffer is %d bytes\n", shard->kernel_rbuf_sz);
 
-        if (lcm->params.recv_buf_size > lcm->kernel_rbuf_sz) {
+        if (lcm->params.recv_buf_size > shard->kernel_rbuf_sz) {
             g_warning ("LCM UDP receive buffer size (%d) \n"
                     "       is smaller than reqested (%d). "
                     "For more info:\n"
                     "       http://lcm-proj.github.io/multicast_setup.html\n", 
-                    lcm->kernel_rbuf_sz, lcm->params.recv_buf_size);
+                    shard->kernel_rbuf_sz, lcm->params.recv_buf_size);
         }
     }
 
+#ifdef SO_BUSY_POLL
+    // lets reads poll the network device queue instead of waiting for its
+    // interrupt.  Values above the net.core.busy_read sysctl need
+    // CAP_NET_ADMIN.
+    if (lcm->params.busy_poll &&
+            setsockopt (shard->recvfd, SOL_SOCKET, SO_BUSY_POLL,
+                &lcm->params.busy_poll, sizeof (lcm->params.busy_poll)) < 0)
+        dbg (DBG_LCM, "setsockopt (SOL_SOCKET, SO_BUSY_POLL): %s\n",
+                strerror (errno));
+#endif
+
     /* Enable per-packet timestamping by the kernel, if available */
+#ifdef USE_NS_TIMESTAMPS
+    if (lcm->params.rx_timestamp == UDPM_RX_TIMESTAMP_NS) {
+        opt = 1;
+        if (setsockopt (shard->recvfd, SOL_SOCKET, SO_TIMESTAMPNS,
+                    &opt, sizeof (opt)) < 0)
+            perror ("setsockopt (SOL_SOCKET, SO_TIMESTAMPNS)");
+    } else if (lcm->params.rx_timestamp != UDPM_RX_TIMESTAMP_DEFAULT) {
+        opt = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (lcm->params.rx_timestamp == UDPM_RX_TIMESTAMP_HW)
+            opt |= SOF_TIMESTAMPING_RX_HARDWARE |
+                SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (setsockopt (shard->recvfd, SOL_SOCKET, SO_TIMESTAMPING,
+                    &opt, sizeof (opt)) < 0)
+            perror ("setsockopt (SOL_SOCKET, SO_TIMESTAMPING)");
+    } else
+#endif
+    {
 #ifdef SO_TIMESTAMP
-    opt = 1;
-    setsockopt (lcm->recvfd, SOL_SOCKET, SO_TIMESTAMP, &opt, sizeof (opt));
+        opt = 1;
+        setsockopt (shard->recvfd, SOL_SOCKET, SO_TIMESTAMP, &opt,
+                sizeof (opt));
+#endif
+    }
+
+#ifdef USE_SOCKET_FILTER
+    int filtering = _attach_socket_filter (shard);
+    if (filtering < 0)
+        return -1;
+    g_atomic_int_set (&lcm->filtering_channels, filtering);
 #endif
 
-    if (bind (lcm->recvfd, (struct sockaddr*)&addr, sizeof (addr)) < 0) {
-        perror ("bind");
-        goto setup_recv_thread_fail;
+    if (bind (shard->recvfd, (struct sockaddr*)&addr, sizeof (addr)) < 0) {
+        perror ("bind");
+        return -1;
+    }
+
+    // join the multicast group, on each of the interfaces if they are given.
+    // One that is listed twice is only joined on once.
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = lcm->params.mc_addr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    for (int i = 0; i < MAX (1, lcm->num_ifaces); i++) {
+        if (lcm->num_ifaces)
+            mreq.imr_interface = lcm->ifaces[i].addr;
+        dbg (DBG_LCM, "LCM: joining multicast group\n");
+        if (setsockopt (shard->recvfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                (char*)&mreq, sizeof (mreq)) < 0 &&
+                !(lcm->num_ifaces && errno == EADDRINUSE)) {
+            perror ("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+_setup_recv_parts (lcm_udpm_t *lcm)
+{
+    g_static_rec_mutex_lock(&lcm->mutex);
+
+    // some thread synchronization code to ensure that only one thread sets up the
+    // receive thread, and that all threads entering this function after the thread
+    // setup begins wait for it to finish.
+    if(lcm->creating_read_thread) {
+        // check if this thread is the one creating the receive thread.
+        // If so, just return.
+        if(g_static_private_get(&CREATE_READ_THREAD_PKEY)) {
+            g_static_rec_mutex_unlock(&lcm->mutex);
+            return 0;
+        }
+
+        // ugly bit with two mutexes because we can't use a GStaticRecMutex with a GCond
+        g_mutex_lock(lcm->create_read_thread_mutex);
+        g_static_rec_mutex_unlock(&lcm->mutex);
+
+        // wait for the thread creating the read thread to finish
+        while(lcm->creating_read_thread) {
+            g_cond_wait(lcm->create_read_thread_cond, lcm->create_read_thread_mutex);
+        }
+        g_mutex_unlock(lcm->create_read_thread_mutex);
+        g_static_rec_mutex_lock(&lcm->mutex);
+
+        // if we've gotten here, then either the read thread is created, or it
+        // was not possible to do so.  Figure out which happened, and return.
+        int result = lcm->thread_created ? 0 : -1;
+        g_static_rec_mutex_unlock(&lcm->mutex);
+        return result;
+    } else if(lcm->thread_created) {
+        g_static_rec_mutex_unlock(&lcm->mutex);
+        return 0;
     }
 
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr = lcm->params.mc_addr;
-    mreq.imr_interface.s_addr = INADDR_ANY;
-    // join the multicast group
-    dbg (DBG_LCM, "LCM: joining multicast group\n");
-    if (setsockopt (lcm->recvfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
-            (char*)&mreq, sizeof (mreq)) < 0) {
-        perror ("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
-        goto setup_recv_thread_fail;
-    }
+    // no other thread is trying to create the read thread right now.  claim that task.
+    lcm->creating_read_thread = 1;
+    lcm->create_read_thread_mutex = g_mutex_new();
+    lcm->create_read_thread_cond = g_cond_new();
+    // mark this thread as the one creating the read thread
+    g_static_private_set(&CREATE_READ_THREAD_PKEY, GINT_TO_POINTER(1), NULL);
 
-    lcm->inbufs_empty = lcm_buf_queue_new ();
-    lcm->inbufs_filled = lcm_buf_queue_new ();
-    lcm->ringbuf = lcm_ringbuf_new (LCM_RINGBUF_SIZE);
+    dbg (DBG_LCM, "allocating resources for receiving messages\n");
 
-    int i;
-    for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
-        /* We don't set the receive buffer's data pointer yet because it
-         * will be taken from the ringbuffer at receive time. */
-        lcm_buf_t * lcmb = (lcm_buf_t *) calloc (1, sizeof (lcm_buf_t));
-        lcm_buf_enqueue (lcm->inbufs_empty, lcmb);
+    lcm->num_shards = MAX (1, lcm->params.recv_threads);
+    lcm->shards = (udpm_rx_shard_t *) calloc (lcm->num_shards,
+            sizeof (udpm_rx_shard_t));
+    for (int i = 0; i < lcm->num_shards; i++)
+        _init_recv_shard (lcm, &lcm->shards[i], i);
+    for (int i = 0; i < lcm->num_shards; i++) {
+        if (_setup_recv_shard (lcm, &lcm->shards[i]) < 0)
+            goto setup_recv_thread_fail;
     }
 
+#ifdef USE_XDP
+    if (lcm->params.xdp_ifname)
+        _xdp_init (lcm);
+#endif
+
     // setup a pipe for notifying the reader thread when to quit
     if(0 != lcm_internal_pipe_create(lcm->thread_msg_pipe)) {
         perror(__FILE__ " pipe(setup)");
@@ -1042,27 +4362,40 @@ _setup_recv_parts (lcm_udpm_t *lcm)
     }
     fcntl (lcm->thread_msg_pipe[1], F_SETFL, O_NONBLOCK);
 
-    /* Start the reader thread */
-    lcm->read_thread = g_thread_create (recv_thread, lcm, TRUE, NULL);
-    if (!lcm->read_thread) {
-        fprintf (stderr, "Error: LCM failed to start reader thread\n");
-        goto setup_recv_thread_fail;
-    }
+    /* Start the reader threads */
     lcm->thread_created = 1;
-    g_static_rec_mutex_unlock(&lcm->mutex);
+    for (int i = 0; i < lcm->num_shards; i++) {
+        lcm->shards[i].read_thread = g_thread_create (recv_thread,
+                &lcm->shards[i], TRUE, NULL);
+        if (!lcm->shards[i].read_thread) {
+            fprintf (stderr, "Error: LCM failed to start reader thread\n");
+            goto setup_recv_thread_fail;
+        }
+    }
+    int self_test_results = 0;
+    if (lcm->params.self_test == UDPM_SELF_TEST_ASYNC) {
+        _start_self_test (lcm);
+    } else if (lcm->params.self_test == UDPM_SELF_TEST_SYNC) {
+        g_static_rec_mutex_unlock(&lcm->mutex);
 
-    // conduct a self-test just to make sure everything is working.
-    dbg (DBG_LCM, "LCM: conducting self test\n");
-    int self_test_results = udpm_self_test(lcm);
-    g_static_rec_mutex_lock(&lcm->mutex);
+        // conduct a self-test just to make sure everything is working.
+        dbg (DBG_LCM, "LCM: conducting self test\n");
+        lcm_internal_set_self_test_status (lcm->lcm, LCM_SELF_TEST_PENDING);
+        self_test_results = udpm_self_test(lcm);
+        g_static_rec_mutex_lock(&lcm->mutex);
 
-    if (0 == self_test_results) {
-        dbg (DBG_LCM, "LCM: self test successful\n");
-    } else {
-        // self test failed.  destroy the read thread
-        fprintf (stderr, "LCM self test failed!!\n"
-                "Check your routing tables and firewall settings\n");
-        _destroy_recv_parts (lcm);
+        if (0 == self_test_results) {
+            dbg (DBG_LCM, "LCM: self test successful\n");
+            lcm_internal_set_self_test_status (lcm->lcm,
+                    LCM_SELF_TEST_PASSED);
+        } else {
+            // self test failed.  destroy the read thread
+            fprintf (stderr, "LCM self test failed!!\n"
+                    "Check your routing tables and firewall settings\n");
+            lcm_internal_set_self_test_status (lcm->lcm,
+                    LCM_SELF_TEST_FAILED);
+            _destroy_recv_parts (lcm);
+        }
     }
 
     // notify threads waiting for the read thread to be created
@@ -1080,15 +4413,284 @@ setup_recv_thread_fail:
     return -1;
 }
 
+/* Creates the socket of a transmit lane.  Returns 0 on success. */
+static int
+_setup_tx_lane (lcm_udpm_t *lcm, udpm_tx_lane_t *lane)
+{
+    // don't use connect() on the actual transmit socket, because linux then
+    // has problems multicasting to localhost
+    lane->sendfd = socket (AF_INET, SOCK_DGRAM, 0);
+
+    // set multicast TTL
+    if (lcm->params.mc_ttl == 0) {
+        dbg (DBG_LCM, "LCM multicast TTL set to 0.  Packets will not "
+                "leave localhost\n");
+    }
+    dbg (DBG_LCM, "LCM: setting multicast packet TTL to %d\n",
+            lcm->params.mc_ttl);
+    if (setsockopt (lane->sendfd, IPPROTO_IP, IP_MULTICAST_TTL,
+                (char *) &lcm->params.mc_ttl, sizeof (lcm->params.mc_ttl)) < 0) {
+        perror ("setsockopt(IPPROTO_IP, IP_MULTICAST_TTL)");
+        return -1;
+    }
+
+    // mark the datagrams of qos_channels, so that switches and the queueing
+    // discipline of the interface let them ahead of the others
+    if (lane->qos) {
+        int tos = lcm->params.qos_dscp << 2;
+        dbg (DBG_LCM, "LCM: setting DSCP %d on the QoS socket\n",
+                lcm->params.qos_dscp);
+        if (setsockopt (lane->sendfd, IPPROTO_IP, IP_TOS,
+                    (char *) &tos, sizeof (tos)) < 0) {
+            perror ("setsockopt(IPPROTO_IP, IP_TOS)");
+            return -1;
+        }
+#ifdef SO_PRIORITY
+        int priority = lcm->params.qos_priority;
+        if (setsockopt (lane->sendfd, SOL_SOCKET, SO_PRIORITY,
+                    (char *) &priority, sizeof (priority)) < 0) {
+            perror ("setsockopt(SOL_SOCKET, SO_PRIORITY)");
+            return -1;
+        }
+#endif
+    }
+
+#ifdef WIN32
+    // Windows has small (8k) buffer by default
+    // increase the send buffer to a reasonable amount.
+    int send_buf_size = 256 * 1024;
+    setsockopt(lane->sendfd, SOL_SOCKET, SO_SNDBUF, 
+            (char*)&send_buf_size, sizeof(send_buf_size));
+#endif
+
+    // debugging... how big is the send buffer?
+    int sockbufsize = 0;
+    unsigned int retsize = sizeof(int);
+    getsockopt(lane->sendfd, SOL_SOCKET, SO_SNDBUF, 
+            (char*)&sockbufsize, (socklen_t *) &retsize);
+    dbg (DBG_LCM, "LCM: send buffer is %d bytes\n", sockbufsize);
+
+    // set loopback option on the send socket
+#ifdef __sun__
+    unsigned char send_lo_opt = 1;
+#else
+    unsigned int send_lo_opt = 1;
+#endif
+    if (setsockopt (lane->sendfd, IPPROTO_IP, IP_MULTICAST_LOOP, 
+                (char *) &send_lo_opt, sizeof (send_lo_opt)) < 0) {
+        perror ("setsockopt (IPPROTO_IP, IP_MULTICAST_LOOP)");
+        return -1;
+    }
+
+    // we still need to setup sendfd in multi-cast group
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = lcm->params.mc_addr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    dbg (DBG_LCM, "LCM: joining multicast group\n");
+    if (setsockopt (lane->sendfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+            (char*)&mreq, sizeof (mreq)) < 0) {
+#ifdef WIN32
+      // ignore this error in windows... see issue #60
+#else
+        perror ("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
+        return -1;
+#endif
+    }
+
+    if (lcm->reliable)
+        lane->retained = (udpm_retained_msg_t *) calloc (
+                lcm->params.retransmit_window, sizeof (udpm_retained_msg_t));
+    return 0;
+}
+
+/* Publishes the channel patterns subscribed to on the interest channel. */
+static void
+_announce_interest (lcm_udpm_t *lcm)
+{
+    GPtrArray *patterns = g_ptr_array_new ();
+    g_static_rec_mutex_lock (&lcm->mutex);
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init (&iter, lcm->subscriptions);
+    while (g_hash_table_iter_next (&iter, &key, NULL))
+        if (strcmp ((const char *) key, SELF_TEST_CHANNEL))
+            g_ptr_array_add (patterns, key);
+    int size;
+    void *buf = lcm_interest_encode (lcm->node_id, lcm->params.announce_ms,
+            patterns, &size);
+    g_static_rec_mutex_unlock (&lcm->mutex);
+    g_ptr_array_free (patterns, TRUE);
+
+    if (lcm_udpm_publish (lcm, LCM_INTEREST_CHANNEL, buf, size) < 0)
+        dbg (DBG_LCM, "could not announce the subscriptions\n");
+    free (buf);
+}
+
+/* Announces the subscriptions every announce_ms, and forgets the instances
+ * that stopped announcing theirs. */
+static void *
+_interest_thread (void *user)
+{
+#ifdef G_OS_UNIX
+    // Mask out all signals on this thread.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_SETMASK, &mask, NULL);
+#endif
+
+    lcm_udpm_t *lcm = (lcm_udpm_t *) user;
+    lcm_internal_thread_init ("udpm-interest", NULL, NULL);
+    int64_t next_announce = 0;
+    while (1) {
+        int64_t now = lcm_clock_monotonic_us ();
+        if (now >= next_announce) {
+            _announce_interest (lcm);
+            lcm_interest_table_expire (lcm->interest, now);
+            next_announce = now + (int64_t) lcm->params.announce_ms * 1000;
+        }
+
+        fd_set fds;
+        FD_ZERO (&fds);
+        FD_SET (lcm->interest_pipe[0], &fds);
+        int64_t timeout = next_announce - now;
+        struct timeval tv = { timeout / 1000000, timeout % 1000000 };
+        int status = select (lcm->interest_pipe[0] + 1, &fds, NULL, NULL, &tv);
+        if (status < 0) {
+            if (errno != EINTR)
+                perror ("interest thread -- select");
+            continue;
+        }
+        if (status > 0) {
+            char cmd;
+            if (lcm_internal_pipe_read (lcm->interest_pipe[0], &cmd, 1) != 1 ||
+                    cmd == 'x')
+                break;
+            g_atomic_int_set (&lcm->announce_pending, 0);
+            next_announce = 0;
+        }
+    }
+    return NULL;
+}
+
+/* Collects the addresses of this host for the ignore_local option.  The self
+ * test, which receives the instance's own datagram, cannot pass with it and is
+ * turned off.  Returns -1 on failure. */
+static int
+_find_local_addrs (lcm_udpm_t *lcm)
+{
+    lcm->params.self_test = UDPM_SELF_TEST_OFF;
+#ifdef WIN32
+    fprintf (stderr, "LCM Error: ignore_local is not supported on Windows\n");
+    return -1;
+#else
+    struct ifaddrs *ifaddr;
+    if (getifaddrs (&ifaddr) < 0) {
+        perror ("getifaddrs");
+        return -1;
+    }
+    int n = 0;
+    for (struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next)
+        if (ifa->ifa_addr && ifa->ifa_addr->sa_family == AF_INET)
+            n++;
+    lcm->local_addrs = (struct in_addr *) calloc (MAX (n, 1),
+            sizeof (struct in_addr));
+    for (struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+            continue;
+        lcm->local_addrs[lcm->num_local_addrs++] =
+            ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr;
+        dbg (DBG_LCM, "ignoring datagrams from %s\n", inet_ntoa (
+                    ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr));
+    }
+    freeifaddrs (ifaddr);
+    if (!lcm->num_local_addrs) {
+        fprintf (stderr, "LCM Error: this host has no IPv4 address to "
+                "ignore\n");
+        return -1;
+    }
+    return 0;
+#endif
+}
+
+/* Looks up the network interfaces of the interfaces option, each given by its
+ * name or one of its IPv4 addresses.  Returns -1 on failure. */
+static int
+_find_interfaces (lcm_udpm_t *lcm)
+{
+#ifndef USE_MULTI_IFACE
+    fprintf (stderr, "LCM Error: interfaces is not supported on this "
+            "platform\n");
+    return -1;
+#else
+    struct ifaddrs *ifaddr;
+    if (getifaddrs (&ifaddr) < 0) {
+        perror ("getifaddrs");
+        return -1;
+    }
+    gchar **names = g_strsplit (lcm->params.ifaces, ",", 0);
+    lcm->ifaces = (udpm_iface_t *) calloc (MAX (g_strv_length (names), 1),
+            sizeof (udpm_iface_t));
+    int status = 0;
+    for (int i = 0; names[i]; i++) {
+        struct in_addr addr;
+        int by_addr = inet_aton (names[i], &addr);
+        struct ifaddrs *ifa;
+        for (ifa = ifaddr; ifa; ifa = ifa->ifa_next) {
+            if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET)
+                continue;
+            struct in_addr ifa_addr =
+                ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr;
+            if (by_addr ? ifa_addr.s_addr == addr.s_addr :
+                    !strcmp (ifa->ifa_name, names[i]))
+                break;
+        }
+        if (!ifa) {
+            fprintf (stderr, "LCM Error: no network interface with an IPv4 "
+                    "address is called [%s]\n", names[i]);
+            status = -1;
+            break;
+        }
+        udpm_iface_t *iface = &lcm->ifaces[lcm->num_ifaces++];
+        iface->addr = ((struct sockaddr_in *) ifa->ifa_addr)->sin_addr;
+        iface->index = if_nametoindex (ifa->ifa_name);
+        dbg (DBG_LCM, "using interface %s, %s\n", ifa->ifa_name,
+                inet_ntoa (iface->addr));
+    }
+    g_strfreev (names);
+    freeifaddrs (ifaddr);
+    if (!status && !lcm->num_ifaces) {
+        fprintf (stderr, "LCM Error: interfaces lists no interface\n");
+        status = -1;
+    }
+    return status;
+#endif
+}
+
 lcm_provider_t * 
 lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 {
     udpm_params_t params;
     memset (&params, 0, sizeof (udpm_params_t));
+    params.recv_pool_size = LCM_DEFAULT_RECV_POOL_SIZE;
+    params.max_frag_msgs = MAX_NUM_FRAG_BUFS;
+    params.frag_timeout_ms = FRAG_BUF_MAX_AGE_USEC / 1000;
+    params.channel_filter = 1;
+    params.retransmit_window = LCM_DEFAULT_RETRANSMIT_WINDOW;
+    params.compress_min = LCM_DEFAULT_COMPRESS_MIN;
+    params.qos_dscp = LCM_DEFAULT_QOS_DSCP;
+    params.qos_priority = LCM_DEFAULT_QOS_PRIORITY;
+    params.announce_ms = LCM_INTEREST_DEFAULT_INTERVAL_MS;
+#ifdef USE_IOCP
+    params.iocp = 1;
+#endif
 
     g_hash_table_foreach ((GHashTable*) args, new_argument, &params);
 
     if (parse_mc_addr_and_port (network, &params) < 0) {
+        free (params.rx_cpu);
+        free (params.rx_sched);
+        free (params.xdp_ifname);
+        free (params.ifaces);
         return NULL;
     }
 
@@ -1096,15 +4698,50 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
 
     lcm->lcm = parent;
     lcm->params = params;
-    lcm->recvfd = -1;
-    lcm->sendfd = -1;
+    lcm_pacer_init (&lcm->pacer, params.max_rate_mbps, params.burst_kb);
     lcm->thread_msg_pipe[0] = lcm->thread_msg_pipe[1] = -1;
-    lcm->udp_low_watermark = 1.0;
+    lcm->subscriptions = g_hash_table_new_full (g_str_hash, g_str_equal,
+            free, NULL);
+    lcm->nack_pipe[0] = lcm->nack_pipe[1] = -1;
+    lcm->interest_pipe[0] = lcm->interest_pipe[1] = -1;
+#ifndef USE_IO_URING
+    if (params.io_uring)
+        fprintf (stderr, "LCM: built without io_uring support, using the "
+                "default receive path\n");
+#endif
+#ifndef USE_IOCP
+    if (params.iocp)
+        fprintf (stderr, "LCM: I/O completion ports are only used on "
+                "Windows, using the default receive path\n");
+#endif
+#ifndef USE_XDP
+    if (params.xdp_ifname)
+        fprintf (stderr, "LCM: built without AF_XDP support, using the "
+                "default receive path\n");
+#else
+    // the AF_XDP socket is read alongside recvfd by the recvmmsg loop
+    if (params.xdp_ifname && params.io_uring) {
+        fprintf (stderr, "LCM: io=uring is not used with xdp\n");
+        lcm->params.io_uring = 0;
+    }
+#endif
+
+    if (params.ignore_local && _find_local_addrs (lcm) < 0) {
+        lcm_udpm_destroy (lcm);
+        return NULL;
+    }
 
-    lcm->kernel_rbuf_sz = 0;
-    lcm->warned_about_small_kernel_buf = 0;
+    if (params.ifaces && _find_interfaces (lcm) < 0) {
+        lcm_udpm_destroy (lcm);
+        return NULL;
+    }
 
-    lcm->frag_bufs = NULL;
+    // gaps in the sequence numbers are only NACKed if all of the messages
+    // reach the process, so that they are real losses
+    if (params.nack && params.channel_filter) {
+        dbg (DBG_LCM, "nack disables the channel filter\n");
+        lcm->params.channel_filter = 0;
+    }
 
     // synchronization variables used when allocating receive resources
     lcm->creating_read_thread = 0;
@@ -1112,15 +4749,14 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     lcm->create_read_thread_cond = NULL;
 
     // internal notification pipe
-    if(0 != lcm_internal_pipe_create(lcm->notify_pipe)) {
+    if(0 != lcm_internal_notify_create(lcm->notify_pipe)) {
         perror(__FILE__ " pipe(create)");
         lcm_udpm_destroy (lcm);
         return NULL;
     }
-    fcntl (lcm->notify_pipe[1], F_SETFL, O_NONBLOCK);
 
     g_static_rec_mutex_init (&lcm->mutex);
-    g_static_mutex_init (&lcm->transmit_lock);
+    g_static_mutex_init (&lcm->pacer_lock);
 
     dbg (DBG_LCM, "Initializing LCM UDPM context...\n");
     dbg (DBG_LCM, "Multicast %s:%d\n", inet_ntoa(params.mc_addr), ntohs (params.mc_port));
@@ -1145,75 +4781,145 @@ lcm_udpm_create (lcm_t * parent, const char *network, const GHashTable *args)
     }
     lcm_close_socket(testfd);
 
-    // create a transmit socket
-    //
-    // don't use connect() on the actual transmit socket, because linux then
-    // has problems multicasting to localhost
-    lcm->sendfd = socket (AF_INET, SOCK_DGRAM, 0);
-
-    // set multicast TTL
-    if (params.mc_ttl == 0) {
-        dbg (DBG_LCM, "LCM multicast TTL set to 0.  Packets will not "
-                "leave localhost\n");
+    if (params.reliable) {
+        GError *err = NULL;
+        lcm->reliable = lcm_channel_pattern_new (params.reliable, &err);
+        if (!lcm->reliable) {
+            fprintf (stderr, "LCM Error: bad reliable channel pattern [%s]: %s\n",
+                    params.reliable, err->message);
+            g_error_free (err);
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
     }
-    dbg (DBG_LCM, "LCM: setting multicast packet TTL to %d\n", params.mc_ttl);
-    if (setsockopt (lcm->sendfd, IPPROTO_IP, IP_MULTICAST_TTL,
-                (char *) &params.mc_ttl, sizeof (params.mc_ttl)) < 0) {
-        perror ("setsockopt(IPPROTO_IP, IP_MULTICAST_TTL)");
-        lcm_udpm_destroy (lcm);
-        return NULL;
+    lcm->params.reliable = NULL;
+
+    if (params.compress && params.compress_channels) {
+        GError *err = NULL;
+        lcm->compress_channels = lcm_channel_pattern_new (
+                params.compress_channels, &err);
+        if (!lcm->compress_channels) {
+            fprintf (stderr, "LCM Error: bad compress_channels pattern [%s]: "
+                    "%s\n", params.compress_channels, err->message);
+            g_error_free (err);
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+    }
+    lcm->params.compress_channels = NULL;
+
+    if (params.qos_channels) {
+        GError *err = NULL;
+        lcm->qos_channels = lcm_channel_pattern_new (params.qos_channels,
+                &err);
+        if (!lcm->qos_channels) {
+            fprintf (stderr, "LCM Error: bad qos_channels pattern [%s]: %s\n",
+                    params.qos_channels, err->message);
+            g_error_free (err);
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+    }
+    lcm->params.qos_channels = NULL;
+
+    // create the transmit sockets
+    lcm->num_thread_lanes = MAX (1, params.tx_sockets);
+    lcm->num_tx_lanes = lcm->num_thread_lanes + (lcm->qos_channels ? 1 : 0);
+    lcm->tx_lanes = (udpm_tx_lane_t *) calloc (lcm->num_tx_lanes,
+            sizeof (udpm_tx_lane_t));
+    for (int i = 0; i < lcm->num_tx_lanes; i++) {
+        lcm->tx_lanes[i].qos = i >= lcm->num_thread_lanes;
+        lcm->tx_lanes[i].sendfd = -1;
+        g_static_mutex_init (&lcm->tx_lanes[i].lock);
+        lcm->tx_lanes[i].faults = lcm_fault_injector_new (&params.faults, i);
+    }
+    for (int i = 0; i < lcm->num_tx_lanes; i++) {
+        if (_setup_tx_lane (lcm, &lcm->tx_lanes[i]) < 0) {
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
     }
 
-#ifdef WIN32
-    // Windows has small (8k) buffer by default
-    // increase the send buffer to a reasonable amount.
-    int send_buf_size = 256 * 1024;
-    setsockopt(lcm->sendfd, SOL_SOCKET, SO_SNDBUF, 
-            (char*)&send_buf_size, sizeof(send_buf_size));
-#endif
-
-    // debugging... how big is the send buffer?
-    int sockbufsize = 0;
-    unsigned int retsize = sizeof(int);
-    getsockopt(lcm->sendfd, SOL_SOCKET, SO_SNDBUF, 
-            (char*)&sockbufsize, (socklen_t *) &retsize);
-    dbg (DBG_LCM, "LCM: send buffer is %d bytes\n", sockbufsize);
-
-    // set loopback option on the send socket
-#ifdef __sun__
-    unsigned char send_lo_opt = 1;
-#else
-    unsigned int send_lo_opt = 1;
-#endif
-    if (setsockopt (lcm->sendfd, IPPROTO_IP, IP_MULTICAST_LOOP, 
-                (char *) &send_lo_opt, sizeof (send_lo_opt)) < 0) {
-        perror ("setsockopt (IPPROTO_IP, IP_MULTICAST_LOOP)");
-        lcm_udpm_destroy (lcm);
-        return NULL;
+    // small messages share datagrams of at most one MTU
+    if (params.batch_us > 0) {
+        int mtu = params.mtu ? params.mtu : LCM_BATCH_DEFAULT_MTU;
+        lcm->batch_size = MIN (mtu - LCM_IP_UDP_HEADER_SIZE,
+                (int) (LCM_SHORT_MESSAGE_MAX_SIZE +
+                    sizeof (lcm2_header_short_t)));
+        // a message that fills more than half of a batch gains little
+        lcm->batch_max_record = (lcm->batch_size - sizeof (uint32_t)) / 2;
+        uint32_t magic = htonl (LCM2_MAGIC_BATCH);
+        // the messages of qos_channels don't wait
+        for (int i = 0; i < lcm->num_thread_lanes; i++) {
+            udpm_tx_lane_t *lane = &lcm->tx_lanes[i];
+            lane->batch = (char *) malloc (lcm->batch_size);
+            memcpy (lane->batch, &magic, sizeof (magic));
+            lane->batch_len = sizeof (magic);
+        }
+        lcm->batch_mutex = g_mutex_new ();
+        lcm->batch_cond = g_cond_new ();
+        lcm->batch_thread = g_thread_create (_batch_thread, lcm, TRUE, NULL);
+        if (!lcm->batch_thread) {
+            fprintf (stderr, "Error: LCM failed to start the batch thread\n");
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
     }
 
     // don't start the receive thread yet.  Only allocate resources for
     // receiving messages when a subscription is made.
 
-    // However, we still need to setup sendfd in multi-cast group
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr = lcm->params.mc_addr;
-    mreq.imr_interface.s_addr = INADDR_ANY;
-    dbg (DBG_LCM, "LCM: joining multicast group\n");
-    if (setsockopt (lcm->sendfd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
-            (char*)&mreq, sizeof (mreq)) < 0) {
-#ifdef WIN32
-      // ignore this error in windows... see issue #60
-#else
-        perror ("setsockopt (IPPROTO_IP, IP_ADD_MEMBERSHIP)");
-        lcm_udpm_destroy (lcm);
-        return NULL;
-#endif
+    // receivers send their NACKs to the transmit sockets
+    if (lcm->reliable) {
+        if (0 != lcm_internal_pipe_create (lcm->nack_pipe)) {
+            perror (__FILE__ " pipe(nack)");
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+        lcm->nack_thread = g_thread_create (_nack_thread, lcm, TRUE, NULL);
+        if (!lcm->nack_thread) {
+            fprintf (stderr, "Error: LCM failed to start the NACK thread\n");
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+    }
+
+    // the announcements of the others are heard whether or not this
+    // instance subscribes to anything
+    if (params.interest) {
+        lcm->node_id = lcm_interest_new_node_id ();
+        lcm->interest = lcm_interest_table_new (lcm->node_id);
+        if (0 != lcm_internal_pipe_create (lcm->interest_pipe)) {
+            perror (__FILE__ " pipe(interest)");
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+        if (_setup_recv_parts (lcm) < 0) {
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
+        lcm->interest_thread = g_thread_create (_interest_thread, lcm, TRUE,
+                NULL);
+        if (!lcm->interest_thread) {
+            fprintf (stderr, "Error: LCM failed to start the interest "
+                    "thread\n");
+            lcm_udpm_destroy (lcm);
+            return NULL;
+        }
     }
 
     return lcm;
 }
 
+static int
+lcm_udpm_has_subscribers (lcm_udpm_t *lcm, const char *channel)
+{
+    if (!lcm->interest)
+        return -1;
+    return lcm_interest_table_has_subscribers (lcm->interest, channel,
+            lcm->params.announce_ms);
+}
+
 #ifdef WIN32
 static lcm_provider_vtable_t udpm_vtable;
 #else
@@ -1221,10 +4927,17 @@ static lcm_provider_vtable_t udpm_vtable = {
     .create      = lcm_udpm_create,
     .destroy     = lcm_udpm_destroy,
     .subscribe   = lcm_udpm_subscribe,
-    .unsubscribe = NULL,
+    .unsubscribe = lcm_udpm_unsubscribe,
     .publish     = lcm_udpm_publish,
     .handle      = lcm_udpm_handle,
     .get_fileno  = lcm_udpm_get_fileno,
+    .handle_batch = lcm_udpm_handle_batch,
+    .get_stats   = lcm_udpm_get_stats,
+    .busy_wait   = lcm_udpm_busy_wait,
+    .publish_stream_begin = lcm_udpm_publish_stream_begin,
+    .publish_stream_write = lcm_udpm_publish_stream_write,
+    .publish_stream_end = lcm_udpm_publish_stream_end,
+    .has_subscribers = lcm_udpm_has_subscribers
 };
 #endif
 
@@ -1239,10 +4952,17 @@ lcm_udpm_provider_init (GPtrArray * providers)
     udpm_vtable.create      = lcm_udpm_create;
     udpm_vtable.destroy     = lcm_udpm_destroy;
     udpm_vtable.subscribe   = lcm_udpm_subscribe;
-    udpm_vtable.unsubscribe = NULL;
+    udpm_vtable.unsubscribe = lcm_udpm_unsubscribe;
     udpm_vtable.publish     = lcm_udpm_publish;
     udpm_vtable.handle      = lcm_udpm_handle;
     udpm_vtable.get_fileno  = lcm_udpm_get_fileno;
+    udpm_vtable.handle_batch = lcm_udpm_handle_batch;
+    udpm_vtable.get_stats   = lcm_udpm_get_stats;
+    udpm_vtable.busy_wait   = lcm_udpm_busy_wait;
+    udpm_vtable.publish_stream_begin = lcm_udpm_publish_stream_begin;
+    udpm_vtable.publish_stream_write = lcm_udpm_publish_stream_write;
+    udpm_vtable.publish_stream_end = lcm_udpm_publish_stream_end;
+    udpm_vtable.has_subscribers = lcm_udpm_has_subscribers;
 #endif
     udpm_info.name = "udpm";
     udpm_info.vtable = &udpm_vtable;
@@ -0,0 +1,252 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#include <string.h>
+#include "lcm_interest_t.h"
+
+static int __lcm_interest_t_hash_computed;
+static uint64_t __lcm_interest_t_hash;
+
+uint64_t __lcm_interest_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    const __lcm_hash_ptr *fp;
+    for (fp = p; fp != NULL; fp = fp->parent)
+        if (fp->v == __lcm_interest_t_get_hash)
+            return 0;
+
+    __lcm_hash_ptr cp;
+    cp.parent =  p;
+    cp.v = __lcm_interest_t_get_hash;
+    (void) cp;
+
+    uint64_t hash = (uint64_t)0xbd08f8f75f433fceLL
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __string_hash_recursive(&cp)
+        ;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+int64_t __lcm_interest_t_get_hash(void)
+{
+    if (!__lcm_interest_t_hash_computed) {
+        __lcm_interest_t_hash = (int64_t)__lcm_interest_t_hash_recursive(NULL);
+        __lcm_interest_t_hash_computed = 1;
+    }
+
+    return __lcm_interest_t_hash;
+}
+
+int __lcm_interest_t_encode_array(void *buf, int offset, int maxlen, const lcm_interest_t *p, int elements)
+{
+    int pos = 0, element;
+    int thislen;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].node_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].interval_ms), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_patterns), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_encode_array(buf, offset + pos, maxlen - pos, p[element].patterns, p[element].num_patterns);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int lcm_interest_t_encode(void *buf, int offset, int maxlen, const lcm_interest_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_interest_t_get_hash();
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __lcm_interest_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_interest_t_encoded_array_size(const lcm_interest_t *p, int elements)
+{
+    int size = 0, element;
+    for (element = 0; element < elements; element++) {
+
+        size += __int64_t_encoded_array_size(&(p[element].utime), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].node_id), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].interval_ms), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].num_patterns), 1);
+
+        size += __string_encoded_array_size(p[element].patterns, p[element].num_patterns);
+
+    }
+    return size;
+}
+
+int lcm_interest_t_encoded_size(const lcm_interest_t *p)
+{
+    return 8 + __lcm_interest_t_encoded_array_size(p, 1);
+}
+
+int __lcm_interest_t_decode_array(const void *buf, int offset, int maxlen, lcm_interest_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].node_id), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].interval_ms), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_patterns), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].patterns = (char**) lcm_malloc(sizeof(char*) * p[element].num_patterns);
+        thislen = __string_decode_array(buf, offset + pos, maxlen - pos, p[element].patterns, p[element].num_patterns);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int __lcm_interest_t_decode_array_cleanup(lcm_interest_t *p, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_decode_array_cleanup(&(p[element].utime), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].node_id), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].interval_ms), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].num_patterns), 1);
+
+        if (p[element].patterns) {
+            __string_decode_array_cleanup(p[element].patterns, p[element].num_patterns);
+            if (p[element].patterns) free(p[element].patterns);
+        }
+
+    }
+    return 0;
+}
+
+int lcm_interest_t_decode(const void *buf, int offset, int maxlen, lcm_interest_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_interest_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_interest_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int lcm_interest_t_decode_cleanup(lcm_interest_t *p)
+{
+    return __lcm_interest_t_decode_array_cleanup(p, 1);
+}
+
+int __lcm_interest_t_decode_array_arena(const void *buf, int offset, int maxlen, lcm_interest_t *p, int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].utime), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].node_id), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].interval_ms), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_patterns), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        p[element].patterns = (char**) lcm_arena_alloc(arena, sizeof(char*) * p[element].num_patterns);
+        thislen = __string_decode_array_arena(buf, offset + pos, maxlen - pos, p[element].patterns, p[element].num_patterns, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int lcm_interest_t_decode_arena(const void *buf, int offset, int maxlen, lcm_interest_t *p, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_interest_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_interest_t_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_interest_t_clone_array(const lcm_interest_t *p, lcm_interest_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_clone_array(&(p[element].utime), &(q[element].utime), 1);
+
+        __int64_t_clone_array(&(p[element].node_id), &(q[element].node_id), 1);
+
+        __int32_t_clone_array(&(p[element].interval_ms), &(q[element].interval_ms), 1);
+
+        __int32_t_clone_array(&(p[element].num_patterns), &(q[element].num_patterns), 1);
+
+        q[element].patterns = (char**) lcm_malloc(sizeof(char*) * q[element].num_patterns);
+        __string_clone_array(p[element].patterns, q[element].patterns, p[element].num_patterns);
+
+    }
+    return 0;
+}
+
+lcm_interest_t *lcm_interest_t_copy(const lcm_interest_t *p)
+{
+    lcm_interest_t *q = (lcm_interest_t*) malloc(sizeof(lcm_interest_t));
+    __lcm_interest_t_clone_array(p, q, 1);
+    return q;
+}
+
+void lcm_interest_t_destroy(lcm_interest_t *p)
+{
+    __lcm_interest_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
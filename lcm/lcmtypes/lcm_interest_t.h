@@ -0,0 +1,118 @@
+/**
+ * Generated by running lcm-gen -c --c-no-pubsub lcm_interest.lcm
+ *
+ * and then modified by hand to replace
+ * #include <lcm/lcm_coretypes.h>
+ * with
+ * #include "../lcm_coretypes.h"
+ **/
+
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#ifndef _lcm_interest_t_h
+#define _lcm_interest_t_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "../lcm_coretypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sent every interval_ms milliseconds, and whenever the subscriptions change.
+ * Receivers forget the patterns of an instance that stays silent for three
+ * intervals.
+ */
+typedef struct _lcm_interest_t lcm_interest_t;
+struct _lcm_interest_t
+{
+    int64_t    utime;
+    int64_t    node_id;
+    int32_t    interval_ms;
+    int32_t    num_patterns;
+    char*      *patterns;
+};
+
+/**
+ * Create a deep copy of a lcm_interest_t.
+ * When no longer needed, destroy it with lcm_interest_t_destroy()
+ */
+lcm_interest_t* lcm_interest_t_copy(const lcm_interest_t* to_copy);
+
+/**
+ * Destroy an instance of lcm_interest_t created by lcm_interest_t_copy()
+ */
+void lcm_interest_t_destroy(lcm_interest_t* to_destroy);
+
+/**
+ * Encode a message of type lcm_interest_t into binary form.
+ *
+ * @param buf The output buffer.
+ * @param offset Encoding starts at this byte offset into @p buf.
+ * @param maxlen Maximum number of bytes to write.  This should generally
+ *               be equal to lcm_interest_t_encoded_size().
+ * @param msg The message to encode.
+ * @return The number of bytes encoded, or <0 if an error occured.
+ */
+int lcm_interest_t_encode(void *buf, int offset, int maxlen, const lcm_interest_t *p);
+
+/**
+ * Decode a message of type lcm_interest_t from binary form.
+ * When decoding messages containing strings or variable-length arrays, this
+ * function may allocate memory.  When finished with the decoded message,
+ * release allocated resources with lcm_interest_t_decode_cleanup().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+int lcm_interest_t_decode(const void *buf, int offset, int maxlen, lcm_interest_t *msg);
+
+/**
+ * Release resources allocated by lcm_interest_t_decode()
+ * @return 0
+ */
+int lcm_interest_t_decode_cleanup(lcm_interest_t *p);
+
+/**
+ * Decode a message of type lcm_interest_t from binary form, like lcm_interest_t_decode(),
+ * but allocate the strings and variable-length arrays of the message from
+ * @p arena.  Do not call lcm_interest_t_decode_cleanup() on the message; its memory is
+ * released with lcm_arena_reset() or lcm_arena_free().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @param arena The arena to allocate from.
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+int lcm_interest_t_decode_arena(const void *buf, int offset, int maxlen, lcm_interest_t *msg, lcm_arena_t *arena);
+
+/**
+ * Check how many bytes are required to encode a message of type lcm_interest_t
+ */
+int lcm_interest_t_encoded_size(const lcm_interest_t *p);
+
+// LCM support functions. Users should not call these
+int64_t __lcm_interest_t_get_hash(void);
+uint64_t __lcm_interest_t_hash_recursive(const __lcm_hash_ptr *p);
+int __lcm_interest_t_encode_array(void *buf, int offset, int maxlen, const lcm_interest_t *p, int elements);
+int __lcm_interest_t_decode_array(const void *buf, int offset, int maxlen, lcm_interest_t *p, int elements);
+int __lcm_interest_t_decode_array_cleanup(lcm_interest_t *p, int elements);
+int __lcm_interest_t_decode_array_arena(const void *buf, int offset, int maxlen, lcm_interest_t *p, int elements, lcm_arena_t *arena);
+int __lcm_interest_t_encoded_array_size(const lcm_interest_t *p, int elements);
+int __lcm_interest_t_clone_array(const lcm_interest_t *p, lcm_interest_t *q, int elements);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
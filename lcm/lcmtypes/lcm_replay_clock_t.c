@@ -0,0 +1,171 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#include <string.h>
+#include "lcm_replay_clock_t.h"
+
+uint64_t __lcm_replay_clock_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    (void) p;
+    return (uint64_t) LCM_REPLAY_CLOCK_T_FINGERPRINT;
+}
+
+int64_t __lcm_replay_clock_t_get_hash(void)
+{
+    return LCM_REPLAY_CLOCK_T_FINGERPRINT;
+}
+
+int __lcm_replay_clock_t_encode_array(void *buf, int offset, int maxlen, const lcm_replay_clock_t *p, int elements)
+{
+    int pos = 0, element;
+
+    if ((int64_t) elements * 16 > maxlen) return -1;
+
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_encode_array(buf, offset + pos, 8, &(p[element].utime), 1);
+        pos += 8;
+
+        __int64_t_encode_array(buf, offset + pos, 8, &(p[element].seq), 1);
+        pos += 8;
+
+    }
+    return pos;
+}
+
+int lcm_replay_clock_t_encode(void *buf, int offset, int maxlen, const lcm_replay_clock_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_replay_clock_t_get_hash();
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __lcm_replay_clock_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_replay_clock_t_encoded_array_size(const lcm_replay_clock_t *p, int elements)
+{
+    (void) p;
+    return elements * 16;
+}
+
+int lcm_replay_clock_t_encoded_size(const lcm_replay_clock_t *p)
+{
+    (void) p;
+    return LCM_REPLAY_CLOCK_T_ENCODED_SIZE;
+}
+
+int __lcm_replay_clock_t_decode_array(const void *buf, int offset, int maxlen, lcm_replay_clock_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].seq), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int __lcm_replay_clock_t_decode_array_cleanup(lcm_replay_clock_t *p, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_decode_array_cleanup(&(p[element].utime), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].seq), 1);
+
+    }
+    return 0;
+}
+
+int lcm_replay_clock_t_decode(const void *buf, int offset, int maxlen, lcm_replay_clock_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_replay_clock_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_replay_clock_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int lcm_replay_clock_t_decode_cleanup(lcm_replay_clock_t *p)
+{
+    return __lcm_replay_clock_t_decode_array_cleanup(p, 1);
+}
+
+int __lcm_replay_clock_t_decode_array_arena(const void *buf, int offset, int maxlen, lcm_replay_clock_t *p, int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].utime), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].seq), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int lcm_replay_clock_t_decode_arena(const void *buf, int offset, int maxlen, lcm_replay_clock_t *p, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_replay_clock_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_replay_clock_t_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_replay_clock_t_clone_array(const lcm_replay_clock_t *p, lcm_replay_clock_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_clone_array(&(p[element].utime), &(q[element].utime), 1);
+
+        __int64_t_clone_array(&(p[element].seq), &(q[element].seq), 1);
+
+    }
+    return 0;
+}
+
+lcm_replay_clock_t *lcm_replay_clock_t_copy(const lcm_replay_clock_t *p)
+{
+    lcm_replay_clock_t *q = (lcm_replay_clock_t*) malloc(sizeof(lcm_replay_clock_t));
+    __lcm_replay_clock_t_clone_array(p, q, 1);
+    return q;
+}
+
+void lcm_replay_clock_t_destroy(lcm_replay_clock_t *p)
+{
+    __lcm_replay_clock_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
@@ -0,0 +1,694 @@
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#include <string.h>
+#include "lcm_stats_report_t.h"
+
+static int __lcm_stats_report_t_hash_computed;
+static uint64_t __lcm_stats_report_t_hash;
+
+uint64_t __lcm_stats_report_t_hash_recursive(const __lcm_hash_ptr *p)
+{
+    const __lcm_hash_ptr *fp;
+    for (fp = p; fp != NULL; fp = fp->parent)
+        if (fp->v == __lcm_stats_report_t_get_hash)
+            return 0;
+
+    __lcm_hash_ptr cp;
+    cp.parent =  p;
+    cp.v = __lcm_stats_report_t_get_hash;
+    (void) cp;
+
+    uint64_t hash = (uint64_t)0xfedda8d6dd2cb539LL
+         + __int64_t_hash_recursive(&cp)
+         + __string_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __boolean_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __double_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __boolean_hash_recursive(&cp)
+         + __int32_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+         + __int64_t_hash_recursive(&cp)
+        ;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+int64_t __lcm_stats_report_t_get_hash(void)
+{
+    if (!__lcm_stats_report_t_hash_computed) {
+        __lcm_stats_report_t_hash = (int64_t)__lcm_stats_report_t_hash_recursive(NULL);
+        __lcm_stats_report_t_hash_computed = 1;
+    }
+
+    return __lcm_stats_report_t_hash;
+}
+
+int __lcm_stats_report_t_encode_array(void *buf, int offset, int maxlen, const lcm_stats_report_t *p, int elements)
+{
+    int pos = 0, element;
+    int thislen;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_encode_array(buf, offset + pos, maxlen - pos, &(p[element].host), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].pid), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_published), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_published), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_publish_failed), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_queue_full), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_queued), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_wakeups), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_encode_array(buf, offset + pos, maxlen - pos, &(p[element].has_transport_stats), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_packets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_bad_packets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_lost), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_reordered), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_duplicated), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_incomplete), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_no_buffer), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_fec_recovered), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_nacked), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_retransmitted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].num_senders), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __double_encode_array(buf, offset + pos, maxlen - pos, &(p[element].ring_low_watermark), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].frag_bytes_high_watermark), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_encode_array(buf, offset + pos, maxlen - pos, &(p[element].has_publish_queue_stats), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_queued), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_queued_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_max_queued_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_transmitted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_failed), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_dropped), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int lcm_stats_report_t_encode(void *buf, int offset, int maxlen, const lcm_stats_report_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_stats_report_t_get_hash();
+
+    thislen = __int64_t_encode_array(buf, offset + pos, maxlen - pos, &hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    thislen = __lcm_stats_report_t_encode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_stats_report_t_encoded_array_size(const lcm_stats_report_t *p, int elements)
+{
+    int size = 0, element;
+    for (element = 0; element < elements; element++) {
+
+        size += __int64_t_encoded_array_size(&(p[element].utime), 1);
+
+        size += __string_encoded_array_size(&(p[element].host), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].pid), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_published), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].bytes_published), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_publish_failed), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_received), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].bytes_received), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_dropped_queue_full), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].num_queued), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_wakeups), 1);
+
+        size += __boolean_encoded_array_size(&(p[element].has_transport_stats), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_packets), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_bytes), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_bad_packets), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_lost), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_reordered), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_duplicated), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_incomplete), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_dropped_no_buffer), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_fec_recovered), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_nacked), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].num_retransmitted), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].num_senders), 1);
+
+        size += __double_encoded_array_size(&(p[element].ring_low_watermark), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].frag_bytes_high_watermark), 1);
+
+        size += __boolean_encoded_array_size(&(p[element].has_publish_queue_stats), 1);
+
+        size += __int32_t_encoded_array_size(&(p[element].tx_num_queued), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].tx_queued_bytes), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].tx_max_queued_bytes), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].tx_num_transmitted), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].tx_num_failed), 1);
+
+        size += __int64_t_encoded_array_size(&(p[element].tx_num_dropped), 1);
+
+    }
+    return size;
+}
+
+int lcm_stats_report_t_encoded_size(const lcm_stats_report_t *p)
+{
+    return 8 + __lcm_stats_report_t_encoded_array_size(p, 1);
+}
+
+int __lcm_stats_report_t_decode_array(const void *buf, int offset, int maxlen, lcm_stats_report_t *p, int elements)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].utime), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_decode_array(buf, offset + pos, maxlen - pos, &(p[element].host), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].pid), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_published), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_published), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_publish_failed), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_queue_full), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_queued), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_wakeups), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_decode_array(buf, offset + pos, maxlen - pos, &(p[element].has_transport_stats), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_packets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_bad_packets), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_lost), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_reordered), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_duplicated), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_incomplete), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_no_buffer), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_fec_recovered), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_nacked), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_retransmitted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].num_senders), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __double_decode_array(buf, offset + pos, maxlen - pos, &(p[element].ring_low_watermark), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].frag_bytes_high_watermark), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_decode_array(buf, offset + pos, maxlen - pos, &(p[element].has_publish_queue_stats), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_queued), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_queued_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_max_queued_bytes), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_transmitted), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_failed), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &(p[element].tx_num_dropped), 1);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int __lcm_stats_report_t_decode_array_cleanup(lcm_stats_report_t *p, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_decode_array_cleanup(&(p[element].utime), 1);
+
+        __string_decode_array_cleanup(&(p[element].host), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].pid), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_published), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].bytes_published), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_publish_failed), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_received), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].bytes_received), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_dropped_queue_full), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].num_queued), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_wakeups), 1);
+
+        __boolean_decode_array_cleanup(&(p[element].has_transport_stats), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_packets), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_bytes), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_bad_packets), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_lost), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_reordered), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_duplicated), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_incomplete), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_dropped_no_buffer), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_fec_recovered), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_nacked), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].num_retransmitted), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].num_senders), 1);
+
+        __double_decode_array_cleanup(&(p[element].ring_low_watermark), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].frag_bytes_high_watermark), 1);
+
+        __boolean_decode_array_cleanup(&(p[element].has_publish_queue_stats), 1);
+
+        __int32_t_decode_array_cleanup(&(p[element].tx_num_queued), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].tx_queued_bytes), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].tx_max_queued_bytes), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].tx_num_transmitted), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].tx_num_failed), 1);
+
+        __int64_t_decode_array_cleanup(&(p[element].tx_num_dropped), 1);
+
+    }
+    return 0;
+}
+
+int lcm_stats_report_t_decode(const void *buf, int offset, int maxlen, lcm_stats_report_t *p)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_stats_report_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_stats_report_t_decode_array(buf, offset + pos, maxlen - pos, p, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int lcm_stats_report_t_decode_cleanup(lcm_stats_report_t *p)
+{
+    return __lcm_stats_report_t_decode_array_cleanup(p, 1);
+}
+
+int __lcm_stats_report_t_decode_array_arena(const void *buf, int offset, int maxlen, lcm_stats_report_t *p, int elements, lcm_arena_t *arena)
+{
+    int pos = 0, thislen, element;
+
+    for (element = 0; element < elements; element++) {
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].utime), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __string_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].host), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].pid), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_published), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].bytes_published), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_publish_failed), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_received), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].bytes_received), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_queue_full), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_queued), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_wakeups), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].has_transport_stats), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_packets), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_bytes), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_bad_packets), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_lost), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_reordered), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_duplicated), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_incomplete), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_dropped_no_buffer), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_fec_recovered), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_nacked), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_retransmitted), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].num_senders), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __double_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].ring_low_watermark), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].frag_bytes_high_watermark), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __boolean_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].has_publish_queue_stats), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int32_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_num_queued), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_queued_bytes), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_max_queued_bytes), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_num_transmitted), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_num_failed), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+        thislen = __int64_t_decode_array_arena(buf, offset + pos, maxlen - pos, &(p[element].tx_num_dropped), 1, arena);
+        if (thislen < 0) return thislen; else pos += thislen;
+
+    }
+    return pos;
+}
+
+int lcm_stats_report_t_decode_arena(const void *buf, int offset, int maxlen, lcm_stats_report_t *p, lcm_arena_t *arena)
+{
+    int pos = 0, thislen;
+    int64_t hash = __lcm_stats_report_t_get_hash();
+
+    int64_t this_hash;
+    thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);
+    if (thislen < 0) return thislen; else pos += thislen;
+    if (this_hash != hash) return -1;
+
+    thislen = __lcm_stats_report_t_decode_array_arena(buf, offset + pos, maxlen - pos, p, 1, arena);
+    if (thislen < 0) return thislen; else pos += thislen;
+
+    return pos;
+}
+
+int __lcm_stats_report_t_clone_array(const lcm_stats_report_t *p, lcm_stats_report_t *q, int elements)
+{
+    int element;
+    for (element = 0; element < elements; element++) {
+
+        __int64_t_clone_array(&(p[element].utime), &(q[element].utime), 1);
+
+        __string_clone_array(&(p[element].host), &(q[element].host), 1);
+
+        __int32_t_clone_array(&(p[element].pid), &(q[element].pid), 1);
+
+        __int64_t_clone_array(&(p[element].num_published), &(q[element].num_published), 1);
+
+        __int64_t_clone_array(&(p[element].bytes_published), &(q[element].bytes_published), 1);
+
+        __int64_t_clone_array(&(p[element].num_publish_failed), &(q[element].num_publish_failed), 1);
+
+        __int64_t_clone_array(&(p[element].num_received), &(q[element].num_received), 1);
+
+        __int64_t_clone_array(&(p[element].bytes_received), &(q[element].bytes_received), 1);
+
+        __int64_t_clone_array(&(p[element].num_dropped_queue_full), &(q[element].num_dropped_queue_full), 1);
+
+        __int32_t_clone_array(&(p[element].num_queued), &(q[element].num_queued), 1);
+
+        __int64_t_clone_array(&(p[element].num_wakeups), &(q[element].num_wakeups), 1);
+
+        __boolean_clone_array(&(p[element].has_transport_stats), &(q[element].has_transport_stats), 1);
+
+        __int64_t_clone_array(&(p[element].num_packets), &(q[element].num_packets), 1);
+
+        __int64_t_clone_array(&(p[element].num_bytes), &(q[element].num_bytes), 1);
+
+        __int64_t_clone_array(&(p[element].num_bad_packets), &(q[element].num_bad_packets), 1);
+
+        __int64_t_clone_array(&(p[element].num_lost), &(q[element].num_lost), 1);
+
+        __int64_t_clone_array(&(p[element].num_reordered), &(q[element].num_reordered), 1);
+
+        __int64_t_clone_array(&(p[element].num_duplicated), &(q[element].num_duplicated), 1);
+
+        __int64_t_clone_array(&(p[element].num_incomplete), &(q[element].num_incomplete), 1);
+
+        __int64_t_clone_array(&(p[element].num_dropped_no_buffer), &(q[element].num_dropped_no_buffer), 1);
+
+        __int64_t_clone_array(&(p[element].num_fec_recovered), &(q[element].num_fec_recovered), 1);
+
+        __int64_t_clone_array(&(p[element].num_nacked), &(q[element].num_nacked), 1);
+
+        __int64_t_clone_array(&(p[element].num_retransmitted), &(q[element].num_retransmitted), 1);
+
+        __int32_t_clone_array(&(p[element].num_senders), &(q[element].num_senders), 1);
+
+        __double_clone_array(&(p[element].ring_low_watermark), &(q[element].ring_low_watermark), 1);
+
+        __int64_t_clone_array(&(p[element].frag_bytes_high_watermark), &(q[element].frag_bytes_high_watermark), 1);
+
+        __boolean_clone_array(&(p[element].has_publish_queue_stats), &(q[element].has_publish_queue_stats), 1);
+
+        __int32_t_clone_array(&(p[element].tx_num_queued), &(q[element].tx_num_queued), 1);
+
+        __int64_t_clone_array(&(p[element].tx_queued_bytes), &(q[element].tx_queued_bytes), 1);
+
+        __int64_t_clone_array(&(p[element].tx_max_queued_bytes), &(q[element].tx_max_queued_bytes), 1);
+
+        __int64_t_clone_array(&(p[element].tx_num_transmitted), &(q[element].tx_num_transmitted), 1);
+
+        __int64_t_clone_array(&(p[element].tx_num_failed), &(q[element].tx_num_failed), 1);
+
+        __int64_t_clone_array(&(p[element].tx_num_dropped), &(q[element].tx_num_dropped), 1);
+
+    }
+    return 0;
+}
+
+lcm_stats_report_t *lcm_stats_report_t_copy(const lcm_stats_report_t *p)
+{
+    lcm_stats_report_t *q = (lcm_stats_report_t*) malloc(sizeof(lcm_stats_report_t));
+    __lcm_stats_report_t_clone_array(p, q, 1);
+    return q;
+}
+
+void lcm_stats_report_t_destroy(lcm_stats_report_t *p)
+{
+    __lcm_stats_report_t_decode_array_cleanup(p, 1);
+    free(p);
+}
+
@@ -0,0 +1,145 @@
+/**
+ * Generated by running lcm-gen -c --c-no-pubsub lcm_stats_report.lcm
+ *
+ * and then modified by hand to replace
+ * #include <lcm/lcm_coretypes.h>
+ * with
+ * #include "../lcm_coretypes.h"
+ **/
+
+// THIS IS AN AUTOMATICALLY GENERATED FILE.  DO NOT MODIFY
+// BY HAND!!
+//
+// Generated by lcm-gen
+
+#ifndef _lcm_stats_report_t_h
+#define _lcm_stats_report_t_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "../lcm_coretypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sent every stats_interval milliseconds by an LCM instance created with that
+ * option.  The fields are those of lcm_stats_t in lcm.h.
+ */
+typedef struct _lcm_stats_report_t lcm_stats_report_t;
+struct _lcm_stats_report_t
+{
+    int64_t    utime;
+    char*      host;
+    int32_t    pid;
+    int64_t    num_published;
+    int64_t    bytes_published;
+    int64_t    num_publish_failed;
+    int64_t    num_received;
+    int64_t    bytes_received;
+    int64_t    num_dropped_queue_full;
+    int32_t    num_queued;
+    int64_t    num_wakeups;
+    int8_t     has_transport_stats;
+    int64_t    num_packets;
+    int64_t    num_bytes;
+    int64_t    num_bad_packets;
+    int64_t    num_lost;
+    int64_t    num_reordered;
+    int64_t    num_duplicated;
+    int64_t    num_incomplete;
+    int64_t    num_dropped_no_buffer;
+    int64_t    num_fec_recovered;
+    int64_t    num_nacked;
+    int64_t    num_retransmitted;
+    int32_t    num_senders;
+    double     ring_low_watermark;
+    int64_t    frag_bytes_high_watermark;
+    int8_t     has_publish_queue_stats;
+    int32_t    tx_num_queued;
+    int64_t    tx_queued_bytes;
+    int64_t    tx_max_queued_bytes;
+    int64_t    tx_num_transmitted;
+    int64_t    tx_num_failed;
+    int64_t    tx_num_dropped;
+};
+
+/**
+ * Create a deep copy of a lcm_stats_report_t.
+ * When no longer needed, destroy it with lcm_stats_report_t_destroy()
+ */
+lcm_stats_report_t* lcm_stats_report_t_copy(const lcm_stats_report_t* to_copy);
+
+/**
+ * Destroy an instance of lcm_stats_report_t created by lcm_stats_report_t_copy()
+ */
+void lcm_stats_report_t_destroy(lcm_stats_report_t* to_destroy);
+
+/**
+ * Encode a message of type lcm_stats_report_t into binary form.
+ *
+ * @param buf The output buffer.
+ * @param offset Encoding starts at this byte offset into @p buf.
+ * @param maxlen Maximum number of bytes to write.  This should generally
+ *               be equal to lcm_stats_report_t_encoded_size().
+ * @param msg The message to encode.
+ * @return The number of bytes encoded, or <0 if an error occured.
+ */
+int lcm_stats_report_t_encode(void *buf, int offset, int maxlen, const lcm_stats_report_t *p);
+
+/**
+ * Decode a message of type lcm_stats_report_t from binary form.
+ * When decoding messages containing strings or variable-length arrays, this
+ * function may allocate memory.  When finished with the decoded message,
+ * release allocated resources with lcm_stats_report_t_decode_cleanup().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+int lcm_stats_report_t_decode(const void *buf, int offset, int maxlen, lcm_stats_report_t *msg);
+
+/**
+ * Release resources allocated by lcm_stats_report_t_decode()
+ * @return 0
+ */
+int lcm_stats_report_t_decode_cleanup(lcm_stats_report_t *p);
+
+/**
+ * Decode a message of type lcm_stats_report_t from binary form, like lcm_stats_report_t_decode(),
+ * but allocate the strings and variable-length arrays of the message from
+ * @p arena.  Do not call lcm_stats_report_t_decode_cleanup() on the message; its memory is
+ * released with lcm_arena_reset() or lcm_arena_free().
+ *
+ * @param buf The buffer containing the encoded message
+ * @param offset The byte offset into @p buf where the encoded message starts.
+ * @param maxlen The maximum number of bytes to read while decoding.
+ * @param msg Output parameter where the decoded message is stored
+ * @param arena The arena to allocate from.
+ * @return The number of bytes decoded, or <0 if an error occured.
+ */
+int lcm_stats_report_t_decode_arena(const void *buf, int offset, int maxlen, lcm_stats_report_t *msg, lcm_arena_t *arena);
+
+/**
+ * Check how many bytes are required to encode a message of type lcm_stats_report_t
+ */
+int lcm_stats_report_t_encoded_size(const lcm_stats_report_t *p);
+
+// LCM support functions. Users should not call these
+int64_t __lcm_stats_report_t_get_hash(void);
+uint64_t __lcm_stats_report_t_hash_recursive(const __lcm_hash_ptr *p);
+int __lcm_stats_report_t_encode_array(void *buf, int offset, int maxlen, const lcm_stats_report_t *p, int elements);
+int __lcm_stats_report_t_decode_array(const void *buf, int offset, int maxlen, lcm_stats_report_t *p, int elements);
+int __lcm_stats_report_t_decode_array_cleanup(lcm_stats_report_t *p, int elements);
+int __lcm_stats_report_t_decode_array_arena(const void *buf, int offset, int maxlen, lcm_stats_report_t *p, int elements, lcm_arena_t *arena);
+int __lcm_stats_report_t_encoded_array_size(const lcm_stats_report_t *p, int elements);
+int __lcm_stats_report_t_clone_array(const lcm_stats_report_t *p, lcm_stats_report_t *q, int elements);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,5 +1,6 @@
 #include "udpm_util.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
@@ -7,22 +8,56 @@
 
 #include "dbg.h"
 
-#define LCM_MAX_UNFRAGMENTED_PACKET_SIZE 65536
+#ifdef LCM_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef LCM_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 /******************** fragment buffer **********************/
+static lcm_frag_buf_t *
+_frag_buf_alloc (struct sockaddr_in from, uint32_t msg_seqno,
+        uint32_t data_size, uint16_t nfragments, int64_t first_packet_utime)
+{
+    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t*) malloc (sizeof (lcm_frag_buf_t));
+    fbuf->channel[0] = 0;
+    fbuf->channel_id = -1;
+    memset (&fbuf->key, 0, sizeof (fbuf->key));
+    fbuf->key.from = from;
+    fbuf->key.msg_seqno = msg_seqno;
+    fbuf->data = NULL;
+    fbuf->data_size = data_size;
+    fbuf->fragments_in_msg = nfragments;
+    fbuf->fragments_remaining = nfragments;
+    fbuf->received = (uint8_t*) calloc ((nfragments + 7) / 8, 1);
+    fbuf->last_packet_utime = first_packet_utime;
+    fbuf->last_packet_time_ns = first_packet_utime * 1000;
+    fbuf->ignored = 0;
+    fbuf->compressed = 0;
+    return fbuf;
+}
+
 lcm_frag_buf_t *
 lcm_frag_buf_new (struct sockaddr_in from, const char *channel, 
         uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
         int64_t first_packet_utime)
 {
-    lcm_frag_buf_t *fbuf = (lcm_frag_buf_t*) malloc (sizeof (lcm_frag_buf_t));
-    strncpy (fbuf->channel, channel, sizeof (fbuf->channel));
-    fbuf->from = from;
-    fbuf->msg_seqno = msg_seqno;
+    lcm_frag_buf_t *fbuf = _frag_buf_alloc (from, msg_seqno, data_size,
+            nfragments, first_packet_utime);
+    if (channel)
+        strncpy (fbuf->channel, channel, sizeof (fbuf->channel));
     fbuf->data = (char*)malloc (data_size);
-    fbuf->data_size = data_size;
-    fbuf->fragments_remaining = nfragments;
-    fbuf->last_packet_utime = first_packet_utime;
+    return fbuf;
+}
+
+lcm_frag_buf_t *
+lcm_frag_buf_new_ignored (struct sockaddr_in from, uint32_t msg_seqno,
+        uint32_t data_size, uint16_t nfragments, int64_t first_packet_utime)
+{
+    lcm_frag_buf_t *fbuf = _frag_buf_alloc (from, msg_seqno, data_size,
+            nfragments, first_packet_utime);
+    fbuf->ignored = 1;
     return fbuf;
 }
 
@@ -30,9 +65,20 @@ void
 lcm_frag_buf_destroy (lcm_frag_buf_t *fbuf)
 {
     free (fbuf->data);
+    free (fbuf->received);
     free (fbuf);
 }
 
+int
+lcm_frag_buf_mark_received (lcm_frag_buf_t *fbuf, uint16_t fragment_no)
+{
+    if (fragment_no >= fbuf->fragments_in_msg ||
+            lcm_frag_buf_has_fragment (fbuf, fragment_no))
+        return 0;
+    fbuf->received[fragment_no / 8] |= 1 << (fragment_no % 8);
+    fbuf->fragments_remaining--;
+    return 1;
+}
 
 
 /******************** fragment buffer store **********************/
@@ -56,17 +102,31 @@ _sockaddr_in_equal (const void * a, const void *b)
            a_addr->sin_family      == b_addr->sin_family;
 }
 
-static void
-_find_lru_frag_buf (gpointer key, gpointer value, void *user_data)
+guint
+lcm_frag_key_hash (const void * key)
 {
-    lcm_frag_buf_t **lru_fbuf = (lcm_frag_buf_t**) user_data;
-    lcm_frag_buf_t *c_fbuf = (lcm_frag_buf_t*) value;
-    if (! *lru_fbuf ||
-        (c_fbuf->last_packet_utime < (*lru_fbuf)->last_packet_utime)) {
-        *lru_fbuf = c_fbuf;
-    }
+    const lcm_frag_key_t *k = (const lcm_frag_key_t*) key;
+    return _sockaddr_in_hash (&k->from) ^ (k->msg_seqno * 2654435761u);
 }
 
+gboolean
+lcm_frag_key_equal (const void * a, const void *b)
+{
+    const lcm_frag_key_t *a_key = (const lcm_frag_key_t*) a;
+    const lcm_frag_key_t *b_key = (const lcm_frag_key_t*) b;
+
+    return a_key->msg_seqno == b_key->msg_seqno &&
+        _sockaddr_in_equal (&a_key->from, &b_key->from);
+}
+
+// The messages of one sender in a store
+struct _lcm_frag_sender {
+    struct sockaddr_in from;
+    int count;
+    lcm_frag_buf_t *head;   // least recently updated
+    lcm_frag_buf_t *tail;
+};
+
 lcm_frag_buf_store * lcm_frag_buf_store_new(uint32_t max_total_size,
         uint32_t max_n_frag_bufs) {
     lcm_frag_buf_store * store = (lcm_frag_buf_store *) calloc(1,
@@ -74,44 +134,174 @@ lcm_frag_buf_store * lcm_frag_buf_store_new(uint32_t max_total_size,
     store->total_size = 0;
     store->max_total_size = max_total_size;
     store->max_n_frag_bufs = max_n_frag_bufs;
+    store->max_age_usec = FRAG_BUF_MAX_AGE_USEC;
 
-    store->frag_bufs = g_hash_table_new_full(_sockaddr_in_hash,
-                                       _sockaddr_in_equal, NULL,
+    store->frag_bufs = g_hash_table_new_full(lcm_frag_key_hash,
+                                       lcm_frag_key_equal, NULL,
                                        (GDestroyNotify) lcm_frag_buf_destroy);
+    store->senders = g_hash_table_new_full(_sockaddr_in_hash,
+            _sockaddr_in_equal, NULL, free);
     return store;
 }
 
 void lcm_frag_buf_store_destroy(lcm_frag_buf_store * store){
     g_hash_table_destroy (store->frag_bufs);
+    g_hash_table_destroy (store->senders);
     free(store);
 }
 
 lcm_frag_buf_t * lcm_frag_buf_store_lookup(lcm_frag_buf_store * store,
-        struct sockaddr* key) {
-    return (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, key);
+        struct sockaddr* from, uint32_t msg_seqno) {
+    lcm_frag_key_t key;
+    memset (&key, 0, sizeof (key));
+    key.from = *(struct sockaddr_in*) from;
+    key.msg_seqno = msg_seqno;
+    return (lcm_frag_buf_t *) g_hash_table_lookup(store->frag_bufs, &key);
 }
 
-void
+// appends fbuf to the tails of the store's and its sender's lists
+static void
+_lru_append (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+{
+    fbuf->lru_prev = store->lru_tail;
+    fbuf->lru_next = NULL;
+    if (store->lru_tail)
+        store->lru_tail->lru_next = fbuf;
+    else
+        store->lru_head = fbuf;
+    store->lru_tail = fbuf;
+
+    lcm_frag_sender_t *sender = fbuf->sender;
+    fbuf->sender_prev = sender->tail;
+    fbuf->sender_next = NULL;
+    if (sender->tail)
+        sender->tail->sender_next = fbuf;
+    else
+        sender->head = fbuf;
+    sender->tail = fbuf;
+}
+
+static void
+_lru_unlink (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+{
+    if (fbuf->lru_prev)
+        fbuf->lru_prev->lru_next = fbuf->lru_next;
+    else
+        store->lru_head = fbuf->lru_next;
+    if (fbuf->lru_next)
+        fbuf->lru_next->lru_prev = fbuf->lru_prev;
+    else
+        store->lru_tail = fbuf->lru_prev;
+
+    lcm_frag_sender_t *sender = fbuf->sender;
+    if (fbuf->sender_prev)
+        fbuf->sender_prev->sender_next = fbuf->sender_next;
+    else
+        sender->head = fbuf->sender_next;
+    if (fbuf->sender_next)
+        fbuf->sender_next->sender_prev = fbuf->sender_prev;
+    else
+        sender->tail = fbuf->sender_prev;
+}
+
+// removes a fragment buffer to make room, and returns 1 if it held an
+// incomplete message
+static int
+_evict (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+{
+    int incomplete = !fbuf->ignored;
+    dbg (DBG_LCM, "Dropping message (missing %d fragments)\n",
+            fbuf->fragments_remaining);
+    lcm_frag_buf_store_remove (store, fbuf);
+    return incomplete;
+}
+
+int
 lcm_frag_buf_store_add (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
-    while (store->total_size > store->max_total_size ||
-            g_hash_table_size (store->frag_bufs) > store->max_n_frag_bufs) {
-        // find and remove the least recently updated fragment buffer
-        lcm_frag_buf_t *lru_fbuf = NULL;
-        g_hash_table_foreach (store->frag_bufs, _find_lru_frag_buf, &lru_fbuf);
-        if (lru_fbuf){
-            lcm_frag_buf_store_remove (store, lru_fbuf);
-        }
+    int num_evicted = 0;
+
+    // make room among the sender's own messages first
+    lcm_frag_sender_t *sender = (lcm_frag_sender_t *) g_hash_table_lookup (
+            store->senders, &fbuf->key.from);
+    if (sender && sender->count >= MAX_FRAG_BUFS_PER_SENDER) {
+        // that may have been the sender's last one
+        num_evicted += _evict (store, sender->head);
+        sender = (lcm_frag_sender_t *) g_hash_table_lookup (store->senders,
+                &fbuf->key.from);
+    }
+
+    // and then make room for this one
+    uint32_t size = fbuf->ignored ? 0 : fbuf->data_size;
+    while (store->lru_head &&
+            (store->total_size + size > store->max_total_size ||
+             g_hash_table_size (store->frag_bufs) >= store->max_n_frag_bufs)) {
+        // remove the least recently updated fragment buffer
+        if (sender && sender->count == 1 && sender->head == store->lru_head)
+            sender = NULL;
+        num_evicted += _evict (store, store->lru_head);
     }
-    g_hash_table_insert (store->frag_bufs, &fbuf->from, fbuf);
-    store->total_size += fbuf->data_size;
+
+    if (!sender) {
+        sender = (lcm_frag_sender_t *) calloc (1, sizeof (lcm_frag_sender_t));
+        sender->from = fbuf->key.from;
+        g_hash_table_insert (store->senders, &sender->from, sender);
+    }
+    sender->count++;
+    fbuf->sender = sender;
+    _lru_append (store, fbuf);
+    g_hash_table_insert (store->frag_bufs, &fbuf->key, fbuf);
+    store->total_size += size;
+    if (store->total_size > store->peak_total_size)
+        store->peak_total_size = store->total_size;
+    return num_evicted;
 }
 
 void
 lcm_frag_buf_store_remove (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
 {
+    if (!fbuf->ignored)
+        store->total_size -= fbuf->data_size;
+    _lru_unlink (store, fbuf);
+    lcm_frag_sender_t *sender = fbuf->sender;
+    if (!--sender->count)
+        g_hash_table_remove (store->senders, &sender->from);
+    g_hash_table_remove (store->frag_bufs, &fbuf->key);
+}
+
+void
+lcm_frag_buf_store_ignore (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf)
+{
+    if (fbuf->ignored)
+        return;
     store->total_size -= fbuf->data_size;
-    g_hash_table_remove (store->frag_bufs, &fbuf->from);
+    free (fbuf->data);
+    fbuf->data = NULL;
+    fbuf->ignored = 1;
+}
+
+void
+lcm_frag_buf_store_touch (lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf,
+        int64_t packet_utime, int64_t packet_time_ns)
+{
+    fbuf->last_packet_utime = packet_utime;
+    fbuf->last_packet_time_ns = packet_time_ns;
+    if (store->lru_tail != fbuf || fbuf->sender->tail != fbuf) {
+        _lru_unlink (store, fbuf);
+        _lru_append (store, fbuf);
+    }
+}
+
+int
+lcm_frag_buf_store_expire (lcm_frag_buf_store *store, int64_t now_utime)
+{
+    int num_expired = 0;
+    if (!store->max_age_usec)
+        return 0;
+    while (store->lru_head && store->lru_head->last_packet_utime +
+            store->max_age_usec < now_utime)
+        num_expired += _evict (store, store->lru_head);
+    return num_expired;
 }
 
 
@@ -155,34 +345,23 @@ lcm_buf_enqueue (lcm_buf_queue_t * q, lcm_buf_t * el)
 }
 
  void
-lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf)
+lcm_buf_free_data(lcm_buf_t *lcmb)
 {
     if(!lcmb->buf)
         return;
-    if (lcmb->ringbuf) {
-        lcm_ringbuf_dealloc (lcmb->ringbuf, lcmb->buf);
-
-        // if the packet was allocated from an obsolete and empty ringbuffer,
-        // then deallocate the old ringbuffer as well.
-        if(lcmb->ringbuf != ringbuf && !lcm_ringbuf_used(lcmb->ringbuf)) {
-            lcm_ringbuf_free(lcmb->ringbuf);
-            dbg(DBG_LCM, "Destroying unused orphan ringbuffer %p\n",
-                    lcmb->ringbuf);
-        }
-    } else {
+    if (lcmb->pool)
+        lcm_bufpool_release (lcmb->pool, lcmb->buf);
+    else
         free (lcmb->buf);
-    }
     lcmb->buf = NULL;
     lcmb->buf_size = 0;
-    lcmb->ringbuf = NULL;
+    lcmb->pool = NULL;
 }
 
 lcm_buf_t *
-lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t **ringbuf) {
-     lcm_buf_t * lcmb = NULL;
-     // first allocate a buffer struct for the packet metadata
+lcm_buf_allocate(lcm_buf_queue_t * inbufs_empty) {
+     // allocate additional buffer structs if needed
      if (lcm_buf_queue_is_empty(inbufs_empty)) {
-         // allocate additional buffer structs if needed
          int i;
          for (i = 0; i < LCM_DEFAULT_RECV_BUFS; i++) {
              lcm_buf_t * nbuf = (lcm_buf_t *) calloc(1, sizeof(lcm_buf_t));
@@ -190,42 +369,55 @@ lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t **ringbuf) {
          }
      }
 
-     lcmb = lcm_buf_dequeue(inbufs_empty);
+     lcm_buf_t * lcmb = lcm_buf_dequeue(inbufs_empty);
      assert(lcmb);
+     lcmb->channel_id = -1;
+     return lcmb;
+}
 
-    // allocate space on the ringbuffer for the packet data.
-    // give it the maximum possible size for an unfragmented packet
-    lcmb->buf = lcm_ringbuf_alloc(*ringbuf, LCM_MAX_UNFRAGMENTED_PACKET_SIZE);
-    if (lcmb->buf == NULL) {
-         // ringbuffer is full.  allocate a larger ringbuffer
-
-         // Can't free the old ringbuffer yet because it's in use (i.e., full)
-         // Must wait until later to free it.
-         assert(lcm_ringbuf_used(*ringbuf) > 0);
-         dbg(DBG_LCM, "Orphaning ringbuffer %p\n", *ringbuf);
-
-         unsigned int old_capacity = lcm_ringbuf_capacity(*ringbuf);
-         unsigned int new_capacity = (unsigned int) (old_capacity * 1.5);
-         // replace the passed in ringbuf with the new one
-         *ringbuf = lcm_ringbuf_new(new_capacity);
-         lcmb->buf = lcm_ringbuf_alloc(*ringbuf, 65536);
-         assert(lcmb->buf);
-         dbg(DBG_LCM, "Allocated new ringbuffer size %u\n", new_capacity);
-     }
-     // save a pointer to the ringbuf, in case it gets replaced by another call
-     lcmb->ringbuf = *ringbuf;
+ int
+lcm_buf_allocate_data(lcm_buf_t *lcmb, lcm_bufpool_t *pool, unsigned int len)
+{
+    if (!lcmb->buf || lcmb->buf_size < len) {
+        lcm_buf_free_data(lcmb);
+        lcmb->buf = lcm_bufpool_alloc(pool, len);
+        if (!lcmb->buf)
+            return -1;
+        lcmb->pool = pool;
+        lcmb->buf_size = lcm_bufpool_buf_size(lcmb->buf);
+    }
 
-     // zero the last byte so that strlen never segfaults
-     lcmb->buf[65535] = 0;
-     return lcmb;
- }
+    // zero the last byte so that strlen never segfaults
+    lcmb->buf[len - 1] = 0;
+    return 0;
+}
 
  void
-lcm_buf_queue_free (lcm_buf_queue_t * q, lcm_ringbuf_t *ringbuf)
+lcm_buf_shrink_data(lcm_buf_t *lcmb, unsigned int len)
+{
+    if (!lcmb->pool)
+        return;
+    char *buf = lcm_bufpool_alloc(lcmb->pool, len + 1);
+    if (!buf)
+        return;
+    if (lcm_bufpool_buf_size(buf) >= lcmb->buf_size) {
+        // no smaller size class fits
+        lcm_bufpool_release(lcmb->pool, buf);
+        return;
+    }
+    memcpy(buf, lcmb->buf, len);
+    buf[len] = 0;
+    lcm_bufpool_release(lcmb->pool, lcmb->buf);
+    lcmb->buf = buf;
+    lcmb->buf_size = lcm_bufpool_buf_size(buf);
+}
+
+ void
+lcm_buf_queue_free (lcm_buf_queue_t * q)
 {
     lcm_buf_t * el;
     while ( (el = lcm_buf_dequeue (q))) {
-        lcm_buf_free_data(el, ringbuf);
+        lcm_buf_free_data(el);
         free (el);
     }
     free (q);
@@ -237,7 +429,505 @@ lcm_buf_queue_is_empty (lcm_buf_queue_t * q)
     return q->head == NULL ? 1 : 0;
 }
 
+/************** lock-free message buffer handoff ****************/
+
+// head and tail count pushes and pops since the ring was created, and wrap
+// around at 2^32.  tail - head is the number of buffers in the ring.
+lcm_buf_ring_t *
+lcm_buf_ring_new (unsigned int capacity)
+{
+    assert (capacity && !(capacity & (capacity - 1)));
+    lcm_buf_ring_t * ring =
+        (lcm_buf_ring_t *) calloc (1, sizeof (lcm_buf_ring_t));
+    ring->slots = (lcm_buf_t **) calloc (capacity, sizeof (lcm_buf_t *));
+    ring->mask = capacity - 1;
+    return ring;
+}
+
+void
+lcm_buf_ring_free (lcm_buf_ring_t * ring)
+{
+    if (!ring)
+        return;
+    free (ring->slots);
+    free (ring);
+}
+
+int
+lcm_buf_ring_push (lcm_buf_ring_t * ring, lcm_buf_t * el)
+{
+    guint tail = (guint) ring->tail;
+    guint head = (guint) g_atomic_int_get (&ring->head);
+    if (tail - head > ring->mask)
+        return -1;
+    ring->slots[tail & ring->mask] = el;
+    // publishes the slot before the new tail
+    g_atomic_int_set (&ring->tail, (gint) (tail + 1));
+    return 0;
+}
 
+lcm_buf_t *
+lcm_buf_ring_pop (lcm_buf_ring_t * ring)
+{
+    guint head = (guint) ring->head;
+    guint tail = (guint) g_atomic_int_get (&ring->tail);
+    if (head == tail)
+        return NULL;
+    lcm_buf_t * el = ring->slots[head & ring->mask];
+    // the producer may reuse the slot once it sees the new head
+    g_atomic_int_set (&ring->head, (gint) (head + 1));
+    return el;
+}
+
+int
+lcm_buf_ring_is_empty (lcm_buf_ring_t * ring)
+{
+    return g_atomic_int_get (&ring->head) == g_atomic_int_get (&ring->tail);
+}
+
+/******************** sequence tracking **********************/
+
+// how many sequence numbers before the newest one are remembered, to tell
+// reordered messages from duplicates
+#define SEQ_WINDOW 64
+
+// a sequence number this far behind the newest one means that the sender
+// restarted
+#define SEQ_RESTART_DISTANCE 1024
+
+#define MAX_TRACKED_SENDERS 1000
+#define SENDER_TIMEOUT_USEC 10000000
+
+typedef struct _seq_sender {
+    struct sockaddr_in from;
+    uint32_t last_seqno;  // newest sequence number received
+    uint64_t seen;        // bit i is set if last_seqno - i was received
+    uint64_t complete;    // bit i is set if all of last_seqno - i arrived
+    int64_t  last_utime;
+} seq_sender_t;
+
+struct _lcm_seq_tracker {
+    GHashTable *senders;
+    int count_gaps;
+};
+
+lcm_seq_tracker_t *
+lcm_seq_tracker_new (int count_gaps)
+{
+    lcm_seq_tracker_t *tracker =
+        (lcm_seq_tracker_t *) calloc (1, sizeof (lcm_seq_tracker_t));
+    tracker->senders = g_hash_table_new_full (_sockaddr_in_hash,
+            _sockaddr_in_equal, NULL, free);
+    tracker->count_gaps = count_gaps;
+    return tracker;
+}
+
+void
+lcm_seq_tracker_destroy (lcm_seq_tracker_t *tracker)
+{
+    g_hash_table_destroy (tracker->senders);
+    free (tracker);
+}
+
+void
+lcm_seq_tracker_set_count_gaps (lcm_seq_tracker_t *tracker, int count_gaps)
+{
+    tracker->count_gaps = count_gaps;
+}
+
+static gboolean
+_seq_sender_is_stale (gpointer key, gpointer value, gpointer user_data)
+{
+    seq_sender_t *sender = (seq_sender_t *) value;
+    int64_t now = *(int64_t *) user_data;
+    return now - sender->last_utime > SENDER_TIMEOUT_USEC;
+}
+
+static void
+_seq_sender_reset (seq_sender_t *sender, uint32_t msg_seqno)
+{
+    sender->last_seqno = msg_seqno;
+    sender->seen = 1;
+    sender->complete = 0;
+}
+
+int
+lcm_seq_tracker_update (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno, int is_fragment,
+        int64_t utime, lcm_transport_stats_t *stats)
+{
+    seq_sender_t *sender =
+        (seq_sender_t *) g_hash_table_lookup (tracker->senders, from);
+    if (!sender) {
+        if (g_hash_table_size (tracker->senders) >= MAX_TRACKED_SENDERS)
+            g_hash_table_foreach_remove (tracker->senders,
+                    _seq_sender_is_stale, &utime);
+        if (g_hash_table_size (tracker->senders) < MAX_TRACKED_SENDERS) {
+            sender = (seq_sender_t *) calloc (1, sizeof (seq_sender_t));
+            sender->from = *from;
+            sender->last_utime = utime;
+            _seq_sender_reset (sender, msg_seqno);
+            g_hash_table_insert (tracker->senders, &sender->from, sender);
+        }
+        stats->num_senders = g_hash_table_size (tracker->senders);
+        return 0;
+    }
+    sender->last_utime = utime;
+
+    // serial number arithmetic, so that the sequence numbers can wrap around
+    int32_t ahead = (int32_t) (msg_seqno - sender->last_seqno);
+    if (ahead > 0) {
+        if (tracker->count_gaps)
+            stats->num_lost += ahead - 1;
+        sender->seen = ahead < SEQ_WINDOW ? (sender->seen << ahead) | 1 : 1;
+        sender->complete = ahead < SEQ_WINDOW ? sender->complete << ahead : 0;
+        sender->last_seqno = msg_seqno;
+        return ahead - 1;
+    }
+
+    uint32_t behind = (uint32_t) -ahead;
+    if (behind >= SEQ_RESTART_DISTANCE) {
+        _seq_sender_reset (sender, msg_seqno);
+        return 0;
+    }
+    if (behind < SEQ_WINDOW && (sender->seen & ((uint64_t) 1 << behind))) {
+        // the other fragments of a message share its sequence number
+        if (!is_fragment)
+            stats->num_duplicated++;
+        return -1;
+    }
+    if (behind < SEQ_WINDOW)
+        sender->seen |= (uint64_t) 1 << behind;
+    stats->num_reordered++;
+    if (tracker->count_gaps && stats->num_lost > 0)
+        stats->num_lost--;
+    return 0;
+}
+
+// the bit of msg_seqno in the windows of sender, or 0 if it is outside them
+static uint64_t
+_seq_sender_bit (const seq_sender_t *sender, uint32_t msg_seqno)
+{
+    uint32_t behind = sender->last_seqno - msg_seqno;
+    return behind < SEQ_WINDOW ? (uint64_t) 1 << behind : 0;
+}
+
+void
+lcm_seq_tracker_set_complete (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno)
+{
+    seq_sender_t *sender =
+        (seq_sender_t *) g_hash_table_lookup (tracker->senders, from);
+    if (sender)
+        sender->complete |= _seq_sender_bit (sender, msg_seqno);
+}
+
+int
+lcm_seq_tracker_is_complete (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno)
+{
+    seq_sender_t *sender =
+        (seq_sender_t *) g_hash_table_lookup (tracker->senders, from);
+    return sender && (sender->complete & _seq_sender_bit (sender, msg_seqno));
+}
+
+/******************** datagram sizes **********************/
+
+int
+lcm_short_message_max_size (int mtu)
+{
+    if (!mtu)
+        return LCM_SHORT_MESSAGE_MAX_SIZE;
+    return MIN (LCM_SHORT_MESSAGE_MAX_SIZE, mtu - LCM_IP_UDP_HEADER_SIZE -
+            (int) sizeof (lcm2_header_short_t));
+}
+
+int
+lcm_fragment_max_payload (int mtu)
+{
+    if (!mtu)
+        return LCM_FRAGMENT_MAX_PAYLOAD;
+    return MIN (LCM_FRAGMENT_MAX_PAYLOAD, mtu - LCM_IP_UDP_HEADER_SIZE -
+            (int) sizeof (lcm2_header_long_t));
+}
+
+/******************** compression **********************/
+
+int
+lcm_codec_from_name (const char *name)
+{
+    if (!strcmp (name, "lz4")) {
+#ifdef LCM_HAVE_LZ4
+        return LCM_CODEC_LZ4;
+#else
+        return -1;
+#endif
+    }
+    if (!strcmp (name, "zlib")) {
+#ifdef LCM_HAVE_ZLIB
+        return LCM_CODEC_ZLIB;
+#else
+        return -1;
+#endif
+    }
+    return 0;
+}
+
+int
+lcm_compress_payload (int codec, const void *data, uint32_t len,
+        char **compressed)
+{
+    // not worth it unless the header and at least as much again are saved
+    uint32_t hdr_size = sizeof (lcm2_compress_header_t);
+    if (len <= 2 * hdr_size || len > LCM_MAX_MESSAGE_SIZE)
+        return -1;
+    uint32_t capacity = len - 2 * hdr_size;
+    char *buf = (char *) malloc (hdr_size + capacity);
+    int size = -1;
+
+    switch (codec) {
+#ifdef LCM_HAVE_LZ4
+    case LCM_CODEC_LZ4:
+        size = LZ4_compress_default ((const char *) data, buf + hdr_size,
+                len, capacity);
+        if (size <= 0)
+            size = -1;
+        break;
+#endif
+#ifdef LCM_HAVE_ZLIB
+    case LCM_CODEC_ZLIB: {
+        // level 1 is the fastest, which matters more than the ratio here
+        uLongf zsize = capacity;
+        if (compress2 ((Bytef *) buf + hdr_size, &zsize,
+                    (const Bytef *) data, len, 1) == Z_OK)
+            size = zsize;
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    if (size < 0) {
+        free (buf);
+        return -1;
+    }
+
+    lcm2_compress_header_t *hdr = (lcm2_compress_header_t *) buf;
+    memset (hdr, 0, hdr_size);
+    hdr->raw_size = htonl (len);
+    hdr->codec = codec;
+    *compressed = buf;
+    return hdr_size + size;
+}
+
+int
+lcm_decompress_payload (const void *payload, uint32_t len, char **data)
+{
+    uint32_t hdr_size = sizeof (lcm2_compress_header_t);
+    if (len < hdr_size)
+        return -1;
+    const lcm2_compress_header_t *hdr =
+        (const lcm2_compress_header_t *) payload;
+    uint32_t raw_size = ntohl (hdr->raw_size);
+    if (raw_size > LCM_MAX_MESSAGE_SIZE)
+        return -1;
+    const char *src = (const char *) payload + hdr_size;
+    uint32_t src_size = len - hdr_size;
+    char *buf = (char *) malloc (raw_size ? raw_size : 1);
+    int ok = 0;
+
+    switch (hdr->codec) {
+#ifdef LCM_HAVE_LZ4
+    case LCM_CODEC_LZ4:
+        ok = LZ4_decompress_safe (src, buf, src_size, raw_size) ==
+            (int) raw_size;
+        break;
+#endif
+#ifdef LCM_HAVE_ZLIB
+    case LCM_CODEC_ZLIB: {
+        uLongf size = raw_size;
+        ok = uncompress ((Bytef *) buf, &size, (const Bytef *) src,
+                src_size) == Z_OK && size == raw_size;
+        break;
+    }
+#endif
+    default:
+        break;
+    }
+    if (!ok) {
+        free (buf);
+        return -1;
+    }
+    *data = buf;
+    return raw_size;
+}
+
+/******************** fragment pacing **********************/
+
+void
+lcm_pacer_init (lcm_pacer_t *pacer, double max_rate_mbps, int burst_kb)
+{
+    // 1 Mbit/s is 1/8 of a byte per microsecond
+    pacer->rate = max_rate_mbps > 0 ? max_rate_mbps / 8 : 0;
+    if (burst_kb <= 0)
+        burst_kb = LCM_DEFAULT_PACING_BURST_KB;
+    pacer->burst = burst_kb * 1024.0;
+    pacer->tokens = pacer->burst;
+    pacer->last_utime = lcm_clock_monotonic_us ();
+}
+
+void
+lcm_pacer_wait (lcm_pacer_t *pacer, int nbytes)
+{
+    if (pacer->rate <= 0)
+        return;
+
+    // a send larger than the bucket waits for a full bucket and leaves the
+    // rest as debt, so the long-term rate still holds.
+    double needed = MIN ((double) nbytes, pacer->burst);
+    while (1) {
+        int64_t now = lcm_clock_monotonic_us ();
+        if (now > pacer->last_utime) {
+            pacer->tokens = MIN (pacer->burst,
+                    pacer->tokens + (now - pacer->last_utime) * pacer->rate);
+        }
+        pacer->last_utime = now;
+        if (pacer->tokens >= needed)
+            break;
+        g_usleep ((gulong) ((needed - pacer->tokens) / pacer->rate) + 1);
+    }
+    pacer->tokens -= nbytes;
+}
+
+/******************** fault injection **********************/
+static int
+_parse_rate (const char *key, const char *value, double *rate)
+{
+    char *endptr = NULL;
+    double r = strtod (value, &endptr);
+    if (endptr == value || *endptr || r < 0 || r > 1) {
+        fprintf (stderr, "Warning: Invalid value for %s\n", key);
+        return 1;
+    }
+    *rate = r;
+    return 1;
+}
+
+int
+lcm_fault_params_parse (lcm_fault_params_t *params, const char *key,
+        const char *value)
+{
+    if (!strcmp (key, "drop_rate"))
+        return _parse_rate (key, value, &params->drop_rate);
+    if (!strcmp (key, "dup_rate"))
+        return _parse_rate (key, value, &params->dup_rate);
+    if (!strcmp (key, "reorder_rate"))
+        return _parse_rate (key, value, &params->reorder_rate);
+    if (!strcmp (key, "fault_seed")) {
+        char *endptr = NULL;
+        params->seed = strtoul (value, &endptr, 0);
+        if (endptr == value || *endptr)
+            fprintf (stderr, "Warning: Invalid value for fault_seed\n");
+        return 1;
+    }
+    return 0;
+}
+
+int
+lcm_fault_params_enabled (const lcm_fault_params_t *params)
+{
+    return params->drop_rate > 0 || params->dup_rate > 0 ||
+        params->reorder_rate > 0;
+}
+
+lcm_fault_injector_t *
+lcm_fault_injector_new (const lcm_fault_params_t *params, unsigned int stream)
+{
+    if (!lcm_fault_params_enabled (params))
+        return NULL;
+    lcm_fault_injector_t *faults =
+        (lcm_fault_injector_t *) calloc (1, sizeof (lcm_fault_injector_t));
+    faults->params = *params;
+    uint64_t seed = params->seed ? params->seed :
+        (uint64_t) lcm_clock_realtime_ns () ^ (uint64_t) (uintptr_t) faults;
+    // splitmix64 of the seed and stream, so that neither may be 0
+    uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    faults->rand_state = (z ^ (z >> 31)) | 1;
+    faults->held_size = -1;
+    return faults;
+}
+
+void
+lcm_fault_injector_destroy (lcm_fault_injector_t *faults)
+{
+    if (!faults)
+        return;
+    free (faults->held);
+    free (faults);
+}
+
+// a uniform random number in [0, 1), with xorshift64*
+static double
+_fault_rand (lcm_fault_injector_t *faults)
+{
+    uint64_t x = faults->rand_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    faults->rand_state = x;
+    return ((x * 2685821657736338717ULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int
+_send_held (lcm_fault_injector_t *faults, SOCKET fd)
+{
+    int size = faults->held_size;
+    faults->held_size = -1;
+    return sendto (fd, faults->held, size, 0,
+            (struct sockaddr *) &faults->held_to, sizeof (faults->held_to));
+}
+
+int
+lcm_fault_sendmsg (lcm_fault_injector_t *faults, SOCKET fd,
+        const struct msghdr *msg)
+{
+    int size = 0;
+    for (size_t i = 0; i < msg->msg_iovlen; i++)
+        size += msg->msg_iov[i].iov_len;
+
+    int status = size;
+    if (_fault_rand (faults) < faults->params.drop_rate) {
+        // lost
+    } else if (faults->held_size < 0 &&
+            _fault_rand (faults) < faults->params.reorder_rate &&
+            msg->msg_namelen <= sizeof (faults->held_to)) {
+        if (size > faults->held_capacity) {
+            free (faults->held);
+            faults->held = (char *) malloc (size);
+            faults->held_capacity = size;
+        }
+        int offset = 0;
+        for (size_t i = 0; i < msg->msg_iovlen; i++) {
+            memcpy (faults->held + offset, msg->msg_iov[i].iov_base,
+                    msg->msg_iov[i].iov_len);
+            offset += msg->msg_iov[i].iov_len;
+        }
+        memset (&faults->held_to, 0, sizeof (faults->held_to));
+        memcpy (&faults->held_to, msg->msg_name, msg->msg_namelen);
+        faults->held_size = size;
+        return size;
+    } else {
+        status = sendmsg (fd, msg, 0);
+        if (status >= 0 && _fault_rand (faults) < faults->params.dup_rate)
+            sendmsg (fd, msg, 0);
+    }
+
+    if (faults->held_size >= 0 && _send_held (faults, fd) < 0)
+        return -1;
+    return status;
+}
 
 #ifdef __linux__
 static inline int _parse_inaddr(const char *addr_str, struct in_addr *addr)
@@ -326,3 +1016,766 @@ show_route_cmds:
 inet_ntoa(lcm_mcaddr));
 }
 #endif
+
+/******************** io_uring **********************/
+#ifdef USE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+struct _lcm_uring {
+    int fd;
+    unsigned sq_entries;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    struct io_uring_sqe *sqes;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    unsigned sqe_tail;     // submissions prepared, not all published yet
+    unsigned to_submit;
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    unsigned buf_tail;
+    int nbufs;
+    int buf_size;
+    char *bufs;
+};
+
+lcm_uring_t *
+lcm_uring_new (unsigned entries, int bgid, int nbufs, int buf_size)
+{
+    struct io_uring_params p;
+    memset (&p, 0, sizeof (p));
+    int fd = syscall (__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+        return NULL;
+
+    lcm_uring_t *ring = (lcm_uring_t *) calloc (1, sizeof (lcm_uring_t));
+    ring->fd = fd;
+    ring->sq_entries = p.sq_entries;
+    ring->sq_ring = ring->cq_ring = ring->sqes = MAP_FAILED;
+    ring->buf_ring = MAP_FAILED;
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    ring->cq_ring_size = p.cq_off.cqes +
+        p.cq_entries * sizeof (struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sq_ring_size = ring->cq_ring_size =
+            MAX (ring->sq_ring_size, ring->cq_ring_size);
+    ring->sq_ring = mmap (NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED)
+        goto fail;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap (NULL, ring->cq_ring_size,
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+    ring->sqes = (struct io_uring_sqe *) mmap (NULL,
+            p.sq_entries * sizeof (struct io_uring_sqe),
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+            IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+        goto fail;
+
+    char *sq = (char *) ring->sq_ring;
+    ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_mask = *(unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ring->sqe_tail = *ring->sq_tail;
+    char *cq = (char *) ring->cq_ring;
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+    // the kernel takes receive buffers from a ring that it shares with us
+    ring->buf_ring_size = nbufs * sizeof (struct io_uring_buf);
+    ring->buf_ring = (struct io_uring_buf_ring *) mmap (NULL,
+            ring->buf_ring_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED)
+        goto fail;
+    struct io_uring_buf_reg reg;
+    memset (&reg, 0, sizeof (reg));
+    reg.ring_addr = (uintptr_t) ring->buf_ring;
+    reg.ring_entries = nbufs;
+    reg.bgid = bgid;
+    if (syscall (__NR_io_uring_register, fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) < 0)
+        goto fail;
+
+    ring->nbufs = nbufs;
+    ring->buf_size = buf_size;
+    ring->bufs = (char *) malloc ((size_t) nbufs * buf_size);
+    for (int bid = 0; bid < nbufs; bid++)
+        lcm_uring_recycle_buf (ring, bid);
+    return ring;
+
+fail:;
+    int err = errno;
+    lcm_uring_destroy (ring);
+    errno = err;
+    return NULL;
+}
+
+void
+lcm_uring_destroy (lcm_uring_t *ring)
+{
+    // closing the ring cancels the requests in flight
+    close (ring->fd);
+    if (ring->sqes != MAP_FAILED)
+        munmap (ring->sqes, ring->sq_entries * sizeof (struct io_uring_sqe));
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+        munmap (ring->cq_ring, ring->cq_ring_size);
+    if (ring->sq_ring != MAP_FAILED)
+        munmap (ring->sq_ring, ring->sq_ring_size);
+    if (ring->buf_ring != MAP_FAILED)
+        munmap (ring->buf_ring, ring->buf_ring_size);
+    free (ring->bufs);
+    free (ring);
+}
+
+struct io_uring_sqe *
+lcm_uring_get_sqe (lcm_uring_t *ring)
+{
+    unsigned head = __atomic_load_n (ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries)
+        return NULL;
+    unsigned idx = ring->sqe_tail & ring->sq_mask;
+    ring->sq_array[idx] = idx;
+    ring->sqe_tail++;
+    ring->to_submit++;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset (sqe, 0, sizeof (*sqe));
+    return sqe;
+}
+
+int
+lcm_uring_submit_and_wait (lcm_uring_t *ring, unsigned wait_nr)
+{
+    __atomic_store_n (ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    int status = syscall (__NR_io_uring_enter, ring->fd, ring->to_submit,
+            wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (status >= 0)
+        ring->to_submit -= status;
+    return status < 0 ? -1 : 0;
+}
+
+struct io_uring_cqe *
+lcm_uring_peek_cqe (lcm_uring_t *ring)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n (ring->cq_tail, __ATOMIC_ACQUIRE))
+        return NULL;
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void
+lcm_uring_cqe_seen (lcm_uring_t *ring)
+{
+    __atomic_store_n (ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+char *
+lcm_uring_buf (lcm_uring_t *ring, int bid)
+{
+    return ring->bufs + (size_t) bid * ring->buf_size;
+}
+
+void
+lcm_uring_recycle_buf (lcm_uring_t *ring, int bid)
+{
+    struct io_uring_buf *buf =
+        &ring->buf_ring->bufs[ring->buf_tail & (ring->nbufs - 1)];
+    buf->addr = (uintptr_t) lcm_uring_buf (ring, bid);
+    // one byte stays free, for a terminating zero after the datagram
+    buf->len = ring->buf_size - 1;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n (&ring->buf_ring->tail, (uint16_t) ring->buf_tail,
+            __ATOMIC_RELEASE);
+}
+#endif
+
+/******************** AF_XDP **********************/
+#ifdef USE_XDP
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <stddef.h>
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_xdp.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// each frame holds one datagram of an interface with the usual MTU.  The
+// kernel puts it after XDP_PACKET_HEADROOM bytes, and a byte is left for the
+// terminating zero.  Longer ones, as on an interface with jumbo frames, are
+// left to the kernel.
+#define XSK_FRAME_SIZE 4096
+#define XSK_MAX_PACKET_LEN (XSK_FRAME_SIZE - XDP_PACKET_HEADROOM - 1)
+
+// the Ethernet, IPv4 and UDP headers of a datagram without IP options
+#define XDP_ETH_LEN 14
+#define XDP_HEADERS_LEN (XDP_ETH_LEN + 20 + 8)
+
+struct _lcm_xdp {
+    int ifindex;
+    int map_fd;     // the XSKMAP, receive queue -> AF_XDP socket
+    int prog_fd;
+    int link_fd;    // the attachment, undone when it is closed
+};
+
+typedef struct _xsk_ring {
+    uint32_t *producer;
+    uint32_t *consumer;
+    void *descs;
+    uint32_t mask;
+    uint32_t cached;   // our own end of the ring
+    void *map;
+    size_t map_size;
+} xsk_ring_t;
+
+struct _lcm_xsk {
+    lcm_xdp_t *xdp;
+    int fd;
+    int queue;
+    char *umem;
+    size_t umem_size;
+    xsk_ring_t rx;      // struct xdp_desc, filled by the kernel
+    xsk_ring_t fill;    // uint64_t frame addresses, filled by us
+};
+
+static int
+_bpf (int cmd, union bpf_attr *attr)
+{
+    return syscall (__NR_bpf, cmd, attr, sizeof (*attr));
+}
+
+static struct bpf_insn
+_insn (uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm)
+{
+    struct bpf_insn insn;
+    memset (&insn, 0, sizeof (insn));
+    insn.code = code;
+    insn.dst_reg = dst;
+    insn.src_reg = src;
+    insn.off = off;
+    insn.imm = imm;
+    return insn;
+}
+
+// Builds the XDP program into prog, and returns its length.  Values loaded
+// from the packet are in network byte order, and compared to constants that
+// are too, except for the port, which is swapped to compare it as a number.
+static int
+_xdp_build_prog (struct bpf_insn *prog, int map_fd, struct in_addr group,
+        uint16_t port_lo, uint16_t port_hi)
+{
+    int n = 0;
+    int pass_jumps[16];
+    int num_pass = 0;
+#define EMIT(code, dst, src, off, imm) \
+    (prog[n++] = _insn (code, dst, src, off, imm))
+#define EMIT_PASS(code, dst, src, imm) \
+    (pass_jumps[num_pass++] = n, EMIT (code, dst, src, 0, imm))
+
+    // r6 = ctx, r2 = data, r3 = data_end
+    EMIT (BPF_ALU64 | BPF_MOV | BPF_X, 6, 1, 0, 0);
+    EMIT (BPF_LDX | BPF_MEM | BPF_W, 2, 6, offsetof (struct xdp_md, data), 0);
+    EMIT (BPF_LDX | BPF_MEM | BPF_W, 3, 6,
+            offsetof (struct xdp_md, data_end), 0);
+    // the headers must be there
+    EMIT (BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0);
+    EMIT (BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, XDP_HEADERS_LEN);
+    EMIT_PASS (BPF_JMP | BPF_JGT | BPF_X, 4, 3, 0);
+    // and fit in a frame
+    EMIT (BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0);
+    EMIT (BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, XSK_MAX_PACKET_LEN);
+    EMIT_PASS (BPF_JMP | BPF_JLT | BPF_X, 4, 3, 0);
+    // IPv4 without options, not a fragment, and UDP
+    EMIT (BPF_LDX | BPF_MEM | BPF_H, 5, 2, 12, 0);
+    EMIT_PASS (BPF_JMP | BPF_JNE | BPF_K, 5, 0, htons (ETH_P_IP));
+    EMIT (BPF_LDX | BPF_MEM | BPF_B, 5, 2, XDP_ETH_LEN, 0);
+    EMIT_PASS (BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0x45);
+    EMIT (BPF_LDX | BPF_MEM | BPF_H, 5, 2, XDP_ETH_LEN + 6, 0);
+    EMIT (BPF_ALU64 | BPF_AND | BPF_K, 5, 0, 0, htons (IP_MF | IP_OFFMASK));
+    EMIT_PASS (BPF_JMP | BPF_JNE | BPF_K, 5, 0, 0);
+    EMIT (BPF_LDX | BPF_MEM | BPF_B, 5, 2, XDP_ETH_LEN + 9, 0);
+    EMIT_PASS (BPF_JMP | BPF_JNE | BPF_K, 5, 0, IPPROTO_UDP);
+    // sent to the group, as the registers are 64 bits and the immediate
+    // operand of a jump is sign extended
+    EMIT (BPF_LDX | BPF_MEM | BPF_W, 5, 2, XDP_ETH_LEN + 16, 0);
+    EMIT (BPF_ALU | BPF_MOV | BPF_K, 4, 0, 0, (int32_t) group.s_addr);
+    EMIT_PASS (BPF_JMP | BPF_JNE | BPF_X, 5, 4, 0);
+    // on one of the ports
+    EMIT (BPF_LDX | BPF_MEM | BPF_H, 5, 2, XDP_ETH_LEN + 20 + 2, 0);
+    EMIT (BPF_ALU | BPF_END | BPF_TO_BE, 5, 0, 0, 16);
+    EMIT_PASS (BPF_JMP | BPF_JLT | BPF_K, 5, 0, port_lo);
+    EMIT_PASS (BPF_JMP | BPF_JGT | BPF_K, 5, 0, port_hi);
+    // return bpf_redirect_map (map, ctx->rx_queue_index, XDP_PASS), which
+    // passes the datagram on if the queue has no socket
+    EMIT (BPF_LDX | BPF_MEM | BPF_W, 2, 6,
+            offsetof (struct xdp_md, rx_queue_index), 0);
+    EMIT (BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd);
+    EMIT (0, 0, 0, 0, 0);
+    EMIT (BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS);
+    EMIT (BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map);
+    EMIT (BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    // everything else goes on to the kernel
+    int pass = n;
+    EMIT (BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS);
+    EMIT (BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    for (int i = 0; i < num_pass; i++)
+        prog[pass_jumps[i]].off = pass - pass_jumps[i] - 1;
+#undef EMIT_PASS
+#undef EMIT
+    return n;
+}
+
+lcm_xdp_t *
+lcm_xdp_attach (const char *ifname, struct in_addr group, uint16_t port_lo,
+        uint16_t port_hi, int num_queues)
+{
+    int ifindex = if_nametoindex (ifname);
+    if (!ifindex)
+        return NULL;
+
+    lcm_xdp_t *xdp = (lcm_xdp_t *) calloc (1, sizeof (lcm_xdp_t));
+    xdp->ifindex = ifindex;
+    xdp->prog_fd = xdp->link_fd = -1;
+
+    union bpf_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof (uint32_t);
+    attr.value_size = sizeof (uint32_t);
+    attr.max_entries = num_queues;
+    xdp->map_fd = _bpf (BPF_MAP_CREATE, &attr);
+    if (xdp->map_fd < 0)
+        goto fail;
+
+    struct bpf_insn prog[40];
+    char log[4096] = "";
+    memset (&attr, 0, sizeof (attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uintptr_t) prog;
+    attr.insn_cnt = _xdp_build_prog (prog, xdp->map_fd, group, port_lo,
+            port_hi);
+    attr.license = (uintptr_t) "LGPL";
+    attr.log_buf = (uintptr_t) log;
+    attr.log_size = sizeof (log);
+    attr.log_level = 1;
+    xdp->prog_fd = _bpf (BPF_PROG_LOAD, &attr);
+    if (xdp->prog_fd < 0) {
+        int err = errno;
+        dbg (DBG_LCM, "the XDP program was rejected:\n%s\n", log);
+        errno = err;
+        goto fail;
+    }
+
+    // in native mode if the driver supports it, and generic mode otherwise
+    memset (&attr, 0, sizeof (attr));
+    attr.link_create.prog_fd = xdp->prog_fd;
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    xdp->link_fd = _bpf (BPF_LINK_CREATE, &attr);
+    if (xdp->link_fd < 0)
+        goto fail;
+    return xdp;
+
+fail:
+    {
+        int err = errno;
+        lcm_xdp_detach (xdp);
+        errno = err;
+    }
+    return NULL;
+}
+
+void
+lcm_xdp_detach (lcm_xdp_t *xdp)
+{
+    if (xdp->link_fd >= 0)
+        close (xdp->link_fd);
+    if (xdp->prog_fd >= 0)
+        close (xdp->prog_fd);
+    if (xdp->map_fd >= 0)
+        close (xdp->map_fd);
+    free (xdp);
+}
+
+static int
+_xsk_map_ring (lcm_xsk_t *xsk, xsk_ring_t *ring,
+        const struct xdp_ring_offset *off, int size, size_t desc_size,
+        off_t pgoff)
+{
+    ring->map_size = off->desc + size * desc_size;
+    ring->map = mmap (NULL, ring->map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, xsk->fd, pgoff);
+    if (ring->map == MAP_FAILED)
+        return -1;
+    ring->producer = (uint32_t *) ((char *) ring->map + off->producer);
+    ring->consumer = (uint32_t *) ((char *) ring->map + off->consumer);
+    ring->descs = (char *) ring->map + off->desc;
+    ring->mask = size - 1;
+    return 0;
+}
+
+lcm_xsk_t *
+lcm_xsk_new (lcm_xdp_t *xdp, int queue, int nframes, int numa_node)
+{
+    lcm_xsk_t *xsk = (lcm_xsk_t *) calloc (1, sizeof (lcm_xsk_t));
+    xsk->xdp = xdp;
+    xsk->queue = queue;
+    xsk->rx.map = xsk->fill.map = MAP_FAILED;
+    xsk->umem = MAP_FAILED;
+    xsk->fd = socket (AF_XDP, SOCK_RAW, 0);
+    if (xsk->fd < 0)
+        goto fail;
+
+    xsk->umem_size = (size_t) nframes * XSK_FRAME_SIZE;
+    xsk->umem = mmap (NULL, xsk->umem_size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | (numa_node < 0 ? MAP_POPULATE : 0),
+            -1, 0);
+    if (xsk->umem == MAP_FAILED)
+        goto fail;
+    if (numa_node >= 0) {
+        // placed before the pages are faulted in and pinned by XDP_UMEM_REG
+        if (lcm_numa_bind (xsk->umem, xsk->umem_size, numa_node) < 0)
+            dbg (DBG_LCM, "could not bind the UMEM to NUMA node %d: %s\n",
+                    numa_node, strerror (errno));
+        memset (xsk->umem, 0, xsk->umem_size);
+    }
+    struct xdp_umem_reg reg;
+    memset (&reg, 0, sizeof (reg));
+    reg.addr = (uintptr_t) xsk->umem;
+    reg.len = xsk->umem_size;
+    reg.chunk_size = XSK_FRAME_SIZE;
+    if (setsockopt (xsk->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof (reg)) < 0)
+        goto fail;
+
+    // the kernel wants a completion ring even though nothing is sent
+    int ring_size = nframes;
+    int comp_size = 64;
+    if (setsockopt (xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size,
+                sizeof (ring_size)) < 0 ||
+            setsockopt (xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING,
+                &comp_size, sizeof (comp_size)) < 0 ||
+            setsockopt (xsk->fd, SOL_XDP, XDP_RX_RING, &ring_size,
+                sizeof (ring_size)) < 0)
+        goto fail;
+
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof (off);
+    if (getsockopt (xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0)
+        goto fail;
+    if (_xsk_map_ring (xsk, &xsk->rx, &off.rx, ring_size,
+                sizeof (struct xdp_desc), XDP_PGOFF_RX_RING) < 0 ||
+            _xsk_map_ring (xsk, &xsk->fill, &off.fr, ring_size,
+                sizeof (uint64_t), XDP_UMEM_PGOFF_FILL_RING) < 0)
+        goto fail;
+
+    // every frame starts out with the kernel
+    uint64_t *fill = (uint64_t *) xsk->fill.descs;
+    for (int i = 0; i < nframes; i++)
+        fill[i] = (uint64_t) i * XSK_FRAME_SIZE;
+    xsk->fill.cached = nframes;
+    __atomic_store_n (xsk->fill.producer, xsk->fill.cached, __ATOMIC_RELEASE);
+
+    struct sockaddr_xdp sxdp;
+    memset (&sxdp, 0, sizeof (sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = xdp->ifindex;
+    sxdp.sxdp_queue_id = queue;
+    if (bind (xsk->fd, (struct sockaddr *) &sxdp, sizeof (sxdp)) < 0)
+        goto fail;
+
+    uint32_t key = queue;
+    uint32_t value = xsk->fd;
+    union bpf_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.map_fd = xdp->map_fd;
+    attr.key = (uintptr_t) &key;
+    attr.value = (uintptr_t) &value;
+    if (_bpf (BPF_MAP_UPDATE_ELEM, &attr) < 0)
+        goto fail;
+    xsk->rx.cached = *xsk->rx.consumer;
+    return xsk;
+
+fail:
+    {
+        int err = errno;
+        lcm_xsk_destroy (xsk);
+        errno = err;
+    }
+    return NULL;
+}
+
+void
+lcm_xsk_destroy (lcm_xsk_t *xsk)
+{
+    if (xsk->fd >= 0) {
+        // the program passes the queue's datagrams on to the kernel again
+        uint32_t key = xsk->queue;
+        union bpf_attr attr;
+        memset (&attr, 0, sizeof (attr));
+        attr.map_fd = xsk->xdp->map_fd;
+        attr.key = (uintptr_t) &key;
+        _bpf (BPF_MAP_DELETE_ELEM, &attr);
+        close (xsk->fd);
+    }
+    if (xsk->rx.map != MAP_FAILED)
+        munmap (xsk->rx.map, xsk->rx.map_size);
+    if (xsk->fill.map != MAP_FAILED)
+        munmap (xsk->fill.map, xsk->fill.map_size);
+    if (xsk->umem != MAP_FAILED)
+        munmap (xsk->umem, xsk->umem_size);
+    free (xsk);
+}
+
+int
+lcm_xsk_fileno (lcm_xsk_t *xsk)
+{
+    return xsk->fd;
+}
+
+// Points dgram at the UDP payload of the Ethernet frame of len bytes at
+// addr.  Returns 0 if it is not a whole IPv4 UDP datagram, or if there is no
+// room after it for the terminating zero.
+static int
+_xsk_parse (lcm_xsk_t *xsk, uint64_t addr, uint32_t len,
+        lcm_xsk_datagram_t *dgram)
+{
+    uint64_t frame = addr & ~(uint64_t) (XSK_FRAME_SIZE - 1);
+    char *pkt = xsk->umem + addr;
+    char *frame_end = xsk->umem + frame + XSK_FRAME_SIZE;
+    dgram->frame = frame;
+    if (len < XDP_HEADERS_LEN)
+        return 0;
+
+    struct iphdr *ip = (struct iphdr *) (pkt + XDP_ETH_LEN);
+    int ip_len = ip->ihl * 4;
+    if (ip->version != 4 || ip->protocol != IPPROTO_UDP || ip_len < 20 ||
+            XDP_ETH_LEN + ip_len + sizeof (struct udphdr) > len)
+        return 0;
+    struct udphdr *udp = (struct udphdr *) (pkt + XDP_ETH_LEN + ip_len);
+    int udp_len = ntohs (udp->len);
+    if (udp_len < (int) sizeof (struct udphdr) ||
+            XDP_ETH_LEN + ip_len + udp_len > len)
+        return 0;
+
+    dgram->data = (char *) (udp + 1);
+    dgram->len = udp_len - sizeof (struct udphdr);
+    if (dgram->data + dgram->len >= frame_end)
+        return 0;
+    dgram->data[dgram->len] = 0;
+    memset (&dgram->from, 0, sizeof (dgram->from));
+    dgram->from.sin_family = AF_INET;
+    dgram->from.sin_addr.s_addr = ip->saddr;
+    dgram->from.sin_port = udp->source;
+    return 1;
+}
+
+int
+lcm_xsk_receive (lcm_xsk_t *xsk, lcm_xsk_datagram_t *dgrams, int max,
+        int *num_bad)
+{
+    uint32_t avail = __atomic_load_n (xsk->rx.producer, __ATOMIC_ACQUIRE) -
+        xsk->rx.cached;
+    const struct xdp_desc *descs = (const struct xdp_desc *) xsk->rx.descs;
+    int n = 0;
+    for (; avail > 0 && n < max; avail--) {
+        const struct xdp_desc *desc = &descs[xsk->rx.cached++ & xsk->rx.mask];
+        if (_xsk_parse (xsk, desc->addr, desc->len, &dgrams[n])) {
+            n++;
+        } else {
+            lcm_xsk_recycle (xsk, dgrams[n].frame);
+            (*num_bad)++;
+        }
+    }
+    __atomic_store_n (xsk->rx.consumer, xsk->rx.cached, __ATOMIC_RELEASE);
+    return n;
+}
+
+void
+lcm_xsk_recycle (lcm_xsk_t *xsk, uint64_t frame)
+{
+    // there is a place in the fill ring for every frame, so it never fills
+    uint64_t *fill = (uint64_t *) xsk->fill.descs;
+    fill[xsk->fill.cached++ & xsk->fill.mask] = frame;
+    __atomic_store_n (xsk->fill.producer, xsk->fill.cached, __ATOMIC_RELEASE);
+}
+#endif
+
+/******************** NUMA placement **********************/
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// from <linux/mempolicy.h>
+#define LCM_MPOL_PREFERRED 1
+#define LCM_MPOL_BIND 2
+#define LCM_MPOL_MF_MOVE (1 << 1)
+
+#define LCM_NUMA_MAX_NODES 1024
+
+// Reads the first line of a sysfs file, without its newline, into buf.
+static int
+_read_sysfs (const char *path, char *buf, int size)
+{
+    FILE *fp = fopen (path, "r");
+    if (!fp)
+        return -1;
+    int status = fgets (buf, size, fp) ? 0 : -1;
+    fclose (fp);
+    if (!status)
+        buf[strcspn (buf, "\n")] = 0;
+    return status;
+}
+
+int
+lcm_numa_node_of_ifname (const char *ifname)
+{
+    char path[256];
+    char buf[32];
+    if (strchr (ifname, '/'))
+        return -1;
+    snprintf (path, sizeof (path), "/sys/class/net/%s/device/numa_node",
+            ifname);
+    if (_read_sysfs (path, buf, sizeof (buf)) < 0)
+        return -1;
+    // -1 for a device that is not closer to any node
+    int node = atoi (buf);
+    return node >= 0 && node < LCM_NUMA_MAX_NODES ? node : -1;
+}
+
+int
+lcm_numa_node_of_route (struct in_addr dest)
+{
+    FILE *fp = fopen ("/proc/net/route", "r");
+    if (!fp)
+        return -1;
+
+    // the most specific route wins
+    char buf[1024];
+    char ifname[64] = "";
+    uint32_t best_mask = 0;
+    int found = 0;
+    if (!fgets (buf, sizeof (buf), fp)) {
+        fclose (fp);
+        return -1;
+    }
+    while (fgets (buf, sizeof (buf), fp)) {
+        gchar **words = g_strsplit (buf, "\t", 0);
+        struct in_addr route, mask;
+        if (g_strv_length (words) == 11 &&
+                _parse_inaddr (words[1], &route) &&
+                _parse_inaddr (words[7], &mask) &&
+                (dest.s_addr & mask.s_addr) == (route.s_addr & mask.s_addr) &&
+                (!found || ntohl (mask.s_addr) > best_mask)) {
+            found = 1;
+            best_mask = ntohl (mask.s_addr);
+            g_strlcpy (ifname, words[0], sizeof (ifname));
+        }
+        g_strfreev (words);
+    }
+    fclose (fp);
+    return found ? lcm_numa_node_of_ifname (ifname) : -1;
+}
+
+char *
+lcm_numa_node_cpus (int node)
+{
+    char path[256];
+    char buf[1024];
+    snprintf (path, sizeof (path), "/sys/devices/system/node/node%d/cpulist",
+            node);
+    if (node < 0 || _read_sysfs (path, buf, sizeof (buf)) < 0 || !buf[0])
+        return NULL;
+    return strdup (buf);
+}
+
+int
+lcm_numa_prefer_node (int node)
+{
+    if (node < 0 || node >= LCM_NUMA_MAX_NODES)
+        return -1;
+    unsigned long mask[LCM_NUMA_MAX_NODES / (8 * sizeof (unsigned long))];
+    memset (mask, 0, sizeof (mask));
+    mask[node / (8 * sizeof (unsigned long))] |=
+        1UL << (node % (8 * sizeof (unsigned long)));
+    return syscall (SYS_set_mempolicy, LCM_MPOL_PREFERRED, mask,
+            (unsigned long) LCM_NUMA_MAX_NODES + 1) < 0 ? -1 : 0;
+}
+
+int
+lcm_numa_bind (void *addr, size_t len, int node)
+{
+    if (node < 0 || node >= LCM_NUMA_MAX_NODES)
+        return -1;
+    unsigned long mask[LCM_NUMA_MAX_NODES / (8 * sizeof (unsigned long))];
+    memset (mask, 0, sizeof (mask));
+    mask[node / (8 * sizeof (unsigned long))] |=
+        1UL << (node % (8 * sizeof (unsigned long)));
+    return syscall (SYS_mbind, addr, len, LCM_MPOL_BIND, mask,
+            (unsigned long) LCM_NUMA_MAX_NODES + 1, LCM_MPOL_MF_MOVE) < 0 ?
+        -1 : 0;
+}
+#else
+int
+lcm_numa_node_of_ifname (const char *ifname)
+{
+    return -1;
+}
+
+int
+lcm_numa_node_of_route (struct in_addr dest)
+{
+    return -1;
+}
+
+char *
+lcm_numa_node_cpus (int node)
+{
+    return NULL;
+}
+
+int
+lcm_numa_prefer_node (int node)
+{
+    return -1;
+}
+
+int
+lcm_numa_bind (void *addr, size_t len, int node)
+{
+    return -1;
+}
+#endif
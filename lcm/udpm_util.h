@@ -30,11 +30,25 @@ typedef int SOCKET;
 #include <glib.h>
 
 #include "lcm.h"
-#include "ringbuffer.h"
+#include "lcm_clock.h"
+#include "bufpool.h"
 
 /************************* Important Defines *******************/
 #define LCM2_MAGIC_SHORT 0x4c433032   // hex repr of ascii "LC02" 
 #define LCM2_MAGIC_LONG  0x4c433033   // hex repr of ascii "LC03" 
+#define LCM2_MAGIC_PARITY 0x4c433034  // hex repr of ascii "LC04"
+#define LCM2_MAGIC_NACK   0x4c433035  // hex repr of ascii "LC05"
+// retransmissions of LC02 and LC03 datagrams, in reply to a NACK
+#define LCM2_MAGIC_SHORT_RETRANSMIT 0x4c433036  // "LC06"
+#define LCM2_MAGIC_LONG_RETRANSMIT  0x4c433037  // "LC07"
+// several short messages packed into one datagram (see the batch_us option).
+// The magic is followed by records, each a 16 bit size in network byte order
+// and that many bytes of an LC02 or LC12 datagram.
+#define LCM2_MAGIC_BATCH            0x4c433038  // "LC08"
+// set in the magic of LC02, LC03, LC06 and LC07 datagrams ("LC12", ...) whose
+// message payload is compressed.  Receivers that do not know these magic
+// numbers discard them.
+#define LCM2_MAGIC_COMPRESSED       0x00000100
 
 #ifdef __APPLE__
 #define LCM_SHORT_MESSAGE_MAX_SIZE 1435
@@ -44,12 +58,35 @@ typedef int SOCKET;
 #define LCM_FRAGMENT_MAX_PAYLOAD 65487
 #endif
 
-#define LCM_RINGBUF_SIZE (200*1024)
+// the IPv4 and UDP headers in front of each LCM datagram
+#define LCM_IP_UDP_HEADER_SIZE 28
+
+// the smallest value of the mtu option.  Every IPv4 link carries this much.
+#define LCM_MIN_MTU 576
+
+// the size of batch datagrams, with their IP and UDP headers, if the mtu
+// option is not set
+#define LCM_BATCH_DEFAULT_MTU 1500
+
+// default cap on the memory used to hold received packets until they are
+// handled
+#define LCM_DEFAULT_RECV_POOL_SIZE (32 * 1024 * 1024)
+
+#define LCM_MAX_UNFRAGMENTED_PACKET_SIZE LCM_BUFPOOL_MAX_ALLOC
 
 #define LCM_DEFAULT_RECV_BUFS 2000
 
+// the most read threads that recv_threads may ask for
+#define LCM_MAX_RECV_THREADS 64
+
 #define MAX_FRAG_BUF_TOTAL_SIZE (1 << 24)// 16 megabytes
 #define MAX_NUM_FRAG_BUFS 1000
+// messages from one sender that may be reassembled at the same time, e.g.,
+// when several threads of a process publish large messages
+#define MAX_FRAG_BUFS_PER_SENDER 4
+// a message being reassembled is dropped once no fragment of it arrived for
+// this long
+#define FRAG_BUF_MAX_AGE_USEC 2000000
 
 // HUGE is not defined on cygwin as of 2008-03-05
 #ifndef HUGE
@@ -83,6 +120,49 @@ typedef struct _lcm2_header_long {
 // ASCII-encoded channel name, followed by the payload data
 // if fragment_no > 0, then header is immediately followed by the payload data
 
+// The largest fec=k:m group
+#define LCM_MAX_FEC_GROUP 255
+
+typedef struct _lcm2_header_parity {
+    uint32_t magic;
+    uint32_t msg_seqno;
+    uint16_t fragments_in_msg;
+    uint16_t first_fragment;
+    uint16_t stride;
+    uint16_t num_covered;
+    uint16_t fragment_size;
+    uint16_t last_fragment_size;
+} lcm2_header_parity_t;
+// A parity packet follows the fragments of a message when forward error
+// correction is enabled.  Its payload is the XOR of the payloads (including
+// the channel name of fragment 0) of the num_covered fragments first_fragment,
+// first_fragment + stride, ..., each padded with zeros to the longest.  Every
+// fragment carries fragment_size bytes of payload except the last, which
+// carries last_fragment_size.  Receivers that do not know this magic number
+// discard the packet.
+
+
+// Unicast by a receiver to a sender to ask for the messages first_seqno
+// through first_seqno + count - 1 again
+typedef struct _lcm2_nack {
+    uint32_t magic;
+    uint32_t first_seqno;
+    uint32_t count;
+} lcm2_nack_t;
+
+// the most messages asked for by one NACK
+#define LCM_MAX_NACK_COUNT 64
+
+// A compressed message payload starts with this header, followed by the
+// message data compressed with the codec.
+typedef struct _lcm2_compress_header {
+    uint32_t raw_size;      // size of the message data before compression
+    uint8_t codec;          // LCM_CODEC_*
+    uint8_t reserved[3];
+} lcm2_compress_header_t;
+
+#define LCM_CODEC_LZ4  1
+#define LCM_CODEC_ZLIB 2
 
 /************************* Utility Functions *******************/
 static inline int
@@ -126,35 +206,31 @@ lcm_timeval_subtract (const GTimeVal *a, const GTimeVal *b, GTimeVal *dest)
     }
 }
 
-static inline int64_t 
-lcm_timestamp_now()
-{
-    GTimeVal tv;
-    g_get_current_time(&tv);
-    return (int64_t) tv.tv_sec * 1000000 + tv.tv_usec;
-}
-
 
 /******************** message buffer **********************/
 typedef struct _lcm_buf {
     char  channel_name[LCM_MAX_CHANNEL_NAME_LENGTH+1];
     int   channel_size;      // length of channel name
+    int   channel_id;        // from lcm_internal_channel_id(), or -1
 
     int64_t recv_utime;      // timestamp of first datagram receipt
+    int64_t recv_time_ns;    // same, in nanoseconds
     char *buf;               // pointer to beginning of message.  This includes
                              // the header for unfragmented messages, and does
                              // not include the header for fragmented messages.
 
     int   data_offset;       // offset to payload
     int   data_size;         // size of payload
-    lcm_ringbuf_t *ringbuf;  // the ringbuffer used to allocate buf.  NULL if
-                             // not allocated from ringbuf
+    lcm_bufpool_t *pool;     // the pool used to allocate buf.  NULL if buf
+                             // was malloc()ed
 
     int   packet_size;       // total bytes received
     int   buf_size;          // bytes allocated
 
     struct sockaddr from;    // sender
     socklen_t fromlen;
+    int   rx_shard;          // index of the receive thread that filled buf
+    uint32_t msg_seqno;      // sequence number of the message
     struct _lcm_buf *next;
 } lcm_buf_t;
 
@@ -171,57 +247,395 @@ lcm_buf_queue_t * lcm_buf_queue_new(void);
 lcm_buf_t * lcm_buf_dequeue(lcm_buf_queue_t * q);
 void lcm_buf_enqueue(lcm_buf_queue_t * q, lcm_buf_t * el);
 
-void lcm_buf_queue_free(lcm_buf_queue_t * q, lcm_ringbuf_t *ringbuf);
+void lcm_buf_queue_free(lcm_buf_queue_t * q);
 int lcm_buf_queue_is_empty(lcm_buf_queue_t * q);
 
-// allocate a lcm_buf from the ringbuf. If there is no more space in the ringbuf
-// it is replaced with a bigger one. In this case, the old ringbuffer will be
-// cleaned up when lcm_buf_free_data() is called;
-lcm_buf_t *
-lcm_buf_allocate_data(lcm_buf_queue_t * inbufs_empty, lcm_ringbuf_t **ringbuf);
+// take a lcm_buf from inbufs_empty, which is refilled if needed.  Its buf is
+// not allocated.
+lcm_buf_t * lcm_buf_allocate(lcm_buf_queue_t * inbufs_empty);
+
+// make sure that lcmb->buf has room for len bytes, the last of which is set
+// to zero.  Returns -1 if the pool is at its memory cap.
+int lcm_buf_allocate_data(lcm_buf_t *lcmb, lcm_bufpool_t *pool,
+        unsigned int len);
+
+// move the first len bytes of lcmb->buf to a smaller buffer of the same pool,
+// if there is one that fits len plus a terminating zero.
+void lcm_buf_shrink_data(lcm_buf_t *lcmb, unsigned int len);
+
+void lcm_buf_free_data(lcm_buf_t *lcmb);
 
-void lcm_buf_free_data(lcm_buf_t *lcmb, lcm_ringbuf_t *ringbuf);
+/******* Lock-free handoff of message buffers between two threads *******/
+
+// must be a power of 2
+#define LCM_BUF_RING_SIZE 2048
+
+// A bounded ring of lcm_buf_t pointers with exactly one producer thread and
+// one consumer thread.  Neither side takes a lock: the producer only writes
+// tail and the consumer only writes head.
+typedef struct _lcm_buf_ring {
+    lcm_buf_t ** slots;
+    unsigned int mask;
+    volatile gint head;      // next slot to pop.  written by the consumer
+    char pad[64];            // keep head and tail on separate cache lines
+    volatile gint tail;      // next slot to push.  written by the producer
+} lcm_buf_ring_t;
+
+// capacity must be a power of 2
+lcm_buf_ring_t * lcm_buf_ring_new(unsigned int capacity);
+// does not free the buffers still in the ring
+void lcm_buf_ring_free(lcm_buf_ring_t * ring);
+
+// Returns 0 on success, or -1 if the ring is full.  Producer only.
+int lcm_buf_ring_push(lcm_buf_ring_t * ring, lcm_buf_t * el);
+// Returns NULL if the ring is empty.  Consumer only.
+lcm_buf_t * lcm_buf_ring_pop(lcm_buf_ring_t * ring);
+int lcm_buf_ring_is_empty(lcm_buf_ring_t * ring);
 
 /******************** fragment buffer **********************/
-typedef struct _lcm_frag_buf {
-    char      channel[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+// A message being reassembled is identified by its sender and sequence number
+typedef struct _lcm_frag_key {
     struct    sockaddr_in from;
+    uint32_t  msg_seqno;
+} lcm_frag_key_t;
+
+typedef struct _lcm_frag_sender lcm_frag_sender_t;
+
+typedef struct _lcm_frag_buf lcm_frag_buf_t;
+struct _lcm_frag_buf {
+    char      channel[LCM_MAX_CHANNEL_NAME_LENGTH+1];
+    int       channel_id;        // of channel, or -1
+    lcm_frag_key_t key;
     char      *data;
     uint32_t  data_size;
+    uint16_t  fragments_in_msg;
     uint16_t  fragments_remaining;
-    uint32_t  msg_seqno;
+    uint8_t   *received;         // bitmap of the fragments received so far
     int64_t   last_packet_utime;
-} lcm_frag_buf_t;
-
+    int64_t   last_packet_time_ns;
+    // nonzero if the message is not wanted, in which case data is NULL and
+    // its fragments are only counted
+    int       ignored;
+    // nonzero if data is a compressed message, to decompress once complete
+    int       compressed;
+
+    // while in a store, the links of its list of all the messages, and of
+    // the list of the sender's messages, both least recently updated first
+    lcm_frag_buf_t *lru_prev, *lru_next;
+    lcm_frag_buf_t *sender_prev, *sender_next;
+    lcm_frag_sender_t *sender;
+};
+
+// channel may be NULL if the first fragment has not arrived yet.
 lcm_frag_buf_t * lcm_frag_buf_new(struct sockaddr_in from, const char *channel,
         uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
         int64_t first_packet_utime);
+// A fragment buffer that holds no data, recording that the remaining
+// fragments of a message nobody subscribes to can be discarded.
+lcm_frag_buf_t * lcm_frag_buf_new_ignored(struct sockaddr_in from,
+        uint32_t msg_seqno, uint32_t data_size, uint16_t nfragments,
+        int64_t first_packet_utime);
 void lcm_frag_buf_destroy(lcm_frag_buf_t *fbuf);
 
+// hashes and compares lcm_frag_key_t, for tables keyed by message
+guint lcm_frag_key_hash(const void *key);
+gboolean lcm_frag_key_equal(const void *a, const void *b);
+
+// Records the arrival of a fragment, and decrements fragments_remaining.
+// Returns 0 without doing so if the fragment was already received, or if
+// fragment_no is out of range.
+int lcm_frag_buf_mark_received(lcm_frag_buf_t *fbuf, uint16_t fragment_no);
+
+static inline int
+lcm_frag_buf_has_fragment(const lcm_frag_buf_t *fbuf, uint16_t fragment_no)
+{
+    return (fbuf->received[fragment_no / 8] >> (fragment_no % 8)) & 1;
+}
+
 
 /******************** fragment buffer store **********************/
+// The messages being reassembled, found by lcm_frag_key_t, and kept in the
+// order they were last updated in so that the stalest one is always at hand
+// to evict or expire.
 typedef struct _lcm_frag_buf_store {
     uint32_t total_size;
+    uint32_t peak_total_size;   // the most that total_size has been
     uint32_t max_total_size;
     uint32_t max_n_frag_bufs;
+    int64_t max_age_usec;       // see lcm_frag_buf_store_expire(), or 0
     GHashTable *frag_bufs;
+    GHashTable *senders;        // struct sockaddr_in* -> lcm_frag_sender_t
+    lcm_frag_buf_t *lru_head;   // least recently updated
+    lcm_frag_buf_t *lru_tail;
 } lcm_frag_buf_store;
 
 lcm_frag_buf_store * lcm_frag_buf_store_new(uint32_t max_total_size,
         uint32_t max_n_frag_bufs);
 void lcm_frag_buf_store_destroy(lcm_frag_buf_store * store);
 lcm_frag_buf_t * lcm_frag_buf_store_lookup(lcm_frag_buf_store * store,
-        struct sockaddr* key);
+        struct sockaddr* from, uint32_t msg_seqno);
 
 void lcm_frag_buf_store_remove(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
-void lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
 
+// Adds a fragment buffer, first evicting the least recently updated ones if
+// the store is full or the sender already has MAX_FRAG_BUFS_PER_SENDER
+// messages in progress.  Returns the number of incomplete messages evicted.
+int lcm_frag_buf_store_add(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
+
+// Frees the data of a message nobody subscribes to.  Its remaining fragments
+// are still recognized and discarded.
+void lcm_frag_buf_store_ignore(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf);
+
+// Records that a fragment of the message arrived at packet_utime and
+// packet_time_ns, which makes it the most recently updated one.
+void lcm_frag_buf_store_touch(lcm_frag_buf_store *store, lcm_frag_buf_t *fbuf,
+        int64_t packet_utime, int64_t packet_time_ns);
+
+// Drops the messages that no fragment arrived for in the last max_age_usec
+// microseconds before now_utime, and returns how many of those were
+// incomplete messages that somebody wanted.  Only looks at the stale ones,
+// so it can be called for every datagram.
+int lcm_frag_buf_store_expire(lcm_frag_buf_store *store, int64_t now_utime);
+
+
+/******************** sequence tracking **********************/
+// Follows the msg_seqno of each sender to count the messages lost, reordered
+// or duplicated on the way.
+typedef struct _lcm_seq_tracker lcm_seq_tracker_t;
+
+// if count_gaps is 0, skipped sequence numbers are not counted as lost.
+lcm_seq_tracker_t * lcm_seq_tracker_new (int count_gaps);
+void lcm_seq_tracker_destroy (lcm_seq_tracker_t *tracker);
+void lcm_seq_tracker_set_count_gaps (lcm_seq_tracker_t *tracker,
+        int count_gaps);
+
+// Accounts for one datagram from @from, and updates the num_lost,
+// num_reordered, num_duplicated and num_senders fields of @stats.
+// @is_fragment is nonzero if the datagram is a fragment of a larger message,
+// in which case it shares its sequence number with the other fragments.
+// Returns the number of sequence numbers skipped just before @msg_seqno,
+// whether or not they are counted as lost, or -1 if @msg_seqno was already
+// received.
+int lcm_seq_tracker_update (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno, int is_fragment,
+        int64_t utime, lcm_transport_stats_t *stats);
+
+// Records that all the fragments of the message @msg_seqno from @from
+// arrived, so that copies of them that come later can be told apart from the
+// fragments of a message in progress.  Only the most recent sequence numbers
+// of each sender are remembered.
+void lcm_seq_tracker_set_complete (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno);
+int lcm_seq_tracker_is_complete (lcm_seq_tracker_t *tracker,
+        const struct sockaddr_in *from, uint32_t msg_seqno);
+
+/******************** datagram sizes **********************/
+// The largest message payload (channel, its terminating zero and data) sent
+// in a single datagram, and the payload of each fragment of larger messages,
+// on a network with the given @mtu, so that IP never has to fragment them.
+// If @mtu is 0, or larger than a UDP datagram can be, these are
+// LCM_SHORT_MESSAGE_MAX_SIZE and LCM_FRAGMENT_MAX_PAYLOAD.  Receivers
+// accept fragments of any size.
+int lcm_short_message_max_size (int mtu);
+int lcm_fragment_max_payload (int mtu);
+
+/******************** compression **********************/
+// Returns the LCM_CODEC_* value named @name ("lz4" or "zlib"), 0 if there is
+// no such codec, or -1 if LCM was built without it.
+int lcm_codec_from_name (const char *name);
+
+// Compresses @len bytes of @data with @codec into a newly malloc()ed buffer
+// that starts with an lcm2_compress_header_t.  Returns the size of the
+// buffer, or -1 if compression failed or would not make the message smaller.
+int lcm_compress_payload (int codec, const void *data, uint32_t len,
+        char **compressed);
+
+// Decompresses a payload made by lcm_compress_payload into a newly
+// malloc()ed buffer.  Returns the size of the message data, or -1 if the
+// payload is malformed or its codec is not available.
+int lcm_decompress_payload (const void *payload, uint32_t len, char **data);
+
+/******************** fragment pacing **********************/
+// Token bucket that limits the rate at which fragments of large messages are
+// transmitted, so that a burst of fragments does not overrun the receivers'
+// socket buffers.
+typedef struct _lcm_pacer {
+    double   rate;        // bytes per microsecond.  0 disables pacing.
+    double   burst;       // bucket size, in bytes
+    double   tokens;      // bytes that may be sent right away.  May be
+                          // negative after sending more than the bucket holds.
+    int64_t  last_utime;  // when tokens was last refilled
+} lcm_pacer_t;
+
+// The default burst size, used if only a rate is given
+#define LCM_DEFAULT_PACING_BURST_KB 256
+
+void lcm_pacer_init(lcm_pacer_t *pacer, double max_rate_mbps, int burst_kb);
+
+// Blocks until @nbytes may be transmitted, and accounts for them.  Returns
+// immediately if pacing is disabled.
+void lcm_pacer_wait(lcm_pacer_t *pacer, int nbytes);
+
+/******************** fault injection **********************/
+// Drops, duplicates and reorders transmitted datagrams at random, to test how
+// receivers cope with a bad network.  Enabled with the drop_rate, dup_rate
+// and reorder_rate provider options, which are probabilities per datagram.
+// A reordered datagram is held back and transmitted right after the next
+// one.
+typedef struct _lcm_fault_params {
+    double drop_rate;
+    double dup_rate;
+    double reorder_rate;
+    unsigned int seed;        // fault_seed option.  0 picks one at random.
+} lcm_fault_params_t;
+
+// Parses the provider option @key if it is one of the fault options above.
+// Returns 1 if it was, and 0 otherwise.
+int lcm_fault_params_parse (lcm_fault_params_t *params, const char *key,
+        const char *value);
+
+// Nonzero if @params inject any faults
+int lcm_fault_params_enabled (const lcm_fault_params_t *params);
+
+// The faults injected on one socket.  Not thread safe: each one must only be
+// used by one thread at a time, e.g. under the lock of its socket.
+typedef struct _lcm_fault_injector {
+    lcm_fault_params_t params;
+    uint64_t rand_state;
+    // the datagram held back, if held_size >= 0
+    char *held;
+    int held_size;
+    int held_capacity;
+    struct sockaddr_in held_to;
+} lcm_fault_injector_t;
+
+// Returns a new injector, or NULL if @params inject no faults.  Injectors
+// created with the same @params and @stream make the same decisions, unless
+// the seed is 0.
+lcm_fault_injector_t * lcm_fault_injector_new (
+        const lcm_fault_params_t *params, unsigned int stream);
+void lcm_fault_injector_destroy (lcm_fault_injector_t *faults);
+
+// Like sendmsg(), but drops, duplicates or holds back the datagram as the
+// injector decides.  Dropped and held back datagrams count as sent.
+int lcm_fault_sendmsg (lcm_fault_injector_t *faults, SOCKET fd,
+        const struct msghdr *msg);
 
 /************************* Linux Specific Functions *******************/
 #ifdef __linux__
 void linux_check_routing_table(struct in_addr lcm_mcaddr);
 #endif
 
+/******************** io_uring **********************/
+// A minimal io_uring, made with the system calls directly, with one ring of
+// provided buffers for received datagrams.  Only built with
+// LCM_ENABLE_IO_URING, and with kernel headers recent enough for multishot
+// recvmsg.
+#ifdef LCM_ENABLE_IO_URING
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define USE_IO_URING
+
+typedef struct _lcm_uring lcm_uring_t;
+
+// Creates a ring with room for @entries submissions, and @nbufs receive
+// buffers of @buf_size bytes in buffer group @bgid.  @nbufs must be a power
+// of 2.  Returns NULL, with errno set, if the kernel does not support it.
+lcm_uring_t * lcm_uring_new (unsigned entries, int bgid, int nbufs,
+        int buf_size);
+void lcm_uring_destroy (lcm_uring_t *ring);
+
+// Returns a zeroed submission, or NULL if the submission queue is full.
+struct io_uring_sqe * lcm_uring_get_sqe (lcm_uring_t *ring);
+
+// Submits the pending submissions, and waits for at least @wait_nr
+// completions.  Returns -1 with errno set on error.
+int lcm_uring_submit_and_wait (lcm_uring_t *ring, unsigned wait_nr);
+
+// Returns the next completion, or NULL if there is none.  Each one must be
+// marked seen before the next is peeked.
+struct io_uring_cqe * lcm_uring_peek_cqe (lcm_uring_t *ring);
+void lcm_uring_cqe_seen (lcm_uring_t *ring);
+
+// The receive buffer that the kernel picked for a completion, and giving it
+// back once its datagram is processed.
+char * lcm_uring_buf (lcm_uring_t *ring, int bid);
+void lcm_uring_recycle_buf (lcm_uring_t *ring, int bid);
+#endif
+#endif
+
+// AF_XDP receive sockets, made with the system calls directly.  An XDP
+// program on the network interface redirects the IPv4 UDP datagrams sent to
+// a multicast group and range of ports to the AF_XDP socket of the receive
+// queue they arrive on, and passes everything else on to the kernel.  Only
+// built with LCM_ENABLE_XDP.
+#ifdef LCM_ENABLE_XDP
+#define USE_XDP
+
+typedef struct _lcm_xdp lcm_xdp_t;
+typedef struct _lcm_xsk lcm_xsk_t;
+
+// A datagram received on an AF_XDP socket.  data points into the frame
+// holding it, and is followed by a terminating zero.
+typedef struct _lcm_xsk_datagram {
+    uint64_t frame;
+    char *data;
+    int len;
+    struct sockaddr_in from;
+} lcm_xsk_datagram_t;
+
+// Attaches the XDP program to interface @ifname, for the datagrams sent to
+// @group on ports @port_lo to @port_hi, in host byte order.  Receive queues
+// 0 to @num_queues - 1 can have a socket.  Returns NULL, with errno set, if
+// the program could not be loaded or attached.  It is detached again by
+// lcm_xdp_detach, or when the process exits.
+lcm_xdp_t * lcm_xdp_attach (const char *ifname, struct in_addr group,
+        uint16_t port_lo, uint16_t port_hi, int num_queues);
+void lcm_xdp_detach (lcm_xdp_t *xdp);
+
+// Opens an AF_XDP socket on receive queue @queue, with @nframes frames of
+// UMEM, a power of 2, to receive into.  Returns NULL, with errno set, on
+// failure.  If @numa_node is not -1, the UMEM comes from that NUMA node.  A
+// socket is only used by one thread at a time.
+lcm_xsk_t * lcm_xsk_new (lcm_xdp_t *xdp, int queue, int nframes,
+        int numa_node);
+void lcm_xsk_destroy (lcm_xsk_t *xsk);
+
+// The descriptor to poll for received datagrams.
+int lcm_xsk_fileno (lcm_xsk_t *xsk);
+
+// Takes up to @max of the datagrams received so far, without blocking, and
+// returns how many it did.  Frames that do not hold a whole IPv4 UDP datagram
+// are given back right away and counted in *@num_bad.  Each datagram's frame
+// must be given back with lcm_xsk_recycle once it is processed.
+int lcm_xsk_receive (lcm_xsk_t *xsk, lcm_xsk_datagram_t *dgrams, int max,
+        int *num_bad);
+void lcm_xsk_recycle (lcm_xsk_t *xsk, uint64_t frame);
+#endif
+
+// NUMA placement of the receive path, with sysfs and the system calls
+// directly.  Nodes are numbered as in /sys/devices/system/node.  Where NUMA
+// is not supported, these fail with -1 or NULL.
+
+// Returns the node that network interface @ifname is attached to, or -1 if
+// it is not closer to any node.
+int lcm_numa_node_of_ifname (const char *ifname);
+
+// Returns the node of the interface that the kernel routes @dest through.
+int lcm_numa_node_of_route (struct in_addr dest);
+
+// Returns the CPUs of @node as a malloc()ed list such as "0-7,16-23", as
+// lcm_set_thread_scheduling() takes them.
+char * lcm_numa_node_cpus (int node);
+
+// Has the memory that the calling thread faults in from now on come from
+// @node, as long as it has any free.
+int lcm_numa_prefer_node (int node);
+
+// Moves the pages of [@addr, @addr + @len) to @node, and has the ones still
+// to be faulted in come from there.  @addr must be page aligned.
+int lcm_numa_bind (void *addr, size_t len, int node);
+
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,5 @@
 
-#define		_WIN32_WINNT		0x0501
+#define		_WIN32_WINNT		0x0600
 #include	<winsock2.h>
 #include	<Mswsock.h>
 #include	<stdio.h>
@@ -17,6 +17,9 @@ extern "C"
 {
 GUID WSARecvMsg_GUID = WSAID_WSARECVMSG;
 LPFN_WSARECVMSG WSARecvMsg = NULL;
+GUID WSASendMsg_GUID = WSAID_WSASENDMSG;
+LPFN_WSASENDMSG WSASendMsg = NULL;
+volatile LONG WSASendMsg_looked_up = 0;
 
 
 int inet_aton(const char *cp, struct in_addr *inp)
@@ -216,6 +219,54 @@ size_t sendmsg ( SOCKET s, const struct msghdr *msg, int flags )
 	return nWritten;
 }
 
+//	Sends the datagrams of msgvec one after another with WSASendMsg, where it
+//	exists (Vista and later), and WSASendTo otherwise.  Like sendmmsg on Linux,
+//	returns the number of datagrams sent, or -1 if the first one failed.
+int sendmmsg ( SOCKET s, struct mmsghdr *msgvec, unsigned int vlen, int flags )
+{
+DWORD		nWritten, status;
+unsigned int	i;
+
+	if ( !InterlockedCompareExchange ( &WSASendMsg_looked_up, 1, 0 ) )
+	{
+		LPFN_WSASENDMSG fn = NULL;
+		status = WSAIoctl ( s, SIO_GET_EXTENSION_FUNCTION_POINTER,
+							&WSASendMsg_GUID, sizeof WSASendMsg_GUID,
+							&fn, sizeof fn, &nWritten, NULL, NULL );
+		if ( status != SOCKET_ERROR )
+			InterlockedExchangePointer ( (PVOID volatile *) &WSASendMsg, fn );
+	}
+
+	for ( i = 0; i < vlen; i++ )
+	{
+		struct msghdr *msg = &msgvec[i].msg_hdr;
+		if ( WSASendMsg != NULL )
+		{
+			WSAMSG wsamsg;
+			wsamsg.name = msg->msg_name;
+			wsamsg.namelen = msg->msg_namelen;
+			wsamsg.lpBuffers = (LPWSABUF) msg->msg_iov;
+			wsamsg.dwBufferCount = msg->msg_iovlen;
+			wsamsg.Control.len = 0;
+			wsamsg.Control.buf = NULL;
+			wsamsg.dwFlags = 0;
+			status = WSASendMsg ( s, &wsamsg, 0, &nWritten, NULL, NULL );
+		}
+		else
+		{
+			status = WSASendTo ( s, (WSABUF *) msg->msg_iov, msg->msg_iovlen,
+				&nWritten, 0, msg->msg_name, msg->msg_namelen, NULL, NULL );
+		}
+		if ( status != 0 )
+		{
+			errno = WSAGetLastError();
+			return i ? (int) i : -1;
+		}
+		msgvec[i].msg_len = nWritten;
+	}
+	return (int) vlen;
+}
+
 int gettimeofday(struct timeval *tv, struct timezone *tz)		// tz is not used in any lcm code
 {
 
@@ -50,6 +50,12 @@ typedef struct msghdr
     ULONG           msg_flags;
 } msghdr;
 
+struct mmsghdr
+{
+    struct msghdr   msg_hdr;
+    unsigned int    msg_len;
+};
+
 int inet_aton(const char *cp, struct in_addr *inp);
 
 int    __declspec(dllexport) lcm_internal_pipe_create ( int filedes[2] );
@@ -61,6 +67,7 @@ int __declspec(dllexport) fcntl (int fd, int flag1, ...);
 
 size_t recvmsg ( SOCKET s, struct msghdr *msg, int flags );
 size_t sendmsg ( SOCKET s, const struct msghdr *msg, int flags );
+int sendmmsg ( SOCKET s, struct mmsghdr *msgvec, unsigned int vlen, int flags );
 
 #ifdef __cplusplus
 }
@@ -23,6 +23,7 @@
 
 // flags for emit_c_array_loops_start
 #define FLAG_EMIT_MALLOCS 1
+#define FLAG_EMIT_ARENA_ALLOCS 4
 
 // flags for emit_c_array_loops_end
 #define FLAG_EMIT_FREES   2
@@ -91,6 +92,9 @@ void setup_c_options(getopt_t *gopt)
     getopt_add_string (gopt, 0, "cinclude",   "",       "Generated #include lines reference this folder");
     getopt_add_bool   (gopt, 0, "c-no-pubsub",   0,     "Do not generate _publish and _subscribe functions");
     getopt_add_bool   (gopt, 0, "c-typeinfo",   0,      "Generate typeinfo functions for each type");
+    getopt_add_bool   (gopt, 0, "c-views",      0,      "Generate zero-copy views of encoded messages");
+    getopt_add_bool   (gopt, 0, "c-decode-fields", 0,   "Generate functions that decode only some members");
+    getopt_add_bool   (gopt, 0, "c-registry",   0,      "Generate a registry of the types of each package, by fingerprint");
 }
 
 /** Emit output that is common to every header file **/
@@ -199,6 +203,19 @@ static void emit_header_struct(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
         emit(0, "");
     }
 
+    int fixed_size = lcm_struct_fixed_encoded_size(ls);
+    if (fixed_size >= 0) {
+        emit(0, "/**");
+        emit(0, " * %s has no strings, nested types or variable-length arrays, so every", tn_);
+        emit(0, " * message of it is encoded in %s_ENCODED_SIZE bytes, starting with", tn_upper);
+        emit(0, " * %s_FINGERPRINT.", tn_upper);
+        emit(0, " */");
+        emit(0, "#define %s_ENCODED_SIZE %d", tn_upper, fixed_size + 8);
+        emit(0, "#define %s_FINGERPRINT ((int64_t) 0x%016"PRIx64"ULL)", tn_upper,
+             lcm_struct_fingerprint(ls));
+        emit(0, "");
+    }
+
     // define the struct
     emit_comment(f, 0, ls->comment);
     emit(0, "typedef struct _%s %s;", tn_, tn_);
@@ -264,7 +281,8 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
         emit(0, "");
         emit(0, "/**");
         emit(0, " * Prototype for a callback function invoked when a message of type");
-        emit(0, " * %s is received.", tn_);
+        emit(0, " * %s is received.  @p msg and its arrays are only valid until the", tn_);
+        emit(0, " * callback returns; use %s_copy() to keep it.", tn_);
         emit(0, " */");
         emit(0,"typedef void(*%s_handler_t)(const lcm_recv_buf_t *rbuf,\n"
                "             const char *channel, const %s *msg, void *userdata);",
@@ -350,6 +368,22 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(0,"%sint %s_decode_cleanup(%s *p);", xd_, tn_, tn_);
     emit(0, "");
     emit(0, "/**");
+    emit(0, " * Decode a message of type %s from binary form, like %s_decode(),", tn_, tn_);
+    emit(0, " * but allocate the strings and variable-length arrays of the message from");
+    emit(0, " * @p arena.  Do not call %s_decode_cleanup() on the message; its memory is", tn_);
+    emit(0, " * released with lcm_arena_reset() or lcm_arena_free().");
+    emit(0, " *");
+    emit(0, " * @param buf The buffer containing the encoded message");
+    emit(0, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(0, " * @param maxlen The maximum number of bytes to read while decoding.");
+    emit(0, " * @param msg Output parameter where the decoded message is stored");
+    emit(0, " * @param arena The arena to allocate from.");
+    emit(0, " * @return The number of bytes decoded, or <0 if an error occured.");
+    emit(0, " */");
+    emit(0,"%sint %s_decode_arena(const void *buf, int offset, int maxlen, %s *msg, lcm_arena_t *arena);",
+         xd_, tn_, tn_);
+    emit(0, "");
+    emit(0, "/**");
     emit(0, " * Check how many bytes are required to encode a message of type %s", tn_);
     emit(0, " */");
     emit(0,"%sint %s_encoded_size(const %s *p);", xd_, tn_, tn_);
@@ -367,6 +401,8 @@ static void emit_header_prototypes(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(0,"%sint __%s_encode_array(void *buf, int offset, int maxlen, const %s *p, int elements);", xd_, tn_, tn_);
     emit(0,"%sint __%s_decode_array(const void *buf, int offset, int maxlen, %s *p, int elements);", xd_, tn_, tn_);
     emit(0,"%sint __%s_decode_array_cleanup(%s *p, int elements);", xd_, tn_, tn_);
+    emit(0,"%sint __%s_decode_array_arena(const void *buf, int offset, int maxlen, %s *p, int elements, lcm_arena_t *arena);",
+         xd_, tn_, tn_);
     emit(0,"%sint __%s_encoded_array_size(const %s *p, int elements);", xd_, tn_, tn_);
     emit(0,"%sint __%s_clone_array(const %s *p, %s *q, int elements);", xd_, tn_, tn_, tn_);
     emit(0,"");
@@ -378,6 +414,24 @@ static void emit_c_struct_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     char *tn  = ls->structname->lctypename;
     char *tn_ = dots_to_underscores(tn);
 
+    if (lcm_struct_fixed_encoded_size(ls) >= 0) {
+        // no members with hashes of their own
+        char *tn_upper = g_ascii_strup(tn_, -1);
+        emit(0, "uint64_t __%s_hash_recursive(const __lcm_hash_ptr *p)", tn_);
+        emit(0, "{");
+        emit(1,     "(void) p;");
+        emit(1,     "return (uint64_t) %s_FINGERPRINT;", tn_upper);
+        emit(0, "}");
+        emit(0, "");
+        emit(0, "int64_t __%s_get_hash(void)", tn_);
+        emit(0, "{");
+        emit(1,     "return %s_FINGERPRINT;", tn_upper);
+        emit(0, "}");
+        emit(0, "");
+        g_free(tn_upper);
+        return;
+    }
+
     emit(0, "static int __%s_hash_computed;", tn_);
     emit(0, "static uint64_t __%s_hash;", tn_);
     emit(0, "");
@@ -419,6 +473,25 @@ static void emit_c_struct_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0, "");
 }
 
+static int is_enum_type(lcmgen_t *lcm, const char *t)
+{
+    for (unsigned int i = 0; i < g_ptr_array_size(lcm->enums); i++) {
+        lcm_enum_t *le = (lcm_enum_t *) g_ptr_array_index(lcm->enums, i);
+        if (!strcmp(le->enumname->lctypename, t))
+            return 1;
+    }
+    return 0;
+}
+
+// The encoded size of the members of type t, or 0 if it varies, as for
+// strings and structs
+static int view_element_size(lcmgen_t *lcm, const char *t)
+{
+    if (is_enum_type(lcm, t))
+        return 4;
+    return lcm_primitive_encoded_size(t);
+}
+
 // Create an accessor for member lm, whose name is "n". For arrays,
 // the dim'th dimension is accessed. E.g., dim=0 will have no
 // additional brackets, dim=1 has [a], dim=2 has [a][b].
@@ -455,11 +528,20 @@ static char *make_array_size(lcm_member_t *lm, const char *n, int dim)
     return NULL;
 }
 
-static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags)
+// Emits the loops over all but the last dimension of member lm, starting at
+// the given indent
+static void emit_c_array_loops_start_at(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags,
+                                        int indent)
 {
     if (g_ptr_array_size(lm->dimensions) == 0)
         return;
 
+    const char *alloc = "lcm_malloc(";
+    if (flags & FLAG_EMIT_ARENA_ALLOCS) {
+        flags |= FLAG_EMIT_MALLOCS;
+        alloc = "lcm_arena_alloc(arena, ";
+    }
+
     for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions) - 1; i++) {
         char var = 'a' + i;
 
@@ -470,49 +552,62 @@ static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, c
                 stars[s+1] = 0;
             }
 
-            emit(2+i, "%s = (%s%s*) lcm_malloc(sizeof(%s%s) * %s);",
+            emit(indent+i, "%s = (%s%s*) %ssizeof(%s%s) * %s);",
                  make_accessor(lm, n, i),
                  map_type_name(lm->type->lctypename),
                  stars,
+                 alloc,
                  map_type_name(lm->type->lctypename),
                  stars,
                  make_array_size(lm, n, i));
         }
 
-        emit(2+i, "{ int %c;", var);
-        emit(2+i, "for (%c = 0; %c < %s; %c++) {", var, var, make_array_size(lm, "p", i), var);
+        emit(indent+i, "{ int %c;", var);
+        emit(indent+i, "for (%c = 0; %c < %s; %c++) {", var, var, make_array_size(lm, "p", i), var);
     }
 
     if (flags & FLAG_EMIT_MALLOCS) {
-        emit(2 + g_ptr_array_size(lm->dimensions) - 1, "%s = (%s*) lcm_malloc(sizeof(%s) * %s);",
+        emit(indent + g_ptr_array_size(lm->dimensions) - 1, "%s = (%s*) %ssizeof(%s) * %s);",
              make_accessor(lm, n, g_ptr_array_size(lm->dimensions) - 1),
              map_type_name(lm->type->lctypename),
+             alloc,
              map_type_name(lm->type->lctypename),
              make_array_size(lm, n, g_ptr_array_size(lm->dimensions) - 1));
     }
 }
 
-static void emit_c_array_loops_end(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags)
+static void emit_c_array_loops_end_at(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags,
+                                      int indent)
 {
     if (g_ptr_array_size(lm->dimensions) == 0)
         return;
 
     for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions) - 1; i++) {
-        int indent = g_ptr_array_size(lm->dimensions) - i;
+        int level = indent - 2 + g_ptr_array_size(lm->dimensions) - i;
         if (flags & FLAG_EMIT_FREES) {
             char *accessor =  make_accessor(lm, "p", g_ptr_array_size(lm->dimensions) - 1 - i);
-            emit(indent+1, "if (%s) free(%s);", accessor, accessor);
+            emit(level+1, "if (%s) free(%s);", accessor, accessor);
         }
-        emit(indent, "}");
-        emit(indent, "}");
+        emit(level, "}");
+        emit(level, "}");
     }
 
     if (flags & FLAG_EMIT_FREES) {
         char *accessor = make_accessor(lm, "p", 0);
-        emit(2, "if (%s) free(%s);", accessor, accessor);
+        emit(indent, "if (%s) free(%s);", accessor, accessor);
     }
 }
 
+static void emit_c_array_loops_start(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags)
+{
+    emit_c_array_loops_start_at(lcm, f, lm, n, flags, 2);
+}
+
+static void emit_c_array_loops_end(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *n, int flags)
+{
+    emit_c_array_loops_end_at(lcm, f, lm, n, flags, 2);
+}
+
 static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     char *tn = ls->structname->lctypename;
@@ -521,6 +616,39 @@ static void emit_c_encode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0,"int __%s_encode_array(void *buf, int offset, int maxlen, const %s *p, int elements)", tn_, tn_);
     emit(0,"{");
     emit(1,    "int pos = 0, element;");
+
+    // Messages of fixed size are checked against maxlen once, instead of
+    // member by member
+    int fixed_size = lcm_struct_fixed_encoded_size(ls);
+    if (fixed_size > 0) {
+        emit(0,"");
+        emit(1,    "if ((int64_t) elements * %d > maxlen) return -1;", fixed_size);
+        emit(0,"");
+        emit(1,    "for (element = 0; element < elements; element++) {");
+        emit(0,"");
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+            int ndim = g_ptr_array_size(lm->dimensions);
+            char *count = make_array_size(lm, "p", ndim - 1);
+            int size = view_element_size(lcm, lm->type->lctypename) * atoi(count);
+
+            emit_c_array_loops_start(lcm, f, lm, "p", FLAG_NONE);
+            int indent = 2+imax(0, ndim - 1);
+            emit(indent, "__%s_encode_array(buf, offset + pos, %d, %s, %s);",
+                 dots_to_underscores (lm->type->lctypename), size,
+                 make_accessor(lm, "p", ndim - 1), count);
+            emit(indent, "pos += %d;", size);
+            emit_c_array_loops_end(lcm, f, lm, "p", FLAG_NONE);
+            emit(0,"");
+            g_free(count);
+        }
+        emit(1,   "}");
+        emit(1, "return pos;");
+        emit(0,"}");
+        emit(0,"");
+        return;
+    }
+
     if (g_ptr_array_size(ls->members) > 0) {
         emit(1, "int thislen;");
     }
@@ -570,30 +698,48 @@ static void emit_c_encode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0,"");
 }
 
-static void emit_c_decode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+// Emits the decoding of member lm of p[element] at the given indent,
+// allocated from arena if arena is set
+static void emit_c_decode_member(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, int arena, int base)
+{
+    emit_c_array_loops_start_at(lcm, f, lm, "p", lcm_is_constant_size_array(lm) ? FLAG_NONE :
+                                arena ? FLAG_EMIT_ARENA_ALLOCS : FLAG_EMIT_MALLOCS, base);
+
+    int indent = base+imax(0, g_ptr_array_size(lm->dimensions) - 1);
+    emit(indent, "thislen = __%s_decode_array%s(buf, offset + pos, maxlen - pos, %s, %s%s);",
+         dots_to_underscores (lm->type->lctypename),
+         arena ? "_arena" : "",
+         make_accessor(lm, "p", g_ptr_array_size(lm->dimensions) - 1),
+         make_array_size(lm, "p", g_ptr_array_size(lm->dimensions) - 1),
+         arena ? ", arena" : "");
+    emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+
+    emit_c_array_loops_end_at(lcm, f, lm, "p", FLAG_NONE, base);
+}
+
+// Emits __<type>_decode_array(), or with arena __<type>_decode_array_arena(),
+// which allocates from an lcm_arena_t instead of with lcm_malloc()
+static void emit_c_decode_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, int arena)
 {
     char *tn = ls->structname->lctypename;
     char *tn_ = dots_to_underscores(tn);
+    const char *suffix = arena ? "_arena" : "";
 
-    emit(0,"int __%s_decode_array(const void *buf, int offset, int maxlen, %s *p, int elements)", tn_, tn_);
+    emit(0,"int __%s_decode_array%s(const void *buf, int offset, int maxlen, %s *p, int elements%s)",
+         tn_, suffix, tn_, arena ? ", lcm_arena_t *arena" : "");
     emit(0,"{");
-    emit(1,    "int pos = 0, thislen, element;");
+    // a type with only constants decodes nothing
+    if (g_ptr_array_size(ls->members))
+        emit(1,    "int pos = 0, thislen, element;");
+    else
+        emit(1,    "int pos = 0, element;");
     emit(0,"");
     emit(1,    "for (element = 0; element < elements; element++) {");
     emit(0,"");
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
 
-        emit_c_array_loops_start(lcm, f, lm, "p", lcm_is_constant_size_array(lm) ? FLAG_NONE : FLAG_EMIT_MALLOCS);
-
-        int indent = 2+imax(0, g_ptr_array_size(lm->dimensions) - 1);
-        emit(indent, "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, %s, %s);",
-             dots_to_underscores (lm->type->lctypename),
-             make_accessor(lm, "p", g_ptr_array_size(lm->dimensions) - 1),
-             make_array_size(lm, "p", g_ptr_array_size(lm->dimensions) - 1));
-        emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
-
-        emit_c_array_loops_end(lcm, f, lm, "p", FLAG_NONE);
+        emit_c_decode_member(lcm, f, lm, arena, 2);
         emit(0,"");
     }
     emit(1,   "}");
@@ -615,15 +761,27 @@ static void emit_c_decode_array_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
 
-        emit_c_array_loops_start(lcm, f, lm, "p", FLAG_NONE);
+        // variable-length arrays are NULL if they were not decoded, as by
+        // <type>_decode_fields()
+        int base = 2;
+        if (!lcm_is_constant_size_array(lm)) {
+            char *accessor = make_accessor(lm, "p", 0);
+            emit(2, "if (%s) {", accessor);
+            free(accessor);
+            base = 3;
+        }
+        emit_c_array_loops_start_at(lcm, f, lm, "p", FLAG_NONE, base);
 
-        int indent = 2+imax(0, g_ptr_array_size(lm->dimensions) - 1);
+        int indent = base+imax(0, g_ptr_array_size(lm->dimensions) - 1);
         emit(indent, "__%s_decode_array_cleanup(%s, %s);",
              dots_to_underscores (lm->type->lctypename),
              make_accessor(lm, "p", g_ptr_array_size(lm->dimensions) - 1),
              make_array_size(lm, "p", g_ptr_array_size(lm->dimensions) - 1));
 
-        emit_c_array_loops_end(lcm, f, lm, "p", lcm_is_constant_size_array(lm) ? FLAG_NONE : FLAG_EMIT_FREES);
+        emit_c_array_loops_end_at(lcm, f, lm, "p", lcm_is_constant_size_array(lm) ? FLAG_NONE : FLAG_EMIT_FREES,
+                                  base);
+        if (base == 3)
+            emit(2, "}");
         emit(0,"");
     }
     emit(1,   "}");
@@ -632,12 +790,14 @@ static void emit_c_decode_array_cleanup(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls
     emit(0,"");
 }
 
-static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, int arena)
 {
     char *tn = ls->structname->lctypename;
     char *tn_ = dots_to_underscores(tn);
+    const char *suffix = arena ? "_arena" : "";
 
-    emit(0,"int %s_decode(const void *buf, int offset, int maxlen, %s *p)", tn_, tn_);
+    emit(0,"int %s_decode%s(const void *buf, int offset, int maxlen, %s *p%s)",
+         tn_, suffix, tn_, arena ? ", lcm_arena_t *arena" : "");
     emit(0,"{");
     emit(1,    "int pos = 0, thislen;");
     emit(1,    "int64_t hash = __%s_get_hash();", tn_);
@@ -647,7 +807,8 @@ static void emit_c_decode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(1,    "if (thislen < 0) return thislen; else pos += thislen;");
     emit(1,    "if (this_hash != hash) return -1;");
     emit(0,"");
-    emit(1,    "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, p, 1);", tn_);
+    emit(1,    "thislen = __%s_decode_array%s(buf, offset + pos, maxlen - pos, p, 1%s);",
+         tn_, suffix, arena ? ", arena" : "");
     emit(1,    "if (thislen < 0) return thislen; else pos += thislen;");
     emit(0,"");
     emit(1, "return pos;");
@@ -674,6 +835,14 @@ static void emit_c_encoded_array_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 
     emit(0,"int __%s_encoded_array_size(const %s *p, int elements)", tn_, tn_);
     emit(0,"{");
+    int fixed_size = lcm_struct_fixed_encoded_size(ls);
+    if (fixed_size >= 0) {
+        emit(1, "(void) p;");
+        emit(1, "return elements * %d;", fixed_size);
+        emit(0,"}");
+        emit(0,"");
+        return;
+    }
     emit(1,"int size = 0, element;");
     emit(1,    "for (element = 0; element < elements; element++) {");
     emit(0,"");
@@ -704,6 +873,15 @@ static void emit_c_encoded_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 
     emit(0,"int %s_encoded_size(const %s *p)", tn_, tn_);
     emit(0,"{");
+    if (lcm_struct_fixed_encoded_size(ls) >= 0) {
+        char *tn_upper = g_ascii_strup(tn_, -1);
+        emit(1, "(void) p;");
+        emit(1, "return %s_ENCODED_SIZE;", tn_upper);
+        g_free(tn_upper);
+        emit(0,"}");
+        emit(0,"");
+        return;
+    }
     emit(1, "return 8 + __%s_encoded_array_size(p, 1);", tn_);
     emit(0,"}");
     emit(0,"");
@@ -894,17 +1072,16 @@ static void emit_c_struct_publish(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
     fprintf(f,
             "int %s_publish(lcm_t *lc, const char *channel, const %s *p)\n"
             "{\n"
+            "      if (!lcm_publish_wanted (lc, channel)) return 0;\n"
             "      int max_data_size = %s_encoded_size (p);\n"
-            "      uint8_t *buf = (uint8_t*) malloc (max_data_size);\n"
+            "      uint8_t *buf = (uint8_t*) lcm_publish_reserve (lc, channel, max_data_size);\n"
             "      if (!buf) return -1;\n"
             "      int data_size = %s_encode (buf, 0, max_data_size, p);\n"
             "      if (data_size < 0) {\n"
-            "          free (buf);\n"
+            "          lcm_publish_cancel (lc, buf);\n"
             "          return data_size;\n"
             "      }\n"
-            "      int status = lcm_publish (lc, channel, buf, data_size);\n"
-            "      free (buf);\n"
-            "      return status;\n"
+            "      return lcm_publish_commit (lc, buf, data_size);\n"
             "}\n\n", tn_, tn_, tn_, tn_);
 }
 
@@ -920,6 +1097,7 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
             "    void *userdata;\n"
 //            "    char *channel;\n"
             "    lcm_subscription_t *lc_h;\n"
+            "    lcm_arena_t arena;  // storage of the decoded message, kept across messages\n"
             "};\n", tn_, tn_);
     fprintf(f,
             "static\n"
@@ -928,18 +1106,19 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
             "{\n"
             "    int status;\n"
             "    %s p;\n"
+            "    %s_subscription_t *h = (%s_subscription_t*) userdata;\n"
             "    memset(&p, 0, sizeof(%s));\n"
-            "    status = %s_decode (rbuf->data, 0, rbuf->data_size, &p);\n"
+            "    status = %s_decode_arena (rbuf->data, 0, rbuf->data_size, &p, &h->arena);\n"
             "    if (status < 0) {\n"
             "        fprintf (stderr, \"error %%d decoding %s!!!\\n\", status);\n"
+            "        lcm_arena_reset (&h->arena);\n"
             "        return;\n"
             "    }\n"
             "\n"
-            "    %s_subscription_t *h = (%s_subscription_t*) userdata;\n"
             "    h->user_handler (rbuf, channel, &p, h->userdata);\n"
             "\n"
-            "    %s_decode_cleanup (&p);\n"
-            "}\n\n", tn_, tn_, tn_, tn_, tn_, tn_, tn_, tn_
+            "    lcm_arena_reset (&h->arena);\n"
+            "}\n\n", tn_, tn_, tn_, tn_, tn_, tn_, tn_
         );
 
     fprintf(f,
@@ -952,6 +1131,7 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
             "                       malloc(sizeof(%s_subscription_t));\n"
             "    n->user_handler = f;\n"
             "    n->userdata = userdata;\n"
+            "    lcm_arena_init (&n->arena);\n"
 //            "    n->channel = (char*) malloc (chan_len);\n"
 //            "    memcpy (n->channel, channel, chan_len);\n"
             "    n->lc_h = lcm_subscribe (lcm, channel,\n"
@@ -982,12 +1162,490 @@ static void emit_c_struct_subscribe(lcmgen_t *lcm, FILE *f, lcm_struct_t *lr)
             "        return -1;\n"
             "    }\n"
 //            "    free (hid->channel);\n"
+            "    lcm_arena_free (&hid->arena);\n"
             "    free (hid);\n"
             "    return 0;\n"
             "}\n\n", tn_, tn_, tn_
         );
 }
 
+/** Zero-copy views **/
+
+// The number of elements of member lm, as an int64_t expression of a view
+// named "view"
+static char *view_count_expr(lcm_member_t *lm, const char *tn_)
+{
+    GString *expr = g_string_new("");
+    if (g_ptr_array_size(lm->dimensions) == 0)
+        g_string_append(expr, "1");
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (d)
+            g_string_append(expr, " * ");
+        if (ld->mode == LCM_CONST)
+            g_string_append_printf(expr, "(int64_t) %s", ld->size);
+        else
+            g_string_append_printf(expr, "(int64_t) %s_view_get_%s(view)", tn_, ld->size);
+    }
+    return g_string_free(expr, FALSE);
+}
+
+static void emit_header_view(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *xd = getopt_get_string(lcm->gopt, "c-export-symbol");
+    char *xd_ = add_space_or_empty(xd);
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+    int num_members = g_ptr_array_size(ls->members);
+
+    emit(0, "/**");
+    emit(0, " * A read-only view of an encoded %s.  The view points into the", tn_);
+    emit(0, " * encoded message, which must outlive it, and only decodes the fields that");
+    emit(0, " * are read.  Arrays of strings or structs can not be read through a view.");
+    emit(0, " */");
+    emit(0, "typedef struct _%s_view %s_view;", tn_, tn_);
+    emit(0, "struct _%s_view", tn_);
+    emit(0, "{");
+    emit(1, "const uint8_t *buf;");
+    emit(1, "int size;");
+    emit(1, "int offsets[%d];", num_members ? num_members : 1);
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Check an encoded message of type %s, and set up a view of it.", tn_);
+    emit(0, " * The accessors of the view do not check the message again.");
+    emit(0, " *");
+    emit(0, " * @param view The view to set up.");
+    emit(0, " * @param buf The buffer containing the encoded message");
+    emit(0, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(0, " * @param maxlen The maximum number of bytes of the message.");
+    emit(0, " * @return The size of the encoded message, or <0 if it is not valid.");
+    emit(0, " */");
+    emit(0, "%sint %s_view_init(%s_view *view, const void *buf, int offset, int maxlen);",
+         xd_, tn_, tn_);
+    emit(0, "");
+    emit(0, "// LCM support functions. Users should not call these");
+    emit(0, "%sint __%s_view_init(%s_view *view, const void *buf, int offset, int maxlen);",
+         xd_, tn_, tn_);
+    emit(0, "");
+
+    for (unsigned int m = 0; m < num_members; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *t = lm->type->lctypename;
+        const char *mn = lm->membername;
+        int ndim = g_ptr_array_size(lm->dimensions);
+        int size = view_element_size(lcm, t);
+        char *t_ = dots_to_underscores(t);
+        const char *ct = map_type_name(t);
+
+        if (size && !ndim) {
+            emit(0, "static inline %s %s_view_get_%s(const %s_view *view)", ct, tn_, mn, tn_);
+            emit(0, "{");
+            emit(1, "%s v;", ct);
+            emit(1, "__%s_decode_array(view->buf, view->offsets[%d], %d, &v, 1);", t_, m, size);
+            emit(1, "return v;");
+            emit(0, "}");
+            emit(0, "");
+        } else if (size) {
+            char *count = view_count_expr(lm, tn_);
+            emit(0, "static inline int %s_view_%s_length(const %s_view *view)", tn_, mn, tn_);
+            emit(0, "{");
+            emit(1, "(void) view;");
+            emit(1, "return (int) (%s);", count);
+            emit(0, "}");
+            emit(0, "");
+            emit(0, "/**");
+            emit(0, " * Element @p i of %s, in row-major order.  @p i is not checked.", mn);
+            emit(0, " */");
+            emit(0, "static inline %s %s_view_get_%s(const %s_view *view, int i)", ct, tn_, mn, tn_);
+            emit(0, "{");
+            emit(1, "%s v;", ct);
+            emit(1, "__%s_decode_array(view->buf, view->offsets[%d] + i * %d, %d, &v, 1);",
+                 t_, m, size, size);
+            emit(1, "return v;");
+            emit(0, "}");
+            emit(0, "");
+            emit(0, "/**");
+            emit(0, " * Decode @p count elements of %s, starting at @p first.", mn);
+            emit(0, " * @return @p count, or <0 if the elements are out of range.");
+            emit(0, " */");
+            emit(0, "static inline int %s_view_copy_%s(const %s_view *view, %s *dst, int first, int count)",
+                 tn_, mn, tn_, ct);
+            emit(0, "{");
+            emit(1, "if (first < 0 || count < 0 || count > %s_view_%s_length(view) - first)", tn_, mn);
+            emit(2, "return -1;");
+            emit(1, "__%s_decode_array(view->buf, view->offsets[%d] + first * %d, count * %d, dst, count);",
+                 t_, m, size, size);
+            emit(1, "return count;");
+            emit(0, "}");
+            emit(0, "");
+            emit(0, "/**");
+            emit(0, " * The encoded elements of %s, in big-endian byte order.", mn);
+            emit(0, " */");
+            emit(0, "static inline const void *%s_view_%s_bytes(const %s_view *view)", tn_, mn, tn_);
+            emit(0, "{");
+            emit(1, "return view->buf + view->offsets[%d];", m);
+            emit(0, "}");
+            emit(0, "");
+            free(count);
+        } else if (!ndim && !strcmp(t, "string")) {
+            emit(0, "static inline const char *%s_view_get_%s(const %s_view *view)", tn_, mn, tn_);
+            emit(0, "{");
+            emit(1, "return (const char *) view->buf + view->offsets[%d] + 4;", m);
+            emit(0, "}");
+            emit(0, "");
+        } else if (!ndim) {
+            emit(0, "static inline int %s_view_get_%s(const %s_view *view, %s_view *member)",
+                 tn_, mn, tn_, t_);
+            emit(0, "{");
+            emit(1, "return __%s_view_init(member, view->buf, view->offsets[%d], view->size - view->offsets[%d]);",
+                 t_, m, m);
+            emit(0, "}");
+            emit(0, "");
+        }
+        free(t_);
+    }
+}
+
+static void emit_c_view_init(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+
+    emit(0, "int __%s_view_init(%s_view *view, const void *buf, int offset, int maxlen)", tn_, tn_);
+    emit(0, "{");
+    emit(1,     "int pos = 0;");
+    if (g_ptr_array_size(ls->members))
+        emit(1, "int64_t n;");
+    emit(0, "");
+    emit(1,     "view->buf = (const uint8_t *) buf + offset;");
+    emit(1,     "if (maxlen < 0) return -1;");
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *t = lm->type->lctypename;
+        int size = view_element_size(lcm, t);
+
+        emit(1, "view->offsets[%d] = pos;", m);
+        emit(1, "n = 1;");
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            if (ld->mode == LCM_CONST)
+                emit(1, "n = __lcm_view_count(n, %s, maxlen);", ld->size);
+            else
+                emit(1, "n = __lcm_view_count(n, %s_view_get_%s(view), maxlen);", tn_, ld->size);
+        }
+        if (size) {
+            emit(1, "if (n < 0 || n > (maxlen - pos) / %d) return -1;", size);
+            emit(1, "pos += (int) n * %d;", size);
+        } else {
+            char *t_ = dots_to_underscores(t);
+            emit(1, "if (n < 0) return -1;");
+            emit(1, "while (n-- > 0) {");
+            if (!strcmp(t, "string")) {
+                emit(2, "int thislen = __string_view_skip(view->buf, pos, maxlen - pos);");
+            } else {
+                emit(2, "%s_view member;", t_);
+                emit(2, "int thislen = __%s_view_init(&member, view->buf, pos, maxlen - pos);", t_);
+            }
+            emit(2, "if (thislen < 0) return thislen; else pos += thislen;");
+            emit(1, "}");
+            free(t_);
+        }
+        emit(0, "");
+    }
+    emit(1,     "view->size = pos;");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "int %s_view_init(%s_view *view, const void *buf, int offset, int maxlen)", tn_, tn_);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(1,     "int64_t hash = __%s_get_hash();", tn_);
+    emit(0, "");
+    emit(1,     "int64_t this_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (this_hash != hash) return -1;");
+    emit(0, "");
+    emit(1,     "thislen = __%s_view_init(view, buf, offset + pos, maxlen - pos);", tn_);
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+/** Partial decoding **/
+
+// The bit of member m in the mask of <type>_decode_fields().  The members
+// from the 64th on share the last bit.
+static int decode_fields_bit(unsigned int m)
+{
+    return m < 63 ? m : 63;
+}
+
+// Whether member lm is the size of a variable-length array of ls
+static int is_dimension_member(lcm_struct_t *ls, lcm_member_t *lm)
+{
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *other = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        for (unsigned int d = 0; d < g_ptr_array_size(other->dimensions); d++) {
+            lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(other->dimensions, d);
+            if (ld->mode == LCM_VAR && !strcmp(ld->size, lm->membername))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether skipping member lm needs the variable n, or thislen
+static int skip_needs_count(lcmgen_t *lcm, lcm_member_t *lm)
+{
+    if (g_ptr_array_size(lm->dimensions) == 0)
+        return 0;
+    return !lcm_is_constant_size_array(lm) || !view_element_size(lcm, lm->type->lctypename);
+}
+
+static int skip_needs_thislen(lcmgen_t *lcm, lcm_member_t *lm)
+{
+    return !view_element_size(lcm, lm->type->lctypename);
+}
+
+// Emits code that moves pos past the encoded member lm, reading only the
+// lengths of its variable-length parts.  dim_fmt formats the variable
+// holding a variable-length dimension from the name of its member.
+static void emit_c_skip_member(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *dim_fmt, int indent)
+{
+    const char *t = lm->type->lctypename;
+    int size = view_element_size(lcm, t);
+
+    if (!skip_needs_count(lcm, lm)) {
+        if (!strcmp(t, "string")) {
+            emit(indent, "thislen = __string_view_skip(buf, offset + pos, maxlen - pos);");
+            emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+            return;
+        }
+        if (!size) {
+            char *t_ = dots_to_underscores(t);
+            emit(indent, "thislen = __%s_skip_array(buf, offset + pos, maxlen - pos, 1);", t_);
+            emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+            free(t_);
+            return;
+        }
+        // a scalar or an array of constant size
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            size *= atoi(ld->size);
+        }
+        emit(indent, "if (maxlen - pos < %d) return -1;", size);
+        emit(indent, "pos += %d;", size);
+        return;
+    }
+
+    emit(indent, "n = 1;");
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (ld->mode == LCM_CONST) {
+            emit(indent, "n = __lcm_view_count(n, %s, maxlen);", ld->size);
+        } else {
+            char *var = g_strdup_printf(dim_fmt, ld->size);
+            emit(indent, "n = __lcm_view_count(n, %s, maxlen);", var);
+            g_free(var);
+        }
+    }
+    if (size) {
+        emit(indent, "if (n < 0 || n > (maxlen - pos) / %d) return -1;", size);
+        emit(indent, "pos += (int) n * %d;", size);
+    } else if (!strcmp(t, "string")) {
+        emit(indent, "if (n < 0) return -1;");
+        emit(indent, "while (n-- > 0) {");
+        emit(indent + 1, "thislen = __string_view_skip(buf, offset + pos, maxlen - pos);");
+        emit(indent + 1, "if (thislen < 0) return thislen; else pos += thislen;");
+        emit(indent, "}");
+    } else {
+        char *t_ = dots_to_underscores(t);
+        emit(indent, "if (n < 0) return -1;");
+        emit(indent, "thislen = __%s_skip_array(buf, offset + pos, maxlen - pos, (int) n);", t_);
+        emit(indent, "if (thislen < 0) return thislen; else pos += thislen;");
+        free(t_);
+    }
+}
+
+static void emit_header_decode_fields(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *xd = getopt_get_string(lcm->gopt, "c-export-symbol");
+    char *xd_ = add_space_or_empty(xd);
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+    char *tn_upper = g_ascii_strup(tn_, -1);
+
+    if (g_ptr_array_size(ls->members) > 0) {
+        emit(0, "/**");
+        emit(0, " * The members of %s, for the mask of %s_decode_fields().", tn_, tn_);
+        if (g_ptr_array_size(ls->members) > 63)
+            emit(0, " * The members from the 64th on share a bit, and are decoded together.");
+        emit(0, " */");
+    }
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        emit(0, "#define %s_FIELD_%s ((uint64_t) 1 << %d)", tn_upper, lm->membername,
+             decode_fields_bit(m));
+    }
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Decode some of the members of a message of type %s, like", tn_);
+    emit(0, " * %s_decode().  The other members are zeroed, and skipped by reading", tn_);
+    emit(0, " * only the lengths of their variable-length parts.  The sizes of the");
+    emit(0, " * variable-length arrays are decoded up to the last member selected.");
+    emit(0, " * Decoding stops after that member, so the rest of the message is not");
+    emit(0, " * checked.  Release the message with %s_decode_cleanup().", tn_);
+    emit(0, " *");
+    emit(0, " * @param buf The buffer containing the encoded message");
+    emit(0, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(0, " * @param maxlen The maximum number of bytes to read while decoding.");
+    emit(0, " * @param msg Output parameter where the decoded message is stored");
+    emit(0, " * @param mask The members to decode, a bitwise or of %s_FIELD_* values.", tn_upper);
+    emit(0, " * @return The number of bytes read, or <0 if an error occured.");
+    emit(0, " */");
+    emit(0, "%sint %s_decode_fields(const void *buf, int offset, int maxlen, %s *msg, uint64_t mask);",
+         xd_, tn_, tn_);
+    emit(0, "");
+    emit(0, "// LCM support functions. Users should not call these");
+    emit(0, "%sint __%s_decode_fields(const void *buf, int offset, int maxlen, %s *p, uint64_t mask);",
+         xd_, tn_, tn_);
+    emit(0, "%sint __%s_skip_array(const void *buf, int offset, int maxlen, int elements);", xd_, tn_);
+    emit(0, "");
+    g_free(tn_upper);
+}
+
+// Emits __<type>_skip_array(), which returns the encoded size of elements
+// messages without decoding them
+static void emit_c_skip_array(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+    int fixed_size = lcm_struct_fixed_encoded_size(ls);
+
+    emit(0, "int __%s_skip_array(const void *buf, int offset, int maxlen, int elements)", tn_);
+    emit(0, "{");
+    if (fixed_size >= 0) {
+        emit(1, "(void) buf;");
+        emit(1, "(void) offset;");
+        emit(1, "if ((int64_t) elements * %d > maxlen) return -1;", fixed_size);
+        emit(1, "return elements * %d;", fixed_size);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+
+    int need_count = 0, need_thislen = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (is_dimension_member(ls, lm)) {
+            emit(1, "%s __%s_dim;", map_type_name(lm->type->lctypename), lm->membername);
+            need_thislen = 1;
+        } else {
+            need_count |= skip_needs_count(lcm, lm);
+            need_thislen |= skip_needs_thislen(lcm, lm);
+        }
+    }
+    emit(1, "int pos = 0, element;");
+    if (need_thislen)
+        emit(1, "int thislen;");
+    if (need_count)
+        emit(1, "int64_t n;");
+    emit(0, "");
+    emit(1, "for (element = 0; element < elements; element++) {");
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (is_dimension_member(ls, lm)) {
+            emit(2, "thislen = __%s_decode_array(buf, offset + pos, maxlen - pos, &__%s_dim, 1);",
+                 lm->type->lctypename, lm->membername);
+            emit(2, "if (thislen < 0) return thislen; else pos += thislen;");
+        } else {
+            emit_c_skip_member(lcm, f, lm, "__%s_dim", 2);
+        }
+        emit(0, "");
+    }
+    emit(1, "}");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+static void emit_c_decode_fields(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    char *tn = ls->structname->lctypename;
+    char *tn_ = dots_to_underscores(tn);
+    char *tn_upper = g_ascii_strup(tn_, -1);
+
+    emit(0, "int __%s_decode_fields(const void *buf, int offset, int maxlen, %s *p, uint64_t mask)",
+         tn_, tn_);
+    emit(0, "{");
+    if (g_ptr_array_size(ls->members) == 0) {
+        emit(1, "(void) buf;");
+        emit(1, "(void) offset;");
+        emit(1, "(void) maxlen;");
+        emit(1, "(void) mask;");
+        emit(1, "memset(p, 0, sizeof(%s));", tn_);
+        emit(1, "return 0;");
+    } else {
+        int need_count = 0;
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+            if (!is_dimension_member(ls, lm))
+                need_count |= skip_needs_count(lcm, lm);
+        }
+        emit(1, "const int element = 0;  // for the member accessors");
+        emit(1, "int pos = 0, thislen;");
+        if (need_count)
+            emit(1, "int64_t n;");
+        emit(0, "");
+        emit(1, "memset(p, 0, sizeof(%s));", tn_);
+        emit(0, "");
+        for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+
+            emit(1, "if ((mask >> %d) == 0) return pos;", decode_fields_bit(m));
+            if (is_dimension_member(ls, lm)) {
+                emit_c_decode_member(lcm, f, lm, 0, 1);
+            } else {
+                emit(1, "if (mask & %s_FIELD_%s) {", tn_upper, lm->membername);
+                emit_c_decode_member(lcm, f, lm, 0, 2);
+                emit(1, "} else {");
+                emit_c_skip_member(lcm, f, lm, "p[element].%s", 2);
+                emit(1, "}");
+            }
+            emit(0, "");
+        }
+        emit(1, "return pos;");
+    }
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "int %s_decode_fields(const void *buf, int offset, int maxlen, %s *p, uint64_t mask)",
+         tn_, tn_);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(1,     "int64_t hash = __%s_get_hash();", tn_);
+    emit(0, "");
+    emit(1,     "int64_t this_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &this_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (this_hash != hash) return -1;");
+    emit(0, "");
+    emit(1,     "thislen = __%s_decode_fields(buf, offset + pos, maxlen - pos, p, mask);", tn_);
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+    g_free(tn_upper);
+}
+
 int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *le)
 {
     char *tn = le->enumname->lctypename;
@@ -1086,6 +1744,13 @@ int emit_enum(lcmgen_t *lcmgen, lcm_enum_t *le)
         emit(0, "}");
         emit(0, "");
 
+        emit(0, "static inline int __%s_decode_array_arena(const void *_buf, int offset, int maxlen, %s *p, int elements, lcm_arena_t *arena)", tn_, tn_);
+        emit(0, "{");
+        emit(1,    "(void) arena;");
+        emit(1,    "return __%s_decode_array(_buf, offset, maxlen, p, elements);", tn_);
+        emit(0, "}");
+        emit(0, "");
+
         emit(0, "static inline int __%s_clone_array(const %s *p, %s *q, int elements)", tn_, tn_, tn_);
         emit(0, "{");
         emit(1,    "memcpy(q, p, elements * sizeof(%s));", tn_);
@@ -1185,6 +1850,10 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *lr)
         emit_header_top(lcmgen, f, tn_);
         emit_header_struct(lcmgen, f, lr);
         emit_header_prototypes(lcmgen, f, lr);
+        if (getopt_get_bool(lcmgen->gopt, "c-views"))
+            emit_header_view(lcmgen, f, lr);
+        if (getopt_get_bool(lcmgen->gopt, "c-decode-fields"))
+            emit_header_decode_fields(lcmgen, f, lr);
 
         emit_header_bottom(lcmgen, f);
         fclose(f);
@@ -1217,10 +1886,18 @@ int emit_struct(lcmgen_t *lcmgen, lcm_struct_t *lr)
             emit_c_get_type_info(lcmgen, f, lr);
         }
 
-        emit_c_decode_array(lcmgen, f, lr);
+        emit_c_decode_array(lcmgen, f, lr, 0);
         emit_c_decode_array_cleanup(lcmgen, f, lr);
-        emit_c_decode(lcmgen, f, lr);
+        emit_c_decode(lcmgen, f, lr, 0);
         emit_c_decode_cleanup(lcmgen, f, lr);
+        emit_c_decode_array(lcmgen, f, lr, 1);
+        emit_c_decode(lcmgen, f, lr, 1);
+        if (getopt_get_bool(lcmgen->gopt, "c-views"))
+            emit_c_view_init(lcmgen, f, lr);
+        if (getopt_get_bool(lcmgen->gopt, "c-decode-fields")) {
+            emit_c_skip_array(lcmgen, f, lr);
+            emit_c_decode_fields(lcmgen, f, lr);
+        }
 
         emit_c_clone_array(lcmgen, f, lr);
         emit_c_copy(lcmgen, f, lr);
@@ -1259,3 +1936,143 @@ int emit_c(lcmgen_t *lcmgen)
 
     return 0;
 }
+
+typedef struct {
+    int64_t fingerprint;
+    lcm_struct_t *lr;
+} registry_entry_t;
+
+static int compare_registry_entries(const void *a, const void *b)
+{
+    int64_t fa = ((const registry_entry_t *) a)->fingerprint;
+    int64_t fb = ((const registry_entry_t *) b)->fingerprint;
+    return fa < fb ? -1 : fa > fb;
+}
+
+// Emits <package>_registry.h and .c, which list the structs of the package
+// sorted by fingerprint, for lcm_type_registry_find().
+static int emit_package_registry(lcmgen_t *lcmgen, const char *package)
+{
+    const char *cinclude = getopt_get_string(lcmgen->gopt, "cinclude");
+    const char *cinclude_sep = strlen(cinclude) > 0 ? "/" : "";
+    char *xd = getopt_get_string(lcmgen->gopt, "c-export-symbol");
+    char *xd_ = add_space_or_empty(xd);
+    char *pn_ = dots_to_underscores(package);
+    char *rn = g_strdup_printf("%s%sregistry", pn_, strlen(pn_) ? "_" : "");
+    char *header_name = g_strdup_printf("%s/%s.h", getopt_get_string(lcmgen->gopt, "c-hpath"), rn);
+    char *c_name      = g_strdup_printf("%s/%s.c", getopt_get_string(lcmgen->gopt, "c-cpath"), rn);
+    int status = 0;
+
+    GArray *entries = g_array_new(FALSE, FALSE, sizeof(registry_entry_t));
+    int needs_generation = 0;
+    for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
+        lcm_struct_t *lr = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
+        if (strcmp(lr->structname->package, package))
+            continue;
+        registry_entry_t entry;
+        uint64_t fingerprint;
+        if (lcm_struct_full_fingerprint(lcmgen, lr, &fingerprint)) {
+            status = -1;
+            goto done;
+        }
+        entry.fingerprint = (int64_t) fingerprint;
+        entry.lr = lr;
+        g_array_append_val(entries, entry);
+        needs_generation |= lcm_needs_generation(lcmgen, lr->lcmfile, header_name) ||
+            lcm_needs_generation(lcmgen, lr->lcmfile, c_name);
+    }
+    if (!needs_generation)
+        goto done;
+    qsort(entries->data, entries->len, sizeof(registry_entry_t),
+            compare_registry_entries);
+
+    FILE *f = fopen(header_name, "w");
+    if (f == NULL) {
+        status = -1;
+        goto done;
+    }
+    emit_header_top(lcmgen, f, rn);
+    emit(0, "/**");
+    emit(0, " * The types of package %s, sorted by fingerprint.", package);
+    emit(0, " */");
+    emit(0, "extern %sconst lcm_type_registry_entry_t %s[];", xd_, rn);
+    emit(0, "extern %sconst int %s_size;", xd_, rn);
+    emit(0, "");
+    emit(0, "/**");
+    emit(0, " * Finds the type of package %s whose messages start with", package);
+    emit(0, " * @p fingerprint.");
+    emit(0, " *");
+    emit(0, " * @return the entry of the type, or NULL if there is none.");
+    emit(0, " */");
+    emit(0, "%sconst lcm_type_registry_entry_t *%s_find(int64_t fingerprint);", xd_, rn);
+    emit(0, "");
+    emit_header_bottom(lcmgen, f);
+    fclose(f);
+
+    f = fopen(c_name, "w");
+    if (f == NULL) {
+        status = -1;
+        goto done;
+    }
+    emit_auto_generated_warning(f);
+    fprintf(f, "#include \"%s%s%s.h\"\n", cinclude, cinclude_sep, rn);
+    for (unsigned int i = 0; i < entries->len; i++) {
+        registry_entry_t *entry = &g_array_index(entries, registry_entry_t, i);
+        char *tn_ = dots_to_underscores(entry->lr->structname->lctypename);
+        fprintf(f, "#include \"%s%s%s.h\"\n", cinclude, cinclude_sep, tn_);
+        free(tn_);
+    }
+    fprintf(f, "\n");
+    emit(0, "const lcm_type_registry_entry_t %s[] = {", rn);
+    for (unsigned int i = 0; i < entries->len; i++) {
+        registry_entry_t *entry = &g_array_index(entries, registry_entry_t, i);
+        char *tn = entry->lr->structname->lctypename;
+        char *tn_ = dots_to_underscores(tn);
+        emit(1, "{ (int64_t) 0x%016"PRIx64"ULL, \"%s\", %s_get_type_info },",
+                (uint64_t) entry->fingerprint, tn, tn_);
+        free(tn_);
+    }
+    emit(0, "};");
+    emit(0, "");
+    emit(0, "const int %s_size = %u;", rn, entries->len);
+    emit(0, "");
+    emit(0, "const lcm_type_registry_entry_t *%s_find(int64_t fingerprint)", rn);
+    emit(0, "{");
+    emit(1, "return lcm_type_registry_find(%s, %s_size, fingerprint);", rn, rn);
+    emit(0, "}");
+    fclose(f);
+
+done:
+    g_array_free(entries, TRUE);
+    g_free(header_name);
+    g_free(c_name);
+    g_free(rn);
+    free(pn_);
+    return status;
+}
+
+int emit_c_registry(lcmgen_t *lcmgen)
+{
+    // the registry refers to the type info of each type
+    if (!getopt_get_bool(lcmgen->gopt, "c-typeinfo")) {
+        fprintf(stderr, "--c-registry requires --c-typeinfo\n");
+        return -1;
+    }
+
+    GPtrArray *packages = g_ptr_array_new();
+    int status = 0;
+    for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs) && !status; i++) {
+        lcm_struct_t *lr = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
+        const char *package = lr->structname->package;
+        unsigned int p;
+        for (p = 0; p < g_ptr_array_size(packages); p++)
+            if (!strcmp((const char *) g_ptr_array_index(packages, p), package))
+                break;
+        if (p < g_ptr_array_size(packages))
+            continue;
+        g_ptr_array_add(packages, (gpointer) package);
+        status = emit_package_registry(lcmgen, package);
+    }
+    g_ptr_array_free(packages, TRUE);
+    return status;
+}
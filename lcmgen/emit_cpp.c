@@ -133,6 +133,246 @@ void setup_cpp_options(getopt_t *gopt)
     getopt_add_string (gopt, 0, "cpp-std",    "c++98",      "C++ standard(c++98, c++11)");
     getopt_add_string (gopt, 0, "cpp-hpath",    ".",      "Location for .hpp files");
     getopt_add_string (gopt, 0, "cpp-include",   "",       "Generated #include lines reference this folder");
+    getopt_add_bool   (gopt, 0, "cpp-decode-fields", 0,    "Generate decodeFields(), which decodes only some members");
+    getopt_add_bool   (gopt, 0, "cpp-views",    0,      "Generate zero-copy views of encoded messages");
+    getopt_add_string (gopt, 0, "cpp-soa",      "",
+            "Store these arrays of structs as one vector per member, as TYPE.MEMBER[,...]");
+}
+
+/** Struct-of-arrays members **/
+
+// Whether --cpp-soa names member lm of ls
+static int is_soa_member(lcmgen_t *lcmgen, lcm_struct_t *ls, lcm_member_t *lm)
+{
+    const char *opt = getopt_get_string(lcmgen->gopt, "cpp-soa");
+    if (!opt || !*opt)
+        return 0;
+    char *name = g_strdup_printf("%s.%s", ls->structname->lctypename, lm->membername);
+    gchar **entries = g_strsplit(opt, ",", 0);
+    int found = 0;
+    for (int i = 0; entries[i] && !found; i++)
+        found = !strcmp(g_strstrip(entries[i]), name);
+    g_strfreev(entries);
+    g_free(name);
+    return found;
+}
+
+// The type of the elements of lm if it is stored as a struct of arrays, or
+// NULL.  check_soa_members() made sure that it is one that can be.
+static lcm_struct_t *soa_element_type(lcmgen_t *lcmgen, lcm_struct_t *ls, lcm_member_t *lm)
+{
+    if (!is_soa_member(lcmgen, ls, lm))
+        return NULL;
+    return lcm_find_struct(lcmgen, lm->type->lctypename);
+}
+
+// The byte offset of member m in an encoded es, which only has scalar
+// members of primitive types.
+static int soa_field_offset(lcm_struct_t *es, unsigned int m)
+{
+    int offset = 0;
+    for (unsigned int i = 0; i < m; i++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, i);
+        offset += lcm_primitive_encoded_size(em->type->lctypename);
+    }
+    return offset;
+}
+
+// Checks the members named by --cpp-soa that belong to the types being
+// generated, and returns -1 if one of them can not be stored as a struct of
+// arrays.  Names of types that are not being generated are ignored, so that
+// the same option can be given to separate runs of lcm-gen.
+static int check_soa_members(lcmgen_t *lcmgen)
+{
+    const char *opt = getopt_get_string(lcmgen->gopt, "cpp-soa");
+    if (!opt || !*opt)
+        return 0;
+    gchar **entries = g_strsplit(opt, ",", 0);
+    int status = 0;
+    for (int i = 0; entries[i] && !status; i++) {
+        char *entry = g_strstrip(entries[i]);
+        char *dot = strrchr(entry, '.');
+        if (!dot) {
+            fprintf(stderr, "--cpp-soa: \"%s\" is not of the form TYPE.MEMBER\n", entry);
+            status = -1;
+            break;
+        }
+        char *type_name = g_strndup(entry, dot - entry);
+        lcm_struct_t *ls = lcm_find_struct(lcmgen, type_name);
+        g_free(type_name);
+        if (!ls)
+            continue;
+        lcm_member_t *lm = lcm_find_member(ls, dot + 1);
+        lcm_struct_t *es = lm ? lcm_find_struct(lcmgen, lm->type->lctypename) : NULL;
+        const char *problem = NULL;
+        if (!lm) {
+            problem = "no such member";
+        } else if (g_ptr_array_size(lm->dimensions) != 1 || lcm_is_constant_size_array(lm)) {
+            problem = "not a one-dimensional array of variable length";
+        } else if (!es) {
+            problem = "not an array of a struct that is being generated";
+        } else if (es == ls || g_ptr_array_size(es->members) == 0) {
+            problem = "not an array of a struct with members";
+        }
+        for (unsigned int m = 0; es && !problem && m < g_ptr_array_size(es->members); m++) {
+            lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+            if (g_ptr_array_size(em->dimensions) || !lcm_primitive_encoded_size(em->type->lctypename))
+                problem = "not an array of a struct whose members are all scalars of primitive types";
+        }
+        if (problem) {
+            fprintf(stderr, "--cpp-soa: %s is %s\n", entry, problem);
+            status = -1;
+        }
+    }
+    g_strfreev(entries);
+    return status;
+}
+
+static void emit_header_soa_class(lcmgen_t *lcmgen, FILE *f, lcm_member_t *lm, lcm_struct_t *es)
+{
+    const char *mn = lm->membername;
+    char *et = dots_to_double_colons(es->structname->lctypename);
+    int num_fields = g_ptr_array_size(es->members);
+
+    emit(2, "/**");
+    emit(2, " * The elements of %s, stored as one vector per member of", mn);
+    emit(2, " * %s instead of as a vector of them.  They are encoded as the", et);
+    emit(2, " * vector would be, and encoding checks that each column has at least the");
+    emit(2, " * number of elements that the message declares.");
+    emit(2, " */");
+    emit(2, "class %s_columns", mn);
+    emit(2, "{");
+    emit(3,     "public:");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        char *ct = map_type_name(em->type->lctypename);
+        emit(4, "std::vector< %s > %s;", ct, em->membername);
+        free(ct);
+    }
+    lcm_member_t *first = (lcm_member_t *) g_ptr_array_index(es->members, 0);
+    emit(0, "");
+    emit(4,         "int size() const { return static_cast<int>(%s.size()); }", first->membername);
+    emit(0, "");
+    emit(4,         "void resize(int n)");
+    emit(4,         "{");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(5,         "%s.resize(n);", em->membername);
+    }
+    emit(4,         "}");
+    emit(0, "");
+    emit(4,         "%s get(int i) const", et);
+    emit(4,         "{");
+    emit(5,             "%s element;", et);
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(5,         "element.%s = %s[i];", em->membername, em->membername);
+    }
+    emit(5,             "return element;");
+    emit(4,         "}");
+    emit(0, "");
+    emit(4,         "void set(int i, const %s& element)", et);
+    emit(4,         "{");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(5,         "%s[i] = element.%s;", em->membername, em->membername);
+    }
+    emit(4,         "}");
+    emit(0, "");
+    emit(4,         "void push_back(const %s& element)", et);
+    emit(4,         "{");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(5,         "%s.push_back(element.%s);", em->membername, em->membername);
+    }
+    emit(4,         "}");
+    emit(0, "");
+    emit(4,         "void swap(%s_columns& other)", mn);
+    emit(4,         "{");
+    emit(5,             "using std::swap;");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(5,         "swap(%s, other.%s);", em->membername, em->membername);
+    }
+    emit(4,         "}");
+    emit(0, "");
+    emit(4,         "friend void swap(%s_columns& a, %s_columns& b) { a.swap(b); }", mn, mn);
+    emit(0, "");
+    emit(4,         "// LCM support functions. Users should not call these");
+    emit(4,         "bool _hasElements(int n) const");
+    emit(4,         "{");
+    for (int m = 0; m < num_fields; m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(m ? 6 : 5, "%s%s.size() >= static_cast<size_t>(n)%s", m ? "" : "return ",
+                em->membername, m < num_fields - 1 ? " &&" : ";");
+    }
+    emit(4,         "}");
+    emit(2, "};");
+    emit(0, "");
+    free(et);
+}
+
+// Emits the encoding of a struct-of-arrays member, one column at a time from
+// the vectors into the interleaved elements of the encoded array.
+static void emit_encode_soa(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, lcm_struct_t *es)
+{
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+    const char *mn = lm->membername;
+    int stride = lcm_struct_fixed_encoded_size(es);
+
+    emit(1, "if(this->%s > 0) {", dim->size);
+    emit(2,     "if(!this->%s._hasElements(this->%s)) return -1;", mn, dim->size);
+    emit(2,     "if(static_cast<int64_t>(this->%s) * %d > maxlen - pos) return -1;", dim->size, stride);
+    emit(2,     "uint8_t *__%s_enc = static_cast<uint8_t*>(buf) + offset + pos;", mn);
+    for (unsigned int m = 0; m < g_ptr_array_size(es->members); m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        int size = lcm_primitive_encoded_size(em->type->lctypename);
+        emit(2, "__lcm_copy_swapped_strided(__%s_enc + %d, %d, &this->%s.%s[0], %d, this->%s, %d);",
+                mn, soa_field_offset(es, m), stride, mn, em->membername, size, dim->size, size);
+    }
+    emit(2,     "pos += this->%s * %d;", dim->size, stride);
+    emit(1, "}");
+}
+
+static void emit_encode_stream_soa(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, lcm_struct_t *es)
+{
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+    const char *mn = lm->membername;
+
+    emit(1, "if(this->%s > 0 && !this->%s._hasElements(this->%s)) return -1;", dim->size, mn, dim->size);
+    emit(1, "for (int a0 = 0; a0 < this->%s; a0++) {", dim->size);
+    for (unsigned int m = 0; m < g_ptr_array_size(es->members); m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        emit(2, "if (__lcm_stream_put(stream, &this->%s.%s[a0], 1, %d) < 0) return -1;",
+                mn, em->membername, lcm_primitive_encoded_size(em->type->lctypename));
+    }
+    emit(1, "}");
+}
+
+static void emit_decode_soa(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, lcm_struct_t *es, int extra_indent)
+{
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, 0);
+    const char *mn = lm->membername;
+    int stride = lcm_struct_fixed_encoded_size(es);
+    int indent = extra_indent + 1;
+
+    emit(indent, "if(this->%s < 0 || static_cast<int64_t>(this->%s) * %d > maxlen - pos) return -1;",
+            dim->size, dim->size, stride);
+    emit(indent, "try {");
+    emit(indent + 1, "this->%s.resize(this->%s);", mn, dim->size);
+    emit(indent, "} catch (...) {");
+    emit(indent + 1, "return -1;");
+    emit(indent, "}");
+    emit(indent, "if(this->%s > 0) {", dim->size);
+    emit(indent + 1, "const uint8_t *__%s_enc = static_cast<const uint8_t*>(buf) + offset + pos;", mn);
+    for (unsigned int m = 0; m < g_ptr_array_size(es->members); m++) {
+        lcm_member_t *em = (lcm_member_t *) g_ptr_array_index(es->members, m);
+        int size = lcm_primitive_encoded_size(em->type->lctypename);
+        emit(indent + 1, "__lcm_copy_swapped_strided(&this->%s.%s[0], %d, __%s_enc + %d, %d, this->%s, %d);",
+                mn, em->membername, size, mn, soa_field_offset(es, m), stride, dim->size, size);
+    }
+    emit(indent + 1, "pos += this->%s * %d;", dim->size, stride);
+    emit(indent, "}");
 }
 
 static void emit_auto_generated_warning(FILE *f)
@@ -191,6 +431,224 @@ emit_package_namespace_close(lcmgen_t* lcmgen, FILE* f, lcm_struct_t* ls)
 }
 
 /** Emit header file **/
+// The bit of member m in the mask of decodeFields().  The members from the
+// 64th on share the last bit.
+static int decode_fields_bit(unsigned int m)
+{
+    return m < 63 ? m : 63;
+}
+
+static void emit_header_decode_fields(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
+{
+    const char *cpp_std = getopt_get_string(lcmgen->gopt, "cpp-std");
+    const char *qualifier = strcmp(cpp_std, "c++11") ? "static const" : "static constexpr";
+
+    if (g_ptr_array_size(ls->members) > 0) {
+        emit(2, "/**");
+        emit(2, " * The members, for the mask of decodeFields().");
+        if (g_ptr_array_size(ls->members) > 63)
+            emit(2, " * The members from the 64th on share a bit, and are decoded together.");
+        emit(2, " */");
+    }
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        emit(2, "%s uint64_t FIELD_%s = 1ULL << %d;", qualifier, lm->membername,
+             decode_fields_bit(m));
+    }
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Decode some of the members of a message into this instance, like");
+    emit(2, " * decode().  The other members are left as they are, and skipped by");
+    emit(2, " * reading only the lengths of their variable-length parts.  The sizes of");
+    emit(2, " * the variable-length arrays are decoded up to the last member selected.");
+    emit(2, " * Decoding stops after that member, so the rest of the message is not");
+    emit(2, " * checked.");
+    emit(2, " *");
+    emit(2, " * @param buf The buffer containing the encoded message.");
+    emit(2, " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(2, " * @param maxlen The maximum number of bytes to read while decoding.");
+    emit(2, " * @param mask The members to decode, a bitwise or of FIELD_* values.");
+    emit(2, " * @return The number of bytes read, or <0 if an error occured.");
+    emit(2, " */");
+    emit(2, "inline int decodeFields(const void *buf, int offset, int maxlen, uint64_t mask);");
+    emit(0, "");
+}
+
+// The number of elements of member lm, as an int64_t expression in a View
+static char *view_count_expr(lcm_member_t *lm)
+{
+    GString *expr = g_string_new("");
+    if (g_ptr_array_size(lm->dimensions) == 0)
+        g_string_append(expr, "1");
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (d)
+            g_string_append(expr, " * ");
+        if (ld->mode == LCM_CONST)
+            g_string_append_printf(expr, "(int64_t) %s", ld->size);
+        else
+            g_string_append_printf(expr, "(int64_t) get_%s()", ld->size);
+    }
+    return g_string_free(expr, FALSE);
+}
+
+static void emit_header_view(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    int num_members = g_ptr_array_size(ls->members);
+
+    emit(0, "");
+    emit(1, "public:");
+    emit(2, "/**");
+    emit(2, " * A read-only view of an encoded %s.  The view points into the", sn);
+    emit(2, " * encoded message, which must outlive it, and only decodes the members");
+    emit(2, " * that are read.  Arrays of strings or structs can not be read through");
+    emit(2, " * a view.  In a handler subscribed without decoding, a view is set up");
+    emit(2, " * with init(rbuf->data, 0, rbuf->data_size).");
+    emit(2, " */");
+    emit(2, "class View");
+    emit(2, "{");
+    emit(3,     "public:");
+    emit(4,         "View() : encoded(NULL), encoded_size(0) {}");
+    emit(0, "");
+    emit(4,         "/**");
+    emit(4,         " * Check an encoded message, and set up the view of it.  The");
+    emit(4,         " * accessors do not check the message again.");
+    emit(4,         " *");
+    emit(4,         " * @param buf The buffer containing the encoded message.");
+    emit(4,         " * @param offset The byte offset into @p buf where the encoded message starts.");
+    emit(4,         " * @param maxlen The maximum number of bytes of the message.");
+    emit(4,         " * @return The size of the encoded message, or <0 if it is not valid.");
+    emit(4,         " */");
+    emit(4,         "inline int init(const void *buf, int offset, int maxlen);");
+    emit(0, "");
+    emit(4,         "/**");
+    emit(4,         " * The encoded members, without the fingerprint, for forwarding them.");
+    emit(4,         " */");
+    emit(4,         "const void *getEncodedMembers() const { return encoded; }");
+    emit(4,         "int getEncodedMembersSize() const { return encoded_size; }");
+
+    for (unsigned int m = 0; m < num_members; m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *t = lm->type->lctypename;
+        const char *mn = lm->membername;
+        int ndim = g_ptr_array_size(lm->dimensions);
+        int size = lcm_primitive_encoded_size(t);
+        char *ct = map_type_name(t);
+
+        if (size || !ndim)
+            emit(0, "");
+        if (size && !ndim) {
+            emit(4, "%s get_%s() const", ct, mn);
+            emit(4, "{");
+            emit(5,     "%s v;", ct);
+            emit(5,     "__%s_decode_array(encoded, offsets[%d], %d, &v, 1);", t, m, size);
+            emit(5,     "return v;");
+            emit(4, "}");
+        } else if (size) {
+            char *count = view_count_expr(lm);
+            emit(4, "/**");
+            emit(4, " * The elements of %s, in row-major order.", mn);
+            emit(4, " */");
+            emit(4, "lcm::ArrayView< %s > get_%s() const", ct, mn);
+            emit(4, "{");
+            emit(5,     "return lcm::ArrayView< %s >(encoded + offsets[%d], (int) (%s));", ct, m, count);
+            emit(4, "}");
+            free(count);
+        } else if (!ndim && !strcmp(t, "string")) {
+            emit(4, "const char *get_%s() const", mn);
+            emit(4, "{");
+            emit(5,     "return (const char *) encoded + offsets[%d] + 4;", m);
+            emit(4, "}");
+        } else if (!ndim) {
+            emit(4, "%s::View get_%s() const", ct, mn);
+            emit(4, "{");
+            emit(5,     "%s::View member;", ct);
+            emit(5,     "member._initNoHash(encoded, offsets[%d], encoded_size - offsets[%d]);", m, m);
+            emit(5,     "return member;");
+            emit(4, "}");
+        }
+        free(ct);
+    }
+    emit(0, "");
+    emit(4,         "// LCM support functions. Users should not call these");
+    emit(4,         "inline int _initNoHash(const void *buf, int offset, int maxlen);");
+    emit(0, "");
+    emit(3,     "private:");
+    emit(4,         "const uint8_t *encoded;");
+    emit(4,         "int encoded_size;");
+    emit(4,         "int offsets[%d];", num_members ? num_members : 1);
+    emit(2, "};");
+}
+
+static void emit_view_init(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+
+    emit(0, "int %s::View::init(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, tlen;");
+    emit(1,     "int64_t msg_hash;");
+    emit(0, "");
+    emit(1,     "tlen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &msg_hash, 1);");
+    emit(1,     "if (tlen < 0) return tlen; else pos += tlen;");
+    emit(1,     "if (msg_hash != getHash()) return -1;");
+    emit(0, "");
+    emit(1,     "tlen = this->_initNoHash(buf, offset + pos, maxlen - pos);");
+    emit(1,     "if (tlen < 0) return tlen; else pos += tlen;");
+    emit(0, "");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+
+    emit(0, "int %s::View::_initNoHash(const void *buf, int offset, int maxlen)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0;");
+    if (g_ptr_array_size(ls->members))
+        emit(1, "int64_t n;");
+    emit(0, "");
+    emit(1,     "encoded = static_cast<const uint8_t *>(buf) + offset;");
+    emit(1,     "if (maxlen < 0) return -1;");
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        const char *t = lm->type->lctypename;
+        int size = lcm_primitive_encoded_size(t);
+
+        emit(1, "offsets[%d] = pos;", m);
+        emit(1, "n = 1;");
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            if (ld->mode == LCM_CONST)
+                emit(1, "n = __lcm_view_count(n, %s, maxlen);", ld->size);
+            else
+                emit(1, "n = __lcm_view_count(n, get_%s(), maxlen);", ld->size);
+        }
+        if (size) {
+            emit(1, "if (n < 0 || n > (maxlen - pos) / %d) return -1;", size);
+            emit(1, "pos += (int) n * %d;", size);
+        } else {
+            emit(1, "if (n < 0) return -1;");
+            emit(1, "while (n-- > 0) {");
+            if (!strcmp(t, "string")) {
+                emit(2, "int tlen = __string_view_skip(encoded, pos, maxlen - pos);");
+            } else {
+                char *tnc = dots_to_double_colons(t);
+                emit(2, "%s::View member;", tnc);
+                emit(2, "int tlen = member._initNoHash(encoded, pos, maxlen - pos);");
+                free(tnc);
+            }
+            emit(2, "if (tlen < 0) return tlen; else pos += tlen;");
+            emit(1, "}");
+        }
+        emit(0, "");
+    }
+    emit(1,     "encoded_size = pos;");
+    emit(1,     "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
 static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
 {
     char *tn = ls->structname->lctypename;
@@ -203,7 +661,13 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     fprintf(f, "#define __%s_hpp__\n", tn_);
     fprintf(f, "\n");
     fprintf(f, "#include <lcm/lcm_coretypes.h>\n");
+    if (getopt_get_bool(lcmgen->gopt, "cpp-views"))
+        fprintf(f, "#include <lcm/lcm_array_view.hpp>\n");
     fprintf(f, "\n");
+    fprintf(f, "#include <algorithm>\n");
+    fprintf(f, "#if __cplusplus >= 201103L\n");
+    fprintf(f, "#include <type_traits>\n");
+    fprintf(f, "#endif\n");
 
     // do we need to #include <vector> and/or <string>?
     int emit_include_vector = 0;
@@ -249,13 +713,21 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     // data members
     if(g_ptr_array_size(ls->members)) {
         emit(1, "public:");
+        for (unsigned int mind = 0; mind < g_ptr_array_size(ls->members); mind++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, mind);
+            lcm_struct_t *es = soa_element_type(lcmgen, ls, lm);
+            if (es)
+                emit_header_soa_class(lcmgen, f, lm, es);
+        }
         for (unsigned int mind = 0; mind < g_ptr_array_size(ls->members); mind++) {
             lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, mind);
 
             emit_comment(f, 2, lm->comment);
             char* mapped_typename = map_type_name(lm->type->lctypename);
             int ndim = g_ptr_array_size(lm->dimensions);
-            if (ndim == 0) {
+            if (soa_element_type(lcmgen, ls, lm)) {
+                emit(2, "%s_columns %s;", lm->membername, lm->membername);
+            } else if (ndim == 0) {
                 emit(2, "%-10s %s;", mapped_typename, lm->membername);
             } else {
                 if (lcm_is_constant_size_array(lm)) {
@@ -325,6 +797,16 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
         emit(0, "");
     }
 
+    if (lcm_struct_fixed_encoded_size(ls) >= 0) {
+        emit(1, "public:");
+        emit(2, "/**");
+        emit(2, " * The type has no strings, nested types or variable-length arrays, so");
+        emit(2, " * every message of it is encoded in ENCODED_SIZE bytes.");
+        emit(2, " */");
+        emit(2, "enum { ENCODED_SIZE = %d };", lcm_struct_fixed_encoded_size(ls) + 8);
+        emit(0, "");
+    }
+
     emit(1, "public:");
     emit(2, "/**");
     emit(2, " * Encode a message into binary form.");
@@ -338,6 +820,15 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(2, "inline int encode(void *buf, int offset, int maxlen) const;");
     emit(0, "");
     emit(2, "/**");
+    emit(2, " * Encode a message into a stream, which passes the encoded bytes on in");
+    emit(2, " * pieces, for messages too large to encode into one buffer.  The");
+    emit(2, " * stream is not flushed at the end.");
+    emit(2, " *");
+    emit(2, " * @return 0 on success, or <0 on error.");
+    emit(2, " */");
+    emit(2, "inline int encode(lcm_encode_stream_t *stream) const;");
+    emit(0, "");
+    emit(2, "/**");
     emit(2, " * Check how many bytes are required to encode this message.");
     emit(2, " */");
     emit(2, "inline int getEncodedSize() const;");
@@ -352,6 +843,8 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(2, " */");
     emit(2, "inline int decode(const void *buf, int offset, int maxlen);");
     emit(0, "");
+    if (getopt_get_bool(lcmgen->gopt, "cpp-decode-fields"))
+        emit_header_decode_fields(lcmgen, f, ls);
     emit(2, "/**");
     emit(2, " * Retrieve the 64-bit fingerprint identifying the structure of the message.");
     emit(2, " * Note that the fingerprint is the same for all instances of the same");
@@ -364,19 +857,77 @@ static void emit_header_start(lcmgen_t *lcmgen, FILE *f, lcm_struct_t *ls)
     emit(2, " * Returns \"%s\"", ls->structname->shortname);
     emit(2, " */");
     emit(2, "inline static const char* getTypeName();");
+    emit(0, "");
+    emit(2, "/**");
+    emit(2, " * Exchange the contents of this instance with @p other, without copying");
+    emit(2, " * the contents of its strings and variable-length arrays.");
+    emit(2, " */");
+    emit(2, "inline void swap(%s& other);", sn);
 
     emit(0, "");
     emit(2, "// LCM support functions. Users should not call these");
     emit(2, "inline int _encodeNoHash(void *buf, int offset, int maxlen) const;");
+    emit(2, "inline int _encodeNoHash(lcm_encode_stream_t *stream) const;");
     emit(2, "inline int _getEncodedSizeNoHash() const;");
     emit(2, "inline int _decodeNoHash(const void *buf, int offset, int maxlen);");
     emit(2, "inline static uint64_t _computeHash(const __lcm_hash_ptr *p);");
+    if (getopt_get_bool(lcmgen->gopt, "cpp-decode-fields")) {
+        emit(2, "inline int _decodeFieldsNoHash(const void *buf, int offset, int maxlen, uint64_t mask);");
+        emit(2, "inline static int _skipNoHash(const void *buf, int offset, int maxlen, int elements);");
+    }
+    if (getopt_get_bool(lcmgen->gopt, "cpp-views"))
+        emit_header_view(lcmgen, f, ls);
     emit(0, "};");
     emit(0, "");
+    emit(0, "inline void swap(%s& a, %s& b)", sn, sn);
+    emit(0, "{");
+    emit(1,     "a.swap(b);");
+    emit(0, "}");
+    emit(0, "");
+    emit(0, "#if __cplusplus >= 201103L");
+    emit(0, "// The implicit move constructor moves the strings and vectors, so that");
+    emit(0, "// containers of messages and message queues don't copy them.");
+    emit(0, "static_assert(std::is_nothrow_move_constructible<%s>::value,", sn);
+    emit(0, "        \"%s must be nothrow move constructible\");", sn);
+    emit(0, "#endif");
+    emit(0, "");
 
     free(tn_);
 }
 
+static void emit_swap(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    emit(0, "void %s::swap(%s& other)", sn, sn);
+    emit(0, "{");
+    if (g_ptr_array_size(ls->members) == 0)
+        emit(1, "(void) other;");
+    else
+        emit(1, "using std::swap;");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        int ndim = g_ptr_array_size(lm->dimensions);
+        // vectors swap as a whole, fixed-size arrays element by element
+        if (ndim == 0 || !lcm_is_constant_size_array(lm)) {
+            emit(1, "swap(this->%s, other.%s);", lm->membername, lm->membername);
+            continue;
+        }
+        for (int d = 0; d < ndim; d++) {
+            lcm_dimension_t *ld = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            emit(1 + d, "for (int a%d = 0; a%d < %s; a%d++)", d, d, ld->size, d);
+        }
+        emit_start(1 + ndim, "swap(this->%s", lm->membername);
+        for (int d = 0; d < ndim; d++)
+            emit_continue("[a%d]", d);
+        emit_continue(", other.%s", lm->membername);
+        for (int d = 0; d < ndim; d++)
+            emit_continue("[a%d]", d);
+        emit_end(");");
+    }
+    emit(0, "}");
+    emit(0, "");
+}
+
 static void emit_encode(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char* sn = ls->structname->shortname;
@@ -401,7 +952,10 @@ static void emit_encoded_size(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     const char *sn = ls->structname->shortname;
     emit(0,"int %s::getEncodedSize() const", sn);
     emit(0,"{");
-    emit(1, "return 8 + _getEncodedSizeNoHash();");
+    if (lcm_struct_fixed_encoded_size(ls) >= 0)
+        emit(1, "return ENCODED_SIZE;");
+    else
+        emit(1, "return 8 + _getEncodedSizeNoHash();");
     emit(0,"}");
     emit(0,"");
 }
@@ -431,6 +985,13 @@ static void emit_get_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     const char *sn  = ls->structname->shortname;
     emit(0, "int64_t %s::getHash()", sn);
     emit(0, "{");
+    if (lcm_struct_fixed_encoded_size(ls) >= 0) {
+        // the hash of the type doesn't depend on any other type
+        emit(1,     "return static_cast<int64_t>(0x%016"PRIx64"ULL);", lcm_struct_fingerprint(ls));
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
     emit(1,     "static int64_t hash = static_cast<int64_t>(_computeHash(NULL));");
     emit(1,     "return hash;");
     emit(0, "}");
@@ -482,9 +1043,35 @@ static void emit_compute_hash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0, "");
 }
 
+// A constant-size multidimensional array of a primitive type is contiguous,
+// so it is encoded or decoded by one call over all of its elements, instead
+// of one call per row.  Returns 1 if the call was emitted.
+static int emit_flat_primitive_array(FILE *f, lcm_member_t *lm, const char *op, int indent)
+{
+    int ndim = g_ptr_array_size(lm->dimensions);
+    if (ndim < 2 || !lcm_is_constant_size_array(lm) ||
+            !lcm_is_primitive_type(lm->type->lctypename) ||
+            !strcmp(lm->type->lctypename, "string"))
+        return 0;
+
+    emit_start(indent, "tlen = __%s_%s_array(buf, offset + pos, maxlen - pos, &this->%s",
+            lm->type->lctypename, op, lm->membername);
+    for (int d = 0; d < ndim; d++)
+        emit_continue("[0]");
+    for (int d = 0; d < ndim; d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, d);
+        emit_continue("%s%s", d ? " * " : ", ", dim->size);
+    }
+    emit_end(");");
+    emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+    return 1;
+}
+
 static void _encode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int depth, int extra_indent)
 {
     int indent = extra_indent + 1 + depth;
+    if (depth == 0 && emit_flat_primitive_array(f, lm, "encode", indent))
+        return;
     // primitive array
     if (depth+1 == g_ptr_array_size(lm->dimensions) &&
             lcm_is_primitive_type(lm->type->lctypename) &&
@@ -502,11 +1089,11 @@ static void _encode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int dept
     //
     if(depth == g_ptr_array_size(lm->dimensions)) {
         if(!strcmp(lm->type->lctypename, "string")) {
-            emit_start(indent, "char* __cstr = const_cast<char*>(this->%s", lm->membername);
+            emit_start(indent, "const std::string& __str = this->%s", lm->membername);
             for(int i=0; i<depth; i++)
                 emit_continue("[a%d]", i);
-            emit_end(".c_str());");
-            emit(indent, "tlen = __string_encode_array(buf, offset + pos, maxlen - pos, &__cstr, 1);");
+            emit_end(";");
+            emit(indent, "tlen = __string_encode_sized(buf, offset + pos, maxlen - pos, __str.c_str(), __str.size());");
         } else {
             emit_start(indent, "tlen = this->%s", lm->membername);
             for(int i=0; i<depth; i++)
@@ -545,13 +1132,15 @@ static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
         int num_dims = g_ptr_array_size(lm->dimensions);
+        lcm_struct_t *es = soa_element_type(lcm, ls, lm);
 
-        if (0 == num_dims) {
+        if (es) {
+            emit_encode_soa(lcm, f, lm, es);
+        } else if (0 == num_dims) {
             if (lcm_is_primitive_type(lm->type->lctypename)) {
                 if(!strcmp(lm->type->lctypename, "string")) {
-                    emit(1, "char* %s_cstr = const_cast<char*>(this->%s.c_str());", lm->membername, lm->membername);
-                    emit(1, "tlen = __string_encode_array(buf, offset + pos, maxlen - pos, &%s_cstr, 1);",
-                            lm->membername);
+                    emit(1, "tlen = __string_encode_sized(buf, offset + pos, maxlen - pos, this->%s.c_str(), this->%s.size());",
+                            lm->membername, lm->membername);
                 } else {
                 emit(1, "tlen = __%s_encode_array(buf, offset + pos, maxlen - pos, &this->%s, 1);",
                     lm->type->lctypename, lm->membername);
@@ -584,13 +1173,111 @@ static void emit_encode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0,"");
 }
 
+static void _encode_stream_recursive(FILE *f, lcm_member_t *lm, int depth)
+{
+    const char *t = lm->type->lctypename;
+    int ndim = g_ptr_array_size(lm->dimensions);
+    int size = lcm_primitive_encoded_size(t);
+    int indent = 1 + depth;
+
+    if (depth == 0 && ndim > 1 && size && lcm_is_constant_size_array(lm)) {
+        // contiguous, see emit_flat_primitive_array()
+        emit_start(indent, "if (__lcm_stream_put(stream, &this->%s", lm->membername);
+        for (int d = 0; d < ndim; d++)
+            emit_continue("[0]");
+        for (int d = 0; d < ndim; d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, d);
+            emit_continue("%s%s", d ? " * " : ", ", dim->size);
+        }
+        emit_end(", %d) < 0) return -1;", size);
+        return;
+    }
+    if (size && depth + 1 == ndim) {
+        lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
+        if (is_dim_size_fixed(dim->size))
+            emit_start(indent, "if (");
+        else
+            emit_start(indent, "if (%s%s > 0 && ", dim_size_prefix(dim->size), dim->size);
+        emit_continue("__lcm_stream_put(stream, &this->%s", lm->membername);
+        for (int i = 0; i < depth; i++)
+            emit_continue("[a%d]", i);
+        emit_end("[0], %s%s, %d) < 0) return -1;", dim_size_prefix(dim->size), dim->size, size);
+        return;
+    }
+    if (depth == ndim) {
+        if (size) {
+            emit_start(indent, "if (__lcm_stream_put(stream, &this->%s", lm->membername);
+        } else if (!strcmp(t, "string") && depth == 0) {
+            emit(indent, "if (__lcm_stream_put_string(stream, this->%s.c_str(), this->%s.size()) < 0) return -1;",
+                    lm->membername, lm->membername);
+            return;
+        } else if (!strcmp(t, "string")) {
+            emit_start(indent, "const std::string& __str = this->%s", lm->membername);
+            for (int i = 0; i < depth; i++)
+                emit_continue("[a%d]", i);
+            emit_end(";");
+            emit(indent, "if (__lcm_stream_put_string(stream, __str.c_str(), __str.size()) < 0) return -1;");
+            return;
+        } else {
+            emit_start(indent, "if (this->%s", lm->membername);
+        }
+        for (int i = 0; i < depth; i++)
+            emit_continue("[a%d]", i);
+        if (size)
+            emit_end(", 1, %d) < 0) return -1;", size);
+        else
+            emit_end("._encodeNoHash(stream) < 0) return -1;");
+        return;
+    }
+
+    lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
+    emit(indent, "for (int a%d = 0; a%d < %s%s; a%d++) {",
+            depth, depth, dim_size_prefix(dim->size), dim->size, depth);
+    _encode_stream_recursive(f, lm, depth + 1);
+    emit(indent, "}");
+}
+
+static void emit_encode_stream(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    emit(0, "int %s::encode(lcm_encode_stream_t *stream) const", sn);
+    emit(0, "{");
+    emit(1,     "int64_t hash = getHash();");
+    emit(1,     "if (__lcm_stream_put(stream, &hash, 1, 8) < 0) return -1;");
+    emit(1,     "return this->_encodeNoHash(stream);");
+    emit(0, "}");
+    emit(0, "");
+
+    if (g_ptr_array_size(ls->members) == 0) {
+        emit(0, "int %s::_encodeNoHash(lcm_encode_stream_t *) const", sn);
+        emit(0, "{");
+        emit(1,     "return 0;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+    emit(0, "int %s::_encodeNoHash(lcm_encode_stream_t *stream) const", sn);
+    emit(0, "{");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        lcm_struct_t *es = soa_element_type(lcm, ls, lm);
+        if (es)
+            emit_encode_stream_soa(lcm, f, lm, es);
+        else
+            _encode_stream_recursive(f, lm, 0);
+    }
+    emit(1,     "return 0;");
+    emit(0, "}");
+    emit(0, "");
+}
+
 static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
     const char *sn = ls->structname->shortname;
     emit(0, "int %s::_getEncodedSizeNoHash() const", sn);
     emit(0, "{");
-    if(0 == g_ptr_array_size(ls->members)) {
-        emit(1,     "return 0;");
+    if (lcm_struct_fixed_encoded_size(ls) >= 0) {
+        emit(1,     "return %d;", lcm_struct_fixed_encoded_size(ls));
         emit(0,"}");
         emit(0,"");
         return;
@@ -599,8 +1286,12 @@ static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
         int ndim = g_ptr_array_size(lm->dimensions);
+        lcm_struct_t *es = soa_element_type(lcm, ls, lm);
 
-        if(lcm_is_primitive_type(lm->type->lctypename) &&
+        if (es) {
+            lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, 0);
+            emit(1, "enc_size += this->%s * %d;", dim->size, lcm_struct_fixed_encoded_size(es));
+        } else if(lcm_is_primitive_type(lm->type->lctypename) &&
                 strcmp(lm->type->lctypename, "string")) {
             emit_start(1, "enc_size += ");
             for(int n=0; n < ndim - 1; n++) {
@@ -638,21 +1329,26 @@ static void emit_encoded_size_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     emit(0,"");
 }
 
-static void _decode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int depth)
+static void _decode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int depth, int extra_indent)
 {
+    int indent = extra_indent + 1 + depth;
+    if (depth == 0 && emit_flat_primitive_array(f, lm, "decode", indent))
+        return;
     // primitive array
     if (depth+1 == g_ptr_array_size(lm->dimensions) &&
         lcm_is_primitive_type(lm->type->lctypename) &&
         strcmp(lm->type->lctypename, "string")) {
         lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
 
-        int decode_indent = 1 + depth;
+        int decode_indent = indent;
         if(!lcm_is_constant_size_array(lm)) {
-            emit(1 + depth, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
-            emit_start(2 + depth, "this->%s", lm->membername);
+            // resizing keeps the capacity of a message that is decoded into
+            // again, and drops the elements of a longer array
+            emit_start(indent, "this->%s", lm->membername);
             for(int i=0; i<depth; i++)
                 emit_continue("[a%d]", i);
             emit_end(".resize(%s%s);", dim_size_prefix(dim->size), dim->size);
+            emit(indent, "if(%s%s) {", dim_size_prefix(dim->size), dim->size);
             decode_indent++;
         }
 
@@ -663,46 +1359,69 @@ static void _decode_recursive(lcmgen_t* lcm, FILE* f, lcm_member_t* lm, int dept
         emit_end("[0], %s%s);", dim_size_prefix(dim->size), dim->size);
         emit(decode_indent, "if(tlen < 0) return tlen; else pos += tlen;");
         if(!lcm_is_constant_size_array(lm)) {
-            emit(1 + depth, "}");
+            emit(indent, "}");
         }
     } else if(depth == g_ptr_array_size(lm->dimensions)) {
         if(!strcmp(lm->type->lctypename, "string")) {
-            emit(1 + depth, "int32_t __elem_len;");
-            emit(1 + depth, "tlen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &__elem_len, 1);");
-            emit(1 + depth, "if(tlen < 0) return tlen; else pos += tlen;");
-            emit(1 + depth, "if(__elem_len > maxlen - pos) return -1;");
-            emit_start(1 + depth, "this->%s", lm->membername);
+            emit(indent, "int32_t __elem_len;");
+            emit(indent, "tlen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &__elem_len, 1);");
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+            emit(indent, "if(__elem_len > maxlen - pos) return -1;");
+            emit_start(indent, "this->%s", lm->membername);
             for(int i=0; i<depth; i++)
                 emit_continue("[a%d]", i);
             emit_end(".assign(static_cast<const char*>(buf) + offset + pos, __elem_len -  1);");
-            emit(1 + depth, "pos += __elem_len;");
+            emit(indent, "pos += __elem_len;");
         } else {
-            emit_start(1 + depth, "tlen = this->%s", lm->membername);
+            emit_start(indent, "tlen = this->%s", lm->membername);
             for(int i=0; i<depth; i++)
                 emit_continue("[a%d]", i);
             emit_end("._decodeNoHash(buf, offset + pos, maxlen - pos);");
-            emit(1 + depth, "if(tlen < 0) return tlen; else pos += tlen;");
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
         }
     } else {
         lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
 
         if(!lcm_is_constant_size_array(lm)) {
-            emit(1+depth, "try {");
-            emit_start(2+depth, "this->%s", lm->membername);
+            emit(indent, "try {");
+            emit_start(indent + 1, "this->%s", lm->membername);
             for(int i=0; i<depth; i++) {
                 emit_continue("[a%d]", i);
             }
             emit_end(".resize(%s%s);", dim_size_prefix(dim->size), dim->size);
-            emit(1+depth, "} catch (...) {");
-            emit(2+depth, "return -1;");
-            emit(1+depth, "}");
+            emit(indent, "} catch (...) {");
+            emit(indent + 1, "return -1;");
+            emit(indent, "}");
         }
-        emit(1+depth, "for (int a%d = 0; a%d < %s%s; a%d++) {",
+        emit(indent, "for (int a%d = 0; a%d < %s%s; a%d++) {",
                 depth, depth, dim_size_prefix(dim->size), dim->size, depth);
 
-        _decode_recursive(lcm, f, lm, depth+1);
+        _decode_recursive(lcm, f, lm, depth+1, extra_indent);
 
-        emit(1+depth, "}");
+        emit(indent, "}");
+    }
+}
+
+static void emit_decode_member(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, lcm_member_t *lm, int extra_indent)
+{
+    int indent = extra_indent + 1;
+    lcm_struct_t *es = soa_element_type(lcm, ls, lm);
+    if (es) {
+        emit_decode_soa(lcm, f, lm, es, extra_indent);
+    } else if (0 == g_ptr_array_size(lm->dimensions) && lcm_is_primitive_type(lm->type->lctypename)) {
+        if(!strcmp(lm->type->lctypename, "string")) {
+            emit(indent, "int32_t __%s_len__;", lm->membername);
+            emit(indent, "tlen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &__%s_len__, 1);", lm->membername);
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+            emit(indent, "if(__%s_len__ > maxlen - pos) return -1;", lm->membername);
+            emit(indent, "this->%s.assign(static_cast<const char*>(buf) + offset + pos, __%s_len__ - 1);", lm->membername, lm->membername);
+            emit(indent, "pos += __%s_len__;", lm->membername);
+        } else {
+            emit(indent, "tlen = __%s_decode_array(buf, offset + pos, maxlen - pos, &this->%s, 1);", lm->type->lctypename, lm->membername);
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+        }
+    } else {
+        _decode_recursive(lcm, f, lm, 0, extra_indent);
     }
 }
 
@@ -724,31 +1443,216 @@ static void emit_decode_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
 
-        if (0 == g_ptr_array_size(lm->dimensions) && lcm_is_primitive_type(lm->type->lctypename)) {
-            if(!strcmp(lm->type->lctypename, "string")) {
-                emit(1, "int32_t __%s_len__;", lm->membername);
-                emit(1, "tlen = __int32_t_decode_array(buf, offset + pos, maxlen - pos, &__%s_len__, 1);", lm->membername);
-                emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
-                emit(1, "if(__%s_len__ > maxlen - pos) return -1;", lm->membername);
-                emit(1, "this->%s.assign(static_cast<const char*>(buf) + offset + pos, __%s_len__ - 1);", lm->membername, lm->membername);
-                emit(1, "pos += __%s_len__;", lm->membername);
-            } else {
-                emit(1, "tlen = __%s_decode_array(buf, offset + pos, maxlen - pos, &this->%s, 1);", lm->type->lctypename, lm->membername);
-                emit(1, "if(tlen < 0) return tlen; else pos += tlen;");
-            }
+        emit_decode_member(lcm, f, ls, lm, 0);
+        emit(0,"");
+    }
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+/** Partial decoding **/
+
+// Whether member lm is the size of a variable-length array of ls
+static int is_dimension_member(lcm_struct_t *ls, lcm_member_t *lm)
+{
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *other = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        for (unsigned int d = 0; d < g_ptr_array_size(other->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(other->dimensions, d);
+            if (dim->mode == LCM_VAR && !strcmp(dim->size, lm->membername))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether skipping member lm needs the variable n
+static int skip_needs_count(lcm_member_t *lm)
+{
+    if (g_ptr_array_size(lm->dimensions) == 0)
+        return 0;
+    return !lcm_is_constant_size_array(lm) || !lcm_primitive_encoded_size(lm->type->lctypename);
+}
+
+// Emits code that moves pos past the encoded member lm, reading only the
+// lengths of its variable-length parts.  dim_fmt formats the variable
+// holding a variable-length dimension from the name of its member.
+static void emit_skip_member(lcmgen_t *lcm, FILE *f, lcm_member_t *lm, const char *dim_fmt, int indent)
+{
+    const char *t = lm->type->lctypename;
+    int size = lcm_primitive_encoded_size(t);
+
+    if (!skip_needs_count(lm)) {
+        if (!strcmp(t, "string")) {
+            emit(indent, "tlen = __string_view_skip(buf, offset + pos, maxlen - pos);");
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+            return;
+        }
+        if (!size) {
+            char *tn = dots_to_double_colons(t);
+            emit(indent, "tlen = %s::_skipNoHash(buf, offset + pos, maxlen - pos, 1);", tn);
+            emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+            free(tn);
+            return;
+        }
+        // a scalar or an array of constant size
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            size *= atoi(dim->size);
+        }
+        emit(indent, "if(maxlen - pos < %d) return -1;", size);
+        emit(indent, "pos += %d;", size);
+        return;
+    }
+
+    emit(indent, "n = 1;");
+    for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+        if (dim->mode == LCM_CONST) {
+            emit(indent, "n = __lcm_view_count(n, %s, maxlen);", dim->size);
         } else {
-            _decode_recursive(lcm, f, lm, 0);
+            char *var = g_strdup_printf(dim_fmt, dim->size);
+            emit(indent, "n = __lcm_view_count(n, %s, maxlen);", var);
+            g_free(var);
         }
+    }
+    if (size) {
+        emit(indent, "if(n < 0 || n > (maxlen - pos) / %d) return -1;", size);
+        emit(indent, "pos += static_cast<int>(n) * %d;", size);
+    } else if (!strcmp(t, "string")) {
+        emit(indent, "if(n < 0) return -1;");
+        emit(indent, "while(n-- > 0) {");
+        emit(indent + 1, "tlen = __string_view_skip(buf, offset + pos, maxlen - pos);");
+        emit(indent + 1, "if(tlen < 0) return tlen; else pos += tlen;");
+        emit(indent, "}");
+    } else {
+        char *tn = dots_to_double_colons(t);
+        emit(indent, "if(n < 0) return -1;");
+        emit(indent, "tlen = %s::_skipNoHash(buf, offset + pos, maxlen - pos, static_cast<int>(n));", tn);
+        emit(indent, "if(tlen < 0) return tlen; else pos += tlen;");
+        free(tn);
+    }
+}
 
-        emit(0,"");
+static void emit_decode_fields(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char* sn = ls->structname->shortname;
+    emit(0, "int %s::decodeFields(const void *buf, int offset, int maxlen, uint64_t mask)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, thislen;");
+    emit(0, "");
+    emit(1,     "int64_t msg_hash;");
+    emit(1,     "thislen = __int64_t_decode_array(buf, offset + pos, maxlen - pos, &msg_hash, 1);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(1,     "if (msg_hash != getHash()) return -1;");
+    emit(0, "");
+    emit(1,     "thislen = this->_decodeFieldsNoHash(buf, offset + pos, maxlen - pos, mask);");
+    emit(1,     "if (thislen < 0) return thislen; else pos += thislen;");
+    emit(0, "");
+    emit(1,  "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
+static void emit_decode_fields_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char* sn = ls->structname->shortname;
+    if(0 == g_ptr_array_size(ls->members)) {
+        emit(0, "int %s::_decodeFieldsNoHash(const void *, int, int, uint64_t)", sn);
+        emit(0, "{");
+        emit(1,     "return 0;");
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+    int need_count = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (!is_dimension_member(ls, lm))
+            need_count |= skip_needs_count(lm);
+    }
+    emit(0, "int %s::_decodeFieldsNoHash(const void *buf, int offset, int maxlen, uint64_t mask)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, tlen;");
+    if (need_count)
+        emit(1, "int64_t n;");
+    emit(0, "");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+
+        emit(1, "if((mask >> %d) == 0) return pos;", decode_fields_bit(m));
+        if (is_dimension_member(ls, lm)) {
+            emit_decode_member(lcm, f, ls, lm, 0);
+        } else {
+            emit(1, "if(mask & FIELD_%s) {", lm->membername);
+            emit_decode_member(lcm, f, ls, lm, 1);
+            emit(1, "} else {");
+            emit_skip_member(lcm, f, lm, "this->%s", 2);
+            emit(1, "}");
+        }
+        emit(0, "");
     }
     emit(1, "return pos;");
     emit(0, "}");
     emit(0, "");
 }
 
+static void emit_skip_nohash(lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char* sn = ls->structname->shortname;
+    int fixed_size = lcm_struct_fixed_encoded_size(ls);
+
+    if (fixed_size >= 0) {
+        emit(0, "int %s::_skipNoHash(const void *, int, int maxlen, int elements)", sn);
+        emit(0, "{");
+        emit(1,     "if(static_cast<int64_t>(elements) * %d > maxlen) return -1;", fixed_size);
+        emit(1,     "return elements * %d;", fixed_size);
+        emit(0, "}");
+        emit(0, "");
+        return;
+    }
+
+    emit(0, "int %s::_skipNoHash(const void *buf, int offset, int maxlen, int elements)", sn);
+    emit(0, "{");
+    emit(1,     "int pos = 0, tlen;");
+    int need_count = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (is_dimension_member(ls, lm)) {
+            char *mapped_typename = map_type_name(lm->type->lctypename);
+            emit(1, "%s __%s_dim__;", mapped_typename, lm->membername);
+            free(mapped_typename);
+        } else {
+            need_count |= skip_needs_count(lm);
+        }
+    }
+    if (need_count)
+        emit(1, "int64_t n;");
+    emit(0, "");
+    emit(1, "for(int element = 0; element < elements; element++) {");
+    for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
+        if (is_dimension_member(ls, lm)) {
+            emit(2, "tlen = __%s_decode_array(buf, offset + pos, maxlen - pos, &__%s_dim__, 1);",
+                 lm->type->lctypename, lm->membername);
+            emit(2, "if(tlen < 0) return tlen; else pos += tlen;");
+        } else {
+            emit_skip_member(lcm, f, lm, "__%s_dim__", 2);
+        }
+        emit(0, "");
+    }
+    emit(1, "}");
+    emit(1, "return pos;");
+    emit(0, "}");
+    emit(0, "");
+}
+
 int emit_cpp(lcmgen_t *lcmgen)
 {
+    if (check_soa_members(lcmgen) < 0)
+        return -1;
+
     // iterate through all defined message types
     for (unsigned int i = 0; i < g_ptr_array_size(lcmgen->structs); i++) {
         lcm_struct_t *lr = (lcm_struct_t *) g_ptr_array_index(lcmgen->structs, i);
@@ -781,10 +1685,20 @@ int emit_cpp(lcmgen_t *lcmgen)
             emit(0, "}");
             emit(0, "");
 
+            emit_swap(lcmgen, f, lr);
+
             emit_encode_nohash(lcmgen, f, lr);
+            emit_encode_stream(lcmgen, f, lr);
             emit_decode_nohash(lcmgen, f, lr);
             emit_encoded_size_nohash(lcmgen, f, lr);
             emit_compute_hash(lcmgen, f, lr);
+            if (getopt_get_bool(lcmgen->gopt, "cpp-decode-fields")) {
+                emit_decode_fields(lcmgen, f, lr);
+                emit_decode_fields_nohash(lcmgen, f, lr);
+                emit_skip_nohash(lcmgen, f, lr);
+            }
+            if (getopt_get_bool(lcmgen->gopt, "cpp-views"))
+                emit_view_init(lcmgen, f, lr);
 
             emit_package_namespace_close(lcmgen, f, lr);
             emit(0, "#endif");
@@ -144,14 +144,24 @@ static void make_accessor(lcm_member_t *lm, const char *obj, char *s)
 	}
 }
 
-static int struct_has_string_member(lcm_struct_t *lr) 
+// One-dimensional arrays of primitives other than string are converted in
+// one call to LCMDataInputStream.ReadArray / LCMDataOutputStream.WriteArray.
+static int is_bulk_array(lcm_member_t *lm, primitive_info_t *pinfo)
 {
-    for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
-        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, member);
-        if(!strcmp("string", lm->type->lctypename))
-            return 1;
+    return pinfo != NULL && strcmp("string", lm->type->lctypename) &&
+        g_ptr_array_size(lm->dimensions) == 1;
+}
+
+static void emit_array_dims(FILE *f, lcm_member_t *lm)
+{
+    emit_continue("[");
+    for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
+        lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
+        emit_continue("(int) %s", dim->size);
+        if (i < (g_ptr_array_size(lm->dimensions)-1))
+            emit_continue(",");
     }
-    return 0;
+    emit_continue("]");
 }
 
 static const char * dim_size_prefix(const char *dim_size) {
@@ -184,8 +194,8 @@ int emit_csharp(lcmgen_t *lcm)
                                                "# = ins.ReadInt64();",  
                                                "outs.Write(#);"));
     g_hash_table_insert(type_table, "string",   prim("String",
-                                               "__strbuf = new byte[ins.ReadInt32()-1]; ins.ReadFully(__strbuf); ins.ReadByte(); # = System.Text.Encoding.GetEncoding(\"US-ASCII\").GetString(__strbuf);",
-                                               "__strbuf = System.Text.Encoding.GetEncoding(\"US-ASCII\").GetBytes(#); outs.Write(__strbuf.Length+1); outs.Write(__strbuf, 0, __strbuf.Length); outs.Write((byte) 0);"));
+                                               "# = ins.ReadLCMString();",
+                                               "outs.WriteLCMString(#);"));
     g_hash_table_insert(type_table, "boolean",  prim("bool",
                                                "# = ins.ReadBoolean();",
                                                "outs.Write(#);"));
@@ -478,8 +488,6 @@ int emit_csharp(lcmgen_t *lcm)
 
         emit(2,"public void _encodeRecursive(LCMDataOutputStream outs)");
         emit(2,"{");
-        if(struct_has_string_member(lr))
-            emit(3, "byte[] __strbuf = null;");
         char accessor[1024];
 
         for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
@@ -487,6 +495,14 @@ int emit_csharp(lcmgen_t *lcm)
             primitive_info_t *pinfo = (primitive_info_t*) g_hash_table_lookup(type_table, lm->type->lctypename);
             make_accessor(lm, "this", accessor);
 
+            if (is_bulk_array(lm, pinfo)) {
+                lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, 0);
+                emit(3, "outs.WriteArray(this.%s, 0, (int) %s%s);",
+                        lm->membername, dim_size_prefix(dim->size), dim->size);
+                emit(0," ");
+                continue;
+            }
+
             for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
                 lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
                 emit(3+i, "for (int %c = 0; %c < %s%s; %c++) {", 
@@ -535,38 +551,41 @@ int emit_csharp(lcmgen_t *lcm)
 
         emit(2,"public void _decodeRecursive(LCMDataInputStream ins)");
         emit(2,"{");
-        if(struct_has_string_member(lr))
-            emit(3, "byte[] __strbuf = null;");
         for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
             lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, member);
             primitive_info_t *pinfo = (primitive_info_t*) g_hash_table_lookup(type_table, lm->type->lctypename);
 
             make_accessor(lm, "this", accessor);
 
-            // allocate an array if necessary
+            // allocate an array if necessary, reusing the current one if it
+            // already has the right dimensions
             if (g_ptr_array_size(lm->dimensions) > 0) {
 
-                emit_start(3, "this.%s = new ", lm->membername);
+                emit_start(3, "if (this.%s == null", lm->membername);
+                for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
+                    lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
+                    emit_continue(" || this.%s.GetLength(%u) != (int) %s", lm->membername, i, dim->size);
+                }
+                emit_end(")");
+
+                emit_start(4, "this.%s = new ", lm->membername);
 
                 if (pinfo != NULL)
                     emit_continue("%s", pinfo->storage);
                 else
                     emit_continue("%s", make_fqn_csharp(lcm, lm->type->lctypename));
 
-				if (g_ptr_array_size(lm->dimensions) > 0)
-				{
-					emit_continue("[");
-					for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
-						lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
-						emit_continue("(int) %s", dim->size);
-						if (i < (g_ptr_array_size(lm->dimensions)-1))
-							emit_continue(",");
-					}
-					emit_continue("]");
-				}
+                emit_array_dims(f, lm);
                 emit_end(";");
             }
 
+            if (is_bulk_array(lm, pinfo)) {
+                lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, 0);
+                emit(3, "ins.ReadArray(this.%s, 0, (int) %s);", lm->membername, dim->size);
+                emit(0," ");
+                continue;
+            }
+
             for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
                 lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
                 emit(3+i, "for (int %c = 0; %c < %s%s; %c++) {", 
@@ -73,14 +73,18 @@ typedef struct
     char *storage;
     char *decode;
     char *encode;
+    // suffix of the LCMData{Input,Output}Stream methods that read and write
+    // arrays of the type all at once, or NULL
+    char *bulk;
 } primitive_info_t;
 
-static primitive_info_t *prim(char *storage, char *decode, char *encode)
+static primitive_info_t *prim(char *storage, char *decode, char *encode, char *bulk)
 {
     primitive_info_t *p = (primitive_info_t*) calloc(sizeof(primitive_info_t), 1);
     p->storage = storage;
     p->decode = decode;
     p->encode = encode;
+    p->bulk = bulk;
 
     return p;
 }
@@ -139,16 +143,6 @@ static void make_accessor_array(lcm_member_t *lm, const char *obj, char *s)
         pos += sprintf(&s[pos],"[%c]", 'a'+d);
 }
 
-static int struct_has_string_member(lcm_struct_t *lr)
-{
-    for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
-        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, member);
-        if(!strcmp("string", lm->type->lctypename))
-            return 1;
-    }
-    return 0;
-}
-
 static const char * dim_size_prefix(const char *dim_size) {
     char *eptr = NULL;
     long asdf = strtol(dim_size, &eptr, 0);
@@ -177,15 +171,12 @@ void encode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
             return;
         }
 
-        // some other kind of primitive array.
-        // This seems to be slower than the default (and is untested for correctness), hence it is disabled.
-        if (0 && !strcmp(pinfo->storage, "float")) {
-
+        // some other kind of primitive array
+        if (pinfo->bulk) {
             lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
-
-            emit(2+depth, "{ ByteBuffer bbuf = ByteBuffer.allocate(%s%s*4); bbuf.order(ByteOrder.BIG_ENDIAN); ", dim_size_prefix(dim->size), dim->size);
-            emit(2+depth, "  bbuf.asFloatBuffer().put(this.%s);", accessor_array);
-            emit(2+depth, "  outs.write(bbuf.array()); }");
+            emit(2+depth, "LCMDataOutputStream.write%s(outs, this.%s, 0, %s%s%s);",
+                 pinfo->bulk, accessor_array, dim->mode == LCM_VAR ? "(int) " : "",
+                 dim_size_prefix(dim->size), dim->size);
             return;
         }
     }
@@ -213,6 +204,30 @@ void encode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
     emit(2+depth, "}");
 }
 
+/** Allocate the arrays of dimension depth and above of a member, unless the
+ * ones that are already there have the right size. **/
+static void emit_decode_alloc(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t *pinfo, int depth)
+{
+    char subarray[1024];
+    int pos = sprintf(subarray, "this.%s", lm->membername);
+    for (int d = 0; d < depth; d++)
+        pos += sprintf(&subarray[pos], "[%c]", 'a'+d);
+
+    lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
+    emit(2+depth, "if (%s == null || %s.length != (int) %s)", subarray, subarray, dim->size);
+    emit_start(3+depth, "%s = new ", subarray);
+    if (pinfo != NULL)
+        emit_continue("%s", pinfo->storage);
+    else
+        emit_continue("%s", make_fqn(lcm, lm->type->lctypename));
+
+    for (unsigned int i = depth; i < g_ptr_array_size(lm->dimensions); i++) {
+        dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
+        emit_continue("[(int) %s]", dim->size);
+    }
+    emit_end(";");
+}
+
 void decode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t *pinfo, char *accessor, int depth)
 {
     // base case: primitive array
@@ -228,13 +243,12 @@ void decode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
             return;
         }
 
-        // some other kind of primitive array.
-        // This seems to be slower than the default (and is untested for correctness), hence it is disabled.
-        if (0 && !strcmp(pinfo->storage, "float")) {
+        // some other kind of primitive array
+        if (pinfo->bulk) {
             lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, depth);
-
-            emit(2+depth, "{ byte bb[] = new byte[%s%s*4]; ins.readFully(bb); ByteBuffer bbuf = ByteBuffer.wrap(bb); bbuf.order(ByteOrder.BIG_ENDIAN); ", dim_size_prefix(dim->size), dim->size);
-            emit(2+depth, "  bbuf.asFloatBuffer().get(this.%s); }", accessor_array);
+            emit(2+depth, "LCMDataInputStream.read%s(ins, this.%s, 0, %s%s%s);",
+                 pinfo->bulk, accessor_array, dim->mode == LCM_VAR ? "(int) " : "",
+                 dim_size_prefix(dim->size), dim->size);
             return;
         }
   }
@@ -244,7 +258,11 @@ void decode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
         emit_start(2 + g_ptr_array_size(lm->dimensions),"");
         if (pinfo != NULL)
             freplace(f, pinfo->decode, accessor);
-        else {
+        else if (lcm_find_struct(lcm, lm->type->lctypename)) {
+            // decode into the struct that is already there, if any
+            emit_continue("if (%s == null) %s = new %s(); %s._decodeRecursive(ins);",
+                          accessor, accessor, make_fqn(lcm, lm->type->lctypename), accessor);
+        } else {
             emit_continue("%s = %s._decodeRecursiveFactory(ins);", accessor, make_fqn(lcm, lm->type->lctypename));
         }
         emit_end("");
@@ -257,6 +275,9 @@ void decode_recursive(lcmgen_t *lcm, lcm_member_t *lm, FILE *f, primitive_info_t
     emit(2+depth, "for (int %c = 0; %c < %s%s; %c++) {",
          'a'+depth, 'a'+depth, dim_size_prefix(dim->size), dim->size, 'a'+depth);
 
+    if (depth+1 < (int) g_ptr_array_size(lm->dimensions))
+        emit_decode_alloc(lcm, lm, f, pinfo, depth+1);
+
     decode_recursive(lcm, lm, f, pinfo, accessor, depth+1);
 
     emit(2+depth, "}");
@@ -330,37 +351,42 @@ int emit_java(lcmgen_t *lcm)
 
     g_hash_table_insert(type_table, "byte",   prim("byte",
                                              "# = ins.readByte();",
-                                             "outs.writeByte(#);"));
+                                             "outs.writeByte(#);",
+                                             NULL));
     g_hash_table_insert(type_table, "int8_t",   prim("byte",
                                                "# = ins.readByte();",
-                                               "outs.writeByte(#);"));
+                                               "outs.writeByte(#);",
+                                               NULL));
     g_hash_table_insert(type_table, "int16_t",  prim("short",
                                                "# = ins.readShort();",
-                                               "outs.writeShort(#);"));
+                                               "outs.writeShort(#);",
+                                               "Shorts"));
     g_hash_table_insert(type_table, "int32_t",  prim("int",
                                                "# = ins.readInt();",
-                                               "outs.writeInt(#);"));
+                                               "outs.writeInt(#);",
+                                               "Ints"));
     g_hash_table_insert(type_table, "int64_t",  prim("long",
                                                "# = ins.readLong();",
-                                               "outs.writeLong(#);"));
+                                               "outs.writeLong(#);",
+                                               "Longs"));
 
     g_hash_table_insert(type_table, "string",   prim("String",
-                                                     "__strbuf = new char[ins.readInt()-1]; for (int _i = 0; _i < __strbuf.length; _i++) __strbuf[_i] = (char) (ins.readByte()&0xff); ins.readByte(); # = new String(__strbuf);",
-                                                     "__strbuf = new char[#.length()]; #.getChars(0, #.length(), __strbuf, 0); outs.writeInt(__strbuf.length+1); for (int _i = 0; _i < __strbuf.length; _i++) outs.write(__strbuf[_i]); outs.writeByte(0);"));
-
-//    g_hash_table_insert(type_table, "string",   prim("String",
-//                                               "__strbuf = new byte[ins.readInt()-1]; ins.readFully(__strbuf); ins.readByte(); # = new String(__strbuf, \"UTF-8\");",
-//                                               "__strbuf = #.getBytes(\"UTF-8\"); outs.writeInt(__strbuf.length+1); outs.write(__strbuf, 0, __strbuf.length); outs.writeByte(0);"));
+                                               "# = LCMDataInputStream.readLCMString(ins);",
+                                               "LCMDataOutputStream.writeLCMString(outs, #);",
+                                               NULL));
 
     g_hash_table_insert(type_table, "boolean",  prim("boolean",
                                                "# = ins.readByte()!=0;",
-                                               "outs.writeByte( # ? 1 : 0);"));
+                                               "outs.writeByte( # ? 1 : 0);",
+                                               NULL));
     g_hash_table_insert(type_table, "float",    prim("float",
                                                "# = ins.readFloat();",
-                                               "outs.writeFloat(#);"));
+                                               "outs.writeFloat(#);",
+                                               "Floats"));
     g_hash_table_insert(type_table, "double",   prim("double",
                                                "# = ins.readDouble();",
-                                               "outs.writeDouble(#);"));
+                                               "outs.writeDouble(#);",
+                                               "Doubles"));
 
     //////////////////////////////////////////////////////////////
     // ENUMS
@@ -497,21 +523,6 @@ int emit_java(lcmgen_t *lcm)
         emit(0, " ");
         emit(0, "import java.io.*;");
 
-        if (0) {
-            // Determine if we even need the java.nio.* package.
-            int usenio = 0;
-            for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
-                lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, member);
-                primitive_info_t *pinfo = (primitive_info_t*) g_hash_table_lookup(type_table, lm->type->lctypename);
-                if (pinfo!=NULL && !strcmp(pinfo->storage, "float")) {
-                    usenio = 1;
-                    break;
-                }
-            }
-            if (usenio)
-                emit(0, "import java.nio.*;");
-        }
-
         emit(0, "import java.util.*;");
         emit(0, "import lcm.lcm.*;");
         emit(0, " ");
@@ -635,8 +646,6 @@ int emit_java(lcmgen_t *lcm)
 
         emit(1,"public void _encodeRecursive(DataOutput outs) throws IOException");
         emit(1,"{");
-        if(struct_has_string_member(lr))
-            emit(2, "char[] __strbuf = null;");
         char accessor[1024];
 
         for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
@@ -668,6 +677,26 @@ int emit_java(lcmgen_t *lcm)
         emit(1,"}");
         emit(0," ");
 
+        emit(1,"/**");
+        emit(1," * Decodes a message into an existing object, which saves allocating a");
+        emit(1," * new one.  The arrays and nested structs of the object are reused");
+        emit(1," * where their sizes match.");
+        emit(1," *");
+        emit(1," * @param reuse the object to decode into, or null for a new one.");
+        emit(1," * @return the decoded object.");
+        emit(1," */");
+        emit(1,"public static %s decode(DataInput ins, %s reuse) throws IOException",
+             make_fqn(lcm, lr->structname->lctypename), make_fqn(lcm, lr->structname->lctypename));
+        emit(1,"{");
+        emit(2,"if (ins.readLong() != LCM_FINGERPRINT)");
+        emit(3,     "throw new IOException(\"LCM Decode error: bad fingerprint\");");
+        emit(0," ");
+        emit(2,"%s o = (reuse != null) ? reuse : new %s();", make_fqn(lcm, lr->structname->lctypename), make_fqn(lcm, lr->structname->lctypename));
+        emit(2,"o._decodeRecursive(ins);");
+        emit(2,"return o;");
+        emit(1,"}");
+        emit(0," ");
+
         emit(1,"public static %s _decodeRecursiveFactory(DataInput ins) throws IOException", make_fqn(lcm, lr->structname->lctypename));
         emit(1,"{");
         emit(2,"%s o = new %s();", make_fqn(lcm, lr->structname->lctypename), make_fqn(lcm, lr->structname->lctypename));
@@ -678,8 +707,6 @@ int emit_java(lcmgen_t *lcm)
 
         emit(1,"public void _decodeRecursive(DataInput ins) throws IOException");
         emit(1,"{");
-        if(struct_has_string_member(lr))
-            emit(2, "char[] __strbuf = null;");
         for (unsigned int member = 0; member < g_ptr_array_size(lr->members); member++) {
             lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, member);
             primitive_info_t *pinfo = (primitive_info_t*) g_hash_table_lookup(type_table, lm->type->lctypename);
@@ -687,21 +714,8 @@ int emit_java(lcmgen_t *lcm)
             make_accessor(lm, "this", accessor);
 
             // allocate an array if necessary
-            if (g_ptr_array_size(lm->dimensions) > 0) {
-
-                emit_start(2, "this.%s = new ", lm->membername);
-
-                if (pinfo != NULL)
-                    emit_continue("%s", pinfo->storage);
-                else
-                    emit_continue("%s", make_fqn(lcm, lm->type->lctypename));
-
-                for (unsigned int i = 0; i < g_ptr_array_size(lm->dimensions); i++) {
-                    lcm_dimension_t *dim = (lcm_dimension_t*) g_ptr_array_index(lm->dimensions, i);
-                    emit_continue("[(int) %s]", dim->size);
-                }
-                emit_end(";");
-            }
+            if (g_ptr_array_size(lm->dimensions) > 0)
+                emit_decode_alloc(lcm, lm, f, pinfo, 0);
 
             decode_recursive(lcm, lm, f, pinfo, accessor, 0);
             emit(0," ");
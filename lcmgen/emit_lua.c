@@ -219,16 +219,25 @@ _emit_decode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls,
 		!strcmp ("int64_t", tn) ||
 		!strcmp ("float", tn) ||
 		!strcmp ("double", tn)) {
-        if(fixed_len) {
-            emit (indent, "%s = {lcm._pack.unpack('>%s%c', data:read(%d))}",
-                    accessor, len, _struct_format(lm), 
+        if (!strcmp ("byte", tn)) {
+            // bytes are unpacked as a single string
+            if(fixed_len) {
+                emit (indent, "%s = {lcm._pack.unpack('>%sB', data:read(%s))}",
+                        accessor, len, len);
+            } else {
+                emit (indent, "%s = {lcm._pack.unpack(string.format('>%%dB', obj.%s), data:read(obj.%s))}",
+                        accessor, len, len);
+            }
+        } else if(fixed_len) {
+            emit (indent, "%s = lcm._pack.unpack_array('>%c', %s, data:read(%d))",
+                    accessor, _struct_format(lm), len,
                     atoi(len) * _primitive_type_size(tn));
         } else {
             if(_primitive_type_size(tn) > 1) {
-                emit (indent, "%s = {lcm._pack.unpack(string.format('>%%d%c', obj.%s), data:read(obj.%s * %d))}",
+                emit (indent, "%s = lcm._pack.unpack_array('>%c', obj.%s, data:read(obj.%s * %d))",
                 	accessor, _struct_format(lm), len, len, _primitive_type_size(tn));
             } else {
-            	emit (indent, "%s = {lcm._pack.unpack(string.format('>%%d%c', obj.%s), data:read(obj.%s))}",
+            	emit (indent, "%s = lcm._pack.unpack_array('>%c', obj.%s, data:read(obj.%s))",
                     accessor, _struct_format(lm), len, len);
             }
         }
@@ -419,11 +428,20 @@ _emit_encode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls,
         !strcmp ("int64_t", tn) ||
         !strcmp ("float", tn) ||
         !strcmp ("double", tn)) {
-        if(fixed_len) {
-            emit(indent, "table.insert(buf_table, lcm._pack.pack('>%s%c', unpack(%s)))",
-            	len, _struct_format(lm), accessor);
+        if (!strcmp ("byte", tn)) {
+            // bytes are packed from a single string
+            if(fixed_len) {
+                emit(indent, "table.insert(buf_table, lcm._pack.pack('>%sB', unpack(%s)))",
+                    len, accessor);
+            } else {
+                emit(indent, "table.insert(buf_table, lcm._pack.pack(string.format('>%%dB', self.%s), unpack(%s)))",
+                    len, accessor);
+            }
+        } else if(fixed_len) {
+            emit(indent, "table.insert(buf_table, lcm._pack.pack_array('>%c', %s, %s))",
+            	_struct_format(lm), len, accessor);
         } else {
-            emit(indent, "table.insert(buf_table, lcm._pack.pack(string.format('>%%d%c', self.%s), unpack(%s)))",
+            emit(indent, "table.insert(buf_table, lcm._pack.pack_array('>%c', self.%s, %s))",
             	_struct_format(lm), len, accessor);
         }
     } else {
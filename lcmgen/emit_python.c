@@ -95,6 +95,8 @@ void setup_python_options(getopt_t *gopt)
             "Python destination directory");
     getopt_add_bool  (gopt, 0,   "python-no-init",  0,
             "Do not create __init__.py");
+    getopt_add_bool  (gopt, 0,   "python-numpy",    0,
+            "Decode numeric arrays to read-only numpy arrays when numpy is available");
 }
 
 static int
@@ -137,146 +139,391 @@ _primitive_type_size (const char *tn)
     return 0;
 }
 
+// The struct format of a primitive type when decoding.  Booleans are decoded
+// with '?', so that they unpack to bools.
+static char
+_decode_format (const char *tn)
+{
+    if (!strcmp ("boolean", tn)) return '?';
+    if (!strcmp ("byte", tn)) return 'B';
+    if (!strcmp ("int8_t", tn)) return 'b';
+    if (!strcmp ("int16_t", tn)) return 'h';
+    if (!strcmp ("int32_t", tn)) return 'i';
+    if (!strcmp ("int64_t", tn)) return 'q';
+    if (!strcmp ("float", tn)) return 'f';
+    if (!strcmp ("double", tn)) return 'd';
+    return 0;
+}
+
+// The numpy dtype of a numeric primitive type, or NULL for the types
+// that are never decoded with numpy.
+static const char *
+_numpy_dtype (const char *tn)
+{
+    if (!strcmp ("int8_t", tn)) return "i1";
+    if (!strcmp ("int16_t", tn)) return ">i2";
+    if (!strcmp ("int32_t", tn)) return ">i4";
+    if (!strcmp ("int64_t", tn)) return ">i8";
+    if (!strcmp ("float", tn)) return ">f4";
+    if (!strcmp ("double", tn)) return ">f8";
+    return NULL;
+}
+
+// Whether lm is an array that is decoded in one piece with numpy.  Arrays
+// of bytes stay bytes, and arrays of booleans stay bools.
+static int
+_use_numpy (const lcmgen_t *lcm, lcm_member_t *lm)
+{
+    return getopt_get_bool (lcm->gopt, "python-numpy") &&
+        lm->dimensions->len && _numpy_dtype (lm->type->lctypename);
+}
+
+// The shape of an array member as a Python expression.  A one dimensional
+// shape is a tuple too, so that it can be passed to reshape.
+static char *
+_numpy_shape (lcm_member_t *lm, const char *sep)
+{
+    GString *shape = g_string_new ("");
+    for (unsigned int n = 0; n < lm->dimensions->len; n++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index (lm->dimensions, n);
+        g_string_append_printf (shape, "%s%s%s", n ? sep : "",
+                dim->mode == LCM_CONST ? "" : "self.", dim->size);
+    }
+    return g_string_free (shape, FALSE);
+}
+
+// Appends the struct format of lm to fmt if it has a fixed size, i.e. if it
+// is a primitive or a one dimensional array of constant length of a
+// primitive, and returns its size in bytes.  Returns -1 for other members.
+static int
+_decode_run_format (const lcmgen_t *lcm, lcm_member_t *lm, GString *fmt)
+{
+    const char *tn = lm->type->lctypename;
+    if (!lcm_is_primitive_type (tn) || !strcmp ("string", tn) ||
+        _use_numpy (lcm, lm))
+        return -1;
+    if (lm->dimensions->len == 0) {
+        g_string_append_c (fmt, _decode_format (tn));
+        return _primitive_type_size (tn);
+    }
+    lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index (lm->dimensions, 0);
+    if (lm->dimensions->len > 1 || dim->mode != LCM_CONST)
+        return -1;
+    int n = atoi (dim->size);
+    if (!strcmp ("byte", tn)) {
+        // unpacks to a single bytes value
+        g_string_append_printf (fmt, "%ds", n);
+    } else {
+        g_string_append_printf (fmt, "%d%c", n, _decode_format (tn));
+    }
+    return n * _primitive_type_size (tn);
+}
+
+// The name of the class attribute holding the precompiled struct.Struct for
+// fmt.
+static char *
+_struct_name (const char *fmt)
+{
+    char *name = g_strdup_printf ("_struct_%s", fmt);
+    for (char *p = name; *p; p++) {
+        if (*p == '?') *p = '_';
+    }
+    return name;
+}
+
+static void
+_add_struct_format (GPtrArray *fmts, const char *fmt)
+{
+    for (unsigned int i = 0; i < fmts->len; i++) {
+        if (!strcmp ((char *) g_ptr_array_index (fmts, i), fmt))
+            return;
+    }
+    g_ptr_array_add (fmts, g_strdup (fmt));
+}
+
+// Collects the formats of the precompiled structs that _decode_from uses, in
+// the same order as emit_python_decode_one walks the members.
+static void
+_collect_decode_structs (const lcmgen_t *lcm, lcm_struct_t *ls, GPtrArray *fmts)
+{
+    GString *run = g_string_new ("");
+    for (unsigned int m = 0; m < g_ptr_array_size (ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (ls->members, m);
+        const char *tn = lm->type->lctypename;
+        if (_decode_run_format (lcm, lm, run) >= 0)
+            continue;
+        if (run->len) {
+            _add_struct_format (fmts, run->str);
+            g_string_truncate (run, 0);
+        }
+        if (!strcmp ("string", tn)) {
+            _add_struct_format (fmts, "I");
+        } else if (lcm_is_primitive_type (tn) && strcmp ("byte", tn)) {
+            lcm_dimension_t *last_dim = (lcm_dimension_t *) g_ptr_array_index (
+                    lm->dimensions, lm->dimensions->len - 1);
+            if (last_dim->mode == LCM_CONST) {
+                char *fmt = g_strdup_printf ("%s%c", last_dim->size,
+                        _decode_format (tn));
+                _add_struct_format (fmts, fmt);
+                g_free (fmt);
+            }
+        }
+    }
+    if (run->len)
+        _add_struct_format (fmts, run->str);
+    g_string_free (run, TRUE);
+}
+
+// Collects the formats of the precompiled structs that _encode_into uses, in
+// the same order as emit_python_encode_into walks the members.
+static void
+_collect_encode_structs (const lcmgen_t *lcm, lcm_struct_t *ls, GPtrArray *fmts)
+{
+    GString *run = g_string_new ("");
+    for (unsigned int m = 0; m < g_ptr_array_size (ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (ls->members, m);
+        const char *tn = lm->type->lctypename;
+        char fmt = _struct_format (lm);
+        if (!lm->dimensions->len && fmt) {
+            g_string_append_c (run, fmt);
+            continue;
+        }
+        if (run->len) {
+            _add_struct_format (fmts, run->str);
+            g_string_truncate (run, 0);
+        }
+        if (!strcmp ("string", tn)) {
+            _add_struct_format (fmts, "I");
+        } else if (fmt) {
+            lcm_dimension_t *last_dim = (lcm_dimension_t *) g_ptr_array_index (
+                    lm->dimensions, lm->dimensions->len - 1);
+            if (last_dim->mode == LCM_CONST) {
+                char *afmt = g_strdup_printf ("%s%c", last_dim->size,
+                        strcmp ("byte", tn) ? fmt : 's');
+                _add_struct_format (fmts, afmt);
+                g_free (afmt);
+            }
+        }
+    }
+    if (run->len)
+        _add_struct_format (fmts, run->str);
+    g_string_free (run, TRUE);
+}
+
+static void
+emit_python_structs (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    GPtrArray *fmts = g_ptr_array_new ();
+    _collect_decode_structs (lcm, ls, fmts);
+    _collect_encode_structs (lcm, ls, fmts);
+    for (unsigned int i = 0; i < fmts->len; i++) {
+        const char *fmt = (char *) g_ptr_array_index (fmts, i);
+        char *name = _struct_name (fmt);
+        emit (1, "%s = struct.Struct(\">%s\")", name, fmt);
+        g_free (name);
+        g_free ((char *) fmt);
+    }
+    if (fmts->len)
+        fprintf (f, "\n");
+    g_ptr_array_free (fmts, TRUE);
+}
+
+// Emits code that stores expr in target, or appends it to target.
+static void
+_emit_decode_store (FILE *f, const char *target, int append, int indent,
+        const char *expr)
+{
+    if (append) {
+        emit (indent, "%s.append(%s)", target, expr);
+    } else {
+        emit (indent, "%s = %s", target, expr);
+    }
+}
+
 static void
 _emit_decode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls, 
-        lcm_member_t *lm, const char *accessor, int indent, const char *sfx)
+        lcm_member_t *lm, const char *target, int append, int indent)
 {
     const char *tn = lm->type->lctypename;
     const char *mn = lm->membername;
-    const char *sn = lm->type->shortname;
+    const char *sn = ls->structname->shortname;
     if (!strcmp ("string", tn)) {
-        emit (indent, "__%s_len = struct.unpack('>I', buf.read(4))[0]", mn);
-        emit (indent, "%sbuf.read(__%s_len)[:-1].decode('utf-8', 'replace')%s",
-                accessor, mn, sfx);
-    } else if (!strcmp ("byte", tn)) {
-        emit (indent, "%sstruct.unpack('B', buf.read(1))[0]%s", accessor, sfx);
-    } else if (!(strcmp ("boolean", tn))) {
-        emit (indent, "%sbool(struct.unpack('b', buf.read(1))[0])%s", accessor, sfx);
-    } else if (!strcmp ("int8_t", tn)) {
-        emit (indent, "%sstruct.unpack('b', buf.read(1))[0]%s", accessor, sfx);
-    } else if (!strcmp ("int16_t", tn)) {
-        emit (indent, "%sstruct.unpack('>h', buf.read(2))[0]%s", accessor, sfx);
-    } else if (!strcmp ("int32_t", tn)) {
-        emit (indent, "%sstruct.unpack('>i', buf.read(4))[0]%s", accessor, sfx);
-    } else if (!strcmp ("int64_t", tn)) {
-        emit (indent, "%sstruct.unpack('>q', buf.read(8))[0]%s", accessor, sfx);
-    } else if (!strcmp ("float", tn)) {
-        emit (indent, "%sstruct.unpack('>f', buf.read(4))[0]%s", accessor, sfx);
-    } else if (!strcmp ("double", tn)) {
-        emit (indent, "%sstruct.unpack('>d', buf.read(8))[0]%s", accessor, sfx);
+        emit (indent, "__%s_len = %s._struct_I.unpack_from(buf, offset)[0]",
+                mn, sn);
+        char *expr = g_strdup_printf ("buf[offset + 4:offset + 3 + __%s_len]"
+                ".tobytes().decode('utf-8', 'replace')", mn);
+        _emit_decode_store (f, target, append, indent, expr);
+        g_free (expr);
+        emit (indent, "offset += 4 + __%s_len", mn);
     } else {
-        if (is_same_type (lm->type, ls->structname)) {
-            emit (indent, "%s%s._decode_one(buf)%s", accessor, sn, sfx);
+        assert (!lcm_is_primitive_type (tn));
+        const char *type = is_same_type (lm->type, ls->structname) ?
+            lm->type->shortname : tn;
+        if (append) {
+            emit (indent, "__%s, offset = %s._decode_from(buf, offset)",
+                    mn, type);
+            emit (indent, "%s.append(__%s)", target, mn);
         } else {
-            emit (indent, "%s%s._decode_one(buf)%s", accessor, tn, sfx);
+            emit (indent, "%s, offset = %s._decode_from(buf, offset)",
+                    target, type);
         }
     }
 }
 
 static void
 _emit_decode_list(const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls,
-        lcm_member_t *lm, const char *accessor, int indent, int is_first,
+        lcm_member_t *lm, const char *target, int append, int indent,
         const char *len, int fixed_len)
 {
     const char *tn = lm->type->lctypename;
-    const char *suffix = "";
-    if(!is_first) {
-        suffix = ")";
-    }
+    int size = _primitive_type_size (tn);
+    char *count = fixed_len ? g_strdup (len) : g_strdup_printf ("self.%s", len);
+    char *expr;
     if (!strcmp ("byte", tn)) {
-        emit (indent, "%sbuf.read(%s%s)%s", 
-                accessor, fixed_len ? "":"self.", len, suffix);
-    } else if (!strcmp ("boolean", tn)) {
-        if(fixed_len) {
-            emit (indent, "%smap(bool, struct.unpack('>%s%c', buf.read(%d)))%s",
-                    accessor, len, _struct_format(lm),
-                    atoi(len) * _primitive_type_size(tn),
-                    suffix);
-        } else {
-            emit (indent,
-                    "%smap(bool, struct.unpack('>%%d%c' %% self.%s, buf.read(self.%s)))%s",
-                    accessor, _struct_format(lm), len, len, suffix);
-        }
-    } else if (!strcmp ("int8_t", tn) || 
-               !strcmp ("int16_t", tn) ||
-               !strcmp ("int32_t", tn) ||
-               !strcmp ("int64_t", tn) ||
-               !strcmp ("float", tn) ||
-               !strcmp ("double", tn)) {
-        if(fixed_len) {
-            emit (indent, "%sstruct.unpack('>%s%c', buf.read(%d))%s", 
-                    accessor, len, _struct_format(lm), 
-                    atoi(len) * _primitive_type_size(tn), 
-                    suffix);
-        } else {
-            if(_primitive_type_size(tn) > 1) {
-                emit (indent, 
-                        "%sstruct.unpack('>%%d%c' %% self.%s, buf.read(self.%s * %d))%s", 
-                        accessor, _struct_format(lm), len, len, 
-                        _primitive_type_size(tn), suffix);
-            } else {
-            emit (indent, 
-                    "%sstruct.unpack('>%%d%c' %% self.%s, buf.read(self.%s))%s", 
-                    accessor, _struct_format(lm), len, len, suffix);
-            }
-        }
+        expr = g_strdup_printf ("buf[offset:offset + %s].tobytes()", count);
+    } else if (fixed_len) {
+        char *fmt = g_strdup_printf ("%s%c", len, _decode_format (tn));
+        char *name = _struct_name (fmt);
+        expr = g_strdup_printf ("%s.%s.unpack_from(buf, offset)",
+                ls->structname->shortname, name);
+        g_free (name);
+        g_free (fmt);
     } else {
-        assert(0);
+        expr = g_strdup_printf ("struct.unpack_from('>%%d%c' %% %s, buf, offset)",
+                _decode_format (tn), count);
     }
+    _emit_decode_store (f, target, append, indent, expr);
+    if (fixed_len) {
+        emit (indent, "offset += %d", atoi (len) * size);
+    } else if (size > 1) {
+        emit (indent, "offset += %s * %d", count, size);
+    } else {
+        emit (indent, "offset += %s", count);
+    }
+    g_free (expr);
+    g_free (count);
 }
 
+// Emits a single unpack_from of a run of fixed size members.
 static void
-_flush_read_struct_fmt (const lcmgen_t *lcm, FILE *f, 
-        GQueue *formats, GQueue *members)
+_flush_decode_run (FILE *f, lcm_struct_t *ls, GString *fmt, GPtrArray *members,
+        int size)
 {
-    int nfmts = g_queue_get_length(formats);
-    assert (nfmts == g_queue_get_length (members));
-    if(nfmts == 0) 
+    if (!members->len)
         return;
 
-    fprintf (f, "        ");
-    int fmtsize = 0;
-    while (! g_queue_is_empty (members)) {
-        lcm_member_t *lm = (lcm_member_t*) g_queue_pop_head (members);
-        emit_continue ("self.%s", lm->membername);
-        if (! g_queue_is_empty (members)) {
-            emit_continue (", ");
-        }
-        fmtsize += _primitive_type_size (lm->type->lctypename);
+    const char *sn = ls->structname->shortname;
+    char *name = _struct_name (fmt->str);
+    int all_scalar = 1;
+    for (unsigned int i = 0; i < members->len; i++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (members, i);
+        if (lm->dimensions->len && strcmp ("byte", lm->type->lctypename))
+            all_scalar = 0;
     }
-    emit_continue (" = struct.unpack(\">");
-    while (! g_queue_is_empty (formats)) {
-        emit_continue ("%c", GPOINTER_TO_INT (g_queue_pop_head (formats)));
+
+    if (members->len == 1) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (members, 0);
+        emit (2, "self.%s = %s.%s.unpack_from(buf, offset)%s", lm->membername,
+                sn, name, all_scalar ? "[0]" : "");
+    } else if (all_scalar) {
+        emit_start (2, "");
+        for (unsigned int i = 0; i < members->len; i++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (members, i);
+            emit_continue ("self.%s%s", lm->membername,
+                    i < members->len - 1 ? ", " : "");
+        }
+        emit_end (" = %s.%s.unpack_from(buf, offset)", sn, name);
+    } else {
+        // arrays take a slice of the unpacked values
+        emit (2, "__values = %s.%s.unpack_from(buf, offset)", sn, name);
+        int index = 0;
+        for (unsigned int i = 0; i < members->len; i++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (members, i);
+            if (lm->dimensions->len && strcmp ("byte", lm->type->lctypename)) {
+                lcm_dimension_t *dim =
+                    (lcm_dimension_t *) g_ptr_array_index (lm->dimensions, 0);
+                int n = atoi (dim->size);
+                emit (2, "self.%s = __values[%d:%d]", lm->membername, index,
+                        index + n);
+                index += n;
+            } else {
+                emit (2, "self.%s = __values[%d]", lm->membername, index);
+                index++;
+            }
+        }
     }
-    emit_end ("\", buf.read(%d))%s", fmtsize, nfmts == 1 ? "[0]" : "");
+    emit (2, "offset += %d", size);
+
+    g_free (name);
+    g_string_truncate (fmt, 0);
+    g_ptr_array_set_size (members, 0);
 }
 
 static void
 emit_python_decode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
-    emit(1, "def _decode_one(buf):");
-    emit (2, "self = %s()", ls->structname->shortname);
+    const char *sn = ls->structname->shortname;
 
-    GQueue *struct_fmt = g_queue_new ();
-    GQueue *struct_members = g_queue_new ();
+    // kept for streams, and for types generated by older versions of lcm-gen
+    emit (1, "def _decode_one(buf):");
+    emit (2, "data = memoryview(buf.read())");
+    emit (2, "self, offset = %s._decode_from(data, 0)", sn);
+    emit (2, "if offset < len(data):");
+    emit (3,     "buf.seek(offset - len(data), 1)");
+    emit (2, "return self");
+    emit (1, "_decode_one = staticmethod(_decode_one)");
+    fprintf (f, "\n");
+
+    emit (1, "def _decode_from(buf, offset):");
+    emit (2, "self = %s()", sn);
+
+    GString *run_fmt = g_string_new ("");
+    GPtrArray *run_members = g_ptr_array_new ();
+    int run_size = 0;
 
     for (unsigned int m = 0; m < g_ptr_array_size(ls->members); m++) {
         lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(ls->members, m);
-        char fmt = _struct_format (lm);
+
+        int member_size = _decode_run_format (lcm, lm, run_fmt);
+        if (member_size >= 0) {
+            g_ptr_array_add (run_members, lm);
+            run_size += member_size;
+            continue;
+        }
+        _flush_decode_run (f, ls, run_fmt, run_members, run_size);
+        run_size = 0;
 
         if (! lm->dimensions->len) {
-            if (fmt && strcmp(lm->type->lctypename, "boolean")) {
-                g_queue_push_tail (struct_fmt, GINT_TO_POINTER ((int)fmt));
-                g_queue_push_tail (struct_members, lm);
-            } else {
-                _flush_read_struct_fmt (lcm, f, struct_fmt, struct_members);
-                char *accessor = g_strdup_printf("self.%s = ", lm->membername);
-                _emit_decode_one (lcm, f, ls, lm, accessor, 2, "");
-                g_free(accessor);
-            }
+            char *target = g_strdup_printf("self.%s", lm->membername);
+            _emit_decode_one (lcm, f, ls, lm, target, 0, 2);
+            g_free(target);
         } else {
-            _flush_read_struct_fmt (lcm, f, struct_fmt, struct_members);
-
+            int base = 2;
+            if (_use_numpy (lcm, lm)) {
+                // the whole array is a single numpy array, with the pure
+                // Python decoding below as the fallback
+                const char *tn = lm->type->lctypename;
+                char *count = _numpy_shape (lm, " * ");
+                emit (2, "if numpy is not None:");
+                if (lm->dimensions->len > 1) {
+                    char *shape = _numpy_shape (lm, ", ");
+                    emit (3, "self.%s = numpy.frombuffer(buf, '%s', %s, offset)"
+                            ".reshape((%s))", lm->membername, _numpy_dtype (tn),
+                            count, shape);
+                    g_free (shape);
+                } else {
+                    emit (3, "self.%s = numpy.frombuffer(buf, '%s', %s, offset)",
+                            lm->membername, _numpy_dtype (tn), count);
+                }
+                if (_primitive_type_size (tn) > 1) {
+                    emit (3, "offset += %s * %d", count, _primitive_type_size (tn));
+                } else {
+                    emit (3, "offset += %s", count);
+                }
+                emit (2, "else:");
+                g_free (count);
+                base = 3;
+            }
             GString *accessor = g_string_new ("");
             g_string_append_printf (accessor, "self.%s", lm->membername);
 
@@ -287,15 +534,15 @@ emit_python_decode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
                 lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index (lm->dimensions, n);
 
                 if(n == 0) {
-                    emit (2, "%s = []", accessor->str);
+                    emit (base, "%s = []", accessor->str);
                 } else {
-                    emit (2+n, "%s.append([])", accessor->str);
+                    emit (base+n, "%s.append([])", accessor->str);
                 }
 
                 if (dim->mode == LCM_CONST) {
-                    emit (2+n, "for i%d in range(%s):", n, dim->size);
+                    emit (base+n, "for i%d in range(%s):", n, dim->size);
                 } else {
-                    emit (2+n, "for i%d in range(self.%s):", n, dim->size);
+                    emit (base+n, "for i%d in range(self.%s):", n, dim->size);
                 }
 
                 if(n > 0 && n < lm->dimensions->len-1) {
@@ -311,57 +558,51 @@ emit_python_decode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
             if(lcm_is_primitive_type(lm->type->lctypename) && 
                0 != strcmp(lm->type->lctypename, "string")) {
                 // member is a primitive non-string type.  Emit code to 
-                // decode a full array in one call to struct.unpack
-                if(n == 0) {
-                    g_string_append_printf (accessor, " = ");
-                } else {
-                    g_string_append_printf (accessor, ".append(");
-                }
-
+                // decode a full array in one call to unpack_from
                 _emit_decode_list(lcm, f, ls, lm,
-                        accessor->str, 2+n, n==0, 
+                        accessor->str, n > 0, base+n,
                         last_dim->size, last_dim_fixed_len);
             } else {
                 // member is either a string type or an inner LCM type.  Each
                 // array element must be decoded individually
                 if(n == 0) {
-                    emit (2, "%s = []", accessor->str);
+                    emit (base, "%s = []", accessor->str);
                 } else {
-                    emit (2+n, "%s.append ([])", accessor->str);
+                    emit (base+n, "%s.append ([])", accessor->str);
                     g_string_append_printf (accessor, "[i%d]", n-1);
                 }
                 if (last_dim_fixed_len) {
-                    emit (2+n, "for i%d in range(%s):", n, last_dim->size);
+                    emit (base+n, "for i%d in range(%s):", n, last_dim->size);
                 } else {
-                    emit (2+n, "for i%d in range(self.%s):", n, last_dim->size);
+                    emit (base+n, "for i%d in range(self.%s):", n, last_dim->size);
                 }
-                g_string_append_printf (accessor, ".append(");
-                _emit_decode_one (lcm, f, ls, lm, accessor->str, n+3, ")");
+                _emit_decode_one (lcm, f, ls, lm, accessor->str, 1, base+1+n);
             }
             g_string_free (accessor, TRUE);
         }
     }
-    _flush_read_struct_fmt (lcm, f, struct_fmt, struct_members);
-    emit (2, "return self");
+    _flush_decode_run (f, ls, run_fmt, run_members, run_size);
+    emit (2, "return self, offset");
 
-    g_queue_free (struct_fmt);
-    g_queue_free (struct_members);
-    emit (1, "_decode_one = staticmethod(_decode_one)");
+    g_string_free (run_fmt, TRUE);
+    g_ptr_array_free (run_members, TRUE);
+    emit (1, "_decode_from = staticmethod(_decode_from)");
     fprintf (f, "\n");
 }
 
 static void
 emit_python_decode (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 {
+    const char *sn = ls->structname->shortname;
     emit (1, "def decode(data):");
     emit (2, "if hasattr(data, 'read'):");
-    emit (3,     "buf = data");
-    emit (2, "else:");
-    emit (3,     "buf = BytesIO(data)");
-    emit (2, "if buf.read(8) != %s._get_packed_fingerprint():", 
-            ls->structname->shortname);
+    emit (3,     "if data.read(8) != %s._get_packed_fingerprint():", sn);
+    emit (4,         "raise ValueError(\"Decode error\")");
+    emit (3,     "return %s._decode_one(data)", sn);
+    emit (2, "buf = memoryview(data)");
+    emit (2, "if buf[:8].tobytes() != %s._get_packed_fingerprint():", sn);
     emit (3,     "raise ValueError(\"Decode error\")");
-    emit (2, "return %s._decode_one(buf)", ls->structname->shortname);
+    emit (2, "return %s._decode_from(buf, 8)[0]", sn);
     emit (1, "decode = staticmethod(decode)");
     fprintf (f, "\n");
 }
@@ -481,6 +722,20 @@ emit_python_encode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
             }
         } else {
             _flush_write_struct_fmt (f, struct_fmt, struct_members);
+            int base = 2;
+            if (_use_numpy (lcm, lm)) {
+                // reshape checks that the array has the declared dimensions
+                char *shape = _numpy_shape (lm, ", ");
+                emit (2, "if numpy is not None and isinstance(self.%s, numpy.ndarray):",
+                        lm->membername);
+                emit (3, "buf.write(numpy.asarray(self.%s, '%s')"
+                        ".reshape((%s%s)).tobytes())", lm->membername,
+                        _numpy_dtype (lm->type->lctypename), shape,
+                        lm->dimensions->len == 1 ? "," : "");
+                emit (2, "else:");
+                g_free (shape);
+                base = 3;
+            }
             GString *accessor = g_string_new ("");
             g_string_append_printf (accessor, "self.%s", lm->membername);
 
@@ -491,9 +746,9 @@ emit_python_encode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
 
                 g_string_append_printf (accessor, "[i%d]", n);
                 if (dim->mode == LCM_CONST) {
-                    emit (2+n, "for i%d in range(%s):", n, dim->size);
+                    emit (base+n, "for i%d in range(%s):", n, dim->size);
                 } else {
-                    emit (2+n, "for i%d in range(self.%s):", n, dim->size);
+                    emit (base+n, "for i%d in range(self.%s):", n, dim->size);
                 }
             }
 
@@ -506,15 +761,15 @@ emit_python_encode_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
                0 != strcmp(lm->type->lctypename, "string")) {
 
                 _emit_encode_list(lcm, f, ls, lm,
-                        accessor->str, 2+n, last_dim->size, last_dim_fixed_len);
+                        accessor->str, base+n, last_dim->size, last_dim_fixed_len);
             } else {
                 if (last_dim_fixed_len) {
-                    emit (2+n, "for i%d in range(%s):", n, last_dim->size);
+                    emit (base+n, "for i%d in range(%s):", n, last_dim->size);
                 } else {
-                    emit (2+n, "for i%d in range(self.%s):", n, last_dim->size);
+                    emit (base+n, "for i%d in range(self.%s):", n, last_dim->size);
                 }
                 g_string_append_printf (accessor, "[i%d]", n);
-                _emit_encode_one (lcm, f, ls, lm, accessor->str, n+3);
+                _emit_encode_one (lcm, f, ls, lm, accessor->str, base+1+n);
             }
             
             g_string_free (accessor, TRUE);
@@ -539,6 +794,256 @@ emit_python_encode (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
     fprintf (f, "\n");
 }
 
+// The number of elements of lm, a Python expression, and the sizes of its
+// dimensions multiplied together in *fixed if they are all constant.
+static char *
+_element_count (lcm_member_t *lm, int *fixed)
+{
+    *fixed = 1;
+    for (unsigned int n = 0; n < lm->dimensions->len; n++) {
+        lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index (lm->dimensions, n);
+        if (dim->mode == LCM_CONST) {
+            *fixed *= atoi (dim->size);
+        } else {
+            *fixed = -1;
+            break;
+        }
+    }
+    return _numpy_shape (lm, " * ");
+}
+
+// Emits for loops over the dimensions of lm up to, but not including,
+// num_dims, and returns the accessor of an element inside them.
+static GString *
+_emit_dimension_loops (FILE *f, lcm_member_t *lm, unsigned int num_dims,
+        int indent)
+{
+    GString *accessor = g_string_new ("");
+    g_string_append_printf (accessor, "self.%s", lm->membername);
+    for (unsigned int n = 0; n < num_dims; n++) {
+        lcm_dimension_t *dim =
+            (lcm_dimension_t*) g_ptr_array_index (lm->dimensions, n);
+        emit (indent + n, "for i%d in range(%s%s):", n,
+                dim->mode == LCM_CONST ? "" : "self.", dim->size);
+        g_string_append_printf (accessor, "[i%d]", n);
+    }
+    return accessor;
+}
+
+static void
+emit_python_encoded_size (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    // the members of a fixed size are added up here, and the others as the
+    // message is
+    int fixed_size = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size (ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (ls->members, m);
+        int count;
+        g_free (_element_count (lm, &count));
+        if (_struct_format (lm) && count >= 0)
+            fixed_size += count * _primitive_type_size (lm->type->lctypename);
+    }
+
+    emit (1, "def _get_encoded_size(self):");
+    emit (2, "size = %d", fixed_size);
+    for (unsigned int m = 0; m < g_ptr_array_size (ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (ls->members, m);
+        const char *tn = lm->type->lctypename;
+        int count;
+        char *count_expr = _element_count (lm, &count);
+        if (_struct_format (lm)) {
+            if (count < 0)
+                emit (2, "size += %s * %d", count_expr,
+                        _primitive_type_size (tn));
+        } else {
+            GString *accessor = _emit_dimension_loops (f, lm,
+                    lm->dimensions->len, 2);
+            int indent = 2 + lm->dimensions->len;
+            if (!strcmp ("string", tn)) {
+                emit (indent, "size += len(%s.encode('utf-8')) + 5",
+                        accessor->str);
+            } else {
+                emit (indent, "size += %s._get_encoded_size()", accessor->str);
+            }
+            g_string_free (accessor, TRUE);
+        }
+        g_free (count_expr);
+    }
+    emit (2, "return size");
+    fprintf (f, "\n");
+
+    emit (1, "def encoded_size(self):");
+    emit (2, "return 8 + self._get_encoded_size()");
+    fprintf (f, "\n");
+}
+
+static void
+_emit_encode_into_one (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls,
+        lcm_member_t *lm, const char *accessor, int indent)
+{
+    const char *tn = lm->type->lctypename;
+    const char *mn = lm->membername;
+    const char *sn = ls->structname->shortname;
+    if (!strcmp ("string", tn)) {
+        emit (indent, "__%s_encoded = %s.encode('utf-8')", mn, accessor);
+        emit (indent, "__%s_len = len(__%s_encoded)", mn, mn);
+        emit (indent, "%s._struct_I.pack_into(buf, offset, __%s_len + 1)",
+                sn, mn);
+        emit (indent, "buf[offset + 4:offset + 4 + __%s_len] = __%s_encoded",
+                mn, mn);
+        emit (indent, "buf[offset + 4 + __%s_len] = 0", mn);
+        emit (indent, "offset += 5 + __%s_len", mn);
+    } else {
+        const char *gpf = "_get_packed_fingerprint()";
+        emit (indent, "assert %s.%s == %s.%s", accessor, gpf,
+                is_same_type (lm->type, ls->structname) ?
+                lm->type->shortname : tn, gpf);
+        emit (indent, "offset = %s._encode_into(buf, offset)", accessor);
+    }
+}
+
+static void
+_emit_encode_into_list (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls,
+        lcm_member_t *lm, const char *accessor, int indent,
+        const char *len, int fixed_len)
+{
+    const char *tn = lm->type->lctypename;
+    const char *sn = ls->structname->shortname;
+    const char *mn = lm->membername;
+    int size = _primitive_type_size (tn);
+    char *count = fixed_len ? g_strdup (len) : g_strdup_printf ("self.%s", len);
+    if (!strcmp ("byte", tn)) {
+        // 's' takes bytes only, where encode() also takes lists of ints
+        emit (indent, "__%s_bytes = %s[:%s]", mn, accessor, count);
+        emit (indent, "if not isinstance(__%s_bytes, bytes):", mn);
+        emit (indent + 1, "__%s_bytes = bytes(bytearray(__%s_bytes))", mn, mn);
+        if (fixed_len)
+            emit (indent, "%s._struct_%ss.pack_into(buf, offset, __%s_bytes)",
+                    sn, len, mn);
+        else
+            emit (indent, "struct.pack_into('%%ds' %% %s, buf, offset, "
+                    "__%s_bytes)", count, mn);
+    } else if (fixed_len) {
+        emit (indent, "%s._struct_%s%c.pack_into(buf, offset, *%s[:%s])", sn,
+                len, _struct_format (lm), accessor, len);
+    } else {
+        emit (indent, "struct.pack_into('>%%d%c' %% %s, buf, offset, "
+                "*%s[:%s])", _struct_format (lm), count, accessor, count);
+    }
+    if (fixed_len)
+        emit (indent, "offset += %d", atoi (len) * size);
+    else if (size > 1)
+        emit (indent, "offset += %s * %d", count, size);
+    else
+        emit (indent, "offset += %s", count);
+    g_free (count);
+}
+
+// Emits a single pack_into of a run of scalar members.
+static void
+_flush_encode_run (FILE *f, lcm_struct_t *ls, GString *fmt, GPtrArray *members,
+        int size)
+{
+    if (!members->len)
+        return;
+    char *name = _struct_name (fmt->str);
+    emit_start (2, "%s.%s.pack_into(buf, offset, ", ls->structname->shortname,
+            name);
+    for (unsigned int i = 0; i < members->len; i++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (members, i);
+        emit_continue ("self.%s%s", lm->membername,
+                i < members->len - 1 ? ", " : "");
+    }
+    emit_end (")");
+    emit (2, "offset += %d", size);
+    g_free (name);
+    g_string_truncate (fmt, 0);
+    g_ptr_array_set_size (members, 0);
+}
+
+static void
+emit_python_encode_into (const lcmgen_t *lcm, FILE *f, lcm_struct_t *ls)
+{
+    const char *sn = ls->structname->shortname;
+    emit (1, "def encode_into(self, buf, offset=0):");
+    emit (2, "\"\"\"Encodes the message into buf at offset, and returns its size.");
+    emit (2, "buf is a bytearray, which is extended if it is too short, or on");
+    emit (2, "Python 3 any writable buffer, which must be long enough.\"\"\"");
+    emit (2, "size = 8 + self._get_encoded_size()");
+    emit (2, "if len(buf) < offset + size:");
+    emit (3,     "if not isinstance(buf, bytearray):");
+    emit (4,         "raise ValueError(\"Buffer too small\")");
+    emit (3,     "buf.extend(bytearray(offset + size - len(buf)))");
+    emit (2, "buf[offset:offset + 8] = %s._get_packed_fingerprint()", sn);
+    emit (2, "self._encode_into(buf, offset + 8)");
+    emit (2, "return size");
+    fprintf (f, "\n");
+
+    emit (1, "def _encode_into(self, buf, offset):");
+    GString *run_fmt = g_string_new ("");
+    GPtrArray *run_members = g_ptr_array_new ();
+    int run_size = 0;
+    for (unsigned int m = 0; m < g_ptr_array_size (ls->members); m++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index (ls->members, m);
+        const char *tn = lm->type->lctypename;
+        char fmt = _struct_format (lm);
+        if (!lm->dimensions->len && fmt) {
+            g_string_append_c (run_fmt, fmt);
+            g_ptr_array_add (run_members, lm);
+            run_size += _primitive_type_size (tn);
+            continue;
+        }
+        _flush_encode_run (f, ls, run_fmt, run_members, run_size);
+        run_size = 0;
+
+        if (!lm->dimensions->len) {
+            char *accessor = g_strdup_printf ("self.%s", lm->membername);
+            _emit_encode_into_one (lcm, f, ls, lm, accessor, 2);
+            g_free (accessor);
+            continue;
+        }
+
+        int base = 2;
+        if (_use_numpy (lcm, lm)) {
+            char *shape = _numpy_shape (lm, ", ");
+            emit (2, "if numpy is not None and isinstance(self.%s, numpy.ndarray):",
+                    lm->membername);
+            emit (3, "__%s_bytes = numpy.asarray(self.%s, '%s')"
+                    ".reshape((%s%s)).tobytes()", lm->membername,
+                    lm->membername, _numpy_dtype (tn), shape,
+                    lm->dimensions->len == 1 ? "," : "");
+            emit (3, "buf[offset:offset + len(__%s_bytes)] = __%s_bytes",
+                    lm->membername, lm->membername);
+            emit (3, "offset += len(__%s_bytes)", lm->membername);
+            emit (2, "else:");
+            g_free (shape);
+            base = 3;
+        }
+        lcm_dimension_t *last_dim = (lcm_dimension_t *) g_ptr_array_index (
+                lm->dimensions, lm->dimensions->len - 1);
+        if (fmt) {
+            GString *accessor = _emit_dimension_loops (f, lm,
+                    lm->dimensions->len - 1, base);
+            _emit_encode_into_list (lcm, f, ls, lm, accessor->str,
+                    base + lm->dimensions->len - 1, last_dim->size,
+                    last_dim->mode == LCM_CONST);
+            g_string_free (accessor, TRUE);
+        } else {
+            GString *accessor = _emit_dimension_loops (f, lm,
+                    lm->dimensions->len, base);
+            _emit_encode_into_one (lcm, f, ls, lm, accessor->str,
+                    base + lm->dimensions->len);
+            g_string_free (accessor, TRUE);
+        }
+    }
+    _flush_encode_run (f, ls, run_fmt, run_members, run_size);
+    emit (2, "return offset");
+    fprintf (f, "\n");
+
+    g_string_free (run_fmt, TRUE);
+    g_ptr_array_free (run_members, TRUE);
+}
+
 static void
 emit_member_initializer(const lcmgen_t* lcm, FILE *f, lcm_member_t* lm, 
         int dim_num)
@@ -871,6 +1376,13 @@ emit_package (lcmgen_t *lcm, _package_contents_t *pc)
         emit (2,     "buf.write (struct.pack(\">i\", self.value))");
         fprintf (f, "\n");
 
+        emit (1, "def _get_encoded_size(self):");
+        emit (2,     "return 4");
+        emit (1, "def _encode_into(self, buf, offset):");
+        emit (2,     "struct.pack_into(\">i\", buf, offset, self.value)");
+        emit (2,     "return offset + 4");
+        fprintf (f, "\n");
+
         emit (1, "def decode(data):");
         emit (2,     "if hasattr (data, 'read'):");
         emit (3,         "buf = data");
@@ -888,6 +1400,11 @@ emit_package (lcmgen_t *lcm, _package_contents_t *pc)
                 le->enumname->shortname);
         emit (1, "_decode_one = staticmethod(_decode_one)");
 
+        emit (1, "def _decode_from(buf, offset):");
+        emit (2,     "return %s(struct.unpack_from(\">i\", buf, offset)[0]), offset + 4",
+                le->enumname->shortname);
+        emit (1, "_decode_from = staticmethod(_decode_from)");
+
         fprintf (f, "\n");
         fclose (f);
     }
@@ -923,6 +1440,13 @@ emit_package (lcmgen_t *lcm, _package_contents_t *pc)
                 "    from io import BytesIO\n"
                 "import struct\n\n");
 
+        if (getopt_get_bool (lcm->gopt, "python-numpy")) {
+            fprintf (f, "try:\n"
+                    "    import numpy\n"
+                    "except ImportError:\n"
+                    "    numpy = None\n\n");
+        }
+
         emit_python_dependencies (lcm, f, ls);
 
         fprintf(f, "class %s(object):\n", ls->structname->shortname);
@@ -943,9 +1467,12 @@ emit_package (lcmgen_t *lcm, _package_contents_t *pc)
         if (g_ptr_array_size(ls->constants) > 0)
             emit(0, "");
 
+        emit_python_structs (lcm, f, ls);
         emit_python_init (lcm, f, ls);
         emit_python_encode (lcm, f, ls);
         emit_python_encode_one (lcm, f, ls);
+        emit_python_encoded_size (lcm, f, ls);
+        emit_python_encode_into (lcm, f, ls);
         emit_python_decode (lcm, f, ls);
         emit_python_decode_one (lcm, f, ls);
         emit_python_fingerprint (lcm, f, ls);
@@ -28,6 +28,7 @@
 
 #include "lcmgen.h"
 #include "tokenize.h"
+#include "../lcm/lcm_version.h"
 
 
 #ifdef WIN32
@@ -139,6 +140,9 @@ lcmgen_t *lcmgen_create()
     lcmgen->enums = g_ptr_array_new();
     lcmgen->package = strdup("");
     lcmgen->comment_doc = NULL;
+    lcmgen->file_keys = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    lcmgen->pending = g_hash_table_new_full(g_str_hash, g_str_equal, free, free);
+    lcmgen->num_jobs = 1;
 
     return lcmgen;
 }
@@ -920,11 +924,148 @@ lcm_constant_t *lcm_find_const(lcm_struct_t *lr, const char *name)
     return NULL;
 }
 
+// 64-bit FNV-1a
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static uint64_t hash_string(uint64_t h, const char *s)
+{
+    // the terminating zero too, so that consecutive strings stay apart
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+#define HASH_INIT 0xcbf29ce484222325ULL
+
+static int compute_file_key(lcmgen_t *lcm, const char *declaringfile,
+        uint64_t *key)
+{
+    gchar *text;
+    gsize len;
+    if (!g_file_get_contents(declaringfile, &text, &len, NULL))
+        return -1;
+    const int version[3] = { LCM_VERSION_MAJOR, LCM_VERSION_MINOR, LCM_VERSION_PATCH };
+    uint64_t h = hash_bytes(HASH_INIT, version, sizeof(version));
+    h = hash_bytes(h, text, len);
+    g_free(text);
+
+    // the options that can change what is emitted
+    for (unsigned int i = 0; i < g_ptr_array_size(lcm->gopt->options); i++) {
+        getopt_option_t *goo = (getopt_option_t *) g_ptr_array_index(lcm->gopt->options, i);
+        if (goo->spacer || !strcmp(goo->lname, "cache-dir") ||
+                !strcmp(goo->lname, "jobs") || !strcmp(goo->lname, "lazy"))
+            continue;
+        h = hash_string(h, goo->lname);
+        h = hash_string(h, goo->svalue ? goo->svalue : "");
+    }
+
+    // the types that the file's types refer to, as far as their generated
+    // code depends on them
+    for (unsigned int i = 0; i < g_ptr_array_size(lcm->structs); i++) {
+        lcm_struct_t *lr = (lcm_struct_t *) g_ptr_array_index(lcm->structs, i);
+        if (strcmp(lr->lcmfile, declaringfile))
+            continue;
+        for (unsigned int m = 0; m < g_ptr_array_size(lr->members); m++) {
+            lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, m);
+            const char *t = lm->type->lctypename;
+            if (lcm_is_primitive_type(t))
+                continue;
+            uint64_t fingerprint = 0;
+            lcm_struct_t *ms = lcm_find_struct(lcm, t);
+            if (ms && lcm_struct_full_fingerprint(lcm, ms, &fingerprint))
+                fingerprint = 0;
+            h = hash_string(h, t);
+            h = hash_bytes(h, &fingerprint, sizeof(fingerprint));
+        }
+    }
+    *key = h;
+    return 0;
+}
+
+// The file in the cache directory that holds the key of outfile
+static char *cache_entry_path(lcmgen_t *lcmgen, const char *outfile)
+{
+    return g_strdup_printf("%s%s%016" PRIx64,
+            getopt_get_string(lcmgen->gopt, "cache-dir"), G_DIR_SEPARATOR_S,
+            hash_string(HASH_INIT, outfile));
+}
+
+static int cache_is_current(lcmgen_t *lcmgen, const char *declaringfile,
+        const char *outfile)
+{
+    uint64_t *key = (uint64_t *) g_hash_table_lookup(lcmgen->file_keys, declaringfile);
+    if (!key) {
+        key = (uint64_t *) malloc(sizeof(uint64_t));
+        if (compute_file_key(lcmgen, declaringfile, key)) {
+            perror(declaringfile);
+            free(key);
+            return 0;
+        }
+        g_hash_table_insert(lcmgen->file_keys, strdup(declaringfile), key);
+    }
+
+    // the entry is the key, followed by the path of the output file
+    char *path = cache_entry_path(lcmgen, outfile);
+    gchar *entry = NULL;
+    int current = 0;
+    if (g_file_get_contents(path, &entry, NULL, NULL)) {
+        char *expected = g_strdup_printf("%016" PRIx64 " %s\n", *key, outfile);
+        current = !strcmp(entry, expected);
+        g_free(expected);
+        g_free(entry);
+    }
+    g_free(path);
+
+    struct stat outstat;
+    if (current && stat(outfile, &outstat) == 0)
+        return 1;
+
+    uint64_t *pending_key = (uint64_t *) malloc(sizeof(uint64_t));
+    *pending_key = *key;
+    g_hash_table_insert(lcmgen->pending, strdup(outfile), pending_key);
+    return 0;
+}
+
+void lcmgen_record_generated(lcmgen_t *lcmgen, int success)
+{
+    GHashTableIter iter;
+    gpointer outfile, key;
+    g_hash_table_iter_init(&iter, lcmgen->pending);
+    while (success && g_hash_table_iter_next(&iter, &outfile, &key)) {
+        // written to a file of its own, and renamed, so that concurrent
+        // lcm-gen processes never see part of an entry
+        char *path = cache_entry_path(lcmgen, (const char *) outfile);
+        char *tmp = g_strdup_printf("%s.%d", path, (int) getpid());
+        FILE *f = fopen(tmp, "w");
+        if (f == NULL ||
+                fprintf(f, "%016" PRIx64 " %s\n", *(uint64_t *) key,
+                    (const char *) outfile) < 0 ||
+                fclose(f) != 0 || rename(tmp, path) != 0) {
+            perror(tmp);
+            unlink(tmp);
+        }
+        g_free(tmp);
+        g_free(path);
+    }
+    g_hash_table_remove_all(lcmgen->pending);
+}
+
 int lcm_needs_generation(lcmgen_t *lcmgen, const char *declaringfile, const char *outfile)
 {
     struct stat instat, outstat;
     int res;
 
+    if (lcmgen->num_jobs > 1 &&
+            hash_string(HASH_INIT, outfile) % lcmgen->num_jobs != (uint64_t) lcmgen->job)
+        return 0;
+
+    if (strlen(getopt_get_string(lcmgen->gopt, "cache-dir")))
+        return !cache_is_current(lcmgen, declaringfile, outfile);
+
     if (!getopt_get_bool(lcmgen->gopt, "lazy"))
         return 1;
 
@@ -959,3 +1100,118 @@ int lcm_is_constant_size_array(lcm_member_t *lm)
 
     return 1;
 }
+
+int lcm_primitive_encoded_size(const char *t)
+{
+    if (!strcmp(t, "int8_t") || !strcmp(t, "byte") || !strcmp(t, "boolean"))
+        return 1;
+    if (!strcmp(t, "int16_t"))
+        return 2;
+    if (!strcmp(t, "int32_t") || !strcmp(t, "float"))
+        return 4;
+    if (!strcmp(t, "int64_t") || !strcmp(t, "double"))
+        return 8;
+    return 0;
+}
+
+int lcm_struct_fixed_encoded_size(lcm_struct_t *lr)
+{
+    int64_t size = 0;
+
+    for (unsigned int i = 0; i < g_ptr_array_size(lr->members); i++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, i);
+        int64_t msize = lcm_primitive_encoded_size(lm->type->lctypename);
+
+        if (msize == 0 || !lcm_is_constant_size_array(lm))
+            return -1;
+
+        for (unsigned int d = 0; d < g_ptr_array_size(lm->dimensions); d++) {
+            lcm_dimension_t *dim = (lcm_dimension_t *) g_ptr_array_index(lm->dimensions, d);
+            msize *= strtoll(dim->size, NULL, 0);
+            if (msize > INT32_MAX)
+                return -1;
+        }
+        size += msize;
+        if (size > INT32_MAX - 8)
+            return -1;
+    }
+
+    return (int) size;
+}
+
+uint64_t lcm_struct_fingerprint(lcm_struct_t *lr)
+{
+    uint64_t hash = (uint64_t) lr->hash;
+
+    return (hash<<1) + ((hash>>63)&1);
+}
+
+// the structs whose fingerprints are being computed, to break cycles like
+// the generated __<type>_hash_recursive() functions do
+typedef struct hash_parent hash_parent_t;
+struct hash_parent
+{
+    const lcm_struct_t *lr;
+    const hash_parent_t *parent;
+};
+
+static int struct_hash_recursive(lcmgen_t *lcm, lcm_struct_t *lr,
+        const hash_parent_t *parents, uint64_t *hash)
+{
+    for (const hash_parent_t *p = parents; p != NULL; p = p->parent) {
+        if (p->lr == lr) {
+            *hash = 0;
+            return 0;
+        }
+    }
+    hash_parent_t cp = { lr, parents };
+    uint64_t h = (uint64_t) lr->hash;
+
+    for (unsigned int i = 0; i < g_ptr_array_size(lr->members); i++) {
+        lcm_member_t *lm = (lcm_member_t *) g_ptr_array_index(lr->members, i);
+        const char *t = lm->type->lctypename;
+        if (lcm_is_primitive_type(t))
+            continue;
+
+        lcm_struct_t *ms = lcm_find_struct(lcm, t);
+        if (ms) {
+            uint64_t mh;
+            if (struct_hash_recursive(lcm, ms, &cp, &mh))
+                return -1;
+            h += mh;
+            continue;
+        }
+        unsigned int e;
+        for (e = 0; e < g_ptr_array_size(lcm->enums); e++) {
+            lcm_enum_t *le = (lcm_enum_t *) g_ptr_array_index(lcm->enums, e);
+            if (!strcmp(le->enumname->lctypename, t)) {
+                h += (uint64_t) le->hash;
+                break;
+            }
+        }
+        if (e == g_ptr_array_size(lcm->enums)) {
+            fprintf(stderr, "The fingerprint of %s depends on %s, which was not "
+                    "parsed\n", lr->structname->lctypename, t);
+            return -1;
+        }
+    }
+
+    *hash = (h<<1) + ((h>>63)&1);
+    return 0;
+}
+
+lcm_struct_t *lcm_find_struct(lcmgen_t *lcm, const char *lctypename)
+{
+    for (unsigned int i = 0; i < g_ptr_array_size(lcm->structs); i++) {
+        lcm_struct_t *lr = (lcm_struct_t *) g_ptr_array_index(lcm->structs, i);
+        if (!strcmp(lr->structname->lctypename, lctypename))
+            return lr;
+    }
+    return NULL;
+}
+
+int lcm_struct_full_fingerprint(lcmgen_t *lcm, lcm_struct_t *lr,
+        uint64_t *fingerprint)
+{
+    return struct_hash_recursive(lcm, lr, NULL, fingerprint);
+}
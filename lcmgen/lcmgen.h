@@ -155,6 +155,17 @@ struct lcmgen
     GPtrArray *enums;   // lcm_enum_t (declared at top level)
 
     gchar* comment_doc;
+
+    // with --cache-dir, the key of each declaring file (see
+    // lcm_needs_generation()), and the output files generated with those
+    // keys that lcmgen_record_generated() has yet to write to the cache.
+    GHashTable *file_keys;  // char* -> uint64_t*
+    GHashTable *pending;    // char* -> uint64_t*
+
+    // with --jobs, this process only emits the output files whose path
+    // hashes to job, out of num_jobs.  num_jobs is 1 otherwise.
+    int job;
+    int num_jobs;
 };
 
 /////////////////////////////////////////////////
@@ -173,10 +184,20 @@ lcm_member_t *lcm_find_member(lcm_struct_t *lr, const char *name);
 // Returns the constant of a struct by name. Returns NULL on error.
 lcm_constant_t *lcm_find_const(lcm_struct_t *lr, const char *name);
 
-// Returns 1 if the "lazy" option is enabled AND the file "outfile" is
-// older than the file "declaringfile"
+// Returns 1 unless "outfile" is up to date, or left to another job.
+//
+// With the "cache-dir" option, "outfile" is up to date if it was generated
+// from the same key as the current one of "declaringfile": a hash of its
+// contents, the lcm-gen version and options, and the fingerprints of the
+// types that its types refer to.  Otherwise, with the "lazy" option, it is
+// up to date if it is newer than "declaringfile".
 int lcm_needs_generation(lcmgen_t *lcmgen, const char *declaringfile, const char *outfile);
 
+// Writes the output files of the last lcm_needs_generation() calls to the
+// cache, once they were generated successfully, or forgets them if
+// "success" is 0.
+void lcmgen_record_generated(lcmgen_t *lcmgen, int success);
+
 // create a new parsing context.
 lcmgen_t *lcmgen_create();
 
@@ -190,4 +211,27 @@ int lcmgen_handle_file(lcmgen_t *lcm, const char *path);
 // (scalars return 1)
 int lcm_is_constant_size_array(lcm_member_t *lm);
 
+// The encoded size of a primitive type other than string, or 0 for strings
+// and all other types.
+int lcm_primitive_encoded_size(const char *t);
+
+// If all members of the struct are primitives other than strings, and all
+// of its arrays have constant sizes, every message of its type is encoded
+// in the same number of bytes.  Returns that number, excluding the 8-byte
+// fingerprint, or -1 for all other structs.
+int lcm_struct_fixed_encoded_size(lcm_struct_t *lr);
+
+// The fingerprint of a struct for which lcm_struct_fixed_encoded_size()
+// is >= 0, which encoded messages start with.  The fingerprints of other
+// structs depend on the types of their members.
+uint64_t lcm_struct_fingerprint(lcm_struct_t *lr);
+
+// Returns the parsed struct with the fully-qualified name, or NULL.
+lcm_struct_t *lcm_find_struct(lcmgen_t *lcm, const char *lctypename);
+
+// Computes the fingerprint of any struct, which encoded messages start with.
+// Returns -1 if it depends on a type that was not parsed.
+int lcm_struct_full_fingerprint(lcmgen_t *lcm, lcm_struct_t *lr,
+        uint64_t *fingerprint);
+
 #endif
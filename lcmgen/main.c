@@ -11,6 +11,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <inttypes.h>
+#ifndef WIN32
+#include <sys/wait.h>
+#endif
 #include "lcmgen.h"
 #include "../lcm/lcm_version.h"
 
@@ -23,6 +26,7 @@
 
 void setup_c_options(getopt_t *gopt);
 int emit_c(lcmgen_t *lcm);
+int emit_c_registry(lcmgen_t *lcm);
 
 void setup_java_options(getopt_t *gopt);
 int emit_java(lcmgen_t *lcm);
@@ -39,6 +43,86 @@ int emit_csharp(lcmgen_t *lcm);
 void setup_cpp_options(getopt_t *gopt);
 int emit_cpp(lcmgen_t *lcm);
 
+typedef struct emitter emitter_t;
+struct emitter
+{
+    const char *option;     // the option that selects it
+    int (*emit)(lcmgen_t *lcm);
+    const char *error;      // shown if it fails
+    int show_errno;
+    // nonzero if every file it writes goes through lcm_needs_generation(),
+    // so that its files can be split between jobs
+    int splits;
+};
+
+static const emitter_t emitters[] = {
+    { "c", emit_c, "An error occurred while emitting C code.\n", 0, 1 },
+    { "c-registry", emit_c_registry,
+        "An error occurred while emitting the C type registry.\n", 0, 0 },
+    { "cpp", emit_cpp, "An error occurred while emitting C++ code.\n", 0, 1 },
+    { "java", emit_java, "An error occurred while emitting Java code.\n", 1, 1 },
+    { "python", emit_python, "An error occurred while emitting Python code.\n", 0, 0 },
+    { "lua", emit_lua, "An error occurred while emitting Lua code.\n", 0, 0 },
+    { "csharp", emit_csharp, "An error occurred while emitting C#.NET code.\n", 0, 1 },
+};
+
+#define NUM_EMITTERS ((int) (sizeof(emitters) / sizeof(emitters[0])))
+
+static int run_emitter(lcmgen_t *lcm, const emitter_t *e)
+{
+    int res = e->emit(lcm);
+    lcmgen_record_generated(lcm, !res);
+    if (res) {
+        if (e->show_errno)
+            perror(e->error);
+        else
+            printf("%s", e->error);
+    }
+    return res;
+}
+
+#ifndef WIN32
+// Runs the selected emitters in up to njobs processes at once.  Those whose
+// files can be split are run as njobs jobs, each emitting its share of the
+// files.
+static void run_emitters_in_parallel(lcmgen_t *lcm, int njobs)
+{
+    int running = 0;
+    fflush(stdout);
+    for (int i = 0; i < NUM_EMITTERS; i++) {
+        const emitter_t *e = &emitters[i];
+        if (!getopt_get_bool(lcm->gopt, e->option))
+            continue;
+        int parts = e->splits ? njobs : 1;
+        for (int job = 0; job < parts; job++) {
+            if (running == njobs && wait(NULL) > 0)
+                running--;
+            pid_t pid = fork();
+            if (pid < 0) {
+                // emit it here instead
+                perror("fork");
+                lcm->job = job;
+                lcm->num_jobs = parts;
+                run_emitter(lcm, e);
+                continue;
+            }
+            if (pid == 0) {
+                lcm->job = job;
+                lcm->num_jobs = parts;
+                int res = run_emitter(lcm, e);
+                fflush(stdout);
+                _exit(res ? 1 : 0);
+            }
+            running++;
+        }
+    }
+    while (running > 0 && wait(NULL) > 0)
+        running--;
+    lcm->job = 0;
+    lcm->num_jobs = 1;
+}
+#endif
+
 int main(int argc, char *argv[])
 {
     getopt_t *gopt = getopt_create();
@@ -47,6 +131,9 @@ int main(int argc, char *argv[])
     getopt_add_bool  (gopt, 't',  "tokenize", 0,    "Show tokenization");
     getopt_add_bool  (gopt, 'd',  "debug",    0,    "Show parsed file");
     getopt_add_bool  (gopt, 0,    "lazy",     0,    "Generate output file only if .lcm is newer");
+    getopt_add_string(gopt, 0,    "cache-dir", "",
+                      "Generate output files only if their types changed, remembering them in this directory");
+    getopt_add_int   (gopt, 0,    "jobs",     "1",  "Generate code with this many processes at once");
     getopt_add_string(gopt, 0,    "package-prefix",     "",
                       "Add this package name as a prefix to the declared package");
     getopt_add_bool  (gopt, 0,  "version",    0,    "Show version information and exit");
@@ -114,45 +201,26 @@ int main(int argc, char *argv[])
         lcmgen_dump(lcm);
     }
 
-    if (getopt_get_bool(gopt, "c")) {
-        did_something = 1;
-        if (emit_c(lcm)) {
-            printf("An error occurred while emitting C code.\n");
-        }
-    }
-
-    if (getopt_get_bool(gopt, "cpp")) {
-        did_something = 1;
-        if (emit_cpp(lcm)) {
-            printf("An error occurred while emitting C++ code.\n");
-        }
-    }
-
-    if (getopt_get_bool(gopt, "java")) {
-        did_something = 1;
-        if (emit_java(lcm)) {
-            perror("An error occurred while emitting Java code.\n");
-        }
-    }
-
-    if (getopt_get_bool(gopt, "python")) {
-        did_something = 1;
-        if (emit_python(lcm)) {
-            printf("An error occurred while emitting Python code.\n");
-        }
+    const char *cache_dir = getopt_get_string(gopt, "cache-dir");
+    if (strlen(cache_dir) && g_mkdir_with_parents(cache_dir, 0755)) {
+        perror(cache_dir);
+        return 1;
     }
 
-    if (getopt_get_bool(gopt, "lua")) {
-    	did_something = 1;
-    	if (emit_lua(lcm)) {
-    		printf("An error occurred while emitting Lua code.\n");
-    	}
+    int njobs = getopt_get_int(gopt, "jobs");
+    for (int i = 0; i < NUM_EMITTERS; i++) {
+        if (getopt_get_bool(gopt, emitters[i].option))
+            did_something = 1;
     }
-
-    if (getopt_get_bool(gopt, "csharp")) {
-        did_something = 1;
-        if (emit_csharp(lcm)) {
-            printf("An error occurred while emitting C#.NET code.\n");
+#ifndef WIN32
+    if (njobs > 1) {
+        run_emitters_in_parallel(lcm, njobs);
+    } else
+#endif
+    {
+        for (int i = 0; i < NUM_EMITTERS; i++) {
+            if (getopt_get_bool(gopt, emitters[i].option))
+                run_emitter(lcm, &emitters[i]);
         }
     }
 
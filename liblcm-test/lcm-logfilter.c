@@ -3,13 +3,37 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
 #include <getopt.h>
 
 #include <glib.h>
 
 #include <lcm/lcm.h>
+#include "lcm/channel_matcher.h"
 
-static void 
+// What to copy, shared by the ranges that are filtered in parallel
+typedef struct {
+    lcm_channel_pattern_t *pattern;
+    int invert;
+    int64_t start_timestamp;
+    int64_t end_timestamp;  // or -1
+} filter_t;
+
+// One part of the source log, filtered into a log of its own
+typedef struct {
+    const filter_t *filter;
+    lcm_eventlog_t *src;
+    lcm_eventlog_t *dst;
+    // whether the events of each channel name are copied, plus one, so that
+    // each channel name is only matched once
+    GHashTable *copies;
+    GHashTable *counts;
+    int64_t nwritten;
+    int status;
+} range_t;
+
+static void
 usage()
 {
     printf("usage: lcm-logfilter -c <CHAN> [OPTIONS] <source_logfile> <dest_logfile>\n"
@@ -17,18 +41,20 @@ usage()
            "Selectively extract channels from a source logfile to a destination\n"
            "logfile.\n"
            "\n"
-           "Optiosn:\n"
+           "Options:\n"
            "  -h        prints this help text and exits\n"
-           "  -c CHAN   POSIX regular expression.  Channels matching this expression\n"
-           "            will be copied to the destination logfile.\n"
+           "  -c CHAN   GLib regular expression, implicitly surrounded by '^' and\n"
+           "            '$' like a subscription.  Channels matching this\n"
+           "            expression will be copied to the destination logfile.\n"
            "  -i        invert the regular expression CHAN, so that only channels not\n"
-           "  -c CHAN   GLib regular expression.\n"
+           "            matching it are copied.\n"
            "  -s START  start time.  Messages logged less than START seconds\n"
            "            after the first message in the logfile will not be\n"
            "            extracted.\n"
            "  -e END    end time.  Messages logged more than END seconds\n"
            "            after the first message in the logfile will not be\n"
            "            extracted.\n"
+           "  -j JOBS   filter JOBS parts of the source logfile in parallel.\n"
            "  -v        verbose mode. Prints a summary of channels extracted\n"
            );
     exit(1);
@@ -37,7 +63,181 @@ usage()
 static void
 _verbose_entry_summary(gpointer key, gpointer value, gpointer user_data)
 {
-    printf("%20s: %d\n", (char*)key, *((int*)value));
+    printf("%20s: %" PRId64 "\n", (char*)key, *((int64_t*)value));
+}
+
+static int
+channel_copied(range_t *r, const char *channel)
+{
+    gpointer cached = g_hash_table_lookup(r->copies, channel);
+    if (cached)
+        return GPOINTER_TO_INT(cached) - 1;
+    int matches = lcm_channel_pattern_match(r->filter->pattern, channel) ? 1 : 0;
+    int copied = matches != r->filter->invert;
+    g_hash_table_insert(r->copies, g_strdup(channel),
+            GINT_TO_POINTER(copied + 1));
+    return copied;
+}
+
+static void
+filter_range(range_t *r)
+{
+    const filter_t *filter = r->filter;
+
+    // the buffers of one event are reused for all of them
+    lcm_eventlog_event_t event;
+    memset(&event, 0, sizeof(event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    while (0 == lcm_eventlog_read_next_event_into(r->src, &event,
+                &channel_capacity, &data_capacity)) {
+        if (event.timestamp < filter->start_timestamp)
+            continue;
+        if (filter->end_timestamp >= 0 &&
+                event.timestamp > filter->end_timestamp)
+            break;
+        if (!channel_copied(r, event.channel))
+            continue;
+
+        if (0 != lcm_eventlog_write_event(r->dst, &event)) {
+            r->status = -1;
+            break;
+        }
+        r->nwritten++;
+
+        int64_t *count = (int64_t *) g_hash_table_lookup(r->counts,
+                event.channel);
+        if (!count) {
+            count = (int64_t *) calloc(1, sizeof(int64_t));
+            g_hash_table_insert(r->counts, g_strdup(event.channel), count);
+        }
+        (*count)++;
+    }
+    free(event.channel);
+    free(event.data);
+    if (0 != lcm_eventlog_flush(r->dst))
+        r->status = -1;
+}
+
+static gpointer
+filter_thread(gpointer user)
+{
+    filter_range((range_t *) user);
+    return NULL;
+}
+
+static void
+add_counts(gpointer key, gpointer value, gpointer user_data)
+{
+    GHashTable *counts = (GHashTable *) user_data;
+    int64_t *count = (int64_t *) g_hash_table_lookup(counts, key);
+    if (!count) {
+        count = (int64_t *) calloc(1, sizeof(int64_t));
+        g_hash_table_insert(counts, g_strdup((char *) key), count);
+    }
+    *count += *(int64_t *) value;
+}
+
+static lcm_eventlog_t *
+create_output(const char *fname)
+{
+    lcm_eventlog_t *log = lcm_eventlog_create(fname, "w");
+#ifndef WIN32
+    // the copied events are written in large batches
+    if (log)
+        lcm_eventlog_set_write_flags(log, LCM_EVENTLOG_WRITEV);
+#endif
+    return log;
+}
+
+// Filters the ranges of the source log on threads of their own, each into a
+// temporary log next to the destination, and then joins those in order.
+// Returns the number of events written, or -1 on failure.
+static int64_t
+filter_parallel(const filter_t *filter, const char *source_fname,
+        const char *dest_fname, int num_ranges, const int64_t *offsets,
+        GHashTable *counts)
+{
+    range_t *ranges = (range_t *) calloc(num_ranges, sizeof(range_t));
+    GThread **threads = (GThread **) calloc(num_ranges, sizeof(GThread *));
+    char **part_fnames = (char **) calloc(num_ranges, sizeof(char *));
+    int status = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        range_t *r = &ranges[i];
+        r->filter = filter;
+        r->copies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                NULL);
+        r->counts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                free);
+        part_fnames[i] = g_strdup_printf("%s.part%d", dest_fname, i);
+        r->src = lcm_eventlog_create_range(source_fname, offsets[i],
+                offsets[i + 1]);
+        r->dst = create_output(part_fnames[i]);
+        if (!r->src || !r->dst) {
+            perror("Unable to open logfile");
+            status = -1;
+            break;
+        }
+        threads[i] = g_thread_create(filter_thread, r, TRUE, NULL);
+        if (!threads[i])
+            filter_range(r);
+    }
+
+    int64_t nwritten = 0;
+    for (int i = 0; i < num_ranges; i++) {
+        range_t *r = &ranges[i];
+        if (threads[i])
+            g_thread_join(threads[i]);
+        if (r->status != 0)
+            status = -1;
+        if (r->src)
+            lcm_eventlog_destroy(r->src);
+        if (r->dst)
+            lcm_eventlog_destroy(r->dst);
+        g_hash_table_foreach(r->counts, add_counts, counts);
+        g_hash_table_destroy(r->counts);
+        g_hash_table_destroy(r->copies);
+    }
+
+    // the parts are copied rather than concatenated, which numbers the
+    // events of the destination logfile from 0
+    lcm_eventlog_t *dst_log = status == 0 ? create_output(dest_fname) : NULL;
+    if (status == 0 && !dst_log) {
+        perror("Unable to open destination logfile");
+        status = -1;
+    }
+    lcm_eventlog_event_t event;
+    memset(&event, 0, sizeof(event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    for (int i = 0; i < num_ranges && part_fnames[i]; i++) {
+        lcm_eventlog_t *part = dst_log ?
+            lcm_eventlog_create(part_fnames[i], "r") : NULL;
+        while (part && 0 == lcm_eventlog_read_next_event_into(part, &event,
+                    &channel_capacity, &data_capacity)) {
+            if (0 != lcm_eventlog_write_event(dst_log, &event)) {
+                status = -1;
+                break;
+            }
+            nwritten++;
+        }
+        if (part)
+            lcm_eventlog_destroy(part);
+        remove(part_fnames[i]);
+        g_free(part_fnames[i]);
+    }
+    free(event.channel);
+    free(event.data);
+    if (dst_log) {
+        if (0 != lcm_eventlog_flush(dst_log))
+            status = -1;
+        lcm_eventlog_destroy(dst_log);
+    }
+
+    free(part_fnames);
+    free(threads);
+    free(ranges);
+    return status == 0 ? nwritten : -1;
 }
 
 int main(int argc, char **argv)
@@ -50,9 +250,10 @@ int main(int argc, char **argv)
     int64_t end_utime = -1;
     int have_end_utime = 0;
     int invert_regex = 0;
+    int jobs = 1;
 
-    char *optstring = "hc:vs:e:i";
-    char c;
+    char *optstring = "hc:vs:e:ij:";
+    int c;
 
     while ((c = getopt(argc, argv, optstring)) >= 0)
     {
@@ -85,6 +286,14 @@ int main(int argc, char **argv)
             case 'c':
                 pattern = g_strdup(optarg);
                 break;
+            case 'j':
+                {
+                    char *eptr = NULL;
+                    jobs = strtol(optarg, &eptr, 10);
+                    if(*eptr != 0 || jobs < 1)
+                        usage();
+                }
+                break;
             case 'v':
                 verbose = 1;
                 break;
@@ -103,86 +312,86 @@ int main(int argc, char **argv)
     if (!pattern)
         usage();
 
-    GRegex * regex;
+    filter_t filter;
     GError *rerr = NULL;
-    regex = g_regex_new(pattern, (GRegexCompileFlags) 0, (GRegexMatchFlags) 0, &rerr);
-    if(rerr) {
-        fprintf(stderr, "bad regex\n");
+    filter.pattern = lcm_channel_pattern_new(pattern, &rerr);
+    if(!filter.pattern) {
+        fprintf(stderr, "bad regex: %s\n", rerr->message);
+        g_error_free(rerr);
         exit(1);
     }
+    filter.invert = invert_regex;
 
     source_fname = argv[argc - 2];
     dest_fname = argv[argc - 1];
 
+    // the time window is relative to the first event of the whole log
     lcm_eventlog_t *src_log = lcm_eventlog_create(source_fname, "r");
     if (!src_log) {
         perror("Unable to open source logfile");
-		g_regex_unref(regex);
-        return 1;
-    }
-    lcm_eventlog_t *dst_log = lcm_eventlog_create(dest_fname, "w");
-    if (!dst_log) {
-        perror("Unable to open destination logfile");
-        lcm_eventlog_destroy(src_log);
-		g_regex_unref(regex);
+        lcm_channel_pattern_free(filter.pattern);
         return 1;
     }
+    lcm_eventlog_event_t *first = lcm_eventlog_read_next_event(src_log);
+    int64_t first_event_timestamp = first ? first->timestamp : 0;
+    if (first)
+        lcm_eventlog_free_event(first);
+    lcm_eventlog_destroy(src_log);
+    filter.start_timestamp = first_event_timestamp + start_utime;
+    filter.end_timestamp = have_end_utime ?
+        first_event_timestamp + end_utime : -1;
 
     GHashTable *counts = g_hash_table_new_full(g_str_hash, g_str_equal,
             g_free, free);
-    int nwritten = 0;
-    int have_first_event_timestamp = 0;
-    int64_t first_event_timestamp = 0;
-
-    for (lcm_eventlog_event_t *event = lcm_eventlog_read_next_event(src_log);
-            event != NULL;
-            event = lcm_eventlog_read_next_event(src_log)) {
-        if(!have_first_event_timestamp) {
-            first_event_timestamp = event->timestamp;
-            have_first_event_timestamp = 1;
-        }
+    int64_t nwritten = -1;
 
-        int64_t elapsed = event->timestamp - first_event_timestamp;
-        if(elapsed < start_utime) {
-            lcm_eventlog_free_event(event);
-            continue;
-        }
-        if(have_end_utime && elapsed > end_utime) {
-            lcm_eventlog_free_event(event);
-            break;
+    int num_ranges = 1;
+    int64_t *offsets = (int64_t *) malloc((jobs + 1) * sizeof(int64_t));
+    if (jobs > 1)
+        num_ranges = lcm_eventlog_split(source_fname, jobs, offsets);
+    if (num_ranges > 1) {
+        nwritten = filter_parallel(&filter, source_fname, dest_fname,
+                num_ranges, offsets, counts);
+    } else {
+        // A filtered reader never reads the data of other channels, and
+        // skips the parts of an indexed log without any of them.
+        range_t r;
+        memset(&r, 0, sizeof(r));
+        r.filter = &filter;
+        r.copies = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                NULL);
+        r.counts = counts;
+        r.src = invert_regex ? lcm_eventlog_create(source_fname, "r") :
+            lcm_eventlog_create_filtered(source_fname, pattern);
+        r.dst = r.src ? create_output(dest_fname) : NULL;
+        if (!r.src) {
+            perror("Unable to open source logfile");
+        } else if (!r.dst) {
+            perror("Unable to open destination logfile");
+        } else {
+            if (start_utime > 0)
+                lcm_eventlog_seek_to_timestamp(r.src, filter.start_timestamp);
+            filter_range(&r);
+            nwritten = r.status == 0 ? r.nwritten : -1;
         }
-
-		int regmatch =  g_regex_match(regex, event->channel, (GRegexMatchFlags) 0, NULL);
-        int copy_to_dest = (regmatch == 0 && !invert_regex) ||
-                           (regmatch != 0 && invert_regex);
-        if (copy_to_dest) {
-            lcm_eventlog_write_event(dst_log, event);
-            nwritten++;
-
-            if (verbose)  {
-                int *count = (int *) g_hash_table_lookup(counts, event->channel);
-                if (!count) {
-                    count = (int*) malloc(sizeof(int));
-                    *count = 1;
-                    g_hash_table_insert(counts, g_strdup(event->channel), count);
-                    printf("matched channel %s\n", event->channel);
-                } else {
-                    *count += 1;
-                }
-            }
-        }
-        lcm_eventlog_free_event(event);
+        if (r.src)
+            lcm_eventlog_destroy(r.src);
+        if (r.dst)
+            lcm_eventlog_destroy(r.dst);
+        g_hash_table_destroy(r.copies);
     }
+    free(offsets);
 
-    if (verbose) {
+    if (nwritten < 0)
+        fprintf(stderr, "Error: Failed to write %s\n", dest_fname);
+    else if (verbose) {
         g_hash_table_foreach(counts, _verbose_entry_summary, NULL);
         printf("=====\n");
-        printf("Events written: %d\n", nwritten);
+        printf("Events written: %" PRId64 "\n", nwritten);
     }
-    
-	g_regex_unref(regex);
-    lcm_eventlog_destroy(src_log);
-    lcm_eventlog_destroy(dst_log);
+
+    lcm_channel_pattern_free(filter.pattern);
     g_hash_table_destroy(counts);
-    return 0;
+    g_free(pattern);
+    return nwritten < 0 ? 1 : 0;
 }
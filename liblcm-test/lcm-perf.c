@@ -0,0 +1,550 @@
+// file: lcm-perf.c
+// desc: end-to-end throughput and latency benchmark for any LCM provider.
+//       Publisher and subscriber threads, each with an LCM instance of its
+//       own, exchange timestamped messages over a sweep of message sizes and
+//       publish rates, and each run is reported as a line of CSV or JSON.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <glib.h>
+#include <lcm/lcm.h>
+
+#define DEFAULT_SIZES "64,1024,16384"
+#define DEFAULT_RATES "10000"
+#define DEFAULT_CHANNEL "LCM_PERF"
+
+// publisher id, sequence number and send time at the start of each message
+#define HEADER_SIZE 20
+
+// how long subscribers get to join before, and to drain after, a run
+#define SETTLE_USEC 200000
+
+// A histogram of latencies in nanoseconds, in the manner of HdrHistogram:
+// values below 2 * HIST_HALF are counted exactly, and above that each power
+// of two is split into HIST_HALF buckets, so that any value is known to
+// within 1 / HIST_HALF of itself.
+#define HIST_HALF_BITS 6
+#define HIST_HALF (1 << HIST_HALF_BITS)
+#define HIST_SHIFTS 40
+#define HIST_BUCKETS (2 * HIST_HALF + HIST_SHIFTS * HIST_HALF)
+
+typedef struct {
+    int64_t counts[HIST_BUCKETS];
+    int64_t total;
+    int64_t min;
+    int64_t max;
+} histogram_t;
+
+typedef struct {
+    // the settings of the sweep
+    const char *url;
+    const char *channel;
+    int num_publishers;
+    int num_subscribers;
+    double duration;
+    int json;
+
+    // the run in progress
+    int size;
+    double rate;
+    int stop_publishing;  // atomic
+    int stop_receiving;   // atomic
+    int failed;           // atomic
+} perf_t;
+
+typedef struct {
+    perf_t *perf;
+    int id;
+    lcm_t *lcm;
+    int64_t num_sent;
+} publisher_t;
+
+typedef struct {
+    perf_t *perf;
+    lcm_t *lcm;
+    lcm_subscription_t *subs;
+    int64_t num_received;
+    int64_t num_bytes;
+    histogram_t hist;
+} subscriber_t;
+
+static int64_t
+now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t
+cpu_ns(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ((int64_t) ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000 +
+        ((int64_t) ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000;
+}
+
+static void
+encode64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--, v >>= 8)
+        p[i] = (uint8_t) v;
+}
+
+static uint64_t
+decode64(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static int
+hist_index(int64_t v)
+{
+    if (v < 2 * HIST_HALF)
+        return v < 0 ? 0 : (int) v;
+    int msb = 63;
+    while (!((uint64_t) v >> msb))
+        msb--;
+    // v >> shift is in [HIST_HALF, 2 * HIST_HALF)
+    int shift = msb - HIST_HALF_BITS;
+    if (shift > HIST_SHIFTS)
+        return HIST_BUCKETS - 1;
+    return HIST_HALF + shift * HIST_HALF + (int) ((v >> shift) - HIST_HALF);
+}
+
+// the largest value counted in a bucket
+static int64_t
+hist_value(int i)
+{
+    if (i < 2 * HIST_HALF)
+        return i;
+    int shift = (i - HIST_HALF) / HIST_HALF;
+    int64_t sub = HIST_HALF + (i - HIST_HALF) % HIST_HALF;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void
+hist_record(histogram_t *h, int64_t v)
+{
+    h->counts[hist_index(v)]++;
+    if (!h->total || v < h->min)
+        h->min = v;
+    if (!h->total || v > h->max)
+        h->max = v;
+    h->total++;
+}
+
+static void
+hist_add(histogram_t *h, const histogram_t *other)
+{
+    if (!other->total)
+        return;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+        h->counts[i] += other->counts[i];
+    if (!h->total || other->min < h->min)
+        h->min = other->min;
+    if (!h->total || other->max > h->max)
+        h->max = other->max;
+    h->total += other->total;
+}
+
+static int64_t
+hist_percentile(const histogram_t *h, double percentile)
+{
+    if (!h->total)
+        return 0;
+    int64_t rank = (int64_t) (percentile / 100 * h->total + 0.5);
+    if (rank < 1)
+        rank = 1;
+    int64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            int64_t v = hist_value(i);
+            return v < h->max ? v : h->max;
+        }
+    }
+    return h->max;
+}
+
+static void
+on_message(const lcm_recv_buf_t *rbuf, const char *channel, void *user)
+{
+    int64_t now = now_ns();
+    subscriber_t *s = (subscriber_t *) user;
+    if (rbuf->data_size < HEADER_SIZE)
+        return;
+    const uint8_t *p = (const uint8_t *) rbuf->data;
+    hist_record(&s->hist, now - (int64_t) decode64(p + 12));
+    s->num_received++;
+    s->num_bytes += rbuf->data_size;
+}
+
+static gpointer
+subscriber_thread(gpointer user)
+{
+    subscriber_t *s = (subscriber_t *) user;
+    while (!g_atomic_int_get(&s->perf->stop_receiving)) {
+        if (lcm_handle_timeout(s->lcm, 50) < 0) {
+            g_atomic_int_set(&s->perf->failed, 1);
+            break;
+        }
+    }
+    return NULL;
+}
+
+static gpointer
+publisher_thread(gpointer user)
+{
+    publisher_t *p = (publisher_t *) user;
+    perf_t *perf = p->perf;
+    uint8_t *msg = (uint8_t *) calloc(1, perf->size);
+    for (int i = HEADER_SIZE; i < perf->size; i++)
+        msg[i] = (uint8_t) i;
+    msg[0] = (uint8_t) (p->id >> 24);
+    msg[1] = (uint8_t) (p->id >> 16);
+    msg[2] = (uint8_t) (p->id >> 8);
+    msg[3] = (uint8_t) p->id;
+
+    // messages go out on a fixed schedule, or back-to-back with rate 0
+    int64_t interval = perf->rate > 0 ? (int64_t) (1e9 / perf->rate) : 0;
+    int64_t next = now_ns();
+    while (!g_atomic_int_get(&perf->stop_publishing)) {
+        if (interval) {
+            next += interval;
+            struct timespec ts;
+            ts.tv_sec = next / 1000000000;
+            ts.tv_nsec = next % 1000000000;
+#ifdef __linux__
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#else
+            int64_t wait = next - now_ns();
+            if (wait > 0)
+                g_usleep(wait / 1000);
+#endif
+        }
+        encode64(msg + 4, p->num_sent);
+        encode64(msg + 12, now_ns());
+        if (0 == lcm_publish(p->lcm, perf->channel, msg, perf->size))
+            p->num_sent++;
+    }
+    free(msg);
+    return NULL;
+}
+
+static int
+run(perf_t *perf)
+{
+    // memq and inproc only deliver within one instance, which all the
+    // threads then share
+    int shared = !strncmp(perf->url, "memq://", 7) ||
+        !strncmp(perf->url, "inproc://", 9);
+    lcm_t *shared_lcm = shared ? lcm_create(perf->url) : NULL;
+    if (shared && !shared_lcm) {
+        fprintf(stderr, "Error: Failed to create LCM for %s\n", perf->url);
+        return -1;
+    }
+
+    publisher_t *pubs = (publisher_t *) calloc(perf->num_publishers,
+            sizeof(publisher_t));
+    subscriber_t *subs = (subscriber_t *) calloc(perf->num_subscribers,
+            sizeof(subscriber_t));
+    GThread **pub_threads = (GThread **) calloc(perf->num_publishers,
+            sizeof(GThread *));
+    GThread **sub_threads = (GThread **) calloc(perf->num_subscribers,
+            sizeof(GThread *));
+    int status = 0;
+    g_atomic_int_set(&perf->stop_publishing, 0);
+    g_atomic_int_set(&perf->stop_receiving, 0);
+    g_atomic_int_set(&perf->failed, 0);
+
+    for (int i = 0; i < perf->num_subscribers && status == 0; i++) {
+        subscriber_t *s = &subs[i];
+        s->perf = perf;
+        s->lcm = shared ? shared_lcm : lcm_create(perf->url);
+        if (!s->lcm) {
+            fprintf(stderr, "Error: Failed to create LCM for %s\n",
+                    perf->url);
+            status = -1;
+            break;
+        }
+        s->subs = lcm_subscribe(s->lcm, perf->channel, on_message, s);
+        // with a shared instance, one thread dispatches for everyone
+        if (!shared || i == 0)
+            sub_threads[i] = g_thread_create(subscriber_thread, s, TRUE,
+                    NULL);
+    }
+    for (int i = 0; i < perf->num_publishers && status == 0; i++) {
+        pubs[i].perf = perf;
+        pubs[i].id = i;
+        pubs[i].lcm = shared ? shared_lcm : lcm_create(perf->url);
+        if (!pubs[i].lcm) {
+            fprintf(stderr, "Error: Failed to create LCM for %s\n",
+                    perf->url);
+            status = -1;
+        }
+    }
+
+    int64_t start_ns = 0, end_ns = 0, start_cpu = 0, end_cpu = 0;
+    if (status == 0) {
+        g_usleep(SETTLE_USEC);
+        start_cpu = cpu_ns();
+        start_ns = now_ns();
+        for (int i = 0; i < perf->num_publishers; i++)
+            pub_threads[i] = g_thread_create(publisher_thread, &pubs[i], TRUE,
+                    NULL);
+        g_usleep((gulong) (perf->duration * 1e6));
+    }
+    g_atomic_int_set(&perf->stop_publishing, 1);
+    for (int i = 0; i < perf->num_publishers; i++) {
+        if (pub_threads[i])
+            g_thread_join(pub_threads[i]);
+    }
+    if (status == 0) {
+        end_ns = now_ns();
+        g_usleep(SETTLE_USEC);
+    }
+    g_atomic_int_set(&perf->stop_receiving, 1);
+    for (int i = 0; i < perf->num_subscribers; i++) {
+        if (sub_threads[i])
+            g_thread_join(sub_threads[i]);
+    }
+    end_cpu = cpu_ns();
+    if (g_atomic_int_get(&perf->failed))
+        status = -1;
+
+    int64_t num_sent = 0, num_received = 0, num_bytes = 0;
+    histogram_t *hist = (histogram_t *) calloc(1, sizeof(histogram_t));
+    for (int i = 0; i < perf->num_publishers; i++)
+        num_sent += pubs[i].num_sent;
+    for (int i = 0; i < perf->num_subscribers; i++) {
+        num_received += subs[i].num_received;
+        num_bytes += subs[i].num_bytes;
+        hist_add(hist, &subs[i].hist);
+    }
+
+    if (status == 0) {
+        double seconds = (end_ns - start_ns) / 1e9;
+        int64_t num_expected = num_sent * perf->num_subscribers;
+        double loss = num_expected ?
+            1 - (double) num_received / num_expected : 0;
+        int64_t num_msgs = num_sent + num_received;
+        double cpu_per_msg = num_msgs ?
+            (double) (end_cpu - start_cpu) / num_msgs : 0;
+        double lat[7] = {
+            hist->min / 1e3,
+            hist_percentile(hist, 50) / 1e3,
+            hist_percentile(hist, 90) / 1e3,
+            hist_percentile(hist, 99) / 1e3,
+            hist_percentile(hist, 99.9) / 1e3,
+            hist_percentile(hist, 99.99) / 1e3,
+            hist->max / 1e3,
+        };
+        if (perf->json) {
+            printf("{\"url\": \"%s\", \"size\": %d, \"rate\": %g, "
+                    "\"publishers\": %d, \"subscribers\": %d, "
+                    "\"seconds\": %.3f, \"sent\": %" PRId64 ", "
+                    "\"received\": %" PRId64 ", \"loss\": %.6f, "
+                    "\"msgs_per_sec\": %.1f, \"mb_per_sec\": %.3f, "
+                    "\"cpu_ns_per_msg\": %.1f, \"latency_usec\": "
+                    "{\"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+                    "\"p99\": %.3f, \"p99.9\": %.3f, \"p99.99\": %.3f, "
+                    "\"max\": %.3f}}\n",
+                    perf->url, perf->size, perf->rate, perf->num_publishers,
+                    perf->num_subscribers, seconds, num_sent, num_received,
+                    loss, num_received / seconds, num_bytes / seconds / 1e6,
+                    cpu_per_msg, lat[0], lat[1], lat[2], lat[3], lat[4],
+                    lat[5], lat[6]);
+        } else {
+            printf("%s,%d,%g,%d,%d,%.3f,%" PRId64 ",%" PRId64 ",%.6f,%.1f,"
+                    "%.3f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+                    perf->url, perf->size, perf->rate, perf->num_publishers,
+                    perf->num_subscribers, seconds, num_sent, num_received,
+                    loss, num_received / seconds, num_bytes / seconds / 1e6,
+                    cpu_per_msg, lat[0], lat[1], lat[2], lat[3], lat[4],
+                    lat[5], lat[6]);
+        }
+        fflush(stdout);
+    }
+
+    for (int i = 0; i < perf->num_subscribers; i++) {
+        if (subs[i].subs)
+            lcm_unsubscribe(subs[i].lcm, subs[i].subs);
+        if (!shared && subs[i].lcm)
+            lcm_destroy(subs[i].lcm);
+    }
+    for (int i = 0; i < perf->num_publishers; i++) {
+        if (!shared && pubs[i].lcm)
+            lcm_destroy(pubs[i].lcm);
+    }
+    if (shared_lcm)
+        lcm_destroy(shared_lcm);
+    free(hist);
+    free(sub_threads);
+    free(pub_threads);
+    free(subs);
+    free(pubs);
+    return status;
+}
+
+// parses a comma separated list of numbers
+static GArray *
+parse_list(const char *list)
+{
+    GArray *values = g_array_new(FALSE, FALSE, sizeof(double));
+    char **items = g_strsplit(list, ",", -1);
+    for (int i = 0; items[i]; i++) {
+        char *eptr = NULL;
+        double v = strtod(items[i], &eptr);
+        if (eptr == items[i] || *eptr || v < 0) {
+            g_array_free(values, TRUE);
+            values = NULL;
+            break;
+        }
+        g_array_append_val(values, v);
+    }
+    g_strfreev(items);
+    if (values && !values->len) {
+        g_array_free(values, TRUE);
+        values = NULL;
+    }
+    return values;
+}
+
+static void
+usage(void)
+{
+    printf("usage: lcm-perf [OPTIONS]\n"
+           "\n"
+           "Measures the throughput, loss, CPU cost and latency of an LCM\n"
+           "provider.  For each message size and publish rate, publisher and\n"
+           "subscriber threads, each with an LCM instance of its own,\n"
+           "exchange timestamped messages, and the run is reported as one line\n"
+           "of CSV, or of JSON.\n"
+           "\n"
+           "  -h        prints this help text and exits\n"
+           "  -u URL    LCM URL to measure (default: the default LCM URL)\n"
+           "  -s SIZES  comma separated message sizes, in bytes, of at least %d\n"
+           "            (default: %s)\n"
+           "  -r RATES  comma separated rates, in messages per second for each\n"
+           "            publisher.  0 publishes as fast as possible.\n"
+           "            (default: %s)\n"
+           "  -p N      number of publisher threads (default: 1)\n"
+           "  -n N      number of subscriber threads, each receiving every\n"
+           "            message (default: 1)\n"
+           "  -d SEC    duration of each run (default: 2)\n"
+           "  -c CHAN   channel to publish on (default: %s)\n"
+           "  -j        print JSON instead of CSV\n"
+           "\n"
+           "Latencies are in microseconds, CPU time is for the whole process\n"
+           "per message sent or received.\n",
+           HEADER_SIZE, DEFAULT_SIZES, DEFAULT_RATES, DEFAULT_CHANNEL);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    perf_t perf;
+    memset(&perf, 0, sizeof(perf));
+    perf.url = NULL;
+    perf.channel = DEFAULT_CHANNEL;
+    perf.num_publishers = 1;
+    perf.num_subscribers = 1;
+    perf.duration = 2;
+    const char *sizes_arg = DEFAULT_SIZES;
+    const char *rates_arg = DEFAULT_RATES;
+
+    char *optstring = "hu:s:r:p:n:d:c:j";
+    int c;
+    while ((c = getopt(argc, argv, optstring)) >= 0)
+    {
+        switch (c) {
+            case 'u':
+                perf.url = optarg;
+                break;
+            case 's':
+                sizes_arg = optarg;
+                break;
+            case 'r':
+                rates_arg = optarg;
+                break;
+            case 'p':
+                perf.num_publishers = atoi(optarg);
+                if (perf.num_publishers < 1)
+                    usage();
+                break;
+            case 'n':
+                perf.num_subscribers = atoi(optarg);
+                if (perf.num_subscribers < 1)
+                    usage();
+                break;
+            case 'd':
+                perf.duration = strtod(optarg, NULL);
+                if (perf.duration <= 0)
+                    usage();
+                break;
+            case 'c':
+                perf.channel = optarg;
+                break;
+            case 'j':
+                perf.json = 1;
+                break;
+            case 'h':
+            default:
+                usage();
+                break;
+        };
+    }
+    if (optind != argc)
+        usage();
+
+    GArray *sizes = parse_list(sizes_arg);
+    GArray *rates = parse_list(rates_arg);
+    if (!sizes || !rates)
+        usage();
+    for (guint i = 0; i < sizes->len; i++) {
+        if (g_array_index(sizes, double, i) < HEADER_SIZE)
+            usage();
+    }
+
+    // the URL is echoed in each result
+    char *default_url = NULL;
+    if (!perf.url) {
+        const char *env = getenv("LCM_DEFAULT_URL");
+        default_url = g_strdup(env && *env ? env :
+                "udpm://239.255.76.67:7667?ttl=0");
+        perf.url = default_url;
+    }
+
+    if (!perf.json)
+        printf("url,size,rate,publishers,subscribers,seconds,sent,received,"
+                "loss,msgs_per_sec,mb_per_sec,cpu_ns_per_msg,lat_min_usec,"
+                "lat_p50_usec,lat_p90_usec,lat_p99_usec,lat_p999_usec,"
+                "lat_p9999_usec,lat_max_usec\n");
+
+    int status = 0;
+    for (guint i = 0; i < sizes->len && status == 0; i++) {
+        for (guint j = 0; j < rates->len && status == 0; j++) {
+            perf.size = (int) g_array_index(sizes, double, i);
+            perf.rate = g_array_index(rates, double, j);
+            status = run(&perf);
+        }
+    }
+
+    g_array_free(sizes, TRUE);
+    g_array_free(rates, TRUE);
+    g_free(default_url);
+    return status == 0 ? 0 : 1;
+}
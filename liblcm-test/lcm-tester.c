@@ -9,10 +9,13 @@
 #endif
 
 #include <fcntl.h>
+#include <math.h>
+#include <time.h>
 
 #include <glib.h>
 
 #include <lcm/lcm.h>
+#include <lcm/lcm_coretypes.h>
 
 static int64_t 
 timestamp_now ()
@@ -71,7 +74,8 @@ regex_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
     printf ("regex handler\n");
 }
 
-int main (int argc, char **argv)
+static int
+self_test (void)
 {
     int status;
 
@@ -212,3 +216,376 @@ int main (int argc, char **argv)
     printf ("LCM: OK!\n");
     return 0;
 }
+
+/* Ping-pong mode.  The pinger publishes each ping and waits for the ponger
+ * to reflect it, and times every stage of the round trip:
+ *
+ *   publish     how long lcm_publish() takes to return
+ *   wire        from calling lcm_publish() to the receive timestamp, i.e.,
+ *               through the sender's and receiver's kernels and the network.
+ *               This overlaps publish, since on a loopback interface the
+ *               message is often received before lcm_publish() returns.
+ *   rx thread   from the receive timestamp until the application wakes up
+ *               to the message, i.e., the provider's receive thread
+ *   dispatch    from waking up until the handler runs, in lcm_handle()
+ *   turnaround  from the ponger's handler running until it publishes
+ *
+ * Each side measures its own stages on its own clock; the ponger reports
+ * its stages in the pong, and the wire time of each direction is what is
+ * left of the round trip, split evenly.  The clocks of the two sides never
+ * need to agree. */
+
+#define PING_CHANNEL "LCM_TESTER_PING"
+#define PONG_CHANNEL "LCM_TESTER_PONG"
+
+// The sequence number of the ping, then in the pong the ponger's receive
+// thread, dispatch and turnaround times, and how long its previous pong took
+// to publish, each an int64 in nanoseconds
+#define PING_HEADER_FIELDS 5
+#define PING_HEADER_SIZE (PING_HEADER_FIELDS * 8)
+
+#define DEFAULT_PING_SIZES "64,1024,16384,65536"
+
+typedef struct {
+    lcm_t *lcm;
+    char *buf;
+    int64_t wake_ns;            // when the application woke up to the message
+    int64_t prev_publish_ns;    // how long the last pong took to publish
+
+    // the pinger's view of the reply it waits for
+    int64_t expected_seq;
+    int got_reply;
+    int64_t reply_hdr[PING_HEADER_FIELDS];
+    int64_t reply_rx_ns;
+    int64_t reply_dispatch_ns;
+    int64_t reply_handler_ns;
+} ping_state_t;
+
+static int64_t
+now_ns (void)
+{
+#ifdef WIN32
+    return timestamp_now () * 1000;
+#else
+    struct timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+// Waits up to timeout_usec for a message, and handles it.  Returns 1 if one
+// was handled, 0 on timeout and -1 on errors.
+static int
+handle_timed (ping_state_t *ps, int64_t timeout_usec)
+{
+    int fd = lcm_get_fileno (ps->lcm);
+    fd_set readfds;
+    FD_ZERO (&readfds);
+    FD_SET (fd, &readfds);
+    struct timeval timeout;
+    timestamp_to_timeval (timeout_usec, &timeout);
+    int status = select (fd + 1, &readfds, 0, 0, &timeout);
+    if (status < 0) {
+        perror ("select");
+        return -1;
+    }
+    if (status == 0)
+        return 0;
+    ps->wake_ns = now_ns ();
+    return lcm_handle (ps->lcm) == 0 ? 1 : -1;
+}
+
+static void
+pong_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+{
+    ping_state_t *ps = (ping_state_t *) u;
+    int64_t handler_ns = now_ns ();
+    if (rbuf->data_size < PING_HEADER_SIZE)
+        return;
+
+    int64_t hdr[PING_HEADER_FIELDS];
+    __int64_t_decode_array (rbuf->data, 0, PING_HEADER_SIZE, hdr, 1);
+    hdr[1] = ps->wake_ns - rbuf->recv_time_ns;
+    hdr[2] = handler_ns - ps->wake_ns;
+    hdr[4] = ps->prev_publish_ns;
+
+    memcpy (ps->buf, rbuf->data, rbuf->data_size);
+    int64_t publish_start = now_ns ();
+    hdr[3] = publish_start - handler_ns;
+    __int64_t_encode_array (ps->buf, 0, PING_HEADER_SIZE, hdr,
+            PING_HEADER_FIELDS);
+    lcm_publish (ps->lcm, PONG_CHANNEL, ps->buf, rbuf->data_size);
+    ps->prev_publish_ns = now_ns () - publish_start;
+}
+
+static void
+ping_reply_handler (const lcm_recv_buf_t *rbuf, const char *channel, void *u)
+{
+    ping_state_t *ps = (ping_state_t *) u;
+    int64_t handler_ns = now_ns ();
+    if (rbuf->data_size < PING_HEADER_SIZE)
+        return;
+    __int64_t_decode_array (rbuf->data, 0, PING_HEADER_SIZE, ps->reply_hdr,
+            PING_HEADER_FIELDS);
+    // a late reply to a ping that timed out
+    if (ps->reply_hdr[0] != ps->expected_seq)
+        return;
+    ps->got_reply = 1;
+    ps->reply_handler_ns = handler_ns;
+    ps->reply_rx_ns = ps->wake_ns - rbuf->recv_time_ns;
+    ps->reply_dispatch_ns = handler_ns - ps->wake_ns;
+}
+
+static int
+compare_int64 (const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *) a;
+    int64_t y = *(const int64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// median, in microseconds, of n samples in nanoseconds.  Sorts them.
+static double
+median_usec (int64_t *v, int n)
+{
+    qsort (v, n, sizeof (int64_t), compare_int64);
+    return v[n / 2] / 1000.0;
+}
+
+static int
+pong (const char *url)
+{
+    ping_state_t ps;
+    memset (&ps, 0, sizeof (ps));
+    ps.lcm = lcm_create (url);
+    if (!ps.lcm) {
+        fprintf (stderr, "couldn't allocate lcm_t\n");
+        return 1;
+    }
+    ps.buf = (char *) malloc (LCM_MAX_MESSAGE_SIZE);
+    lcm_subscribe (ps.lcm, PING_CHANNEL, pong_handler, &ps);
+    printf ("LCM: reflecting pings on %s\n", PING_CHANNEL);
+    fflush (stdout);
+    while (handle_timed (&ps, 1000000) >= 0) {
+    }
+    free (ps.buf);
+    lcm_destroy (ps.lcm);
+    return 1;
+}
+
+static int
+ping (const char *url, const char *sizes, int count, int warmup,
+        int timeout_ms)
+{
+    ping_state_t ps;
+    memset (&ps, 0, sizeof (ps));
+    ps.lcm = lcm_create (url);
+    if (!ps.lcm) {
+        fprintf (stderr, "couldn't allocate lcm_t\n");
+        return 1;
+    }
+    lcm_subscribe (ps.lcm, PONG_CHANNEL, ping_reply_handler, &ps);
+
+    // rtt, publish, wire, rx thread, dispatch and turnaround per ping
+    int64_t *samples[6];
+    for (int i = 0; i < 6; i++)
+        samples[i] = (int64_t *) malloc (count * sizeof (int64_t));
+
+    printf ("%8s %6s %5s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "size",
+            "count", "lost", "rtt_p50", "rtt_p99", "rtt_max", "jitter",
+            "publish", "wire", "rx_thread", "dispatch", "turnaround");
+    printf ("%8s %6s %5s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "(bytes)",
+            "", "", "(usec)", "", "", "", "", "", "", "", "");
+
+    int64_t seq = 0;
+    int status = 0;
+    const char *p = sizes;
+    while (*p && status == 0) {
+        char *end;
+        long size = strtol (p, &end, 10);
+        if (end == p || size <= 0 || size > LCM_MAX_MESSAGE_SIZE) {
+            fprintf (stderr, "Invalid size list \"%s\"\n", sizes);
+            status = 1;
+            break;
+        }
+        p = *end == ',' ? end + 1 : end;
+        if (size < PING_HEADER_SIZE)
+            size = PING_HEADER_SIZE;
+        ps.buf = (char *) calloc (1, size);
+
+        int n = 0;
+        int lost = 0;
+        double sum = 0, sum_sq = 0;
+        int64_t rtt_max = 0;
+        for (int i = 0; i < warmup + count && status == 0; i++) {
+            int64_t hdr[PING_HEADER_FIELDS] = { seq, 0, 0, 0, 0 };
+            __int64_t_encode_array (ps.buf, 0, PING_HEADER_SIZE, hdr,
+                    PING_HEADER_FIELDS);
+            ps.expected_seq = seq++;
+            ps.got_reply = 0;
+
+            int64_t t0 = now_ns ();
+            lcm_publish (ps.lcm, PING_CHANNEL, ps.buf, size);
+            int64_t t1 = now_ns ();
+
+            int64_t deadline = t0 + (int64_t) timeout_ms * 1000000;
+            while (!ps.got_reply && status == 0) {
+                int64_t left = deadline - now_ns ();
+                if (left <= 0)
+                    break;
+                if (handle_timed (&ps, left / 1000 + 1) < 0)
+                    status = 1;
+            }
+            if (!ps.got_reply) {
+                if (i >= warmup)
+                    lost++;
+                continue;
+            }
+            if (i < warmup)
+                continue;
+
+            // the pong's publish time is reported with the next pong, and
+            // taken to be the same as the ping's for the first one
+            int64_t *h = ps.reply_hdr;
+            int64_t pong_publish = n ? h[4] : t1 - t0;
+            int64_t rtt = ps.reply_handler_ns - t0;
+            int64_t accounted = h[1] + h[2] + h[3] + ps.reply_rx_ns +
+                ps.reply_dispatch_ns;
+            samples[0][n] = rtt;
+            samples[1][n] = ((t1 - t0) + pong_publish) / 2;
+            samples[2][n] = (rtt - accounted) / 2;
+            samples[3][n] = (h[1] + ps.reply_rx_ns) / 2;
+            samples[4][n] = (h[2] + ps.reply_dispatch_ns) / 2;
+            samples[5][n] = h[3];
+            sum += rtt;
+            sum_sq += (double) rtt * rtt;
+            if (rtt > rtt_max)
+                rtt_max = rtt;
+            n++;
+        }
+        free (ps.buf);
+        ps.buf = NULL;
+        if (status != 0)
+            break;
+        if (n == 0) {
+            printf ("%8ld %6d %5d %9s\n", size, n, lost, "-");
+            continue;
+        }
+
+        double mean = sum / n;
+        double jitter = sqrt (MAX (0, sum_sq / n - mean * mean)) / 1000.0;
+        qsort (samples[0], n, sizeof (int64_t), compare_int64);
+        double rtt_p99 = samples[0][(int) ((n - 1) * 0.99)] / 1000.0;
+        printf ("%8ld %6d %5d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f "
+                "%9.1f %9.1f\n", size, n, lost, median_usec (samples[0], n),
+                rtt_p99, rtt_max / 1000.0, jitter, median_usec (samples[1], n),
+                median_usec (samples[2], n), median_usec (samples[3], n),
+                median_usec (samples[4], n), median_usec (samples[5], n));
+        fflush (stdout);
+    }
+
+    for (int i = 0; i < 6; i++)
+        free (samples[i]);
+    lcm_destroy (ps.lcm);
+    return status;
+}
+
+static void
+usage (const char *cmd)
+{
+    fprintf (stderr, "\
+Usage: %s [OPTION...]\n\
+  Without --ping or --pong, tests handler registration and self-receive.\n\
+\n\
+Options:\n\
+  --ping               Measure round trips to an lcm-tester running --pong.\n\
+  --pong               Reflect the pings of an lcm-tester running --ping.\n\
+  -u, --lcm-url=URL    LCM URL to use.\n\
+  -s, --sizes=LIST     Comma separated ping sizes, in bytes.\n\
+                       (default: %s)\n\
+  -n, --count=N        Pings timed per size.  (default: 1000)\n\
+  -w, --warmup=N       Pings sent untimed before each size.  (default: 10)\n\
+  -t, --timeout=MS     How long to wait for each pong.  (default: 100)\n\
+  -h, --help           Shows this help text and exits.\n\
+  \n", cmd, DEFAULT_PING_SIZES);
+}
+
+// Matches argv[*i] against the option -s or --l, and points *value at its
+// argument, either after '=' or in the next argument.  Returns 1 if it
+// matched, and -1 if its argument is missing.
+static int
+match_option (int argc, char **argv, int *i, const char *s, const char *l,
+        const char **value)
+{
+    const char *arg = argv[*i];
+    size_t len = strlen (l);
+    if (!strncmp (arg, "--", 2) && !strncmp (arg + 2, l, len) &&
+            arg[2 + len] == '=') {
+        *value = arg + 3 + len;
+        return 1;
+    }
+    if (!(!strncmp (arg, "--", 2) && !strcmp (arg + 2, l)) &&
+            !(s && !strcmp (arg, s)))
+        return 0;
+    if (*i + 1 >= argc)
+        return -1;
+    *value = argv[++*i];
+    return 1;
+}
+
+int main (int argc, char **argv)
+{
+    int mode = 0;   // 0 self test, 'i' ping, 'o' pong
+    const char *url = NULL;
+    const char *sizes = DEFAULT_PING_SIZES;
+    int count = 1000;
+    int warmup = 10;
+    int timeout_ms = 100;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = NULL;
+        int m = 0;
+        if (!strcmp (argv[i], "--ping")) {
+            mode = 'i';
+        } else if (!strcmp (argv[i], "--pong")) {
+            mode = 'o';
+        } else if ((m = match_option (argc, argv, &i, "-u", "lcm-url",
+                        &value))) {
+            url = value;
+        } else if ((m = match_option (argc, argv, &i, "-s", "sizes",
+                        &value))) {
+            sizes = value;
+        } else if ((m = match_option (argc, argv, &i, "-n", "count",
+                        &value))) {
+            if (m < 0 || (count = atoi (value)) <= 0) {
+                usage (argv[0]);
+                return 1;
+            }
+        } else if ((m = match_option (argc, argv, &i, "-w", "warmup",
+                        &value))) {
+            if (m < 0 || (warmup = atoi (value)) < 0) {
+                usage (argv[0]);
+                return 1;
+            }
+        } else if ((m = match_option (argc, argv, &i, "-t", "timeout",
+                        &value))) {
+            if (m < 0 || (timeout_ms = atoi (value)) <= 0) {
+                usage (argv[0]);
+                return 1;
+            }
+        } else {
+            usage (argv[0]);
+            return 1;
+        }
+        if (m < 0) {
+            usage (argv[0]);
+            return 1;
+        }
+    }
+
+    if (mode == 'i')
+        return ping (url, sizes, count, warmup, timeout_ms);
+    if (mode == 'o')
+        return pong (url);
+    return self_test ();
+}
@@ -0,0 +1,273 @@
+// Microbenchmark of LCM marshalling: the primitive array functions of
+// lcm_coretypes.h, and the generated C and C++ bindings of the test types.
+//
+// Each case is repeated until it has run for at least the minimum time, and
+// one CSV line is printed per case:
+//
+//   case,bytes,iterations,ns_per_op,ns_per_byte,allocs_per_op
+//
+// where bytes is the encoded size.  Decoding includes releasing the decoded
+// message, as a subscriber would, and the c_decode_arena cases decode into
+// an arena that is reset after each message.  Allocations are counted by interposing
+// malloc, and are reported as -1 where that is not supported.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include <lcm/lcm_coretypes.h>
+
+#include "../c/common.h"
+#include "../cpp/common.hpp"
+
+#ifdef __GLIBC__
+#define COUNT_ALLOCS
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static uint64_t g_num_allocs = 0;
+
+extern "C" void* malloc(size_t size) {
+    g_num_allocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t nmemb, size_t size) {
+    g_num_allocs++;
+    return __libc_calloc(nmemb, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    g_num_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+static double g_min_time = 0.2;
+static const char* g_filter = NULL;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Runs op until at least g_min_time has passed, and prints its cost.
+template <typename Op>
+static void run_case(const char* name, int bytes, Op op) {
+    if (g_filter && !strstr(name, g_filter)) {
+        return;
+    }
+    if (op() < 0) {
+        fprintf(stderr, "%s failed\n", name);
+        exit(1);
+    }
+
+    uint64_t iterations = 1;
+    double elapsed;
+    uint64_t allocs = 0;
+    while (1) {
+#ifdef COUNT_ALLOCS
+        uint64_t allocs_before = g_num_allocs;
+#endif
+        double start = now_sec();
+        for (uint64_t i = 0; i < iterations; i++) {
+            op();
+        }
+        elapsed = now_sec() - start;
+#ifdef COUNT_ALLOCS
+        allocs = g_num_allocs - allocs_before;
+#endif
+        if (elapsed >= g_min_time) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    double ns_per_op = elapsed * 1e9 / iterations;
+#ifdef COUNT_ALLOCS
+    double allocs_per_op = (double)allocs / iterations;
+#else
+    double allocs_per_op = -1;
+#endif
+    printf("%s,%d,%llu,%.1f,%.3f,%.2f\n", name, bytes,
+            (unsigned long long)iterations, ns_per_op,
+            bytes ? ns_per_op / bytes : 0.0, allocs_per_op);
+    fflush(stdout);
+}
+
+// Encodes and decodes an array of n elements of a primitive type.
+#define BENCH_PRIMITIVE(type, ctype, n)                                      \
+    do {                                                                     \
+        std::vector<ctype> src(n), dst(n);                                   \
+        for (int i = 0; i < n; i++) {                                        \
+            src[i] = (ctype)(i * 3);                                         \
+        }                                                                    \
+        int size = __##type##_encoded_array_size(&src[0], n);                \
+        std::vector<uint8_t> buf(size);                                      \
+        run_case("coretypes_encode_" #type, size, [&]() {                    \
+            return __##type##_encode_array(&buf[0], 0, size, &src[0], n);    \
+        });                                                                  \
+        run_case("coretypes_decode_" #type, size, [&]() {                    \
+            return __##type##_decode_array(&buf[0], 0, size, &dst[0], n);    \
+        });                                                                  \
+    } while (0)
+
+static void bench_coretypes(int n) {
+    BENCH_PRIMITIVE(byte, uint8_t, n);
+    BENCH_PRIMITIVE(int8_t, int8_t, n);
+    BENCH_PRIMITIVE(int16_t, int16_t, n);
+    BENCH_PRIMITIVE(int32_t, int32_t, n);
+    BENCH_PRIMITIVE(int64_t, int64_t, n);
+    BENCH_PRIMITIVE(float, float, n);
+    BENCH_PRIMITIVE(double, double, n);
+
+    // strings are decoded into buffers of their own
+    int num_strings = n / 16 > 0 ? n / 16 : 1;
+    std::vector<char*> src(num_strings), dst(num_strings);
+    for (int i = 0; i < num_strings; i++) {
+        src[i] = (char*)"the quick brown fox jumps over";
+    }
+    int size = __string_encoded_array_size(&src[0], num_strings);
+    std::vector<uint8_t> buf(size);
+    run_case("coretypes_encode_string", size, [&]() {
+        return __string_encode_array(&buf[0], 0, size, &src[0], num_strings);
+    });
+    run_case("coretypes_decode_string", size, [&]() {
+        int status =
+            __string_decode_array(&buf[0], 0, size, &dst[0], num_strings);
+        __string_decode_array_cleanup(&dst[0], num_strings);
+        return status;
+    });
+}
+
+// Encodes and decodes a message with the generated C functions.
+#define BENCH_C_TYPE(type, label, fill_arg)                                  \
+    do {                                                                     \
+        type msg;                                                            \
+        fill_##type(fill_arg, &msg);                                         \
+        int size = type##_encoded_size(&msg);                                \
+        std::vector<uint8_t> buf(size);                                      \
+        type##_encode(&buf[0], 0, size, &msg);                               \
+        run_case("c_encode_" label, size, [&]() {                            \
+            return type##_encode(&buf[0], 0, size, &msg);                    \
+        });                                                                  \
+        run_case("c_decode_" label, size, [&]() {                            \
+            type decoded;                                                    \
+            int status = type##_decode(&buf[0], 0, size, &decoded);          \
+            type##_decode_cleanup(&decoded);                                 \
+            return status;                                                   \
+        });                                                                  \
+        lcm_arena_t arena = LCM_ARENA_INITIALIZER;                           \
+        run_case("c_decode_arena_" label, size, [&]() {                      \
+            type decoded;                                                    \
+            int status =                                                     \
+                type##_decode_arena(&buf[0], 0, size, &decoded, &arena);     \
+            lcm_arena_reset(&arena);                                         \
+            return status;                                                   \
+        });                                                                  \
+        lcm_arena_free(&arena);                                              \
+        clear_##type(&msg);                                                  \
+    } while (0)
+
+static void bench_c_types() {
+    BENCH_C_TYPE(lcmtest_primitives_t, "primitives_t", 100);
+    BENCH_C_TYPE(lcmtest_primitives_list_t, "primitives_list_t", 100);
+    BENCH_C_TYPE(lcmtest_node_t, "node_t", 5);
+    BENCH_C_TYPE(lcmtest_multidim_array_t, "multidim_array_t", 10);
+}
+
+// Encodes and decodes a message with the generated C++ classes.
+template <typename T>
+static void bench_cpp_type(const char* label, int fill_arg) {
+    T msg;
+    FillLcmType(fill_arg, &msg);
+    int size = msg.getEncodedSize();
+    std::vector<uint8_t> buf(size);
+    msg.encode(&buf[0], 0, size);
+    char name[128];
+    snprintf(name, sizeof(name), "cpp_encode_%s", label);
+    run_case(name, size, [&]() { return msg.encode(&buf[0], 0, size); });
+    snprintf(name, sizeof(name), "cpp_decode_%s", label);
+    run_case(name, size, [&]() {
+        T decoded;
+        return decoded.decode(&buf[0], 0, size);
+    });
+}
+
+static void bench_cpp_types() {
+    bench_cpp_type<lcmtest::primitives_t>("primitives_t", 100);
+    bench_cpp_type<lcmtest::primitives_list_t>("primitives_list_t", 100);
+    bench_cpp_type<lcmtest::node_t>("node_t", 5);
+    bench_cpp_type<lcmtest::multidim_array_t>("multidim_array_t", 10);
+}
+
+static void usage(const char* cmd) {
+    fprintf(stderr,
+            "Usage: %s [OPTION...]\n"
+            "  Measures the cost of encoding and decoding LCM types.\n"
+            "\n"
+            "Options:\n"
+            "  -n, --elements=N    Elements per primitive array (default "
+            "4096).\n"
+            "  -t, --time=SEC      Minimum time per case (default 0.2).\n"
+            "  -f, --filter=TEXT   Only run the cases whose name contains "
+            "TEXT.\n"
+            "  -h, --help          Shows this help text and exits.\n",
+            cmd);
+}
+
+int main(int argc, char** argv) {
+    int elements = 4096;
+    struct option long_opts[] = {
+        {"elements", required_argument, 0, 'n'},
+        {"time", required_argument, 0, 't'},
+        {"filter", required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "n:t:f:h", long_opts, 0)) >= 0) {
+        switch (c) {
+            case 'n':
+                elements = atoi(optarg);
+                if (elements <= 0) {
+                    fprintf(stderr, "Invalid --elements \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                g_min_time = strtod(optarg, NULL);
+                if (g_min_time <= 0) {
+                    fprintf(stderr, "Invalid --time \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                g_filter = optarg;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    printf("case,bytes,iterations,ns_per_op,ns_per_byte,allocs_per_op\n");
+    bench_coretypes(elements);
+    bench_c_types();
+    bench_cpp_types();
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Microbenchmark of the dispatch path of an LCM instance, as the number of
+// subscriptions and channels grows.  The memq provider does nothing but the
+// work of lcm.c: lcm_publish() asks lcm_has_handlers() whether to queue a
+// message, and lcm_handle_batch() takes each queued message through
+// lcm_try_enqueue_message() and lcm_dispatch_handlers().
+//
+// Each case sets up N subscriptions, from 1 to --max by factors of 10, and
+// one CSV line is printed per case and N:
+//
+//   case,subscriptions,channels,messages,publish_ns,dispatch_ns,
+//   subscribe_ns,unsubscribe_ns
+//
+// where publish_ns and dispatch_ns are per message, over the channels taken
+// in turn, and subscribe_ns and unsubscribe_ns are the mean cost of adding
+// and removing one of the N subscriptions.  The cases are
+//
+//   literal  N subscriptions to N channels, one each
+//   regex    N regular expression subscriptions, each matching one of N
+//            channels
+//   miss     N literal subscriptions, and messages on N other channels
+//   fanout   N literal subscriptions to the one channel published on
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+// messages published before they are handled, at most
+#define BATCH_SIZE 256
+
+static double g_min_time = 0.2;
+static const char* g_filter = NULL;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void count_message(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user) {
+    (*(int64_t*)user)++;
+}
+
+struct Case {
+    const char* name;
+    // the subscriptions of the case, and the channels published on
+    std::vector<std::string> patterns;
+    std::vector<std::string> channels;
+    // messages dispatched per message published
+    int64_t deliveries;
+};
+
+static Case make_case(const char* name, int n) {
+    Case c;
+    c.name = name;
+    c.deliveries = 1;
+    char buf[64];
+    for (int i = 0; i < n; i++) {
+        if (!strcmp(name, "regex")) {
+            snprintf(buf, sizeof(buf), "BENCH_%d_.*", i);
+            c.patterns.push_back(buf);
+            snprintf(buf, sizeof(buf), "BENCH_%d_REGEX", i);
+            c.channels.push_back(buf);
+        } else if (!strcmp(name, "fanout")) {
+            c.patterns.push_back("BENCH_FANOUT");
+        } else {
+            snprintf(buf, sizeof(buf), "BENCH_%d", i);
+            c.patterns.push_back(buf);
+            snprintf(buf, sizeof(buf), "%s_%d",
+                    !strcmp(name, "miss") ? "OTHER" : "BENCH", i);
+            c.channels.push_back(buf);
+        }
+    }
+    if (!strcmp(name, "fanout")) {
+        c.channels.push_back("BENCH_FANOUT");
+        c.deliveries = n;
+    } else if (!strcmp(name, "miss")) {
+        c.deliveries = 0;
+    }
+    return c;
+}
+
+// Returns 0 on success, and -1 if the messages were not all delivered.
+static int run_case(const char* name, int n) {
+    if (g_filter && !strstr(name, g_filter)) {
+        return 0;
+    }
+    Case c = make_case(name, n);
+    lcm_t* lcm = lcm_create("memq://");
+    if (!lcm) {
+        fprintf(stderr, "Unable to create memq://\n");
+        return -1;
+    }
+
+    int64_t count = 0;
+    std::vector<lcm_subscription_t*> subs(n);
+    double start = now_sec();
+    for (int i = 0; i < n; i++) {
+        subs[i] = lcm_subscribe(lcm, c.patterns[i].c_str(), count_message,
+                &count);
+    }
+    double subscribe_ns = (now_sec() - start) * 1e9 / n;
+
+    // each round publishes on every channel once, in batches.  The first
+    // round, in which lcm.c sees the channels for the first time, is not
+    // timed.
+    uint8_t data[64] = { 0 };
+    int num_channels = (int)c.channels.size();
+    double publish_time = 0, dispatch_time = 0;
+    int64_t messages = 0;
+    for (int round = 0; publish_time + dispatch_time < g_min_time;
+            round++) {
+        for (int first = 0; first < num_channels; first += BATCH_SIZE) {
+            int num = num_channels - first < BATCH_SIZE ?
+                num_channels - first : BATCH_SIZE;
+            double t0 = now_sec();
+            for (int i = first; i < first + num; i++) {
+                lcm_publish(lcm, c.channels[i].c_str(), data, sizeof(data));
+            }
+            double t1 = now_sec();
+            while (lcm_handle_batch(lcm, BATCH_SIZE, 0) > 0) {
+            }
+            double t2 = now_sec();
+            if (round > 0) {
+                publish_time += t1 - t0;
+                dispatch_time += t2 - t1;
+                messages += num;
+            }
+        }
+    }
+    int64_t expected = (messages + num_channels) * c.deliveries;
+
+    start = now_sec();
+    for (int i = 0; i < n; i++) {
+        lcm_unsubscribe(lcm, subs[i]);
+    }
+    double unsubscribe_ns = (now_sec() - start) * 1e9 / n;
+    lcm_destroy(lcm);
+
+    printf("%s,%d,%d,%lld,%.1f,%.1f,%.1f,%.1f\n", name, n, num_channels,
+            (long long)messages, publish_time * 1e9 / messages,
+            dispatch_time * 1e9 / messages, subscribe_ns, unsubscribe_ns);
+    fflush(stdout);
+    if (count != expected) {
+        fprintf(stderr, "%s: %lld messages dispatched, expected %lld\n",
+                name, (long long)count, (long long)expected);
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char* cmd) {
+    fprintf(stderr,
+            "Usage: %s [OPTION...]\n"
+            "  Measures the cost of dispatching messages and of subscribing "
+            "as the\n"
+            "  number of subscriptions grows.\n"
+            "\n"
+            "Options:\n"
+            "  -n, --max=N         Most subscriptions per case (default "
+            "10000).\n"
+            "  -t, --time=SEC      Minimum time per case (default 0.2).\n"
+            "  -f, --filter=TEXT   Only run the cases whose name contains "
+            "TEXT.\n"
+            "  -h, --help          Shows this help text and exits.\n",
+            cmd);
+}
+
+int main(int argc, char** argv) {
+    int max_subs = 10000;
+    struct option long_opts[] = {
+        {"max", required_argument, 0, 'n'},
+        {"time", required_argument, 0, 't'},
+        {"filter", required_argument, 0, 'f'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "n:t:f:h", long_opts, 0)) >= 0) {
+        switch (c) {
+            case 'n':
+                max_subs = atoi(optarg);
+                if (max_subs <= 0) {
+                    fprintf(stderr, "Invalid --max \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 't':
+                g_min_time = strtod(optarg, NULL);
+                if (g_min_time <= 0) {
+                    fprintf(stderr, "Invalid --time \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                g_filter = optarg;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    printf("case,subscriptions,channels,messages,publish_ns,dispatch_ns,"
+            "subscribe_ns,unsubscribe_ns\n");
+    const char* cases[] = { "literal", "regex", "miss", "fanout" };
+    int status = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int n = 1; n <= max_subs; n *= 10) {
+            if (run_case(cases[i], n) < 0) {
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
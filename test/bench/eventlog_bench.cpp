@@ -0,0 +1,493 @@
+// Benchmark of LCM log file I/O.  A synthetic log is written with event
+// sizes drawn from a configurable distribution, and then read back in the
+// ways that the log tools do.  One CSV line is printed per case:
+//
+//   case,events,mbytes,seconds,events_per_sec,mb_per_sec,usec_per_op
+//
+// where mbytes is the size of the log file that the case went through, and
+// usec_per_op is the time per event, or per seek for the seek cases.  The
+// logs are read back right after they are written, so reads come from the
+// page cache rather than the disk.
+//
+// With --require, the benchmark fails if a result misses its threshold, e.g.
+//
+//   bench-eventlog --require=read.mb_per_sec>=500,seek.usec_per_op<=100
+//
+// which is how performance CI jobs use it; see LCM_ENABLE_PERF_TESTS.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+#include "../c/common.h"
+
+#define NUM_CHANNELS 4
+#define EVENT_USEC 1000
+
+struct SizeClass {
+    int size;
+    int weight;
+};
+
+struct Result {
+    std::string name;
+    int64_t events;
+    int64_t bytes;
+    double seconds;
+    int64_t ops;
+};
+
+static std::vector<Result> g_results;
+
+static double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int64_t file_size(const char* path) {
+    struct stat st;
+    if (0 != stat(path, &st)) {
+        return 0;
+    }
+    return st.st_size;
+}
+
+// xorshift64*, so that runs are reproducible across platforms
+static uint64_t g_rand_state = 0x9E3779B97F4A7C15ULL;
+static uint64_t next_rand() {
+    g_rand_state ^= g_rand_state >> 12;
+    g_rand_state ^= g_rand_state << 25;
+    g_rand_state ^= g_rand_state >> 27;
+    return g_rand_state * 2685821657736338717ULL;
+}
+
+// Parses SIZE:WEIGHT[,SIZE:WEIGHT...]
+static int parse_sizes(const char* str, std::vector<SizeClass>* sizes) {
+    sizes->clear();
+    const char* p = str;
+    while (*p) {
+        char* end;
+        SizeClass sc;
+        sc.size = strtol(p, &end, 10);
+        if (end == p || sc.size < 0) {
+            return -1;
+        }
+        sc.weight = 1;
+        p = end;
+        if (*p == ':') {
+            sc.weight = strtol(p + 1, &end, 10);
+            if (end == p + 1 || sc.weight <= 0) {
+                return -1;
+            }
+            p = end;
+        }
+        sizes->push_back(sc);
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return sizes->empty() ? -1 : 0;
+}
+
+static void report(const char* name, int64_t events, int64_t bytes,
+        double seconds, int64_t ops) {
+    Result r;
+    r.name = name;
+    r.events = events;
+    r.bytes = bytes;
+    r.seconds = seconds;
+    r.ops = ops;
+    g_results.push_back(r);
+    printf("%s,%lld,%.2f,%.4f,%.0f,%.1f,%.3f\n", name, (long long)events,
+            bytes / 1e6, seconds, events / seconds, bytes / 1e6 / seconds,
+            ops ? seconds * 1e6 / ops : 0.0);
+    fflush(stdout);
+}
+
+static int bench_write(const char* name, const char* path, int64_t num_events,
+        const std::vector<SizeClass>& sizes, int flags) {
+    int total_weight = 0;
+    int max_size = 0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        total_weight += sizes[i].weight;
+        if (sizes[i].size > max_size) {
+            max_size = sizes[i].size;
+        }
+    }
+    std::vector<uint8_t> data(max_size + 1);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (uint8_t)i;
+    }
+    char channels[NUM_CHANNELS][32];
+    for (int i = 0; i < NUM_CHANNELS; i++) {
+        snprintf(channels[i], sizeof(channels[i]), "BENCH_%d", i);
+    }
+
+    g_rand_state = 0x9E3779B97F4A7C15ULL;
+    double start = now_sec();
+    lcm_eventlog_t* log = lcm_eventlog_create(path, "w");
+    if (!log) {
+        fprintf(stderr, "Unable to create %s\n", path);
+        return -1;
+    }
+#ifndef WIN32
+    if (flags) {
+        lcm_eventlog_set_write_flags(log, flags);
+    }
+#endif
+    for (int64_t n = 0; n < num_events; n++) {
+        int pick = next_rand() % total_weight;
+        size_t k = 0;
+        while (pick >= sizes[k].weight) {
+            pick -= sizes[k].weight;
+            k++;
+        }
+        lcm_eventlog_event_t event;
+        event.eventnum = n;
+        event.timestamp = n * EVENT_USEC;
+        event.channel = channels[n % NUM_CHANNELS];
+        event.channellen = strlen(event.channel);
+        event.datalen = sizes[k].size;
+        event.data = &data[0];
+        if (0 != lcm_eventlog_write_event(log, &event)) {
+            fprintf(stderr, "Unable to write %s\n", path);
+            lcm_eventlog_destroy(log);
+            return -1;
+        }
+    }
+    lcm_eventlog_flush(log);
+    lcm_eventlog_destroy(log);
+    report(name, num_events, file_size(path), now_sec() - start, num_events);
+    return 0;
+}
+
+static int bench_read(const char* path) {
+    double start = now_sec();
+    lcm_eventlog_t* log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        return -1;
+    }
+    int64_t events = 0;
+    lcm_eventlog_event_t* event;
+    while ((event = lcm_eventlog_read_next_event(log))) {
+        events++;
+        lcm_eventlog_free_event(event);
+    }
+    lcm_eventlog_destroy(log);
+    report("read", events, file_size(path), now_sec() - start, events);
+
+    // reusing the event buffers, as lcm-logmerge does
+    start = now_sec();
+    log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        return -1;
+    }
+    lcm_eventlog_event_t reused;
+    memset(&reused, 0, sizeof(reused));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    events = 0;
+    while (0 == lcm_eventlog_read_next_event_into(log, &reused,
+                    &channel_capacity, &data_capacity)) {
+        events++;
+    }
+    free(reused.channel);
+    free(reused.data);
+    lcm_eventlog_destroy(log);
+    report("read_into", events, file_size(path), now_sec() - start, events);
+    return 0;
+}
+
+static int bench_filtered(const char* path) {
+    double start = now_sec();
+    lcm_eventlog_t* log = lcm_eventlog_create_filtered(path, "BENCH_0");
+    if (!log) {
+        return -1;
+    }
+    int64_t events = 0;
+    lcm_eventlog_event_t* event;
+    while ((event = lcm_eventlog_read_next_event(log))) {
+        events++;
+        lcm_eventlog_free_event(event);
+    }
+    lcm_eventlog_destroy(log);
+    report("filtered", events, file_size(path), now_sec() - start, events);
+    return 0;
+}
+
+static int bench_seek(const char* name, const char* path, int64_t num_events,
+        int num_seeks) {
+    lcm_eventlog_t* log = lcm_eventlog_create(path, "r");
+    if (!log) {
+        return -1;
+    }
+    g_rand_state = 0x2545F4914F6CDD1DULL;
+    double start = now_sec();
+    for (int i = 0; i < num_seeks; i++) {
+        int64_t ts = (next_rand() % num_events) * EVENT_USEC;
+        lcm_eventlog_event_t* event = NULL;
+        if (0 == lcm_eventlog_seek_to_timestamp(log, ts)) {
+            event = lcm_eventlog_read_next_event(log);
+        }
+        if (!event) {
+            fprintf(stderr, "Seek to %lld failed\n", (long long)ts);
+            lcm_eventlog_destroy(log);
+            return -1;
+        }
+        lcm_eventlog_free_event(event);
+    }
+    double seconds = now_sec() - start;
+    lcm_eventlog_destroy(log);
+    report(name, num_seeks, 0, seconds, num_seeks);
+    return 0;
+}
+
+// Times lcm-logger recording the log, played back as fast as possible with
+// the file provider.
+static int bench_logger(const char* logger, const char* src, const char* dst,
+        int64_t num_events) {
+    std::string url = std::string("--lcm-url=file://") + src + "?mode=afap";
+    double start = now_sec();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        execl(logger, logger, "-q", "-f", "--no-index", url.c_str(), dst,
+                (char*)NULL);
+        perror("exec");
+        _exit(127);
+    }
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", logger);
+        return -1;
+    }
+    double seconds = now_sec() - start;
+
+    lcm_eventlog_t* log = lcm_eventlog_create(dst, "r");
+    if (!log) {
+        return -1;
+    }
+    int64_t events = 0;
+    lcm_eventlog_event_t* event;
+    while ((event = lcm_eventlog_read_next_event(log))) {
+        events++;
+        lcm_eventlog_free_event(event);
+    }
+    lcm_eventlog_destroy(log);
+    if (events < num_events) {
+        fprintf(stderr, "lcm-logger dropped %lld of %lld events\n",
+                (long long)(num_events - events), (long long)num_events);
+    }
+    report("logger", events, file_size(dst), seconds, events);
+    return 0;
+}
+
+static const Result* find_result(const std::string& name) {
+    for (size_t i = 0; i < g_results.size(); i++) {
+        if (g_results[i].name == name) {
+            return &g_results[i];
+        }
+    }
+    return NULL;
+}
+
+static int result_value(const std::string& metric, double* value) {
+    size_t dot = metric.find('.');
+    if (dot == std::string::npos) {
+        return -1;
+    }
+    const Result* r = find_result(metric.substr(0, dot));
+    if (!r) {
+        return -1;
+    }
+    std::string column = metric.substr(dot + 1);
+    if (column == "events_per_sec") {
+        *value = r->events / r->seconds;
+    } else if (column == "mb_per_sec") {
+        *value = r->bytes / 1e6 / r->seconds;
+    } else if (column == "usec_per_op" && r->ops) {
+        *value = r->seconds * 1e6 / r->ops;
+    } else if (column == "seconds") {
+        *value = r->seconds;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+// Checks CASE.COLUMN>=VALUE or CASE.COLUMN<=VALUE, comma separated.
+// Returns the number of thresholds missed, or -1 if one can't be parsed.
+static int check_requirements(const char* requirements) {
+    int failed = 0;
+    std::string all = requirements;
+    size_t pos = 0;
+    while (pos < all.size()) {
+        size_t comma = all.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = all.size();
+        }
+        std::string req = all.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t op = req.find(">=");
+        int at_least = 1;
+        if (op == std::string::npos) {
+            op = req.find("<=");
+            at_least = 0;
+        }
+        double value;
+        if (op == std::string::npos ||
+                0 != result_value(req.substr(0, op), &value)) {
+            fprintf(stderr, "Invalid requirement \"%s\"\n", req.c_str());
+            return -1;
+        }
+        char* end;
+        const char* limit_str = req.c_str() + op + 2;
+        double limit = strtod(limit_str, &end);
+        if (end == limit_str || *end) {
+            fprintf(stderr, "Invalid requirement \"%s\"\n", req.c_str());
+            return -1;
+        }
+        if (at_least ? value < limit : value > limit) {
+            fprintf(stderr, "FAILED: %s, measured %g\n", req.c_str(), value);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+static void usage(const char* cmd) {
+    fprintf(stderr,
+            "Usage: %s [OPTION...]\n"
+            "  Measures how fast LCM log files are written and read.\n"
+            "\n"
+            "Options:\n"
+            "  -n, --events=N         Events in the synthetic log (default "
+            "100000).\n"
+            "  -s, --sizes=DIST       Event sizes, as SIZE:WEIGHT[,...] "
+            "(default\n"
+            "                         64:60,1024:30,65536:10).\n"
+            "  -k, --seeks=N          Seeks per seek case (default 1000).\n"
+            "  -L, --logger=PATH      Also time the lcm-logger at PATH.\n"
+            "  -r, --require=LIST     Fail unless each CASE.COLUMN>=VALUE "
+            "or\n"
+            "                         CASE.COLUMN<=VALUE of LIST holds.\n"
+            "  -h, --help             Shows this help text and exits.\n",
+            cmd);
+}
+
+int main(int argc, char** argv) {
+    int64_t num_events = 100000;
+    int num_seeks = 1000;
+    const char* logger = NULL;
+    const char* requirements = NULL;
+    std::vector<SizeClass> sizes;
+    parse_sizes("64:60,1024:30,65536:10", &sizes);
+
+    struct option long_opts[] = {
+        {"events", required_argument, 0, 'n'},
+        {"sizes", required_argument, 0, 's'},
+        {"seeks", required_argument, 0, 'k'},
+        {"logger", required_argument, 0, 'L'},
+        {"require", required_argument, 0, 'r'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:k:L:r:h", long_opts, 0)) >= 0) {
+        switch (c) {
+            case 'n':
+                num_events = strtoll(optarg, NULL, 10);
+                if (num_events <= 0) {
+                    fprintf(stderr, "Invalid --events \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 's':
+                if (0 != parse_sizes(optarg, &sizes)) {
+                    fprintf(stderr, "Invalid --sizes \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'k':
+                num_seeks = atoi(optarg);
+                if (num_seeks <= 0) {
+                    fprintf(stderr, "Invalid --seeks \"%s\"\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'L':
+                logger = optarg;
+                break;
+            case 'r':
+                requirements = optarg;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    std::string path = make_tmpnam();
+    std::string index_path = path + LCM_EVENTLOG_INDEX_SUFFIX;
+    std::string logger_path = path + ".logger";
+
+    printf("case,events,mbytes,seconds,events_per_sec,mb_per_sec,"
+            "usec_per_op\n");
+    int status = 0;
+#ifndef WIN32
+    status = bench_write("write_writev", path.c_str(), num_events, sizes,
+            LCM_EVENTLOG_WRITEV);
+#endif
+    if (status == 0) {
+        status = bench_write("write", path.c_str(), num_events, sizes, 0);
+    }
+    if (status == 0) {
+        status = bench_read(path.c_str());
+    }
+    if (status == 0) {
+        status = bench_filtered(path.c_str());
+    }
+    if (status == 0) {
+        status = bench_seek("seek", path.c_str(), num_events, num_seeks);
+    }
+    if (status == 0) {
+        status = lcm_eventlog_build_index(path.c_str());
+    }
+    if (status == 0) {
+        status = bench_seek("seek_indexed", path.c_str(), num_events,
+                num_seeks);
+    }
+    if (status == 0 && logger) {
+        status = bench_logger(logger, path.c_str(), logger_path.c_str(),
+                num_events);
+    }
+
+    unlink(path.c_str());
+    unlink(index_path.c_str());
+    unlink(logger_path.c_str());
+    if (status != 0) {
+        return 1;
+    }
+    if (requirements && 0 != check_requirements(requirements)) {
+        return 1;
+    }
+    return 0;
+}
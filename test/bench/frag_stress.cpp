@@ -0,0 +1,316 @@
+// Stress test of the reassembly of fragmented messages by the udpm and
+// mpudpm providers.  Several senders, each an LCM instance with a socket of
+// its own, publish large messages at the same time, so that their fragments
+// interleave at the receiver, while the drop_rate, dup_rate and reorder_rate
+// provider options damage their datagrams.  Each loss rate is run in turn,
+// and one CSV line is printed per run:
+//
+//   provider,drop_rate,dup_rate,reorder_rate,senders,fragments,sent,
+//   delivered,delivered_pct,expected_pct,corrupt,repeated,incomplete,
+//   frag_high_water_kb,maxrss_kb
+//
+// where expected_pct is the share of messages whose fragments would all
+// survive the loss rate, corrupt counts delivered messages whose contents
+// are wrong and repeated those delivered more than once.  The test fails if
+// any message is corrupt.
+
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+#define CHANNEL "FRAG_STRESS"
+#define HEADER_SIZE 8
+
+struct Options {
+    int num_senders;
+    int msgs_per_sender;
+    int msg_size;
+    int mtu;
+    double max_rate_mbps;
+    double dup_rate;
+    double reorder_rate;
+};
+
+struct Sender {
+    lcm_t* lcm;
+    uint32_t id;
+    const Options* opts;
+};
+
+struct Receiver {
+    int msg_size;
+    int num_senders;
+    int msgs_per_sender;
+    std::vector<uint8_t> seen;
+    int64_t delivered;
+    int64_t corrupt;
+    int64_t repeated;
+};
+
+static uint8_t pattern(uint32_t sender, uint32_t seq, int i) {
+    return (uint8_t)(sender * 31 + seq * 7 + i);
+}
+
+static void* publish_thread(void* user) {
+    Sender* s = (Sender*)user;
+    std::vector<uint8_t> data(s->opts->msg_size);
+    for (int seq = 0; seq < s->opts->msgs_per_sender; seq++) {
+        memcpy(&data[0], &s->id, 4);
+        memcpy(&data[4], &seq, 4);
+        for (int i = HEADER_SIZE; i < s->opts->msg_size; i++) {
+            data[i] = pattern(s->id, seq, i);
+        }
+        lcm_publish(s->lcm, CHANNEL, &data[0], s->opts->msg_size);
+    }
+    return NULL;
+}
+
+static void on_message(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user) {
+    Receiver* r = (Receiver*)user;
+    const uint8_t* data = (const uint8_t*)rbuf->data;
+    uint32_t sender, seq;
+    if ((int)rbuf->data_size != r->msg_size) {
+        r->corrupt++;
+        return;
+    }
+    memcpy(&sender, data, 4);
+    memcpy(&seq, data + 4, 4);
+    if ((int)sender >= r->num_senders || (int)seq >= r->msgs_per_sender) {
+        r->corrupt++;
+        return;
+    }
+    for (int i = HEADER_SIZE; i < r->msg_size; i++) {
+        if (data[i] != pattern(sender, seq, i)) {
+            r->corrupt++;
+            return;
+        }
+    }
+    uint8_t* seen = &r->seen[sender * r->msgs_per_sender + seq];
+    if (*seen) {
+        r->repeated++;
+        return;
+    }
+    *seen = 1;
+    r->delivered++;
+}
+
+static std::string make_url(const char* provider, int port,
+        const Options& opts, const char* extra) {
+    char url[512];
+    snprintf(url, sizeof(url),
+            "%s://239.255.76.67:%d?ttl=0&self_test=off&mtu=%d%s%s", provider,
+            port, opts.mtu, !strcmp(provider, "udpm") ? "&channel_filter=0" :
+            "&nports=4", extra);
+    return url;
+}
+
+// Returns 0 if no message was corrupt, 1 if one was, and -1 on errors.
+static int run(const char* provider, int port, double drop_rate,
+        const Options& opts) {
+    std::string rx_url = make_url(provider, port, opts,
+            "&recv_buf_size=4000000");
+    lcm_t* rx = lcm_create(rx_url.c_str());
+    if (!rx) {
+        fprintf(stderr, "Unable to create %s\n", rx_url.c_str());
+        return -1;
+    }
+    Receiver r;
+    r.msg_size = opts.msg_size;
+    r.num_senders = opts.num_senders;
+    r.msgs_per_sender = opts.msgs_per_sender;
+    r.seen.assign(opts.num_senders * opts.msgs_per_sender, 0);
+    r.delivered = r.corrupt = r.repeated = 0;
+    lcm_subscription_t* subs = lcm_subscribe(rx, CHANNEL, on_message, &r);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    char faults[256];
+    snprintf(faults, sizeof(faults),
+            "&max_rate_mbps=%g&drop_rate=%g&dup_rate=%g&reorder_rate=%g",
+            opts.max_rate_mbps, drop_rate, opts.dup_rate, opts.reorder_rate);
+    std::vector<Sender> senders(opts.num_senders);
+    std::vector<pthread_t> threads(opts.num_senders);
+    for (int i = 0; i < opts.num_senders; i++) {
+        char extra[300];
+        snprintf(extra, sizeof(extra), "%s&fault_seed=%d", faults, i + 1);
+        std::string url = make_url(provider, port, opts, extra);
+        senders[i].lcm = lcm_create(url.c_str());
+        senders[i].id = i;
+        senders[i].opts = &opts;
+        if (!senders[i].lcm) {
+            fprintf(stderr, "Unable to create %s\n", url.c_str());
+            return -1;
+        }
+    }
+    // let the receive sockets join their groups
+    lcm_handle_timeout(rx, 200);
+    for (int i = 0; i < opts.num_senders; i++) {
+        pthread_create(&threads[i], NULL, publish_thread, &senders[i]);
+    }
+
+    // wait until all messages arrived, or nothing did for a while
+    int64_t total = (int64_t)opts.num_senders * opts.msgs_per_sender;
+    while (r.delivered < total && lcm_handle_timeout(rx, 500) > 0) {
+    }
+    for (int i = 0; i < opts.num_senders; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    while (r.delivered < total && lcm_handle_timeout(rx, 500) > 0) {
+    }
+
+    lcm_transport_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    lcm_get_transport_stats(rx, &stats);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    int fragment_payload = opts.mtu - 28 - 20;
+    int fragments = (opts.msg_size + (int)strlen(CHANNEL) + 1 +
+            fragment_payload - 1) / fragment_payload;
+    double expected = pow(1 - drop_rate, fragments);
+    printf("%s,%g,%g,%g,%d,%d,%lld,%lld,%.2f,%.2f,%lld,%lld,%lld,%.0f,%ld\n",
+            provider, drop_rate, opts.dup_rate, opts.reorder_rate,
+            opts.num_senders, fragments, (long long)total,
+            (long long)r.delivered, 100.0 * r.delivered / total,
+            100.0 * expected, (long long)r.corrupt, (long long)r.repeated,
+            (long long)stats.num_incomplete,
+            stats.frag_bytes_high_watermark / 1024.0, usage.ru_maxrss);
+    fflush(stdout);
+
+    for (int i = 0; i < opts.num_senders; i++) {
+        lcm_destroy(senders[i].lcm);
+    }
+    lcm_unsubscribe(rx, subs);
+    lcm_destroy(rx);
+    return r.corrupt ? 1 : 0;
+}
+
+static void usage(const char* cmd) {
+    fprintf(stderr,
+            "Usage: %s [OPTION...]\n"
+            "  Stress tests the reassembly of fragmented messages.\n"
+            "\n"
+            "Options:\n"
+            "  -u, --providers=LIST   udpm, mpudpm or both (default "
+            "udpm,mpudpm).\n"
+            "  -l, --loss=LIST        Drop rates to run (default\n"
+            "                         0,0.001,0.01,0.05).\n"
+            "  -D, --dup=P            Duplication rate (default 0.01).\n"
+            "  -R, --reorder=P        Reordering rate (default 0.01).\n"
+            "  -p, --senders=N        Senders publishing at once (default "
+            "4).\n"
+            "  -n, --messages=N       Messages per sender (default 100).\n"
+            "  -s, --size=BYTES       Message size (default 65536).\n"
+            "  -m, --mtu=BYTES        MTU of the datagrams (default 1500).\n"
+            "  -r, --rate=MBPS        Rate of each sender (default 100).\n"
+            "  -h, --help             Shows this help text and exits.\n",
+            cmd);
+}
+
+int main(int argc, char** argv) {
+    Options opts;
+    opts.num_senders = 4;
+    opts.msgs_per_sender = 100;
+    opts.msg_size = 65536;
+    opts.mtu = 1500;
+    opts.max_rate_mbps = 100;
+    opts.dup_rate = 0.01;
+    opts.reorder_rate = 0.01;
+    std::string providers = "udpm,mpudpm";
+    std::string losses = "0,0.001,0.01,0.05";
+
+    struct option long_opts[] = {
+        {"providers", required_argument, 0, 'u'},
+        {"loss", required_argument, 0, 'l'},
+        {"dup", required_argument, 0, 'D'},
+        {"reorder", required_argument, 0, 'R'},
+        {"senders", required_argument, 0, 'p'},
+        {"messages", required_argument, 0, 'n'},
+        {"size", required_argument, 0, 's'},
+        {"mtu", required_argument, 0, 'm'},
+        {"rate", required_argument, 0, 'r'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}};
+    int c;
+    while ((c = getopt_long(argc, argv, "u:l:D:R:p:n:s:m:r:h", long_opts,
+                    0)) >= 0) {
+        switch (c) {
+            case 'u':
+                providers = optarg;
+                break;
+            case 'l':
+                losses = optarg;
+                break;
+            case 'D':
+                opts.dup_rate = strtod(optarg, NULL);
+                break;
+            case 'R':
+                opts.reorder_rate = strtod(optarg, NULL);
+                break;
+            case 'p':
+                opts.num_senders = atoi(optarg);
+                break;
+            case 'n':
+                opts.msgs_per_sender = atoi(optarg);
+                break;
+            case 's':
+                opts.msg_size = atoi(optarg);
+                break;
+            case 'm':
+                opts.mtu = atoi(optarg);
+                break;
+            case 'r':
+                opts.max_rate_mbps = strtod(optarg, NULL);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (opts.num_senders <= 0 || opts.msgs_per_sender <= 0 ||
+            opts.msg_size < HEADER_SIZE || opts.mtu < 576) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("provider,drop_rate,dup_rate,reorder_rate,senders,fragments,sent,"
+            "delivered,delivered_pct,expected_pct,corrupt,repeated,"
+            "incomplete,frag_high_water_kb,maxrss_kb\n");
+    int status = 0;
+    // each run gets ports of its own, so that late datagrams of one run
+    // don't reach the next
+    int port = 7750;
+    size_t ppos = 0;
+    while (ppos < providers.size() && status >= 0) {
+        size_t pend = providers.find(',', ppos);
+        if (pend == std::string::npos) {
+            pend = providers.size();
+        }
+        std::string provider = providers.substr(ppos, pend - ppos);
+        ppos = pend + 1;
+
+        size_t lpos = 0;
+        while (lpos < losses.size() && status >= 0) {
+            char* end;
+            double drop_rate = strtod(losses.c_str() + lpos, &end);
+            lpos = end - losses.c_str() + 1;
+            int result = run(provider.c_str(), port, drop_rate, opts);
+            port += 8;
+            if (result != 0) {
+                status = result;
+            }
+        }
+    }
+    return status == 0 ? 0 : 1;
+}
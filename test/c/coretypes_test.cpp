@@ -0,0 +1,390 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include <lcm/lcm_coretypes.h>
+
+#include "common.h"
+#include "lcmtest_registry.h"
+#include "lcmtest2_registry.h"
+#include "lcmtest3_registry.h"
+
+// Checks the array functions of a primitive type against a byte at a time
+// big-endian encoding, for lengths around the size of a SIMD block and at
+// unaligned offsets.
+template <typename T, typename EncodeFn, typename DecodeFn>
+static void CheckBigEndianArrays(EncodeFn encode, DecodeFn decode) {
+    const int kMaxElements = 70;
+    std::vector<T> src(kMaxElements);
+    uint8_t* bytes = (uint8_t*)&src[0];
+    for (size_t i = 0; i < src.size() * sizeof(T); i++) {
+        bytes[i] = (uint8_t)(i * 37 + 11);
+    }
+
+    for (int elements = 0; elements <= kMaxElements; elements++) {
+        for (int offset = 0; offset < 4; offset++) {
+            const int size = elements * sizeof(T);
+            std::vector<uint8_t> expected(offset + size + 1);
+            for (int i = 0; i < elements; i++) {
+                uint64_t v = 0;
+                memcpy(&v, &src[i], sizeof(T));
+                for (size_t b = 0; b < sizeof(T); b++) {
+                    expected[offset + i * sizeof(T) + b] =
+                        (uint8_t)(v >> (8 * (sizeof(T) - 1 - b)));
+                }
+            }
+
+            std::vector<uint8_t> buf(offset + size + 1);
+            EXPECT_EQ(size, encode(&buf[0], offset, size, &src[0], elements));
+            EXPECT_EQ(expected, buf) << elements << " at " << offset;
+            if (elements) {
+                EXPECT_EQ(-1, encode(&buf[0], offset, size - 1, &src[0],
+                                     elements));
+            }
+
+            std::vector<T> dst(elements + 1, 0);
+            EXPECT_EQ(size, decode(&buf[0], offset, size, &dst[0], elements));
+            EXPECT_EQ(0, memcmp(&src[0], &dst[0], size))
+                << elements << " at " << offset;
+            EXPECT_EQ(0, dst[elements]);
+        }
+    }
+}
+
+TEST(LCM_C, CoretypesInt16Array) {
+    CheckBigEndianArrays<int16_t>(__int16_t_encode_array,
+                                  __int16_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesInt32Array) {
+    CheckBigEndianArrays<int32_t>(__int32_t_encode_array,
+                                  __int32_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesInt64Array) {
+    CheckBigEndianArrays<int64_t>(__int64_t_encode_array,
+                                  __int64_t_decode_array);
+}
+
+TEST(LCM_C, CoretypesFloatingPointArrays) {
+    float f[5] = { 1.5f, -2.25f, 0.0f, 3.0e38f, -1.0e-38f };
+    double d[5] = { 1.5, -2.25, 0.0, 1.0e300, -1.0e-300 };
+    uint8_t buf[40];
+
+    EXPECT_EQ(20, __float_encode_array(buf, 0, sizeof(buf), f, 5));
+    // 1.5f is 0x3fc00000
+    EXPECT_EQ(0x3f, buf[0]);
+    EXPECT_EQ(0xc0, buf[1]);
+    float f2[5];
+    EXPECT_EQ(20, __float_decode_array(buf, 0, sizeof(buf), f2, 5));
+    EXPECT_EQ(0, memcmp(f, f2, sizeof(f)));
+
+    EXPECT_EQ(40, __double_encode_array(buf, 0, sizeof(buf), d, 5));
+    // 1.5 is 0x3ff8000000000000
+    EXPECT_EQ(0x3f, buf[0]);
+    EXPECT_EQ(0xf8, buf[1]);
+    double d2[5];
+    EXPECT_EQ(40, __double_decode_array(buf, 0, sizeof(buf), d2, 5));
+    EXPECT_EQ(0, memcmp(d, d2, sizeof(d)));
+}
+
+TEST(LCM_C, CoretypesStringEncodeSized) {
+    const char* str = "hello";
+    char* cstr = (char*)str;
+    uint8_t expected[10], buf[10];
+    ASSERT_EQ(10, __string_encode_array(expected, 0, sizeof(expected), &cstr, 1));
+    EXPECT_EQ(10, __string_encode_sized(buf, 0, sizeof(buf), str, 5));
+    EXPECT_EQ(0, memcmp(expected, buf, sizeof(buf)));
+
+    EXPECT_GT(0, __string_encode_sized(buf, 0, 9, str, 5));
+    EXPECT_GT(0, __string_encode_sized(buf, 0, -1, str, 5));
+    EXPECT_EQ(5, __string_encode_sized(buf, 0, 5, "", 0));
+}
+
+TEST(LCM_C, CoretypesArena) {
+    lcm_arena_t arena = LCM_ARENA_INITIALIZER;
+    EXPECT_TRUE(lcm_arena_alloc(&arena, 0) == NULL);
+
+    // allocations are aligned, and don't overlap
+    uint8_t* a = (uint8_t*)lcm_arena_alloc(&arena, 3);
+    uint8_t* b = (uint8_t*)lcm_arena_alloc(&arena, 8);
+    ASSERT_TRUE(a != NULL && b != NULL);
+    EXPECT_EQ(0u, (uintptr_t)a % 16);
+    EXPECT_EQ(0u, (uintptr_t)b % 16);
+    EXPECT_GE(b - a, 3);
+
+    // larger than a block
+    uint8_t* big = (uint8_t*)lcm_arena_alloc(&arena, 100000);
+    ASSERT_TRUE(big != NULL);
+    memset(big, 1, 100000);
+
+    // a reset keeps the largest block, which then fits the same again
+    lcm_arena_reset(&arena);
+    ASSERT_TRUE(arena.blocks != NULL);
+    EXPECT_TRUE(arena.blocks->next == NULL);
+    lcm_arena_block_t* block = arena.blocks;
+    EXPECT_TRUE(lcm_arena_alloc(&arena, 100000) != NULL);
+    EXPECT_EQ(block, arena.blocks);
+
+    lcm_arena_free(&arena);
+    EXPECT_TRUE(arena.blocks == NULL);
+}
+
+TEST(LCM_C, CoretypesDecodeArena) {
+    lcmtest_node_t node;
+    fill_lcmtest_node_t(4, &node);
+    lcmtest_primitives_list_t list;
+    fill_lcmtest_primitives_list_t(20, &list);
+
+    std::vector<uint8_t> node_buf(lcmtest_node_t_encoded_size(&node));
+    int node_size = (int)node_buf.size();
+    ASSERT_EQ(node_size, lcmtest_node_t_encode(&node_buf[0], 0, node_size,
+                                               &node));
+    std::vector<uint8_t> list_buf(
+        lcmtest_primitives_list_t_encoded_size(&list));
+    int list_size = (int)list_buf.size();
+    ASSERT_EQ(list_size, lcmtest_primitives_list_t_encode(&list_buf[0], 0,
+                                                          list_size, &list));
+
+    lcm_arena_t arena;
+    lcm_arena_init(&arena);
+    for (int i = 0; i < 3; i++) {
+        lcmtest_node_t decoded_node;
+        EXPECT_EQ(node_size, lcmtest_node_t_decode_arena(
+                                 &node_buf[0], 0, node_size, &decoded_node,
+                                 &arena));
+        EXPECT_TRUE(check_lcmtest_node_t(&decoded_node, 4));
+
+        lcmtest_primitives_list_t decoded_list;
+        EXPECT_EQ(list_size, lcmtest_primitives_list_t_decode_arena(
+                                 &list_buf[0], 0, list_size, &decoded_list,
+                                 &arena));
+        EXPECT_TRUE(check_lcmtest_primitives_list_t(&decoded_list, 20));
+        lcm_arena_reset(&arena);
+    }
+
+    // a truncated message fails without leaking
+    lcmtest_primitives_list_t truncated;
+    EXPECT_GT(0, lcmtest_primitives_list_t_decode_arena(
+                     &list_buf[0], 0, list_size - 1, &truncated, &arena));
+    lcm_arena_free(&arena);
+
+    clear_lcmtest_node_t(&node);
+    clear_lcmtest_primitives_list_t(&list);
+}
+
+TEST(LCM_C, CoretypesViewPrimitives) {
+    lcmtest2_cross_package_t msg;
+    fill_lcmtest2_cross_package_t(12, &msg);
+    std::vector<uint8_t> buf(lcmtest2_cross_package_t_encoded_size(&msg));
+    int size = (int)buf.size();
+    ASSERT_EQ(size,
+              lcmtest2_cross_package_t_encode(&buf[0], 0, size, &msg));
+
+    lcmtest2_cross_package_t_view view;
+    ASSERT_EQ(size, lcmtest2_cross_package_t_view_init(&view, &buf[0], 0,
+                                                       size));
+    lcmtest_primitives_t_view prims;
+    ASSERT_LT(0, lcmtest2_cross_package_t_view_get_primitives(&view, &prims));
+    const lcmtest_primitives_t* p = &msg.primitives;
+    EXPECT_EQ(p->i8, lcmtest_primitives_t_view_get_i8(&prims));
+    EXPECT_EQ(p->i16, lcmtest_primitives_t_view_get_i16(&prims));
+    EXPECT_EQ(p->i64, lcmtest_primitives_t_view_get_i64(&prims));
+    EXPECT_EQ(p->enabled, lcmtest_primitives_t_view_get_enabled(&prims));
+    EXPECT_STREQ(p->name, lcmtest_primitives_t_view_get_name(&prims));
+
+    ASSERT_EQ(p->num_ranges, lcmtest_primitives_t_view_ranges_length(&prims));
+    for (int i = 0; i < p->num_ranges; i++) {
+        EXPECT_EQ(p->ranges[i], lcmtest_primitives_t_view_get_ranges(&prims,
+                                                                     i));
+    }
+    std::vector<int16_t> ranges(p->num_ranges - 2);
+    EXPECT_EQ(p->num_ranges - 2, lcmtest_primitives_t_view_copy_ranges(
+                                     &prims, &ranges[0], 2, p->num_ranges - 2));
+    EXPECT_EQ(0, memcmp(&ranges[0], &p->ranges[2],
+                        ranges.size() * sizeof(int16_t)));
+    EXPECT_GT(0, lcmtest_primitives_t_view_copy_ranges(&prims, &ranges[0], 3,
+                                                       p->num_ranges - 2));
+
+    ASSERT_EQ(4, lcmtest_primitives_t_view_orientation_length(&prims));
+    double orientation[4];
+    EXPECT_EQ(4, lcmtest_primitives_t_view_copy_orientation(&prims,
+                                                            orientation, 0, 4));
+    EXPECT_EQ(0, memcmp(orientation, p->orientation, sizeof(orientation)));
+    EXPECT_EQ(p->position[1],
+              lcmtest_primitives_t_view_get_position(&prims, 1));
+
+    clear_lcmtest2_cross_package_t(&msg);
+}
+
+TEST(LCM_C, CoretypesViewMultidim) {
+    lcmtest_multidim_array_t msg;
+    fill_lcmtest_multidim_array_t(5, &msg);
+    std::vector<uint8_t> buf(lcmtest_multidim_array_t_encoded_size(&msg));
+    int size = (int)buf.size();
+    ASSERT_EQ(size,
+              lcmtest_multidim_array_t_encode(&buf[0], 0, size, &msg));
+
+    lcmtest_multidim_array_t_view view;
+    ASSERT_EQ(size, lcmtest_multidim_array_t_view_init(&view, &buf[0], 0,
+                                                       size));
+    ASSERT_EQ(125, lcmtest_multidim_array_t_view_data_length(&view));
+    for (int i = 0; i < 5; i++) {
+        for (int j = 0; j < 5; j++) {
+            for (int k = 0; k < 5; k++) {
+                EXPECT_EQ(msg.data[i][j][k],
+                          lcmtest_multidim_array_t_view_get_data(
+                              &view, (i * 5 + j) * 5 + k));
+            }
+        }
+    }
+
+    // every truncation of the message is rejected
+    for (int len = 0; len < size; len++) {
+        EXPECT_GT(0, lcmtest_multidim_array_t_view_init(&view, &buf[0], 0,
+                                                        len));
+    }
+
+    // as are array sizes that overflow the buffer
+    std::vector<uint8_t> corrupt(buf);
+    int32_t huge = 0x40000000;
+    __int32_t_encode_array(&corrupt[0], 8, 4, &huge, 1);
+    EXPECT_GT(0, lcmtest_multidim_array_t_view_init(&view, &corrupt[0], 0,
+                                                    size));
+    int32_t negative = -5;
+    __int32_t_encode_array(&corrupt[0], 8, 4, &negative, 1);
+    __int32_t_encode_array(&corrupt[0], 12, 4, &negative, 1);
+    EXPECT_GT(0, lcmtest_multidim_array_t_view_init(&view, &corrupt[0], 0,
+                                                    size));
+
+    // and messages of another type
+    lcmtest_primitives_t_view other;
+    EXPECT_GT(0, lcmtest_primitives_t_view_init(&other, &buf[0], 0, size));
+
+    clear_lcmtest_multidim_array_t(&msg);
+}
+
+TEST(LCM_C, CoretypesFixedSize) {
+    EXPECT_EQ(12, LCMTEST2_ANOTHER_TYPE_T_ENCODED_SIZE);
+    EXPECT_EQ(LCMTEST2_ANOTHER_TYPE_T_FINGERPRINT,
+              __lcmtest2_another_type_t_get_hash());
+
+    lcmtest2_another_type_t msg;
+    fill_lcmtest2_another_type_t(7, &msg);
+    EXPECT_EQ(LCMTEST2_ANOTHER_TYPE_T_ENCODED_SIZE,
+              lcmtest2_another_type_t_encoded_size(&msg));
+    uint8_t buf[LCMTEST2_ANOTHER_TYPE_T_ENCODED_SIZE];
+    for (int len = 0; len < (int)sizeof(buf); len++) {
+        EXPECT_GT(0, lcmtest2_another_type_t_encode(buf, 0, len, &msg));
+    }
+    ASSERT_EQ((int)sizeof(buf),
+              lcmtest2_another_type_t_encode(buf, 0, sizeof(buf), &msg));
+
+    lcmtest2_another_type_t decoded;
+    ASSERT_EQ((int)sizeof(buf),
+              lcmtest2_another_type_t_decode(buf, 0, sizeof(buf), &decoded));
+    EXPECT_TRUE(check_lcmtest2_another_type_t(&decoded, 7));
+    lcmtest2_another_type_t_decode_cleanup(&decoded);
+    clear_lcmtest2_another_type_t(&msg);
+}
+
+TEST(LCM_C, CoretypesDecodeFields) {
+    lcmtest_multidim_array_t msg;
+    fill_lcmtest_multidim_array_t(5, &msg);
+    std::vector<uint8_t> buf(lcmtest_multidim_array_t_encoded_size(&msg));
+    int size = (int)buf.size();
+    ASSERT_EQ(size,
+              lcmtest_multidim_array_t_encode(&buf[0], 0, size, &msg));
+
+    // the strings are decoded, and the array before them skipped
+    lcmtest_multidim_array_t decoded;
+    EXPECT_EQ(size, lcmtest_multidim_array_t_decode_fields(
+                        &buf[0], 0, size, &decoded,
+                        LCMTEST_MULTIDIM_ARRAY_T_FIELD_strarray));
+    EXPECT_EQ(5, decoded.size_c);
+    EXPECT_TRUE(decoded.data == NULL);
+    for (int i = 0; i < 2; i++) {
+        for (int k = 0; k < 5; k++) {
+            EXPECT_STREQ(msg.strarray[i][k], decoded.strarray[i][k]);
+        }
+    }
+    lcmtest_multidim_array_t_decode_cleanup(&decoded);
+
+    // decoding stops after the last member selected
+    EXPECT_EQ(16, lcmtest_multidim_array_t_decode_fields(
+                      &buf[0], 0, size, &decoded,
+                      LCMTEST_MULTIDIM_ARRAY_T_FIELD_size_b));
+    EXPECT_EQ(5, decoded.size_b);
+    lcmtest_multidim_array_t_decode_cleanup(&decoded);
+    EXPECT_EQ(8, lcmtest_multidim_array_t_decode_fields(&buf[0], 0, size,
+                                                        &decoded, 0));
+
+    // truncated messages fail, whether the end is decoded or skipped
+    EXPECT_GT(0, lcmtest_multidim_array_t_decode_fields(
+                     &buf[0], 0, size - 1, &decoded,
+                     LCMTEST_MULTIDIM_ARRAY_T_FIELD_strarray));
+    lcmtest_multidim_array_t_decode_cleanup(&decoded);
+    EXPECT_GT(0, lcmtest_multidim_array_t_decode_fields(
+                     &buf[0], 0, 150, &decoded,
+                     LCMTEST_MULTIDIM_ARRAY_T_FIELD_strarray));
+    lcmtest_multidim_array_t_decode_cleanup(&decoded);
+    clear_lcmtest_multidim_array_t(&msg);
+
+    // nested structs are skipped as a whole
+    lcmtest2_cross_package_t cross;
+    fill_lcmtest2_cross_package_t(12, &cross);
+    std::vector<uint8_t> cross_buf(
+        lcmtest2_cross_package_t_encoded_size(&cross));
+    size = (int)cross_buf.size();
+    ASSERT_EQ(size, lcmtest2_cross_package_t_encode(&cross_buf[0], 0, size,
+                                                    &cross));
+    lcmtest2_cross_package_t cross_decoded;
+    EXPECT_EQ(size, lcmtest2_cross_package_t_decode_fields(
+                        &cross_buf[0], 0, size, &cross_decoded,
+                        LCMTEST2_CROSS_PACKAGE_T_FIELD_another));
+    EXPECT_TRUE(check_lcmtest2_another_type_t(&cross_decoded.another, 12));
+    EXPECT_TRUE(cross_decoded.primitives.name == NULL);
+    lcmtest2_cross_package_t_decode_cleanup(&cross_decoded);
+    clear_lcmtest2_cross_package_t(&cross);
+}
+
+static void CheckRegistry(const lcm_type_registry_entry_t* entries, int n) {
+    for (int i = 0; i < n; i++) {
+        // the fingerprints computed by lcm-gen are those of the messages
+        const lcm_type_info_t* info = entries[i].get_type_info();
+        EXPECT_EQ(info->get_hash(), entries[i].fingerprint) << entries[i].name;
+        if (i > 0)
+            EXPECT_LT(entries[i - 1].fingerprint, entries[i].fingerprint);
+        EXPECT_EQ(&entries[i],
+                lcm_type_registry_find(entries, n, entries[i].fingerprint));
+    }
+}
+
+TEST(LCM_C, CoretypesRegistry) {
+    EXPECT_EQ(10, lcmtest_registry_size);
+    CheckRegistry(lcmtest_registry, lcmtest_registry_size);
+    CheckRegistry(lcmtest2_registry, lcmtest2_registry_size);
+    CheckRegistry(lcmtest3_registry, lcmtest3_registry_size);
+    EXPECT_TRUE(lcmtest_registry_find(0) == NULL);
+
+    // a message is decoded by the type its fingerprint names
+    lcmtest_node_t msg;
+    fill_lcmtest_node_t(3, &msg);
+    std::vector<uint8_t> buf(lcmtest_node_t_encoded_size(&msg));
+    int size = (int)buf.size();
+    ASSERT_EQ(size, lcmtest_node_t_encode(&buf[0], 0, size, &msg));
+    int64_t fingerprint;
+    ASSERT_EQ(8, __int64_t_decode_array(&buf[0], 0, size, &fingerprint, 1));
+    const lcm_type_registry_entry_t* entry = lcmtest_registry_find(fingerprint);
+    ASSERT_TRUE(entry != NULL);
+    EXPECT_STREQ("lcmtest.node_t", entry->name);
+    const lcm_type_info_t* info = entry->get_type_info();
+    std::vector<uint8_t> decoded(info->struct_size());
+    EXPECT_EQ(size, info->decode(&buf[0], 0, size, &decoded[0]));
+    EXPECT_TRUE(check_lcmtest_node_t((lcmtest_node_t*)&decoded[0], 3));
+    info->decode_cleanup(&decoded[0]);
+    clear_lcmtest_node_t(&msg);
+
+    EXPECT_TRUE(lcmtest2_registry_find(fingerprint) == NULL);
+}
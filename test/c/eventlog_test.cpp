@@ -1,6 +1,10 @@
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <vector>
 
 #include <lcm/lcm.h>
 #include "common.h"
@@ -128,3 +132,1177 @@ TEST(LCM_C, EventLogCorrupt) {
     lcm_eventlog_destroy(rlog);
     free_tmpnam(fname);
 }
+
+TEST(LCM_C, EventLogResync) {
+    // After corrupt data, reading picks up again at the next event, and
+    // seeking by timestamp lands on an event header.
+    char* fname = make_tmpnam();
+
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+
+    const char* channel = "CHANNEL_TEST";
+    char data[100];
+    memset(data, 0xED, sizeof(data));
+
+    lcm_eventlog_event_t event;
+    event.channellen = strlen(channel);
+    event.channel = const_cast<char*>(channel);
+    event.datalen = sizeof(data);
+    event.data = data;
+
+    event.timestamp = 1;
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    // garbage that starts like a magic number
+    const unsigned char garbage[] = { 0xED, 0xA1, 0xDA, 0xED, 0xA1, 0x00 };
+    EXPECT_EQ(sizeof(garbage), fwrite(garbage, 1, sizeof(garbage), wlog->f));
+    for (int i = 0; i < 100; ++i) {
+        event.timestamp = 1000 + i * 10;
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    // the first event is followed by garbage
+    EXPECT_EQ((void*)NULL, lcm_eventlog_read_next_event(rlog));
+    for (int i = 0; i < 100; ++i) {
+        lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void*)NULL, revent);
+        EXPECT_EQ(1000 + i * 10, revent->timestamp);
+        EXPECT_EQ(i + 1, revent->eventnum);
+        EXPECT_EQ(0, memcmp(data, revent->data, sizeof(data)));
+        lcm_eventlog_free_event(revent);
+    }
+    EXPECT_EQ((void*)NULL, lcm_eventlog_read_next_event(rlog));
+
+    EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, 1500));
+    lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+    ASSERT_NE((void*)NULL, revent);
+    EXPECT_LE(1480, revent->timestamp);
+    EXPECT_GE(1520, revent->timestamp);
+    lcm_eventlog_free_event(revent);
+
+    lcm_eventlog_destroy(rlog);
+    free_tmpnam(fname);
+}
+
+TEST(LCM_C, EventLogReadInto) {
+    // Reading into a caller's event reuses its buffers, growing them only
+    // for larger events.
+    char* fname = make_tmpnam();
+
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    const int sizes[] = { 100, 10, 1000, 0, 500 };
+    std::vector<char> data(1000);
+    for (int i = 0; i < 5; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = i;
+        event.channel = const_cast<char*>(i % 2 ? "A" : "CHANNEL");
+        event.channellen = strlen(event.channel);
+        event.datalen = sizes[i];
+        memset(&data[0], 'a' + i, data.size());
+        event.data = &data[0];
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    lcm_eventlog_event_t event;
+    memset(&event, 0, sizeof(event));
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(0, lcm_eventlog_read_next_event_into(rlog, &event,
+                    &channel_capacity, &data_capacity));
+        EXPECT_EQ(i, event.timestamp);
+        EXPECT_STREQ(i % 2 ? "A" : "CHANNEL", event.channel);
+        ASSERT_EQ(sizes[i], event.datalen);
+        EXPECT_EQ(std::string(sizes[i], 'a' + i),
+                std::string((const char*)event.data, event.datalen));
+        EXPECT_EQ(0, ((const char*)event.data)[event.datalen]);
+    }
+    EXPECT_EQ(8, channel_capacity);
+    EXPECT_EQ(1001, data_capacity);
+    EXPECT_EQ(-1, lcm_eventlog_read_next_event_into(rlog, &event,
+                &channel_capacity, &data_capacity));
+    free(event.channel);
+    free(event.data);
+
+    lcm_eventlog_destroy(rlog);
+    free_tmpnam(fname);
+}
+
+static std::string ReadFile(const std::string& path) {
+    std::string contents;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f)
+        return contents;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        contents.append(buf, n);
+    fclose(f);
+    return contents;
+}
+
+static void WriteIndexTestLog(const char* fname, int num_events,
+        int64_t time0, int index) {
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    if (index)
+        EXPECT_EQ(0, lcm_eventlog_enable_index(wlog));
+    std::vector<char> data(300);
+    for (int i = 0; i < num_events; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = time0 + i * 10;
+        event.channel = const_cast<char*>("CHANNEL");
+        event.channellen = strlen(event.channel);
+        // some events are large, to split by size as well as count
+        event.datalen = i % 100 ? 300 : 0;
+        memset(&data[0], i, data.size());
+        event.data = &data[0];
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+}
+
+TEST(LCM_C, EventLogIndex) {
+    // With an index, seeking lands on the first event at or after the
+    // timestamp.  A log indexed as it is written and one indexed afterwards
+    // get the same index.
+    char* fname = make_tmpnam();
+    std::string ipath = std::string(fname) + LCM_EVENTLOG_INDEX_SUFFIX;
+
+    const int num_events = 10000;
+    WriteIndexTestLog(fname, num_events, 0, 1);
+    std::string written = ReadFile(ipath);
+    EXPECT_LT(8u, written.size());
+    EXPECT_EQ(0, lcm_eventlog_build_index(fname));
+    EXPECT_EQ(written, ReadFile(ipath));
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    const int64_t targets[] = { 0, 5, 12345, 45000, 99985, 99990, 1000000 };
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i) {
+        EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, targets[i]));
+        lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void*)NULL, revent);
+        int64_t expected = (targets[i] + 9) / 10;
+        if (expected >= num_events)
+            expected = num_events - 1;
+        EXPECT_EQ(expected, revent->eventnum);
+        EXPECT_EQ(expected * 10, revent->timestamp);
+        lcm_eventlog_free_event(revent);
+    }
+    lcm_eventlog_destroy(rlog);
+
+    // a flushed log can be read with its index while it is being written.
+    // Only the channels and the stats of the last block are left to write.
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    EXPECT_EQ(0, lcm_eventlog_enable_index(wlog));
+    std::vector<char> data(300);
+    for (int i = 0; i < num_events; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = i * 10;
+        event.channel = const_cast<char*>("CHANNEL");
+        event.channellen = strlen(event.channel);
+        event.datalen = i % 100 ? 300 : 0;
+        memset(&data[0], i, data.size());
+        event.data = &data[0];
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    EXPECT_EQ(0, lcm_eventlog_flush(wlog));
+    std::string flushed = ReadFile(ipath);
+    EXPECT_EQ(written.size() - 12 - 16 - 40, flushed.size());
+    EXPECT_EQ(0, written.compare(0, flushed.size(), flushed));
+    rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, 45000));
+    lcm_eventlog_event_t* live = lcm_eventlog_read_next_event(rlog);
+    ASSERT_NE((void*)NULL, live);
+    EXPECT_EQ(4500, live->eventnum);
+    lcm_eventlog_free_event(live);
+    lcm_eventlog_destroy(rlog);
+    lcm_eventlog_destroy(wlog);
+    EXPECT_EQ(written, ReadFile(ipath));
+
+    // an index of a different log is not trusted
+    WriteIndexTestLog(fname, num_events / 2, 5, 0);
+    rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, 20000));
+    lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+    ASSERT_NE((void*)NULL, revent);
+    EXPECT_EQ(revent->eventnum * 10 + 5, revent->timestamp);
+    EXPECT_LE(19000, revent->timestamp);
+    EXPECT_GE(21000, revent->timestamp);
+    lcm_eventlog_free_event(revent);
+    lcm_eventlog_destroy(rlog);
+
+    remove(ipath.c_str());
+    free_tmpnam(fname);
+}
+
+TEST(LCM_C, EventLogRepair) {
+    // Garbage full of magic numbers in front of impossible headers is skipped
+    // by readers at once, losing only the event that it follows.  Repairing
+    // the log keeps the events that are whole, and drops that one and the
+    // one that is cut short at the end.
+    char* fname = make_tmpnam();
+    std::string out = std::string(fname) + ".repaired";
+    std::string idx = out + LCM_EVENTLOG_INDEX_SUFFIX;
+
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    const char* channel = "REPAIR";
+    char data[200];
+    memset(data, 0xED, sizeof(data));
+    lcm_eventlog_event_t event;
+    event.channellen = strlen(channel);
+    event.channel = const_cast<char*>(channel);
+    event.datalen = sizeof(data);
+    event.data = data;
+    const int64_t event_size = 28 + event.channellen + event.datalen;
+    for (int i = 0; i < 100; ++i) {
+        event.timestamp = i * 1000;
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+        if (i == 49) {
+            std::vector<unsigned char> garbage(100000, 0);
+            for (size_t g = 8; g + 32 <= garbage.size(); g += 64) {
+                garbage[g] = 0xED;
+                garbage[g + 1] = 0xA1;
+                garbage[g + 2] = 0xDA;
+                garbage[g + 3] = 0x01;
+                memset(&garbage[g + 20], 0xFF, 4);  // channel length -1
+            }
+            EXPECT_EQ(garbage.size(), fwrite(&garbage[0], 1, garbage.size(),
+                        wlog->f));
+        }
+    }
+    // the start of an event that was never finished
+    event.timestamp = 100000;
+    EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    lcm_eventlog_destroy(wlog);
+    std::string contents = ReadFile(fname);
+    ASSERT_EQ(0, truncate(fname, contents.size() - 50));
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    int num_read = 0, num_null = 0;
+    while (num_null < 3) {
+        lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+        if (!revent) {
+            num_null++;
+            continue;
+        }
+        num_read++;
+        lcm_eventlog_free_event(revent);
+    }
+    lcm_eventlog_destroy(rlog);
+    EXPECT_EQ(99, num_read);
+
+    lcm_eventlog_repair_stats_t stats;
+    ASSERT_EQ(0, lcm_eventlog_repair(fname, out.c_str(), &stats));
+    EXPECT_EQ(99, stats.num_events);
+    EXPECT_EQ(2, stats.num_damaged);
+    EXPECT_EQ(event_size + 100000 + event_size - 50, stats.bytes_skipped);
+    EXPECT_EQ(-1, lcm_eventlog_repair(fname, fname, NULL));
+
+    rlog = lcm_eventlog_create(out.c_str(), "r");
+    ASSERT_NE((void*)NULL, rlog);
+    for (int i = 0; i < 100; ++i) {
+        if (i == 49)
+            continue;
+        lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+        ASSERT_NE((void*)NULL, revent);
+        EXPECT_EQ(i < 49 ? i : i - 1, revent->eventnum);
+        EXPECT_EQ(i * 1000, revent->timestamp);
+        EXPECT_EQ(0, memcmp(data, revent->data, sizeof(data)));
+        lcm_eventlog_free_event(revent);
+    }
+    EXPECT_EQ((void*)NULL, lcm_eventlog_read_next_event(rlog));
+    lcm_eventlog_destroy(rlog);
+    EXPECT_LT(8u, ReadFile(idx).size());
+
+    remove(idx.c_str());
+    remove(out.c_str());
+    free_tmpnam(fname);
+}
+
+static std::vector<std::string> ReadFilteredChannels(const char* fname,
+        const char* regex, std::vector<int64_t>* eventnums) {
+    std::vector<std::string> channels;
+    lcm_eventlog_t* rlog = lcm_eventlog_create_filtered(fname, regex);
+    EXPECT_NE((void*)NULL, rlog);
+    if (!rlog)
+        return channels;
+    lcm_eventlog_event_t* revent;
+    while ((revent = lcm_eventlog_read_next_event(rlog))) {
+        channels.push_back(revent->channel);
+        eventnums->push_back(revent->eventnum);
+        EXPECT_EQ(revent->eventnum % 256, ((uint8_t*)revent->data)[0]);
+        lcm_eventlog_free_event(revent);
+    }
+    lcm_eventlog_destroy(rlog);
+    return channels;
+}
+
+TEST(LCM_C, EventLogFilteredRead) {
+    // A filtered reader returns the events on matching channels, with or
+    // without an index.
+    char* fname = make_tmpnam();
+    std::string ipath = std::string(fname) + LCM_EVENTLOG_INDEX_SUFFIX;
+
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    EXPECT_EQ(0, lcm_eventlog_enable_index(wlog));
+    std::vector<char> data(200);
+    std::vector<int64_t> slow;
+    for (int i = 0; i < 20000; ++i) {
+        char channel[32];
+        if (i % 3000 == 1500) {
+            strcpy(channel, "SLOW");
+            slow.push_back(i);
+        } else if (i >= 8000 && i < 9000) {
+            // more channels than fit in one word of a bitmap
+            snprintf(channel, sizeof(channel), "MANY_%d", i % 40);
+        } else {
+            strcpy(channel, "FAST");
+        }
+        lcm_eventlog_event_t event;
+        event.timestamp = i;
+        event.channel = channel;
+        event.channellen = strlen(channel);
+        event.datalen = data.size();
+        data[0] = (char)i;
+        event.data = &data[0];
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    std::vector<int64_t> eventnums;
+    EXPECT_EQ(std::vector<std::string>(slow.size(), "SLOW"),
+            ReadFilteredChannels(fname, "SLOW", &eventnums));
+    EXPECT_EQ(slow, eventnums);
+
+    eventnums.clear();
+    std::vector<std::string> many =
+        ReadFilteredChannels(fname, "MANY_3.", &eventnums);
+    ASSERT_EQ(250u, many.size());
+    EXPECT_EQ(8030, eventnums[0]);
+    EXPECT_EQ("MANY_39", many[249]);
+
+    // the same without an index
+    remove(ipath.c_str());
+    eventnums.clear();
+    EXPECT_EQ(std::vector<std::string>(slow.size(), "SLOW"),
+            ReadFilteredChannels(fname, "SLOW", &eventnums));
+    EXPECT_EQ(slow, eventnums);
+
+    EXPECT_EQ((void*)NULL, lcm_eventlog_create_filtered(fname, "("));
+
+    free_tmpnam(fname);
+}
+
+TEST(LCM_C, EventLogCompressed) {
+    // Compressed logs read back like any other, and seek by timestamp with
+    // or without the block index at the end.  A codec that LCM was built
+    // without is refused.
+    const char* codecs[] = { "lz4", "zlib" };
+    for (int c = 0; c < 2; c++) {
+        char* fname = make_tmpnam();
+        lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+        ASSERT_NE((void*)NULL, wlog);
+        if (0 != lcm_eventlog_set_compression(wlog, codecs[c])) {
+            lcm_eventlog_destroy(wlog);
+            free_tmpnam(fname);
+            continue;
+        }
+        const int num_events = 5000;
+        std::vector<char> data(1000);
+        int64_t raw_size = 0;
+        for (int i = 0; i < num_events; ++i) {
+            lcm_eventlog_event_t event;
+            event.timestamp = i * 10;
+            event.channel = const_cast<char*>(i % 10 ? "FAST" : "SLOW");
+            event.channellen = strlen(event.channel);
+            event.datalen = i % 10 == 5 ? 0 : 1000;
+            for (int j = 0; j < event.datalen; j++)
+                data[j] = (char)(i + j / 100);
+            event.data = &data[0];
+            EXPECT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+            raw_size += 28 + event.channellen + event.datalen;
+            if (i == 100)
+                EXPECT_EQ(0, lcm_eventlog_flush(wlog));
+        }
+        lcm_eventlog_destroy(wlog);
+
+        FILE* f = fopen(fname, "rb");
+        ASSERT_NE((void*)NULL, f);
+        fseek(f, 0, SEEK_END);
+        long file_size = ftell(f);
+        fclose(f);
+        EXPECT_GT(raw_size / 4, file_size);
+
+        for (int footer = 1; footer >= 0; footer--) {
+            if (!footer)
+                ASSERT_EQ(0, truncate(fname, file_size - 12));
+            lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+            ASSERT_NE((void*)NULL, rlog);
+            for (int i = 0; i < num_events; ++i) {
+                lcm_eventlog_event_t* revent =
+                    lcm_eventlog_read_next_event(rlog);
+                ASSERT_NE((void*)NULL, revent);
+                EXPECT_EQ(i, revent->eventnum);
+                EXPECT_EQ(i * 10, revent->timestamp);
+                ASSERT_EQ(i % 10 == 5 ? 0 : 1000, revent->datalen);
+                if (revent->datalen)
+                    EXPECT_EQ((char)(i + 9), ((char*)revent->data)[999]);
+                lcm_eventlog_free_event(revent);
+            }
+            EXPECT_EQ((void*)NULL, lcm_eventlog_read_next_event(rlog));
+
+            const int64_t targets[] = { 0, 12345, 1015, 49985, 1000000 };
+            for (size_t t = 0; t < sizeof(targets) / sizeof(targets[0]);
+                    ++t) {
+                EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog,
+                            targets[t]));
+                lcm_eventlog_event_t* revent =
+                    lcm_eventlog_read_next_event(rlog);
+                ASSERT_NE((void*)NULL, revent);
+                int64_t expected = (targets[t] + 9) / 10;
+                if (expected >= num_events)
+                    expected = num_events - 1;
+                EXPECT_EQ(expected, revent->eventnum);
+                lcm_eventlog_free_event(revent);
+            }
+
+            // moving the file continues at the next block
+            fseeko(rlog->f, file_size / 2, SEEK_SET);
+            lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+            ASSERT_NE((void*)NULL, revent);
+            EXPECT_LT(num_events / 4, revent->eventnum);
+            EXPECT_GT(num_events * 3 / 4, revent->eventnum);
+            EXPECT_EQ(revent->eventnum * 10, revent->timestamp);
+            lcm_eventlog_free_event(revent);
+            lcm_eventlog_destroy(rlog);
+        }
+
+        std::vector<int64_t> eventnums;
+        EXPECT_EQ(std::vector<std::string>(num_events / 10, "SLOW"),
+                ReadFilteredChannels(fname, "SLOW", &eventnums));
+        for (size_t i = 0; i < eventnums.size(); ++i)
+            EXPECT_EQ((int64_t)i * 10, eventnums[i]);
+
+        free_tmpnam(fname);
+    }
+}
+
+static void WriteFlagsTestLog(const char* fname, const char* mode, int flags,
+        int first, int num_events) {
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, mode);
+    ASSERT_NE((void*)NULL, wlog);
+    ASSERT_EQ(0, lcm_eventlog_set_write_flags(wlog, flags));
+    std::vector<char> data(100000);
+    for (int i = first; i < first + num_events; ++i) {
+        // a mix of events copied into the buffer and written out directly
+        int datalen = (i % 7 == 3) ? 100000 : i % 500;
+        memset(&data[0], (char)i, datalen);
+        lcm_eventlog_event_t event;
+        event.timestamp = i * 10;
+        event.channellen = 4;
+        event.datalen = datalen;
+        event.channel = (char*)"CHAN";
+        event.data = &data[0];
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+        if (i == first + num_events / 2)
+            EXPECT_EQ(0, lcm_eventlog_flush(wlog));
+    }
+    lcm_eventlog_destroy(wlog);
+}
+
+TEST(LCM_C, EventLogWriteFlags) {
+    // Logs are the same whichever way they are written, including when
+    // appending to a log that does not end on a block boundary.
+    char* fname = make_tmpnam();
+    const int flags[] = { LCM_EVENTLOG_WRITEV,
+        LCM_EVENTLOG_WRITEV | LCM_EVENTLOG_DIRECT };
+
+    WriteFlagsTestLog(fname, "w", 0, 0, 300);
+    WriteFlagsTestLog(fname, "a", 0, 300, 100);
+    std::string expected = ReadFile(fname);
+    for (int f = 0; f < 2; ++f) {
+        lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+        ASSERT_NE((void*)NULL, wlog);
+        int status = lcm_eventlog_set_write_flags(wlog, flags[f]);
+        lcm_eventlog_destroy(wlog);
+        if (status != 0) {
+            // not every file system supports O_DIRECT
+            EXPECT_TRUE(flags[f] & LCM_EVENTLOG_DIRECT);
+            continue;
+        }
+        WriteFlagsTestLog(fname, "w", flags[f], 0, 300);
+        WriteFlagsTestLog(fname, "a", flags[f], 300, 100);
+        EXPECT_TRUE(expected == ReadFile(fname));
+    }
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    EXPECT_EQ(-1, lcm_eventlog_set_write_flags(rlog, LCM_EVENTLOG_WRITEV));
+    lcm_eventlog_destroy(rlog);
+    free_tmpnam(fname);
+}
+
+TEST(LCM_C, EventLogAsync) {
+    // Events written from the caller come out in order, and the counters
+    // account for every event, whether the writer waits or drops them.
+    char* fname = make_tmpnam();
+    const int num_events = 2000;
+    char data[1000];
+    for (int block = 1; block >= 0; --block) {
+        lcm_eventlog_t* wlog = lcm_eventlog_create_async(fname, "w", 20000,
+                block);
+        ASSERT_NE((void*)NULL, wlog);
+        std::vector<int64_t> queued;
+        for (int i = 0; i < num_events; ++i) {
+            memset(data, (char)i, sizeof(data));
+            lcm_eventlog_event_t event;
+            event.timestamp = i;
+            event.channellen = 4;
+            event.datalen = (i % 10) * 100;
+            event.channel = (char*)"CHAN";
+            event.data = data;
+            if (0 == lcm_eventlog_write_event(wlog, &event)) {
+                EXPECT_EQ((int64_t)queued.size(), event.eventnum);
+                queued.push_back(i);
+            }
+            if (i == num_events / 2)
+                EXPECT_EQ(0, lcm_eventlog_flush(wlog));
+        }
+        EXPECT_EQ(0, lcm_eventlog_flush(wlog));
+
+        lcm_eventlog_async_stats_t stats;
+        ASSERT_EQ(0, lcm_eventlog_get_async_stats(wlog, &stats));
+        EXPECT_EQ(0, stats.num_queued);
+        EXPECT_EQ(0, stats.queued_bytes);
+        EXPECT_GE(20000, stats.max_queued_bytes);
+        EXPECT_EQ((int64_t)queued.size(), stats.num_written);
+        EXPECT_EQ(0, stats.num_failed);
+        EXPECT_EQ(num_events - (int64_t)queued.size(), stats.num_dropped);
+        EXPECT_LE(1, stats.num_flushes);
+        if (block)
+            EXPECT_EQ((size_t)num_events, queued.size());
+        else
+            EXPECT_EQ(0, stats.num_blocked);
+        lcm_eventlog_destroy(wlog);
+
+        lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+        ASSERT_NE((void*)NULL, rlog);
+        EXPECT_EQ(-1, lcm_eventlog_get_async_stats(rlog, &stats));
+        for (size_t i = 0; i < queued.size(); ++i) {
+            lcm_eventlog_event_t* revent = lcm_eventlog_read_next_event(rlog);
+            ASSERT_NE((void*)NULL, revent);
+            EXPECT_EQ((int64_t)i, revent->eventnum);
+            EXPECT_EQ(queued[i], revent->timestamp);
+            EXPECT_EQ((queued[i] % 10) * 100, revent->datalen);
+            if (revent->datalen)
+                EXPECT_EQ((char)queued[i], ((char*)revent->data)[0]);
+            lcm_eventlog_free_event(revent);
+        }
+        EXPECT_EQ((void*)NULL, lcm_eventlog_read_next_event(rlog));
+        lcm_eventlog_destroy(rlog);
+    }
+    EXPECT_EQ((void*)NULL, lcm_eventlog_create_async(fname, "r", 1000, 1));
+    free_tmpnam(fname);
+}
+
+static void WriteSplitTestLog(const char* fname, int num_events,
+        const char* codec) {
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    if (codec)
+        ASSERT_EQ(0, lcm_eventlog_set_compression(wlog, codec));
+    // payloads full of magic numbers, which splitting must not mistake for
+    // the start of an event
+    std::vector<char> data(2000);
+    const char magic[] = { '\xed', '\xa1', '\xda', '\x01' };
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = magic[i % 4];
+    for (int i = 0; i < num_events; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = i;
+        event.channellen = i % 2 ? 2 : 1;
+        event.datalen = (i * 37) % 2000;
+        event.channel = (char*)(i % 2 ? "BB" : "A");
+        event.data = &data[0];
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+}
+
+static void CountScannedEvent(const lcm_eventlog_event_t* event, int range,
+        void* user) {
+    std::vector<int64_t>* eventnums = (std::vector<int64_t>*)user;
+    eventnums[range].push_back(event->eventnum);
+}
+
+TEST(LCM_C, EventLogSplit) {
+    // The ranges of a split log hold every event exactly once, in order,
+    // with or without an index, and for compressed logs.
+    char* fname = make_tmpnam();
+    const int num_events = 3000;
+    const char* codecs[] = { NULL, NULL, "lz4", "zlib" };
+    for (int mode = 0; mode < 4; ++mode) {
+        WriteSplitTestLog(fname, num_events, NULL);
+        if (codecs[mode]) {
+            lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+            int status = lcm_eventlog_set_compression(wlog, codecs[mode]);
+            lcm_eventlog_destroy(wlog);
+            if (status != 0)
+                continue;
+            WriteSplitTestLog(fname, num_events, codecs[mode]);
+        }
+        std::string idx = std::string(fname) + LCM_EVENTLOG_INDEX_SUFFIX;
+        if (mode == 1)
+            ASSERT_EQ(0, lcm_eventlog_build_index(fname));
+        else
+            remove(idx.c_str());
+        int64_t file_size = ReadFile(fname).size();
+
+        const int num_ranges[] = { 1, 4, 7, 100 };
+        for (int n = 0; n < 4; ++n) {
+            std::vector<int64_t> offsets(num_ranges[n] + 1);
+            int ranges = lcm_eventlog_split(fname, num_ranges[n], &offsets[0]);
+            ASSERT_LE(1, ranges);
+            ASSERT_GE(num_ranges[n], ranges);
+            if (!codecs[mode])
+                EXPECT_EQ(num_ranges[n], ranges);
+            EXPECT_EQ(0, offsets[0]);
+            EXPECT_EQ(file_size, offsets[ranges]);
+
+            int64_t expected = 0;
+            for (int r = 0; r < ranges; ++r) {
+                EXPECT_LT(offsets[r], offsets[r + 1]);
+                lcm_eventlog_t* rlog = lcm_eventlog_create_range(fname,
+                        offsets[r], offsets[r + 1]);
+                ASSERT_NE((void*)NULL, rlog);
+                lcm_eventlog_event_t* revent;
+                while ((revent = lcm_eventlog_read_next_event(rlog))) {
+                    EXPECT_EQ(expected, revent->eventnum);
+                    EXPECT_EQ((expected * 37) % 2000, revent->datalen);
+                    expected++;
+                    lcm_eventlog_free_event(revent);
+                }
+                lcm_eventlog_destroy(rlog);
+            }
+            EXPECT_EQ(num_events, expected);
+        }
+
+        std::vector<int64_t> eventnums[4];
+        int ranges = lcm_eventlog_scan_parallel(fname, 4, CountScannedEvent,
+                eventnums);
+        ASSERT_LE(1, ranges);
+        std::vector<int64_t> all;
+        for (int r = 0; r < ranges; ++r)
+            all.insert(all.end(), eventnums[r].begin(), eventnums[r].end());
+        ASSERT_EQ((size_t)num_events, all.size());
+        for (int i = 0; i < num_events; ++i)
+            EXPECT_EQ(i, all[i]);
+        remove(idx.c_str());
+    }
+    free_tmpnam(fname);
+}
+
+// Writes events on three channels, one of which falls silent for a while.
+static void WriteStatsTestLog(const char* fname, const char* mode, int first,
+        int num_events, const char* codec, int index) {
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, mode);
+    ASSERT_NE((void*)NULL, wlog);
+    if (codec)
+        ASSERT_EQ(0, lcm_eventlog_set_compression(wlog, codec));
+    if (index)
+        ASSERT_EQ(0, lcm_eventlog_enable_index(wlog));
+    std::vector<char> data(500);
+    const char* channels[] = { "A", "BB", "CCC" };
+    for (int i = first; i < first + num_events; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = i * 100 + (i % 3 == 2 && i > 1000 ? 50000 : 0);
+        event.channel = const_cast<char*>(channels[i % 3]);
+        event.channellen = strlen(event.channel);
+        event.datalen = (i * 13) % 500;
+        event.data = &data[0];
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+}
+
+static void ExpectChannelStats(const char* fname, int num_threads) {
+    std::vector<lcm_eventlog_channel_stats_t> expected;
+    lcm_eventlog_t* rlog = lcm_eventlog_create(fname, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    lcm_eventlog_event_t* revent;
+    while ((revent = lcm_eventlog_read_next_event(rlog))) {
+        size_t c = 0;
+        while (c < expected.size() &&
+                strcmp(expected[c].channel, revent->channel))
+            c++;
+        if (c == expected.size()) {
+            lcm_eventlog_channel_stats_t cs;
+            memset(&cs, 0, sizeof(cs));
+            cs.channel = strdup(revent->channel);
+            cs.first_timestamp = revent->timestamp;
+            expected.push_back(cs);
+        } else if (revent->timestamp - expected[c].last_timestamp >
+                expected[c].max_gap) {
+            expected[c].max_gap = revent->timestamp -
+                expected[c].last_timestamp;
+        }
+        expected[c].last_timestamp = revent->timestamp;
+        expected[c].num_events++;
+        expected[c].num_bytes += revent->datalen;
+        lcm_eventlog_free_event(revent);
+    }
+    lcm_eventlog_destroy(rlog);
+
+    lcm_eventlog_channel_stats_t* stats = NULL;
+    int num = lcm_eventlog_get_channel_stats(fname, num_threads, &stats);
+    ASSERT_EQ((int)expected.size(), num);
+    for (int c = 0; c < num; ++c) {
+        EXPECT_STREQ(expected[c].channel, stats[c].channel);
+        EXPECT_EQ(expected[c].num_events, stats[c].num_events);
+        EXPECT_EQ(expected[c].num_bytes, stats[c].num_bytes);
+        EXPECT_EQ(expected[c].first_timestamp, stats[c].first_timestamp);
+        EXPECT_EQ(expected[c].last_timestamp, stats[c].last_timestamp);
+        EXPECT_EQ(expected[c].max_gap, stats[c].max_gap);
+        free(expected[c].channel);
+    }
+    lcm_eventlog_free_channel_stats(stats, num);
+}
+
+TEST(LCM_C, EventLogChannelStats) {
+    // The stats of each channel are the same whether they come from the
+    // index, from reading the event headers with any number of threads, or
+    // from a compressed log.
+    char* fname = make_tmpnam();
+    std::string idx = std::string(fname) + LCM_EVENTLOG_INDEX_SUFFIX;
+    const int num_events = 5000;
+
+    WriteStatsTestLog(fname, "w", 0, num_events, NULL, 0);
+    remove(idx.c_str());
+    ExpectChannelStats(fname, 1);
+    ExpectChannelStats(fname, 4);
+
+    ASSERT_EQ(0, lcm_eventlog_build_index(fname));
+    ExpectChannelStats(fname, 1);
+
+    // events logged after the index was written are read
+    WriteStatsTestLog(fname, "a", num_events, 1500, NULL, 0);
+    ExpectChannelStats(fname, 2);
+
+    // and so are those of the last block of a log indexed as it is written
+    WriteStatsTestLog(fname, "w", 0, num_events, NULL, 1);
+    ExpectChannelStats(fname, 1);
+    WriteStatsTestLog(fname, "a", num_events, 1500, NULL, 1);
+    ExpectChannelStats(fname, 3);
+    remove(idx.c_str());
+
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    int status = lcm_eventlog_set_compression(wlog, "lz4");
+    lcm_eventlog_destroy(wlog);
+    if (status == 0) {
+        WriteStatsTestLog(fname, "w", 0, num_events, "lz4", 0);
+        ExpectChannelStats(fname, 3);
+    }
+
+    WriteStatsTestLog(fname, "w", 0, 0, NULL, 0);
+    lcm_eventlog_channel_stats_t* stats = NULL;
+    EXPECT_EQ(0, lcm_eventlog_get_channel_stats(fname, 1, &stats));
+    lcm_eventlog_free_channel_stats(stats, 0);
+    EXPECT_EQ(-1, lcm_eventlog_get_channel_stats("/nonexistent.lcmlog", 1,
+                &stats));
+    free_tmpnam(fname);
+}
+
+TEST(LCM_C, EventLogStriped) {
+    // The stripes named by a manifest read back as one log, in timestamp
+    // order, filtered and after seeking too.
+    const int num_stripes = 3;
+    const int num_events = 3000;
+    // make_tmpnam() may reuse its buffer
+    std::string fnames[num_stripes];
+    lcm_eventlog_t* wlogs[num_stripes];
+    for (int s = 0; s < num_stripes; ++s) {
+        char* fname = make_tmpnam();
+        fnames[s] = fname;
+        free_tmpnam(fname);
+        wlogs[s] = lcm_eventlog_create(fnames[s].c_str(), "w");
+        ASSERT_NE((void*)NULL, wlogs[s]);
+        EXPECT_EQ(0, lcm_eventlog_enable_index(wlogs[s]));
+    }
+    std::vector<char> data(100);
+    for (int i = 0; i < num_events; ++i) {
+        lcm_eventlog_event_t event;
+        event.timestamp = i * 10;
+        event.channel = (char*)(i % 2 ? "B" : "A");
+        event.channellen = 1;
+        event.datalen = data.size();
+        data[0] = (char)i;
+        event.data = &data[0];
+        // round-robin, a few events at a time
+        EXPECT_EQ(0, lcm_eventlog_write_event(wlogs[i / 5 % num_stripes],
+                    &event));
+    }
+    for (int s = 0; s < num_stripes; ++s)
+        lcm_eventlog_destroy(wlogs[s]);
+
+    // the first stripe is named relative to the manifest
+    char* manifest = make_tmpnam();
+    const char* paths[num_stripes];
+    size_t slash = fnames[0].rfind('/');
+    paths[0] = fnames[0].c_str() + (slash == std::string::npos ? 0 : slash + 1);
+    for (int s = 1; s < num_stripes; ++s)
+        paths[s] = fnames[s].c_str();
+    ASSERT_EQ(0, lcm_eventlog_write_manifest(manifest, num_stripes, paths));
+
+    lcm_eventlog_t* rlog = lcm_eventlog_create(manifest, "r");
+    ASSERT_NE((void*)NULL, rlog);
+    lcm_eventlog_event_t event = { 0 };
+    int32_t channel_capacity = 0;
+    int32_t data_capacity = 0;
+    int expected = 0;
+    while (0 == lcm_eventlog_read_next_event_into(rlog, &event,
+                &channel_capacity, &data_capacity)) {
+        EXPECT_EQ(expected, event.eventnum);
+        EXPECT_EQ(expected * 10, event.timestamp);
+        EXPECT_EQ((char)expected, ((char*)event.data)[0]);
+        expected++;
+    }
+    EXPECT_EQ(num_events, expected);
+
+    EXPECT_EQ(0, lcm_eventlog_seek_to_timestamp(rlog, 12345));
+    ASSERT_EQ(0, lcm_eventlog_read_next_event_into(rlog, &event,
+                &channel_capacity, &data_capacity));
+    EXPECT_EQ(1235, event.eventnum);
+    EXPECT_EQ(12350, event.timestamp);
+    free(event.channel);
+    free(event.data);
+    lcm_eventlog_destroy(rlog);
+
+    rlog = lcm_eventlog_create_filtered(manifest, "B");
+    ASSERT_NE((void*)NULL, rlog);
+    lcm_eventlog_event_t* revent;
+    expected = 1;
+    while ((revent = lcm_eventlog_read_next_event(rlog))) {
+        EXPECT_STREQ("B", revent->channel);
+        EXPECT_EQ(expected * 10, revent->timestamp);
+        expected += 2;
+        lcm_eventlog_free_event(revent);
+    }
+    EXPECT_EQ(num_events + 1, expected);
+    lcm_eventlog_destroy(rlog);
+
+    int64_t offsets[3];
+    EXPECT_EQ(-1, lcm_eventlog_split(manifest, 2, offsets));
+
+    // a missing stripe fails the whole log
+    remove(fnames[2].c_str());
+    EXPECT_EQ((void*)NULL, lcm_eventlog_create(manifest, "r"));
+
+    remove(manifest);
+    free_tmpnam(manifest);
+    for (int s = 0; s < num_stripes; ++s) {
+        remove(fnames[s].c_str());
+        remove((fnames[s] + LCM_EVENTLOG_INDEX_SUFFIX).c_str());
+    }
+}
+
+static void
+CountFileEvent(const lcm_recv_buf_t* rbuf, const char* channel, void* user) {
+    // slow enough that the dispatch thread falls behind without flow control
+    usleep(50);
+    (*(std::atomic<int>*)user)++;
+}
+
+TEST(LCM_C, FileProviderAfap) {
+    // A log spanning hours plays back as fast as possible with speed=0 or
+    // mode=afap, with or without reading ahead, and flow control keeps a
+    // bounded, threaded subscription from dropping any of it.
+    char* fname = make_tmpnam();
+    const int num_events = 2000;
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    char data[16] = { 0 };
+    lcm_eventlog_event_t event;
+    event.channel = const_cast<char*>("AFAP");
+    event.channellen = strlen(event.channel);
+    event.datalen = sizeof(data);
+    event.data = data;
+    for (int i = 0; i < num_events; ++i) {
+        event.timestamp = (int64_t)i * 10000000;
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    const char* options[] = { "speed=0", "mode=afap",
+        "speed=0&dispatch_threads=1&flow_control=1", "speed=0&read_ahead=8",
+        "mode=afap&read_ahead=1" };
+    for (int n = 0; n < 5; ++n) {
+        std::string url = std::string("file://") + fname + "?" + options[n];
+        lcm_t* lcm = lcm_create(url.c_str());
+        ASSERT_NE((void*)NULL, lcm);
+        std::atomic<int> count(0);
+        lcm_subscription_t* subs = lcm_subscribe(lcm, "AFAP", CountFileEvent,
+                &count);
+        if (n == 2)
+            lcm_subscription_set_queue_capacity(subs, 4);
+        int handled = 0;
+        while (lcm_handle(lcm) == 0)
+            handled++;
+        EXPECT_EQ(num_events, handled);
+
+        lcm_subscription_stats_t stats;
+        for (int i = 0; i < 1000 && count < num_events; ++i)
+            usleep(1000);
+        ASSERT_EQ(0, lcm_subscription_get_stats(subs, &stats));
+        EXPECT_EQ(num_events, count);
+        EXPECT_EQ(0, stats.num_dropped);
+        lcm_destroy(lcm);
+    }
+    free_tmpnam(fname);
+}
+
+static void
+RecordRecvTime(const lcm_recv_buf_t* rbuf, const char* channel, void* user) {
+    ((std::vector<int64_t>*)user)->push_back(rbuf->recv_utime);
+}
+
+TEST(LCM_C, FileProviderChannel) {
+    // With channel=REGEX, only the matching events are played back, with
+    // or without an index, and the gaps between them keep their timing.
+    char* fname = make_tmpnam();
+    std::string idx = std::string(fname) + LCM_EVENTLOG_INDEX_SUFFIX;
+    const int num_events = 3000;
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    char data[1024] = { 0 };
+    lcm_eventlog_event_t event;
+    for (int i = 0; i < num_events; ++i) {
+        // one IMU event every 100 ms among camera frames
+        int imu = i % 100 == 0;
+        event.channel = const_cast<char*>(imu ? "IMU" : "CAMERA");
+        event.channellen = strlen(event.channel);
+        event.datalen = imu ? 16 : sizeof(data);
+        event.data = data;
+        event.timestamp = 1000000 + (int64_t)i * 1000;
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    for (int indexed = 0; indexed < 2; ++indexed) {
+        if (indexed)
+            ASSERT_EQ(0, lcm_eventlog_build_index(fname));
+        std::string url = std::string("file://") + fname +
+            "?speed=100&channel=IMU.%3F";
+        lcm_t* lcm = lcm_create(url.c_str());
+        ASSERT_NE((void*)NULL, lcm);
+        std::vector<int64_t> times;
+        lcm_subscribe(lcm, ".*", RecordRecvTime, &times);
+        while (lcm_handle(lcm) == 0) {
+        }
+        lcm_destroy(lcm);
+
+        ASSERT_EQ((size_t)num_events / 100, times.size());
+        for (size_t i = 1; i < times.size(); ++i)
+            EXPECT_EQ(1000, times[i] - times[i - 1]);
+    }
+    remove(idx.c_str());
+    free_tmpnam(fname);
+}
+
+struct PlayedEvent {
+    std::string channel;
+    std::string data;
+    const char* address;
+};
+
+static void
+RecordEvent(const lcm_recv_buf_t* rbuf, const char* channel, void* user) {
+    PlayedEvent event;
+    event.channel = channel;
+    event.data.assign((const char*)rbuf->data, rbuf->data_size);
+    event.address = (const char*)rbuf->data;
+    ((std::vector<PlayedEvent>*)user)->push_back(event);
+}
+
+#ifndef WIN32
+TEST(LCM_C, FileProviderMmap) {
+    // mmap=1 plays back the same events as reading the log, from the
+    // mapping itself, and reads logs above mmap_limit_mb as usual.
+    char* fname = make_tmpnam();
+    const int num_events = 500;
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    char data[300];
+    lcm_eventlog_event_t event;
+    for (int i = 0; i < num_events; ++i) {
+        event.channel = const_cast<char*>(i % 3 ? "MAPPED" : "MAP");
+        event.channellen = strlen(event.channel);
+        event.datalen = (i * 37) % sizeof(data);
+        for (int j = 0; j < event.datalen; ++j)
+            data[j] = i + j;
+        event.data = data;
+        event.timestamp = (int64_t)i * 1000;
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    const char* options[] = { "speed=0", "speed=0&mmap=1",
+        "speed=0&mmap=1&mmap_limit_mb=0.001" };
+    std::vector<PlayedEvent> played[3];
+    for (int n = 0; n < 3; ++n) {
+        std::string url = std::string("file://") + fname + "?" + options[n];
+        lcm_t* lcm = lcm_create(url.c_str());
+        ASSERT_NE((void*)NULL, lcm);
+        lcm_subscribe(lcm, ".*", RecordEvent, &played[n]);
+        while (lcm_handle(lcm) == 0) {
+        }
+        lcm_destroy(lcm);
+        ASSERT_EQ((size_t)num_events, played[n].size());
+    }
+    for (int i = 0; i < num_events; ++i) {
+        for (int n = 1; n < 3; ++n) {
+            EXPECT_EQ(played[0][i].channel, played[n][i].channel);
+            EXPECT_EQ(played[0][i].data, played[n][i].data);
+        }
+        // mapped events follow each other in memory, with a header and the
+        // channel in between
+        if (i > 0)
+            EXPECT_EQ(played[1][i - 1].address + played[1][i - 1].data.size() +
+                    28 + played[1][i].channel.size(), played[1][i].address);
+    }
+    free_tmpnam(fname);
+}
+#endif
+
+TEST(LCM_C, FileProviderPreloadLoop) {
+    // preload=1 plays back the selected events from memory, and loop=1 plays
+    // them loop_count times, each pass a mean interval after the last.
+    char* fname = make_tmpnam();
+    const int num_events = 300;
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    char data[200];
+    lcm_eventlog_event_t event;
+    for (int i = 0; i < num_events; ++i) {
+        event.channel = const_cast<char*>(i % 3 ? "LOOP" : "SKIP");
+        event.channellen = strlen(event.channel);
+        event.datalen = (i * 37) % sizeof(data);
+        for (int j = 0; j < event.datalen; ++j)
+            data[j] = i + j;
+        event.data = data;
+        event.timestamp = 1000000 + (int64_t)i * 1000;
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    const char* options[] = { "speed=0&channel=LOOP",
+        "speed=0&channel=LOOP&preload=1",
+        "speed=0&channel=LOOP&loop=1&loop_count=3" };
+    std::vector<PlayedEvent> played[3];
+    for (int n = 0; n < 3; ++n) {
+        std::string url = std::string("file://") + fname + "?" + options[n];
+        lcm_t* lcm = lcm_create(url.c_str());
+        ASSERT_NE((void*)NULL, lcm);
+        lcm_subscribe(lcm, ".*", RecordEvent, &played[n]);
+        while (lcm_handle(lcm) == 0) {
+        }
+        lcm_destroy(lcm);
+    }
+    const size_t num_played = num_events * 2 / 3;
+    ASSERT_EQ(num_played, played[0].size());
+    ASSERT_EQ(num_played, played[1].size());
+    ASSERT_EQ(3 * num_played, played[2].size());
+    for (size_t i = 0; i < 3 * num_played; ++i) {
+        if (i < num_played) {
+            EXPECT_EQ(played[0][i].channel, played[1][i].channel);
+            EXPECT_EQ(played[0][i].data, played[1][i].data);
+        }
+        EXPECT_EQ(played[0][i % num_played].data, played[2][i].data);
+        // every pass plays from the same memory
+        EXPECT_EQ(played[2][i % num_played].address, played[2][i].address);
+    }
+
+    // the passes keep the timing of the log, 1 or 2 ms between the events
+    // played, and the mean of those between the passes
+    std::string url = std::string("file://") + fname +
+        "?speed=100&channel=LOOP&loop=1&loop_count=2";
+    lcm_t* lcm = lcm_create(url.c_str());
+    ASSERT_NE((void*)NULL, lcm);
+    std::vector<int64_t> times;
+    lcm_subscribe(lcm, ".*", RecordRecvTime, &times);
+    while (lcm_handle(lcm) == 0) {
+    }
+    lcm_destroy(lcm);
+    ASSERT_EQ(2 * num_played, times.size());
+    for (size_t i = 1; i < times.size(); ++i) {
+        int64_t mean = (298000 / (num_played - 1)) / 100;
+        int64_t gap = i == num_played ? mean : (i % 2 ? 10 : 20);
+        EXPECT_EQ(gap, times[i] - times[i - 1]) << i;
+    }
+    free_tmpnam(fname);
+}
+
+// precise timing is only implemented on Linux
+#ifdef __linux__
+TEST(LCM_C, FileProviderPrecise) {
+    // Precise playback reports the scheduling error of each event but the
+    // first, and is never early.
+    char* fname = make_tmpnam();
+    std::string timing = std::string(fname) + ".timing";
+    const int num_events = 100;
+    lcm_eventlog_t* wlog = lcm_eventlog_create(fname, "w");
+    ASSERT_NE((void*)NULL, wlog);
+    char data[16] = { 0 };
+    lcm_eventlog_event_t event;
+    event.channel = const_cast<char*>("PRECISE");
+    event.channellen = strlen(event.channel);
+    event.datalen = sizeof(data);
+    event.data = data;
+    for (int i = 0; i < num_events; ++i) {
+        event.timestamp = 1000000 + (int64_t)i * 2000;
+        ASSERT_EQ(0, lcm_eventlog_write_event(wlog, &event));
+    }
+    lcm_eventlog_destroy(wlog);
+
+    std::string url = std::string("file://") + fname +
+        "?precise=1&timing_log=" + timing;
+    lcm_t* lcm = lcm_create(url.c_str());
+    ASSERT_NE((void*)NULL, lcm);
+    int handled = 0;
+    while (lcm_handle(lcm) == 0)
+        handled++;
+    EXPECT_EQ(num_events, handled);
+    lcm_destroy(lcm);
+
+    FILE* f = fopen(timing.c_str(), "r");
+    ASSERT_NE((FILE*)NULL, f);
+    char line[256];
+    ASSERT_NE((char*)NULL, fgets(line, sizeof(line), f));
+    EXPECT_EQ('#', line[0]);
+    std::vector<long long> errors;
+    long long timestamp, error;
+    while (fscanf(f, "%lld %lld", &timestamp, &error) == 2) {
+        EXPECT_EQ(1000000 + (long long)(errors.size() + 1) * 2000, timestamp);
+        EXPECT_LE(0, error);
+        errors.push_back(error);
+    }
+    fclose(f);
+    EXPECT_EQ((size_t)num_events - 1, errors.size());
+    remove(timing.c_str());
+    free_tmpnam(fname);
+}
+#endif
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <lcm/lcm.h>
+
+// Each test uses a multicast port and a segment of its own, removed when the
+// test is done.
+class HybridGroup {
+  public:
+    HybridGroup(const char* test, int port) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "test-hybrid-%s-%d", test, (int) getpid());
+        shm = buf;
+        shm_unlink(("/lcm-" + shm).c_str());
+        snprintf(buf, sizeof(buf), "239.255.76.67:%d", port);
+        group = buf;
+    }
+    ~HybridGroup() { shm_unlink(("/lcm-" + shm).c_str()); }
+
+    std::string url(const char* options = "") const {
+        return "hybrid://" + group + "?ttl=0&announce_ms=50&shm=" + shm +
+            options;
+    }
+    std::string udpm_url() const {
+        return "udpm://" + group + "?ttl=0";
+    }
+
+    std::string shm;
+    std::string group;
+};
+
+static void CountHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    (*(int*)user_data)++;
+}
+
+static void HandleFor(lcm_t* lcm, int millis) {
+    for (int i = 0; i < millis / 10; i++)
+        lcm_handle_timeout(lcm, 10);
+}
+
+TEST(LCM_C, HybridLocalDelivery) {
+    // Instances on the same host get each message once, through shared
+    // memory, and nothing goes out on the multicast group.
+    HybridGroup group("local", 7711);
+    lcm_t* pub = lcm_create(group.url().c_str());
+    lcm_t* sub = lcm_create(group.url().c_str());
+    lcm_t* udpm = lcm_create(group.udpm_url().c_str());
+    ASSERT_TRUE(pub != NULL);
+    ASSERT_TRUE(sub != NULL);
+    ASSERT_TRUE(udpm != NULL);
+
+    int num_sub = 0, num_pub = 0, num_udpm = 0, num_interest = 0;
+    lcm_subscribe(sub, "HYBRID", CountHandler, &num_sub);
+    lcm_subscribe(pub, ".*", CountHandler, &num_pub);
+    lcm_subscribe(udpm, "HYBRID", CountHandler, &num_udpm);
+    lcm_subscribe(udpm, "#!lcm_interest", CountHandler, &num_interest);
+
+    // the instances hear each other's announcements, and ignore them
+    HandleFor(udpm, 200);
+    EXPECT_LT(0, num_interest);
+    EXPECT_EQ(1, lcm_has_remote_subscribers(pub, "HYBRID"));
+    EXPECT_EQ(0, lcm_has_remote_subscribers(pub, "NOBODY"));
+    EXPECT_EQ(-1, lcm_has_remote_subscribers(udpm, "HYBRID"));
+
+    for (int i = 0; i < 10; i++)
+        EXPECT_EQ(0, lcm_publish(pub, "HYBRID", "data", 4));
+    while (num_sub < 10 && lcm_handle_timeout(sub, 1000) > 0) {
+    }
+    while (num_pub < 10 && lcm_handle_timeout(pub, 1000) > 0) {
+    }
+    HandleFor(sub, 100);
+    HandleFor(pub, 100);
+    HandleFor(udpm, 100);
+    EXPECT_EQ(10, num_sub);
+    EXPECT_EQ(10, num_pub);
+    EXPECT_EQ(0, num_udpm);
+
+    lcm_destroy(udpm);
+    lcm_destroy(pub);
+    lcm_destroy(sub);
+}
+
+TEST(LCM_C, HybridIgnoresLocalMulticast) {
+    // With udp=always, messages also go out on the group, but the hybrid
+    // instances of the host only take them from shared memory.
+    HybridGroup group("always", 7712);
+    lcm_t* pub = lcm_create(group.url("&udp=always").c_str());
+    lcm_t* sub = lcm_create(group.url().c_str());
+    lcm_t* udpm = lcm_create(group.udpm_url().c_str());
+    ASSERT_TRUE(pub != NULL);
+    ASSERT_TRUE(sub != NULL);
+    ASSERT_TRUE(udpm != NULL);
+
+    int num_sub = 0, num_udpm = 0;
+    lcm_subscribe(sub, "HYBRID", CountHandler, &num_sub);
+    lcm_subscribe(udpm, "HYBRID", CountHandler, &num_udpm);
+
+    EXPECT_EQ(0, lcm_publish(pub, "HYBRID", "data", 4));
+    EXPECT_EQ(0, lcm_publish(udpm, "HYBRID", "data", 4));
+    while (num_udpm < 2 && lcm_handle_timeout(udpm, 1000) > 0) {
+    }
+    HandleFor(sub, 200);
+    EXPECT_EQ(2, num_udpm);
+    EXPECT_EQ(1, num_sub);
+
+    lcm_destroy(udpm);
+    lcm_destroy(pub);
+    lcm_destroy(sub);
+}
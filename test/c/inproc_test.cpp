@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+struct InprocState {
+    lcm_t* lcm;
+    std::vector<std::string> received;
+    std::vector<const void*> data;
+    int publish_status;
+};
+
+static void InprocRecordHandler(const lcm_recv_buf_t* rbuf,
+        const char* channel, void* user_data) {
+    InprocState* state = (InprocState*)user_data;
+    state->received.push_back(std::string(channel) + ":" +
+            std::string((const char*)rbuf->data, rbuf->data_size));
+    state->data.push_back(rbuf->data);
+}
+
+TEST(LCM_C, InprocSynchronous) {
+    // Handlers run inside lcm_publish(), with the publisher's buffer, and
+    // lcm_handle_timeout() never finds anything to handle.
+    lcm_t* lcm = lcm_create("inproc://");
+    ASSERT_TRUE(lcm != NULL);
+    InprocState state;
+    lcm_subscribe(lcm, "A", InprocRecordHandler, &state);
+
+    char buf[] = "hello";
+    EXPECT_EQ(0, lcm_publish(lcm, "A", buf, 5));
+    ASSERT_EQ(1u, state.received.size());
+    EXPECT_EQ("A:hello", state.received[0]);
+    EXPECT_EQ((const void*)buf, state.data[0]);
+
+    EXPECT_EQ(0, lcm_publish(lcm, "B", buf, 5));
+    EXPECT_EQ(1u, state.received.size());
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+    lcm_destroy(lcm);
+}
+
+// publishes "B" from the handler for "A", and "C" from the handler for "B"
+static void InprocChainHandler(const lcm_recv_buf_t* rbuf,
+        const char* channel, void* user_data) {
+    InprocState* state = (InprocState*)user_data;
+    const char* next = !strcmp(channel, "A") ? "B" :
+        !strcmp(channel, "B") ? "C" : NULL;
+    state->received.push_back(std::string("begin ") + channel);
+    if (next)
+        lcm_publish(state->lcm, next, "", 0);
+    state->received.push_back(std::string("end ") + channel);
+}
+
+TEST(LCM_C, InprocNested) {
+    // Without defer, a message published from a handler is dispatched
+    // before that handler returns.
+    InprocState state;
+    state.lcm = lcm_create("inproc://");
+    ASSERT_TRUE(state.lcm != NULL);
+    lcm_subscribe(state.lcm, ".*", InprocChainHandler, &state);
+    EXPECT_EQ(0, lcm_publish(state.lcm, "A", "", 0));
+
+    const char* expected[] = { "begin A", "begin B", "begin C", "end C",
+        "end B", "end A" };
+    EXPECT_EQ(std::vector<std::string>(expected, expected + 6),
+            state.received);
+    lcm_destroy(state.lcm);
+}
+
+TEST(LCM_C, InprocDeferred) {
+    // With defer, it is dispatched once the outermost handlers are done.
+    InprocState state;
+    state.lcm = lcm_create("inproc://?defer=1");
+    ASSERT_TRUE(state.lcm != NULL);
+    lcm_subscribe(state.lcm, ".*", InprocChainHandler, &state);
+    EXPECT_EQ(0, lcm_publish(state.lcm, "A", "", 0));
+
+    const char* expected[] = { "begin A", "end A", "begin B", "end B",
+        "begin C", "end C" };
+    EXPECT_EQ(std::vector<std::string>(expected, expected + 6),
+            state.received);
+    lcm_destroy(state.lcm);
+}
+
+static void InprocLoopHandler(const lcm_recv_buf_t* rbuf,
+        const char* channel, void* user_data) {
+    InprocState* state = (InprocState*)user_data;
+    state->received.push_back(channel);
+    int status = lcm_publish(state->lcm, channel, "", 0);
+    if (status < 0)
+        state->publish_status = status;
+}
+
+TEST(LCM_C, InprocMaxDepth) {
+    // A handler that keeps publishing to itself is stopped at max_depth.
+    InprocState state;
+    state.publish_status = 0;
+    state.lcm = lcm_create("inproc://?max_depth=4");
+    ASSERT_TRUE(state.lcm != NULL);
+    lcm_subscribe(state.lcm, "LOOP", InprocLoopHandler, &state);
+    EXPECT_EQ(0, lcm_publish(state.lcm, "LOOP", "", 0));
+    EXPECT_EQ(4u, state.received.size());
+    EXPECT_EQ(-1, state.publish_status);
+    lcm_destroy(state.lcm);
+}
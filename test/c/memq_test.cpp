@@ -1,9 +1,16 @@
+#include <poll.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
 #include <gtest/gtest.h>
 
 #include <lcm/lcm.h>
 
+#include "common.h"
+
 TEST(LCM_C, MemqConstructDestroy) {
     lcm_t* lcm = lcm_create("memq://");
     EXPECT_TRUE(lcm != NULL);
@@ -113,3 +120,937 @@ TEST(LCM_C, MemqTimeout) {
 
   lcm_destroy(lcm);
 }
+
+struct MemqPatternState {
+    std::vector<int> calls;
+};
+
+struct MemqPatternSubscriber {
+    int id;
+    MemqPatternState* state;
+};
+
+void MemqPatternHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqPatternSubscriber* sub = (MemqPatternSubscriber*)user_data;
+    sub->state->calls.push_back(sub->id);
+}
+
+static std::vector<int> MemqPublishAndHandle(lcm_t* lcm,
+        MemqPatternState* state, const char* channel) {
+    state->calls.clear();
+    lcm_publish(lcm, channel, "", 0);
+    lcm_handle_timeout(lcm, 0);
+    return state->calls;
+}
+
+TEST(LCM_C, MemqSubscribePatterns) {
+    // Literal, prefix and regex subscriptions must all match the same
+    // channels as the equivalent regular expressions, and handlers must be
+    // invoked in subscription order.
+    lcm_t* lcm = lcm_create("memq://");
+    MemqPatternState state;
+    MemqPatternSubscriber subs[] = {
+        { 0, &state }, { 1, &state }, { 2, &state }, { 3, &state },
+        { 4, &state }, { 5, &state },
+    };
+
+    lcm_subscribe(lcm, "POSE_.*", MemqPatternHandler, &subs[0]);
+    lcm_subscribe(lcm, "POSE", MemqPatternHandler, &subs[1]);
+    lcm_subscribe(lcm, "PO.E", MemqPatternHandler, &subs[2]);
+    lcm_subscribe(lcm, ".*", MemqPatternHandler, &subs[3]);
+    lcm_subscribe(lcm, "POSE\\.X", MemqPatternHandler, &subs[4]);
+
+    std::vector<int> expected;
+
+    expected = { 1, 2, 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE"));
+    expected = { 0, 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE_LEFT"));
+    expected = { 0, 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE_"));
+    expected = { 3, 4 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE.X"));
+    expected = { 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSEX"));
+    expected = { 2, 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POKE"));
+
+    // A subscription made after a channel has been seen applies to it too.
+    lcm_subscription_t* late = lcm_subscribe(lcm, "POSE",
+            MemqPatternHandler, &subs[5]);
+    expected = { 1, 2, 3, 5 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE"));
+
+    lcm_unsubscribe(lcm, late);
+    expected = { 1, 2, 3 };
+    EXPECT_EQ(expected, MemqPublishAndHandle(lcm, &state, "POSE"));
+
+    // Invalid regular expressions are rejected.
+    EXPECT_TRUE(lcm_subscribe(lcm, "POSE(", MemqPatternHandler,
+                &subs[5]) == NULL);
+
+    lcm_destroy(lcm);
+}
+
+struct MemqUnsubscribeState {
+    lcm_t* lcm;
+    lcm_subscription_t* victim;
+    int num_first;
+    int num_victim;
+};
+
+void MemqUnsubscribeFirstHandler(const lcm_recv_buf_t* rbuf,
+        const char* channel, void* user_data) {
+    MemqUnsubscribeState* state = (MemqUnsubscribeState*)user_data;
+    state->num_first++;
+    if (state->victim) {
+        lcm_unsubscribe(state->lcm, state->victim);
+        state->victim = NULL;
+    }
+}
+
+void MemqUnsubscribeVictimHandler(const lcm_recv_buf_t* rbuf,
+        const char* channel, void* user_data) {
+    MemqUnsubscribeState* state = (MemqUnsubscribeState*)user_data;
+    state->num_victim++;
+}
+
+TEST(LCM_C, MemqUnsubscribeInHandler) {
+    // A handler unsubscribed by an earlier handler for the same message must
+    // not be invoked, and must be safely released afterwards.
+    lcm_t* lcm = lcm_create("memq://");
+    MemqUnsubscribeState state;
+    state.lcm = lcm;
+    state.num_first = 0;
+    state.num_victim = 0;
+
+    lcm_subscribe(lcm, "channel", MemqUnsubscribeFirstHandler, &state);
+    state.victim = lcm_subscribe(lcm, "chan.*",
+            MemqUnsubscribeVictimHandler, &state);
+
+    lcm_publish(lcm, "channel", "", 0);
+    lcm_publish(lcm, "channel", "", 0);
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 0));
+    EXPECT_LT(0, lcm_handle_timeout(lcm, 0));
+
+    EXPECT_EQ(2, state.num_first);
+    EXPECT_EQ(0, state.num_victim);
+
+    lcm_destroy(lcm);
+}
+
+struct MemqPoolState {
+    std::atomic<int> num_fast;
+    std::atomic<int> num_slow;
+    std::atomic<int> out_of_order;
+    int total;
+};
+
+static int MemqMessageIndex(const lcm_recv_buf_t* rbuf) {
+    int index;
+    memcpy(&index, rbuf->data, sizeof(index));
+    return index;
+}
+
+static bool MemqWaitFor(std::atomic<int>* value, int expected) {
+    for (int i = 0; i < 5000 && *value != expected; ++i) {
+        usleep(1000);
+    }
+    return *value == expected;
+}
+
+void MemqPoolFastHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqPoolState* state = (MemqPoolState*)user_data;
+    if (MemqMessageIndex(rbuf) != state->num_fast) {
+        state->out_of_order++;
+    }
+    state->num_fast++;
+}
+
+void MemqPoolSlowHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqPoolState* state = (MemqPoolState*)user_data;
+    // Block until the other subscription has seen every message.  This only
+    // finishes if the two subscriptions run on different threads.
+    if (MemqMessageIndex(rbuf) == 0) {
+        MemqWaitFor(&state->num_fast, state->total);
+    }
+    if (MemqMessageIndex(rbuf) != state->num_slow) {
+        state->out_of_order++;
+    }
+    state->num_slow++;
+}
+
+TEST(LCM_C, MemqDispatchThreads) {
+    lcm_t* lcm = lcm_create("memq://?dispatch_threads=2");
+    ASSERT_TRUE(lcm != NULL);
+
+    MemqPoolState state;
+    state.num_fast = 0;
+    state.num_slow = 0;
+    state.out_of_order = 0;
+    state.total = 100;
+
+    lcm_subscription_t* fast = lcm_subscribe(lcm, "channel",
+            MemqPoolFastHandler, &state);
+    lcm_subscription_t* slow = lcm_subscribe(lcm, "channel",
+            MemqPoolSlowHandler, &state);
+    lcm_subscription_set_queue_capacity(fast, 0);
+    lcm_subscription_set_queue_capacity(slow, 0);
+
+    for (int i = 0; i < state.total; ++i) {
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+    }
+    for (int i = 0; i < state.total; ++i) {
+        EXPECT_LT(0, lcm_handle_timeout(lcm, 0));
+    }
+
+    EXPECT_TRUE(MemqWaitFor(&state.num_fast, state.total));
+    EXPECT_TRUE(MemqWaitFor(&state.num_slow, state.total));
+    EXPECT_EQ(0, state.out_of_order);
+
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqPollSet) {
+    // A poll set should dispatch messages from every instance it contains.
+    lcm_t* lcm_a = lcm_create("memq://");
+    lcm_t* lcm_b = lcm_create("memq://");
+    lcm_poll_set_t* set = lcm_poll_set_create();
+    ASSERT_TRUE(set != NULL);
+
+    EXPECT_EQ(0, lcm_poll_set_add(set, lcm_a));
+    EXPECT_EQ(0, lcm_poll_set_add(set, lcm_b));
+    EXPECT_GT(0, lcm_poll_set_add(set, lcm_b));
+
+    // No messages available.  Call should timeout.
+    EXPECT_EQ(0, lcm_poll_set_handle_timeout(set, 0));
+    EXPECT_EQ(0, lcm_poll_set_handle_timeout(set, 10));
+    EXPECT_GT(0, lcm_poll_set_handle_timeout(set, -1));
+
+    int handled_a = 0;
+    int handled_b = 0;
+    lcm_subscribe(lcm_a, "channel", MemqTimeoutHandler, &handled_a);
+    lcm_subscribe(lcm_b, "channel", MemqTimeoutHandler, &handled_b);
+
+    lcm_publish(lcm_b, "channel", "", 0);
+    EXPECT_EQ(1, lcm_poll_set_handle_timeout(set, 10000));
+    EXPECT_EQ(0, handled_a);
+    EXPECT_EQ(1, handled_b);
+
+    lcm_publish(lcm_a, "channel", "", 0);
+    lcm_publish(lcm_b, "channel", "", 0);
+    handled_b = 0;
+    EXPECT_EQ(2, lcm_poll_set_handle_timeout(set, 10000));
+    EXPECT_EQ(1, handled_a);
+    EXPECT_EQ(1, handled_b);
+
+    EXPECT_EQ(0, lcm_poll_set_remove(set, lcm_a));
+    EXPECT_GT(0, lcm_poll_set_remove(set, lcm_a));
+    lcm_publish(lcm_a, "channel", "", 0);
+    EXPECT_EQ(0, lcm_poll_set_handle_timeout(set, 0));
+
+    lcm_poll_set_destroy(set);
+    lcm_destroy(lcm_a);
+    lcm_destroy(lcm_b);
+}
+
+struct MemqRetainState {
+    std::vector<lcm_recv_buf_t*> retained;
+    std::vector<const void*> handler_data;
+};
+
+void MemqRetainHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqRetainState* state = (MemqRetainState*)user_data;
+    state->retained.push_back(lcm_recv_buf_retain(rbuf));
+    state->handler_data.push_back(rbuf->data);
+}
+
+TEST(LCM_C, MemqRetainBuffer) {
+    // Retained buffers should outlive their handlers, and two subscriptions
+    // retaining the same message should share its storage.
+    lcm_t* lcm = lcm_create("memq://");
+    MemqRetainState state;
+
+    lcm_subscribe(lcm, "channel", MemqRetainHandler, &state);
+    lcm_subscribe(lcm, "channel", MemqRetainHandler, &state);
+
+    const int num_msgs = 5;
+    for (int i = 0; i < num_msgs; ++i) {
+        std::vector<uint8_t> buf(1000, i);
+        lcm_publish(lcm, "channel", &buf[0], buf.size());
+        lcm_handle(lcm);
+    }
+
+    ASSERT_EQ(2 * num_msgs, (int)state.retained.size());
+    for (int i = 0; i < num_msgs; ++i) {
+        std::vector<uint8_t> expected(1000, i);
+        for (int j = 2 * i; j < 2 * i + 2; ++j) {
+            lcm_recv_buf_t* rbuf = state.retained[j];
+            EXPECT_EQ(state.handler_data[j], rbuf->data);
+            ASSERT_EQ(expected.size(), rbuf->data_size);
+            EXPECT_EQ(0, memcmp(&expected[0], rbuf->data, rbuf->data_size));
+        }
+    }
+
+    // a retained buffer can itself be retained
+    lcm_recv_buf_t* again = lcm_recv_buf_retain(state.retained[0]);
+    EXPECT_EQ(state.retained[0]->data, again->data);
+
+    lcm_destroy(lcm);
+
+    for (size_t i = 0; i < state.retained.size(); ++i) {
+        lcm_recv_buf_release(state.retained[i]);
+    }
+    EXPECT_EQ(0, ((uint8_t*)again->data)[999]);
+    lcm_recv_buf_release(again);
+}
+
+TEST(LCM_C, MemqPublishReserve) {
+    // Messages encoded into reserved buffers should be published intact, and
+    // cancelled buffers should not be published at all.
+    lcm_t* lcm = lcm_create("memq://");
+    std::vector<std::vector<uint8_t> > received_buffers;
+    lcm_subscribe(lcm, "channel", MemqBufferedHandler, &received_buffers);
+
+    char long_channel[LCM_MAX_CHANNEL_NAME_LENGTH + 2];
+    memset(long_channel, 'x', sizeof(long_channel) - 1);
+    long_channel[sizeof(long_channel) - 1] = 0;
+    EXPECT_TRUE(lcm_publish_reserve(lcm, long_channel, 10) == NULL);
+
+    std::vector<std::vector<uint8_t> > buffers;
+    for (int i = 0; i < 10; ++i) {
+        uint8_t* buf = (uint8_t*)lcm_publish_reserve(lcm, "channel", 100 * i + 1);
+        ASSERT_TRUE(buf != NULL);
+        if (i == 5) {
+            lcm_publish_cancel(lcm, buf);
+            continue;
+        }
+        // publish less than what was reserved
+        std::vector<uint8_t> expected(50 * i + 1, i);
+        memcpy(buf, &expected[0], expected.size());
+        EXPECT_EQ(0, lcm_publish_commit(lcm, buf, expected.size()));
+        buffers.push_back(expected);
+    }
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+
+    EXPECT_EQ(buffers, received_buffers);
+    lcm_destroy(lcm);
+}
+
+struct MemqConflateState {
+    std::atomic<int> entered;
+    std::atomic<int> released;
+    std::atomic<int> num_seen;
+    std::vector<int> seen;
+};
+
+void MemqConflateHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqConflateState* state = (MemqConflateState*)user_data;
+    state->entered = 1;
+    MemqWaitFor(&state->released, 1);
+    state->seen.push_back(MemqMessageIndex(rbuf));
+    state->num_seen++;
+}
+
+TEST(LCM_C, MemqConflate) {
+    // While the handler is busy, a conflating subscription should keep only
+    // the newest message.
+    lcm_t* lcm = lcm_create("memq://?dispatch_threads=1");
+    ASSERT_TRUE(lcm != NULL);
+
+    MemqConflateState state;
+    state.entered = 0;
+    state.released = 0;
+    state.num_seen = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqConflateHandler, &state);
+    EXPECT_EQ(0, lcm_subscription_set_conflate(subs, 1));
+
+    const int num_msgs = 10;
+    for (int i = 0; i < num_msgs; ++i) {
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+        EXPECT_EQ(1, lcm_handle_timeout(lcm, 0));
+        if (i == 0) {
+            EXPECT_TRUE(MemqWaitFor(&state.entered, 1));
+        }
+    }
+
+    state.released = 1;
+    EXPECT_TRUE(MemqWaitFor(&state.num_seen, 2));
+    usleep(10000);
+    ASSERT_EQ(2, (int)state.seen.size());
+    EXPECT_EQ(0, state.seen[0]);
+    EXPECT_EQ(num_msgs - 1, state.seen[1]);
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 2, stats.num_dropped);
+    EXPECT_EQ(2, stats.num_dispatched);
+
+    lcm_destroy(lcm);
+}
+
+static void MemqIndexHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user) {
+    ((std::vector<int>*) user)->push_back(MemqMessageIndex(rbuf));
+}
+
+TEST(LCM_C, MemqConflateHandle) {
+    // Without dispatch threads, the messages published before lcm_handle()
+    // gets to them are skipped for the newest one.
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_TRUE(lcm != NULL);
+
+    MemqConflateState state;
+    state.entered = 0;
+    state.released = 1;
+    state.num_seen = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqConflateHandler, &state);
+    EXPECT_EQ(0, lcm_subscription_set_conflate(subs, 1));
+    std::vector<int> fifo;
+    lcm_subscription_t* other = lcm_subscribe(lcm, "channel",
+            MemqIndexHandler, &fifo);
+
+    const int num_msgs = 10;
+    for (int i = 0; i < num_msgs; ++i)
+        lcm_publish(lcm, "channel", &i, sizeof(i));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    ASSERT_EQ(1, (int)state.seen.size());
+    EXPECT_EQ(num_msgs - 1, state.seen[0]);
+    // a subscription that does not conflate still gets all of them
+    EXPECT_EQ(num_msgs, (int)fifo.size());
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(subs, &stats);
+    EXPECT_EQ(num_msgs - 1, stats.num_dropped);
+    EXPECT_EQ(1, stats.num_dispatched);
+
+    // once it has caught up, the next message is delivered as usual
+    int next = num_msgs;
+    lcm_publish(lcm, "channel", &next, sizeof(next));
+    EXPECT_EQ(1, lcm_handle_timeout(lcm, 0));
+    ASSERT_EQ(2, (int)state.seen.size());
+    EXPECT_EQ(next, state.seen[1]);
+
+    lcm_unsubscribe(lcm, other);
+    lcm_destroy(lcm);
+}
+
+struct MemqPriorityState {
+    std::atomic<int> entered;
+    std::atomic<int> released;
+    std::atomic<int> num_seen;
+    std::vector<std::string> seen;
+};
+
+void MemqPriorityHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqPriorityState* state = (MemqPriorityState*)user_data;
+    if (!strcmp(channel, "hold")) {
+        state->entered = 1;
+        MemqWaitFor(&state->released, 1);
+    }
+    state->seen.push_back(channel);
+    state->num_seen++;
+}
+
+TEST(LCM_C, MemqPriority) {
+    // Once the dispatch thread is free again, the subscription with the
+    // higher priority should run before the messages queued ahead of it.
+    lcm_t* lcm = lcm_create("memq://?dispatch_threads=1");
+    ASSERT_TRUE(lcm != NULL);
+
+    MemqPriorityState state;
+    state.entered = 0;
+    state.released = 0;
+    state.num_seen = 0;
+    lcm_subscribe(lcm, "hold", MemqPriorityHandler, &state);
+    lcm_subscribe(lcm, "bulk", MemqPriorityHandler, &state);
+    lcm_subscription_t* urgent = lcm_subscribe(lcm, "urgent",
+            MemqPriorityHandler, &state);
+    EXPECT_EQ(0, lcm_subscription_set_priority(urgent, 1));
+
+    int i = 0;
+    lcm_publish(lcm, "hold", &i, sizeof(i));
+    EXPECT_EQ(1, lcm_handle_timeout(lcm, 0));
+    EXPECT_TRUE(MemqWaitFor(&state.entered, 1));
+
+    const int num_bulk = 5;
+    for (i = 0; i < num_bulk; ++i) {
+        lcm_publish(lcm, "bulk", &i, sizeof(i));
+        EXPECT_EQ(1, lcm_handle_timeout(lcm, 0));
+    }
+    lcm_publish(lcm, "urgent", &i, sizeof(i));
+    EXPECT_EQ(1, lcm_handle_timeout(lcm, 0));
+
+    state.released = 1;
+    EXPECT_TRUE(MemqWaitFor(&state.num_seen, num_bulk + 2));
+    ASSERT_EQ(num_bulk + 2, (int)state.seen.size());
+    EXPECT_EQ("hold", state.seen[0]);
+    EXPECT_EQ("urgent", state.seen[1]);
+    for (i = 2; i < num_bulk + 2; ++i)
+        EXPECT_EQ("bulk", state.seen[i]);
+
+    lcm_destroy(lcm);
+}
+
+static void MemqHoldTxHook(const char* thread_name, void* user_data) {
+    if (!strcmp(thread_name, "lcm-tx"))
+        MemqWaitFor((std::atomic<int>*)user_data, 1);
+}
+
+static int MemqWaitForQueueEmpty(lcm_t* lcm) {
+    lcm_publish_queue_stats_t stats;
+    for (int i = 0; i < 5000; ++i) {
+        if (lcm_get_publish_queue_stats(lcm, &stats) < 0)
+            return -1;
+        if (!stats.num_queued)
+            return 0;
+        usleep(1000);
+    }
+    return -1;
+}
+
+TEST(LCM_C, MemqAsyncTx) {
+    lcm_t* lcm = lcm_create("memq://");
+    lcm_publish_queue_stats_t stats;
+    EXPECT_EQ(-1, lcm_get_publish_queue_stats(lcm, &stats));
+    lcm_destroy(lcm);
+
+    // hold the transmit thread back so that the queue fills up
+    std::atomic<int> released(0);
+    lcm_set_thread_hook(MemqHoldTxHook, &released);
+    lcm = lcm_create("memq://?async_tx=1&tx_queue_mb=1");
+    ASSERT_TRUE(lcm != NULL);
+    std::vector<std::vector<uint8_t> > received_buffers;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqBufferedHandler, &received_buffers);
+    lcm_subscription_set_queue_capacity(subs, 0);
+
+    std::vector<uint8_t> big(400000, 1);
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", &big[0], big.size()));
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", &big[0], big.size()));
+    EXPECT_EQ(-1, lcm_publish(lcm, "channel", &big[0], big.size()));
+    EXPECT_EQ(0, lcm_get_publish_queue_stats(lcm, &stats));
+    EXPECT_EQ(2, stats.num_queued);
+    EXPECT_EQ(800000, stats.queued_bytes);
+    EXPECT_EQ(1, stats.num_dropped);
+
+    // reserved buffers are queued as they are
+    uint8_t* buf = (uint8_t*)lcm_publish_reserve(lcm, "channel", 100);
+    ASSERT_TRUE(buf != NULL);
+    std::vector<uint8_t> small(50, 2);
+    memcpy(buf, &small[0], small.size());
+    EXPECT_EQ(0, lcm_publish_commit(lcm, buf, small.size()));
+
+    released = 1;
+    EXPECT_EQ(0, MemqWaitForQueueEmpty(lcm));
+    lcm_set_thread_hook(NULL, NULL);
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    ASSERT_EQ(3u, received_buffers.size());
+    EXPECT_EQ(big, received_buffers[0]);
+    EXPECT_EQ(big, received_buffers[1]);
+    EXPECT_EQ(small, received_buffers[2]);
+
+    EXPECT_EQ(0, lcm_get_publish_queue_stats(lcm, &stats));
+    EXPECT_EQ(0, stats.queued_bytes);
+    EXPECT_EQ(800050, stats.max_queued_bytes);
+    EXPECT_EQ(3, stats.num_transmitted);
+    EXPECT_EQ(0, stats.num_failed);
+    lcm_destroy(lcm);
+
+    // with the block policy, publishing waits for room instead
+    lcm = lcm_create("memq://?async_tx=1&tx_queue_mb=1&tx_queue_policy=block");
+    ASSERT_TRUE(lcm != NULL);
+    received_buffers.clear();
+    subs = lcm_subscribe(lcm, "channel", MemqBufferedHandler,
+            &received_buffers);
+    lcm_subscription_set_queue_capacity(subs, 0);
+    for (int i = 0; i < 10; ++i)
+        EXPECT_EQ(0, lcm_publish(lcm, "channel", &big[0], big.size()));
+    EXPECT_EQ(0, MemqWaitForQueueEmpty(lcm));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    EXPECT_EQ(10u, received_buffers.size());
+    EXPECT_EQ(0, lcm_get_publish_queue_stats(lcm, &stats));
+    EXPECT_EQ(0, stats.num_dropped);
+    EXPECT_LE(stats.max_queued_bytes, 1024 * 1024);
+    lcm_destroy(lcm);
+}
+
+struct MemqZeroCopyState {
+    std::vector<const void*> handler_data;
+    std::vector<lcm_recv_buf_t*> retained;
+};
+
+void MemqZeroCopyHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqZeroCopyState* state = (MemqZeroCopyState*)user_data;
+    state->handler_data.push_back(rbuf->data);
+    if (rbuf->data_size && ((const uint8_t*)rbuf->data)[0] == 1)
+        state->retained.push_back(lcm_recv_buf_retain(rbuf));
+}
+
+TEST(LCM_C, MemqZeroCopy) {
+    // With zero_copy, handlers see the reserved buffers themselves, and can
+    // retain them past the end of the handler.
+    lcm_t* lcm = lcm_create("memq://?zero_copy=1");
+    ASSERT_TRUE(lcm != NULL);
+    MemqZeroCopyState state;
+    lcm_subscribe(lcm, "channel", MemqZeroCopyHandler, &state);
+
+    std::vector<void*> reserved;
+    for (int i = 0; i < 3; ++i) {
+        uint8_t* buf = (uint8_t*)lcm_publish_reserve(lcm, "channel", 1000);
+        ASSERT_TRUE(buf != NULL);
+        memset(buf, i, 1000);
+        reserved.push_back(buf);
+        EXPECT_EQ(0, lcm_publish_commit(lcm, buf, 1000));
+    }
+    // plain lcm_publish still copies
+    std::vector<uint8_t> copied(10, 3);
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", &copied[0], copied.size()));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+
+    ASSERT_EQ(4u, state.handler_data.size());
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(reserved[i], state.handler_data[i]);
+    EXPECT_NE((const void*)&copied[0], state.handler_data[3]);
+
+    // with no subscribers, the buffer goes back to the caller
+    uint8_t* unused = (uint8_t*)lcm_publish_reserve(lcm, "nobody", 10);
+    EXPECT_EQ(0, lcm_publish_commit(lcm, unused, 10));
+
+    lcm_destroy(lcm);
+    ASSERT_EQ(1u, state.retained.size());
+    EXPECT_EQ(reserved[1], state.retained[0]->data);
+    EXPECT_EQ(std::vector<uint8_t>(1000, 1),
+            std::vector<uint8_t>((uint8_t*)state.retained[0]->data,
+                (uint8_t*)state.retained[0]->data + 1000));
+    lcm_recv_buf_release(state.retained[0]);
+}
+
+#define MEMQ_THREAD_MSGS 5000
+
+struct MemqThreadsReceived {
+    int next[4];
+    int out_of_order;
+    int num_received;
+};
+
+struct MemqThreadsPublisher {
+    lcm_t* lcm;
+    int thread_no;
+};
+
+static void* MemqThreadsPublish(void* user_data) {
+    MemqThreadsPublisher* pub = (MemqThreadsPublisher*)user_data;
+    for (int i = 0; i < MEMQ_THREAD_MSGS; ++i) {
+        int data[2] = { pub->thread_no, i };
+        lcm_publish(pub->lcm, "channel", data, sizeof(data));
+    }
+    return NULL;
+}
+
+void MemqThreadsHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    MemqThreadsReceived* received = (MemqThreadsReceived*)user_data;
+    int data[2];
+    memcpy(data, rbuf->data, sizeof(data));
+    if (data[1] != received->next[data[0]])
+        received->out_of_order++;
+    received->next[data[0]] = data[1] + 1;
+    received->num_received++;
+}
+
+TEST(LCM_C, MemqPublishThreads) {
+    // Messages published from several threads at once should all arrive,
+    // each thread's in the order it published them.
+    lcm_t* lcm = lcm_create("memq://");
+    MemqThreadsReceived received;
+    memset(&received, 0, sizeof(received));
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqThreadsHandler, &received);
+    lcm_subscription_set_queue_capacity(subs, 4 * MEMQ_THREAD_MSGS);
+
+    pthread_t threads[4];
+    MemqThreadsPublisher pubs[4];
+    for (int i = 0; i < 4; ++i) {
+        pubs[i].lcm = lcm;
+        pubs[i].thread_no = i;
+        pthread_create(&threads[i], NULL, MemqThreadsPublish, &pubs[i]);
+    }
+    while (received.num_received < 4 * MEMQ_THREAD_MSGS &&
+            lcm_handle_timeout(lcm, 1000) > 0) {
+    }
+    for (int i = 0; i < 4; ++i)
+        pthread_join(threads[i], NULL);
+    EXPECT_EQ(4 * MEMQ_THREAD_MSGS, received.num_received);
+    EXPECT_EQ(0, received.out_of_order);
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+    lcm_destroy(lcm);
+}
+
+static void MemqTypedHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        const lcmtest_primitives_list_t* msg, void* user_data) {
+    int* expected = (int*)user_data;
+    EXPECT_TRUE(check_lcmtest_primitives_list_t(msg, *expected));
+    *expected = -1;
+}
+
+TEST(LCM_C, MemqTypedSubscribe) {
+    // The generated handler stub decodes into storage that it keeps across
+    // messages, which has to work as messages grow and shrink.
+    lcm_t* lcm = lcm_create("memq://");
+    int expected = 0;
+    lcmtest_primitives_list_t_subscription_t* subs =
+        lcmtest_primitives_list_t_subscribe(lcm, "channel", MemqTypedHandler,
+                &expected);
+    const int sizes[] = {20, 3, 60, 0, 60, 7};
+    for (int i = 0; i < 6; ++i) {
+        lcmtest_primitives_list_t msg;
+        fill_lcmtest_primitives_list_t(sizes[i], &msg);
+        EXPECT_EQ(0, lcmtest_primitives_list_t_publish(lcm, "channel", &msg));
+        clear_lcmtest_primitives_list_t(&msg);
+        expected = sizes[i];
+        EXPECT_EQ(0, lcm_handle(lcm));
+        EXPECT_EQ(-1, expected);
+    }
+    EXPECT_EQ(0, lcmtest_primitives_list_t_unsubscribe(lcm, subs));
+    lcm_destroy(lcm);
+}
+
+static void MemqStreamHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    int* num_received = (int*)user_data;
+    if (rbuf->data_size == 10 && !memcmp(rbuf->data, "0123456789", 10))
+        (*num_received)++;
+}
+
+TEST(LCM_C, MemqPublishStream) {
+    // providers that can't stream collect the message in a buffer
+    lcm_t* lcm = lcm_create("memq://");
+    int num_received = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqStreamHandler, &num_received);
+    lcm_publish_stream_t* stream = lcm_publish_stream_begin(lcm, "channel", 10);
+    ASSERT_TRUE(stream != NULL);
+    EXPECT_EQ(0, lcm_publish_stream_write(stream, "0123", 4));
+    EXPECT_EQ(0, lcm_publish_stream_write(stream, "456789", 6));
+    EXPECT_EQ(0, lcm_publish_stream_end(stream));
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(1, num_received);
+
+    stream = lcm_publish_stream_begin(lcm, "channel", 10);
+    ASSERT_TRUE(stream != NULL);
+    EXPECT_EQ(-1, lcm_publish_stream_write(stream, "0123456789x", 11));
+    lcm_publish_stream_cancel(stream);
+    EXPECT_EQ(0, lcm_handle_timeout(lcm, 0));
+    lcm_unsubscribe(lcm, subs);
+    lcm_destroy(lcm);
+}
+
+static void MemqCountHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    (*(int*)user_data)++;
+}
+
+TEST(LCM_C, MemqStats) {
+    lcm_t* lcm = lcm_create("memq://");
+    int num_received = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqCountHandler, &num_received);
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(0, lcm_publish(lcm, "channel", "0123456789", 10));
+
+    lcm_stats_t stats;
+    EXPECT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(3, stats.num_published);
+    EXPECT_EQ(30, stats.bytes_published);
+    EXPECT_EQ(0, stats.num_publish_failed);
+    EXPECT_EQ(0, stats.num_received);
+    EXPECT_EQ(0, stats.num_dropped_queue_full);
+    EXPECT_EQ(0, stats.has_publish_queue_stats);
+
+    EXPECT_EQ(3, lcm_handle_batch(lcm, 10, 0));
+    EXPECT_EQ(3, num_received);
+    EXPECT_EQ(0, lcm_get_stats(lcm, &stats));
+    EXPECT_EQ(3, stats.num_received);
+    EXPECT_EQ(30, stats.bytes_received);
+    EXPECT_EQ(0, stats.num_queued);
+    EXPECT_EQ(1, stats.num_wakeups);
+    lcm_unsubscribe(lcm, subs);
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqStatsInterval) {
+    lcm_t* lcm = lcm_create("memq://?stats_interval=10");
+    int num_reports = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, LCM_STATS_CHANNEL,
+            MemqCountHandler, &num_reports);
+    for (int i = 0; i < 100 && num_reports < 2; ++i)
+        lcm_handle_timeout(lcm, 100);
+    EXPECT_LE(2, num_reports);
+
+    // a report is counted as published only after memq has queued it, so
+    // the counter may trail the handler for a moment
+    lcm_stats_t stats;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(0, lcm_get_stats(lcm, &stats));
+        if (stats.num_published >= 2)
+            break;
+        usleep(1000);
+    }
+    EXPECT_LE(2, stats.num_published);
+    lcm_unsubscribe(lcm, subs);
+    lcm_destroy(lcm);
+}
+
+static void MemqSleepHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    usleep(*(int*)user_data);
+}
+
+static void MemqSlowHandlerCallback(lcm_subscription_t* subs,
+        const char* channel, int64_t handler_time_usec, void* user_data) {
+    EXPECT_STREQ("channel", channel);
+    EXPECT_LE(50000, handler_time_usec);
+    (*(int*)user_data)++;
+}
+
+TEST(LCM_C, MemqSlowHandler) {
+    // The threshold is far above scheduler jitter, but a loaded host may
+    // still stall the fast call past it, so only the slow one is certain.
+    lcm_t* lcm = lcm_create("memq://");
+    int sleep_usec = 0;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "channel",
+            MemqSleepHandler, &sleep_usec);
+    int num_slow = 0;
+    EXPECT_EQ(-1, lcm_set_slow_handler_threshold(lcm, -1, NULL, NULL));
+    EXPECT_EQ(0, lcm_set_slow_handler_threshold(lcm, 50000,
+                MemqSlowHandlerCallback, &num_slow));
+
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "x", 1));
+    EXPECT_EQ(1, lcm_handle_batch(lcm, 10, 0));
+    sleep_usec = 200000;
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "x", 1));
+    EXPECT_EQ(1, lcm_handle_batch(lcm, 10, 0));
+    EXPECT_LE(1, num_slow);
+
+    lcm_subscription_stats_t stats;
+    EXPECT_EQ(0, lcm_subscription_get_stats(subs, &stats));
+    EXPECT_EQ(num_slow, stats.num_slow);
+    EXPECT_LE(200000, stats.max_handler_time_usec);
+    int64_t total = 0;
+    for (int i = 0; i < LCM_HANDLER_HISTOGRAM_BUCKETS; ++i)
+        total += stats.handler_time_histogram[i];
+    EXPECT_EQ(2, total);
+    // 200000 us or more takes at least 18 bits
+    int64_t slow_bucket = 0;
+    for (int i = 18; i < LCM_HANDLER_HISTOGRAM_BUCKETS; ++i)
+        slow_bucket += stats.handler_time_histogram[i];
+    EXPECT_LE(1, slow_bucket);
+
+    // no more reports once disabled
+    int num_slow_before = num_slow;
+    EXPECT_EQ(0, lcm_set_slow_handler_threshold(lcm, 0, NULL, NULL));
+    sleep_usec = 60000;
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "x", 1));
+    EXPECT_EQ(1, lcm_handle_batch(lcm, 10, 0));
+    EXPECT_EQ(num_slow_before, num_slow);
+    EXPECT_EQ(0, lcm_subscription_get_stats(subs, &stats));
+    EXPECT_EQ(num_slow_before, stats.num_slow);
+    lcm_unsubscribe(lcm, subs);
+    lcm_destroy(lcm);
+}
+
+TEST(LCM_C, MemqMaxRate) {
+    // A rate-limited subscription skips the messages that come too soon
+    // after the last one it took, without affecting the others.
+    lcm_t* lcm = lcm_create("memq://");
+    ASSERT_TRUE(lcm != NULL);
+    int num_all = 0, num_limited = 0;
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &num_all);
+    lcm_subscription_t* limited = lcm_subscribe(lcm, "channel",
+            MemqCountHandler, &num_limited);
+    EXPECT_EQ(0, lcm_subscription_set_max_rate(limited, 5));
+
+    const int num_msgs = 50;
+    for (int i = 0; i < num_msgs; ++i)
+        EXPECT_EQ(0, lcm_publish(lcm, "channel", &i, sizeof(i)));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    EXPECT_EQ(num_msgs, num_all);
+    EXPECT_EQ(1, num_limited);
+
+    lcm_subscription_stats_t stats;
+    lcm_subscription_get_stats(limited, &stats);
+    EXPECT_EQ(num_msgs - 1, stats.num_decimated);
+    EXPECT_EQ(1, stats.num_enqueued);
+    EXPECT_EQ(0, stats.num_dropped);
+
+    // the next one is taken once the interval has passed
+    usleep(250000);
+    EXPECT_EQ(0, lcm_publish(lcm, "channel", "x", 1));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    EXPECT_EQ(2, num_limited);
+
+    // and every one again once the limit is lifted
+    EXPECT_EQ(0, lcm_subscription_set_max_rate(limited, 0));
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(0, lcm_publish(lcm, "channel", "x", 1));
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    EXPECT_EQ(5, num_limited);
+    lcm_destroy(lcm);
+}
+
+static int MemqReadable(lcm_t* lcm) {
+    struct pollfd pfd;
+    pfd.fd = lcm_get_fileno(lcm);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0);
+}
+
+TEST(LCM_C, MemqNotifyReadable) {
+    // The descriptor should be readable exactly while messages are queued,
+    // however lcm_handle() takes them.
+    lcm_t* lcm = lcm_create("memq://");
+    int msg_handled = 0;
+    lcm_subscribe(lcm, "channel", MemqCountHandler, &msg_handled);
+    EXPECT_EQ(0, MemqReadable(lcm));
+
+    for (int i = 0; i < 3; i++)
+        lcm_publish(lcm, "channel", "", 0);
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(1, MemqReadable(lcm));
+        EXPECT_EQ(0, lcm_handle(lcm));
+    }
+    EXPECT_EQ(0, MemqReadable(lcm));
+    EXPECT_EQ(3, msg_handled);
+
+    lcm_publish(lcm, "channel", "", 0);
+    EXPECT_EQ(1, MemqReadable(lcm));
+    EXPECT_EQ(0, lcm_handle(lcm));
+    EXPECT_EQ(0, MemqReadable(lcm));
+
+    for (int i = 0; i < 3; i++)
+        lcm_publish(lcm, "channel", "", 0);
+    EXPECT_EQ(3, lcm_handle_batch(lcm, 10, 0));
+    EXPECT_EQ(0, MemqReadable(lcm));
+    EXPECT_EQ(7, msg_handled);
+
+    lcm_destroy(lcm);
+}
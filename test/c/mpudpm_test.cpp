@@ -0,0 +1,274 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+static void count_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user_data) {
+  (*(int*) user_data)++;
+}
+
+// the port that mpudpm maps a channel to before anything moves it
+static int port_index(const std::string& channel, int nports) {
+  uint32_t hash = 5381;
+  for (size_t i = 0; i < channel.size(); i++)
+    hash += (hash << 5) + channel[i];
+  return hash % nports;
+}
+
+// a channel name starting with prefix that maps to port start + index
+static std::string channel_on_port(const char* prefix, int index,
+    int nports) {
+  for (int i = 0;; i++) {
+    std::string channel = prefix + std::to_string(i);
+    if (port_index(channel, nports) == index)
+      return channel;
+  }
+}
+
+// listens to the group on one port like a receiver would
+static int open_group_socket(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    return -1;
+  int opt = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  struct timeval timeout = { 0, 100000 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(port);
+  struct ip_mreq mreq;
+  mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+  mreq.imr_interface.s_addr = INADDR_ANY;
+  if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+        sizeof(mreq)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// the channels of the unfragmented messages that arrived on the socket,
+// until it stays quiet for a while or with MSG_DONTWAIT, until it has none
+// queued
+static std::vector<std::string> read_group_channels(int fd, int flags) {
+  std::vector<std::string> channels;
+  char pkt[65536];
+  ssize_t sz;
+  while ((sz = recv(fd, pkt, sizeof(pkt) - 1, flags)) > 0) {
+    uint32_t magic;
+    memcpy(&magic, pkt, sizeof(magic));
+    if (sz <= 8 || ntohl(magic) != 0x4c433032)
+      continue;
+    pkt[sz] = 0;
+    channels.push_back(pkt + 8);
+  }
+  return channels;
+}
+
+TEST(LCM_C, MpudpmPortPolicyLoad) {
+  // Two busy channels that hash to the same port.  The publisher measures
+  // their rates and moves one of them to the idle third port, and a
+  // receiver that hashes its channels follows it there.
+  const int nports = 3;
+  std::string first = channel_on_port("MPUDPM_LOAD_", 1, nports);
+  std::string second = channel_on_port(first.c_str(), 1, nports);
+  lcm_t* publisher = lcm_create(
+      "mpudpm://239.255.76.67:7750?ttl=0&nports=3&port_policy=load");
+  ASSERT_TRUE(publisher != NULL);
+  lcm_t* receiver = lcm_create("mpudpm://239.255.76.67:7750?ttl=0&nports=3");
+  ASSERT_TRUE(receiver != NULL);
+  int num_first = 0, num_second = 0;
+  lcm_subscription_t* first_subs = lcm_subscribe(receiver, first.c_str(),
+      count_handler, &num_first);
+  lcm_subscription_t* second_subs = lcm_subscribe(receiver, second.c_str(),
+      count_handler, &num_second);
+  int fd = open_group_socket(7752);
+  ASSERT_GE(fd, 0);
+
+  // 1000 bytes every 5 ms on each channel is 200 kB/s, above the rate at
+  // which channels are moved.  The loads are compared every 5 s or so.
+  char data[1000] = { 0 };
+  std::string moved;
+  for (int i = 0; i < 2000 && moved.empty(); i++) {
+    lcm_publish(publisher, first.c_str(), data, sizeof(data));
+    lcm_publish(publisher, second.c_str(), data, sizeof(data));
+    usleep(5000);
+    while (lcm_handle_timeout(receiver, 0) > 0) {
+    }
+    std::vector<std::string> channels = read_group_channels(fd,
+        MSG_DONTWAIT);
+    for (size_t j = 0; j < channels.size(); j++) {
+      if (channels[j] == first || channels[j] == second)
+        moved = channels[j];
+    }
+  }
+  ASSERT_FALSE(moved.empty());
+  EXPECT_LT(0, num_first);
+  EXPECT_LT(0, num_second);
+
+  // only one of them moves, since that already halves the load of both
+  // ports, and the receiver still gets every message on both channels
+  int start_first = num_first, start_second = num_second;
+  for (int i = 0; i < 10; i++) {
+    lcm_publish(publisher, first.c_str(), data, sizeof(data));
+    lcm_publish(publisher, second.c_str(), data, sizeof(data));
+    usleep(5000);
+  }
+  while ((num_first < start_first + 10 || num_second < start_second + 10) &&
+      lcm_handle_timeout(receiver, 1000) > 0) {
+  }
+  EXPECT_EQ(start_first + 10, num_first);
+  EXPECT_EQ(start_second + 10, num_second);
+  std::vector<std::string> channels = read_group_channels(fd, 0);
+  EXPECT_EQ(10u, channels.size());
+  EXPECT_EQ(10, std::count(channels.begin(), channels.end(), moved));
+  close(fd);
+
+  lcm_unsubscribe(receiver, first_subs);
+  lcm_unsubscribe(receiver, second_subs);
+  lcm_destroy(receiver);
+  lcm_destroy(publisher);
+}
+
+static bool has_channel(const std::vector<std::string>& channels,
+    const char* channel) {
+  return std::find(channels.begin(), channels.end(), channel) !=
+    channels.end();
+}
+
+TEST(LCM_C, MpudpmMapDeltas) {
+  // the internal channels are all on the first port
+  int fd = open_group_socket(7740);
+  ASSERT_GE(fd, 0);
+  lcm_t* publisher = lcm_create("mpudpm://239.255.76.67:7740?ttl=0&nports=2");
+  ASSERT_TRUE(publisher != NULL);
+  read_group_channels(fd, 0);
+
+  // a new channel is announced on its own, without the whole map, and only
+  // the first time it is published
+  char data[100] = { 0 };
+  lcm_publish(publisher, "MPUDPM_DELTA_OLD", data, sizeof(data));
+  std::vector<std::string> channels = read_group_channels(fd, 0);
+  EXPECT_TRUE(has_channel(channels, "#!mpudpm_CH2PRT_DLT"));
+  EXPECT_FALSE(has_channel(channels, "#!mpudpm_CH2PRT_UPD"));
+  lcm_publish(publisher, "MPUDPM_DELTA_OLD", data, sizeof(data));
+  channels = read_group_channels(fd, 0);
+  EXPECT_FALSE(has_channel(channels, "#!mpudpm_CH2PRT_DLT"));
+  EXPECT_FALSE(has_channel(channels, "#!mpudpm_CH2PRT_UPD"));
+
+  // a regex subscriber that comes later asks for the whole map, and learns
+  // the ports of the channels that are added after that from the deltas
+  lcm_t* receiver = lcm_create("mpudpm://239.255.76.67:7740?ttl=0&nports=2");
+  ASSERT_TRUE(receiver != NULL);
+  int num_old = 0, num_new = 0;
+  lcm_subscription_t* old_subs = lcm_subscribe(receiver, "MPUDPM_DELTA_O.*",
+      count_handler, &num_old);
+  lcm_subscription_t* new_subs = lcm_subscribe(receiver, "MPUDPM_DELTA_N.*",
+      count_handler, &num_new);
+  for (int i = 0; i < 100 && !num_old; i++) {
+    lcm_publish(publisher, "MPUDPM_DELTA_OLD", data, sizeof(data));
+    lcm_handle_timeout(receiver, 10);
+  }
+  EXPECT_LT(0, num_old);
+  channels = read_group_channels(fd, 0);
+  EXPECT_TRUE(has_channel(channels, "#!mpudpm_CH2PRT_REQ"));
+  EXPECT_TRUE(has_channel(channels, "#!mpudpm_CH2PRT_UPD"));
+
+  // well within the period of the full broadcasts
+  for (int i = 0; i < 100 && !num_new; i++) {
+    lcm_publish(publisher, "MPUDPM_DELTA_NEW", data, sizeof(data));
+    lcm_handle_timeout(receiver, 10);
+  }
+  EXPECT_LT(0, num_new);
+  channels = read_group_channels(fd, 0);
+  EXPECT_TRUE(has_channel(channels, "#!mpudpm_CH2PRT_DLT"));
+  EXPECT_FALSE(has_channel(channels, "#!mpudpm_CH2PRT_UPD"));
+  close(fd);
+
+  lcm_unsubscribe(receiver, old_subs);
+  lcm_unsubscribe(receiver, new_subs);
+  lcm_destroy(receiver);
+  lcm_destroy(publisher);
+}
+
+static void thread_hook(const char* thread_name, void* user) {
+  if (!strcmp(thread_name, "mpudpm-rx"))
+    (*(int*) user)++;
+}
+
+TEST(LCM_C, MpudpmRecvThreads) {
+  int num_rx_threads = 0;
+  lcm_set_thread_hook(thread_hook, &num_rx_threads);
+  lcm_t* lcm = lcm_create(
+      "mpudpm://239.255.76.67:7730?ttl=0&nports=4&recv_threads=2");
+  ASSERT_TRUE(lcm != NULL);
+
+  // a channel on each port, so that both threads read some of them, and
+  // both small and fragmented messages on each
+  const int nports = 4;
+  std::vector<std::string> channels;
+  std::vector<int> num_received(nports, 0);
+  std::vector<lcm_subscription_t*> subs;
+  for (int i = 0; i < nports; i++) {
+    channels.push_back(channel_on_port("MPUDPM_RX_", i, nports));
+    subs.push_back(lcm_subscribe(lcm, channels[i].c_str(), count_handler,
+          &num_received[i]));
+  }
+  EXPECT_EQ(2, num_rx_threads);
+
+  std::vector<char> data(100000, 0);
+  const int num_msgs = 5;
+  for (int i = 0; i < num_msgs; i++) {
+    for (int j = 0; j < nports; j++) {
+      lcm_publish(lcm, channels[j].c_str(), data.data(), 100);
+      lcm_publish(lcm, channels[j].c_str(), data.data(), data.size());
+    }
+    usleep(10000);
+  }
+  int total = 0;
+  while (total < 2 * num_msgs * nports && lcm_handle_timeout(lcm, 1000) > 0) {
+    total = 0;
+    for (int j = 0; j < nports; j++)
+      total += num_received[j];
+  }
+  for (int j = 0; j < nports; j++)
+    EXPECT_EQ(2 * num_msgs, num_received[j]);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_bad_packets);
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  for (int j = 0; j < nports; j++)
+    lcm_unsubscribe(lcm, subs[j]);
+  lcm_destroy(lcm);
+  lcm_set_thread_hook(NULL, NULL);
+
+  // out of range, so the ports are read by one thread
+  num_rx_threads = 0;
+  lcm_set_thread_hook(thread_hook, &num_rx_threads);
+  lcm = lcm_create("mpudpm://239.255.76.67:7730?ttl=0&nports=4&recv_threads=0");
+  ASSERT_TRUE(lcm != NULL);
+  lcm_subscription_t* sub = lcm_subscribe(lcm, channels[0].c_str(),
+      count_handler, &num_received[0]);
+  EXPECT_EQ(1, num_rx_threads);
+  lcm_unsubscribe(lcm, sub);
+  lcm_destroy(lcm);
+  lcm_set_thread_hook(NULL, NULL);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <lcm/lcm.h>
+
+static void CountHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    (*(int*) user_data)++;
+}
+
+// handles messages until none arrive for 100 ms
+static void HandleAll(lcm_t* lcm) {
+    while (lcm_handle_timeout(lcm, 100) > 0) {
+    }
+}
+
+TEST(LCM_C, SharedFanOut) {
+    lcm_t* a = lcm_create("shared://memq://");
+    lcm_t* b = lcm_create("shared://memq://");
+    ASSERT_TRUE(a != NULL);
+    ASSERT_TRUE(b != NULL);
+    int num_a = 0;
+    int num_b = 0;
+    int num_b_any = 0;
+    lcm_subscription_t* subs_a = lcm_subscribe(a, "SHARED", CountHandler,
+            &num_a);
+    lcm_subscribe(b, "SHARED", CountHandler, &num_b);
+    // a message is queued on an instance once, however many of its
+    // subscriptions match
+    lcm_subscribe(b, "SHARED.*", CountHandler, &num_b_any);
+
+    // what one instance publishes reaches all of them
+    char data[] = "hello";
+    EXPECT_EQ(0, lcm_publish(a, "SHARED", data, sizeof(data)));
+    EXPECT_EQ(0, lcm_publish(b, "SHARED", data, sizeof(data)));
+    EXPECT_EQ(0, lcm_publish(b, "SHARED_OTHER", data, sizeof(data)));
+    HandleAll(a);
+    HandleAll(b);
+    EXPECT_EQ(2, num_a);
+    EXPECT_EQ(2, num_b);
+    EXPECT_EQ(3, num_b_any);
+
+    // instances without a subscription get nothing
+    lcm_unsubscribe(a, subs_a);
+    EXPECT_EQ(0, lcm_publish(b, "SHARED", data, sizeof(data)));
+    HandleAll(b);
+    EXPECT_EQ(0, lcm_handle_timeout(a, 100));
+    EXPECT_EQ(2, num_a);
+    EXPECT_EQ(3, num_b);
+
+    // and the others keep working when one is destroyed
+    lcm_destroy(a);
+    EXPECT_EQ(0, lcm_publish(b, "SHARED", data, sizeof(data)));
+    HandleAll(b);
+    EXPECT_EQ(4, num_b);
+    lcm_destroy(b);
+}
+
+TEST(LCM_C, SharedQueueCapacity) {
+    lcm_t* a = lcm_create("shared://memq://");
+    lcm_t* b = lcm_create("shared://memq://");
+    ASSERT_TRUE(a != NULL);
+    ASSERT_TRUE(b != NULL);
+    int num_a = 0;
+    int num_b = 0;
+    lcm_subscription_t* subs_a = lcm_subscribe(a, "SHARED_CAP", CountHandler,
+            &num_a);
+    lcm_subscription_set_queue_capacity(subs_a, 200);
+    lcm_subscription_t* subs_b = lcm_subscribe(b, "SHARED_CAP", CountHandler,
+            &num_b);
+    lcm_subscription_set_queue_capacity(subs_b, 2);
+
+    // each instance keeps to its own queue capacities
+    char data[100] = { 0 };
+    for (int i = 0; i < 100; i++)
+        lcm_publish(a, "SHARED_CAP", data, sizeof(data));
+    // let the fan-out thread queue all of them before handling any
+    lcm_t* flush = lcm_create("shared://memq://");
+    int num_flush = 0;
+    lcm_subscribe(flush, "SHARED_FLUSH", CountHandler, &num_flush);
+    lcm_publish(flush, "SHARED_FLUSH", data, sizeof(data));
+    HandleAll(flush);
+    EXPECT_EQ(1, num_flush);
+    HandleAll(a);
+    HandleAll(b);
+    EXPECT_EQ(100, num_a);
+    EXPECT_LE(num_b, 3);
+
+    lcm_subscription_stats_t stats;
+    EXPECT_EQ(0, lcm_subscription_get_stats(subs_b, &stats));
+    EXPECT_EQ(100, stats.num_enqueued + stats.num_dropped);
+
+    lcm_destroy(flush);
+    lcm_destroy(a);
+    lcm_destroy(b);
+}
+
+TEST(LCM_C, SharedSeparateUrls) {
+    // the options are part of the URL that is shared
+    lcm_t* a = lcm_create("shared://memq://?zero_copy=0");
+    lcm_t* b = lcm_create("shared://memq://");
+    ASSERT_TRUE(a != NULL);
+    ASSERT_TRUE(b != NULL);
+    int num_a = 0;
+    int num_b = 0;
+    lcm_subscribe(a, "SHARED_URL", CountHandler, &num_a);
+    lcm_subscribe(b, "SHARED_URL", CountHandler, &num_b);
+    char data[] = "hello";
+    EXPECT_EQ(0, lcm_publish(a, "SHARED_URL", data, sizeof(data)));
+    HandleAll(a);
+    HandleAll(b);
+    EXPECT_EQ(1, num_a);
+    EXPECT_EQ(0, num_b);
+    lcm_destroy(a);
+    lcm_destroy(b);
+
+    EXPECT_TRUE(lcm_create("shared://") == NULL);
+}
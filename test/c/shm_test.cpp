@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <lcm/lcm.h>
+
+// Each test uses a segment of its own, removed when the test is done.
+class ShmSegment {
+  public:
+    explicit ShmSegment(const char* test) {
+        char buf[128];
+        snprintf(buf, sizeof(buf), "test-%s-%d", test, (int) getpid());
+        name = buf;
+        shm_unlink(("/lcm-" + name).c_str());
+    }
+    ~ShmSegment() { shm_unlink(("/lcm-" + name).c_str()); }
+
+    std::string url(const char* options = "") const {
+        return "shm://" + name + options;
+    }
+
+    std::string name;
+};
+
+static void ShmBufferHandler(const lcm_recv_buf_t* rbuf, const char* channel,
+        void* user_data) {
+    std::vector<std::vector<uint8_t> >* received =
+        (std::vector<std::vector<uint8_t> >*)user_data;
+    const uint8_t* data = (const uint8_t*)rbuf->data;
+    received->push_back(std::vector<uint8_t>(data, data + rbuf->data_size));
+}
+
+TEST(LCM_C, ShmInvalidName) {
+    EXPECT_EQ(NULL, lcm_create("shm://a/b"));
+}
+
+TEST(LCM_C, ShmBetweenInstances) {
+    // Messages published by one instance reach every instance on the same
+    // segment, in order, including the publisher itself.
+    ShmSegment shm("between");
+    lcm_t* pub = lcm_create(shm.url().c_str());
+    lcm_t* sub = lcm_create(shm.url().c_str());
+    ASSERT_TRUE(pub != NULL);
+    ASSERT_TRUE(sub != NULL);
+
+    std::vector<std::vector<uint8_t> > pub_received, sub_received;
+    lcm_subscribe(pub, "SHM_.*", ShmBufferHandler, &pub_received);
+    lcm_subscribe(sub, "SHM_.*", ShmBufferHandler, &sub_received);
+
+    std::vector<std::vector<uint8_t> > sent;
+    for (int i = 0; i < 20; i++) {
+        std::vector<uint8_t> buf(i * 97 + 1);
+        for (size_t j = 0; j < buf.size(); j++)
+            buf[j] = rand() % 255;
+        lcm_publish(pub, "SHM_TEST", &buf[0], buf.size());
+        sent.push_back(buf);
+    }
+    lcm_publish(pub, "OTHER", "", 0);
+
+    while (sub_received.size() < sent.size() &&
+            lcm_handle_timeout(sub, 1000) > 0) {
+    }
+    while (pub_received.size() < sent.size() &&
+            lcm_handle_timeout(pub, 1000) > 0) {
+    }
+    EXPECT_EQ(sent, sub_received);
+    EXPECT_EQ(sent, pub_received);
+
+    lcm_transport_stats_t stats;
+    EXPECT_EQ(0, lcm_get_transport_stats(sub, &stats));
+    EXPECT_EQ(21, stats.num_packets);
+    EXPECT_EQ(0, stats.num_lost);
+
+    lcm_destroy(pub);
+    lcm_destroy(sub);
+}
+
+TEST(LCM_C, ShmOverwrite) {
+    // A receiver that falls behind by more than the ring loses the oldest
+    // messages, but never gets a damaged one.
+    ShmSegment shm("overwrite");
+    lcm_t* lcm = lcm_create(shm.url("?size_mb=1").c_str());
+    ASSERT_TRUE(lcm != NULL);
+
+    std::vector<std::vector<uint8_t> > received;
+    lcm_subscription_t* subs = lcm_subscribe(lcm, "SHM", ShmBufferHandler,
+            &received);
+    lcm_subscription_set_queue_capacity(subs, 1000);
+
+    // too large for a quarter of the ring
+    std::vector<uint8_t> large(300 * 1024);
+    EXPECT_GT(0, lcm_publish(lcm, "SHM", &large[0], large.size()));
+
+    const int num_msgs = 400;
+    std::vector<uint8_t> buf(16 * 1024);
+    for (int i = 0; i < num_msgs; i++) {
+        memset(&buf[0], i, buf.size());
+        lcm_publish(lcm, "SHM", &buf[0], buf.size());
+    }
+    while (lcm_handle_timeout(lcm, 200) > 0) {
+    }
+    // A receive thread that only ran after the burst skipped all of it, and
+    // picks up the messages published after that.
+    for (int i = 0; i < 100 && received.empty(); i++) {
+        lcm_publish(lcm, "SHM", &buf[0], buf.size());
+        lcm_handle_timeout(lcm, 100);
+    }
+
+    EXPECT_LT(0u, received.size());
+    for (size_t i = 0; i < received.size(); i++) {
+        ASSERT_EQ(buf.size(), received[i].size());
+        EXPECT_EQ(std::vector<uint8_t>(buf.size(), received[i][0]),
+                received[i]);
+    }
+    lcm_transport_stats_t stats;
+    EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+    EXPECT_EQ(0, stats.num_bad_packets);
+
+    lcm_destroy(lcm);
+}
@@ -1,5 +1,20 @@
 #include <gtest/gtest.h>
 
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
 #include <lcm/lcm.h>
 
 TEST(LCM_C, InvalidCreation) {
@@ -12,3 +27,1692 @@ TEST(LCM_C, InvalidCreation) {
   lcm = lcm_create("udpm://239.255.1.1:65536");
   EXPECT_EQ(NULL, lcm);
 }
+
+static void count_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user) {
+  (*(int*) user)++;
+}
+
+TEST(LCM_C, UdpmTransportStats) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7690?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_STATS", count_handler,
+      &num_received);
+  const int num_msgs = 10;
+  char data[100] = { 0 };
+  for (int i = 0; i < num_msgs; i++) {
+    lcm_publish(lcm, "UDPM_STATS", data, sizeof(data));
+    lcm_handle_timeout(lcm, 1000);
+  }
+  EXPECT_EQ(num_msgs, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  // the self test sends packets of its own
+  EXPECT_LE(num_msgs, stats.num_packets);
+  EXPECT_EQ(0, stats.num_bad_packets);
+  EXPECT_EQ(0, stats.num_lost);
+  EXPECT_EQ(0, stats.num_duplicated);
+  EXPECT_EQ(1, stats.num_senders);
+  EXPECT_GT(stats.ring_low_watermark, 0);
+  EXPECT_LE(stats.ring_low_watermark, 1);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+
+  lcm = lcm_create("memq://");
+  EXPECT_EQ(-1, lcm_get_transport_stats(lcm, &stats));
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmRecvPoolCap) {
+  // enough for a couple of hundred small messages
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7691?ttl=0"
+      "&recv_pool_size=131072&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_POOL", count_handler,
+      &num_received);
+  lcm_subscription_set_queue_capacity(subs, 0);
+
+  // nothing is handled while publishing, so the pool fills up
+  const int num_msgs = 1000;
+  char data[100] = { 0 };
+  for (int i = 0; i < num_msgs; i++) {
+    lcm_publish(lcm, "UDPM_POOL", data, sizeof(data));
+    if (i % 50 == 0)
+      usleep(1000);
+  }
+  usleep(100000);
+  while (lcm_handle_timeout(lcm, 100) > 0) {
+  }
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_GT(num_received, 0);
+  EXPECT_LT(num_received, num_msgs);
+  EXPECT_GT(stats.num_dropped_no_buffer, 0);
+  EXPECT_GE(stats.ring_low_watermark, 0);
+  EXPECT_LT(stats.ring_low_watermark, 0.1);
+
+  // handling the queued messages gave their buffers back
+  num_received = 0;
+  lcm_publish(lcm, "UDPM_POOL", data, sizeof(data));
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+#ifdef __linux__
+TEST(LCM_C, UdpmChannelFilter) {
+  // the subscription waits for the self test, so that no self test
+  // datagram arrives while the packets are counted
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7692?ttl=0&self_test=sync");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_FILTER_A",
+      count_handler, &num_received);
+
+  lcm_transport_stats_t before;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &before));
+
+  // the kernel drops the messages nobody subscribes to
+  char data[100] = { 0 };
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_FILTER_B", data, sizeof(data));
+  lcm_publish(lcm, "UDPM_FILTER_A", data, sizeof(data));
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+
+  lcm_transport_stats_t after;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &after));
+  EXPECT_EQ(1, after.num_packets - before.num_packets);
+  EXPECT_EQ(0, after.num_lost);
+
+  // a prefix pattern lets the other channel through again
+  lcm_subscription_t* subs_all = lcm_subscribe(lcm, "UDPM_FILTER_.*",
+      count_handler, &num_received);
+  num_received = 0;
+  lcm_publish(lcm, "UDPM_FILTER_B", data, sizeof(data));
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+
+  // and a catch-all one removes the filter
+  lcm_subscription_t* subs_any = lcm_subscribe(lcm, ".*", count_handler,
+      &num_received);
+  num_received = 0;
+  lcm_publish(lcm, "UDPM_OTHER", data, sizeof(data));
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+
+  lcm_unsubscribe(lcm, subs_any);
+  lcm_unsubscribe(lcm, subs_all);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+#endif
+
+TEST(LCM_C, UdpmUnsubscribedFragments) {
+  // without the socket filter, every fragment reaches the process
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7693?ttl=0&channel_filter=0"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_FRAG_A",
+      count_handler, &num_received);
+
+  // the fragments of the unsubscribed message are discarded, and do not
+  // disturb the next message from the same sender
+  const int size = 200000;
+  char* data = (char*) calloc(1, size);
+  lcm_publish(lcm, "UDPM_FRAG_B", data, size);
+  lcm_publish(lcm, "UDPM_FRAG_A", data, size);
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  free(data);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+// Sends one fragment of a message the way another LCM process would.
+static void send_fragment(int fd, const struct sockaddr_in* dest,
+    uint32_t seqno, const char* channel, const char* data, int data_size,
+    int fragment_no, int fragments_in_msg, int fragment_size) {
+  char pkt[2048];
+  uint32_t hdr[4] = { htonl(0x4c433033), htonl(seqno), htonl(data_size),
+    htonl(fragment_no * fragment_size) };
+  uint16_t frag[2] = { htons(fragment_no), htons(fragments_in_msg) };
+  memcpy(pkt, hdr, sizeof(hdr));
+  memcpy(pkt + sizeof(hdr), frag, sizeof(frag));
+  int len = sizeof(hdr) + sizeof(frag);
+  if (fragment_no == 0) {
+    strcpy(pkt + len, channel);
+    len += strlen(channel) + 1;
+  }
+  int offset = fragment_no * fragment_size;
+  int n = data_size - offset < fragment_size ? data_size - offset :
+      fragment_size;
+  memcpy(pkt + len, data + offset, n);
+  len += n;
+  sendto(fd, pkt, len, 0, (const struct sockaddr*) dest, sizeof(*dest));
+}
+
+static void check_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user) {
+  const char* expected = (const char*) user;
+  if (rbuf->data_size == 4000 && !memcmp(rbuf->data, expected, 4000))
+    (*(int*) (expected + 4000))++;
+}
+
+TEST(LCM_C, UdpmInterleavedFragments) {
+  // with the socket filter, fragments that arrive before the first one are
+  // assumed to belong to unsubscribed channels
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7694?ttl=0&channel_filter=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  // each buffer holds a message, followed by the number of times it was
+  // received intact
+  char a[4000 + sizeof(int)];
+  char b[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++) {
+    a[i] = i % 251;
+    b[i] = i % 241;
+  }
+  memset(a + 4000, 0, sizeof(int));
+  memset(b + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs_a = lcm_subscribe(lcm, "UDPM_INTERLEAVED_A",
+      check_handler, a);
+  lcm_subscription_t* subs_b = lcm_subscribe(lcm, "UDPM_INTERLEAVED_B",
+      check_handler, b);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  unsigned char ttl = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+  dest.sin_port = htons(7694);
+
+  // two messages from the same sender, interleaved, out of order and with a
+  // duplicate fragment
+  send_fragment(fd, &dest, 10, "UDPM_INTERLEAVED_A", a, 4000, 1, 4, 1000);
+  send_fragment(fd, &dest, 11, "UDPM_INTERLEAVED_B", b, 4000, 0, 4, 1000);
+  send_fragment(fd, &dest, 10, "UDPM_INTERLEAVED_A", a, 4000, 0, 4, 1000);
+  send_fragment(fd, &dest, 11, "UDPM_INTERLEAVED_B", b, 4000, 2, 4, 1000);
+  send_fragment(fd, &dest, 10, "UDPM_INTERLEAVED_A", a, 4000, 3, 4, 1000);
+  send_fragment(fd, &dest, 11, "UDPM_INTERLEAVED_B", b, 4000, 1, 4, 1000);
+  send_fragment(fd, &dest, 11, "UDPM_INTERLEAVED_B", b, 4000, 1, 4, 1000);
+  send_fragment(fd, &dest, 10, "UDPM_INTERLEAVED_A", a, 4000, 2, 4, 1000);
+  send_fragment(fd, &dest, 11, "UDPM_INTERLEAVED_B", b, 4000, 3, 4, 1000);
+  close(fd);
+
+  for (int i = 0; i < 2; i++)
+    lcm_handle_timeout(lcm, 1000);
+  int num_a, num_b;
+  memcpy(&num_a, a + 4000, sizeof(int));
+  memcpy(&num_b, b + 4000, sizeof(int));
+  EXPECT_EQ(1, num_a);
+  EXPECT_EQ(1, num_b);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  lcm_unsubscribe(lcm, subs_a);
+  lcm_unsubscribe(lcm, subs_b);
+  lcm_destroy(lcm);
+}
+
+// Sends a message cut into fragments of fragment_size bytes, except for
+// fragment lost, followed by one parity packet covering all of them.
+static void send_with_parity(int fd, const struct sockaddr_in* dest,
+    uint32_t seqno, const char* channel, const char* data, int data_size,
+    int fragment_size, int lost) {
+  std::vector<char> payload(channel, channel + strlen(channel) + 1);
+  int header_size = payload.size();
+  payload.insert(payload.end(), data, data + data_size);
+  int n = (payload.size() + fragment_size - 1) / fragment_size;
+  std::vector<char> parity(fragment_size, 0);
+  for (int i = 0; i < n; i++) {
+    int start = i * fragment_size;
+    int len = std::min<int>(fragment_size, payload.size() - start);
+    for (int j = 0; j < len; j++)
+      parity[j] ^= payload[start + j];
+    if (i == lost)
+      continue;
+    char pkt[2048];
+    uint32_t hdr[4] = { htonl(0x4c433033), htonl(seqno), htonl(data_size),
+      htonl(i ? start - header_size : 0) };
+    uint16_t frag[2] = { htons(i), htons(n) };
+    memcpy(pkt, hdr, sizeof(hdr));
+    memcpy(pkt + sizeof(hdr), frag, sizeof(frag));
+    memcpy(pkt + 20, &payload[start], len);
+    sendto(fd, pkt, 20 + len, 0, (const struct sockaddr*) dest,
+        sizeof(*dest));
+  }
+  char pkt[2048];
+  uint32_t hdr[2] = { htonl(0x4c433034), htonl(seqno) };
+  uint16_t fields[6] = { htons(n), htons(0), htons(1), htons(n),
+    htons(fragment_size), htons(payload.size() - (n - 1) * fragment_size) };
+  memcpy(pkt, hdr, sizeof(hdr));
+  memcpy(pkt + sizeof(hdr), fields, sizeof(fields));
+  memcpy(pkt + 20, &parity[0], fragment_size);
+  sendto(fd, pkt, 20 + fragment_size, 0, (const struct sockaddr*) dest,
+      sizeof(*dest));
+}
+
+TEST(LCM_C, UdpmFecRecovery) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7695?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  char data[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++)
+    data[i] = i % 251;
+  memset(data + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_FEC", check_handler,
+      data);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  unsigned char ttl = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+  dest.sin_port = htons(7695);
+
+  // lose the last fragment, one in the middle and then the first.  The
+  // fragments that follow a lost first one are only kept once parity packets
+  // were seen.
+  send_with_parity(fd, &dest, 20, "UDPM_FEC", data, 4000, 1000, 4);
+  send_with_parity(fd, &dest, 21, "UDPM_FEC", data, 4000, 1000, 2);
+  send_with_parity(fd, &dest, 22, "UDPM_FEC", data, 4000, 1000, 0);
+  close(fd);
+
+  for (int i = 0; i < 3; i++)
+    lcm_handle_timeout(lcm, 1000);
+  int num_received;
+  memcpy(&num_received, data + 4000, sizeof(int));
+  EXPECT_EQ(3, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(3, stats.num_fec_recovered);
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmFecPublish) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7696?ttl=0&fec=4:2"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_FEC_PUBLISH",
+      count_handler, &num_received);
+
+  // nothing is lost, and the parity packets are not mistaken for anything
+  const int size = 500000;
+  char* data = (char*) calloc(1, size);
+  lcm_publish(lcm, "UDPM_FEC_PUBLISH", data, size);
+  lcm_publish(lcm, "UDPM_FEC_PUBLISH", data, size);
+  for (int i = 0; i < 2; i++)
+    lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(2, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_bad_packets);
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  free(data);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+static void send_short(int fd, const struct sockaddr_in* dest, uint32_t magic,
+    uint32_t seqno, const char* channel)
+{
+  char pkt[100];
+  uint32_t hdr[2] = { htonl(magic), htonl(seqno) };
+  memcpy(pkt, hdr, sizeof(hdr));
+  strcpy(pkt + 8, channel);
+  memset(pkt + 8 + strlen(channel) + 1, 0, 10);
+  sendto(fd, pkt, 8 + strlen(channel) + 1 + 10, 0,
+      (const struct sockaddr*) dest, sizeof(*dest));
+}
+
+TEST(LCM_C, UdpmNackRetransmit) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7697?ttl=0&nack=1");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_NACK", count_handler,
+      &num_received);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  unsigned char ttl = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  struct timeval timeout = { 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+  dest.sin_port = htons(7697);
+
+  // message 2 is lost, and the receiver asks for it
+  send_short(fd, &dest, 0x4c433032, 1, "UDPM_NACK");
+  send_short(fd, &dest, 0x4c433032, 3, "UDPM_NACK");
+  for (int i = 0; i < 2; i++)
+    lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(2, num_received);
+
+  uint32_t nack[3] = { 0, 0, 0 };
+  ASSERT_EQ((ssize_t) sizeof(nack), recv(fd, nack, sizeof(nack), 0));
+  EXPECT_EQ(0x4c433035u, ntohl(nack[0]));
+  EXPECT_EQ(2u, ntohl(nack[1]));
+  EXPECT_EQ(1u, ntohl(nack[2]));
+
+  // it accepts the retransmission once
+  send_short(fd, &dest, 0x4c433036, 2, "UDPM_NACK");
+  send_short(fd, &dest, 0x4c433036, 2, "UDPM_NACK");
+  lcm_handle_timeout(lcm, 1000);
+  lcm_handle_timeout(lcm, 100);
+  EXPECT_EQ(3, num_received);
+  close(fd);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(1, stats.num_nacked);
+  EXPECT_EQ(1, stats.num_retransmitted);
+  EXPECT_EQ(0, stats.num_lost);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmReliablePublish) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7698?ttl=0"
+      "&reliable=UDPM_RELIABLE");
+  ASSERT_TRUE(lcm != NULL);
+
+  // listen to the group like a receiver would
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  int opt = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  struct timeval timeout = { 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(7698);
+  ASSERT_EQ(0, bind(fd, (struct sockaddr*) &addr, sizeof(addr)));
+  struct ip_mreq mreq;
+  mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+  mreq.imr_interface.s_addr = INADDR_ANY;
+  ASSERT_EQ(0, setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+        sizeof(mreq)));
+
+  char data[100] = { 0 };
+  lcm_publish(lcm, "UDPM_RELIABLE", data, sizeof(data));
+
+  uint32_t pkt[1000];
+  struct sockaddr_in from;
+  socklen_t fromlen;
+  uint32_t seqno = 0;
+  int found = 0;
+  while (!found) {
+    fromlen = sizeof(from);
+    ssize_t sz = recvfrom(fd, pkt, sizeof(pkt), 0, (struct sockaddr*) &from,
+        &fromlen);
+    ASSERT_GT(sz, 8);
+    found = ntohl(pkt[0]) == 0x4c433032 &&
+      !strcmp((char*) (pkt + 2), "UDPM_RELIABLE");
+    seqno = ntohl(pkt[1]);
+  }
+
+  // the publisher answers a NACK with a retransmission
+  uint32_t nack[3] = { htonl(0x4c433035), htonl(seqno), htonl(1) };
+  sendto(fd, nack, sizeof(nack), 0, (struct sockaddr*) &from, fromlen);
+  found = 0;
+  while (!found) {
+    ssize_t sz = recv(fd, pkt, sizeof(pkt), 0);
+    ASSERT_GT(sz, 8);
+    found = ntohl(pkt[0]) == 0x4c433036;
+  }
+  EXPECT_EQ(seqno, ntohl(pkt[1]));
+  EXPECT_STREQ("UDPM_RELIABLE", (char*) (pkt + 2));
+
+  close(fd);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmIoUring) {
+  // falls back to the default receive path where io_uring is not available
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7699?ttl=0&io=uring"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_IO_URING",
+      count_handler, &num_received);
+
+  const int size = 300000;
+  char* data = (char*) calloc(1, size);
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_IO_URING", data, 100);
+  lcm_publish(lcm, "UDPM_IO_URING", data, size);
+  for (int i = 0; i < 11 && num_received < 11; i++)
+    lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(11, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_bad_packets);
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  free(data);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmMtu) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7700?ttl=0&mtu=1500");
+  ASSERT_TRUE(lcm != NULL);
+
+  char data[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++)
+    data[i] = i % 251;
+  memset(data + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_MTU", check_handler,
+      data);
+
+  // listen to the group like a receiver would
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  int opt = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  struct timeval timeout = { 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(7700);
+  ASSERT_EQ(0, bind(fd, (struct sockaddr*) &addr, sizeof(addr)));
+  struct ip_mreq mreq;
+  mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+  mreq.imr_interface.s_addr = INADDR_ANY;
+  ASSERT_EQ(0, setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+        sizeof(mreq)));
+
+  // 4000 bytes take 3 fragments of at most 1472 bytes, the UDP payload of a
+  // 1500 byte packet
+  lcm_publish(lcm, "UDPM_MTU", data, 4000);
+  int num_fragments = 0;
+  char pkt[65536];
+  while (num_fragments < 3) {
+    ssize_t sz = recv(fd, pkt, sizeof(pkt), 0);
+    ASSERT_GT(sz, 8);
+    uint32_t magic;
+    memcpy(&magic, pkt, sizeof(magic));
+    if (ntohl(magic) != 0x4c433033)
+      continue;
+    EXPECT_LE(sz, 1472);
+    num_fragments++;
+  }
+  close(fd);
+
+  lcm_handle_timeout(lcm, 1000);
+  int num_received;
+  memcpy(&num_received, data + 4000, sizeof(int));
+  EXPECT_EQ(1, num_received);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmBusyPoll) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7701?ttl=0&busy_poll=200");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_BUSY_POLL",
+      count_handler, &num_received);
+
+  // both with and without a message waiting at the end of the spin
+  char data[100] = { 0 };
+  EXPECT_EQ(0, lcm_handle_timeout(lcm, 10));
+  for (int i = 0; i < 5; i++) {
+    lcm_publish(lcm, "UDPM_BUSY_POLL", data, sizeof(data));
+    EXPECT_EQ(1, lcm_handle_timeout(lcm, 1000));
+  }
+  lcm_publish(lcm, "UDPM_BUSY_POLL", data, sizeof(data));
+  EXPECT_EQ(0, lcm_handle(lcm));
+  EXPECT_EQ(6, num_received);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+struct ExpectedMessage {
+  const char* data;
+  int size;
+  int num_received;
+};
+
+static void expect_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user) {
+  ExpectedMessage* expected = (ExpectedMessage*) user;
+  if (rbuf->data_size == (uint32_t) expected->size &&
+      !memcmp(rbuf->data, expected->data, expected->size))
+    expected->num_received++;
+}
+
+TEST(LCM_C, UdpmCompress) {
+  // a codec that LCM was built without is ignored, and the messages are then
+  // sent as they are
+  const char* codecs[] = { "lz4", "zlib" };
+  for (int c = 0; c < 2; c++) {
+    char url[200];
+    snprintf(url, sizeof(url), "udpm://239.255.76.67:7704?ttl=0"
+        "&recv_buf_size=4000000&compress=%s&compress_min=1000"
+        "&compress_channels=UDPM_COMPRESS_.*", codecs[c]);
+    lcm_t* lcm = lcm_create(url);
+    ASSERT_TRUE(lcm != NULL);
+
+    // a fragmented and a short message that compress, and one on a channel
+    // that is not compressed
+    // two random bits per byte compress to well over one fragment
+    const int big_size = 400000;
+    char* big = (char*) malloc(big_size);
+    uint32_t x = 1;
+    for (int i = 0; i < big_size; i++) {
+      x = x * 1103515245 + 12345;
+      big[i] = (x >> 16) & 3;
+    }
+    char small[3000];
+    for (int i = 0; i < (int) sizeof(small); i++)
+      small[i] = i % 7;
+    ExpectedMessage expected[3] = {
+      { big, big_size, 0 },
+      { small, (int) sizeof(small), 0 },
+      { small, (int) sizeof(small), 0 },
+    };
+    const char* channels[3] = {
+      "UDPM_COMPRESS_BIG", "UDPM_COMPRESS_SMALL", "UDPM_RAW"
+    };
+    lcm_subscription_t* subs[3];
+    for (int i = 0; i < 3; i++)
+      subs[i] = lcm_subscribe(lcm, channels[i], expect_handler, &expected[i]);
+
+    // listen to the group like a receiver would
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(fd, 0);
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    opt = 4000000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt, sizeof(opt));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(7704);
+    ASSERT_EQ(0, bind(fd, (struct sockaddr*) &addr, sizeof(addr)));
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    ASSERT_EQ(0, setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+          sizeof(mreq)));
+
+    for (int i = 0; i < 3; i++)
+      lcm_publish(lcm, channels[i], expected[i].data, expected[i].size);
+    int num_received = 0;
+    for (int i = 0; i < 10 && num_received < 3; i++) {
+      lcm_handle_timeout(lcm, 1000);
+      num_received = expected[0].num_received + expected[1].num_received +
+          expected[2].num_received;
+    }
+    for (int i = 0; i < 3; i++)
+      EXPECT_EQ(1, expected[i].num_received) << codecs[c] << " " <<
+          channels[i];
+
+    lcm_transport_stats_t stats;
+    EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+    EXPECT_EQ(0, stats.num_bad_packets);
+
+    // compressed messages have their own magic numbers, "LC12" and "LC13"
+    int num_compressed = 0;
+    int compressed_bytes = 0;
+    int raw_seen = 0;
+    char pkt[65536];
+    ssize_t sz;
+    while ((sz = recv(fd, pkt, sizeof(pkt), MSG_DONTWAIT)) >= 8) {
+      uint32_t magic;
+      memcpy(&magic, pkt, sizeof(magic));
+      magic = ntohl(magic);
+      if (magic == 0x4c433132 || magic == 0x4c433133) {
+        num_compressed++;
+        compressed_bytes += sz;
+      }
+      if (magic == 0x4c433032 && !strcmp(pkt + 8, "UDPM_RAW"))
+        raw_seen = 1;
+    }
+    EXPECT_EQ(1, raw_seen);
+    if (num_compressed)
+      EXPECT_LT(compressed_bytes, big_size);
+    close(fd);
+
+    for (int i = 0; i < 3; i++)
+      lcm_unsubscribe(lcm, subs[i]);
+    lcm_destroy(lcm);
+    free(big);
+  }
+}
+
+static void self_test_handler(lcm_t* lcm, int status, void* user) {
+  // called from the self test thread
+  __sync_lock_test_and_set((int*) user, status);
+}
+
+TEST(LCM_C, UdpmSelfTest) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7703?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+  EXPECT_EQ(LCM_SELF_TEST_NONE, lcm_get_self_test_status(lcm));
+  int result = LCM_SELF_TEST_NONE;
+  lcm_set_self_test_handler(lcm, self_test_handler, &result);
+
+  // subscribing does not wait for the self test, and messages published
+  // right away are received
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_SELF_TEST",
+      count_handler, &num_received);
+  int status = lcm_get_self_test_status(lcm);
+  EXPECT_TRUE(status == LCM_SELF_TEST_PENDING ||
+      status == LCM_SELF_TEST_PASSED);
+  char data[100] = { 0 };
+  lcm_publish(lcm, "UDPM_SELF_TEST", data, sizeof(data));
+  EXPECT_EQ(1, lcm_handle_timeout(lcm, 1000));
+  EXPECT_EQ(1, num_received);
+
+  for (int i = 0; i < 100 &&
+      __sync_fetch_and_add(&result, 0) == LCM_SELF_TEST_NONE; i++)
+    usleep(10000);
+  EXPECT_EQ(LCM_SELF_TEST_PASSED, __sync_fetch_and_add(&result, 0));
+  EXPECT_EQ(LCM_SELF_TEST_PASSED, lcm_get_self_test_status(lcm));
+
+  // a handler set after the test finished is called right away
+  int late_result = LCM_SELF_TEST_NONE;
+  lcm_set_self_test_handler(lcm, self_test_handler, &late_result);
+  EXPECT_EQ(LCM_SELF_TEST_PASSED, late_result);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+
+  lcm = lcm_create("udpm://239.255.76.67:7703?ttl=0&self_test=off");
+  ASSERT_TRUE(lcm != NULL);
+  subs = lcm_subscribe(lcm, "UDPM_SELF_TEST", count_handler, &num_received);
+  EXPECT_EQ(LCM_SELF_TEST_NONE, lcm_get_self_test_status(lcm));
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+
+  lcm = lcm_create("udpm://239.255.76.67:7703?ttl=0&self_test=sync");
+  ASSERT_TRUE(lcm != NULL);
+  subs = lcm_subscribe(lcm, "UDPM_SELF_TEST", count_handler, &num_received);
+  EXPECT_EQ(LCM_SELF_TEST_PASSED, lcm_get_self_test_status(lcm));
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+#ifdef __linux__
+struct ThreadHookResult {
+  int num_rx_threads;
+  int pinned_to_cpu0;
+};
+
+static void thread_hook(const char* thread_name, void* user) {
+  ThreadHookResult* result = (ThreadHookResult*) user;
+  if (strcmp(thread_name, "udpm-rx"))
+    return;
+  result->num_rx_threads++;
+  cpu_set_t set;
+  pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+  result->pinned_to_cpu0 = CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set);
+}
+
+TEST(LCM_C, UdpmRxCpu) {
+  EXPECT_EQ(-1, lcm_set_thread_scheduling("0-x", NULL));
+  EXPECT_EQ(-1, lcm_set_thread_scheduling(NULL, "fast"));
+
+  ThreadHookResult result = { 0, 0 };
+  lcm_set_thread_hook(thread_hook, &result);
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7702?ttl=0&rx_cpu=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  // the read thread starts with the first subscription, and is pinned before
+  // the hook runs
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_RX_CPU",
+      count_handler, &num_received);
+  char data[100] = { 0 };
+  lcm_publish(lcm, "UDPM_RX_CPU", data, sizeof(data));
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+  EXPECT_EQ(1, result.num_rx_threads);
+  EXPECT_EQ(1, result.pinned_to_cpu0);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+  lcm_set_thread_hook(NULL, NULL);
+}
+
+TEST(LCM_C, UdpmNuma) {
+  // both read threads, and their preallocated pools, go on node 0, which
+  // every Linux host has
+  ThreadHookResult result = { 0, 0 };
+  lcm_set_thread_hook(thread_hook, &result);
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7718?ttl=0&recv_threads=2"
+      "&numa=0,0&prealloc=1&recv_pool_size=1048576");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_NUMA",
+      count_handler, &num_received);
+  std::vector<char> data(100000, 0);
+  lcm_publish(lcm, "UDPM_NUMA", &data[0], 100);
+  lcm_publish(lcm, "UDPM_NUMA", &data[0], data.size());
+  while (num_received < 2 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  EXPECT_EQ(2, num_received);
+  EXPECT_EQ(2, result.num_rx_threads);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+  lcm_set_thread_hook(NULL, NULL);
+
+  // the node of the interface is not always known, which is not an error
+  lcm = lcm_create("udpm://239.255.76.67:7718?ttl=0&numa=auto");
+  ASSERT_TRUE(lcm != NULL);
+  num_received = 0;
+  subs = lcm_subscribe(lcm, "UDPM_NUMA", count_handler, &num_received);
+  lcm_publish(lcm, "UDPM_NUMA", &data[0], 100);
+  lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(1, num_received);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+#endif
+
+struct TxSocketsPublisher {
+  lcm_t* lcm;
+  int thread_no;
+};
+
+static const int TX_SOCKETS_MSGS = 20;
+static const int TX_SOCKETS_BIG = 200000;
+
+static void* tx_sockets_publish(void* user) {
+  TxSocketsPublisher* pub = (TxSocketsPublisher*) user;
+  std::vector<char> data(TX_SOCKETS_BIG, 0);
+  data[0] = pub->thread_no;
+  for (int i = 0; i < TX_SOCKETS_MSGS; i++) {
+    data[1] = i;
+    // a fragmented message in the middle of the small ones
+    int size = i == TX_SOCKETS_MSGS / 2 ? TX_SOCKETS_BIG : 100;
+    lcm_publish(pub->lcm, "UDPM_TX_SOCKETS", &data[0], size);
+  }
+  return NULL;
+}
+
+struct TxSocketsReceived {
+  int num_received;
+  int next[4];
+  int out_of_order;
+};
+
+static void tx_sockets_handler(const lcm_recv_buf_t* rbuf,
+    const char* channel, void* user) {
+  TxSocketsReceived* received = (TxSocketsReceived*) user;
+  const char* data = (const char*) rbuf->data;
+  int thread_no = data[0];
+  if (data[1] != received->next[thread_no])
+    received->out_of_order++;
+  received->next[thread_no] = data[1] + 1;
+  received->num_received++;
+}
+
+TEST(LCM_C, UdpmTxSockets) {
+  lcm_t* rx = lcm_create("udpm://239.255.76.67:7705?ttl=0&self_test=off"
+      "&channel_filter=0&recv_buf_size=2000000");
+  ASSERT_TRUE(rx != NULL);
+  lcm_t* tx = lcm_create("udpm://239.255.76.67:7705?ttl=0&tx_sockets=4");
+  ASSERT_TRUE(tx != NULL);
+
+  TxSocketsReceived received;
+  memset(&received, 0, sizeof(received));
+  lcm_subscription_t* subs = lcm_subscribe(rx, "UDPM_TX_SOCKETS",
+      tx_sockets_handler, &received);
+  lcm_subscription_set_queue_capacity(subs, 4 * TX_SOCKETS_MSGS);
+
+  // each thread publishes on a socket of its own, and its messages stay in
+  // order
+  pthread_t threads[4];
+  TxSocketsPublisher pubs[4];
+  for (int i = 0; i < 4; i++) {
+    pubs[i].lcm = tx;
+    pubs[i].thread_no = i;
+    pthread_create(&threads[i], NULL, tx_sockets_publish, &pubs[i]);
+  }
+  while (received.num_received < 4 * TX_SOCKETS_MSGS &&
+      lcm_handle_timeout(rx, 1000) > 0) {
+  }
+  for (int i = 0; i < 4; i++)
+    pthread_join(threads[i], NULL);
+  EXPECT_EQ(4 * TX_SOCKETS_MSGS, received.num_received);
+  EXPECT_EQ(0, received.out_of_order);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(rx, &stats));
+  EXPECT_EQ(0, stats.num_lost);
+  EXPECT_EQ(4, stats.num_senders);
+
+  lcm_unsubscribe(rx, subs);
+  lcm_destroy(tx);
+  lcm_destroy(rx);
+}
+
+TEST(LCM_C, UdpmFaultInjection) {
+  lcm_t* rx = lcm_create("udpm://239.255.76.67:7706?ttl=0&self_test=off"
+      "&channel_filter=0&recv_buf_size=2000000");
+  ASSERT_TRUE(rx != NULL);
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(rx, "UDPM_FAULTS", count_handler,
+      &num_received);
+  lcm_subscription_set_queue_capacity(subs, 200);
+
+  // about half of the messages are lost, and the receiver sees the gaps
+  lcm_t* tx = lcm_create("udpm://239.255.76.67:7706?ttl=0&drop_rate=0.5"
+      "&fault_seed=1");
+  ASSERT_TRUE(tx != NULL);
+  char data[100] = { 0 };
+  for (int i = 0; i < 200; i++)
+    lcm_publish(tx, "UDPM_FAULTS", data, sizeof(data));
+  while (lcm_handle_timeout(rx, 200) > 0) {
+  }
+  lcm_destroy(tx);
+  EXPECT_GT(num_received, 50);
+  EXPECT_LT(num_received, 150);
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(rx, &stats));
+  EXPECT_GT(stats.num_lost, 0);
+  EXPECT_LE(stats.num_lost, 200 - num_received);
+
+  // every datagram is transmitted twice
+  tx = lcm_create("udpm://239.255.76.67:7706?ttl=0&dup_rate=1");
+  ASSERT_TRUE(tx != NULL);
+  int64_t num_duplicated = stats.num_duplicated;
+  for (int i = 0; i < 10; i++)
+    lcm_publish(tx, "UDPM_FAULTS", data, sizeof(data));
+  while (lcm_handle_timeout(rx, 200) > 0) {
+  }
+  lcm_destroy(tx);
+  EXPECT_EQ(0, lcm_get_transport_stats(rx, &stats));
+  EXPECT_EQ(num_duplicated + 10, stats.num_duplicated);
+  lcm_unsubscribe(rx, subs);
+
+  // every other fragment swaps places with the next datagram, and the
+  // messages are still reassembled
+  char frag_data[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++)
+    frag_data[i] = i % 251;
+  memset(frag_data + 4000, 0, sizeof(int));
+  subs = lcm_subscribe(rx, "UDPM_FAULTS_FRAG", check_handler, frag_data);
+  tx = lcm_create("udpm://239.255.76.67:7706?ttl=0&mtu=1500"
+      "&reorder_rate=1");
+  ASSERT_TRUE(tx != NULL);
+  for (int i = 0; i < 10; i++)
+    lcm_publish(tx, "UDPM_FAULTS_FRAG", frag_data, 4000);
+  // the last datagram is held back until another one is transmitted
+  lcm_publish(tx, "UDPM_FAULTS", data, sizeof(data));
+  while (lcm_handle_timeout(rx, 200) > 0) {
+  }
+  lcm_destroy(tx);
+  int num_intact;
+  memcpy(&num_intact, frag_data + 4000, sizeof(int));
+  EXPECT_EQ(10, num_intact);
+  EXPECT_EQ(0, lcm_get_transport_stats(rx, &stats));
+  EXPECT_GE(stats.frag_bytes_high_watermark, 4000);
+
+  lcm_unsubscribe(rx, subs);
+  lcm_destroy(rx);
+}
+
+TEST(LCM_C, UdpmPublishStream) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7707?ttl=0&mtu=1500");
+  ASSERT_TRUE(lcm != NULL);
+  char data[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++)
+    data[i] = i % 251;
+  memset(data + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_STREAM", check_handler,
+      data);
+
+  // the fragments are sent while the message is written in uneven pieces
+  for (int i = 0; i < 3; i++) {
+    lcm_publish_stream_t* stream = lcm_publish_stream_begin(lcm,
+        "UDPM_STREAM", 4000);
+    ASSERT_TRUE(stream != NULL);
+    for (int offset = 0; offset < 4000; offset += 7) {
+      int len = offset + 7 <= 4000 ? 7 : 4000 - offset;
+      ASSERT_EQ(0, lcm_publish_stream_write(stream, data + offset, len));
+    }
+    EXPECT_EQ(0, lcm_publish_stream_end(stream));
+  }
+  while (lcm_handle_timeout(lcm, 200) > 0) {
+  }
+  int num_intact;
+  memcpy(&num_intact, data + 4000, sizeof(int));
+  EXPECT_EQ(3, num_intact);
+
+  // the size of the message has to be kept to
+  lcm_publish_stream_t* stream = lcm_publish_stream_begin(lcm, "UDPM_STREAM",
+      4000);
+  ASSERT_TRUE(stream != NULL);
+  EXPECT_EQ(0, lcm_publish_stream_write(stream, data, 3000));
+  EXPECT_EQ(-1, lcm_publish_stream_write(stream, data, 1001));
+  lcm_publish_stream_cancel(stream);
+  stream = lcm_publish_stream_begin(lcm, "UDPM_STREAM", 4000);
+  ASSERT_TRUE(stream != NULL);
+  EXPECT_EQ(0, lcm_publish_stream_write(stream, data, 3999));
+  EXPECT_EQ(-1, lcm_publish_stream_end(stream));
+
+  // and the transmit socket is usable again afterwards
+  EXPECT_EQ(0, lcm_publish(lcm, "UDPM_STREAM", data, 4000));
+  while (lcm_handle_timeout(lcm, 200) > 0) {
+  }
+  memcpy(&num_intact, data + 4000, sizeof(int));
+  EXPECT_EQ(4, num_intact);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+struct BatchReceived {
+  int num_received;
+  int out_of_order;
+};
+
+static void batch_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user) {
+  BatchReceived* received = (BatchReceived*) user;
+  int index;
+  memcpy(&index, rbuf->data, sizeof(index));
+  if (index != received->num_received)
+    received->out_of_order++;
+  received->num_received++;
+}
+
+TEST(LCM_C, UdpmBatch) {
+  lcm_t* rx = lcm_create("udpm://239.255.76.67:7708?ttl=0&self_test=off"
+      "&channel_filter=0");
+  ASSERT_TRUE(rx != NULL);
+  lcm_t* tx = lcm_create("udpm://239.255.76.67:7708?ttl=0&mtu=1500"
+      "&batch_us=100000");
+  ASSERT_TRUE(tx != NULL);
+
+  BatchReceived received;
+  memset(&received, 0, sizeof(received));
+  lcm_subscription_t* subs = lcm_subscribe(rx, "UDPM_BATCH", batch_handler,
+      &received);
+  lcm_subscription_set_queue_capacity(subs, 200);
+
+  // the small messages share datagrams, and the fragmented one in the
+  // middle stays in its place
+  char data[4000] = { 0 };
+  for (int i = 0; i < 101; i++) {
+    memcpy(data, &i, sizeof(i));
+    lcm_publish(tx, "UDPM_BATCH", data, i == 50 ? 4000 : 32);
+  }
+  // the last batch is transmitted when its time is up
+  while (received.num_received < 101 && lcm_handle_timeout(rx, 1000) > 0) {
+  }
+  EXPECT_EQ(101, received.num_received);
+  EXPECT_EQ(0, received.out_of_order);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(rx, &stats));
+  EXPECT_LT(stats.num_packets, 20);
+  EXPECT_EQ(0, stats.num_lost);
+  EXPECT_EQ(0, stats.num_bad_packets);
+
+  // the messages still waiting are transmitted when the sender is destroyed
+  int i = 101;
+  memcpy(data, &i, sizeof(i));
+  lcm_publish(tx, "UDPM_BATCH", data, 32);
+  lcm_destroy(tx);
+  while (received.num_received < 102 && lcm_handle_timeout(rx, 1000) > 0) {
+  }
+  EXPECT_EQ(102, received.num_received);
+
+  lcm_unsubscribe(rx, subs);
+  lcm_destroy(rx);
+}
+
+TEST(LCM_C, UdpmQos) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7709?ttl=0"
+      "&qos_channels=UDPM_QOS_URGENT&qos_dscp=46");
+  ASSERT_TRUE(lcm != NULL);
+
+  // listen to the group like a receiver would, and look at the TOS byte
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  int opt = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+  setsockopt(fd, IPPROTO_IP, IP_RECVTOS, &opt, sizeof(opt));
+  struct timeval timeout = { 1, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = INADDR_ANY;
+  addr.sin_port = htons(7709);
+  ASSERT_EQ(0, bind(fd, (struct sockaddr*) &addr, sizeof(addr)));
+  struct ip_mreq mreq;
+  mreq.imr_multiaddr.s_addr = inet_addr("239.255.76.67");
+  mreq.imr_interface.s_addr = INADDR_ANY;
+  ASSERT_EQ(0, setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+        sizeof(mreq)));
+
+  char data[100] = { 0 };
+  lcm_publish(lcm, "UDPM_QOS_BULK", data, sizeof(data));
+  lcm_publish(lcm, "UDPM_QOS_URGENT", data, sizeof(data));
+
+  int tos_bulk = -1;
+  int tos_urgent = -1;
+  uint16_t port_bulk = 0;
+  uint16_t port_urgent = 0;
+  while (tos_bulk < 0 || tos_urgent < 0) {
+    uint32_t pkt[1000];
+    char control[64];
+    struct sockaddr_in from;
+    struct iovec vec = { pkt, sizeof(pkt) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &from;
+    msg.msg_namelen = sizeof(from);
+    msg.msg_iov = &vec;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t sz = recvmsg(fd, &msg, 0);
+    ASSERT_GT(sz, 8);
+    int tos = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+        cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_TOS)
+        tos = *(unsigned char*) CMSG_DATA(cmsg);
+    }
+    if (!strcmp((char*) (pkt + 2), "UDPM_QOS_BULK")) {
+      tos_bulk = tos;
+      port_bulk = from.sin_port;
+    } else if (!strcmp((char*) (pkt + 2), "UDPM_QOS_URGENT")) {
+      tos_urgent = tos;
+      port_urgent = from.sin_port;
+    }
+  }
+  // the urgent channel goes out on a socket of its own
+  EXPECT_EQ(0, tos_bulk);
+  EXPECT_EQ(46 << 2, tos_urgent);
+  EXPECT_NE(port_bulk, port_urgent);
+
+  close(fd);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmFragStoreCap) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7710?ttl=0"
+      "&frag_store_mb=0.25&max_frag_msgs=4&prealloc=1"
+      "&recv_pool_size=1048576&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_FRAG_CAP",
+      count_handler, &num_received);
+
+  // a message larger than the cap is dropped, and those that fit still
+  // arrive through the preallocated pool
+  std::vector<char> data(400000);
+  lcm_publish(lcm, "UDPM_FRAG_CAP", &data[0], data.size());
+  lcm_publish(lcm, "UDPM_FRAG_CAP", &data[0], 100000);
+  lcm_publish(lcm, "UDPM_FRAG_CAP", &data[0], 100);
+  while (num_received < 2 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  EXPECT_EQ(2, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(1, stats.num_dropped_too_large);
+  EXPECT_EQ(0, stats.num_incomplete);
+  EXPECT_EQ(0, stats.num_dropped_no_buffer);
+  EXPECT_LE(stats.frag_bytes_high_watermark, 256 * 1024);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmFragTimeout) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7717?ttl=0&channel_filter=0"
+      "&frag_timeout_ms=100");
+  ASSERT_TRUE(lcm != NULL);
+
+  char a[4000 + sizeof(int)];
+  char b[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++) {
+    a[i] = i % 251;
+    b[i] = i % 241;
+  }
+  memset(a + 4000, 0, sizeof(int));
+  memset(b + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs_a = lcm_subscribe(lcm, "UDPM_TIMEOUT_A",
+      check_handler, a);
+  lcm_subscription_t* subs_b = lcm_subscribe(lcm, "UDPM_TIMEOUT_B",
+      check_handler, b);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  unsigned char ttl = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+  dest.sin_port = htons(7717);
+
+  // the first message stalls halfway, and is given up on once the next one
+  // starts arriving
+  send_fragment(fd, &dest, 20, "UDPM_TIMEOUT_A", a, 4000, 0, 4, 1000);
+  send_fragment(fd, &dest, 20, "UDPM_TIMEOUT_A", a, 4000, 1, 4, 1000);
+  usleep(300000);
+  for (int i = 0; i < 4; i++)
+    send_fragment(fd, &dest, 21, "UDPM_TIMEOUT_B", b, 4000, i, 4, 1000);
+  send_fragment(fd, &dest, 20, "UDPM_TIMEOUT_A", a, 4000, 2, 4, 1000);
+  send_fragment(fd, &dest, 20, "UDPM_TIMEOUT_A", a, 4000, 3, 4, 1000);
+  close(fd);
+
+  for (int i = 0; i < 2; i++)
+    lcm_handle_timeout(lcm, 500);
+  int num_a, num_b;
+  memcpy(&num_a, a + 4000, sizeof(int));
+  memcpy(&num_b, b + 4000, sizeof(int));
+  EXPECT_EQ(0, num_a);
+  EXPECT_EQ(1, num_b);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(1, stats.num_incomplete);
+
+  lcm_unsubscribe(lcm, subs_a);
+  lcm_unsubscribe(lcm, subs_b);
+  lcm_destroy(lcm);
+}
+
+static int wait_for_remote_subscribers(lcm_t* lcm, const char* channel,
+    int expected) {
+  for (int i = 0; i < 100; i++) {
+    if (lcm_has_remote_subscribers(lcm, channel) == expected)
+      return 1;
+    usleep(10000);
+  }
+  return 0;
+}
+
+TEST(LCM_C, UdpmInterest) {
+  lcm_t* sub = lcm_create("udpm://239.255.76.67:7713?ttl=0"
+      "&interest=1&announce_ms=50");
+  lcm_t* pub = lcm_create("udpm://239.255.76.67:7713?ttl=0"
+      "&interest=1&announce_ms=50&skip_unsubscribed=1");
+  lcm_t* plain = lcm_create("udpm://239.255.76.67:7713?ttl=0");
+  ASSERT_TRUE(sub != NULL);
+  ASSERT_TRUE(pub != NULL);
+  ASSERT_TRUE(plain != NULL);
+
+  // without interest, nothing is known, and everything goes out
+  EXPECT_EQ(-1, lcm_has_remote_subscribers(plain, "UDPM_INTEREST"));
+  EXPECT_EQ(1, lcm_publish_wanted(plain, "UDPM_INTEREST"));
+
+  // nobody subscribes, so the message is not transmitted
+  EXPECT_TRUE(wait_for_remote_subscribers(pub, "UDPM_INTEREST", 0));
+  EXPECT_EQ(0, lcm_publish(pub, "UDPM_INTEREST", "data", 4));
+  lcm_stats_t stats;
+  EXPECT_EQ(0, lcm_get_stats(pub, &stats));
+  EXPECT_EQ(1, stats.num_suppressed);
+  EXPECT_EQ(0, stats.num_published);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(sub, "UDPM_INTEREST",
+      count_handler, &num_received);
+  EXPECT_TRUE(wait_for_remote_subscribers(pub, "UDPM_INTEREST", 1));
+  EXPECT_EQ(1, lcm_publish_wanted(pub, "UDPM_INTEREST"));
+  EXPECT_EQ(0, lcm_publish(pub, "UDPM_INTEREST", "data", 4));
+  while (num_received < 1 && lcm_handle_timeout(sub, 1000) > 0) {
+  }
+  EXPECT_EQ(1, num_received);
+  EXPECT_EQ(0, lcm_get_stats(pub, &stats));
+  EXPECT_EQ(1, stats.num_suppressed);
+  EXPECT_EQ(1, stats.num_published);
+
+  lcm_unsubscribe(sub, subs);
+  EXPECT_TRUE(wait_for_remote_subscribers(pub, "UDPM_INTEREST", 0));
+  EXPECT_EQ(0, lcm_publish_wanted(pub, "UDPM_INTEREST"));
+
+  lcm_destroy(plain);
+  lcm_destroy(pub);
+  lcm_destroy(sub);
+}
+
+TEST(LCM_C, UdpmSubscribeToSeenChannel) {
+  // the subscriptions of a channel that messages already arrived on are
+  // found by its ID, and must follow subscribe and unsubscribe
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7714?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_first = 0, num_second = 0;
+  lcm_subscription_t* first = lcm_subscribe(lcm, "UDPM_IDS", count_handler,
+      &num_first);
+  EXPECT_EQ(0, lcm_publish(lcm, "UDPM_IDS", "data", 4));
+  while (num_first < 1 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  EXPECT_EQ(1, num_first);
+
+  lcm_subscription_t* second = lcm_subscribe(lcm, "UDPM_I.*", count_handler,
+      &num_second);
+  EXPECT_EQ(0, lcm_publish(lcm, "UDPM_IDS", "data", 4));
+  while (num_second < 1 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  EXPECT_EQ(2, num_first);
+  EXPECT_EQ(1, num_second);
+
+  lcm_unsubscribe(lcm, first);
+  EXPECT_EQ(0, lcm_publish(lcm, "UDPM_IDS", "data", 4));
+  while (num_second < 2 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  EXPECT_EQ(2, num_first);
+  EXPECT_EQ(2, num_second);
+
+  lcm_unsubscribe(lcm, second);
+  lcm_destroy(lcm);
+}
+
+static void order_handler(const lcm_recv_buf_t* rbuf, const char* channel,
+    void* user_data) {
+  ((std::vector<std::string>*) user_data)->push_back(channel);
+}
+
+TEST(LCM_C, UdpmPriority) {
+  // messages for a subscription with a higher priority are handled ahead of
+  // those that arrived before them
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7715?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  std::vector<std::string> seen;
+  lcm_subscribe(lcm, "UDPM_BULK", order_handler, &seen);
+  lcm_subscription_t* urgent = lcm_subscribe(lcm, "UDPM_URGENT",
+      order_handler, &seen);
+  EXPECT_EQ(0, lcm_subscription_set_priority(urgent, 1));
+
+  const int num_bulk = 20;
+  for (int i = 0; i < num_bulk; i++)
+    EXPECT_EQ(0, lcm_publish(lcm, "UDPM_BULK", "data", 4));
+  EXPECT_EQ(0, lcm_publish(lcm, "UDPM_URGENT", "data", 4));
+  usleep(200000);
+  while ((int) seen.size() < num_bulk + 1 &&
+      lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  ASSERT_EQ(num_bulk + 1, (int) seen.size());
+  EXPECT_EQ("UDPM_URGENT", seen[0]);
+
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmXdp) {
+  // the datagrams that the AF_XDP socket does not get, like those too long
+  // for its frames, still arrive the usual way, and so does everything where
+  // AF_XDP is not available
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7716?ttl=0&xdp=lo"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_XDP", count_handler,
+      &num_received);
+
+  const int size = 300000;
+  char* data = (char*) calloc(1, size);
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_XDP", data, 100);
+  lcm_publish(lcm, "UDPM_XDP", data, size);
+  for (int i = 0; i < 11 && num_received < 11; i++)
+    lcm_handle_timeout(lcm, 1000);
+  EXPECT_EQ(11, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_bad_packets);
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  free(data);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmInterfaces) {
+  // the loopback interface listed twice stands in for two links
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7719?ttl=0"
+      "&interfaces=lo,127.0.0.1&interface_mode=redundant"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_IFACES", count_handler,
+      &num_received);
+  lcm_subscription_set_queue_capacity(subs, 100);
+
+  // every datagram arrives twice, and each message is handled once
+  const int size = 200000;
+  char* data = (char*) calloc(1, size);
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_IFACES", data, 100);
+  lcm_publish(lcm, "UDPM_IFACES", data, size);
+  while (lcm_handle_timeout(lcm, 500) > 0) {
+  }
+  EXPECT_EQ(11, num_received);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_LE(10, stats.num_duplicated);
+  EXPECT_EQ(0, stats.num_incomplete);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+
+  // striped, they all arrive once
+  lcm = lcm_create("udpm://239.255.76.67:7719?ttl=0&interfaces=lo,lo"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+  num_received = 0;
+  subs = lcm_subscribe(lcm, "UDPM_IFACES", count_handler, &num_received);
+  lcm_subscription_set_queue_capacity(subs, 100);
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_IFACES", data, 100);
+  lcm_publish(lcm, "UDPM_IFACES", data, size);
+  while (lcm_handle_timeout(lcm, 500) > 0) {
+  }
+  EXPECT_EQ(11, num_received);
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_duplicated);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+
+  EXPECT_EQ(NULL, lcm_create("udpm://239.255.76.67:7719?ttl=0"
+      "&interfaces=no_such_interface"));
+  free(data);
+}
+
+TEST(LCM_C, UdpmInterfacesReordered) {
+  // with the channel filter on, as by default
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7722?ttl=0&interfaces=lo,lo");
+  ASSERT_TRUE(lcm != NULL);
+
+  char a[4000 + sizeof(int)];
+  for (int i = 0; i < 4000; i++)
+    a[i] = i % 251;
+  memset(a + 4000, 0, sizeof(int));
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_IFACES_REORDERED",
+      check_handler, a);
+
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(fd, 0);
+  unsigned char ttl = 0;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  struct sockaddr_in dest;
+  memset(&dest, 0, sizeof(dest));
+  dest.sin_family = AF_INET;
+  dest.sin_addr.s_addr = inet_addr("239.255.76.67");
+  dest.sin_port = htons(7722);
+
+  // striped over two links, a later fragment may overtake the first one,
+  // and the copies that come over the other link of redundant senders are
+  // dropped, also once the message is complete
+  const char* channel = "UDPM_IFACES_REORDERED";
+  send_fragment(fd, &dest, 20, channel, a, 4000, 1, 4, 1000);
+  send_fragment(fd, &dest, 20, channel, a, 4000, 0, 4, 1000);
+  send_fragment(fd, &dest, 20, channel, a, 4000, 1, 4, 1000);
+  send_fragment(fd, &dest, 20, channel, a, 4000, 3, 4, 1000);
+  send_fragment(fd, &dest, 20, channel, a, 4000, 2, 4, 1000);
+  for (int i = 0; i < 4; i++)
+    send_fragment(fd, &dest, 20, channel, a, 4000, i, 4, 1000);
+  close(fd);
+
+  while (lcm_handle_timeout(lcm, 500) > 0) {
+  }
+  int num_a;
+  memcpy(&num_a, a + 4000, sizeof(int));
+  EXPECT_EQ(1, num_a);
+
+  lcm_transport_stats_t stats;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &stats));
+  EXPECT_EQ(0, stats.num_incomplete);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+TEST(LCM_C, UdpmPacingShortMessages) {
+  // at 10 kbit/s, pacing 20 KB would take 16 seconds
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7720?ttl=0"
+      "&max_rate_mbps=0.01&burst_kb=1");
+  ASSERT_TRUE(lcm != NULL);
+
+  // messages that fit in a single datagram are never delayed
+  char data[1000] = { 0 };
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < 20; i++)
+    EXPECT_EQ(0, lcm_publish(lcm, "UDPM_PACING", data, sizeof(data)));
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) +
+      (end.tv_nsec - start.tv_nsec) / 1e9;
+  EXPECT_LT(elapsed, 1.0);
+
+  lcm_destroy(lcm);
+}
+
+static void last_payload_handler(const lcm_recv_buf_t* rbuf,
+    const char* channel, void* user) {
+  memcpy(user, rbuf->data, sizeof(int));
+}
+
+TEST(LCM_C, UdpmConflate) {
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7721?ttl=0");
+  ASSERT_TRUE(lcm != NULL);
+
+  int num_received = 0;
+  int last = -1;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_CONFLATE",
+      count_handler, &num_received);
+  EXPECT_EQ(0, lcm_subscription_set_conflate(subs, 1));
+  lcm_subscription_t* payload = lcm_subscribe(lcm, "UDPM_CONFLATE",
+      last_payload_handler, &last);
+  EXPECT_EQ(0, lcm_subscription_set_conflate(payload, 1));
+
+  // the messages that are still waiting for lcm_handle() when a newer one
+  // arrives are skipped, and the newest is delivered
+  for (int i = 0; i < 10; i++)
+    lcm_publish(lcm, "UDPM_CONFLATE", &i, sizeof(i));
+  usleep(100000);
+  while (lcm_handle_timeout(lcm, 100) > 0) {
+  }
+  EXPECT_EQ(1, num_received);
+  EXPECT_EQ(9, last);
+
+  lcm_subscription_stats_t stats;
+  EXPECT_EQ(0, lcm_subscription_get_stats(subs, &stats));
+  EXPECT_EQ(9, stats.num_dropped);
+  EXPECT_EQ(1, stats.num_dispatched);
+
+  lcm_unsubscribe(lcm, payload);
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+static void first_byte_handler(const lcm_recv_buf_t* rbuf,
+    const char* channel, void* user) {
+  ((std::vector<int>*) user)->push_back(((const uint8_t*) rbuf->data)[0]);
+}
+
+TEST(LCM_C, UdpmMaxRateFragmented) {
+  // the fragments of a message that only rate-limited subscriptions would
+  // get, and that comes too soon, are dropped as they arrive
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7723?ttl=0"
+      "&recv_buf_size=4000000");
+  ASSERT_TRUE(lcm != NULL);
+
+  std::vector<int> seen;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_RATE_FRAG",
+      first_byte_handler, &seen);
+  EXPECT_EQ(0, lcm_subscription_set_max_rate(subs, 2));
+
+  const int size = 200000;
+  std::vector<uint8_t> data(size);
+  for (int i = 0; i < 5; i++) {
+    data[0] = i;
+    lcm_publish(lcm, "UDPM_RATE_FRAG", &data[0], size);
+  }
+  while (lcm_handle_timeout(lcm, 200) > 0) {
+  }
+  ASSERT_EQ(1u, seen.size());
+  EXPECT_EQ(0, seen[0]);
+
+  lcm_subscription_stats_t stats;
+  EXPECT_EQ(0, lcm_subscription_get_stats(subs, &stats));
+  EXPECT_EQ(4, stats.num_decimated);
+  lcm_transport_stats_t transport;
+  EXPECT_EQ(0, lcm_get_transport_stats(lcm, &transport));
+  EXPECT_EQ(0, transport.num_incomplete);
+
+  // once the subscription is due again, the next one is reassembled
+  usleep(600000);
+  data[0] = 5;
+  lcm_publish(lcm, "UDPM_RATE_FRAG", &data[0], size);
+  while (seen.size() < 2 && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  ASSERT_EQ(2u, seen.size());
+  EXPECT_EQ(5, seen[1]);
+
+  lcm_unsubscribe(lcm, subs);
+  lcm_destroy(lcm);
+}
+
+#ifdef __linux__
+struct ChurnState {
+  lcm_t* lcm;
+  std::atomic<int> stop;
+  int num_churned;
+  int num_ignored;  // only touched by the handlers, in lcm_handle()
+};
+
+static void* churn_subscriptions(void* user) {
+  ChurnState* state = (ChurnState*) user;
+  char channel[32];
+  while (!state->stop) {
+    lcm_subscription_t* subs[4];
+    for (int i = 0; i < 4; i++) {
+      snprintf(channel, sizeof(channel), "UDPM_CHURN_%d", i);
+      subs[i] = lcm_subscribe(state->lcm, i % 2 ? channel : "UDPM_CHURN_.*",
+          count_handler, &state->num_ignored);
+    }
+    lcm_subscription_t* stable = lcm_subscribe(state->lcm, "UDPM_STABLE",
+        count_handler, &state->num_ignored);
+    for (int i = 0; i < 4; i++)
+      lcm_unsubscribe(state->lcm, subs[i]);
+    lcm_unsubscribe(state->lcm, stable);
+    state->num_churned++;
+  }
+  return NULL;
+}
+
+TEST(LCM_C, UdpmShardedChurn) {
+  // subscriptions come and go on another thread while both receive threads
+  // look up and dispatch the messages of two senders
+  lcm_t* lcm = lcm_create("udpm://239.255.76.67:7724?ttl=0&recv_threads=2"
+      "&recv_buf_size=2000000");
+  ASSERT_TRUE(lcm != NULL);
+  lcm_t* senders[2];
+  for (int i = 0; i < 2; i++) {
+    senders[i] = lcm_create("udpm://239.255.76.67:7724?ttl=0");
+    ASSERT_TRUE(senders[i] != NULL);
+  }
+
+  int num_received = 0;
+  lcm_subscription_t* subs = lcm_subscribe(lcm, "UDPM_STABLE",
+      count_handler, &num_received);
+  lcm_subscription_set_queue_capacity(subs, 0);
+
+  ChurnState state;
+  state.lcm = lcm;
+  state.stop = 0;
+  state.num_churned = 0;
+  state.num_ignored = 0;
+  pthread_t churn;
+  pthread_create(&churn, NULL, churn_subscriptions, &state);
+
+  const int num_msgs = 400;
+  char data[100] = { 0 };
+  std::vector<char> big(100000, 0);
+  char channel[32];
+  for (int i = 0; i < num_msgs; i++) {
+    lcm_t* sender = senders[i % 2];
+    snprintf(channel, sizeof(channel), "UDPM_CHURN_%d", i % 4);
+    lcm_publish(sender, channel, data, sizeof(data));
+    if (i % 10)
+      lcm_publish(sender, "UDPM_STABLE", data, sizeof(data));
+    else
+      lcm_publish(sender, "UDPM_STABLE", &big[0], big.size());
+    while (lcm_handle_timeout(lcm, 0) > 0) {
+    }
+    usleep(200);
+  }
+  while (num_received < num_msgs && lcm_handle_timeout(lcm, 1000) > 0) {
+  }
+  state.stop = 1;
+  pthread_join(churn, NULL);
+
+  EXPECT_EQ(num_msgs, num_received);
+  EXPECT_LT(0, state.num_churned);
+
+  lcm_unsubscribe(lcm, subs);
+  for (int i = 0; i < 2; i++)
+    lcm_destroy(senders[i]);
+  lcm_destroy(lcm);
+}
+#endif
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>
+
+#include "lcm/udpm_util.h"
+
+// The ring only stores the pointers, so the tests fill it with counters.
+static lcm_buf_t* ring_el(uintptr_t i) {
+  return (lcm_buf_t*) (i + 1);
+}
+
+static uintptr_t ring_index(lcm_buf_t* el) {
+  return (uintptr_t) el - 1;
+}
+
+TEST(LCM_C, UdpmBufRingWraparound) {
+  // head and tail run past the capacity many times over, and the pushes
+  // and pops do not line up with the end of the slots
+  lcm_buf_ring_t* ring = lcm_buf_ring_new(4);
+  EXPECT_TRUE(lcm_buf_ring_is_empty(ring));
+  EXPECT_EQ(NULL, lcm_buf_ring_pop(ring));
+
+  uintptr_t next_push = 0;
+  uintptr_t next_pop = 0;
+  for (int round = 0; round < 1000; round++) {
+    for (int i = 0; i < 3; i++)
+      ASSERT_EQ(0, lcm_buf_ring_push(ring, ring_el(next_push++)));
+    EXPECT_FALSE(lcm_buf_ring_is_empty(ring));
+    for (int i = 0; i < 3; i++) {
+      lcm_buf_t* el = lcm_buf_ring_pop(ring);
+      ASSERT_TRUE(el != NULL);
+      ASSERT_EQ(next_pop++, ring_index(el));
+    }
+    EXPECT_TRUE(lcm_buf_ring_is_empty(ring));
+    EXPECT_EQ(NULL, lcm_buf_ring_pop(ring));
+  }
+  lcm_buf_ring_free(ring);
+}
+
+TEST(LCM_C, UdpmBufRingFull) {
+  lcm_buf_ring_t* ring = lcm_buf_ring_new(8);
+  for (uintptr_t i = 0; i < 8; i++)
+    EXPECT_EQ(0, lcm_buf_ring_push(ring, ring_el(i)));
+  // a full ring turns the producer away without overwriting anything
+  EXPECT_EQ(-1, lcm_buf_ring_push(ring, ring_el(100)));
+
+  // each pop makes room for exactly one more
+  EXPECT_EQ(0u, ring_index(lcm_buf_ring_pop(ring)));
+  EXPECT_EQ(0, lcm_buf_ring_push(ring, ring_el(8)));
+  EXPECT_EQ(-1, lcm_buf_ring_push(ring, ring_el(100)));
+
+  for (uintptr_t i = 1; i <= 8; i++)
+    EXPECT_EQ(i, ring_index(lcm_buf_ring_pop(ring)));
+  EXPECT_TRUE(lcm_buf_ring_is_empty(ring));
+  lcm_buf_ring_free(ring);
+}
+
+TEST(LCM_C, UdpmBufRingThreads) {
+  // A small ring between two threads keeps filling up, so the producer
+  // spends much of its time turned away.  Every element still comes out
+  // once and in order.
+  lcm_buf_ring_t* ring = lcm_buf_ring_new(16);
+  const uintptr_t num_els = 1000000;
+  std::atomic<int64_t> num_full(0);
+
+  std::thread producer([&]() {
+    for (uintptr_t i = 0; i < num_els; i++) {
+      while (lcm_buf_ring_push(ring, ring_el(i)) < 0) {
+        num_full++;
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  // let the ring fill up once before draining it
+  while (!num_full)
+    std::this_thread::yield();
+  uintptr_t next = 0;
+  int64_t num_out_of_order = 0;
+  while (next < num_els) {
+    lcm_buf_t* el = lcm_buf_ring_pop(ring);
+    if (!el) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (ring_index(el) != next)
+      num_out_of_order++;
+    next++;
+  }
+  producer.join();
+
+  EXPECT_EQ(0, num_out_of_order);
+  EXPECT_TRUE(lcm_buf_ring_is_empty(ring));
+  EXPECT_EQ(NULL, lcm_buf_ring_pop(ring));
+  EXPECT_LT(0, num_full.load());
+  lcm_buf_ring_free(ring);
+}
@@ -0,0 +1,91 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <gtest/gtest.h>
+
+#include <lcm/lcm-cpp.hpp>
+
+// Writes 30 events, alternating between channels A and B, with timestamps
+// 0, 100, 200, ... and the event number in the data.
+static std::string WriteTestLog() {
+    char fname[] = "/tmp/lcm-cpp-eventlog-XXXXXX";
+    int fd = mkstemp(fname);
+    EXPECT_LE(0, fd);
+    close(fd);
+    lcm::LogFile log(fname, "w");
+    EXPECT_TRUE(log.good());
+    for (int32_t i = 0; i < 30; ++i) {
+        lcm::LogEvent event;
+        event.timestamp = i * 100;
+        event.channel = i % 2 ? "B" : "A";
+        event.datalen = sizeof(i);
+        event.data = &i;
+        EXPECT_EQ(0, log.writeEvent(&event));
+    }
+    return fname;
+}
+
+TEST(LCM_CPP, LogFileEvents) {
+    std::string fname = WriteTestLog();
+    lcm::LogFile log(fname, "r");
+    ASSERT_TRUE(log.good());
+    int num_events = 0;
+    lcm::LogFile::EventRange events = log.events();
+    for (lcm::LogFile::EventIterator it = events.begin(); it != events.end();
+            ++it) {
+        EXPECT_EQ(num_events, it->eventnum);
+        EXPECT_EQ(num_events * 100, it->timestamp);
+        EXPECT_STREQ(num_events % 2 ? "B" : "A", it->channel);
+        EXPECT_EQ(1, it->channellen);
+        ASSERT_EQ((int32_t)sizeof(int32_t), it->datalen);
+        int32_t value;
+        memcpy(&value, it->data, sizeof(value));
+        EXPECT_EQ(num_events, value);
+        num_events++;
+    }
+    EXPECT_EQ(30, num_events);
+    // the events have been read
+    EXPECT_TRUE(log.events().begin() == log.events().end());
+    unlink(fname.c_str());
+}
+
+TEST(LCM_CPP, LogFileEventsRange) {
+    std::string fname = WriteTestLog();
+    lcm::LogFile log(fname, "r");
+    ASSERT_TRUE(log.good());
+    int64_t expected = 1000;
+    lcm::LogFile::EventRange events = log.events(950, 2000);
+    for (lcm::LogFile::EventIterator it = events.begin(); it != events.end();
+            ++it) {
+        EXPECT_EQ(expected, it->timestamp);
+        expected += 100;
+    }
+    EXPECT_EQ(2000, expected);
+
+    // ranges can go back in the log
+    events = log.events(0, 250);
+    int num_events = 0;
+    for (lcm::LogFile::EventIterator it = events.begin(); it != events.end();
+            ++it)
+        num_events++;
+    EXPECT_EQ(3, num_events);
+    unlink(fname.c_str());
+}
+
+TEST(LCM_CPP, LogFileEventsFiltered) {
+    std::string fname = WriteTestLog();
+    EXPECT_FALSE(lcm::LogFile(fname, "w", "B").good());
+    lcm::LogFile log(fname, "r", "B");
+    ASSERT_TRUE(log.good());
+    int num_events = 0;
+    lcm::LogFile::EventRange events = log.events();
+    for (lcm::LogFile::EventIterator it = events.begin(); it != events.end();
+            ++it) {
+        EXPECT_STREQ("B", it->channel);
+        EXPECT_EQ(num_events * 200 + 100, it->timestamp);
+        num_events++;
+    }
+    EXPECT_EQ(15, num_events);
+    unlink(fname.c_str());
+}
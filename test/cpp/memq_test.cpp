@@ -1,9 +1,15 @@
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include <lcm/lcm-cpp.hpp>
 
+#include "common.hpp"
+
 TEST(LCM_CPP, MemqConstructDestroy) {
     lcm::LCM lcm("memq://");
     EXPECT_TRUE(lcm.good());
@@ -104,3 +110,477 @@ TEST(LCM_CPP, MemqTimeout) {
     EXPECT_LT(0, lcm.handleTimeout(10000));
     EXPECT_TRUE(msg_handled);
 }
+
+TEST(LCM_CPP, MemqHandleBatch) {
+    // Publish many messages, then drain them in batches.
+    lcm::LCM lcm("memq://");
+    std::vector<std::vector<uint8_t> > received_buffers;
+
+    lcm::Subscription* subs = lcm.subscribeFunction("channel",
+            MemqBufferedHandler, &received_buffers);
+    subs->setQueueCapacity(0);
+
+    // No messages available.  Call should timeout.
+    EXPECT_EQ(0, lcm.handleBatch(10, 0));
+
+    // Invalid arguments should result in an error.
+    EXPECT_GT(0, lcm.handleBatch(0, 0));
+    EXPECT_GT(0, lcm.handleBatch(10, -1));
+
+    int num_bufs = 25;
+    std::vector<std::vector<uint8_t> > buffers(num_bufs);
+    for (int buf_num = 0; buf_num < num_bufs; ++buf_num) {
+        std::vector<uint8_t>& buf = buffers[buf_num];
+        buf.resize(10, buf_num);
+        lcm.publish("channel", &buf[0], buf.size());
+    }
+
+    EXPECT_EQ(10, lcm.handleBatch(10, 0));
+    EXPECT_EQ(10, lcm.handleBatch(10, 0));
+    EXPECT_EQ(5, lcm.handleBatch(10, 0));
+    EXPECT_EQ(0, lcm.handleBatch(10, 0));
+
+    EXPECT_EQ(buffers, received_buffers);
+}
+
+TEST(LCM_CPP, MemqHandleReady) {
+    lcm::LCM lcm("memq://");
+    std::vector<std::vector<uint8_t> > received_buffers;
+    lcm::Subscription* subs = lcm.subscribeFunction("channel",
+            MemqBufferedHandler, &received_buffers);
+    subs->setQueueCapacity(0);
+
+    EXPECT_EQ(0, lcm.handleReady());
+    std::vector<uint8_t> buf(10, 1);
+    for (int i = 0; i < 150; ++i)
+        lcm.publish("channel", &buf[0], buf.size());
+    EXPECT_EQ(100, lcm.handleReady());
+    EXPECT_EQ(30, lcm.handleReady(30));
+    EXPECT_EQ(20, lcm.handleReady());
+    EXPECT_EQ(0, lcm.handleReady());
+    EXPECT_EQ(150u, received_buffers.size());
+}
+
+static void MemqStatsBlockingHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel,
+        std::atomic<bool>* released) {
+    do {
+        usleep(1000);
+    } while (!*released);
+}
+
+TEST(LCM_CPP, MemqSubscriptionStats) {
+    // Stall the handler on a dispatch thread so that the subscription's queue
+    // overflows, and check that the drops are counted.
+    lcm::LCM lcm("memq://?dispatch_threads=1");
+    std::atomic<bool> released(false);
+
+    lcm::Subscription* subs = lcm.subscribeFunction("channel",
+            MemqStatsBlockingHandler, &released);
+    subs->setQueueCapacity(5);
+
+    lcm::SubscriptionStats stats = subs->getStats();
+    EXPECT_EQ(0, stats.num_enqueued);
+    EXPECT_EQ(0, stats.num_dispatched);
+    EXPECT_EQ(0, stats.num_dropped);
+    EXPECT_EQ(0, stats.peak_queue_depth);
+
+    const int num_bufs = 20;
+    std::vector<uint8_t> buf(10);
+    for (int buf_num = 0; buf_num < num_bufs; ++buf_num) {
+        lcm.publish("channel", &buf[0], buf.size());
+        EXPECT_EQ(1, lcm.handleTimeout(0));
+    }
+
+    // the first message is held by the handler, and the queue holds the
+    // capacity plus one more.
+    stats = subs->getStats();
+    EXPECT_EQ(6, stats.num_enqueued);
+    EXPECT_EQ(num_bufs - 6, stats.num_dropped);
+    EXPECT_EQ(6, stats.peak_queue_depth);
+
+    released = true;
+    for (int i = 0; i < 1000 && subs->getStats().num_dispatched < 6; i++) {
+        usleep(1000);
+    }
+    stats = subs->getStats();
+    EXPECT_EQ(6, stats.num_dispatched);
+    EXPECT_GT(stats.handler_time_usec, 0);
+}
+
+static void MemqSlowHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel, void* unused) {
+    usleep(3000);
+}
+
+static void MemqSlowHandlerCallback(lcm_subscription_t* subs,
+        const char* channel, int64_t handler_time_usec, void* user_data) {
+    (*(int*)user_data)++;
+}
+
+TEST(LCM_CPP, MemqSlowHandler) {
+    lcm::LCM lcm("memq://");
+    lcm::Subscription* subs = lcm.subscribeFunction("channel",
+            MemqSlowHandler, (void*) NULL);
+    int num_slow = 0;
+    EXPECT_EQ(0, lcm.setSlowHandlerThreshold(2000, MemqSlowHandlerCallback,
+                &num_slow));
+
+    std::vector<uint8_t> buf(10);
+    lcm.publish("channel", &buf[0], buf.size());
+    EXPECT_EQ(1, lcm.handleTimeout(0));
+    EXPECT_EQ(1, num_slow);
+
+    lcm::SubscriptionStats stats = subs->getStats();
+    EXPECT_EQ(1, stats.num_slow);
+    EXPECT_LE(3000, stats.max_handler_time_usec);
+    // 3000 us or more is in [2048, 4096) or later
+    int64_t slow_bucket = 0;
+    for (int i = 12; i < LCM_HANDLER_HISTOGRAM_BUCKETS; ++i)
+        slow_bucket += stats.handler_time_histogram[i];
+    EXPECT_EQ(1, slow_bucket);
+}
+
+struct MemqReuseState {
+    int expected;
+    int num_handled;
+};
+
+static void MemqReuseHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel, const lcmtest::primitives_list_t* msg,
+        MemqReuseState* state) {
+    EXPECT_TRUE(CheckLcmType(msg, state->expected));
+    EXPECT_EQ(state->expected, (int)msg->items.size());
+    for (int i = 0; i < msg->num_items; ++i) {
+        EXPECT_EQ(msg->items[i].num_ranges, (int)msg->items[i].ranges.size());
+    }
+    state->num_handled++;
+}
+
+class MemqReuseObject {
+  public:
+    MemqReuseState state;
+    void onMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+            const lcmtest::primitives_list_t* msg) {
+        MemqReuseHandler(rbuf, channel, msg, &state);
+    }
+};
+
+TEST(LCM_CPP, MemqTypedReuse) {
+    // Subscriptions decode every message into the same object, which must
+    // not keep the elements of earlier, longer messages.
+    lcm::LCM lcm("memq://");
+    MemqReuseState state = {0, 0};
+    MemqReuseObject obj;
+    obj.state = state;
+    lcm.subscribeFunction("channel", MemqReuseHandler, &state);
+    lcm.subscribe("channel", &MemqReuseObject::onMessage, &obj);
+
+    const int sizes[] = {20, 3, 0, 40, 0, 7};
+    for (int i = 0; i < 6; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        lcm.publish("channel", &msg);
+        state.expected = obj.state.expected = sizes[i];
+        EXPECT_EQ(0, lcm.handle());
+    }
+    EXPECT_EQ(6, state.num_handled);
+    EXPECT_EQ(6, obj.state.num_handled);
+}
+
+TEST(LCM_CPP, MemqPublishBuffer) {
+    lcm::LCM lcm("memq://");
+    MemqReuseState state = {0, 0};
+    lcm.subscribeFunction("channel", MemqReuseHandler, &state);
+
+    std::vector<uint8_t> buf;
+    const int sizes[] = {10, 2};
+    for (int i = 0; i < 2; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        EXPECT_EQ(0, lcm.publish("channel", &msg, buf));
+        EXPECT_EQ(msg.getEncodedSize(), (int)buf.size());
+
+        lcmtest::primitives_list_t decoded;
+        EXPECT_EQ((int)buf.size(), decoded.decode(&buf[0], 0, buf.size()));
+        EXPECT_TRUE(CheckLcmType(&decoded, sizes[i]));
+
+        state.expected = sizes[i];
+        EXPECT_EQ(0, lcm.handle());
+    }
+    EXPECT_EQ(2, state.num_handled);
+}
+
+#ifdef LCM_CXX_11_ENABLED
+static void MemqMoveHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel, lcmtest::primitives_list_t&& msg,
+        std::vector<lcmtest::primitives_list_t>* queue) {
+    queue->push_back(std::move(msg));
+}
+
+class MemqMoveObject {
+  public:
+    std::vector<lcmtest::primitives_list_t> queue;
+    void onMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+            lcmtest::primitives_list_t&& msg) {
+        queue.push_back(std::move(msg));
+    }
+};
+
+TEST(LCM_CPP, MemqTypedMove) {
+    lcm::LCM lcm("memq://");
+    std::vector<lcmtest::primitives_list_t> queue;
+    MemqMoveObject obj;
+    lcm.subscribeFunction("channel", MemqMoveHandler, &queue);
+    lcm.subscribe("channel", &MemqMoveObject::onMessage, &obj);
+
+    const int sizes[] = {20, 0, 5};
+    for (int i = 0; i < 3; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        lcm.publish("channel", &msg);
+        EXPECT_EQ(0, lcm.handle());
+    }
+    ASSERT_EQ(3u, queue.size());
+    ASSERT_EQ(3u, obj.queue.size());
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(CheckLcmType(&queue[i], sizes[i]));
+        EXPECT_TRUE(CheckLcmType(&obj.queue[i], sizes[i]));
+    }
+}
+#endif
+
+#ifdef LCM_CXX_11_ENABLED
+// a callable that can only be moved into its subscription
+struct MemqMoveOnlyHandler {
+    std::unique_ptr<std::vector<lcmtest::primitives_list_t> > queue;
+    std::vector<lcmtest::primitives_list_t>* moved;
+    void operator()(const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+            lcmtest::primitives_list_t&& msg) {
+        queue->push_back(std::move(msg));
+        *moved = *queue;
+    }
+};
+
+TEST(LCM_CPP, MemqCallable) {
+    // the lambdas live in their subscriptions, including one that can only
+    // be moved
+    lcm::LCM lcm("memq://");
+    std::vector<const lcmtest::primitives_list_t*> decoded_into;
+    std::vector<int> sizes_seen;
+    lcm.subscribe<lcmtest::primitives_list_t>("chan.*",
+        [&](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+                const lcmtest::primitives_list_t* msg) {
+            decoded_into.push_back(msg);
+            sizes_seen.push_back(msg->num_items);
+            EXPECT_TRUE(CheckLcmType(msg, msg->num_items));
+            EXPECT_EQ(0, channel.compare(0, 4, "chan"));
+        });
+    std::vector<lcmtest::primitives_list_t> moved;
+    MemqMoveOnlyHandler handler;
+    handler.queue.reset(new std::vector<lcmtest::primitives_list_t>());
+    handler.moved = &moved;
+    lcm.subscribe<lcmtest::primitives_list_t>("channel", std::move(handler));
+    int num_raw = 0;
+    lcm::Subscription* raw = lcm.subscribe("channel",
+        [&num_raw](const lcm::ReceiveBuffer* rbuf, const std::string& channel) {
+            EXPECT_EQ("channel", channel);
+            EXPECT_LT(0u, rbuf->data_size);
+            num_raw++;
+        });
+
+    const int sizes[] = {20, 0, 5, 3};
+    const char* channels[] = {"channel", "channel", "channel", "chan2"};
+    for (int i = 0; i < 4; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        lcm.publish(channels[i], &msg);
+        EXPECT_EQ(0, lcm.handle());
+    }
+    ASSERT_EQ(4u, sizes_seen.size());
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(sizes[i], sizes_seen[i]);
+        EXPECT_EQ(decoded_into[0], decoded_into[i]);
+    }
+    ASSERT_EQ(3u, moved.size());
+    for (int i = 0; i < 3; ++i)
+        EXPECT_TRUE(CheckLcmType(&moved[i], sizes[i]));
+    EXPECT_EQ(3, num_raw);
+    EXPECT_EQ(0, lcm.unsubscribe(raw));
+}
+#endif
+
+#ifdef LCM_CXX_11_ENABLED
+static void MemqSharedHandler(const lcm::ReceiveBuffer* rbuf,
+        const std::string& channel, const lcmtest::primitives_list_t* msg,
+        std::vector<const lcmtest::primitives_list_t*>* seen) {
+    seen->push_back(msg);
+}
+
+class MemqSharedObject {
+  public:
+    std::vector<const lcmtest::primitives_list_t*> seen;
+    void onMessage(const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+            const lcmtest::primitives_list_t* msg) {
+        seen.push_back(msg);
+    }
+};
+
+TEST(LCM_CPP, MemqSharedDecode) {
+    // the subscriptions of the same type are handed the same decoded message,
+    // except the ones that take it by rvalue reference
+    lcm::LCM lcm("memq://");
+    std::vector<const lcmtest::primitives_list_t*> by_function;
+    MemqSharedObject obj;
+    std::vector<const lcmtest::primitives_list_t*> by_lambda;
+    std::vector<lcmtest::primitives_list_t> moved;
+    lcm.subscribeFunction("channel", MemqSharedHandler, &by_function);
+    lcm.subscribe("channel", &MemqSharedObject::onMessage, &obj);
+    lcm.subscribe<lcmtest::primitives_list_t>("channel",
+        [&](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+                const lcmtest::primitives_list_t* msg) {
+            EXPECT_TRUE(CheckLcmType(msg, msg->num_items));
+            by_lambda.push_back(msg);
+        });
+    lcm.subscribe<lcmtest::primitives_list_t>("channel",
+        [&](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+                lcmtest::primitives_list_t&& msg) {
+            moved.push_back(std::move(msg));
+        });
+
+    const int sizes[] = {20, 0, 5};
+    for (int i = 0; i < 3; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        lcm.publish("channel", &msg);
+        EXPECT_EQ(0, lcm.handle());
+        ASSERT_EQ(i + 1, (int)by_lambda.size());
+        EXPECT_EQ(by_lambda[i], by_function[i]);
+        EXPECT_EQ(by_lambda[i], obj.seen[i]);
+        EXPECT_TRUE(CheckLcmType(&moved[i], sizes[i]));
+    }
+
+    // it is decoded into the first subscription's object, which it keeps
+    for (int i = 0; i < 3; ++i)
+        EXPECT_EQ(by_function[0], by_function[i]);
+
+    // a subscription removed during the dispatch no longer hands out its
+    // object
+    lcm::LCM removing("memq://");
+    std::vector<const lcmtest::primitives_list_t*> before;
+    std::vector<const lcmtest::primitives_list_t*> after;
+    lcm::Subscription* first = removing.subscribeFunction("channel",
+            MemqSharedHandler, &before);
+    removing.subscribe<lcmtest::primitives_list_t>("channel",
+        [&](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+                const lcmtest::primitives_list_t* msg) {
+            EXPECT_EQ(before[0], msg);
+            removing.unsubscribe(first);
+        });
+    removing.subscribeFunction("channel", MemqSharedHandler, &after);
+    lcmtest::primitives_list_t msg;
+    FillLcmType(5, &msg);
+    removing.publish("channel", &msg);
+    EXPECT_EQ(0, removing.handle());
+    ASSERT_EQ(1u, after.size());
+    EXPECT_NE(before[0], after[0]);
+    EXPECT_TRUE(CheckLcmType(after[0], 5));
+
+    // on dispatch threads each subscription decodes its own, since it may
+    // already decode its next message while the others read this one
+    lcm::LCM pooled("memq://?dispatch_threads=2");
+    const int num_msgs = 50;
+    std::atomic<int> num_intact(0);
+    std::atomic<int> num_handled(0);
+    for (int i = 0; i < 2; ++i) {
+        pooled.subscribe<lcmtest::primitives_list_t>("channel",
+            [&](const lcm::ReceiveBuffer* rbuf, const std::string& channel,
+                    const lcmtest::primitives_list_t* msg) {
+                usleep(100);
+                if (CheckLcmType(msg, 5))
+                    num_intact++;
+                num_handled++;
+            })->setQueueCapacity(0);
+    }
+    for (int i = 0; i < num_msgs; ++i) {
+        FillLcmType(5, &msg);
+        pooled.publish("channel", &msg);
+        EXPECT_EQ(0, pooled.handle());
+    }
+    while (num_handled < 2 * num_msgs)
+        std::this_thread::yield();
+    EXPECT_EQ(2 * num_msgs, num_intact);
+}
+#endif
+
+TEST(LCM_CPP, MemqPublishStream) {
+    lcm::LCM lcm("memq://");
+    MemqReuseState state = {0, 0};
+    lcm.subscribeFunction("channel", MemqReuseHandler, &state);
+
+    const int sizes[] = {0, 3, 500};
+    for (int i = 0; i < 3; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(sizes[i], &msg);
+        EXPECT_EQ(0, lcm.publishStream("channel", &msg));
+        state.expected = sizes[i];
+        EXPECT_EQ(0, lcm.handle());
+    }
+    EXPECT_EQ(3, state.num_handled);
+}
+
+#ifdef LCM_CXX_11_ENABLED
+TEST(LCM_CPP, MemqQueue) {
+    lcm::LCM lcm("memq://");
+    EXPECT_TRUE(lcm.subscribeQueue<lcmtest::primitives_list_t>("channel", 0) == NULL);
+    lcm::MessageQueue<lcmtest::primitives_list_t>* queue =
+        lcm.subscribeQueue<lcmtest::primitives_list_t>("channel", 3);
+    ASSERT_TRUE(queue != NULL);
+
+    // the messages that don't fit are dropped
+    for (int i = 0; i < 5; ++i) {
+        lcmtest::primitives_list_t msg;
+        FillLcmType(i, &msg);
+        lcm.publish("channel", &msg);
+        EXPECT_EQ(0, lcm.handle());
+    }
+    EXPECT_EQ(2, queue->getNumDropped());
+    lcmtest::primitives_list_t msg;
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_TRUE(queue->tryPop(msg));
+        EXPECT_TRUE(CheckLcmType(&msg, i));
+    }
+    EXPECT_FALSE(queue->tryPop(msg));
+    EXPECT_FALSE(queue->popWait(msg, 10));
+    EXPECT_EQ(0, lcm.unsubscribe(queue));
+}
+
+TEST(LCM_CPP, MemqQueueThread) {
+    lcm::LCM lcm("memq://");
+    lcm::MessageQueue<lcmtest::primitives_list_t>* queue =
+        lcm.subscribeQueue<lcmtest::primitives_list_t>("channel", 4);
+    const int num_msgs = 1000;
+    std::atomic<int> num_popped(0);
+    int num_intact = 0;
+    std::thread consumer([&]() {
+        lcmtest::primitives_list_t msg;
+        for (int i = 0; i < num_msgs && queue->popWait(msg, 5000); ++i) {
+            if (CheckLcmType(&msg, i % 10))
+                num_intact++;
+            num_popped++;
+        }
+    });
+    for (int i = 0; i < num_msgs; ++i) {
+        // the queue wraps around many times, but never overflows
+        while (i - num_popped >= 4)
+            std::this_thread::yield();
+        lcmtest::primitives_list_t msg;
+        FillLcmType(i % 10, &msg);
+        lcm.publish("channel", &msg);
+        EXPECT_EQ(0, lcm.handle());
+    }
+    consumer.join();
+    EXPECT_EQ(0, queue->getNumDropped());
+    EXPECT_EQ(num_msgs, num_intact);
+}
+#endif
@@ -0,0 +1,277 @@
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common.hpp"
+#include "lcmtest/byte_array_t.hpp"
+#include "lcmtest/point_cloud_t.hpp"
+
+TEST(LCM_CPP, DecodeFields) {
+    lcmtest::node_t node;
+    FillLcmType(4, &node);
+    lcmtest::primitives_list_t list;
+    FillLcmType(20, &list);
+    lcmtest2::cross_package_t cross;
+    FillLcmType(12, &cross);
+
+    std::vector<uint8_t> buf(list.getEncodedSize());
+    int size = (int)buf.size();
+    ASSERT_EQ(size, list.encode(&buf[0], 0, size));
+
+    // decoding stops after the last member selected
+    lcmtest::primitives_list_t decoded_list;
+    EXPECT_EQ(12, decoded_list.decodeFields(
+                      &buf[0], 0, size,
+                      lcmtest::primitives_list_t::FIELD_num_items));
+    EXPECT_EQ(20, decoded_list.num_items);
+    EXPECT_TRUE(decoded_list.items.empty());
+    EXPECT_EQ(size, decoded_list.decodeFields(
+                        &buf[0], 0, size,
+                        lcmtest::primitives_list_t::FIELD_items));
+    EXPECT_TRUE(CheckLcmType(&decoded_list, 20));
+    EXPECT_GT(0, decoded_list.decodeFields(
+                     &buf[0], 0, size - 1,
+                     lcmtest::primitives_list_t::FIELD_items));
+
+    // nested structs, including recursive ones, are skipped as a whole
+    buf.resize(cross.getEncodedSize());
+    size = (int)buf.size();
+    ASSERT_EQ(size, cross.encode(&buf[0], 0, size));
+    lcmtest2::cross_package_t decoded_cross;
+    EXPECT_EQ(size, decoded_cross.decodeFields(
+                        &buf[0], 0, size,
+                        lcmtest2::cross_package_t::FIELD_another));
+    EXPECT_TRUE(CheckLcmType(&decoded_cross.another, 12));
+    EXPECT_TRUE(decoded_cross.primitives.name.empty());
+
+    buf.resize(node.getEncodedSize());
+    size = (int)buf.size();
+    ASSERT_EQ(size, node.encode(&buf[0], 0, size));
+    EXPECT_EQ(size, lcmtest::node_t::_skipNoHash(&buf[0], 8, size - 8, 1) + 8);
+    EXPECT_GT(0, lcmtest::node_t::_skipNoHash(&buf[0], 8, size - 9, 1));
+
+    ClearLcmType(&node);
+    ClearLcmType(&list);
+    ClearLcmType(&cross);
+}
+
+TEST(LCM_CPP, Swap) {
+    lcmtest::primitives_list_t a, b;
+    FillLcmType(20, &a);
+    FillLcmType(3, &b);
+    const lcmtest::primitives_t* a_items = &a.items[0];
+
+    // swapping exchanges the vectors instead of copying them
+    swap(a, b);
+    EXPECT_TRUE(CheckLcmType(&a, 3));
+    EXPECT_TRUE(CheckLcmType(&b, 20));
+    EXPECT_EQ(a_items, &b.items[0]);
+
+    lcmtest::node_t x, y;
+    FillLcmType(4, &x);
+    FillLcmType(2, &y);
+    x.swap(y);
+    EXPECT_TRUE(CheckLcmType(&x, 2));
+    EXPECT_TRUE(CheckLcmType(&y, 4));
+}
+
+#ifdef LCM_CXX_11_ENABLED
+TEST(LCM_CPP, Move) {
+    lcmtest::primitives_list_t a;
+    FillLcmType(20, &a);
+    const lcmtest::primitives_t* a_items = &a.items[0];
+    std::vector<lcmtest::primitives_list_t> queue;
+    queue.push_back(std::move(a));
+    EXPECT_TRUE(CheckLcmType(&queue[0], 20));
+    EXPECT_EQ(a_items, &queue[0].items[0]);
+}
+#endif
+
+TEST(LCM_CPP, View) {
+    lcmtest2::cross_package_t msg;
+    FillLcmType(12, &msg);
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    int size = (int)buf.size();
+    ASSERT_EQ(size, msg.encode(&buf[0], 0, size));
+
+    lcmtest2::cross_package_t::View view;
+    ASSERT_EQ(size, view.init(&buf[0], 0, size));
+    EXPECT_EQ(size - 8, view.getEncodedMembersSize());
+    EXPECT_EQ(&buf[8], view.getEncodedMembers());
+    lcmtest::primitives_t::View prims = view.get_primitives();
+    const lcmtest::primitives_t& p = msg.primitives;
+    EXPECT_EQ(p.i8, prims.get_i8());
+    EXPECT_EQ(p.i16, prims.get_i16());
+    EXPECT_EQ(p.i64, prims.get_i64());
+    EXPECT_EQ(p.enabled, prims.get_enabled());
+    EXPECT_EQ(p.name, prims.get_name());
+
+    lcm::ArrayView<int16_t> ranges = prims.get_ranges();
+    ASSERT_EQ(p.num_ranges, ranges.size());
+    for (int i = 0; i < p.num_ranges; i++) {
+        EXPECT_EQ(p.ranges[i], ranges[i]);
+    }
+    EXPECT_TRUE(std::equal(ranges.begin(), ranges.end(), p.ranges.begin()));
+    EXPECT_EQ(p.num_ranges, ranges.end() - ranges.begin());
+    std::vector<int16_t> copied(p.num_ranges - 2);
+    EXPECT_EQ(p.num_ranges - 2,
+              ranges.copy(&copied[0], 2, p.num_ranges - 2));
+    EXPECT_TRUE(std::equal(copied.begin(), copied.end(), &p.ranges[2]));
+    EXPECT_GT(0, ranges.copy(&copied[0], 3, p.num_ranges - 2));
+
+    lcm::ArrayView<double> orientation = prims.get_orientation();
+    ASSERT_EQ(4, orientation.size());
+    EXPECT_TRUE(std::equal(orientation.begin(), orientation.end(),
+                           p.orientation));
+    EXPECT_EQ(p.position[1], prims.get_position()[1]);
+
+    // truncated and foreign messages are not valid
+    EXPECT_GT(0, view.init(&buf[0], 0, size - 1));
+    lcmtest::primitives_t::View wrong;
+    EXPECT_GT(0, wrong.init(&buf[0], 0, size));
+}
+
+TEST(LCM_CPP, ViewMultidim) {
+    lcmtest::multidim_array_t msg;
+    FillLcmType(5, &msg);
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    int size = (int)buf.size();
+    ASSERT_EQ(size, msg.encode(&buf[0], 0, size));
+
+    lcmtest::multidim_array_t::View view;
+    ASSERT_EQ(size, view.init(&buf[0], 0, size));
+    lcm::ArrayView<int32_t> data = view.get_data();
+    ASSERT_EQ(msg.size_a * msg.size_b * msg.size_c, data.size());
+    int i = 0;
+    for (int a = 0; a < msg.size_a; a++)
+        for (int b = 0; b < msg.size_b; b++)
+            for (int c = 0; c < msg.size_c; c++)
+                EXPECT_EQ(msg.data[a][b][c], data[i++]);
+}
+
+TEST(LCM_CPP, ViewBytes) {
+    lcmtest::byte_array_t msg;
+    msg.num_bytes = 20;
+    for (int i = 0; i < msg.num_bytes; i++)
+        msg.data.push_back((uint8_t)(i * 13));
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    int size = (int)buf.size();
+    ASSERT_EQ(size, msg.encode(&buf[0], 0, size));
+
+    lcmtest::byte_array_t::View view;
+    ASSERT_EQ(size, view.init(&buf[0], 0, size));
+    lcm::ArrayView<uint8_t> data = view.get_data();
+    ASSERT_EQ(msg.num_bytes, data.size());
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), msg.data.begin()));
+    std::vector<uint8_t> copied(msg.num_bytes);
+    EXPECT_EQ(msg.num_bytes, data.copy(&copied[0], 0, msg.num_bytes));
+    EXPECT_TRUE(copied == msg.data);
+}
+
+static int AppendToVector(void* user, const void* data, int len) {
+    std::vector<uint8_t>* out = (std::vector<uint8_t>*)user;
+    const uint8_t* p = (const uint8_t*)data;
+    out->insert(out->end(), p, p + len);
+    return 0;
+}
+
+template <typename T>
+static void CheckStreamEncode(int fill_arg, int capacity) {
+    T msg;
+    FillLcmType(fill_arg, &msg);
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    ASSERT_EQ((int)buf.size(), msg.encode(&buf[0], 0, buf.size()));
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> tmp(capacity);
+    lcm_encode_stream_t stream = {AppendToVector, &out, &tmp[0], capacity, 0};
+    EXPECT_EQ(0, msg.encode(&stream));
+    EXPECT_EQ(0, __lcm_stream_flush(&stream));
+    EXPECT_TRUE(buf == out);
+}
+
+TEST(LCM_CPP, EncodeStream) {
+    // buffers shorter than a string are flushed in the middle of it
+    for (int capacity = 8; capacity <= 13; capacity += 5) {
+        CheckStreamEncode<lcmtest::primitives_t>(7, capacity);
+        CheckStreamEncode<lcmtest::primitives_list_t>(20, capacity);
+        CheckStreamEncode<lcmtest::node_t>(4, capacity);
+        CheckStreamEncode<lcmtest::multidim_array_t>(5, capacity);
+    }
+}
+
+static void FillPointCloud(int n, lcmtest::point_cloud_t* msg) {
+    msg->utime = 1234567;
+    msg->num_points = n;
+    msg->points.resize(0);
+    for (int i = 0; i < n; i++) {
+        lcmtest::point_t point;
+        point.x = i * 0.5f;
+        point.y = -i * 0.25f;
+        point.z = i + 100.0f;
+        point.intensity = (int16_t)(i * 300 - 5000);
+        point.valid = i % 3 == 0;
+        point.stamp = i * 1e-3;
+        msg->points.push_back(point);
+    }
+    msg->frame = "lidar";
+}
+
+TEST(LCM_CPP, StructOfArrays) {
+    // the points are stored and encoded one member at a time, with the
+    // encoding of an array of point_t
+    lcmtest::point_cloud_t msg;
+    FillPointCloud(37, &msg);
+    EXPECT_EQ(37, msg.points.size());
+    std::vector<uint8_t> buf(msg.getEncodedSize());
+    int size = (int)buf.size();
+    EXPECT_EQ(8 + 12 + 37 * 23 + 4 + 6, size);
+    ASSERT_EQ(size, msg.encode(&buf[0], 0, size));
+    for (int i = 0; i < 37; i++) {
+        lcmtest::point_t point;
+        ASSERT_EQ(23, point._decodeNoHash(&buf[0], 20 + i * 23, size));
+        lcmtest::point_t expected = msg.points.get(i);
+        EXPECT_EQ(expected.x, point.x);
+        EXPECT_EQ(expected.y, point.y);
+        EXPECT_EQ(expected.z, point.z);
+        EXPECT_EQ(expected.intensity, point.intensity);
+        EXPECT_EQ(expected.valid, point.valid);
+        EXPECT_EQ(expected.stamp, point.stamp);
+    }
+
+    lcmtest::point_cloud_t decoded;
+    ASSERT_EQ(size, decoded.decode(&buf[0], 0, size));
+    EXPECT_EQ(37, decoded.points.size());
+    EXPECT_TRUE(decoded.points.stamp == msg.points.stamp);
+    EXPECT_TRUE(decoded.points.valid == msg.points.valid);
+    std::vector<uint8_t> reencoded(size);
+    ASSERT_EQ(size, decoded.encode(&reencoded[0], 0, size));
+    EXPECT_TRUE(buf == reencoded);
+    EXPECT_GT(0, decoded.decode(&buf[0], 0, 8 + 12 + 36 * 23));
+    EXPECT_GT(0, decoded.decode(&buf[0], 0, size - 1));
+
+    lcmtest::point_cloud_t frame_only;
+    EXPECT_EQ(size, frame_only.decodeFields(
+                        &buf[0], 0, size,
+                        lcmtest::point_cloud_t::FIELD_frame));
+    EXPECT_EQ(0, frame_only.points.size());
+    EXPECT_EQ("lidar", frame_only.frame);
+
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> tmp(16);
+    lcm_encode_stream_t stream = {AppendToVector, &out, &tmp[0], 16, 0};
+    EXPECT_EQ(0, msg.encode(&stream));
+    EXPECT_EQ(0, __lcm_stream_flush(&stream));
+    EXPECT_TRUE(buf == out);
+
+    swap(msg, frame_only);
+    EXPECT_EQ(0, msg.points.size());
+    EXPECT_EQ(37, frame_only.points.size());
+
+    // every column must have the elements that the message declares
+    frame_only.points.intensity.pop_back();
+    EXPECT_GT(0, frame_only.encode(&buf[0], 0, size));
+    out.clear();
+    EXPECT_GT(0, frame_only.encode(&stream));
+}
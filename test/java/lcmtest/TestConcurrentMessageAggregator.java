@@ -0,0 +1,68 @@
+import static org.junit.Assert.*;
+import org.junit.Test;
+
+import java.util.ArrayList;
+
+import lcm.lcm.ConcurrentMessageAggregator;
+import lcm.lcm.LCMDataInputStream;
+import lcm.lcm.MessageAggregator;
+
+public class TestConcurrentMessageAggregator {
+    static void receive(ConcurrentMessageAggregator agg, int value) {
+        byte[] data = new byte[] { (byte) value };
+        agg.messageReceived(null, "CHANNEL", new LCMDataInputStream(data));
+    }
+
+    @Test
+    public void testDropOldest() throws Exception {
+        ConcurrentMessageAggregator agg = new ConcurrentMessageAggregator(
+            4, ConcurrentMessageAggregator.OverflowPolicy.DROP_OLDEST);
+        for (int i = 0; i < 6; i++)
+            receive(agg, i);
+        assertEquals(4, agg.numMessagesAvailable());
+        assertEquals(2, agg.getNumDropped());
+
+        MessageAggregator.Message m = agg.getNextMessage(0);
+        assertEquals("CHANNEL", m.channel);
+        assertEquals(2, m.data[0]);
+    }
+
+    @Test
+    public void testDropNewest() throws Exception {
+        ConcurrentMessageAggregator agg = new ConcurrentMessageAggregator(
+            4, ConcurrentMessageAggregator.OverflowPolicy.DROP_NEWEST);
+        for (int i = 0; i < 6; i++)
+            receive(agg, i);
+        assertEquals(2, agg.getNumDropped());
+
+        ArrayList<MessageAggregator.Message> out = new ArrayList<MessageAggregator.Message>();
+        assertEquals(3, agg.drainMessages(out, 3));
+        assertEquals(0, out.get(0).data[0]);
+        assertEquals(2, out.get(2).data[0]);
+        assertEquals(1, agg.drainMessages(out, 10));
+        assertEquals(3, out.get(3).data[0]);
+        assertNull(agg.getNextMessage(0));
+    }
+
+    @Test
+    public void testWait() throws Exception {
+        final ConcurrentMessageAggregator agg = new ConcurrentMessageAggregator();
+        assertNull(agg.getNextMessage(10));
+
+        Thread producer = new Thread() {
+            public void run() {
+                for (int i = 0; i < 1000; i++)
+                    receive(agg, i);
+            }
+        };
+        producer.start();
+        int n = 0;
+        while (n < 1000) {
+            MessageAggregator.Message m = agg.getNextMessage(5000);
+            assertNotNull(m);
+            assertEquals((byte) n, m.data[0]);
+            n++;
+        }
+        producer.join();
+    }
+}
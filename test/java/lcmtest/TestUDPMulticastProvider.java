@@ -1,6 +1,12 @@
+import static org.junit.Assert.*;
 import org.junit.Test;
 
+import java.nio.ByteBuffer;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.TimeUnit;
+
 import lcm.lcm.LCM;
+import lcm.lcm.LCMBufferSubscriber;
 
 public class TestUDPMulticastProvider {
     @Test
@@ -9,4 +15,31 @@ public class TestUDPMulticastProvider {
         lcm.subscribe("", null);
         lcm.close();
     }
+
+    @Test
+    public void testBufferSubscriber() throws Exception {
+        LCM lcm = new LCM("udpm://239.255.76.67:7671?ttl=0");
+        final ArrayBlockingQueue<byte[]> received = new ArrayBlockingQueue<byte[]>(4);
+        lcm.subscribeBuffer("BUFFER_.*", new LCMBufferSubscriber() {
+            public void messageReceived(LCM lcm, String channel, ByteBuffer data) {
+                byte[] copy = new byte[data.remaining()];
+                data.get(copy);
+                received.offer(copy);
+            }
+        });
+
+        // a short message, and one that is fragmented
+        byte[] small = new byte[100];
+        byte[] large = new byte[100000];
+        for (int i = 0; i < large.length; i++) {
+            large[i] = (byte) (i * 7);
+            if (i < small.length)
+                small[i] = (byte) i;
+        }
+        lcm.publish("BUFFER_SMALL", small, 0, small.length);
+        assertArrayEquals(small, received.poll(5, TimeUnit.SECONDS));
+        lcm.publish("BUFFER_LARGE", large, 0, large.length);
+        assertArrayEquals(large, received.poll(5, TimeUnit.SECONDS));
+        lcm.close();
+    }
 }
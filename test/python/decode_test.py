@@ -0,0 +1,156 @@
+#!/usr/bin/python
+import unittest
+from io import BytesIO
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+import lcmtest
+
+def make_primitives():
+    msg = lcmtest.primitives_t()
+    msg.i8 = -3
+    msg.i16 = 1000
+    msg.num_ranges = 4
+    msg.i64 = -(2 ** 40)
+    msg.ranges = [1, -2, 3, -4]
+    msg.position = [0.5, 1.5, 2.5]
+    msg.orientation = [1.0, 0.0, 0.0, -0.25]
+    msg.name = u"prim\u00e9"
+    msg.enabled = True
+    return msg
+
+def make_tree(depth):
+    node = lcmtest.node_t()
+    if depth > 0:
+        node.num_children = 2
+        node.children = [make_tree(depth - 1), make_tree(depth - 1)]
+    return node
+
+def count_nodes(node):
+    return 1 + sum([count_nodes(child) for child in node.children])
+
+class TestDecode(unittest.TestCase):
+
+    def check_primitives(self, decoded):
+        msg = make_primitives()
+        self.assertEqual(msg.i8, decoded.i8)
+        self.assertEqual(msg.i16, decoded.i16)
+        self.assertEqual(msg.num_ranges, decoded.num_ranges)
+        self.assertEqual(msg.i64, decoded.i64)
+        self.assertEqual(msg.ranges, list(decoded.ranges))
+        self.assertEqual(msg.position, list(decoded.position))
+        self.assertEqual(msg.orientation, list(decoded.orientation))
+        self.assertEqual(msg.name, decoded.name)
+        self.assertTrue(decoded.enabled is True)
+
+    def test_buffers(self):
+        """Decode from the buffer types that decode() accepts."""
+        data = make_primitives().encode()
+        self.check_primitives(lcmtest.primitives_t.decode(data))
+        self.check_primitives(lcmtest.primitives_t.decode(bytearray(data)))
+        self.check_primitives(lcmtest.primitives_t.decode(memoryview(data)))
+
+    def test_stream(self):
+        """Decoding from a stream leaves it positioned after the message."""
+        data = make_primitives().encode()
+        buf = BytesIO(data + data)
+        self.check_primitives(lcmtest.primitives_t.decode(buf))
+        self.assertEqual(len(data), buf.tell())
+        self.check_primitives(lcmtest.primitives_t.decode(buf))
+        self.assertEqual(2 * len(data), buf.tell())
+
+    def test_nested(self):
+        """Decode a recursive type."""
+        data = make_tree(3).encode()
+        decoded = lcmtest.node_t.decode(data)
+        self.assertEqual(15, count_nodes(decoded))
+        self.assertEqual(data, decoded.encode())
+
+    def test_multidim(self):
+        msg = lcmtest.multidim_array_t()
+        msg.size_a = 2
+        msg.size_b = 3
+        msg.size_c = 2
+        msg.data = [[[a * 100 + b * 10 + c for c in range(2)]
+            for b in range(3)] for a in range(2)]
+        msg.strarray = [[u"a", u"bc"], [u"", u"def"]]
+        data = msg.encode()
+        decoded = lcmtest.multidim_array_t.decode(data)
+        for a in range(2):
+            for b in range(3):
+                self.assertEqual(msg.data[a][b], list(decoded.data[a][b]))
+        self.assertEqual(msg.strarray, decoded.strarray)
+        self.assertEqual(data, decoded.encode())
+
+    @unittest.skipIf(numpy is None, "numpy is not available")
+    def test_numpy(self):
+        """The test types are generated with --python-numpy, so that numeric
+        arrays decode to numpy arrays, and encode from them."""
+        msg = lcmtest.multidim_array_t()
+        msg.size_a = 2
+        msg.size_b = 3
+        msg.size_c = 2
+        msg.data = numpy.arange(12, dtype=numpy.int32).reshape((2, 3, 2))
+        msg.strarray = [[u"", u""], [u"", u""]]
+        data = msg.encode()
+        decoded = lcmtest.multidim_array_t.decode(data)
+        self.assertTrue(isinstance(decoded.data, numpy.ndarray))
+        self.assertEqual((2, 3, 2), decoded.data.shape)
+        self.assertTrue(numpy.array_equal(msg.data, decoded.data))
+        self.assertEqual(data, decoded.encode())
+
+        prims = lcmtest.primitives_t.decode(make_primitives().encode())
+        self.assertTrue(isinstance(prims.ranges, numpy.ndarray))
+        self.check_primitives(prims)
+
+        msg.size_c = 3
+        self.assertRaises(ValueError, msg.encode)
+
+    def test_encode_into(self):
+        msgs = [make_primitives(), make_tree(3), lcmtest.bools_t(),
+                lcmtest.byte_array_t()]
+        msgs[3].num_bytes = 3
+        msgs[3].data = [1, 2, 255]
+        buf = bytearray()
+        for msg in msgs:
+            data = msg.encode()
+            self.assertEqual(len(data), msg.encoded_size())
+            # the buffer grows to fit, and is reused at an offset
+            self.assertEqual(len(data), msg.encode_into(buf))
+            self.assertEqual(data, bytes(buf[:len(data)]))
+            self.assertEqual(len(data), msg.encode_into(buf, 3))
+            self.assertEqual(data, bytes(buf[3:3 + len(data)]))
+            self.assertEqual(type(msg), type(type(msg).decode(buf[3:])))
+
+        self.assertRaises(ValueError, make_tree(1).encode_into, b"")
+
+    @unittest.skipIf(numpy is None, "numpy is not available")
+    def test_encode_into_numpy(self):
+        msg = lcmtest.multidim_array_t()
+        msg.size_a = 2
+        msg.size_b = 3
+        msg.size_c = 2
+        msg.data = numpy.arange(12, dtype=numpy.int32).reshape((2, 3, 2))
+        msg.strarray = [[u"a", u"bc"], [u"", u"d"]]
+        buf = bytearray()
+        self.assertEqual(msg.encoded_size(), msg.encode_into(buf))
+        self.assertEqual(msg.encode(), bytes(buf))
+
+        prims = lcmtest.primitives_t.decode(make_primitives().encode())
+        buf = bytearray(prims.encoded_size())
+        prims.encode_into(memoryview(buf))
+        self.assertEqual(make_primitives().encode(), bytes(buf))
+
+        msg.size_c = 3
+        self.assertRaises(ValueError, msg.encode_into, bytearray())
+
+    def test_bad_fingerprint(self):
+        data = make_primitives().encode()
+        self.assertRaises(ValueError, lcmtest.node_t.decode, data)
+        self.assertRaises(ValueError, lcmtest.node_t.decode, BytesIO(data))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,86 @@
+#!/usr/bin/python
+import asyncio
+import threading
+import unittest
+
+import lcm
+import lcm.aio
+
+def run(coro):
+    loop = asyncio.new_event_loop()
+    try:
+        return loop.run_until_complete(asyncio.wait_for(coro, 10))
+    finally:
+        loop.close()
+
+class TestLcmAsyncio(unittest.TestCase):
+    def test_iterate(self):
+        async def main():
+            alc = lcm.aio.AsyncLCM(lcm.LCM("memq://"))
+            sub = alc.subscribe("CHAN")
+            other = alc.subscribe("OTHER")
+            for i in range(10):
+                alc.publish("CHAN", str(i).encode())
+            received = []
+            async for channel, data in sub:
+                self.assertEqual("CHAN", channel)
+                received.append(data)
+                if len(received) == 10:
+                    break
+            self.assertEqual([str(i).encode() for i in range(10)], received)
+            self.assertEqual(0, other.qsize())
+            alc.close()
+            self.assertEqual([], await sub.get_batch())
+        run(main())
+
+    def test_get_batch(self):
+        async def main():
+            async with lcm.aio.AsyncLCM(lcm.LCM("memq://"),
+                    max_batch=4) as alc:
+                sub = alc.subscribe("CHAN")
+                for i in range(10):
+                    alc.publish("CHAN", b"x")
+                received = 0
+                while received < 10:
+                    batch = await sub.get_batch(3)
+                    self.assertTrue(1 <= len(batch) <= 3)
+                    received += len(batch)
+            with self.assertRaises(StopAsyncIteration):
+                await sub.get()
+        run(main())
+
+    def test_maxlen(self):
+        async def main():
+            alc = lcm.aio.AsyncLCM(lcm.LCM("memq://"))
+            sub = alc.subscribe("CHAN", maxlen=2)
+            for i in range(5):
+                alc.publish("CHAN", str(i).encode())
+            # let the loop handle all of them before consuming any
+            while sub.num_dropped + sub.qsize() < 5:
+                await asyncio.sleep(0.01)
+            self.assertEqual(3, sub.num_dropped)
+            self.assertEqual([("CHAN", b"3"), ("CHAN", b"4")],
+                    await sub.get_batch())
+            alc.close()
+        run(main())
+
+    def test_other_thread(self):
+        """Messages published from another thread wake up the loop."""
+        async def main():
+            alc = lcm.aio.AsyncLCM(lcm.LCM("memq://"))
+            sub = alc.subscribe("CHAN")
+            def publish():
+                for i in range(100):
+                    alc.lc.publish("CHAN", str(i).encode())
+            thread = threading.Thread(target=publish)
+            thread.start()
+            received = []
+            while len(received) < 100:
+                received.append((await sub.get())[1])
+            thread.join()
+            self.assertEqual([str(i).encode() for i in range(100)], received)
+            alc.close()
+        run(main())
+
+if __name__ == '__main__':
+    unittest.main()
@@ -47,6 +47,38 @@ class TestLcmFile(unittest.TestCase):
             lcm_obj.publish(self.test_channel, msg.encode())
         lcm_obj.unsubscribe(subs)
 
+    def test_read_events(self):
+        log = lcm.EventLog(self.log_filename, "w")
+        for iteration in range(self.num_iterations):
+            msg = self.tester.make_message(iteration)
+            channel = self.test_channel if iteration % 2 else "OTHER"
+            log.write_event(iteration, channel, msg.encode())
+        log.close()
+
+        log = lcm.EventLog(self.log_filename)
+        batches = list(log.batches(30))
+        self.assertEqual([30, 30, 30, 10], [len(b) for b in batches])
+        events = [event for batch in batches for event in batch]
+        for iteration, event in enumerate(events):
+            self.assertEqual(iteration, event.timestamp)
+            self.assertTrue(isinstance(event.data, memoryview))
+            self.assertTrue(event.data.readonly)
+            self.assertEqual(self.tester.make_message(iteration).encode(),
+                    event.data.tobytes())
+            self.tester.check_reply(self.msg_type.decode(event.data),
+                    iteration)
+        self.assertEqual([], log.read_events())
+        self.assertRaises(ValueError, log.read_events, 0)
+        log.close()
+
+        log = lcm.EventLog(self.log_filename, channel_regex=self.test_channel)
+        events = log.read_events(self.num_iterations)
+        self.assertEqual(self.num_iterations // 2, len(events))
+        for event in events:
+            self.assertEqual(self.test_channel, event.channel)
+            self.assertEqual(1, event.timestamp % 2)
+        log.close()
+
 
 def main():
     unittest.main()
@@ -34,6 +34,51 @@ class TestLcmMemq(unittest.TestCase):
         self.assertLess(0, lcm_obj.handle_timeout(10000))
         self.assertTrue(on_msg.msg_handled)
 
+    def test_publish_buffer(self):
+        # any object with the buffer interface can be published
+        lcm_obj = lcm.LCM("memq://")
+        def on_msg(channel, data):
+            on_msg.received.append(data)
+        on_msg.received = []
+        lcm_obj.subscribe("channel", on_msg)
+        buf = bytearray(b"xxdata")
+        lcm_obj.publish("channel", buf)
+        lcm_obj.publish("channel", memoryview(buf)[2:])
+        self.assertEqual(2, lcm_obj.handle_batch(10, 0))
+        self.assertEqual([b"xxdata", b"data"], on_msg.received)
+        with self.assertRaises(TypeError):
+            lcm_obj.publish("channel", 5)
+
+    def test_handle_batch(self):
+        lcm_obj = lcm.LCM("memq://")
+        self.assertEqual(0, lcm_obj.handle_batch(10, 0))
+        with self.assertRaises(ValueError):
+            lcm_obj.handle_batch(0, 0)
+        with self.assertRaises(ValueError):
+            lcm_obj.handle_batch(10, -1)
+
+        received = []
+        def on_msg(channel, data):
+            received.append(data)
+        subs = lcm_obj.subscribe("channel", on_msg)
+        subs.set_queue_capacity(0)
+        for i in range(25):
+            lcm_obj.publish("channel", str(i))
+        self.assertEqual(10, lcm_obj.handle_batch(10, 0))
+        self.assertEqual(10, lcm_obj.handle_batch(10, 0))
+        self.assertEqual(5, lcm_obj.handle_batch(10, 10))
+        self.assertEqual(0, lcm_obj.handle_batch(10, 0))
+        self.assertEqual([str(i).encode() for i in range(25)], received)
+
+        # an exception stops the batch
+        def on_error(channel, data):
+            raise RuntimeError(data)
+        lcm_obj.subscribe("error", on_error)
+        for i in range(3):
+            lcm_obj.publish("error", "")
+        with self.assertRaises(RuntimeError):
+            lcm_obj.handle_batch(10, 0)
+
 def main():
     unittest.main()
 